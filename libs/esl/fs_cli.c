@@ -659,6 +659,12 @@ static int output_printf(const char *fmt, ...)
 	return r;
 }
 
+static void api_chunk_print(const char *data, esl_size_t len, void *user_data)
+{
+	fwrite(data, 1, len, stdout);
+	fflush(stdout);
+}
+
 static void *msg_thread_run(esl_thread_t *me, void *obj)
 {
 	esl_handle_t *handle = (esl_handle_t *) obj;
@@ -820,7 +826,7 @@ static int process_command(esl_handle_t *handle, const char *cmd)
 			printf("%s\n", handle->last_sr_reply);
 		}
 
-		snprintf(cmd_str, sizeof(cmd_str), "api %s\nconsole_execute: true\n\n", cmd);
+		snprintf(cmd_str, sizeof(cmd_str), "api %s\nconsole_execute: true\nchunked_response: true\n\n", cmd);
 		if (esl_send_recv(handle, cmd_str)) {
 			output_printf("Socket interrupted, bye!\n");
 			return -1;
@@ -1365,6 +1371,8 @@ int main(int argc, char *argv[])
 			}
 		} else {
 			connected = 1;
+			/* print long api output as it streams in rather than holding all of it */
+			handle.api_chunk_callback = api_chunk_print;
 			if (temp_log < 0 ) {
 				esl_global_set_default_logger(profile->debug);
 			} else {
@@ -1375,7 +1383,7 @@ int main(int argc, char *argv[])
 	}
 	if (argv_exec) {
 		const char *err = NULL;
-		snprintf(cmd_str, sizeof(cmd_str), "api %s\nconsole_execute: true\n\n", argv_command);
+		snprintf(cmd_str, sizeof(cmd_str), "api %s\nconsole_execute: true\nchunked_response: true\n\n", argv_command);
 		if (timeout) {
 			esl_status_t status = esl_send_recv_timed(&handle, cmd_str, timeout);
 			if (status != ESL_SUCCESS) {
@@ -407,14 +407,27 @@ ESL_DECLARE(size_t) esl_url_encode(const char *url, char *buf, size_t len)
 	return x;
 }
 
+static int hex_val(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
 ESL_DECLARE(char *)esl_url_decode(char *s)
 {
 	char *o;
-	unsigned int tmp;
+	int hi, lo;
+
+	/* nothing moves until the first escape */
+	while (*s && *s != '%') {
+		s++;
+	}
 
 	for (o = s; *s; s++, o++) {
-		if (*s == '%' && strlen(s) > 2 && sscanf(s + 1, "%2x", &tmp) == 1) {
-			*o = (char) tmp;
+		if (*s == '%' && (hi = hex_val(s[1])) >= 0 && (lo = hex_val(s[2])) >= 0) {
+			*o = (char) (hi << 4 | lo);
 			s += 2;
 		} else {
 			*o = *s;
@@ -613,6 +626,8 @@ ESL_DECLARE(esl_status_t) esl_events(esl_handle_t *handle, esl_event_type_t etyp
 		type = "xml";
 	} else if (etype == ESL_EVENT_TYPE_JSON) {
 		type = "json";
+	} else if (etype == ESL_EVENT_TYPE_BINARY) {
+		type = "binary";
 	}
 
 	snprintf(send_buf, sizeof(send_buf), "event %s %s\n\n", type, value);
@@ -1083,6 +1098,17 @@ ESL_DECLARE(esl_status_t) esl_disconnect(esl_handle_t *handle)
 	esl_event_safe_destroy(&handle->last_sr_event);
 	esl_event_safe_destroy(&handle->last_ievent);
 	esl_event_safe_destroy(&handle->info_event);
+	esl_event_safe_destroy(&handle->partial_event);
+
+	if (handle->bin_names) {
+		uint32_t i;
+
+		for (i = 0; i < handle->bin_names_len; i++) {
+			esl_safe_free(handle->bin_names[i]);
+		}
+		esl_safe_free(handle->bin_names);
+		handle->bin_names_len = 0;
+	}
 
 	if (handle->sock != ESL_SOCK_INVALID) {
 		closesocket(handle->sock);
@@ -1177,14 +1203,330 @@ static esl_ssize_t handle_recv(esl_handle_t *handle, void *data, esl_size_t data
 	return -1;
 }
 
+static int esl_binary_get(const unsigned char **p, const unsigned char *end, void *data, esl_size_t len)
+{
+	if (end - *p < (esl_ssize_t) len) {
+		return 0;
+	}
+
+	memcpy(data, *p, len);
+	*p += len;
+
+	return 1;
+}
+
+static char *esl_binary_get_str(const unsigned char **p, const unsigned char *end, esl_size_t len)
+{
+	char *str;
+
+	if (end - *p < (esl_ssize_t) len) {
+		return NULL;
+	}
+
+	str = malloc(len + 1);
+	esl_assert(str);
+	memcpy(str, *p, len);
+	str[len] = '\0';
+	*p += len;
+
+	return str;
+}
+
+/* see the format description in mod_event_socket, names defined by 'N' records stay valid for the whole connection */
+static esl_status_t esl_parse_binary_event(esl_handle_t *handle, const char *body, esl_size_t len)
+{
+	const unsigned char *p = (const unsigned char *) body, *end = p + len;
+	esl_event_t *event = NULL;
+	esl_status_t status = ESL_FAIL;
+
+	esl_event_create(&event, ESL_EVENT_CLONE);
+
+	while (p < end) {
+		unsigned char type = *p++;
+		uint16_t id = 0, nlen = 0;
+		uint32_t vlen = 0;
+		char *name = NULL, *val = NULL;
+		const char *hname = NULL;
+
+		switch (type) {
+		case 'N':
+			if (!esl_binary_get(&p, end, &id, sizeof(id)) || !esl_binary_get(&p, end, &nlen, sizeof(nlen))) {
+				goto end;
+			}
+			id = ntohs(id);
+			nlen = ntohs(nlen);
+
+			if (!(name = esl_binary_get_str(&p, end, nlen))) {
+				goto end;
+			}
+
+			if (id >= handle->bin_names_len) {
+				uint32_t nsize = handle->bin_names_len ? handle->bin_names_len : 256;
+				char **tmp;
+
+				while (id >= nsize) {
+					nsize *= 2;
+				}
+
+				tmp = realloc(handle->bin_names, nsize * sizeof(char *));
+				esl_assert(tmp);
+				memset(tmp + handle->bin_names_len, 0, (nsize - handle->bin_names_len) * sizeof(char *));
+				handle->bin_names = tmp;
+				handle->bin_names_len = nsize;
+			}
+
+			esl_safe_free(handle->bin_names[id]);
+			handle->bin_names[id] = name;
+			continue;
+		case 'H':
+			if (!esl_binary_get(&p, end, &id, sizeof(id))) {
+				goto end;
+			}
+			id = ntohs(id);
+
+			if (id >= handle->bin_names_len || !(hname = handle->bin_names[id])) {
+				goto end;
+			}
+			break;
+		case 'I':
+			if (!esl_binary_get(&p, end, &nlen, sizeof(nlen))) {
+				goto end;
+			}
+			nlen = ntohs(nlen);
+
+			if (!(name = esl_binary_get_str(&p, end, nlen))) {
+				goto end;
+			}
+			hname = name;
+			break;
+		case 'B':
+			if (!esl_binary_get(&p, end, &vlen, sizeof(vlen))) {
+				goto end;
+			}
+			vlen = ntohl(vlen);
+
+			if (!(val = esl_binary_get_str(&p, end, vlen))) {
+				goto end;
+			}
+
+			if (vlen) {
+				esl_safe_free(event->body);
+				event->body = val;
+			} else {
+				free(val);
+			}
+			continue;
+		default:
+			goto end;
+		}
+
+		if (!esl_binary_get(&p, end, &vlen, sizeof(vlen))) {
+			esl_safe_free(name);
+			goto end;
+		}
+		vlen = ntohl(vlen);
+
+		if (!(val = esl_binary_get_str(&p, end, vlen))) {
+			esl_safe_free(name);
+			goto end;
+		}
+
+		if (!strcasecmp(hname, "event-name")) {
+			esl_event_del_header(event, "event-name");
+			esl_name_event(val, &event->event_id);
+		}
+
+		if (!strncmp(val, "ARRAY::", 7)) {
+			esl_event_add_array(event, hname, val);
+		} else {
+			esl_event_add_header_string(event, ESL_STACK_BOTTOM, hname, val);
+		}
+
+		free(val);
+		esl_safe_free(name);
+	}
+
+	status = ESL_SUCCESS;
+
+ end:
+
+	if (status == ESL_SUCCESS) {
+		esl_event_safe_destroy(&handle->last_ievent);
+		handle->last_ievent = event;
+	} else {
+		esl_event_destroy(&event);
+	}
+
+	return status;
+}
+
+/* with lazy_parse the header keeps pointing into the block it was parsed from and is decoded when it is read */
+static void add_parsed_header(esl_event_t *event, char *hname, char *hval, int lazy)
+{
+	/* arrays are split up front, encoded or not */
+	if (lazy && strncmp(hval, "ARRAY", 5)) {
+		esl_event_add_header_slice(event, hname, hval, strchr(hval, '%') ? ESL_TRUE : ESL_FALSE);
+		return;
+	}
+
+	esl_url_decode(hval);
+
+	if (!strncmp(hval, "ARRAY::", 7)) {
+		esl_event_add_array(event, hname, hval);
+	} else {
+		esl_event_add_header_string(event, ESL_STACK_BOTTOM, hname, hval);
+	}
+}
+
+/* headers of one packet off the socket, the buffer is cut up in place or copied to the event's slab first */
+static esl_event_t *parse_socket_data(esl_handle_t *handle, char *data, esl_size_t len)
+{
+	esl_event_t *revent;
+	char *hname, *hval, *p, *e;
+
+	esl_event_create(&revent, ESL_EVENT_CLONE);
+	revent->event_id = ESL_EVENT_SOCKET_DATA;
+	esl_event_add_header_string(revent, ESL_STACK_BOTTOM, "Event-Name", "SOCKET_DATA");
+
+	if (handle->lazy_parse) {
+		revent->slab = malloc(len + 1);
+		esl_assert(revent->slab);
+		memcpy(revent->slab, data, len + 1);
+		data = revent->slab;
+	}
+
+	hname = p = data;
+
+	while(p) {
+		hname = p;
+		p = NULL;
+
+		if ((hval = strchr(hname, ':'))) {
+			*hval++ = '\0';
+			while(*hval == ' ' || *hval == '\t') hval++;
+
+			if ((e = strchr(hval, '\n'))) {
+				*e++ = '\0';
+				while(*e == '\n' || *e == '\r') e++;
+				
+				if (hname && hval) {
+					esl_log(ESL_LOG_DEBUG, "RECV HEADER [%s] = [%s]\n", hname, hval);
+					add_parsed_header(revent, hname, hval, handle->lazy_parse);
+				}
+				
+				p = e;
+			}
+		}
+	}
+
+	return revent;
+}
+
+/* reply text, disconnect notices and the inner event of a complete packet, ESL_FAIL means the server is hanging up on us */
+static esl_status_t parse_packet(esl_handle_t *handle, esl_event_t *revent)
+{
+	char *c, *beg, *hname, *hval, *col, *cl;
+
+	hval = esl_event_get_header(revent, "reply-text");
+
+	if (!esl_strlen_zero(hval)) {
+		strncpy(handle->last_reply, hval, sizeof(handle->last_reply));
+	}
+
+	hval = esl_event_get_header(revent, "content-type");
+
+	if (!esl_safe_strcasecmp(hval, "text/disconnect-notice") && revent->body) {
+		const char *dval = esl_event_get_header(revent, "content-disposition");
+		if (esl_strlen_zero(dval) || strcasecmp(dval, "linger")) {
+			return ESL_FAIL;
+		}
+	}
+	
+	if (revent->body) {
+		if (!esl_safe_strcasecmp(hval, "text/event-plain")) {
+			esl_event_types_t et = ESL_EVENT_CLONE;
+			char *body = strdup(revent->body);
+		
+			esl_event_create(&handle->last_ievent, et);
+
+			beg = body;
+
+			while(beg) {
+				if (!(c = strchr(beg, '\n'))) {
+					break;
+				}
+
+				hname = beg;
+				hval = col = NULL;
+		
+				if (hname && (col = strchr(hname, ':'))) {
+					hval = col + 1;
+					*col = '\0';
+					while(*hval == ' ') hval++;
+				}
+			
+				*c = '\0';
+		
+				if (hname && hval) {
+					esl_log(ESL_LOG_DEBUG, "RECV INNER HEADER [%s] = [%s]\n", hname, hval);
+					if (!strcasecmp(hname, "event-name")) {
+						esl_event_del_header(handle->last_ievent, "event-name");
+						add_parsed_header(handle->last_ievent, hname, hval, 0);
+						esl_name_event(hval, &handle->last_ievent->event_id);
+					} else {
+						add_parsed_header(handle->last_ievent, hname, hval, handle->lazy_parse);
+					}
+				}
+			
+				beg = c + 1;
+
+				if (*beg == '\n') {
+					beg++;
+					break;
+				}
+			}
+		
+			if ((cl = esl_event_get_header(handle->last_ievent, "content-length"))) {
+				handle->last_ievent->body = strdup(beg);
+			}
+
+			if (handle->lazy_parse) {
+				handle->last_ievent->slab = body;
+			} else {
+				free(body);
+			}
+
+			if (esl_log_level >= 7) {
+				char *foo;
+				esl_event_serialize(handle->last_ievent, &foo, ESL_FALSE);
+				esl_log(ESL_LOG_DEBUG, "RECV EVENT\n%s\n", foo);
+				free(foo);
+			}
+		} else if (!esl_safe_strcasecmp(hval, "text/event-json")) {
+			esl_event_create_json(&handle->last_ievent, revent->body);
+		} else if (!esl_safe_strcasecmp(hval, "text/event-binary")) {
+			const char *blen = esl_event_get_header(revent, "content-length");
+
+			if (esl_parse_binary_event(handle, revent->body, blen ? atol(blen) : 0) != ESL_SUCCESS) {
+				esl_log(ESL_LOG_ERROR, "Invalid binary event\n");
+			}
+		}
+	}
+
+	if (esl_log_level >= 7) {
+		char *foo;
+		esl_event_serialize(revent, &foo, ESL_FALSE);
+		esl_log(ESL_LOG_DEBUG, "RECV MESSAGE\n%s\n", foo);
+		free(foo);
+	}
+
+	return ESL_SUCCESS;
+}
+
 ESL_DECLARE(esl_status_t) esl_recv_event(esl_handle_t *handle, int check_q, esl_event_t **save_event)
 {
-	char *c;
 	esl_ssize_t rrval;
 	esl_event_t *revent = NULL;
-	char *beg;
-	char *hname, *hval;
-	char *col;
 	char *cl;
 	esl_ssize_t len;
 	int zc = 0;
@@ -1214,44 +1556,8 @@ ESL_DECLARE(esl_status_t) esl_recv_event(esl_handle_t *handle, int check_q, esl_
 		esl_size_t len1;
 		
 		if ((len1 = esl_buffer_read_packet(handle->packet_buf, handle->socket_buf, sizeof(handle->socket_buf) - 1))) {
-			char *data = (char *) handle->socket_buf;
-			char *p, *e;
-
-			*(data + len1) = '\0';
-			
-			esl_event_create(&revent, ESL_EVENT_CLONE);
-			revent->event_id = ESL_EVENT_SOCKET_DATA;
-			esl_event_add_header_string(revent, ESL_STACK_BOTTOM, "Event-Name", "SOCKET_DATA");
-			
-			hname = p = data;
-
-			while(p) {
-				hname = p;
-				p = NULL;
-
-				if ((hval = strchr(hname, ':'))) {
-					*hval++ = '\0';
-					while(*hval == ' ' || *hval == '\t') hval++;
-
-					if ((e = strchr(hval, '\n'))) {
-						*e++ = '\0';
-						while(*e == '\n' || *e == '\r') e++;
-						
-						if (hname && hval) {
-							esl_url_decode(hval);
-							esl_log(ESL_LOG_DEBUG, "RECV HEADER [%s] = [%s]\n", hname, hval);
-							if (!strncmp(hval, "ARRAY::", 7)) {
-								esl_event_add_array(revent, hname, hval);
-							} else {
-								esl_event_add_header_string(revent, ESL_STACK_BOTTOM, hname, hval);
-							}
-						}
-						
-						p = e;
-					}
-				}
-			}
-
+			*((char *) handle->socket_buf + len1) = '\0';
+			revent = parse_socket_data(handle, (char *) handle->socket_buf, len1);
 			break;
 		}
 
@@ -1325,107 +1631,77 @@ ESL_DECLARE(esl_status_t) esl_recv_event(esl_handle_t *handle, int check_q, esl_
 		handle->last_event = revent;
 	}
 	
-	if (revent) {
-		hval = esl_event_get_header(revent, "reply-text");
+	if (revent && parse_packet(handle, revent) != ESL_SUCCESS) {
+		goto fail;
+	}
 
-		if (!esl_strlen_zero(hval)) {
-			strncpy(handle->last_reply, hval, sizeof(handle->last_reply));
-		}
+	esl_mutex_unlock(handle->mutex);
 
-		hval = esl_event_get_header(revent, "content-type");
+	return ESL_SUCCESS;
 
-		if (!esl_safe_strcasecmp(hval, "text/disconnect-notice") && revent->body) {
-			const char *dval = esl_event_get_header(revent, "content-disposition");
-			if (esl_strlen_zero(dval) || strcasecmp(dval, "linger")) {
-				goto fail;
-			}
-		}
-		
-		if (revent->body) {
-			if (!esl_safe_strcasecmp(hval, "text/event-plain")) {
-				esl_event_types_t et = ESL_EVENT_CLONE;
-				char *body = strdup(revent->body);
-			
-				esl_event_create(&handle->last_ievent, et);
+ fail:
 
-				beg = body;
+	esl_mutex_unlock(handle->mutex);
 
-				while(beg) {
-					if (!(c = strchr(beg, '\n'))) {
-						break;
-					}
+	handle->connected = 0;
 
-					hname = beg;
-					hval = col = NULL;
-			
-					if (hname && (col = strchr(hname, ':'))) {
-						hval = col + 1;
-						*col = '\0';
-						while(*hval == ' ') hval++;
-					}
-				
-					*c = '\0';
-			
-					if (hname && hval) {
-						esl_url_decode(hval);
-						esl_log(ESL_LOG_DEBUG, "RECV INNER HEADER [%s] = [%s]\n", hname, hval);
-						if (!strcasecmp(hname, "event-name")) {
-							esl_event_del_header(handle->last_ievent, "event-name");
-						        esl_name_event(hval, &handle->last_ievent->event_id);
-						}
-
-						if (!strncmp(hval, "ARRAY::", 7)) {
-							esl_event_add_array(handle->last_ievent, hname, hval);
-						} else {
-							esl_event_add_header_string(handle->last_ievent, ESL_STACK_BOTTOM, hname, hval);
-						}
-					}
-				
-					beg = c + 1;
+	return ESL_FAIL;
 
-					if (*beg == '\n') {
-						beg++;
-						break;
-					}
-				}
-			
-				if ((cl = esl_event_get_header(handle->last_ievent, "content-length"))) {
-					handle->last_ievent->body = strdup(beg);
-				}
-			
-				free(body);			
+}
 
-				if (esl_log_level >= 7) {
-					char *foo;
-					esl_event_serialize(handle->last_ievent, &foo, ESL_FALSE);
-					esl_log(ESL_LOG_DEBUG, "RECV EVENT\n%s\n", foo);
-					free(foo);
-				}
-			} else if (!esl_safe_strcasecmp(hval, "text/event-json")) {
-				esl_event_create_json(&handle->last_ievent, revent->body);
-			}
+ESL_DECLARE(esl_status_t) esl_recv_buffered_event(esl_handle_t *handle, esl_event_t **save_event)
+{
+	esl_event_t *revent;
+	esl_status_t status = ESL_BREAK;
+	char *cl;
+
+	*save_event = NULL;
+
+	esl_mutex_lock(handle->mutex);
+
+	if (!handle->partial_event) {
+		esl_size_t len1;
+
+		if (!(len1 = esl_buffer_read_packet(handle->packet_buf, handle->socket_buf, sizeof(handle->socket_buf) - 1))) {
+			goto end;
 		}
 
-		if (esl_log_level >= 7) {
-			char *foo;
-			esl_event_serialize(revent, &foo, ESL_FALSE);
-			esl_log(ESL_LOG_DEBUG, "RECV MESSAGE\n%s\n", foo);
-			free(foo);
+		*((char *) handle->socket_buf + len1) = '\0';
+		handle->partial_event = parse_socket_data(handle, (char *) handle->socket_buf, len1);
+	}
+
+	/* keep the headers aside until the whole body is in */
+	if ((cl = esl_event_get_header(handle->partial_event, "content-length"))) {
+		esl_ssize_t len = atol(cl);
+		char *body;
+
+		if ((esl_ssize_t) esl_buffer_inuse(handle->packet_buf) < len) {
+			goto end;
 		}
+
+		body = malloc(len + 1);
+		esl_assert(body);
+		esl_buffer_read(handle->packet_buf, body, len);
+		*(body + len) = '\0';
+		handle->partial_event->body = body;
 	}
 
-	esl_mutex_unlock(handle->mutex);
+	revent = handle->partial_event;
+	handle->partial_event = NULL;
 
-	return ESL_SUCCESS;
+	esl_event_safe_destroy(&handle->last_ievent);
 
- fail:
+	if ((status = parse_packet(handle, revent)) != ESL_SUCCESS) {
+		handle->connected = 0;
+	}
 
-	esl_mutex_unlock(handle->mutex);
+	*save_event = revent;
 
-	handle->connected = 0;
+ end:
 
-	return ESL_FAIL;
+	esl_mutex_unlock(handle->mutex);
 
+	return status;
 }
 
 ESL_DECLARE(esl_status_t) esl_send(esl_handle_t *handle, const char *cmd)
@@ -1462,6 +1738,8 @@ ESL_DECLARE(esl_status_t) esl_send_recv_timed(esl_handle_t *handle, const char *
 {
 	const char *hval;
 	esl_status_t status;
+	char *chunks = NULL;
+	esl_size_t chunks_len = 0;
 	
     if (!handle || !handle->connected || handle->sock == ESL_SOCK_INVALID) {
         return ESL_FAIL;
@@ -1492,6 +1770,50 @@ ESL_DECLARE(esl_status_t) esl_send_recv_timed(esl_handle_t *handle, const char *
 	if (handle->last_sr_event) {
 		char *ct = esl_event_get_header(handle->last_sr_event,"content-type");
 
+		if (ct && !strcasecmp(ct, "api/response-chunk")) {
+			const char *cl = esl_event_get_header(handle->last_sr_event, "content-length");
+			esl_size_t len = cl ? (esl_size_t) atol(cl) : 0;
+			const char *body = handle->last_sr_event->body;
+
+			if (body && len) {
+				if (handle->api_chunk_callback) {
+					handle->api_chunk_callback(body, len, handle->api_chunk_user_data);
+				} else {
+					char *tmp = realloc(chunks, chunks_len + len + 1);
+					esl_assert(tmp);
+					chunks = tmp;
+					memcpy(chunks + chunks_len, body, len);
+					chunks_len += len;
+					chunks[chunks_len] = '\0';
+				}
+			}
+
+			esl_event_safe_destroy(&handle->last_sr_event);
+			goto recv;
+		}
+
+		if (chunks && !strcasecmp(ct, "api/response")) {
+			const char *cl = esl_event_get_header(handle->last_sr_event, "content-length");
+			esl_size_t len = cl ? (esl_size_t) atol(cl) : 0;
+			char *body = realloc(chunks, chunks_len + len + 1);
+			char lenbuf[32];
+
+			esl_assert(body);
+
+			if (len && handle->last_sr_event->body) {
+				memcpy(body + chunks_len, handle->last_sr_event->body, len);
+			}
+
+			*(body + chunks_len + len) = '\0';
+			free(handle->last_sr_event->body);
+			handle->last_sr_event->body = body;
+			chunks = NULL;
+
+			snprintf(lenbuf, sizeof(lenbuf), "%lu", (unsigned long) (chunks_len + len));
+			esl_event_del_header(handle->last_sr_event, "content-length");
+			esl_event_add_header_string(handle->last_sr_event, ESL_STACK_BOTTOM, "Content-Length", lenbuf);
+		}
+
 		if (strcasecmp(ct, "api/response") && strcasecmp(ct, "command/reply")) {
 			esl_event_t *ep;
 
@@ -1511,6 +1833,7 @@ ESL_DECLARE(esl_status_t) esl_send_recv_timed(esl_handle_t *handle, const char *
 			if (!handle->connected || handle->sock == ESL_SOCK_INVALID) {
 				handle->connected = 0;
 				esl_mutex_unlock(handle->mutex);
+				esl_safe_free(chunks);
 				return ESL_FAIL;
 			}
 
@@ -1528,6 +1851,8 @@ ESL_DECLARE(esl_status_t) esl_send_recv_timed(esl_handle_t *handle, const char *
 	
 	esl_mutex_unlock(handle->mutex);
 
+	esl_safe_free(chunks);
+
 	return status;
 }
 
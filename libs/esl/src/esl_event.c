@@ -235,6 +235,26 @@ static unsigned int esl_ci_hashfunc_default(const char *char_key, esl_ssize_t *k
     return hash;
 }
 
+ESL_DECLARE(char *) esl_event_header_value(esl_event_header_t *header)
+{
+	if ((header->flags & ESL_HF_ENCODED)) {
+		esl_url_decode(header->value);
+		header->flags &= ~ESL_HF_ENCODED;
+	}
+
+	return header->value;
+}
+
+/* give a sliced header its own copies before anything changes it */
+static void header_unslice(esl_event_header_t *header)
+{
+	if ((header->flags & ESL_HF_SLICE)) {
+		header->name = DUP(header->name);
+		header->value = header->value ? DUP(esl_event_header_value(header)) : NULL;
+		header->flags = 0;
+	}
+}
+
 ESL_DECLARE(esl_event_header_t *) esl_event_get_header_ptr(esl_event_t *event, const char *header_name)
 {
 	esl_event_header_t *hp;
@@ -269,7 +289,7 @@ ESL_DECLARE(char *) esl_event_get_header_idx(esl_event_t *event, const char *hea
 			}
 		}
 
-		return hp->value;
+		return esl_event_header_value(hp);
 	} else if (!strcmp(header_name, "_body")) {
 		return event->body;
 	}		
@@ -299,7 +319,7 @@ ESL_DECLARE(esl_status_t) esl_event_del_header_val(esl_event_t *event, const cha
 		esl_assert(x < 1000000);
 		hash = esl_ci_hashfunc_default(header_name, &hlen);
 
-		if ((!hp->hash || hash == hp->hash) && (hp->name && !strcasecmp(header_name, hp->name)) && (esl_strlen_zero(val) || !strcmp(hp->value, val))) {
+		if ((!hp->hash || hash == hp->hash) && (hp->name && !strcasecmp(header_name, hp->name)) && (esl_strlen_zero(val) || !strcmp(esl_event_header_value(hp), val))) {
 			if (lp) {
 				lp->next = hp->next;
 			} else {
@@ -308,6 +328,11 @@ ESL_DECLARE(esl_status_t) esl_event_del_header_val(esl_event_t *event, const cha
 			if (hp == event->last_header || !hp->next) {
 				event->last_header = lp;
 			}
+
+			if ((hp->flags & ESL_HF_SLICE)) {
+				hp->name = hp->value = NULL;
+			}
+
 			FREE(hp->name);
 
 			if (hp->idx) {
@@ -361,6 +386,40 @@ static esl_event_header_t *new_header(const char *header_name)
 
 }
 
+ESL_DECLARE(esl_status_t) esl_event_add_header_slice(esl_event_t *event, char *name, char *value, esl_bool_t encoded)
+{
+	esl_event_header_t *header;
+	esl_ssize_t hlen = -1;
+
+#ifdef ESL_EVENT_RECYCLE
+	void *pop;
+	if (esl_queue_trypop(EVENT_HEADER_RECYCLE_QUEUE, &pop) == ESL_SUCCESS) {
+		header = (esl_event_header_t *) pop;
+	} else {
+#endif
+		header = ALLOC(sizeof(*header));
+		esl_assert(header);
+#ifdef ESL_EVENT_RECYCLE
+	}
+#endif
+
+	memset(header, 0, sizeof(*header));
+	header->name = name;
+	header->value = value;
+	header->hash = esl_ci_hashfunc_default(name, &hlen);
+	header->flags = ESL_HF_SLICE | (encoded ? ESL_HF_ENCODED : 0);
+
+	if (event->last_header) {
+		event->last_header->next = header;
+	} else {
+		event->headers = header;
+	}
+
+	event->last_header = header;
+
+	return ESL_SUCCESS;
+}
+
 ESL_DECLARE(int) esl_event_add_array(esl_event_t *event, const char *var, const char *val)
 {
 	char *data;
@@ -443,6 +502,8 @@ static esl_status_t esl_event_base_add_header(esl_event_t *event, esl_stack_t st
 		}
 		
 		if ((header = esl_event_get_header_ptr(event, header_name))) {
+
+			header_unslice(header);
 			
 			if (index_ptr) {
 				if (index > -1 && index <= 4000) {
@@ -653,6 +714,11 @@ ESL_DECLARE(void) esl_event_destroy(esl_event_t **event)
 		for (hp = ep->headers; hp;) {
 			this = hp;
 			hp = hp->next;
+
+			if ((this->flags & ESL_HF_SLICE)) {
+				this->name = this->value = NULL;
+			}
+
 			FREE(this->name);
 
 			if (this->idx) {
@@ -679,6 +745,7 @@ ESL_DECLARE(void) esl_event_destroy(esl_event_t **event)
 		}
 		FREE(ep->body);
 		FREE(ep->subclass_name);
+		FREE(ep->slab);
 #ifdef ESL_EVENT_RECYCLE
 		if (esl_queue_trypush(EVENT_RECYCLE_QUEUE, ep) != ESL_SUCCESS) {
 			FREE(ep);
@@ -705,7 +772,7 @@ ESL_DECLARE(void) esl_event_merge(esl_event_t *event, esl_event_t *tomerge)
 				esl_event_add_header_string(event, ESL_STACK_PUSH, hp->name, hp->array[i]);
 			}
 		} else {
-			esl_event_add_header_string(event, ESL_STACK_BOTTOM, hp->name, hp->value);
+			esl_event_add_header_string(event, ESL_STACK_BOTTOM, hp->name, esl_event_header_value(hp));
 		}
 	}
 }
@@ -733,7 +800,7 @@ ESL_DECLARE(esl_status_t) esl_event_dup(esl_event_t **event, esl_event_t *todup)
 				esl_event_add_header_string(*event, ESL_STACK_PUSH, hp->name, hp->array[i]);
 			}
 		} else {
-			esl_event_add_header_string(*event, ESL_STACK_BOTTOM, hp->name, hp->value);
+			esl_event_add_header_string(*event, ESL_STACK_BOTTOM, hp->name, esl_event_header_value(hp));
 		}
 	}
 
@@ -785,7 +852,7 @@ ESL_DECLARE(esl_status_t) esl_event_serialize(esl_event_t *event, char **str, es
 				new_len += (strlen(hp->array[i]) * 3) + 1;
 			}
 		} else {
-			new_len = (strlen(hp->value) * 3) + 1;
+			new_len = (strlen(esl_event_header_value(hp)) * 3) + 1;
 		}
 
 		if (encode_len < new_len) {
@@ -805,9 +872,9 @@ ESL_DECLARE(esl_status_t) esl_event_serialize(esl_event_t *event, char **str, es
 
 
 		if (encode) {
-			esl_url_encode(hp->value, encode_buf, encode_len);
+			esl_url_encode(esl_event_header_value(hp), encode_buf, encode_len);
 		} else {
-			esl_snprintf(encode_buf, encode_len, "%s", hp->value);
+			esl_snprintf(encode_buf, encode_len, "%s", esl_event_header_value(hp));
 		}
 
 
@@ -940,7 +1007,7 @@ ESL_DECLARE(esl_status_t) esl_event_serialize_json(esl_event_t *event, char **st
 			cJSON_AddItemToObject(cj, hp->name, a);
 			
 		} else {
-			cJSON_AddItemToObject(cj, hp->name, cJSON_CreateString(hp->value));
+			cJSON_AddItemToObject(cj, hp->name, cJSON_CreateString(esl_event_header_value(hp)));
 		}
 	}
 
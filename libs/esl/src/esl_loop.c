@@ -0,0 +1,701 @@
+/*
+ * Copyright (c) 2007-2012, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/* One thread, many handles.  Each connection keeps the commands it sent in order, the server answers
+   them in that order so the head of the list owns the next reply.  A bgapi moves to a second list once
+   its reply names the Job-UUID and stays there until the BACKGROUND_JOB event with that uuid arrives. */
+
+#include <esl_loop.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <errno.h>
+
+#if defined(__linux__)
+#define ESL_LOOP_EPOLL
+#include <sys/epoll.h>
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#define ESL_LOOP_KQUEUE
+#include <sys/event.h>
+#else
+#include <poll.h>
+#endif
+
+#define ESL_LOOP_MAX_EVENTS 64
+#define ESL_LOOP_READS_PER_PASS 16
+
+typedef struct esl_loop_request {
+	esl_loop_reply_callback_t callback;
+	void *user_data;
+	int bg;
+	char job_uuid[64];
+	struct esl_loop_request *next;
+} esl_loop_request_t;
+
+struct esl_loop_conn {
+	esl_loop_t *loop;
+	esl_handle_t *handle;
+	esl_loop_event_callback_t event_callback;
+	esl_loop_disconnect_callback_t disconnect_callback;
+	void *user_data;
+	char *out;
+	esl_size_t out_len;
+	esl_size_t out_pos;
+	esl_size_t out_size;
+	esl_loop_request_t *pending;
+	esl_loop_request_t *pending_tail;
+	esl_loop_request_t *jobs;
+	int writing;
+	int backlog;
+	int removed;
+	struct esl_loop_conn *next;
+	struct esl_loop_conn *dead_next;
+};
+
+struct esl_loop {
+	int fd;
+	esl_loop_conn_t *conns;
+	/* removed while the loop was running, freed when the pass ends */
+	esl_loop_conn_t *dead;
+	int count;
+	int in_run;
+#if !defined(ESL_LOOP_EPOLL) && !defined(ESL_LOOP_KQUEUE)
+	struct pollfd *pfds;
+	esl_loop_conn_t **pconns;
+	int plen;
+#endif
+};
+
+static void conn_lost(esl_loop_conn_t *conn);
+
+static int loop_watch(esl_loop_t *loop, esl_loop_conn_t *conn, int add, int write)
+{
+#if defined(ESL_LOOP_EPOLL)
+	struct epoll_event ev = { 0 };
+
+	ev.events = EPOLLIN | (write ? EPOLLOUT : 0);
+	ev.data.ptr = conn;
+
+	return epoll_ctl(loop->fd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, conn->handle->sock, &ev);
+#elif defined(ESL_LOOP_KQUEUE)
+	struct kevent ev[2];
+	int n = 0;
+
+	if (add) {
+		EV_SET(&ev[n++], conn->handle->sock, EVFILT_READ, EV_ADD, 0, 0, conn);
+	}
+
+	if (write != conn->writing) {
+		EV_SET(&ev[n++], conn->handle->sock, EVFILT_WRITE, write ? EV_ADD : EV_DELETE, 0, 0, conn);
+	}
+
+	return n ? kevent(loop->fd, ev, n, NULL, 0, NULL) : 0;
+#else
+	/* the poll set is rebuilt on every pass */
+	return 0;
+#endif
+}
+
+static void loop_unwatch(esl_loop_t *loop, esl_loop_conn_t *conn)
+{
+#if defined(ESL_LOOP_EPOLL)
+	struct epoll_event ev = { 0 };
+
+	epoll_ctl(loop->fd, EPOLL_CTL_DEL, conn->handle->sock, &ev);
+#elif defined(ESL_LOOP_KQUEUE)
+	struct kevent ev[2];
+	int n = 0;
+
+	EV_SET(&ev[n++], conn->handle->sock, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+	if (conn->writing) {
+		EV_SET(&ev[n++], conn->handle->sock, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+	}
+
+	kevent(loop->fd, ev, n, NULL, 0, NULL);
+#endif
+}
+
+static void set_nonblock(esl_socket_t sock, int on)
+{
+	int flags = fcntl(sock, F_GETFL, 0);
+
+	if (flags != -1) {
+		fcntl(sock, F_SETFL, on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK));
+	}
+}
+
+static void free_requests(esl_loop_conn_t *conn, esl_loop_request_t **list)
+{
+	esl_loop_request_t *req;
+
+	while ((req = *list)) {
+		*list = req->next;
+
+		if (req->callback) {
+			req->callback(conn, NULL, req->user_data);
+		}
+
+		free(req);
+	}
+}
+
+static void free_conn(esl_loop_conn_t *conn)
+{
+	esl_safe_free(conn->out);
+	free(conn);
+}
+
+static esl_status_t conn_flush(esl_loop_conn_t *conn)
+{
+	esl_handle_t *handle = conn->handle;
+	int want;
+
+	while (conn->out_pos < conn->out_len) {
+		esl_ssize_t r = send(handle->sock, conn->out + conn->out_pos, conn->out_len - conn->out_pos, 0);
+
+		if (r > 0) {
+			conn->out_pos += r;
+		} else if (r < 0 && errno == EINTR) {
+			continue;
+		} else if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		} else {
+			handle->errnum = errno;
+			strerror_r(handle->errnum, handle->err, sizeof(handle->err));
+			conn_lost(conn);
+			return ESL_FAIL;
+		}
+	}
+
+	if (conn->out_pos == conn->out_len) {
+		conn->out_pos = conn->out_len = 0;
+	}
+
+	want = conn->out_pos < conn->out_len;
+
+	if (want != conn->writing) {
+		loop_watch(conn->loop, conn, 0, want);
+		conn->writing = want;
+	}
+
+	return ESL_SUCCESS;
+}
+
+static void conn_packet(esl_loop_conn_t *conn, esl_event_t *revent)
+{
+	esl_handle_t *handle = conn->handle;
+	const char *ct = esl_event_get_header(revent, "content-type");
+	esl_loop_request_t *req, **lp;
+
+	if (!esl_safe_strcasecmp(ct, "command/reply") || !esl_safe_strcasecmp(ct, "api/response")) {
+		if (!(req = conn->pending)) {
+			esl_log(ESL_LOG_WARNING, "Reply with no command waiting for it\n");
+			return;
+		}
+
+		if (!(conn->pending = req->next)) {
+			conn->pending_tail = NULL;
+		}
+
+		if (req->bg) {
+			const char *uuid = esl_event_get_header(revent, "job-uuid");
+			const char *text = esl_event_get_header(revent, "reply-text");
+
+			if (!esl_strlen_zero(uuid) && text && !strncmp(text, "+OK", 3)) {
+				snprintf(req->job_uuid, sizeof(req->job_uuid), "%s", uuid);
+				req->next = conn->jobs;
+				conn->jobs = req;
+				return;
+			}
+		}
+
+		if (req->callback) {
+			req->callback(conn, revent, req->user_data);
+		}
+
+		free(req);
+		return;
+	}
+
+	if (ct && !strncasecmp(ct, "text/event-", 11)) {
+		esl_event_t *event = handle->last_ievent;
+		const char *name, *uuid;
+
+		if (!event) {
+			return;
+		}
+
+		if ((name = esl_event_get_header(event, "event-name")) && !strcasecmp(name, "BACKGROUND_JOB") &&
+			(uuid = esl_event_get_header(event, "job-uuid"))) {
+			for (lp = &conn->jobs; (req = *lp); lp = &req->next) {
+				if (!strcmp(req->job_uuid, uuid)) {
+					*lp = req->next;
+
+					if (req->callback) {
+						req->callback(conn, event, req->user_data);
+					}
+
+					free(req);
+					return;
+				}
+			}
+		}
+
+		if (conn->event_callback) {
+			conn->event_callback(conn, event, conn->user_data);
+		}
+
+		return;
+	}
+
+	/* log/data, a lingering disconnect notice or anything else the server pushes */
+	if (conn->event_callback) {
+		conn->event_callback(conn, revent, conn->user_data);
+	}
+}
+
+static void conn_dispatch(esl_loop_conn_t *conn)
+{
+	esl_event_t *revent;
+	esl_status_t status;
+
+	conn->backlog = 0;
+
+	while (!conn->removed && (status = esl_recv_buffered_event(conn->handle, &revent)) != ESL_BREAK) {
+		if (revent) {
+			conn_packet(conn, revent);
+			esl_event_destroy(&revent);
+		}
+
+		if (status != ESL_SUCCESS) {
+			conn_lost(conn);
+			break;
+		}
+	}
+}
+
+static void conn_read(esl_loop_conn_t *conn)
+{
+	esl_handle_t *handle = conn->handle;
+	int i;
+
+	for (i = 0; i < ESL_LOOP_READS_PER_PASS; i++) {
+		esl_ssize_t r = recv(handle->sock, handle->socket_buf, sizeof(handle->socket_buf) - 1, 0);
+
+		if (r > 0) {
+			esl_buffer_write(handle->packet_buf, handle->socket_buf, r);
+			if (r < (esl_ssize_t) sizeof(handle->socket_buf) - 1) {
+				break;
+			}
+		} else if (r < 0 && errno == EINTR) {
+			continue;
+		} else if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			break;
+		} else {
+			if (r < 0) {
+				handle->errnum = errno;
+				strerror_r(handle->errnum, handle->err, sizeof(handle->err));
+			}
+			conn_dispatch(conn);
+			conn_lost(conn);
+			return;
+		}
+	}
+
+	conn_dispatch(conn);
+}
+
+static void conn_lost(esl_loop_conn_t *conn)
+{
+	if (conn->removed) {
+		return;
+	}
+
+	conn->handle->connected = 0;
+
+	if (conn->disconnect_callback) {
+		conn->disconnect_callback(conn, conn->user_data);
+	}
+
+	esl_loop_remove(conn);
+}
+
+ESL_DECLARE(esl_status_t) esl_loop_create(esl_loop_t **loop)
+{
+	esl_loop_t *new_loop;
+
+	if (!(new_loop = calloc(1, sizeof(*new_loop)))) {
+		return ESL_FAIL;
+	}
+
+#if defined(ESL_LOOP_EPOLL)
+	new_loop->fd = epoll_create(ESL_LOOP_MAX_EVENTS);
+#elif defined(ESL_LOOP_KQUEUE)
+	new_loop->fd = kqueue();
+#else
+	new_loop->fd = 0;
+#endif
+
+	if (new_loop->fd < 0) {
+		esl_log(ESL_LOG_ERROR, "Cannot create event loop: %s\n", strerror(errno));
+		free(new_loop);
+		return ESL_FAIL;
+	}
+
+	*loop = new_loop;
+
+	return ESL_SUCCESS;
+}
+
+ESL_DECLARE(void) esl_loop_destroy(esl_loop_t **loop)
+{
+	esl_loop_t *lp = *loop;
+	esl_loop_conn_t *conn;
+
+	if (!lp) {
+		return;
+	}
+
+	*loop = NULL;
+
+	while ((conn = lp->conns)) {
+		esl_loop_remove(conn);
+	}
+
+	while ((conn = lp->dead)) {
+		lp->dead = conn->dead_next;
+		free_conn(conn);
+	}
+
+#if defined(ESL_LOOP_EPOLL) || defined(ESL_LOOP_KQUEUE)
+	close(lp->fd);
+#else
+	esl_safe_free(lp->pfds);
+	esl_safe_free(lp->pconns);
+#endif
+
+	free(lp);
+}
+
+ESL_DECLARE(esl_status_t) esl_loop_add(esl_loop_t *loop, esl_handle_t *handle, esl_loop_event_callback_t event_callback,
+									   esl_loop_disconnect_callback_t disconnect_callback, void *user_data, esl_loop_conn_t **conn)
+{
+	esl_loop_conn_t *new_conn;
+
+	if (!handle || !handle->connected || handle->sock == ESL_SOCK_INVALID) {
+		return ESL_FAIL;
+	}
+
+	if (!(new_conn = calloc(1, sizeof(*new_conn)))) {
+		return ESL_FAIL;
+	}
+
+	new_conn->loop = loop;
+	new_conn->handle = handle;
+	new_conn->event_callback = event_callback;
+	new_conn->disconnect_callback = disconnect_callback;
+	new_conn->user_data = user_data;
+
+	set_nonblock(handle->sock, 1);
+
+	if (loop_watch(loop, new_conn, 1, 0)) {
+		esl_log(ESL_LOG_ERROR, "Cannot watch socket: %s\n", strerror(errno));
+		set_nonblock(handle->sock, 0);
+		free(new_conn);
+		return ESL_FAIL;
+	}
+
+	/* whatever connect read past the auth reply is handled on the next pass */
+	if (esl_buffer_inuse(handle->packet_buf)) {
+		new_conn->backlog = 1;
+	}
+
+	new_conn->next = loop->conns;
+	loop->conns = new_conn;
+	loop->count++;
+
+	if (conn) {
+		*conn = new_conn;
+	}
+
+	return ESL_SUCCESS;
+}
+
+ESL_DECLARE(void) esl_loop_remove(esl_loop_conn_t *conn)
+{
+	esl_loop_t *loop = conn->loop;
+	esl_loop_conn_t **lp;
+
+	if (conn->removed) {
+		return;
+	}
+
+	conn->removed = 1;
+
+	for (lp = &loop->conns; *lp; lp = &(*lp)->next) {
+		if (*lp == conn) {
+			*lp = conn->next;
+			loop->count--;
+			break;
+		}
+	}
+
+	/* the handle may already have been disconnected from the disconnect callback */
+	if (conn->handle->sock != ESL_SOCK_INVALID) {
+		loop_unwatch(loop, conn);
+		set_nonblock(conn->handle->sock, 0);
+	}
+
+	free_requests(conn, &conn->pending);
+	conn->pending_tail = NULL;
+	free_requests(conn, &conn->jobs);
+
+	if (loop->in_run) {
+		conn->dead_next = loop->dead;
+		loop->dead = conn;
+	} else {
+		free_conn(conn);
+	}
+}
+
+ESL_DECLARE(esl_status_t) esl_loop_send(esl_loop_conn_t *conn, const char *cmd, esl_loop_reply_callback_t callback, void *user_data)
+{
+	esl_loop_request_t *req;
+	esl_size_t len = strlen(cmd), need;
+	int terminate;
+
+	if (conn->removed || !conn->handle->connected || !len) {
+		return ESL_FAIL;
+	}
+
+	/* same rule as esl_send */
+	terminate = !(len > 1 && cmd[len - 1] == '\n' && cmd[len - 2] == '\n');
+	need = conn->out_len + len + (terminate ? 2 : 0);
+
+	if (need > conn->out_size) {
+		esl_size_t size = conn->out_size ? conn->out_size : 4096;
+		char *tmp;
+
+		while (size < need) {
+			size *= 2;
+		}
+
+		if (!(tmp = realloc(conn->out, size))) {
+			return ESL_FAIL;
+		}
+
+		conn->out = tmp;
+		conn->out_size = size;
+	}
+
+	if (!(req = calloc(1, sizeof(*req)))) {
+		return ESL_FAIL;
+	}
+
+	req->callback = callback;
+	req->user_data = user_data;
+	req->bg = !strncasecmp(cmd, "bgapi ", 6);
+
+	if (conn->pending_tail) {
+		conn->pending_tail->next = req;
+	} else {
+		conn->pending = req;
+	}
+	conn->pending_tail = req;
+
+	esl_log(ESL_LOG_DEBUG, "SEND\n%s\n", cmd);
+
+	memcpy(conn->out + conn->out_len, cmd, len);
+	conn->out_len += len;
+
+	if (terminate) {
+		memcpy(conn->out + conn->out_len, "\n\n", 2);
+		conn->out_len += 2;
+	}
+
+	return conn_flush(conn);
+}
+
+ESL_DECLARE(esl_status_t) esl_loop_bgapi(esl_loop_conn_t *conn, const char *cmd, const char *arg, esl_loop_reply_callback_t callback, void *user_data)
+{
+	esl_size_t len = strlen(cmd) + (arg ? strlen(arg) : 0) + 16;
+	esl_status_t status;
+	char *buf;
+
+	if (!(buf = malloc(len))) {
+		return ESL_FAIL;
+	}
+
+	snprintf(buf, len, "bgapi %s%s%s", cmd, arg ? " " : "", arg ? arg : "");
+	status = esl_loop_send(conn, buf, callback, user_data);
+	free(buf);
+
+	return status;
+}
+
+ESL_DECLARE(esl_status_t) esl_loop_run(esl_loop_t *loop, uint32_t ms)
+{
+	esl_loop_conn_t *conn;
+	int n, i, handled = 0;
+#if defined(ESL_LOOP_EPOLL)
+	struct epoll_event evs[ESL_LOOP_MAX_EVENTS];
+#elif defined(ESL_LOOP_KQUEUE)
+	struct kevent evs[ESL_LOOP_MAX_EVENTS];
+	struct timespec ts;
+#endif
+
+	loop->in_run = 1;
+
+	for (conn = loop->conns; conn; conn = conn->next) {
+		if (conn->backlog) {
+			handled++;
+		}
+	}
+
+	if (handled) {
+		esl_loop_conn_t *next;
+
+		for (conn = loop->conns; conn; conn = next) {
+			next = conn->next;
+			if (conn->backlog) {
+				conn_dispatch(conn);
+			}
+		}
+		ms = 0;
+	}
+
+#if defined(ESL_LOOP_EPOLL)
+	n = epoll_wait(loop->fd, evs, ESL_LOOP_MAX_EVENTS, ms);
+
+	for (i = 0; i < n; i++) {
+		conn = evs[i].data.ptr;
+
+		if (!conn->removed && (evs[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))) {
+			conn_read(conn);
+		}
+
+		if (!conn->removed && (evs[i].events & EPOLLOUT)) {
+			conn_flush(conn);
+		}
+	}
+#elif defined(ESL_LOOP_KQUEUE)
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000;
+	n = kevent(loop->fd, NULL, 0, evs, ESL_LOOP_MAX_EVENTS, &ts);
+
+	for (i = 0; i < n; i++) {
+		conn = evs[i].udata;
+
+		if (conn->removed) {
+			continue;
+		}
+
+		if (evs[i].filter == EVFILT_READ) {
+			conn_read(conn);
+		} else if (evs[i].filter == EVFILT_WRITE) {
+			conn_flush(conn);
+		}
+	}
+#else
+	if (loop->plen < loop->count) {
+		loop->plen = loop->count + 16;
+		loop->pfds = realloc(loop->pfds, loop->plen * sizeof(*loop->pfds));
+		loop->pconns = realloc(loop->pconns, loop->plen * sizeof(*loop->pconns));
+		esl_assert(loop->pfds && loop->pconns);
+	}
+
+	for (i = 0, conn = loop->conns; conn; conn = conn->next, i++) {
+		loop->pfds[i].fd = conn->handle->sock;
+		loop->pfds[i].events = POLLIN | (conn->out_pos < conn->out_len ? POLLOUT : 0);
+		loop->pfds[i].revents = 0;
+		loop->pconns[i] = conn;
+	}
+
+	if ((n = poll(loop->pfds, i, ms)) > 0) {
+		int count = i;
+
+		for (i = 0; i < count; i++) {
+			conn = loop->pconns[i];
+
+			if (!conn->removed && (loop->pfds[i].revents & (POLLIN | POLLERR | POLLHUP))) {
+				conn_read(conn);
+			}
+
+			if (!conn->removed && (loop->pfds[i].revents & POLLOUT)) {
+				conn_flush(conn);
+			}
+		}
+	}
+#endif
+
+	loop->in_run = 0;
+
+	while ((conn = loop->dead)) {
+		loop->dead = conn->dead_next;
+		free_conn(conn);
+	}
+
+	if (n < 0) {
+		return errno == EINTR ? ESL_BREAK : ESL_FAIL;
+	}
+
+	return (n > 0 || handled) ? ESL_SUCCESS : ESL_BREAK;
+}
+
+ESL_DECLARE(esl_handle_t *) esl_loop_conn_handle(esl_loop_conn_t *conn)
+{
+	return conn->handle;
+}
+
+ESL_DECLARE(void *) esl_loop_conn_user_data(esl_loop_conn_t *conn)
+{
+	return conn->user_data;
+}
+
+ESL_DECLARE(int) esl_loop_count(esl_loop_t *loop)
+{
+	return loop->count;
+}
+
+#endif /* !WIN32 */
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
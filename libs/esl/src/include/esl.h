@@ -56,7 +56,8 @@ typedef enum {
 typedef enum {
 	ESL_EVENT_TYPE_PLAIN,
 	ESL_EVENT_TYPE_XML,
-	ESL_EVENT_TYPE_JSON
+	ESL_EVENT_TYPE_JSON,
+	ESL_EVENT_TYPE_BINARY
 } esl_event_type_t;
 
 #ifdef WIN32
@@ -283,6 +284,9 @@ typedef enum {
 #include <esl_threadmutex.h>
 #include <esl_buffer.h>
 
+/*! \brief Receives one piece of an api reply sent with chunked_response: true */
+typedef void (*esl_api_chunk_callback_t)(const char *data, esl_size_t len, void *user_data);
+
 /*! \brief A handle that will hold the socket information and
            different events received. */
 typedef struct {
@@ -319,6 +323,18 @@ typedef struct {
 	int async_execute;
 	int event_lock;
 	int destroyed;
+	/*! Header names the server interned for text/event-binary on this connection. Used only internally. */
+	char **bin_names;
+	uint32_t bin_names_len;
+	/*! Headers of a packet whose body has not all arrived yet, see esl_recv_buffered_event. Used only internally. */
+	esl_event_t *partial_event;
+	/*! Received events keep their headers in one block with values URL-decoded on first access instead of a copy of each.
+	    Read values through esl_event_get_header or esl_event_header_value. */
+	int lazy_parse;
+	/*! Called by esl_send_recv with each api/response-chunk of a chunked api reply as it arrives.
+	    When unset the pieces are joined in front of the body of last_sr_event instead. */
+	esl_api_chunk_callback_t api_chunk_callback;
+	void *api_chunk_user_data;
 } esl_handle_t;
 
 #define esl_test_flag(obj, flag) ((obj)->flags & flag)
@@ -455,6 +471,13 @@ ESL_DECLARE(esl_status_t) esl_recv_event(esl_handle_t *handle, int check_q, esl_
     \param[out] save_event If this is not NULL, will return the event received
 */
 ESL_DECLARE(esl_status_t) esl_recv_event_timed(esl_handle_t *handle, uint32_t ms, int check_q, esl_event_t **save_event);
+/*!
+    \brief Take the next packet out of data already read into handle->packet_buf, the socket is not touched
+    \param handle Handle to receive from
+    \param save_event The packet, the caller destroys it, an event body is parsed into handle->last_ievent
+    \return ESL_SUCCESS with a packet, ESL_BREAK when more data is needed, ESL_FAIL with the packet on a disconnect notice
+*/
+ESL_DECLARE(esl_status_t) esl_recv_buffered_event(esl_handle_t *handle, esl_event_t **save_event);
 /*!
     \brief This will send a command and place its response event on handle->last_sr_event and handle->last_sr_reply
     \param handle Handle to be used
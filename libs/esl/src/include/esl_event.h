@@ -150,6 +150,8 @@ typedef enum {
 	/*! hash of the header name */
 	unsigned long hash;
 	struct esl_event_header *next;
+	/*! ESL_HF_ flags, read the value with esl_event_header_value when they may be set */
+	int flags;
 };
 
 
@@ -177,12 +179,21 @@ struct esl_event {
 	unsigned long key;
 	struct esl_event *next;
 	int flags;
+	/*! block the names and values of sliced headers point into */
+	char *slab;
 };
 
 typedef enum {
 	ESL_EF_UNIQ_HEADERS = (1 << 0)
 } esl_event_flag_t;
 
+typedef enum {
+	/*! name and value point into the event's slab and are not freed with the header */
+	ESL_HF_SLICE = (1 << 0),
+	/*! the value is still URL-encoded, it is decoded in place on first access */
+	ESL_HF_ENCODED = (1 << 1)
+} esl_event_header_flag_t;
+
 
 #define ESL_EVENT_SUBCLASS_ANY NULL
 
@@ -215,6 +226,21 @@ ESL_DECLARE(esl_event_header_t *) esl_event_get_header_ptr(esl_event_t *event, c
 ESL_DECLARE(char *) esl_event_get_header_idx(esl_event_t *event, const char *header_name, int idx);
 #define esl_event_get_header(_e, _h) esl_event_get_header_idx(_e, _h, -1)
 
+/*!
+  \brief The value of a header, decoding it first when it is still URL-encoded
+  \param header the header, e.g. while walking event->headers
+*/
+ESL_DECLARE(char *) esl_event_header_value(esl_event_header_t *header);
+
+/*!
+  \brief Add a header that points into event->slab instead of owning copies, always at the bottom
+  \param event the event, its slab holds name and value
+  \param name the header name
+  \param value the header value
+  \param encoded the value is still URL-encoded
+*/
+ESL_DECLARE(esl_status_t) esl_event_add_header_slice(esl_event_t *event, char *name, char *value, esl_bool_t encoded);
+
 /*!
   \brief Retrieve the body value from an event
   \param event the event to read the body from
@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2007-2012, Anthony Minessale II
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * * Neither the name of the original author; nor the names of any contributors
+ * may be used to endorse or promote products derived from this software
+ * without specific prior written permission.
+ *
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER
+ * OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _ESL_LOOP_H_
+#define _ESL_LOOP_H_
+
+#include "esl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* defined(__cplusplus) */
+
+/**
+ * @defgroup esl_loop Event Loop
+ * Drive many connected handles from one thread.  The loop owns the socket of each handle it is given:
+ * the socket is made non blocking, commands are queued with esl_loop_send and their replies come back
+ * to a callback in the order they were sent, events go to the connection's event callback.
+ * Nothing here is thread safe, call everything from the thread that runs esl_loop_run.
+ * @{
+ */
+
+typedef struct esl_loop esl_loop_t;
+typedef struct esl_loop_conn esl_loop_conn_t;
+
+/*! \brief An event, log line or lingering disconnect notice, the event is only valid during the call */
+typedef void (*esl_loop_event_callback_t)(esl_loop_conn_t *conn, esl_event_t *event, void *user_data);
+
+/*! \brief The reply to a command, or the BACKGROUND_JOB event for a bgapi, NULL when the connection went away first */
+typedef void (*esl_loop_reply_callback_t)(esl_loop_conn_t *conn, esl_event_t *reply, void *user_data);
+
+/*! \brief The connection was lost, it is removed from the loop on return and the handle is left to the caller to esl_disconnect */
+typedef void (*esl_loop_disconnect_callback_t)(esl_loop_conn_t *conn, void *user_data);
+
+/*!
+    \brief Create a loop, epoll or kqueue where available and poll otherwise
+    \param loop The new loop
+*/
+ESL_DECLARE(esl_status_t) esl_loop_create(esl_loop_t **loop);
+
+/*!
+    \brief Destroy a loop, connections still on it are removed as by esl_loop_remove
+    \param loop The loop
+*/
+ESL_DECLARE(void) esl_loop_destroy(esl_loop_t **loop);
+
+/*!
+    \brief Put a connected and authenticated handle on a loop
+    \param loop The loop
+    \param handle A handle from esl_connect or esl_attach_handle, it must not be used directly while it is on the loop
+    \param event_callback Called for events, may be NULL
+    \param disconnect_callback Called once when the connection is lost, may be NULL
+    \param user_data Passed to the callbacks
+    \param[out] conn Optional, the connection
+*/
+ESL_DECLARE(esl_status_t) esl_loop_add(esl_loop_t *loop, esl_handle_t *handle, esl_loop_event_callback_t event_callback,
+									   esl_loop_disconnect_callback_t disconnect_callback, void *user_data, esl_loop_conn_t **conn);
+
+/*!
+    \brief Take a connection off its loop, the socket goes back to blocking and outstanding replies get a NULL callback
+    \param conn The connection, freed now or, from a callback, when the loop pass ends
+*/
+ESL_DECLARE(void) esl_loop_remove(esl_loop_conn_t *conn);
+
+/*!
+    \brief Queue a command, the terminating blank line is added when missing
+    \param conn The connection
+    \param cmd The command, e.g. "api status" or "event plain BACKGROUND_JOB CHANNEL_HANGUP"
+    \param callback Called with the command/reply or api/response, may be NULL
+    \param user_data Passed to callback
+*/
+ESL_DECLARE(esl_status_t) esl_loop_send(esl_loop_conn_t *conn, const char *cmd, esl_loop_reply_callback_t callback, void *user_data);
+
+/*!
+    \brief Run a command in the background and get its result
+    \param conn The connection, it must be subscribed to BACKGROUND_JOB events
+    \param cmd The api command
+    \param arg Its arguments, may be NULL
+    \param callback Called with the BACKGROUND_JOB event matched by Job-UUID, or with the reply when the job was refused
+    \param user_data Passed to callback
+*/
+ESL_DECLARE(esl_status_t) esl_loop_bgapi(esl_loop_conn_t *conn, const char *cmd, const char *arg, esl_loop_reply_callback_t callback, void *user_data);
+
+/*!
+    \brief Wait for activity on the loop's connections and handle it
+    \param loop The loop
+    \param ms The longest to wait, 0 to only handle what is ready
+    \return ESL_SUCCESS when something was handled, ESL_BREAK on a timeout, ESL_FAIL on an error
+*/
+ESL_DECLARE(esl_status_t) esl_loop_run(esl_loop_t *loop, uint32_t ms);
+
+/*! \brief The handle of a connection */
+ESL_DECLARE(esl_handle_t *) esl_loop_conn_handle(esl_loop_conn_t *conn);
+
+/*! \brief The user_data given to esl_loop_add */
+ESL_DECLARE(void *) esl_loop_conn_user_data(esl_loop_conn_t *conn);
+
+/*! \brief Number of connections on a loop */
+ESL_DECLARE(int) esl_loop_count(esl_loop_t *loop);
+
+/** @} */
+
+#ifdef __cplusplus
+}
+#endif /* defined(__cplusplus) */
+
+#endif /* defined(_ESL_LOOP_H_) */
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
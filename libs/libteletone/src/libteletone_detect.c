@@ -100,12 +100,19 @@
 #include <time.h>
 #include <fcntl.h>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define TELETONE_SSE
+#endif
+
 #define LOW_ENG 10000000
 #define ZC 2
-static teletone_detection_descriptor_t dtmf_detect_row[GRID_FACTOR];
-static teletone_detection_descriptor_t dtmf_detect_col[GRID_FACTOR];
-static teletone_detection_descriptor_t dtmf_detect_row_2nd[GRID_FACTOR];
-static teletone_detection_descriptor_t dtmf_detect_col_2nd[GRID_FACTOR];
+
+/* where each filter lives in the bank */
+#define ROW(i) (i)
+#define COL(i) (GRID_FACTOR + (i))
+#define ROW_2ND(i) (GRID_FACTOR * 2 + (i))
+#define COL_2ND(i) (GRID_FACTOR * 3 + (i))
 
 static float dtmf_row[] = {697.0f,	770.0f,	 852.0f,  941.0f};
 static float dtmf_col[] = {1209.0f, 1336.0f, 1477.0f, 1633.0f};
@@ -135,6 +142,60 @@ TELETONE_API(void) teletone_goertzel_update(teletone_goertzel_state_t *goertzel_
 #endif
 
 #define teletone_goertzel_result(gs) (double)(((gs)->v3 * (gs)->v3 + (gs)->v2 * (gs)->v2 - (gs)->v2 * (gs)->v3 * (gs)->fac))
+#define teletone_goertzel_bank_result(b, i) (double)(((b)->v3[i] * (b)->v3[i] + (b)->v2[i] * (b)->v2[i] - (b)->v2[i] * (b)->v3[i] * (b)->fac[i]))
+
+static void goertzel_bank_reset(teletone_goertzel_bank_t *bank)
+{
+	memset(bank->v2, 0, sizeof(bank->v2));
+	memset(bank->v3, 0, sizeof(bank->v3));
+}
+
+/* step every DTMF filter through the samples at once, the state stays in registers for the whole buffer */
+static void goertzel_bank_update(teletone_goertzel_bank_t *bank, int16_t sample_buffer[], int samples, float *energy)
+{
+	float famp, e = *energy;
+	int j, x;
+#ifdef TELETONE_SSE
+	__m128 fac[TELETONE_DTMF_FILTERS / 4], v2[TELETONE_DTMF_FILTERS / 4], v3[TELETONE_DTMF_FILTERS / 4], v1, amp;
+
+	for (x = 0; x < TELETONE_DTMF_FILTERS / 4; x++) {
+		fac[x] = _mm_loadu_ps(&bank->fac[x * 4]);
+		v2[x] = _mm_loadu_ps(&bank->v2[x * 4]);
+		v3[x] = _mm_loadu_ps(&bank->v3[x * 4]);
+	}
+
+	for (j = 0; j < samples; j++) {
+		famp = sample_buffer[j];
+		e += famp*famp;
+		amp = _mm_set1_ps(famp);
+
+		for (x = 0; x < TELETONE_DTMF_FILTERS / 4; x++) {
+			v1 = v2[x];
+			v2[x] = v3[x];
+			v3[x] = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(fac[x], v2[x]), v1), amp);
+		}
+	}
+
+	for (x = 0; x < TELETONE_DTMF_FILTERS / 4; x++) {
+		_mm_storeu_ps(&bank->v2[x * 4], v2[x]);
+		_mm_storeu_ps(&bank->v3[x * 4], v3[x]);
+	}
+#else
+	float v1;
+
+	for (j = 0; j < samples; j++) {
+		famp = sample_buffer[j];
+		e += famp*famp;
+
+		for (x = 0; x < TELETONE_DTMF_FILTERS; x++) {
+			v1 = bank->v2[x];
+			bank->v2[x] = bank->v3[x];
+			bank->v3[x] = bank->fac[x] * bank->v2[x] - v1 + famp;
+		}
+	}
+#endif
+	*energy = e;
+}
 
 TELETONE_API(void) teletone_dtmf_detect_init (teletone_dtmf_detect_state_t *dtmf_detect_state, int sample_rate)
 {
@@ -143,26 +204,23 @@ TELETONE_API(void) teletone_dtmf_detect_init (teletone_dtmf_detect_state_t *dtmf
 
 	dtmf_detect_state->hit1 = dtmf_detect_state->hit2 = 0;
 
+	/* the coefficients live in the state so detectors running at different rates don't clobber each other */
 	for (i = 0;	 i < GRID_FACTOR;  i++) {
 		theta = (float)(M_TWO_PI*(dtmf_row[i]/(float)sample_rate));
-		dtmf_detect_row[i].fac = (float)(2.0*cos(theta));
+		dtmf_detect_state->bank.fac[ROW(i)] = (float)(2.0*cos(theta));
 
 		theta = (float)(M_TWO_PI*(dtmf_col[i]/(float)sample_rate));
-		dtmf_detect_col[i].fac = (float)(2.0*cos(theta));
+		dtmf_detect_state->bank.fac[COL(i)] = (float)(2.0*cos(theta));
 	
 		theta = (float)(M_TWO_PI*(dtmf_row[i]*2.0/(float)sample_rate));
-		dtmf_detect_row_2nd[i].fac = (float)(2.0*cos(theta));
+		dtmf_detect_state->bank.fac[ROW_2ND(i)] = (float)(2.0*cos(theta));
 
 		theta = (float)(M_TWO_PI*(dtmf_col[i]*2.0/(float)sample_rate));
-		dtmf_detect_col_2nd[i].fac = (float)(2.0*cos(theta));
-	
-		goertzel_init (&dtmf_detect_state->row_out[i], &dtmf_detect_row[i]);
-		goertzel_init (&dtmf_detect_state->col_out[i], &dtmf_detect_col[i]);
-		goertzel_init (&dtmf_detect_state->row_out2nd[i], &dtmf_detect_row_2nd[i]);
-		goertzel_init (&dtmf_detect_state->col_out2nd[i], &dtmf_detect_col_2nd[i]);
-	
-		dtmf_detect_state->energy = 0.0;
+		dtmf_detect_state->bank.fac[COL_2ND(i)] = (float)(2.0*cos(theta));
 	}
+
+	goertzel_bank_reset(&dtmf_detect_state->bank);
+	dtmf_detect_state->energy = 0.0;
 	dtmf_detect_state->current_sample = 0;
 	dtmf_detect_state->detected_digits = 0;
 	dtmf_detect_state->lost_digits = 0;
@@ -306,10 +364,8 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 {
 	float row_energy[GRID_FACTOR];
 	float col_energy[GRID_FACTOR];
-	float famp;
-	float v1;
+	teletone_goertzel_bank_t *bank = &dtmf_detect_state->bank;
 	int i;
-	int j;
 	int sample;
 	int best_row;
 	int best_col;
@@ -326,43 +382,14 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 			limit = samples;
 		}
 
-		for (j = sample;  j < limit;  j++) {
-			int x = 0;
-			famp = sample_buffer[j];
-			
-			dtmf_detect_state->energy += famp*famp;
-
-			for(x = 0; x < GRID_FACTOR; x++) {
-				v1 = dtmf_detect_state->row_out[x].v2;
-				dtmf_detect_state->row_out[x].v2 = dtmf_detect_state->row_out[x].v3;
-				dtmf_detect_state->row_out[x].v3 = (float)(dtmf_detect_state->row_out[x].fac*dtmf_detect_state->row_out[x].v2 - v1 + famp);
-	
-				v1 = dtmf_detect_state->col_out[x].v2;
-				dtmf_detect_state->col_out[x].v2 = dtmf_detect_state->col_out[x].v3;
-				dtmf_detect_state->col_out[x].v3 = (float)(dtmf_detect_state->col_out[x].fac*dtmf_detect_state->col_out[x].v2 - v1 + famp);
-
-				v1 = dtmf_detect_state->col_out2nd[x].v2;
-				dtmf_detect_state->col_out2nd[x].v2 = dtmf_detect_state->col_out2nd[x].v3;
-				dtmf_detect_state->col_out2nd[x].v3 = (float)(dtmf_detect_state->col_out2nd[x].fac*dtmf_detect_state->col_out2nd[x].v2 - v1 + famp);
-		
-				v1 = dtmf_detect_state->row_out2nd[x].v2;
-				dtmf_detect_state->row_out2nd[x].v2 = dtmf_detect_state->row_out2nd[x].v3;
-				dtmf_detect_state->row_out2nd[x].v3 = (float)(dtmf_detect_state->row_out2nd[x].fac*dtmf_detect_state->row_out2nd[x].v2 - v1 + famp);
-			}
-
-		}
+		goertzel_bank_update(bank, &sample_buffer[sample], limit - sample, &dtmf_detect_state->energy);
 
 		if (dtmf_detect_state->zc > 0) {
 			if (dtmf_detect_state->energy < LOW_ENG && dtmf_detect_state->lenergy < LOW_ENG) {
 				if (!--dtmf_detect_state->zc) {
 					/* Reinitialise the detector for the next block */
 					dtmf_detect_state->hit1 = dtmf_detect_state->hit2 = 0;
-					for (i = 0;	 i < GRID_FACTOR;  i++) {
-						goertzel_init (&dtmf_detect_state->row_out[i], &dtmf_detect_row[i]);
-						goertzel_init (&dtmf_detect_state->col_out[i], &dtmf_detect_col[i]);
-						goertzel_init (&dtmf_detect_state->row_out2nd[i], &dtmf_detect_row_2nd[i]);
-						goertzel_init (&dtmf_detect_state->col_out2nd[i], &dtmf_detect_col_2nd[i]);
-					}
+					goertzel_bank_reset(bank);
 					dtmf_detect_state->dur -= samples;
 					return TT_HIT_END;
 				}
@@ -384,15 +411,15 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 		}
 		/* We are at the end of a DTMF detection block */
 		/* Find the peak row and the peak column */
-		row_energy[0] = teletone_goertzel_result (&dtmf_detect_state->row_out[0]);
-		col_energy[0] = teletone_goertzel_result (&dtmf_detect_state->col_out[0]);
+		row_energy[0] = teletone_goertzel_bank_result (bank, ROW(0));
+		col_energy[0] = teletone_goertzel_bank_result (bank, COL(0));
 
 		for (best_row = best_col = 0, i = 1;  i < GRID_FACTOR;	i++) {
-			row_energy[i] = teletone_goertzel_result (&dtmf_detect_state->row_out[i]);
+			row_energy[i] = teletone_goertzel_bank_result (bank, ROW(i));
 			if (row_energy[i] > row_energy[best_row]) {
 				best_row = i;
 			}
-			col_energy[i] = teletone_goertzel_result (&dtmf_detect_state->col_out[i]);
+			col_energy[i] = teletone_goertzel_bank_result (bank, COL(i));
 			if (col_energy[i] > col_energy[best_col]) {
 				best_col = i;
 			}
@@ -412,8 +439,8 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 			}
 			/* ... and second harmonic test */
 			if (i >= GRID_FACTOR && (row_energy[best_row] + col_energy[best_col]) > 42.0*dtmf_detect_state->energy &&
-				teletone_goertzel_result (&dtmf_detect_state->col_out2nd[best_col])*DTMF_2ND_HARMONIC_COL < col_energy[best_col] &&
-				teletone_goertzel_result (&dtmf_detect_state->row_out2nd[best_row])*DTMF_2ND_HARMONIC_ROW < row_energy[best_row]) {
+				teletone_goertzel_bank_result (bank, COL_2ND(best_col))*DTMF_2ND_HARMONIC_COL < col_energy[best_col] &&
+				teletone_goertzel_bank_result (bank, ROW_2ND(best_row))*DTMF_2ND_HARMONIC_ROW < row_energy[best_row]) {
 				hit = dtmf_positions[(best_row << 2) + best_col];
 				/* Look for two successive similar results */
 				/* The logic in the next test is:
@@ -455,6 +482,23 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 }
 
 
+TELETONE_API(int) teletone_dtmf_detect_batch (teletone_dtmf_detect_state_t *dtmf_detect_states[],
+											  int16_t *sample_buffers[],
+											  int samples[],
+											  teletone_hit_type_t hits[],
+											  int count)
+{
+	int i, r = 0;
+
+	for (i = 0; i < count; i++) {
+		if ((hits[i] = teletone_dtmf_detect(dtmf_detect_states[i], sample_buffers[i], samples[i])) != TT_HIT_NONE) {
+			r++;
+		}
+	}
+
+	return r;
+}
+
 TELETONE_API(int) teletone_dtmf_get (teletone_dtmf_detect_state_t *dtmf_detect_state, char *buf, unsigned int *dur)
 {
 	if (!dtmf_detect_state->digit) {
@@ -131,6 +131,7 @@ extern "C" {
 #define DTMF_2ND_HARMONIC_ROW		2.5		/* 4dB */
 #define DTMF_2ND_HARMONIC_COL		63.1	/* 18dB */
 #define GRID_FACTOR 4
+#define TELETONE_DTMF_FILTERS (GRID_FACTOR * 4)
 #define BLOCK_LEN 102
 #define M_TWO_PI 2.0*M_PI
 
@@ -149,6 +150,14 @@ extern "C" {
 		double fac;
 	} teletone_goertzel_state_t;
 	
+	/*! \brief All the DTMF Goertzel filters side by side so they can be stepped together
+	  (rows, columns, row 2nd harmonics then column 2nd harmonics, GRID_FACTOR of each) */
+	typedef struct {
+		float fac[TELETONE_DTMF_FILTERS];
+		float v2[TELETONE_DTMF_FILTERS];
+		float v3[TELETONE_DTMF_FILTERS];
+	} teletone_goertzel_bank_t;
+
 	/*! \brief A container for a DTMF detection state.*/
 	typedef struct {
 		int hit1;
@@ -159,10 +168,7 @@ extern "C" {
 		int zc;
 		
 
-		teletone_goertzel_state_t row_out[GRID_FACTOR];
-		teletone_goertzel_state_t col_out[GRID_FACTOR];
-		teletone_goertzel_state_t row_out2nd[GRID_FACTOR];
-		teletone_goertzel_state_t col_out2nd[GRID_FACTOR];
+		teletone_goertzel_bank_t bank;
 		float energy;
 		float lenergy;
 	
@@ -252,6 +258,21 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 	*/
 TELETONE_API(int) teletone_dtmf_get (teletone_dtmf_detect_state_t *dtmf_detect_state, char *buf, unsigned int *dur);
 
+	/*! 
+	  \brief Check the sample buffers of many detectors in one call
+	  \param dtmf_detect_states the detection state objects
+	  \param sample_buffers one sample buffer for each state
+	  \param samples the number of samples in each buffer
+	  \param hits where the result of each teletone_dtmf_detect is stored
+	  \param count the number of states
+	  \return the number of states that reported something other than TT_HIT_NONE
+	*/
+TELETONE_API(int) teletone_dtmf_detect_batch (teletone_dtmf_detect_state_t *dtmf_detect_states[],
+											  int16_t *sample_buffers[],
+											  int samples[],
+											  teletone_hit_type_t hits[],
+											  int count);
+
 	/*! 
 	  \brief Step through the Goertzel Algorithm for each sample in a buffer
 	  \param goertzel_state the goertzel state to step the samples through
@@ -273,6 +273,17 @@ TPORT_DLL int tport_has_tls(tport_t const *tport);
 /** Test if transport provided a verified certificate chain (TLS only) */
 TPORT_DLL int tport_is_verified(tport_t const *tport);
 
+/** TLS handshake counters, summed over the TLS primaries of a master. */
+typedef struct {
+  unsigned long tls_full;        /**< Full handshakes completed */
+  unsigned long tls_resumed;     /**< Handshakes resuming a session */
+  unsigned long tls_failed;      /**< Handshakes that failed */
+  uint64_t      tls_usec;        /**< Time spent handshaking, in microseconds */
+} tport_tls_stats_t;
+
+/** Get TLS handshake counters of a transport master. */
+TPORT_DLL int tport_tls_stats(tport_t const *self, tport_tls_stats_t *stats);
+
 /** Return true if transport is being updated. */
 TPORT_DLL int tport_is_updating(tport_t const *self);
 
@@ -363,6 +374,9 @@ TPORT_DLL int tport_convert_addr(su_home_t *home,
 TPORT_DLL char *tport_hostport(char buf[], isize_t bufsize,
 			       su_sockaddr_t const *su, int with_port);
 
+/** Send a CRLF keepalive to a peer without a transaction. */
+TPORT_DLL int tport_send_ping(tport_t *self, tp_name_t const *tpn);
+
 /** Initialize STUN keepalives. */
 TPORT_DLL int tport_keepalive(tport_t *tp, su_addrinfo_t const *ai,
 			      tag_type_t tag, tag_value_t value, ...);
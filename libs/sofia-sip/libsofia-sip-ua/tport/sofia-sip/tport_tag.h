@@ -231,6 +231,27 @@ TPORT_DLL extern tag_typedef_t tptag_tls_verify_subjects_ref;
 #define TPTAG_TLS_VERIFY_SUBJECTS_REF(x) \
              tptag_tls_verify_subjects_ref, tag_cptr_vr(&(x), (x))
 
+TPORT_DLL extern tag_typedef_t tptag_tls_session_cache_size;
+#define TPTAG_TLS_SESSION_CACHE_SIZE(x) \
+             tptag_tls_session_cache_size, tag_uint_v((x))
+
+TPORT_DLL extern tag_typedef_t tptag_tls_session_cache_size_ref;
+#define TPTAG_TLS_SESSION_CACHE_SIZE_REF(x) \
+             tptag_tls_session_cache_size_ref, tag_uint_vr(&(x))
+
+TPORT_DLL extern tag_typedef_t tptag_tls_session_timeout;
+#define TPTAG_TLS_SESSION_TIMEOUT(x) tptag_tls_session_timeout, tag_uint_v((x))
+
+TPORT_DLL extern tag_typedef_t tptag_tls_session_timeout_ref;
+#define TPTAG_TLS_SESSION_TIMEOUT_REF(x) \
+             tptag_tls_session_timeout_ref, tag_uint_vr(&(x))
+
+TPORT_DLL extern tag_typedef_t tptag_tls_ticket_keys;
+#define TPTAG_TLS_TICKET_KEYS(x) tptag_tls_ticket_keys, tag_str_v((x))
+
+TPORT_DLL extern tag_typedef_t tptag_tls_ticket_keys_ref;
+#define TPTAG_TLS_TICKET_KEYS_REF(x) tptag_tls_ticket_keys_ref, tag_str_vr(&(x))
+
 /* TPTAG_TLS_VERIFY_PEER is depreciated - Use TPTAG_TLS_VERIFY_POLICY */
 TPORT_DLL extern tag_typedef_t tptag_tls_verify_peer;
 #define TPTAG_TLS_VERIFY_PEER(x) TPTAG_TLS_VERIFY_POLICY( (x) ? \
@@ -72,6 +72,10 @@ typedef struct tport_nat_s tport_nat_t;
 
 #include "tport_internal.h"
 
+#if HAVE_TLS
+#include "tport_tls.h"
+#endif
+
 #if HAVE_FUNC
 #elif HAVE_FUNCTION
 #define __func__ __FUNCTION__
@@ -276,6 +280,38 @@ int tport_is_verified(tport_t const *self)
   return tport_has_tls(self) && self->tp_is_connected && self->tp_verified;
 }
 
+/** Get TLS handshake counters.
+ *
+ * Sums the handshakes done by all the TLS primaries of the master @a self
+ * belongs to.  The counters are only written by the thread running the
+ * stack, a reader on another thread may see them slightly behind.
+ *
+ * @retval 0 when successful
+ * @retval -1 upon an error or when TLS is not supported
+ */
+int tport_tls_stats(tport_t const *self, tport_tls_stats_t *stats)
+{
+#if HAVE_TLS
+  tport_primary_t *pri;
+#endif
+
+  if (!self || !stats)
+    return su_seterrno(EINVAL);
+
+  memset(stats, 0, sizeof *stats);
+
+#if HAVE_TLS
+  for (pri = self->tp_master->mr_primaries; pri; pri = pri->pri_next) {
+    if (pri->pri_has_tls)
+      tls_get_stats(((tport_tls_primary_t *)pri)->tlspri_master, stats);
+  }
+
+  return 0;
+#else
+  return su_seterrno(ENOSYS);
+#endif
+}
+
 /** Return true if transport is being updated. */
 int tport_is_updating(tport_t const *self)
 {
@@ -4662,6 +4698,97 @@ tport_t *tport_by_addrinfo(tport_primary_t const *pri,
   return (tport_t *)sub;
 }
 
+/** Send a keepalive to a peer.
+ *
+ * Over a datagram transport a CRLFCRLF packet is sent from the primary
+ * transport to the host and port in @a tpn, which must be a numeric
+ * address. Over TCP or TLS the RFC 5626 double CRLF is written to an open
+ * connection to that peer; a connection is never opened for it.
+ *
+ * This is much cheaper than an OPTIONS transaction when all that is needed
+ * is to keep a NAT binding or connection of a registered client alive.
+ * It must be called from the thread running the stack.
+ *
+ * @retval 0 when the keepalive was sent or queued data already keeps the
+ *           connection busy
+ * @retval -1 upon an error, or when there is nothing to send it on
+ */
+int tport_send_ping(tport_t *self, tp_name_t const *tpn)
+{
+  static char const ping[] = "\r\n\r\n";
+  tport_t *tp;
+  char const *host;
+  su_sockaddr_t su[1];
+  socklen_t sulen;
+#if SU_HAVE_IN6
+  char *end, ipaddr[TPORT_HOSTPORTSIZE];
+#endif
+
+  if (self == NULL || tpn == NULL || !tpn->tpn_proto ||
+      !tpn->tpn_canon || !tpn->tpn_host || !tpn->tpn_port)
+    return su_seterrno(EINVAL);
+
+  if (!(tp = tport_by_name(self, tpn)))
+    return su_seterrno(ENOENT);
+
+  if (tport_is_secondary(tp)) {
+    if (tport_is_closed(tp) || tport_is_shutdown(tp) || !tport_is_clear_to_send(tp))
+      return su_seterrno(ENOTCONN);
+
+    if (tport_has_queued(tp))
+      return 0;
+
+    if (tport_has_tls(tp)) {
+      msg_iovec_t iov[1];
+
+      iov->siv_base = (void *)ping, iov->siv_len = 4;
+
+      if (tp->tp_pri->pri_vtable->vtp_send(tp, NULL, iov, 1) != 4)
+	return -1;
+
+      tp->tp_ktime = su_now();
+      return 0;
+    }
+
+    return tport_tcp_ping(tp, su_now());
+  }
+
+  if (!tport_is_primary(tp) || !tport_is_dgram(tp))
+    return su_seterrno(ENOTCONN);
+
+  memset(su, 0, sizeof su);
+  host = tpn->tpn_host;
+
+#if SU_HAVE_IN6
+  if (host_is_ip6_reference(host)) {
+    host = strncpy(ipaddr, host + 1, sizeof(ipaddr) - 1);
+    ipaddr[sizeof(ipaddr) - 1] = '\0';
+    if ((end = strchr(ipaddr, ']')))
+      *end = 0;
+  }
+
+  if (host_is_ip6_address(host)) {
+    su->su_len = sulen = (socklen_t) sizeof (struct sockaddr_in6);
+    su->su_family = AF_INET6;
+  }
+  else
+#endif
+  {
+    su->su_len = sulen = (socklen_t) sizeof (struct sockaddr_in);
+    su->su_family = AF_INET;
+  }
+
+  su->su_port = htons(strtoul(tpn->tpn_port, NULL, 10));
+
+  if (su_inet_pton(su->su_family, host, SU_ADDR(su)) <= 0)
+    return su_seterrno(EINVAL);
+
+  if (su_sendto(tp->tp_socket, (void *)ping, 4, 0, su, sulen) != 4)
+    return -1;
+
+  return 0;
+}
+
 
 /** Get transport name from URL. */
 int tport_name_by_url(su_home_t *home,
@@ -403,6 +403,58 @@ tag_typedef_t tptag_tls_verify_date = UINTTAG_TYPEDEF(tls_verify_date);
  */
 tag_typedef_t tptag_tls_verify_subjects = PTRTAG_TYPEDEF(tls_verify_subjects);
 
+/**@def TPTAG_TLS_SESSION_CACHE_SIZE(x)
+ *
+ * Number of TLS sessions the server side keeps for resumption.  Clients
+ * reconnecting with a cached session skip the public key operations of a
+ * full handshake.
+ *
+ * @par Used with
+ *   tport_tbind(), nua_create(), nta_agent_create(), nta_agent_add_tport()
+ *
+ * @par Parameter Type:
+ *   unsigned int
+ *
+ * @par Values
+ *   - 0 - OpenSSL default (20480 sessions)
+ *   - Non-Zero - Maximum number of cached sessions
+ */
+tag_typedef_t tptag_tls_session_cache_size = UINTTAG_TYPEDEF(tls_session_cache_size);
+
+/**@def TPTAG_TLS_SESSION_TIMEOUT(x)
+ *
+ * Lifetime of a cached TLS session or session ticket in seconds.
+ *
+ * @par Used with
+ *   tport_tbind(), nua_create(), nta_agent_create(), nta_agent_add_tport()
+ *
+ * @par Parameter Type:
+ *   unsigned int
+ *
+ * @par Values
+ *   - 0 - OpenSSL default (300 seconds)
+ *   - Non-Zero - Session lifetime in seconds
+ */
+tag_typedef_t tptag_tls_session_timeout = UINTTAG_TYPEDEF(tls_session_timeout);
+
+/**@def TPTAG_TLS_TICKET_KEYS(x)
+ *
+ * File holding the 48 bytes of session ticket keys.  Servers sharing the
+ * file accept each other's tickets, so clients failing over to another
+ * server resume their sessions instead of doing a full handshake.
+ *
+ * @par Used with
+ *   tport_tbind(), nua_create(), nta_agent_create(), nta_agent_add_tport()
+ *
+ * @par Parameter Type:
+ *   char const *
+ *
+ * @par Values
+ *   - NULL - random keys private to this agent
+ *   - Path name of the key file
+ */
+tag_typedef_t tptag_tls_ticket_keys = STRTAG_TYPEDEF(tls_ticket_keys);
+
 #if 0
 /**@def TPTAG_X509_SUBJECT(x)
  *
@@ -128,6 +128,14 @@ struct tls_s {
 
   /* Host names */
   su_strlst_t *subjects;
+
+  /* Handshake counters, kept in the master */
+  tls_t *master;
+  su_nanotime_t hs_started;
+  unsigned long hs_full;
+  unsigned long hs_resumed;
+  unsigned long hs_failed;
+  uint64_t hs_usec;
 };
 
 enum { tls_buffer_size = 16384 };
@@ -419,6 +427,47 @@ int tls_get_socket(tls_t *tls)
   return sock;
 }
 
+/* Load the session ticket keys shared with other servers */
+static
+void tls_load_ticket_keys(tls_t *tls, char const *path)
+{
+#ifdef SSL_CTRL_SET_TLSEXT_TICKET_KEYS
+  unsigned char keys[48];
+  FILE *f;
+  size_t n = 0;
+
+  if ((f = fopen(path, "rb"))) {
+    n = fread(keys, 1, sizeof keys, f);
+    fclose(f);
+  }
+
+  if (n != sizeof keys) {
+    SU_DEBUG_1(("%s: cannot read %u bytes of ticket keys from %s\n",
+		"tls_init_master", (unsigned)sizeof keys, path));
+    return;
+  }
+
+  if (!SSL_CTX_set_tlsext_ticket_keys(tls->ctx, keys, sizeof keys))
+    tls_log_errors(3, "tls_init_master(ticket keys)", 0);
+
+  memset(keys, 0, sizeof keys);
+#else
+  SU_DEBUG_3(("%s: session tickets not supported, ignoring %s\n",
+	      "tls_init_master", path));
+#endif
+}
+
+void tls_get_stats(tls_t const *tls, tport_tls_stats_t *stats)
+{
+  if (!tls)
+    return;
+
+  stats->tls_full += tls->hs_full;
+  stats->tls_resumed += tls->hs_resumed;
+  stats->tls_failed += tls->hs_failed;
+  stats->tls_usec += tls->hs_usec;
+}
+
 tls_t *tls_init_master(tls_issues_t *ti)
 {
   /* Default id in case RAND fails */
@@ -441,12 +490,26 @@ tls_t *tls_init_master(tls_issues_t *ti)
     return NULL;
   }
 
-  RAND_pseudo_bytes(sessionId, sizeof(sessionId));
+  /* Servers sharing ticket keys must share the context too, or
+     OpenSSL refuses to resume each other's sessions */
+  if (!ti->ticket_keys)
+    RAND_pseudo_bytes(sessionId, sizeof(sessionId));
 
   SSL_CTX_set_session_id_context(tls->ctx,
                                  (void*) sessionId,
 				 sizeof(sessionId));
 
+  SSL_CTX_set_session_cache_mode(tls->ctx, SSL_SESS_CACHE_SERVER);
+
+  if (ti->session_cache_size)
+    SSL_CTX_sess_set_cache_size(tls->ctx, ti->session_cache_size);
+
+  if (ti->session_timeout)
+    SSL_CTX_set_timeout(tls->ctx, ti->session_timeout);
+
+  if (ti->ticket_keys)
+    tls_load_ticket_keys(tls, ti->ticket_keys);
+
   if (ti->CAfile != NULL)
     SSL_CTX_set_client_CA_list(tls->ctx,
                                SSL_load_client_CA_file(ti->CAfile));
@@ -481,6 +544,7 @@ tls_t *tls_init_secondary(tls_t *master, int sock, int accept)
     tls->verify_subj_in  = master->verify_subj_in;
     tls->verify_date     = master->verify_date;
     tls->x509_verified   = master->x509_verified;
+    tls->master          = master;
 
     if (!(tls->read_buffer = su_alloc(tls->home, tls_buffer_size)))
       su_home_unref(tls->home), tls = NULL;
@@ -895,10 +959,20 @@ int tls_connect(su_root_magic_t *magic, su_wait_t *w, tport_t *self)
 
   if (self->tp_is_connected == 0) {
     int ret, status;
+    su_nanotime_t started, now;
+
+    su_monotime(&started);
+    if (!tls->hs_started)
+      tls->hs_started = started;
 
     ret = self->tp_accepted ? SSL_accept(tls->con) : SSL_connect(tls->con);
     status = SSL_get_error(tls->con, ret);
 
+    /* only the time spent in OpenSSL, waiting for the peer is free */
+    su_monotime(&now);
+    if (tls->master)
+      tls->master->hs_usec += (now - started) / 1000;
+
     switch (status) {
       case SSL_ERROR_WANT_READ:
         /* OpenSSL is waiting for the peer to send handshake data */
@@ -918,6 +992,13 @@ int tls_connect(su_root_magic_t *magic, su_wait_t *w, tport_t *self)
         /* TLS Handshake complete */
 	status = tls_post_connection_check(self, tls);
         if ( status == X509_V_OK ) {
+          if (tls->master) {
+            if (SSL_session_reused(tls->con))
+              tls->master->hs_resumed++;
+            else
+              tls->master->hs_full++;
+          }
+
           su_wait_t wait[1] = {SU_WAIT_INIT};
           tport_master_t *mr = self->tp_master;
 
@@ -960,6 +1041,9 @@ int tls_connect(su_root_magic_t *magic, su_wait_t *w, tport_t *self)
   }
 
   /* TLS Handshake Failed or Peer Certificate did not Verify */
+  if (tls->master)
+    tls->master->hs_failed++;
+
   tport_close(self);
   tport_set_secondary_timer(self);
 
@@ -65,6 +65,9 @@ typedef struct tls_issues_s {
                          */
   int   version;	/* For tls1, version is 1. When ssl3/ssl2 is
 			 * used, it is 0. */
+  unsigned session_cache_size; /* if 0, use the OpenSSL default */
+  unsigned session_timeout;    /* seconds, if 0, use the OpenSSL default */
+  char *ticket_keys;    /* File of 48 bytes of session ticket keys */
 } tls_issues_t;
 
 typedef struct tport_tls_s {
@@ -93,6 +96,8 @@ int tls_want_write(tls_t *tls, int events);
 
 int tls_events(tls_t const *tls, int flags);
 
+void tls_get_stats(tls_t const *tls, tport_tls_stats_t *stats);
+
 SOFIA_END_DECLS
 
 #endif
@@ -187,6 +187,9 @@ static int tport_tls_init_master(tport_primary_t *pri,
   unsigned tls_depth = 0;
   unsigned tls_date = 1;
   su_strlst_t const *tls_subjects = NULL;
+  unsigned tls_cache_size = 0;
+  unsigned tls_timeout = 0;
+  char const *tls_ticket_keys = NULL;
   su_home_t autohome[SU_HOME_AUTO_SIZE(1024)];
   tls_issues_t ti = {0};
 
@@ -204,6 +207,9 @@ static int tport_tls_init_master(tport_primary_t *pri,
 	  TPTAG_TLS_VERIFY_DEPTH_REF(tls_depth),
 	  TPTAG_TLS_VERIFY_DATE_REF(tls_date),
 	  TPTAG_TLS_VERIFY_SUBJECTS_REF(tls_subjects),
+	  TPTAG_TLS_SESSION_CACHE_SIZE_REF(tls_cache_size),
+	  TPTAG_TLS_SESSION_TIMEOUT_REF(tls_timeout),
+	  TPTAG_TLS_TICKET_KEYS_REF(tls_ticket_keys),
 	  TAG_END());
 
   if (!path) {
@@ -225,6 +231,9 @@ static int tport_tls_init_master(tport_primary_t *pri,
     ti.CAfile = su_sprintf(autohome, "%s/%s", path, "cafile.pem");
     ti.version = tls_version;
     ti.CApath = su_strdup(autohome, path);
+    ti.session_cache_size = tls_cache_size;
+    ti.session_timeout = tls_timeout;
+    ti.ticket_keys = su_strdup(autohome, tls_ticket_keys);
 
     SU_DEBUG_9(("%s(%p): tls key = %s\n", __func__, (void *)pri, ti.key));
 
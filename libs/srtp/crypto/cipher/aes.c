@@ -47,6 +47,19 @@
 #include "aes.h"
 #include "err.h"
 
+/*
+ * where the compiler can target the AES instructions on a function by
+ * function basis, aes_encrypt() and aes_encrypt_ctr() switch to them at
+ * run time when cpuid reports them; the round keys produced by
+ * aes_expand_encryption_key() are laid out exactly as aesenc wants them
+ */
+#if !defined(SRTP_NO_AESNI) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define AES_HAVE_AESNI 1
+#include <cpuid.h>
+#include <wmmintrin.h>
+#endif
+
 /* 
  * we use the tables T0, T1, T2, T3, and T4 to compute AES, and 
  * the tables U0, U1, U2, and U4 to compute its inverse
@@ -1909,9 +1922,136 @@ aes_inv_final_round(v128_t *state, const v128_t *round_key) {
 #endif  /* CPU type */
 
 
+#ifdef AES_HAVE_AESNI
+
+static int aesni_state = -1;
+
+int
+aes_use_aesni(void) {
+  unsigned int eax, ebx, ecx, edx;
+
+  if (aesni_state < 0) {
+    /* AES-NI is leaf 1 ecx bit 25, SSE2 is edx bit 26 */
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+      aesni_state = ((ecx & (1u << 25)) && (edx & (1u << 26))) ? 1 : 0;
+    else
+      aesni_state = 0;
+  }
+
+  return aesni_state;
+}
+
+__attribute__((target("aes,sse2")))
+static inline __m128i
+aesni_encrypt_block(__m128i b, const __m128i *k) {
+  b = _mm_xor_si128(b, _mm_loadu_si128(k + 0));
+  b = _mm_aesenc_si128(b, _mm_loadu_si128(k + 1));
+  b = _mm_aesenc_si128(b, _mm_loadu_si128(k + 2));
+  b = _mm_aesenc_si128(b, _mm_loadu_si128(k + 3));
+  b = _mm_aesenc_si128(b, _mm_loadu_si128(k + 4));
+  b = _mm_aesenc_si128(b, _mm_loadu_si128(k + 5));
+  b = _mm_aesenc_si128(b, _mm_loadu_si128(k + 6));
+  b = _mm_aesenc_si128(b, _mm_loadu_si128(k + 7));
+  b = _mm_aesenc_si128(b, _mm_loadu_si128(k + 8));
+  b = _mm_aesenc_si128(b, _mm_loadu_si128(k + 9));
+  return _mm_aesenclast_si128(b, _mm_loadu_si128(k + 10));
+}
+
+__attribute__((target("aes,sse2")))
+static void
+aesni_encrypt(v128_t *plaintext, const aes_expanded_key_t exp_key) {
+  __m128i b = _mm_loadu_si128((const __m128i *)plaintext);
+
+  _mm_storeu_si128((__m128i *)plaintext,
+		   aesni_encrypt_block(b, (const __m128i *)exp_key));
+}
+
+/*
+ * four keystream blocks are kept in flight so the aesenc latency of
+ * one block hides behind the others
+ */
+__attribute__((target("aes,sse2")))
+static void
+aesni_encrypt_ctr(v128_t *counter, uint8_t *buf, unsigned int num_blocks,
+		  const aes_expanded_key_t exp_key) {
+  const __m128i *k = (const __m128i *)exp_key;
+  __m128i rk, c[4], d[4];
+  v128_t ctr[4];
+  unsigned int i, j, n;
+
+  while (num_blocks) {
+    n = num_blocks < 4 ? num_blocks : 4;
+
+    for (j = 0; j < n; j++) {
+      v128_copy(&ctr[j], counter);
+      if (!++(counter->v8[15]))
+	++(counter->v8[14]);
+    }
+
+    rk = _mm_loadu_si128(k);
+    for (j = 0; j < n; j++)
+      c[j] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&ctr[j]), rk);
+
+    for (i = 1; i < 10; i++) {
+      rk = _mm_loadu_si128(k + i);
+      for (j = 0; j < n; j++)
+	c[j] = _mm_aesenc_si128(c[j], rk);
+    }
+
+    rk = _mm_loadu_si128(k + 10);
+    for (j = 0; j < n; j++) {
+      c[j] = _mm_aesenclast_si128(c[j], rk);
+      d[j] = _mm_loadu_si128((const __m128i *)(buf + 16 * j));
+      _mm_storeu_si128((__m128i *)(buf + 16 * j), _mm_xor_si128(d[j], c[j]));
+    }
+
+    buf += 16 * n;
+    num_blocks -= n;
+  }
+}
+
+#else
+
+int
+aes_use_aesni(void) {
+  return 0;
+}
+
+#endif /* AES_HAVE_AESNI */
+
+void
+aes_encrypt_ctr(v128_t *counter, uint8_t *buf, unsigned int num_blocks,
+		const aes_expanded_key_t exp_key) {
+  v128_t ks;
+  unsigned int i;
+
+#ifdef AES_HAVE_AESNI
+  if (aes_use_aesni()) {
+    aesni_encrypt_ctr(counter, buf, num_blocks, exp_key);
+    return;
+  }
+#endif
+
+  while (num_blocks--) {
+    v128_copy(&ks, counter);
+    aes_encrypt(&ks, exp_key);
+    if (!++(counter->v8[15]))
+      ++(counter->v8[14]);
+    for (i = 0; i < sizeof(v128_t); i++)
+      *buf++ ^= ks.v8[i];
+  }
+}
+
 void
 aes_encrypt(v128_t *plaintext, const aes_expanded_key_t exp_key) {
 
+#ifdef AES_HAVE_AESNI
+  if (aes_use_aesni()) {
+    aesni_encrypt(plaintext, exp_key);
+    return;
+  }
+#endif
+
   /* add in the subkey */
   v128_xor_eq(plaintext, exp_key + 0);
 
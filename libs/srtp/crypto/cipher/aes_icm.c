@@ -366,6 +366,16 @@ aes_icm_encrypt_ismacryp(aes_icm_ctx_t *c,
 
   }
   
+  /*
+   * plain ICM clocks only the low sixteen bits of the counter, which is
+   * what aes_encrypt_ctr() does, so hand it all the whole blocks at once
+   */
+  if (!forIsmacryp && bytes_to_encr >= sizeof(v128_t)) {
+    aes_encrypt_ctr(&c->counter, buf, bytes_to_encr/sizeof(v128_t), c->expanded_key);
+    buf += bytes_to_encr & ~(sizeof(v128_t) - 1);
+    bytes_to_encr &= sizeof(v128_t) - 1;
+  }
+
   /* now loop over entire 16-byte blocks of keystream */
   for (i=0; i < (bytes_to_encr/sizeof(v128_t)); i++) {
 
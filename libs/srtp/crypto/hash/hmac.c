@@ -145,6 +145,10 @@ hmac_init(hmac_ctx_t *state, const uint8_t *key, int key_len) {
   sha1_update(&state->init_ctx, ipad, 64);
   memcpy(&state->ctx, &state->init_ctx, sizeof(sha1_ctx_t)); 
 
+  /* the outer hash always starts with opad ^ key, so hash that once here */
+  sha1_init(&state->opad_ctx);
+  sha1_update(&state->opad_ctx, (uint8_t *)state->opad, 64);
+
   return err_status_ok;
 }
 
@@ -190,11 +194,8 @@ hmac_compute(hmac_ctx_t *state, const void *message,
   debug_print(mod_hmac, "intermediate state: %s", 
 	      octet_string_hex_string((uint8_t *)H, 20));
 
-  /* re-initialize hash context */
-  sha1_init(&state->ctx);
-  
-  /* hash opad ^ key  */
-  sha1_update(&state->ctx, (uint8_t *)state->opad, 64);
+  /* start from the precomputed hash of opad ^ key */
+  memcpy(&state->ctx, &state->opad_ctx, sizeof(sha1_ctx_t));
 
   /* hash the result of the inner hash */
   sha1_update(&state->ctx, (uint8_t *)H, 20);
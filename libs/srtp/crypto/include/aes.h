@@ -69,6 +69,28 @@ aes_encrypt(v128_t *plaintext, const aes_expanded_key_t exp_key);
 void
 aes_decrypt(v128_t *plaintext, const aes_expanded_key_t exp_key);
 
+/*
+ * aes_encrypt_ctr(counter, buf, num_blocks, exp_key) exors the
+ * keystream of num_blocks successive counter blocks into the 16 *
+ * num_blocks octets at buf, clocking the low sixteen bits of the
+ * counter forward once per block as SRTP's integer counter mode does
+ *
+ * when the processor has the AES instructions several blocks are
+ * run through the cipher at once
+ */
+
+void
+aes_encrypt_ctr(v128_t *counter, uint8_t *buf, unsigned int num_blocks,
+		const aes_expanded_key_t exp_key);
+
+/*
+ * aes_use_aesni() returns nonzero when aes_encrypt() and
+ * aes_encrypt_ctr() run on the AES instructions rather than the tables
+ */
+
+int
+aes_use_aesni(void);
+
 #if 0
 /*
  * internal functions 
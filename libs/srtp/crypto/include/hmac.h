@@ -53,6 +53,7 @@ typedef struct {
   uint8_t    opad[64];
   sha1_ctx_t ctx;
   sha1_ctx_t init_ctx;
+  sha1_ctx_t opad_ctx;       /* sha1 state after hashing opad ^ key */
 } hmac_ctx_t;
 
 err_status_t
@@ -121,8 +121,26 @@ struct stfu_instance {
     uint8_t ready;
     uint8_t debug;
 
+    uint8_t adaptive;
+    uint8_t have_transit;
+    uint32_t min_qlen;
+    uint32_t percentile;
+    uint32_t target_qlen;
+    uint32_t shrink_hold;
+    int32_t last_transit;
+    int32_t transit_floor;
+    int32_t period_min_transit;
+    uint32_t jitter_q4;
+    uint32_t hist[STFU_JITTER_BUCKETS];
+    uint32_t hist_total;
+    uint32_t hist_count;
+    uint32_t plc_count;
+    uint32_t underrun_plc;
+    uint32_t plc_ts;
+
     char *name;
     stfu_n_call_me_t callback;
+    stfu_n_release_t release;
     void *udata;
 };
 
@@ -142,6 +160,32 @@ int32_t stfu_n_get_most_qlen(stfu_instance_t *i)
     return i->most_qlen;
 }
 
+stfu_status_t stfu_n_set_adaptive(stfu_instance_t *i, uint32_t min_qlen, uint32_t percentile)
+{
+    stfu_assert(i);
+
+    if (!min_qlen) {
+        min_qlen = 2;
+    }
+
+    if (!percentile || percentile > 100) {
+        percentile = 95;
+    }
+
+    if (i->max_qlen && min_qlen > i->max_qlen) {
+        return STFU_IT_FAILED;
+    }
+
+    i->min_qlen = min_qlen;
+    i->percentile = percentile;
+    i->target_qlen = i->qlen;
+    i->shrink_hold = 0;
+    i->have_transit = 0;
+    i->adaptive = 1;
+
+    return STFU_IT_WORKED;
+}
+
 void stfu_global_set_logger(stfu_logger_t logger)
 {
 	if (logger) {
@@ -175,7 +219,7 @@ static stfu_status_t stfu_n_resize_aqueue(stfu_queue_t *queue, uint32_t qlen)
     } else {
         m = realloc(queue->array, qlen * sizeof(struct stfu_frame));
         assert(m);
-        memset(m + queue->array_size * sizeof(struct stfu_frame), 0, (qlen * sizeof(struct stfu_frame)) - (queue->array_size * sizeof(struct stfu_frame)));
+        memset(m + queue->real_array_size * sizeof(struct stfu_frame), 0, (qlen - queue->real_array_size) * sizeof(struct stfu_frame));
         queue->array = (struct stfu_frame *) m;
         queue->real_array_size = queue->array_size = qlen;
     }
@@ -201,6 +245,26 @@ void stfu_n_call_me(stfu_instance_t *i, stfu_n_call_me_t callback, void *udata)
     i->udata = udata;
 }
 
+void stfu_n_set_release(stfu_instance_t *i, stfu_n_release_t release)
+{
+    i->release = release;
+}
+
+static void stfu_n_release_aqueue(stfu_instance_t *i, stfu_queue_t *queue)
+{
+    uint32_t x;
+
+    for (x = 0; x < queue->real_array_size; x++) {
+        if (queue->array[x].ref) {
+            if (i->release) {
+                i->release(queue->array[x].ref);
+            }
+            queue->array[x].ref = NULL;
+            queue->array[x].ref_data = NULL;
+        }
+    }
+}
+
 void stfu_n_destroy(stfu_instance_t **i)
 {
 	stfu_instance_t *ii;
@@ -208,6 +272,9 @@ void stfu_n_destroy(stfu_instance_t **i)
 	if (i && *i) {
 		ii = *i;
 		*i = NULL;
+        stfu_n_release_aqueue(ii, &ii->a_queue);
+        stfu_n_release_aqueue(ii, &ii->b_queue);
+        stfu_n_release_aqueue(ii, &ii->c_queue);
         if (ii->name) free(ii->name);
 		free(ii->a_queue.array);
 		free(ii->b_queue.array);
@@ -237,13 +304,17 @@ void stfu_n_report(stfu_instance_t *i, stfu_report_t *r)
 	r->clean_count = i->period_clean_count;
 	r->consecutive_good_count = i->consecutive_good_count;
 	r->consecutive_bad_count = i->consecutive_bad_count;
+	r->target_qlen = i->adaptive ? i->target_qlen : i->qlen;
+	r->jitter = i->jitter_q4 >> 4;
+	r->plc_count = i->plc_count;
+	r->adaptive = i->adaptive;
 }
 
 stfu_status_t stfu_n_resize(stfu_instance_t *i, uint32_t qlen) 
 {
     stfu_status_t s;
 
-    if (i->qlen == i->max_qlen) {
+    if (qlen > i->qlen && i->qlen == i->max_qlen) {
         return STFU_IT_FAILED;
     }
     
@@ -365,6 +436,7 @@ void stfu_n_reset(stfu_instance_t *i)
 	i->last_rd_ts = 0;
 	i->miss_count = 0;	
     i->packet_count = 0;
+    i->have_transit = 0;
 
 
 }
@@ -402,7 +474,101 @@ static void stfu_n_swap(stfu_instance_t *i)
     i->out_queue->last_jitter = 0;
 }
 
-stfu_status_t stfu_n_add_data(stfu_instance_t *i, uint32_t ts, uint32_t pt, void *data, size_t datalen, uint32_t timer_ts, int last)
+static void stfu_n_adapt(stfu_instance_t *i, uint32_t ts, uint32_t timer_ts)
+{
+    int32_t transit, d, delay;
+    uint32_t x, bucket, want, sum = 0, target = 0;
+
+    transit = (int32_t)(timer_ts - ts);
+
+    if (!i->have_transit) {
+        i->last_transit = i->transit_floor = i->period_min_transit = transit;
+        i->have_transit = 1;
+        return;
+    }
+
+    /* RFC 3550 interarrival jitter, kept in 1/16 sample units */
+    d = abs(transit - i->last_transit);
+    i->last_transit = transit;
+    i->jitter_q4 += d - ((i->jitter_q4 + 8) >> 4);
+
+    if (transit < i->period_min_transit) {
+        i->period_min_transit = transit;
+    }
+
+    if (transit < i->transit_floor) {
+        i->transit_floor = transit;
+    }
+
+    delay = transit - i->transit_floor;
+    bucket = (uint32_t)(((int64_t)delay * STFU_JITTER_RES) / least1(i->samples_per_packet));
+
+    if (bucket >= STFU_JITTER_BUCKETS) {
+        bucket = STFU_JITTER_BUCKETS - 1;
+    }
+
+    i->hist[bucket]++;
+    i->hist_total++;
+
+    /* age the histogram so the percentile follows the recent network and re-anchor the floor against clock drift */
+    if (++i->hist_count > i->period_time) {
+        i->hist_total = 0;
+        for (x = 0; x < STFU_JITTER_BUCKETS; x++) {
+            i->hist[x] >>= 1;
+            i->hist_total += i->hist[x];
+        }
+        i->transit_floor = i->period_min_transit;
+        i->period_min_transit = transit;
+        i->hist_count = 0;
+    }
+
+    if (i->hist_total < 50) {
+        return;
+    }
+
+    want = (uint32_t)(((uint64_t)i->hist_total * i->percentile) / 100);
+
+    for (x = 0; x < STFU_JITTER_BUCKETS; x++) {
+        sum += i->hist[x];
+        if (sum >= want) {
+            break;
+        }
+    }
+
+    /* round the delay up to whole packets plus one for reordering */
+    target = ((x + STFU_JITTER_RES) / STFU_JITTER_RES) + 1;
+
+    if (target < i->min_qlen) {
+        target = i->min_qlen;
+    }
+
+    if (i->max_qlen && target > i->max_qlen) {
+        target = i->max_qlen;
+    }
+
+    i->target_qlen = target;
+
+    if (target > i->qlen) {
+        i->shrink_hold = 0;
+        if (stfu_log != null_logger && i->debug) {
+            stfu_log(STFU_LOG_EMERG, "%s adaptive grow %u %u (target %u jitter %u)\n", i->name, i->qlen, i->qlen + 1, target, i->jitter_q4 >> 4);
+        }
+        stfu_n_resize(i, i->qlen + 1);
+    } else if (target < i->qlen) {
+        if (++i->shrink_hold > i->decrement_time / 5) {
+            if (stfu_log != null_logger && i->debug) {
+                stfu_log(STFU_LOG_EMERG, "%s adaptive shrink %u %u (target %u jitter %u)\n", i->name, i->qlen, i->qlen - 1, target, i->jitter_q4 >> 4);
+            }
+            stfu_n_resize(i, i->qlen - 1);
+            stfu_n_sync(i, i->qlen);
+            i->shrink_hold = 0;
+        }
+    } else {
+        i->shrink_hold = 0;
+    }
+}
+
+static stfu_status_t stfu_n_add_data_real(stfu_instance_t *i, uint32_t ts, uint32_t pt, void *data, size_t datalen, uint32_t timer_ts, int last, void *ref)
 {
 	uint32_t index = 0;
 	stfu_frame_t *frame;
@@ -488,7 +654,11 @@ stfu_status_t stfu_n_add_data(stfu_instance_t *i, uint32_t ts, uint32_t pt, void
 
     i->period_need_range_avg = i->period_need_range / least1(i->period_missing_count);
 
-    if (i->period_missing_count > i->qlen * 2) {
+    if (i->adaptive) {
+        if (timer_ts && ts) {
+            stfu_n_adapt(i, ts, timer_ts);
+        }
+    } else if (i->period_missing_count > i->qlen * 2) {
         if (stfu_log != null_logger && i->debug) {
             stfu_log(STFU_LOG_EMERG, "%s resize %u %u\n", i->name, i->qlen, i->qlen + 1);
         }
@@ -522,7 +692,7 @@ stfu_status_t stfu_n_add_data(stfu_instance_t *i, uint32_t ts, uint32_t pt, void
 
         i->period_packet_in_count = 0;
 
-        if (i->period_missing_count == 0 && i->qlen > i->orig_qlen) {
+        if (!i->adaptive && i->period_missing_count == 0 && i->qlen > i->orig_qlen) {
             stfu_n_resize(i, i->qlen - 1);
             stfu_n_sync(i, i->qlen);
         }
@@ -558,14 +728,28 @@ stfu_status_t stfu_n_add_data(stfu_instance_t *i, uint32_t ts, uint32_t pt, void
         stfu_n_swap(i);
     }
 
-	if ((cplen = datalen) > sizeof(frame->data)) {
-		cplen = sizeof(frame->data);
-	}
+    if (frame->ref) {
+        if (i->release) {
+            i->release(frame->ref);
+        }
+        frame->ref = NULL;
+        frame->ref_data = NULL;
+    }
 
     i->last_rd_ts = ts;
     i->packet_count++;
 
-	memcpy(frame->data, data, cplen);
+    if (ref) {
+        frame->ref = ref;
+        frame->ref_data = data;
+        cplen = datalen;
+    } else {
+        if ((cplen = datalen) > sizeof(frame->data)) {
+            cplen = sizeof(frame->data);
+        }
+
+        memcpy(frame->data, data, cplen);
+    }
 
     frame->pt = pt;
 	frame->ts = ts;
@@ -575,6 +759,16 @@ stfu_status_t stfu_n_add_data(stfu_instance_t *i, uint32_t ts, uint32_t pt, void
 	return STFU_IT_WORKED;
 }
 
+stfu_status_t stfu_n_add_data(stfu_instance_t *i, uint32_t ts, uint32_t pt, void *data, size_t datalen, uint32_t timer_ts, int last)
+{
+    return stfu_n_add_data_real(i, ts, pt, data, datalen, timer_ts, last, NULL);
+}
+
+stfu_status_t stfu_n_add_ref_data(stfu_instance_t *i, uint32_t ts, uint32_t pt, void *data, size_t datalen, uint32_t timer_ts, void *ref)
+{
+    return stfu_n_add_data_real(i, ts, pt, data, datalen, timer_ts, 0, ref);
+}
+
 static int stfu_n_find_any_frame(stfu_instance_t *in, stfu_queue_t *queue, stfu_frame_t **r_frame)
 {
     uint32_t i = 0;
@@ -637,12 +831,26 @@ stfu_frame_t *stfu_n_read_a_frame(stfu_instance_t *i)
     }
     
     if (!i->ready) {
+        /* keep concealing across an underrun while the queue refills instead of going silent */
+        if (i->adaptive && i->underrun_plc && i->plc_len) {
+            i->underrun_plc--;
+            i->plc_ts += i->samples_per_packet;
+            i->plc_count++;
+            rframe = &i->out_queue->int_frame;
+            rframe->dlen = i->plc_len;
+            rframe->pt = i->plc_pt;
+            rframe->ts = i->plc_ts;
+            return rframe;
+        }
+
         if (stfu_log != null_logger && i->debug) {
             stfu_log(STFU_LOG_EMERG, "%s JITTERBUFFER NOT READY: IGNORING FRAME\n", i->name);
         }
         return NULL;
     }
 
+    i->underrun_plc = 0;
+
 
     if (i->cur_ts == 0 && i->last_wr_ts < 1000) {
         uint32_t x = 0;
@@ -781,8 +989,9 @@ stfu_frame_t *stfu_n_read_a_frame(stfu_instance_t *i)
         rframe = &i->out_queue->int_frame;
         rframe->dlen = i->plc_len;
         rframe->pt = i->plc_pt;
-        rframe->ts = i->cur_ts;
+        rframe->ts = i->plc_ts = i->cur_ts;
         i->miss_count++;
+        i->plc_count++;
         
         if (stfu_log != null_logger && i->debug) {
             stfu_log(STFU_LOG_EMERG, "%s PLC %d %d %ld %u:%u\n", i->name, 
@@ -791,7 +1000,16 @@ stfu_frame_t *stfu_n_read_a_frame(stfu_instance_t *i)
 
         if (i->miss_count > i->max_plc) {
             stfu_n_reset(i);
-            rframe = NULL;
+
+            if (i->adaptive) {
+                /* the queue ran dry, make room for the burst that is probably on its way */
+                if (i->qlen < i->max_qlen) {
+                    stfu_n_resize(i, i->qlen + 1);
+                }
+                i->underrun_plc = i->max_plc;
+            } else {
+                rframe = NULL;
+            }
         }
     }
 
@@ -153,6 +153,8 @@ void stfu_global_set_default_logger(int level);
 #define STFU_DATALEN 16384
 #define STFU_QLEN 300
 #define STFU_MAX_TRACK 256
+#define STFU_JITTER_BUCKETS 64
+#define STFU_JITTER_RES 4
 
 typedef enum {
 	STFU_IT_FAILED,
@@ -168,6 +170,8 @@ struct stfu_frame {
 	size_t dlen;
 	uint8_t was_read;
 	uint8_t plc;
+	void *ref;
+	void *ref_data;
 };
 typedef struct stfu_frame stfu_frame_t;
 
@@ -180,15 +184,23 @@ typedef struct {
 	uint32_t clean_count;
 	uint32_t consecutive_good_count;
 	uint32_t consecutive_bad_count;
+	uint32_t target_qlen;
+	uint32_t jitter;
+	uint32_t plc_count;
+	uint8_t adaptive;
 } stfu_report_t;
 
 typedef void (*stfu_n_call_me_t)(stfu_instance_t *i, void *);
+typedef void (*stfu_n_release_t)(void *ref);
 
 void stfu_n_report(stfu_instance_t *i, stfu_report_t *r);
 void stfu_n_destroy(stfu_instance_t **i);
 stfu_instance_t *stfu_n_init(uint32_t qlen, uint32_t max_qlen, uint32_t samples_per_packet, uint32_t samples_per_second, uint32_t max_drift_ms);
 stfu_status_t stfu_n_resize(stfu_instance_t *i, uint32_t qlen);
 stfu_status_t stfu_n_add_data(stfu_instance_t *i, uint32_t ts, uint32_t pt, void *data, size_t datalen, uint32_t timer_ts, int last);
+/*! Queue a frame by reference: on STFU_IT_WORKED the instance owns ref and drops it through the release callback once the slot is reused */
+stfu_status_t stfu_n_add_ref_data(stfu_instance_t *i, uint32_t ts, uint32_t pt, void *data, size_t datalen, uint32_t timer_ts, void *ref);
+void stfu_n_set_release(stfu_instance_t *i, stfu_n_release_t release);
 stfu_frame_t *stfu_n_read_a_frame(stfu_instance_t *i);
 void stfu_n_reset(stfu_instance_t *i);
 stfu_status_t stfu_n_sync(stfu_instance_t *i, uint32_t packets);
@@ -196,9 +208,12 @@ void stfu_n_call_me(stfu_instance_t *i, stfu_n_call_me_t callback, void *udata);
 void stfu_n_debug(stfu_instance_t *i, const char *name);
 int32_t stfu_n_get_drift(stfu_instance_t *i);
 int32_t stfu_n_get_most_qlen(stfu_instance_t *i);
+/*! Track interarrival jitter and size the queue from the given percentile of the arrival delay (min_qlen 0 = 2, percentile 0 = 95) */
+stfu_status_t stfu_n_set_adaptive(stfu_instance_t *i, uint32_t min_qlen, uint32_t percentile);
 
 #define stfu_im_done(i) stfu_n_add_data(i, 0, NULL, 0, 0, 1)
 #define stfu_n_eat(i,t,p,d,l,tt) stfu_n_add_data(i, t, p, d, l, tt, 0)
+#define stfu_frame_data(f) ((f)->ref ? (f)->ref_data : (void *) (f)->data)
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,677 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2012, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * fs_bench.c -- Micro benchmarks of core primitives
+ *
+ * Each benchmark times a loop over one primitive for a given parameter (headers
+ * in an event, keys in a hash, variables in a string, ...).  It is run a few times
+ * and the fastest and median runs are printed, one line per benchmark, as tab
+ * separated values or JSON so results can be collected and compared over time.
+ */
+
+#ifndef _XOPEN_SOURCE
+#define _XOPEN_SOURCE 600
+#endif
+
+#include <switch.h>
+#include <switch_version.h>
+
+
+/* Picky compiler */
+#ifdef __ICC
+#pragma warning (disable:167)
+#endif
+
+#define MAX_REPEATS 32
+
+typedef struct bench_ctx {
+	switch_memory_pool_t *pool;
+	uint32_t iterations;
+	int param;
+	const char *sparam;
+	void *data;
+} bench_ctx_t;
+
+/* setup is not timed, run does ctx->iterations operations, teardown undoes setup */
+typedef struct bench_def {
+	const char *name;
+	switch_status_t (*setup) (bench_ctx_t *ctx);
+	void (*run) (bench_ctx_t *ctx);
+	void (*teardown) (bench_ctx_t *ctx);
+} bench_def_t;
+
+static volatile uintptr_t sink;
+
+static void fill_event(switch_event_t *event, int headers)
+{
+	char name[32], value[64];
+	int i;
+
+	for (i = 0; i < headers; i++) {
+		switch_snprintf(name, sizeof(name), "Variable-Header-%d", i);
+		switch_snprintf(value, sizeof(value), "value %d of header with some text", i);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, name, value);
+	}
+}
+
+static void run_event_create(bench_ctx_t *ctx)
+{
+	switch_event_t *event;
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		switch_event_create(&event, SWITCH_EVENT_CUSTOM);
+		fill_event(event, ctx->param);
+		switch_event_destroy(&event);
+	}
+}
+
+static switch_status_t setup_event(bench_ctx_t *ctx)
+{
+	switch_event_t *event;
+
+	switch_event_create(&event, SWITCH_EVENT_CUSTOM);
+	fill_event(event, ctx->param);
+	ctx->data = event;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void teardown_event(bench_ctx_t *ctx)
+{
+	switch_event_t *event = ctx->data;
+
+	switch_event_destroy(&event);
+}
+
+static void run_event_serialize(bench_ctx_t *ctx)
+{
+	char *str;
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		switch_event_serialize(ctx->data, &str, SWITCH_TRUE);
+		sink += (uintptr_t) str;
+		free(str);
+	}
+}
+
+static void run_event_serialize_json(bench_ctx_t *ctx)
+{
+	char *str;
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		switch_event_serialize_json(ctx->data, &str);
+		sink += (uintptr_t) str;
+		free(str);
+	}
+}
+
+static void run_event_dup(bench_ctx_t *ctx)
+{
+	switch_event_t *event;
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		switch_event_dup(&event, ctx->data);
+		switch_event_destroy(&event);
+	}
+}
+
+typedef struct {
+	switch_hash_t *hash;
+	char **keys;
+} hash_data_t;
+
+static switch_status_t setup_hash(bench_ctx_t *ctx)
+{
+	hash_data_t *hd = switch_core_alloc(ctx->pool, sizeof(*hd));
+	int i;
+
+	hd->keys = switch_core_alloc(ctx->pool, sizeof(char *) * ctx->param);
+
+	for (i = 0; i < ctx->param; i++) {
+		hd->keys[i] = switch_core_sprintf(ctx->pool, "%08x-%d-key", (unsigned) (i * 2654435761u), i);
+	}
+
+	switch_core_hash_init(&hd->hash, ctx->pool);
+
+	for (i = 0; i < ctx->param; i++) {
+		switch_core_hash_insert(hd->hash, hd->keys[i], hd->keys[i]);
+	}
+
+	ctx->data = hd;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void teardown_hash(bench_ctx_t *ctx)
+{
+	hash_data_t *hd = ctx->data;
+
+	switch_core_hash_destroy(&hd->hash);
+}
+
+static void run_hash_insert(bench_ctx_t *ctx)
+{
+	hash_data_t *hd = ctx->data;
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		switch_core_hash_insert(hd->hash, hd->keys[i % ctx->param], hd->keys[i % ctx->param]);
+	}
+}
+
+static void run_hash_find(bench_ctx_t *ctx)
+{
+	hash_data_t *hd = ctx->data;
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		sink += (uintptr_t) switch_core_hash_find(hd->hash, hd->keys[(i * 7919) % ctx->param]);
+	}
+}
+
+static void run_hash_miss(bench_ctx_t *ctx)
+{
+	hash_data_t *hd = ctx->data;
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		sink += (uintptr_t) switch_core_hash_find(hd->hash, "no-such-key-in-this-table");
+	}
+}
+
+static const char *regex_patterns[] = {
+	"^1?(\\d{10})$",
+	"^(\\+?1)?(\\d{3})(\\d{3})(\\d{4})$",
+	"^(?:sip:)?([^@]+)@([^:;>]+)(?::(\\d+))?"
+};
+
+static const char *regex_subjects[] = {
+	"15551234567",
+	"+15551234567",
+	"sip:1000@sip.example.com:5060;transport=tcp"
+};
+
+static void run_regex_perform(bench_ctx_t *ctx)
+{
+	const char *pattern = regex_patterns[ctx->param % 3], *subject = regex_subjects[ctx->param % 3];
+	switch_regex_t *re = NULL;
+	int ovector[30];
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		sink += switch_regex_perform(subject, pattern, &re, ovector, sizeof(ovector) / sizeof(ovector[0]));
+		switch_regex_safe_free(re);
+	}
+}
+
+/* delimiter and a typical string for it: dial string, codec list, app args with quoting */
+static const struct {
+	char delim;
+	const char *str;
+} separate_subjects[] = {
+	{',', "{ignore_early_media=true,origination_caller_id_number=1000}sofia/internal/1001@example.com,user/1002@example.com,"
+	 "sofia/gateway/gw1/15551234567,loopback/1003/default"},
+	{',', "PCMU,PCMA,G722,opus@48000h@20i,speex@16000h@20i,G729,GSM"},
+	{' ', "bridge 'sofia/internal/1001@example.com' ring_ready 'playback tone_stream://%(2000,4000,440,480)' \\ continue"}
+};
+
+static void run_separate_string(bench_ctx_t *ctx)
+{
+	const char *subject = separate_subjects[ctx->param % 3].str;
+	char delim = separate_subjects[ctx->param % 3].delim;
+	char buf[512], *argv[64];
+	size_t len = strlen(subject) + 1;
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		memcpy(buf, subject, len);
+		sink += switch_separate_string(buf, delim, argv, switch_arraylen(argv));
+	}
+}
+
+static void run_separate_string_span(bench_ctx_t *ctx)
+{
+	const char *subject = separate_subjects[ctx->param % 3].str;
+	char delim = separate_subjects[ctx->param % 3].delim;
+	switch_span_t spans[64];
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		sink += switch_separate_string_span(subject, delim, spans, switch_arraylen(spans));
+	}
+}
+
+/* a session nobody runs, only there so channel variables can be duped into its pool */
+static switch_endpoint_interface_t *bench_endpoint_interface;
+static switch_io_routines_t bench_io_routines;
+
+static switch_status_t setup_channel(bench_ctx_t *ctx)
+{
+	switch_core_session_t *session;
+	switch_channel_t *channel;
+	char name[32], value[64];
+	int i;
+
+	if (!bench_endpoint_interface) {
+		switch_loadable_module_interface_t *module_interface;
+		switch_memory_pool_t *pool;
+
+		switch_core_new_memory_pool(&pool);
+		module_interface = switch_loadable_module_create_module_interface(pool, "fs_bench");
+		bench_endpoint_interface = switch_loadable_module_create_interface(module_interface, SWITCH_ENDPOINT_INTERFACE);
+		bench_endpoint_interface->interface_name = "bench";
+		bench_endpoint_interface->io_routines = &bench_io_routines;
+	}
+
+	if (!(session = switch_core_session_request(bench_endpoint_interface, SWITCH_CALL_DIRECTION_INBOUND, SOF_NO_LIMITS, NULL))) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	channel = switch_core_session_get_channel(session);
+
+	for (i = 0; i < 64; i++) {
+		switch_snprintf(name, sizeof(name), "bench_var_%d", i);
+		switch_snprintf(value, sizeof(value), "the value of variable %d", i);
+		switch_channel_set_variable(channel, name, value);
+	}
+
+	ctx->sparam = "";
+	for (i = 0; i < ctx->param; i++) {
+		ctx->sparam = switch_core_sprintf(ctx->pool, "%sprefix ${bench_var_%d} ", ctx->sparam, (i * 17) % 64);
+	}
+
+	ctx->data = session;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void teardown_channel(bench_ctx_t *ctx)
+{
+	switch_core_session_t *session = ctx->data;
+
+	switch_core_session_destroy(&session);
+}
+
+static void run_expand_variables(bench_ctx_t *ctx)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(ctx->data);
+	char *str;
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		str = switch_channel_expand_variables(channel, ctx->sparam);
+		sink += (uintptr_t) str;
+		if (str != ctx->sparam) {
+			free(str);
+		}
+	}
+}
+
+static switch_status_t setup_xml(bench_ctx_t *ctx)
+{
+	switch_stream_handle_t stream = { 0 };
+	int i;
+
+	SWITCH_STANDARD_STREAM(stream);
+
+	stream.write_function(&stream, "<document type=\"freeswitch/xml\">\n<section name=\"directory\">\n<domain name=\"example.com\">\n<users>\n");
+	for (i = 0; i < ctx->param; i++) {
+		stream.write_function(&stream, "<user id=\"%d\">\n<params>\n<param name=\"password\" value=\"secret%d\"/>\n"
+							  "<param name=\"vm-password\" value=\"%d\"/>\n</params>\n<variables>\n"
+							  "<variable name=\"effective_caller_id_name\" value=\"Extension %d\"/>\n"
+							  "<variable name=\"user_context\" value=\"default\"/>\n</variables>\n</user>\n", i, i, i, i);
+	}
+	stream.write_function(&stream, "</users>\n</domain>\n</section>\n</document>\n");
+
+	ctx->sparam = switch_core_strdup(ctx->pool, stream.data);
+	free(stream.data);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void run_xml_parse(bench_ctx_t *ctx)
+{
+	switch_xml_t xml;
+	uint32_t i;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		if ((xml = switch_xml_parse_str_dynamic((char *) ctx->sparam, SWITCH_TRUE))) {
+			switch_xml_free(xml);
+		}
+	}
+}
+
+typedef struct {
+	switch_codec_t codec;
+	int16_t pcm[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	uint8_t encoded[SWITCH_RECOMMENDED_BUFFER_SIZE];
+	uint32_t encoded_len;
+	uint32_t pcm_bytes;
+	uint32_t rate;
+} codec_data_t;
+
+static switch_status_t setup_codec(bench_ctx_t *ctx)
+{
+	codec_data_t *cd = switch_core_alloc(ctx->pool, sizeof(*cd));
+	uint32_t i, samples, flags = 0, rate;
+
+	if (switch_core_codec_init(&cd->codec, ctx->sparam, NULL, 0, 20, 1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE,
+							   NULL, ctx->pool) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	cd->rate = cd->codec.implementation->actual_samples_per_second;
+	samples = cd->codec.implementation->decoded_bytes_per_packet / 2;
+	cd->pcm_bytes = samples * 2;
+
+	for (i = 0; i < samples; i++) {
+		cd->pcm[i] = (int16_t) ((i * 1237) % 16000 - 8000);
+	}
+
+	cd->encoded_len = sizeof(cd->encoded);
+	rate = cd->rate;
+	switch_core_codec_encode(&cd->codec, NULL, cd->pcm, cd->pcm_bytes, cd->rate, cd->encoded, &cd->encoded_len, &rate, &flags);
+
+	ctx->data = cd;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void teardown_codec(bench_ctx_t *ctx)
+{
+	codec_data_t *cd = ctx->data;
+
+	switch_core_codec_destroy(&cd->codec);
+}
+
+static void run_codec_encode(bench_ctx_t *ctx)
+{
+	codec_data_t *cd = ctx->data;
+	uint8_t out[SWITCH_RECOMMENDED_BUFFER_SIZE];
+	uint32_t i, len, rate, flags;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		len = sizeof(out), rate = cd->rate, flags = 0;
+		switch_core_codec_encode(&cd->codec, NULL, cd->pcm, cd->pcm_bytes, cd->rate, out, &len, &rate, &flags);
+		sink += len;
+	}
+}
+
+static void run_codec_decode(bench_ctx_t *ctx)
+{
+	codec_data_t *cd = ctx->data;
+	int16_t out[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	uint32_t i, len, rate, flags;
+
+	for (i = 0; i < ctx->iterations; i++) {
+		len = sizeof(out), rate = cd->rate, flags = 0;
+		switch_core_codec_decode(&cd->codec, NULL, cd->encoded, cd->encoded_len, cd->rate, out, &len, &rate, &flags);
+		sink += len;
+	}
+}
+
+static bench_def_t benches[] = {
+	{"event_create", NULL, run_event_create, NULL},
+	{"event_serialize", setup_event, run_event_serialize, teardown_event},
+	{"event_serialize_json", setup_event, run_event_serialize_json, teardown_event},
+	{"event_dup", setup_event, run_event_dup, teardown_event},
+	{"hash_insert", setup_hash, run_hash_insert, teardown_hash},
+	{"hash_find", setup_hash, run_hash_find, teardown_hash},
+	{"hash_find_miss", setup_hash, run_hash_miss, teardown_hash},
+	{"regex_perform", NULL, run_regex_perform, NULL},
+	{"separate_string", NULL, run_separate_string, NULL},
+	{"separate_string_span", NULL, run_separate_string_span, NULL},
+	{"expand_variables", setup_channel, run_expand_variables, teardown_channel},
+	{"xml_parse_str", setup_xml, run_xml_parse, NULL},
+	{"codec_encode", setup_codec, run_codec_encode, teardown_codec},
+	{"codec_decode", setup_codec, run_codec_decode, teardown_codec},
+	{NULL}
+};
+
+/* the parameters each benchmark is run with unless -p is given */
+static const char *default_params(const char *name)
+{
+	if (!strncmp(name, "event_", 6)) {
+		return "10,50";
+	} else if (!strncmp(name, "hash_", 5)) {
+		return "1000,100000";
+	} else if (!strcmp(name, "regex_perform") || !strncmp(name, "separate_string", 15)) {
+		return "0,1,2";
+	} else if (!strcmp(name, "expand_variables")) {
+		return "1,10";
+	} else if (!strcmp(name, "xml_parse_str")) {
+		return "10,1000";
+	} else if (!strncmp(name, "codec_", 6)) {
+		return "PCMU,PCMA,L16";
+	}
+
+	return "0";
+}
+
+static int cmp_time(const void *a, const void *b)
+{
+	switch_time_t x = *(const switch_time_t *) a, y = *(const switch_time_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int bench_one(bench_def_t *def, const char *param, uint32_t iterations, int repeats, int json, int *first)
+{
+	bench_ctx_t ctx = { 0 };
+	switch_time_t times[MAX_REPEATS], start;
+	double best, median;
+	int r;
+
+	switch_core_new_memory_pool(&ctx.pool);
+	ctx.iterations = iterations;
+	ctx.param = atoi(param);
+	ctx.sparam = param;
+
+	if (def->setup && def->setup(&ctx) != SWITCH_STATUS_SUCCESS) {
+		fprintf(stderr, "%s: cannot set up with %s, skipped\n", def->name, param);
+		switch_core_destroy_memory_pool(&ctx.pool);
+		return -1;
+	}
+
+	if (!strncmp(def->name, "hash_", 5) && ctx.param < 1) {
+		ctx.param = 1;
+	}
+
+	/* one untimed pass to warm the caches and allocators */
+	ctx.iterations = iterations / 10 ? iterations / 10 : 1;
+	def->run(&ctx);
+	ctx.iterations = iterations;
+
+	for (r = 0; r < repeats; r++) {
+		start = switch_time_ref();
+		def->run(&ctx);
+		times[r] = switch_time_ref() - start;
+	}
+
+	if (def->teardown) {
+		def->teardown(&ctx);
+	}
+
+	switch_core_destroy_memory_pool(&ctx.pool);
+
+	qsort(times, repeats, sizeof(times[0]), cmp_time);
+	best = (double) times[0] * 1000 / iterations;
+	median = (double) times[repeats / 2] * 1000 / iterations;
+
+	if (json) {
+		printf("%s\n  {\"name\": \"%s\", \"param\": \"%s\", \"iterations\": %u, \"repeats\": %d, "
+			   "\"best_ns_per_op\": %.1f, \"median_ns_per_op\": %.1f, \"ops_per_sec\": %.0f}",
+			   *first ? "" : ",", def->name, param, iterations, repeats, best, median, best > 0 ? 1000000000 / best : 0);
+	} else {
+		printf("%s\t%s\t%u\t%d\t%.1f\t%.1f\t%.0f\n", def->name, param, iterations, repeats, best, median, best > 0 ? 1000000000 / best : 0);
+	}
+
+	fflush(stdout);
+	*first = 0;
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int r = 1;
+	switch_bool_t verbose = SWITCH_FALSE;
+	const char *err = NULL;
+	int i, p;
+	char *extra_modules[100] = { 0 };
+	int extra_modules_count = 0;
+	int cmd_fail = 0;
+	uint32_t iterations = 100000;
+	int repeats = 5;
+	int json = 0, first = 1;
+	const char *filter = NULL, *params = NULL;
+	bench_def_t *def;
+
+	for (i = 1; i < argc; i++) {
+		if (argv[i][0] == '-' && i + 1 < argc) {
+			switch (argv[i][1]) {
+			case 'l':
+				i++;
+				/* Load extra modules */
+				if (strchr(argv[i], ',')) {
+					extra_modules_count = switch_split(argv[i], ',', extra_modules);
+				} else {
+					extra_modules_count = 1;
+					extra_modules[0] = argv[i];
+				}
+				break;
+			case 'n':
+				iterations = atoi(argv[++i]);
+				break;
+			case 'r':
+				repeats = atoi(argv[++i]);
+				break;
+			case 'p':
+				params = argv[++i];
+				break;
+			case 'o':
+				json = !strcasecmp(argv[++i], "json");
+				break;
+			default:
+				printf("Command line option not recognized: %s\n", argv[i]);
+				cmd_fail = 1;
+			}
+		} else if (!strcmp(argv[i], "-v")) {
+			verbose = SWITCH_TRUE;
+		} else if (argv[i][0] != '-') {
+			filter = argv[i];
+		} else {
+			cmd_fail = 1;
+		}
+	}
+
+	if (cmd_fail || !iterations || repeats < 1 || repeats > MAX_REPEATS) {
+		goto usage;
+	}
+
+	if (switch_core_init(SCF_MINIMAL, verbose, &err) != SWITCH_STATUS_SUCCESS) {
+		fprintf(stderr, "Cannot init core [%s]\n", err);
+		goto end;
+	}
+
+	switch_loadable_module_init(SWITCH_FALSE);
+
+	for (i = 0; i < extra_modules_count; i++) {
+		if (switch_loadable_module_load_module((char *) SWITCH_GLOBAL_dirs.mod_dir, (char *) extra_modules[i], SWITCH_TRUE, &err) != SWITCH_STATUS_SUCCESS) {
+			fprintf(stderr, "Cannot init %s [%s]\n", extra_modules[i], err);
+			goto end;
+		}
+	}
+
+	if (json) {
+		printf("{\"version\": \"%s\", \"cpus\": %u, \"results\": [", SWITCH_VERSION_FULL, switch_core_cpu_count());
+	} else {
+		printf("# FreeSWITCH %s, %u cpus\n", SWITCH_VERSION_FULL, switch_core_cpu_count());
+		printf("name\tparam\titerations\trepeats\tbest_ns_per_op\tmedian_ns_per_op\tops_per_sec\n");
+	}
+
+	for (def = benches; def->name; def++) {
+		char *list, *pv[32] = { 0 };
+		int pc;
+
+		if (filter && !strstr(def->name, filter)) {
+			continue;
+		}
+
+		list = strdup(params ? params : default_params(def->name));
+		pc = switch_separate_string(list, ',', pv, (sizeof(pv) / sizeof(pv[0])));
+
+		for (p = 0; p < pc; p++) {
+			bench_one(def, pv[p], iterations, repeats, json, &first);
+		}
+
+		free(list);
+	}
+
+	if (json) {
+		printf("\n]}\n");
+	}
+
+	r = 0;
+	goto end;
+
+  usage:
+	printf("Usage: %s [options] [benchmark]\n\n", argv[0]);
+	printf("Times core primitives, only running the benchmarks whose name contains [benchmark].\n\n");
+	printf("\t\t -n iterations\t\t Operations per timed run (default 100000)\n");
+	printf("\t\t -r repeats\t\t Timed runs per benchmark, best and median are reported (default 5)\n");
+	printf("\t\t -p p1,p2\t\t Parameters to run with instead of each benchmark's defaults\n");
+	printf("\t\t -o tsv|json\t\t Output format (default tsv)\n");
+	printf("\t\t -l module[,module]\t Load additional modules (comma-separated), e.g. for more codecs\n");
+	printf("\t\t -v\t\t\t Verbose\n\n");
+	printf("Benchmarks:");
+	for (def = benches; def->name; def++) {
+		printf(" %s", def->name);
+	}
+	printf("\n");
+	r = 1;
+
+  end:
+
+	switch_core_destroy();
+
+	return r;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -76,6 +76,111 @@ static const uint8_t alaw_to_ulaw_table[256] = {
 	214, 215, 212, 213, 218, 219, 216, 217, 207, 207, 206, 206, 210, 211, 208, 209
 };
 
+/*
+ * Block conversion tables.  u-law only ever looks at the magnitude above bit 2 and A-law above bit 4, so
+ * an 8K and a 2K table give bit exact results without the per sample branch and bit scan.
+ */
+static uint8_t ulaw_mag_table[8193];
+static uint8_t alaw_mag_table[2048];
+static int16_t ulaw_lin_table[256];
+static int16_t alaw_lin_table[256];
+static volatile int g711_tables_ready = 0;
+
+void g711_init_tables(void)
+{
+	int i;
+
+	if (g711_tables_ready)
+		return;
+
+	for (i = 0; i <= 8192; i++)
+		ulaw_mag_table[i] = linear_to_ulaw(i << 2) ^ 0xFF;
+	for (i = 0; i < 2048; i++)
+		alaw_mag_table[i] = linear_to_alaw(i << 4) ^ (ALAW_AMI_MASK | 0x80);
+	for (i = 0; i < 256; i++) {
+		ulaw_lin_table[i] = ulaw_to_linear((uint8_t) i);
+		alaw_lin_table[i] = alaw_to_linear((uint8_t) i);
+	}
+
+	g711_tables_ready = 1;
+}
+
+/*- End of function --------------------------------------------------------*/
+
+void linear_to_ulaw_block(uint8_t *ulaw, const int16_t *linear, int samples)
+{
+	int i;
+
+	if (!g711_tables_ready) {
+		for (i = 0; i < samples; i++)
+			ulaw[i] = linear_to_ulaw(linear[i]);
+		return;
+	}
+
+	for (i = 0; i < samples; i++) {
+		int l = linear[i];
+		int m = (l < 0) ? -l : l;
+
+		ulaw[i] = ulaw_mag_table[m >> 2] ^ ((l < 0) ? 0x7F : 0xFF);
+	}
+}
+
+/*- End of function --------------------------------------------------------*/
+
+void ulaw_to_linear_block(int16_t *linear, const uint8_t *ulaw, int samples)
+{
+	int i;
+
+	if (!g711_tables_ready) {
+		for (i = 0; i < samples; i++)
+			linear[i] = ulaw_to_linear(ulaw[i]);
+		return;
+	}
+
+	for (i = 0; i < samples; i++)
+		linear[i] = ulaw_lin_table[ulaw[i]];
+}
+
+/*- End of function --------------------------------------------------------*/
+
+void linear_to_alaw_block(uint8_t *alaw, const int16_t *linear, int samples)
+{
+	int i;
+
+	if (!g711_tables_ready) {
+		for (i = 0; i < samples; i++)
+			alaw[i] = linear_to_alaw(linear[i]);
+		return;
+	}
+
+	for (i = 0; i < samples; i++) {
+		int l = linear[i];
+		int m = (l < 0) ? -l - 8 : l;
+		int mask = (l < 0) ? ALAW_AMI_MASK : (ALAW_AMI_MASK | 0x80);
+
+		/* -1 to -7 come out as the smallest negative step */
+		alaw[i] = (uint8_t) (((m < 0) ? 0 : alaw_mag_table[m >> 4]) ^ mask);
+	}
+}
+
+/*- End of function --------------------------------------------------------*/
+
+void alaw_to_linear_block(int16_t *linear, const uint8_t *alaw, int samples)
+{
+	int i;
+
+	if (!g711_tables_ready) {
+		for (i = 0; i < samples; i++)
+			linear[i] = alaw_to_linear(alaw[i]);
+		return;
+	}
+
+	for (i = 0; i < samples; i++)
+		linear[i] = alaw_lin_table[alaw[i]];
+}
+
+/*- End of function --------------------------------------------------------*/
+
 uint8_t alaw_to_ulaw(uint8_t alaw)
 {
 	return alaw_to_ulaw_table[alaw];
@@ -333,6 +333,22 @@ extern "C" {
 */
 	uint8_t ulaw_to_alaw(uint8_t ulaw);
 
+/*! \brief Build the tables used by the block routines, call once before any other thread uses them.
+           Until then the block routines fall back to the per sample ones. */
+	void g711_init_tables(void);
+
+/*! \brief Encode a block of linear samples to u-law, bit exact with linear_to_ulaw() */
+	void linear_to_ulaw_block(uint8_t *ulaw, const int16_t *linear, int samples);
+
+/*! \brief Decode a block of u-law samples to linear */
+	void ulaw_to_linear_block(int16_t *linear, const uint8_t *ulaw, int samples);
+
+/*! \brief Encode a block of linear samples to A-law, bit exact with linear_to_alaw() */
+	void linear_to_alaw_block(uint8_t *alaw, const int16_t *linear, int samples);
+
+/*! \brief Decode a block of A-law samples to linear */
+	void alaw_to_linear_block(int16_t *linear, const uint8_t *alaw, int samples);
+
 #ifdef __cplusplus
 }
 #endif
@@ -102,6 +102,34 @@ typedef enum {
 } switch_session_flag_t;
 
 
+typedef struct {
+	switch_time_t timestamp;
+	uint16_t type;
+	uint32_t a;
+	uint32_t b;
+	uint32_t c;
+	char str[16];
+} switch_session_trace_record_t;
+
+/* fixed size, always on flight recorder, see switch_core_session_trace() */
+typedef struct {
+	switch_mutex_t *mutex;
+	uint32_t size;
+	uint32_t count;
+	switch_session_trace_record_t records[1];
+} switch_session_trace_ring_t;
+
+/* a decoded frame converted to the rate some tap bugs asked for, made once per frame and shared by all of them */
+#define SWITCH_TAP_RATES 2
+
+typedef struct switch_tap_frame_s {
+	uint32_t from_rate;
+	uint32_t rate;
+	uint32_t gen;
+	switch_audio_resampler_t *resampler;
+	switch_frame_t frame;
+} switch_tap_frame_t;
+
 struct switch_core_session {
 	switch_memory_pool_t *pool;
 	switch_thread_t *thread;
@@ -127,6 +155,14 @@ struct switch_core_session {
 
 	switch_audio_resampler_t *read_resampler;
 	switch_audio_resampler_t *write_resampler;
+	/* resamplers parked by a NOOP frame, picked up again if the next RESAMPLE frame has the same rates */
+	switch_audio_resampler_t *read_resampler_idle;
+	switch_audio_resampler_t *write_resampler_idle;
+	/* heap allocations made by the read/write frame paths, flat once media is flowing */
+	uint32_t io_allocs;
+	/* [0] read [1] write, guarded by the codec read/write mutex of that direction */
+	switch_tap_frame_t tap_frames[2][SWITCH_TAP_RATES];
+	uint32_t tap_gen[2];
 
 	switch_mutex_t *mutex;
 	switch_mutex_t *resample_mutex;
@@ -143,11 +179,11 @@ struct switch_core_session {
 
 	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
 	void *private_info;
-	switch_queue_t *event_queue;
-	switch_queue_t *message_queue;
+	switch_mpsc_queue_t *event_queue;
+	switch_mpsc_queue_t *message_queue;
 	switch_queue_t *signal_data_queue;
-	switch_queue_t *private_event_queue;
-	switch_queue_t *private_event_queue_pri;
+	switch_mpsc_queue_t *private_event_queue;
+	switch_mpsc_queue_t *private_event_queue_pri;
 	switch_thread_rwlock_t *bug_rwlock;
 	switch_media_bug_t *bugs;
 	switch_app_log_t *app_log;
@@ -174,11 +210,18 @@ struct switch_core_session {
 	plc_state_t *plc;
 	uint8_t recur_buffer[SWITCH_RECOMMENDED_BUFFER_SIZE];
 	switch_size_t recur_buffer_len;
+	switch_session_trace_ring_t *trace;
+	switch_time_t created;
+	uint32_t phases;
+	/* media-latency-probe, ingress to egress time of written frames in 1ms buckets */
+	uint32_t *latency_hist;
+	uint32_t latency_count;
+	switch_time_t latency_max;
 };
 
 struct switch_media_bug {
-	switch_buffer_t *raw_write_buffer;
-	switch_buffer_t *raw_read_buffer;
+	switch_ringbuffer_t *raw_write_buffer;
+	switch_ringbuffer_t *raw_read_buffer;
 	switch_frame_t *read_replace_frame_in;
 	switch_frame_t *read_replace_frame_out;
 	switch_frame_t *write_replace_frame_in;
@@ -203,6 +246,11 @@ struct switch_media_bug {
 	uint32_t record_pre_buffer_max;
 	switch_frame_t *ping_frame;
 	switch_frame_t *read_demux_frame;
+	switch_frame_t *native_read_frame;
+	switch_frame_t *native_write_frame;
+	switch_frame_t *tap_read_frame;
+	switch_frame_t *tap_write_frame;
+	uint32_t tap_rate;
 	struct switch_media_bug *next;
 };
 
@@ -221,6 +269,8 @@ struct switch_runtime {
 	switch_memory_pool_t *memory_pool;
 	const switch_state_handler_table_t *state_handlers[SWITCH_MAX_STATE_HANDLERS];
 	int state_handler_index;
+	/* per state, the global handlers that implement it in registration order, NULL terminated */
+	switch_state_handler_t state_dispatch[SWITCH_SHN_ON_DESTROY + 1][SWITCH_MAX_STATE_HANDLERS + 1];
 	FILE *console;
 	uint8_t running;
 	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
@@ -252,9 +302,14 @@ struct switch_runtime {
 	uint32_t tipping_point;
 	uint32_t microseconds_per_tick;
 	int32_t timer_affinity;
+	int32_t timer_shards;
+	struct switch_thread_affinity *thread_affinity[SWITCH_THREAD_ROLE_MAX];
 	switch_profile_timer_t *profile_timer;
 	double profile_time;
 	double min_idle_time;
+	uint32_t component_load;
+	char component_load_name[64];
+	uint32_t max_component_load;
 	int sql_buffer_len;
 	int max_sql_buffer_len;
 	switch_dbtype_t odbc_dbtype;
@@ -269,17 +324,48 @@ struct switch_runtime {
 	char *core_db_post_trans_execute;
 	char *core_db_inner_pre_trans_execute;
 	char *core_db_inner_post_trans_execute;
+	uint32_t event_stats_interval;
+	int core_db_channels;
+	uint32_t regex_cache_size;
+	int sched_threads;
+	switch_slab_t *frame_slab;
+	switch_slab_t *message_slab;
+	uint32_t pool_recycle_max;
+	uint32_t pool_recycle_max_free;
+	uint32_t pool_prewarm;
+	switch_bool_t pool_accounting;
+	uint32_t session_trace_size;
+	switch_session_trace_dump_t session_trace_dump;
+	switch_size_t file_cache_size;
+	switch_size_t file_cache_max_file;
+	switch_bool_t file_cache_native;
+	uint32_t speech_pool_size;
+	switch_bool_t tts_cache;
+	char *tts_cache_dir;
+	uint32_t file_io_threads;
+	uint32_t dns_cache_ttl;
+	uint32_t dns_negative_ttl;
+	uint32_t dns_cache_stale;
+	switch_size_t file_io_depth;
+	switch_size_t file_io_write_chunk;
+	switch_bool_t file_io_fsync;
+	uint32_t codec_offload_threads;
+	uint32_t codec_offload_batch;
+	char *codec_offload_codecs;
 };
 
 extern struct switch_runtime runtime;
 
+void switch_core_sample_load_sources(void);
+
 
 struct switch_session_manager {
 	switch_memory_pool_t *memory_pool;
-	switch_hash_t *session_table;
+	switch_striped_hash_t *session_table;
 	uint32_t session_count;
 	uint32_t session_limit;
 	switch_size_t session_id;
+	switch_metric_t *io_allocs;
 };
 
 extern struct switch_session_manager session_manager;
@@ -289,7 +375,23 @@ extern struct switch_session_manager session_manager;
 switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_t manage);
 void switch_core_sqldb_stop(void);
 void switch_core_session_init(switch_memory_pool_t *pool);
+void switch_regex_init(switch_memory_pool_t *pool);
+void switch_regex_shutdown(void);
+void switch_core_file_cache_init(switch_memory_pool_t *pool);
+void switch_core_file_cache_shutdown(void);
+void switch_core_speech_pool_init(switch_memory_pool_t *pool);
+void switch_core_speech_pool_shutdown(void);
+void switch_resample_init(switch_memory_pool_t *pool);
+void switch_resample_shutdown(void);
+void switch_core_file_io_init(void);
+void switch_core_file_io_shutdown(void);
+void switch_core_codec_offload_init(void);
+void switch_core_codec_offload_shutdown(void);
 void switch_core_session_uninit(void);
 void switch_core_state_machine_init(switch_memory_pool_t *pool);
 switch_memory_pool_t *switch_core_memory_init(void);
 void switch_core_memory_stop(void);
+void switch_core_memory_metrics(switch_stream_handle_t *stream, void *user_data);
+void switch_core_memory_prewarm(uint32_t count);
+void switch_core_intern_init(switch_memory_pool_t *pool);
+void switch_core_session_latency_report(switch_core_session_t *session);
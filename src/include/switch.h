@@ -137,6 +137,9 @@
 #include "switch_odbc.h"
 #include "switch_json.h"
 #include "switch_limit.h"
+#include "switch_metrics.h"
+#include "switch_prefix.h"
+#include "switch_snapshot.h"
 
 #include <libteletone.h>
 
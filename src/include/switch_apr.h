@@ -722,6 +722,56 @@ SWITCH_DECLARE(switch_status_t) switch_queue_trypush(switch_queue_t *queue, void
 
 /** @} */
 
+/**
+ * @defgroup switch_mpsc_queue Intrusive lock free queues
+ * @ingroup switch_apr
+ * Producers push without taking a lock, the link lives in the object being queued so a queue needs no slots and no
+ * conditions.  Pops are meant for one consumer at a time, a pop that races another pop just reports the queue empty.
+ * @{
+ */
+
+/** The link an object embeds to go on a queue, an object can only be on one queue at a time */
+	 typedef struct switch_mpsc_node {
+		 struct switch_mpsc_node *volatile next;
+		 void *data;
+	 } switch_mpsc_node_t;
+
+/** Opaque structure used for the lock free queue API */
+	 typedef struct switch_mpsc_queue switch_mpsc_queue_t;
+
+/**
+ * create a lock free queue
+ *
+ * @param queue The new queue
+ * @param capacity pushes fail once this many objects are queued, like a full switch_queue_t
+ * @param pool a pool to allocate the queue from
+ */
+SWITCH_DECLARE(switch_status_t) switch_mpsc_queue_create(switch_mpsc_queue_t **queue, uint32_t capacity, switch_memory_pool_t *pool);
+
+/**
+ * push an object, safe from any number of threads
+ *
+ * @param queue the queue
+ * @param node the link inside the object
+ * @param data what the pop hands back, usually the object itself
+ * @returns SWITCH_STATUS_FALSE when the queue is full
+ */
+SWITCH_DECLARE(switch_status_t) switch_mpsc_queue_trypush(switch_mpsc_queue_t *queue, switch_mpsc_node_t *node, void *data);
+
+/**
+ * pop the oldest object without waiting
+ *
+ * @param queue the queue
+ * @param data the data given to the push
+ * @returns SWITCH_STATUS_FALSE when the queue is empty, a push is half way through or another pop is running
+ */
+SWITCH_DECLARE(switch_status_t) switch_mpsc_queue_trypop(switch_mpsc_queue_t *queue, void **data);
+
+/** number of objects queued, a plain atomic read */
+SWITCH_DECLARE(uint32_t) switch_mpsc_queue_size(switch_mpsc_queue_t *queue);
+
+/** @} */
+
 /**
  * @defgroup switch_file_io File I/O Handling Functions
  * @ingroup switch_apr 
@@ -1148,6 +1198,14 @@ SWITCH_DECLARE(int32_t) switch_sockaddr_get_family(switch_sockaddr_t *sa);
 SWITCH_DECLARE(switch_status_t) switch_sockaddr_ip_get(char **addr, switch_sockaddr_t *sa);
 SWITCH_DECLARE(int) switch_sockaddr_equal(const switch_sockaddr_t *sa1, const switch_sockaddr_t *sa2);
 
+/**
+ * Fill in a switch_sockaddr_t from a native struct sockaddr
+ * @param sa The address to fill in
+ * @param native The native (struct sockaddr_in / sockaddr_in6) address
+ * @param len The length of the native address
+ */
+SWITCH_DECLARE(switch_status_t) switch_sockaddr_set_native(switch_sockaddr_t *sa, const void *native, switch_size_t len);
+
 
 /**
  * Create apr_sockaddr_t from hostname, address family, and port.
@@ -1196,6 +1254,25 @@ SWITCH_DECLARE(switch_status_t) switch_sockaddr_create(switch_sockaddr_t **sa, s
  */
 SWITCH_DECLARE(switch_status_t) switch_socket_send(switch_socket_t *sock, const char *buf, switch_size_t *len);
 
+/** A buffer to hand to switch_socket_sendv() */
+	 typedef struct switch_io_vec {
+		 const char *base;
+		 switch_size_t len;
+	 } switch_io_vec_t;
+
+#define SWITCH_IO_VEC_MAX 64
+
+/**
+ * Send several buffers over a network with as few system calls as possible.
+ * @param sock The socket to send the data over.
+ * @param vec The buffers to send, at most SWITCH_IO_VEC_MAX of them.
+ * @param nvec The number of buffers in vec.
+ * @param len On exit, the number of bytes sent.
+ * @remark Like switch_socket_send() this keeps writing until everything is sent
+ *         or the socket fails, even on a non-blocking socket.
+ */
+SWITCH_DECLARE(switch_status_t) switch_socket_sendv(switch_socket_t *sock, const switch_io_vec_t *vec, int32_t nvec, switch_size_t *len);
+
 /**
  * @param sock The socket to send from
  * @param where The apr_sockaddr_t describing where to send the data
@@ -1445,6 +1522,13 @@ SWITCH_DECLARE(switch_status_t) switch_socket_create_pollfd(switch_pollfd_t **po
 SWITCH_DECLARE(switch_status_t) switch_match_glob(const char *pattern, switch_array_header_t ** result, switch_memory_pool_t *p);
 SWITCH_DECLARE(switch_status_t) switch_socket_addr_get(switch_sockaddr_t ** sa, switch_bool_t remote, switch_socket_t *sock);
 
+/**
+ * Get the native OS descriptor behind a socket
+ * @param sock The socket
+ * @return the descriptor or -1 on failure
+ */
+SWITCH_DECLARE(int) switch_socket_fd_get(switch_socket_t *sock);
+
 /**
  * Create an anonymous pipe.
  * @param in The file descriptor to use as input to the pipe.
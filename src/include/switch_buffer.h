@@ -160,6 +160,99 @@ SWITCH_DECLARE(switch_size_t) switch_buffer_zwrite(_In_ switch_buffer_t *buffer,
 
 /** @} */
 
+/**
+ * @defgroup switch_ringbuffer Lock-free Ring Buffer Routines
+ * @ingroup core1
+ * A fixed size single-producer/single-consumer byte ring for media paths where one thread
+ * writes and exactly one other thread reads.  The writer only ever moves the head and the
+ * reader only ever moves the tail so neither side takes a lock.  All write calls must come
+ * from the same thread and all read, toss and zero calls must come from the same thread.
+ * @{
+ */
+
+/*! \brief Allocate a new switch_ringbuffer
+ * \param ringbuffer returned pointer to the new ring buffer
+ * \param size requested capacity in bytes (rounded up to the next power of two)
+ * \return status
+ */
+SWITCH_DECLARE(switch_status_t) switch_ringbuffer_create(_Out_ switch_ringbuffer_t **ringbuffer, _In_ switch_size_t size);
+
+/*! \brief Destroy a switch_ringbuffer
+ * \param ringbuffer the ring buffer to destroy
+ */
+SWITCH_DECLARE(void) switch_ringbuffer_destroy(switch_ringbuffer_t **ringbuffer);
+
+/*! \brief Get the capacity of a switch_ringbuffer_t
+ * \param ringbuffer any ring buffer of type switch_ringbuffer_t
+ * \return size of the ring buffer
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_len(_In_ switch_ringbuffer_t *ringbuffer);
+
+/*! \brief Get the in use amount of a switch_ringbuffer_t (safe from either side)
+ * \param ringbuffer any ring buffer of type switch_ringbuffer_t
+ * \return ammount of ring buffer curently in use
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_inuse(_In_ switch_ringbuffer_t *ringbuffer);
+
+/*! \brief Get the freespace of a switch_ringbuffer_t (safe from either side)
+ * \param ringbuffer any ring buffer of type switch_ringbuffer_t
+ * \return freespace in the ring buffer
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_freespace(_In_ switch_ringbuffer_t *ringbuffer);
+
+/*! \brief Write data into a switch_ringbuffer_t (producer side)
+ * \param ringbuffer any ring buffer of type switch_ringbuffer_t
+ * \param data pointer to the data to be written
+ * \param datalen amount of data to be written
+ * \return datalen on success or 0 if there was not enough room for all of it
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_write(_In_ switch_ringbuffer_t *ringbuffer, _In_bytecount_(datalen) const void *data, _In_ switch_size_t datalen);
+
+/*! \brief Read data from a switch_ringbuffer_t up to the ammount of datalen if it is available (consumer side)
+ * \param ringbuffer any ring buffer of type switch_ringbuffer_t
+ * \param data pointer to the read data to be returned
+ * \param datalen amount of data to be returned
+ * \return ammount of data actually read
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_read(_In_ switch_ringbuffer_t *ringbuffer, _In_ void *data, _In_ switch_size_t datalen);
+
+/*! \brief Get a pointer to the contiguous readable region without copying (consumer side)
+ * \param ringbuffer any ring buffer of type switch_ringbuffer_t
+ * \param ptr returned pointer to the oldest unread byte
+ * \return number of bytes readable at ptr before the ring wraps
+ * \note call switch_ringbuffer_toss() with the number of bytes consumed when done
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_peek_zerocopy(_In_ switch_ringbuffer_t *ringbuffer, _Out_ const void **ptr);
+
+/*! \brief Discard datalen bytes from the read side of a switch_ringbuffer_t (consumer side)
+ * \param ringbuffer any ring buffer of type switch_ringbuffer_t
+ * \param datalen amount of data to discard
+ * \return ammount of data actually discarded
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_toss(_In_ switch_ringbuffer_t *ringbuffer, _In_ switch_size_t datalen);
+
+/*! \brief Get a pointer to the contiguous writable region without copying (producer side)
+ * \param ringbuffer any ring buffer of type switch_ringbuffer_t
+ * \param ptr returned pointer to the first free byte
+ * \return number of bytes writable at ptr before the ring wraps
+ * \note call switch_ringbuffer_commit() with the number of bytes produced when done
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_reserve_zerocopy(_In_ switch_ringbuffer_t *ringbuffer, _Out_ void **ptr);
+
+/*! \brief Publish datalen bytes written through switch_ringbuffer_reserve_zerocopy() (producer side)
+ * \param ringbuffer any ring buffer of type switch_ringbuffer_t
+ * \param datalen amount of data produced
+ * \return ammount of data actually published
+ */
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_commit(_In_ switch_ringbuffer_t *ringbuffer, _In_ switch_size_t datalen);
+
+/*! \brief Remove all data from a switch_ringbuffer_t (consumer side)
+ * \param ringbuffer any ring buffer of type switch_ringbuffer_t
+ */
+SWITCH_DECLARE(void) switch_ringbuffer_zero(_In_ switch_ringbuffer_t *ringbuffer);
+
+/** @} */
+
 SWITCH_END_EXTERN_C
 #endif
 /* For Emacs:
@@ -273,6 +273,11 @@ SWITCH_DECLARE(const char *) switch_channel_get_hold_music_partner(switch_channe
 
 SWITCH_DECLARE(uint32_t) switch_channel_del_variable_prefix(switch_channel_t *channel, const char *prefix);
 
+/*!
+  \brief Add or remove all of a channel's indexed variables to or from the session variable index under a uuid
+*/
+SWITCH_DECLARE(void) switch_channel_index_variables(switch_channel_t *channel, const char *uuid, switch_bool_t add);
+
 #define switch_channel_set_variable_safe(_channel, _var, _val) switch_channel_set_variable_var_check(_channel, _var, _val, SWITCH_FALSE)
 #define switch_channel_set_variable(_channel, _var, _val) switch_channel_set_variable_var_check(_channel, _var, _val, SWITCH_TRUE)
 #define switch_channel_set_variable_partner(_channel, _var, _val) switch_channel_set_variable_partner_var_check(_channel, _var, _val, SWITCH_TRUE)
@@ -596,6 +601,16 @@ SWITCH_DECLARE(void) switch_channel_event_set_extended_data(_In_ switch_channel_
 SWITCH_DECLARE(char *) switch_channel_expand_variables_check(switch_channel_t *channel, const char *in, switch_event_t *var_list, switch_event_t *api_list, uint32_t recur);
 #define switch_channel_expand_variables(_channel, _in) switch_channel_expand_variables_check(_channel, _in, NULL, NULL, 0)
 
+/*!
+  \brief Expand a template compiled with switch_expand_template_create against a channel, same rules as switch_channel_expand_variables_check
+  \param channel channel to expand the variables from
+  \param tpl the compiled template
+  \return the template source if nothing needs expanding, otherwise a new string that must be freed
+  \note test the return val against switch_expand_template_get_source(tpl) and free the string if it is not the same.
+*/
+SWITCH_DECLARE(char *) switch_channel_expand_template_check(switch_channel_t *channel, switch_expand_template_t *tpl, switch_event_t *var_list, switch_event_t *api_list);
+#define switch_channel_expand_template(_channel, _tpl) switch_channel_expand_template_check(_channel, _tpl, NULL, NULL)
+
 
 SWITCH_DECLARE(char *) switch_channel_build_param_string(_In_ switch_channel_t *channel, _In_opt_ switch_caller_profile_t *caller_profile,
 														 _In_opt_ const char *prefix);
@@ -643,6 +658,31 @@ SWITCH_DECLARE(switch_caller_extension_t *) switch_channel_get_queued_extension(
 SWITCH_DECLARE(void) switch_channel_transfer_to_extension(switch_channel_t *channel, switch_caller_extension_t *caller_extension);
 SWITCH_DECLARE(const char *) switch_channel_get_partner_uuid(switch_channel_t *channel);
 
+/*!
+  \brief Create a waiter that channels signal whenever their state or flags change
+  \param waiter the new waiter
+  \param pool the pool it lives in
+*/
+SWITCH_DECLARE(switch_status_t) switch_channel_waiter_create(switch_channel_waiter_t **waiter, switch_memory_pool_t *pool);
+
+/*! \brief Wake whoever is blocked on a waiter, a signal with nobody waiting is kept for the next wait */
+SWITCH_DECLARE(void) switch_channel_waiter_signal(switch_channel_waiter_t *waiter);
+
+/*!
+  \brief Block until a waiter is signalled
+  \param ms the most to block for
+  \return SWITCH_STATUS_SUCCESS when signalled, SWITCH_STATUS_TIMEOUT otherwise
+*/
+SWITCH_DECLARE(switch_status_t) switch_channel_waiter_wait(switch_channel_waiter_t *waiter, uint32_t ms);
+
+/*!
+  \brief Have a channel signal a waiter on each state or flag change
+  \return SWITCH_STATUS_FALSE if a different waiter is already attached
+  \note clear it with switch_channel_clear_waiter() before the waiter goes away
+*/
+SWITCH_DECLARE(switch_status_t) switch_channel_set_waiter(switch_channel_t *channel, switch_channel_waiter_t *waiter);
+SWITCH_DECLARE(void) switch_channel_clear_waiter(switch_channel_t *channel, switch_channel_waiter_t *waiter);
+
 SWITCH_END_EXTERN_C
 #endif
 /* For Emacs:
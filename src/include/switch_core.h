@@ -99,6 +99,8 @@ struct switch_core_session_message {
 	int _line;
 	const char *string_array_arg[MESSAGE_STRING_ARG_MAX];
 	time_t delivery_time;
+	/*! link for the session message queue */
+	switch_mpsc_node_t qnode;
 };
 
 /*! \brief A generic object to pass as a thread's session object to allow mutiple arguements and a pool */
@@ -141,6 +143,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_pop(switch_core_session_t
 								
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_exec_all(switch_core_session_t *orig_session, 
 															   const char *function, switch_media_bug_exec_cb_t cb, void *user_data);
+/*! \brief Count the bugs on a session added by function, NULL counts all of them */
 SWITCH_DECLARE(uint32_t) switch_core_media_bug_count(switch_core_session_t *orig_session, const char *function);
 /*!
   \brief Add a media bug to the session
@@ -199,6 +202,30 @@ SWITCH_DECLARE(void) switch_core_media_bug_set_write_replace_frame(_In_ switch_m
 */
 SWITCH_DECLARE(switch_frame_t *) switch_core_media_bug_get_read_replace_frame(_In_ switch_media_bug_t *bug);
 SWITCH_DECLARE(void) switch_core_media_bug_set_read_demux_frame(_In_ switch_media_bug_t *bug, _In_ switch_frame_t *frame);
+
+/*!
+  \brief Obtain the encoded frame handed to a SMBF_TAP_NATIVE_READ or SMBF_TAP_NATIVE_WRITE bug
+  \param bug the bug to get the frame from
+  \note only valid inside the SWITCH_ABC_TYPE_TAP_NATIVE_READ / SWITCH_ABC_TYPE_TAP_NATIVE_WRITE callback
+*/
+SWITCH_DECLARE(switch_frame_t *) switch_core_media_bug_get_native_read_frame(_In_ switch_media_bug_t *bug);
+SWITCH_DECLARE(switch_frame_t *) switch_core_media_bug_get_native_write_frame(_In_ switch_media_bug_t *bug);
+
+/*!
+  \brief Obtain the decoded frame handed to a SMBF_TAP_READ or SMBF_TAP_WRITE bug
+  \param bug the bug to get the frame from
+  \note this is the session's own frame, only valid inside the SWITCH_ABC_TYPE_TAP_READ / SWITCH_ABC_TYPE_TAP_WRITE callback
+*/
+SWITCH_DECLARE(const switch_frame_t *) switch_core_media_bug_get_tap_read_frame(_In_ switch_media_bug_t *bug);
+
+/*!
+  \brief Ask for the frames handed to a SMBF_TAP_READ or SMBF_TAP_WRITE bug at another rate
+  \param bug the bug
+  \param rate the rate, 0 for the session rate
+  \note the conversion is done once per frame for every bug on the session asking for the same rate
+*/
+SWITCH_DECLARE(void) switch_core_media_bug_set_tap_rate(_In_ switch_media_bug_t *bug, uint32_t rate);
+SWITCH_DECLARE(const switch_frame_t *) switch_core_media_bug_get_tap_write_frame(_In_ switch_media_bug_t *bug);
 /*!
   \brief Obtain the session from a media bug
   \param bug the bug to get the data from
@@ -489,6 +516,32 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_destroy_memory_pool(_Inout_
 SWITCH_DECLARE(void) switch_core_memory_pool_set_data(switch_memory_pool_t *pool, const char *key, void *data);
 SWITCH_DECLARE(void *) switch_core_memory_pool_get_data(switch_memory_pool_t *pool, const char *key);
 
+/*!
+  \brief Create a cache of fixed size objects that lives as long as the core
+  \param name the name it is reported under
+  \param size the object size
+  \param depth how many free objects each of its per thread magazines may hold (0 for the default)
+  \return the cache
+  \note objects are ordinary malloc() blocks, so switch_slab_free() takes any block of that size and free() works on slab objects
+*/
+SWITCH_DECLARE(switch_slab_t *) switch_slab_create(const char *name, switch_size_t size, uint32_t depth);
+
+/*! \brief Allocate an uninitialized object from a cache, falls back to malloc when the magazine is empty */
+SWITCH_DECLARE(void *) switch_slab_alloc(switch_slab_t *slab);
+
+/*! \brief Give an object back to a cache */
+SWITCH_DECLARE(void) switch_slab_free(switch_slab_t *slab, void *ptr);
+
+/*! \brief Write hit/miss counts for every cache */
+SWITCH_DECLARE(void) switch_slab_stats(switch_stream_handle_t *stream);
+
+/*!
+  \brief Write the pool tags holding the most memory, needs pool-accounting turned on
+  \param stream the stream to write to
+  \param top how many tags to show, 0 for all of them
+*/
+SWITCH_DECLARE(void) switch_core_memory_pool_stats(switch_stream_handle_t *stream, int top);
+
 
 /*! 
   \brief Start the session's state machine
@@ -822,6 +875,46 @@ SWITCH_DECLARE(void) switch_core_session_hupall_matching_var(_In_ const char *va
 */
 SWITCH_DECLARE(void) switch_core_session_hupall_endpoint(const switch_endpoint_interface_t *endpoint_interface, switch_call_cause_t cause);
 
+/*! 
+  \brief Keep an index of sessions by the value of a channel variable
+  \param var_name The variable name
+  \note Only values set after the call are indexed, this is meant to be done at startup (indexed-channel-variables in switch.conf)
+*/
+SWITCH_DECLARE(void) switch_core_session_index_variable(_In_z_ const char *var_name);
+
+/*! 
+  \brief Find the sessions which have an indexed channel variable set to a value
+  \param var_name The variable name
+  \param var_val The value to look for
+  \param matches Filled with the uuids of the matching sessions (NULL when there are none), free with switch_console_free_matches()
+  \return SWITCH_STATUS_FALSE if the variable is not indexed and the sessions have to be scanned instead
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_session_find_by_variable(_In_z_ const char *var_name, _In_z_ const char *var_val,
+																	 switch_console_callback_match_t **matches);
+
+/*! 
+  \brief Used by the channel variable setters to keep the variable index up to date
+*/
+SWITCH_DECLARE(switch_bool_t) switch_core_session_variable_indexed(const char *var_name);
+SWITCH_DECLARE(void) switch_core_session_variable_index_update(const char *uuid, const char *var_name, const char *old_val, const char *new_val);
+
+typedef switch_status_t (*switch_core_session_bulk_callback_t) (switch_core_session_t *session, void *user_data);
+typedef void (*switch_core_session_bulk_progress_t) (uint32_t done, uint32_t total, void *user_data);
+
+/*! 
+  \brief Run a callback on every session, spread over a few worker threads
+  \param endpoint_interface Only visit sessions of this endpoint (NULL for all)
+  \param callback Called with each session read locked, return SWITCH_STATUS_SUCCESS to count it as matched
+  \param user_data Passed to the callback, shared by all the workers
+  \param progress Called from the calling thread about every 100ms and once at the end (optional)
+  \param progress_data Passed to the progress callback
+  \return The number of sessions the callback matched
+  \note The session uuids are collected first, the session table is not locked while the callbacks run
+*/
+SWITCH_DECLARE(uint32_t) switch_core_session_bulk_exec(const switch_endpoint_interface_t *endpoint_interface,
+													   switch_core_session_bulk_callback_t callback, void *user_data,
+													   switch_core_session_bulk_progress_t progress, void *progress_data);
+
 /*! 
   \brief Get the session's partner (the session its bridged to)
   \param session The session we're searching with 
@@ -895,6 +988,36 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_event_send(_In_z_ const char
 
 SWITCH_DECLARE(switch_app_log_t *) switch_core_session_get_app_log(_In_ switch_core_session_t *session);
 
+/*!
+  \brief Add a record to the session's trace ring (a no-op when session-trace-size is 0)
+  \param session the session to trace
+  \param type the kind of record, decides how a, b, c and str are shown
+  \param a type specific value
+  \param b type specific value
+  \param c type specific value
+  \param str short text, only the first 15 characters are kept
+*/
+SWITCH_DECLARE(void) switch_core_session_trace(_In_ switch_core_session_t *session, switch_session_trace_type_t type,
+											   uint32_t a, uint32_t b, uint32_t c, _In_opt_z_ const char *str);
+
+/*!
+  \brief Write the session's trace ring out as text, oldest record first
+  \param session the session to dump
+  \param stream the stream to write to
+  \return SWITCH_STATUS_FALSE if the session has no trace ring
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_session_trace_dump(_In_ switch_core_session_t *session, _In_ switch_stream_handle_t *stream);
+
+/*!
+  \brief Count the duration of a call setup phase into its latency histogram
+  \param session the session to store it on as setup_<phase>_usec, NULL for phases that aren't tied to a session
+  \param phase the phase
+  \param start when the phase started, 0 for the time the session was created (only the first one per session is kept)
+  \param end when the phase ended, 0 for now
+*/
+SWITCH_DECLARE(void) switch_core_session_record_phase(_In_opt_ switch_core_session_t *session, switch_session_phase_t phase,
+													  switch_time_t start, switch_time_t end);
+
 /*! 
   \brief Execute an application on a session 
   \param session the current session
@@ -918,6 +1041,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_execute_application_get_flag
 
 SWITCH_DECLARE(switch_status_t) switch_core_session_execute_application_async(switch_core_session_t *session, const char *app, const char *arg);
 
+/*!
+  \brief Queue an application on a session and tag its completion
+  \param app_uuid returned as Application-UUID on the CHANNEL_EXECUTE_COMPLETE event of this execution
+  \note the session thread runs the application the next time it looks at its private events, e.g. while it is parked
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_session_execute_application_async_uuid(switch_core_session_t *session, const char *app, const char *arg,
+																				   const char *app_uuid);
+
 SWITCH_DECLARE(switch_status_t) switch_core_session_get_app_flags(const char *app, int32_t *flags);
 
 /*! 
@@ -1322,6 +1453,7 @@ SWITCH_DECLARE(void *) switch_core_hash_find_rdlock(_In_ switch_hash_t *hash, _I
  \param deprecate_me [deprecated] NULL
  \param hash the hashtable to use
  \return The element, or NULL if it wasn't found 
+ \note elements come back in insertion order, deleting the current one while iterating is safe but inserting is not
 */
 SWITCH_DECLARE(switch_hash_index_t *) switch_hash_first(char *deprecate_me, _In_ switch_hash_t *hash);
 
@@ -1342,6 +1474,64 @@ SWITCH_DECLARE(switch_hash_index_t *) switch_hash_next(_In_ switch_hash_index_t
 SWITCH_DECLARE(void) switch_hash_this(_In_ switch_hash_index_t *hi, _Out_opt_ptrdiff_cap_(klen)
 									  const void **key, _Out_opt_ switch_ssize_t *klen, _Out_ void **val);
 
+/*!
+  \brief Initialize a hash table that is split into independently rwlocked stripes
+  \param hash a NULL pointer to a hash table to aim at the new hash
+  \param pool the pool to use for the new hash, NULL for one of its own
+  \param stripes number of stripes, rounded up to a power of 2, 0 for the default of 16
+  \param case_sensitive SWITCH_FALSE to compare keys without regard to case
+  \return SWITCH_STATUS_SUCCESS if the hash is created
+  \note every call takes the lock of the key's stripe by itself, keys in other stripes are never blocked
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_striped_hash_init(_Out_ switch_striped_hash_t **hash, _In_opt_ switch_memory_pool_t *pool, uint32_t stripes,
+															 switch_bool_t case_sensitive);
+SWITCH_DECLARE(switch_status_t) switch_core_striped_hash_destroy(_Inout_ switch_striped_hash_t **hash);
+SWITCH_DECLARE(switch_status_t) switch_core_striped_hash_insert(_In_ switch_striped_hash_t *hash, _In_z_ const char *key, _In_opt_ const void *data);
+SWITCH_DECLARE(switch_status_t) switch_core_striped_hash_delete(_In_ switch_striped_hash_t *hash, _In_z_ const char *key);
+SWITCH_DECLARE(void *) switch_core_striped_hash_find(_In_ switch_striped_hash_t *hash, _In_z_ const char *key);
+
+/*!
+  \brief Look up a key and run a callback on its value with the stripe read locked
+  \return what the callback returned, NULL without calling it if the key isn't there
+  \note use it to take a reference on the value before anyone can remove it
+*/
+SWITCH_DECLARE(void *) switch_core_striped_hash_find_callback(_In_ switch_striped_hash_t *hash, _In_z_ const char *key,
+															  _In_ switch_striped_hash_callback_t callback, _In_opt_ void *pData);
+
+/*!
+  \brief Read, modify and write one key with the stripe write locked
+  \param callback gets the current value (NULL if there is none) and returns the new one, NULL removes the key
+  \return the new value
+*/
+SWITCH_DECLARE(void *) switch_core_striped_hash_update(_In_ switch_striped_hash_t *hash, _In_z_ const char *key,
+													   _In_ switch_striped_hash_callback_t callback, _In_opt_ void *pData);
+
+/*!
+  \brief Call a callback on every element, one stripe read locked at a time
+  \return the first non NULL value returned by the callback, which also stops the walk
+*/
+SWITCH_DECLARE(void *) switch_core_striped_hash_walk(_In_ switch_striped_hash_t *hash, _In_ switch_striped_hash_callback_t callback, _In_opt_ void *pData);
+
+/*!
+  \brief Delete data from a striped hash based on callback function, one stripe write locked at a time
+  \return SWITCH_STATUS_SUCCESS if any data is deleted
+*/
+/*!
+  \brief Get the shared permanent copy of a short string, used for header and variable names
+  \param str the string
+  \return the atom, equal strings always give the same pointer, NULL if the string is too long or the table is full
+*/
+SWITCH_DECLARE(const char *) switch_core_intern(_In_z_ const char *str);
+
+/*! \brief The case insensitive hash of an atom returned by switch_core_intern(), only valid on atoms */
+SWITCH_DECLARE(unsigned int) switch_core_intern_hash(_In_z_ const char *atom);
+
+/*! \brief How many atoms have been interned */
+SWITCH_DECLARE(uint32_t) switch_core_intern_count(void);
+
+SWITCH_DECLARE(switch_status_t) switch_core_striped_hash_delete_multi(_In_ switch_striped_hash_t *hash, _In_ switch_hash_delete_callback_t callback,
+																	  _In_opt_ void *pData);
+
 ///\}
 
 ///\defgroup timer Timer Functions
@@ -1473,6 +1663,32 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_decode(switch_codec_t *codec,
 */
 SWITCH_DECLARE(switch_status_t) switch_core_codec_destroy(switch_codec_t *codec);
 
+/*!
+  \brief Register an engine that encodes and decodes in batches off the session threads
+  \param engine the engine, copied, so it may live on the stack
+  \return SWITCH_STATUS_SUCCESS if the engine was registered
+  \note only handles opened after this call are offered to the engine, the last registered engine is asked first
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_codec_offload_register(const switch_codec_offload_engine_t *engine);
+
+/*!
+  \brief Unregister a codec offload engine, handles it had claimed go back to running inline
+  \param name the name the engine was registered with
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_codec_offload_unregister(const char *name);
+
+/*!
+  \brief Run a codec offload job's encode or decode directly, for engines that hand back work they cannot do
+  \param job the job
+*/
+SWITCH_DECLARE(void) switch_core_codec_offload_run(switch_codec_offload_job_t *job);
+
+/*!
+  \brief Write the codec offload counters (jobs, batches, inline fallbacks) to a stream
+  \param stream the stream to write the report to
+*/
+SWITCH_DECLARE(void) switch_core_codec_offload_stats(switch_stream_handle_t *stream);
+
 /*! 
   \brief Assign the read codec to a given session
   \param session session to add the codec to
@@ -1683,6 +1899,33 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_get_string(_In_ switch_file_han
 */
 SWITCH_DECLARE(switch_status_t) switch_core_file_close(_In_ switch_file_handle_t *fh);
 
+/*!
+  \brief Switch a handle reading from the prompt cache to frames pre-encoded for a codec
+  \param fh the file handle, open for read
+  \param codec the codec the frames will be written with
+  \return SWITCH_STATUS_SUCCESS when the handle now reads native frames (SWITCH_FILE_NATIVE is set)
+  \note the frames are encoded once per codec the first time somebody asks, only constant frame size codecs qualify
+  \note a handle not from the cache is asked through its module's file_native, if it has one
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_file_cache_native(switch_file_handle_t *fh, switch_codec_t *codec);
+
+/*!
+  \brief Write the prompt cache size and hit/miss counters to a stream
+  \param stream the stream to write the report to
+*/
+SWITCH_DECLARE(void) switch_core_file_cache_stats(switch_stream_handle_t *stream);
+
+/*!
+  \brief Write the async file I/O counters (bytes, stalls waiting on the I/O threads) to a stream
+  \param stream the stream to write the report to
+*/
+SWITCH_DECLARE(void) switch_core_file_io_stats(switch_stream_handle_t *stream);
+
+/*!
+  \brief Drop every decoded file from the prompt cache, handles still playing keep theirs until they close
+*/
+SWITCH_DECLARE(void) switch_core_file_cache_flush(void);
+
 SWITCH_DECLARE(switch_status_t) switch_core_file_truncate(switch_file_handle_t *fh, int64_t offset);
 
 
@@ -1764,6 +2007,38 @@ SWITCH_DECLARE(switch_status_t) switch_core_speech_read_tts(switch_speech_handle
 */
 SWITCH_DECLARE(switch_status_t) switch_core_speech_close(switch_speech_handle_t *sh, switch_speech_flag_t *flags);
 
+/*!
+  \brief Take an idle handle for the same module, voice, rate and interval from the speech handle pool or open a new one
+  \param sh the handle, give it back with switch_core_speech_release()
+  \note the pool is off unless speech-handle-pool-size is set, then this is just switch_core_speech_open() with a pool of its own
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_speech_open_pooled(switch_speech_handle_t **sh,
+															   const char *module_name,
+															   const char *voice_name,
+															   unsigned int rate, unsigned int interval, switch_speech_flag_t *flags);
+
+/*!
+  \brief Give a handle from switch_core_speech_open_pooled() back, it is closed if the pool for its key is full
+  \param sh the handle, set to NULL
+*/
+SWITCH_DECLARE(void) switch_core_speech_release(switch_speech_handle_t **sh);
+
+/*!
+  \brief Close the idle pooled handles of a speech module
+  \param module_name the module, NULL for all of them
+*/
+SWITCH_DECLARE(void) switch_core_speech_pool_flush(const char *module_name);
+
+/*!
+  \brief Where the rendered audio of some text on a handle is kept when tts-cache is on
+  \param sh the speech handle, its engine, voice and rate are part of the key
+  \param text the text as it is fed to the handle
+  \param buf where the path is written
+  \param buflen size of buf
+  \return SWITCH_STATUS_SUCCESS with the path, SWITCH_STATUS_FALSE when the cache is off or the text is too long to be worth keeping
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_speech_cache_path(switch_speech_handle_t *sh, const char *text, char *buf, switch_size_t buflen);
+
 
 /*! 
   \brief Open an asr handle
@@ -2134,6 +2409,36 @@ SWITCH_DECLARE(uint32_t) switch_core_min_dtmf_duration(uint32_t duration);
 SWITCH_DECLARE(uint32_t) switch_core_max_dtmf_duration(uint32_t duration);
 SWITCH_DECLARE(double) switch_core_min_idle_cpu(double new_limit);
 SWITCH_DECLARE(double) switch_core_idle_cpu(void);
+
+/*! \brief Reports how busy a component is in percent, called once a second from the timer thread */
+typedef uint32_t (*switch_core_load_func_t) (void *user_data);
+
+/*!
+  \brief Report the load of a component that has no thread of its own, e.g. how full a queue is
+  \param name a unique name shown by status and in the admission log
+  \param func called with user_data once a second, it must not add or remove load sources
+  \param user_data passed to func
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_add_load_source(const char *name, switch_core_load_func_t func, void *user_data);
+
+/*!
+  \brief Report the CPU use of the calling thread, for threads that serialize work and can saturate one core
+  \param name a unique name shown by status and in the admission log
+  \return SWITCH_STATUS_NOTIMPL when the platform has no per thread CPU clock
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_add_thread_load_source(const char *name);
+SWITCH_DECLARE(void) switch_core_remove_load_source(const char *name);
+
+/*!
+  \brief The load of the busiest source over the last second
+  \param name optional, receives the name of that source
+  \param len size of name
+*/
+SWITCH_DECLARE(uint32_t) switch_core_component_load(char *name, switch_size_t len);
+
+/*! \brief Get, or set when new_limit is not negative, the component load at which new inbound sessions are refused, 0 is off */
+SWITCH_DECLARE(int32_t) switch_core_max_component_load(int32_t new_limit);
+SWITCH_DECLARE(void) switch_core_load_sources_status(switch_stream_handle_t *stream);
 SWITCH_DECLARE(uint32_t) switch_core_default_dtmf_duration(uint32_t duration);
 SWITCH_DECLARE(switch_status_t) switch_console_set_complete(const char *string);
 SWITCH_DECLARE(switch_status_t) switch_console_set_alias(const char *string);
@@ -2252,6 +2557,49 @@ SWITCH_DECLARE(char *) switch_cache_db_execute_sql2str(switch_cache_db_handle_t
  \param [out] err - Error if it exists
 */
 SWITCH_DECLARE(switch_status_t) switch_cache_db_execute_sql(switch_cache_db_handle_t *dbh, char *sql, char **err);
+typedef enum {
+	SCDB_ARG_NULL,
+	SCDB_ARG_TEXT,
+	SCDB_ARG_INT,
+	SCDB_ARG_INT64,
+	SCDB_ARG_DOUBLE
+} switch_cache_db_arg_type_t;
+
+/*! \brief One value bound to a '?' placeholder of switch_cache_db_execute_prepared() */
+typedef struct {
+	switch_cache_db_arg_type_t type;
+	const char *text;
+	int64_t num;
+	double dbl;
+} switch_cache_db_arg_t;
+
+static inline void switch_cache_db_arg_text(switch_cache_db_arg_t *arg, const char *text)
+{
+	arg->type = text ? SCDB_ARG_TEXT : SCDB_ARG_NULL;
+	arg->text = text;
+}
+
+static inline void switch_cache_db_arg_int64(switch_cache_db_arg_t *arg, int64_t num)
+{
+	arg->type = SCDB_ARG_INT64;
+	arg->num = num;
+}
+
+/*! 
+ \brief Executes a statement with '?' placeholders, the statement is prepared once and kept on the handle
+ \param [in] dbh The handle
+ \param [in] sql - sql to run, the same string each time so the cached statement is found
+ \param [in] args - one value per placeholder, in order
+ \param [in] argc - number of args
+ \param [in] callback - function pointer to callback (may be NULL)
+ \param [in] pdata - data to pass to callback
+ \param [out] err - Error if it exists
+ \note ODBC handles have no statement cache, the values are quoted into the sql and it runs as usual
+*/
+SWITCH_DECLARE(switch_status_t) switch_cache_db_execute_prepared(switch_cache_db_handle_t *dbh, const char *sql,
+																 const switch_cache_db_arg_t *args, int argc,
+																 switch_core_db_callback_func_t callback, void *pdata, char **err);
+
 /*! 
  \brief Executes the sql and uses callback for row-by-row processing
  \param [in] dbh The handle
@@ -2275,6 +2623,24 @@ SWITCH_DECLARE(int) switch_cache_db_affected_rows(switch_cache_db_handle_t *dbh)
  \param [in] stream stream for status
 */
 SWITCH_DECLARE(void) switch_cache_db_status(switch_stream_handle_t *stream);
+
+/*!
+ \brief Tell if the in memory copy of the channels and calls tables is being kept
+ \return SWITCH_TRUE when switch_core_channel_store_walk() can be used
+*/
+SWITCH_DECLARE(switch_bool_t) switch_core_channel_store_running(void);
+
+/*!
+ \brief Walk the in memory channels, in the columns and order of "select * from channels" or of the basic_calls view
+ \param [in] calls SWITCH_TRUE for one row per call like basic_calls (ordered by call_created_epoch), SWITCH_FALSE for one row per channel
+ \param [in] like only channels whose uuid, name, cid_name, cid_num or presence_data match this LIKE pattern (NULL for all)
+ \param [in] callback called with each row like a sql callback, return non zero to stop
+ \param [in] pArg passed to the callback
+ \return SWITCH_STATUS_FALSE if the store is not running
+ \note custom presence-data-cols columns only exist in the database
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_channel_store_walk(switch_bool_t calls, const char *like, switch_core_db_callback_func_t callback, void *pArg);
+
 SWITCH_DECLARE(switch_status_t) _switch_core_db_handle(switch_cache_db_handle_t ** dbh, const char *file, const char *func, int line);
 #define switch_core_db_handle(_a) _switch_core_db_handle(_a, __FILE__, __SWITCH_FUNC__, __LINE__)
 
@@ -2331,6 +2697,22 @@ SWITCH_DECLARE(void) switch_say_file(switch_say_file_handle_t *sh, const char *f
 SWITCH_DECLARE(int) switch_max_file_desc(void);
 SWITCH_DECLARE(void) switch_close_extra_files(int *keep, int keep_ttl);
 SWITCH_DECLARE(switch_status_t) switch_core_thread_set_cpu_affinity(int cpu);
+
+/*!
+  \brief Set where the threads of a role are placed (<role>-thread-affinity in switch.conf)
+  \param role the thread role
+  \param policy "disabled", "spread" for one cpu per thread in turn, "numa" for one numa node per thread in turn,
+         or a list of cpus such as "2-5,8" to take in turn
+  \return SWITCH_STATUS_SUCCESS if the policy was understood
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_thread_set_affinity_policy(switch_thread_role_t role, const char *policy);
+
+/*!
+  \brief Pin the calling thread to the next place the policy of its role hands out
+  \param role the thread role
+  \return SWITCH_STATUS_SUCCESS if the thread was pinned, SWITCH_STATUS_FALSE when the role has no policy
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_thread_set_role_affinity(switch_thread_role_t role);
 SWITCH_DECLARE(void) switch_os_yield(void);
 
 SWITCH_END_EXTERN_C
@@ -387,6 +387,12 @@ SWITCH_DECLARE(int) switch_core_db_bind_text(switch_core_db_stmt_t *pStmt, int i
  */
 SWITCH_DECLARE(int) switch_core_db_bind_double(switch_core_db_stmt_t *pStmt, int i, double dValue);
 
+/**
+ * Bind NULL to a parameter, a binding survives switch_core_db_reset() so a reused
+ * statement has to set every parameter again.
+ */
+SWITCH_DECLARE(int) switch_core_db_bind_null(switch_core_db_stmt_t *pStmt, int i);
+
 /**
  * Each entry in a table has a unique integer key.  (The key is
  * the value of the INTEGER PRIMARY KEY column if there is such a column,
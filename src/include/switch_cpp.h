@@ -27,6 +27,7 @@ extern "C" {
 	memset(&cb_state, 0, sizeof(cb_state));				\
 	hook_state = CS_NEW;								\
 	fhp = NULL;											\
+	*async_tag = '\0';									\
 	cause = SWITCH_CAUSE_NONE
 
 //// C++ Interface: switch_to_cpp_mempool//// Description: This class allows for overloading the new operator to allocate from a switch_memory_pool_t//// Author: Yossi Neiman <freeswitch@cartissolutions.com>, (C) 2007//// Copyright: See COPYING file that comes with this distribution//
@@ -174,9 +175,15 @@ SWITCH_DECLARE(bool) email(char *to, char *from, char *headers = NULL, char *bod
 
 	 };
 
+#define EVENT_CONSUMER_BATCH_MAX 500
+
      class EventConsumer {
 	 protected:
 		 switch_memory_pool_t *pool;
+		 switch_event_t *batch[EVENT_CONSUMER_BATCH_MAX];
+		 uint32_t batch_len;
+		 void free_batch(void);
+		 switch_event_t *batch_get(int index);
 	 public:
 		 switch_queue_t *events;
 		 switch_event_types_t e_event_id;
@@ -190,6 +197,25 @@ SWITCH_DECLARE(bool) email(char *to, char *from, char *headers = NULL, char *bod
 		 SWITCH_DECLARE_CONSTRUCTOR ~ EventConsumer();
 		 SWITCH_DECLARE(int) bind(const char *event_name, const char *subclass_name = "");
 		 SWITCH_DECLARE(Event *) pop(int block = 0, int timeout = 0);
+
+	/** \brief Take several events off the queue in one call
+	 *
+	 * The events stay in the consumer until the next popBatch() and are
+	 * read in place with the batch*() methods by their number, counting from
+	 * 0, no Event is made for them.
+	 *
+	 * \param max - the most events to take, up to EVENT_CONSUMER_BATCH_MAX
+	 * \param timeout - milliseconds to wait for max events, 0 takes what is queued now
+	 * \return the number of events in the batch
+	 */
+		 SWITCH_DECLARE(int) popBatch(int max = 100, int timeout = 0);
+		 SWITCH_DECLARE(const char *) batchHeader(int index, const char *header_name);
+		 SWITCH_DECLARE(const char *) batchBody(int index);
+		 SWITCH_DECLARE(const char *) batchType(int index);
+
+	/** \brief Move one event of the batch into an Event, for when the read only view is not enough
+	 */
+		 SWITCH_DECLARE(Event *) batchEvent(int index);
 	 };
 
 #ifdef SWIG
@@ -207,6 +233,7 @@ SWITCH_DECLARE(bool) email(char *to, char *from, char *headers = NULL, char *bod
 		 void *on_hangup;		// language specific callback function, cast as void * 
 		 switch_file_handle_t *fhp;
 		 char dtmf_buf[512];
+		 char async_tag[256];
 
 	   public:
 		 SWITCH_DECLARE_CONSTRUCTOR CoreSession();
@@ -356,6 +383,35 @@ SWITCH_DECLARE(bool) email(char *to, char *from, char *headers = NULL, char *bod
 
 		 SWITCH_DECLARE(void) execute(const char *app, const char *data = NULL);
 
+	/** \brief Queue an application on the session and return without waiting for it
+	 *
+	 * The session thread runs the application, a session still in its
+	 * dialplan is parked so it runs once the script returns.  Bind an
+	 * EventConsumer to CHANNEL_EXECUTE_COMPLETE and match Unique-ID and
+	 * Application-UUID to pick the script up again when it is done, this
+	 * lets one script drive any number of calls.
+	 *
+	 * \param tag - sent back as Application-UUID, a new uuid is used when it is empty
+	 * \return the tag, NULL when nothing could be queued
+	 */
+		 SWITCH_DECLARE(const char *) executeAsync(const char *app, const char *data = NULL, const char *tag = NULL);
+
+	/** \brief streamFile() that returns at once, see executeAsync()
+	 */
+		 SWITCH_DECLARE(const char *) streamFileAsync(char *file, const char *tag = NULL);
+
+	/** \brief playAndGetDigits() that returns at once, see executeAsync()
+	 *
+	 * The digits are left in var_name on the channel and in the
+	 * Application-Response of the completion event.
+	 */
+		 SWITCH_DECLARE(const char *) playAndGetDigitsAsync(int min_digits,
+															int max_digits,
+															int max_tries,
+															int timeout, char *terminators, char *audio_files, char *bad_input_audio_files,
+															char *digits_regex, const char *var_name = NULL, int digit_timeout = 0,
+															const char *tag = NULL);
+
 		 SWITCH_DECLARE(void) sendEvent(Event * sendME);
 
 		 SWITCH_DECLARE(void) setEventData(Event * e);
@@ -74,6 +74,14 @@ SWITCH_BEGIN_EXTERN_C
 	/*! hash of the header name */
 	unsigned long hash;
 	struct switch_event_header *next;
+	/*! previous header in the list, for unlinking without a walk */
+	struct switch_event_header *prev;
+	/*! next header in the same index bucket */
+	struct switch_event_header *index_next;
+	/*! the strings belong to the event's snapshot, not to the header */
+	switch_bool_t borrowed;
+	/*! the name is an atom from switch_core_intern() and is never freed */
+	switch_bool_t interned;
 };
 
 /*! \brief Representation of an event */
@@ -100,6 +108,23 @@ struct switch_event {
 	unsigned long key;
 	struct switch_event *next;
 	int flags;
+	/*! number of headers in the list */
+	uint32_t header_count;
+	/*! header lookup index, built on demand once the event is big enough */
+	switch_event_header_t **index;
+	/*! number of index buckets, a power of two that grows with the header count */
+	uint32_t index_size;
+	/*! optional block allocator owning the headers and their strings */
+	struct switch_event_arena *arena;
+	/*! when the event entered the dispatch queue, for latency accounting */
+	switch_time_t queued;
+	/*! shared frozen headers (channel variables) added to the header list only when somebody looks */
+	struct switch_event_snapshot *snapshot;
+	switch_bool_t snapshot_expanded;
+	/*! snapshot lent to the header list by switch_event_borrow_snapshot(), held until the event is destroyed */
+	struct switch_event_snapshot *borrowed_snapshot;
+	/*! link for the session event queues */
+	switch_mpsc_node_t qnode;
 };
 
 typedef enum {
@@ -112,6 +137,7 @@ typedef enum {
 struct switch_event_node;
 
 #define SWITCH_EVENT_SUBCLASS_ANY NULL
+#define SWITCH_EVENT_STATS_SUBCLASS "event::stats"
 
 /*!
   \brief Start the eventing system
@@ -210,6 +236,53 @@ SWITCH_DECLARE(void) switch_event_destroy(switch_event_t **event);
   \return SWITCH_STATUS_SUCCESS if the event was duplicated
 */
 SWITCH_DECLARE(switch_status_t) switch_event_dup(switch_event_t **event, switch_event_t *todup);
+
+/*!
+  \brief Allocate the headers added to an event from one growing block that is released with the event
+  \param event the event to back with an arena
+  \param size the size of the first block (0 for the default)
+  \return SWITCH_STATUS_SUCCESS if the event now has an arena
+*/
+SWITCH_DECLARE(switch_status_t) switch_event_use_arena(switch_event_t *event, switch_size_t size);
+
+/*!
+  \brief Freeze a copy of an event's headers that many events can share by reference
+  \param snapshot the new snapshot, with one reference held by the caller
+  \param src the event to copy the headers from
+  \param prefix a string to put in front of every header name (e.g. "variable_")
+  \return SWITCH_STATUS_SUCCESS if the snapshot was created
+*/
+SWITCH_DECLARE(switch_status_t) switch_event_snapshot_create(switch_event_snapshot_t **snapshot, switch_event_t *src, const char *prefix);
+
+/*!
+  \brief Drop a reference to a snapshot, freeing it with the last one
+  \param snapshot the snapshot to release (set to NULL)
+*/
+SWITCH_DECLARE(void) switch_event_snapshot_release(switch_event_snapshot_t **snapshot);
+
+/*!
+  \brief Attach a snapshot to an event, its headers appear in the event the first time they are needed
+  \param event the event to attach to
+  \param snapshot the snapshot to reference
+  \return SWITCH_STATUS_SUCCESS if attached, SWITCH_STATUS_FALSE if the event already has a snapshot
+  \note lookups of prefixed names, serializing, duplicating and delivering the event expand the snapshot on their own.
+   Code walking event->headers directly on an event it did not receive from a binding must call switch_event_expand_snapshot() first.
+*/
+SWITCH_DECLARE(switch_status_t) switch_event_add_snapshot(switch_event_t *event, switch_event_snapshot_t *snapshot);
+
+/*!
+  \brief Add the headers of an attached snapshot to the event's header list
+  \param event the event to expand
+*/
+SWITCH_DECLARE(void) switch_event_expand_snapshot(switch_event_t *event);
+
+/*!
+  \brief Append the headers of a snapshot to an event right away, sharing its strings instead of copying them
+  \param event the event to add to
+  \param snapshot the snapshot to reference
+  \return SWITCH_STATUS_SUCCESS if added, SWITCH_STATUS_FALSE if the event already borrows a snapshot or has unique headers
+*/
+SWITCH_DECLARE(switch_status_t) switch_event_borrow_snapshot(switch_event_t *event, switch_event_snapshot_t *snapshot);
 SWITCH_DECLARE(void) switch_event_merge(switch_event_t *event, switch_event_t *tomerge);
 SWITCH_DECLARE(switch_status_t) switch_event_dup_reply(switch_event_t **event, switch_event_t *todup);
 
@@ -252,6 +325,24 @@ SWITCH_DECLARE(switch_status_t) switch_event_bind(const char *id, switch_event_t
 */
 SWITCH_DECLARE(switch_status_t) switch_event_bind_removable(const char *id, switch_event_types_t event, const char *subclass_name,
 															switch_event_callback_t callback, void *user_data, switch_event_node_t **node);
+
+/*!
+  \brief Bind an event callback that is delivered from its own bounded queue and thread
+  \param id an identifier token of the binder
+  \param event the event enumeration to bind to
+  \param subclass_name the event subclass to bind to in the case if SWITCH_EVENT_CUSTOM
+  \param callback the callback functon to bind
+  \param user_data optional user specific data to pass whenever the callback is invoked
+  \param queue_len how many events may wait for the callback (0 for the default)
+  \param policy drop new events or block the dispatcher when the queue is full
+  \param node optional bind handle to later remove the binding.
+  \return SWITCH_STATUS_SUCCESS if the event was binded
+  \note a slow callback bound this way only delays its own events instead of every other consumer.
+   A blocking binding must not bind or unbind events from inside its callback.
+*/
+SWITCH_DECLARE(switch_status_t) switch_event_bind_queued(const char *id, switch_event_types_t event, const char *subclass_name,
+														 switch_event_callback_t callback, void *user_data,
+														 uint32_t queue_len, switch_event_queue_policy_t policy, switch_event_node_t **node);
 /*!
   \brief Unbind a bound event consumer
   \param node node to unbind
@@ -317,6 +408,17 @@ SWITCH_DECLARE(switch_xml_t) switch_event_xmlize(switch_event_t *event, const ch
 */
 SWITCH_DECLARE(switch_status_t) switch_event_running(void);
 
+/*!
+  \brief Write per event type counts and dispatch latency and per binding callback times to a stream
+  \param stream the stream to write the report to
+*/
+SWITCH_DECLARE(void) switch_event_stats(switch_stream_handle_t *stream);
+
+/*!
+  \brief Fire a SWITCH_EVENT_STATS_SUBCLASS custom event carrying the same numbers as switch_event_stats()
+*/
+SWITCH_DECLARE(void) switch_event_fire_stats(void);
+
 #ifndef SWIG
 /*!
   \brief Add a body to an event
@@ -333,6 +435,39 @@ SWITCH_DECLARE(switch_status_t) switch_event_set_body(switch_event_t *event, con
 SWITCH_DECLARE(char *) switch_event_expand_headers_check(switch_event_t *event, const char *in, switch_event_t *var_list, switch_event_t *api_list, uint32_t recur);
 #define switch_event_expand_headers(_event, _in) switch_event_expand_headers_check(_event, _in, NULL, NULL, 0)
 
+/*!
+  \brief Compile a string with ${var} / ${api args} references once so it can be expanded many times
+  \param tplP [out] the compiled template
+  \param in the template string
+  \param pool optional pool to allocate the template from, otherwise it must be destroyed with switch_expand_template_destroy
+  \return SWITCH_STATUS_SUCCESS on success
+*/
+SWITCH_DECLARE(switch_status_t) switch_expand_template_create(switch_expand_template_t **tplP, const char *in, switch_memory_pool_t *pool);
+
+/*!
+  \brief Destroy a template compiled without a pool
+  \param tplP the template, set to NULL
+*/
+SWITCH_DECLARE(void) switch_expand_template_destroy(switch_expand_template_t **tplP);
+
+/*!
+  \brief Get the string a template was compiled from
+  \param tpl the template
+  \return the source string, owned by the template
+*/
+SWITCH_DECLARE(const char *) switch_expand_template_get_source(switch_expand_template_t *tpl);
+
+/*!
+  \brief Expand a compiled template against the headers of an event, same rules as switch_event_expand_headers_check
+  \param event the event to expand from
+  \param tpl the template
+  \param var_list optional list of variables allowed to be expanded
+  \param api_list optional list of api commands allowed to be executed
+  \return the template source if nothing needs expanding, otherwise a new string that must be freed
+*/
+SWITCH_DECLARE(char *) switch_event_expand_template_check(switch_event_t *event, switch_expand_template_t *tpl, switch_event_t *var_list, switch_event_t *api_list);
+#define switch_event_expand_template(_event, _tpl) switch_event_expand_template_check(_event, _tpl, NULL, NULL)
+
 SWITCH_DECLARE(switch_status_t) switch_event_create_pres_in_detailed(_In_z_ char *file, _In_z_ char *func, _In_ int line,
 																	 _In_z_ const char *proto, _In_z_ const char *login,
 																	 _In_z_ const char *from, _In_z_ const char *from_domain,
@@ -68,6 +68,8 @@ SWITCH_BEGIN_EXTERN_C
 	uint16_t seq;
 	uint32_t ssrc;
 	switch_bool_t m;
+	/*! when the media in the frame arrived from the network, 0 when unknown, see media-latency-probe */
+	switch_time_t ingress;
 	/*! frame flags */
 	switch_frame_flag_t flags;
 };
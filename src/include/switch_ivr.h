@@ -103,6 +103,26 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_generate_xml_cdr(switch_core_session_
 SWITCH_DECLARE(int) switch_ivr_set_xml_profile_data(switch_xml_t xml, switch_caller_profile_t *caller_profile, int off);
 SWITCH_DECLARE(int) switch_ivr_set_xml_chan_vars(switch_xml_t xml, switch_channel_t *channel, int off);
 
+/*!
+  \brief Write an XML CDR report straight to a stream without building an xml tree.
+  \param session the session to get the data from.
+  \param stream the stream to write to, it must have a raw_write_function.
+  \param prn_header add the <?xml version..> header too.
+  \return SWITCH_STATUS_SUCCESS if successful
+  \note the output is the same as switch_xml_toxml() of the switch_ivr_generate_xml_cdr() tree.
+*/
+SWITCH_DECLARE(switch_status_t) switch_ivr_stream_xml_cdr(switch_core_session_t *session, switch_stream_handle_t *stream, switch_bool_t prn_header);
+
+/*!
+  \brief Write a JSON CDR report straight to a stream without building a json object.
+  \param session the session to get the data from.
+  \param stream the stream to write to, it must have a raw_write_function.
+  \param urlencode url encode the channel variables.
+  \return SWITCH_STATUS_SUCCESS if successful
+  \note the output is the same as cJSON_PrintUnformatted() of the switch_ivr_generate_json_cdr() object.
+*/
+SWITCH_DECLARE(switch_status_t) switch_ivr_stream_json_cdr(switch_core_session_t *session, switch_stream_handle_t *stream, switch_bool_t urlencode);
+
 /*!
   \brief Parse command from an event
   \param session the session on which to parse the event
@@ -517,6 +537,19 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_multi_threaded_bridge(_In_ switch_cor
 																 switch_input_callback_function_t dtmf_callback, void *session_data,
 																 void *peer_session_data);
 
+/*!
+  \brief Set how many media worker threads are started per packet interval for bridged audio
+  \param workers the number of workers (0 leaves every bridge on its own channel threads)
+  \note Worker threads for an interval are started the first time a bridge with that ptime uses them,
+        both directions of a bridge are kept on the same worker and carried back to back in one pass
+*/
+SWITCH_DECLARE(void) switch_ivr_set_media_workers(uint32_t workers);
+
+/*!
+  \brief Stop the bridge media workers and return their legs to the channel threads
+*/
+SWITCH_DECLARE(void) switch_ivr_media_workers_shutdown(void);
+
 /*!
   \brief Bridge Signalling from one session to another
   \param session one session
@@ -55,6 +55,8 @@ SWITCH_DECLARE(void) switch_limit_init(switch_memory_pool_t *pool);
   \param max - 0 means no limit, just count
   \param interval - 0 means no interval
   \return true/false - true ok, false over limit
+  \note a rate is counted in fixed windows unless the channel sets LIMIT_RATE_MODE_VARIABLE to
+        LIMIT_RATE_MODE_TOKEN_BUCKET, backends without it keep the fixed windows
 */
 SWITCH_DECLARE(switch_status_t) switch_limit_incr(const char *backend, switch_core_session_t *session, const char *realm, const char *resource, const int max, const int interval);
 
@@ -119,6 +121,8 @@ SWITCH_DECLARE(char *) switch_limit_status(const char *backend);
 
 #define LIMIT_IGNORE_TRANSFER_VARIABLE "limit_ignore_transfer"
 #define LIMIT_BACKEND_VARIABLE "limit_backend"
+#define LIMIT_RATE_MODE_VARIABLE "limit_rate_mode"
+#define LIMIT_RATE_MODE_TOKEN_BUCKET "token-bucket"
 #define LIMIT_EVENT_USAGE "limit::usage"
 #define LIMIT_DEF_XFER_EXTEN "limit_exceeded"
 
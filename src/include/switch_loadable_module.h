@@ -245,6 +245,12 @@ SWITCH_DECLARE(switch_management_interface_t *) switch_loadable_module_get_manag
  */
 SWITCH_DECLARE(switch_limit_interface_t *) switch_loadable_module_get_limit_interface(const char *name);
 
+/*!
+  \brief A counter bumped every time a codec implementation is added or removed
+  \return the current generation, anything cached from the codec lists is stale once it changes
+ */
+SWITCH_DECLARE(uint32_t) switch_loadable_module_codec_generation(void);
+
 /*!
   \brief Retrieve the list of loaded codecs into an array
   \param array the array to populate
@@ -0,0 +1,134 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2012, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * switch_metrics.h - Metrics registry with Prometheus text exposition
+ *
+ */
+
+ /*!
+  \defgroup metrics1 METRICS code
+  \ingroup core1
+  \{
+*/
+#ifndef _SWITCH_METRICS_H
+#define _SWITCH_METRICS_H
+
+SWITCH_BEGIN_EXTERN_C
+
+typedef enum {
+	SWITCH_METRIC_COUNTER,
+	SWITCH_METRIC_GAUGE,
+	SWITCH_METRIC_HISTOGRAM
+} switch_metric_type_t;
+
+typedef struct switch_metric switch_metric_t;
+
+/*! \brief Computes the value of a metric when it is scraped instead of having it pushed */
+typedef int64_t (*switch_metric_callback_t) (switch_metric_t *metric, void *user_data);
+
+/*! \brief Writes any number of families straight to the exposition stream, see switch_metric_write_family() */
+typedef void (*switch_metric_collector_t) (switch_stream_handle_t *stream, void *user_data);
+
+/*!
+  \brief Initilize the METRICS Core System
+  \param pool the memory pool to use for long term allocations
+  \note Generally called by the core_init
+*/
+SWITCH_DECLARE(void) switch_metrics_init(switch_memory_pool_t *pool);
+
+SWITCH_DECLARE(void) switch_metrics_shutdown(void);
+
+/*!
+  \brief Register a counter or gauge
+  \param name the series name, optionally followed by labels e.g. sofia_calls_total{profile="internal"}
+  \param help one line of help text for the family
+  \param type SWITCH_METRIC_COUNTER or SWITCH_METRIC_GAUGE
+  \return the metric, registering the same name twice returns the same metric
+*/
+SWITCH_DECLARE(switch_metric_t *) switch_metric_register(const char *name, const char *help, switch_metric_type_t type);
+
+/*!
+  \brief Register a histogram with power of two buckets
+  \param name the series name, optionally followed by labels
+  \param help one line of help text for the family
+  \param max the largest value that gets its own bucket, anything above only lands in +Inf
+  \return the metric
+*/
+SWITCH_DECLARE(switch_metric_t *) switch_metric_register_histogram(const char *name, const char *help, int64_t max);
+
+/*!
+  \brief Register a counter or gauge whose value is read from a callback at scrape time
+  \note the callback runs with the registry read locked, unregister it before the code it lives in goes away
+*/
+SWITCH_DECLARE(switch_metric_t *) switch_metric_register_callback(const char *name, const char *help, switch_metric_type_t type,
+																  switch_metric_callback_t callback, void *user_data);
+
+/*!
+  \brief Register a collector that writes its own families at scrape time
+  \param name a unique name used to unregister it
+*/
+SWITCH_DECLARE(switch_status_t) switch_metric_register_collector(const char *name, switch_metric_collector_t collector, void *user_data);
+SWITCH_DECLARE(switch_status_t) switch_metric_unregister_collector(const char *name);
+
+/*!
+  \brief Drop a reference to a metric, it leaves the registry with the last one
+  \param metric the metric, set to NULL
+*/
+SWITCH_DECLARE(void) switch_metric_unregister(switch_metric_t **metric);
+
+/*! \brief Add to a counter or gauge, cheap enough for hot paths */
+SWITCH_DECLARE(void) switch_metric_add(switch_metric_t *metric, int64_t value);
+#define switch_metric_inc(_metric) switch_metric_add(_metric, 1)
+#define switch_metric_dec(_metric) switch_metric_add(_metric, -1)
+
+/*! \brief Set a gauge */
+SWITCH_DECLARE(void) switch_metric_set(switch_metric_t *metric, int64_t value);
+
+/*! \brief Count one value into a histogram */
+SWITCH_DECLARE(void) switch_metric_observe(switch_metric_t *metric, int64_t value);
+
+/*! \brief Current value of a counter or gauge, the number of observations for a histogram */
+SWITCH_DECLARE(int64_t) switch_metric_get(switch_metric_t *metric);
+
+/*! \brief Write the whole registry in the Prometheus text format (version 0.0.4) */
+SWITCH_DECLARE(void) switch_metrics_expose(switch_stream_handle_t *stream);
+
+/*! \brief Helpers for collectors */
+SWITCH_DECLARE(void) switch_metric_write_family(switch_stream_handle_t *stream, const char *name, const char *help, switch_metric_type_t type);
+SWITCH_DECLARE(void) switch_metric_write_value(switch_stream_handle_t *stream, const char *name, const char *labels, int64_t value);
+
+SWITCH_END_EXTERN_C
+#endif
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
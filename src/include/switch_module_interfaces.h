@@ -100,6 +100,10 @@ struct switch_stream_handle {
 	switch_size_t alloc_len;
 	switch_size_t alloc_chunk;
 	switch_event_t *param_event;
+	/*! when set, buffered output is handed to flush_function once it reaches flush_len bytes instead of growing the buffer */
+	switch_stream_handle_flush_function_t flush_function;
+	void *flush_user_data;
+	switch_size_t flush_len;
 };
 
 struct switch_io_event_hooks;
@@ -278,6 +282,8 @@ struct switch_file_interface {
 	switch_status_t (*file_set_string) (switch_file_handle_t *fh, switch_audio_col_t col, const char *string);
 	/*! function to get meta data */
 	switch_status_t (*file_get_string) (switch_file_handle_t *fh, switch_audio_col_t col, const char **string);
+	/*! optional function to make an open handle read frames already encoded for a codec, it sets SWITCH_FILE_NATIVE when it can */
+	switch_status_t (*file_native) (switch_file_handle_t *fh, switch_codec_t *codec);
 	/*! list of supported file extensions */
 	char **extens;
 	switch_thread_rwlock_t *rwlock;
@@ -343,6 +349,13 @@ struct switch_file_handle {
 	char *file_path;
 	char *spool_path;
 	const char *prefix;
+	/*! decoded audio shared from the prompt cache, the file itself is not open when set */
+	struct switch_file_cache_node *cache_node;
+	/*! the cached audio pre-encoded for the codec written to, cache_pos counts bytes into it when set */
+	struct switch_file_cache_variant *cache_variant;
+	switch_size_t cache_pos;
+	/*! module reads and writes handed to the file I/O threads */
+	struct switch_file_io *io;
 };
 
 /*! \brief Abstract interface to an asr module */
@@ -601,6 +614,38 @@ struct switch_codec {
 	switch_payload_t agreed_pt;
 	switch_mutex_t *mutex;
 	struct switch_codec *next;
+	/*! set when a codec offload engine runs this handle's encode and decode */
+	void *offload;
+};
+
+/*! \brief One encode or decode handed to a codec offload engine, the arguments are those of switch_core_codec_encode/decode */
+struct switch_codec_offload_job {
+	switch_codec_t *codec;
+	switch_codec_t *other_codec;
+	/*! SWITCH_TRUE to encode in_data into out_data, SWITCH_FALSE to decode it */
+	switch_bool_t encode;
+	void *in_data;
+	uint32_t in_len;
+	uint32_t in_rate;
+	void *out_data;
+	uint32_t *out_len;
+	uint32_t *out_rate;
+	unsigned int *flag;
+	/*! set by the engine once the job has run */
+	switch_status_t status;
+	/*! owned by the core */
+	int done;
+};
+
+/*! \brief Runs codec work for many legs at once, e.g. a DSP card, a GPU or the core's own transcoding threads */
+struct switch_codec_offload_engine {
+	/*! a unique name, used to unregister it */
+	const char *name;
+	/*! return SWITCH_TRUE to run every handle opened on this implementation */
+	switch_bool_t (*claim) (const switch_codec_implementation_t *implementation, void *user_data);
+	/*! run a batch and set status on each job, a handle never has more than one job in a batch */
+	void (*process) (switch_codec_offload_job_t **jobs, uint32_t count, void *user_data);
+	void *user_data;
 };
 
 /*! \brief A table of settings and callbacks that define a paticular implementation of a codec */
@@ -205,6 +205,12 @@ typedef int gid_t;
 #else
 #define PRINTF_FUNCTION(fmtstr,vars)
 #endif
+/* builds a hot loop for the baseline ISA and again for AVX2, the dynamic loader picks one for the running cpu */
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6 && defined(__x86_64__) && defined(__linux__)
+#define SWITCH_TARGET_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define SWITCH_TARGET_CLONES
+#endif
 #ifdef SWITCH_INT32
 typedef SWITCH_INT32 switch_int32_t;
 #else
@@ -0,0 +1,140 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2012, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * switch_prefix.h - Longest prefix match tables over digit strings
+ *
+ */
+
+ /*!
+  \defgroup prefix1 PREFIX table code
+  \ingroup core1
+  \{
+*/
+#ifndef _SWITCH_PREFIX_H
+#define _SWITCH_PREFIX_H
+
+SWITCH_BEGIN_EXTERN_C
+
+typedef struct switch_prefix_table switch_prefix_table_t;
+typedef struct switch_prefix_builder switch_prefix_builder_t;
+
+/*!
+  \brief Initilize the PREFIX Core System
+  \param pool the memory pool to use for long term allocations
+  \note Generally called by the core_init
+*/
+SWITCH_DECLARE(void) switch_prefix_init(switch_memory_pool_t *pool);
+
+SWITCH_DECLARE(void) switch_prefix_shutdown(void);
+
+/*!
+  \brief Start building a table, prefixes can be added in any order
+  \param builder the new builder
+*/
+SWITCH_DECLARE(switch_status_t) switch_prefix_builder_create(switch_prefix_builder_t **builder);
+
+/*!
+  \brief Add a prefix to a table being built
+  \param builder the builder
+  \param prefix the digits, anything else in it is ignored, an empty prefix matches every number
+  \param value the value a lookup that matches this prefix returns, the last one added wins for a repeated prefix
+*/
+SWITCH_DECLARE(switch_status_t) switch_prefix_builder_add(switch_prefix_builder_t *builder, const char *prefix, const char *value);
+
+/*!
+  \brief Turn a builder into a read only table
+  \param builder the builder, it is freed and set to NULL
+  \param table the table
+*/
+SWITCH_DECLARE(switch_status_t) switch_prefix_builder_finish(switch_prefix_builder_t **builder, switch_prefix_table_t **table);
+
+SWITCH_DECLARE(void) switch_prefix_builder_destroy(switch_prefix_builder_t **builder);
+
+/*! \brief Build a table from a file of prefix,value lines, blank lines and lines starting with # are skipped */
+SWITCH_DECLARE(switch_status_t) switch_prefix_table_load_csv(switch_prefix_table_t **table, const char *path);
+
+/*!
+  \brief Build a table from the first two columns of a query
+  \param dsn odbc dsn as dsn:user:pass, NULL for the core db
+*/
+SWITCH_DECLARE(switch_status_t) switch_prefix_table_load_sql(switch_prefix_table_t **table, const char *dsn, const char *sql);
+
+/*!
+  \brief Map a snapshot written by switch_prefix_table_save()
+  \note the table is used straight from the mapping, nothing is parsed so this is the fast way to start with a big table
+*/
+SWITCH_DECLARE(switch_status_t) switch_prefix_table_load_snapshot(switch_prefix_table_t **table, const char *path);
+
+/*! \brief Write a table to a snapshot file, it is written aside and renamed so a reader never sees half of it */
+SWITCH_DECLARE(switch_status_t) switch_prefix_table_save(switch_prefix_table_t *table, const char *path);
+
+/*!
+  \brief Find the longest prefix of a number in a table
+  \param table the table
+  \param number the number, anything but digits is skipped
+  \param matched optional, the number of digits that matched
+  \return the value of the longest matching prefix, NULL if nothing matched
+  \note the value lives as long as the table
+*/
+SWITCH_DECLARE(const char *) switch_prefix_table_find(switch_prefix_table_t *table, const char *number, switch_size_t *matched);
+
+/*! \brief Number of prefixes in a table */
+SWITCH_DECLARE(uint32_t) switch_prefix_table_count(switch_prefix_table_t *table);
+
+SWITCH_DECLARE(void) switch_prefix_table_destroy(switch_prefix_table_t **table);
+
+/*!
+  \brief (Re)load the tables configured in prefix.conf
+  \param reload a table that fails to load keeps its old contents on a reload
+*/
+SWITCH_DECLARE(void) switch_load_prefix_tables(switch_bool_t reload);
+
+/*!
+  \brief Look a number up in a table from prefix.conf
+  \param name the table name
+  \param number the number
+  \param buf where the value is copied
+  \param buflen size of buf
+  \param matched optional, the number of digits that matched
+  \return SWITCH_STATUS_SUCCESS on a match, SWITCH_STATUS_NOTFOUND when nothing matched, SWITCH_STATUS_FALSE for an unknown table
+*/
+SWITCH_DECLARE(switch_status_t) switch_prefix_lookup(const char *name, const char *number, char *buf, switch_size_t buflen, switch_size_t *matched);
+
+/*! \brief List the configured tables on a stream */
+SWITCH_DECLARE(void) switch_prefix_tables_dump(switch_stream_handle_t *stream);
+
+SWITCH_END_EXTERN_C
+#endif
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -50,6 +50,23 @@ SWITCH_DECLARE(int) switch_regex_copy_substring(const char *subject, int *ovecto
 SWITCH_DECLARE(void) switch_regex_free(void *data);
 
 SWITCH_DECLARE(int) switch_regex_perform(const char *field, const char *expression, switch_regex_t **new_re, int *ovector, uint32_t olen);
+
+/*!
+ \brief Compile an expression the same way switch_regex_perform does so it can be matched many times
+ \param expression the expression, optionally in /pattern/flags or _asterisk form
+ \return the compiled regex or NULL on error, free with switch_regex_safe_free
+*/
+SWITCH_DECLARE(switch_regex_t *) switch_regex_compile_expression(const char *expression);
+
+/*!
+ \brief Match a string against a precompiled regex
+ \param re the regex from switch_regex_compile_expression
+ \param field the string to match
+ \param ovector vector of integers for substring information
+ \param olen number of elements in ovector
+ \return the match count, 0 if there was no match
+*/
+SWITCH_DECLARE(int) switch_regex_exec(switch_regex_t *re, const char *field, int *ovector, uint32_t olen);
 SWITCH_DECLARE(void) switch_perform_substitution(switch_regex_t *re, int match_count, const char *data, const char *field_data,
 												 char *substituted, switch_size_t len, int *ovector);
 
@@ -74,6 +91,12 @@ SWITCH_DECLARE(void) switch_capture_regex(switch_regex_t *re, int match_count, c
 										  int *ovector, const char *var, switch_cap_callback_t callback, void *user_data);
 
 SWITCH_DECLARE_NONSTD(void) switch_regex_set_var_callback(const char *var, const char *val, void *user_data);
+
+/*!
+ \brief Write the compiled pattern cache size and hit/miss counters to a stream
+ \param stream the stream to write the report to
+*/
+SWITCH_DECLARE(void) switch_regex_cache_stats(switch_stream_handle_t *stream);
 SWITCH_DECLARE_NONSTD(void) switch_regex_set_event_header_callback(const char *var, const char *val, void *user_data);
 
 #define switch_regex_safe_free(re)	if (re) {\
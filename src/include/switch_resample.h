@@ -67,6 +67,11 @@ SWITCH_BEGIN_EXTERN_C
 	uint32_t to_len;
 	/*! the total size of the to buffer */
 	uint32_t to_size;
+	/*! the channel count and quality the generic resampler was built with */
+	uint32_t channels;
+	int quality;
+	/*! a fixed ratio kernel used instead of the generic resampler for integer rate pairs */
+	void *fixed;
 
 } switch_audio_resampler_t;
 
@@ -173,6 +178,50 @@ SWITCH_DECLARE(uint32_t) switch_merge_sln(int16_t *data, uint32_t samples, int16
 SWITCH_DECLARE(uint32_t) switch_unmerge_sln(int16_t *data, uint32_t samples, int16_t *other_data, uint32_t other_samples);
 SWITCH_DECLARE(void) switch_mux_channels(int16_t *data, switch_size_t samples, uint32_t channels);
 
+/*!
+  \brief Pick the fastest mixing kernel (SSE2/AVX2/NEON or scalar) the running cpu supports
+ */
+SWITCH_DECLARE(void) switch_sln_kernel_init(void);
+
+/*!
+  \brief Force a specific mixing kernel
+  \param name scalar, sse2, avx2 or neon
+  \return SWITCH_STATUS_SUCCESS if the kernel is built in and supported by this cpu
+ */
+SWITCH_DECLARE(switch_status_t) switch_sln_kernel_set(const char *name);
+
+/*!
+  \brief Get the name of the mixing kernel in use
+  \return the kernel name
+ */
+SWITCH_DECLARE(const char *) switch_sln_kernel_name(void);
+
+/*!
+  \brief Add a signed linear frame into a 32 bit accumulator
+  \param acc the accumulator
+  \param data the audio data
+  \param samples the number of 2 byte samples
+ */
+SWITCH_DECLARE(void) switch_sln_accumulate(int32_t *acc, const int16_t *data, uint32_t samples);
+
+/*!
+  \brief Sum the absolute sample values of a mono signed linear frame
+  \param data the audio data
+  \param samples the number of 2 byte samples
+  \return the sum, 0 only for digital silence
+ */
+SWITCH_DECLARE(uint32_t) switch_sln_energy(const int16_t *data, uint32_t samples);
+
+/*!
+  \brief Produce a saturated signed linear frame from an accumulator minus one contribution
+  \param data the output audio data
+  \param acc the accumulator
+  \param self the contribution to remove (may be NULL)
+  \param self_samples the number of samples in self
+  \param samples the number of 2 byte samples to produce
+ */
+SWITCH_DECLARE(void) switch_sln_mix_out(int16_t *data, const int32_t *acc, const int16_t *self, uint32_t self_samples, uint32_t samples);
+
 SWITCH_END_EXTERN_C
 #endif
 /* For Emacs:
@@ -68,6 +68,18 @@ struct switch_rtp_crypto_key {
 };
 typedef struct switch_rtp_crypto_key switch_rtp_crypto_key_t;
 
+typedef struct {
+	uint32_t sessions;
+	switch_size_t wakeups;
+	switch_size_t packets;
+	switch_size_t dropped;
+	switch_size_t relayed;
+	uint32_t max_batch;
+	uint32_t rtcp_sessions;
+	switch_size_t rtcp_received;
+	switch_size_t rtcp_sent;
+} switch_rtp_reactor_stats_t;
+
 
 
 SWITCH_DECLARE(switch_status_t) switch_rtp_add_crypto_key(switch_rtp_t *rtp_session,
@@ -224,16 +236,66 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_activate_ice(switch_rtp_t *rtp_sessio
 */
 SWITCH_DECLARE(switch_status_t) switch_rtp_activate_rtcp(switch_rtp_t *rtp_session, int send_rate, switch_port_t remote_port);
 
+/*! 
+  \brief Hand the receive side of an RTP session to the shared RTP reactor threads
+  \param rtp_session the rtp session
+  \return SWITCH_STATUS_SUCCESS or an error when the reactor is unavailable on this platform
+  \note packets are drained from the socket in batches with recvmmsg() and buffered in memory for the reader
+*/
+SWITCH_DECLARE(switch_status_t) switch_rtp_activate_reactor(switch_rtp_t *rtp_session);
+
+/*!
+  \brief Set/Get the number of RTP reactor threads (only before the first session uses the reactor)
+  \param threads new value (if > 0)
+  \return the current number of reactor threads
+*/
+SWITCH_DECLARE(uint32_t) switch_rtp_set_reactor_threads(uint32_t threads);
+
+/*!
+  \brief Get the packet and wakeup counters of the running RTP reactor threads
+  \param stats an array to fill in
+  \param max the number of elements in stats
+  \return the number of reactors reported
+*/
+SWITCH_DECLARE(uint32_t) switch_rtp_get_reactor_stats(switch_rtp_reactor_stats_t *stats, uint32_t max);
+
+/*!
+  \brief Collect outbound packets written during the same media tick and send them with one sendmmsg()
+  \param rtp_session the rtp session
+  \param max_packets the largest batch to hold (0 or 1 disables batching)
+  \param max_usec the longest a packet may wait in the batch
+  \return SWITCH_STATUS_SUCCESS or SWITCH_STATUS_NOTIMPL without sendmmsg()
+  \note the outbound batch_count/largest_batch stats report how well packets are coalescing
+*/
+SWITCH_DECLARE(switch_status_t) switch_rtp_set_tx_batch(switch_rtp_t *rtp_session, uint32_t max_packets, uint32_t max_usec);
+
+/*!
+  \brief Forward media between two sessions from the reactor threads without it reaching either session
+  \param rtp_session one leg
+  \param peer the other leg, both must use the reactor and the same codec
+  \return SWITCH_STATUS_SUCCESS, SWITCH_STATUS_NOTIMPL without the reactor, SWITCH_STATUS_FALSE if either leg cannot relay
+  \note packets that are not the media payload still reach the session, frames written to either leg are dropped while relaying
+*/
+SWITCH_DECLARE(switch_status_t) switch_rtp_relay_start(switch_rtp_t *rtp_session, switch_rtp_t *peer);
+
+/*! \brief Stop relaying for a session and its peer, safe to call on a session that is not relaying */
+SWITCH_DECLARE(void) switch_rtp_relay_stop(switch_rtp_t *rtp_session);
+
+/*! \brief Whether a session is relaying, and if so the packets it has relayed to its peer */
+SWITCH_DECLARE(switch_bool_t) switch_rtp_relay_active(switch_rtp_t *rtp_session, switch_size_t *packets);
+
 /*! 
   \brief Acvite a jitter buffer on an RTP session
   \param rtp_session the rtp session
-  \param queue_frames the number of frames to delay
+  \param queue_frames the number of frames to delay (the floor when adaptive)
+  \param jb_flags SWITCH_RTP_JB_* options
   \return SWITCH_STATUS_SUCCESS
 */
 SWITCH_DECLARE(switch_status_t) switch_rtp_activate_jitter_buffer(switch_rtp_t *rtp_session, 
 																  uint32_t queue_frames,
 																  uint32_t max_queue_frames,
-																  uint32_t samples_per_packet, uint32_t samples_per_second, uint32_t max_drift);
+																  uint32_t samples_per_packet, uint32_t samples_per_second, uint32_t max_drift,
+																  switch_rtp_jb_flag_t jb_flags);
 
 SWITCH_DECLARE(switch_status_t) switch_rtp_debug_jitter_buffer(switch_rtp_t *rtp_session, const char *name);
 
@@ -46,6 +46,8 @@ SWITCH_BEGIN_EXTERN_C
 	char *group;
 	void *cmd_arg;
 	uint32_t task_id;
+	/*! when set, the epoch time in milliseconds to run at, takes precedence over runtime */
+	int64_t runtime_ms;
 };
 
 
@@ -64,6 +66,16 @@ SWITCH_DECLARE(uint32_t) switch_scheduler_add_task(time_t task_runtime,
 												   switch_scheduler_func_t func,
 												   const char *desc, const char *group, uint32_t cmd_id, void *cmd_arg, switch_scheduler_flag_t flags);
 
+/*!
+  \brief Schedule a task in the future with millisecond resolution
+  \param task_runtime_ms the time in epoch milliseconds to execute the task.
+  \note the callback reschedules itself by moving task->runtime_ms forward, see switch_scheduler_add_task() for the rest
+  \return the id of the task
+*/
+SWITCH_DECLARE(uint32_t) switch_scheduler_add_task_ms(int64_t task_runtime_ms,
+													  switch_scheduler_func_t func,
+													  const char *desc, const char *group, uint32_t cmd_id, void *cmd_arg, switch_scheduler_flag_t flags);
+
 /*!
   \brief Delete a scheduled task
   \param task_id the id of the task
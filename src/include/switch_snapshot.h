@@ -0,0 +1,109 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2012, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * switch_snapshot.h - Runtime state kept across a restart
+ *
+ */
+
+ /*!
+  \defgroup snapshot1 SNAPSHOT code
+  \ingroup core1
+  \{
+*/
+#ifndef _SWITCH_SNAPSHOT_H
+#define _SWITCH_SNAPSHOT_H
+
+SWITCH_BEGIN_EXTERN_C
+
+typedef struct switch_snapshot_writer switch_snapshot_writer_t;
+
+/*!
+  \brief Writes the state of one owner at shutdown, one switch_snapshot_write() per record
+  \note runs after the sessions are gone and before any module is unloaded
+*/
+typedef switch_status_t (*switch_snapshot_save_callback_t) (switch_snapshot_writer_t *writer, void *user_data);
+
+/*!
+  \brief Reads back one record written by the save callback
+  \param data the record, only valid for the duration of the call
+  \param len the length of the record
+  \param age how many seconds ago the snapshot was written
+*/
+typedef switch_status_t (*switch_snapshot_load_callback_t) (const void *data, switch_size_t len, uint32_t age, void *user_data);
+
+/*!
+  \brief Initilize the SNAPSHOT Core System
+  \param pool the memory pool to use for long term allocations
+  \note Generally called by the core_init
+*/
+SWITCH_DECLARE(void) switch_snapshot_init(switch_memory_pool_t *pool);
+
+SWITCH_DECLARE(void) switch_snapshot_shutdown(void);
+
+/*! \brief Turn saving and restoring on or off, off by default (state-snapshot in switch.conf) */
+SWITCH_DECLARE(void) switch_snapshot_set_enabled(switch_bool_t enabled);
+
+/*! \brief Ignore a snapshot older than this many seconds (state-snapshot-max-age in switch.conf) */
+SWITCH_DECLARE(void) switch_snapshot_set_max_age(uint32_t seconds);
+
+/*!
+  \brief Register the save and load callbacks of an owner
+  \param name unique name of the owner, e.g. mod_hash
+  \param version format of the records, a snapshot saved with another version is not handed to load
+  \note when a snapshot is open the saved records are handed to load before this returns, at most once per process
+*/
+SWITCH_DECLARE(switch_status_t) switch_snapshot_register(const char *name, uint32_t version, switch_snapshot_save_callback_t save,
+														 switch_snapshot_load_callback_t load, void *user_data);
+
+SWITCH_DECLARE(switch_status_t) switch_snapshot_unregister(const char *name);
+
+/*! \brief Append one record from a save callback */
+SWITCH_DECLARE(switch_status_t) switch_snapshot_write(switch_snapshot_writer_t *writer, const void *data, switch_size_t len);
+
+/*! \brief Map the snapshot left by the last shutdown and restore the owners registered so far, called before the modules load */
+SWITCH_DECLARE(void) switch_snapshot_open(void);
+
+/*! \brief Let go of the mapping once the modules are up, later registrations start cold */
+SWITCH_DECLARE(void) switch_snapshot_release(void);
+
+/*! \brief Write the state of every owner, the file is written aside and renamed */
+SWITCH_DECLARE(switch_status_t) switch_snapshot_save(void);
+
+/*! \brief List the owners and what the open snapshot holds for them */
+SWITCH_DECLARE(void) switch_snapshot_dump(switch_stream_handle_t *stream);
+
+SWITCH_END_EXTERN_C
+#endif
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -253,6 +253,15 @@ typedef enum {
 	SWITCH_CALL_DIRECTION_OUTBOUND
 } switch_call_direction_t;
 
+/*! \brief What a thread does, each role can be given its own cpu placement with switch_core_thread_set_affinity_policy() */
+typedef enum {
+	SWITCH_THREAD_ROLE_SESSION,
+	SWITCH_THREAD_ROLE_MEDIA,
+	SWITCH_THREAD_ROLE_SIGNALING,
+	SWITCH_THREAD_ROLE_EVENT,
+	SWITCH_THREAD_ROLE_MAX
+} switch_thread_role_t;
+
 typedef enum {
 	SBF_DIAL_ALEG = (1 << 0),
 	SBF_EXEC_ALEG = (1 << 1),
@@ -320,7 +329,9 @@ typedef enum {
 	SCF_THREADED_SYSTEM_EXEC = (1 << 18),
 	SCF_SYNC_CLOCK_REQUESTED = (1 << 19),
 	SCF_CORE_ODBC_REQ = (1 << 20),
-	SCF_DEBUG_SQL = (1 << 21)
+	SCF_DEBUG_SQL = (1 << 21),
+	SCF_XML_SNAPSHOT = (1 << 22),
+	SCF_MEDIA_LATENCY_PROBE = (1 << 23)
 } switch_core_flag_enum_t;
 typedef uint32_t switch_core_flag_t;
 
@@ -433,7 +444,11 @@ typedef enum {
 	SWITCH_ABC_TYPE_WRITE_REPLACE,
 	SWITCH_ABC_TYPE_READ_REPLACE,
 	SWITCH_ABC_TYPE_READ_PING,
-	SWITCH_ABC_TYPE_CLOSE
+	SWITCH_ABC_TYPE_CLOSE,
+	SWITCH_ABC_TYPE_TAP_NATIVE_READ,
+	SWITCH_ABC_TYPE_TAP_NATIVE_WRITE,
+	SWITCH_ABC_TYPE_TAP_READ,
+	SWITCH_ABC_TYPE_TAP_WRITE
 } switch_abc_type_t;
 
 typedef struct {
@@ -546,6 +561,12 @@ typedef struct {
 	switch_size_t cng_packet_count;
 	switch_size_t flush_packet_count;
 	switch_size_t largest_jb_size;
+	switch_size_t jb_size;
+	switch_size_t jb_target_size;
+	switch_size_t jb_plc_count;
+	switch_size_t jb_jitter_ms;
+	switch_size_t batch_count;
+	switch_size_t largest_batch;
 } switch_rtp_numbers_t;
 
 
@@ -725,6 +746,18 @@ typedef enum {
 
 } switch_rtp_bug_flag_t;
 
+/*!
+  \enum switch_rtp_jb_flag_enum_t
+  \brief Jitter buffer options for switch_rtp_activate_jitter_buffer
+<pre>
+SWITCH_RTP_JB_ADAPTIVE   - Size the buffer from measured interarrival jitter and conceal underruns with PLC frames
+</pre>
+ */
+typedef enum {
+	SWITCH_RTP_JB_ADAPTIVE = (1 << 0)
+} switch_rtp_jb_flag_enum_t;
+typedef uint32_t switch_rtp_jb_flag_t;
+
 #ifdef _MSC_VER
 #pragma pack(push, r1, 1)
 #endif
@@ -1427,6 +1460,10 @@ SMBF_THREAD_LOCK - Only let the same thread who created the bug remove it.
 SMBF_PRUNE - 
 SMBF_NO_PAUSE - 
 SMBF_STEREO_SWAP - Record in stereo: Write Stream - left channel, Read Stream - right channel
+SMBF_TAP_NATIVE_READ - Hand over every frame read from the endpoint as it arrived, before it is decoded
+SMBF_TAP_NATIVE_WRITE - Hand over every frame written to the endpoint as it leaves, after it is encoded
+SMBF_TAP_READ - Hand over every decoded read frame as is, without buffering a copy for the bug
+SMBF_TAP_WRITE - Hand over every decoded write frame as is, without buffering a copy for the bug
 </pre>
 */
 typedef enum {
@@ -1442,7 +1479,11 @@ typedef enum {
 	SMBF_PRUNE = (1 << 8),
 	SMBF_NO_PAUSE = (1 << 9),
 	SMBF_STEREO_SWAP = (1 << 10),
-	SMBF_LOCK = (1 << 11)
+	SMBF_LOCK = (1 << 11),
+	SMBF_TAP_NATIVE_READ = (1 << 12),
+	SMBF_TAP_NATIVE_WRITE = (1 << 13),
+	SMBF_TAP_READ = (1 << 14),
+	SMBF_TAP_WRITE = (1 << 15)
 } switch_media_bug_flag_enum_t;
 typedef uint32_t switch_media_bug_flag_t;
 
@@ -1462,6 +1503,8 @@ SWITCH_FILE_PAUSE =             (1 <<  8) - Pause
 SWITCH_FILE_NATIVE =            (1 <<  9) - File is in native format (no transcoding)
 SWITCH_FILE_SEEK = 				(1 << 10) - File has done a seek
 SWITCH_FILE_OPEN =              (1 << 11) - File is open
+SWITCH_FILE_NOCACHE =           (1 << 17) - Read from the file itself, never from the prompt cache
+SWITCH_FILE_FSYNC =             (1 << 18) - Flush the written file to disk when it is closed
 </pre>
  */
 typedef enum {
@@ -1481,7 +1524,9 @@ typedef enum {
 	SWITCH_FILE_DONE = (1 << 13),
 	SWITCH_FILE_BUFFER_DONE = (1 << 14),
 	SWITCH_FILE_WRITE_APPEND = (1 << 15),
-	SWITCH_FILE_WRITE_OVER = (1 << 16)
+	SWITCH_FILE_WRITE_OVER = (1 << 16),
+	SWITCH_FILE_NOCACHE = (1 << 17),
+	SWITCH_FILE_FSYNC = (1 << 18)
 } switch_file_flag_enum_t;
 typedef uint32_t switch_file_flag_t;
 
@@ -1645,6 +1690,11 @@ typedef enum {
 	SWITCH_EVENT_ALL
 } switch_event_types_t;
 
+typedef enum {
+	SWITCH_EVENT_QUEUE_DROP,
+	SWITCH_EVENT_QUEUE_BLOCK
+} switch_event_queue_policy_t;
+
 typedef enum {
 	SWITCH_INPUT_TYPE_DTMF,
 	SWITCH_INPUT_TYPE_EVENT
@@ -1721,6 +1771,35 @@ typedef enum {
 	SWITCH_CAUSE_INVALID_PROFILE = 611
 } switch_call_cause_t;
 
+typedef enum {
+	SWITCH_TRACE_STATE,
+	SWITCH_TRACE_MESSAGE,
+	SWITCH_TRACE_APP,
+	SWITCH_TRACE_HANGUP,
+	SWITCH_TRACE_RTP,
+	SWITCH_TRACE_USER
+} switch_session_trace_type_t;
+
+typedef enum {
+	SWITCH_TRACE_DUMP_NEVER,
+	SWITCH_TRACE_DUMP_FAILED,
+	SWITCH_TRACE_DUMP_ALWAYS
+} switch_session_trace_dump_t;
+
+/* call setup phases timed by switch_core_session_record_phase() */
+typedef enum {
+	SWITCH_PHASE_ROUTE,				/* session created -> routing starts */
+	SWITCH_PHASE_DIALPLAN,			/* one dialplan hunt */
+	SWITCH_PHASE_XML_FETCH,			/* one fetch from an xml binding */
+	SWITCH_PHASE_MEDIA,				/* one offer/answer negotiation */
+	SWITCH_PHASE_ORIGINATE_RING,	/* originate starts -> the winning leg rings or has early media */
+	SWITCH_PHASE_ORIGINATE_ANSWER,	/* originate starts -> the winning leg answers */
+	SWITCH_PHASE_ANSWER,			/* session created -> answered */
+	SWITCH_PHASE_BRIDGE,			/* session created -> bridged */
+	SWITCH_PHASE_SQL,				/* one switch_cache_db_execute_sql() */
+	SWITCH_PHASE_COUNT
+} switch_session_phase_t;
+
 typedef enum {
 	SCSC_PAUSE_INBOUND,
 	SCSC_PAUSE_OUTBOUND,
@@ -1772,12 +1851,15 @@ typedef struct switch_rtcp switch_rtcp_t;
 typedef struct switch_core_session_message switch_core_session_message_t;
 typedef struct switch_event_header switch_event_header_t;
 typedef struct switch_event switch_event_t;
+typedef struct switch_expand_template switch_expand_template_t;
 typedef struct switch_event_subclass switch_event_subclass_t;
 typedef struct switch_event_node switch_event_node_t;
+typedef struct switch_event_snapshot switch_event_snapshot_t;
 typedef struct switch_loadable_module switch_loadable_module_t;
 typedef struct switch_frame switch_frame_t;
 typedef struct switch_rtcp_frame switch_rtcp_frame_t;
 typedef struct switch_channel switch_channel_t;
+typedef struct switch_channel_waiter switch_channel_waiter_t;
 typedef struct switch_file_handle switch_file_handle_t;
 typedef struct switch_core_session switch_core_session_t;
 typedef struct switch_caller_profile switch_caller_profile_t;
@@ -1786,9 +1868,12 @@ typedef struct switch_caller_application switch_caller_application_t;
 typedef struct switch_state_handler_table switch_state_handler_table_t;
 typedef struct switch_timer switch_timer_t;
 typedef struct switch_codec switch_codec_t;
+typedef struct switch_codec_offload_job switch_codec_offload_job_t;
+typedef struct switch_codec_offload_engine switch_codec_offload_engine_t;
 typedef struct switch_core_thread_session switch_core_thread_session_t;
 typedef struct switch_codec_implementation switch_codec_implementation_t;
 typedef struct switch_buffer switch_buffer_t;
+typedef struct switch_ringbuffer switch_ringbuffer_t;
 typedef struct switch_codec_settings switch_codec_settings_t;
 typedef struct switch_codec_fmtp switch_codec_fmtp_t;
 typedef struct switch_odbc_handle switch_odbc_handle_t;
@@ -1869,6 +1954,7 @@ typedef switch_caller_extension_t *(*switch_dialplan_hunt_function_t) (switch_co
 
 typedef switch_bool_t (*switch_hash_delete_callback_t) (_In_ const void *key, _In_ const void *val, _In_opt_ void *pData);
 #define SWITCH_HASH_DELETE_FUNC(name) static switch_bool_t name (const void *key, const void *val, void *pData)
+typedef void *(*switch_striped_hash_callback_t) (_In_z_ const char *key, _In_opt_ void *val, _In_opt_ void *pData);
 
 typedef struct switch_scheduler_task switch_scheduler_task_t;
 
@@ -1880,6 +1966,7 @@ typedef switch_status_t (*switch_state_handler_t) (switch_core_session_t *);
 typedef struct switch_stream_handle switch_stream_handle_t;
 typedef switch_status_t (*switch_stream_handle_write_function_t) (switch_stream_handle_t *handle, const char *fmt, ...);
 typedef switch_status_t (*switch_stream_handle_raw_write_function_t) (switch_stream_handle_t *handle, uint8_t *data, switch_size_t datalen);
+typedef switch_status_t (*switch_stream_handle_flush_function_t) (switch_stream_handle_t *handle, const uint8_t *data, switch_size_t datalen);
 
 typedef switch_status_t (*switch_api_function_t) (_In_opt_z_ const char *cmd, _In_opt_ switch_core_session_t *session,
 												  _In_ switch_stream_handle_t *stream);
@@ -1956,6 +2043,8 @@ typedef switch_xml_t(*switch_xml_search_function_t) (const char *section,
 													 void *user_data);
 
 typedef struct switch_hash switch_hash_t;
+typedef struct switch_striped_hash switch_striped_hash_t;
+typedef struct switch_slab switch_slab_t;
 struct HashElem;
 typedef struct HashElem switch_hash_index_t;
 
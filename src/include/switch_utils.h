@@ -284,8 +284,20 @@ static inline int switch_false(const char *expr)
 }
 
 
+/*!
+  \brief Resolve a host name to an address string
+  \note answers are cached for dns-cache-ttl seconds and failures for dns-negative-ttl, a name about to expire or
+  already past it is refreshed in the background while the cached address keeps being returned, so a dead DNS server
+  only costs the first lookup of a name
+*/
 SWITCH_DECLARE(switch_status_t) switch_resolve_host(const char *host, char *buf, size_t buflen);
 
+SWITCH_DECLARE(void) switch_resolve_cache_init(switch_memory_pool_t *pool);
+SWITCH_DECLARE(void) switch_resolve_cache_shutdown(void);
+
+/*! \brief Drop every cached answer, or only the one for host */
+SWITCH_DECLARE(void) switch_resolve_cache_flush(const char *host);
+
 
 /*!
   \brief find local ip of the box
@@ -690,6 +702,22 @@ SWITCH_DECLARE(switch_time_t) switch_str_time(const char *in);
 SWITCH_DECLARE(unsigned int) switch_separate_string(_In_ char *buf, char delim, _Post_count_(return) char **array, unsigned int arraylen);
 SWITCH_DECLARE(unsigned int) switch_separate_string_string(char *buf, char *delim, _Post_count_(return) char **array, unsigned int arraylen);
 
+typedef struct {
+	const char *str;
+	switch_size_t len;
+} switch_span_t;
+
+/*!
+  \brief Separate a string like switch_separate_string() without touching it or allocating
+  \param buf the string to parse
+  \param delim the character delimiter (runs of spaces count as one when it is ' ')
+  \param array the spans to fill, each points into buf with its surrounding spaces trimmed
+  \param arraylen the max number of elements in the array, the last one gets the rest of the string
+  \return the number of elements added to the array
+  \note quotes and escapes are honored when looking for delimiters but are left in the spans
+*/
+SWITCH_DECLARE(unsigned int) switch_separate_string_span(_In_z_ const char *buf, char delim, _Post_count_(return) switch_span_t *array, unsigned int arraylen);
+
 
 SWITCH_DECLARE(char *) switch_strip_spaces(char *str, switch_bool_t dup);
 SWITCH_DECLARE(char *) switch_strip_whitespace(const char *str);
@@ -69,7 +69,9 @@ SWITCH_BEGIN_EXTERN_C
 	SWITCH_XML_ROOT = (1 << 0),	// root
 	SWITCH_XML_NAMEM = (1 << 1),	// name is malloced
 	SWITCH_XML_TXTM = (1 << 2),	// txt is malloced
-	SWITCH_XML_DUP = (1 << 3)	// attribute name and value are strduped
+	SWITCH_XML_DUP = (1 << 3),	// attribute name and value are strduped
+	SWITCH_XML_ARENA = (1 << 4),	// tag lives in the arena of its root
+	SWITCH_XML_ARENA_ATTR = (1 << 5)	// attribute list lives in the arena of its root
 } switch_xml_flag_t;
 
 /*! \brief A representation of an XML tree */
@@ -109,6 +111,15 @@ struct switch_xml {
  */
 SWITCH_DECLARE(switch_xml_t) switch_xml_parse_str_dynamic(_In_z_ char *s, _In_ switch_bool_t dup);
 
+/*! 
+ * \brief Parses a string like switch_xml_parse_str_dynamic, keeping the tags and attribute lists in a few blocks freed with the root
+ * \param s The string to parse
+ * \param dup true if you want the string to be strdup()'d automatically
+ * \return the switch_xml_t or NULL if an error occured
+ * \note a tag cut out of such a tree must not outlive its root
+ */
+SWITCH_DECLARE(switch_xml_t) switch_xml_parse_str_arena(_In_z_ char *s, _In_ switch_bool_t dup);
+
 /*! 
  * \brief Parses a string into a switch_xml_t 
  * \param s The string to parse
@@ -225,6 +236,14 @@ SWITCH_DECLARE(char *) switch_xml_toxml_nolock(switch_xml_t xml, _In_ switch_boo
 SWITCH_DECLARE(char *) switch_xml_toxml_buf(_In_ switch_xml_t xml, _In_z_ char *buf, _In_ switch_size_t buflen, _In_ switch_size_t offset,
 											_In_ switch_bool_t prn_header);
 
+///\brief Writes a string to a stream, encoded the way switch_xml_toxml() encodes
+///\ character content (attr false) or attribute values (attr true).
+///\param stream the stream to write to
+///\param s the string to encode, NULL is written as an empty string
+///\param attr encode for an attribute value
+///\return SWITCH_STATUS_SUCCESS or the status of the failed stream write
+SWITCH_DECLARE(switch_status_t) switch_xml_stream_encode(_In_ switch_stream_handle_t *stream, _In_opt_z_ const char *s, _In_ switch_bool_t attr);
+
 ///\brief returns a NULL terminated array of processing instructions for the given
 ///\ target
 ///\param xml the xml node
@@ -340,6 +359,13 @@ SWITCH_DECLARE(switch_status_t) switch_xml_init(_In_ switch_memory_pool_t *pool,
 
 SWITCH_DECLARE(switch_status_t) switch_xml_reload(const char **err);
 
+///\brief reparse only some sections of the core xml registry and keep the rest of the current one
+///\param what comma separated section names or included files, NULL for the sections whose files changed
+///\param err a pointer to set error strings
+///\return SWITCH_STATUS_SUCCESS if successful, err is "Unchanged" when there was nothing to reload
+///\note falls back to a full reload when a change is outside of any section or the tree can't be split
+SWITCH_DECLARE(switch_status_t) switch_xml_reload_sections(_In_opt_z_ const char *what, const char **err);
+
 SWITCH_DECLARE(switch_status_t) switch_xml_destroy(void);
 
 ///\brief retrieve the core XML root node
@@ -406,6 +432,22 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_open_cfg(_In_z_ const char *file_path, _
 SWITCH_DECLARE(void) switch_xml_set_binding_sections(_In_ switch_xml_binding_t *binding, _In_ switch_xml_section_t sections);
 SWITCH_DECLARE(void) switch_xml_set_binding_user_data(_In_ switch_xml_binding_t *binding, _In_opt_ void *user_data);
 SWITCH_DECLARE(switch_xml_section_t) switch_xml_get_binding_sections(_In_ switch_xml_binding_t *binding);
+///\brief cache what a binding returns
+///\param binding the binding
+///\param ttl seconds an answer is reused for, 0 turns the cache off
+///\param key_params optional comma separated list of params that are part of the cache key besides section, tag, key and value
+///\note concurrent identical lookups on a caching binding share a single fetch
+SWITCH_DECLARE(void) switch_xml_set_binding_cache(_In_ switch_xml_binding_t *binding, _In_ uint32_t ttl, _In_opt_z_ const char *key_params);
+///\brief give a caching binding a name that stays the same across restarts
+///\param name unique name, the cached answers of a binding with the same name are kept in the state snapshot
+///\note call it after switch_xml_set_binding_cache(), answers restored for the name are adopted right away
+SWITCH_DECLARE(void) switch_xml_set_binding_name(_In_ switch_xml_binding_t *binding, _In_opt_z_ const char *name);
+///\brief drop cached binding answers
+///\param section only drop answers for this section, NULL for all
+///\param key_value only drop answers for this key value, NULL for all
+///\return the number of answers dropped
+SWITCH_DECLARE(uint32_t) switch_xml_clear_fetch_cache(_In_opt_z_ const char *section, _In_opt_z_ const char *key_value);
+SWITCH_DECLARE(void) switch_xml_fetch_cache_stats(_In_ switch_stream_handle_t *stream);
 SWITCH_DECLARE(void *) switch_xml_get_binding_user_data(_In_ switch_xml_binding_t *binding);
 
 SWITCH_DECLARE(switch_status_t) switch_xml_bind_search_function_ret(_In_ switch_xml_search_function_t function, _In_ switch_xml_section_t sections,
@@ -65,6 +65,8 @@
 #define MAX_FREQUENCY_R(r) ((2.0 * M_PI * MAX_FREQUENCY) / (r))
 /* decrease this value to eliminate false positives */
 #define VARIANCE_THRESHOLD (0.001)
+/*! Frames whose RMS is under this (in 16 bit sample units) can not hold a beep and skip desa2 */
+#define DEFAULT_ENERGY_THRESHOLD (64)
 
 #include "amplitude.h"
 #include "buffer.h"
@@ -120,9 +122,19 @@ typedef struct {
     double f;
     /* freq_table_t ft; */
     avmd_state_t state;
+    /*! Mean square under which a frame is treated as silence */
+    uint64_t energy_threshold;
+    /*! Give up after this many samples without a beep, 0 for never */
+    uint64_t timeout_samples;
+    /*! Remove the bug once the beep is found */
+    switch_bool_t detach_on_beep;
+    uint64_t samples;
+    uint32_t frames;
+    uint32_t skipped_frames;
+    switch_time_t cpu_usec;
 } avmd_session_t;
 
-static void avmd_process(avmd_session_t *session, switch_frame_t *frame);
+static switch_bool_t avmd_process(avmd_session_t *session, const switch_frame_t *frame);
 static switch_bool_t avmd_callback(switch_media_bug_t * bug, void *user_data, switch_abc_type_t type);
 static void init_avmd_session_data(avmd_session_t *avmd_session,  switch_core_session_t *fs_session);
 
@@ -155,6 +167,52 @@ static void init_avmd_session_data(avmd_session_t *avmd_session,  switch_core_se
         BEEP_LEN(avmd_session->rate) / SINE_LEN(avmd_session->rate),
         fs_session
     );
+
+    avmd_session->energy_threshold = DEFAULT_ENERGY_THRESHOLD * DEFAULT_ENERGY_THRESHOLD;
+    avmd_session->timeout_samples = 0;
+    avmd_session->detach_on_beep = SWITCH_TRUE;
+    avmd_session->samples = 0;
+    avmd_session->frames = 0;
+    avmd_session->skipped_frames = 0;
+    avmd_session->cpu_usec = 0;
+}
+
+/*! \brief Read the per call tuning from channel variables, once the rate is known
+ * @param avmd_session A reference to a avmd session
+ */
+static void avmd_session_set_options(avmd_session_t *avmd_session)
+{
+    switch_channel_t *channel = switch_core_session_get_channel(avmd_session->session);
+    const char *var;
+    int tmp;
+
+    if ((var = switch_channel_get_variable(channel, "avmd_energy_threshold")) && (tmp = atoi(var)) >= 0) {
+        avmd_session->energy_threshold = (uint64_t) tmp * tmp;
+    }
+
+    if ((var = switch_channel_get_variable(channel, "avmd_timeout")) && (tmp = atoi(var)) > 0) {
+        avmd_session->timeout_samples = (uint64_t) tmp * avmd_session->rate / 1000;
+    }
+
+    if ((var = switch_channel_get_variable(channel, "avmd_detach_on_beep"))) {
+        avmd_session->detach_on_beep = switch_true(var) ? SWITCH_TRUE : SWITCH_FALSE;
+    }
+}
+
+/*! \brief Report what detection cost this channel
+ * @param avmd_session A reference to a avmd session
+ */
+static void avmd_session_report(avmd_session_t *avmd_session)
+{
+    switch_channel_t *channel = switch_core_session_get_channel(avmd_session->session);
+
+    switch_channel_set_variable_printf(channel, "avmd_cpu_usec", "%" SWITCH_TIME_T_FMT, avmd_session->cpu_usec);
+    switch_channel_set_variable_printf(channel, "avmd_frames", "%u", avmd_session->frames);
+    switch_channel_set_variable_printf(channel, "avmd_skipped_frames", "%u", avmd_session->skipped_frames);
+
+    switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(avmd_session->session), SWITCH_LOG_DEBUG,
+        "AVMD done: %u frames, %u skipped as silence, %" SWITCH_TIME_T_FMT "us\n",
+        avmd_session->frames, avmd_session->skipped_frames, avmd_session->cpu_usec);
 }
 
 
@@ -170,7 +228,9 @@ static switch_bool_t avmd_callback(switch_media_bug_t * bug, void *user_data, sw
 {
     avmd_session_t *avmd_session;
     switch_codec_t *read_codec;
-    switch_frame_t *frame;
+    const switch_frame_t *frame;
+    switch_time_t start;
+    switch_bool_t ok;
 
 
     avmd_session = (avmd_session_t *) user_data;
@@ -184,25 +244,38 @@ static switch_bool_t avmd_callback(switch_media_bug_t * bug, void *user_data, sw
         read_codec = switch_core_session_get_read_codec(avmd_session->session);
         avmd_session->rate = read_codec->implementation->samples_per_second;
         /* avmd_session->vmd_codec.channels = read_codec->implementation->number_of_channels; */
+        avmd_session_set_options(avmd_session);
         break;
 
     case SWITCH_ABC_TYPE_READ_PING:
         break;
     case SWITCH_ABC_TYPE_CLOSE:
-		
+        avmd_session_report(avmd_session);
+        /* we may be going away on our own, don't leave the tag behind */
+        if (switch_channel_get_private(switch_core_session_get_channel(avmd_session->session), "_avmd_") == bug) {
+            switch_channel_set_private(switch_core_session_get_channel(avmd_session->session), "_avmd_", NULL);
+        }
         break;
     case SWITCH_ABC_TYPE_READ:
         break;
     case SWITCH_ABC_TYPE_WRITE:
         break;
 
-    case SWITCH_ABC_TYPE_READ_REPLACE:
-        frame = switch_core_media_bug_get_read_replace_frame(bug);
-        avmd_process(avmd_session, frame);
-        return SWITCH_TRUE;
+    case SWITCH_ABC_TYPE_TAP_READ:
+        if (!(frame = switch_core_media_bug_get_tap_read_frame(bug))) {
+            return SWITCH_TRUE;
+        }
+        start = switch_time_now();
+        ok = avmd_process(avmd_session, frame);
+        avmd_session->cpu_usec += switch_time_now() - start;
+        /* returning false detaches the bug */
+        return ok;
 
     case SWITCH_ABC_TYPE_WRITE_REPLACE:
         break;
+
+    default:
+        break;
     }
 
     return SWITCH_TRUE;
@@ -291,6 +364,11 @@ SWITCH_STANDARD_APP(avmd_start_function)
         return;
     }
 
+    /* It may have already stopped on its own */
+    if (!zstr(data) && strcasecmp(data, "stop") == 0) {
+        return;
+    }
+
     avmd_session = (avmd_session_t *)switch_core_session_alloc(session, sizeof(avmd_session_t));
 
     init_avmd_session_data(avmd_session, session);
@@ -302,7 +380,7 @@ SWITCH_STANDARD_APP(avmd_start_function)
         avmd_callback,
         avmd_session,
         0,
-        SMBF_READ_REPLACE,
+        SMBF_TAP_READ,
         &bug
     );
 
@@ -417,6 +495,12 @@ SWITCH_STANDARD_API(avmd_api_main)
         goto end;
     }
 
+    /* It may have already stopped on its own */
+    if (strcasecmp(command, "stop") == 0) {
+        stream->write_function(stream, "+OK\n");
+        goto end;
+    }
+
     /* If we don't see the expected start exit */
     if (strcasecmp(command, "start") != 0) {
         stream->write_function(stream, "-USAGE: %s\n", AVMD_SYNTAX);
@@ -438,7 +522,7 @@ SWITCH_STANDARD_API(avmd_api_main)
         avmd_callback,
         avmd_session,
         0,
-        SMBF_READ_REPLACE,
+        SMBF_TAP_READ,
         &bug
     );
 
@@ -476,8 +560,9 @@ end:
  * @author Eric des Courtis
  * @param session An avmd session
  * @param frame A audio frame
+ * @return SWITCH_FALSE once detection is over and the bug can go
  */
-static void avmd_process(avmd_session_t *session, switch_frame_t *frame)
+static switch_bool_t avmd_process(avmd_session_t *session, const switch_frame_t *frame)
 {
     switch_event_t *event;
     switch_status_t status;
@@ -486,41 +571,57 @@ static void avmd_process(avmd_session_t *session, switch_frame_t *frame)
 
     circ_buffer_t *b;
     size_t pos;
+    size_t end;
     double f;
     double v;
-//    double error = 0.0;
-//    double success = 0.0;
-//    double amp = 0.0;
-//    double s_rate;
-//    double e_rate;
-//    double avg_a;
-    //double sine_len;
     uint32_t sine_len_i;
-    //uint32_t beep_len_i;
-//    int valid;
 
 	b = &session->b;
 
 	/*! If beep has already been detected skip the CPU heavy stuff */
     if(session->state.beep_state == BEEP_DETECTED){
-        return;
+        return session->detach_on_beep ? SWITCH_FALSE : SWITCH_TRUE;
     }
 
 	/*! Precompute values used heavily in the inner loop */
     sine_len_i = SINE_LEN(session->rate);
-    //sine_len = (double)sine_len_i;
-    //beep_len_i = BEEP_LEN(session->rate);
 	
     channel = switch_core_session_get_channel(session->session);
 
+    session->frames++;
+    session->samples += frame->samples;
+
 	/*! Insert frame of 16 bit samples into buffer */
     INSERT_INT16_FRAME(b, (int16_t *)(frame->data), frame->samples);
 
-    //switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session->session), SWITCH_LOG_INFO, "<<< AVMD sine_len_i=%d >>>\n", sine_len_i);
+    end = GET_CURRENT_POS(b) - P;
+
+    /*! A frame this quiet can not hold a beep, skip desa2 for it */
+    if (session->energy_threshold && frame->samples) {
+        const int16_t *data = (const int16_t *) frame->data;
+        uint64_t energy = 0;
+        uint32_t i;
+
+        for (i = 0; i < frame->samples; i++) {
+            energy += (int32_t) data[i] * data[i];
+        }
+
+        if (energy / frame->samples < session->energy_threshold) {
+            session->skipped_frames++;
+            RESET_SMA_BUFFER(&session->sma_b);
+            RESET_SMA_BUFFER(&session->sqa_b);
+            session->pos = end;
+            goto check_timeout;
+        }
+    }
+
+    /*! INNER LOOP -- desa2 only runs every sine len, step straight to those positions */
+    pos = session->pos;
+    if (pos % sine_len_i) {
+        pos += sine_len_i - (pos % sine_len_i);
+    }
 
-    /*! INNER LOOP -- OPTIMIZATION TARGET */
-    for(pos = session->pos; pos < (GET_CURRENT_POS(b) - P); pos++){
-       if ((pos % sine_len_i) == 0) {
+    for(; pos < end; pos += sine_len_i){
                  /*! Get a desa2 frequency estimate every sine len */
 		f = desa2(b, pos);
 
@@ -544,7 +645,7 @@ static void avmd_process(avmd_session_t *session, switch_frame_t *frame)
 				/*! Throw an event to FreeSWITCH */
                 status = switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, AVMD_EVENT_BEEP);
                 if(status != SWITCH_STATUS_SUCCESS) {
-                    return;
+                    return SWITCH_TRUE;
                 }
 
                 switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Beep-Status", "stop");
@@ -552,7 +653,7 @@ static void avmd_process(avmd_session_t *session, switch_frame_t *frame)
                 switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "call-command", "avmd");
 
                 if ((switch_event_dup(&event_copy, event)) != SWITCH_STATUS_SUCCESS) {
-                    return;
+                    return SWITCH_TRUE;
                 }
 
                 switch_core_session_queue_event(session->session, &event);
@@ -564,15 +665,21 @@ static void avmd_process(avmd_session_t *session, switch_frame_t *frame)
 		RESET_SMA_BUFFER(&session->sqa_b);
                 session->state.beep_state = BEEP_DETECTED;
 
-                return;
+                return session->detach_on_beep ? SWITCH_FALSE : SWITCH_TRUE;
             }
+    }
+    session->pos = end;
 
-            //amp = 0.0;
-            //success = 0.0;
-            //error = 0.0;
-        }
+ check_timeout:
+
+    /*! Nothing showed up in time, stop paying for it */
+    if (session->timeout_samples && session->samples >= session->timeout_samples) {
+        switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session->session), SWITCH_LOG_INFO, "<<< AVMD - No Beep, giving up >>>\n");
+        switch_channel_set_variable(channel, "avmd_detect", "FALSE");
+        return SWITCH_FALSE;
     }
-    session->pos = pos;
+
+    return SWITCH_TRUE;
 }
 
 /* For Emacs:
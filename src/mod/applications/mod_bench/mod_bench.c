@@ -0,0 +1,918 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2012, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * mod_bench.c -- Call load generator and capacity benchmark
+ *
+ * Calls are originated at a steady rate to the dial string of a scenario, normally loopback/ or
+ * a sofia profile pointed back at the box, into a dialplan extension that bridges, runs an IVR,
+ * joins a conference or records.  Every originated leg runs the bench_leg application, which
+ * plays a tone through an L16 write codec so the far side always has real audio to transcode,
+ * mix or record, and times each frame it reads back to measure media jitter.
+ *
+ * A run reports call setup latency, jitter, idle cpu and failure causes, together with the
+ * scenario and version it ran with so two releases can be compared on the same numbers.
+ */
+#include <switch.h>
+#include <switch_version.h>
+#include <math.h>
+
+#define BENCH_SAMPLES 100000
+#define BENCH_MAX_CAUSE 1024
+#define BENCH_PRIVATE "_bench_leg_"
+#define BENCH_SYNTAX "start <scenario> [cps=<n>] [calls=<n>] [duration=<sec>] [max-sessions=<n>]|stop|status|report [<file>]|scenarios"
+
+SWITCH_MODULE_LOAD_FUNCTION(mod_bench_load);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_bench_shutdown);
+SWITCH_MODULE_DEFINITION(mod_bench, mod_bench_load, mod_bench_shutdown, NULL);
+
+typedef struct {
+	char *name;
+	char *dial_string;
+	char *cid_name;
+	char *cid_number;
+	double cps;
+	uint32_t calls;
+	uint32_t duration;
+	uint32_t max_sessions;
+	uint32_t timeout;
+	uint32_t tone;
+} bench_scenario_t;
+
+typedef struct {
+	uint32_t id;
+	bench_scenario_t sc;
+	char dial_string[1024];
+	switch_time_t started;
+	switch_time_t stopped;
+	uint32_t attempted;
+	uint32_t answered;
+	uint32_t failed;
+	uint32_t throttled;
+	uint32_t active;
+	uint32_t peak_active;
+	uint32_t setup_min;
+	uint32_t setup_max;
+	uint64_t setup_total;
+	uint64_t setup_seen;
+	uint32_t setup_count;
+	uint32_t setup[BENCH_SAMPLES];
+	uint32_t jitter_calls;
+	double jitter_total;
+	double jitter_max;
+	uint64_t frames;
+	uint64_t late_frames;
+	uint64_t cng_frames;
+	uint32_t idle_samples;
+	double idle_total;
+	double idle_min;
+	uint32_t causes[BENCH_MAX_CAUSE];
+	uint32_t rand_state;
+} bench_run_t;
+
+/* what a leg measured, in the session pool, accounted for once when the session goes away */
+typedef struct {
+	uint32_t run_id;
+	uint32_t duration;
+	uint32_t tone;
+	double jitter_ms;
+	uint64_t frames;
+	uint64_t late_frames;
+	uint64_t cng_frames;
+	int measured;
+} bench_leg_t;
+
+typedef struct {
+	uint32_t run_id;
+	uint32_t seq;
+	switch_memory_pool_t *pool;
+} bench_call_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_hash_t *scenarios;
+	char *report_dir;
+	bench_run_t *run;
+	uint32_t next_id;
+	int running;
+	int stop;
+	int shutdown;
+	switch_thread_t *thread;
+} globals;
+
+static switch_status_t bench_leg_destroy(switch_core_session_t *session);
+
+static switch_state_handler_table_t bench_state_handlers = {
+	/*.on_init */ NULL,
+	/*.on_routing */ NULL,
+	/*.on_execute */ NULL,
+	/*.on_hangup */ NULL,
+	/*.on_exchange_media */ NULL,
+	/*.on_soft_execute */ NULL,
+	/*.on_consume_media */ NULL,
+	/*.on_hibernate */ NULL,
+	/*.on_reset */ NULL,
+	/*.on_park */ NULL,
+	/*.on_reporting */ NULL,
+	/*.on_destroy */ bench_leg_destroy
+};
+
+/* the run a leg or call belongs to, NULL once a newer run replaced it, call with globals.mutex held */
+static bench_run_t *bench_run_by_id(uint32_t id)
+{
+	return (globals.run && globals.run->id == id) ? globals.run : NULL;
+}
+
+/* a reservoir keeps the percentiles honest however many calls a run makes */
+static void bench_add_setup(bench_run_t *run, uint32_t ms)
+{
+	if (!run->setup_seen++ || ms < run->setup_min) {
+		run->setup_min = ms;
+	}
+	if (ms > run->setup_max) {
+		run->setup_max = ms;
+	}
+	run->setup_total += ms;
+
+	if (run->setup_count < BENCH_SAMPLES) {
+		run->setup[run->setup_count++] = ms;
+	} else {
+		uint64_t slot;
+
+		run->rand_state = run->rand_state * 1103515245 + 12345;
+		slot = ((uint64_t) run->rand_state << 16 | (run->rand_state >> 16)) % run->setup_seen;
+		if (slot < BENCH_SAMPLES) {
+			run->setup[slot] = ms;
+		}
+	}
+}
+
+static void bench_count_cause(bench_run_t *run, switch_call_cause_t cause)
+{
+	run->causes[(uint32_t) cause < BENCH_MAX_CAUSE ? cause : 0]++;
+}
+
+static switch_status_t bench_leg_destroy(switch_core_session_t *session)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	bench_leg_t *leg = switch_channel_get_private(channel, BENCH_PRIVATE);
+	bench_run_t *run;
+
+	if (!leg) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_channel_set_private(channel, BENCH_PRIVATE, NULL);
+
+	switch_mutex_lock(globals.mutex);
+	if ((run = bench_run_by_id(leg->run_id))) {
+		if (leg->measured) {
+			run->jitter_calls++;
+			run->jitter_total += leg->jitter_ms;
+			if (leg->jitter_ms > run->jitter_max) {
+				run->jitter_max = leg->jitter_ms;
+			}
+			run->frames += leg->frames;
+			run->late_frames += leg->late_frames;
+			run->cng_frames += leg->cng_frames;
+		}
+		bench_count_cause(run, switch_channel_get_cause(channel));
+		run->active--;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define BENCH_LEG_DESC "Benchmark leg: play a tone and measure the jitter of the audio coming back"
+
+/* RFC 3550 style interarrival jitter over the frames read, against the packet time of the read codec */
+SWITCH_STANDARD_APP(bench_leg_function)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	bench_leg_t *leg = switch_channel_get_private(channel, BENCH_PRIVATE);
+	switch_codec_implementation_t read_impl = { 0 };
+	switch_codec_t codec = { 0 };
+	switch_frame_t write_frame = { 0 };
+	switch_frame_t *read_frame;
+	switch_status_t status;
+	switch_time_t now, last = 0, end, ptime;
+	int16_t *audio;
+	uint32_t samples, i;
+	uint64_t pos = 0;
+	double step, jitter = 0;
+
+	if (!leg) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "bench_leg only runs on calls started by bench\n");
+		return;
+	}
+
+	switch_core_session_get_read_impl(session, &read_impl);
+
+	if (!read_impl.samples_per_packet || !read_impl.microseconds_per_packet) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "No media, nothing to measure\n");
+		switch_channel_hangup(channel, SWITCH_CAUSE_NORMAL_CLEARING);
+		return;
+	}
+
+	if (switch_core_codec_init(&codec,
+							   "L16",
+							   NULL,
+							   read_impl.actual_samples_per_second,
+							   read_impl.microseconds_per_packet / 1000,
+							   1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE, NULL,
+							   switch_core_session_get_pool(session)) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Raw codec activation failed\n");
+		switch_channel_hangup(channel, SWITCH_CAUSE_INCOMPATIBLE_DESTINATION);
+		return;
+	}
+
+	samples = read_impl.actual_samples_per_second * (read_impl.microseconds_per_packet / 1000) / 1000;
+	audio = switch_core_session_alloc(session, samples * sizeof(*audio));
+	write_frame.codec = &codec;
+	write_frame.data = audio;
+	write_frame.buflen = samples * sizeof(*audio);
+	write_frame.datalen = samples * sizeof(*audio);
+	write_frame.samples = samples;
+
+	ptime = read_impl.microseconds_per_packet;
+	step = 2 * M_PI * leg->tone / read_impl.actual_samples_per_second;
+	end = switch_micro_time_now() + (switch_time_t) leg->duration * 1000000;
+
+	while (switch_channel_ready(channel) && !globals.shutdown) {
+		status = switch_core_session_read_frame(session, &read_frame, SWITCH_IO_FLAG_NONE, 0);
+
+		if (!SWITCH_READ_ACCEPTABLE(status)) {
+			break;
+		}
+
+		now = switch_micro_time_now();
+
+		if (now >= end) {
+			break;
+		}
+
+		if (switch_test_flag(read_frame, SFF_CNG)) {
+			leg->cng_frames++;
+		}
+
+		if (last) {
+			switch_time_t d = now - last - ptime;
+
+			if (d < 0) {
+				d = -d;
+			}
+			if (d > ptime) {
+				leg->late_frames++;
+			}
+			jitter += ((double) d - jitter) / 16;
+		}
+		last = now;
+		leg->frames++;
+
+		for (i = 0; i < samples; i++) {
+			audio[i] = leg->tone ? (int16_t) (8000 * sin(step * (double) pos++)) : 0;
+		}
+
+		if (switch_core_session_write_frame(session, &write_frame, SWITCH_IO_FLAG_NONE, 0) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+	}
+
+	leg->jitter_ms = jitter / 1000;
+	leg->measured = leg->frames > 1;
+
+	switch_core_codec_destroy(&codec);
+
+	switch_channel_hangup(channel, SWITCH_CAUSE_NORMAL_CLEARING);
+}
+
+static void *SWITCH_THREAD_FUNC bench_call_thread(switch_thread_t *thread, void *obj)
+{
+	bench_call_t *call = (bench_call_t *) obj;
+	switch_memory_pool_t *pool = call->pool;
+	switch_core_session_t *session = NULL;
+	switch_channel_t *channel;
+	switch_caller_extension_t *extension;
+	switch_call_cause_t cause = SWITCH_CAUSE_NONE;
+	switch_event_t *ovars = NULL;
+	bench_scenario_t sc;
+	bench_run_t *run;
+	bench_leg_t *leg;
+	char dial_string[1024];
+	switch_time_t start;
+	uint32_t ms;
+
+	switch_mutex_lock(globals.mutex);
+	if (!(run = bench_run_by_id(call->run_id))) {
+		switch_mutex_unlock(globals.mutex);
+		goto end;
+	}
+	sc = run->sc;
+	switch_copy_string(dial_string, run->dial_string, sizeof(dial_string));
+	switch_mutex_unlock(globals.mutex);
+
+	switch_event_create_plain(&ovars, SWITCH_EVENT_CHANNEL_DATA);
+	switch_event_add_header_string(ovars, SWITCH_STACK_BOTTOM, "ignore_early_media", "true");
+	switch_event_add_header_string(ovars, SWITCH_STACK_BOTTOM, "bench_scenario", sc.name);
+	switch_event_add_header_string(ovars, SWITCH_STACK_BOTTOM, "bench_leg", "true");
+	switch_event_add_header(ovars, SWITCH_STACK_BOTTOM, "bench_call", "%u", call->seq);
+
+	start = switch_micro_time_now();
+
+	if (switch_ivr_originate(NULL, &session, &cause, dial_string, sc.timeout, &bench_state_handlers,
+							 sc.cid_name, sc.cid_number, NULL, ovars, SOF_NONE, NULL) != SWITCH_STATUS_SUCCESS || !session) {
+		switch_mutex_lock(globals.mutex);
+		if ((run = bench_run_by_id(call->run_id))) {
+			run->failed++;
+			run->active--;
+			bench_count_cause(run, cause);
+		}
+		switch_mutex_unlock(globals.mutex);
+		goto end;
+	}
+
+	ms = (uint32_t) ((switch_micro_time_now() - start) / 1000);
+	channel = switch_core_session_get_channel(session);
+
+	leg = switch_core_session_alloc(session, sizeof(*leg));
+	leg->run_id = call->run_id;
+	leg->duration = sc.duration;
+	leg->tone = sc.tone;
+
+	switch_mutex_lock(globals.mutex);
+	if ((run = bench_run_by_id(call->run_id))) {
+		run->answered++;
+		bench_add_setup(run, ms);
+		/* from here on the leg is counted down when its session is destroyed */
+		switch_channel_set_private(channel, BENCH_PRIVATE, leg);
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	switch_channel_set_variable_printf(channel, "bench_setup_ms", "%u", ms);
+
+	if (run && (extension = switch_caller_extension_new(session, "bench_leg", NULL))) {
+		switch_caller_extension_add_application(session, extension, "bench_leg", NULL);
+		switch_channel_set_caller_extension(channel, extension);
+		switch_channel_set_state(channel, CS_EXECUTE);
+	} else {
+		switch_channel_hangup(channel, SWITCH_CAUSE_NORMAL_CLEARING);
+	}
+
+	switch_core_session_rwunlock(session);
+
+  end:
+
+	if (ovars) {
+		switch_event_destroy(&ovars);
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+
+	return NULL;
+}
+
+static void bench_launch_call(bench_run_t *run)
+{
+	switch_memory_pool_t *pool;
+	switch_thread_t *thread;
+	switch_threadattr_t *thd_attr = NULL;
+	bench_call_t *call;
+
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	call = switch_core_alloc(pool, sizeof(*call));
+	call->pool = pool;
+	call->run_id = run->id;
+
+	switch_mutex_lock(globals.mutex);
+	call->seq = ++run->attempted;
+	if (++run->active > run->peak_active) {
+		run->peak_active = run->active;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_detach_set(thd_attr, 1);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	if (switch_thread_create(&thread, thd_attr, bench_call_thread, call, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_mutex_lock(globals.mutex);
+		run->failed++;
+		run->active--;
+		bench_count_cause(run, SWITCH_CAUSE_SWITCH_CONGESTION);
+		switch_mutex_unlock(globals.mutex);
+		switch_core_destroy_memory_pool(&pool);
+	}
+}
+
+static void bench_sample_cpu(bench_run_t *run)
+{
+	double idle = switch_core_idle_cpu();
+
+	switch_mutex_lock(globals.mutex);
+	if (!run->idle_samples++ || idle < run->idle_min) {
+		run->idle_min = idle;
+	}
+	run->idle_total += idle;
+	switch_mutex_unlock(globals.mutex);
+}
+
+/* paces the calls and samples the cpu, then waits for the last calls to hang up */
+static void *SWITCH_THREAD_FUNC bench_run_thread(switch_thread_t *thread, void *obj)
+{
+	bench_run_t *run = (bench_run_t *) obj;
+	switch_time_t now, next, sampled, interval, drain;
+	uint32_t active;
+
+	interval = (switch_time_t) (1000000 / run->sc.cps);
+	next = sampled = switch_micro_time_now();
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "bench %s: %.2f calls/s to %s for %u seconds each\n",
+					  run->sc.name, run->sc.cps, run->dial_string, run->sc.duration);
+
+	while (!globals.stop && !globals.shutdown && (!run->sc.calls || run->attempted < run->sc.calls)) {
+		now = switch_micro_time_now();
+
+		if (now >= next) {
+			switch_mutex_lock(globals.mutex);
+			active = run->active;
+			switch_mutex_unlock(globals.mutex);
+
+			if (run->sc.max_sessions && active >= run->sc.max_sessions) {
+				run->throttled++;
+			} else {
+				bench_launch_call(run);
+			}
+
+			/* after a stall carry on at the set rate rather than firing the missed calls in a burst */
+			if ((next += interval) < now - 1000000) {
+				next = now;
+			}
+		}
+
+		if (now - sampled >= 1000000) {
+			bench_sample_cpu(run);
+			sampled = now;
+		}
+
+		switch_yield(next > now && next - now < 10000 ? (int) (next - now) : 10000);
+	}
+
+	drain = switch_micro_time_now() + ((switch_time_t) run->sc.duration + run->sc.timeout + 10) * 1000000;
+
+	for (;;) {
+		switch_mutex_lock(globals.mutex);
+		active = run->active;
+		switch_mutex_unlock(globals.mutex);
+
+		if (!active || globals.shutdown || (now = switch_micro_time_now()) > drain) {
+			break;
+		}
+
+		if (now - sampled >= 1000000) {
+			bench_sample_cpu(run);
+			sampled = now;
+		}
+
+		switch_yield(100000);
+	}
+
+	switch_mutex_lock(globals.mutex);
+	run->stopped = switch_micro_time_now();
+	globals.running = 0;
+	switch_mutex_unlock(globals.mutex);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "bench %s: done, %u attempted, %u answered, %u failed\n",
+					  run->sc.name, run->attempted, run->answered, run->failed);
+
+	return NULL;
+}
+
+static int bench_cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static uint32_t bench_pct(uint32_t *sorted, uint32_t count, uint32_t pct)
+{
+	return count ? sorted[(uint32_t) (((uint64_t) count - 1) * pct / 100)] : 0;
+}
+
+/* call with globals.mutex held */
+static cJSON *bench_report(bench_run_t *run)
+{
+	cJSON *json, *obj;
+	uint32_t *sorted = NULL, i;
+	switch_time_t stopped = run->stopped ? run->stopped : switch_micro_time_now();
+	double elapsed = (double) (stopped - run->started) / 1000000;
+	char date[80] = "";
+	switch_time_exp_t tm;
+	switch_size_t retsize;
+
+	json = cJSON_CreateObject();
+
+	switch_time_exp_lt(&tm, run->started);
+	switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", &tm);
+
+	cJSON_AddStringToObject(json, "version", SWITCH_VERSION_FULL);
+	cJSON_AddStringToObject(json, "hostname", switch_core_get_hostname());
+	cJSON_AddNumberToObject(json, "cpus", switch_core_cpu_count());
+	cJSON_AddStringToObject(json, "started", date);
+	cJSON_AddNumberToObject(json, "elapsed_sec", elapsed);
+	if (!run->stopped) {
+		cJSON_AddTrueToObject(json, "running");
+	}
+
+	obj = cJSON_CreateObject();
+	cJSON_AddStringToObject(obj, "name", run->sc.name);
+	cJSON_AddStringToObject(obj, "dial_string", run->dial_string);
+	cJSON_AddNumberToObject(obj, "cps", run->sc.cps);
+	cJSON_AddNumberToObject(obj, "calls", run->sc.calls);
+	cJSON_AddNumberToObject(obj, "duration", run->sc.duration);
+	cJSON_AddNumberToObject(obj, "max_sessions", run->sc.max_sessions);
+	cJSON_AddNumberToObject(obj, "timeout", run->sc.timeout);
+	cJSON_AddNumberToObject(obj, "tone", run->sc.tone);
+	cJSON_AddItemToObject(json, "scenario", obj);
+
+	obj = cJSON_CreateObject();
+	cJSON_AddNumberToObject(obj, "attempted", run->attempted);
+	cJSON_AddNumberToObject(obj, "answered", run->answered);
+	cJSON_AddNumberToObject(obj, "failed", run->failed);
+	cJSON_AddNumberToObject(obj, "throttled", run->throttled);
+	cJSON_AddNumberToObject(obj, "active", run->active);
+	cJSON_AddNumberToObject(obj, "peak_active", run->peak_active);
+	cJSON_AddNumberToObject(obj, "achieved_cps", elapsed > 0 ? run->attempted / elapsed : 0);
+	cJSON_AddItemToObject(json, "calls", obj);
+
+	if (run->setup_count) {
+		switch_zmalloc(sorted, run->setup_count * sizeof(*sorted));
+		memcpy(sorted, run->setup, run->setup_count * sizeof(*sorted));
+		qsort(sorted, run->setup_count, sizeof(*sorted), bench_cmp_u32);
+	}
+
+	obj = cJSON_CreateObject();
+	cJSON_AddNumberToObject(obj, "min", run->setup_min);
+	cJSON_AddNumberToObject(obj, "avg", run->setup_seen ? (double) run->setup_total / run->setup_seen : 0);
+	cJSON_AddNumberToObject(obj, "p50", bench_pct(sorted, run->setup_count, 50));
+	cJSON_AddNumberToObject(obj, "p95", bench_pct(sorted, run->setup_count, 95));
+	cJSON_AddNumberToObject(obj, "p99", bench_pct(sorted, run->setup_count, 99));
+	cJSON_AddNumberToObject(obj, "max", run->setup_max);
+	cJSON_AddItemToObject(json, "setup_ms", obj);
+
+	switch_safe_free(sorted);
+
+	obj = cJSON_CreateObject();
+	cJSON_AddNumberToObject(obj, "avg_jitter_ms", run->jitter_calls ? run->jitter_total / run->jitter_calls : 0);
+	cJSON_AddNumberToObject(obj, "max_jitter_ms", run->jitter_max);
+	cJSON_AddNumberToObject(obj, "frames", (double) run->frames);
+	cJSON_AddNumberToObject(obj, "late_frames", (double) run->late_frames);
+	cJSON_AddNumberToObject(obj, "cng_frames", (double) run->cng_frames);
+	cJSON_AddItemToObject(json, "media", obj);
+
+	obj = cJSON_CreateObject();
+	cJSON_AddNumberToObject(obj, "min", run->idle_min);
+	cJSON_AddNumberToObject(obj, "avg", run->idle_samples ? run->idle_total / run->idle_samples : 0);
+	cJSON_AddItemToObject(json, "idle_cpu", obj);
+
+	obj = cJSON_CreateObject();
+	for (i = 0; i < BENCH_MAX_CAUSE; i++) {
+		if (run->causes[i]) {
+			cJSON_AddNumberToObject(obj, switch_channel_cause2str((switch_call_cause_t) i), run->causes[i]);
+		}
+	}
+	cJSON_AddItemToObject(json, "causes", obj);
+
+	return json;
+}
+
+static switch_status_t bench_start(const char *name, int argc, char **argv, switch_stream_handle_t *stream)
+{
+	bench_scenario_t *scp, sc;
+	bench_run_t *run;
+	switch_threadattr_t *thd_attr = NULL;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	int i;
+
+	switch_mutex_lock(globals.mutex);
+
+	if (globals.running) {
+		stream->write_function(stream, "-ERR a run is already in progress\n");
+		goto end;
+	}
+
+	if (!(scp = switch_core_hash_find(globals.scenarios, name))) {
+		stream->write_function(stream, "-ERR no scenario %s\n", name);
+		goto end;
+	}
+
+	sc = *scp;
+
+	for (i = 0; i < argc; i++) {
+		char *val;
+
+		if (!(val = strchr(argv[i], '='))) {
+			stream->write_function(stream, "-ERR expected key=value, got %s\n", argv[i]);
+			goto end;
+		}
+		*val++ = '\0';
+
+		if (!strcasecmp(argv[i], "cps")) {
+			sc.cps = atof(val);
+		} else if (!strcasecmp(argv[i], "calls")) {
+			sc.calls = atoi(val);
+		} else if (!strcasecmp(argv[i], "duration")) {
+			sc.duration = atoi(val);
+		} else if (!strcasecmp(argv[i], "max-sessions")) {
+			sc.max_sessions = atoi(val);
+		} else {
+			stream->write_function(stream, "-ERR unknown option %s\n", argv[i]);
+			goto end;
+		}
+	}
+
+	if (sc.cps <= 0 || sc.cps > 10000) {
+		stream->write_function(stream, "-ERR cps must be above 0 and at most 10000\n");
+		goto end;
+	}
+
+	/* the last run and its report stay around until the next start */
+	switch_safe_free(globals.run);
+	switch_zmalloc(run, sizeof(*run));
+	run->id = ++globals.next_id;
+	run->sc = sc;
+	run->rand_state = run->id;
+	switch_copy_string(run->dial_string, sc.dial_string, sizeof(run->dial_string));
+	run->started = switch_micro_time_now();
+
+	globals.run = run;
+	globals.stop = 0;
+
+	if (globals.thread) {
+		switch_status_t st;
+		switch_thread_join(&st, globals.thread);
+		globals.thread = NULL;
+	}
+
+	switch_threadattr_create(&thd_attr, globals.pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	if (switch_thread_create(&globals.thread, thd_attr, bench_run_thread, run, globals.pool) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR cannot start the run\n");
+		goto end;
+	}
+
+	globals.running = 1;
+	status = SWITCH_STATUS_SUCCESS;
+	stream->write_function(stream, "+OK run %u of %s\n", run->id, sc.name);
+
+  end:
+
+	switch_mutex_unlock(globals.mutex);
+
+	return status;
+}
+
+static void bench_write_report(const char *file, switch_stream_handle_t *stream)
+{
+	cJSON *json;
+	char *text, *path = NULL;
+	FILE *f;
+
+	switch_mutex_lock(globals.mutex);
+	if (!globals.run) {
+		switch_mutex_unlock(globals.mutex);
+		stream->write_function(stream, "-ERR nothing has run yet\n");
+		return;
+	}
+	json = bench_report(globals.run);
+	switch_mutex_unlock(globals.mutex);
+
+	text = cJSON_Print(json);
+	cJSON_Delete(json);
+
+	if (zstr(file)) {
+		stream->write_function(stream, "%s\n", text);
+	} else {
+		path = switch_is_file_path(file) ? strdup(file) : switch_mprintf("%s%s%s", globals.report_dir, SWITCH_PATH_SEPARATOR, file);
+
+		if ((f = fopen(path, "w"))) {
+			fprintf(f, "%s\n", text);
+			fclose(f);
+			stream->write_function(stream, "+OK %s\n", path);
+		} else {
+			stream->write_function(stream, "-ERR cannot write %s: %s\n", path, strerror(errno));
+		}
+
+		switch_safe_free(path);
+	}
+
+	switch_safe_free(text);
+}
+
+SWITCH_STANDARD_API(bench_function)
+{
+	char *mydata = NULL, *argv[16] = { 0 };
+	int argc = 0;
+	switch_hash_index_t *hi;
+	const void *key;
+	void *val;
+
+	if (zstr(cmd) || !(mydata = strdup(cmd))) {
+		stream->write_function(stream, "-USAGE: %s\n", BENCH_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+
+	if (!strcasecmp(argv[0], "start") && argc > 1) {
+		bench_start(argv[1], argc - 2, argv + 2, stream);
+	} else if (!strcasecmp(argv[0], "stop")) {
+		globals.stop = 1;
+		stream->write_function(stream, "+OK\n");
+	} else if (!strcasecmp(argv[0], "status")) {
+		switch_mutex_lock(globals.mutex);
+		if (globals.run) {
+			bench_run_t *run = globals.run;
+			stream->write_function(stream, "%s %s: %u attempted, %u answered, %u failed, %u active\n",
+								   run->sc.name, globals.running ? "running" : "finished", run->attempted, run->answered, run->failed, run->active);
+		} else {
+			stream->write_function(stream, "idle\n");
+		}
+		switch_mutex_unlock(globals.mutex);
+	} else if (!strcasecmp(argv[0], "report")) {
+		bench_write_report(argv[1], stream);
+	} else if (!strcasecmp(argv[0], "scenarios")) {
+		for (hi = switch_hash_first(NULL, globals.scenarios); hi; hi = switch_hash_next(hi)) {
+			bench_scenario_t *sc;
+
+			switch_hash_this(hi, &key, NULL, &val);
+			sc = (bench_scenario_t *) val;
+			stream->write_function(stream, "%s\t%s\t%.2f cps\t%u calls\t%u s\n", sc->name, sc->dial_string, sc->cps, sc->calls, sc->duration);
+		}
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", BENCH_SYNTAX);
+	}
+
+	switch_safe_free(mydata);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t load_config(switch_memory_pool_t *pool)
+{
+	char *cf = "bench.conf";
+	switch_xml_t cfg, xml, settings, param, scenarios, x_sc;
+
+	globals.report_dir = switch_core_strdup(pool, SWITCH_GLOBAL_dirs.log_dir);
+
+	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "open of %s failed\n", cf);
+		return SWITCH_STATUS_TERM;
+	}
+
+	if ((settings = switch_xml_child(cfg, "settings"))) {
+		for (param = switch_xml_child(settings, "param"); param; param = param->next) {
+			char *var = (char *) switch_xml_attr_soft(param, "name");
+			char *val = (char *) switch_xml_attr_soft(param, "value");
+
+			if (!strcasecmp(var, "report-dir") && !zstr(val)) {
+				globals.report_dir = switch_core_strdup(pool, val);
+			}
+		}
+	}
+
+	if ((scenarios = switch_xml_child(cfg, "scenarios"))) {
+		for (x_sc = switch_xml_child(scenarios, "scenario"); x_sc; x_sc = x_sc->next) {
+			const char *name = switch_xml_attr(x_sc, "name");
+			const char *dial_string = switch_xml_attr(x_sc, "dial-string");
+			const char *val;
+			bench_scenario_t *sc;
+
+			if (zstr(name) || zstr(dial_string)) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Skipping a scenario without a name or dial-string\n");
+				continue;
+			}
+
+			sc = switch_core_alloc(pool, sizeof(*sc));
+			sc->name = switch_core_strdup(pool, name);
+			sc->dial_string = switch_core_strdup(pool, dial_string);
+			sc->cid_name = switch_core_strdup(pool, switch_str_nil(switch_xml_attr(x_sc, "caller-id-name")));
+			sc->cid_number = switch_core_strdup(pool, switch_str_nil(switch_xml_attr(x_sc, "caller-id-number")));
+			sc->cps = (val = switch_xml_attr(x_sc, "cps")) ? atof(val) : 1;
+			sc->calls = (val = switch_xml_attr(x_sc, "calls")) ? atoi(val) : 100;
+			sc->duration = (val = switch_xml_attr(x_sc, "duration")) ? atoi(val) : 30;
+			sc->max_sessions = (val = switch_xml_attr(x_sc, "max-sessions")) ? atoi(val) : 0;
+			sc->timeout = (val = switch_xml_attr(x_sc, "timeout")) ? atoi(val) : 30;
+			sc->tone = (val = switch_xml_attr(x_sc, "tone")) ? atoi(val) : 1000;
+
+			if (zstr(sc->cid_name)) {
+				sc->cid_name = "bench";
+			}
+			if (zstr(sc->cid_number)) {
+				sc->cid_number = "0000000000";
+			}
+
+			switch_core_hash_insert(globals.scenarios, sc->name, sc);
+		}
+	}
+
+	switch_xml_free(xml);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_MODULE_LOAD_FUNCTION(mod_bench_load)
+{
+	switch_api_interface_t *api_interface;
+	switch_application_interface_t *app_interface;
+	switch_status_t status;
+
+	memset(&globals, 0, sizeof(globals));
+	globals.pool = pool;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&globals.scenarios, pool);
+
+	if ((status = load_config(pool)) != SWITCH_STATUS_SUCCESS) {
+		return status;
+	}
+
+	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
+
+	SWITCH_ADD_APP(app_interface, "bench_leg", "Benchmark leg", BENCH_LEG_DESC, bench_leg_function, "", SAF_NONE);
+	SWITCH_ADD_API(api_interface, "bench", "Call load generator", bench_function, BENCH_SYNTAX);
+	switch_console_set_complete("add bench start");
+	switch_console_set_complete("add bench stop");
+	switch_console_set_complete("add bench status");
+	switch_console_set_complete("add bench report");
+	switch_console_set_complete("add bench scenarios");
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_bench_shutdown)
+{
+	switch_status_t st;
+	int sanity = 50;
+
+	switch_console_set_complete("del bench");
+
+	globals.shutdown = 1;
+
+	if (globals.thread) {
+		switch_thread_join(&st, globals.thread);
+		globals.thread = NULL;
+	}
+
+	/* the legs carry our state handler, so they have to be gone before the module is */
+	switch_core_session_hupall_matching_var("bench_leg", "true", SWITCH_CAUSE_MANAGER_REQUEST);
+
+	while (globals.run && globals.run->active && --sanity) {
+		switch_yield(100000);
+	}
+
+	switch_mutex_lock(globals.mutex);
+	switch_safe_free(globals.run);
+	switch_mutex_unlock(globals.mutex);
+
+	switch_core_hash_destroy(&globals.scenarios);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
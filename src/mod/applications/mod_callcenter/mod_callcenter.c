@@ -415,6 +415,7 @@ static struct {
 	char *dbname;
 	int32_t threads;
 	int32_t running;
+	switch_bool_t memory_routing;
 	switch_mutex_t *mutex;
 	switch_memory_pool_t *pool;
 } globals;
@@ -740,6 +741,886 @@ static cc_queue_t *get_queue(const char *queue_name)
 	return queue;
 }
 
+/*!
+ * In-memory routing index
+ *
+ * Agents, tiers and the members of every queue are mirrored here so the dispatch thread
+ * can route without polling the db.  Each queue keeps its tiers sorted by level and position
+ * with a count of the agents that could take a call right now, and its waiting members in a
+ * heap ordered by score.  The db is still written for every change so the list api, other
+ * tools reading it and the next restart see the same data, but routing never reads it back.
+ */
+#define CC_ROUTE_PRESENT (1 << 0)
+#define CC_ROUTE_IDLE (1 << 1)
+
+struct cc_route_tier;
+struct cc_route_member;
+
+struct cc_route_agent {
+	char *name;
+	char *system;
+	char *type;
+	char *contact;
+	char *uuid;
+	cc_agent_status_t status;
+	cc_agent_state_t state;
+	int max_no_answer;
+	int wrap_up_time;
+	int reject_delay_time;
+	int busy_delay_time;
+	int no_answer_delay_time;
+	int no_answer_count;
+	int calls_answered;
+	switch_time_t talk_time;
+	switch_time_t last_bridge_start;
+	switch_time_t last_bridge_end;
+	switch_time_t last_offered_call;
+	switch_time_t ready_time;
+	struct cc_route_tier *tiers;
+};
+typedef struct cc_route_agent cc_route_agent_t;
+
+struct cc_route_queue {
+	char *name;
+	struct cc_route_tier *tiers;
+	/* Tiers whose agent is logged in, and the ones among them that could be offered a call */
+	int present;
+	int idle;
+	struct cc_route_member **heap;
+	int heap_len;
+	int heap_size;
+	struct cc_route_member *abandoned;
+	struct cc_route_queue *next;
+};
+typedef struct cc_route_queue cc_route_queue_t;
+
+struct cc_route_tier {
+	cc_route_agent_t *agent;
+	cc_route_queue_t *queue;
+	cc_tier_state_t state;
+	int level;
+	int position;
+	int class;
+	struct cc_route_tier *next;
+	struct cc_route_tier *agent_next;
+};
+typedef struct cc_route_tier cc_route_tier_t;
+
+struct cc_route_member {
+	cc_route_queue_t *queue;
+	char *uuid;
+	char *session_uuid;
+	char *cid_number;
+	char *cid_name;
+	char *serving_agent;
+	switch_time_t joined_epoch;
+	switch_time_t abandoned_epoch;
+	int base_score;
+	int skill_score;
+	cc_member_state_t state;
+	int heap_index;
+	struct cc_route_member *abandoned_next;
+	struct cc_route_member *abandoned_prev;
+	switch_bool_t in_abandoned;
+};
+typedef struct cc_route_member cc_route_member_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *agent_hash;
+	switch_hash_t *queue_hash;
+	switch_hash_t *member_hash;
+	cc_route_queue_t *queues;
+} route;
+
+static void route_set_str(char **dst, const char *src)
+{
+	switch_safe_free(*dst);
+	*dst = strdup(switch_str_nil(src));
+}
+
+static cc_route_queue_t *route_queue_get(const char *queue_name, switch_bool_t create)
+{
+	cc_route_queue_t *rq;
+
+	if (!(rq = switch_core_hash_find(route.queue_hash, queue_name)) && create) {
+		switch_zmalloc(rq, sizeof(*rq));
+		rq->name = strdup(queue_name);
+		rq->next = route.queues;
+		route.queues = rq;
+		switch_core_hash_insert(route.queue_hash, rq->name, rq);
+	}
+
+	return rq;
+}
+
+static void route_tier_set_class(cc_route_tier_t *tier, int class)
+{
+	if ((tier->class & CC_ROUTE_PRESENT)) tier->queue->present--;
+	if ((tier->class & CC_ROUTE_IDLE)) tier->queue->idle--;
+
+	tier->class = class;
+
+	if ((tier->class & CC_ROUTE_PRESENT)) tier->queue->present++;
+	if ((tier->class & CC_ROUTE_IDLE)) tier->queue->idle++;
+}
+
+/* Same filters the dispatch queries and agents_callback() apply, minus the ones depending on the current time */
+static void route_tier_classify(cc_route_tier_t *tier)
+{
+	cc_route_agent_t *agent = tier->agent;
+	int class = 0;
+
+	if (agent->status == CC_AGENT_STATUS_AVAILABLE || agent->status == CC_AGENT_STATUS_ON_BREAK || agent->status == CC_AGENT_STATUS_AVAILABLE_ON_DEMAND) {
+		class |= CC_ROUTE_PRESENT;
+
+		if (agent->status != CC_AGENT_STATUS_ON_BREAK && agent->state == CC_AGENT_STATE_WAITING &&
+			(tier->state == CC_TIER_STATE_READY || tier->state == CC_TIER_STATE_NO_ANSWER)) {
+			class |= CC_ROUTE_IDLE;
+		}
+	}
+
+	route_tier_set_class(tier, class);
+}
+
+static void route_agent_refresh(cc_route_agent_t *agent)
+{
+	cc_route_tier_t *tier;
+
+	for (tier = agent->tiers; tier; tier = tier->agent_next) {
+		route_tier_classify(tier);
+	}
+}
+
+static void route_tier_link(cc_route_tier_t *tier)
+{
+	cc_route_tier_t **tp = &tier->queue->tiers;
+
+	while (*tp && ((*tp)->level < tier->level || ((*tp)->level == tier->level && (*tp)->position <= tier->position))) {
+		tp = &(*tp)->next;
+	}
+	tier->next = *tp;
+	*tp = tier;
+}
+
+static void route_tier_unlink(cc_route_tier_t *tier)
+{
+	cc_route_tier_t **tp;
+
+	for (tp = &tier->queue->tiers; *tp; tp = &(*tp)->next) {
+		if (*tp == tier) {
+			*tp = tier->next;
+			break;
+		}
+	}
+	tier->next = NULL;
+}
+
+static void route_tier_free(cc_route_tier_t *tier)
+{
+	cc_route_tier_t **tp;
+
+	route_tier_set_class(tier, 0);
+	route_tier_unlink(tier);
+
+	for (tp = &tier->agent->tiers; *tp; tp = &(*tp)->agent_next) {
+		if (*tp == tier) {
+			*tp = tier->agent_next;
+			break;
+		}
+	}
+	free(tier);
+}
+
+static cc_route_tier_t *route_tier_find(const char *queue_name, const char *agent_name)
+{
+	cc_route_agent_t *agent;
+	cc_route_tier_t *tier;
+
+	if (!(agent = switch_core_hash_find(route.agent_hash, agent_name))) {
+		return NULL;
+	}
+
+	for (tier = agent->tiers; tier; tier = tier->agent_next) {
+		if (!strcmp(tier->queue->name, queue_name)) {
+			return tier;
+		}
+	}
+
+	return NULL;
+}
+
+/* The time part of the score is the same for every member, so the heap can be keyed without it */
+static int64_t route_member_priority(cc_route_member_t *member)
+{
+	return (int64_t) member->base_score + member->skill_score - member->joined_epoch;
+}
+
+static void route_heap_sift_up(cc_route_member_t **heap, int i, switch_bool_t track)
+{
+	cc_route_member_t *member = heap[i];
+
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+
+		if (route_member_priority(heap[parent]) >= route_member_priority(member)) {
+			break;
+		}
+		heap[i] = heap[parent];
+		if (track) heap[i]->heap_index = i;
+		i = parent;
+	}
+	heap[i] = member;
+	if (track) member->heap_index = i;
+}
+
+static void route_heap_sift_down(cc_route_member_t **heap, int len, int i, switch_bool_t track)
+{
+	cc_route_member_t *member = heap[i];
+
+	for (;;) {
+		int child = 2 * i + 1;
+
+		if (child >= len) {
+			break;
+		}
+		if (child + 1 < len && route_member_priority(heap[child + 1]) > route_member_priority(heap[child])) {
+			child++;
+		}
+		if (route_member_priority(heap[child]) <= route_member_priority(member)) {
+			break;
+		}
+		heap[i] = heap[child];
+		if (track) heap[i]->heap_index = i;
+		i = child;
+	}
+	heap[i] = member;
+	if (track) member->heap_index = i;
+}
+
+static void route_heap_remove(cc_route_member_t *member)
+{
+	cc_route_queue_t *rq = member->queue;
+	int i = member->heap_index;
+
+	if (i < 0) {
+		return;
+	}
+
+	member->heap_index = -1;
+
+	if (i != --rq->heap_len) {
+		cc_route_member_t *moved = rq->heap[rq->heap_len];
+
+		rq->heap[i] = moved;
+		moved->heap_index = i;
+		route_heap_sift_down(rq->heap, rq->heap_len, i, SWITCH_TRUE);
+		route_heap_sift_up(rq->heap, moved->heap_index, SWITCH_TRUE);
+	}
+}
+
+static void route_heap_insert(cc_route_member_t *member)
+{
+	cc_route_queue_t *rq = member->queue;
+
+	if (member->heap_index >= 0) {
+		return;
+	}
+
+	if (rq->heap_len == rq->heap_size) {
+		rq->heap_size = rq->heap_size ? rq->heap_size * 2 : 16;
+		rq->heap = realloc(rq->heap, rq->heap_size * sizeof(*rq->heap));
+		switch_assert(rq->heap);
+	}
+
+	rq->heap[rq->heap_len] = member;
+	route_heap_sift_up(rq->heap, rq->heap_len++, SWITCH_TRUE);
+}
+
+/* Members the dispatch thread has to look at: waiting ones and ring-all ones still being offered */
+static void route_member_place(cc_route_member_t *member)
+{
+	cc_route_queue_t *rq = member->queue;
+
+	if (member->state == CC_MEMBER_STATE_WAITING ||
+		(member->state == CC_MEMBER_STATE_TRYING && !strcmp(member->serving_agent, "ring-all"))) {
+		route_heap_insert(member);
+	} else {
+		route_heap_remove(member);
+	}
+
+	if (member->state == CC_MEMBER_STATE_ABANDONED) {
+		if (!member->in_abandoned) {
+			member->abandoned_prev = NULL;
+			if ((member->abandoned_next = rq->abandoned)) {
+				member->abandoned_next->abandoned_prev = member;
+			}
+			rq->abandoned = member;
+			member->in_abandoned = SWITCH_TRUE;
+		}
+	} else if (member->in_abandoned) {
+		if (member->abandoned_prev) {
+			member->abandoned_prev->abandoned_next = member->abandoned_next;
+		} else {
+			rq->abandoned = member->abandoned_next;
+		}
+		if (member->abandoned_next) {
+			member->abandoned_next->abandoned_prev = member->abandoned_prev;
+		}
+		member->abandoned_next = member->abandoned_prev = NULL;
+		member->in_abandoned = SWITCH_FALSE;
+	}
+}
+
+static void route_member_free(cc_route_member_t *member)
+{
+	member->state = CC_MEMBER_STATE_UNKNOWN;
+	route_member_place(member);
+	switch_core_hash_delete(route.member_hash, member->uuid);
+
+	switch_safe_free(member->uuid);
+	switch_safe_free(member->session_uuid);
+	switch_safe_free(member->cid_number);
+	switch_safe_free(member->cid_name);
+	switch_safe_free(member->serving_agent);
+	free(member);
+}
+
+static cc_route_agent_t *route_agent_add(const char *name)
+{
+	cc_route_agent_t *agent;
+
+	if (!(agent = switch_core_hash_find(route.agent_hash, name))) {
+		switch_zmalloc(agent, sizeof(*agent));
+		agent->name = strdup(name);
+		route_set_str(&agent->system, "single_box");
+		route_set_str(&agent->type, NULL);
+		route_set_str(&agent->contact, NULL);
+		route_set_str(&agent->uuid, NULL);
+		switch_core_hash_insert(route.agent_hash, agent->name, agent);
+	}
+
+	return agent;
+}
+
+static void route_agent_free(cc_route_agent_t *agent)
+{
+	while (agent->tiers) {
+		route_tier_free(agent->tiers);
+	}
+	switch_core_hash_delete(route.agent_hash, agent->name);
+
+	switch_safe_free(agent->name);
+	switch_safe_free(agent->system);
+	switch_safe_free(agent->type);
+	switch_safe_free(agent->contact);
+	switch_safe_free(agent->uuid);
+	free(agent);
+}
+
+static void cc_route_agent_add(const char *name, const char *type)
+{
+	cc_route_agent_t *agent;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	agent = route_agent_add(name);
+	route_set_str(&agent->type, type);
+	agent->status = CC_AGENT_STATUS_LOGGED_OUT;
+	agent->state = CC_AGENT_STATE_WAITING;
+	route_agent_refresh(agent);
+	switch_mutex_unlock(route.mutex);
+}
+
+static void cc_route_agent_del(const char *name)
+{
+	cc_route_agent_t *agent;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((agent = switch_core_hash_find(route.agent_hash, name))) {
+		route_agent_free(agent);
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+/* Mirrors a successful cc_agent_update() */
+static void cc_route_agent_set(const char *name, const char *key, const char *value)
+{
+	cc_route_agent_t *agent;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if (!(agent = switch_core_hash_find(route.agent_hash, name))) {
+		goto end;
+	}
+
+	if (!strcasecmp(key, "status")) {
+		cc_agent_status_t status = cc_agent_str2status(value);
+
+		if (status == CC_AGENT_STATUS_AVAILABLE && agent->status != status) {
+			agent->talk_time = 0;
+			agent->calls_answered = 0;
+			agent->no_answer_count = 0;
+		}
+		agent->status = status;
+	} else if (!strcasecmp(key, "state")) {
+		agent->state = cc_agent_str2state(value);
+		if (agent->state == CC_AGENT_STATE_RECEIVING) {
+			agent->last_offered_call = local_epoch_time_now(NULL);
+		}
+	} else if (!strcasecmp(key, "type")) {
+		route_set_str(&agent->type, value);
+	} else {
+		if (!strcasecmp(key, "uuid")) {
+			route_set_str(&agent->uuid, value);
+		} else if (!strcasecmp(key, "contact")) {
+			route_set_str(&agent->contact, value);
+		} else if (!strcasecmp(key, "ready_time")) {
+			agent->ready_time = atol(value);
+		} else if (!strcasecmp(key, "busy_delay_time")) {
+			agent->busy_delay_time = atoi(value);
+		} else if (!strcasecmp(key, "reject_delay_time")) {
+			agent->reject_delay_time = atoi(value);
+		} else if (!strcasecmp(key, "no_answer_delay_time")) {
+			agent->no_answer_delay_time = atoi(value);
+		} else if (!strcasecmp(key, "max_no_answer")) {
+			agent->max_no_answer = atoi(value);
+		} else if (!strcasecmp(key, "wrap_up_time")) {
+			agent->wrap_up_time = atoi(value);
+		}
+		route_set_str(&agent->system, "single_box");
+	}
+
+	route_agent_refresh(agent);
+
+end:
+	switch_mutex_unlock(route.mutex);
+}
+
+static void cc_route_agent_bridge_start(const char *name, const char *uuid)
+{
+	cc_route_agent_t *agent;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((agent = switch_core_hash_find(route.agent_hash, name))) {
+		route_set_str(&agent->uuid, uuid);
+		agent->last_bridge_start = local_epoch_time_now(NULL);
+		agent->calls_answered++;
+		agent->no_answer_count = 0;
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+static void cc_route_agent_bridge_end(const char *name, switch_bool_t clear_uuid)
+{
+	cc_route_agent_t *agent;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((agent = switch_core_hash_find(route.agent_hash, name))) {
+		if (clear_uuid) {
+			route_set_str(&agent->uuid, NULL);
+		}
+		agent->last_bridge_end = local_epoch_time_now(NULL);
+		agent->talk_time += agent->last_bridge_end - agent->last_bridge_start;
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+static void cc_route_agent_no_answer(const char *name)
+{
+	cc_route_agent_t *agent;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((agent = switch_core_hash_find(route.agent_hash, name))) {
+		agent->no_answer_count++;
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+static void cc_route_tier_add(const char *queue_name, const char *agent_name, const char *state, int level, int position)
+{
+	cc_route_agent_t *agent;
+	cc_route_tier_t *tier;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((agent = switch_core_hash_find(route.agent_hash, agent_name)) && !route_tier_find(queue_name, agent_name)) {
+		switch_zmalloc(tier, sizeof(*tier));
+		tier->agent = agent;
+		tier->queue = route_queue_get(queue_name, SWITCH_TRUE);
+		tier->state = cc_tier_str2state(state);
+		tier->level = level;
+		tier->position = position;
+		tier->agent_next = agent->tiers;
+		agent->tiers = tier;
+		route_tier_link(tier);
+		route_tier_classify(tier);
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+/* Mirrors a successful cc_tier_update() */
+static void cc_route_tier_set(const char *queue_name, const char *agent_name, const char *key, const char *value)
+{
+	cc_route_tier_t *tier;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((tier = route_tier_find(queue_name, agent_name))) {
+		if (!strcasecmp(key, "state")) {
+			tier->state = cc_tier_str2state(value);
+			route_tier_classify(tier);
+		} else if (!strcasecmp(key, "level") || !strcasecmp(key, "position")) {
+			route_tier_unlink(tier);
+			if (!strcasecmp(key, "level")) {
+				tier->level = atoi(value);
+			} else {
+				tier->position = atoi(value);
+			}
+			route_tier_link(tier);
+		}
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+static void cc_route_tier_del(const char *queue_name, const char *agent_name)
+{
+	cc_route_tier_t *tier;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((tier = route_tier_find(queue_name, agent_name))) {
+		route_tier_free(tier);
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+/* The agent is offered a call from queue_name: put its other Ready tiers in Standby */
+static void cc_route_tier_offer(const char *agent_name, const char *queue_name)
+{
+	cc_route_agent_t *agent;
+	cc_route_tier_t *tier;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((agent = switch_core_hash_find(route.agent_hash, agent_name))) {
+		for (tier = agent->tiers; tier; tier = tier->agent_next) {
+			if (!strcmp(tier->queue->name, queue_name)) {
+				tier->state = CC_TIER_STATE_OFFERING;
+			} else if (tier->state == CC_TIER_STATE_READY) {
+				tier->state = CC_TIER_STATE_STANDBY;
+			}
+		}
+		route_agent_refresh(agent);
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+/* The offer from queue_name is over: revert what cc_route_tier_offer() did */
+static void cc_route_tier_release(const char *agent_name, const char *queue_name, cc_tier_state_t state)
+{
+	cc_route_agent_t *agent;
+	cc_route_tier_t *tier;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((agent = switch_core_hash_find(route.agent_hash, agent_name))) {
+		for (tier = agent->tiers; tier; tier = tier->agent_next) {
+			if (!strcmp(tier->queue->name, queue_name)) {
+				if (tier->state == CC_TIER_STATE_ACTIVE_INBOUND || tier->state == CC_TIER_STATE_STANDBY || tier->state == CC_TIER_STATE_OFFERING) {
+					tier->state = state;
+				}
+			} else if (tier->state == CC_TIER_STATE_STANDBY) {
+				tier->state = CC_TIER_STATE_READY;
+			}
+		}
+		route_agent_refresh(agent);
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+static void cc_route_member_add(const char *queue_name, const char *uuid, const char *session_uuid, const char *cid_number, const char *cid_name,
+								switch_time_t joined_epoch, switch_time_t abandoned_epoch, int base_score, int skill_score,
+								const char *serving_agent, cc_member_state_t state)
+{
+	cc_route_member_t *member;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if (!switch_core_hash_find(route.member_hash, uuid)) {
+		switch_zmalloc(member, sizeof(*member));
+		member->queue = route_queue_get(queue_name, SWITCH_TRUE);
+		member->heap_index = -1;
+		route_set_str(&member->uuid, uuid);
+		route_set_str(&member->session_uuid, session_uuid);
+		route_set_str(&member->cid_number, cid_number);
+		route_set_str(&member->cid_name, cid_name);
+		route_set_str(&member->serving_agent, serving_agent);
+		member->joined_epoch = joined_epoch;
+		member->abandoned_epoch = abandoned_epoch;
+		member->base_score = base_score;
+		member->skill_score = skill_score;
+		member->state = state;
+		switch_core_hash_insert(route.member_hash, member->uuid, member);
+		route_member_place(member);
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+/*!
+ * \brief Move a member from one state to another
+ * \param from_state only if the member is in that state, CC_MEMBER_STATE_UNKNOWN for any
+ * \param from_serving only if the member is served by that agent, NULL for any
+ * \param to_serving the new serving agent, NULL to keep it
+ * \return SWITCH_TRUE if the member was changed
+ */
+static switch_bool_t cc_route_member_update(const char *uuid, cc_member_state_t from_state, const char *from_serving,
+											cc_member_state_t to_state, const char *to_serving)
+{
+	cc_route_member_t *member;
+	switch_bool_t changed = SWITCH_FALSE;
+
+	if (!globals.memory_routing) {
+		return SWITCH_FALSE;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((member = switch_core_hash_find(route.member_hash, uuid)) &&
+		(from_state == CC_MEMBER_STATE_UNKNOWN || member->state == from_state) &&
+		(!from_serving || !strcmp(member->serving_agent, from_serving))) {
+		member->state = to_state;
+		if (to_serving) {
+			route_set_str(&member->serving_agent, to_serving);
+		}
+		route_member_place(member);
+		changed = SWITCH_TRUE;
+	}
+	switch_mutex_unlock(route.mutex);
+
+	return changed;
+}
+
+static switch_bool_t cc_route_member_serving(const char *uuid, const char *serving)
+{
+	cc_route_member_t *member;
+	switch_bool_t match = SWITCH_FALSE;
+
+	switch_mutex_lock(route.mutex);
+	if ((member = switch_core_hash_find(route.member_hash, uuid))) {
+		match = !strcmp(member->serving_agent, serving) ? SWITCH_TRUE : SWITCH_FALSE;
+	}
+	switch_mutex_unlock(route.mutex);
+
+	return match;
+}
+
+static void cc_route_member_abandon(const char *uuid, switch_time_t abandoned_epoch, switch_bool_t keep_abandoned)
+{
+	cc_route_member_t *member;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((member = switch_core_hash_find(route.member_hash, uuid)) && !(keep_abandoned && member->state == CC_MEMBER_STATE_ABANDONED)) {
+		member->state = CC_MEMBER_STATE_ABANDONED;
+		member->abandoned_epoch = abandoned_epoch;
+		route_set_str(&member->session_uuid, NULL);
+		route_member_place(member);
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+static void cc_route_member_resume(const char *uuid, const char *session_uuid)
+{
+	cc_route_member_t *member;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((member = switch_core_hash_find(route.member_hash, uuid)) && member->state == CC_MEMBER_STATE_ABANDONED) {
+		member->state = CC_MEMBER_STATE_WAITING;
+		route_set_str(&member->session_uuid, session_uuid);
+		route_member_place(member);
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+static void cc_route_member_del(const char *uuid)
+{
+	cc_route_member_t *member;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	switch_mutex_lock(route.mutex);
+	if ((member = switch_core_hash_find(route.member_hash, uuid))) {
+		route_member_free(member);
+	}
+	switch_mutex_unlock(route.mutex);
+}
+
+static int route_load_agents_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	cc_route_agent_t *agent;
+
+	switch_mutex_lock(route.mutex);
+	agent = route_agent_add(argv[0]);
+
+	route_set_str(&agent->system, argv[1]);
+	route_set_str(&agent->type, argv[2]);
+	route_set_str(&agent->contact, argv[3]);
+	route_set_str(&agent->uuid, argv[4]);
+	agent->status = cc_agent_str2status(switch_str_nil(argv[5]));
+	agent->state = cc_agent_str2state(switch_str_nil(argv[6]));
+	agent->max_no_answer = atoi(switch_str_nil(argv[7]));
+	agent->wrap_up_time = atoi(switch_str_nil(argv[8]));
+	agent->reject_delay_time = atoi(switch_str_nil(argv[9]));
+	agent->busy_delay_time = atoi(switch_str_nil(argv[10]));
+	agent->no_answer_delay_time = atoi(switch_str_nil(argv[11]));
+	agent->last_bridge_start = atol(switch_str_nil(argv[12]));
+	agent->last_bridge_end = atol(switch_str_nil(argv[13]));
+	agent->last_offered_call = atol(switch_str_nil(argv[14]));
+	agent->no_answer_count = atoi(switch_str_nil(argv[15]));
+	agent->calls_answered = atoi(switch_str_nil(argv[16]));
+	agent->talk_time = atol(switch_str_nil(argv[17]));
+	agent->ready_time = atol(switch_str_nil(argv[18]));
+	switch_mutex_unlock(route.mutex);
+
+	return 0;
+}
+
+static int route_load_tiers_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	if (argv[0] && argv[1]) {
+		cc_route_tier_add(argv[0], argv[1], switch_str_nil(argv[2]), atoi(switch_str_nil(argv[3])), atoi(switch_str_nil(argv[4])));
+	}
+
+	return 0;
+}
+
+static int route_load_members_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	if (argv[0] && argv[1]) {
+		cc_route_member_add(argv[0], argv[1], argv[2], argv[3], argv[4], atol(switch_str_nil(argv[5])), atol(switch_str_nil(argv[6])),
+							atoi(switch_str_nil(argv[7])), atoi(switch_str_nil(argv[8])), argv[9], cc_member_str2state(switch_str_nil(argv[10])));
+	}
+
+	return 0;
+}
+
+/*!
+ * \brief Fill the routing index from the db
+ * \note called from load_config() once the db has been reset, before the xml agents and tiers are imported.
+ *       The db callbacks take route.mutex under globals.mutex, so route.mutex is never held while running sql.
+ */
+static void cc_route_load(void)
+{
+	char *sql;
+
+	if (!globals.memory_routing) {
+		return;
+	}
+
+	sql = switch_mprintf("SELECT name, system, type, contact, uuid, status, state, max_no_answer, wrap_up_time, reject_delay_time, busy_delay_time,"
+						 " no_answer_delay_time, last_bridge_start, last_bridge_end, last_offered_call, no_answer_count, calls_answered, talk_time, ready_time"
+						 " FROM agents WHERE name IS NOT NULL");
+	cc_execute_sql_callback(NULL, NULL, sql, route_load_agents_callback, NULL);
+	switch_safe_free(sql);
+
+	sql = switch_mprintf("SELECT queue, agent, state, level, position FROM tiers");
+	cc_execute_sql_callback(NULL, NULL, sql, route_load_tiers_callback, NULL);
+	switch_safe_free(sql);
+
+	sql = switch_mprintf("SELECT queue, uuid, session_uuid, cid_number, cid_name, joined_epoch, abandoned_epoch, base_score, skill_score, serving_agent, state"
+						 " FROM members WHERE system = 'single_box'");
+	cc_execute_sql_callback(NULL, NULL, sql, route_load_members_callback, NULL);
+	switch_safe_free(sql);
+}
+
+static void cc_route_init(switch_memory_pool_t *pool)
+{
+	memset(&route, 0, sizeof(route));
+	switch_mutex_init(&route.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&route.agent_hash, pool);
+	switch_core_hash_init(&route.queue_hash, pool);
+	switch_core_hash_init(&route.member_hash, pool);
+}
+
+static void cc_route_shutdown(void)
+{
+	switch_hash_index_t *hi;
+	void *val = NULL;
+	const void *key;
+	switch_ssize_t keylen;
+	cc_route_queue_t *rq;
+
+	switch_mutex_lock(route.mutex);
+	while ((hi = switch_hash_first(NULL, route.member_hash))) {
+		switch_hash_this(hi, &key, &keylen, &val);
+		route_member_free((cc_route_member_t *) val);
+	}
+	while ((hi = switch_hash_first(NULL, route.agent_hash))) {
+		switch_hash_this(hi, &key, &keylen, &val);
+		route_agent_free((cc_route_agent_t *) val);
+	}
+	while ((rq = route.queues)) {
+		route.queues = rq->next;
+		switch_core_hash_delete(route.queue_hash, rq->name);
+		switch_safe_free(rq->heap);
+		switch_safe_free(rq->name);
+		free(rq);
+	}
+	switch_core_hash_destroy(&route.member_hash);
+	switch_core_hash_destroy(&route.agent_hash);
+	switch_core_hash_destroy(&route.queue_hash);
+	switch_mutex_unlock(route.mutex);
+}
+
 struct call_helper {
 	const char *member_uuid;
 	const char *member_session_uuid;
@@ -820,6 +1701,7 @@ cc_status_t cc_agent_add(const char *agent, const char *type)
 				agent, type, cc_agent_status2str(CC_AGENT_STATUS_LOGGED_OUT), cc_agent_state2str(CC_AGENT_STATE_WAITING));
 		cc_execute_sql(NULL, sql, NULL);
 		switch_safe_free(sql);
+		cc_route_agent_add(agent, type);
 	} else {
 		result = CC_STATUS_AGENT_INVALID_TYPE;
 		goto done;
@@ -840,6 +1722,7 @@ cc_status_t cc_agent_del(const char *agent)
 			agent, agent);
 	cc_execute_sql(NULL, sql, NULL);
 	switch_safe_free(sql);
+	cc_route_agent_del(agent);
 	return result;
 }
 
@@ -1046,6 +1929,7 @@ cc_status_t cc_agent_update(const char *key, const char *value, const char *agen
 
 done:
 	if (result == CC_STATUS_SUCCESS) {
+		cc_route_agent_set(agent, key, value);
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Updated Agent %s set %s = %s\n", agent, key, value);
 	}
 
@@ -1092,6 +1976,7 @@ cc_status_t cc_tier_add(const char *queue_name, const char *agent, const char *s
 				queue_name, agent, state, level, position);
 		cc_execute_sql(NULL, sql, NULL);
 		switch_safe_free(sql);
+		cc_route_tier_add(queue_name, agent, state, level, position);
 
 		result = CC_STATUS_SUCCESS;
 	} else {
@@ -1167,6 +2052,7 @@ cc_status_t cc_tier_update(const char *key, const char *value, const char *queue
 	}	
 done:
 	if (result == CC_STATUS_SUCCESS) {
+		cc_route_tier_set(queue_name, agent, key, value);
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Updated tier: Agent %s in Queue %s set %s = %s\n", agent, queue_name, key, value);
 	}
 	return result;
@@ -1181,6 +2067,7 @@ cc_status_t cc_tier_del(const char *queue_name, const char *agent)
 	sql = switch_mprintf("DELETE FROM tiers WHERE queue = '%q' AND agent = '%q';", queue_name, agent);
 	cc_execute_sql(NULL, sql, NULL);
 	switch_safe_free(sql);
+	cc_route_tier_del(queue_name, agent);
 
 	result = CC_STATUS_SUCCESS;
 
@@ -1265,6 +2152,7 @@ static switch_status_t load_config(void)
 	}
 
 	switch_mutex_lock(globals.mutex);
+	globals.memory_routing = SWITCH_TRUE;
 	if ((settings = switch_xml_child(cfg, "settings"))) {
 		for (param = switch_xml_child(settings, "param"); param; param = param->next) {
 			char *var = (char *) switch_xml_attr_soft(param, "name");
@@ -1274,6 +2162,8 @@ static switch_status_t load_config(void)
 				globals.debug = atoi(val);
 			} else if (!strcasecmp(var, "dbname")) {
 				globals.dbname = strdup(val);
+			} else if (!strcasecmp(var, "memory-routing")) {
+				globals.memory_routing = switch_true(val);
 			} else if (!strcasecmp(var, "odbc-dsn")) {
 				globals.odbc_dsn = strdup(val);
 
@@ -1316,6 +2206,8 @@ static switch_status_t load_config(void)
 	cc_execute_sql(NULL, sql, NULL);
 	switch_safe_free(sql);
 
+	cc_route_load();
+
 	/* Loading queue into memory struct */
 	if ((x_queues = switch_xml_child(cfg, "queues"))) {
 		for (x_queue = switch_xml_child(x_queues, "queue"); x_queue; x_queue = x_queue->next) {
@@ -1420,6 +2312,7 @@ static void *SWITCH_THREAD_FUNC outbound_agent_thread_run(switch_thread_t *threa
 
 		cc_execute_sql(NULL, sql, NULL);
 		switch_safe_free(sql);
+		cc_route_member_abandon(h->member_uuid, local_epoch_time_now(NULL), SWITCH_TRUE);
 		goto done;
 	}
 
@@ -1569,22 +2462,32 @@ static void *SWITCH_THREAD_FUNC outbound_agent_thread_run(switch_thread_t *threa
 
 
 		if (!strcasecmp(h->queue_strategy,"ring-all")) {
-			char res[256];
+			char res[256] = "0";
 			/* Map the Agent to the member */
-			sql = switch_mprintf("UPDATE members SET serving_agent = '%q', serving_system = 'single_box', state = '%q'"
-					" WHERE state = '%q' AND uuid = '%q' AND system = 'single_box' AND serving_agent = 'ring-all'",
-					h->agent_name, cc_member_state2str(CC_MEMBER_STATE_TRYING),
-					cc_member_state2str(CC_MEMBER_STATE_TRYING), h->member_uuid);
-			cc_execute_sql(NULL, sql, NULL);
+			if (globals.memory_routing) {
+				/* The index decides who won, the db only follows */
+				if (cc_route_member_update(h->member_uuid, CC_MEMBER_STATE_TRYING, "ring-all", CC_MEMBER_STATE_TRYING, h->agent_name)) {
+					switch_set_string(res, "1");
+				}
+			}
+			if (!globals.memory_routing || atoi(res)) {
+				sql = switch_mprintf("UPDATE members SET serving_agent = '%q', serving_system = 'single_box', state = '%q'"
+						" WHERE state = '%q' AND uuid = '%q' AND system = 'single_box' AND serving_agent = 'ring-all'",
+						h->agent_name, cc_member_state2str(CC_MEMBER_STATE_TRYING),
+						cc_member_state2str(CC_MEMBER_STATE_TRYING), h->member_uuid);
+				cc_execute_sql(NULL, sql, NULL);
 
-			switch_safe_free(sql);
+				switch_safe_free(sql);
+			}
 
-			/* Check if we won the race to get the member to our selected agent (Used for Multi system purposes) */
-			sql = switch_mprintf("SELECT count(*) FROM members"
-					" WHERE serving_agent = '%q' AND serving_system = 'single_box' AND uuid = '%q' AND system = 'single_box'",
-					h->agent_name, h->member_uuid);
-			cc_execute_sql2str(NULL, NULL, sql, res, sizeof(res));
-			switch_safe_free(sql);
+			if (!globals.memory_routing) {
+				/* Check if we won the race to get the member to our selected agent (Used for Multi system purposes) */
+				sql = switch_mprintf("SELECT count(*) FROM members"
+						" WHERE serving_agent = '%q' AND serving_system = 'single_box' AND uuid = '%q' AND system = 'single_box'",
+						h->agent_name, h->member_uuid);
+				cc_execute_sql2str(NULL, NULL, sql, res, sizeof(res));
+				switch_safe_free(sql);
+			}
 
 			if (atoi(res) == 0) {
 				goto done;
@@ -1625,6 +2528,7 @@ static void *SWITCH_THREAD_FUNC outbound_agent_thread_run(switch_thread_t *threa
 				h->agent_name, h->agent_system);
 		cc_execute_sql(NULL, sql, NULL);
 		switch_safe_free(sql);
+		cc_route_agent_bridge_start(h->agent_name, agent_uuid);
 
 		/* Change the agents Status in the tiers */
 		cc_tier_update("state", cc_tier_state2str(CC_TIER_STATE_ACTIVE_INBOUND), h->queue_name, h->agent_name);
@@ -1687,11 +2591,13 @@ static void *SWITCH_THREAD_FUNC outbound_agent_thread_run(switch_thread_t *threa
 				, (strcasecmp(h->agent_type, CC_AGENT_TYPE_UUID_STANDBY)?"uuid = '',":""), local_epoch_time_now(NULL), local_epoch_time_now(NULL), h->agent_name, h->agent_system);
 		cc_execute_sql(NULL, sql, NULL);
 		switch_safe_free(sql);
+		cc_route_agent_bridge_end(h->agent_name, strcasecmp(h->agent_type, CC_AGENT_TYPE_UUID_STANDBY) ? SWITCH_TRUE : SWITCH_FALSE);
 
 		/* Remove the member entry from the db (Could become optional to support latter processing) */
 		sql = switch_mprintf("DELETE FROM members WHERE system = 'single_box' AND uuid = '%q'", h->member_uuid);
 		cc_execute_sql(NULL, sql, NULL);
 		switch_safe_free(sql);
+		cc_route_member_del(h->member_uuid);
 
 		/* Caller off event */
 		if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CALLCENTER_EVENT) == SWITCH_STATUS_SUCCESS) {
@@ -1724,6 +2630,7 @@ static void *SWITCH_THREAD_FUNC outbound_agent_thread_run(switch_thread_t *threa
 				h->agent_name, h->agent_system, h->member_uuid);
 		cc_execute_sql(NULL, sql, NULL);
 		switch_safe_free(sql);
+		cc_route_member_update(h->member_uuid, CC_MEMBER_STATE_UNKNOWN, h->agent_name, CC_MEMBER_STATE_WAITING, "");
 
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member_session), SWITCH_LOG_DEBUG, "Agent %s Origination Canceled : %s\n", h->agent_name, switch_channel_cause2str(cause));
 
@@ -1755,6 +2662,7 @@ static void *SWITCH_THREAD_FUNC outbound_agent_thread_run(switch_thread_t *threa
 						h->agent_name, h->agent_system);
 				cc_execute_sql(NULL, sql, NULL);
 				switch_safe_free(sql);
+				cc_route_agent_no_answer(h->agent_name);
 
 				/* Put Agent on break because he didn't answer often */
 				if (h->max_no_answer > 0 && (h->no_answer_count + 1) >= h->max_no_answer) {
@@ -1798,6 +2706,7 @@ done:
 			cc_tier_state2str(CC_TIER_STATE_READY), h->agent_name, h->queue_name, cc_tier_state2str(CC_TIER_STATE_STANDBY));
 	cc_execute_sql(NULL, sql, NULL);
 	switch_safe_free(sql);
+	cc_route_tier_release(h->agent_name, h->queue_name, tiers_state);
 
 	/* If we are in Status Available On Demand, set state to Idle so we do not receive another call until state manually changed to Waiting */
 	if (!strcasecmp(cc_agent_status2str(CC_AGENT_STATUS_AVAILABLE_ON_DEMAND), h->agent_status)) {
@@ -1923,7 +2832,22 @@ static int agents_callback(void *pArg, int argc, char **argv, char **columnNames
 		}
 	}
 
-	if (!strcasecmp(cbt->strategy,"ring-all")) {
+	if (globals.memory_routing) {
+		/* The index decides who gets the member, the db only follows */
+		if (!strcasecmp(cbt->strategy,"ring-all")) {
+			switch_snprintf(res, sizeof(res), "%d", cc_route_member_serving(cbt->member_uuid, "ring-all"));
+		} else if (cc_route_member_update(cbt->member_uuid, CC_MEMBER_STATE_WAITING, NULL, CC_MEMBER_STATE_TRYING, agent_name)) {
+			sql = switch_mprintf("UPDATE members SET serving_agent = '%q', serving_system = 'single_box', state = '%q'"
+					" WHERE state = '%q' AND uuid = '%q' AND system = 'single_box'",
+					agent_name, cc_member_state2str(CC_MEMBER_STATE_TRYING),
+					cc_member_state2str(CC_MEMBER_STATE_WAITING), cbt->member_uuid);
+			cc_execute_sql(NULL, sql, NULL);
+			switch_safe_free(sql);
+			switch_snprintf(res, sizeof(res), "1");
+		} else {
+			switch_snprintf(res, sizeof(res), "0");
+		}
+	} else if (!strcasecmp(cbt->strategy,"ring-all")) {
 		/* Check if member is a ring-all mode */
 		sql = switch_mprintf("SELECT count(*) FROM members WHERE serving_agent = 'ring-all' AND uuid = '%q' AND system = 'single_box'", cbt->member_uuid);
 		cc_execute_sql2str(NULL, NULL, sql, res, sizeof(res));
@@ -1997,6 +2921,7 @@ static int agents_callback(void *pArg, int argc, char **argv, char **columnNames
 						cc_tier_state2str(CC_TIER_STATE_STANDBY), h->agent_name, h->queue_name, cc_tier_state2str(CC_TIER_STATE_READY));
 				cc_execute_sql(NULL, sql, NULL);
 				switch_safe_free(sql);
+				cc_route_tier_offer(h->agent_name, h->queue_name);
 
 				switch_threadattr_create(&thd_attr, h->pool);
 				switch_threadattr_detach_set(thd_attr, 1);
@@ -2014,6 +2939,193 @@ static int agents_callback(void *pArg, int argc, char **argv, char **columnNames
 	return 0;
 }
 
+#define CC_ROUTE_AGENT_COLUMNS 18
+
+static int route_cmp(int64_t a, int64_t b)
+{
+	return a < b ? -1 : a > b;
+}
+
+static int route_tier_cmp_position(const void *a, const void *b)
+{
+	const cc_route_tier_t *ta = *(cc_route_tier_t * const *) a;
+	const cc_route_tier_t *tb = *(cc_route_tier_t * const *) b;
+	int r;
+
+	if ((r = route_cmp(ta->level, tb->level)) || (r = route_cmp(ta->position, tb->position))) {
+		return r;
+	}
+	return route_cmp(ta->agent->last_offered_call, tb->agent->last_offered_call);
+}
+
+static int route_tier_cmp_idle(const void *a, const void *b)
+{
+	const cc_route_tier_t *ta = *(cc_route_tier_t * const *) a;
+	const cc_route_tier_t *tb = *(cc_route_tier_t * const *) b;
+	int r;
+
+	if ((r = route_cmp(ta->level, tb->level)) || (r = route_cmp(ta->agent->last_offered_call, tb->agent->last_offered_call))) {
+		return r;
+	}
+	return route_cmp(ta->position, tb->position);
+}
+
+static int route_tier_cmp_talk_time(const void *a, const void *b)
+{
+	const cc_route_tier_t *ta = *(cc_route_tier_t * const *) a;
+	const cc_route_tier_t *tb = *(cc_route_tier_t * const *) b;
+	int r;
+
+	if ((r = route_cmp(ta->level, tb->level)) || (r = route_cmp(ta->agent->talk_time, tb->agent->talk_time))) {
+		return r;
+	}
+	return route_cmp(ta->position, tb->position);
+}
+
+static int route_tier_cmp_calls(const void *a, const void *b)
+{
+	const cc_route_tier_t *ta = *(cc_route_tier_t * const *) a;
+	const cc_route_tier_t *tb = *(cc_route_tier_t * const *) b;
+	int r;
+
+	if ((r = route_cmp(ta->level, tb->level)) || (r = route_cmp(ta->agent->calls_answered, tb->agent->calls_answered))) {
+		return r;
+	}
+	return route_cmp(ta->position, tb->position);
+}
+
+/* Same columns as the agents queries in members_callback() */
+static char **route_agent_row(switch_memory_pool_t *pool, cc_route_tier_t *tier)
+{
+	cc_route_agent_t *agent = tier->agent;
+	char **argv = switch_core_alloc(pool, CC_ROUTE_AGENT_COLUMNS * sizeof(char *));
+
+	argv[0] = switch_core_strdup(pool, agent->system);
+	argv[1] = switch_core_strdup(pool, agent->name);
+	argv[2] = switch_core_strdup(pool, cc_agent_status2str(agent->status));
+	argv[3] = switch_core_strdup(pool, agent->contact);
+	argv[4] = switch_core_sprintf(pool, "%d", agent->no_answer_count);
+	argv[5] = switch_core_sprintf(pool, "%d", agent->max_no_answer);
+	argv[6] = switch_core_sprintf(pool, "%d", agent->reject_delay_time);
+	argv[7] = switch_core_sprintf(pool, "%d", agent->busy_delay_time);
+	argv[8] = switch_core_sprintf(pool, "%d", agent->no_answer_delay_time);
+	argv[9] = switch_core_strdup(pool, cc_tier_state2str(tier->state));
+	argv[10] = switch_core_sprintf(pool, "%" SWITCH_TIME_T_FMT, agent->last_bridge_end);
+	argv[11] = switch_core_sprintf(pool, "%d", agent->wrap_up_time);
+	argv[12] = switch_core_strdup(pool, cc_agent_state2str(agent->state));
+	argv[13] = switch_core_sprintf(pool, "%" SWITCH_TIME_T_FMT, agent->ready_time);
+	argv[14] = switch_core_sprintf(pool, "%d", tier->position);
+	argv[15] = switch_core_sprintf(pool, "%d", tier->level);
+	argv[16] = switch_core_strdup(pool, agent->type);
+	argv[17] = switch_core_strdup(pool, agent->uuid);
+
+	return argv;
+}
+
+/*!
+ * \brief In-memory version of the agents query of members_callback(), feeds agents_callback() in the same order
+ * \param position the tier position to resume after for top-down
+ * \param level the tier level to resume in for top-down
+ */
+static void cc_route_agents_dispatch(const char *queue_name, const char *strategy, int position, int level, agent_callback_t *cbt)
+{
+	cc_route_queue_t *rq;
+	cc_route_tier_t *tier, **tiers;
+	switch_memory_pool_t *pool = NULL;
+	char ***rows = NULL;
+	int (*cmp) (const void *, const void *) = route_tier_cmp_position;
+	switch_bool_t resume = SWITCH_FALSE;
+	int i, n = 0, first = 0;
+
+	switch_mutex_lock(route.mutex);
+
+	if (!(rq = route_queue_get(queue_name, SWITCH_FALSE)) || !rq->present) {
+		goto end;
+	}
+
+	/* Nobody could be offered the call, all agents_callback() would do is notice there are agents */
+	if (!rq->idle) {
+		cbt->agent_found = SWITCH_TRUE;
+		goto end;
+	}
+
+	switch_core_new_memory_pool(&pool);
+	tiers = switch_core_alloc(pool, 2 * rq->present * sizeof(*tiers));
+
+	if (!strcasecmp(strategy, "top-down")) {
+		resume = SWITCH_TRUE;
+	} else if (!strcasecmp(strategy, "round-robin")) {
+		cc_route_tier_t *last = NULL;
+
+		for (tier = rq->tiers; tier; tier = tier->next) {
+			if (tier->agent->last_offered_call > 0 && (!last || tier->agent->last_offered_call > last->agent->last_offered_call)) {
+				last = tier;
+			}
+		}
+		if (last) {
+			position = last->position;
+			level = last->level;
+			resume = SWITCH_TRUE;
+		}
+	} else if (!strcasecmp(strategy, "longest-idle-agent")) {
+		cmp = route_tier_cmp_idle;
+	} else if (!strcasecmp(strategy, "agent-with-least-talk-time")) {
+		cmp = route_tier_cmp_talk_time;
+	} else if (!strcasecmp(strategy, "agent-with-fewest-calls")) {
+		cmp = route_tier_cmp_calls;
+	}
+
+	/* The agents after the last one offered a call within its level go first, then everybody from the top */
+	if (resume) {
+		for (tier = rq->tiers; tier; tier = tier->next) {
+			if ((tier->class & CC_ROUTE_PRESENT) && tier->level == level && tier->position > position) {
+				tiers[n++] = tier;
+			}
+		}
+		qsort(tiers, n, sizeof(*tiers), route_tier_cmp_position);
+		first = n;
+	}
+
+	for (tier = rq->tiers; tier; tier = tier->next) {
+		if ((tier->class & CC_ROUTE_PRESENT)) {
+			tiers[n++] = tier;
+		}
+	}
+	qsort(tiers + first, n - first, sizeof(*tiers), cmp);
+
+	if (!strcasecmp(strategy, "random")) {
+		int j, k;
+
+		for (i = first; i < n; i = j) {
+			for (j = i + 1; j < n && tiers[j]->level == tiers[i]->level; j++);
+			for (k = j - 1; k > i; k--) {
+				int r = i + rand() % (k - i + 1);
+				tier = tiers[k];
+				tiers[k] = tiers[r];
+				tiers[r] = tier;
+			}
+		}
+	}
+
+	rows = switch_core_alloc(pool, n * sizeof(*rows));
+	for (i = 0; i < n; i++) {
+		rows[i] = route_agent_row(pool, tiers[i]);
+	}
+
+end:
+	switch_mutex_unlock(route.mutex);
+
+	for (i = 0; rows && i < n; i++) {
+		if (agents_callback(cbt, CC_ROUTE_AGENT_COLUMNS, rows[i], NULL)) {
+			break;
+		}
+	}
+
+	if (pool) {
+		switch_core_destroy_memory_pool(&pool);
+	}
+}
+
 static int members_callback(void *pArg, int argc, char **argv, char **columnNames)
 {
 	cc_queue_t *queue = NULL;
@@ -2030,6 +3142,7 @@ static int members_callback(void *pArg, int argc, char **argv, char **columnName
 	agent_callback_t cbt;
 	const char *member_state = NULL;
 	const char *member_abandoned_epoch = NULL;
+	int position = 0, level = 0;
 	memset(&cbt, 0, sizeof(cbt));
 
 	cbt.queue_name = argv[0];
@@ -2072,6 +3185,7 @@ static int members_callback(void *pArg, int argc, char **argv, char **columnName
 			sql = switch_mprintf("DELETE FROM members WHERE system = 'single_box' AND uuid = '%q' AND (abandoned_epoch = '%" SWITCH_TIME_T_FMT "' OR joined_epoch = '%q')", cbt.member_uuid, abandoned_epoch, cbt.member_joined_epoch);
 			cc_execute_sql(NULL, sql, NULL);
 			switch_safe_free(sql);
+			cc_route_member_del(cbt.member_uuid);
 		}
 		/* Skip this member */
 		goto end;
@@ -2094,10 +3208,9 @@ static int members_callback(void *pArg, int argc, char **argv, char **columnName
 	cbt.record_template = queue_record_template;
 	cbt.agent_found = SWITCH_FALSE;
 
-	if (!strcasecmp(queue->strategy, "top-down")) {
+	if (!strcasecmp(queue_strategy, "top-down")) {
 		/* WARNING this use channel variable to help dispatch... might need to be reviewed to save it in DB to make this multi server prooft in the future */
 		switch_core_session_t *member_session = switch_core_session_locate(cbt.member_session_uuid);
-		int position = 0, level = 0;
 		const char *last_agent_tier_position, *last_agent_tier_level;
 		if (member_session) {
 			switch_channel_t *member_channel = switch_core_session_get_channel(member_session);
@@ -2110,7 +3223,18 @@ static int members_callback(void *pArg, int argc, char **argv, char **columnName
 			}
 			switch_core_session_rwunlock(member_session);
 		}
+	} else if (!strcasecmp(queue_strategy, "ring-all")) {
+		if (cc_route_member_update(cbt.member_uuid, CC_MEMBER_STATE_WAITING, NULL, CC_MEMBER_STATE_TRYING, NULL) || !globals.memory_routing) {
+			sql = switch_mprintf("UPDATE members SET state = '%q' WHERE state = '%q' AND uuid = '%q' AND system = 'single_box'",
+					cc_member_state2str(CC_MEMBER_STATE_TRYING), cc_member_state2str(CC_MEMBER_STATE_WAITING), cbt.member_uuid);
+			cc_execute_sql(NULL, sql, NULL);
+			switch_safe_free(sql);
+		}
+	}
 
+	if (globals.memory_routing) {
+		cc_route_agents_dispatch(queue_name, queue_strategy, position, level, &cbt);
+	} else if (!strcasecmp(queue_strategy, "top-down")) {
 		sql = switch_mprintf("SELECT system, name, status, contact, no_answer_count, max_no_answer, reject_delay_time, busy_delay_time, no_answer_delay_time, tiers.state, agents.last_bridge_end, agents.wrap_up_time, agents.state, agents.ready_time, tiers.position as tiers_position, tiers.level as tiers_level, agents.type, agents.uuid, agents.last_offered_call as agents_last_offered_call, 1 as dyn_order FROM agents LEFT JOIN tiers ON (agents.name = tiers.agent)"
 				" WHERE tiers.queue = '%q'"
 				" AND (agents.status = '%q' OR agents.status = '%q' OR agents.status = '%q')"
@@ -2128,7 +3252,7 @@ static int members_callback(void *pArg, int argc, char **argv, char **columnName
 				queue_name,
 				cc_agent_status2str(CC_AGENT_STATUS_AVAILABLE), cc_agent_status2str(CC_AGENT_STATUS_ON_BREAK), cc_agent_status2str(CC_AGENT_STATUS_AVAILABLE_ON_DEMAND)
 				);
-	} else if (!strcasecmp(queue->strategy, "round-robin")) {
+	} else if (!strcasecmp(queue_strategy, "round-robin")) {
 		sql = switch_mprintf("SELECT system, name, status, contact, no_answer_count, max_no_answer, reject_delay_time, busy_delay_time, no_answer_delay_time, tiers.state, agents.last_bridge_end, agents.wrap_up_time, agents.state, agents.ready_time, tiers.position as tiers_position, tiers.level as tiers_level, agents.type, agents.uuid, agents.last_offered_call as agents_last_offered_call, 1 as dyn_order FROM agents LEFT JOIN tiers ON (agents.name = tiers.agent)"
 				" WHERE tiers.queue = '%q'"
 				" AND (agents.status = '%q' OR agents.status = '%q' OR agents.status = '%q')"
@@ -2149,17 +3273,13 @@ static int members_callback(void *pArg, int argc, char **argv, char **columnName
 
 	} else {
 
-		if (!strcasecmp(queue->strategy, "longest-idle-agent")) {
+		if (!strcasecmp(queue_strategy, "longest-idle-agent")) {
 			sql_order_by = switch_mprintf("level, agents.last_offered_call, position");
 		} else if (!strcasecmp(queue_strategy, "agent-with-least-talk-time")) {
 			sql_order_by = switch_mprintf("level, agents.talk_time, position");
 		} else if (!strcasecmp(queue_strategy, "agent-with-fewest-calls")) {
 			sql_order_by = switch_mprintf("level, agents.calls_answered, position");
 		} else if (!strcasecmp(queue_strategy, "ring-all")) {
-			sql = switch_mprintf("UPDATE members SET state = '%q' WHERE state = '%q' AND uuid = '%q' AND system = 'single_box'",
-					cc_member_state2str(CC_MEMBER_STATE_TRYING), cc_member_state2str(CC_MEMBER_STATE_WAITING), cbt.member_uuid);
-			cc_execute_sql(NULL, sql, NULL);
-			switch_safe_free(sql);
 			sql_order_by = switch_mprintf("level, position");
 		} else if(!strcasecmp(queue_strategy, "random")) {
 			sql_order_by = switch_mprintf("level, random()");
@@ -2181,9 +3301,10 @@ static int members_callback(void *pArg, int argc, char **argv, char **columnName
 
 	}
 
-	cc_execute_sql_callback(NULL /* queue */, NULL /* mutex */, sql, agents_callback, &cbt /* Call back variables */);
-
-	switch_safe_free(sql);
+	if (sql) {
+		cc_execute_sql_callback(NULL /* queue */, NULL /* mutex */, sql, agents_callback, &cbt /* Call back variables */);
+		switch_safe_free(sql);
+	}
 
 	/* We update a field in the queue struct so we can kick caller out if waiting for too long with no agent */
 	if (!cbt.queue_name || !(queue = get_queue(cbt.queue_name))) {
@@ -2205,6 +3326,111 @@ end:
 	return 0;
 }
 
+#define CC_ROUTE_MEMBER_COLUMNS 9
+
+struct route_cursor {
+	cc_route_member_t **heap;
+	int len;
+};
+
+/* Same columns as the members query of cc_agent_dispatch_thread_run() */
+static char **route_member_row(switch_memory_pool_t *pool, cc_route_member_t *member, switch_time_t now)
+{
+	char **argv = switch_core_alloc(pool, CC_ROUTE_MEMBER_COLUMNS * sizeof(char *));
+
+	argv[0] = switch_core_strdup(pool, member->queue->name);
+	argv[1] = switch_core_strdup(pool, member->uuid);
+	argv[2] = switch_core_strdup(pool, member->session_uuid);
+	argv[3] = switch_core_strdup(pool, member->cid_number);
+	argv[4] = switch_core_strdup(pool, member->cid_name);
+	argv[5] = switch_core_sprintf(pool, "%" SWITCH_TIME_T_FMT, member->joined_epoch);
+	argv[6] = switch_core_sprintf(pool, "%" SWITCH_INT64_T_FMT, (int64_t) now + route_member_priority(member));
+	argv[7] = switch_core_strdup(pool, cc_member_state2str(member->state));
+	argv[8] = switch_core_sprintf(pool, "%" SWITCH_TIME_T_FMT, member->abandoned_epoch);
+
+	return argv;
+}
+
+/*!
+ * \brief One pass of the dispatch thread over the routing index
+ * \note the rows are built under route.mutex and handed to members_callback() once it is released
+ */
+static void cc_route_dispatch(void)
+{
+	cc_route_queue_t *rq;
+	cc_route_member_t *member;
+	switch_memory_pool_t *pool = NULL;
+	struct route_cursor *cursors;
+	char ***rows = NULL;
+	switch_time_t now = local_epoch_time_now(NULL);
+	int i, queues = 0, total = 0, n = 0;
+
+	switch_mutex_lock(route.mutex);
+
+	for (rq = route.queues; rq; rq = rq->next) {
+		queues++;
+		total += rq->heap_len;
+		for (member = rq->abandoned; member; member = member->abandoned_next) {
+			total++;
+		}
+	}
+
+	if (!total) {
+		goto end;
+	}
+
+	switch_core_new_memory_pool(&pool);
+	rows = switch_core_alloc(pool, total * sizeof(*rows));
+	cursors = switch_core_alloc(pool, queues * sizeof(*cursors));
+
+	for (i = 0, rq = route.queues; rq; rq = rq->next, i++) {
+		if ((cursors[i].len = rq->heap_len)) {
+			cursors[i].heap = switch_core_alloc(pool, rq->heap_len * sizeof(*rq->heap));
+			memcpy(cursors[i].heap, rq->heap, rq->heap_len * sizeof(*rq->heap));
+		}
+	}
+
+	/* Merge copies of the queue heaps so members come out by score across all the queues */
+	for (;;) {
+		int best = -1;
+
+		for (i = 0; i < queues; i++) {
+			if (cursors[i].len && (best < 0 || route_member_priority(cursors[i].heap[0]) > route_member_priority(cursors[best].heap[0]))) {
+				best = i;
+			}
+		}
+
+		if (best < 0) {
+			break;
+		}
+
+		rows[n++] = route_member_row(pool, cursors[best].heap[0], now);
+
+		if (--cursors[best].len) {
+			cursors[best].heap[0] = cursors[best].heap[cursors[best].len];
+			route_heap_sift_down(cursors[best].heap, cursors[best].len, 0, SWITCH_FALSE);
+		}
+	}
+
+	/* Abandoned members only go through members_callback() to be discarded once they are too old */
+	for (rq = route.queues; rq; rq = rq->next) {
+		for (member = rq->abandoned; member; member = member->abandoned_next) {
+			rows[n++] = route_member_row(pool, member, now);
+		}
+	}
+
+end:
+	switch_mutex_unlock(route.mutex);
+
+	for (i = 0; rows && i < n; i++) {
+		members_callback(NULL, CC_ROUTE_MEMBER_COLUMNS, rows[i], NULL);
+	}
+
+	if (pool) {
+		switch_core_destroy_memory_pool(&pool);
+	}
+}
+
 static int AGENT_DISPATCH_THREAD_RUNNING = 0;
 static int AGENT_DISPATCH_THREAD_STARTED = 0;
 
@@ -2229,6 +3455,13 @@ void *SWITCH_THREAD_FUNC cc_agent_dispatch_thread_run(switch_thread_t *thread, v
 
 	while (globals.running == 1) {
 		char *sql = NULL;
+
+		if (globals.memory_routing) {
+			cc_route_dispatch();
+			switch_yield(100000);
+			continue;
+		}
+
 		sql = switch_mprintf("SELECT queue,uuid,session_uuid,cid_number,cid_name,joined_epoch,(%" SWITCH_TIME_T_FMT "-joined_epoch)+base_score+skill_score AS score, state, abandoned_epoch FROM members"
 				" WHERE state = '%q' OR state = '%q' OR (serving_agent = 'ring-all' AND state = '%q') ORDER BY score DESC",
 				local_epoch_time_now(NULL),
@@ -2523,6 +3756,12 @@ SWITCH_STANDARD_APP(callcenter_function)
 				cc_member_state2str(CC_MEMBER_STATE_WAITING));
 		cc_execute_sql(queue, sql, NULL);
 		switch_safe_free(sql);
+
+		cc_route_member_add(queue_name, member_uuid, member_session_uuid,
+							switch_str_nil(switch_channel_get_variable(member_channel, "caller_id_number")),
+							switch_str_nil(switch_channel_get_variable(member_channel, "caller_id_name")),
+							local_epoch_time_now(NULL), 0, cc_base_score_int, 0,
+							(!strcasecmp(queue->strategy,"ring-all")?"ring-all":""), CC_MEMBER_STATE_WAITING);
 	} else {
 		char res[256];
 
@@ -2533,6 +3772,7 @@ SWITCH_STANDARD_APP(callcenter_function)
 				member_session_uuid, cc_member_state2str(CC_MEMBER_STATE_WAITING), local_epoch_time_now(NULL), member_uuid, cc_member_state2str(CC_MEMBER_STATE_ABANDONED)); 
 		cc_execute_sql(queue, sql, NULL);
 		switch_safe_free(sql);
+		cc_route_member_resume(member_uuid, member_session_uuid);
 
 		/* Confirm we took that member in */
 		sql = switch_mprintf("SELECT abandoned_epoch FROM members WHERE uuid = '%q' AND session_uuid = '%q' AND state = '%q' AND queue = '%q'", member_uuid, member_session_uuid, cc_member_state2str(CC_MEMBER_STATE_WAITING), queue_name);
@@ -2649,6 +3889,7 @@ SWITCH_STANDARD_APP(callcenter_function)
 				cc_member_state2str(CC_MEMBER_STATE_ABANDONED), local_epoch_time_now(NULL), member_uuid);
 				cc_execute_sql(NULL, sql, NULL);
 		switch_safe_free(sql);
+		cc_route_member_abandon(member_uuid, local_epoch_time_now(NULL), SWITCH_FALSE);
 
 		/* Hangup any callback agents  */
 		switch_core_session_hupall_matching_var("cc_member_pre_answer_uuid", member_uuid, SWITCH_CAUSE_ORIGINATOR_CANCEL);
@@ -2688,6 +3929,7 @@ SWITCH_STANDARD_APP(callcenter_function)
 				cc_member_state2str(CC_MEMBER_STATE_ANSWERED), local_epoch_time_now(NULL), member_uuid);
 		cc_execute_sql(NULL, sql, NULL);
 		switch_safe_free(sql);
+		cc_route_member_update(member_uuid, CC_MEMBER_STATE_UNKNOWN, NULL, CC_MEMBER_STATE_ANSWERED, NULL);
 
 		/* Update some channel variables for xml_cdr needs */
 		switch_channel_set_variable_printf(member_channel, "cc_cause", "%s", "answered");
@@ -3176,6 +4418,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_callcenter_load)
 
 	switch_core_hash_init(&globals.queue_hash, globals.pool);
 	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	cc_route_init(globals.pool);
 
 	if ((status = load_config()) != SWITCH_STATUS_SUCCESS) {
 		return status;
@@ -3276,6 +4519,8 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_callcenter_shutdown)
 	switch_safe_free(globals.dbname);
 	switch_mutex_unlock(globals.mutex);
 
+	cc_route_shutdown();
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
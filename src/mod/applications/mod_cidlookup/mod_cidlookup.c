@@ -44,7 +44,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cidlookup_load);
  */
 SWITCH_MODULE_DEFINITION(mod_cidlookup, mod_cidlookup_load, mod_cidlookup_shutdown, NULL);
 
-static char *SYNTAX = "cidlookup status|number [skipurl] [skipcitystate] [verbose]";
+static char *SYNTAX = "cidlookup status|flush|number [skipurl] [skipcitystate] [verbose]";
+
+#define CIDLOOKUP_ASYNC_PRIVATE "__cidlookup_async"
 
 static struct {
 	char *url;
@@ -56,6 +58,11 @@ static struct {
 	switch_bool_t cache;
 	int cache_expire;
 
+	switch_bool_t memory_cache;
+	int memory_cache_size;
+	int negative_cache_expire;
+	int async_timeout;
+
 	char *odbc_dsn;
 	char *odbc_user;
 	char *odbc_pass;
@@ -63,6 +70,17 @@ static struct {
 	char *citystate_sql;
 
 	switch_memory_pool_t *pool;
+
+	switch_mutex_t *cache_mutex;
+	switch_hash_t *cache_hash;
+	struct cid_cache_entry *cache_head;
+	struct cid_cache_entry *cache_tail;
+	int cache_count;
+	uint64_t cache_hits;
+	uint64_t cache_misses;
+
+	switch_mutex_t *async_mutex;
+	int async_threads;
 } globals;
 
 struct http_data {
@@ -79,6 +97,34 @@ struct cid_data_obj {
 };
 typedef struct cid_data_obj cid_data_t;
 
+/* in process cache, most recently used at the head */
+struct cid_cache_entry {
+	char *number;
+	char *name;
+	char *area;
+	char *src;
+	switch_bool_t negative;
+	switch_time_t expires;
+	struct cid_cache_entry *prev;
+	struct cid_cache_entry *next;
+};
+typedef struct cid_cache_entry cid_cache_entry_t;
+
+/* a lookup running beside the call, the result is copied in here so the thread never touches the session pool */
+struct cid_async_obj {
+	switch_core_session_t *session;
+	char *number;
+	switch_bool_t skipurl;
+	switch_bool_t skipcitystate;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	int done;
+	int applied;
+	char name[256];
+	char area[256];
+	char src[256];
+};
+typedef struct cid_async_obj cid_async_t;
 
 struct callback_obj {
 	switch_memory_pool_t *pool;
@@ -157,6 +203,14 @@ static switch_xml_config_item_t instructions[] = {
 	SWITCH_CONFIG_ITEM("cache", SWITCH_CONFIG_BOOL, CONFIG_RELOAD, &globals.cache, SWITCH_FALSE, NULL, "true|false", "whether to cache via cidlookup"),
 	SWITCH_CONFIG_ITEM("cache-expire", SWITCH_CONFIG_INT, CONFIG_RELOAD, &globals.cache_expire, (void *) 300, NULL, "expire",
 					   "seconds to preserve num->name cache"),
+	SWITCH_CONFIG_ITEM("memory-cache", SWITCH_CONFIG_BOOL, CONFIG_RELOAD, &globals.memory_cache, SWITCH_FALSE, NULL, "true|false",
+					   "whether to cache in process, does not need mod_memcache"),
+	SWITCH_CONFIG_ITEM("memory-cache-size", SWITCH_CONFIG_INT, CONFIG_RELOAD, &globals.memory_cache_size, (void *) 10000, NULL, "entries",
+					   "numbers kept in the in process cache, the least recently used go first"),
+	SWITCH_CONFIG_ITEM("negative-cache-expire", SWITCH_CONFIG_INT, CONFIG_RELOAD, &globals.negative_cache_expire, (void *) 60, NULL, "expire",
+					   "seconds to remember a number the url lookups found nothing for, 0 to not"),
+	SWITCH_CONFIG_ITEM("async-timeout", SWITCH_CONFIG_INT, CONFIG_RELOAD, &globals.async_timeout, (void *) 3000, NULL, "timeout",
+					   "milliseconds to wait at answer for an async lookup"),
 	SWITCH_CONFIG_ITEM("curl-timeout", SWITCH_CONFIG_INT, CONFIG_RELOAD, &globals.curl_timeout, (void *) 2000, NULL, "timeout for curl",
 					   "milliseconds to timeout"),
 	SWITCH_CONFIG_ITEM("curl-warning-duration", SWITCH_CONFIG_INT, CONFIG_RELOAD, &globals.curl_warnduration, (void *) 1000, NULL,
@@ -342,6 +396,136 @@ switch_bool_t set_cache(switch_memory_pool_t *pool, char *number, cid_data_t *ci
 	return success;
 }
 
+static void memory_cache_unlink(cid_cache_entry_t *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		globals.cache_head = entry->next;
+	}
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		globals.cache_tail = entry->prev;
+	}
+	entry->prev = entry->next = NULL;
+}
+
+static void memory_cache_push(cid_cache_entry_t *entry)
+{
+	entry->prev = NULL;
+	entry->next = globals.cache_head;
+	if (globals.cache_head) {
+		globals.cache_head->prev = entry;
+	} else {
+		globals.cache_tail = entry;
+	}
+	globals.cache_head = entry;
+}
+
+/* call with cache_mutex held */
+static void memory_cache_delete(cid_cache_entry_t *entry)
+{
+	memory_cache_unlink(entry);
+	switch_core_hash_delete(globals.cache_hash, entry->number);
+	globals.cache_count--;
+
+	switch_safe_free(entry->number);
+	switch_safe_free(entry->name);
+	switch_safe_free(entry->area);
+	switch_safe_free(entry->src);
+	free(entry);
+}
+
+static void memory_cache_flush(void)
+{
+	switch_mutex_lock(globals.cache_mutex);
+	while (globals.cache_head) {
+		memory_cache_delete(globals.cache_head);
+	}
+	switch_mutex_unlock(globals.cache_mutex);
+}
+
+/* a hit is copied into pool, a negative hit returns NULL with *negative set */
+static cid_data_t *memory_cache_get(switch_memory_pool_t *pool, const char *number, switch_bool_t *negative)
+{
+	cid_cache_entry_t *entry;
+	cid_data_t *cid = NULL;
+
+	*negative = SWITCH_FALSE;
+
+	switch_mutex_lock(globals.cache_mutex);
+	if ((entry = switch_core_hash_find(globals.cache_hash, number))) {
+		if (entry->expires < switch_micro_time_now()) {
+			memory_cache_delete(entry);
+			entry = NULL;
+		}
+	}
+
+	if (entry) {
+		memory_cache_unlink(entry);
+		memory_cache_push(entry);
+		globals.cache_hits++;
+
+		if (entry->negative) {
+			*negative = SWITCH_TRUE;
+		} else {
+			cid = switch_core_alloc(pool, sizeof(cid_data_t));
+			switch_assert(cid);
+			cid->name = entry->name ? switch_core_strdup(pool, entry->name) : NULL;
+			cid->area = entry->area ? switch_core_strdup(pool, entry->area) : NULL;
+			cid->src = entry->src ? switch_core_strdup(pool, entry->src) : NULL;
+		}
+	} else {
+		globals.cache_misses++;
+	}
+	switch_mutex_unlock(globals.cache_mutex);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10, "memory cache: k:'%s' %s\n", number,
+					  cid ? "hit" : (*negative ? "negative hit" : "miss"));
+	return cid;
+}
+
+/* a NULL cid remembers that nothing was found */
+static void memory_cache_set(const char *number, cid_data_t *cid)
+{
+	cid_cache_entry_t *entry;
+	int expire = cid ? globals.cache_expire : globals.negative_cache_expire;
+
+	if (globals.memory_cache_size <= 0 || expire <= 0) {
+		return;
+	}
+
+	switch_zmalloc(entry, sizeof(*entry));
+	entry->number = strdup(number);
+	if (cid) {
+		entry->name = cid->name ? strdup(cid->name) : NULL;
+		entry->area = cid->area ? strdup(cid->area) : NULL;
+		entry->src = cid->src ? strdup(cid->src) : NULL;
+	} else {
+		entry->negative = SWITCH_TRUE;
+	}
+	entry->expires = switch_micro_time_now() + (switch_time_t) expire * 1000000;
+
+	switch_mutex_lock(globals.cache_mutex);
+	{
+		cid_cache_entry_t *old;
+
+		if ((old = switch_core_hash_find(globals.cache_hash, number))) {
+			memory_cache_delete(old);
+		}
+	}
+
+	switch_core_hash_insert(globals.cache_hash, entry->number, entry);
+	memory_cache_push(entry);
+	globals.cache_count++;
+
+	while (globals.cache_count > globals.memory_cache_size && globals.cache_tail) {
+		memory_cache_delete(globals.cache_tail);
+	}
+	switch_mutex_unlock(globals.cache_mutex);
+}
+
 static size_t file_callback(void *ptr, size_t size, size_t nmemb, void *data)
 {
 	register unsigned int realsize = (unsigned int) (size * nmemb);
@@ -556,6 +740,7 @@ static cid_data_t *do_lookup(switch_memory_pool_t *pool, switch_event_t *event,
 	cid_data_t *cid = NULL;
 	cid_data_t *cidtmp = NULL;
 	switch_bool_t save_cache = SWITCH_FALSE;
+	switch_bool_t tried_url = SWITCH_FALSE;
 
 	cid = switch_core_alloc(pool, sizeof(cid_data_t));
 	switch_assert(cid);
@@ -573,6 +758,21 @@ static cid_data_t *do_lookup(switch_memory_pool_t *pool, switch_event_t *event,
 		}
 	}
 
+	if (globals.memory_cache) {
+		switch_bool_t negative = SWITCH_FALSE;
+
+		cidtmp = memory_cache_get(pool, number, &negative);
+		if (cidtmp) {
+			cid = cidtmp;
+			cid->src = switch_core_sprintf(pool, "%s (cache)", cid->src);
+			goto done;
+		}
+		if (negative) {
+			/* the url lookups found nothing for this number a moment ago */
+			skipurl = SWITCH_TRUE;
+		}
+	}
+
 	if (globals.cache) {
 		cidtmp = check_cache(pool, number);
 		if (cidtmp) {
@@ -583,6 +783,7 @@ static cid_data_t *do_lookup(switch_memory_pool_t *pool, switch_event_t *event,
 	}
 
 	if (!skipurl && globals.whitepages_apikey) {
+		tried_url = SWITCH_TRUE;
 		cid = do_whitepages_lookup(pool, event, number);
 		if (cid && cid->name) {	/* only cache if we have a name */
 			save_cache = SWITCH_TRUE;
@@ -591,6 +792,7 @@ static cid_data_t *do_lookup(switch_memory_pool_t *pool, switch_event_t *event,
 	}
 
 	if (!skipurl && globals.url) {
+		tried_url = SWITCH_TRUE;
 		url_query = switch_event_expand_headers(event, globals.url);
 		do_lookup_url(pool, event, &name, url_query, NULL, NULL, 0);
 		if (name) {
@@ -648,14 +850,176 @@ static cid_data_t *do_lookup(switch_memory_pool_t *pool, switch_event_t *event,
 		set_cache(pool, number, cid);
 	}
 
+	if (globals.memory_cache) {
+		if (save_cache) {
+			memory_cache_set(number, cid);
+		} else if (tried_url) {
+			memory_cache_set(number, NULL);
+		}
+	}
+
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10, "cidlookup source: %s\n", cid->src);
 	return cid;
 }
 
+static void cidlookup_set_channel(switch_core_session_t *session, cid_data_t *cid)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	switch_caller_profile_t *profile = switch_channel_get_caller_profile(channel);
+
+	if (!cid || !profile || zstr(cid->name)) {
+		return;
+	}
+
+	if (switch_string_var_check_const(cid->name)) {
+		switch_log_printf(SWITCH_CHANNEL_CHANNEL_LOG(channel), SWITCH_LOG_CRIT, "Invalid CID data {%s} contains a variable\n", cid->name);
+		return;
+	}
+
+	switch_channel_set_variable(channel, "original_caller_id_name", switch_core_session_strdup(session, profile->caller_id_name));
+	if (!zstr(cid->src)) {
+		switch_channel_set_variable(channel, "cidlookup_source", cid->src);
+	}
+	if (!zstr(cid->area)) {
+		switch_channel_set_variable(channel, "cidlookup_area", cid->area);
+	}
+	profile->caller_id_name = switch_core_strdup(profile->pool, cid->name);
+}
+
+static void *SWITCH_THREAD_FUNC cidlookup_async_run(switch_thread_t *thread, void *obj)
+{
+	cid_async_t *async = (cid_async_t *) obj;
+	switch_memory_pool_t *pool = NULL;
+	switch_event_t *event = NULL;
+	cid_data_t *cid;
+
+	switch_core_new_memory_pool(&pool);
+	switch_event_create(&event, SWITCH_EVENT_MESSAGE);
+
+	cid = do_lookup(pool, event, async->number, async->skipurl, async->skipcitystate);
+
+	switch_mutex_lock(async->mutex);
+	if (cid) {
+		switch_copy_string(async->name, switch_str_nil(cid->name), sizeof(async->name));
+		switch_copy_string(async->area, switch_str_nil(cid->area), sizeof(async->area));
+		switch_copy_string(async->src, switch_str_nil(cid->src), sizeof(async->src));
+	}
+	async->done = 1;
+	switch_thread_cond_signal(async->cond);
+	switch_mutex_unlock(async->mutex);
+
+	switch_event_destroy(&event);
+	switch_core_destroy_memory_pool(&pool);
+
+	/* the session may go away as soon as this is released, async lives in its pool */
+	switch_core_session_rwunlock(async->session);
+
+	switch_mutex_lock(globals.async_mutex);
+	globals.async_threads--;
+	switch_mutex_unlock(globals.async_mutex);
+
+	return NULL;
+}
+
+/* block until the lookup is done or timeout ms have passed and apply the result once */
+static void cidlookup_async_wait(switch_core_session_t *session, cid_async_t *async, int timeout)
+{
+	switch_time_t deadline = switch_micro_time_now() + (switch_time_t) timeout * 1000;
+	cid_data_t cid = { 0 };
+	int apply = 0;
+
+	switch_mutex_lock(async->mutex);
+	while (!async->done && !async->applied && timeout > 0) {
+		switch_time_t now = switch_micro_time_now();
+
+		if (now >= deadline) {
+			break;
+		}
+		switch_thread_cond_timedwait(async->cond, async->mutex, deadline - now);
+	}
+
+	if (!async->applied) {
+		async->applied = 1;
+		if (async->done) {
+			cid.name = switch_core_session_strdup(session, async->name);
+			cid.area = switch_core_session_strdup(session, async->area);
+			cid.src = switch_core_session_strdup(session, async->src);
+			apply = 1;
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "cidlookup for %s not done after %dms, leaving the name alone\n",
+							  async->number, timeout);
+		}
+	}
+	switch_mutex_unlock(async->mutex);
+
+	if (apply) {
+		cidlookup_set_channel(session, &cid);
+	}
+}
+
+static switch_status_t cidlookup_async_hook(switch_core_session_t *session, switch_core_session_message_t *msg)
+{
+	if (msg->message_id == SWITCH_MESSAGE_INDICATE_ANSWER || msg->message_id == SWITCH_MESSAGE_INDICATE_PROGRESS) {
+		switch_channel_t *channel = switch_core_session_get_channel(session);
+		cid_async_t *async;
+
+		if ((async = switch_channel_get_private(channel, CIDLOOKUP_ASYNC_PRIVATE))) {
+			cidlookup_async_wait(session, async, globals.async_timeout);
+		}
+		switch_core_event_hook_remove_receive_message(session, cidlookup_async_hook);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t cidlookup_async_start(switch_core_session_t *session, const char *number, switch_bool_t skipurl, switch_bool_t skipcitystate)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	switch_memory_pool_t *pool = switch_core_session_get_pool(session);
+	switch_thread_t *thread;
+	switch_threadattr_t *thd_attr = NULL;
+	cid_async_t *async;
+
+	if (switch_core_session_read_lock(session) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	async = switch_core_session_alloc(session, sizeof(*async));
+	async->session = session;
+	async->number = switch_core_session_strdup(session, number);
+	async->skipurl = skipurl;
+	async->skipcitystate = skipcitystate;
+	switch_mutex_init(&async->mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_thread_cond_create(&async->cond, pool);
+
+	switch_channel_set_private(channel, CIDLOOKUP_ASYNC_PRIVATE, async);
+	switch_core_event_hook_add_receive_message(session, cidlookup_async_hook);
+
+	switch_mutex_lock(globals.async_mutex);
+	globals.async_threads++;
+	switch_mutex_unlock(globals.async_mutex);
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_detach_set(thd_attr, 1);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	if (switch_thread_create(&thread, thd_attr, cidlookup_async_run, async, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Cannot start the cidlookup thread\n");
+		switch_channel_set_private(channel, CIDLOOKUP_ASYNC_PRIVATE, NULL);
+		switch_core_event_hook_remove_receive_message(session, cidlookup_async_hook);
+		switch_mutex_lock(globals.async_mutex);
+		globals.async_threads--;
+		switch_mutex_unlock(globals.async_mutex);
+		switch_core_session_rwunlock(session);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_APP(cidlookup_app_function)
 {
-	char *argv[4] = { 0 };
+	char *argv[5] = { 0 };
 	int argc;
 	char *mydata = NULL;
 	int i;
@@ -668,27 +1032,23 @@ SWITCH_STANDARD_APP(cidlookup_app_function)
 	const char *number = NULL;
 	switch_bool_t skipurl = SWITCH_FALSE;
 	switch_bool_t skipcitystate = SWITCH_FALSE;
+	switch_bool_t async = SWITCH_FALSE;
 
-	if (session) {
-		pool = switch_core_session_get_pool(session);
-	} else {
-		switch_core_new_memory_pool(&pool);
-	}
-	switch_event_create(&event, SWITCH_EVENT_MESSAGE);
+	pool = switch_core_session_get_pool(session);
 
 	if (!(mydata = switch_core_session_strdup(session, data))) {
 		return;
 	}
 
 	if ((argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0]))))) {
-		if (argc > 0) {
-			number = switch_core_session_strdup(session, argv[0]);
-		}
+		number = argv[0];
 		for (i = 1; i < argc; i++) {
 			if (!strcasecmp(argv[i], "skipurl")) {
 				skipurl = SWITCH_TRUE;
 			} else if (!strcasecmp(argv[i], "skipcitystate")) {
 				skipcitystate = SWITCH_TRUE;
+			} else if (!strcasecmp(argv[i], "async")) {
+				async = SWITCH_TRUE;
 			}
 		}
 	}
@@ -697,33 +1057,38 @@ SWITCH_STANDARD_APP(cidlookup_app_function)
 		number = switch_caller_get_field_by_name(profile, "caller_id_number");
 	}
 
-	if (number) {
-		cid = do_lookup(pool, event, number, skipurl, skipcitystate);
-	}
-
-	if (switch_string_var_check_const(cid->name)) {
-		switch_log_printf(SWITCH_CHANNEL_CHANNEL_LOG(channel), SWITCH_LOG_CRIT, "Invalid CID data {%s} contains a variable\n", cid->name);
-		goto done;
+	if (zstr(number)) {
+		return;
 	}
 
-	if (cid && channel) {
-		switch_channel_set_variable(channel, "original_caller_id_name", switch_core_strdup(pool, profile->caller_id_name));
-		if (!zstr(cid->src)) {
-			switch_channel_set_variable(channel, "cidlookup_source", cid->src);
-		}
-		if (!zstr(cid->area)) {
-			switch_channel_set_variable(channel, "cidlookup_area", cid->area);
+	if (async && !switch_channel_test_flag(channel, CF_ANSWERED) && !switch_channel_test_flag(channel, CF_EARLY_MEDIA)) {
+		if (cidlookup_async_start(session, number, skipurl, skipcitystate) == SWITCH_STATUS_SUCCESS) {
+			return;
 		}
-		profile->caller_id_name = switch_core_strdup(profile->pool, cid->name);;
 	}
 
+	switch_event_create(&event, SWITCH_EVENT_MESSAGE);
+
+	cid = do_lookup(pool, event, number, skipurl, skipcitystate);
+	cidlookup_set_channel(session, cid);
 
-  done:
 	if (event) {
 		switch_event_destroy(&event);
 	}
-	if (!session && pool) {
-		switch_core_destroy_memory_pool(&pool);
+}
+
+SWITCH_STANDARD_APP(cidlookup_wait_app_function)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	cid_async_t *async;
+	int timeout = globals.async_timeout;
+
+	if (!zstr(data)) {
+		timeout = atoi(data);
+	}
+
+	if ((async = switch_channel_get_private(channel, CIDLOOKUP_ASYNC_PRIVATE))) {
+		cidlookup_async_wait(session, async, timeout);
 	}
 }
 
@@ -770,6 +1135,23 @@ SWITCH_STANDARD_API(cidlookup_function)
 								   globals.sql ? globals.sql : "(null)", globals.citystate_sql ? globals.citystate_sql : "(null)");
 			stream->write_function(stream, " ODBC Compiled: %s\n", switch_odbc_available()? "true" : "false");
 
+			switch_mutex_lock(globals.cache_mutex);
+			stream->write_function(stream, " memory-cache: %s\n memory-cache-size: %d\n negative-cache-expire: %d\n",
+								   globals.memory_cache ? "true" : "false", globals.memory_cache_size, globals.negative_cache_expire);
+			stream->write_function(stream, " memory-cache-entries: %d\n memory-cache-hits: %" SWITCH_UINT64_T_FMT "\n memory-cache-misses: %"
+								   SWITCH_UINT64_T_FMT "\n", globals.cache_count, globals.cache_hits, globals.cache_misses);
+			switch_mutex_unlock(globals.cache_mutex);
+
+			switch_mutex_lock(globals.async_mutex);
+			stream->write_function(stream, " async-timeout: %d\n async-lookups: %d\n", globals.async_timeout, globals.async_threads);
+			switch_mutex_unlock(globals.async_mutex);
+
+			switch_goto_status(SWITCH_STATUS_SUCCESS, done);
+		}
+
+		if (!strcmp("flush", argv[0])) {
+			memory_cache_flush();
+			stream->write_function(stream, "+OK\n");
 			switch_goto_status(SWITCH_STATUS_SUCCESS, done);
 		}
 		for (i = 1; i < argc; i++) {
@@ -826,6 +1208,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cidlookup_load)
 
 	globals.pool = pool;
 
+	switch_mutex_init(&globals.cache_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_mutex_init(&globals.async_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_core_hash_init(&globals.cache_hash, globals.pool);
+
 	do_config(SWITCH_FALSE);
 
 	if ((switch_event_bind_removable(modname, SWITCH_EVENT_RELOADXML, NULL, event_handler, NULL, &reload_xml_event) != SWITCH_STATUS_SUCCESS)) {
@@ -835,7 +1221,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cidlookup_load)
 
 	SWITCH_ADD_API(api_interface, "cidlookup", "cidlookup API", cidlookup_function, SYNTAX);
 	SWITCH_ADD_APP(app_interface, "cidlookup", "Perform a CID lookup", "Perform a CID lookup",
-				   cidlookup_app_function, "[number [skipurl]]", SAF_SUPPORT_NOMEDIA | SAF_ROUTING_EXEC);
+				   cidlookup_app_function, "[number [skipurl] [skipcitystate] [async]]", SAF_SUPPORT_NOMEDIA | SAF_ROUTING_EXEC);
+	SWITCH_ADD_APP(app_interface, "cidlookup_wait", "Wait for an async CID lookup", "Wait for an async CID lookup and apply it",
+				   cidlookup_wait_app_function, "[timeout_ms]", SAF_SUPPORT_NOMEDIA | SAF_ROUTING_EXEC);
 
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
@@ -847,6 +1235,24 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cidlookup_load)
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_cidlookup_shutdown)
 {
 	switch_event_unbind(&reload_xml_event);
+
+	/* async lookups are bounded by curl-timeout, let them finish with their sessions */
+	for (;;) {
+		int running;
+
+		switch_mutex_lock(globals.async_mutex);
+		running = globals.async_threads;
+		switch_mutex_unlock(globals.async_mutex);
+
+		if (!running) {
+			break;
+		}
+		switch_yield(100000);
+	}
+
+	memory_cache_flush();
+	switch_core_hash_destroy(&globals.cache_hash);
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
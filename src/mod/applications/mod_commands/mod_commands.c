@@ -337,6 +337,14 @@ SWITCH_STANDARD_API(host_lookup_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_STANDARD_API(flush_dns_cache_function)
+{
+	switch_resolve_cache_flush(zstr(cmd) ? NULL : cmd);
+	stream->write_function(stream, "+OK\n");
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_API(nat_map_function)
 {
 	int argc;
@@ -1763,6 +1771,15 @@ SWITCH_STANDARD_API(status_function)
 	stream->write_function(stream, "%d session(s) %d/%d\n", switch_core_session_count(), last_sps, sps);
 	stream->write_function(stream, "%d session(s) max\n", switch_core_session_limit(0));
 	stream->write_function(stream, "min idle cpu %0.2f/%0.2f\n", switch_core_min_idle_cpu(-1.0), switch_core_idle_cpu());
+	if (switch_core_max_component_load(-1)) {
+		char name[64] = "";
+		uint32_t load = switch_core_component_load(name, sizeof(name));
+
+		stream->write_function(stream, "max component load %d/%u (%s)\n", switch_core_max_component_load(-1), load, zstr(name) ? "none" : name);
+		if (!html) {
+			switch_core_load_sources_status(stream);
+		}
+	}
 
 	if (html) {
 		stream->write_function(stream, "</b>\n");
@@ -1783,6 +1800,102 @@ SWITCH_STANDARD_API(status_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_STANDARD_API(rtp_reactor_status_function)
+{
+	switch_rtp_reactor_stats_t stats[64];
+	uint32_t i, count;
+
+	count = switch_rtp_get_reactor_stats(stats, sizeof(stats) / sizeof(stats[0]));
+
+	if (!count) {
+		stream->write_function(stream, "RTP reactor is not running\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	stream->write_function(stream, "%-8s %-10s %-12s %-14s %-10s %-14s %-10s %-12s %-10s %-12s %s\n", "reactor", "sessions", "wakeups", "packets", "dropped",
+						   "relayed", "max_batch", "pkts/wakeup", "rtcp", "rtcp_in", "rtcp_out");
+
+	for (i = 0; i < count; i++) {
+		stream->write_function(stream, "%-8u %-10u %-12" SWITCH_SIZE_T_FMT " %-14" SWITCH_SIZE_T_FMT " %-10" SWITCH_SIZE_T_FMT " %-14" SWITCH_SIZE_T_FMT
+							   " %-10u %-12.2f %-10u %-12" SWITCH_SIZE_T_FMT " %" SWITCH_SIZE_T_FMT "\n",
+							   i, stats[i].sessions, stats[i].wakeups, stats[i].packets, stats[i].dropped, stats[i].relayed, stats[i].max_batch,
+							   stats[i].wakeups ? (double) stats[i].packets / stats[i].wakeups : 0.0,
+							   stats[i].rtcp_sessions, stats[i].rtcp_received, stats[i].rtcp_sent);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define SLN_KERNEL_SYNTAX "[scalar|sse2|avx2|neon|bench [<members>] [<loops>]]"
+SWITCH_STANDARD_API(sln_kernel_function)
+{
+	char *mydata = NULL, *argv[3] = { 0 };
+	int argc = 0;
+
+	if (!zstr(cmd) && (mydata = strdup(cmd))) {
+		argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+	}
+
+	if (!argc) {
+		stream->write_function(stream, "%s\n", switch_sln_kernel_name());
+	} else if (!strcasecmp(argv[0], "bench")) {
+		/* one conference tick: sum every member into the mix then build each member's mix minus itself */
+		const char *kernels[] = { "scalar", "sse2", "avx2", "neon", NULL };
+		char *active = strdup(switch_sln_kernel_name());
+		uint32_t members = argv[1] ? atoi(argv[1]) : 200;
+		uint32_t loops = argv[2] ? atoi(argv[2]) : 1000;
+		uint32_t samples = 320;	/* 20ms at 16khz */
+		int32_t acc[320];
+		int16_t out[320];
+		int16_t *frames;
+		uint32_t i, m, l;
+
+		if (!members) members = 1;
+		if (!loops) loops = 1;
+
+		switch_zmalloc(frames, members * samples * sizeof(int16_t));
+
+		for (i = 0; i < members * samples; i++) {
+			frames[i] = (int16_t) ((rand() % 8192) - 4096);
+		}
+
+		stream->write_function(stream, "%u members, %u samples, %u loops\n", members, samples, loops);
+
+		for (i = 0; kernels[i]; i++) {
+			switch_time_t start;
+
+			if (switch_sln_kernel_set(kernels[i]) != SWITCH_STATUS_SUCCESS) {
+				continue;
+			}
+
+			start = switch_time_now();
+
+			for (l = 0; l < loops; l++) {
+				memset(acc, 0, sizeof(acc));
+				for (m = 0; m < members; m++) {
+					switch_sln_accumulate(acc, frames + (m * samples), samples);
+				}
+				for (m = 0; m < members; m++) {
+					switch_sln_mix_out(out, acc, frames + (m * samples), samples, samples);
+				}
+			}
+
+			stream->write_function(stream, "%-8s %0.2f usec/tick\n", kernels[i], (double) (switch_time_now() - start) / loops);
+		}
+
+		switch_sln_kernel_set(active);
+		free(active);
+		free(frames);
+	} else if (switch_sln_kernel_set(argv[0]) == SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "+OK %s\n", switch_sln_kernel_name());
+	} else {
+		stream->write_function(stream, "-ERR %s is not available\n", argv[0]);
+	}
+
+	switch_safe_free(mydata);
+	return SWITCH_STATUS_SUCCESS;
+}
+
 #define CTL_SYNTAX "[send_sighup|hupall|pause [inbound|outbound]|resume [inbound|outbound]|shutdown [cancel|elegant|asap|now|restart]|sps|sync_clock|sync_clock_when_idle|reclaim_mem|max_sessions|min_dtmf_duration [num]|max_dtmf_duration [num]|default_dtmf_duration [num]|min_idle_cpu|loglevel [level]|debug_level [level]]"
 SWITCH_STANDARD_API(ctl_function)
 {
@@ -2149,11 +2262,24 @@ SWITCH_STANDARD_API(reload_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#define RELOAD_XML_SYNTAX "[changed|section <name>[,<name>]|file <path>]"
 SWITCH_STANDARD_API(reload_xml_function)
 {
 	const char *err = "";
 
-	switch_xml_reload(&err);
+	if (zstr(cmd)) {
+		switch_xml_reload(&err);
+	} else if (!strcasecmp(cmd, "changed")) {
+		switch_xml_reload_sections(NULL, &err);
+	} else if (!strncasecmp(cmd, "section ", 8) && !zstr(cmd + 8)) {
+		switch_xml_reload_sections(cmd + 8, &err);
+	} else if (!strncasecmp(cmd, "file ", 5) && !zstr(cmd + 5)) {
+		switch_xml_reload_sections(cmd + 5, &err);
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", RELOAD_XML_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	stream->write_function(stream, "+OK [%s]\n", err);
 
 	return SWITCH_STATUS_SUCCESS;
@@ -4041,26 +4167,45 @@ SWITCH_STANDARD_API(alias_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
-#define SHOW_SYNTAX "codec|endpoint|application|api|dialplan|file|timer|calls [count]|channels [count|like <match string>]|calls|detailed_calls|bridged_calls|detailed_bridged_calls|aliases|complete|chat|management|modules|nat_map|say|interfaces|interface_types|tasks|limits"
+#define SHOW_SYNTAX "codec|endpoint|application|api|dialplan|file|timer|calls [count]|channels [count|like <match string>]|calls|detailed_calls|bridged_calls|detailed_bridged_calls|aliases|complete|chat|management|modules|nat_map|say|interfaces|interface_types|tasks|limits|event_stats|regex_stats"
 SWITCH_STANDARD_API(show_function)
 {
 	char sql[1024];
-	char *errmsg;
-	switch_cache_db_handle_t *db;
+	char *errmsg = NULL;
+	switch_cache_db_handle_t *db = NULL;
 	struct holder holder = { 0 };
 	int help = 0;
+	/* channels and calls come from the core's in memory store when it is running */
+	int store = 0, use_store = 0;
+	const char *store_like = NULL;
 	char *mydata = NULL, *argv[6] = { 0 };
 	char *command = NULL, *as = NULL;
 	switch_core_flag_t cflags = switch_core_flags();
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
     const char *hostname = switch_core_get_switchname();
 
-	if (!(cflags & SCF_USE_SQL)) {
+	/* kept in memory by the event system, no database involved */
+	if (cmd && !strcasecmp(cmd, "event_stats")) {
+		switch_event_stats(stream);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (cmd && !strcasecmp(cmd, "regex_stats")) {
+		switch_regex_cache_stats(stream);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (cmd && switch_core_channel_store_running() &&
+		((!strncasecmp(cmd, "channels", 8) && (!cmd[8] || cmd[8] == ' ')) || (!strncasecmp(cmd, "calls", 5) && (!cmd[5] || cmd[5] == ' ')))) {
+		store = 1;
+	}
+
+	if (!store && !(cflags & SCF_USE_SQL)) {
 		stream->write_function(stream, "-ERR SQL DISABLED NO DATA AVAILABLE!\n");
 		return SWITCH_STATUS_SUCCESS;
 	}
 
-	if (switch_core_db_handle(&db) != SWITCH_STATUS_SUCCESS) {
+	if (!store && switch_core_db_handle(&db) != SWITCH_STATUS_SUCCESS) {
 		stream->write_function(stream, "%s", "-ERR Databse Error!\n");
 		return SWITCH_STATUS_SUCCESS;
 	}
@@ -4131,6 +4276,9 @@ SWITCH_STANDARD_API(show_function)
 		}
 	} else if (!strcasecmp(command, "calls")) {
 		sprintf(sql, "select * from basic_calls where hostname='%s' order by call_created_epoch", hostname);
+		if (store) {
+			use_store = 2;
+		}
 		if (argv[1] && !strcasecmp(argv[1], "count")) {
 			holder.justcount = 1;
 			if (argv[3] && !strcasecmp(argv[2], "as")) {
@@ -4164,14 +4312,22 @@ SWITCH_STANDARD_API(show_function)
 
 			}
 
+			store_like = argv[2];
+
 			if (argv[4] && !strcasecmp(argv[3], "as")) {
 				as = argv[4];
 			}
 		} else {
 			sprintf(sql, "select * from channels where hostname='%s' order by created_epoch", hostname);
 		}
+		if (store) {
+			use_store = 1;
+		}
 	} else if (!strcasecmp(command, "channels")) {
 		sprintf(sql, "select * from channels where hostname='%s' order by created_epoch", hostname);
+		if (store) {
+			use_store = 1;
+		}
 		if (argv[1] && !strcasecmp(argv[1], "count")) {
 			holder.justcount = 1;
 			if (argv[3] && !strcasecmp(argv[2], "as")) {
@@ -4242,7 +4398,11 @@ SWITCH_STANDARD_API(show_function)
 				holder.delim = ",";
 			}
 		}
-		switch_cache_db_execute_sql_callback(db, sql, show_callback, &holder, &errmsg);
+		if (use_store) {
+			switch_core_channel_store_walk(use_store == 2, store_like, show_callback, &holder);
+		} else {
+			switch_cache_db_execute_sql_callback(db, sql, show_callback, &holder, &errmsg);
+		}
 		if (holder.http) {
 			holder.stream->write_function(holder.stream, "</table>");
 		}
@@ -4258,7 +4418,11 @@ SWITCH_STANDARD_API(show_function)
 			stream->write_function(stream, "\n%u total.\n", holder.count);
 		}
 	} else if (!strcasecmp(as, "xml")) {
-		switch_cache_db_execute_sql_callback(db, sql, show_as_xml_callback, &holder, &errmsg);
+		if (use_store) {
+			switch_core_channel_store_walk(use_store == 2, store_like, show_as_xml_callback, &holder);
+		} else {
+			switch_cache_db_execute_sql_callback(db, sql, show_as_xml_callback, &holder, &errmsg);
+		}
 
 		if (errmsg) {
 			stream->write_function(stream, "-ERR SQL Error [%s]\n", errmsg);
@@ -4709,6 +4873,143 @@ SWITCH_STANDARD_API(uuid_recv_dtmf_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#define UUID_TRACE_SYNTAX "<uuid>"
+SWITCH_STANDARD_API(uuid_trace_function)
+{
+	switch_core_session_t *psession = NULL;
+
+	if (zstr(cmd)) {
+		stream->write_function(stream, "-USAGE: %s\n", UUID_TRACE_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!(psession = switch_core_session_locate(cmd))) {
+		stream->write_function(stream, "-ERR No Such Channel!\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (switch_core_session_trace_dump(psession, stream) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR Session tracing is disabled\n");
+	}
+
+	switch_core_session_rwunlock(psession);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_STANDARD_API(slab_stats_function)
+{
+	switch_slab_stats(stream);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define PROMPT_CACHE_SYNTAX "[stats|flush]"
+SWITCH_STANDARD_API(prompt_cache_function)
+{
+	if (!zstr(cmd) && !strcasecmp(cmd, "flush")) {
+		switch_core_file_cache_flush();
+		stream->write_function(stream, "+OK\n");
+	} else if (zstr(cmd) || !strcasecmp(cmd, "stats")) {
+		switch_core_file_cache_stats(stream);
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", PROMPT_CACHE_SYNTAX);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_STANDARD_API(file_io_stats_function)
+{
+	switch_core_file_io_stats(stream);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_STANDARD_API(codec_offload_stats_function)
+{
+	switch_core_codec_offload_stats(stream);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define POOL_STATS_SYNTAX "[<top>]"
+SWITCH_STANDARD_API(pool_stats_function)
+{
+	switch_core_memory_pool_stats(stream, zstr(cmd) ? 20 : atoi(cmd));
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_STANDARD_API(metrics_function)
+{
+	switch_metrics_expose(stream);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define PREFIX_LOOKUP_SYNTAX "[<table> <number>]"
+SWITCH_STANDARD_API(prefix_lookup_function)
+{
+	char *mydata = NULL, *argv[2] = { 0 };
+	char value[1024] = "";
+	switch_size_t matched = 0;
+	switch_status_t status;
+
+	if (zstr(cmd)) {
+		switch_prefix_tables_dump(stream);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	mydata = strdup(cmd);
+	switch_assert(mydata);
+
+	if (switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0]))) < 2) {
+		stream->write_function(stream, "-USAGE: %s\n", PREFIX_LOOKUP_SYNTAX);
+		goto done;
+	}
+
+	if ((status = switch_prefix_lookup(argv[0], argv[1], value, sizeof(value), &matched)) == SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "%s\n", value);
+	} else if (status == SWITCH_STATUS_NOTFOUND) {
+		stream->write_function(stream, "-ERR no match\n");
+	} else {
+		stream->write_function(stream, "-ERR no such table %s\n", argv[0]);
+	}
+
+  done:
+	switch_safe_free(mydata);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define STATE_SNAPSHOT_SYNTAX "[save]"
+SWITCH_STANDARD_API(state_snapshot_function)
+{
+	if (zstr(cmd)) {
+		switch_snapshot_dump(stream);
+	} else if (!strcasecmp(cmd, "save")) {
+		if (switch_snapshot_save() == SWITCH_STATUS_SUCCESS) {
+			stream->write_function(stream, "+OK\n");
+		} else {
+			stream->write_function(stream, "-ERR state snapshot is disabled or could not be written\n");
+		}
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", STATE_SNAPSHOT_SYNTAX);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_STANDARD_API(reload_prefix_function)
+{
+	const char *err;
+
+	if (switch_xml_reload(&err) == SWITCH_STATUS_SUCCESS) {
+		switch_load_prefix_tables(SWITCH_TRUE);
+		stream->write_function(stream, "+OK prefix tables reloaded\n");
+	} else {
+		stream->write_function(stream, "-Error [%s]\n", err);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 #define DUMP_SYNTAX "<uuid> [format]"
 SWITCH_STANDARD_API(uuid_dump_function)
 {
@@ -4957,6 +5258,91 @@ SWITCH_STANDARD_API(xml_flush_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#define XML_PARSE_BENCH_SYNTAX "<file> [<loops>]"
+SWITCH_STANDARD_API(xml_parse_bench_function)
+{
+	char *mycmd = NULL, *argv[2] = { 0 };
+	int argc = 0;
+	FILE *fp = NULL;
+	char *data = NULL;
+	long size;
+	uint32_t loops, i, mode;
+
+	if (!zstr(cmd) && (mycmd = strdup(cmd))) {
+		argc = switch_separate_string(mycmd, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+	}
+
+	if (!argc) {
+		stream->write_function(stream, "-USAGE: %s\n", XML_PARSE_BENCH_SYNTAX);
+		goto end;
+	}
+
+	loops = argv[1] ? atoi(argv[1]) : 10000;
+	if (!loops) loops = 1;
+
+	if (!(fp = fopen(argv[0], "rb")) || fseek(fp, 0, SEEK_END) || (size = ftell(fp)) <= 0 || fseek(fp, 0, SEEK_SET)) {
+		stream->write_function(stream, "-ERR Cannot read %s\n", argv[0]);
+		goto end;
+	}
+
+	switch_zmalloc(data, size + 1);
+	if (fread(data, 1, size, fp) != (size_t) size) {
+		stream->write_function(stream, "-ERR Cannot read %s\n", argv[0]);
+		goto end;
+	}
+
+	stream->write_function(stream, "%ld bytes, %u loops\n", size, loops);
+
+	/* the same copy, parse and free a fetch response goes through, once per mode */
+	for (mode = 0; mode < 2; mode++) {
+		switch_time_t start = switch_time_now();
+
+		for (i = 0; i < loops; i++) {
+			switch_xml_t xml = mode ? switch_xml_parse_str_arena(data, SWITCH_TRUE) : switch_xml_parse_str_dynamic(data, SWITCH_TRUE);
+
+			if (!xml) {
+				stream->write_function(stream, "-ERR Parse failed\n");
+				goto end;
+			}
+			switch_xml_free(xml);
+		}
+
+		stream->write_function(stream, "%-8s %0.2f usec/parse\n", mode ? "arena" : "dynamic", (double) (switch_time_now() - start) / loops);
+	}
+
+  end:
+	if (fp) {
+		fclose(fp);
+	}
+	switch_safe_free(data);
+	switch_safe_free(mycmd);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define XML_FETCH_CACHE_SYNTAX "[stats|flush [<section> [<key_value>]]]"
+SWITCH_STANDARD_API(xml_fetch_cache_function)
+{
+	char *mycmd = NULL, *argv[3] = { 0 };
+	int argc = 0;
+	uint32_t r;
+
+	if (!zstr(cmd) && (mycmd = strdup(cmd))) {
+		argc = switch_split(mycmd, ' ', argv);
+	}
+
+	if (argc == 0 || !strcasecmp(argv[0], "stats")) {
+		switch_xml_fetch_cache_stats(stream);
+	} else if (!strcasecmp(argv[0], "flush")) {
+		r = switch_xml_clear_fetch_cache(argv[1], argv[2]);
+		stream->write_function(stream, "+OK cleared %u entr%s\n", r, r == 1 ? "y" : "ies");
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", XML_FETCH_CACHE_SYNTAX);
+	}
+
+	switch_safe_free(mycmd);
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_API(escape_function)
 {
 	int len;
@@ -5411,6 +5797,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "group_call", "Generate a dial string to call a group", group_call_function, "<group>[@<domain>]");
 	SWITCH_ADD_API(commands_api_interface, "help", "Show help for all the api commands", help_function, "");
 	SWITCH_ADD_API(commands_api_interface, "host_lookup", "host_lookup", host_lookup_function, "<hostname>");
+	SWITCH_ADD_API(commands_api_interface, "flush_dns_cache", "Flush the core DNS cache", flush_dns_cache_function, "[<hostname>]");
 	SWITCH_ADD_API(commands_api_interface, "hostname", "Returns the system hostname", hostname_api_function, "");
 	SWITCH_ADD_API(commands_api_interface, "switchname", "Returns the switch name", switchname_api_function, "");
 	SWITCH_ADD_API(commands_api_interface, "hupall", "hupall", hupall_api_function, "<cause> [<var> <value>]");
@@ -5424,6 +5811,15 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "load", "Load Module", load_function, LOAD_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "log", "Log", log_function, LOG_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "md5", "md5", md5_function, "<data>");
+	SWITCH_ADD_API(commands_api_interface, "metrics", "Show metrics in the Prometheus text format", metrics_function, "");
+	SWITCH_ADD_API(commands_api_interface, "prefix_lookup", "Longest prefix match in a prefix.conf table", prefix_lookup_function, PREFIX_LOOKUP_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "reloadprefix", "Reload prefix tables", reload_prefix_function, "");
+	SWITCH_ADD_API(commands_api_interface, "state_snapshot", "Show the state snapshot owners or save one now", state_snapshot_function, STATE_SNAPSHOT_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "slab_stats", "Show slab cache usage", slab_stats_function, "");
+	SWITCH_ADD_API(commands_api_interface, "prompt_cache", "Show or flush the decoded prompt cache", prompt_cache_function, PROMPT_CACHE_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "file_io_stats", "Show async file I/O counters", file_io_stats_function, "");
+	SWITCH_ADD_API(commands_api_interface, "codec_offload_stats", "Show codec offload counters", codec_offload_stats_function, "");
+	SWITCH_ADD_API(commands_api_interface, "pool_stats", "Show the memory pool tags holding the most memory", pool_stats_function, POOL_STATS_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "module_exists", "check if module exists", module_exists_function, "<module>");
 	SWITCH_ADD_API(commands_api_interface, "msleep", "sleep N milliseconds", msleep_function, "<milliseconds>");
 	SWITCH_ADD_API(commands_api_interface, "nat_map", "nat_map", nat_map_function, "[status|republish|reinit] | [add|del] <port> [tcp|udp] [static]");
@@ -5432,8 +5828,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "regex", "Eval a regex", regex_function, "<data>|<pattern>[|<subst string>]");
 	SWITCH_ADD_API(commands_api_interface, "reloadacl", "Reload ACL", reload_acl_function, "");
 	SWITCH_ADD_API(commands_api_interface, "reload", "Reload Module", reload_function, UNLOAD_SYNTAX);
-	SWITCH_ADD_API(commands_api_interface, "reloadxml", "Reload XML", reload_xml_function, "");
+	SWITCH_ADD_API(commands_api_interface, "reloadxml", "Reload XML", reload_xml_function, RELOAD_XML_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "replace", "replace a string", replace_function, "<data>|<string1>|<string2>");
+	SWITCH_ADD_API(commands_api_interface, "rtp_reactor_status", "Show RTP reactor counters", rtp_reactor_status_function, "");
+	SWITCH_ADD_API(commands_api_interface, "sln_kernel", "Show, set or benchmark the audio mixing kernel", sln_kernel_function, SLN_KERNEL_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "say_string", "", say_string_function, SAY_STRING_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "sched_api", "Schedule an api command", sched_api_function, SCHED_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "sched_broadcast", "Schedule a broadcast event to a running call", sched_broadcast_function,
@@ -5468,6 +5866,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "uuid_displace", "session displace", session_displace_function, "<uuid> [start|stop] <path> [<limit>] [mux]");
 	SWITCH_ADD_API(commands_api_interface, "uuid_display", "change display", uuid_display_function, DISPLAY_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "uuid_dump", "uuid_dump", uuid_dump_function, DUMP_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "uuid_trace", "Show the session trace ring", uuid_trace_function, UUID_TRACE_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "uuid_exists", "see if a uuid exists", uuid_exists_function, EXISTS_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "uuid_fileman", "uuid_fileman", uuid_fileman_function, FILEMAN_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "uuid_flush_dtmf", "Flush dtmf on a given uuid", uuid_flush_dtmf_function, "<uuid>");
@@ -5498,6 +5897,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 				   uuid_jitterbuffer_function, JITTERBUFFER_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "uuid_zombie_exec", "Set zombie_exec flag on the specified uuid", uuid_zombie_exec_function, "<uuid>");
 	SWITCH_ADD_API(commands_api_interface, "xml_flush_cache", "clear xml cache", xml_flush_function, "<id> <key> <val>");
+	SWITCH_ADD_API(commands_api_interface, "xml_parse_bench", "Compare the xml parser modes on a file", xml_parse_bench_function, XML_PARSE_BENCH_SYNTAX);
+	SWITCH_ADD_API(commands_api_interface, "xml_fetch_cache", "xml binding fetch cache", xml_fetch_cache_function, XML_FETCH_CACHE_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "xml_locate", "find some xml", xml_locate_function, "[root | <section> <tag> <tag_attr_name> <tag_attr_val>]");
 	SWITCH_ADD_API(commands_api_interface, "xml_wrap", "Wrap another api command in xml", xml_wrap_api_function, "<command> <args>");
 	SWITCH_ADD_API(commands_api_interface, "file_exists", "check if a file exists on server", file_exists_function, "<file>");
@@ -5562,6 +5963,11 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	switch_console_set_complete("add nat_map status");
 	switch_console_set_complete("add reload ::console::list_loaded_modules");
 	switch_console_set_complete("add reloadacl reloadxml");
+	switch_console_set_complete("add reloadprefix");
+	switch_console_set_complete("add state_snapshot save");
+	switch_console_set_complete("add reloadxml changed");
+	switch_console_set_complete("add reloadxml section");
+	switch_console_set_complete("add reloadxml file");
 	switch_console_set_complete("add show aliases");
 	switch_console_set_complete("add show api");
 	switch_console_set_complete("add show application");
@@ -5605,6 +6011,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	switch_console_set_complete("add uuid_displace ::console::list_uuid");
 	switch_console_set_complete("add uuid_display ::console::list_uuid");
 	switch_console_set_complete("add uuid_dump ::console::list_uuid");
+	switch_console_set_complete("add uuid_trace ::console::list_uuid");
 	switch_console_set_complete("add uuid_exists ::console::list_uuid");
 	switch_console_set_complete("add uuid_fileman ::console::list_uuid");
 	switch_console_set_complete("add uuid_flush_dtmf ::console::list_uuid");
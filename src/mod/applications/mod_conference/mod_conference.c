@@ -86,7 +86,13 @@ static int EC = 0;
 #define CONF_DBLOCK_SIZE CONF_BUFFER_SIZE
 #define CONF_DBUFFER_SIZE CONF_BUFFER_SIZE
 #define CONF_DBUFFER_MAX 0
+#define CONF_RING_SIZE CONF_BUFFER_SIZE
 #define CONF_CHAT_PROTO "conf"
+#define CONF_CASCADE_PRIVATE "_conference_cascade_"
+#define CONF_CASCADE_MAGIC 0xFC
+#define CONF_CASCADE_VERSION 1
+#define CONF_CASCADE_MAX_PACKET 4096
+#define CONF_CASCADE_META_EVERY 50
 
 #ifndef MIN
 #define MIN(a, b) ((a)<(b)?(a):(b))
@@ -96,6 +102,12 @@ static int EC = 0;
 #define SCORE_DECAY 0.8
 /* the maximum value for the IIR score [keeps loud & longwinded people from getting overweighted] */
 #define SCORE_MAX_IIR 25000
+/* conference_member_t.vad: the input thread's verdict on its last frame, energy score in the low bits */
+#define CONF_VAD_TALKING (1U << 31)
+/* upper bound for max-active-speakers */
+#define CONF_MAX_ACTIVE_SPEAKERS 64
+/* mixer ticks a speaker stays in the mix after dropping out of the loudest set */
+#define CONF_TOPN_HOLD 25
 /* the minimum score for which you can be considered to be loud enough to now have the floor */
 #define SCORE_IIR_SPEAKING_MAX 300
 /* the threshold below which you cede the floor to someone loud (see above value). */
@@ -170,7 +182,10 @@ typedef enum {
 	MFLAG_INDICATE_UNMUTE = (1 << 18),
 	MFLAG_NOMOH = (1 << 19),
 	MFLAG_VIDEO_BRIDGE = (1 << 20),
-	MFLAG_INDICATE_MUTE_DETECT = (1 << 21)
+	MFLAG_INDICATE_MUTE_DETECT = (1 << 21),
+	MFLAG_SHARED_ENCODE = (1 << 22),
+	MFLAG_CASCADE = (1 << 23),
+	MFLAG_CASCADE_RELAY = (1 << 24)
 } member_flag_t;
 
 typedef enum {
@@ -190,7 +205,8 @@ typedef enum {
 	CFLAG_ENTER_SOUND = (1 << 13),
 	CFLAG_VIDEO_BRIDGE = (1 << 14),
 	CFLAG_AUDIO_ALWAYS = (1 << 15),
-	CFLAG_ENDCONF_FORCED = (1 << 16)
+	CFLAG_ENDCONF_FORCED = (1 << 16),
+	CFLAG_SHARED_ENCODE = (1 << 17)
 } conf_flag_t;
 
 typedef enum {
@@ -306,6 +322,7 @@ typedef struct conference_obj {
 	uint32_t interval;
 	switch_mutex_t *mutex;
 	conference_member_t *members;
+	struct conference_member_snapshot *member_snapshot;
 	conference_member_t *floor_holder;
 	switch_mutex_t *member_mutex;
 	conference_file_node_t *fnode;
@@ -334,6 +351,29 @@ typedef struct conference_obj {
 	int endconf_grace_time;
 
 	uint32_t relationship_total;
+	/* oldest input arrival in the current mix and the runner up, a member does not hear itself */
+	conference_member_t *ingress_member;
+	switch_time_t ingress_oldest;
+	switch_time_t ingress_next;
+	uint32_t mix_threads;
+	uint32_t mix_thread_threshold;
+	/* only mix the loudest max_active_speakers members, 0 mixes everyone */
+	uint32_t max_active_speakers;
+	struct conference_mix_pool *mix_pool;
+	uint32_t mix_tick;
+	struct conference_encode_group *encode_groups;
+	switch_mutex_t *encode_mutex;
+	/* cascade links to other nodes, with more than one link they hear only the local members: main mix minus every link */
+	uint32_t cascade_count;
+	int32_t *cascade_frame;
+	int cascade_mix;
+	/* video fan-out workers, see conference_video_fanout_dispatch() */
+	uint32_t video_fanout_threads;
+	uint32_t video_fanout_threshold;
+	struct conference_video_fanout *video_fanout;
+	struct conference_video_targets *video_targets;
+	switch_time_t video_refresh_last;
+	int video_refresh_pending;
 	uint32_t score;
 	int mux_loop_count;
 	int member_loop_count;
@@ -348,6 +388,8 @@ typedef struct conference_obj {
 	switch_call_cause_t cancel_cause;
 	conference_cdr_node_t *cdr_nodes;
 	conference_cdr_reject_t *cdr_rejected;
+	/* recordings fed from the mix by the conference thread, under conference->mutex */
+	struct conference_record *records;
 	switch_time_t start_time;
 	switch_time_t end_time;
 	char *log_dir;
@@ -355,6 +397,89 @@ typedef struct conference_obj {
 	struct vid_helper mh;
 } conference_obj_t;
 
+/* Contiguous copy of the member list for the mixer, only rebuilt on join/leave while both conference->mutex and member_mutex are held.
+   The mixer holds conference->mutex for a whole tick so it never sees a snapshot being replaced. */
+typedef struct conference_member_snapshot {
+	uint32_t count;
+	conference_member_t *members[1];
+} conference_member_snapshot_t;
+
+/* Muted listeners using the same codec all hear the same mix, a group encodes that mix once per tick for all of them */
+typedef struct conference_encode_group {
+	const switch_codec_implementation_t *impl;
+	int32_t volume_out_level;
+	switch_codec_t codec;
+	switch_mutex_t *mutex;
+	uint32_t tick;
+	uint32_t datalen;
+	uint32_t samples;
+	uint32_t members;
+	int usable;
+	uint8_t data[SWITCH_RECOMMENDED_BUFFER_SIZE];
+	struct conference_encode_group *next;
+} conference_encode_group_t;
+
+typedef struct conference_encode_hdr {
+	conference_encode_group_t *group;
+	uint32_t datalen;
+	uint32_t samples;
+} conference_encode_hdr_t;
+
+typedef struct conference_mix_worker {
+	struct conference_mix_pool *pool;
+	switch_thread_t *thread;
+	uint32_t index;
+} conference_mix_worker_t;
+
+typedef struct conference_mix_pool {
+	conference_obj_t *conference;
+	conference_mix_worker_t *workers;
+	uint32_t threads;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	switch_thread_cond_t *done_cond;
+	conference_member_snapshot_t *snap;
+	int32_t *main_frame;
+	uint32_t bytes;
+	uint32_t generation;
+	uint32_t pending;
+	int running;
+} conference_mix_pool_t;
+
+/* The sessions the floor holder's video goes to, each one read locked until the last packet using the set is written */
+typedef struct conference_video_targets {
+	switch_atomic_t refs;
+	uint32_t count;
+	uint32_t video;
+	struct {
+		switch_core_session_t *session;
+		uint32_t id;
+	} targets[1];
+} conference_video_targets_t;
+
+typedef struct conference_video_packet {
+	switch_atomic_t refs;
+	struct conference_video_fanout *fanout;
+	conference_video_targets_t *targets;
+	switch_frame_t frame;
+} conference_video_packet_t;
+
+typedef struct conference_video_worker {
+	struct conference_video_fanout *fanout;
+	switch_thread_t *thread;
+	switch_queue_t *queue;
+	uint32_t index;
+} conference_video_worker_t;
+
+typedef struct conference_video_fanout {
+	switch_memory_pool_t *pool;
+	conference_video_worker_t *workers;
+	uint32_t threads;
+	switch_atomic_t inflight;
+	switch_atomic_t want_refresh;
+	switch_size_t dropped;
+} conference_video_fanout_t;
+
 /* Relationship with another member */
 typedef struct conference_relationship {
 	uint32_t id;
@@ -368,13 +493,20 @@ struct conference_member {
 	switch_core_session_t *session;
 	conference_obj_t *conference;
 	switch_memory_pool_t *pool;
-	switch_buffer_t *audio_buffer;
-	switch_buffer_t *mux_buffer;
+	switch_ringbuffer_t *audio_buffer;
+	switch_ringbuffer_t *mux_buffer;
+	switch_ringbuffer_t *enc_buffer;
+	const switch_codec_implementation_t *enc_impl;
 	switch_buffer_t *resample_buffer;
 	uint32_t flags;
 	uint32_t score;
 	uint32_t last_score;
 	uint32_t score_iir;
+	switch_atomic_t vad;
+	/* conference thread only: smoothed energy, ticks left in the mix and whether this member is in it */
+	uint32_t topn_energy;
+	uint32_t topn_hold;
+	uint8_t topn_active;
 	switch_mutex_t *flag_mutex;
 	switch_mutex_t *write_mutex;
 	switch_mutex_t *audio_in_mutex;
@@ -393,6 +525,10 @@ struct conference_member {
 	uint32_t frame_size;
 	uint8_t *mux_frame;
 	uint32_t read;
+	/* media-latency-probe: arrival of the newest input, of the input being mixed, and of the oldest input in the queued mix */
+	switch_time_t in_ingress;
+	switch_time_t mix_ingress;
+	switch_time_t out_ingress;
 	uint32_t vol_period;
 	int32_t energy_level;
 	int32_t agc_volume_in_level;
@@ -420,11 +556,69 @@ struct conference_member {
 	char *kicked_sound;
 };
 
-/* Record Node */
+/* A cascade link is a channel to the same conference on another node, each node mixes its own members and the nodes
+   trade one L16 stream per link over UDP.  A small header rides along with the local member count and active speaker. */
+typedef struct conference_cascade_hdr {
+	uint8_t magic;
+	uint8_t version;
+	uint8_t flags;
+	uint8_t meta_len;
+	uint32_t seq;
+	uint16_t members;
+	uint16_t samples;
+} conference_cascade_hdr_t;
+
+typedef enum {
+	CASCADE_FLAG_META = (1 << 0),
+	CASCADE_FLAG_TALKING = (1 << 1)
+} cascade_flag_t;
+
+typedef struct conference_cascade {
+	switch_core_session_t *session;
+	switch_channel_t *channel;
+	conference_member_t *member;
+	switch_mutex_t *mutex;
+	switch_socket_t *sock;
+	switch_sockaddr_t *remote_addr;
+	switch_sockaddr_t *from_addr;
+	switch_codec_t read_codec;
+	switch_codec_t write_codec;
+	switch_timer_t timer;
+	switch_frame_t read_frame;
+	switch_buffer_t *jb;
+	uint32_t jb_max;
+	uint32_t timeout;
+	int relay;
+	uint32_t tx_seq;
+	uint32_t rx_seq;
+	int rx_started;
+	switch_time_t last_rx;
+	conference_member_t *last_floor;
+	uint32_t meta_countdown;
+	uint32_t remote_members;
+	int remote_talking;
+	int speaker_changed;
+	char remote_node[64];
+	char remote_speaker[128];
+	uint32_t rx_packets;
+	uint32_t rx_lost;
+	uint32_t rx_late;
+	uint32_t tx_packets;
+	uint8_t databuf[SWITCH_RECOMMENDED_BUFFER_SIZE];
+	uint8_t pktbuf[CONF_CASCADE_MAX_PACKET];
+} conference_cascade_t;
+
+/* Record Node, the conference thread writes the mix to it at the conference rate, the file I/O threads do the rest.
+   The member is never on the member list, it only carries the path and join time for the cdr. */
 typedef struct conference_record {
 	conference_obj_t *conference;
 	char *path;
 	switch_memory_pool_t *pool;
+	switch_file_handle_t fh;
+	conference_member_t member;
+	uint32_t lead_in;
+	int stop;
+	struct conference_record *next;
 } conference_record_t;
 
 typedef enum {
@@ -455,6 +649,7 @@ static switch_status_t conference_add_member(conference_obj_t *conference, confe
 static switch_status_t conference_del_member(conference_obj_t *conference, conference_member_t *member);
 static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, void *obj);
 static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thread, void *obj);
+static void conference_video_targets_rebuild(conference_obj_t *conference);
 static void conference_loop_output(conference_member_t *member);
 static uint32_t conference_stop_file(conference_obj_t *conference, file_stop_t stop);
 static switch_status_t conference_play_file(conference_obj_t *conference, char *file, uint32_t leadin, switch_channel_t *channel, uint8_t async);
@@ -494,7 +689,9 @@ static conference_obj_t *conference_new(char *name, conf_xml_cfg_t cfg, switch_c
 static switch_status_t chat_send(switch_event_t *message_event);
 								 
 
-static void launch_conference_record_thread(conference_obj_t *conference, char *path);
+static switch_status_t conference_record_start(conference_obj_t *conference, char *path);
+static void conference_record_write(conference_obj_t *conference, int32_t *main_frame, uint32_t bytes);
+static switch_thread_t *launch_thread_detached(switch_thread_start_t func, switch_memory_pool_t *pool, void *data);
 static int launch_conference_video_bridge_thread(conference_member_t *member_a, conference_member_t *member_b);
 static void launch_conference_video_mirror_thread(conference_member_t *member_a);
 
@@ -891,21 +1088,21 @@ static conference_member_t *conference_member_get(conference_obj_t *conference,
 	return member;
 }
 
-/* stop the specified recording */
+/* stop the specified recording, the conference thread closes it on its next tick */
 static switch_status_t conference_record_stop(conference_obj_t *conference, char *path)
 {
-	conference_member_t *member = NULL;
+	conference_record_t *rec;
 	int count = 0;
 
 	switch_assert(conference != NULL);
-	switch_mutex_lock(conference->member_mutex);
-	for (member = conference->members; member; member = member->next) {
-		if (switch_test_flag(member, MFLAG_NOCHANNEL) && (!path || !strcmp(path, member->rec_path))) {
-			switch_clear_flag_locked(member, MFLAG_RUNNING);
+	switch_mutex_lock(conference->mutex);
+	for (rec = conference->records; rec; rec = rec->next) {
+		if (!rec->stop && (!path || !strcmp(path, rec->path))) {
+			rec->stop = 1;
 			count++;
 		}
 	}
-	switch_mutex_unlock(conference->member_mutex);
+	switch_mutex_unlock(conference->mutex);
 	return count;
 }
 
@@ -965,6 +1162,31 @@ static switch_status_t member_del_relationship(conference_member_t *member, uint
 	return status;
 }
 
+/* caller holds conference->mutex and conference->member_mutex */
+static void conference_rebuild_snapshot(conference_obj_t *conference)
+{
+	conference_member_snapshot_t *snap, *old = conference->member_snapshot;
+	conference_member_t *member;
+	uint32_t count = 0;
+
+	for (member = conference->members; member; member = member->next) {
+		count++;
+	}
+
+	switch_zmalloc(snap, sizeof(*snap) + sizeof(conference_member_t *) * count);
+
+	for (member = conference->members; member; member = member->next) {
+		snap->members[snap->count++] = member;
+	}
+
+	conference->member_snapshot = snap;
+	switch_safe_free(old);
+
+	if (conference->video_fanout) {
+		conference_video_targets_rebuild(conference);
+	}
+}
+
 /* Gain exclusive access and add the member to the list */
 static switch_status_t conference_add_member(conference_obj_t *conference, conference_member_t *member)
 {
@@ -974,6 +1196,7 @@ static switch_status_t conference_add_member(conference_obj_t *conference, confe
 	call_list_t *call_list = NULL;
 	switch_channel_t *channel;
 	const char *controls = NULL;
+	conference_cascade_t *cascade;
 
 	switch_assert(conference != NULL);
 	switch_assert(member != NULL);
@@ -992,6 +1215,7 @@ static switch_status_t conference_add_member(conference_obj_t *conference, confe
 	member->score_iir = 0;
 	member->verbose_events = conference->verbose_events;
 	conference->members = member;
+	conference_rebuild_snapshot(conference);
 	switch_set_flag_locked(member, MFLAG_INTREE);
 	switch_mutex_unlock(conference->member_mutex);
 	conference_cdr_add(member);
@@ -1008,6 +1232,21 @@ static switch_status_t conference_add_member(conference_obj_t *conference, confe
 		conference_send_presence(conference);
 
 		channel = switch_core_session_get_channel(member->session);
+
+		if ((cascade = (conference_cascade_t *) switch_channel_get_private(channel, CONF_CASCADE_PRIVATE))) {
+			switch_set_flag_locked(member, MFLAG_CASCADE);
+			if (cascade->relay) {
+				switch_set_flag_locked(member, MFLAG_CASCADE_RELAY);
+			}
+			if (!conference->cascade_frame) {
+				conference->cascade_frame = switch_core_alloc(conference->pool, (SWITCH_RECOMMENDED_BUFFER_SIZE / 2) * sizeof(int32_t));
+			}
+			conference->cascade_count++;
+			switch_mutex_lock(cascade->mutex);
+			cascade->member = member;
+			switch_mutex_unlock(cascade->mutex);
+		}
+
 		switch_channel_set_variable_printf(channel, "conference_member_id", "%d", member->id);
 		switch_channel_set_variable_printf(channel, "conference_moderator", "%s", switch_test_flag(member, MFLAG_MOD) ? "true" : "false");
 		switch_channel_set_variable(channel, "conference_recording", conference->record_filename);
@@ -1168,6 +1407,8 @@ static switch_status_t conference_del_member(conference_obj_t *conference, confe
 		last = imember;
 	}
 
+	conference_rebuild_snapshot(conference);
+
 	switch_thread_rwlock_unlock(member->rwlock);
 	
 	/* Close Unused Handles */
@@ -1212,6 +1453,17 @@ static switch_status_t conference_del_member(conference_obj_t *conference, confe
 	if (!switch_test_flag(member, MFLAG_NOCHANNEL)) {
 		conference->count--;
 
+		if (switch_test_flag(member, MFLAG_CASCADE)) {
+			conference_cascade_t *cascade;
+
+			conference->cascade_count--;
+			if ((cascade = (conference_cascade_t *) switch_channel_get_private(switch_core_session_get_channel(member->session), CONF_CASCADE_PRIVATE))) {
+				switch_mutex_lock(cascade->mutex);
+				cascade->member = NULL;
+				switch_mutex_unlock(cascade->mutex);
+			}
+		}
+
 		if (switch_test_flag(member, MFLAG_ENDCONF)) {
 			if (!--conference->end_count) {
 				//switch_set_flag_locked(conference, CFLAG_DESTRUCT);
@@ -1223,7 +1475,8 @@ static switch_status_t conference_del_member(conference_obj_t *conference, confe
 		conference_send_presence(conference);
 
 		if ((conference->min && switch_test_flag(conference, CFLAG_ENFORCE_MIN) && conference->count < conference->min)
-			|| (switch_test_flag(conference, CFLAG_DYNAMIC) && conference->count == 0)) {
+			|| (switch_test_flag(conference, CFLAG_DYNAMIC) && conference->count == conference->cascade_count)) {
+			/* links to other nodes alone do not keep a dynamic conference up */
 			switch_set_flag(conference, CFLAG_DESTRUCT);
 		} else {
 			if (!exit_sound && conference->exit_sound && switch_test_flag(conference, CFLAG_EXIT_SOUND)) {
@@ -1372,6 +1625,257 @@ static void *SWITCH_THREAD_FUNC conference_video_mirror_thread_run(switch_thread
 
 
 /* Main video monitor thread (1 per distinct conference room) */
+#define CONF_VIDEO_FANOUT_QLEN 128
+#define CONF_VIDEO_REFRESH_INTERVAL 500000
+
+/*
+ * Video fan-out: with video-fanout-threads set and at least video-fanout-threshold members, the video thread copies
+ * each packet read from the floor holder once and queues it to every worker.  A worker writes it to the members whose
+ * id falls in its share, so a session is only ever written from one thread and the rewrite to the receiver's own
+ * ssrc, sequence and timestamp still happens in its RTP stack.  The member list is not touched by the workers, they
+ * use a read locked copy of it which is replaced whenever a member comes or goes.
+ */
+static void conference_video_targets_release(conference_video_targets_t *targets)
+{
+	uint32_t i;
+
+	if (!targets || switch_atomic_dec(&targets->refs)) {
+		return;
+	}
+
+	for (i = 0; i < targets->count; i++) {
+		switch_core_session_rwunlock(targets->targets[i].session);
+	}
+
+	free(targets);
+}
+
+/* caller holds conference->mutex */
+static void conference_video_targets_rebuild(conference_obj_t *conference)
+{
+	conference_video_targets_t *targets = NULL, *old = conference->video_targets;
+	conference_member_t *member;
+	uint32_t count = 0;
+
+	if (conference->video_fanout) {
+		for (member = conference->members; member; member = member->next) {
+			count++;
+		}
+
+		switch_zmalloc(targets, sizeof(*targets) + sizeof(targets->targets[0]) * count);
+		switch_atomic_set(&targets->refs, 1);
+
+		for (member = conference->members; member; member = member->next) {
+			if (member->session && switch_core_session_read_lock(member->session) == SWITCH_STATUS_SUCCESS) {
+				if (switch_channel_test_flag(switch_core_session_get_channel(member->session), CF_VIDEO)) {
+					targets->video++;
+				}
+				targets->targets[targets->count].session = member->session;
+				targets->targets[targets->count].id = member->id;
+				targets->count++;
+			}
+		}
+	}
+
+	conference->video_targets = targets;
+	conference_video_targets_release(old);
+}
+
+static void conference_video_packet_release(conference_video_packet_t *pkt)
+{
+	if (switch_atomic_dec(&pkt->refs)) {
+		return;
+	}
+
+	conference_video_targets_release(pkt->targets);
+	switch_atomic_dec(&pkt->fanout->inflight);
+	free(pkt);
+}
+
+static void *SWITCH_THREAD_FUNC conference_video_worker_run(switch_thread_t *thread, void *obj)
+{
+	conference_video_worker_t *worker = (conference_video_worker_t *) obj;
+	conference_video_fanout_t *fanout = worker->fanout;
+	void *pop = NULL;
+	uint32_t i;
+
+	while (switch_queue_pop(worker->queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		conference_video_packet_t *pkt = (conference_video_packet_t *) pop;
+		conference_video_targets_t *targets = pkt->targets;
+
+		for (i = 0; i < targets->count; i++) {
+			switch_channel_t *channel;
+			switch_frame_t frame;
+
+			if (targets->targets[i].id % fanout->threads != worker->index) {
+				continue;
+			}
+
+			channel = switch_core_session_get_channel(targets->targets[i].session);
+
+			if (switch_channel_test_flag(channel, CF_VIDEO_REFRESH_REQ)) {
+				switch_channel_clear_flag(channel, CF_VIDEO_REFRESH_REQ);
+				switch_atomic_set(&fanout->want_refresh, 1);
+			}
+
+			if (switch_channel_test_flag(channel, CF_VIDEO)) {
+				/* the write path is free to scribble on the frame, the payload is shared */
+				frame = pkt->frame;
+				switch_core_session_write_video_frame(targets->targets[i].session, &frame, SWITCH_IO_FLAG_NONE, 0);
+			}
+		}
+
+		conference_video_packet_release(pkt);
+	}
+
+	return NULL;
+}
+
+static void conference_video_fanout_start(conference_obj_t *conference)
+{
+	conference_video_fanout_t *fanout;
+	switch_memory_pool_t *pool = NULL;
+	switch_threadattr_t *thd_attr = NULL;
+	uint32_t i;
+
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	fanout = switch_core_alloc(pool, sizeof(*fanout));
+	fanout->pool = pool;
+	fanout->threads = conference->video_fanout_threads;
+	fanout->workers = switch_core_alloc(pool, sizeof(conference_video_worker_t) * fanout->threads);
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	for (i = 0; i < fanout->threads; i++) {
+		fanout->workers[i].fanout = fanout;
+		fanout->workers[i].index = i;
+		switch_queue_create(&fanout->workers[i].queue, CONF_VIDEO_FANOUT_QLEN, pool);
+		switch_thread_create(&fanout->workers[i].thread, thd_attr, conference_video_worker_run, &fanout->workers[i], pool);
+	}
+
+	switch_mutex_lock(conference->mutex);
+	conference->video_fanout = fanout;
+	conference_video_targets_rebuild(conference);
+	switch_mutex_unlock(conference->mutex);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Video fan-out started for conference %s with %u threads\n",
+					  conference->name, fanout->threads);
+}
+
+static void conference_video_fanout_stop(conference_obj_t *conference)
+{
+	conference_video_fanout_t *fanout;
+	switch_memory_pool_t *pool;
+	switch_status_t st;
+	uint32_t i;
+
+	switch_mutex_lock(conference->mutex);
+	if ((fanout = conference->video_fanout)) {
+		conference->video_fanout = NULL;
+		conference_video_targets_rebuild(conference);
+	}
+	switch_mutex_unlock(conference->mutex);
+
+	if (!fanout) {
+		return;
+	}
+
+	/* the workers finish what is queued before they see the NULL */
+	for (i = 0; i < fanout->threads; i++) {
+		switch_queue_push(fanout->workers[i].queue, NULL);
+	}
+
+	for (i = 0; i < fanout->threads; i++) {
+		switch_thread_join(&st, fanout->workers[i].thread);
+	}
+
+	if (fanout->dropped) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Video fan-out for conference %s dropped %" SWITCH_SIZE_T_FMT " packets\n",
+						  conference->name, fanout->dropped);
+	}
+
+	pool = fanout->pool;
+	switch_core_destroy_memory_pool(&pool);
+}
+
+/* caller holds conference->mutex, returns the number of members that take video */
+static uint32_t conference_video_fanout_dispatch(conference_obj_t *conference, switch_frame_t *frame)
+{
+	conference_video_fanout_t *fanout = conference->video_fanout;
+	conference_video_targets_t *targets = conference->video_targets;
+	conference_video_packet_t *pkt;
+	uint32_t packetlen = frame->packet ? frame->packetlen : 0;
+	uint8_t *p;
+	uint32_t i;
+
+	switch_malloc(pkt, sizeof(*pkt) + frame->datalen + packetlen);
+	pkt->frame = *frame;
+	p = (uint8_t *) (pkt + 1);
+
+	if (frame->datalen) {
+		memcpy(p, frame->data, frame->datalen);
+	}
+	pkt->frame.data = p;
+	pkt->frame.buflen = frame->datalen;
+	p += frame->datalen;
+
+	if (packetlen) {
+		memcpy(p, frame->packet, packetlen);
+		pkt->frame.packet = p;
+	} else {
+		pkt->frame.packet = NULL;
+		pkt->frame.packetlen = 0;
+	}
+
+	pkt->fanout = fanout;
+	pkt->targets = targets;
+	switch_atomic_inc(&targets->refs);
+	switch_atomic_set(&pkt->refs, 1);
+	switch_atomic_inc(&fanout->inflight);
+
+	for (i = 0; i < fanout->threads; i++) {
+		switch_atomic_inc(&pkt->refs);
+		if (switch_queue_trypush(fanout->workers[i].queue, pkt) != SWITCH_STATUS_SUCCESS) {
+			/* this worker is behind, its members lose the packet so ask for a keyframe to cover the damage */
+			switch_atomic_dec(&pkt->refs);
+			fanout->dropped++;
+			switch_atomic_set(&fanout->want_refresh, 1);
+		}
+	}
+
+	conference_video_packet_release(pkt);
+
+	return targets->video;
+}
+
+/* Keyframe requests from many receivers at once, or right after the last one, cost the floor holder a single keyframe */
+static void conference_video_refresh(conference_obj_t *conference, switch_core_session_t *session, switch_core_session_message_t *msg, int want)
+{
+	switch_time_t now;
+
+	if (want) {
+		conference->video_refresh_pending = 1;
+	}
+
+	if (!conference->video_refresh_pending) {
+		return;
+	}
+
+	now = switch_micro_time_now();
+
+	if (now - conference->video_refresh_last < CONF_VIDEO_REFRESH_INTERVAL) {
+		return;
+	}
+
+	conference->video_refresh_last = now;
+	conference->video_refresh_pending = 0;
+	switch_core_session_receive_message(session, msg);
+}
+
 static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thread, void *obj)
 {
 	conference_obj_t *conference = (conference_obj_t *) obj;
@@ -1386,6 +1890,10 @@ static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thr
 	conference->video_running = 1;
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Video thread started for conference %s\n", conference->name);
 
+	if (conference->video_fanout_threads) {
+		conference_video_fanout_start(conference);
+	}
+
 	/* Tell the channel to request a fresh vid frame */
 	msg.from = __FILE__;
 	msg.message_id = SWITCH_MESSAGE_INDICATE_VIDEO_REFRESH_REQ;
@@ -1432,6 +1940,20 @@ static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thr
 		has_vid = 0;
 		want_refresh = 0;
 
+		/* keep going through the workers while they still hold packets so no member is written from two threads */
+		if (conference->video_fanout && conference->video_targets &&
+			(conference->video_targets->count >= conference->video_fanout_threshold || switch_atomic_read(&conference->video_fanout->inflight))) {
+			has_vid = conference_video_fanout_dispatch(conference, vid_frame);
+
+			if (switch_atomic_read(&conference->video_fanout->want_refresh)) {
+				switch_atomic_set(&conference->video_fanout->want_refresh, 0);
+				want_refresh++;
+			}
+
+			conference_video_refresh(conference, session, &msg, want_refresh);
+			goto do_continue;
+		}
+
 		for (imember = conference->members; imember; imember = imember->next) {
 			switch_channel_t *ichannel = switch_core_session_get_channel(imember->session);
 
@@ -1446,22 +1968,432 @@ static void *SWITCH_THREAD_FUNC conference_video_thread_run(switch_thread_t *thr
 			}
 		}
 		
-		if (want_refresh) {
-			switch_core_session_receive_message(session, &msg);
-			want_refresh = 0;
-		}
+		conference_video_refresh(conference, session, &msg, want_refresh);
 
 	do_continue:
 		
 		switch_mutex_unlock(conference->mutex);
 	}
 
+	conference_video_fanout_stop(conference);
+
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Video thread ending for conference %s\n", conference->name);
 	conference->video_running = 0;
 
 	return NULL;
 }
 
+static conference_encode_group_t *conference_encode_group_get(conference_obj_t *conference, const switch_codec_implementation_t *impl, int32_t volume)
+{
+	conference_encode_group_t *group;
+
+	switch_mutex_lock(conference->encode_mutex);
+
+	for (group = conference->encode_groups; group; group = group->next) {
+		if (group->impl == impl && group->volume_out_level == volume) {
+			goto done;
+		}
+	}
+
+	group = switch_core_alloc(conference->pool, sizeof(*group));
+	group->impl = impl;
+	group->volume_out_level = volume;
+	switch_mutex_init(&group->mutex, SWITCH_MUTEX_NESTED, conference->pool);
+
+	if (switch_core_codec_init(&group->codec, impl->iananame, NULL, impl->samples_per_second, impl->microseconds_per_packet / 1000,
+							   impl->number_of_channels, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE, NULL,
+							   conference->pool) == SWITCH_STATUS_SUCCESS) {
+		/* only share when the members write codec would take our payload untouched */
+		group->usable = group->codec.implementation == impl;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Conference %s shared encode group %s@%uh@%ui vol %d %s\n", conference->name,
+					  impl->iananame, impl->samples_per_second, impl->microseconds_per_packet / 1000, volume, group->usable ? "ready" : "unusable");
+
+	group->next = conference->encode_groups;
+	conference->encode_groups = group;
+
+  done:
+	switch_mutex_unlock(conference->encode_mutex);
+
+	return group;
+}
+
+static void conference_encode_groups_destroy(conference_obj_t *conference)
+{
+	conference_encode_group_t *group;
+
+	for (group = conference->encode_groups; group; group = group->next) {
+		if (switch_core_codec_ready(&group->codec)) {
+			switch_core_codec_destroy(&group->codec);
+		}
+	}
+
+	conference->encode_groups = NULL;
+}
+
+static switch_status_t conference_shared_encode(conference_obj_t *conference, conference_member_t *omember, int32_t *main_frame, uint32_t bytes)
+{
+	conference_encode_group_t *group;
+	uint8_t rec[sizeof(conference_encode_hdr_t) + SWITCH_RECOMMENDED_BUFFER_SIZE];
+	conference_encode_hdr_t *hdr = (conference_encode_hdr_t *) rec;
+
+	if (!omember->enc_buffer || !omember->enc_impl) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!(group = conference_encode_group_get(conference, omember->enc_impl, omember->volume_out_level)) || !group->usable) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(group->mutex);
+
+	if (group->tick != conference->mix_tick) {
+		int16_t pcm[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+		uint32_t rate = conference->rate, flag = 0;
+
+		group->tick = conference->mix_tick;
+		group->datalen = sizeof(group->data);
+		group->samples = bytes / 2;
+
+		switch_sln_mix_out(pcm, main_frame, NULL, 0, bytes / 2);
+
+		if (group->volume_out_level) {
+			switch_change_sln_volume(pcm, bytes / 2, group->volume_out_level);
+		}
+
+		if (switch_core_codec_encode(&group->codec, NULL, pcm, bytes, conference->rate, group->data, &group->datalen, &rate, &flag) != SWITCH_STATUS_SUCCESS) {
+			group->datalen = 0;
+		}
+	}
+
+	hdr->group = group;
+	hdr->datalen = group->datalen;
+	hdr->samples = group->samples;
+
+	if (hdr->datalen) {
+		memcpy(rec + sizeof(*hdr), group->data, hdr->datalen);
+	}
+
+	switch_mutex_unlock(group->mutex);
+
+	if (!hdr->datalen) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!switch_ringbuffer_write(omember->enc_buffer, rec, sizeof(*hdr) + hdr->datalen)) {
+		switch_set_flag_locked(omember, MFLAG_FLUSH_BUFFER);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* Decide in the member's own thread if it may take the shared payload, the conference thread only reads the result */
+static void member_check_shared_encode(conference_member_t *member, uint32_t interval)
+{
+	switch_codec_t *codec = switch_core_session_get_write_codec(member->session);
+	const switch_codec_implementation_t *impl = codec && switch_core_codec_ready(codec) ? codec->implementation : NULL;
+
+	if (switch_test_flag(member->conference, CFLAG_SHARED_ENCODE) && member->enc_buffer && impl && !member->fnode &&
+		switch_test_flag(member, MFLAG_CAN_HEAR) && interval == member->conference->interval && impl->number_of_channels == 1 &&
+		impl->actual_samples_per_second == member->conference->rate && impl->microseconds_per_packet == member->conference->interval * 1000 &&
+		strcasecmp(impl->iananame, "L16")) {
+		member->enc_impl = impl;
+		if (!switch_test_flag(member, MFLAG_SHARED_ENCODE)) {
+			switch_set_flag_locked(member, MFLAG_SHARED_ENCODE);
+		}
+	} else if (switch_test_flag(member, MFLAG_SHARED_ENCODE)) {
+		switch_clear_flag_locked(member, MFLAG_SHARED_ENCODE);
+	}
+}
+
+/* Build one member's mix from the main frame and queue it on that member's output ring */
+static void conference_mix_member(conference_obj_t *conference, conference_member_t *omember, int32_t *main_frame, uint32_t bytes)
+{
+	int16_t write_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	conference_member_snapshot_t *snap = conference->member_snapshot;
+	conference_member_t *imember;
+	int16_t *bptr;
+	uint32_t x, i;
+	int32_t z;
+	int local_only;
+
+	if (!switch_test_flag(omember, MFLAG_RUNNING)) {
+		return;
+	}
+
+	if (!switch_test_flag(omember, MFLAG_CAN_HEAR)) {
+		return;
+	}
+
+	/* in a full mesh a link must not carry what came in over the other links, the peer already has that directly */
+	local_only = conference->cascade_mix && switch_test_flag(omember, MFLAG_CASCADE) && !switch_test_flag(omember, MFLAG_CASCADE_RELAY);
+
+	if (switch_test_flag(conference, CFLAG_SHARED_ENCODE) && !conference->relationship_total && switch_test_flag(omember, MFLAG_SHARED_ENCODE) &&
+		!switch_test_flag(omember, MFLAG_HAS_AUDIO) && !local_only && conference_shared_encode(conference, omember, main_frame, bytes) == SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	/* without relationships every listener hears the whole mix minus itself, the vector kernel does that in one pass */
+	if (!conference->relationship_total) {
+		if (local_only) {
+			switch_sln_mix_out(write_frame, conference->cascade_frame, NULL, 0, bytes / 2);
+		} else {
+			switch_sln_mix_out(write_frame, main_frame, switch_test_flag(omember, MFLAG_HAS_AUDIO) ? (int16_t *) omember->frame : NULL,
+							   omember->read / 2, bytes / 2);
+		}
+		goto mixed;
+	}
+
+	bptr = (int16_t *) omember->frame;
+	for (x = 0; x < bytes / 2; x++) {
+		if (local_only) {
+			z = conference->cascade_frame[x];
+		} else {
+			z = main_frame[x];
+			/* bptr[x] represents my own contribution to this audio sample */
+			if (switch_test_flag(omember, MFLAG_HAS_AUDIO) && x <= omember->read / 2) {
+				z -= (int32_t) bptr[x];
+			}
+		}
+
+		/* when there are relationships, we have to do more work by scouring all the members to see if there are any 
+		   reasons why we should not be hearing a paticular member, and if not, delete their samples as well.
+		 */
+		if (conference->relationship_total) {
+			for (i = 0; i < snap->count; i++) {
+				imember = snap->members[i];
+				if (local_only && switch_test_flag(imember, MFLAG_CASCADE)) {
+					continue;
+				}
+				if (imember != omember && switch_test_flag(imember, MFLAG_HAS_AUDIO)) {
+					conference_relationship_t *rel;
+					switch_size_t found = 0;
+					int16_t *rptr = (int16_t *) imember->frame;
+					for (rel = imember->relationships; rel; rel = rel->next) {
+						if ((rel->id == omember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_SPEAK)) {
+							z -= (int32_t) rptr[x];
+							found = 1;
+							break;
+						}
+					}
+					if (!found) {
+						for (rel = omember->relationships; rel; rel = rel->next) {
+							if ((rel->id == imember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_HEAR)) {
+								z -= (int32_t) rptr[x];
+								break;
+							}
+						}
+					}
+
+				}
+			}
+		}
+
+		/* Now we can convert to 16 bit. */
+		switch_normalize_to_16bit(z);
+		write_frame[x] = (int16_t) z;
+	}
+
+  mixed:
+	omember->out_ingress = omember == conference->ingress_member ? conference->ingress_next : conference->ingress_oldest;
+
+	if (!switch_ringbuffer_write(omember->mux_buffer, write_frame, bytes)) {
+		/* the output ring is full because this member stopped draining it, let it flush and catch up */
+		switch_set_flag_locked(omember, MFLAG_FLUSH_BUFFER);
+	}
+}
+
+/* Mix helper threads: once a conference grows past mix-thread-threshold members the per member output step is split
+   between the conference thread and mix-threads helpers, the central sum stays on the conference thread. */
+static void *SWITCH_THREAD_FUNC conference_mix_worker_run(switch_thread_t *thread, void *obj)
+{
+	conference_mix_worker_t *worker = (conference_mix_worker_t *) obj;
+	conference_mix_pool_t *pool = worker->pool;
+	uint32_t generation = 0, i;
+
+	switch_mutex_lock(pool->mutex);
+
+	while (pool->running) {
+		if (pool->generation == generation) {
+			switch_thread_cond_wait(pool->cond, pool->mutex);
+			continue;
+		}
+
+		generation = pool->generation;
+		switch_mutex_unlock(pool->mutex);
+
+		for (i = worker->index; i < pool->snap->count; i += pool->threads + 1) {
+			conference_mix_member(pool->conference, pool->snap->members[i], pool->main_frame, pool->bytes);
+		}
+
+		switch_mutex_lock(pool->mutex);
+		if (!--pool->pending) {
+			switch_thread_cond_signal(pool->done_cond);
+		}
+	}
+
+	switch_mutex_unlock(pool->mutex);
+
+	return NULL;
+}
+
+static void conference_mix_pool_start(conference_obj_t *conference)
+{
+	conference_mix_pool_t *pool;
+	switch_threadattr_t *thd_attr = NULL;
+	uint32_t i;
+
+	pool = switch_core_alloc(conference->pool, sizeof(*pool));
+	pool->conference = conference;
+	pool->threads = conference->mix_threads;
+	pool->running = 1;
+	pool->workers = switch_core_alloc(conference->pool, sizeof(conference_mix_worker_t) * pool->threads);
+	switch_mutex_init(&pool->mutex, SWITCH_MUTEX_NESTED, conference->pool);
+	switch_thread_cond_create(&pool->cond, conference->pool);
+	switch_thread_cond_create(&pool->done_cond, conference->pool);
+
+	switch_threadattr_create(&thd_attr, conference->pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	for (i = 0; i < pool->threads; i++) {
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i + 1;
+		switch_thread_create(&pool->workers[i].thread, thd_attr, conference_mix_worker_run, &pool->workers[i], conference->pool);
+	}
+
+	conference->mix_pool = pool;
+}
+
+static void conference_mix_pool_stop(conference_obj_t *conference)
+{
+	conference_mix_pool_t *pool = conference->mix_pool;
+	switch_status_t st;
+	uint32_t i;
+
+	if (!pool) {
+		return;
+	}
+
+	switch_mutex_lock(pool->mutex);
+	pool->running = 0;
+	switch_thread_cond_broadcast(pool->cond);
+	switch_mutex_unlock(pool->mutex);
+
+	for (i = 0; i < pool->threads; i++) {
+		if (pool->workers[i].thread) {
+			switch_thread_join(&st, pool->workers[i].thread);
+		}
+	}
+
+	conference->mix_pool = NULL;
+}
+
+/* caller holds conference->mutex so the member snapshot can not change under the helpers */
+static void conference_mix_members(conference_obj_t *conference, int32_t *main_frame, uint32_t bytes)
+{
+	conference_mix_pool_t *pool = conference->mix_pool;
+	conference_member_snapshot_t *snap = conference->member_snapshot;
+	uint32_t i;
+
+	if (!snap) {
+		return;
+	}
+
+	if (!pool || snap->count < conference->mix_thread_threshold) {
+		for (i = 0; i < snap->count; i++) {
+			conference_mix_member(conference, snap->members[i], main_frame, bytes);
+		}
+		return;
+	}
+
+	switch_mutex_lock(pool->mutex);
+	pool->snap = snap;
+	pool->main_frame = main_frame;
+	pool->bytes = bytes;
+	pool->pending = pool->threads;
+	pool->generation++;
+	switch_thread_cond_broadcast(pool->cond);
+	switch_mutex_unlock(pool->mutex);
+
+	for (i = 0; i < snap->count; i += pool->threads + 1) {
+		conference_mix_member(conference, snap->members[i], main_frame, bytes);
+	}
+
+	switch_mutex_lock(pool->mutex);
+	while (pool->pending) {
+		switch_thread_cond_wait(pool->done_cond, pool->mutex);
+	}
+	switch_mutex_unlock(pool->mutex);
+}
+
+/* conference thread only: keep the loudest members that have audio in the mix and drop the rest before it is summed.
+   A member already mixed gets a 25% edge and stays in for CONF_TOPN_HOLD ticks after it stops being picked so the
+   mix does not flap between two speakers of similar level.  Cascade links always stay in. */
+static void conference_select_speakers(conference_obj_t *conference, conference_member_snapshot_t *snap)
+{
+	conference_member_t *picked[CONF_MAX_ACTIVE_SPEAKERS];
+	uint32_t rank[CONF_MAX_ACTIVE_SPEAKERS];
+	uint32_t max = conference->max_active_speakers, npicked = 0, x, y;
+
+	for (x = 0; x < snap->count; x++) {
+		conference_member_t *member = snap->members[x];
+		uint32_t energy;
+
+		if (!switch_test_flag(member, MFLAG_HAS_AUDIO) || switch_test_flag(member, MFLAG_CASCADE)) {
+			continue;
+		}
+
+		energy = switch_atomic_read(&member->vad) & ~CONF_VAD_TALKING;
+		member->topn_energy = (member->topn_energy * 3 + energy) / 4;
+		energy = member->topn_active ? member->topn_energy + member->topn_energy / 4 : member->topn_energy;
+
+		/* insertion into the sorted picks, loudest first */
+		for (y = npicked; y > 0 && rank[y - 1] < energy; y--) {
+			if (y < max) {
+				picked[y] = picked[y - 1];
+				rank[y] = rank[y - 1];
+			}
+		}
+
+		if (y < max) {
+			picked[y] = member;
+			rank[y] = energy;
+			if (npicked < max) {
+				npicked++;
+			}
+		}
+	}
+
+	for (x = 0; x < snap->count; x++) {
+		conference_member_t *member = snap->members[x];
+		int in = 0;
+
+		if (switch_test_flag(member, MFLAG_CASCADE)) {
+			continue;
+		}
+
+		for (y = 0; y < npicked; y++) {
+			if (picked[y] == member) {
+				in = 1;
+				break;
+			}
+		}
+
+		if (in) {
+			member->topn_active = 1;
+			member->topn_hold = CONF_TOPN_HOLD;
+		} else if (member->topn_active && member->topn_hold && --member->topn_hold) {
+			/* still held, it is mixed on top of the picks */
+		} else {
+			member->topn_active = 0;
+			if (switch_test_flag(member, MFLAG_HAS_AUDIO)) {
+				switch_clear_flag_locked(member, MFLAG_HAS_AUDIO);
+			}
+		}
+	}
+}
+
 /* Main monitor thread (1 per distinct conference room) */
 static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, void *obj)
 {
@@ -1469,7 +2401,8 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 	conference_member_t *imember, *omember;
 	uint32_t samples = switch_samples_per_packet(conference->rate, conference->interval);
 	uint32_t bytes = samples * 2;
-	uint8_t ready = 0, total = 0;
+	uint32_t ready = 0, total = 0;
+	conference_member_snapshot_t *snap;
 	switch_timer_t timer = { 0 };
 	switch_event_t *event;
 	uint8_t *file_frame;
@@ -1484,6 +2417,8 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 		divisor = 1;
 	}
 
+	switch_core_thread_set_role_affinity(SWITCH_THREAD_ROLE_MEDIA);
+
 	file_frame = switch_core_alloc(conference->pool, SWITCH_RECOMMENDED_BUFFER_SIZE);
 	async_file_frame = switch_core_alloc(conference->pool, SWITCH_RECOMMENDED_BUFFER_SIZE);
 
@@ -1501,6 +2436,10 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 	conference->is_recording = 0;
 	conference->record_count = 0;
 
+	if (conference->mix_threads) {
+		conference_mix_pool_start(conference);
+	}
+
 	while (globals.running && !switch_test_flag(conference, CFLAG_DESTRUCT)) {
 		switch_size_t file_sample_len = samples;
 		switch_size_t file_data_len = samples * 2;
@@ -1520,9 +2459,15 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 
 		floor_holder = conference->floor_holder;
 		
+		snap = conference->member_snapshot;
+
+		conference->ingress_member = NULL;
+		conference->ingress_oldest = conference->ingress_next = 0;
+
 		/* Read one frame of audio from each member channel and save it for redistribution */
-		for (imember = conference->members; imember; imember = imember->next) {
+		for (x = 0; snap && x < snap->count; x++) {
 			uint32_t buf_read = 0;
+			imember = snap->members[x];
 			total++;
 			imember->read = 0;
 
@@ -1552,15 +2497,30 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 			}
 
 			switch_clear_flag_locked(imember, MFLAG_HAS_AUDIO);
-			switch_mutex_lock(imember->audio_in_mutex);
 
-			if (switch_buffer_inuse(imember->audio_buffer) >= bytes
-				&& (buf_read = (uint32_t) switch_buffer_read(imember->audio_buffer, imember->frame, bytes))) {
+			/* the conference thread is the only reader of the input ring */
+			if (switch_ringbuffer_inuse(imember->audio_buffer) >= bytes
+				&& (buf_read = (uint32_t) switch_ringbuffer_read(imember->audio_buffer, imember->frame, bytes))) {
+				switch_time_t ingress = imember->in_ingress;
+
 				imember->read = buf_read;
 				switch_set_flag_locked(imember, MFLAG_HAS_AUDIO);
 				ready++;
+
+				imember->mix_ingress = 0;
+				if (ingress) {
+					/* the audio still queued behind this frame arrived after it */
+					imember->mix_ingress = ingress - (switch_time_t) switch_ringbuffer_inuse(imember->audio_buffer) * conference->interval * 1000 / bytes;
+
+					if (!conference->ingress_oldest || imember->mix_ingress < conference->ingress_oldest) {
+						conference->ingress_next = conference->ingress_oldest;
+						conference->ingress_oldest = imember->mix_ingress;
+						conference->ingress_member = imember;
+					} else if (!conference->ingress_next || imember->mix_ingress < conference->ingress_next) {
+						conference->ingress_next = imember->mix_ingress;
+					}
+				}
 			}
-			switch_mutex_unlock(imember->audio_in_mutex);
 		}
 		
 
@@ -1598,6 +2558,8 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 					msg.message_id = SWITCH_MESSAGE_INDICATE_VIDEO_REFRESH_REQ;
 			
 					switch_core_session_receive_message(floor_holder->session, &msg);
+					conference->video_refresh_last = switch_micro_time_now();
+					conference->video_refresh_pending = 0;
 				}
 			}
 			
@@ -1639,7 +2601,7 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 				switch_channel_t *channel = switch_core_session_get_channel(imember->session);
 				char *rfile = switch_channel_expand_variables(channel, conference->auto_record);
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Auto recording file: %s\n", rfile);
-				launch_conference_record_thread(conference, rfile);
+				conference_record_start(conference, rfile);
 				if (rfile != conference->auto_record) {
 					conference->record_filename = switch_core_strdup(conference->pool, rfile);
 					switch_safe_free(rfile);
@@ -1768,10 +2730,13 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 			}
 		}
 
+		if (ready > conference->max_active_speakers && conference->max_active_speakers && snap) {
+			conference_select_speakers(conference, snap);
+		}
+
 		if (ready || has_file_data) {
 			/* Use more bits in the main_frame to preserve the exact sum of the audio samples. */
-			int main_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2] = { 0 };
-			int16_t write_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2] = { 0 };
+			int32_t main_frame[SWITCH_RECOMMENDED_BUFFER_SIZE / 2] = { 0 };
 
 
 			/* Init the main frame with file data if there is any. */
@@ -1790,9 +2755,14 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 			conference->mux_loop_count = 0;
 			conference->member_loop_count = 0;
 
+			if ((conference->cascade_mix = (conference->cascade_count > 1))) {
+				memset(conference->cascade_frame, 0, bytes * 2);
+			}
+
 
 			/* Copy audio from every member known to be producing audio into the main frame. */
-			for (omember = conference->members; omember; omember = omember->next) {
+			for (x = 0; snap && x < snap->count; x++) {
+				omember = snap->members[x];
 				conference->member_loop_count++;
 				
 				if (!(switch_test_flag(omember, MFLAG_RUNNING) && switch_test_flag(omember, MFLAG_HAS_AUDIO))) {
@@ -1800,101 +2770,54 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 				}
 
 				if (conference->agc_level) {
-					if (switch_test_flag(omember, MFLAG_TALKING) && switch_test_flag(omember, MFLAG_CAN_SPEAK)) {
-						member_score_sum += omember->score;
+					uint32_t vad = switch_atomic_read(&omember->vad);
+
+					if ((vad & CONF_VAD_TALKING) && switch_test_flag(omember, MFLAG_CAN_SPEAK)) {
+						member_score_sum += vad & ~CONF_VAD_TALKING;
 						conference->mux_loop_count++;
 					}
 				}
 				
-				bptr = (int16_t *) omember->frame;
-				for (x = 0; x < omember->read / 2; x++) {
-					main_frame[x] += (int32_t) bptr[x];
-				}
-			}
+				switch_sln_accumulate(main_frame, (int16_t *) omember->frame, omember->read / 2);
 
-			if (conference->agc_level && conference->member_loop_count) {
-				conf_energy = 0;
-			
-				for (x = 0; x < bytes / 2; x++) {
-					z = abs(main_frame[x]);
-					switch_normalize_to_16bit(z);
-					conf_energy += (int16_t) z;
+				if (conference->cascade_mix && switch_test_flag(omember, MFLAG_CASCADE)) {
+					switch_sln_accumulate(conference->cascade_frame, (int16_t *) omember->frame, omember->read / 2);
 				}
-				
-				conference->score = conf_energy / ((bytes / 2) / divisor) / conference->member_loop_count;
-
-				conference->avg_tally += conference->score;
-				conference->avg_score = conference->avg_tally / ++conference->avg_itt;
-				if (!conference->avg_itt) conference->avg_tally = conference->score;
 			}
-			
-			/* Create write frame once per member who is not deaf for each sample in the main frame
-			   check if our audio is involved and if so, subtract it from the sample so we don't hear ourselves.
-			   Since main frame was 32 bit int, we did not lose any detail, now that we have to convert to 16 bit we can
-			   cut it off at the min and max range if need be and write the frame to the output buffer.
-			 */
-			for (omember = conference->members; omember; omember = omember->next) {
-				switch_size_t ok = 1;
 
-				if (!switch_test_flag(omember, MFLAG_RUNNING)) {
-					continue;
-				}
-
-				if (!switch_test_flag(omember, MFLAG_CAN_HEAR)) {
-					continue;
-				}
-
-				bptr = (int16_t *) omember->frame;
+			if (conference->cascade_mix) {
+				/* what the links hear: everything but the links */
 				for (x = 0; x < bytes / 2; x++) {
-					z = main_frame[x];
-					/* bptr[x] represents my own contribution to this audio sample */
-					if (switch_test_flag(omember, MFLAG_HAS_AUDIO) && x <= omember->read / 2) {
-						z -= (int32_t) bptr[x];
-					}
-
-					/* when there are relationships, we have to do more work by scouring all the members to see if there are any 
-					   reasons why we should not be hearing a paticular member, and if not, delete their samples as well.
-					 */
-					if (conference->relationship_total) {
-						for (imember = conference->members; imember; imember = imember->next) {
-							if (imember != omember && switch_test_flag(imember, MFLAG_HAS_AUDIO)) {
-								conference_relationship_t *rel;
-								switch_size_t found = 0;
-								int16_t *rptr = (int16_t *) imember->frame;
-								for (rel = imember->relationships; rel; rel = rel->next) {
-									if ((rel->id == omember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_SPEAK)) {
-										z -= (int32_t) rptr[x];
-										found = 1;
-										break;
-									}
-								}
-								if (!found) {
-									for (rel = omember->relationships; rel; rel = rel->next) {
-										if ((rel->id == imember->id || rel->id == 0) && !switch_test_flag(rel, RFLAG_CAN_HEAR)) {
-											z -= (int32_t) rptr[x];
-											break;
-										}
-									}
-								}
-
-							}
-						}
-					}
+					conference->cascade_frame[x] = main_frame[x] - conference->cascade_frame[x];
+				}
+			}
 
-					/* Now we can convert to 16 bit. */
+			if (conference->agc_level && conference->member_loop_count) {
+				conf_energy = 0;
+			
+				for (x = 0; x < bytes / 2; x++) {
+					z = abs(main_frame[x]);
 					switch_normalize_to_16bit(z);
-					write_frame[x] = (int16_t) z;
+					conf_energy += (int16_t) z;
 				}
 				
-				switch_mutex_lock(omember->audio_out_mutex);
-				ok = switch_buffer_write(omember->mux_buffer, write_frame, bytes);
-				switch_mutex_unlock(omember->audio_out_mutex);
+				conference->score = conf_energy / ((bytes / 2) / divisor) / conference->member_loop_count;
 
-				if (!ok) {
-					switch_mutex_unlock(conference->mutex);
-					goto end;
-				}
+				conference->avg_tally += conference->score;
+				conference->avg_score = conference->avg_tally / ++conference->avg_itt;
+				if (!conference->avg_itt) conference->avg_tally = conference->score;
 			}
+			
+			/* Create write frame once per member who is not deaf for each sample in the main frame
+			   check if our audio is involved and if so, subtract it from the sample so we don't hear ourselves.
+			   Since main frame was 32 bit int, we did not lose any detail, now that we have to convert to 16 bit we can
+			   cut it off at the min and max range if need be and write the frame to the output buffer.
+			 */
+			conference->mix_tick++;
+			conference_mix_members(conference, main_frame, bytes);
+			conference_record_write(conference, main_frame, bytes);
+		} else if (conference->records) {
+			conference_record_write(conference, NULL, bytes);
 		}
 
 		if (conference->async_fnode && conference->async_fnode->done) {
@@ -1933,6 +2856,8 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 	/* Rinse ... Repeat */
   end:
 
+	conference_mix_pool_stop(conference);
+
 	if (switch_test_flag(conference, CFLAG_OUTCALL)) {
 		conference->cancel_cause = SWITCH_CAUSE_ORIGINATOR_CANCEL;
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Ending pending outcall channels for Conference: '%s'\n", conference->name);
@@ -1996,6 +2921,8 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 		switch_clear_flag_locked(imember, MFLAG_RUNNING);
 	}
 	switch_mutex_unlock(conference->member_mutex);
+	conference_record_stop(conference, NULL);
+	conference_record_write(conference, NULL, bytes);
 	switch_mutex_unlock(conference->mutex);
 
 	if (conference->vh[0].up == 1) {
@@ -2032,6 +2959,9 @@ static void *SWITCH_THREAD_FUNC conference_thread_run(switch_thread_t *thread, v
 	switch_thread_rwlock_unlock(conference->rwlock);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Write Lock OFF\n");
 
+	conference_encode_groups_destroy(conference);
+	switch_safe_free(conference->member_snapshot);
+
 	if (conference->sh) {
 		switch_speech_flag_t flags = SWITCH_SPEECH_FLAG_NONE;
 		switch_core_speech_close(&conference->lsh, &flags);
@@ -2621,6 +3551,7 @@ static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, v
 	switch_frame_t *read_frame = NULL;
 	uint32_t hangover = 40, hangunder = 5, hangover_hits = 0, hangunder_hits = 0, diff_level = 400;
 	switch_core_session_t *session = member->session;
+	int silent;
 
 	switch_assert(member != NULL);
 
@@ -2691,6 +3622,8 @@ static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, v
 		}
 		
 
+		silent = 0;
+
 		/* if the member can speak, compute the audio energy level and */
 		/* generate events when the level crosses the threshold        */
 		if ((switch_test_flag(member, MFLAG_CAN_SPEAK) || switch_test_flag(member, MFLAG_MUTE_DETECT))) {
@@ -2711,12 +3644,19 @@ static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, v
 			}
 			
 			if ((samples = read_frame->datalen / sizeof(*data))) {
-				for (i = 0; i < samples; i++) {
-					energy += abs(data[j]);
-					j += member->read_impl.number_of_channels;
+				if (member->read_impl.number_of_channels > 1) {
+					for (i = 0; i < samples; i++) {
+						energy += abs(data[j]);
+						j += member->read_impl.number_of_channels;
+					}
+				} else {
+					energy = switch_sln_energy(data, samples);
 				}
 				
 				member->score = energy / samples;
+
+				/* digital silence adds nothing to the mix, the conference thread need not see it at all */
+				silent = !energy;
 			}
 
 			if (member->vol_period) {
@@ -2835,9 +3775,12 @@ static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, v
 			member->last_score = member->score;
 		}
 
+		/* everything the conference thread wants to know about this frame, in one word it can read without our locks */
+		switch_atomic_set(&member->vad, (member->score & ~CONF_VAD_TALKING) | (switch_test_flag(member, MFLAG_TALKING) ? CONF_VAD_TALKING : 0));
+
 		/* skip frames that are not actual media or when we are muted or silent */
 		if ((switch_test_flag(member, MFLAG_TALKING) || member->energy_level == 0 || switch_test_flag(member->conference, CFLAG_AUDIO_ALWAYS)) 
-			&& switch_test_flag(member, MFLAG_CAN_SPEAK) &&	!switch_test_flag(member->conference, CFLAG_WAIT_MOD)) {
+			&& !silent && switch_test_flag(member, MFLAG_CAN_SPEAK) && !switch_test_flag(member->conference, CFLAG_WAIT_MOD)) {
 			switch_audio_resampler_t *read_resampler = member->read_resampler;
 			void *data;
 			uint32_t datalen;
@@ -2860,13 +3803,12 @@ static void *SWITCH_THREAD_FUNC conference_loop_input(switch_thread_t *thread, v
 			if (datalen) {
 				switch_size_t ok = 1;
 
-				/* Write the audio into the input buffer */
-				switch_mutex_lock(member->audio_in_mutex);
-				ok = switch_buffer_write(member->audio_buffer, data, datalen);
-				switch_mutex_unlock(member->audio_in_mutex);
-				if (!ok) {
-					switch_mutex_unlock(member->read_mutex);
-					break;
+				/* Write the audio into the input buffer, if the conference thread has fallen behind the frame is dropped */
+				ok = switch_ringbuffer_write(member->audio_buffer, data, datalen);
+				if (ok) {
+					member->in_ingress = read_frame->ingress;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_DEBUG1, "Input buffer full, dropping frame\n");
 				}
 			}
 		}
@@ -3127,7 +4069,7 @@ static void conference_loop_output(conference_member_t *member)
 		char dtmf[128] = "";
 		switch_event_t *event;
 		int use_timer = 0;
-		switch_buffer_t *use_buffer = NULL;
+		switch_ringbuffer_t *use_buffer = NULL;
 		uint32_t mux_used = 0;
 
 		switch_mutex_lock(member->write_mutex);
@@ -3179,7 +4121,35 @@ static void conference_loop_output(conference_member_t *member)
 		}
 
 		use_buffer = NULL;
-		mux_used = (uint32_t) switch_buffer_inuse(member->mux_buffer);
+
+		if (member->enc_buffer) {
+			member_check_shared_encode(member, interval);
+
+			if (switch_ringbuffer_inuse(member->enc_buffer) > sizeof(conference_encode_hdr_t)) {
+				conference_encode_hdr_t hdr;
+				switch_frame_t enc_frame = { 0 };
+
+				/* the conference thread already encoded this frame for everyone in our group, send it as is */
+				switch_ringbuffer_read(member->enc_buffer, &hdr, sizeof(hdr));
+				enc_frame.data = data;
+				enc_frame.buflen = SWITCH_RECOMMENDED_BUFFER_SIZE;
+				enc_frame.datalen = (uint32_t) switch_ringbuffer_read(member->enc_buffer, data, hdr.datalen);
+				enc_frame.samples = hdr.samples;
+				enc_frame.rate = member->conference->rate;
+				enc_frame.codec = &hdr.group->codec;
+				enc_frame.timestamp = timer.samplecount;
+				low_count = 0;
+
+				if (switch_core_session_write_frame(member->session, &enc_frame, SWITCH_IO_FLAG_NONE, 0) != SWITCH_STATUS_SUCCESS) {
+					switch_channel_hangup(channel, SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER);
+					break;
+				}
+
+				goto shared_done;
+			}
+		}
+
+		mux_used = (uint32_t) switch_ringbuffer_inuse(member->mux_buffer);
 		
 		use_timer = 1;
 		
@@ -3195,13 +4165,19 @@ static void conference_loop_output(conference_member_t *member)
 			}
 		}
 
+		write_frame.ingress = 0;
+
 		if (mux_used >= bytes) {
 			/* Flush the output buffer and write all the data (presumably muxed) back to the channel */
-			switch_mutex_lock(member->audio_out_mutex);
 			write_frame.data = data;
 			use_buffer = member->mux_buffer;
 			low_count = 0;
-			if ((write_frame.datalen = (uint32_t) switch_buffer_read(use_buffer, write_frame.data, bytes))) {
+			if ((write_frame.datalen = (uint32_t) switch_ringbuffer_read(use_buffer, write_frame.data, bytes))) {
+				if (member->out_ingress) {
+					write_frame.ingress = member->out_ingress -
+						(switch_time_t) switch_ringbuffer_inuse(use_buffer) * interval * 1000 / bytes;
+				}
+
 				if (write_frame.datalen) {
 					write_frame.samples = write_frame.datalen / 2;
 				   
@@ -3220,13 +4196,10 @@ static void conference_loop_output(conference_member_t *member)
 					}
 					if (switch_core_session_write_frame(member->session, &write_frame, SWITCH_IO_FLAG_NONE, 0) != SWITCH_STATUS_SUCCESS) {
 						switch_channel_hangup(channel, SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER);
-						switch_mutex_unlock(member->audio_out_mutex);
 						break;
 					}
 				}
 			}
-
-			switch_mutex_unlock(member->audio_out_mutex);
 		} else if (member->fnode) {
 			write_frame.datalen = bytes;
 			write_frame.samples = samples;
@@ -3255,11 +4228,14 @@ static void conference_loop_output(conference_member_t *member)
 			}
 		}
 
+	  shared_done:
+
 		if (switch_test_flag(member, MFLAG_FLUSH_BUFFER)) {
-			if (switch_buffer_inuse(member->mux_buffer)) {
-				switch_mutex_lock(member->audio_out_mutex);
-				switch_buffer_zero(member->mux_buffer);
-				switch_mutex_unlock(member->audio_out_mutex);
+			if (switch_ringbuffer_inuse(member->mux_buffer)) {
+				switch_ringbuffer_zero(member->mux_buffer);
+			}
+			if (member->enc_buffer && switch_ringbuffer_inuse(member->enc_buffer)) {
+				switch_ringbuffer_zero(member->enc_buffer);
 			}
 			switch_clear_flag_locked(member, MFLAG_FLUSH_BUFFER);
 		}
@@ -3340,223 +4316,159 @@ static void conference_loop_output(conference_member_t *member)
 	}
 }
 
-/* Sub-Routine called by a record entity inside a conference */
-static void *SWITCH_THREAD_FUNC conference_record_thread_run(switch_thread_t *thread, void *obj)
+/* Close a finished recording off the conference thread, the close waits for the file I/O threads to drain it */
+static void *SWITCH_THREAD_FUNC conference_record_close_thread_run(switch_thread_t *thread, void *obj)
 {
-	int16_t *data_buf;
-	switch_file_handle_t fh = { 0 };
-	conference_member_t smember = { 0 }, *member;
 	conference_record_t *rec = (conference_record_t *) obj;
-	conference_obj_t *conference = rec->conference;
-	uint32_t samples = switch_samples_per_packet(conference->rate, conference->interval);
-	uint32_t mux_used;
-	char *vval;
-	switch_timer_t timer = { 0 };
-	uint32_t rlen;
-	switch_size_t data_buf_len;
-	switch_event_t *event;
-	int no_data = 0;
-	int lead_in = 20;
-	switch_size_t len = 0;
-
-	data_buf_len = samples * sizeof(int16_t);
-
-	switch_zmalloc(data_buf, data_buf_len);
+	switch_memory_pool_t *pool = rec->pool;
 
-	if (switch_thread_rwlock_tryrdlock(conference->rwlock) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Read Lock Fail\n");
-		return NULL;
+	if (switch_test_flag((&rec->fh), SWITCH_FILE_OPEN)) {
+		switch_core_file_close(&rec->fh);
 	}
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Recording of %s Stopped\n", rec->path);
+
+	rec = NULL;
+	switch_core_destroy_memory_pool(&pool);
 
 	switch_mutex_lock(globals.hash_mutex);
-	globals.threads++;
+	globals.threads--;
 	switch_mutex_unlock(globals.hash_mutex);
 
-	member = &smember;
-
-	member->flags = MFLAG_CAN_HEAR | MFLAG_NOCHANNEL | MFLAG_RUNNING;
-
-	member->conference = conference;
-	member->native_rate = conference->rate;
-	member->rec_path = rec->path;
-	member->rec_time = switch_epoch_time_now(NULL);
-	fh.channels = 1;
-	fh.samplerate = conference->rate;
-	member->id = next_member_id();
-	member->pool = rec->pool;
-
-	member->frame_size = SWITCH_RECOMMENDED_BUFFER_SIZE;
-	member->frame = switch_core_alloc(member->pool, member->frame_size);
-	member->mux_frame = switch_core_alloc(member->pool, member->frame_size);
-
-
-	switch_mutex_init(&member->write_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_mutex_init(&member->flag_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_mutex_init(&member->fnode_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_mutex_init(&member->audio_in_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_mutex_init(&member->audio_out_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_mutex_init(&member->read_mutex, SWITCH_MUTEX_NESTED, rec->pool);
-	switch_thread_rwlock_create(&member->rwlock, rec->pool);
-
-	/* Setup an audio buffer for the incoming audio */
-	if (switch_buffer_create_dynamic(&member->audio_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, 0) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
-		goto end;
-	}
-
-	/* Setup an audio buffer for the outgoing audio */
-	if (switch_buffer_create_dynamic(&member->mux_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, 0) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
-		goto end;
-	}
-
-	if (conference_add_member(conference, member) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Joining Conference\n");
-		goto end;
-	}
-
-	fh.pre_buffer_datalen = SWITCH_DEFAULT_FILE_BUFFER_LEN;
-
-	if (switch_core_file_open(&fh,
-							  rec->path, (uint8_t) 1, conference->rate, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT,
-							  rec->pool) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening File [%s]\n", rec->path);
-		goto end;
-	}
-
-
-	if (switch_core_timer_init(&timer, conference->timer_name, conference->interval, samples, rec->pool) == SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Setup timer success interval: %u  samples: %u\n", conference->interval, samples);
-	} else {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Timer Setup Failed.  Conference Cannot Start\n");
-		goto end;
-	}
+	return NULL;
+}
 
-	if ((vval = switch_mprintf("Conference %s", conference->name))) {
-		switch_core_file_set_string(&fh, SWITCH_AUDIO_COL_STR_TITLE, vval);
-		switch_safe_free(vval);
-	}
+/* caller holds conference->mutex */
+static void conference_record_finish(conference_obj_t *conference, conference_record_t *rec)
+{
+	switch_event_t *event;
 
-	switch_core_file_set_string(&fh, SWITCH_AUDIO_COL_STR_ARTIST, "FreeSWITCH mod_conference Software Conference Module");
+	conference->is_recording = 0;
+	conference_cdr_del(&rec->member);
 
-	if (test_eflag(conference, EFLAG_RECORD) &&
-			switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
+	if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
 		conference_add_event_data(conference, event);
-		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "start-recording");
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "stop-recording");
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Path", rec->path);
 		switch_event_fire(&event);
 	}
 
-	while (switch_test_flag(member, MFLAG_RUNNING) && switch_test_flag(conference, CFLAG_RUNNING) && conference->count) {
+	switch_mutex_lock(globals.hash_mutex);
+	globals.threads++;
+	switch_mutex_unlock(globals.hash_mutex);
+
+	launch_thread_detached(conference_record_close_thread_run, rec->pool, rec);
+}
 
-		len = 0;
+/* conference thread only, with conference->mutex held: hand this tick's mix to every recording, silence when nothing
+   was mixed, and retire the recordings that were stopped or lost everyone */
+static void conference_record_write(conference_obj_t *conference, int32_t *main_frame, uint32_t bytes)
+{
+	int16_t data_buf[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+	conference_record_t *rec, **ptr = &conference->records;
+	switch_size_t len;
+	int have_data = 0;
+
+	while ((rec = *ptr)) {
+		if (rec->stop || !conference->count) {
+			*ptr = rec->next;
+			conference_record_finish(conference, rec);
+			continue;
+		}
 
-		if (lead_in) {
-			lead_in--;
-			goto loop;
+		if (rec->lead_in) {
+			rec->lead_in--;
+			ptr = &rec->next;
+			continue;
 		}
-		
-		mux_used = (uint32_t) switch_buffer_inuse(member->mux_buffer);
 
-		if (switch_test_flag(member, MFLAG_FLUSH_BUFFER)) {
-			if (mux_used) {
-				switch_mutex_lock(member->audio_out_mutex);
-				switch_buffer_zero(member->mux_buffer);
-				switch_mutex_unlock(member->audio_out_mutex);
-				mux_used = 0;
+		if (!have_data) {
+			if (main_frame) {
+				switch_sln_mix_out(data_buf, main_frame, NULL, 0, bytes / 2);
+			} else {
+				memset(data_buf, 255, bytes);
 			}
-			switch_clear_flag_locked(member, MFLAG_FLUSH_BUFFER);
+			have_data = 1;
 		}
 
-	again:
-
-		if (switch_test_flag((&fh), SWITCH_FILE_PAUSE)) {
-			switch_set_flag_locked(member, MFLAG_FLUSH_BUFFER);
-			goto loop;
+		len = bytes / 2;
+		if (switch_core_file_write(&rec->fh, data_buf, &len) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Write Failed\n");
+			rec->stop = 1;
 		}
 
-		if (mux_used >= data_buf_len) {
-			/* Flush the output buffer and write all the data (presumably muxed) to the file */
-			switch_mutex_lock(member->audio_out_mutex);
-			//low_count = 0;
+		ptr = &rec->next;
+	}
+}
 
-			if ((rlen = (uint32_t) switch_buffer_read(member->mux_buffer, data_buf, data_buf_len))) {
-				len = (switch_size_t) rlen / sizeof(int16_t);
-				no_data = 0;
-			}
-			switch_mutex_unlock(member->audio_out_mutex);
-		}
+/* Open a recording of the conference's mix, no thread of its own: the conference thread feeds it every tick */
+static switch_status_t conference_record_start(conference_obj_t *conference, char *path)
+{
+	switch_memory_pool_t *pool;
+	conference_record_t *rec;
+	switch_event_t *event;
+	char *vval;
 
-		if (len == 0) {
-			mux_used = (uint32_t) switch_buffer_inuse(member->mux_buffer);
-				
-			if (mux_used >= data_buf_len) {
-				goto again;
-			}
+	/* Setup a memory pool to use. */
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Pool Failure\n");
+		return SWITCH_STATUS_MEMERR;
+	}
 
-			if (++no_data < 2) {
-				goto loop;
-			}
+	/* Create a node object */
+	if (!(rec = switch_core_alloc(pool, sizeof(*rec)))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Alloc Failure\n");
+		switch_core_destroy_memory_pool(&pool);
+		return SWITCH_STATUS_MEMERR;
+	}
 
-			memset(data_buf, 255, (switch_size_t) data_buf_len);
-			len = (switch_size_t) samples;
-		}
+	conference->is_recording = 1;
 
-		if (!len || switch_core_file_write(&fh, data_buf, &len) != SWITCH_STATUS_SUCCESS) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Write Failed\n");
-			switch_clear_flag_locked(member, MFLAG_RUNNING);
-		}
-		
-	loop:
+	rec->conference = conference;
+	rec->path = switch_core_strdup(pool, path);
+	rec->pool = pool;
+	rec->lead_in = CONF_DEFAULT_LEADIN;
 
-		switch_core_timer_next(&timer);
-	}							/* Rinse ... Repeat */
+	rec->member.conference = conference;
+	rec->member.flags = MFLAG_NOCHANNEL;
+	rec->member.pool = pool;
+	rec->member.rec_path = rec->path;
+	rec->member.rec_time = switch_epoch_time_now(NULL);
 
-  end:
+	rec->fh.channels = 1;
+	rec->fh.samplerate = conference->rate;
+	rec->fh.pre_buffer_datalen = SWITCH_DEFAULT_FILE_BUFFER_LEN;
 
-	while(!no_data) {
-		switch_mutex_lock(member->audio_out_mutex);
-		if ((rlen = (uint32_t) switch_buffer_read(member->mux_buffer, data_buf, data_buf_len))) {
-			len = (switch_size_t) rlen / sizeof(int16_t);
-			switch_core_file_write(&fh, data_buf, &len);
-		} else {
-			no_data = 1;
-		}
-		switch_mutex_unlock(member->audio_out_mutex);
+	if (switch_core_file_open(&rec->fh,
+							  rec->path, (uint8_t) 1, conference->rate, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT,
+							  rec->pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening File [%s]\n", rec->path);
+		conference->is_recording = 0;
+		switch_core_destroy_memory_pool(&pool);
+		return SWITCH_STATUS_FALSE;
 	}
 
-	conference->is_recording = 0;
-	
-	switch_safe_free(data_buf);
-	switch_core_timer_destroy(&timer);
-	conference_del_member(conference, member);
-
-	switch_buffer_destroy(&member->audio_buffer);
-	switch_buffer_destroy(&member->mux_buffer);
-	switch_clear_flag_locked(member, MFLAG_RUNNING);
-	if (switch_test_flag((&fh), SWITCH_FILE_OPEN)) {
-		switch_core_file_close(&fh);
+	if ((vval = switch_mprintf("Conference %s", conference->name))) {
+		switch_core_file_set_string(&rec->fh, SWITCH_AUDIO_COL_STR_TITLE, vval);
+		switch_safe_free(vval);
 	}
-	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Recording of %s Stopped\n", rec->path);
-	if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
+
+	switch_core_file_set_string(&rec->fh, SWITCH_AUDIO_COL_STR_ARTIST, "FreeSWITCH mod_conference Software Conference Module");
+
+	switch_mutex_lock(conference->mutex);
+	conference_cdr_add(&rec->member);
+	rec->next = conference->records;
+	conference->records = rec;
+	switch_mutex_unlock(conference->mutex);
+
+	if (test_eflag(conference, EFLAG_RECORD) &&
+			switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
 		conference_add_event_data(conference, event);
-		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "stop-recording");
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "start-recording");
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Path", rec->path);
 		switch_event_fire(&event);
 	}
 
-	if (rec->pool) {
-		switch_memory_pool_t *pool = rec->pool;
-		rec = NULL;
-		switch_core_destroy_memory_pool(&pool);
-	}
-
-	switch_mutex_lock(globals.hash_mutex);
-	globals.threads--;
-	switch_mutex_unlock(globals.hash_mutex);
-
-	switch_thread_rwlock_unlock(conference->rwlock);
-	return NULL;
+	return SWITCH_STATUS_SUCCESS;
 }
 
 /* Make files stop playing in a conference either the current one or all of them */
@@ -4147,6 +5059,11 @@ static void conference_list(conference_obj_t *conference, switch_stream_handle_t
 			count++;
 		}
 
+		if (switch_test_flag(member, MFLAG_CASCADE)) {
+			stream->write_function(stream, "%s%s", count ? "|" : "", switch_test_flag(member, MFLAG_CASCADE_RELAY) ? "cascade|relay" : "cascade");
+			count++;
+		}
+
 		stream->write_function(stream, "%s%d%s%d%s%d%s%d\n", delim,
 							   member->volume_in_level, 
 							   delim,
@@ -4157,6 +5074,62 @@ static void conference_list(conference_obj_t *conference, switch_stream_handle_t
 	switch_mutex_unlock(conference->member_mutex);
 }
 
+/* Members on the other nodes as last reported over the links, the caller holds conference->member_mutex */
+static uint32_t conference_cascade_remote_count(conference_obj_t *conference)
+{
+	conference_member_t *member;
+	conference_cascade_t *cascade;
+	uint32_t total = 0;
+
+	for (member = conference->members; member; member = member->next) {
+		if (!switch_test_flag(member, MFLAG_CASCADE)) {
+			continue;
+		}
+		if ((cascade = (conference_cascade_t *) switch_channel_get_private(switch_core_session_get_channel(member->session), CONF_CASCADE_PRIVATE))) {
+			total += cascade->remote_members;
+		}
+	}
+
+	return total;
+}
+
+static void conference_list_cascade(conference_obj_t *conference, switch_stream_handle_t *stream, char *delim)
+{
+	conference_member_t *member = NULL;
+	conference_cascade_t *cascade;
+	const char *speaker = "";
+
+	switch_assert(conference != NULL);
+	switch_assert(stream != NULL);
+	switch_assert(delim != NULL);
+
+	switch_mutex_lock(conference->member_mutex);
+
+	if (conference->floor_holder && !switch_test_flag(conference->floor_holder, MFLAG_CASCADE)) {
+		switch_caller_profile_t *profile = switch_channel_get_caller_profile(switch_core_session_get_channel(conference->floor_holder->session));
+		speaker = profile->caller_id_name;
+	}
+
+	/* node, link member id, members on that node, its active speaker, packets in, lost, late */
+	stream->write_function(stream, "%s%slocal%s%u%s%s%s0%s0%s0\n", switch_core_get_switchname(), delim, delim,
+						   conference->count - conference->cascade_count, delim, speaker, delim, delim, delim);
+
+	for (member = conference->members; member; member = member->next) {
+		if (!switch_test_flag(member, MFLAG_CASCADE) ||
+			!(cascade = (conference_cascade_t *) switch_channel_get_private(switch_core_session_get_channel(member->session), CONF_CASCADE_PRIVATE))) {
+			continue;
+		}
+
+		switch_mutex_lock(cascade->mutex);
+		stream->write_function(stream, "%s%s%u%s%u%s%s%s%u%s%u%s%u\n", zstr(cascade->remote_node) ? "unknown" : cascade->remote_node, delim,
+							   member->id, delim, cascade->remote_members, delim, cascade->remote_speaker, delim,
+							   cascade->rx_packets, delim, cascade->rx_lost, delim, cascade->rx_late);
+		switch_mutex_unlock(cascade->mutex);
+	}
+
+	switch_mutex_unlock(conference->member_mutex);
+}
+
 static void conference_list_count_only(conference_obj_t *conference, switch_stream_handle_t *stream)
 {
 	switch_assert(conference != NULL);
@@ -4479,6 +5452,7 @@ static switch_status_t conf_api_sub_list(conference_obj_t *conference, switch_st
 	int pretty = 0;
 	int summary = 0;
 	int countonly = 0;
+	int cascade = 0;
 	int argofs = (argc >= 2 && strcasecmp(argv[1], "list") == 0);	/* detect being called from chat vs. api */
 
 	if (argv[1 + argofs]) {
@@ -4501,6 +5475,8 @@ static switch_status_t conf_api_sub_list(conference_obj_t *conference, switch_st
 			summary = 1;
 		} else if (strcasecmp(argv[1 + argofs], "count") == 0) {
 			countonly = 1;
+		} else if (strcasecmp(argv[1 + argofs], "cascade") == 0) {
+			cascade = 1;
 		}
 	}
 
@@ -4510,13 +5486,25 @@ static switch_status_t conf_api_sub_list(conference_obj_t *conference, switch_st
 			switch_hash_this(hi, NULL, NULL, &val);
 			conference = (conference_obj_t *) val;
 
-			stream->write_function(stream, "Conference %s (%u member%s rate: %u%s)\n",
+			stream->write_function(stream, "Conference %s (%u member%s rate: %u%s",
 								   conference->name,
 								   conference->count,
 								   conference->count == 1 ? "" : "s", conference->rate, switch_test_flag(conference, CFLAG_LOCKED) ? " locked" : "");
+			if (conference->cascade_count) {
+				uint32_t remote;
+
+				switch_mutex_lock(conference->member_mutex);
+				remote = conference_cascade_remote_count(conference);
+				switch_mutex_unlock(conference->member_mutex);
+				stream->write_function(stream, " cascade: %u link%s %u remote member%s", conference->cascade_count,
+									   conference->cascade_count == 1 ? "" : "s", remote, remote == 1 ? "" : "s");
+			}
+			stream->write_function(stream, ")\n");
 			count++;
 			if (!summary) {
-				if (pretty) {
+				if (cascade) {
+					conference_list_cascade(conference, stream, d);
+				} else if (pretty) {
 					conference_list_pretty(conference, stream);
 				} else {
 					conference_list(conference, stream, d);
@@ -4528,6 +5516,8 @@ static switch_status_t conf_api_sub_list(conference_obj_t *conference, switch_st
 		count++;
 		if (countonly) {
 			conference_list_count_only(conference, stream);
+		} else if (cascade) {
+			conference_list_cascade(conference, stream, d);
 		} else if (pretty) {
 			conference_list_pretty(conference, stream);
 		} else {
@@ -4568,6 +5558,7 @@ static void conference_xlist(conference_obj_t *conference, switch_xml_t x_confer
 	conference_member_t *member = NULL;
 	switch_xml_t x_member = NULL, x_members = NULL, x_flags;
 	int moff = 0;
+	conference_record_t *rec;
 	char i[30] = "";
 	char *ival = i;
 	switch_assert(conference != NULL);
@@ -4658,22 +5649,6 @@ static void conference_xlist(conference_obj_t *conference, switch_xml_t x_confer
 		char tmp[50] = "";
 
 		if (switch_test_flag(member, MFLAG_NOCHANNEL)) {
-			if (member->rec_path) {
-				x_member = switch_xml_add_child_d(x_members, "member", moff++);
-				switch_assert(x_member);
-				switch_xml_set_attr_d(x_member, "type", "recording_node");
-				/* or:
-				x_member = switch_xml_add_child_d(x_members, "recording_node", moff++);
-				*/
-
-				x_tag = switch_xml_add_child_d(x_member, "record_path", count++);
-				switch_xml_set_txt_d(x_tag, member->rec_path);
-
-				x_tag = switch_xml_add_child_d(x_member, "join_time", count++);
-				switch_xml_set_attr_d(x_tag, "type", "UNIX-epoch");
-				switch_snprintf(i, sizeof(i), "%d", member->rec_time);
-				switch_xml_set_txt_d(x_tag, i);
-			}
 			continue;
 		}
 
@@ -4737,6 +5712,9 @@ static void conference_xlist(conference_obj_t *conference, switch_xml_t x_confer
 		x_tag = switch_xml_add_child_d(x_flags, "end_conference", count++);
 		switch_xml_set_txt_d(x_tag, switch_test_flag(member, MFLAG_ENDCONF) ? "true" : "false");
 
+		x_tag = switch_xml_add_child_d(x_flags, "is_cascade", count++);
+		switch_xml_set_txt_d(x_tag, switch_test_flag(member, MFLAG_CASCADE) ? "true" : "false");
+
 		switch_snprintf(tmp, sizeof(tmp), "%d", member->volume_out_level);
 		x_tag = add_x_tag(x_member, "output-volume", tmp, toff++);
 
@@ -4749,6 +5727,25 @@ static void conference_xlist(conference_obj_t *conference, switch_xml_t x_confer
 	}
 
 	switch_mutex_unlock(conference->member_mutex);
+
+	switch_mutex_lock(conference->mutex);
+	for (rec = conference->records; rec; rec = rec->next) {
+		uint32_t count = 0;
+		switch_xml_t x_tag;
+
+		x_member = switch_xml_add_child_d(x_members, "member", moff++);
+		switch_assert(x_member);
+		switch_xml_set_attr_d(x_member, "type", "recording_node");
+
+		x_tag = switch_xml_add_child_d(x_member, "record_path", count++);
+		switch_xml_set_txt_d(x_tag, rec->path);
+
+		x_tag = switch_xml_add_child_d(x_member, "join_time", count++);
+		switch_xml_set_attr_d(x_tag, "type", "UNIX-epoch");
+		switch_snprintf(i, sizeof(i), "%d", rec->member.rec_time);
+		switch_xml_set_txt_d(x_tag, i);
+	}
+	switch_mutex_unlock(conference->mutex);
 }
 static switch_status_t conf_api_sub_xml_list(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
 {
@@ -5256,6 +6253,44 @@ static switch_status_t conf_api_sub_bgdial(conference_obj_t *conference, switch_
 
 
 
+/* Link this conference to the same conference on another node, the other node runs the same command pointing back here */
+static switch_status_t conf_api_sub_cascade(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
+{
+	switch_uuid_t uuid;
+	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	char *local_port = NULL, *dialstr;
+	int relay = 0, x;
+
+	switch_assert(conference != NULL);
+	switch_assert(stream != NULL);
+
+	if (argc <= 2 || !strchr(argv[2], ':')) {
+		stream->write_function(stream, "Bad Args\n");
+		return SWITCH_STATUS_GENERR;
+	}
+
+	for (x = 3; x < argc; x++) {
+		if (!strcasecmp(argv[x], "relay")) {
+			relay = 1;
+		} else if (switch_is_number(argv[x])) {
+			local_port = argv[x];
+		}
+	}
+
+	dialstr = switch_mprintf("{cascade_rate=%u,cascade_interval=%u,cascade_relay=%s}cascade/%s%s%s",
+							 conference->rate, conference->interval, relay ? "true" : "false", argv[2], local_port ? "/" : "", switch_str_nil(local_port));
+
+	switch_uuid_get(&uuid);
+	switch_uuid_format(uuid_str, &uuid);
+
+	conference_outcall_bg(conference, NULL, NULL, dialstr, 60, NULL, "Cascade", argv[2], uuid_str, NULL, NULL);
+	switch_safe_free(dialstr);
+
+	stream->write_function(stream, "OK Job-UUID: %s\n", uuid_str);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static switch_status_t conf_api_sub_transfer(conference_obj_t *conference, switch_stream_handle_t *stream, int argc, char **argv)
 {
 	switch_status_t ret_status = SWITCH_STATUS_SUCCESS;
@@ -5342,7 +6377,7 @@ static switch_status_t conf_api_sub_record(conference_obj_t *conference, switch_
 	stream->write_function(stream, "Record file %s\n", argv[2]);
 	conference->record_filename = switch_core_strdup(conference->pool, argv[2]);
 	conference->record_count++;
-	launch_conference_record_thread(conference, argv[2]);
+	conference_record_start(conference, argv[2]);
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -5519,12 +6554,13 @@ typedef enum {
 	CONF_API_COMMAND_NOPIN,
 	CONF_API_COMMAND_GET,
 	CONF_API_COMMAND_SET,
+	CONF_API_COMMAND_CASCADE,
 } api_command_type_t;
 
 /* API Interface Function sub-commands */
 /* Entries in this list should be kept in sync with the enum above */
 static api_command_t conf_api_sub_commands[] = {
-	{"list", (void_fn_t) & conf_api_sub_list, CONF_API_SUB_ARGS_SPLIT, "list", "[delim <string>]|[count]"},
+	{"list", (void_fn_t) & conf_api_sub_list, CONF_API_SUB_ARGS_SPLIT, "list", "[delim <string>]|[count]|[cascade]"},
 	{"xml_list", (void_fn_t) & conf_api_sub_xml_list, CONF_API_SUB_ARGS_SPLIT, "xml_list", ""},
 	{"energy", (void_fn_t) & conf_api_sub_energy, CONF_API_SUB_MEMBER_TARGET, "energy", "<member_id|all|last|non_moderator> [<newval>]"},
 	{"volume_in", (void_fn_t) & conf_api_sub_volume_in, CONF_API_SUB_MEMBER_TARGET, "volume_in", "<member_id|all|last|non_moderator> [<newval>]"},
@@ -5556,6 +6592,7 @@ static api_command_t conf_api_sub_commands[] = {
 	{"nopin", (void_fn_t) & conf_api_sub_pin, CONF_API_SUB_ARGS_SPLIT, "nopin", ""},
 	{"get", (void_fn_t) & conf_api_sub_get, CONF_API_SUB_ARGS_SPLIT, "get", "<parameter-name>"},
 	{"set", (void_fn_t) & conf_api_sub_set, CONF_API_SUB_ARGS_SPLIT, "set", "<parameter-name> <value>"},
+	{"cascade", (void_fn_t) & conf_api_sub_cascade, CONF_API_SUB_ARGS_SPLIT, "cascade", "<host>:<port> [<local port>] [relay]"},
 };
 
 #define CONFFUNCAPISIZE (sizeof(conf_api_sub_commands)/sizeof(conf_api_sub_commands[0]))
@@ -6142,6 +7179,8 @@ static void set_cflags(const char *flags, uint32_t *f)
 				*f |= CFLAG_VIDEO_BRIDGE;
 			} else if (!strcasecmp(argv[i], "audio-always")) {
 				*f |= CFLAG_AUDIO_ALWAYS;
+			} else if (!strcasecmp(argv[i], "shared-encode")) {
+				*f |= CFLAG_SHARED_ENCODE;
 			}
 		}		
 
@@ -6330,13 +7369,20 @@ static int setup_media(conference_member_t *member, conference_obj_t *conference
 	}
 
 	/* Setup an audio buffer for the incoming audio */
-	if (switch_buffer_create_dynamic(&member->audio_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, CONF_DBUFFER_MAX) != SWITCH_STATUS_SUCCESS) {
+	if (switch_ringbuffer_create(&member->audio_buffer, CONF_RING_SIZE) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
 		goto codec_done1;
 	}
 
 	/* Setup an audio buffer for the outgoing audio */
-	if (switch_buffer_create_dynamic(&member->mux_buffer, CONF_DBLOCK_SIZE, CONF_DBUFFER_SIZE, CONF_DBUFFER_MAX) != SWITCH_STATUS_SUCCESS) {
+	if (switch_ringbuffer_create(&member->mux_buffer, CONF_RING_SIZE) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
+		goto codec_done1;
+	}
+
+	/* Setup a buffer for shared encoded audio */
+	if (switch_test_flag(conference, CFLAG_SHARED_ENCODE) && !member->enc_buffer &&
+		switch_ringbuffer_create(&member->enc_buffer, CONF_RING_SIZE) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(member->session), SWITCH_LOG_CRIT, "Memory Error Creating Audio Buffer!\n");
 		goto codec_done1;
 	}
@@ -6848,12 +7894,13 @@ SWITCH_STANDARD_APP(conference_function)
 
 	switch_event_destroy(&params);
 	switch_buffer_destroy(&member.resample_buffer);
-	switch_buffer_destroy(&member.audio_buffer);
-	switch_buffer_destroy(&member.mux_buffer);
+	switch_ringbuffer_destroy(&member.audio_buffer);
+	switch_ringbuffer_destroy(&member.mux_buffer);
+	switch_ringbuffer_destroy(&member.enc_buffer);
 
 	if (conference) {
 		switch_mutex_lock(conference->mutex);
-		if (switch_test_flag(conference, CFLAG_DYNAMIC) && conference->count == 0) {
+		if (switch_test_flag(conference, CFLAG_DYNAMIC) && conference->count == conference->cascade_count) {
 			switch_set_flag_locked(conference, CFLAG_DESTRUCT);
 		}
 		switch_mutex_unlock(conference->mutex);
@@ -6991,37 +8038,6 @@ static void launch_conference_video_mirror_thread(conference_member_t *member_a)
 	launch_thread_detached(conference_video_mirror_thread_run, pool, &conference->mh);
 }
 
-static void launch_conference_record_thread(conference_obj_t *conference, char *path)
-{
-	switch_thread_t *thread;
-	switch_threadattr_t *thd_attr = NULL;
-	switch_memory_pool_t *pool;
-	conference_record_t *rec;
-
-	/* Setup a memory pool to use. */
-	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Pool Failure\n");
-	}
-
-	/* Create a node object */
-	if (!(rec = switch_core_alloc(pool, sizeof(*rec)))) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Alloc Failure\n");
-		switch_core_destroy_memory_pool(&pool);
-		return;
-	}
-
-	conference->is_recording = 1;
-
-	rec->conference = conference;
-	rec->path = switch_core_strdup(pool, path);
-	rec->pool = pool;
-
-	switch_threadattr_create(&thd_attr, rec->pool);
-	switch_threadattr_detach_set(thd_attr, 1);
-	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-	switch_thread_create(&thread, thd_attr, conference_record_thread_run, rec, rec->pool);
-}
-
 static switch_status_t chat_send(switch_event_t *message_event)
 {
 	char name[512] = "", *p, *lbuf = NULL;
@@ -7148,6 +8164,8 @@ static conference_obj_t *conference_new(char *name, conf_xml_cfg_t cfg, switch_c
 	char *maxmember_sound = NULL;
 	uint32_t rate = 8000, interval = 20;
 	int comfort_noise_level = 0;
+	uint32_t mix_threads = 0, mix_thread_threshold = 100, max_active_speakers = 0;
+	uint32_t video_fanout_threads = 0, video_fanout_threshold = 16;
 	int pin_retries = 3;
 	int ivr_dtmf_timeout = 500;
 	int ivr_input_timeout = 0;
@@ -7336,6 +8354,37 @@ static conference_obj_t *conference_new(char *name, conf_xml_cfg_t cfg, switch_c
 				} else if (switch_true(val)) {
 					comfort_noise_level = 1400;
 				}
+			} else if (!strcasecmp(var, "mix-threads") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp >= 0 && tmp <= 64) {
+					mix_threads = (uint32_t) tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "mix-threads must be between 0 and 64\n");
+				}
+			} else if (!strcasecmp(var, "max-active-speakers") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp >= 0 && tmp <= CONF_MAX_ACTIVE_SPEAKERS) {
+					max_active_speakers = (uint32_t) tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "max-active-speakers must be between 0 and %d\n", CONF_MAX_ACTIVE_SPEAKERS);
+				}
+			} else if (!strcasecmp(var, "video-fanout-threads") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp >= 0 && tmp <= 32) {
+					video_fanout_threads = (uint32_t) tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "video-fanout-threads must be between 0 and 32\n");
+				}
+			} else if (!strcasecmp(var, "video-fanout-threshold") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp > 1) {
+					video_fanout_threshold = (uint32_t) tmp;
+				}
+			} else if (!strcasecmp(var, "mix-thread-threshold") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp > 1) {
+					mix_thread_threshold = (uint32_t) tmp;
+				}
 			} else if (!strcasecmp(var, "sound-prefix") && !zstr(val)) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "override sound-prefix with: %s\n", val);
 				sound_prefix = val;
@@ -7420,6 +8469,11 @@ static conference_obj_t *conference_new(char *name, conf_xml_cfg_t cfg, switch_c
 	}
 
 	conference->comfort_noise_level = comfort_noise_level;
+	conference->mix_threads = mix_threads;
+	conference->mix_thread_threshold = mix_thread_threshold;
+	conference->max_active_speakers = max_active_speakers;
+	conference->video_fanout_threads = video_fanout_threads;
+	conference->video_fanout_threshold = video_fanout_threshold;
 	conference->pin_retries = pin_retries;
 	conference->caller_id_name = switch_core_strdup(conference->pool, caller_id_name);
 	conference->caller_id_number = switch_core_strdup(conference->pool, caller_id_number);
@@ -7618,6 +8672,7 @@ static conference_obj_t *conference_new(char *name, conf_xml_cfg_t cfg, switch_c
 	
 	/* Activate the conference mutex for exclusivity */
 	switch_mutex_init(&conference->mutex, SWITCH_MUTEX_NESTED, conference->pool);
+	switch_mutex_init(&conference->encode_mutex, SWITCH_MUTEX_NESTED, conference->pool);
 	switch_mutex_init(&conference->flag_mutex, SWITCH_MUTEX_NESTED, conference->pool);
 	switch_thread_rwlock_create(&conference->rwlock, conference->pool);
 	switch_mutex_init(&conference->member_mutex, SWITCH_MUTEX_NESTED, conference->pool);
@@ -7919,6 +8974,489 @@ static void member_bind_controls(conference_member_t *member, const char *contro
 
 
 /* Called by FreeSWITCH when the module loads */
+/* Cascade endpoint: cascade/<host>:<port>[/<local port>] is one end of a link to the same conference on another node.
+   Both nodes dial each other with matching ports, the link joins the local conference like any caller. */
+static switch_endpoint_interface_t *cascade_endpoint_interface = NULL;
+
+static switch_status_t cascade_on_init(switch_core_session_t *session)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+
+	/* nothing to negotiate, the link is up as soon as the socket is, the originator moves it on to the conference */
+	switch_channel_mark_answered(channel);
+	switch_channel_set_state(channel, CS_CONSUME_MEDIA);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t cascade_on_destroy(switch_core_session_t *session)
+{
+	conference_cascade_t *tech_pvt = switch_core_session_get_private(session);
+
+	if (tech_pvt) {
+		if (tech_pvt->sock) {
+			switch_socket_close(tech_pvt->sock);
+			tech_pvt->sock = NULL;
+		}
+
+		if (tech_pvt->timer.interval) {
+			switch_core_timer_destroy(&tech_pvt->timer);
+		}
+
+		if (switch_core_codec_ready(&tech_pvt->read_codec)) {
+			switch_core_codec_destroy(&tech_pvt->read_codec);
+		}
+
+		if (switch_core_codec_ready(&tech_pvt->write_codec)) {
+			switch_core_codec_destroy(&tech_pvt->write_codec);
+		}
+
+		switch_buffer_destroy(&tech_pvt->jb);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t cascade_kill_channel(switch_core_session_t *session, int sig)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+
+	if (sig == SWITCH_SIG_KILL) {
+		switch_channel_hangup(channel, SWITCH_CAUSE_NORMAL_CLEARING);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* Take in whatever the peer sent since the last tick, the caller holds tech_pvt->mutex */
+static void cascade_receive(conference_cascade_t *tech_pvt)
+{
+	conference_cascade_hdr_t hdr;
+	uint32_t bytes = tech_pvt->read_codec.implementation->decoded_bytes_per_packet;
+	int16_t pcm[SWITCH_RECOMMENDED_BUFFER_SIZE / 2];
+
+	for (;;) {
+		switch_size_t len = sizeof(tech_pvt->pktbuf);
+		uint8_t *p;
+		uint32_t i, samples;
+		int32_t diff;
+
+		if (switch_socket_recvfrom(tech_pvt->from_addr, tech_pvt->sock, 0, (char *) tech_pvt->pktbuf, &len) != SWITCH_STATUS_SUCCESS || !len) {
+			break;
+		}
+
+		if (!switch_cmp_addr(tech_pvt->from_addr, tech_pvt->remote_addr) || len < sizeof(hdr)) {
+			continue;
+		}
+
+		memcpy(&hdr, tech_pvt->pktbuf, sizeof(hdr));
+		hdr.seq = ntohl(hdr.seq);
+		hdr.members = ntohs(hdr.members);
+		samples = ntohs(hdr.samples);
+
+		if (hdr.magic != CONF_CASCADE_MAGIC || hdr.version != CONF_CASCADE_VERSION || sizeof(hdr) + hdr.meta_len + samples * 2 > len) {
+			continue;
+		}
+
+		diff = (int32_t) (hdr.seq - tech_pvt->rx_seq);
+
+		if (tech_pvt->rx_started && diff <= 0) {
+			tech_pvt->rx_late++;
+			continue;
+		}
+
+		if (tech_pvt->rx_started && diff > 1) {
+			tech_pvt->rx_lost += diff - 1;
+		}
+
+		tech_pvt->rx_started = 1;
+		tech_pvt->rx_seq = hdr.seq;
+		tech_pvt->rx_packets++;
+		tech_pvt->last_rx = switch_micro_time_now();
+		tech_pvt->remote_members = hdr.members;
+		tech_pvt->remote_talking = (hdr.flags & CASCADE_FLAG_TALKING) ? 1 : 0;
+
+		p = tech_pvt->pktbuf + sizeof(hdr);
+
+		if ((hdr.flags & CASCADE_FLAG_META) && hdr.meta_len) {
+			char meta[256], *speaker;
+
+			memcpy(meta, p, hdr.meta_len);
+			meta[hdr.meta_len] = '\0';
+
+			if ((speaker = strchr(meta, '\n'))) {
+				*speaker++ = '\0';
+			} else {
+				speaker = "";
+			}
+
+			switch_copy_string(tech_pvt->remote_node, meta, sizeof(tech_pvt->remote_node));
+
+			if (strcmp(tech_pvt->remote_speaker, speaker)) {
+				switch_copy_string(tech_pvt->remote_speaker, speaker, sizeof(tech_pvt->remote_speaker));
+				tech_pvt->speaker_changed = 1;
+			}
+		}
+
+		p += hdr.meta_len;
+
+		if (!samples) {
+			continue;
+		}
+
+		if (samples > sizeof(pcm) / 2) {
+			samples = sizeof(pcm) / 2;
+		}
+
+		memcpy(pcm, p, samples * 2);
+		for (i = 0; i < samples; i++) {
+			pcm[i] = (int16_t) ntohs((uint16_t) pcm[i]);
+		}
+
+		switch_buffer_write(tech_pvt->jb, pcm, samples * 2);
+
+		/* the peer's clock runs ahead of ours or a burst came in, keep the delay down to a couple of frames */
+		if (switch_buffer_inuse(tech_pvt->jb) > tech_pvt->jb_max) {
+			switch_buffer_toss(tech_pvt->jb, switch_buffer_inuse(tech_pvt->jb) - bytes * 2);
+		}
+	}
+}
+
+static switch_status_t cascade_read_frame(switch_core_session_t *session, switch_frame_t **frame, switch_io_flag_t flags, int stream_id)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	conference_cascade_t *tech_pvt = switch_core_session_get_private(session);
+	uint32_t bytes = tech_pvt->read_codec.implementation->decoded_bytes_per_packet;
+	conference_member_t *member = NULL;
+	char speaker[sizeof(tech_pvt->remote_speaker)] = "";
+	int changed = 0;
+
+	*frame = NULL;
+
+	if (!switch_channel_ready(channel)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_core_timer_next(&tech_pvt->timer);
+
+	switch_mutex_lock(tech_pvt->mutex);
+	cascade_receive(tech_pvt);
+
+	tech_pvt->read_frame.codec = &tech_pvt->read_codec;
+	tech_pvt->read_frame.datalen = bytes;
+	tech_pvt->read_frame.samples = bytes / 2;
+
+	if (switch_buffer_inuse(tech_pvt->jb) >= bytes) {
+		switch_buffer_read(tech_pvt->jb, tech_pvt->databuf, bytes);
+		switch_clear_flag((&tech_pvt->read_frame), SFF_CNG);
+	} else {
+		memset(tech_pvt->databuf, 0, bytes);
+		switch_set_flag((&tech_pvt->read_frame), SFF_CNG);
+	}
+
+	if (tech_pvt->speaker_changed) {
+		tech_pvt->speaker_changed = 0;
+		switch_copy_string(speaker, tech_pvt->remote_speaker, sizeof(speaker));
+		member = tech_pvt->member;
+		changed = 1;
+	}
+	switch_mutex_unlock(tech_pvt->mutex);
+
+	if (tech_pvt->rx_started && tech_pvt->timeout && switch_micro_time_now() - tech_pvt->last_rx > (switch_time_t) tech_pvt->timeout * 1000000) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Nothing from %s for %u seconds, dropping the link\n",
+						  switch_channel_get_name(channel), tech_pvt->timeout);
+		switch_channel_hangup(channel, SWITCH_CAUSE_MEDIA_TIMEOUT);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (changed && member && member->conference && test_eflag(member->conference, EFLAG_FLOOR_CHANGE)) {
+		switch_event_t *event;
+
+		if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, CONF_EVENT_MAINT) == SWITCH_STATUS_SUCCESS) {
+			conference_add_event_member_data(member, event);
+			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Action", "cascade-floor-change");
+			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Cascade-Node", tech_pvt->remote_node);
+			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Cascade-Speaker", zstr(speaker) ? "none" : speaker);
+			switch_event_fire(&event);
+		}
+	}
+
+	*frame = &tech_pvt->read_frame;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* What this node tells the peer about itself: member count and who holds the floor here */
+static int cascade_build_meta(conference_cascade_t *tech_pvt, conference_member_t *member, char *meta, switch_size_t len, uint16_t *members, uint8_t *flags)
+{
+	conference_obj_t *conference = member->conference;
+	conference_member_t *floor;
+	const char *speaker = "";
+	char relayed[sizeof(tech_pvt->remote_speaker)] = "";
+	int send_meta = 0;
+
+	if (!conference) {
+		return 0;
+	}
+
+	*members = (uint16_t) (conference->count - conference->cascade_count);
+
+	switch_mutex_lock(conference->member_mutex);
+	floor = conference->floor_holder;
+
+	if (floor && switch_test_flag(floor, MFLAG_TALKING)) {
+		*flags |= CASCADE_FLAG_TALKING;
+	}
+
+	if (floor != tech_pvt->last_floor || !tech_pvt->meta_countdown) {
+		if (floor && floor != member) {
+			if (switch_test_flag(floor, MFLAG_CASCADE)) {
+				conference_cascade_t *other = switch_channel_get_private(switch_core_session_get_channel(floor->session), CONF_CASCADE_PRIVATE);
+
+				if (other) {
+					switch_mutex_lock(other->mutex);
+					switch_copy_string(relayed, other->remote_speaker, sizeof(relayed));
+					switch_mutex_unlock(other->mutex);
+					speaker = relayed;
+				}
+			} else {
+				speaker = switch_channel_get_caller_profile(switch_core_session_get_channel(floor->session))->caller_id_name;
+			}
+		}
+
+		switch_snprintf(meta, len, "%s\n%s", switch_core_get_switchname(), switch_str_nil(speaker));
+		tech_pvt->last_floor = floor;
+		tech_pvt->meta_countdown = CONF_CASCADE_META_EVERY;
+		*flags |= CASCADE_FLAG_META;
+		send_meta = 1;
+	} else {
+		tech_pvt->meta_countdown--;
+	}
+
+	switch_mutex_unlock(conference->member_mutex);
+
+	return send_meta;
+}
+
+static switch_status_t cascade_write_frame(switch_core_session_t *session, switch_frame_t *frame, switch_io_flag_t flags, int stream_id)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	conference_cascade_t *tech_pvt = switch_core_session_get_private(session);
+	conference_cascade_hdr_t hdr = { 0 };
+	conference_member_t *member;
+	char meta[256] = "";
+	uint16_t members = 0;
+	uint32_t samples = 0, i;
+	int16_t *in, *out;
+	switch_size_t len;
+
+	if (!switch_channel_ready(channel)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* only the session thread writes and it is also the one that leaves the conference, so the member stays put here */
+	switch_mutex_lock(tech_pvt->mutex);
+	member = tech_pvt->member;
+	switch_mutex_unlock(tech_pvt->mutex);
+
+	hdr.magic = CONF_CASCADE_MAGIC;
+	hdr.version = CONF_CASCADE_VERSION;
+
+	if (member && cascade_build_meta(tech_pvt, member, meta, sizeof(meta), &members, &hdr.flags)) {
+		hdr.meta_len = (uint8_t) strlen(meta);
+	}
+
+	/* silence goes out as a bare header, it keeps the link and the metadata alive for a few bytes */
+	if (!switch_test_flag(frame, SFF_CNG) && frame->datalen) {
+		samples = frame->datalen / 2;
+	}
+
+	if (sizeof(hdr) + hdr.meta_len + samples * 2 > sizeof(tech_pvt->pktbuf)) {
+		samples = (sizeof(tech_pvt->pktbuf) - sizeof(hdr) - hdr.meta_len) / 2;
+	}
+
+	hdr.seq = htonl(++tech_pvt->tx_seq);
+	hdr.members = htons(members);
+	hdr.samples = htons((uint16_t) samples);
+
+	memcpy(tech_pvt->pktbuf, &hdr, sizeof(hdr));
+	memcpy(tech_pvt->pktbuf + sizeof(hdr), meta, hdr.meta_len);
+
+	in = (int16_t *) frame->data;
+	out = (int16_t *) (tech_pvt->pktbuf + sizeof(hdr) + hdr.meta_len);
+	for (i = 0; i < samples; i++) {
+		int16_t sample = (int16_t) htons((uint16_t) in[i]);
+		memcpy(out + i, &sample, sizeof(sample));
+	}
+
+	len = sizeof(hdr) + hdr.meta_len + samples * 2;
+	switch_socket_sendto(tech_pvt->sock, tech_pvt->remote_addr, 0, (char *) tech_pvt->pktbuf, &len);
+	tech_pvt->tx_packets++;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t cascade_receive_message(switch_core_session_t *session, switch_core_session_message_t *msg)
+{
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t cascade_tech_init(conference_cascade_t *tech_pvt, switch_core_session_t *session, switch_event_t *var_event, char *dest)
+{
+	switch_memory_pool_t *pool = switch_core_session_get_pool(session);
+	uint32_t rate = 8000, interval = 20;
+	switch_port_t port, local_port;
+	char *host, *p, *colon;
+	const char *var;
+
+	if ((var = switch_event_get_header(var_event, "cascade_rate")) && atoi(var) > 0) {
+		rate = atoi(var);
+	}
+
+	if ((var = switch_event_get_header(var_event, "cascade_interval")) && atoi(var) > 0) {
+		interval = atoi(var);
+	}
+
+	tech_pvt->timeout = 10;
+	if ((var = switch_event_get_header(var_event, "cascade_timeout"))) {
+		tech_pvt->timeout = atoi(var);
+	}
+
+	tech_pvt->relay = switch_true(switch_event_get_header(var_event, "cascade_relay"));
+
+	host = dest;
+	if ((p = strchr(host, '/'))) {
+		*p++ = '\0';
+	}
+
+	if (!(colon = strrchr(host, ':')) || !(port = (switch_port_t) atoi(colon + 1))) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Invalid cascade destination [%s], try <host>:<port>[/<local port>]\n", dest);
+		return SWITCH_STATUS_FALSE;
+	}
+	*colon = '\0';
+
+	local_port = p ? (switch_port_t) atoi(p) : port;
+
+	if (switch_sockaddr_info_get(&tech_pvt->remote_addr, host, SWITCH_UNSPEC, port, 0, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_sockaddr_info_get(&tech_pvt->from_addr, NULL, SWITCH_UNSPEC, 0, 0, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Cannot resolve cascade peer %s\n", host);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	{
+		switch_sockaddr_t *local_addr;
+
+		if (switch_sockaddr_info_get(&local_addr, NULL, switch_sockaddr_get_family(tech_pvt->remote_addr), local_port, 0, pool) != SWITCH_STATUS_SUCCESS ||
+			switch_socket_create(&tech_pvt->sock, switch_sockaddr_get_family(tech_pvt->remote_addr), SOCK_DGRAM, 0, pool) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Cannot create the cascade socket\n");
+			return SWITCH_STATUS_FALSE;
+		}
+
+		switch_socket_opt_set(tech_pvt->sock, SWITCH_SO_REUSEADDR, 1);
+
+		if (switch_socket_bind(tech_pvt->sock, local_addr) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Cannot bind the cascade socket to port %u\n", local_port);
+			return SWITCH_STATUS_FALSE;
+		}
+
+		switch_socket_opt_set(tech_pvt->sock, SWITCH_SO_NONBLOCK, TRUE);
+	}
+
+	if (switch_core_codec_init(&tech_pvt->read_codec, "L16", NULL, rate, interval, 1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE,
+							   NULL, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_core_codec_init(&tech_pvt->write_codec, "L16", NULL, rate, interval, 1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE,
+							   NULL, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Cannot set up L16@%uhz %ums\n", rate, interval);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (switch_core_timer_init(&tech_pvt->timer, "soft", interval, tech_pvt->read_codec.implementation->samples_per_packet, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Cannot set up the cascade timer\n");
+		return SWITCH_STATUS_FALSE;
+	}
+
+	tech_pvt->jb_max = tech_pvt->read_codec.implementation->decoded_bytes_per_packet * 6;
+	switch_buffer_create_dynamic(&tech_pvt->jb, tech_pvt->jb_max, tech_pvt->jb_max, 0);
+
+	tech_pvt->read_frame.data = tech_pvt->databuf;
+	tech_pvt->read_frame.buflen = sizeof(tech_pvt->databuf);
+
+	switch_mutex_init(&tech_pvt->mutex, SWITCH_MUTEX_NESTED, pool);
+	tech_pvt->session = session;
+	tech_pvt->channel = switch_core_session_get_channel(session);
+	switch_core_session_set_private(session, tech_pvt);
+	switch_core_session_set_read_codec(session, &tech_pvt->read_codec);
+	switch_core_session_set_write_codec(session, &tech_pvt->write_codec);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_call_cause_t cascade_outgoing_channel(switch_core_session_t *session, switch_event_t *var_event,
+													switch_caller_profile_t *outbound_profile,
+													switch_core_session_t **new_session, switch_memory_pool_t **pool, switch_originate_flag_t flags,
+													switch_call_cause_t *cancel_cause)
+{
+	conference_cascade_t *tech_pvt;
+	switch_channel_t *channel;
+	switch_caller_profile_t *caller_profile;
+	char name[128];
+
+	if (!outbound_profile || zstr(outbound_profile->destination_number)) {
+		return SWITCH_CAUSE_INVALID_NUMBER_FORMAT;
+	}
+
+	if (!(*new_session = switch_core_session_request(cascade_endpoint_interface, SWITCH_CALL_DIRECTION_OUTBOUND, flags, pool))) {
+		return SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER;
+	}
+
+	switch_core_session_add_stream(*new_session, NULL);
+	channel = switch_core_session_get_channel(*new_session);
+	tech_pvt = (conference_cascade_t *) switch_core_session_alloc(*new_session, sizeof(*tech_pvt));
+
+	if (cascade_tech_init(tech_pvt, *new_session, var_event, switch_core_session_strdup(*new_session, outbound_profile->destination_number)) != SWITCH_STATUS_SUCCESS) {
+		switch_core_session_set_private(*new_session, tech_pvt);
+		switch_core_session_destroy(new_session);
+		return SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER;
+	}
+
+	switch_snprintf(name, sizeof(name), "cascade/%s", outbound_profile->destination_number);
+	switch_channel_set_name(channel, name);
+
+	caller_profile = switch_caller_profile_clone(*new_session, outbound_profile);
+	switch_channel_set_caller_profile(channel, caller_profile);
+
+	switch_channel_set_private(channel, CONF_CASCADE_PRIVATE, tech_pvt);
+	/* the link is not a caller, no enter sound or member count announcement for it */
+	switch_channel_set_variable(channel, "conference_silent_entry", "true");
+	switch_channel_set_state(channel, CS_INIT);
+
+	return SWITCH_CAUSE_SUCCESS;
+}
+
+static switch_state_handler_table_t cascade_event_handlers = {
+	/*.on_init */ cascade_on_init,
+	/*.on_routing */ NULL,
+	/*.on_execute */ NULL,
+	/*.on_hangup */ NULL,
+	/*.on_exchange_media */ NULL,
+	/*.on_soft_execute */ NULL,
+	/*.on_consume_media */ NULL,
+	/*.on_hibernate */ NULL,
+	/*.on_reset */ NULL,
+	/*.on_park */ NULL,
+	/*.on_reporting */ NULL,
+	/*.on_destroy */ cascade_on_destroy
+};
+
+static switch_io_routines_t cascade_io_routines = {
+	/*.outgoing_channel */ cascade_outgoing_channel,
+	/*.read_frame */ cascade_read_frame,
+	/*.write_frame */ cascade_write_frame,
+	/*.kill_channel */ cascade_kill_channel,
+	/*.send_dtmf */ NULL,
+	/*.receive_message */ cascade_receive_message
+};
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_conference_load)
 {
 	uint32_t i;
@@ -7986,6 +9524,11 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_conference_load)
 	switch_mutex_init(&globals.hash_mutex, SWITCH_MUTEX_NESTED, globals.conference_pool);
 	switch_mutex_init(&globals.setup_mutex, SWITCH_MUTEX_NESTED, globals.conference_pool);
 
+	cascade_endpoint_interface = switch_loadable_module_create_interface(*module_interface, SWITCH_ENDPOINT_INTERFACE);
+	cascade_endpoint_interface->interface_name = "cascade";
+	cascade_endpoint_interface->io_routines = &cascade_io_routines;
+	cascade_endpoint_interface->state_handler = &cascade_event_handlers;
+
 	/* Subscribe to presence request events */
 	if (switch_event_bind_removable(modname, SWITCH_EVENT_PRESENCE_PROBE, SWITCH_EVENT_SUBCLASS_ANY, pres_event_handler, NULL, &globals.node) !=
 		SWITCH_STATUS_SUCCESS) {
@@ -2370,6 +2370,8 @@ SWITCH_STANDARD_APP(play_and_get_digits_function)
 	switch_play_and_get_digits(session, min_digits, max_digits, max_tries, timeout, valid_terminators,
 							   prompt_audio_file, bad_input_audio_file, var_name, digit_buffer, sizeof(digit_buffer), 
 							   digits_regex, digit_timeout, transfer_on_failure);
+
+	switch_channel_set_variable(switch_core_session_get_channel(session), SWITCH_CURRENT_APPLICATION_RESPONSE_VARIABLE, digit_buffer);
 }
 
 #define SAY_SYNTAX "<module_name>[:<lang>] <say_type> <say_method> [<say_gender>] <text>"
@@ -4110,6 +4112,36 @@ SWITCH_STANDARD_APP(session_loglevel_function)
 	}
 }
 
+#define PREFIX_LOOKUP_SYNTAX "<table> <number> [<variable>]"
+SWITCH_STANDARD_APP(prefix_lookup_function)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	char *mydata, *argv[3] = { 0 };
+	const char *var;
+	char value[1024] = "";
+	switch_size_t matched = 0;
+	switch_status_t status;
+
+	if (zstr(data) || !(mydata = switch_core_session_strdup(session, data)) ||
+		switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0]))) < 2) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "USAGE: prefix_lookup %s\n", PREFIX_LOOKUP_SYNTAX);
+		return;
+	}
+
+	var = zstr(argv[2]) ? "prefix_lookup_result" : argv[2];
+
+	if ((status = switch_prefix_lookup(argv[0], argv[1], value, sizeof(value), &matched)) == SWITCH_STATUS_SUCCESS) {
+		switch_channel_set_variable(channel, var, value);
+		switch_channel_set_variable_printf(channel, switch_core_session_sprintf(session, "%s_length", var), "%d", (int) matched);
+	} else {
+		if (status == SWITCH_STATUS_FALSE) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "No such prefix table %s\n", argv[0]);
+		}
+		switch_channel_set_variable(channel, var, NULL);
+		switch_channel_set_variable(channel, switch_core_session_sprintf(session, "%s_length", var), NULL);
+	}
+}
+
 /* LIMIT STUFF */
 #define LIMIT_USAGE "<backend> <realm> <id> [<max>[/interval]] [number [dialplan [context]]]"
 #define LIMIT_DESC "limit access to a resource and transfer to an extension if the limit is exceeded"
@@ -4726,6 +4758,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_dptools_load)
 	SWITCH_ADD_APP(app_interface, "session_loglevel", "session_loglevel", "session_loglevel", session_loglevel_function, SESSION_LOGLEVEL_SYNTAX,
 				   SAF_SUPPORT_NOMEDIA);
 	SWITCH_ADD_APP(app_interface, "limit", "Limit", LIMIT_DESC, limit_function, LIMIT_USAGE, SAF_SUPPORT_NOMEDIA);
+	SWITCH_ADD_APP(app_interface, "prefix_lookup", "Longest prefix match", "Set a variable to the value of the longest prefix of a number in a prefix.conf table",
+				   prefix_lookup_function, PREFIX_LOOKUP_SYNTAX, SAF_SUPPORT_NOMEDIA | SAF_ROUTING_EXEC);
 	SWITCH_ADD_APP(app_interface, "limit_hash", "Limit", LIMIT_HASH_DESC, limit_hash_function, LIMIT_HASH_USAGE, SAF_SUPPORT_NOMEDIA);
 	SWITCH_ADD_APP(app_interface, "limit_execute", "Limit", LIMITEXECUTE_DESC, limit_execute_function, LIMITEXECUTE_USAGE, SAF_SUPPORT_NOMEDIA);
 	SWITCH_ADD_APP(app_interface, "limit_hash_execute", "Limit", LIMITHASHEXECUTE_DESC, limit_hash_execute_function, LIMITHASHEXECUTE_USAGE, SAF_SUPPORT_NOMEDIA);
@@ -572,6 +572,40 @@ static switch_status_t consumer_read_frame_callback(switch_core_session_t *sessi
 
 struct fifo_node;
 
+/* One row of fifo_outbound, only what picking a consumer needs.  Rows sharing a uuid
+   (one member listed in several fifos) are chained so per uuid updates touch them all
+   like the sql "where uuid=" did. */
+typedef struct fifo_outbound {
+	char *uuid;
+	char *fifo_name;
+	char *originate_string;
+	char *hostname;
+	int simo_count;
+	int use_count;
+	int ring_count;
+	int timeout;
+	int lag;
+	int taking_calls;
+	int is_static;
+	long next_avail;
+	int outbound_call_count;
+	int outbound_fail_count;
+	struct fifo_outbound *next;
+	struct fifo_outbound *uuid_next;
+} fifo_outbound_t;
+
+#define OUTBOUND_RING_INC  (1 << 0)
+#define OUTBOUND_RING_DEC  (1 << 1)
+#define OUTBOUND_USE_INC   (1 << 2)
+#define OUTBOUND_USE_DEC   (1 << 3)
+#define OUTBOUND_FAIL      (1 << 4)
+#define OUTBOUND_FAIL_CLR  (1 << 5)
+#define OUTBOUND_CALL      (1 << 6)
+#define OUTBOUND_LAG       (1 << 7)
+
+#define SQL_QUEUE_SIZE 10000
+#define SQL_BATCH_MAX 500
+
 static struct {
 	switch_hash_t *caller_orig_hash;
 	switch_hash_t *consumer_orig_hash;
@@ -596,6 +630,13 @@ static struct {
 	switch_thread_t *node_thread;
 	int debug;
 	struct fifo_node *nodes;
+	int memory_routing;
+	switch_hash_t *outbound_hash;
+	switch_hash_t *outbound_fifo_hash;
+	switch_mutex_t *outbound_mutex;
+	switch_queue_t *sql_queue;
+	switch_thread_t *sql_thread;
+	int sql_thread_running;
 } globals;
 
 
@@ -813,6 +854,429 @@ static switch_bool_t fifo_execute_sql_callback(switch_mutex_t *mutex, char *sql,
 	return ret;
 }
 
+static void fifo_execute_sql_trans(char *sql)
+{
+	switch_cache_db_handle_t *dbh = NULL;
+
+	switch_mutex_lock(globals.sql_mutex);
+
+	if (!(dbh = fifo_get_db_handle())) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening DB\n");
+		goto end;
+	}
+
+	if (globals.debug > 1) switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "sql: %s\n", sql);
+
+	if (switch_cache_db_persistant_execute_trans(dbh, sql, 1) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to commit fifo transaction, records lost!\n");
+	}
+
+  end:
+
+	switch_cache_db_release_db_handle(&dbh);
+	switch_mutex_unlock(globals.sql_mutex);
+}
+
+static void *SWITCH_THREAD_FUNC sql_thread_run(switch_thread_t *thread, void *obj)
+{
+	switch_stream_handle_t stream = { 0 };
+	void *pop = NULL;
+	int n, stop = 0;
+
+	globals.sql_thread_running = 1;
+
+	while (!stop) {
+		if (switch_queue_pop(globals.sql_queue, &pop) != SWITCH_STATUS_SUCCESS || !pop) {
+			break;
+		}
+
+		SWITCH_STANDARD_STREAM(stream);
+		n = 0;
+
+		while (pop) {
+			stream.write_function(&stream, "%s;\n", (char *) pop);
+			free(pop);
+			pop = NULL;
+
+			if (++n == SQL_BATCH_MAX || switch_queue_trypop(globals.sql_queue, &pop) != SWITCH_STATUS_SUCCESS) {
+				break;
+			}
+
+			if (!pop) {
+				stop = 1;
+			}
+		}
+
+		fifo_execute_sql_trans((char *) stream.data);
+		switch_safe_free(stream.data);
+	}
+
+	globals.sql_thread_running = 0;
+
+	while (switch_queue_trypop(globals.sql_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		if (pop) {
+			fifo_execute_sql((char *) pop, globals.sql_mutex);
+			free(pop);
+		}
+	}
+
+	return NULL;
+}
+
+static void start_sql_thread(switch_memory_pool_t *pool)
+{
+	switch_threadattr_t *thd_attr = NULL;
+
+	switch_queue_create(&globals.sql_queue, SQL_QUEUE_SIZE, pool);
+	globals.sql_thread_running = 1;
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&globals.sql_thread, thd_attr, sql_thread_run, NULL, pool);
+}
+
+static void stop_sql_thread(void)
+{
+	switch_status_t st = SWITCH_STATUS_SUCCESS;
+
+	if (!globals.sql_thread) {
+		return;
+	}
+
+	switch_queue_push(globals.sql_queue, NULL);
+	switch_thread_join(&st, globals.sql_thread);
+	globals.sql_thread = NULL;
+}
+
+/* The tables are only read back for reporting once the outbound members live in memory,
+   so runtime writes go to the sql thread in order.  Takes ownership of *sqlp. */
+static void fifo_execute_sql_queued(char **sqlp)
+{
+	char *sql = *sqlp;
+
+	*sqlp = NULL;
+
+	if (!sql) {
+		return;
+	}
+
+	if (globals.sql_thread_running == 1) {
+		switch_queue_push(globals.sql_queue, sql);
+		return;
+	}
+
+	fifo_execute_sql(sql, globals.sql_mutex);
+	free(sql);
+}
+
+static fifo_outbound_t *outbound_find(const char *fifo_name, const char *uuid)
+{
+	fifo_outbound_t *ob;
+
+	for (ob = switch_core_hash_find(globals.outbound_hash, uuid); ob; ob = ob->uuid_next) {
+		if (!strcmp(ob->fifo_name, fifo_name)) {
+			break;
+		}
+	}
+
+	return ob;
+}
+
+static void outbound_unlink(fifo_outbound_t *ob)
+{
+	fifo_outbound_t *p, *last = NULL;
+
+	for (p = switch_core_hash_find(globals.outbound_fifo_hash, ob->fifo_name); p && p != ob; p = p->next) {
+		last = p;
+	}
+
+	if (p) {
+		if (last) {
+			last->next = ob->next;
+		} else if (ob->next) {
+			switch_core_hash_insert(globals.outbound_fifo_hash, ob->fifo_name, ob->next);
+		} else {
+			switch_core_hash_delete(globals.outbound_fifo_hash, ob->fifo_name);
+		}
+	}
+
+	last = NULL;
+	for (p = switch_core_hash_find(globals.outbound_hash, ob->uuid); p && p != ob; p = p->uuid_next) {
+		last = p;
+	}
+
+	if (p) {
+		if (last) {
+			last->uuid_next = ob->uuid_next;
+		} else if (ob->uuid_next) {
+			switch_core_hash_insert(globals.outbound_hash, ob->uuid, ob->uuid_next);
+		} else {
+			switch_core_hash_delete(globals.outbound_hash, ob->uuid);
+		}
+	}
+
+	switch_safe_free(ob->uuid);
+	switch_safe_free(ob->fifo_name);
+	switch_safe_free(ob->originate_string);
+	switch_safe_free(ob->hostname);
+	free(ob);
+}
+
+/* Insert or replace the (fifo_name, uuid) row, the strings in tmpl are copied */
+static void outbound_add(const fifo_outbound_t *tmpl)
+{
+	fifo_outbound_t *ob;
+
+	switch_zmalloc(ob, sizeof(*ob));
+	*ob = *tmpl;
+	ob->uuid = strdup(tmpl->uuid);
+	ob->fifo_name = strdup(tmpl->fifo_name);
+	ob->originate_string = strdup(switch_str_nil(tmpl->originate_string));
+	ob->hostname = strdup(switch_str_nil(tmpl->hostname));
+
+	switch_mutex_lock(globals.outbound_mutex);
+	{
+		fifo_outbound_t *old;
+
+		if ((old = outbound_find(ob->fifo_name, ob->uuid))) {
+			outbound_unlink(old);
+		}
+	}
+	ob->next = switch_core_hash_find(globals.outbound_fifo_hash, ob->fifo_name);
+	switch_core_hash_insert(globals.outbound_fifo_hash, ob->fifo_name, ob);
+	ob->uuid_next = switch_core_hash_find(globals.outbound_hash, ob->uuid);
+	switch_core_hash_insert(globals.outbound_hash, ob->uuid, ob);
+	switch_mutex_unlock(globals.outbound_mutex);
+}
+
+static void outbound_del(const char *fifo_name, const char *uuid, const char *hostname)
+{
+	fifo_outbound_t *ob;
+
+	switch_mutex_lock(globals.outbound_mutex);
+	if ((ob = outbound_find(fifo_name, uuid)) && (!hostname || !strcmp(ob->hostname, hostname))) {
+		outbound_unlink(ob);
+	}
+	switch_mutex_unlock(globals.outbound_mutex);
+}
+
+/* Mirrors "delete from fifo_outbound where [static=1 and] hostname=..." */
+static void outbound_del_host(const char *hostname, switch_bool_t static_only)
+{
+	switch_hash_index_t *hi;
+	fifo_outbound_t *ob, **doomed = NULL;
+	void *val;
+	int i, n = 0, len = 0;
+
+	switch_mutex_lock(globals.outbound_mutex);
+	for (hi = switch_hash_first(NULL, globals.outbound_fifo_hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		for (ob = (fifo_outbound_t *) val; ob; ob = ob->next) {
+			if ((static_only && !ob->is_static) || strcmp(ob->hostname, hostname)) {
+				continue;
+			}
+			if (n == len) {
+				len = len ? len * 2 : 16;
+				doomed = realloc(doomed, len * sizeof(*doomed));
+				switch_assert(doomed);
+			}
+			doomed[n++] = ob;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		outbound_unlink(doomed[i]);
+	}
+	switch_mutex_unlock(globals.outbound_mutex);
+
+	switch_safe_free(doomed);
+}
+
+static int outbound_member_count(const char *fifo_name)
+{
+	fifo_outbound_t *ob;
+	int count = 0;
+
+	switch_mutex_lock(globals.outbound_mutex);
+	for (ob = switch_core_hash_find(globals.outbound_fifo_hash, fifo_name); ob; ob = ob->next) {
+		count++;
+	}
+	switch_mutex_unlock(globals.outbound_mutex);
+
+	return count;
+}
+
+/* Apply OUTBOUND_* flags to every row with this uuid, the _DEC flags skip rows already at 0
+   the way the "and ring_count > 0" / "and use_count > 0" clauses did */
+static void outbound_update(const char *uuid, uint32_t flags)
+{
+	fifo_outbound_t *ob;
+	long now = (long) switch_epoch_time_now(NULL);
+
+	if (zstr(uuid)) {
+		return;
+	}
+
+	switch_mutex_lock(globals.outbound_mutex);
+	for (ob = switch_core_hash_find(globals.outbound_hash, uuid); ob; ob = ob->uuid_next) {
+		if (((flags & OUTBOUND_RING_DEC) && ob->ring_count <= 0) || ((flags & OUTBOUND_USE_DEC) && ob->use_count <= 0)) {
+			continue;
+		}
+
+		if ((flags & OUTBOUND_RING_INC)) ob->ring_count++;
+		if ((flags & OUTBOUND_RING_DEC)) ob->ring_count--;
+		if ((flags & OUTBOUND_USE_INC)) ob->use_count++;
+		if ((flags & OUTBOUND_USE_DEC)) ob->use_count--;
+		if ((flags & OUTBOUND_FAIL)) ob->outbound_fail_count++;
+		if ((flags & OUTBOUND_FAIL_CLR)) ob->outbound_fail_count = 0;
+		if ((flags & OUTBOUND_CALL)) ob->outbound_call_count++;
+		if ((flags & OUTBOUND_LAG)) ob->next_avail = now + ob->lag + 1;
+	}
+	switch_mutex_unlock(globals.outbound_mutex);
+}
+
+static int outbound_cmp(const void *a, const void *b)
+{
+	const fifo_outbound_t *x = *(fifo_outbound_t * const *) a;
+	const fifo_outbound_t *y = *(fifo_outbound_t * const *) b;
+
+	if (x->next_avail != y->next_avail) {
+		return x->next_avail < y->next_avail ? -1 : 1;
+	}
+
+	if (x->outbound_fail_count != y->outbound_fail_count) {
+		return x->outbound_fail_count < y->outbound_fail_count ? -1 : 1;
+	}
+
+	if (x->outbound_call_count != y->outbound_call_count) {
+		return x->outbound_call_count < y->outbound_call_count ? -1 : 1;
+	}
+
+	return 0;
+}
+
+struct outbound_row {
+	char *argv[6];
+	char num[3][16];
+};
+
+/* Walks the same rows in the same order the select in find_consumers does and hands them
+   to its callbacks, the index lock is not held while they run */
+static void outbound_find_consumers(const char *fifo_name, switch_core_db_callback_func_t callback, void *pdata)
+{
+	fifo_outbound_t *ob, **picks = NULL;
+	struct outbound_row *rows = NULL;
+	long now = (long) switch_epoch_time_now(NULL);
+	int i, n = 0, len = 0;
+
+	switch_mutex_lock(globals.outbound_mutex);
+	for (ob = switch_core_hash_find(globals.outbound_fifo_hash, fifo_name); ob; ob = ob->next) {
+		if (ob->taking_calls != 1 || ob->use_count + ob->ring_count >= ob->simo_count || (ob->next_avail && ob->next_avail > now)) {
+			continue;
+		}
+		if (n == len) {
+			len = len ? len * 2 : 16;
+			picks = realloc(picks, len * sizeof(*picks));
+			switch_assert(picks);
+		}
+		picks[n++] = ob;
+	}
+
+	if (n) {
+		qsort(picks, n, sizeof(*picks), outbound_cmp);
+		switch_zmalloc(rows, n * sizeof(*rows));
+
+		for (i = 0; i < n; i++) {
+			rows[i].argv[0] = strdup(picks[i]->uuid);
+			rows[i].argv[1] = strdup(picks[i]->fifo_name);
+			rows[i].argv[2] = strdup(picks[i]->originate_string);
+			switch_snprintf(rows[i].num[0], sizeof(rows[i].num[0]), "%d", picks[i]->simo_count);
+			switch_snprintf(rows[i].num[1], sizeof(rows[i].num[1]), "%d", picks[i]->use_count);
+			switch_snprintf(rows[i].num[2], sizeof(rows[i].num[2]), "%d", picks[i]->timeout);
+			rows[i].argv[3] = rows[i].num[0];
+			rows[i].argv[4] = rows[i].num[1];
+			rows[i].argv[5] = rows[i].num[2];
+		}
+	}
+	switch_mutex_unlock(globals.outbound_mutex);
+
+	switch_safe_free(picks);
+
+	for (i = 0; i < n; i++) {
+		if (callback(pdata, 6, rows[i].argv, NULL)) {
+			break;
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		free(rows[i].argv[0]);
+		free(rows[i].argv[1]);
+		free(rows[i].argv[2]);
+	}
+
+	switch_safe_free(rows);
+}
+
+static int outbound_load_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	fifo_outbound_t ob = { 0 };
+
+	if (zstr(argv[0]) || zstr(argv[1])) {
+		return 0;
+	}
+
+	ob.uuid = argv[0];
+	ob.fifo_name = argv[1];
+	ob.originate_string = argv[2];
+	ob.simo_count = atoi(switch_str_nil(argv[3]));
+	ob.use_count = atoi(switch_str_nil(argv[4]));
+	ob.timeout = atoi(switch_str_nil(argv[5]));
+	ob.lag = atoi(switch_str_nil(argv[6]));
+	ob.next_avail = atol(switch_str_nil(argv[7]));
+	ob.is_static = atoi(switch_str_nil(argv[8]));
+	ob.outbound_call_count = atoi(switch_str_nil(argv[9]));
+	ob.outbound_fail_count = atoi(switch_str_nil(argv[10]));
+	ob.hostname = argv[11];
+	ob.taking_calls = atoi(switch_str_nil(argv[12]));
+	ob.ring_count = atoi(switch_str_nil(argv[13]));
+
+	outbound_add(&ob);
+
+	return 0;
+}
+
+/* Pick up the members that survived the restart, called once the startup cleanup ran */
+static void outbound_load(void)
+{
+	fifo_execute_sql_callback(globals.sql_mutex,
+							  "select uuid, fifo_name, originate_string, simo_count, use_count, timeout, lag, next_avail, static, "
+							  "outbound_call_count, outbound_fail_count, hostname, taking_calls, ring_count from fifo_outbound",
+							  outbound_load_callback, NULL);
+}
+
+static void outbound_shutdown(void)
+{
+	switch_hash_index_t *hi;
+	fifo_outbound_t *ob, *next;
+	void *val;
+
+	switch_mutex_lock(globals.outbound_mutex);
+	for (hi = switch_hash_first(NULL, globals.outbound_fifo_hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		for (ob = (fifo_outbound_t *) val; ob; ob = next) {
+			next = ob->next;
+			switch_safe_free(ob->uuid);
+			switch_safe_free(ob->fifo_name);
+			switch_safe_free(ob->originate_string);
+			switch_safe_free(ob->hostname);
+			free(ob);
+		}
+	}
+	switch_core_hash_destroy(&globals.outbound_fifo_hash);
+	switch_core_hash_destroy(&globals.outbound_hash);
+	switch_mutex_unlock(globals.outbound_mutex);
+}
+
 static fifo_node_t *create_node(const char *name, uint32_t importance, switch_mutex_t *mutex)
 {
 	fifo_node_t *node;
@@ -849,11 +1313,15 @@ static fifo_node_t *create_node(const char *name, uint32_t importance, switch_mu
 	switch_thread_rwlock_create(&node->rwlock, node->pool);
 	switch_mutex_init(&node->mutex, SWITCH_MUTEX_NESTED, node->pool);
 	switch_mutex_init(&node->update_mutex, SWITCH_MUTEX_NESTED, node->pool);
-	cbt.buf = outbound_count;
-	cbt.len = sizeof(outbound_count);
-	sql = switch_mprintf("select count(*) from fifo_outbound where fifo_name = '%q'", name);
-	fifo_execute_sql_callback(mutex, sql, sql2str_callback, &cbt);
-    node->member_count = atoi(outbound_count);
+	if (globals.memory_routing) {
+		node->member_count = outbound_member_count(name);
+	} else {
+		cbt.buf = outbound_count;
+		cbt.len = sizeof(outbound_count);
+		sql = switch_mprintf("select count(*) from fifo_outbound where fifo_name = '%q'", name);
+		fifo_execute_sql_callback(mutex, sql, sql2str_callback, &cbt);
+		node->member_count = atoi(outbound_count);
+	}
 	if (node->member_count > 0) {
 		node->has_outbound = 1;
 	} else {
@@ -943,7 +1411,7 @@ static void do_unbridge(switch_core_session_t *consumer_session, switch_core_ses
 		switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d %T", &tm);
 
 		sql = switch_mprintf("delete from fifo_bridge where consumer_uuid='%q'", switch_core_session_get_uuid(consumer_session));
-		fifo_execute_sql(sql, globals.sql_mutex);
+		fifo_execute_sql_queued(&sql);
 		switch_safe_free(sql);
 
 
@@ -1031,7 +1499,7 @@ static switch_status_t messagehook (switch_core_session_t *session, switch_core_
 							 switch_str_nil(msg->string_array_arg[0]),
 							 switch_str_nil(msg->string_array_arg[1]),
 							 switch_core_session_get_uuid(session));
-		fifo_execute_sql(sql, globals.sql_mutex);
+		fifo_execute_sql_queued(&sql);
 		switch_safe_free(sql);
 		goto end;
 	default:
@@ -1130,7 +1598,7 @@ static switch_status_t messagehook (switch_core_session_t *session, switch_core_
 									 );
 			}
 
-			fifo_execute_sql(sql, globals.sql_mutex);
+			fifo_execute_sql_queued(&sql);
 			switch_safe_free(sql);
 
 
@@ -1382,7 +1850,8 @@ static void *SWITCH_THREAD_FUNC ringall_thread_run(switch_thread_t *thread, void
 		struct call_helper *h = cbh->rows[i];
 		char *sql = switch_mprintf("update fifo_outbound set ring_count=ring_count+1 where uuid='%s'", h->uuid);
 
-		fifo_execute_sql(sql, globals.sql_mutex);
+		outbound_update(h->uuid, OUTBOUND_RING_INC);
+		fifo_execute_sql_queued(&sql);
 		switch_safe_free(sql);
 
 	}
@@ -1425,7 +1894,8 @@ static void *SWITCH_THREAD_FUNC ringall_thread_run(switch_thread_t *thread, void
 					struct call_helper *h = cbh->rows[i];
 					char *sql = switch_mprintf("update fifo_outbound set ring_count=ring_count-1 "
 											   "where uuid='%q' and ring_count > 0", h->uuid);
-					fifo_execute_sql(sql, globals.sql_mutex);
+					outbound_update(h->uuid, OUTBOUND_RING_DEC);
+					fifo_execute_sql_queued(&sql);
 					switch_safe_free(sql);
 				}
 
@@ -1440,7 +1910,8 @@ static void *SWITCH_THREAD_FUNC ringall_thread_run(switch_thread_t *thread, void
 											   "outbound_fail_total_count = outbound_fail_total_count+1, "
 											   "next_avail=%ld + lag + 1 where uuid='%q' and ring_count > 0",
 											   (long) switch_epoch_time_now(NULL), h->uuid);
-					fifo_execute_sql(sql, globals.sql_mutex);
+					outbound_update(h->uuid, OUTBOUND_RING_DEC | OUTBOUND_FAIL | OUTBOUND_LAG);
+					fifo_execute_sql_queued(&sql);
 					switch_safe_free(sql);
 
 				}
@@ -1498,7 +1969,8 @@ static void *SWITCH_THREAD_FUNC ringall_thread_run(switch_thread_t *thread, void
 	for (i = 0; i < cbh->rowcount; i++) {
 		struct call_helper *h = cbh->rows[i];
 		char *sql = switch_mprintf("update fifo_outbound set ring_count=ring_count-1 where uuid='%q' and ring_count > 0",  h->uuid);
-		fifo_execute_sql(sql, globals.sql_mutex);
+		outbound_update(h->uuid, OUTBOUND_RING_DEC);
+		fifo_execute_sql_queued(&sql);
 		switch_safe_free(sql);
 	}
 
@@ -1609,7 +2081,8 @@ static void *SWITCH_THREAD_FUNC o_thread_run(switch_thread_t *thread, void *obj)
 
 
 	sql = switch_mprintf("update fifo_outbound set ring_count=ring_count+1 where uuid='%s'", h->uuid);
-	fifo_execute_sql(sql, globals.sql_mutex);
+	outbound_update(h->uuid, OUTBOUND_RING_INC);
+	fifo_execute_sql_queued(&sql);
 	switch_safe_free(sql);
 
 	status = switch_ivr_originate(NULL, &session, &cause, originate_string, h->timeout, NULL, NULL, NULL, NULL, ovars, SOF_NONE, NULL);
@@ -1620,7 +2093,8 @@ static void *SWITCH_THREAD_FUNC o_thread_run(switch_thread_t *thread, void *obj)
 		sql = switch_mprintf("update fifo_outbound set ring_count=ring_count-1, "
 							 "outbound_fail_count=outbound_fail_count+1, next_avail=%ld + lag + 1 where uuid='%q'",
 							 (long) switch_epoch_time_now(NULL), h->uuid);
-		fifo_execute_sql(sql, globals.sql_mutex);
+		outbound_update(h->uuid, OUTBOUND_RING_DEC | OUTBOUND_FAIL | OUTBOUND_LAG);
+		fifo_execute_sql_queued(&sql);
 		switch_safe_free(sql);
 
 		if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, FIFO_EVENT) == SWITCH_STATUS_SUCCESS) {
@@ -1765,7 +2239,11 @@ static void find_consumers(fifo_node_t *node)
 				need = node->outbound_per_cycle;
 			}
 
-			fifo_execute_sql_callback(globals.sql_mutex, sql, place_call_enterprise_callback, &need);
+			if (globals.memory_routing) {
+				outbound_find_consumers(node->name, place_call_enterprise_callback, &need);
+			} else {
+				fifo_execute_sql_callback(globals.sql_mutex, sql, place_call_enterprise_callback, &need);
+			}
 
 		}
 		break;
@@ -1785,7 +2263,11 @@ static void find_consumers(fifo_node_t *node)
 				cbh->need = node->outbound_per_cycle;
 			}
 
-			fifo_execute_sql_callback(globals.sql_mutex, sql, place_call_ringall_callback, cbh);
+			if (globals.memory_routing) {
+				outbound_find_consumers(node->name, place_call_ringall_callback, cbh);
+			} else {
+				fifo_execute_sql_callback(globals.sql_mutex, sql, place_call_ringall_callback, cbh);
+			}
 
 			if (cbh->rowcount) {
 				switch_threadattr_create(&thd_attr, cbh->pool);
@@ -2124,14 +2606,15 @@ static void dec_use_count(switch_core_session_t *session, switch_bool_t send_eve
 
 
 		sql = switch_mprintf("delete from fifo_bridge where consumer_uuid='%q'", switch_core_session_get_uuid(session));
-		fifo_execute_sql(sql, globals.sql_mutex);
+		fifo_execute_sql_queued(&sql);
 		switch_safe_free(sql);
 
 		del_bridge_call(outbound_id);
 		sql = switch_mprintf("update fifo_outbound set use_count=use_count-1, stop_time=%ld, next_avail=%ld + lag + 1 where use_count > 0 and uuid='%q'",
 							 now, now, outbound_id);
 
-		fifo_execute_sql(sql, globals.sql_mutex);
+		outbound_update(outbound_id, OUTBOUND_USE_DEC | OUTBOUND_LAG);
+		fifo_execute_sql_queued(&sql);
 		switch_safe_free(sql);
 	}
 
@@ -2199,7 +2682,8 @@ SWITCH_STANDARD_APP(fifo_track_call_function)
 
 	sql = switch_mprintf("update fifo_outbound set stop_time=0,start_time=%ld,outbound_fail_count=0,use_count=use_count+1,%s=%s+1,%s=%s+1 where uuid='%q'",
 						 (long) switch_epoch_time_now(NULL), col1, col1, col2, col2, data);
-	fifo_execute_sql(sql, globals.sql_mutex);
+	outbound_update(data, OUTBOUND_USE_INC | OUTBOUND_FAIL_CLR);
+	fifo_execute_sql_queued(&sql);
 
 	switch_safe_free(sql);
 
@@ -2236,7 +2720,7 @@ static void fifo_caller_add(fifo_node_t *node, switch_core_session_t *session)
 						 switch_str_nil(switch_channel_get_variable(channel, "caller_id_number")),
 						 switch_epoch_time_now(NULL));
 
-	fifo_execute_sql(sql, globals.sql_mutex);
+	fifo_execute_sql_queued(&sql);
 	switch_safe_free(sql);
 }
 
@@ -2250,7 +2734,7 @@ static void fifo_caller_del(const char *uuid)
 		sql = switch_mprintf("delete from fifo_callers", uuid);
 	}
 
-	fifo_execute_sql(sql, globals.sql_mutex);
+	fifo_execute_sql_queued(&sql);
 	switch_safe_free(sql);
 
 }
@@ -3019,7 +3503,8 @@ SWITCH_STANDARD_APP(fifo_function)
 										 switch_epoch_time_now(NULL), outbound_id);
 
 
-					fifo_execute_sql(sql, globals.sql_mutex);
+					outbound_update(outbound_id, OUTBOUND_USE_INC | OUTBOUND_FAIL_CLR);
+					fifo_execute_sql_queued(&sql);
 					switch_safe_free(sql);
 				}
 
@@ -3039,7 +3524,7 @@ SWITCH_STANDARD_APP(fifo_function)
 									 );
 
 
-				fifo_execute_sql(sql, globals.sql_mutex);
+				fifo_execute_sql_queued(&sql);
 				switch_safe_free(sql);
 
 
@@ -3056,7 +3541,8 @@ SWITCH_STANDARD_APP(fifo_function)
 										 "outbound_call_count=outbound_call_count+1, next_avail=%ld + lag + 1 where uuid='%s' and use_count > 0",
 										 now, now, outbound_id);
 
-					fifo_execute_sql(sql, globals.sql_mutex);
+					outbound_update(outbound_id, OUTBOUND_USE_DEC | OUTBOUND_CALL | OUTBOUND_LAG);
+					fifo_execute_sql_queued(&sql);
 					switch_safe_free(sql);
 
 					del_bridge_call(outbound_id);
@@ -3089,7 +3575,7 @@ SWITCH_STANDARD_APP(fifo_function)
 				switch_channel_set_variable_printf(other_channel, "fifo_bridge_seconds", "%d", epoch_end - epoch_start);
 
 				sql = switch_mprintf("delete from fifo_bridge where consumer_uuid='%q'", switch_core_session_get_uuid(session));
-				fifo_execute_sql(sql, globals.sql_mutex);
+				fifo_execute_sql_queued(&sql);
 				switch_safe_free(sql);
 
 
@@ -4018,6 +4504,8 @@ static switch_status_t load_config(int reload, int del_all)
 				}
 			} else if (!strcasecmp(var, "delete-all-outbound-member-on-startup")) {
 				delete_all_outbound_member_on_startup = switch_true(val);
+			} else if (!strcasecmp(var, "memory-routing")) {
+				globals.memory_routing = switch_true(val);
 			}
 		}
 	}
@@ -4063,13 +4551,19 @@ static switch_status_t load_config(int reload, int del_all)
 
 	if ((reload && del_all) || (!reload && delete_all_outbound_member_on_startup)) {
 		sql = switch_mprintf("delete from fifo_outbound where hostname='%q'", globals.hostname);
+		outbound_del_host(globals.hostname, SWITCH_FALSE);
 	} else {
 		sql = switch_mprintf("delete from fifo_outbound where static=1 and hostname='%q'", globals.hostname);
+		outbound_del_host(globals.hostname, SWITCH_TRUE);
 	}
 
-	fifo_execute_sql(sql, globals.sql_mutex);
+	fifo_execute_sql_queued(&sql);
 	switch_safe_free(sql);
 
+	if (!reload) {
+		outbound_load();
+	}
+
 	if (!(node = switch_core_hash_find(globals.fifo_hash, MANUAL_QUEUE_NAME))) {
 		node = create_node(MANUAL_QUEUE_NAME, 0, globals.sql_mutex);
 		node->ready = 2;
@@ -4176,6 +4670,7 @@ static switch_status_t load_config(int reload, int del_all)
 				const char *taking_calls = switch_xml_attr_soft(member, "taking_calls");
 				char *name_dup, *p;
 				char digest[SWITCH_MD5_DIGEST_STRING_SIZE] = { 0 };
+				fifo_outbound_t ob = { 0 };
 
 				if (switch_stristr("fifo_outbound_uuid=", member->txt)) {
 					extract_fifo_outbound_uuid(member->txt, digest, sizeof(digest));
@@ -4221,9 +4716,21 @@ static switch_status_t load_config(int reload, int del_all)
 									 (long) switch_epoch_time_now(NULL));
 
 				switch_assert(sql);
-				fifo_execute_sql(sql, globals.sql_mutex);
+				fifo_execute_sql_queued(&sql);
 				free(sql);
 				free(name_dup);
+
+				ob.uuid = digest;
+				ob.fifo_name = node->name;
+				ob.originate_string = member->txt;
+				ob.hostname = globals.hostname;
+				ob.simo_count = simo_i;
+				ob.timeout = timeout_i;
+				ob.lag = lag_i;
+				ob.taking_calls = taking_calls_i;
+				ob.is_static = 1;
+				outbound_add(&ob);
+
 				node->has_outbound = 1;
 				node->member_count++;
 			}
@@ -4267,6 +4774,7 @@ static void fifo_member_add(char *fifo_name, char *originate_string, int simo_co
     char outbound_count[80] = "";
     callback_t cbt = { 0 };
 	fifo_node_t *node = NULL;
+	fifo_outbound_t ob = { 0 };
 
 	if (!fifo_name) return;
 
@@ -4278,8 +4786,9 @@ static void fifo_member_add(char *fifo_name, char *originate_string, int simo_co
 
 	sql = switch_mprintf("delete from fifo_outbound where fifo_name='%q' and uuid = '%q'", fifo_name, digest);
 	switch_assert(sql);
-	fifo_execute_sql(sql, globals.sql_mutex);
+	fifo_execute_sql_queued(&sql);
 	free(sql);
+	outbound_del(fifo_name, digest, NULL);
 
 
 	switch_mutex_lock(globals.mutex);
@@ -4301,15 +4810,29 @@ static void fifo_member_add(char *fifo_name, char *originate_string, int simo_co
 						 digest, fifo_name, originate_string, simo_count, 0, timeout, lag, 0, (long) expires, globals.hostname, taking_calls,
 						 (long)switch_epoch_time_now(NULL));
 	switch_assert(sql);
-	fifo_execute_sql(sql, globals.sql_mutex);
+	fifo_execute_sql_queued(&sql);
 	free(sql);
 	free(name_dup);
 
-    cbt.buf = outbound_count; 
-    cbt.len = sizeof(outbound_count);
-    sql = switch_mprintf("select count(*) from fifo_outbound where fifo_name = '%q'", fifo_name);
-    fifo_execute_sql_callback(globals.sql_mutex, sql, sql2str_callback, &cbt);
-    node->member_count = atoi(outbound_count);
+	ob.uuid = digest;
+	ob.fifo_name = fifo_name;
+	ob.originate_string = originate_string;
+	ob.hostname = globals.hostname;
+	ob.simo_count = simo_count;
+	ob.timeout = timeout;
+	ob.lag = lag;
+	ob.taking_calls = taking_calls;
+	outbound_add(&ob);
+
+	if (globals.memory_routing) {
+		node->member_count = outbound_member_count(fifo_name);
+	} else {
+		cbt.buf = outbound_count;
+		cbt.len = sizeof(outbound_count);
+		sql = switch_mprintf("select count(*) from fifo_outbound where fifo_name = '%q'", fifo_name);
+		fifo_execute_sql_callback(globals.sql_mutex, sql, sql2str_callback, &cbt);
+		node->member_count = atoi(outbound_count);
+	}
     if (node->member_count > 0) {
         node->has_outbound = 1;
     } else {
@@ -4337,8 +4860,9 @@ static void fifo_member_del(char *fifo_name, char *originate_string)
 
 	sql = switch_mprintf("delete from fifo_outbound where fifo_name='%q' and uuid = '%q' and hostname='%q'", fifo_name, digest, globals.hostname);
 	switch_assert(sql);
-	fifo_execute_sql(sql, globals.sql_mutex);
+	fifo_execute_sql_queued(&sql);
 	free(sql);
+	outbound_del(fifo_name, digest, globals.hostname);
 
 	switch_mutex_lock(globals.mutex);
 	if (!(node = switch_core_hash_find(globals.fifo_hash, fifo_name))) {
@@ -4347,11 +4871,15 @@ static void fifo_member_del(char *fifo_name, char *originate_string)
 	}
 	switch_mutex_unlock(globals.mutex);
 
-	cbt.buf = outbound_count;
-	cbt.len = sizeof(outbound_count);
-	sql = switch_mprintf("select count(*) from fifo_outbound where fifo_name = '%q'", node->name);
-	fifo_execute_sql_callback(globals.sql_mutex, sql, sql2str_callback, &cbt);
-    node->member_count = atoi(outbound_count);
+	if (globals.memory_routing) {
+		node->member_count = outbound_member_count(node->name);
+	} else {
+		cbt.buf = outbound_count;
+		cbt.len = sizeof(outbound_count);
+		sql = switch_mprintf("select count(*) from fifo_outbound where fifo_name = '%q'", node->name);
+		fifo_execute_sql_callback(globals.sql_mutex, sql, sql2str_callback, &cbt);
+		node->member_count = atoi(outbound_count);
+	}
 	if (node->member_count > 0) {
         node->has_outbound = 1;
 	} else {
@@ -4476,12 +5004,18 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_fifo_load)
 	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
 	switch_mutex_init(&globals.sql_mutex, SWITCH_MUTEX_NESTED, globals.pool);
 
+	switch_core_hash_init(&globals.outbound_hash, globals.pool);
+	switch_core_hash_init(&globals.outbound_fifo_hash, globals.pool);
+	switch_mutex_init(&globals.outbound_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	globals.memory_routing = 1;
+
 	globals.running = 1;
 
 	if ((status = load_config(0, 1)) != SWITCH_STATUS_SUCCESS) {
 		switch_event_unbind(&globals.node);
 		switch_event_free_subclass(FIFO_EVENT);
 		switch_core_hash_destroy(&globals.fifo_hash);
+		outbound_shutdown();
 		return status;
 	}
 
@@ -4501,6 +5035,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_fifo_load)
 	switch_console_set_complete("add fifo importance");
 	switch_console_set_complete("add fifo_check_bridge ::console::list_uuid");
 
+	if (globals.memory_routing) {
+		start_sql_thread(globals.pool);
+	}
+
 	start_node_thread(globals.pool);
 
 	return SWITCH_STATUS_SUCCESS;
@@ -4529,6 +5067,8 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_fifo_shutdown)
 		switch_cond_next();
 	}
 
+	stop_sql_thread();
+
 	node = globals.nodes;
 
 	while(node) {
@@ -4553,6 +5093,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_fifo_shutdown)
 	}
 
 	switch_core_hash_destroy(&globals.fifo_hash);
+	outbound_shutdown();
 	memset(&globals, 0, sizeof(globals));
 	switch_mutex_unlock(mutex);
 
@@ -37,6 +37,8 @@
 #include "esl.h"
 
 #define LIMIT_HASH_CLEANUP_INTERVAL 900
+#define LIMIT_TOMBSTONES 8192
+#define LIMIT_REMOTE_FULL_EVERY 60
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_hash_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown);
@@ -45,22 +47,146 @@ SWITCH_MODULE_DEFINITION(mod_hash, mod_hash_load, mod_hash_shutdown, NULL);
 /* CORE STUFF */
 static struct {
 	switch_memory_pool_t *pool;
-	switch_thread_rwlock_t *limit_hash_rwlock;
-	switch_hash_t *limit_hash;
+	switch_striped_hash_t *limit_hash;
 	switch_thread_rwlock_t *db_hash_rwlock;
 	switch_hash_t *db_hash;
 	switch_thread_rwlock_t *remote_hash_rwlock;
 	switch_hash_t *remote_hash;
+	volatile uint64_t limit_version;
+	uint32_t limit_epoch;
+	switch_mutex_t *tombstone_mutex;
+	struct limit_tombstone *tombstones;
+	uint32_t tombstone_next;
+	uint64_t tombstone_horizon;
 } globals;
 
 typedef struct {
-	uint32_t total_usage;	/* < Total */
-	uint32_t rate_usage;	/* < Current rate usage */
-	time_t last_check;		/* < Last rate check */
-	uint32_t interval;		/* < Interval used on last rate check */
-	uint32_t last_update;	/* < Last updated timestamp (rate or total) */
+	volatile uint32_t total_usage;	/* < Total */
+	volatile uint64_t rate_window;	/* < Last rate check in the high 32 bits, current rate usage in the low 32 */
+	uint32_t interval;				/* < Interval used on last rate check */
+	uint32_t last_update;			/* < Last updated timestamp (rate or total) */
+	volatile uint64_t version;		/* < limit_version when it last changed, what hash_dump delta sends */
+	volatile uint64_t tat;			/* < Token bucket mode: ms timestamp the bucket is empty again */
 } limit_hash_item_t;
 
+/* A freed item, kept so a delta can tell the peers to drop it */
+struct limit_tombstone {
+	char *key;
+	uint64_t version;
+};
+
+#define LIMIT_WINDOW(_start, _count) (((uint64_t) (uint32_t) (_start) << 32) | (uint32_t) (_count))
+#define LIMIT_WINDOW_START(_w) ((time_t) ((_w) >> 32))
+#define LIMIT_WINDOW_COUNT(_w) ((uint32_t) ((_w) & 0xffffffff))
+
+/* The counters are changed with the key's stripe only read locked so limits on the same
+   stripe don't wait for each other, the write lock is left for creating and freeing items. */
+#if defined(__GNUC__)
+#define limit_cas32(_ptr, _old, _new) __sync_bool_compare_and_swap(_ptr, _old, _new)
+#define limit_cas64(_ptr, _old, _new) __sync_bool_compare_and_swap(_ptr, _old, _new)
+#define limit_add32(_ptr, _val) __sync_add_and_fetch(_ptr, _val)
+#define limit_read64(_ptr) __sync_fetch_and_add(_ptr, 0)
+#define limit_add64(_ptr, _val) __sync_add_and_fetch(_ptr, _val)
+#elif defined(WIN32)
+#define limit_cas32(_ptr, _old, _new) (InterlockedCompareExchange((volatile LONG *) (_ptr), (LONG) (_new), (LONG) (_old)) == (LONG) (_old))
+#define limit_cas64(_ptr, _old, _new) \
+	(InterlockedCompareExchange64((volatile LONGLONG *) (_ptr), (LONGLONG) (_new), (LONGLONG) (_old)) == (LONGLONG) (_old))
+#define limit_add32(_ptr, _val) ((uint32_t) (InterlockedExchangeAdd((volatile LONG *) (_ptr), (LONG) (_val)) + (LONG) (_val)))
+#define limit_read64(_ptr) ((uint64_t) InterlockedCompareExchange64((volatile LONGLONG *) (_ptr), 0, 0))
+#define limit_add64(_ptr, _val) ((uint64_t) (InterlockedExchangeAdd64((volatile LONGLONG *) (_ptr), (LONGLONG) (_val)) + (LONGLONG) (_val)))
+#else
+static switch_mutex_t *limit_atomic_mutex;
+
+static switch_bool_t limit_cas32(volatile uint32_t *ptr, uint32_t old, uint32_t new)
+{
+	switch_bool_t r = SWITCH_FALSE;
+
+	switch_mutex_lock(limit_atomic_mutex);
+	if (*ptr == old) {
+		*ptr = new;
+		r = SWITCH_TRUE;
+	}
+	switch_mutex_unlock(limit_atomic_mutex);
+
+	return r;
+}
+
+static switch_bool_t limit_cas64(volatile uint64_t *ptr, uint64_t old, uint64_t new)
+{
+	switch_bool_t r = SWITCH_FALSE;
+
+	switch_mutex_lock(limit_atomic_mutex);
+	if (*ptr == old) {
+		*ptr = new;
+		r = SWITCH_TRUE;
+	}
+	switch_mutex_unlock(limit_atomic_mutex);
+
+	return r;
+}
+
+static uint32_t limit_add32(volatile uint32_t *ptr, int32_t val)
+{
+	uint32_t r;
+
+	switch_mutex_lock(limit_atomic_mutex);
+	r = (*ptr += val);
+	switch_mutex_unlock(limit_atomic_mutex);
+
+	return r;
+}
+
+static uint64_t limit_read64(volatile uint64_t *ptr)
+{
+	uint64_t r;
+
+	switch_mutex_lock(limit_atomic_mutex);
+	r = *ptr;
+	switch_mutex_unlock(limit_atomic_mutex);
+
+	return r;
+}
+
+static uint64_t limit_add64(volatile uint64_t *ptr, int64_t val)
+{
+	uint64_t r;
+
+	switch_mutex_lock(limit_atomic_mutex);
+	r = (*ptr += val);
+	switch_mutex_unlock(limit_atomic_mutex);
+
+	return r;
+}
+#endif
+
+/* Stamp an item after changing it.  The stamp only ever grows so a stamp taken by a slower
+   thread can't hide a newer one, a change racing a delta is picked up by the next full sync. */
+static void limit_touch(limit_hash_item_t *item)
+{
+	uint64_t version = limit_add64(&globals.limit_version, 1), cur;
+
+	do {
+		cur = limit_read64(&item->version);
+	} while (cur < version && !limit_cas64(&item->version, cur, version));
+}
+
+/* called with the key's stripe write locked just before the item is freed */
+static void limit_tombstone_add(const char *key)
+{
+	struct limit_tombstone *t;
+
+	switch_mutex_lock(globals.tombstone_mutex);
+	t = &globals.tombstones[globals.tombstone_next++ % LIMIT_TOMBSTONES];
+	if (t->key) {
+		/* a delta older than this no longer knows every deletion */
+		globals.tombstone_horizon = t->version;
+		free(t->key);
+	}
+	t->key = strdup(key);
+	t->version = limit_add64(&globals.limit_version, 1);
+	switch_mutex_unlock(globals.tombstone_mutex);
+}
+
 struct callback {
 	char *buf;
 	size_t len;
@@ -111,6 +237,15 @@ typedef struct {
 	switch_thread_t *thread;
 	
 	limit_remote_state_t state;
+
+	switch_bool_t legacy;		/* < peer only answers hash_dump limit */
+	uint32_t peer_epoch;
+	uint64_t peer_version;		/* < our entry in the version vector, what we have seen of the peer */
+	uint32_t polls;
+	switch_time_t last_sync;
+	uint64_t full_syncs;
+	uint64_t delta_syncs;
+	uint64_t sync_bytes;
 } limit_remote_t;
 
 static limit_hash_item_t get_remote_usage(const char *key);
@@ -118,100 +253,144 @@ void limit_remote_destroy(limit_remote_t **r);
 static void do_config(switch_bool_t reload);
 
 
-/* \brief Enforces limit_hash restrictions
- * \param session current session
- * \param realm limit realm
- * \param id limit id
- * \param max maximum count
- * \param interval interval for rate limiting
- * \return SWITCH_TRUE if the access is allowed, SWITCH_FALSE if it isnt
- */
-SWITCH_LIMIT_INCR(limit_incr_hash)
+typedef struct {
+	switch_core_session_t *session;
+	limit_hash_private_t *pvt;
+	const char *realm;
+	const char *resource;
+	int max;
+	int interval;
+	switch_bool_t token_bucket;
+	switch_status_t status;
+	switch_bool_t found;
+} limit_incr_t;
+
+/* runs with the key's stripe of the limit hash read locked for an existing item and write locked to create one */
+static void *limit_incr_callback(const char *hashkey, void *val, void *pData)
 {
+	limit_incr_t *incr = (limit_incr_t *) pData;
+	switch_core_session_t *session = incr->session;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
-	char *hashkey = NULL;
-	switch_status_t status = SWITCH_STATUS_SUCCESS;
-	limit_hash_item_t *item = NULL;
+	limit_hash_item_t *item = (limit_hash_item_t *) val;
+	limit_hash_private_t *pvt = incr->pvt;
 	time_t now = switch_epoch_time_now(NULL);
-	limit_hash_private_t *pvt = NULL;
+	int max = incr->max, interval = incr->interval;
 	uint8_t increment = 1;
 	limit_hash_item_t remote_usage;
+	uint32_t total, rate;
+	uint64_t window, next;
+	uint64_t now_ms, emission, tolerance, tat, base;
 
-	hashkey = switch_core_session_sprintf(session, "%s_%s", realm, resource);
+	incr->found = SWITCH_TRUE;
 
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
 	/* Check if that realm+resource has ever been checked */
-	if (!(item = (limit_hash_item_t *) switch_core_hash_find(globals.limit_hash, hashkey))) {
+	if (!item) {
 		/* No, create an empty structure and add it, then continue like as if it existed */
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Creating new limit structure: key: %s\n", hashkey);
 		item = (limit_hash_item_t *) malloc(sizeof(limit_hash_item_t));
 		switch_assert(item);
 		memset(item, 0, sizeof(limit_hash_item_t));
-		switch_core_hash_insert(globals.limit_hash, hashkey, item);
 	}
 
-	/* Did we already run on this channel before? */
-	if ((pvt = switch_channel_get_private(channel, "limit_hash"))) {
-		/* Yes, but check if we did that realm+resource
-		   If we didnt, allow incrementing the counter.
-		   If we did, dont touch it but do the validation anyways
-		 */
-		increment = !switch_core_hash_find(pvt->hash, hashkey);
-	} else {
-		/* This is the first limit check on this channel, create a hashtable, set our prviate data */
-		pvt = (limit_hash_private_t *) switch_core_session_alloc(session, sizeof(limit_hash_private_t));
-		memset(pvt, 0, sizeof(limit_hash_private_t));
-		switch_core_hash_init(&pvt->hash, switch_core_session_get_pool(session));
-		switch_channel_set_private(channel, "limit_hash", pvt);
-	}
+	/* Did we already run on this realm+resource on this channel?
+	   If we didnt, allow incrementing the counter.
+	   If we did, dont touch it but do the validation anyways
+	 */
+	increment = !switch_core_hash_find(pvt->hash, hashkey);
 
  	remote_usage = get_remote_usage(hashkey);
 
-	if (interval > 0) {
+	if (interval > 0 && max > 0 && incr->token_bucket) {
+		/* GCRA: every call pushes the time the bucket drains by interval/max, a call is let through while that stays
+		   within one interval from now. A burst of max and a steady max per interval pass, nothing ever needs resetting. */
+		now_ms = (uint64_t) (switch_micro_time_now() / 1000);
+		emission = (uint64_t) interval * 1000 / max;
+		if (!emission) {
+			emission = 1;
+		}
+		tolerance = (uint64_t) interval * 1000 - emission;
 		item->interval = interval;
-		if (item->last_check <= (now - interval)) {
-			item->rate_usage = 1;
-			item->last_check = now;
+
+		do {
+			tat = limit_read64(&item->tat);
+			base = tat > now_ms ? tat : now_ms;
+			if (base - now_ms > tolerance) {
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s exceeds maximum rate of %d/%ds\n",
+								  hashkey, max, interval);
+				incr->status = SWITCH_STATUS_GENERR;
+				return item;
+			}
+		} while (!limit_cas64(&item->tat, tat, base + emission));
+
+		/* calls still in the bucket, kept in the window so usage, cleanup and the remotes see a rate */
+		rate = (uint32_t) ((base + emission - now_ms + emission - 1) / emission);
+		item->rate_window = LIMIT_WINDOW(now, rate);
+
+		total = increment ? limit_add32(&item->total_usage, 1) : item->total_usage;
+	} else if (interval > 0) {
+		item->interval = interval;
+
+		/* Always increment rate when its checked as it doesnt depend on the channel */
+		do {
+			window = limit_read64(&item->rate_window);
+			if (LIMIT_WINDOW_START(window) <= (now - interval)) {
+				next = LIMIT_WINDOW(now, 1);
+			} else {
+				next = window + 1;
+			}
+		} while (!limit_cas64(&item->rate_window, window, next));
+
+		rate = LIMIT_WINDOW_COUNT(next);
+
+		if (LIMIT_WINDOW_START(next) != LIMIT_WINDOW_START(window)) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Usage for %s reset to 1\n",
 							  hashkey);
-		} else {
-			/* Always increment rate when its checked as it doesnt depend on the channel */
-			item->rate_usage++;
-
-			if ((max >= 0) && (item->rate_usage > (uint32_t) max)) {
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s exceeds maximum rate of %d/%ds, now at %d\n",
-								  hashkey, max, interval, item->rate_usage);
-				status = SWITCH_STATUS_GENERR;
-				goto end;
-			}
+		} else if ((max >= 0) && (rate > (uint32_t) max)) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s exceeds maximum rate of %d/%ds, now at %d\n",
+							  hashkey, max, interval, rate);
+			incr->status = SWITCH_STATUS_GENERR;
+			limit_touch(item);
+			return item;
 		}
-	} else if ((max >= 0) && (item->total_usage + increment + remote_usage.total_usage > (uint32_t) max)) {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s is already at max value (%d)\n", hashkey, item->total_usage);
-		status = SWITCH_STATUS_GENERR;
-		goto end;
+
+		total = increment ? limit_add32(&item->total_usage, 1) : item->total_usage;
+	} else {
+		rate = LIMIT_WINDOW_COUNT(limit_read64(&item->rate_window));
+
+		/* compare and add so two calls racing for the last slot can't both take it */
+		do {
+			total = item->total_usage;
+			if ((max >= 0) && (total + increment + remote_usage.total_usage > (uint32_t) max)) {
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s is already at max value (%d)\n", hashkey, total);
+				incr->status = SWITCH_STATUS_GENERR;
+				return item;
+			}
+		} while (increment && !limit_cas32(&item->total_usage, total, total + 1));
+
+		total += increment;
 	}
 
-	if (increment) {
-		item->total_usage++;
+	limit_touch(item);
 
+	if (increment) {
 		switch_core_hash_insert(pvt->hash, hashkey, item);
 
 		if (max == -1) {
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s is now %d\n", hashkey, item->total_usage + remote_usage.total_usage);
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s is now %d\n", hashkey, total + remote_usage.total_usage);
 		} else if (interval == 0) {
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s is now %d/%d\n", hashkey, item->total_usage + remote_usage.total_usage, max);
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s is now %d/%d\n", hashkey, total + remote_usage.total_usage, max);
 		} else {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s is now %d/%d for the last %d seconds\n", hashkey,
-							  item->rate_usage, max, interval);
+							  rate, max, interval);
 		}
 
-		switch_limit_fire_event("hash", realm, resource, item->total_usage, item->rate_usage, max, max >= 0 ? (uint32_t) max : 0);
+		switch_limit_fire_event("hash", incr->realm, incr->resource, total, rate, max, max >= 0 ? (uint32_t) max : 0);
 	}
 
 	/* Save current usage & rate into channel variables so it can be used later in the dialplan, or added to CDR records */
 	{
-		const char *susage = switch_core_session_sprintf(session, "%d", item->total_usage);
-		const char *srate = switch_core_session_sprintf(session, "%d", item->rate_usage);
+		const char *susage = switch_core_session_sprintf(session, "%d", total);
+		const char *srate = switch_core_session_sprintf(session, "%d", rate);
 
 		switch_channel_set_variable(channel, "limit_usage", susage);
 		switch_channel_set_variable(channel, switch_core_session_sprintf(session, "limit_usage_%s", hashkey), susage);
@@ -220,9 +399,51 @@ SWITCH_LIMIT_INCR(limit_incr_hash)
 		switch_channel_set_variable(channel, switch_core_session_sprintf(session, "limit_rate_%s", hashkey), srate);
 	}
 
-  end:
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
-	return status;
+	return item;
+}
+
+/* \brief Enforces limit_hash restrictions
+ * \param session current session
+ * \param realm limit realm
+ * \param id limit id
+ * \param max maximum count
+ * \param interval interval for rate limiting
+ * \return SWITCH_TRUE if the access is allowed, SWITCH_FALSE if it isnt
+ */
+SWITCH_LIMIT_INCR(limit_incr_hash)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	char *hashkey = NULL;
+	limit_hash_private_t *pvt = NULL;
+	limit_incr_t incr = { 0 };
+
+	hashkey = switch_core_session_sprintf(session, "%s_%s", realm, resource);
+
+	if (!(pvt = switch_channel_get_private(channel, "limit_hash"))) {
+		/* This is the first limit check on this channel, create a hashtable, set our prviate data */
+		pvt = (limit_hash_private_t *) switch_core_session_alloc(session, sizeof(limit_hash_private_t));
+		memset(pvt, 0, sizeof(limit_hash_private_t));
+		switch_core_hash_init(&pvt->hash, switch_core_session_get_pool(session));
+		switch_channel_set_private(channel, "limit_hash", pvt);
+	}
+
+	incr.session = session;
+	incr.pvt = pvt;
+	incr.realm = realm;
+	incr.resource = resource;
+	incr.max = max;
+	incr.interval = interval;
+	incr.token_bucket = !strcasecmp(switch_str_nil(switch_channel_get_variable(channel, LIMIT_RATE_MODE_VARIABLE)), LIMIT_RATE_MODE_TOKEN_BUCKET);
+	incr.status = SWITCH_STATUS_SUCCESS;
+
+	/* an existing item only needs its stripe read locked, the write lock is taken to create one */
+	switch_core_striped_hash_find_callback(globals.limit_hash, hashkey, limit_incr_callback, &incr);
+
+	if (!incr.found) {
+		switch_core_striped_hash_update(globals.limit_hash, hashkey, limit_incr_callback, &incr);
+	}
+
+	return incr.status;
 }
 
 /* !\brief Determines whether a given entry is ready to be removed. */
@@ -231,14 +452,16 @@ SWITCH_HASH_DELETE_FUNC(limit_hash_cleanup_delete_callback) {
 	time_t now = switch_epoch_time_now(NULL);
 
 	/* reset to 0 if window has passed so we can clean it up */
-	if (item->rate_usage > 0 && (item->last_check <= (now - item->interval))) {
-		item->rate_usage = 0;
+	if (LIMIT_WINDOW_COUNT(item->rate_window) > 0 && (LIMIT_WINDOW_START(item->rate_window) <= (now - item->interval))) {
+		item->rate_window = LIMIT_WINDOW(LIMIT_WINDOW_START(item->rate_window), 0);
+		limit_touch(item);
 	}
 
-	if (item->total_usage == 0 && item->rate_usage == 0) {
+	if (item->total_usage == 0 && LIMIT_WINDOW_COUNT(item->rate_window) == 0) {
 		/* Noone is using this item anymore */
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Freeing limit item: %s\n", (const char *) key);
 		
+		limit_tombstone_add((const char *) key);
 		free(item);
 		return SWITCH_TRUE;
 	}
@@ -259,26 +482,69 @@ SWITCH_HASH_DELETE_FUNC(limit_hash_remote_cleanup_callback)
 	return SWITCH_FALSE;
 }
 
+SWITCH_HASH_DELETE_FUNC(limit_hash_free_callback)
+{
+	free((void *) val);
+	return SWITCH_TRUE;
+}
+
 /* !\brief Periodically checks for unused limit entries and frees them */
 SWITCH_STANDARD_SCHED_FUNC(limit_hash_cleanup_callback)
 {
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
 	if (globals.limit_hash) {
-		switch_core_hash_delete_multi(globals.limit_hash, limit_hash_cleanup_delete_callback, NULL);
+		switch_core_striped_hash_delete_multi(globals.limit_hash, limit_hash_cleanup_delete_callback, NULL);
 	}
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 
 	if (globals.limit_hash) {	
 		task->runtime = switch_epoch_time_now(NULL) + LIMIT_HASH_CLEANUP_INTERVAL;
 	}
 }
 
+/* drops one use of an item with the key's stripe read locked, returns the item when that was the last use */
+static void *limit_release_callback(const char *hashkey, void *val, void *pData)
+{
+	switch_core_session_t *session = (switch_core_session_t *) pData;
+	limit_hash_item_t *item = (limit_hash_item_t *) val;
+	uint32_t total;
+
+	total = limit_add32(&item->total_usage, -1);
+	limit_touch(item);
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s is now %d\n", hashkey, total);
+
+	return total == 0 ? item : NULL;
+}
+
+/* frees an item nobody uses anymore, with the key's stripe write locked */
+static void *limit_free_unused_callback(const char *hashkey, void *val, void *pData)
+{
+	limit_hash_item_t *item = (limit_hash_item_t *) val;
+
+	if (!item) {
+		return NULL;
+	}
+
+	if (item->total_usage == 0 && LIMIT_WINDOW_COUNT(item->rate_window) == 0) {
+		/* Noone is using this item anymore */
+		limit_tombstone_add(hashkey);
+		free(item);
+		return NULL;
+	}
+
+	return item;
+}
+
+static void limit_release_key(switch_core_session_t *session, const char *hashkey)
+{
+	if (switch_core_striped_hash_find_callback(globals.limit_hash, hashkey, limit_release_callback, session)) {
+		switch_core_striped_hash_update(globals.limit_hash, hashkey, limit_free_unused_callback, NULL);
+	}
+}
+
 /* !\brief Releases usage of a limit_hash-controlled ressource  */
 SWITCH_LIMIT_RELEASE(limit_release_hash)
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	limit_hash_private_t *pvt = switch_channel_get_private(channel, "limit_hash");
-	limit_hash_item_t *item = NULL;
 	switch_hash_index_t *hi;
 	char *hashkey = NULL;
 
@@ -286,77 +552,54 @@ SWITCH_LIMIT_RELEASE(limit_release_hash)
 		return SWITCH_STATUS_SUCCESS;
 	}
 
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
-
 	/* clear for uuid */
 	if (realm == NULL && resource == NULL) {
 		/* Loop through the channel's hashtable which contains mapping to all the limit_hash_item_t referenced by that channel */
 		while ((hi = switch_hash_first(NULL, pvt->hash))) {
-			void *val = NULL;
 			const void *key;
-			switch_ssize_t keylen;
-			limit_hash_item_t *item = NULL;
-
-			switch_hash_this(hi, &key, &keylen, &val);
-
-			item = (limit_hash_item_t *) val;
-			item->total_usage--;
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s is now %d\n", (const char *) key, item->total_usage);
-
-			if (item->total_usage == 0 && item->rate_usage == 0) {
-				/* Noone is using this item anymore */
-				switch_core_hash_delete(globals.limit_hash, (const char *) key);
-				free(item);
-			}
 
+			switch_hash_this(hi, &key, NULL, NULL);
+			limit_release_key(session, (const char *) key);
 			switch_core_hash_delete(pvt->hash, (const char *) key);
 		}
 	} else {
 		hashkey = switch_core_session_sprintf(session, "%s_%s", realm, resource);
 
-		if ((item = (limit_hash_item_t *) switch_core_hash_find(pvt->hash, hashkey))) {
-			item->total_usage--;
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s is now %d\n", (const char *) hashkey, item->total_usage);
-
+		if (switch_core_hash_find(pvt->hash, hashkey)) {
+			limit_release_key(session, hashkey);
 			switch_core_hash_delete(pvt->hash, hashkey);
-
-			if (item->total_usage == 0 && item->rate_usage == 0) {
-				/* Noone is using this item anymore */
-				switch_core_hash_delete(globals.limit_hash, (const char *) hashkey);
-				free(item);
-			}
 		}
 	}
 
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
-	
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static void *limit_usage_callback(const char *hashkey, void *val, void *pData)
+{
+	limit_hash_item_t *item = (limit_hash_item_t *) val;
+	limit_hash_item_t *usage = (limit_hash_item_t *) pData;
+
+	usage->total_usage += item->total_usage;
+	usage->rate_window += LIMIT_WINDOW_COUNT(limit_read64(&item->rate_window));
+
+	return NULL;
+}
+
 SWITCH_LIMIT_USAGE(limit_usage_hash)
 {
 	char *hash_key = NULL;
-	limit_hash_item_t *item = NULL;
-	int count = 0;
-	limit_hash_item_t remote_usage;
-
-	switch_thread_rwlock_rdlock(globals.limit_hash_rwlock);
+	limit_hash_item_t usage;
 
 	hash_key = switch_mprintf("%s_%s", realm, resource);
-	remote_usage = get_remote_usage(hash_key);
-	
-	count = remote_usage.total_usage;
-	*rcount = remote_usage.rate_usage;
+	usage = get_remote_usage(hash_key);
 
-	if ((item = switch_core_hash_find(globals.limit_hash, hash_key))) {
-		count += item->total_usage;
-		*rcount += item->rate_usage;
-	}
+	switch_core_striped_hash_find_callback(globals.limit_hash, hash_key, limit_usage_callback, &usage);
 
  	switch_safe_free(hash_key);
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 
-	return count;
+	*rcount = LIMIT_WINDOW_COUNT(usage.rate_window);
+
+	return usage.total_usage;
 }
 
 SWITCH_LIMIT_RESET(limit_reset_hash)
@@ -364,21 +607,27 @@ SWITCH_LIMIT_RESET(limit_reset_hash)
 	return SWITCH_STATUS_GENERR;
 }
 
+static void *limit_interval_reset_callback(const char *hashkey, void *val, void *pData)
+{
+	limit_hash_item_t *item = (limit_hash_item_t *) val;
+
+	if (item) {
+		item->rate_window = LIMIT_WINDOW(switch_epoch_time_now(NULL), 0);
+		item->tat = 0;
+		limit_touch(item);
+	}
+
+	return item;
+}
+
 SWITCH_LIMIT_INTERVAL_RESET(limit_interval_reset_hash)
 {
 	char *hash_key = NULL;
-	limit_hash_item_t *item = NULL;
-
-	switch_thread_rwlock_rdlock(globals.limit_hash_rwlock);
 
 	hash_key = switch_mprintf("%s_%s", realm, resource);
-	if ((item = switch_core_hash_find(globals.limit_hash, hash_key))) {
-		item->rate_usage = 0;
-		item->last_check = switch_epoch_time_now(NULL);
-	}
-
+	switch_core_striped_hash_update(globals.limit_hash, hash_key, limit_interval_reset_callback, NULL);
  	switch_safe_free(hash_key);
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -417,8 +666,7 @@ SWITCH_STANDARD_APP(hash_function)
 	char *mydata = NULL;
 	char *hash_key = NULL;
 	char *value = NULL;
-
-	switch_thread_rwlock_wrlock(globals.db_hash_rwlock);
+	char *old = NULL;
 
 	if (!zstr(data)) {
 		mydata = strdup(data);
@@ -430,55 +678,58 @@ SWITCH_STANDARD_APP(hash_function)
 		goto usage;
 	}
 
+	if (strcasecmp(argv[0], "insert") && strcasecmp(argv[0], "insert_ifempty") &&
+		strcasecmp(argv[0], "delete") && strcasecmp(argv[0], "delete_ifmatch")) {
+		goto usage;
+	}
+
+	if (argc < 4 && strcasecmp(argv[0], "delete")) {
+		goto usage;
+	}
+
 	hash_key = switch_mprintf("%s_%s", argv[1], argv[2]);
 
-	if (!strcasecmp(argv[0], "insert")) {
-		if (argc < 4) {
-			goto usage;
-		}
-		if ((value = switch_core_hash_find(globals.db_hash, hash_key))) {
-			free(value);
-			switch_core_hash_delete(globals.db_hash, hash_key);
-		}
+	if (!strcasecmp(argv[0], "insert") || !strcasecmp(argv[0], "insert_ifempty")) {
 		value = strdup(argv[3]);
 		switch_assert(value);
+	}
+
+	/* only the hash itself is touched with the write lock held */
+	switch_thread_rwlock_wrlock(globals.db_hash_rwlock);
+
+	if (!strcasecmp(argv[0], "insert")) {
+		old = switch_core_hash_find(globals.db_hash, hash_key);
 		switch_core_hash_insert(globals.db_hash, hash_key, value);
+		value = NULL;
 	} else if (!strcasecmp(argv[0], "insert_ifempty")) {
-		if (argc < 4) {
-			goto usage;
-		}
-		if (!(value = switch_core_hash_find(globals.db_hash, hash_key))) {
-			value = strdup(argv[3]);
-			switch_assert(value);
+		if (!switch_core_hash_find(globals.db_hash, hash_key)) {
 			switch_core_hash_insert(globals.db_hash, hash_key, value);
+			value = NULL;
 		}
-
 	} else if (!strcasecmp(argv[0], "delete")) {
-		if ((value = switch_core_hash_find(globals.db_hash, hash_key))) {
-			switch_safe_free(value);
+		if ((old = switch_core_hash_find(globals.db_hash, hash_key))) {
 			switch_core_hash_delete(globals.db_hash, hash_key);
 		}
 	} else if (!strcasecmp(argv[0], "delete_ifmatch")) {
-		if (argc < 4) {
-			goto usage;
-		}
-		if ((value = switch_core_hash_find(globals.db_hash, hash_key))) {
-			if(!strcmp(argv[3], value)) {
-				switch_safe_free(value);
+		if ((old = switch_core_hash_find(globals.db_hash, hash_key))) {
+			if (!strcmp(argv[3], old)) {
 				switch_core_hash_delete(globals.db_hash, hash_key);
+			} else {
+				old = NULL;
 			}
 		}
-	} else {
-		goto usage;
 	}
 
+	switch_thread_rwlock_unlock(globals.db_hash_rwlock);
+
 	goto done;
 
   usage:
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "USAGE: hash %s\n", HASH_USAGE);
 
   done:
-	switch_thread_rwlock_unlock(globals.db_hash_rwlock);
+	switch_safe_free(old);
+	switch_safe_free(value);
 	switch_safe_free(mydata);
 	switch_safe_free(hash_key);
 }
@@ -582,7 +833,67 @@ SWITCH_STANDARD_API(hash_api_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
-#define HASH_DUMP_SYNTAX "all|limit|db [<realm>]"
+#define HASH_DUMP_SYNTAX "all|limit|db [<realm>] | delta <epoch> <version>"
+static void *limit_dump_callback(const char *key, void *val, void *pData)
+{
+	switch_stream_handle_t *stream = (switch_stream_handle_t *) pData;
+	limit_hash_item_t *item = (limit_hash_item_t *) val;
+	uint64_t window = limit_read64(&item->rate_window);
+
+	stream->write_function(stream, "L/%s/%d/%d/%d/%d\n", key, item->total_usage, LIMIT_WINDOW_COUNT(window), item->interval,
+						   (int) LIMIT_WINDOW_START(window));
+
+	return NULL;
+}
+
+typedef struct {
+	switch_stream_handle_t *stream;
+	uint64_t since;
+} limit_dump_delta_t;
+
+static void *limit_dump_delta_callback(const char *key, void *val, void *pData)
+{
+	limit_dump_delta_t *dd = (limit_dump_delta_t *) pData;
+	limit_hash_item_t *item = (limit_hash_item_t *) val;
+
+	if (limit_read64(&item->version) > dd->since) {
+		limit_dump_callback(key, val, dd->stream);
+	}
+
+	return NULL;
+}
+
+/* Sends what changed since a peer's last sync:
+   V/epoch/version/full|delta
+   X/key for every item freed since, then the L/ lines of hash_dump limit for every item changed since.
+   It falls back to everything when the peer restarted or the deletions it missed were forgotten. */
+static void limit_dump_delta(switch_stream_handle_t *stream, uint32_t epoch, uint64_t since)
+{
+	limit_dump_delta_t dd = { 0 };
+	uint64_t head = limit_read64(&globals.limit_version);
+	int full, i;
+
+	switch_mutex_lock(globals.tombstone_mutex);
+	full = !since || epoch != globals.limit_epoch || since < globals.tombstone_horizon || since > head;
+
+	stream->write_function(stream, "V/%u/%llu/%s\n", globals.limit_epoch, (unsigned long long) head, full ? "full" : "delta");
+
+	if (!full) {
+		for (i = 0; i < LIMIT_TOMBSTONES; i++) {
+			struct limit_tombstone *t = &globals.tombstones[i];
+
+			if (t->key && t->version > since) {
+				stream->write_function(stream, "X/%s\n", t->key);
+			}
+		}
+	}
+	switch_mutex_unlock(globals.tombstone_mutex);
+
+	dd.stream = stream;
+	dd.since = full ? 0 : since;
+	switch_core_striped_hash_walk(globals.limit_hash, limit_dump_delta_callback, &dd);
+}
+
 SWITCH_STANDARD_API(hash_dump_function) 
 {
 	int mode;
@@ -604,6 +915,16 @@ SWITCH_STANDARD_API(hash_dump_function)
 		return SWITCH_STATUS_SUCCESS;
 	}	
 
+	if (!strcmp(argv[0], "delta")) {
+		if (argc < 3) {
+			stream->write_function(stream, "Usage: "HASH_DUMP_SYNTAX"\n");
+		} else {
+			limit_dump_delta(stream, (uint32_t) strtoul(argv[1], NULL, 10), (uint64_t) strtoull(argv[2], NULL, 10));
+		}
+		free(mydata);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	cmd = strdup(argv[0]);
 	if (argc == 2) {
 		realm = 1;
@@ -622,19 +943,7 @@ SWITCH_STANDARD_API(hash_dump_function)
 	}
 	
 	if (mode & 1) {
-		switch_thread_rwlock_rdlock(globals.limit_hash_rwlock);
-		for (hi = switch_hash_first(NULL, globals.limit_hash); hi; hi = switch_hash_next(hi)) {
-			void *val = NULL;
-			const void *key;
-			switch_ssize_t keylen;
-			limit_hash_item_t *item;
-			switch_hash_this(hi, &key, &keylen, &val);
-						
-			item = (limit_hash_item_t *)val;
-
-			stream->write_function(stream, "L/%s/%d/%d/%d/%d\n", key, item->total_usage, item->rate_usage, item->interval, item->last_check);
-		}
-		switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
+		switch_core_striped_hash_walk(globals.limit_hash, limit_dump_callback, stream);
 	}
 	
 	if (mode & 2) {
@@ -676,7 +985,9 @@ SWITCH_STANDARD_API(hash_remote_function)
 	switch_split(dup, ' ', argv);
 	if (argv[0] && !strcmp(argv[0], "list")) {
 		switch_hash_index_t *hi;
-		stream->write_function(stream, "Remote connections:\nName\t\t\tState\n");
+		switch_time_t now = switch_micro_time_now();
+
+		stream->write_function(stream, "Remote connections:\nName\t\t\tState\tSync\tVersion\tLag(ms)\tFull\tDelta\tBytes\n");
 		
 		switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
 		for (hi = switch_hash_first(NULL, globals.remote_hash); hi; hi = switch_hash_next(hi)) {
@@ -687,7 +998,11 @@ SWITCH_STANDARD_API(hash_remote_function)
 			switch_hash_this(hi, &key, &keylen, &val);
 								
 			item = (limit_remote_t *)val;
-			stream->write_function(stream, "%s\t\t\t%s\n", item->name, state_str(item->state));	
+			stream->write_function(stream, "%s\t\t\t%s\t%s\t%llu\t%ld\t%llu\t%llu\t%llu\n", item->name, state_str(item->state),
+								   item->legacy ? "full" : "delta", (unsigned long long) item->peer_version,
+								   item->last_sync ? (long) ((now - item->last_sync) / 1000) : -1L,
+								   (unsigned long long) item->full_syncs, (unsigned long long) item->delta_syncs,
+								   (unsigned long long) item->sync_bytes);
 		}
 		switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
 		stream->write_function(stream, "+OK\n");
@@ -801,6 +1116,8 @@ void limit_remote_destroy(limit_remote_t **r)
 static limit_hash_item_t get_remote_usage(const char *key) {
 	limit_hash_item_t usage = { 0 };
 	switch_hash_index_t *hi;
+	uint32_t rate = 0;
+	time_t last_check = 0;
 	
 	switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
 	for (hi = switch_hash_first(NULL, globals.remote_hash); hi; hi = switch_hash_next(hi)) {
@@ -819,19 +1136,119 @@ static limit_hash_item_t get_remote_usage(const char *key) {
 		switch_thread_rwlock_rdlock(remote->rwlock);
 		if ((item = switch_core_hash_find(remote->index, key))) {
 			usage.total_usage += item->total_usage;
-			usage.rate_usage += item->rate_usage;
-			if (!usage.last_check) {
-				usage.last_check = item->last_check;
+			rate += LIMIT_WINDOW_COUNT(item->rate_window);
+			if (!last_check) {
+				last_check = LIMIT_WINDOW_START(item->rate_window);
 			}
 		}
 		switch_thread_rwlock_unlock(remote->rwlock);
 	}
 	
 	switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
+
+	usage.rate_window = LIMIT_WINDOW(last_check, rate);
 	
 	return usage;
 }
 
+/* Applies one answer to hash_dump delta, or to hash_dump limit for peers that don't know delta */
+static void limit_remote_sync(limit_remote_t *remote, const char *body)
+{
+	char *data = strdup(body);
+	char *p = data, *p2;
+	switch_time_t now = switch_epoch_time_now(NULL);
+	switch_bool_t full = SWITCH_TRUE;
+
+	if (!remote->legacy) {
+		char *argv[3] = { 0 };
+
+		if (strncmp(data, "V/", 2)) {
+			/* an older peer answers the unknown mode with its usage line */
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "[%s] Remote doesn't support delta sync, pulling full dumps\n", remote->name);
+			remote->legacy = SWITCH_TRUE;
+			free(data);
+			return;
+		}
+
+		if ((p2 = strchr(p, '\n'))) {
+			*p2++ = '\0';
+		}
+
+		if (switch_split(p + 2, '/', argv) < 3) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[%s] Protocol error: bad version line: %s\n", remote->name, p);
+			free(data);
+			return;
+		}
+
+		remote->peer_epoch = (uint32_t) strtoul(argv[0], NULL, 10);
+		remote->peer_version = (uint64_t) strtoull(argv[1], NULL, 10);
+		full = !strcmp(argv[2], "full");
+		p = p2;
+	}
+
+	while (p && *p) {
+		/* We are getting the limit data as:
+			L/key/usage/rate/interval/last_checked 
+		   and the keys freed since the last delta as:
+			X/key
+		*/
+		if ((p2 = strchr(p, '\n'))) {
+			*p2++ = '\0';
+		}
+		
+		/* Now p points at the beginning of the current line, 
+		p2 at the start of the next one */
+		if (*p == 'L') { /* Limit data */
+			char *argv[5]; 
+			int argc = switch_split(p+2, '/', argv);
+			
+			if (argc < 5) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[%s] Protocol error: missing argument in line: %s\n", 
+					remote->name, p);
+			} else {
+				limit_hash_item_t *item;
+				switch_thread_rwlock_wrlock(remote->rwlock);
+				if (!(item = switch_core_hash_find(remote->index, argv[0]))) {
+					item = malloc(sizeof(*item));
+					switch_assert(item);
+					memset(item, 0, sizeof(*item));
+					switch_core_hash_insert(remote->index, argv[0], item);
+				}
+				item->total_usage = atoi(argv[1]);
+				item->rate_window = LIMIT_WINDOW(atoi(argv[4]), atoi(argv[2]));
+				item->interval = atoi(argv[3]);
+				item->last_update = now;
+				switch_thread_rwlock_unlock(remote->rwlock);
+			}
+		} else if (*p == 'X' && p[1] == '/') { /* Freed on the remote */
+			limit_hash_item_t *item;
+
+			switch_thread_rwlock_wrlock(remote->rwlock);
+			if ((item = switch_core_hash_find(remote->index, p + 2))) {
+				switch_core_hash_delete(remote->index, p + 2);
+				free(item);
+			}
+			switch_thread_rwlock_unlock(remote->rwlock);
+		}
+		
+		p = p2;
+	}
+	free(data);
+
+	if (full) {
+		/* Now free up anything that wasn't in this update since it means their usage is 0 */
+		switch_thread_rwlock_wrlock(remote->rwlock);
+		switch_core_hash_delete_multi(remote->index, limit_hash_remote_cleanup_callback, (void*)(intptr_t)now);
+		switch_thread_rwlock_unlock(remote->rwlock);
+		remote->full_syncs++;
+	} else {
+		remote->delta_syncs++;
+	}
+
+	remote->sync_bytes += strlen(body);
+	remote->last_sync = switch_micro_time_now();
+}
+
 static void *SWITCH_THREAD_FUNC limit_remote_thread(switch_thread_t *thread, void *obj)
 {
 	limit_remote_t *remote = (limit_remote_t*)obj;
@@ -847,64 +1264,30 @@ static void *SWITCH_THREAD_FUNC limit_remote_thread(switch_thread_t *thread, voi
 				memset(&remote->handle, 0, sizeof(remote->handle));
 			}
 		} else {
-			if (esl_send_recv_timed(&remote->handle, "api hash_dump limit", 5000) != ESL_SUCCESS) {
+			char cmd[128] = "api hash_dump limit";
+
+			if (!remote->legacy) {
+				/* a full pull now and then also repairs a change that raced a delta */
+				int full = !remote->peer_version || !(++remote->polls % LIMIT_REMOTE_FULL_EVERY);
+
+				switch_snprintf(cmd, sizeof(cmd), "api hash_dump delta %u %llu", remote->peer_epoch,
+								full ? 0ULL : (unsigned long long) remote->peer_version);
+			}
+
+			if (esl_send_recv_timed(&remote->handle, cmd, 5000) != ESL_SUCCESS) {
 				esl_disconnect(&remote->handle);
 				memset(&remote->handle, 0, sizeof(remote->handle));
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Disconnected from remote FreeSWITCH (%s) at %s:%d\n",
 					remote->name, remote->host, remote->port);
 				memset(&remote->handle, 0, sizeof(remote->handle));
 				remote->state = REMOTE_DOWN;
+				remote->peer_version = 0;
 				/* Delete all remote tracking entries */
 				switch_thread_rwlock_wrlock(remote->rwlock);
 				switch_core_hash_delete_multi(remote->index, limit_hash_remote_cleanup_callback, NULL);
 				switch_thread_rwlock_unlock(remote->rwlock);
-			} else {
-				if (!zstr(remote->handle.last_sr_event->body)) {
-					char *data = strdup(remote->handle.last_sr_event->body);
-					char *p = data, *p2;
-					switch_time_t now = switch_epoch_time_now(NULL);
-					while (p && *p) {
-						/* We are getting the limit data as:
-							L/key/usage/rate/interval/last_checked 
-						*/
-						if ((p2 = strchr(p, '\n'))) {
-							*p2++ = '\0';
-						}
-						
-						/* Now p points at the beginning of the current line, 
-						p2 at the start of the next one */
-						if (*p == 'L') { /* Limit data */
-							char *argv[5]; 
-							int argc = switch_split(p+2, '/', argv);
-							
-							if (argc < 5) {
-								switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[%s] Protocol error: missing argument in line: %s\n", 
-									remote->name, p);
-							} else {
-								limit_hash_item_t *item;
-								switch_thread_rwlock_wrlock(remote->rwlock);
-								if (!(item = switch_core_hash_find(remote->index, argv[0]))) {
-									item = malloc(sizeof(*item));
-									switch_core_hash_insert(remote->index, argv[0], item);
-								}
-								item->total_usage = atoi(argv[1]);
-								item->rate_usage = atoi(argv[2]);
-								item->interval = atoi(argv[3]);
-								item->last_check = atoi(argv[4]);
-								item->last_update = now;
-								switch_thread_rwlock_unlock(remote->rwlock);
-							}
-						}
-						
-						p = p2;
-					}
-					free(data);
-					
-					/* Now free up anything that wasn't in this update since it means their usage is 0 */
-					switch_thread_rwlock_wrlock(remote->rwlock);
-					switch_core_hash_delete_multi(remote->index, limit_hash_remote_cleanup_callback, (void*)(intptr_t)now);
-					switch_thread_rwlock_unlock(remote->rwlock);
-				}
+			} else if (!zstr(remote->handle.last_sr_event->body)) {
+				limit_remote_sync(remote, remote->handle.last_sr_event->body);
 			}
 		}
 		
@@ -916,6 +1299,68 @@ static void *SWITCH_THREAD_FUNC limit_remote_thread(switch_thread_t *thread, voi
 	return NULL;
 }
 
+static void hash_metrics_collector(switch_stream_handle_t *stream, void *user_data)
+{
+	switch_hash_index_t *hi;
+	switch_time_t now = switch_micro_time_now();
+	void *val;
+	int x;
+
+	switch_metric_write_family(stream, "hash_limit_version", "Changes made to the local limit counters", SWITCH_METRIC_COUNTER);
+	switch_metric_write_value(stream, "hash_limit_version", NULL, (int64_t) limit_read64(&globals.limit_version));
+
+	switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
+
+	switch_metric_write_family(stream, "hash_remote_sync_lag_ms", "Milliseconds since the last sync from a remote, -1 before the first one",
+							   SWITCH_METRIC_GAUGE);
+	for (hi = switch_hash_first(NULL, globals.remote_hash); hi; hi = switch_hash_next(hi)) {
+		limit_remote_t *remote;
+		char labels[256];
+
+		switch_hash_this(hi, NULL, NULL, &val);
+		remote = (limit_remote_t *) val;
+		switch_snprintf(labels, sizeof(labels), "remote=\"%s\"", remote->name);
+		switch_metric_write_value(stream, "hash_remote_sync_lag_ms", labels, remote->last_sync ? (now - remote->last_sync) / 1000 : -1);
+	}
+
+	switch_metric_write_family(stream, "hash_remote_version", "Newest remote limit version applied", SWITCH_METRIC_GAUGE);
+	for (hi = switch_hash_first(NULL, globals.remote_hash); hi; hi = switch_hash_next(hi)) {
+		limit_remote_t *remote;
+		char labels[256];
+
+		switch_hash_this(hi, NULL, NULL, &val);
+		remote = (limit_remote_t *) val;
+		switch_snprintf(labels, sizeof(labels), "remote=\"%s\"", remote->name);
+		switch_metric_write_value(stream, "hash_remote_version", labels, (int64_t) remote->peer_version);
+	}
+
+	switch_metric_write_family(stream, "hash_remote_syncs_total", "Syncs pulled from a remote", SWITCH_METRIC_COUNTER);
+	for (hi = switch_hash_first(NULL, globals.remote_hash); hi; hi = switch_hash_next(hi)) {
+		limit_remote_t *remote;
+		char labels[256];
+
+		switch_hash_this(hi, NULL, NULL, &val);
+		remote = (limit_remote_t *) val;
+		for (x = 0; x < 2; x++) {
+			switch_snprintf(labels, sizeof(labels), "remote=\"%s\",type=\"%s\"", remote->name, x ? "delta" : "full");
+			switch_metric_write_value(stream, "hash_remote_syncs_total", labels, (int64_t) (x ? remote->delta_syncs : remote->full_syncs));
+		}
+	}
+
+	switch_metric_write_family(stream, "hash_remote_sync_bytes_total", "Bytes of limit data pulled from a remote", SWITCH_METRIC_COUNTER);
+	for (hi = switch_hash_first(NULL, globals.remote_hash); hi; hi = switch_hash_next(hi)) {
+		limit_remote_t *remote;
+		char labels[256];
+
+		switch_hash_this(hi, NULL, NULL, &val);
+		remote = (limit_remote_t *) val;
+		switch_snprintf(labels, sizeof(labels), "remote=\"%s\"", remote->name);
+		switch_metric_write_value(stream, "hash_remote_sync_bytes_total", labels, (int64_t) remote->sync_bytes);
+	}
+
+	switch_thread_rwlock_unlock(globals.remote_hash_rwlock);
+}
+
 static void do_config(switch_bool_t reload)
 {
 	switch_xml_t xml = NULL, x_lists = NULL, x_list = NULL, cfg = NULL;
@@ -963,6 +1408,59 @@ static void do_config(switch_bool_t reload)
 	}
 }
 
+#define HASH_SNAPSHOT_VERSION 1
+
+/* the hash api values survive a restart, a record is the key and the value, both nul terminated */
+static switch_status_t hash_snapshot_save(switch_snapshot_writer_t *writer, void *user_data)
+{
+	switch_hash_index_t *hi;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	switch_thread_rwlock_rdlock(globals.db_hash_rwlock);
+	for (hi = switch_hash_first(NULL, globals.db_hash); hi && status == SWITCH_STATUS_SUCCESS; hi = switch_hash_next(hi)) {
+		const void *key;
+		void *val;
+		switch_size_t klen, vlen;
+		char *record;
+
+		switch_hash_this(hi, &key, NULL, &val);
+		klen = strlen((const char *) key) + 1;
+		vlen = strlen((const char *) val) + 1;
+		switch_malloc(record, klen + vlen);
+		memcpy(record, key, klen);
+		memcpy(record + klen, val, vlen);
+		status = switch_snapshot_write(writer, record, klen + vlen);
+		free(record);
+	}
+	switch_thread_rwlock_unlock(globals.db_hash_rwlock);
+
+	return status;
+}
+
+static switch_status_t hash_snapshot_load(const void *data, switch_size_t len, uint32_t age, void *user_data)
+{
+	const char *key = (const char *) data, *val, *end = key + len;
+	char *value;
+
+	if (!len || !(val = memchr(key, '\0', len)) || ++val >= end || !memchr(val, '\0', end - val)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	value = strdup(val);
+	switch_assert(value);
+
+	switch_thread_rwlock_wrlock(globals.db_hash_rwlock);
+	if (switch_core_hash_find(globals.db_hash, key)) {
+		free(value);
+		value = NULL;
+	} else {
+		switch_core_hash_insert(globals.db_hash, key, value);
+	}
+	switch_thread_rwlock_unlock(globals.db_hash_rwlock);
+
+	return value ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
+}
+
 /* INIT/DEINIT STUFF */
 SWITCH_MODULE_LOAD_FUNCTION(mod_hash_load)
 {
@@ -980,12 +1478,17 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hash_load)
 		return SWITCH_STATUS_FALSE;
 	}
 
-	switch_thread_rwlock_create(&globals.limit_hash_rwlock, globals.pool);
 	switch_thread_rwlock_create(&globals.db_hash_rwlock, globals.pool);
+#if !defined(__GNUC__) && !defined(WIN32)
+	switch_mutex_init(&limit_atomic_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+#endif
 	switch_thread_rwlock_create(&globals.remote_hash_rwlock, globals.pool);
-	switch_core_hash_init(&globals.limit_hash, pool);
+	switch_core_striped_hash_init(&globals.limit_hash, pool, 0, SWITCH_TRUE);
 	switch_core_hash_init(&globals.db_hash, pool);
 	switch_core_hash_init(&globals.remote_hash, globals.pool);
+	switch_mutex_init(&globals.tombstone_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	globals.tombstones = switch_core_alloc(globals.pool, LIMIT_TOMBSTONES * sizeof(*globals.tombstones));
+	globals.limit_epoch = (uint32_t) switch_epoch_time_now(NULL);
 
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
@@ -1011,6 +1514,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hash_load)
 	
 	do_config(SWITCH_FALSE);
 
+	switch_metric_register_collector("hash", hash_metrics_collector, NULL);
+	switch_snapshot_register("mod_hash", HASH_SNAPSHOT_VERSION, hash_snapshot_save, hash_snapshot_load, NULL);
+
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;	
 }
@@ -1020,7 +1526,10 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown)
 {
 	switch_hash_index_t *hi;
 	switch_bool_t remote_clean = SWITCH_TRUE;
+	int x;
 	
+	switch_metric_unregister_collector("hash");
+	switch_snapshot_unregister("mod_hash");
 	switch_scheduler_del_task_group("mod_hash");
 
 	/* Kill remote connections, destroy needs a wrlock so we unlock after finding a pointer */
@@ -1047,17 +1556,15 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown)
 		}
 	}
 
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
-	switch_thread_rwlock_wrlock(globals.db_hash_rwlock);
-	
-	while ((hi = switch_hash_first(NULL, globals.limit_hash))) {
-		void *val = NULL;
-		const void *key;
-		switch_ssize_t keylen;
-		switch_hash_this(hi, &key, &keylen, &val);
-		free(val);
-		switch_core_hash_delete(globals.limit_hash, key);
+	switch_core_striped_hash_delete_multi(globals.limit_hash, limit_hash_free_callback, NULL);
+
+	switch_mutex_lock(globals.tombstone_mutex);
+	for (x = 0; x < LIMIT_TOMBSTONES; x++) {
+		switch_safe_free(globals.tombstones[x].key);
 	}
+	switch_mutex_unlock(globals.tombstone_mutex);
+
+	switch_thread_rwlock_wrlock(globals.db_hash_rwlock);
 	
 	while ((hi = switch_hash_first(NULL, globals.db_hash))) {
 		void *val = NULL;
@@ -1068,14 +1575,12 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown)
 		switch_core_hash_delete(globals.db_hash, key);
 	}
 
-	switch_core_hash_destroy(&globals.limit_hash);
+	switch_core_striped_hash_destroy(&globals.limit_hash);
 	switch_core_hash_destroy(&globals.db_hash);	
 
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 	switch_thread_rwlock_unlock(globals.db_hash_rwlock);
 
 	switch_thread_rwlock_destroy(globals.db_hash_rwlock);
-	switch_thread_rwlock_destroy(globals.limit_hash_rwlock);
 
 
 	return SWITCH_STATUS_SUCCESS;
@@ -69,6 +69,14 @@ typedef struct action_binding_s {
 	struct action_binding_s *parent;
 } action_binding_t;
 
+/* keep-alive handles are parked here between requests, the share hands dns and tls sessions between them */
+typedef struct httapi_curl_pool_s {
+	switch_queue_t *idle;
+	CURLSH *share;
+	switch_mutex_t *mutex[CURL_LOCK_DATA_LAST];
+	int http2;
+} httapi_curl_pool_t;
+
 typedef struct client_profile_s {
 	char *name;
 	char *method;
@@ -89,6 +97,7 @@ typedef struct client_profile_s {
 	int timeout;
 	profile_perms_t perms;
 	char *ua;
+	httapi_curl_pool_t curl;
 
 	struct {
 		char *use_profile;
@@ -113,6 +122,8 @@ typedef struct client_profile_s {
 
 #define HTTAPI_MAX_API_BYTES 1024 * 1024
 #define HTTAPI_MAX_FILE_BYTES 1024 * 1024 * 100
+#define HTTAPI_MAX_PREFETCH_THREADS 16
+#define HTTAPI_PREFETCH_QUEUE_LEN 256
 
 typedef struct client_s {
 	switch_memory_pool_t *pool;
@@ -153,8 +164,107 @@ static struct {
 	int debug;
 	int not_found_expires;
 	int cache_ttl;
+	httapi_curl_pool_t file_curl;
+	switch_queue_t *prefetch_queue;
+	switch_thread_t *prefetch_threads[HTTAPI_MAX_PREFETCH_THREADS];
+	int prefetch_thread_count;
 } globals;
 
+static void curl_pool_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userp)
+{
+	httapi_curl_pool_t *cpool = (httapi_curl_pool_t *) userp;
+
+	if (data < CURL_LOCK_DATA_LAST) {
+		switch_mutex_lock(cpool->mutex[data]);
+	}
+}
+
+static void curl_pool_unlock(CURL *handle, curl_lock_data data, void *userp)
+{
+	httapi_curl_pool_t *cpool = (httapi_curl_pool_t *) userp;
+
+	if (data < CURL_LOCK_DATA_LAST) {
+		switch_mutex_unlock(cpool->mutex[data]);
+	}
+}
+
+static void curl_pool_create(httapi_curl_pool_t *cpool, int size, int http2, switch_memory_pool_t *pool)
+{
+	int i;
+
+	memset(cpool, 0, sizeof(*cpool));
+	cpool->http2 = http2;
+
+	if (size > 0) {
+		switch_queue_create(&cpool->idle, size, pool);
+	}
+
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++) {
+		switch_mutex_init(&cpool->mutex[i], SWITCH_MUTEX_NESTED, pool);
+	}
+
+	if ((cpool->share = curl_share_init())) {
+		curl_share_setopt(cpool->share, CURLSHOPT_LOCKFUNC, curl_pool_lock);
+		curl_share_setopt(cpool->share, CURLSHOPT_UNLOCKFUNC, curl_pool_unlock);
+		curl_share_setopt(cpool->share, CURLSHOPT_USERDATA, cpool);
+		curl_share_setopt(cpool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+#if LIBCURL_VERSION_NUM >= 0x071700
+		curl_share_setopt(cpool->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#endif
+	}
+}
+
+static switch_CURL *curl_pool_get(httapi_curl_pool_t *cpool)
+{
+	switch_CURL *curl_handle = NULL;
+	void *pop = NULL;
+
+	if (cpool->idle && switch_queue_trypop(cpool->idle, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		/* the options go but the open connection stays with the handle */
+		curl_handle = (switch_CURL *) pop;
+		curl_easy_reset(curl_handle);
+	} else {
+		curl_handle = switch_curl_easy_init();
+	}
+
+	if (cpool->share) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SHARE, cpool->share);
+	}
+
+#if LIBCURL_VERSION_NUM >= 0x072100
+	if (cpool->http2) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_0);
+	}
+#endif
+
+	return curl_handle;
+}
+
+static void curl_pool_put(httapi_curl_pool_t *cpool, switch_CURL *curl_handle, switch_bool_t reuse)
+{
+	if (!reuse || !cpool->idle || switch_queue_trypush(cpool->idle, curl_handle) != SWITCH_STATUS_SUCCESS) {
+		switch_curl_easy_cleanup(curl_handle);
+	}
+}
+
+static void curl_pool_destroy(httapi_curl_pool_t *cpool)
+{
+	void *pop = NULL;
+
+	if (cpool->idle) {
+		while (switch_queue_trypop(cpool->idle, &pop) == SWITCH_STATUS_SUCCESS) {
+			if (pop) {
+				switch_curl_easy_cleanup((switch_CURL *) pop);
+			}
+		}
+	}
+
+	if (cpool->share) {
+		curl_share_cleanup(cpool->share);
+		cpool->share = NULL;
+	}
+}
+
 
 /* for apr_pstrcat */
 #define DEFAULT_PREBUFFER_SIZE 1024 * 64
@@ -1068,6 +1178,39 @@ static switch_status_t parse_common(const char *tag_name, client_t *client, swit
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* the first prompt is fetched by playback itself, the rest are warmed into the file cache while it plays */
+static void prefetch_playback_files(switch_xml_t work)
+{
+	switch_xml_t tag;
+	int first = 1;
+
+	for (tag = work->child; tag; tag = tag->ordered) {
+		const char *file;
+		char *path;
+
+		if (zstr(tag->name) || strcasecmp(tag->name, "playback") || !(file = switch_xml_attr(tag, "file"))) {
+			continue;
+		}
+
+		if (first) {
+			first = 0;
+			continue;
+		}
+
+		if (strncasecmp(file, "http://", 7) || strchr(file, '$')) {
+			continue;
+		}
+
+		path = strdup(file + 7);
+		switch_assert(path);
+
+		if (switch_queue_trypush(globals.prefetch_queue, path) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Prefetch queue full, skipping %s\n", file);
+			free(path);
+		}
+	}
+}
+
 static switch_status_t parse_xml(client_t *client)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
@@ -1126,6 +1269,10 @@ static switch_status_t parse_xml(client_t *client)
 			}
 
 			if ((category = switch_xml_child(xml, "work"))) {
+
+				if (globals.prefetch_queue) {
+					prefetch_playback_files(category);
+				}
 				
 				tag = category->child;
 				status = SWITCH_STATUS_SUCCESS;
@@ -1470,7 +1617,7 @@ static switch_status_t httapi_sync(client_t *client)
 		creds = client->profile->cred;
 	}
 
-	curl_handle = switch_curl_easy_init();
+	curl_handle = curl_pool_get(&client->profile->curl);
 
 	if (session_id) {
 		char *hval = switch_mprintf("HTTAPI_SESSION_ID=%s", session_id);
@@ -1573,7 +1720,8 @@ static switch_status_t httapi_sync(client_t *client)
 
 	switch_curl_easy_perform(curl_handle);
 	switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &client->code);
-	switch_curl_easy_cleanup(curl_handle);
+	/* the cookie jar is only written out when the handle is cleaned up */
+	curl_pool_put(&client->profile->curl, curl_handle, !client->profile->cookie_file);
 	switch_curl_slist_free_all(headers);
 
 	if (formpost) {
@@ -1618,6 +1766,8 @@ static switch_status_t do_config(void)
 	int x = 0;
 	int need_vars_map = 0;
 	switch_hash_t *vars_map = NULL;
+	int file_pool_size = 8;
+	int file_http2 = 0;
 
 	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "open of %s failed\n", cf);
@@ -1646,10 +1796,30 @@ static switch_status_t do_config(void)
 				if (globals.not_found_expires < 0) {
 					globals.not_found_expires = -1;
 				}
+			} else if (!strcasecmp(var, "file-connection-pool-size")) {
+				int tmp = atoi(val);
+
+				if (tmp > -1) {
+					file_pool_size = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid value [%s]for file-connection-pool-size\n", val);
+				}
+			} else if (!strcasecmp(var, "file-enable-http2")) {
+				file_http2 = switch_true(val);
+			} else if (!strcasecmp(var, "file-prefetch-threads")) {
+				int tmp = atoi(val);
+
+				if (tmp > -1 && tmp <= HTTAPI_MAX_PREFETCH_THREADS) {
+					globals.prefetch_thread_count = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid value [%s]for file-prefetch-threads\n", val);
+				}
 			}
 		}
 	}
 
+	curl_pool_create(&globals.file_curl, file_pool_size, file_http2, globals.pool);
+
 	if (!(profiles_tag = switch_xml_child(cfg, "profiles"))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Missing <profiles> tag!\n");
 		goto done;
@@ -1674,6 +1844,8 @@ static switch_status_t do_config(void)
 		char *ua = "mod_httapi/1.0";
 		hash_node_t *hash_node;
 		int auth_scheme = CURLAUTH_BASIC;
+		int pool_size = 8;
+		int http2 = 0;
 		need_vars_map = 0;
 		vars_map = NULL;
 
@@ -1761,6 +1933,15 @@ static switch_status_t do_config(void)
 					}
 				} else if (!strcasecmp(var, "bind-local")) {
 					bind_local = val;
+				} else if (!strcasecmp(var, "connection-pool-size")) {
+					int tmp = atoi(val);
+					if (tmp >= 0) {
+						pool_size = tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Can't set a negative connection-pool-size!\n");
+					}
+				} else if (!strcasecmp(var, "enable-http2")) {
+					http2 = switch_true(val);
 				}
 			}
 		}
@@ -1995,6 +2176,7 @@ static switch_status_t do_config(void)
 
 		profile->auth_scheme = auth_scheme;
 		profile->timeout = timeout;
+		curl_pool_create(&profile->curl, pool_size, http2, globals.pool);
 		profile->url = strdup(url);
 		switch_assert(profile->url);
 
@@ -2356,7 +2538,7 @@ static switch_status_t fetch_cache_data(http_file_context_t *context, const char
 		url = dynamic_url;
 	}
 
-	curl_handle = switch_curl_easy_init();
+	curl_handle = curl_pool_get(&globals.file_curl);
 
 	switch_curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1);
 
@@ -2398,7 +2580,7 @@ static switch_status_t fetch_cache_data(http_file_context_t *context, const char
 	switch_curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, ua);
 	switch_curl_easy_perform(curl_handle);
 	switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &code);
-	switch_curl_easy_cleanup(curl_handle);
+	curl_pool_put(&globals.file_curl, curl_handle, SWITCH_TRUE);
 	
 	if (client.fd > -1) {
 		close(client.fd);
@@ -2525,6 +2707,14 @@ static switch_status_t locate_url_file(http_file_context_t *context, const char
 
 	lock_file(context, SWITCH_TRUE);
 
+	/* a prefetch or another call may have fetched it while we waited for the lock */
+	load_cache_data(context, url);
+
+	if (context->expires && now < context->expires && switch_file_exists(context->cache_file, context->pool) == SWITCH_STATUS_SUCCESS) {
+		lock_file(context, SWITCH_FALSE);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	if ((status = fetch_cache_data(context, url, &headers, NULL)) != SWITCH_STATUS_SUCCESS) {
 		if (status == SWITCH_STATUS_NOTFOUND) {
 			unreachable = 2;
@@ -2585,6 +2775,59 @@ static switch_status_t locate_url_file(http_file_context_t *context, const char
 }
 
 
+static void prefetch_url_file(const char *path)
+{
+	switch_memory_pool_t *pool = NULL;
+	http_file_context_t *context;
+	char *parsed = NULL, *pdup = NULL;
+
+	switch_core_new_memory_pool(&pool);
+	context = switch_core_alloc(pool, sizeof(*context));
+	context->pool = pool;
+
+	pdup = switch_core_strdup(context->pool, path);
+
+	switch_event_create_brackets(pdup, '(', ')', ',', &context->url_params, &parsed, SWITCH_FALSE);
+
+	if (parsed) path = parsed;
+
+	context->dest_url = switch_core_sprintf(context->pool, "http://%s", path);
+
+	if (locate_url_file(context, context->dest_url) == SWITCH_STATUS_SUCCESS) {
+		if (context->del_on_close) {
+			/* not ours to keep, playback will fetch it again */
+			unlink(context->cache_file);
+			unlink(context->meta_file);
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "prefetched: url:%s\n", context->dest_url);
+		}
+	}
+
+	if (context->url_params) {
+		switch_event_destroy(&context->url_params);
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+}
+
+static void *SWITCH_THREAD_FUNC prefetch_thread_run(switch_thread_t *thread, void *obj)
+{
+	void *pop = NULL;
+
+	while (switch_queue_pop(globals.prefetch_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		char *path = (char *) pop;
+
+		if (!path) {
+			break;
+		}
+
+		prefetch_url_file(path);
+		free(path);
+	}
+
+	return NULL;
+}
+
 static switch_status_t http_file_file_seek(switch_file_handle_t *handle, unsigned int *cur_sample, int64_t samples, int whence)
 {
 	http_file_context_t *context = handle->private_info;
@@ -2809,6 +3052,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_httapi_load)
 	globals.hash_tail = NULL;
 	globals.cache_ttl = 300;
 	globals.not_found_expires = 300;
+	globals.prefetch_thread_count = 2;
 
 
 	http_file_supported_formats[0] = "http";
@@ -2850,6 +3094,19 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_httapi_load)
 	if (do_config() != SWITCH_STATUS_SUCCESS) {
 		return SWITCH_STATUS_FALSE;
 	}
+
+	if (globals.prefetch_thread_count) {
+		switch_threadattr_t *thd_attr = NULL;
+		int i;
+
+		switch_queue_create(&globals.prefetch_queue, HTTAPI_PREFETCH_QUEUE_LEN, globals.pool);
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+		for (i = 0; i < globals.prefetch_thread_count; i++) {
+			switch_thread_create(&globals.prefetch_threads[i], thd_attr, prefetch_thread_run, NULL, globals.pool);
+		}
+	}
 	
 	SWITCH_ADD_API(httapi_api_interface, "httapi",
 				   "HT-TAPI Hypertext Telephony API", httapi_api_function, HTTAPI_SYNTAX);
@@ -2874,6 +3131,29 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_httapi_shutdown)
 	switch_hash_index_t *hi;
 	void *val;
 	const void *vvar;
+	int i;
+
+	if (globals.prefetch_queue) {
+		switch_status_t st;
+		void *pop = NULL;
+
+		/* drop whatever is still waiting so the threads see their NULL right away */
+		while (switch_queue_trypop(globals.prefetch_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			switch_safe_free(pop);
+		}
+
+		for (i = 0; i < globals.prefetch_thread_count; i++) {
+			switch_queue_push(globals.prefetch_queue, NULL);
+		}
+
+		for (i = 0; i < globals.prefetch_thread_count; i++) {
+			if (globals.prefetch_threads[i]) {
+				switch_thread_join(&st, globals.prefetch_threads[i]);
+			}
+		}
+	}
+
+	curl_pool_destroy(&globals.file_curl);
 
 	for (hi = switch_hash_first(NULL, globals.profile_hash); hi; hi = switch_hash_next(hi)) {
 		switch_hash_this(hi, &vvar, NULL, &val);
@@ -2882,6 +3162,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_httapi_shutdown)
 		switch_event_destroy(&profile->var_params.expand_var_list);
 		switch_event_destroy(&profile->var_params.set_var_list);
 		switch_event_destroy(&profile->var_params.get_var_list);
+		curl_pool_destroy(&profile->curl);
 	}
 
 
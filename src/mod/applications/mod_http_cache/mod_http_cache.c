@@ -47,6 +47,7 @@ SWITCH_STANDARD_API(http_cache_prefetch);
 #define DOWNLOAD_NEEDED "download"
 
 typedef struct url_cache url_cache_t;
+typedef struct url_cache_shard url_cache_shard_t;
 
 /**
  * status if the cache entry
@@ -71,20 +72,40 @@ struct cached_url {
 	char *filename;
 	/** The size of the cached URL, in bytes */
 	size_t size;
-	/** URL use flag */
-	int used;
 	/** Status of this entry */
 	cached_url_status_t status;
-	/** Number of sessions waiting for this URL */
-	int waiters;
+	/** Number of downloads, waiters and streams using this URL, it is not destroyed while in use */
+	int refs;
+	/** Queued for a prefetch thread, nobody is downloading it yet */
+	int pending;
+	/** The server answered 200 so the bytes written so far can be played */
+	int streamable;
 	/** time when downloaded */
 	switch_time_t download_time;
 	/** nanoseconds until stale */
 	switch_time_t max_age;
+	/** nanoseconds after going stale that it is still served while it is revalidated in the background */
+	switch_time_t stale_while_revalidate;
+	/** ETag of the response, sent as If-None-Match to revalidate */
+	char *etag;
+	/** Last-Modified of the response, sent as If-Modified-Since to revalidate */
+	char *last_modified;
+	/** Being revalidated, or queued to be */
+	int revalidating;
+	/** Queued for a prefetch thread to revalidate */
+	int refresh_queued;
+	/** The shard indexing this URL */
+	url_cache_shard_t *shard;
+	/** In the shard index and LRU list */
+	int linked;
+	/** More recently used URL */
+	struct cached_url *prev;
+	/** Less recently used URL */
+	struct cached_url *next;
 };
 typedef struct cached_url cached_url_t;
 
-static cached_url_t *cached_url_create(url_cache_t *cache, const char *url);
+static cached_url_t *cached_url_create(url_cache_t *cache, const char *url, switch_memory_pool_t *pool);
 static void cached_url_destroy(cached_url_t *url, switch_memory_pool_t *pool);
 
 /**
@@ -95,10 +116,14 @@ struct http_get_data {
 	int fd;
 	/** The cached URL data */
 	cached_url_t *url;
+	/** The transfer, to check the response code on the first write */
+	switch_CURL *curl_handle;
+	/** Response code has been checked */
+	int checked;
 };
 typedef struct http_get_data http_get_data_t;
 
-static switch_status_t http_get(url_cache_t *cache, cached_url_t *url, switch_core_session_t *session);
+static switch_status_t http_get(url_cache_t *cache, cached_url_t *url, switch_core_session_t *session, cached_url_t *validator);
 static size_t get_file_callback(void *ptr, size_t size, size_t nmemb, void *get);
 static size_t get_header_callback(void *ptr, size_t size, size_t nmemb, void *url);
 static void process_cache_control_header(cached_url_t *url, char *data);
@@ -106,22 +131,28 @@ static void process_cache_control_header(cached_url_t *url, char *data);
 static switch_status_t http_put(url_cache_t *cache, switch_core_session_t *session, const char *url, const char *filename);
 
 /**
- * Queue used for clock cache replacement algorithm.  This
- * queue has been simplified since replacement only happens
- * once it is filled.
+ * One part of the cache index.  URLs are spread over the shards by hash so
+ * lookups of different URLs do not wait on one lock.  Each shard replaces its
+ * own least recently used URLs to stay within its part of the limits.
  */
-struct simple_queue {
-	/** The queue data */
-	void **data;
-	/** queue bounds */
-	size_t max_size;
-	/** queue size */
+struct url_cache_shard {
+	/** Cached URLs mapped by URL */
+	switch_hash_t *map;
+	/** Most recently used URL */
+	cached_url_t *head;
+	/** Least recently used URL, the first to be replaced */
+	cached_url_t *tail;
+	/** The number of URLs in this shard */
+	int count;
+	/** The maximum number of URLs in this shard */
+	int max_url;
+	/** The size of the downloaded URLs in this shard, in bytes */
 	size_t size;
-	/** Current index */
-	int pos;
+	/** The maximum size of this shard, in bytes, 0 for no limit */
+	size_t max_size;
+	/** Synchronizes access to this shard */
+	switch_mutex_t *mutex;
 };
-typedef struct simple_queue simple_queue_t;
-
 
 /**
  * The cache
@@ -129,28 +160,28 @@ typedef struct simple_queue simple_queue_t;
 struct url_cache {
 	/** The maximum number of URLs to cache */
 	int max_url;
-	/** The maximum size of this cache, in bytes */
+	/** The maximum size of this cache, in bytes, 0 for no limit */
 	size_t max_size;
 	/** The default time to allow a cached URL to live, if none is specified */
 	switch_time_t default_max_age;
-	/** The current size of this cache, in bytes */
-	size_t size;
+	/** The default time to serve a stale URL while it is revalidated, if none is specified */
+	switch_time_t default_stale_while_revalidate;
 	/** The location of the cache in the filesystem */
 	char *location;
-	/** Cache mapped by URL */
-	switch_hash_t *map;
-	/** Cached URLs queued for replacement */
-	simple_queue_t queue;
-	/** Synchronizes access to cache */
-	switch_mutex_t *mutex;
+	/** The cache index, split in shards */
+	url_cache_shard_t *shards;
+	/** Number of shards */
+	int shard_count;
+	/** Save the index on shutdown and load it on startup instead of emptying the cache */
+	int persist_index;
 	/** Memory pool */
 	switch_memory_pool_t *pool;
 	/** Number of cache hits */
-	int hits;
+	switch_atomic_t hits;
 	/** Number of cache misses */
-	int misses;
+	switch_atomic_t misses;
 	/** Number of cache errors */
-	int errors;
+	switch_atomic_t errors;
 	/** The prefetch queue */
 	switch_queue_t *prefetch_queue;
 	/** Max size of prefetch queue */
@@ -167,17 +198,28 @@ struct url_cache {
 	int ssl_verifypeer;
 	/** Verify that hostname matches certificate */
 	int ssl_verifyhost;
+	/** Bytes downloaded before a stream starts playing a URL that is still downloading */
+	size_t stream_prebuffer;
 };
 static url_cache_t gcache;
 
 static char *url_cache_get(url_cache_t *cache, switch_core_session_t *session, const char *url, int download, switch_memory_pool_t *pool);
-static switch_status_t url_cache_add(url_cache_t *cache, switch_core_session_t *session, cached_url_t *url);
+static cached_url_t *url_cache_find(url_cache_t *cache, url_cache_shard_t *shard, switch_core_session_t *session, const char *url, switch_memory_pool_t *pool);
+static cached_url_t *url_cache_stream(url_cache_t *cache, const char *url, switch_memory_pool_t *pool);
+static void url_cache_release(url_cache_t *cache, cached_url_t *url);
+static cached_url_t *url_cache_expired(url_cache_t *cache, url_cache_shard_t *shard, switch_core_session_t *session, cached_url_t *url, const char *key, int download, switch_memory_pool_t *pool);
+static void url_cache_revalidate(url_cache_t *cache, url_cache_shard_t *shard, switch_core_session_t *session, cached_url_t *url, switch_memory_pool_t *pool);
+static void url_cache_prefetch(url_cache_t *cache, const char *url, switch_memory_pool_t *pool);
+static switch_status_t url_cache_add(url_cache_t *cache, url_cache_shard_t *shard, switch_core_session_t *session, cached_url_t *url);
 static void url_cache_remove(url_cache_t *cache, switch_core_session_t *session, cached_url_t *url);
-static void url_cache_remove_soft(url_cache_t *cache, switch_core_session_t *session, cached_url_t *url);
-static switch_status_t url_cache_replace(url_cache_t *cache, switch_core_session_t *session);
-static void url_cache_lock(url_cache_t *cache, switch_core_session_t *session);
-static void url_cache_unlock(url_cache_t *cache, switch_core_session_t *session);
-static void url_cache_clear(url_cache_t *cache, switch_core_session_t *session);
+static void url_cache_unref(url_cache_t *cache, cached_url_t *url);
+static switch_status_t url_cache_replace(url_cache_t *cache, url_cache_shard_t *shard, switch_core_session_t *session, int room);
+static url_cache_shard_t *url_cache_shard(url_cache_t *cache, const char *url);
+static void url_cache_lock(url_cache_shard_t *shard, switch_core_session_t *session);
+static void url_cache_unlock(url_cache_shard_t *shard, switch_core_session_t *session);
+static void url_cache_clear(url_cache_t *cache, switch_core_session_t *session, int keep_files);
+static void url_cache_save_index(url_cache_t *cache);
+static void url_cache_load_index(url_cache_t *cache);
 
 /**
  * Put a file to the URL
@@ -283,7 +325,17 @@ static size_t get_file_callback(void *ptr, size_t size, size_t nmemb, void *get)
 		if (bytes_written != realsize) {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "write(): short write!\n");
 		}
+
+		/* streams read up to the size while the download goes on */
+		switch_mutex_lock(get_data->url->shard->mutex);
+		if (!get_data->checked) {
+			long httpRes = 0;
+			switch_curl_easy_getinfo(get_data->curl_handle, CURLINFO_RESPONSE_CODE, &httpRes);
+			get_data->url->streamable = (httpRes == 200);
+			get_data->checked = 1;
+		}
 		get_data->url->size += bytes_written;
+		switch_mutex_unlock(get_data->url->shard->mutex);
 		result = bytes_written;
 	}
 	
@@ -326,14 +378,36 @@ static char *trim(char *str)
 }
 
 #define MAX_AGE "max-age="
+#define STALE_WHILE_REVALIDATE "stale-while-revalidate="
 /**
- * cache-control: max-age=123456
- * Only support max-age.  All other params are ignored.
+ * Find the value of a cache-control param counted in seconds
+ * @param data the header value
+ * @param param the param, including the =
+ * @return the seconds or -1 if the param is missing
+ */
+static int cache_control_seconds(const char *data, const char *param)
+{
+	const char *value = strcasestr(data, param);
+
+	if (!value) {
+		return -1;
+	}
+
+	value += strlen(param);
+	if (!isdigit(*value)) {
+		return -1;
+	}
+
+	return atoi(value);
+}
+
+/**
+ * cache-control: max-age=123456, stale-while-revalidate=60
+ * Only support max-age and stale-while-revalidate.  All other params are ignored.
  */
 static void process_cache_control_header(cached_url_t *url, char *data)
 {
-	char *max_age_str;
-	switch_time_t max_age;
+	int seconds;
 
 	/* trim whitespace and check if empty */
 	data = trim(data);
@@ -341,38 +415,37 @@ static void process_cache_control_header(cached_url_t *url, char *data)
 		return;
 	}
 
-	/* find max-age param */
-	max_age_str = strcasestr(data, MAX_AGE);
-	if (zstr(max_age_str)) {
-		return;
+	if ((seconds = cache_control_seconds(data, MAX_AGE)) >= 0) {
+		url->max_age = (switch_time_t) seconds * 1000 * 1000;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "setting max age to %d seconds from now\n", seconds);
 	}
 
-	/* find max-age value */
-	max_age_str = max_age_str + (sizeof(MAX_AGE) - 1);
-	if (zstr(max_age_str)) {
-		return;
-	}
-	for (int i = 0; i < strlen(max_age_str); i++) {
-		if (!isdigit(max_age_str[i])) {
-			max_age_str[i] = '\0';
-			break;
-		}
-	}
-	if (zstr(max_age_str)) {
-		return;
+	if ((seconds = cache_control_seconds(data, STALE_WHILE_REVALIDATE)) >= 0) {
+		url->stale_while_revalidate = (switch_time_t) seconds * 1000 * 1000;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "setting stale-while-revalidate to %d seconds\n", seconds);
 	}
-	max_age = atoi(max_age_str);
+}
 
-	if (max_age < 0) {
-		return;
+/**
+ * Remember a validator header for revalidating the URL later
+ * @param value where the value is kept
+ * @param data the header value
+ */
+static void process_validator_header(char **value, char *data)
+{
+	data = trim(data);
+	switch_safe_free(*value);
+	if (!zstr(data) && !strpbrk(data, "\t\r\n")) {
+		*value = strdup(data);
 	}
-
-	url->max_age = max_age * 1000 * 1000;
-	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "setting max age to %u seconds from now\n", (int)max_age);
 }
 
 #define CACHE_CONTROL_HEADER "cache-control:"
 #define CACHE_CONTROL_HEADER_LEN (sizeof(CACHE_CONTROL_HEADER) - 1)
+#define ETAG_HEADER "etag:"
+#define ETAG_HEADER_LEN (sizeof(ETAG_HEADER) - 1)
+#define LAST_MODIFIED_HEADER "last-modified:"
+#define LAST_MODIFIED_HEADER_LEN (sizeof(LAST_MODIFIED_HEADER) - 1)
 /**
  * Called by libcurl to process headers from HTTP GET response
  * @param ptr the header data
@@ -400,6 +473,10 @@ static size_t get_header_callback(void *ptr, size_t size, size_t nmemb, void *ge
 	/* check which header this is and process it */
 	if (!strncasecmp(CACHE_CONTROL_HEADER, header, CACHE_CONTROL_HEADER_LEN)) {
 		process_cache_control_header(url, header + CACHE_CONTROL_HEADER_LEN);
+	} else if (!strncasecmp(ETAG_HEADER, header, ETAG_HEADER_LEN)) {
+		process_validator_header(&url->etag, header + ETAG_HEADER_LEN);
+	} else if (!strncasecmp(LAST_MODIFIED_HEADER, header, LAST_MODIFIED_HEADER_LEN)) {
+		process_validator_header(&url->last_modified, header + LAST_MODIFIED_HEADER_LEN);
 	}
 
 	switch_safe_free(header);
@@ -407,53 +484,69 @@ static size_t get_header_callback(void *ptr, size_t size, size_t nmemb, void *ge
 }
 
 /**
- * Get exclusive access to the cache
+ * Find the shard indexing a URL
  * @param cache The cache
+ * @param url The URL
+ * @return the shard
+ */
+static url_cache_shard_t *url_cache_shard(url_cache_t *cache, const char *url)
+{
+	switch_ssize_t len = -1;
+
+	return &cache->shards[switch_hashfunc_default(url, &len) % cache->shard_count];
+}
+
+/**
+ * Get exclusive access to a shard of the cache
+ * @param shard The shard
  * @param session The session acquiring the cache
  */
-static void url_cache_lock(url_cache_t *cache, switch_core_session_t *session)
+static void url_cache_lock(url_cache_shard_t *shard, switch_core_session_t *session)
 {
-	switch_mutex_lock(cache->mutex);
+	switch_mutex_lock(shard->mutex);
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Locked cache\n");
 }
 
 /**
- * Relinquish exclusive access to the cache
- * @param cache The cache
+ * Relinquish exclusive access to a shard of the cache
+ * @param shard The shard
  * @param session The session relinquishing the cache
  */
-static void url_cache_unlock(url_cache_t *cache, switch_core_session_t *session)
+static void url_cache_unlock(url_cache_shard_t *shard, switch_core_session_t *session)
 {
-	switch_mutex_unlock(cache->mutex);
+	switch_mutex_unlock(shard->mutex);
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Unlocked cache\n");
 }
 
 /**
  * Empties the cache
+ * @param cache The cache
+ * @param session the (optional) session
+ * @param keep_files leave the downloaded files on disk, used when the index has been saved
  */
-static void url_cache_clear(url_cache_t *cache, switch_core_session_t *session)
+static void url_cache_clear(url_cache_t *cache, switch_core_session_t *session, int keep_files)
 {
-	url_cache_lock(cache, session);
-
-	// remove each cached URL from the hash and the queue
-	for (int i = 0; i < cache->queue.max_size; i++) {
-		cached_url_t *url = cache->queue.data[i];
-		if (url) {
-			switch_core_hash_delete(cache->map, url->url);
-			cached_url_destroy(url, cache->pool);
-			cache->queue.data[i] = NULL;
+	for (int i = 0; i < cache->shard_count; i++) {
+		url_cache_shard_t *shard = &cache->shards[i];
+		cached_url_t *url;
+
+		url_cache_lock(shard, session);
+
+		// remove each cached URL from the hash and the LRU list
+		while ((url = shard->head)) {
+			if (keep_files && url->status == CACHED_URL_AVAILABLE) {
+				switch_safe_free(url->filename);
+			}
+			url_cache_remove(cache, session, url);
 		}
+
+		url_cache_unlock(shard, session);
 	}
-	cache->queue.pos = 0;
-	cache->queue.size = 0;
 
 	// reset cache stats
-	cache->size = 0;
-	cache->hits = 0;
-	cache->misses = 0;
-	cache->errors = 0;
-
-	url_cache_unlock(cache, session);
+	switch_atomic_set(&cache->hits, 0);
+	switch_atomic_set(&cache->misses, 0);
+	switch_atomic_set(&cache->errors, 0);
 
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Emptied cache\n");
 }
@@ -471,196 +564,467 @@ static char *url_cache_get(url_cache_t *cache, switch_core_session_t *session, c
 {
 	char *filename = NULL;
 	cached_url_t *u = NULL;
+	url_cache_shard_t *shard;
+	int fetch = 0;
 	if (zstr(url)) {
 		return NULL;
 	}
 
-	url_cache_lock(cache, session);
-	u = switch_core_hash_find(cache->map, url);
+	shard = url_cache_shard(cache, url);
+	url_cache_lock(shard, session);
+	u = url_cache_find(cache, shard, session, url, pool);
 
-	if (u && u->status == CACHED_URL_AVAILABLE) {
-		if (switch_time_now() >= (u->download_time + u->max_age)) {
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Cached URL has expired.\n");
-			url_cache_remove_soft(cache, session, u); /* will get permanently deleted upon replacement */
-			u = NULL;
-		} else if (switch_file_exists(u->filename, pool) != SWITCH_STATUS_SUCCESS) {
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Cached URL file is missing.\n");
-			url_cache_remove_soft(cache, session, u); /* will get permanently deleted upon replacement */
-			u = NULL;
-		}
+	if (u && u->status == CACHED_URL_AVAILABLE && switch_time_now() >= (u->download_time + u->max_age)) {
+		u = url_cache_expired(cache, shard, session, u, url, download, pool);
 	}
 
 	if (!u && download) {
 		/* URL is not cached, let's add it.*/
 		/* Set up URL entry and add to map to prevent simultaneous downloads */
-		cache->misses++;
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Cache MISS: size = %zu (%zu MB), hit ratio = %d/%d\n", cache->queue.size, cache->size / 1000000, cache->hits, cache->hits + cache->misses);
-		u = cached_url_create(cache, url);
-		if (url_cache_add(cache, session, u) != SWITCH_STATUS_SUCCESS) {
-			/* This error should never happen */
-			url_cache_unlock(cache, session);
+		switch_atomic_inc(&cache->misses);
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Cache MISS: shard size = %d (%zu MB), hit ratio = %u/%u\n",
+						  shard->count, shard->size / 1000000, switch_atomic_read(&cache->hits), switch_atomic_read(&cache->hits) + switch_atomic_read(&cache->misses));
+		u = cached_url_create(cache, url, pool);
+		if (url_cache_add(cache, shard, session, u) != SWITCH_STATUS_SUCCESS) {
+			/* Every URL in the shard is in use */
+			url_cache_unlock(shard, session);
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Failed to add URL to cache!\n");
 			cached_url_destroy(u, cache->pool);
 			return NULL;
 		}
+		fetch = 1;
+	} else if (u && u->pending && download) {
+		/* a stream queued this URL and is waiting for someone to download it */
+		u->pending = 0;
+		fetch = 1;
+	}
 
+	if (fetch) {
 		/* download the file */
-		url_cache_unlock(cache, session);
-		if (http_get(cache, u, session) == SWITCH_STATUS_SUCCESS) {
+		u->refs++;
+		url_cache_unlock(shard, session);
+		if (http_get(cache, u, session, NULL) == SWITCH_STATUS_SUCCESS) {
 			/* Got the file, let the waiters know it is available */
-			url_cache_lock(cache, session);
+			url_cache_lock(shard, session);
 			u->status = CACHED_URL_AVAILABLE;
 			filename = switch_core_strdup(pool, u->filename);
-			cache->size += u->size;
+			shard->size += u->size;
+			url_cache_replace(cache, shard, session, 0);
 		} else {
-			/* Did not get the file, flag for replacement */
-			url_cache_lock(cache, session);
-			url_cache_remove_soft(cache, session, u);
+			/* Did not get the file, remove it once nobody is waiting for it */
+			url_cache_lock(shard, session);
+			url_cache_remove(cache, session, u);
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Failed to download URL %s\n", url);
-			cache->errors++;
+			switch_atomic_inc(&cache->errors);
 		}
+		url_cache_unref(cache, u);
 	} else if (!u) {
 		filename = DOWNLOAD_NEEDED;
 	} else {
+		u->refs++;
+
 		/* Wait until file is downloaded */
 		if (u->status == CACHED_URL_RX_IN_PROGRESS) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Waiting for URL %s to be available\n", url);
-			u->waiters++;
-			url_cache_unlock(cache, session);
+			url_cache_unlock(shard, session);
 			while(u->status == CACHED_URL_RX_IN_PROGRESS) {
 				switch_sleep(10 * 1000); /* 10 ms */
 			}
-			url_cache_lock(cache, session);
-			u->waiters--;
+			url_cache_lock(shard, session);
 		}
 
 		/* grab filename if everything is OK */
 		if (u->status == CACHED_URL_AVAILABLE) {
 			filename = switch_core_strdup(pool, u->filename);
-			cache->hits++;
-			u->used = 1;
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Cache HIT: size = %zu (%zu MB), hit ratio = %d/%d\n", cache->queue.size, cache->size / 1000000, cache->hits, cache->hits + cache->misses);
+			switch_atomic_inc(&cache->hits);
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Cache HIT: shard size = %d (%zu MB), hit ratio = %u/%u\n",
+							  shard->count, shard->size / 1000000, switch_atomic_read(&cache->hits), switch_atomic_read(&cache->hits) + switch_atomic_read(&cache->misses));
 		}
+		url_cache_unref(cache, u);
 	}
-	url_cache_unlock(cache, session);
+	url_cache_unlock(shard, session);
 	return filename;
 }
 
 /**
- * Add a URL to the cache.  The caller must lock the cache.
- * @param cache the cache
+ * Look up a URL, dropping it if its file is gone.  The caller must lock the shard and check if it has expired.
+ * @param cache The cache
+ * @param shard The shard indexing the URL
  * @param session the (optional) session
- * @param url the URL to add
- * @return SWITCH_STATUS_SUCCESS if successful
+ * @param url The URL
+ * @param pool The pool to use for checking the file
+ * @return The cached URL, available or still downloading, or NULL
  */
-static switch_status_t url_cache_add(url_cache_t *cache, switch_core_session_t *session, cached_url_t *url)
+static cached_url_t *url_cache_find(url_cache_t *cache, url_cache_shard_t *shard, switch_core_session_t *session, const char *url, switch_memory_pool_t *pool)
 {
-	simple_queue_t *queue = &cache->queue;
-	if (queue->size >= queue->max_size && url_cache_replace(cache, session) != SWITCH_STATUS_SUCCESS) {
-		return SWITCH_STATUS_FALSE;
+	cached_url_t *u = switch_core_hash_find(shard->map, url);
+
+	if (u && u->status == CACHED_URL_AVAILABLE && switch_file_exists(u->filename, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Cached URL file is missing.\n");
+		url_cache_remove(cache, session, u);
+		u = NULL;
 	}
-	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Adding %s(%s) to cache index %d\n", url->url, url->filename, queue->pos);
 
-	queue->data[queue->pos] = url;
-	queue->pos = (queue->pos + 1) % queue->max_size;
-	queue->size++;
-	switch_core_hash_insert(cache->map, url->url, url);
-	return SWITCH_STATUS_SUCCESS;
+	if (u && u != shard->head) {
+		/* move to the front of the LRU list */
+		if ((u->prev->next = u->next)) {
+			u->next->prev = u->prev;
+		} else {
+			shard->tail = u->prev;
+		}
+		u->prev = NULL;
+		u->next = shard->head;
+		shard->head->prev = u;
+		shard->head = u;
+	}
+
+	return u;
 }
 
 /**
- * Select a URL for replacement and remove it from the cache.
- * Currently implemented with the clock replacement algorithm.  It's not
- * great, but is better than least recently used and is simple to implement.
- *
- * @param cache the cache
- * @param session the (optional) session 
- * @return SWITCH_STATUS_SUCCESS if successful
+ * Get a URL to stream from the cache without waiting for the download to finish.  A URL that is
+ * not cached is added and handed to the prefetch threads, so every stream of it shares one download.
+ * @param cache The cache
+ * @param url The URL
+ * @param pool The pool to use for checking the file
+ * @return The cached URL, hold until url_cache_release(), or NULL if there is an error
  */
-static switch_status_t url_cache_replace(url_cache_t *cache, switch_core_session_t *session)
+static cached_url_t *url_cache_stream(url_cache_t *cache, const char *url, switch_memory_pool_t *pool)
 {
-	switch_status_t status = SWITCH_STATUS_FALSE;
-	int i = 0;
-	simple_queue_t *queue = &cache->queue;
-	
-	if (queue->size < queue->max_size || queue->size == 0) {
-		return SWITCH_STATUS_FALSE;
+	cached_url_t *u = NULL;
+	url_cache_shard_t *shard;
+	int queued = 1;
+
+	if (zstr(url)) {
+		return NULL;
 	}
 
-	for (i = 0; i < queue->max_size * 2; i++) {
-		cached_url_t *to_replace = (cached_url_t *)queue->data[queue->pos];
+	shard = url_cache_shard(cache, url);
+	url_cache_lock(shard, NULL);
 
-		/* check for queue corruption */
-		if (to_replace == NULL) {
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Unexpected empty URL at cache index %d\n", queue->pos);
-			status = SWITCH_STATUS_SUCCESS;
-			break;
+	if ((u = url_cache_find(cache, shard, NULL, url, pool)) && u->status == CACHED_URL_AVAILABLE &&
+		switch_time_now() >= (u->download_time + u->max_age)) {
+		u = url_cache_expired(cache, shard, NULL, u, url, 1, pool);
+	}
+
+	if (u) {
+		switch_atomic_inc(&cache->hits);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Cache HIT: shard size = %d (%zu MB), hit ratio = %u/%u\n",
+						  shard->count, shard->size / 1000000, switch_atomic_read(&cache->hits), switch_atomic_read(&cache->hits) + switch_atomic_read(&cache->misses));
+	} else {
+		char *qurl;
+
+		switch_atomic_inc(&cache->misses);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Cache MISS: shard size = %d (%zu MB), hit ratio = %u/%u\n",
+						  shard->count, shard->size / 1000000, switch_atomic_read(&cache->hits), switch_atomic_read(&cache->hits) + switch_atomic_read(&cache->misses));
+		u = cached_url_create(cache, url, pool);
+		if (url_cache_add(cache, shard, NULL, u) != SWITCH_STATUS_SUCCESS) {
+			url_cache_unlock(shard, NULL);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failed to add URL to cache!\n");
+			cached_url_destroy(u, cache->pool);
+			return NULL;
 		}
+		u->pending = 1;
 
-		/* check if available for replacement */
-		if (!to_replace->used && !to_replace->waiters) {
-			/* remove from cache and destroy it */
-			url_cache_remove(cache, session, to_replace);
-			cached_url_destroy(to_replace, cache->pool);
-			status = SWITCH_STATUS_SUCCESS;
-			break;
+		qurl = strdup(url);
+		if (switch_queue_trypush(cache->prefetch_queue, qurl) != SWITCH_STATUS_SUCCESS) {
+			switch_safe_free(qurl);
+			queued = 0;
 		}
+	}
 
-		/* not available for replacement.  Mark as not used and move to back of queue */
-		if (to_replace->status == CACHED_URL_AVAILABLE) {
-			to_replace->used = 0;
+	u->refs++;
+	url_cache_unlock(shard, NULL);
+
+	if (!queued) {
+		/* no room in the prefetch queue, download it here like http_get would */
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Prefetch queue is full, downloading %s before playing it\n", url);
+		url_cache_get(cache, NULL, url, 1, pool);
+	}
+
+	return u;
+}
+
+/**
+ * Deal with an expired URL.  Within its stale-while-revalidate time it is served as is and
+ * queued for a prefetch thread to revalidate, after that it is revalidated before it is served.
+ * The caller must lock the shard.
+ * @param cache The cache
+ * @param shard The shard indexing the URL
+ * @param session the (optional) session
+ * @param url The expired URL
+ * @param key The URL, to find what replaced it
+ * @param download If false the URL is not revalidated
+ * @param pool The pool to use for creating files
+ * @return The URL to serve, NULL if it has to be downloaded
+ */
+static cached_url_t *url_cache_expired(url_cache_t *cache, url_cache_shard_t *shard, switch_core_session_t *session, cached_url_t *url, const char *key, int download, switch_memory_pool_t *pool)
+{
+	cached_url_t *u;
+
+	if (switch_time_now() < (url->download_time + url->max_age + url->stale_while_revalidate)) {
+		if (!url->revalidating) {
+			char *qurl = strdup(url->url);
+			if (switch_queue_trypush(cache->prefetch_queue, qurl) == SWITCH_STATUS_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Cached URL is stale, revalidating in the background.\n");
+				url->revalidating = 1;
+				url->refresh_queued = 1;
+			} else {
+				switch_safe_free(qurl);
+			}
 		}
-		queue->pos = (queue->pos + 1) % queue->max_size;
+		return url;
 	}
 
-	return status;
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Cached URL has expired.\n");
+
+	if (!download) {
+		return NULL;
+	}
+
+	url->refs++;
+	if (url->revalidating && !url->refresh_queued) {
+		/* use whatever the revalidation in progress gets */
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Waiting for URL %s to be revalidated\n", key);
+		while (url->revalidating) {
+			url_cache_unlock(shard, session);
+			switch_sleep(10 * 1000); /* 10 ms */
+			url_cache_lock(shard, session);
+		}
+	} else {
+		/* not revalidated yet or only queued, do it now */
+		url_cache_revalidate(cache, shard, session, url, pool);
+	}
+
+	/* the revalidated or replacing URL, the stale one if the server could not be reached */
+	u = switch_core_hash_find(shard->map, key);
+	url_cache_unref(cache, url);
+
+	return u;
 }
 
 /**
- * Remove a URL from the hash map and mark it as eligible for replacement from the queue.
+ * Revalidate an expired URL with a conditional GET.  A 304 keeps the file and restarts its max age,
+ * a 200 replaces it with a new entry and the old one goes once nothing uses it.  On an error the
+ * stale entry is kept so it can still be served.  The caller must lock the shard and hold a
+ * reference to the URL, the lock is released during the GET.
+ * @param cache The cache
+ * @param shard The shard indexing the URL
+ * @param session the (optional) session
+ * @param url The expired URL
+ * @param pool The pool to use for creating the file
  */
-static void url_cache_remove_soft(url_cache_t *cache, switch_core_session_t *session, cached_url_t *url)
+static void url_cache_revalidate(url_cache_t *cache, url_cache_shard_t *shard, switch_core_session_t *session, cached_url_t *url, switch_memory_pool_t *pool)
 {
-	switch_core_hash_delete(cache->map, url->url);
-	url->used = 0;
-	url->status = CACHED_URL_REMOVE;
+	cached_url_t *fresh = cached_url_create(cache, url->url, pool);
+	switch_status_t status;
+
+	url->revalidating = 1;
+	url->refresh_queued = 0;
+	fresh->shard = shard;
+
+	url_cache_unlock(shard, session);
+	status = http_get(cache, fresh, session, url);
+	url_cache_lock(shard, session);
+
+	if (status == SWITCH_STATUS_NOOP) {
+		/* not modified, keep the file with the new freshness of the response */
+		url->download_time = fresh->download_time;
+		url->max_age = fresh->max_age;
+		url->stale_while_revalidate = fresh->stale_while_revalidate;
+		if (fresh->etag) {
+			switch_safe_free(url->etag);
+			url->etag = fresh->etag;
+			fresh->etag = NULL;
+		}
+		if (fresh->last_modified) {
+			switch_safe_free(url->last_modified);
+			url->last_modified = fresh->last_modified;
+			fresh->last_modified = NULL;
+		}
+		cached_url_destroy(fresh, cache->pool);
+	} else if (status == SWITCH_STATUS_SUCCESS) {
+		cached_url_t *current = switch_core_hash_find(shard->map, url->url);
+
+		if (current && current != url) {
+			/* replaced meanwhile */
+			cached_url_destroy(fresh, cache->pool);
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "URL %s has changed, replacing the cached copy\n", url->url);
+			url_cache_remove(cache, session, url);
+			fresh->status = CACHED_URL_AVAILABLE;
+			if (url_cache_add(cache, shard, session, fresh) == SWITCH_STATUS_SUCCESS) {
+				shard->size += fresh->size;
+				url_cache_replace(cache, shard, session, 0);
+			} else {
+				cached_url_destroy(fresh, cache->pool);
+			}
+		}
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Failed to revalidate URL %s, serving the stale copy\n", url->url);
+		switch_atomic_inc(&cache->errors);
+		cached_url_destroy(fresh, cache->pool);
+	}
+
+	url->revalidating = 0;
+}
+
+/**
+ * Prefetch a URL or revalidate a stale one, run by the prefetch threads
+ * @param cache The cache
+ * @param url The URL
+ * @param pool The pool to use for creating files
+ */
+static void url_cache_prefetch(url_cache_t *cache, const char *url, switch_memory_pool_t *pool)
+{
+	url_cache_shard_t *shard = url_cache_shard(cache, url);
+	cached_url_t *u;
+
+	url_cache_lock(shard, NULL);
+	if ((u = switch_core_hash_find(shard->map, url)) && u->refresh_queued) {
+		u->refs++;
+		url_cache_revalidate(cache, shard, NULL, u, pool);
+		url_cache_unref(cache, u);
+		url_cache_unlock(shard, NULL);
+		return;
+	}
+	url_cache_unlock(shard, NULL);
+
+	url_cache_get(cache, NULL, url, 1, pool);
+}
+
+/**
+ * Done streaming a URL, it may be replaced again
+ * @param cache The cache
+ * @param url The cached URL from url_cache_stream()
+ */
+static void url_cache_release(url_cache_t *cache, cached_url_t *url)
+{
+	url_cache_shard_t *shard = url->shard;
+
+	url_cache_lock(shard, NULL);
+	url_cache_unref(cache, url);
+	url_cache_unlock(shard, NULL);
+}
+
+/**
+ * Add a URL to the front of a shard.  The caller must lock the shard.
+ * @param cache the cache
+ * @param shard the shard indexing the URL
+ * @param session the (optional) session
+ * @param url the URL to add
+ * @return SWITCH_STATUS_SUCCESS if successful
+ */
+static switch_status_t url_cache_add(url_cache_t *cache, url_cache_shard_t *shard, switch_core_session_t *session, cached_url_t *url)
+{
+	if (url_cache_replace(cache, shard, session, 1) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Adding %s(%s) to cache\n", url->url, url->filename);
+
+	url->shard = shard;
+	url->linked = 1;
+	url->prev = NULL;
+	if ((url->next = shard->head)) {
+		shard->head->prev = url;
+	} else {
+		shard->tail = url;
+	}
+	shard->head = url;
+	shard->count++;
+	switch_core_hash_insert(shard->map, url->url, url);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/**
+ * Replace the least recently used URLs of a shard until it is within its limits.
+ * URLs that are downloading or in use are skipped.  The caller must lock the shard.
+ *
+ * @param cache the cache
+ * @param shard the shard
+ * @param session the (optional) session
+ * @param room the number of URLs about to be added
+ * @return SWITCH_STATUS_SUCCESS if there is room for them
+ */
+static switch_status_t url_cache_replace(url_cache_t *cache, url_cache_shard_t *shard, switch_core_session_t *session, int room)
+{
+	cached_url_t *to_replace = shard->tail;
+
+	while (to_replace && (shard->count + room > shard->max_url || (shard->max_size && shard->size > shard->max_size))) {
+		cached_url_t *prev = to_replace->prev;
+
+		if (to_replace->status == CACHED_URL_AVAILABLE && !to_replace->refs) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Replacing %s(%s), %zu bytes\n", to_replace->url, to_replace->filename, to_replace->size);
+			url_cache_remove(cache, session, to_replace);
+		}
+		to_replace = prev;
+	}
+
+	return shard->count + room > shard->max_url ? SWITCH_STATUS_FALSE : SWITCH_STATUS_SUCCESS;
 }
 
 /**
- * Remove a URL from the front or back of the cache
+ * Remove a URL from its shard.  It is destroyed now or when the last reference
+ * to it is dropped.  The caller must lock the shard.
  * @param cache the cache
  * @param session the (optional) session
  * @param url the URL to remove
  */
 static void url_cache_remove(url_cache_t *cache, switch_core_session_t *session, cached_url_t *url)
 {
-	simple_queue_t *queue;
-	cached_url_t *to_remove;
-
-	url_cache_remove_soft(cache, session, url);
-
-	/* make sure cached URL matches the item in the queue and remove it */
-	queue = &cache->queue;
-	to_remove = (cached_url_t *)queue->data[queue->pos];
-	if (url == to_remove) {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Removing %s(%s) from cache index %d\n", url->url, url->filename, queue->pos);
-		queue->data[queue->pos] = NULL;
-		queue->size--; 
-	} else {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "URL entry, %s, not in cache queue!!!\n", url->url);
+	url_cache_shard_t *shard = url->shard;
+
+	if (url->linked) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Removing %s(%s) from cache\n", url->url, switch_str_nil(url->filename));
+		switch_core_hash_delete(shard->map, url->url);
+
+		if (url->prev) {
+			url->prev->next = url->next;
+		} else {
+			shard->head = url->next;
+		}
+		if (url->next) {
+			url->next->prev = url->prev;
+		} else {
+			shard->tail = url->prev;
+		}
+		url->prev = url->next = NULL;
+		url->linked = 0;
+		shard->count--;
+
+		/* adjust cache statistics */
+		if (url->status == CACHED_URL_AVAILABLE) {
+			shard->size -= url->size;
+		}
 	}
 
-	/* adjust cache statistics */
-	cache->size -= url->size;
+	url->status = CACHED_URL_REMOVE;
+
+	if (!url->refs) {
+		cached_url_destroy(url, cache->pool);
+	}
+}
+
+/**
+ * Drop a reference to a URL, destroying it if it was removed meanwhile.  The caller must lock the shard.
+ * @param cache the cache
+ * @param url the URL
+ */
+static void url_cache_unref(url_cache_t *cache, cached_url_t *url)
+{
+	if (!--url->refs && !url->linked) {
+		cached_url_destroy(url, cache->pool);
+	}
 }
 
 /**
  * Create a cached URL entry
  * @param cache the cache
  * @param url the URL to cache
+ * @param pool the pool to use for creating the cache directory
  * @return the cached URL
  */
-static cached_url_t *cached_url_create(url_cache_t *cache, const char *url)
+static cached_url_t *cached_url_create(url_cache_t *cache, const char *url, switch_memory_pool_t *pool)
 {
 	switch_uuid_t uuid;
 	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1] = { 0 };
@@ -684,7 +1048,7 @@ static cached_url_t *cached_url_create(url_cache_t *cache, const char *url)
 	filename = &uuid_str[2];
 
 	/* create sub-directory if it doesn't exist */
-	switch_dir_make_recursive(dirname, SWITCH_DEFAULT_DIR_PERMS, cache->pool);
+	switch_dir_make_recursive(dirname, SWITCH_DEFAULT_DIR_PERMS, pool);
 	
 	/* find extension on the end of URL */
 	for(const char *ext = &url[strlen(url) - 1]; ext != url; ext--) {
@@ -702,11 +1066,13 @@ static cached_url_t *cached_url_create(url_cache_t *cache, const char *url)
 	u->filename = switch_mprintf("%s%s%s%s", dirname, SWITCH_PATH_SEPARATOR, filename, file_extension);
 	u->url = switch_safe_strdup(url);
 	u->size = 0;
-	u->used = 1;
 	u->status = CACHED_URL_RX_IN_PROGRESS;
-	u->waiters = 0;
+	u->refs = 0;
+	u->pending = 0;
+	u->streamable = 0;
 	u->download_time = switch_time_now();
 	u->max_age = cache->default_max_age;
+	u->stale_while_revalidate = cache->default_stale_while_revalidate;
 
 	switch_safe_free(dirname);
 
@@ -724,6 +1090,8 @@ static void cached_url_destroy(cached_url_t *url, switch_memory_pool_t *pool)
 	}
 	switch_safe_free(url->filename);
 	switch_safe_free(url->url);
+	switch_safe_free(url->etag);
+	switch_safe_free(url->last_modified);
 	switch_safe_free(url);
 }
 
@@ -732,21 +1100,38 @@ static void cached_url_destroy(cached_url_t *url, switch_memory_pool_t *pool)
  * @param cache the cache
  * @param url The cached URL entry
  * @param session the (optional) session
- * @return SWITCH_STATUS_SUCCESS if successful
+ * @param validator (optional) the stale entry of the URL, makes this a conditional GET with its ETag and Last-Modified
+ * @return SWITCH_STATUS_SUCCESS if successful, SWITCH_STATUS_NOOP if the server says the validator is not modified
  */
-static switch_status_t http_get(url_cache_t *cache, cached_url_t *url, switch_core_session_t *session)
+static switch_status_t http_get(url_cache_t *cache, cached_url_t *url, switch_core_session_t *session, cached_url_t *validator)
 {
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 	switch_CURL *curl_handle = NULL;
+	switch_curl_slist_t *headers = NULL;
 	http_get_data_t get_data = {0};
 	long httpRes = 0;
 	int start_time_ms = switch_time_now() / 1000;
 
+	if (validator) {
+		char *header;
+		if (validator->etag) {
+			header = switch_mprintf("If-None-Match: %s", validator->etag);
+			headers = switch_curl_slist_append(headers, header);
+			switch_safe_free(header);
+		}
+		if (validator->last_modified) {
+			header = switch_mprintf("If-Modified-Since: %s", validator->last_modified);
+			headers = switch_curl_slist_append(headers, header);
+			switch_safe_free(header);
+		}
+	}
+
 	/* set up HTTP GET */
 	get_data.fd = 0;
 	get_data.url = url;
 	
 	curl_handle = switch_curl_easy_init();
+	get_data.curl_handle = curl_handle;
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "opening %s for URL cache\n", get_data.url->filename);
 	if ((get_data.fd = open(get_data.url->filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR)) > -1) {
 		switch_curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1);
@@ -757,6 +1142,9 @@ static switch_status_t http_get(url_cache_t *cache, cached_url_t *url, switch_co
 		switch_curl_easy_setopt(curl_handle, CURLOPT_HEADERFUNCTION, get_header_callback);
 		switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEHEADER, (void *) url);
 		switch_curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "freeswitch-http-cache/1.0");	
+		if (headers) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
+		}
 		if (!cache->ssl_verifypeer) {
 			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0L);
 		} else {
@@ -772,13 +1160,19 @@ static switch_status_t http_get(url_cache_t *cache, cached_url_t *url, switch_co
 		switch_curl_easy_perform(curl_handle);
 		switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &httpRes);
 		switch_curl_easy_cleanup(curl_handle);
+		switch_curl_slist_free_all(headers);
 		close(get_data.fd);
 	} else {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "open() error: %s\n", strerror(errno));
+		switch_curl_easy_cleanup(curl_handle);
+		switch_curl_slist_free_all(headers);
 		return SWITCH_STATUS_GENERR;
 	}
 
-	if (httpRes == 200) {
+	if (httpRes == 304 && validator) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "URL %s not modified, revalidated in %d ms\n", url->url, (int) (switch_time_now() / 1000) - start_time_ms);
+		status = SWITCH_STATUS_NOOP;
+	} else if (httpRes == 200) {
 		int duration_ms = (switch_time_now() / 1000) - start_time_ms;
 		if (duration_ms > 500) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "URL %s downloaded in %d ms\n", url->url, duration_ms);
@@ -786,7 +1180,10 @@ static switch_status_t http_get(url_cache_t *cache, cached_url_t *url, switch_co
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "URL %s downloaded in %d ms\n", url->url, duration_ms);
 		}
 	} else {
+		switch_mutex_lock(url->shard->mutex);
 		url->size = 0; // nothing downloaded or download interrupted
+		url->streamable = 0;
+		switch_mutex_unlock(url->shard->mutex);
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Received HTTP error %ld trying to fetch %s\n", httpRes, url->url);
 		return SWITCH_STATUS_GENERR;
 	}
@@ -795,10 +1192,11 @@ static switch_status_t http_get(url_cache_t *cache, cached_url_t *url, switch_co
 }
 
 /**
- * Empties the entire cache
- * @param cache the cache to empty
+ * Create the cache directories and delete the files in them that are not indexed
+ * @param cache the cache
+ * @param known the files of the loaded index, NULL to empty the entire cache
  */
-static void setup_dir(url_cache_t *cache)
+static void setup_dir(url_cache_t *cache, switch_hash_t *known)
 {
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "setting up %s\n", cache->location);
 	switch_dir_make_recursive(cache->location, SWITCH_DEFAULT_DIR_PERMS, cache->pool);
@@ -813,8 +1211,10 @@ static void setup_dir(url_cache_t *cache)
 			for(filename = switch_dir_next_file(dir, filenamebuf, sizeof(filenamebuf)); filename;
 					filename = switch_dir_next_file(dir, filenamebuf, sizeof(filenamebuf))) {
 				char *path = switch_mprintf("%s%s%s", dirname, SWITCH_PATH_SEPARATOR, filename);
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "deleting: %s\n", path);
-				switch_file_remove(path, cache->pool);
+				if (!known || !switch_core_hash_find(known, path)) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "deleting: %s\n", path);
+					switch_file_remove(path, cache->pool);
+				}
 				switch_safe_free(path);
 			}
 			switch_dir_close(dir);
@@ -823,6 +1223,186 @@ static void setup_dir(url_cache_t *cache)
 	}
 }
 
+#define INDEX_FILE "index"
+#define INDEX_HEADER "FSHTTPCACHE 2\n"
+
+/**
+ * Save the index of the downloaded URLs so the next start keeps them.  The
+ * index is written aside and renamed so a crash never leaves half of one.
+ * Each line is download time, max age, stale-while-revalidate, size, file, ETag,
+ * Last-Modified and URL separated by tabs.
+ * @param cache the cache
+ */
+static void url_cache_save_index(url_cache_t *cache)
+{
+	char *path = switch_mprintf("%s%s%s", cache->location, SWITCH_PATH_SEPARATOR, INDEX_FILE);
+	char *tmp = switch_mprintf("%s.tmp", path);
+	FILE *f;
+	int count = 0;
+	int ok = 1;
+
+	if (!(f = fopen(tmp, "w"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot write cache index %s: %s\n", tmp, strerror(errno));
+		goto done;
+	}
+
+	if (fputs(INDEX_HEADER, f) < 0) {
+		ok = 0;
+	}
+
+	for (int i = 0; ok && i < cache->shard_count; i++) {
+		url_cache_shard_t *shard = &cache->shards[i];
+
+		url_cache_lock(shard, NULL);
+		/* least recently used first, loading adds each one to the front */
+		for (cached_url_t *u = shard->tail; u && ok; u = u->prev) {
+			if (u->status != CACHED_URL_AVAILABLE || strpbrk(u->url, "\t\r\n") || strpbrk(u->filename, "\t\r\n")) {
+				continue;
+			}
+			if (fprintf(f, "%" SWITCH_INT64_T_FMT "\t%" SWITCH_INT64_T_FMT "\t%" SWITCH_INT64_T_FMT "\t%zu\t%s\t%s\t%s\t%s\n",
+						(int64_t) u->download_time, (int64_t) u->max_age, (int64_t) u->stale_while_revalidate, u->size, u->filename,
+						switch_str_nil(u->etag), switch_str_nil(u->last_modified), u->url) < 0) {
+				ok = 0;
+			} else {
+				count++;
+			}
+		}
+		url_cache_unlock(shard, NULL);
+	}
+
+	if (fclose(f) != 0) {
+		ok = 0;
+	}
+
+	if (ok) {
+#ifdef WIN32
+		remove(path);
+#endif
+		if (rename(tmp, path) != 0) {
+			ok = 0;
+		}
+	}
+
+	if (ok) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Saved %d cached URLs to %s\n", count, path);
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot write cache index %s\n", path);
+		remove(tmp);
+	}
+
+done:
+	switch_safe_free(tmp);
+	switch_safe_free(path);
+}
+
+/**
+ * Load the index saved by url_cache_save_index().  URLs that expired meanwhile with
+ * nothing to revalidate them with or whose file is gone or changed size are skipped,
+ * the limits apply as they are added.
+ * @param cache the cache
+ */
+static void url_cache_load_index(url_cache_t *cache)
+{
+	char *path = switch_mprintf("%s%s%s", cache->location, SWITCH_PATH_SEPARATOR, INDEX_FILE);
+	size_t location_len = strlen(cache->location);
+	switch_time_t now = switch_time_now();
+	char line[8192];
+	FILE *f;
+	int count = 0;
+
+	if (!(f = fopen(path, "r"))) {
+		goto done;
+	}
+
+	if (!fgets(line, sizeof(line), f) || strcmp(line, INDEX_HEADER)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Ignoring cache index %s, unknown format\n", path);
+		fclose(f);
+		goto done;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		size_t len = strlen(line);
+		char *field[8] = { 0 };
+		char *p = line;
+		int n;
+		struct stat st;
+		switch_time_t download_time, max_age, stale_while_revalidate;
+		size_t size;
+		url_cache_shard_t *shard;
+		cached_url_t *u;
+
+		if (!len || line[len - 1] != '\n') {
+			/* too long for a URL anyone plays, skip the rest of it */
+			while (len == sizeof(line) - 1 && line[len - 1] != '\n' && fgets(line, sizeof(line), f)) {
+				len = strlen(line);
+			}
+			continue;
+		}
+		line[len - 1] = '\0';
+
+		for (n = 0; n < 8 && p; n++) {
+			field[n] = p;
+			if ((p = strchr(p, '\t')) && n < 7) {
+				*p++ = '\0';
+			}
+		}
+
+		if (n != 8 || zstr(field[7])) {
+			continue;
+		}
+
+		download_time = (switch_time_t) strtoll(field[0], NULL, 10);
+		max_age = (switch_time_t) strtoll(field[1], NULL, 10);
+		stale_while_revalidate = (switch_time_t) strtoll(field[2], NULL, 10);
+		size = (size_t) strtoull(field[3], NULL, 10);
+
+		/* only files of this cache that can still be served or revalidated */
+		if ((now >= download_time + max_age + stale_while_revalidate && zstr(field[5]) && zstr(field[6])) ||
+			strncmp(field[4], cache->location, location_len) || stat(field[4], &st) || (size_t) st.st_size != size) {
+			continue;
+		}
+
+		shard = url_cache_shard(cache, field[7]);
+		url_cache_lock(shard, NULL);
+
+		if (switch_core_hash_find(shard->map, field[7])) {
+			url_cache_unlock(shard, NULL);
+			continue;
+		}
+
+		switch_zmalloc(u, sizeof(cached_url_t));
+		u->url = strdup(field[7]);
+		u->filename = strdup(field[4]);
+		u->size = size;
+		u->status = CACHED_URL_AVAILABLE;
+		u->download_time = download_time;
+		u->max_age = max_age;
+		u->stale_while_revalidate = stale_while_revalidate;
+		u->etag = zstr(field[5]) ? NULL : strdup(field[5]);
+		u->last_modified = zstr(field[6]) ? NULL : strdup(field[6]);
+
+		if (url_cache_add(cache, shard, NULL, u) == SWITCH_STATUS_SUCCESS) {
+			shard->size += u->size;
+			url_cache_replace(cache, shard, NULL, 0);
+		} else {
+			switch_safe_free(u->filename);
+			cached_url_destroy(u, cache->pool);
+		}
+
+		url_cache_unlock(shard, NULL);
+	}
+
+	fclose(f);
+
+	for (int i = 0; i < cache->shard_count; i++) {
+		count += cache->shards[i].count;
+	}
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Loaded %d cached URLs from %s\n", count, path);
+
+done:
+	switch_safe_free(path);
+}
+
 static int isUrl(const char *filename)
 {
 	return !zstr(filename) && (!strncmp("http://", filename, strlen("http://")) || !strncmp("https://", filename, strlen("https://")));
@@ -979,13 +1559,173 @@ SWITCH_STANDARD_API(http_cache_clear)
 	if (!zstr(cmd)) {
 		stream->write_function(stream, "USAGE: %s\n", HTTP_CACHE_CLEAR_SYNTAX);
 	} else {
-		url_cache_clear(&gcache, session);
+		url_cache_clear(&gcache, session, 0);
 		stream->write_function(stream, "+OK\n");
 	}
 	return SWITCH_STATUS_SUCCESS;
 }
 
 
+/**
+ * File interface context, a file handle on the cached file that may still be downloading
+ */
+struct http_cache_file_context {
+	/** The cached URL being played */
+	cached_url_t *url;
+	/** The handle on the cached file */
+	switch_file_handle_t fh;
+	/** The download had finished when the last read ran out of data */
+	int complete;
+};
+typedef struct http_cache_file_context http_cache_file_context_t;
+
+/**
+ * Check how far the download of a URL has gone
+ * @param cache the cache
+ * @param url the cached URL
+ * @param size set to what has been downloaded so far, 0 until the server answered 200
+ * @return the status of the URL
+ */
+static cached_url_status_t cached_url_progress(url_cache_t *cache, cached_url_t *url, size_t *size)
+{
+	cached_url_status_t status;
+
+	switch_mutex_lock(url->shard->mutex);
+	status = url->status;
+	*size = url->streamable ? url->size : 0;
+	switch_mutex_unlock(url->shard->mutex);
+
+	return status;
+}
+
+/**
+ * Open a URL for playback as http_cache://http://server/file.wav, playing starts once stream-prebuffer
+ * bytes are downloaded while the rest of the download goes on
+ */
+static switch_status_t http_cache_file_open(switch_file_handle_t *handle, const char *path)
+{
+	http_cache_file_context_t *context;
+	cached_url_status_t status;
+	size_t size = 0;
+	int flags = SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT;
+	const char *url = path;
+
+	if (switch_test_flag(handle, SWITCH_FILE_FLAG_WRITE)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "http_cache files are read only, use http_put to upload %s\n", path);
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	if (!isUrl(url)) {
+		url = switch_core_sprintf(handle->memory_pool, "http://%s", path);
+	}
+
+	context = switch_core_alloc(handle->memory_pool, sizeof(*context));
+
+	if (!(context->url = url_cache_stream(&gcache, url, handle->memory_pool))) {
+		return SWITCH_STATUS_GENERR;
+	}
+
+	while ((status = cached_url_progress(&gcache, context->url, &size)) == CACHED_URL_RX_IN_PROGRESS && (!size || size < gcache.stream_prebuffer)) {
+		switch_sleep(10 * 1000); /* 10 ms */
+	}
+
+	if (status == CACHED_URL_AVAILABLE) {
+		context->complete = 1;
+	} else if (status == CACHED_URL_RX_IN_PROGRESS) {
+		/* the prompt cache and read ahead would only see what is there now */
+		flags |= SWITCH_FILE_NOCACHE;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Streaming %s with %zu bytes downloaded\n", url, size);
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Failed to download URL %s\n", url);
+		url_cache_release(&gcache, context->url);
+		return SWITCH_STATUS_GENERR;
+	}
+
+	if (switch_core_file_open(&context->fh, context->url->filename, handle->channels, handle->samplerate, flags, NULL) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Failed to open %s cached from %s\n", context->url->filename, url);
+		url_cache_release(&gcache, context->url);
+		return SWITCH_STATUS_GENERR;
+	}
+
+	handle->private_info = context;
+	handle->samples = context->fh.samples;
+	handle->format = context->fh.format;
+	handle->sections = context->fh.sections;
+	handle->seekable = context->complete ? context->fh.seekable : 0;
+	handle->speed = context->fh.speed;
+	handle->interval = context->fh.interval;
+
+	if (switch_test_flag((&context->fh), SWITCH_FILE_NATIVE)) {
+		switch_set_flag(handle, SWITCH_FILE_NATIVE);
+	} else {
+		switch_clear_flag(handle, SWITCH_FILE_NATIVE);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t http_cache_file_close(switch_file_handle_t *handle)
+{
+	http_cache_file_context_t *context = handle->private_info;
+
+	if (switch_test_flag((&context->fh), SWITCH_FILE_OPEN)) {
+		switch_core_file_close(&context->fh);
+	}
+
+	url_cache_release(&gcache, context->url);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t http_cache_file_read(switch_file_handle_t *handle, void *data, size_t *len)
+{
+	http_cache_file_context_t *context = handle->private_info;
+	switch_status_t status;
+	size_t want = *len;
+	size_t size;
+
+	if ((status = switch_core_file_read(&context->fh, data, len)) == SWITCH_STATUS_SUCCESS && *len) {
+		return status;
+	}
+
+	if (context->complete) {
+		return status;
+	}
+
+	/* caught up with the download */
+	switch (cached_url_progress(&gcache, context->url, &size)) {
+	case CACHED_URL_RX_IN_PROGRESS:
+		/* play silence until more arrives */
+		*len = want;
+		memset(data, 0, *len * 2);
+		status = SWITCH_STATUS_SUCCESS;
+		break;
+	default:
+		/* it finished or failed since the read, play whatever is left */
+		context->complete = 1;
+		*len = want;
+		status = switch_core_file_read(&context->fh, data, len);
+		break;
+	}
+
+	return status;
+}
+
+static switch_status_t http_cache_file_seek(switch_file_handle_t *handle, unsigned int *cur_sample, int64_t samples, int whence)
+{
+	http_cache_file_context_t *context = handle->private_info;
+
+	if (!handle->seekable) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "File is not seekable\n");
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	return switch_core_file_seek(&context->fh, cur_sample, samples, whence);
+}
+
+static char *http_cache_supported_formats[SWITCH_MAX_CODECS] = { 0 };
+
+
 /**
  * Thread to prefetch URLs
  * @param thread the thread
@@ -1003,10 +1743,10 @@ static void *SWITCH_THREAD_FUNC prefetch_thread(switch_thread_t *thread, void *o
 	// process prefetch requests
 	while (!gcache.shutdown) {
 		if (switch_queue_pop(gcache.prefetch_queue, &url) == SWITCH_STATUS_SUCCESS) {
-			switch_stream_handle_t stream = { 0 };
-			SWITCH_STANDARD_STREAM(stream);
-			switch_api_execute("http_get", url, NULL, &stream);
-			switch_safe_free(stream.data);
+			switch_memory_pool_t *pool = NULL;
+			switch_core_new_memory_pool(&pool);
+			url_cache_prefetch(&gcache, url, pool);
+			switch_core_destroy_memory_pool(&pool);
 			switch_safe_free(url);
 		}
 		url = NULL;
@@ -1035,6 +1775,7 @@ static switch_status_t do_config(url_cache_t *cache)
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 	int max_urls;
 	switch_time_t default_max_age_sec;
+	switch_time_t default_stale_while_revalidate_sec;
 
 	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "open of %s failed\n", cf);
@@ -1044,12 +1785,17 @@ static switch_status_t do_config(url_cache_t *cache)
 	/* set default config */
 	max_urls = 4000;
 	default_max_age_sec = 86400;
+	default_stale_while_revalidate_sec = 0;
 	cache->location = SWITCH_PREFIX_DIR "/http_cache";
 	cache->prefetch_queue_size = 100;
 	cache->prefetch_thread_count = 8;
 	cache->ssl_cacert = SWITCH_PREFIX_DIR "/conf/cacert.pem";
 	cache->ssl_verifyhost = 1;
 	cache->ssl_verifypeer = 1;
+	cache->stream_prebuffer = 65536;
+	cache->max_size = 0;
+	cache->shard_count = 16;
+	cache->persist_index = 1;
 
 	/* get params */
 	settings = switch_xml_child(cfg, "settings");
@@ -1066,6 +1812,9 @@ static switch_status_t do_config(url_cache_t *cache)
 			} else if (!strcasecmp(var, "default-max-age")) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting default-max-age to %s\n", val);
 				default_max_age_sec = atoi(val);
+			} else if (!strcasecmp(var, "default-stale-while-revalidate")) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting default-stale-while-revalidate to %s\n", val);
+				default_stale_while_revalidate_sec = atoi(val);
 			} else if (!strcasecmp(var, "prefetch-queue-size")) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting prefetch-queue-size to %s\n", val);
 				cache->prefetch_queue_size = atoi(val);
@@ -1081,6 +1830,18 @@ static switch_status_t do_config(url_cache_t *cache)
 			} else if (!strcasecmp(var, "ssl-verifypeer")) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting ssl-verifypeer to %s\n", val);
 				cache->ssl_verifypeer = !switch_false(val); /* only disable if explicitly set to false */
+			} else if (!strcasecmp(var, "stream-prebuffer")) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting stream-prebuffer to %s\n", val);
+				cache->stream_prebuffer = atoi(val);
+			} else if (!strcasecmp(var, "max-size-mb")) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting max-size-mb to %s\n", val);
+				cache->max_size = atoi(val) > 0 ? (size_t) atoi(val) * 1024 * 1024 : 0;
+			} else if (!strcasecmp(var, "index-shards")) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting index-shards to %s\n", val);
+				cache->shard_count = atoi(val);
+			} else if (!strcasecmp(var, "persist-index")) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting persist-index to %s\n", val);
+				cache->persist_index = switch_true(val);
 			} else {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Unsupported param: %s\n", var);
 			}
@@ -1103,11 +1864,21 @@ static switch_status_t do_config(url_cache_t *cache)
 		status = SWITCH_STATUS_TERM;
 		goto done;
 	}
+	if (default_stale_while_revalidate_sec < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "default-stale-while-revalidate must be >= 0\n");
+		status = SWITCH_STATUS_TERM;
+		goto done;
+	}
 	if (cache->prefetch_queue_size <= 0) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "prefetch-queue-size must be > 0\n");
 		status = SWITCH_STATUS_TERM;
 		goto done;
 	}
+	if (cache->shard_count <= 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "index-shards must be > 0\n");
+		status = SWITCH_STATUS_TERM;
+		goto done;
+	}
 	if (cache->prefetch_thread_count <= 0) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "prefetch-thread-count must be > 0\n");
 		status = SWITCH_STATUS_TERM;
@@ -1116,6 +1887,7 @@ static switch_status_t do_config(url_cache_t *cache)
 
 	cache->max_url = max_urls;
 	cache->default_max_age = (default_max_age_sec * 1000 * 1000); /* convert from seconds to nanoseconds */
+	cache->default_stale_while_revalidate = (default_stale_while_revalidate_sec * 1000 * 1000);
 done:
 	switch_xml_free(xml);
 
@@ -1128,6 +1900,7 @@ done:
 SWITCH_MODULE_LOAD_FUNCTION(mod_http_cache_load)
 {
 	switch_api_interface_t *api;
+	switch_file_interface_t *file_interface;
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
 	SWITCH_ADD_API(api, "http_get", "HTTP GET", http_cache_get, HTTP_GET_SYNTAX);
@@ -1135,6 +1908,15 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_http_cache_load)
 	SWITCH_ADD_API(api, "http_put", "HTTP PUT", http_cache_put, HTTP_PUT_SYNTAX);
 	SWITCH_ADD_API(api, "http_clear_cache", "Clear the cache", http_cache_clear, HTTP_CACHE_CLEAR_SYNTAX);
 	SWITCH_ADD_API(api, "http_prefetch", "Prefetch document in a background thread.  Use http_get to get the prefetched document", http_cache_prefetch, HTTP_PREFETCH_SYNTAX);
+
+	http_cache_supported_formats[0] = "http_cache";
+	file_interface = switch_loadable_module_create_interface(*module_interface, SWITCH_FILE_INTERFACE);
+	file_interface->interface_name = modname;
+	file_interface->extens = http_cache_supported_formats;
+	file_interface->file_open = http_cache_file_open;
+	file_interface->file_close = http_cache_file_close;
+	file_interface->file_read = http_cache_file_read;
+	file_interface->file_seek = http_cache_file_seek;
 	
 	memset(&gcache, 0, sizeof(url_cache_t));
 	gcache.pool = pool;
@@ -1143,17 +1925,38 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_http_cache_load)
 		return SWITCH_STATUS_TERM;
 	}
 
-	switch_core_hash_init(&gcache.map, gcache.pool);
-	switch_mutex_init(&gcache.mutex, SWITCH_MUTEX_UNNESTED, gcache.pool);
 	switch_thread_rwlock_create(&gcache.shutdown_lock, gcache.pool);
 
-	/* create the queue */
-	gcache.queue.max_size = gcache.max_url;
-	gcache.queue.data = switch_core_alloc(gcache.pool, sizeof(void *) * gcache.queue.max_size);
-	gcache.queue.pos = 0;
-	gcache.queue.size = 0;
+	/* create the index, the limits are split evenly over the shards */
+	gcache.shards = switch_core_alloc(gcache.pool, sizeof(url_cache_shard_t) * gcache.shard_count);
+	for (int i = 0; i < gcache.shard_count; i++) {
+		url_cache_shard_t *shard = &gcache.shards[i];
+		switch_core_hash_init(&shard->map, gcache.pool);
+		switch_mutex_init(&shard->mutex, SWITCH_MUTEX_UNNESTED, gcache.pool);
+		shard->max_url = (gcache.max_url + gcache.shard_count - 1) / gcache.shard_count;
+		shard->max_size = gcache.max_size / gcache.shard_count;
+	}
+
+	if (gcache.persist_index) {
+		switch_memory_pool_t *lpool = NULL;
+		switch_hash_t *known = NULL;
 
-	setup_dir(&gcache);
+		url_cache_load_index(&gcache);
+
+		/* keep the files the index still uses */
+		switch_core_new_memory_pool(&lpool);
+		switch_core_hash_init(&known, lpool);
+		for (int i = 0; i < gcache.shard_count; i++) {
+			for (cached_url_t *u = gcache.shards[i].head; u; u = u->next) {
+				switch_core_hash_insert(known, u->filename, u);
+			}
+		}
+		setup_dir(&gcache, known);
+		switch_core_hash_destroy(&known);
+		switch_core_destroy_memory_pool(&lpool);
+	} else {
+		setup_dir(&gcache, NULL);
+	}
 
 	/* Start the prefetch threads */
 	switch_queue_create(&gcache.prefetch_queue, gcache.prefetch_queue_size, gcache.pool);
@@ -1183,9 +1986,15 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_http_cache_shutdown)
 	switch_queue_interrupt_all(gcache.prefetch_queue);
 	switch_thread_rwlock_wrlock(gcache.shutdown_lock);
 
-	url_cache_clear(&gcache, NULL);
-	switch_core_hash_destroy(&gcache.map);
-	switch_mutex_destroy(gcache.mutex);
+	if (gcache.persist_index) {
+		url_cache_save_index(&gcache);
+	}
+
+	url_cache_clear(&gcache, NULL, gcache.persist_index);
+	for (int i = 0; i < gcache.shard_count; i++) {
+		switch_core_hash_destroy(&gcache.shards[i].map);
+		switch_mutex_destroy(gcache.shards[i].mutex);
+	}
 	return SWITCH_STATUS_SUCCESS;
 }
 
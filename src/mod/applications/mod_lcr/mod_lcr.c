@@ -33,7 +33,7 @@
 #include <switch.h>
 
 #define LCR_SYNTAX "lcr <digits> [<lcr profile>] [caller_id] [intrastate] [as xml]"
-#define LCR_ADMIN_SYNTAX "lcr_admin show profiles"
+#define LCR_ADMIN_SYNTAX "lcr_admin show profiles|show index|reload index"
 
 #define LCR_HEADERS_COUNT 7
 
@@ -45,6 +45,9 @@
 #define LCR_HEADERS_CID 5
 #define LCR_HEADERS_LIMIT 6
 
+#define LCR_INDEX_ORDER_MAX 8
+#define LCR_INDEX_COLUMNS 11
+
 static char headers[LCR_HEADERS_COUNT][32] = {
 	"Digit Match",
 	"Carrier",
@@ -99,6 +102,51 @@ typedef lcr_obj_t *lcr_route;
 typedef struct max_obj max_obj_t;
 typedef max_obj_t *max_len;
 
+typedef enum {
+	LCR_ORDER_RATE,
+	LCR_ORDER_QUALITY,
+	LCR_ORDER_RELIABILITY
+} lcr_index_order_t;
+
+typedef enum {
+	LCR_RATE_DEFAULT,
+	LCR_RATE_INTRASTATE,
+	LCR_RATE_INTRALATA,
+	LCR_RATE_COUNT
+} lcr_index_rate_t;
+
+/* one row of the default lcr query, as kept by the in memory index */
+struct lcr_index_route {
+	char *digits;
+	char *carrier_name;
+	char *rate[LCR_RATE_COUNT];
+	char *gw_prefix;
+	char *gw_suffix;
+	char *lead_strip;
+	char *trail_strip;
+	char *prefix;
+	char *suffix;
+	char *codec;
+	char *cid;
+	float quality;
+	float reliability;
+	uint16_t profile_id;
+	switch_bool_t lrn;
+	struct lcr_index_route *next;
+};
+typedef struct lcr_index_route lcr_index_route_t;
+
+struct lcr_index {
+	switch_memory_pool_t *pool;
+	switch_hash_t *routes;		/* digits -> every route for that prefix */
+	switch_hash_t *strings;		/* carriers, gateways and codecs repeat on most rows, keep one copy of each */
+	uint32_t rows;
+	uint32_t prefixes;
+	switch_time_t loaded;
+	switch_time_t took;
+};
+typedef struct lcr_index lcr_index_t;
+
 struct profile_obj {
 	char *name;
 	uint16_t id;
@@ -118,6 +166,10 @@ struct profile_obj {
 	switch_bool_t quote_in_list;
 	switch_bool_t info_in_headers;
 	switch_bool_t enable_sip_redir;
+
+	switch_bool_t use_index;
+	lcr_index_order_t index_order[LCR_INDEX_ORDER_MAX];
+	int index_order_cnt;
 };
 typedef struct profile_obj profile_t;
 
@@ -148,6 +200,13 @@ static struct {
 	switch_hash_t *profile_hash;
 	profile_t *default_profile;
 	void *filler1;
+	switch_bool_t memory_index;
+	int index_refresh;
+	lcr_index_t *index;
+	switch_thread_rwlock_t *index_rwlock;
+	switch_mutex_t *index_build_mutex;
+	switch_thread_t *index_thread;
+	int index_running;
 } globals;
 
 
@@ -769,6 +828,289 @@ static int route_add_callback(void *pArg, int argc, char **argv, char **columnNa
 
 }
 
+static char *lcr_index_strdup(lcr_index_t *index, const char *str)
+{
+	char *r;
+
+	if (!str) {
+		return NULL;
+	}
+
+	if (!(r = switch_core_hash_find(index->strings, str))) {
+		r = switch_core_strdup(index->pool, str);
+		switch_core_hash_insert(index->strings, r, r);
+	}
+
+	return r;
+}
+
+static int lcr_index_add_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	lcr_index_t *index = (lcr_index_t *) pArg;
+	lcr_index_route_t *route, *head;
+
+	if (argc < 17 || zstr(argv[0])) {
+		return 0;
+	}
+
+	route = switch_core_alloc(index->pool, sizeof(*route));
+
+	if ((head = switch_core_hash_find(index->routes, argv[0]))) {
+		route->digits = head->digits;
+	} else {
+		route->digits = switch_core_strdup(index->pool, argv[0]);
+		index->prefixes++;
+	}
+
+	route->carrier_name = lcr_index_strdup(index, argv[1]);
+	route->rate[LCR_RATE_DEFAULT] = zstr(argv[2]) ? NULL : lcr_index_strdup(index, argv[2]);
+	route->rate[LCR_RATE_INTRASTATE] = zstr(argv[3]) ? NULL : lcr_index_strdup(index, argv[3]);
+	route->rate[LCR_RATE_INTRALATA] = zstr(argv[4]) ? NULL : lcr_index_strdup(index, argv[4]);
+	route->gw_prefix = lcr_index_strdup(index, argv[5]);
+	route->gw_suffix = lcr_index_strdup(index, argv[6]);
+	route->lead_strip = lcr_index_strdup(index, argv[7]);
+	route->trail_strip = lcr_index_strdup(index, argv[8]);
+	route->prefix = lcr_index_strdup(index, argv[9]);
+	route->suffix = lcr_index_strdup(index, argv[10]);
+	route->codec = lcr_index_strdup(index, argv[11]);
+	route->cid = lcr_index_strdup(index, argv[12]);
+	route->lrn = switch_true(argv[13]);
+	route->profile_id = (uint16_t) atoi(switch_str_nil(argv[14]));
+	route->quality = (float) atof(switch_str_nil(argv[15]));
+	route->reliability = (float) atof(switch_str_nil(argv[16]));
+
+	route->next = head;
+	switch_core_hash_insert(index->routes, route->digits, route);
+	index->rows++;
+
+	return 0;
+}
+
+static void lcr_index_destroy(lcr_index_t **index)
+{
+	switch_memory_pool_t *pool;
+
+	if (!index || !*index) {
+		return;
+	}
+
+	pool = (*index)->pool;
+	switch_core_hash_destroy(&(*index)->routes);
+	switch_core_hash_destroy(&(*index)->strings);
+	switch_core_destroy_memory_pool(&pool);
+	*index = NULL;
+}
+
+/* Loads every route that is enabled and in date, the lookups then only filter on the digits and the profile */
+static lcr_index_t *lcr_index_build(void)
+{
+	switch_memory_pool_t *pool = NULL;
+	lcr_index_t *index;
+	switch_time_t start = switch_micro_time_now();
+	char *sql;
+
+	switch_core_new_memory_pool(&pool);
+	index = switch_core_alloc(pool, sizeof(*index));
+	index->pool = pool;
+	switch_core_hash_init(&index->routes, pool);
+	switch_core_hash_init(&index->strings, pool);
+
+	sql = switch_core_sprintf(pool,
+							  "SELECT l.digits, c.carrier_name, l.rate, %s, %s, cg.prefix, cg.suffix, l.lead_strip, l.trail_strip, l.prefix, l.suffix, "
+							  "cg.codec, l.cid, l.lrn, l.lcr_profile, l.quality, l.reliability "
+							  "FROM lcr l JOIN carriers c ON l.carrier_id=c.id JOIN carrier_gateway cg ON c.id=cg.carrier_id "
+							  "WHERE c.enabled = '1' AND cg.enabled = '1' AND l.enabled = '1' AND CURRENT_TIMESTAMP BETWEEN date_start AND date_end",
+							  db_check("SELECT intrastate_rate FROM lcr LIMIT 1") ? "l.intrastate_rate" : "NULL",
+							  db_check("SELECT intralata_rate FROM lcr LIMIT 1") ? "l.intralata_rate" : "NULL");
+
+	if (!lcr_execute_sql_callback(sql, lcr_index_add_callback, index)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to load the lcr memory index\n");
+		lcr_index_destroy(&index);
+		return NULL;
+	}
+
+	index->loaded = switch_micro_time_now();
+	index->took = index->loaded - start;
+
+	return index;
+}
+
+/* Builds a new index off the call path and swaps it in, lookups keep using the old one until then */
+static switch_status_t lcr_index_reload(void)
+{
+	lcr_index_t *index, *old;
+
+	switch_mutex_lock(globals.index_build_mutex);
+
+	if (!(index = lcr_index_build())) {
+		switch_mutex_unlock(globals.index_build_mutex);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_thread_rwlock_wrlock(globals.index_rwlock);
+	old = globals.index;
+	globals.index = index;
+	switch_thread_rwlock_unlock(globals.index_rwlock);
+
+	lcr_index_destroy(&old);
+
+	switch_mutex_unlock(globals.index_build_mutex);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Loaded %u lcr routes over %u prefixes into the memory index in %dms\n",
+					  index->rows, index->prefixes, (int) (index->took / 1000));
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void *SWITCH_THREAD_FUNC lcr_index_thread_run(switch_thread_t *thread, void *obj)
+{
+	int elapsed = 0;
+
+	while (globals.index_running) {
+		switch_yield(1000000);
+
+		if (globals.index_refresh > 0 && ++elapsed >= globals.index_refresh) {
+			elapsed = 0;
+			lcr_index_reload();
+		}
+	}
+
+	return NULL;
+}
+
+typedef struct {
+	lcr_index_route_t *route;
+	profile_t *profile;
+	float rate;
+	size_t digit_len;
+	int random;
+} lcr_index_match_t;
+
+/* same order as the default sql: digits DESC, then the profile's order_by, then random */
+static int lcr_index_compare(const void *a, const void *b)
+{
+	const lcr_index_match_t *x = (const lcr_index_match_t *) a;
+	const lcr_index_match_t *y = (const lcr_index_match_t *) b;
+	int i, r;
+
+	if (x->digit_len != y->digit_len) {
+		return x->digit_len > y->digit_len ? -1 : 1;
+	}
+
+	if ((r = strcmp(y->route->digits, x->route->digits))) {
+		return r;
+	}
+
+	for (i = 0; i < x->profile->index_order_cnt; i++) {
+		switch (x->profile->index_order[i]) {
+		case LCR_ORDER_RATE:
+			if (x->rate != y->rate) {
+				return x->rate < y->rate ? -1 : 1;
+			}
+			break;
+		case LCR_ORDER_QUALITY:
+			if (x->route->quality != y->route->quality) {
+				return x->route->quality > y->route->quality ? -1 : 1;
+			}
+			break;
+		case LCR_ORDER_RELIABILITY:
+			if (x->route->reliability != y->route->reliability) {
+				return x->route->reliability > y->route->reliability ? -1 : 1;
+			}
+			break;
+		}
+	}
+
+	return x->random - y->random;
+}
+
+/* walks every prefix of digits, fills matches when it is not NULL and returns how many routes matched */
+static int lcr_index_collect(lcr_index_t *index, callback_t *cb_struct, const char *digits, switch_bool_t lrn, lcr_index_rate_t rate,
+							 lcr_index_match_t *matches, int count)
+{
+	char *prefix = switch_core_strdup(cb_struct->pool, digits);
+	size_t n;
+	lcr_index_route_t *route;
+	uint16_t id = cb_struct->profile->id;
+
+	for (n = strlen(prefix); n > 0; n--) {
+		prefix[n] = '\0';
+
+		for (route = switch_core_hash_find(index->routes, prefix); route; route = route->next) {
+			if (route->lrn != lrn || (id > 0 && route->profile_id != id)) {
+				continue;
+			}
+
+			if (matches) {
+				matches[count].route = route;
+				matches[count].profile = cb_struct->profile;
+				matches[count].rate = route->rate[rate] ? (float) atof(route->rate[rate]) : 0;
+				matches[count].digit_len = n;
+				matches[count].random = rand();
+			}
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/* Answers a lookup from the memory index, the rows are handed to route_add_callback like the sql ones would be */
+static switch_status_t lcr_index_lookup(callback_t *cb_struct, const char *digits, lcr_index_rate_t rate)
+{
+	static char *names[LCR_INDEX_COLUMNS] = {
+		"lcr_digits", "lcr_carrier_name", "lcr_rate_field", "lcr_gw_prefix", "lcr_gw_suffix", "lcr_lead_strip",
+		"lcr_trail_strip", "lcr_prefix", "lcr_suffix", "lcr_codec", "lcr_cid"
+	};
+	const char *lrn_digits = cb_struct->lrn_number ? cb_struct->lrn_number : digits;
+	lcr_index_match_t *matches;
+	lcr_index_t *index;
+	int count, i;
+
+	switch_thread_rwlock_rdlock(globals.index_rwlock);
+
+	if (!(index = globals.index)) {
+		switch_thread_rwlock_unlock(globals.index_rwlock);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	count = lcr_index_collect(index, cb_struct, digits, SWITCH_FALSE, rate, NULL, 0);
+	count = lcr_index_collect(index, cb_struct, lrn_digits, SWITCH_TRUE, rate, NULL, count);
+
+	if (count) {
+		matches = switch_core_alloc(cb_struct->pool, sizeof(*matches) * count);
+		i = lcr_index_collect(index, cb_struct, digits, SWITCH_FALSE, rate, matches, 0);
+		lcr_index_collect(index, cb_struct, lrn_digits, SWITCH_TRUE, rate, matches, i);
+
+		qsort(matches, count, sizeof(*matches), lcr_index_compare);
+
+		for (i = 0; i < count; i++) {
+			lcr_index_route_t *route = matches[i].route;
+			char *argv[LCR_INDEX_COLUMNS];
+
+			argv[0] = route->digits;
+			argv[1] = route->carrier_name;
+			argv[2] = route->rate[rate];
+			argv[3] = route->gw_prefix;
+			argv[4] = route->gw_suffix;
+			argv[5] = route->lead_strip;
+			argv[6] = route->trail_strip;
+			argv[7] = route->prefix;
+			argv[8] = route->suffix;
+			argv[9] = route->codec;
+			argv[10] = route->cid;
+
+			if (route_add_callback(cb_struct, LCR_INDEX_COLUMNS, argv, names) != 0) {
+				break;
+			}
+		}
+	}
+
+	switch_thread_rwlock_unlock(globals.index_rwlock);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static int intrastatelata_callback(void *pArg, int argc, char **argv, char **columnNames)
 {
 	int count = 0;
@@ -848,6 +1190,7 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 	char *safe_sql = NULL;
 	char *rate_field = NULL;
 	char *user_rate_field = NULL;
+	lcr_index_rate_t index_rate = LCR_RATE_DEFAULT;
 	
 	switch_assert(cb_struct->lookup_number != NULL);
 
@@ -878,9 +1221,11 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 	if (cb_struct->intralata == SWITCH_TRUE && profile->profile_has_intralata == SWITCH_TRUE) {
 		rate_field = switch_core_strdup(cb_struct->pool, "intralata_rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_intralata_rate");
+		index_rate = LCR_RATE_INTRALATA;
 	} else if (cb_struct->intrastate == SWITCH_TRUE && profile->profile_has_intrastate == SWITCH_TRUE) {
 		rate_field = switch_core_strdup(cb_struct->pool, "intrastate_rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_intrastate_rate");
+		index_rate = LCR_RATE_INTRASTATE;
 	} else {
 		rate_field = switch_core_strdup(cb_struct->pool, "rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_rate");
@@ -922,6 +1267,12 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 		}
 	}
 
+	if (profile->use_index && lcr_index_lookup(cb_struct, digits_copy, index_rate) == SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(cb_struct->session), SWITCH_LOG_DEBUG, "Answered from the memory index\n");
+		switch_core_hash_destroy(&cb_struct->dedup_hash);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	/* set up the query to be executed */
 	/* format the custom_sql */
 	safe_sql = format_custom_sql(profile->custom_sql, cb_struct, digits_copy);
@@ -974,6 +1325,16 @@ static switch_bool_t test_profile(char *lcr_profile)
 	        SWITCH_TRUE : SWITCH_FALSE;
 }
 
+static switch_bool_t lcr_index_order_add(lcr_index_order_t *order, int *count, lcr_index_order_t key)
+{
+	if (*count >= LCR_INDEX_ORDER_MAX) {
+		return SWITCH_FALSE;
+	}
+
+	order[(*count)++] = key;
+	return SWITCH_TRUE;
+}
+
 static switch_status_t lcr_load_config()
 {
 	char *cf = "lcr.conf";
@@ -1004,6 +1365,10 @@ static switch_status_t lcr_load_config()
 						*globals.odbc_pass++ = '\0';
 					}
 				}
+			} else if (!strcasecmp(var, "memory-index")) {
+				globals.memory_index = switch_true(val);
+			} else if (!strcasecmp(var, "memory-index-refresh")) {
+				globals.index_refresh = atoi(val);
 			}
 		}
 	}
@@ -1043,6 +1408,9 @@ static switch_status_t lcr_load_config()
 			char *limit_type = NULL;
 			int argc, x = 0;
 			char *argv[32] = { 0 };
+			lcr_index_order_t index_order[LCR_INDEX_ORDER_MAX];
+			int index_order_cnt = 0;
+			switch_bool_t index_order_ok = SWITCH_TRUE;
 			
 			SWITCH_STANDARD_STREAM(order_by);
 
@@ -1061,18 +1429,24 @@ static switch_status_t lcr_load_config()
 							if (!zstr(argv[x])) {
 								if (!strcasecmp(argv[x], "quality")) {
 									thisorder->write_function(thisorder, "%s quality DESC", comma);
+									index_order_ok &= lcr_index_order_add(index_order, &index_order_cnt, LCR_ORDER_QUALITY);
 								} else if (!strcasecmp(argv[x], "reliability")) {
 									thisorder->write_function(thisorder, "%s reliability DESC", comma);
+									index_order_ok &= lcr_index_order_add(index_order, &index_order_cnt, LCR_ORDER_RELIABILITY);
 								} else if (!strcasecmp(argv[x], "rate")) {
 									thisorder->write_function(thisorder, "%s ${lcr_rate_field}", comma);
+									index_order_ok &= lcr_index_order_add(index_order, &index_order_cnt, LCR_ORDER_RATE);
 								} else {
+									/* any other column only the database can sort on */
 									thisorder->write_function(thisorder, "%s %s", comma, argv[x]);
+									index_order_ok = SWITCH_FALSE;
 								}
 							} else {
 								switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "arg #%d is empty\n", x);
 							}
 						}
 					} else {
+						index_order_ok = SWITCH_FALSE;
 						if (!strcasecmp(val, "quality")) {
 							thisorder->write_function(thisorder, "%s quality DESC", comma);
 						} else if (!strcasecmp(val, "reliability")) {
@@ -1112,6 +1486,16 @@ static switch_status_t lcr_load_config()
 				} else {
 					/* default to rate */
 					profile->order_by = ", ${lcr_rate_field}";
+					index_order[index_order_cnt++] = LCR_ORDER_RATE;
+				}
+
+				/* the index only knows the default query, a custom one or an order it can't sort on stays on sql */
+				if (globals.memory_index && zstr(custom_sql) && index_order_ok) {
+					profile->use_index = SWITCH_TRUE;
+					memcpy(profile->index_order, index_order, sizeof(index_order[0]) * index_order_cnt);
+					profile->index_order_cnt = index_order_cnt;
+				} else if (globals.memory_index) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Profile %s uses custom_sql or order_by columns the memory index can't serve, it stays on sql\n", name);
 				}
 
 				if (!zstr(id_s)) {
@@ -1280,6 +1664,9 @@ static switch_status_t lcr_load_config()
 		memset(profile, 0, sizeof(profile_t));
 		profile->name = "global_default";
 		profile->order_by = ", rate";
+		profile->use_index = globals.memory_index;
+		profile->index_order[0] = LCR_ORDER_RATE;
+		profile->index_order_cnt = 1;
 		globals.default_profile = profile;
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Setting system defined default profile.");
 	}
@@ -1997,8 +2384,34 @@ SWITCH_STANDARD_API(dialplan_lcr_admin_function)
 				stream->write_function(stream, " Sip Redirection Mode:\t%s\n", profile->enable_sip_redir ? "enabled" : "disabled");
 				stream->write_function(stream, " Import fields:\t%s\n", profile->export_fields_str ? profile->export_fields_str : "(null)");
 				stream->write_function(stream, " Limit type:\t%s\n", profile->limit_type);
+				stream->write_function(stream, " Memory index:\t%s\n", profile->use_index ? "enabled" : "disabled");
 				stream->write_function(stream, "\n");
 			}
+		} else if (!strcasecmp(argv[0], "show") && !strcasecmp(argv[1], "index")) {
+			switch_thread_rwlock_rdlock(globals.index_rwlock);
+			if (globals.index) {
+				switch_time_exp_t tm;
+				char date[80] = "";
+				switch_size_t retsize;
+
+				switch_time_exp_lt(&tm, globals.index->loaded);
+				switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d %T", &tm);
+				stream->write_function(stream, "Routes:\t\t%u\n", globals.index->rows);
+				stream->write_function(stream, "Prefixes:\t%u\n", globals.index->prefixes);
+				stream->write_function(stream, "Loaded:\t\t%s (%dms)\n", date, (int) (globals.index->took / 1000));
+				stream->write_function(stream, "Refresh:\t%ds\n", globals.index_refresh);
+			} else {
+				stream->write_function(stream, "-ERR memory index not loaded\n");
+			}
+			switch_thread_rwlock_unlock(globals.index_rwlock);
+		} else if (!strcasecmp(argv[0], "reload") && !strcasecmp(argv[1], "index")) {
+			if (!globals.memory_index) {
+				stream->write_function(stream, "-ERR memory-index is not enabled\n");
+			} else if (lcr_index_reload() == SWITCH_STATUS_SUCCESS) {
+				stream->write_function(stream, "+OK\n");
+			} else {
+				stream->write_function(stream, "-ERR unable to load the memory index\n");
+			}
 		} else {
 			goto usage;
 		}
@@ -2032,11 +2445,27 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lcr_load)
 	if (switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "failed to initialize mutex\n");
 	}
+	switch_mutex_init(&globals.index_build_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_thread_rwlock_create(&globals.index_rwlock, globals.pool);
+	globals.index_refresh = 300;
+
 	if (lcr_load_config() != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to load lcr config file\n");
 		return SWITCH_STATUS_FALSE;
 	}
 
+	if (globals.memory_index) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		/* a failed load leaves the lookups on sql until a refresh or lcr_admin reload index works */
+		lcr_index_reload();
+
+		globals.index_running = 1;
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.index_thread, thd_attr, lcr_index_thread_run, NULL, globals.pool);
+	}
+
 	SWITCH_ADD_API(dialplan_lcr_api_interface, "lcr", "Least Cost Routing Module", dialplan_lcr_function, LCR_SYNTAX);
 	SWITCH_ADD_API(dialplan_lcr_api_admin_interface, "lcr_admin", "Least Cost Routing Module Admin", dialplan_lcr_admin_function, LCR_ADMIN_SYNTAX);
 	SWITCH_ADD_APP(app_interface, "lcr", "Perform an LCR lookup", "Perform an LCR lookup",
@@ -2053,6 +2482,17 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lcr_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_lcr_shutdown)
 {
+	switch_status_t st;
+
+	if (globals.index_thread) {
+		globals.index_running = 0;
+		switch_thread_join(&st, globals.index_thread);
+		globals.index_thread = NULL;
+	}
+
+	switch_thread_rwlock_wrlock(globals.index_rwlock);
+	lcr_index_destroy(&globals.index);
+	switch_thread_rwlock_unlock(globals.index_rwlock);
 
 	switch_core_hash_destroy(&globals.profile_hash);
 
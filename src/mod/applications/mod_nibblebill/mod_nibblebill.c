@@ -68,6 +68,16 @@ typedef struct nibblebill_results {
 	double lowbal_amt;			/*  ditto */
 } nibblebill_results_t;
 
+/* An account's balance as the calls on it see it: the last database balance less what was billed since */
+typedef struct nibble_account {
+	char *name;
+	double balance;				/* Balance last read from the database */
+	double pending;				/* Billed in memory, not written yet */
+	double flushing;			/* Billed and being written by the flush thread right now */
+	switch_time_t last_used;	/* Last time a call billed or looked at this account */
+	struct nibble_account *next;
+} nibble_account_t;
+
 
 /* Keep track of our config, event hooks and database connection variables, for this module only */
 static struct {
@@ -101,6 +111,14 @@ static struct {
 	char *custom_sql_save;
 	char *custom_sql_lookup;
 	switch_odbc_handle_t *master_odbc;
+	switch_mutex_t *db_mutex;	/* One statement at a time on master_odbc */
+
+	/* In-memory ledger, written to the database every ledger_flush_interval seconds. 0 bills straight to the database */
+	int ledger_flush_interval;
+	switch_hash_t *ledger;
+	switch_mutex_t *ledger_mutex;
+	switch_thread_t *ledger_thread;
+	int ledger_running;
 } globals;
 
 static void nibblebill_pause(switch_core_session_t *session);
@@ -191,6 +209,11 @@ static switch_status_t load_config(void)
 				globals.nobal_amt = atof(val);
 			} else if (!strcasecmp(var, "global_heartbeat")) {
 				globals.global_heartbeat = atoi(val);
+			} else if (!strcasecmp(var, "ledger_flush_interval")) {
+				globals.ledger_flush_interval = atoi(val);
+				if (globals.ledger_flush_interval < 0) {
+					globals.ledger_flush_interval = 0;
+				}
 			}
 		}
 	}
@@ -310,8 +333,33 @@ static void transfer_call(switch_core_session_t *session, char *destination)
 	free(mydup);
 }
 
+/* Custom SQL is expanded against the channel, or without one (ledger flushes) against just the account and amount */
+static char *expand_account_sql(const char *sql, switch_channel_t *channel, const char *billaccount, const char *billamount)
+{
+	switch_event_t *vars = NULL;
+	char *expanded;
+
+	if (channel) {
+		return switch_channel_expand_variables(channel, sql);
+	}
+
+	switch_event_create(&vars, SWITCH_EVENT_REQUEST_PARAMS);
+	switch_assert(vars);
+	switch_event_add_header_string(vars, SWITCH_STACK_BOTTOM, "nibble_account", billaccount);
+	if (billamount) {
+		switch_event_add_header_string(vars, SWITCH_STACK_BOTTOM, "nibble_bill", billamount);
+	}
+	expanded = switch_event_expand_headers(vars, sql);
+	if (expanded == sql) {
+		expanded = strdup(sql);
+	}
+	switch_event_destroy(&vars);
+
+	return expanded;
+}
+
 /* At this time, billing never succeeds if you don't have a database. */
-static switch_status_t bill_event(double billamount, const char *billaccount, switch_channel_t *channel)
+static switch_status_t db_bill(double billamount, const char *billaccount, switch_channel_t *channel)
 {
 	char *sql = NULL, *dsql = NULL;
 	switch_odbc_statement_handle_t stmt = NULL;
@@ -322,7 +370,12 @@ static switch_status_t bill_event(double billamount, const char *billaccount, sw
 	}
 
 	if (globals.custom_sql_save) {
-		if (switch_string_var_check_const(globals.custom_sql_save) || switch_string_has_escaped_data(globals.custom_sql_save)) {
+		if (!channel) {
+			char amount[64];
+
+			switch_snprintf(amount, sizeof(amount), "%f", billamount);
+			sql = dsql = expand_account_sql(globals.custom_sql_save, NULL, billaccount, amount);
+		} else if (switch_string_var_check_const(globals.custom_sql_save) || switch_string_has_escaped_data(globals.custom_sql_save)) {
 			switch_channel_set_variable_printf(channel, "nibble_bill", "%f", billamount, SWITCH_FALSE);
 			sql = switch_channel_expand_variables(channel, globals.custom_sql_save);
 			if (sql != globals.custom_sql_save) dsql = sql;
@@ -337,6 +390,7 @@ static switch_status_t bill_event(double billamount, const char *billaccount, sw
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Doing update query\n[%s]\n", sql);
 
+	switch_mutex_lock(globals.db_mutex);
 	if (switch_odbc_handle_exec(globals.master_odbc, sql, &stmt, NULL) != SWITCH_ODBC_SUCCESS) {
 		char *err_str;
 		err_str = switch_odbc_handle_get_error(globals.master_odbc, stmt);
@@ -349,6 +403,7 @@ static switch_status_t bill_event(double billamount, const char *billaccount, sw
 	if (stmt) {
 		switch_odbc_statement_handle_free(&stmt);
 	}
+	switch_mutex_unlock(globals.db_mutex);
 	
 	switch_safe_free(dsql);
 
@@ -356,7 +411,7 @@ static switch_status_t bill_event(double billamount, const char *billaccount, sw
 }
 
 
-static double get_balance(const char *billaccount, switch_channel_t *channel)
+static double db_balance(const char *billaccount, switch_channel_t *channel)
 {
 	char *dsql = NULL, *sql = NULL;
 	nibblebill_results_t pdata;
@@ -369,7 +424,9 @@ static double get_balance(const char *billaccount, switch_channel_t *channel)
 	memset(&pdata, 0, sizeof(pdata));
 
 	if (globals.custom_sql_lookup) {
-		if (switch_string_var_check_const(globals.custom_sql_lookup) || switch_string_has_escaped_data(globals.custom_sql_lookup)) {
+		if (!channel) {
+			sql = dsql = expand_account_sql(globals.custom_sql_lookup, NULL, billaccount, NULL);
+		} else if (switch_string_var_check_const(globals.custom_sql_lookup) || switch_string_has_escaped_data(globals.custom_sql_lookup)) {
 			sql = switch_channel_expand_variables(channel, globals.custom_sql_lookup);
 			if (sql != globals.custom_sql_lookup) dsql = sql;
 		} else {
@@ -382,6 +439,7 @@ static double get_balance(const char *billaccount, switch_channel_t *channel)
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Doing lookup query\n[%s]\n", sql);
 	
+	switch_mutex_lock(globals.db_mutex);
 	if (switch_odbc_handle_callback_exec(globals.master_odbc, sql, nibblebill_callback, &pdata, NULL) != SWITCH_ODBC_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error running this query: [%s]\n", sql);
 		/* Return -1 for safety */
@@ -392,11 +450,169 @@ static double get_balance(const char *billaccount, switch_channel_t *channel)
 		balance = pdata.balance;
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Retrieved current balance for account %s (balance = %f)\n", billaccount, balance);
 	}
+	switch_mutex_unlock(globals.db_mutex);
 	
 	switch_safe_free(dsql);
 	return balance;
 }
 
+/* Find an account in the ledger, reading its balance the first time. Called with ledger_mutex held, returns with it held */
+static nibble_account_t *ledger_account(const char *billaccount)
+{
+	nibble_account_t *account;
+	double balance;
+
+	if ((account = switch_core_hash_find(globals.ledger, billaccount))) {
+		return account;
+	}
+
+	switch_mutex_unlock(globals.ledger_mutex);
+	balance = db_balance(billaccount, NULL);
+	switch_mutex_lock(globals.ledger_mutex);
+
+	/* a failed lookup is not remembered, the -1.0 still stops the call */
+	if (balance == -1.0) {
+		return NULL;
+	}
+
+	/* another call may have loaded it while the lock was released */
+	if (!(account = switch_core_hash_find(globals.ledger, billaccount))) {
+		switch_zmalloc(account, sizeof(*account));
+		account->name = strdup(billaccount);
+		account->balance = balance;
+		switch_core_hash_insert(globals.ledger, account->name, account);
+	}
+
+	return account;
+}
+
+/* Debit the account in memory, the flush thread writes the sum later */
+static switch_status_t bill_event(double billamount, const char *billaccount, switch_channel_t *channel)
+{
+	nibble_account_t *account;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (!globals.ledger_running) {
+		return db_bill(billamount, billaccount, channel);
+	}
+
+	switch_mutex_lock(globals.ledger_mutex);
+	if ((account = ledger_account(billaccount))) {
+		account->pending += billamount;
+		account->last_used = switch_micro_time_now();
+		status = SWITCH_STATUS_SUCCESS;
+	}
+	switch_mutex_unlock(globals.ledger_mutex);
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		/* nothing to debit in memory, try the database directly */
+		status = db_bill(billamount, billaccount, channel);
+	}
+
+	return status;
+}
+
+static double get_balance(const char *billaccount, switch_channel_t *channel)
+{
+	nibble_account_t *account;
+	double balance = -1.0;
+
+	if (!globals.ledger_running) {
+		return db_balance(billaccount, channel);
+	}
+
+	switch_mutex_lock(globals.ledger_mutex);
+	if ((account = ledger_account(billaccount))) {
+		balance = account->balance - account->pending - account->flushing;
+		account->last_used = switch_micro_time_now();
+	}
+	switch_mutex_unlock(globals.ledger_mutex);
+
+	return balance;
+}
+
+/* Write what each account was billed since the last flush as one UPDATE, then re-read its balance to pick up top-ups */
+static void ledger_flush(void)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	nibble_account_t *account, *flush = NULL, *evict = NULL;
+	switch_time_t idle = switch_micro_time_now() - (switch_time_t) globals.ledger_flush_interval * 2 * 1000000;
+	int flushed = 0;
+
+	switch_mutex_lock(globals.ledger_mutex);
+	for (hi = switch_hash_first(NULL, globals.ledger); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		account = (nibble_account_t *) val;
+
+		if (account->pending != 0) {
+			account->flushing = account->pending;
+			account->pending = 0;
+			account->next = flush;
+			flush = account;
+		} else if (account->last_used < idle) {
+			/* nobody billed it for a while, the next call reads a fresh balance */
+			account->next = evict;
+			evict = account;
+		}
+	}
+
+	while ((account = evict)) {
+		evict = account->next;
+		switch_core_hash_delete(globals.ledger, account->name);
+		free(account->name);
+		free(account);
+	}
+	switch_mutex_unlock(globals.ledger_mutex);
+
+	/* accounts are only evicted by this thread, so the flush list stays valid without the lock */
+	for (account = flush; account; account = account->next) {
+		double balance;
+
+		if (db_bill(account->flushing, account->name, NULL) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Failed to write $%f billed to %s, will retry\n", account->flushing, account->name);
+			switch_mutex_lock(globals.ledger_mutex);
+			account->pending += account->flushing;
+			account->flushing = 0;
+			switch_mutex_unlock(globals.ledger_mutex);
+			continue;
+		}
+
+		balance = db_balance(account->name, NULL);
+
+		switch_mutex_lock(globals.ledger_mutex);
+		if (balance == -1.0) {
+			account->balance -= account->flushing;
+		} else {
+			account->balance = balance;
+		}
+		account->flushing = 0;
+		switch_mutex_unlock(globals.ledger_mutex);
+		flushed++;
+	}
+
+	if (flushed) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Flushed billing for %d accounts\n", flushed);
+	}
+}
+
+static void *SWITCH_THREAD_FUNC ledger_thread_run(switch_thread_t *thread, void *obj)
+{
+	switch_time_t next = switch_micro_time_now() + (switch_time_t) globals.ledger_flush_interval * 1000000;
+
+	while (globals.ledger_running) {
+		if (switch_micro_time_now() < next) {
+			switch_yield(100000);
+			continue;
+		}
+
+		ledger_flush();
+		next = switch_micro_time_now() + (switch_time_t) globals.ledger_flush_interval * 1000000;
+	}
+
+	return NULL;
+}
+
 /* This is where we actually charge the guy 
   This can be called anytime a call is in progress or at the end of a call before the session is destroyed */
 static switch_status_t do_billing(switch_core_session_t *session)
@@ -954,9 +1170,23 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_nibblebill_load)
 	memset(&globals, 0, sizeof(globals));
 	globals.pool = pool;
 	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_mutex_init(&globals.db_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_mutex_init(&globals.ledger_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_core_hash_init(&globals.ledger, globals.pool);
 
 	load_config();
 
+	if (globals.ledger_flush_interval > 0 && globals.master_odbc) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		globals.ledger_running = 1;
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.ledger_thread, thd_attr, ledger_thread_run, NULL, globals.pool);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Billing in memory, writing to the database every %d seconds\n",
+						  globals.ledger_flush_interval);
+	}
+
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
@@ -984,8 +1214,31 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_nibblebill_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_nibblebill_shutdown)
 {
+	switch_hash_index_t *hi;
+	void *val;
+	nibble_account_t *account;
+
 	switch_event_unbind(&globals.node);
 	switch_core_remove_state_handler(&nibble_state_handler);
+
+	/* write out whatever is still only in memory before the handle goes */
+	if (globals.ledger_thread) {
+		switch_status_t st;
+
+		globals.ledger_running = 0;
+		switch_thread_join(&st, globals.ledger_thread);
+		ledger_flush();
+	}
+
+	while ((hi = switch_hash_first(NULL, globals.ledger))) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		account = (nibble_account_t *) val;
+		switch_core_hash_delete(globals.ledger, account->name);
+		free(account->name);
+		free(account);
+	}
+	switch_core_hash_destroy(&globals.ledger);
+
 	switch_odbc_handle_disconnect(globals.master_odbc);
 
 	switch_safe_free(globals.db_username);
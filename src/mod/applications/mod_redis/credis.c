@@ -426,14 +426,12 @@ static int cr_receiveerror(REDIS rhnd, char *line)
   return CREDIS_ERR_PROTOCOL;
 }
 
-static int cr_receivereply(REDIS rhnd, char recvtype) 
+/* Receives the next reply in the buffer, reading more data from the socket
+ * if needed. Replies that were pipelined behind it are left in the buffer. */
+static int cr_receivenextreply(REDIS rhnd, char recvtype) 
 {
   char *line, prefix=0;
 
-  /* reset common send/receive buffer */
-  rhnd->buf.len = 0;
-  rhnd->buf.idx = 0;
-
   if (cr_readln(rhnd, 0, &line, NULL) > 0) {
     prefix = *(line++);
  
@@ -457,6 +455,15 @@ static int cr_receivereply(REDIS rhnd, char recvtype)
   return CREDIS_ERR_RECV;
 }
 
+static int cr_receivereply(REDIS rhnd, char recvtype) 
+{
+  /* reset common send/receive buffer */
+  rhnd->buf.len = 0;
+  rhnd->buf.idx = 0;
+
+  return cr_receivenextreply(rhnd, recvtype);
+}
+
 static void cr_delete(REDIS rhnd) 
 {
   if (rhnd->reply.multibulk.bulks != NULL)
@@ -719,6 +726,55 @@ int credis_decrby(REDIS rhnd, const char *key, int decr_val, int *new_val)
   return cr_incr(rhnd, 0, decr_val, key, new_val);
 }
 
+int credis_incrby_multi(REDIS rhnd, int keyc, const char **keyv, const int *incrv, int *valv)
+{
+  cr_buffer *buf = &(rhnd->buf);
+  int i, rc, avail, err = 0;
+
+  /* write all commands before reading any reply so the whole batch costs
+     a single round trip */
+  buf->len = 0;
+  for (i = 0; i < keyc; i++) {
+    avail = buf->size - buf->len;
+    rc = snprintf(buf->data + buf->len, avail, "INCRBY %s %d\r\n", keyv[i], incrv[i]);
+    if (rc >= avail) {
+      if (cr_moremem(buf, rc - avail + 1))
+        return CREDIS_ERR_NOMEM;
+      avail = buf->size - buf->len;
+      rc = snprintf(buf->data + buf->len, avail, "INCRBY %s %d\r\n", keyv[i], incrv[i]);
+    }
+    buf->len += rc;
+  }
+
+  DEBUG("Sending pipeline: keyc=%d, len=%d, data=%s", keyc, buf->len, buf->data);
+
+  rc = cr_senddata(rhnd->fd, rhnd->timeout, buf->data, buf->len);
+
+  if (rc != buf->len) {
+    if (rc < 0)
+      return CREDIS_ERR_SEND;
+    return CREDIS_ERR_TIMEOUT;
+  }
+
+  buf->len = 0;
+  buf->idx = 0;
+
+  /* an error reply only fails its own command, keep reading so the
+     connection stays in sync */
+  for (i = 0; i < keyc; i++) {
+    if ((rc = cr_receivenextreply(rhnd, CR_INT)) == 0) {
+      if (valv != NULL)
+        valv[i] = rhnd->reply.integer;
+    } else if (rc == CREDIS_ERR_PROTOCOL) {
+      err = rc;
+    } else {
+      return rc;
+    }
+  }
+
+  return err;
+}
+
 int credis_exists(REDIS rhnd, const char *key)
 {
   int rc = cr_sendfandreceive(rhnd, CR_INT, "EXISTS %s\r\n", key);
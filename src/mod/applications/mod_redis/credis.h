@@ -147,6 +147,10 @@ int credis_decr(REDIS rhnd, const char *key, int *new_val);
 
 int credis_decrby(REDIS rhnd, const char *key, int decr_val, int *new_val);
 
+/* sends INCRBY `keyv[i]' `incrv[i]' for all `keyc' keys in one pipelined 
+ * round trip, the new values are returned in `valv' if not NULL */
+int credis_incrby_multi(REDIS rhnd, int keyc, const char **keyv, const int *incrv, int *valv);
+
 /* returns -1 if the key doesn't exists and 0 if it does */
 int credis_exists(REDIS rhnd, const char *key);
 
@@ -40,6 +40,15 @@ static struct{
 	char *host;
 	int port;
 	int timeout;
+	int max_connections;
+	int usage_cache_ms;
+	switch_memory_pool_t *pool;
+	switch_mutex_t *pool_mutex;
+	REDIS *idle;
+	int idle_count;
+	int idle_size;
+	switch_mutex_t *cache_mutex;
+	switch_hash_t *usage_cache;
 } globals;
 
 static switch_xml_config_item_t instructions[] = {
@@ -47,6 +56,9 @@ static switch_xml_config_item_t instructions[] = {
 	SWITCH_CONFIG_ITEM_STRING_STRDUP("host", CONFIG_RELOAD, &globals.host, NULL, "localhost", "Hostname for redis server"),	
 	SWITCH_CONFIG_ITEM("port", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &globals.port, (void *) 6379, NULL,NULL, NULL),
 	SWITCH_CONFIG_ITEM("timeout", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &globals.timeout, (void *) 10000, NULL,NULL, NULL),
+	SWITCH_CONFIG_ITEM("max-connections", SWITCH_CONFIG_INT, 0, &globals.max_connections, (void *) 8, NULL, NULL, "Idle connections kept open to the redis server"),
+	SWITCH_CONFIG_ITEM("usage-cache-ms", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &globals.usage_cache_ms, (void *) 0, NULL, NULL,
+					   "How long a usage answer may be served from memory, 0 always asks the server"),
 	SWITCH_CONFIG_ITEM_END()
 };
 
@@ -56,8 +68,26 @@ typedef struct {
 	switch_mutex_t *mutex;
 } limit_redis_private_t;
 
+typedef struct {
+	int usage;
+	switch_time_t expires;
+} limit_redis_usage_t;
+
+/* Takes an idle connection from the pool, connects a new one when there is none */
 static switch_status_t redis_factory(REDIS *redis) 
 {
+	*redis = NULL;
+
+	switch_mutex_lock(globals.pool_mutex);
+	if (globals.idle_count > 0) {
+		*redis = globals.idle[--globals.idle_count];
+	}
+	switch_mutex_unlock(globals.pool_mutex);
+
+	if (*redis) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	if (!((*redis) = credis_connect(globals.host, globals.port, globals.timeout))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't connect to redis server at %s:%d timeout:%d\n", globals.host, globals.port, globals.timeout);		
 		return SWITCH_STATUS_FALSE;
@@ -65,6 +95,64 @@ static switch_status_t redis_factory(REDIS *redis)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* Gives a connection back to the pool, a connection that saw an error is in an unknown state and gets closed */
+static void redis_release(REDIS redis, switch_bool_t reuse)
+{
+	if (!redis) {
+		return;
+	}
+
+	if (reuse) {
+		switch_mutex_lock(globals.pool_mutex);
+		if (globals.idle_count < globals.idle_size) {
+			globals.idle[globals.idle_count++] = redis;
+			redis = NULL;
+		}
+		switch_mutex_unlock(globals.pool_mutex);
+	}
+
+	if (redis) {
+		credis_close(redis);
+	}
+}
+
+static void redis_usage_cache_set(const char *key, int usage)
+{
+	limit_redis_usage_t *item;
+
+	if (globals.usage_cache_ms <= 0) {
+		return;
+	}
+
+	switch_mutex_lock(globals.cache_mutex);
+	if (!(item = switch_core_hash_find(globals.usage_cache, key))) {
+		switch_zmalloc(item, sizeof(*item));
+		switch_core_hash_insert(globals.usage_cache, key, item);
+	}
+	item->usage = usage;
+	item->expires = switch_micro_time_now() + (switch_time_t) globals.usage_cache_ms * 1000;
+	switch_mutex_unlock(globals.cache_mutex);
+}
+
+static switch_bool_t redis_usage_cache_get(const char *key, int *usage)
+{
+	limit_redis_usage_t *item;
+	switch_bool_t found = SWITCH_FALSE;
+
+	if (globals.usage_cache_ms <= 0) {
+		return SWITCH_FALSE;
+	}
+
+	switch_mutex_lock(globals.cache_mutex);
+	if ((item = switch_core_hash_find(globals.usage_cache, key)) && item->expires > switch_micro_time_now()) {
+		*usage = item->usage;
+		found = SWITCH_TRUE;
+	}
+	switch_mutex_unlock(globals.cache_mutex);
+
+	return found;
+}
+
 /* \brief Enforces limit_redis restrictions
  * \param session current session
  * \param realm limit realm
@@ -77,16 +165,15 @@ SWITCH_LIMIT_INCR(limit_incr_redis)
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	limit_redis_private_t *pvt = NULL;
-	int val,uuid_val;
+	const char *keys[2];
+	int incrs[2] = { 1, 1 };
+	int vals[2] = { 0, 0 };
 	char *rediskey = NULL;
 	char *uuid_rediskey = NULL;
 	uint8_t increment = 1;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;	
-	REDIS redis;
-	
-	if (redis_factory(&redis) != SWITCH_STATUS_SUCCESS) {
-		return SWITCH_STATUS_FALSE;
-	}
+	switch_bool_t reuse = SWITCH_TRUE;
+	REDIS redis = NULL;
 	
 	/* Get the keys for redis server */
 	uuid_rediskey = switch_core_session_sprintf(session,"%s_%s_%s", switch_core_get_switchname(), realm, resource);
@@ -101,43 +188,45 @@ SWITCH_LIMIT_INCR(limit_incr_redis)
 		switch_mutex_init(&pvt->mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session));
 		switch_channel_set_private(channel, "limit_redis", pvt);
 	}
-	
-	if (!(switch_core_hash_find_locked(pvt->hash, rediskey, pvt->mutex))) {
-		switch_core_hash_insert_locked(pvt->hash, rediskey, rediskey, pvt->mutex);
+
+	if (!increment) {
+		return SWITCH_STATUS_SUCCESS;
 	}
-	
-   	if (increment) {
-		if (credis_incr(redis, rediskey, &val) != 0) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't increment value corresponding to %s\n", rediskey);
-			switch_goto_status(SWITCH_STATUS_FALSE, end);
+
+	if (redis_factory(&redis) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	keys[0] = rediskey;
+	keys[1] = uuid_rediskey;
+
+	/* Both counters go up in one round trip, an over the limit call is the rare case and pays for a second one */
+	if (credis_incrby_multi(redis, 2, keys, incrs, vals) != 0) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Couldn't increment value corresponding to %s\n", rediskey);
+		reuse = SWITCH_FALSE;
+		switch_goto_status(SWITCH_STATUS_FALSE, end);
+	}
+
+	if (max > 0 && vals[0] > max) {
+		incrs[0] = incrs[1] = -1;
+		if (credis_incrby_multi(redis, 2, keys, incrs, vals) != 0) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Couldn't decrement value corresponding to %s\n", rediskey);
+			reuse = SWITCH_FALSE;
+			switch_goto_status(SWITCH_STATUS_GENERR, end);
 		}
+		redis_usage_cache_set(rediskey, vals[0]);
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s exceeds maximum rate of %d\n", rediskey, max);
+		switch_goto_status(SWITCH_STATUS_FALSE, end);
+	}
 
-		if (max > 0) {
-			if (val > max){
-				if (credis_decr(redis, rediskey, &val) != 0) {
-               		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Couldn't decrement value corresponding to %s\n", rediskey);
-					switch_goto_status(SWITCH_STATUS_GENERR, end);
-				} else {
-           			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s exceeds maximum rate of %d\n", 
-						rediskey, max);
-					switch_goto_status(SWITCH_STATUS_FALSE, end);
-				}
-			} else {
-				if (credis_incr(redis, uuid_rediskey, &uuid_val) != 0) {
-       				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Couldn't increment value corresponding to %s\n", uuid_rediskey);
-       				switch_goto_status(SWITCH_STATUS_FALSE, end);
-				}
-			}	
-		}	
-    }
+	redis_usage_cache_set(rediskey, vals[0]);
+	switch_core_hash_insert_locked(pvt->hash, rediskey, rediskey, pvt->mutex);
 /*
-	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Limit incr redis : rediskey : %s val : %d max : %d\n", rediskey, val, max);
-	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Limit incr redis : uuid_rediskey : %s uuid_val : %d max : %d\n", uuid_rediskey,uuid_val,max);
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Limit incr redis : rediskey : %s val : %d max : %d\n", rediskey, vals[0], max);
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Limit incr redis : uuid_rediskey : %s uuid_val : %d max : %d\n", uuid_rediskey, vals[1], max);
 */
 end:
-	if (redis) {
-		credis_close(redis);
-	}
+	redis_release(redis, reuse);
 	return status;
 }
 	
@@ -146,75 +235,88 @@ SWITCH_LIMIT_RELEASE(limit_release_redis)
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	limit_redis_private_t *pvt = switch_channel_get_private(channel, "limit_redis");
-	int val, uuid_val;
 	switch_hash_index_t *hi;
-	char *rediskey = NULL;
-	char *uuid_rediskey = NULL;
+	const char **keys = NULL;
+	int *incrs = NULL, *vals = NULL;
+	int keyc = 0, count = 0, i;
 	int status = SWITCH_STATUS_SUCCESS;
-	REDIS redis;
+	REDIS redis = NULL;
 	
 	if (!pvt || !pvt->hash) {
         switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "No hashtable for channel %s\n", switch_channel_get_name(channel));
 		return SWITCH_STATUS_SUCCESS;
 	}
-	
-	if (redis_factory(&redis) != SWITCH_STATUS_SUCCESS) {
-		return SWITCH_STATUS_FALSE;
-	}
 
 	switch_mutex_lock(pvt->mutex);
 
 	/* clear for uuid */
+	if (realm == NULL && resource == NULL) {
+		for (hi = switch_hash_first(NULL, pvt->hash); hi; hi = switch_hash_next(hi)) {
+			count++;
+		}
+	} else {
+		count = 1;
+	}
+
+	if (!count) {
+		goto end;
+	}
+
+	keys = switch_core_session_alloc(session, sizeof(*keys) * count * 2);
+	incrs = switch_core_session_alloc(session, sizeof(*incrs) * count * 2);
+	vals = switch_core_session_alloc(session, sizeof(*vals) * count * 2);
+
 	if (realm == NULL && resource == NULL) {
 		/* Loop through the channel's hashtable which contains mapping to all the limit_redis_item_t referenced by that channel */
-		while ((hi = switch_hash_first(NULL, pvt->hash))) {
+		while ((hi = switch_hash_first(NULL, pvt->hash)) && keyc < count * 2) {
 			void *p_val = NULL;
 			const void *p_key;
-			char *p_uuid_key = NULL;
 			switch_ssize_t keylen;
 			
 			switch_hash_this(hi, &p_key, &keylen, &p_val);
-			
-			if (credis_decr(redis, (const char*)p_key, &val) != 0) {
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Couldn't decrement value corresponding to %s\n", (char *)p_key);
-				switch_goto_status(SWITCH_STATUS_FALSE, end);
-			}
-	   		p_uuid_key = switch_core_session_sprintf(session, "%s_%s", switch_core_get_switchname(), (char *)p_key);
-			if (credis_decr(redis,p_uuid_key,&uuid_val) != 0) {
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Couldn't decrement value corresponding to %s\n", p_uuid_key);
-				switch_goto_status(SWITCH_STATUS_FALSE, end);
-			}
+
+			keys[keyc++] = (char *) p_val;
+			keys[keyc++] = switch_core_session_sprintf(session, "%s_%s", switch_core_get_switchname(), (char *) p_val);
 			switch_core_hash_delete(pvt->hash, (const char *) p_key);
-			/*
-        	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Limit release redis : rediskey : %s val : %d\n", (char *)p_val,val);
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Limit incr redis : uuid_rediskey : %s uuid_val : %d\n",
-					 p_uuid_key, uuid_val);*/
 		}
-	
-	} else {	
-	   	rediskey = switch_core_session_sprintf(session, "%s_%s", realm, resource);
-		uuid_rediskey = switch_core_session_sprintf(session, "%s_%s_%s", switch_core_get_switchname(), realm, resource);
-		switch_core_hash_delete(pvt->hash, (const char *) rediskey);
+	} else {
+		char *rediskey = switch_core_session_sprintf(session, "%s_%s", realm, resource);
 
-		if (credis_decr(redis, rediskey, &val) != 0) {
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Couldn't decrement value corresponding to %s\n", rediskey);
-			switch_goto_status(SWITCH_STATUS_FALSE, end);
+		if (!switch_core_hash_find(pvt->hash, rediskey)) {
+			goto end;
 		}
-		if (credis_decr(redis, uuid_rediskey, &uuid_val) != 0) {
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Couldn't decrement value corresponding to %s\n", uuid_rediskey);
-			switch_goto_status(SWITCH_STATUS_FALSE, end);
-		}
-		
+		switch_core_hash_delete(pvt->hash, rediskey);
+
+		keys[keyc++] = rediskey;
+		keys[keyc++] = switch_core_session_sprintf(session, "%s_%s_%s", switch_core_get_switchname(), realm, resource);
+	}
+
+	for (i = 0; i < keyc; i++) {
+		incrs[i] = -1;
+	}
+
+	if (redis_factory(&redis) != SWITCH_STATUS_SUCCESS) {
+		switch_goto_status(SWITCH_STATUS_FALSE, end);
+	}
+
+	/* Every counter this channel holds goes down in a single pipelined round trip */
+	if (credis_incrby_multi(redis, keyc, keys, incrs, vals) != 0) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Couldn't decrement values for channel %s\n", switch_channel_get_name(channel));
+		redis_release(redis, SWITCH_FALSE);
+		switch_goto_status(SWITCH_STATUS_FALSE, end);
+	}
+
+	for (i = 0; i < keyc; i += 2) {
+		redis_usage_cache_set(keys[i], vals[i]);
+	}
 /*
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Limit release redis : rediskey : %s val : %d\n", rediskey,val);
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Limit incr redis : uuid_rediskey : %s uuid_val : %d\n", uuid_rediskey,uuid_val);
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Limit release redis : rediskey : %s val : %d\n", keys[0], vals[0]);
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Limit incr redis : uuid_rediskey : %s uuid_val : %d\n", keys[1], vals[1]);
 */
-	}
+	redis_release(redis, SWITCH_TRUE);
+
 end:
 	switch_mutex_unlock(pvt->mutex);
-	if (redis) {
-		credis_close(redis);
-	}
 	return status;
 }
 
@@ -223,23 +325,33 @@ SWITCH_LIMIT_USAGE(limit_usage_redis)
 	char *redis_key;
 	char *str;
 	REDIS redis;
-	int usage;
+	int usage = 0;
+	int rc;
+
+	redis_key = switch_mprintf("%s_%s", realm, resource);
+
+	if (redis_usage_cache_get(redis_key, &usage)) {
+		switch_safe_free(redis_key);
+		return usage;
+	}
 	
 	if (redis_factory(&redis) != SWITCH_STATUS_SUCCESS) {
+		switch_safe_free(redis_key);
 		return 0;
 	}
 
-	redis_key = switch_mprintf("%s_%s", realm, resource);
-  
-	if (credis_get(redis, redis_key, &str) != 0){
+	/* -1 is a missing key, anything below that leaves the connection in an unknown state */
+	if ((rc = credis_get(redis, redis_key, &str)) != 0) {
 		usage = 0;
 	} else {
 		usage = atoi(str);		
 	}
-	
-	if (redis) {
-		credis_close(redis);
+
+	if (rc == 0 || rc == -1) {
+		redis_usage_cache_set(redis_key, usage);
 	}
+
+	redis_release(redis, rc == 0 || rc == -1);
 	
 	switch_safe_free(redis_key);
 	return usage;
@@ -273,7 +385,7 @@ SWITCH_LIMIT_RESET(limit_reset_redis)
 			}
 		}
 		switch_safe_free(rediskey);
-		credis_close(redis);
+		redis_release(redis, SWITCH_TRUE);
 		return SWITCH_STATUS_SUCCESS;
 	} else {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Couldn't check/clear old redis entries\n");
@@ -297,6 +409,13 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_redis_load)
 		return SWITCH_STATUS_FALSE;
 	}
 
+	globals.pool = pool;
+	globals.idle_size = globals.max_connections > 0 ? globals.max_connections : 0;
+	globals.idle = switch_core_alloc(pool, sizeof(REDIS) * (globals.idle_size + 1));
+	switch_mutex_init(&globals.pool_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&globals.cache_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&globals.usage_cache, pool);
+
 	/* If FreeSWITCH was restarted and we still have active calls, decrement them so our global count stays valid */
 	limit_reset_redis();
 	
@@ -307,6 +426,25 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_redis_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_redis_shutdown)
 {
+	switch_hash_index_t *hi;
+
+	switch_mutex_lock(globals.pool_mutex);
+	while (globals.idle_count > 0) {
+		credis_close(globals.idle[--globals.idle_count]);
+	}
+	switch_mutex_unlock(globals.pool_mutex);
+
+	switch_mutex_lock(globals.cache_mutex);
+	while ((hi = switch_hash_first(NULL, globals.usage_cache))) {
+		const void *key;
+		void *val;
+
+		switch_hash_this(hi, &key, NULL, &val);
+		switch_core_hash_delete(globals.usage_cache, key);
+		free(val);
+	}
+	switch_mutex_unlock(globals.cache_mutex);
+	switch_core_hash_destroy(&globals.usage_cache);
 
 	switch_xml_config_cleanup(instructions);
 
@@ -330,6 +330,7 @@ switch_status_t load_configuration(switch_bool_t reload)
 	spandsp_globals.verbose = 0;
 	spandsp_globals.use_ecm = 1;
 	spandsp_globals.disable_v17 = 0;
+	spandsp_globals.fax_workers = 2;
 	spandsp_globals.prepend_string = switch_core_strdup(spandsp_globals.config_pool, "fax");
 	spandsp_globals.spool = switch_core_strdup(spandsp_globals.config_pool, "/tmp");
     spandsp_globals.ident = "SpanDSP Fax Ident";
@@ -426,6 +427,14 @@ switch_status_t load_configuration(switch_bool_t reload)
 					spandsp_globals.spool = switch_core_strdup(spandsp_globals.config_pool, value);
 				} else if (!strcmp(name, "file-prefix")) {
 					spandsp_globals.prepend_string = switch_core_strdup(spandsp_globals.config_pool, value);
+				} else if (!reload && !strcmp(name, "worker-threads")) {
+					int tmp = atoi(value);
+
+					if (tmp > -1 && tmp <= MAX_FAX_WORKERS) {
+						spandsp_globals.fax_workers = tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid value [%d] for worker-threads\n", tmp);
+					}
 				} else {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Unknown parameter %s\n", name);
 				}
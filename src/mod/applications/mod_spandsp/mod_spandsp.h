@@ -43,6 +43,7 @@ typedef int zap_socket_t;
 #endif
 
 #define MAX_MODEMS 1024
+#define MAX_FAX_WORKERS 16
 #define SPANDSP_EXPOSE_INTERNAL_STRUCTURES
 #include <spandsp.h>
 
@@ -67,6 +68,7 @@ struct spandsp_globals {
 	char *spool;
 	switch_thread_cond_t *cond;
 	switch_mutex_t *cond_mutex;
+	int fax_workers;
 	int modem_count;
 	int modem_verbose;
 	char *modem_context;
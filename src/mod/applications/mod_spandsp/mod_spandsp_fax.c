@@ -69,6 +69,15 @@ typedef enum {
     T38_MODE_REFUSED = -1,
 } t38_mode_t;
 
+/* How long the media thread spent on each frame, a slip is a frame that took longer to process than it lasts */
+typedef struct {
+	switch_time_t budget;
+	switch_time_t start;
+	switch_time_t max;
+	uint32_t frames;
+	uint32_t slips;
+} fax_timing_t;
+
 
 struct pvt_s {
 	switch_core_session_t *session;
@@ -99,6 +108,8 @@ struct pvt_s {
     
     t38_mode_t t38_mode;
 
+	fax_timing_t timing;
+
     struct pvt_s *next;
 };
 
@@ -106,6 +117,23 @@ typedef struct pvt_s pvt_t;
 
 static void launch_timer_thread(void);
 
+typedef enum {
+	FAX_JOB_SYSTEM,
+	FAX_JOB_PREFETCH
+} fax_job_type_t;
+
+/* Work that has no business on a media thread: forking for system_on_fax_* and pulling a TX document into the page cache */
+typedef struct {
+	fax_job_type_t type;
+	char *arg;
+} fax_job_t;
+
+static struct {
+	switch_queue_t *queue;
+	switch_thread_t *threads[MAX_FAX_WORKERS];
+	int count;
+} fax_workers;
+
 static struct {
     pvt_t *head;
     switch_mutex_t *mutex;
@@ -248,6 +276,120 @@ static void launch_timer_thread(void)
 }
 
 
+static void fax_job_run(fax_job_t *job)
+{
+	switch (job->type) {
+	case FAX_JOB_SYSTEM:
+		switch_system(job->arg, SWITCH_FALSE);
+		break;
+	case FAX_JOB_PREFETCH:
+		{
+			/* libtiff then reads each page from memory instead of waiting on the disk mid-call */
+			char buf[65536];
+			FILE *f;
+
+			if ((f = fopen(job->arg, "rb"))) {
+				while (fread(buf, 1, sizeof(buf), f) == sizeof(buf));
+				fclose(f);
+			}
+		}
+		break;
+	}
+}
+
+static void *SWITCH_THREAD_FUNC fax_worker_run(switch_thread_t *thread, void *obj)
+{
+	void *pop;
+
+	while (switch_queue_pop(fax_workers.queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		fax_job_t *job = (fax_job_t *) pop;
+
+		fax_job_run(job);
+		free(job->arg);
+		free(job);
+	}
+
+	return NULL;
+}
+
+static void launch_fax_workers(void)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	int i;
+
+	if (!spandsp_globals.fax_workers) {
+		return;
+	}
+
+	switch_queue_create(&fax_workers.queue, SWITCH_CORE_QUEUE_LEN, spandsp_globals.pool);
+
+	for (i = 0; i < spandsp_globals.fax_workers; i++) {
+		switch_threadattr_create(&thd_attr, spandsp_globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		if (switch_thread_create(&fax_workers.threads[i], thd_attr, fax_worker_run, NULL, spandsp_globals.pool) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+		fax_workers.count++;
+	}
+}
+
+/* Hand a job to the workers, with none running (or all of them hopelessly behind) it runs right here */
+static void fax_job_push(fax_job_type_t type, const char *arg)
+{
+	fax_job_t *job;
+
+	switch_zmalloc(job, sizeof(*job));
+	job->type = type;
+	job->arg = strdup(arg);
+
+	if (!fax_workers.count || switch_queue_trypush(fax_workers.queue, job) != SWITCH_STATUS_SUCCESS) {
+		fax_job_run(job);
+		free(job->arg);
+		free(job);
+	}
+}
+
+static void fax_timing_begin(fax_timing_t *timing)
+{
+	timing->start = switch_time_ref();
+}
+
+static void fax_timing_end(fax_timing_t *timing)
+{
+	switch_time_t elapsed;
+
+	if (!timing->start) {
+		return;
+	}
+
+	elapsed = switch_time_ref() - timing->start;
+	timing->start = 0;
+	timing->frames++;
+
+	if (elapsed > timing->max) {
+		timing->max = elapsed;
+	}
+
+	if (timing->budget && elapsed > timing->budget) {
+		timing->slips++;
+	}
+}
+
+static void fax_timing_report(switch_core_session_t *session, fax_timing_t *timing)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+
+	switch_channel_set_variable_printf(channel, "fax_timing_frames", "%u", timing->frames);
+	switch_channel_set_variable_printf(channel, "fax_timing_slips", "%u", timing->slips);
+	switch_channel_set_variable_printf(channel, "fax_timing_max_usec", "%" SWITCH_TIME_T_FMT, timing->max);
+
+	if (timing->slips) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING,
+						  "%u of %u fax frames took longer than %" SWITCH_TIME_T_FMT "us to process, longest %" SWITCH_TIME_T_FMT "us\n",
+						  timing->slips, timing->frames, timing->budget, timing->max);
+	}
+}
+
 /*****************************************************************************
 	LOGGING AND HELPER FUNCTIONS
 *****************************************************************************/
@@ -587,12 +729,14 @@ static void phase_e_handler(t30_state_t *s, void *user_data, int result)
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "fax-ecm-used", (t.error_correcting_mode) ? "on" : "off");
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "fax-local-station-id", local_ident);
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "fax-remote-station-id", far_ident);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "fax-timing-slips", "%u", pvt->timing.slips);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "fax-timing-max-usec", "%" SWITCH_TIME_T_FMT, pvt->timing.max);
 		switch_event_fire(&event);
 	}
 
     if ((var = switch_channel_get_variable(channel, "system_on_fax_result"))) {
         expanded = switch_channel_expand_variables(channel, var);
-        switch_system(expanded, SWITCH_FALSE);
+        fax_job_push(FAX_JOB_SYSTEM, expanded);
         if (expanded != var) {
             free(expanded);
         }
@@ -603,7 +747,7 @@ static void phase_e_handler(t30_state_t *s, void *user_data, int result)
     if (result == T30_ERR_OK) {
         if ((var = switch_channel_get_variable(channel, "system_on_fax_success"))) {
             expanded = switch_channel_expand_variables(channel, var);
-            switch_system(expanded, SWITCH_FALSE);
+            fax_job_push(FAX_JOB_SYSTEM, expanded);
             if (expanded != var) {
                 free(expanded);
             }
@@ -612,7 +756,7 @@ static void phase_e_handler(t30_state_t *s, void *user_data, int result)
     } else {
         if ((var = switch_channel_get_variable(channel, "system_on_fax_failure"))) {
             expanded = switch_channel_expand_variables(channel, var);
-            switch_system(expanded, SWITCH_FALSE);
+            fax_job_push(FAX_JOB_SYSTEM, expanded);
             if (expanded != var) {
                 free(expanded);
             }
@@ -1290,6 +1434,7 @@ void mod_spandsp_fax_process_fax(switch_core_session_t *session, const char *dat
 								  switch_str_nil(pvt->filename));
 				goto done;
 			}
+			fax_job_push(FAX_JOB_PREFETCH, pvt->filename);
 		}
 	} else {
 		if (pvt->app_mode == FUNCTION_TX) {
@@ -1387,6 +1532,8 @@ void mod_spandsp_fax_process_fax(switch_core_session_t *session, const char *dat
         req_counter = 50;
     }
 
+	pvt->timing.budget = read_impl.microseconds_per_packet;
+
 	while (switch_channel_ready(channel)) {
 		int tx = 0;
 		switch_status_t status;
@@ -1462,7 +1609,9 @@ void mod_spandsp_fax_process_fax(switch_core_session_t *session, const char *dat
                     /* now we know we can cast frame->packet to a udptl structure */
                     //switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "READ %d udptl bytes\n", read_frame->packetlen);
                     
+					fax_timing_begin(&pvt->timing);
                     udptl_rx_packet(pvt->udptl_state, read_frame->packet, read_frame->packetlen);
+					fax_timing_end(&pvt->timing);
                 }
             }
             continue;
@@ -1470,6 +1619,8 @@ void mod_spandsp_fax_process_fax(switch_core_session_t *session, const char *dat
             break;
         }
 
+		fax_timing_begin(&pvt->timing);
+
 		if (switch_test_flag(read_frame, SFF_CNG)) {
 			/* We have no real signal data for the FAX software, but we have a space in time if we have a CNG indication.
 			   Do a fill-in operation in the FAX machine, to keep things rolling along. */
@@ -1490,6 +1641,8 @@ void mod_spandsp_fax_process_fax(switch_core_session_t *session, const char *dat
 			goto done;
 		}
 
+		fax_timing_end(&pvt->timing);
+
 		if (!tx) {
 			/* switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "No audio samples to send\n"); */
 			continue;
@@ -1506,6 +1659,9 @@ void mod_spandsp_fax_process_fax(switch_core_session_t *session, const char *dat
 	}
 
   done:
+	fax_timing_end(&pvt->timing);
+	fax_timing_report(session, &pvt->timing);
+
 	/* Destroy the SpanDSP structures */
 	spanfax_destroy(pvt);
 
@@ -1539,15 +1695,28 @@ void mod_spandsp_fax_load(switch_memory_pool_t *pool)
     while(--sanity && !t38_state_list.thread_running) {
         switch_yield(20000);
     }
+
+	memset(&fax_workers, 0, sizeof(fax_workers));
+	launch_fax_workers();
 }
 
 void mod_spandsp_fax_shutdown(void)
 {
     switch_status_t tstatus = SWITCH_STATUS_SUCCESS;
+    int i;
 
     t38_state_list.thread_running = 0;
     wake_thread(1);
     switch_thread_join(&tstatus, t38_state_list.thread);
+
+	/* the workers finish the jobs queued ahead of their NULL */
+	for (i = 0; i < fax_workers.count; i++) {
+		switch_queue_push(fax_workers.queue, NULL);
+	}
+	for (i = 0; i < fax_workers.count; i++) {
+		switch_thread_join(&tstatus, fax_workers.threads[i]);
+	}
+	fax_workers.count = 0;
 	memset(&spandsp_globals, 0, sizeof(spandsp_globals));
 }
 
@@ -1563,6 +1732,7 @@ static switch_status_t t38_gateway_on_soft_execute(switch_core_session_t *sessio
     switch_core_session_message_t msg = { 0 };
     switch_status_t status;
     switch_frame_t *read_frame = { 0 };
+    fax_timing_t timing = { 20000 };
 
     if (!(other_session = switch_core_session_locate(peer_uuid))) {
         switch_channel_hangup(channel, SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER);
@@ -1648,12 +1818,16 @@ static switch_status_t t38_gateway_on_soft_execute(switch_core_session_t *sessio
         }
         
         if (switch_test_flag(read_frame, SFF_UDPTL_PACKET)) {
+            fax_timing_begin(&timing);
             udptl_rx_packet(pvt->udptl_state, read_frame->packet, read_frame->packetlen);
+            fax_timing_end(&timing);
         }
     }
 
  end_unlock:
 
+    fax_timing_report(session, &timing);
+
 
     msg.message_id = SWITCH_MESSAGE_INDICATE_UNBRIDGE;
     msg.from = __FILE__;
@@ -1691,8 +1865,10 @@ static switch_status_t t38_gateway_on_consume_media(switch_core_session_t *sessi
     zap_socket_t read_fd = FAX_INVALID_SOCKET, write_fd = FAX_INVALID_SOCKET;
     switch_core_session_message_t msg = { 0 };
     switch_event_t *event;
+    fax_timing_t timing = { 0 };
 
 	switch_core_session_get_read_impl(session, &read_impl);
+	timing.budget = read_impl.microseconds_per_packet;
     
     buf = switch_core_session_alloc(session, SWITCH_RECOMMENDED_BUFFER_SIZE);
 
@@ -1811,6 +1987,8 @@ static switch_status_t t38_gateway_on_consume_media(switch_core_session_t *sessi
 			goto end_unlock;
 		}
 
+        fax_timing_begin(&timing);
+
         if (switch_test_flag(read_frame, SFF_CNG)) {
 			/* We have no real signal data for the FAX software, but we have a space in time if we have a CNG indication.
 			   Do a fill-in operation in the FAX machine, to keep things rolling along. */
@@ -1831,6 +2009,8 @@ static switch_status_t t38_gateway_on_consume_media(switch_core_session_t *sessi
 			goto end_unlock;
 		}
 
+		fax_timing_end(&timing);
+
 		if (!tx) {
 			/* switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "No audio samples to send\n"); */
 			continue;
@@ -1852,6 +2032,9 @@ static switch_status_t t38_gateway_on_consume_media(switch_core_session_t *sessi
 
  end_unlock:
 
+    fax_timing_end(&timing);
+    fax_timing_report(session, &timing);
+
     msg.message_id = SWITCH_MESSAGE_INDICATE_UNBRIDGE;
     msg.from = __FILE__;
     msg.string_arg = peer_uuid;
@@ -46,6 +46,11 @@ SWITCH_MODULE_DEFINITION(mod_voicemail, mod_voicemail_load, mod_voicemail_shutdo
 
 #define VM_MAX_GREETINGS 9
 #define VM_EVENT_QUEUE_SIZE 50000
+#define VM_SQL_QUEUE_SIZE 10000
+/* how long a read waits for the writes queued before it, in ms */
+#define VM_SQL_FLUSH_TIMEOUT 5000
+#define VM_POST_QUEUE_SIZE 1000
+#define VM_MAX_POST_THREADS 16
 
 static switch_status_t voicemail_inject(const char *data, switch_core_session_t *session);
 
@@ -57,6 +62,11 @@ static struct {
 	int32_t threads;
 	int32_t running;
 	switch_queue_t *event_queue;
+	switch_queue_t *sql_queue;
+	int sql_thread_running;
+	switch_queue_t *post_queue;
+	int post_threads;
+	int post_threads_running;
 	switch_mutex_t *mutex;
 	switch_memory_pool_t *pool;
 } globals;
@@ -151,6 +161,12 @@ struct vm_profile {
 	switch_bool_t auto_playback_recordings;
 	switch_bool_t db_password_override;
 	switch_bool_t allow_empty_password_auth;
+	switch_bool_t async_sql;
+	uint32_t message_index_ttl;
+	switch_hash_t *index_hash;
+	switch_mutex_t *index_mutex;
+	uint32_t index_generation;
+	volatile switch_atomic_t sql_pending;
 	switch_thread_rwlock_t *rwlock;
 	switch_memory_pool_t *pool;
 	uint32_t flags;
@@ -160,6 +176,45 @@ struct vm_profile {
 };
 typedef struct vm_profile vm_profile_t;
 
+/* message counts of one folder of a mailbox as message_count() last read them */
+struct vm_index_folder {
+	char *folder;
+	time_t expires;
+	int total_new_messages;
+	int total_new_urgent_messages;
+	int total_saved_messages;
+	int total_saved_urgent_messages;
+	struct vm_index_folder *next;
+};
+typedef struct vm_index_folder vm_index_folder_t;
+
+struct vm_sql_job {
+	vm_profile_t *profile;
+	char *sql;
+};
+typedef struct vm_sql_job vm_sql_job_t;
+
+struct vm_mail {
+	char *to;
+	char *from;
+	char *headers;
+	char *body;
+	char *file;
+	char *convert_cmd;
+	char *convert_ext;
+	struct vm_mail *next;
+};
+typedef struct vm_mail vm_mail_t;
+
+/* what is left to do with a message once it is deposited, done off the caller's thread */
+struct vm_post_job {
+	switch_memory_pool_t *pool;
+	vm_mail_t *mails;
+	vm_mail_t *last;
+	char *unlink_path;
+};
+typedef struct vm_post_job vm_post_job_t;
+
 
 switch_cache_db_handle_t *vm_get_db_handle(vm_profile_t *profile)
 {
@@ -183,7 +238,7 @@ switch_cache_db_handle_t *vm_get_db_handle(vm_profile_t *profile)
 }
 
 
-static switch_status_t vm_execute_sql(vm_profile_t *profile, char *sql, switch_mutex_t *mutex)
+static switch_status_t vm_execute_sql_now(vm_profile_t *profile, char *sql, switch_mutex_t *mutex)
 {
 	switch_cache_db_handle_t *dbh = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
@@ -210,12 +265,59 @@ static switch_status_t vm_execute_sql(vm_profile_t *profile, char *sql, switch_m
 	return status;
 }
 
+/* writes go to the sql thread, the caller does not wait for the database */
+static switch_status_t vm_execute_sql(vm_profile_t *profile, char *sql, switch_mutex_t *mutex)
+{
+	vm_sql_job_t *job;
+
+	if (!profile->async_sql || !globals.sql_thread_running || globals.running != 1) {
+		return vm_execute_sql_now(profile, sql, mutex);
+	}
+
+	/* the job holds the profile until it is written */
+	if (switch_thread_rwlock_tryrdlock(profile->rwlock) != SWITCH_STATUS_SUCCESS) {
+		return vm_execute_sql_now(profile, sql, mutex);
+	}
+
+	switch_zmalloc(job, sizeof(*job));
+	job->profile = profile;
+	job->sql = strdup(sql);
+	switch_atomic_inc(&profile->sql_pending);
+
+	if (switch_queue_trypush(globals.sql_queue, job) != SWITCH_STATUS_SUCCESS) {
+		switch_atomic_dec(&profile->sql_pending);
+		switch_thread_rwlock_unlock(profile->rwlock);
+		switch_safe_free(job->sql);
+		free(job);
+		return vm_execute_sql_now(profile, sql, mutex);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* reads have to see the writes queued before them */
+static void vm_sql_flush(vm_profile_t *profile)
+{
+	int sanity = VM_SQL_FLUSH_TIMEOUT;
+
+	while (switch_atomic_read(&profile->sql_pending)) {
+		if (--sanity <= 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[%s] Timed out waiting for %u queued sql writes\n",
+							  profile->name, switch_atomic_read(&profile->sql_pending));
+			break;
+		}
+		switch_yield(1000);
+	}
+}
+
 char *vm_execute_sql2str(vm_profile_t *profile, switch_mutex_t *mutex, char *sql, char *resbuf, size_t len)
 {
 	switch_cache_db_handle_t *dbh = NULL;
 
 	char *ret = NULL;
 
+	vm_sql_flush(profile);
+
 	if (mutex) {
 		switch_mutex_lock(mutex);
 	}
@@ -247,6 +349,8 @@ static switch_bool_t vm_execute_sql_callback(vm_profile_t *profile, switch_mutex
 	char *errmsg = NULL;
 	switch_cache_db_handle_t *dbh = NULL;
 
+	vm_sql_flush(profile);
+
 	if (mutex) {
 		switch_mutex_lock(mutex);
 	}
@@ -276,6 +380,154 @@ static switch_bool_t vm_execute_sql_callback(vm_profile_t *profile, switch_mutex
 
 
 
+static void vm_index_free(vm_index_folder_t *folder)
+{
+	vm_index_folder_t *next;
+
+	for (; folder; folder = next) {
+		next = folder->next;
+		switch_safe_free(folder->folder);
+		free(folder);
+	}
+}
+
+/* drop what is known about a mailbox, or about all of them when there is no id */
+static void vm_index_forget(vm_profile_t *profile, const char *id, const char *domain)
+{
+	switch_hash_index_t *hi;
+	const void *key;
+	void *val;
+	char *mkey;
+
+	if (!profile->index_hash) {
+		return;
+	}
+
+	switch_mutex_lock(profile->index_mutex);
+	profile->index_generation++;
+
+	if (id && domain) {
+		mkey = switch_mprintf("%s@%s", id, domain);
+		if ((val = switch_core_hash_find(profile->index_hash, mkey))) {
+			switch_core_hash_delete(profile->index_hash, mkey);
+			vm_index_free((vm_index_folder_t *) val);
+		}
+		free(mkey);
+	} else {
+		while ((hi = switch_hash_first(NULL, profile->index_hash))) {
+			switch_hash_this(hi, &key, NULL, &val);
+			mkey = strdup((const char *) key);
+			switch_core_hash_delete(profile->index_hash, mkey);
+			free(mkey);
+			vm_index_free((vm_index_folder_t *) val);
+		}
+	}
+
+	switch_mutex_unlock(profile->index_mutex);
+}
+
+static vm_index_folder_t *vm_index_find(vm_profile_t *profile, const char *mkey, const char *folder)
+{
+	vm_index_folder_t *np;
+
+	for (np = (vm_index_folder_t *) switch_core_hash_find(profile->index_hash, mkey); np; np = np->next) {
+		if (!strcmp(np->folder, folder)) {
+			break;
+		}
+	}
+
+	return np;
+}
+
+/* the counts of a folder if they are known and fresh, generation is what vm_index_put() takes after reading them from the db */
+static switch_bool_t vm_index_get(vm_profile_t *profile, const char *id, const char *domain, const char *folder, vm_index_folder_t *counts,
+								  uint32_t *generation)
+{
+	vm_index_folder_t *np;
+	switch_bool_t found = SWITCH_FALSE;
+	char *mkey;
+
+	switch_mutex_lock(profile->index_mutex);
+	*generation = profile->index_generation;
+
+	if (profile->message_index_ttl) {
+		mkey = switch_mprintf("%s@%s", id, domain);
+		if ((np = vm_index_find(profile, mkey, folder)) && np->expires > switch_epoch_time_now(NULL)) {
+			*counts = *np;
+			found = SWITCH_TRUE;
+		}
+		free(mkey);
+	}
+
+	switch_mutex_unlock(profile->index_mutex);
+
+	return found;
+}
+
+static void vm_index_put(vm_profile_t *profile, const char *id, const char *domain, const char *folder, const vm_index_folder_t *counts,
+						 uint32_t generation)
+{
+	vm_index_folder_t *np, *head;
+	char *mkey;
+
+	if (!profile->message_index_ttl) {
+		return;
+	}
+
+	switch_mutex_lock(profile->index_mutex);
+
+	/* something was written since the counts were read, they may be stale already */
+	if (generation != profile->index_generation) {
+		switch_mutex_unlock(profile->index_mutex);
+		return;
+	}
+
+	mkey = switch_mprintf("%s@%s", id, domain);
+
+	if (!(np = vm_index_find(profile, mkey, folder))) {
+		head = (vm_index_folder_t *) switch_core_hash_find(profile->index_hash, mkey);
+		switch_zmalloc(np, sizeof(*np));
+		np->folder = strdup(folder);
+		np->next = head;
+		switch_core_hash_insert(profile->index_hash, mkey, np);
+	}
+
+	np->total_new_messages = counts->total_new_messages;
+	np->total_new_urgent_messages = counts->total_new_urgent_messages;
+	np->total_saved_messages = counts->total_saved_messages;
+	np->total_saved_urgent_messages = counts->total_saved_urgent_messages;
+	np->expires = switch_epoch_time_now(NULL) + profile->message_index_ttl;
+
+	free(mkey);
+	switch_mutex_unlock(profile->index_mutex);
+}
+
+/* a new message is simply counted, no need to ask the db again */
+static void vm_index_deposit(vm_profile_t *profile, const char *id, const char *domain, const char *folder, const char *read_flags)
+{
+	vm_index_folder_t *np;
+	char *mkey;
+
+	if (!profile->index_hash) {
+		return;
+	}
+
+	switch_mutex_lock(profile->index_mutex);
+	profile->index_generation++;
+
+	mkey = switch_mprintf("%s@%s", id, domain);
+	if ((np = vm_index_find(profile, mkey, folder))) {
+		if (read_flags && !strcasecmp(read_flags, "A_URGENT")) {
+			np->total_new_urgent_messages++;
+		} else {
+			np->total_new_messages++;
+		}
+	}
+	free(mkey);
+
+	switch_mutex_unlock(profile->index_mutex);
+}
+
 static char vm_sql[] =
 	"CREATE TABLE voicemail_msgs (\n"
 	"   created_epoch INTEGER,\n"
@@ -313,6 +565,8 @@ static char *vm_index_list[] = {
 static void free_profile(vm_profile_t *profile)
 {
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Destroying Profile %s\n", profile->name);
+	vm_index_forget(profile, NULL, NULL);
+	switch_core_hash_destroy(&profile->index_hash);
 	switch_core_destroy_memory_pool(&profile->pool);
 }
 
@@ -640,6 +894,10 @@ vm_profile_t *profile_set_config(vm_profile_t *profile)
 						   &profile->db_password_override, SWITCH_FALSE, NULL, NULL, NULL);
 	SWITCH_CONFIG_SET_ITEM(profile->config[i++], "allow-empty-password-auth", SWITCH_CONFIG_BOOL, CONFIG_RELOADABLE,
 						   &profile->allow_empty_password_auth, SWITCH_TRUE, NULL, NULL, NULL);
+	SWITCH_CONFIG_SET_ITEM(profile->config[i++], "async-sql", SWITCH_CONFIG_BOOL, CONFIG_RELOADABLE,
+						   &profile->async_sql, SWITCH_TRUE, NULL, NULL, NULL);
+	SWITCH_CONFIG_SET_ITEM(profile->config[i++], "message-index-ttl", SWITCH_CONFIG_INT, CONFIG_RELOADABLE,
+						   &profile->message_index_ttl, 60, &config_int_ht_0, "seconds", NULL);
 
 	switch_assert(i < VM_PROFILE_CONFIGITEM_COUNT);
 
@@ -748,6 +1006,8 @@ static vm_profile_t *load_profile(const char *profile_name)
 		switch_cache_db_release_db_handle(&dbh);
 
 		switch_mutex_init(&profile->mutex, SWITCH_MUTEX_NESTED, profile->pool);
+		switch_mutex_init(&profile->index_mutex, SWITCH_MUTEX_NESTED, profile->pool);
+		switch_core_hash_init(&profile->index_hash, profile->pool);
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Added Profile %s\n", profile->name);
 		switch_core_hash_insert(globals.profile_hash, profile->name, profile);
 	}
@@ -815,6 +1075,14 @@ static switch_status_t load_config(void)
 				globals.debug = atoi(val);
 			} else if (!strcasecmp(var, "message-query-exact-match")) {
 				globals.message_query_exact_match = switch_true(val);
+			} else if (!strcasecmp(var, "post-process-threads")) {
+				int tmp = atoi(val);
+
+				if (tmp >= 0 && tmp <= VM_MAX_POST_THREADS) {
+					globals.post_threads = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "post-process-threads must be between 0 and %d\n", VM_MAX_POST_THREADS);
+				}
 			}
 		}
 	}
@@ -1329,6 +1597,8 @@ static void message_count(vm_profile_t *profile, const char *id_in, const char *
 {
 	char msg_count[80] = "";
 	msg_cnt_callback_t cbt = { 0 };
+	vm_index_folder_t counts = { 0 };
+	uint32_t generation = 0;
 	char *sql;
 	char *myid = NULL;
 
@@ -1343,6 +1613,14 @@ static void message_count(vm_profile_t *profile, const char *id_in, const char *
 
 	myid = resolve_id(id_in, domain_name, "message-count");
 
+	if (vm_index_get(profile, myid, domain_name, myfolder, &counts, &generation)) {
+		cbt.total_new_messages = counts.total_new_messages;
+		cbt.total_new_urgent_messages = counts.total_new_urgent_messages;
+		cbt.total_saved_messages = counts.total_saved_messages;
+		cbt.total_saved_urgent_messages = counts.total_saved_urgent_messages;
+		goto done;
+	}
+
 	sql = switch_mprintf(
 						 "select 1, read_flags, count(read_epoch) from voicemail_msgs where "
 						 "username='%q' and domain='%q' and in_folder='%q' and read_epoch=0 "
@@ -1358,6 +1636,14 @@ static void message_count(vm_profile_t *profile, const char *id_in, const char *
 	vm_execute_sql_callback(profile, profile->mutex, sql, message_count_callback, &cbt);
 	free(sql);
 
+	counts.total_new_messages = cbt.total_new_messages;
+	counts.total_new_urgent_messages = cbt.total_new_urgent_messages;
+	counts.total_saved_messages = cbt.total_saved_messages;
+	counts.total_saved_urgent_messages = cbt.total_saved_urgent_messages;
+	vm_index_put(profile, myid, domain_name, myfolder, &counts, generation);
+
+  done:
+
 	*total_new_messages = cbt.total_new_messages + cbt.total_new_urgent_messages;
 	*total_new_urgent_messages = cbt.total_new_urgent_messages;
 	*total_saved_messages = cbt.total_saved_messages + cbt.total_saved_urgent_messages;
@@ -2046,6 +2332,7 @@ static void voicemail_check_main(switch_core_session_t *session, vm_profile_t *p
 				vm_execute_sql_callback(profile, profile->mutex, sql, unlink_callback, NULL);
 				switch_snprintfv(sql, sizeof(sql), "delete from voicemail_msgs where username='%q' and domain='%q' and flags='delete'", myid, domain_name);
 				vm_execute_sql(profile, sql, profile->mutex);
+				vm_index_forget(profile, myid, domain_name);
 				vm_check_state = VM_CHECK_FOLDER_SUMMARY;
 
 				update_mwi(profile, myid, domain_name, myfolder);
@@ -2549,6 +2836,66 @@ static void voicemail_check_main(switch_core_session_t *session, vm_profile_t *p
 }
 
 
+static vm_post_job_t *vm_post_job_create(void)
+{
+	switch_memory_pool_t *pool;
+	vm_post_job_t *job;
+
+	switch_core_new_memory_pool(&pool);
+	job = switch_core_alloc(pool, sizeof(*job));
+	job->pool = pool;
+
+	return job;
+}
+
+static void vm_post_job_add_mail(vm_post_job_t *job, const char *to, const char *from, const char *headers, const char *body,
+								 const char *file, const char *convert_cmd, const char *convert_ext)
+{
+	vm_mail_t *mail = switch_core_alloc(job->pool, sizeof(*mail));
+
+	mail->to = switch_core_strdup(job->pool, to);
+	mail->from = switch_core_strdup(job->pool, from);
+	mail->headers = switch_core_strdup(job->pool, headers);
+	mail->body = switch_core_strdup(job->pool, body);
+	mail->file = switch_core_strdup(job->pool, file);
+	mail->convert_cmd = switch_core_strdup(job->pool, convert_cmd);
+	mail->convert_ext = switch_core_strdup(job->pool, convert_ext);
+
+	if (job->last) {
+		job->last->next = mail;
+	} else {
+		job->mails = mail;
+	}
+	job->last = mail;
+}
+
+static void vm_post_job_run(vm_post_job_t *job)
+{
+	switch_memory_pool_t *pool = job->pool;
+	vm_mail_t *mail;
+
+	for (mail = job->mails; mail; mail = mail->next) {
+		switch_simple_email(mail->to, mail->from, mail->headers, mail->body, mail->file, mail->convert_cmd, mail->convert_ext);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Sent message to %s\n", mail->to);
+	}
+
+	if (job->unlink_path && unlink(job->unlink_path) != 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Failed to delete file [%s]\n", job->unlink_path);
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+}
+
+/* hand the job to the post processing threads, it is done right away when there are none or they are behind */
+static void vm_post_job_queue(vm_post_job_t *job)
+{
+	if (globals.post_threads_running && globals.running == 1 && switch_queue_trypush(globals.post_queue, job) == SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	vm_post_job_run(job);
+}
+
 static switch_status_t deliver_vm(vm_profile_t *profile,
 								  switch_xml_t x_user,
 								  const char *domain_name,
@@ -2585,6 +2932,7 @@ static switch_status_t deliver_vm(vm_profile_t *profile,
 	switch_status_t ret = SWITCH_STATUS_SUCCESS;
 	char *convert_cmd = profile->convert_cmd;
 	char *convert_ext = profile->convert_ext;
+	vm_post_job_t *post_job = NULL;
 	
 	if (!params) {
 		switch_event_create(&local_event, SWITCH_EVENT_REQUEST_PARAMS);
@@ -2725,6 +3073,7 @@ static switch_status_t deliver_vm(vm_profile_t *profile,
 
 		vm_execute_sql(profile, usql, profile->mutex);
 		switch_safe_free(usql);
+		vm_index_deposit(profile, myid, domain_name, myfolder, read_flags);
 
 		update_mwi(profile, myid, domain_name, myfolder);
 	}
@@ -2749,6 +3098,8 @@ static switch_status_t deliver_vm(vm_profile_t *profile,
 		switch_size_t retsize;
 		char *formatted_cid_num = NULL;
 
+		post_job = vm_post_job_create();
+
 		message_count(profile, myid, domain_name, myfolder, &total_new_messages, &total_saved_messages,
 					  &total_new_urgent_messages, &total_saved_urgent_messages);
 
@@ -2836,9 +3187,9 @@ static switch_status_t deliver_vm(vm_profile_t *profile,
 			}
 
 			if (email_attach) {
-				switch_simple_email(vm_email, from, header_string, body, file_path, convert_cmd, convert_ext);
+				vm_post_job_add_mail(post_job, vm_email, from, header_string, body, file_path, convert_cmd, convert_ext);
 			} else {
-				switch_simple_email(vm_email, from, header_string, body, NULL, NULL, NULL);
+				vm_post_job_add_mail(post_job, vm_email, from, header_string, body, NULL, NULL, NULL);
 			}
 
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Sending message to %s\n", vm_email);
@@ -2889,7 +3240,7 @@ static switch_status_t deliver_vm(vm_profile_t *profile,
 				body = switch_mprintf("%u second Voicemail from %s %s", message_len, caller_id_name, caller_id_number);
 			}
 
-			switch_simple_email(vm_notify_email, from, header_string, body, NULL, NULL, NULL);
+			vm_post_job_add_mail(post_job, vm_notify_email, from, header_string, body, NULL, NULL, NULL);
 
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Sending notify message to %s\n", vm_notify_email);
 
@@ -2923,11 +3274,18 @@ static switch_status_t deliver_vm(vm_profile_t *profile,
   failed:
 
 	if (!insert_db && file_path && switch_file_exists(file_path, pool) == SWITCH_STATUS_SUCCESS) {
-		if (unlink(file_path) != 0) {
+		if (post_job) {
+			/* the mail may still need it as an attachment */
+			post_job->unlink_path = switch_core_strdup(post_job->pool, file_path);
+		} else if (unlink(file_path) != 0) {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Failed to delete file [%s]\n", file_path);
 		}
 	}
 
+	if (post_job) {
+		vm_post_job_queue(post_job);
+	}
+
 	switch_event_destroy(&local_event);
 
 	switch_safe_free(dir_path);
@@ -3915,6 +4273,107 @@ void vm_event_thread_start(void)
 	switch_thread_create(&thread, thd_attr, vm_event_thread_run, NULL, globals.pool);
 }
 
+static void vm_sql_job_run(vm_sql_job_t *job)
+{
+	vm_profile_t *profile = job->profile;
+
+	vm_execute_sql_now(profile, job->sql, profile->mutex);
+	switch_atomic_dec(&profile->sql_pending);
+	profile_rwunlock(profile);
+	switch_safe_free(job->sql);
+	free(job);
+}
+
+void *SWITCH_THREAD_FUNC vm_sql_thread_run(switch_thread_t *thread, void *obj)
+{
+	void *pop;
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "SQL Thread Started\n");
+
+	while (globals.running == 1) {
+		if (switch_queue_pop_timeout(globals.sql_queue, &pop, 500000) == SWITCH_STATUS_SUCCESS && pop) {
+			vm_sql_job_run((vm_sql_job_t *) pop);
+		}
+	}
+
+	/* nothing queued is lost on the way down */
+	while (switch_queue_trypop(globals.sql_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		if (pop) {
+			vm_sql_job_run((vm_sql_job_t *) pop);
+		}
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "SQL Thread Ended\n");
+
+	switch_mutex_lock(globals.mutex);
+	globals.sql_thread_running = 0;
+	globals.threads--;
+	switch_mutex_unlock(globals.mutex);
+
+	return NULL;
+}
+
+static void vm_sql_thread_start(void)
+{
+	switch_thread_t *thread;
+	switch_threadattr_t *thd_attr = NULL;
+
+	switch_mutex_lock(globals.mutex);
+	globals.threads++;
+	globals.sql_thread_running = 1;
+	switch_mutex_unlock(globals.mutex);
+
+	switch_threadattr_create(&thd_attr, globals.pool);
+	switch_threadattr_detach_set(thd_attr, 1);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&thread, thd_attr, vm_sql_thread_run, NULL, globals.pool);
+}
+
+void *SWITCH_THREAD_FUNC vm_post_thread_run(switch_thread_t *thread, void *obj)
+{
+	void *pop;
+
+	while (globals.running == 1) {
+		if (switch_queue_pop_timeout(globals.post_queue, &pop, 500000) == SWITCH_STATUS_SUCCESS && pop) {
+			vm_post_job_run((vm_post_job_t *) pop);
+		}
+	}
+
+	while (switch_queue_trypop(globals.post_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		if (pop) {
+			vm_post_job_run((vm_post_job_t *) pop);
+		}
+	}
+
+	switch_mutex_lock(globals.mutex);
+	globals.post_threads_running--;
+	globals.threads--;
+	switch_mutex_unlock(globals.mutex);
+
+	return NULL;
+}
+
+static void vm_post_threads_start(void)
+{
+	switch_thread_t *thread;
+	switch_threadattr_t *thd_attr = NULL;
+	int i;
+
+	for (i = 0; i < globals.post_threads; i++) {
+		switch_mutex_lock(globals.mutex);
+		globals.threads++;
+		globals.post_threads_running++;
+		switch_mutex_unlock(globals.mutex);
+
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_detach_set(thd_attr, 1);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&thread, thd_attr, vm_post_thread_run, NULL, globals.pool);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Started %d post processing threads\n", globals.post_threads);
+}
+
 void vm_event_handler(switch_event_t *event)
 {
 	switch_event_t *cloned_event;
@@ -4009,6 +4468,7 @@ static void do_play(vm_profile_t *profile, char *user_in, char *domain, char *fi
 
 	vm_execute_sql(profile, sql, profile->mutex);
 	free(sql);
+	vm_index_forget(profile, user, domain);
 
 	sql = switch_mprintf("select * from voicemail_msgs where username='%s' and domain='%s' and file_path like '%%%s' order by created_epoch",
 						 user, domain, file);
@@ -4047,6 +4507,7 @@ static void do_del(vm_profile_t *profile, char *user_in, char *domain, char *fil
 	sql = switch_mprintf("delete from voicemail_msgs where username='%s' and domain='%s' and file_path like '%%%s'", user, domain, file);
 	vm_execute_sql(profile, sql, profile->mutex);
 	free(sql);
+	vm_index_forget(profile, user, domain);
 
 	update_mwi(profile, user, domain, myfolder);
 
@@ -4435,6 +4896,8 @@ SWITCH_STANDARD_API(voicemail_delete_api_function)
 
 		vm_execute_sql(profile, sql, profile->mutex);
 		switch_safe_free(sql);
+		/* a uuid may belong to any mailbox */
+		vm_index_forget(profile, uuid ? NULL : id, domain);
 		
 		update_mwi(profile, id, domain, "inbox");
 	
@@ -4517,6 +4980,7 @@ SWITCH_STANDARD_API(voicemail_read_api_function)
 
 		vm_execute_sql(profile, sql, profile->mutex);
 		switch_safe_free(sql);
+		vm_index_forget(profile, NULL, NULL);
 		
 		update_mwi(profile, id, domain, "inbox");
 	
@@ -4839,6 +5303,7 @@ static int message_purge_callback(void *pArg, int argc, char **argv, char **colu
 		sql = switch_mprintf("DELETE FROM voicemail_msgs WHERE username='%q' AND domain='%q' AND uuid = '%q'", id, domain, uuid);
 		vm_execute_sql(profile, sql, profile->mutex);
 		switch_safe_free(sql);
+		vm_index_forget(profile, id, domain);
 	}
 	profile_rwunlock(profile);
 
@@ -5878,11 +6343,17 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_voicemail_load)
 	switch_mutex_unlock(globals.mutex);
 
 	switch_queue_create(&globals.event_queue, VM_EVENT_QUEUE_SIZE, globals.pool);
+	switch_queue_create(&globals.sql_queue, VM_SQL_QUEUE_SIZE, globals.pool);
+	switch_queue_create(&globals.post_queue, VM_POST_QUEUE_SIZE, globals.pool);
+	globals.post_threads = 2;
 
 	if ((status = load_config()) != SWITCH_STATUS_SUCCESS) {
 		globals.running = 0;
 		return status;
 	}
+
+	vm_sql_thread_start();
+	vm_post_threads_start();
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
@@ -5960,9 +6431,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_voicemail_shutdown)
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Waiting for write lock (Profile %s)\n", profile->name);
 		switch_thread_rwlock_wrlock(profile->rwlock);
 
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Destroying Profile %s\n", profile->name);
-
-		switch_core_destroy_memory_pool(&profile->pool);
+		free_profile(profile);
 		profile = NULL;
 	}
 	switch_mutex_unlock(globals.mutex);
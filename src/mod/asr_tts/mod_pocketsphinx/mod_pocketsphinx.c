@@ -34,6 +34,7 @@
 #include <pocketsphinx.h>
 #include <sphinxbase/err.h>
 #include <sphinxbase/logmath.h>
+#include <sphinxbase/jsgf.h>
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_pocketsphinx_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_pocketsphinx_shutdown);
@@ -42,6 +43,15 @@ SWITCH_MODULE_DEFINITION(mod_pocketsphinx, mod_pocketsphinx_load, mod_pocketsphi
 static switch_mutex_t *MUTEX = NULL;
 static switch_event_node_t *NODE = NULL;
 
+/* A decoder kept warm after its handle closed, with the models loaded and the grammars it has compiled */
+typedef struct ps_idle_decoder {
+	ps_decoder_t *ps;
+	cmd_ln_t *config;
+	int rate;
+	uint32_t generation;
+	struct ps_idle_decoder *next;
+} ps_idle_decoder_t;
+
 static struct {
 	char *model8k;
 	char *model16k;
@@ -51,6 +61,11 @@ static struct {
 	uint32_t silence_hits;
 	uint32_t listen_hits;
 	int auto_reload;
+	uint32_t decoder_pool_size;
+	/* bumped on reload so decoders built from the old config are not reused */
+	uint32_t generation;
+	ps_idle_decoder_t *idle;
+	uint32_t idle_count;
 	switch_memory_pool_t *pool;
 } globals;
 
@@ -77,8 +92,146 @@ typedef struct {
 	int32_t confidence;
 	char const *uttid;
 	cmd_ln_t *config;
+	uint32_t generation;
 } pocketsphinx_t;
 
+/*! take a warm decoder for this rate off the idle list */
+static switch_bool_t decoder_lease(pocketsphinx_t *ps, int rate)
+{
+	ps_idle_decoder_t *cur, *last = NULL;
+
+	switch_mutex_lock(MUTEX);
+	for (cur = globals.idle; cur; last = cur, cur = cur->next) {
+		if (cur->rate == rate && cur->generation == globals.generation) {
+			if (last) {
+				last->next = cur->next;
+			} else {
+				globals.idle = cur->next;
+			}
+			globals.idle_count--;
+			break;
+		}
+	}
+	switch_mutex_unlock(MUTEX);
+
+	if (!cur) {
+		return SWITCH_FALSE;
+	}
+
+	ps->ps = cur->ps;
+	ps->config = cur->config;
+	ps->generation = cur->generation;
+	free(cur);
+
+	return SWITCH_TRUE;
+}
+
+/*! keep the decoder warm for the next handle, or free it if the idle list is full or the config changed */
+static void decoder_release(pocketsphinx_t *ps, int rate)
+{
+	ps_idle_decoder_t *idle = NULL;
+
+	switch_mutex_lock(MUTEX);
+	if (ps->generation == globals.generation && globals.idle_count < globals.decoder_pool_size) {
+		switch_zmalloc(idle, sizeof(*idle));
+		idle->ps = ps->ps;
+		idle->config = ps->config;
+		idle->rate = rate;
+		idle->generation = ps->generation;
+		idle->next = globals.idle;
+		globals.idle = idle;
+		globals.idle_count++;
+	}
+	switch_mutex_unlock(MUTEX);
+
+	if (!idle) {
+		ps_free(ps->ps);
+	}
+
+	ps->ps = NULL;
+	ps->config = NULL;
+}
+
+/*! free the idle decoders, all of them or only those built from an older config */
+static void decoder_flush(switch_bool_t all)
+{
+	ps_idle_decoder_t *cur, *next, *keep = NULL, *stale = NULL;
+
+	switch_mutex_lock(MUTEX);
+	for (cur = globals.idle; cur; cur = next) {
+		next = cur->next;
+		if (all || cur->generation != globals.generation) {
+			cur->next = stale;
+			stale = cur;
+			globals.idle_count--;
+		} else {
+			cur->next = keep;
+			keep = cur;
+		}
+	}
+	globals.idle = keep;
+	switch_mutex_unlock(MUTEX);
+
+	for (cur = stale; cur; cur = next) {
+		next = cur->next;
+		ps_free(cur->ps);
+		free(cur);
+	}
+}
+
+/*! switch a loaded decoder to a grammar, compiling it into the decoder's FSG set the first time it is used */
+static switch_bool_t decoder_select_grammar(pocketsphinx_t *ps, const char *jsgf_file)
+{
+	fsg_set_t *fsgs;
+
+	if (!(fsgs = ps_get_fsgset(ps->ps))) {
+		return SWITCH_FALSE;
+	}
+
+	if (!fsg_set_get_fsg(fsgs, jsgf_file)) {
+		jsgf_t *jsgf;
+		jsgf_rule_t *rule = NULL;
+		jsgf_rule_iter_t *itor;
+		fsg_model_t *fsg = NULL;
+
+		if (!(jsgf = jsgf_parse_file(jsgf_file, NULL))) {
+			return SWITCH_FALSE;
+		}
+
+		/* same as the decoder does for -jsgf, the first public rule is the grammar */
+		for (itor = jsgf_rule_iter(jsgf); itor; itor = jsgf_rule_iter_next(itor)) {
+			rule = jsgf_rule_iter_rule(itor);
+			if (jsgf_rule_public(rule)) {
+				jsgf_rule_iter_free(itor);
+				break;
+			}
+			rule = NULL;
+		}
+
+		if (rule) {
+			fsg = jsgf_build_fsg(jsgf, rule, ps_get_logmath(ps->ps), cmd_ln_float32_r(ps->config, "-lw"));
+		}
+		jsgf_grammar_free(jsgf);
+
+		if (!fsg) {
+			return SWITCH_FALSE;
+		}
+
+		if (!fsg_set_add(fsgs, jsgf_file, fsg)) {
+			fsg_model_free(fsg);
+			return SWITCH_FALSE;
+		}
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Compiled grammar %s\n", jsgf_file);
+	}
+
+	if (!fsg_set_select(fsgs, jsgf_file) || ps_update_fsgset(ps->ps) != fsgs) {
+		return SWITCH_FALSE;
+	}
+
+	return SWITCH_TRUE;
+}
+
 /*! function to open the asr interface */
 static switch_status_t pocketsphinx_asr_open(switch_asr_handle_t *ah, const char *codec, int rate, const char *dest, switch_asr_flag_t *flags)
 {
@@ -157,24 +310,33 @@ static switch_status_t pocketsphinx_asr_load_grammar(switch_asr_handle_t *ah, co
 
 	switch_assert(jsgf && dic && model);
 
-	ps->config = cmd_ln_init(ps->config, ps_args(), FALSE,
-							 "-samprate", rate,
-							 "-hmm", model, "-jsgf", jsgf, "-lw", globals.language_weight, "-dict", dic, "-frate", "50", "-silprob", "0.005", NULL);
-
-	if (ps->config == NULL) {
-		status = SWITCH_STATUS_GENERR;
-		goto end;
+	switch_mutex_lock(ps->flag_mutex);
+	if (!switch_test_flag(ps, PSFLAG_ALLOCATED) && decoder_lease(ps, ah->rate)) {
+		switch_set_flag(ps, PSFLAG_ALLOCATED);
 	}
 
-	switch_mutex_lock(ps->flag_mutex);
-	if (switch_test_flag(ps, PSFLAG_ALLOCATED)) {
-		ps_reinit(ps->ps, ps->config);
-	} else {
-		if (!(ps->ps = ps_init(ps->config))) {
+	/* a loaded decoder only has to switch grammars, reloading the models is the slow part */
+	if (!switch_test_flag(ps, PSFLAG_ALLOCATED) || !decoder_select_grammar(ps, jsgf)) {
+		ps->config = cmd_ln_init(ps->config, ps_args(), FALSE,
+								 "-samprate", rate,
+								 "-hmm", model, "-jsgf", jsgf, "-lw", globals.language_weight, "-dict", dic, "-frate", "50", "-silprob", "0.005", NULL);
+
+		if (ps->config == NULL) {
 			switch_mutex_unlock(ps->flag_mutex);
+			status = SWITCH_STATUS_GENERR;
 			goto end;
 		}
-		switch_set_flag(ps, PSFLAG_ALLOCATED);
+
+		if (switch_test_flag(ps, PSFLAG_ALLOCATED)) {
+			ps_reinit(ps->ps, ps->config);
+		} else {
+			if (!(ps->ps = ps_init(ps->config))) {
+				switch_mutex_unlock(ps->flag_mutex);
+				goto end;
+			}
+			ps->generation = globals.generation;
+			switch_set_flag(ps, PSFLAG_ALLOCATED);
+		}
 	}
 	switch_mutex_unlock(ps->flag_mutex);
 
@@ -211,8 +373,8 @@ static switch_status_t pocketsphinx_asr_close(switch_asr_handle_t *ah, switch_as
 		if (switch_test_flag(ps, PSFLAG_READY)) {
 			ps_end_utt(ps->ps);
 		}
-		ps_free(ps->ps);
-		ps->ps = NULL;
+		decoder_release(ps, ah->rate);
+		switch_clear_flag(ps, PSFLAG_ALLOCATED);
 	}
 	switch_safe_free(ps->grammar);
 	switch_mutex_unlock(ps->flag_mutex);
@@ -413,6 +575,7 @@ static switch_status_t load_config(void)
 	globals.silence_hits = 35;
 	globals.listen_hits = 1;
 	globals.auto_reload = 1;
+	globals.decoder_pool_size = 2;
 
 	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Open of %s failed\n", cf);
@@ -440,6 +603,9 @@ static switch_status_t load_config(void)
 				globals.model16k = switch_core_strdup(globals.pool, val);
 			} else if (!strcasecmp(var, "dictionary")) {
 				globals.dictionary = switch_core_strdup(globals.pool, val);
+			} else if (!strcasecmp(var, "decoder-pool-size")) {
+				int tmp = atoi(val);
+				globals.decoder_pool_size = tmp > 0 ? tmp : 0;
 			}
 		}
 	}
@@ -472,7 +638,11 @@ static void do_load(void)
 {
 	switch_mutex_lock(MUTEX);
 	load_config();
+	/* models, dictionary or grammars may have changed, start over with fresh decoders */
+	globals.generation++;
 	switch_mutex_unlock(MUTEX);
+
+	decoder_flush(SWITCH_FALSE);
 }
 
 static void event_handler(switch_event_t *event)
@@ -525,6 +695,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_pocketsphinx_load)
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_pocketsphinx_shutdown)
 {
 	switch_event_unbind(&NODE);
+	decoder_flush(SWITCH_TRUE);
 	return SWITCH_STATUS_UNLOAD;
 }
 
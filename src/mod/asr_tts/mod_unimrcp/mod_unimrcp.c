@@ -117,6 +117,10 @@ struct mod_unimrcp_globals {
 	int speech_channel_number;
 	/** the available profiles */
 	switch_hash_t *profiles;
+	/** true while the runtime thread maintains the idle session pools */
+	int running;
+	/** true until the runtime thread has exited */
+	int runtime_running;
 };
 typedef struct mod_unimrcp_globals mod_unimrcp_globals_t;
 
@@ -147,6 +151,21 @@ struct profile {
 	switch_hash_t *default_recog_params;
 	/** Default params to use for SPEAK requests */
 	switch_hash_t *default_synth_params;
+
+	/** max idle MRCP sessions kept open per resource for reuse, 0 tears every session down on close */
+	int session_pool_size;
+	/** sessions per resource to establish ahead of the first request */
+	int prestart_sessions;
+	/** seconds an idle session stays open before it is terminated */
+	int session_idle_timeout;
+	/** when to retry prestarting sessions after the server refused one */
+	switch_time_t prestart_retry;
+	/** synchronizes the idle lists */
+	switch_mutex_t *mutex;
+	/** idle sessions by speech_channel_type_t */
+	struct speech_channel *idle[2];
+	/** number of idle sessions by speech_channel_type_t */
+	int idle_count[2];
 };
 typedef struct profile profile_t;
 static switch_status_t profile_create(profile_t ** profile, const char *name, switch_memory_pool_t *pool);
@@ -181,7 +200,7 @@ static switch_xml_config_item_t instructions[] = {
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_unimrcp_shutdown);
 SWITCH_MODULE_RUNTIME_FUNCTION(mod_unimrcp_runtime);
 SWITCH_MODULE_LOAD_FUNCTION(mod_unimrcp_load);
-SWITCH_MODULE_DEFINITION(mod_unimrcp, mod_unimrcp_load, mod_unimrcp_shutdown, NULL);
+SWITCH_MODULE_DEFINITION(mod_unimrcp, mod_unimrcp_load, mod_unimrcp_shutdown, mod_unimrcp_runtime);
 
 static switch_status_t mod_unimrcp_do_config();
 static mrcp_client_t *mod_unimrcp_client_create(switch_memory_pool_t *mod_pool);
@@ -275,6 +294,12 @@ static switch_status_t audio_queue_destroy(audio_queue_t *queue);
 
 #define SPEECH_CHANNEL_TIMEOUT_USEC (5 * 1000000)
 
+/* defaults for the per-profile idle session pool */
+#define DEFAULT_SESSION_IDLE_TIMEOUT 60
+#define PRESTART_RETRY_USEC (30 * 1000000)
+/* rate prestarted sessions are opened with, only requests at this rate can use them */
+#define PRESTART_RATE 8000
+
 /**
  * Type of MRCP channel
  */
@@ -339,6 +364,16 @@ struct speech_channel {
 	switch_hash_t *params;
 	/** app specific data */
 	void *data;
+	/** private pool of a channel that may outlive its speech handle, NULL if the handle owns the channel */
+	switch_memory_pool_t *own_pool;
+	/** rate requested when the MRCP session was set up */
+	uint16_t requested_rate;
+	/** when the channel was put on its profile's idle list */
+	switch_time_t idle_since;
+	/** next channel on the idle list */
+	struct speech_channel *next;
+	/** name storage for pooled channels, the handle pool does not live long enough */
+	char name_buf[128];
 };
 typedef struct speech_channel speech_channel_t;
 
@@ -355,6 +390,13 @@ static switch_status_t speech_channel_create(speech_channel_t ** schannel, const
 static mpf_termination_t *speech_channel_create_mpf_termination(speech_channel_t *schannel);
 static switch_status_t speech_channel_open(speech_channel_t *schannel, profile_t *profile);
 static switch_status_t speech_channel_destroy(speech_channel_t *schannel);
+static switch_status_t speech_channel_create_pooled(speech_channel_t ** schannel, const char *name, speech_channel_type_t type,
+													mod_unimrcp_application_t *app, uint16_t rate);
+static speech_channel_t *speech_channel_lease(profile_t *profile, speech_channel_type_t type, uint16_t rate, const char *name, switch_memory_pool_t *pool);
+static void speech_channel_attach(speech_channel_t *schannel, switch_memory_pool_t *pool);
+static switch_status_t speech_channel_release(speech_channel_t *schannel);
+static void profile_sweep_sessions(profile_t *profile);
+static void profile_destroy_sessions(profile_t *profile);
 static switch_status_t speech_channel_stop(speech_channel_t *schannel);
 static switch_status_t speech_channel_set_param(speech_channel_t *schannel, const char *name, const char *val);
 static switch_status_t speech_channel_write(speech_channel_t *schannel, void *data, switch_size_t *len);
@@ -533,6 +575,8 @@ static switch_status_t profile_create(profile_t ** profile, const char *name, sw
 		lprofile->ssml_mime_type = "application/ssml+xml";
 		switch_core_hash_init(&lprofile->default_synth_params, pool);
 		switch_core_hash_init(&lprofile->default_recog_params, pool);
+		lprofile->session_idle_timeout = DEFAULT_SESSION_IDLE_TIMEOUT;
+		switch_mutex_init(&lprofile->mutex, SWITCH_MUTEX_UNNESTED, pool);
 		*profile = lprofile;
 
 		if (globals.enable_profile_events && switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, MY_EVENT_PROFILE_CREATE) == SWITCH_STATUS_SUCCESS) {
@@ -849,6 +893,10 @@ static switch_status_t speech_channel_create(speech_channel_t ** schannel, const
 	schan->rate = rate;
 	schan->silence = 0;			/* L16 silence sample */
 	schan->channel_opened = 0;
+	schan->own_pool = NULL;
+	schan->requested_rate = rate;
+	schan->idle_since = 0;
+	schan->next = NULL;
 
 	if (switch_mutex_init(&schan->mutex, SWITCH_MUTEX_UNNESTED, pool) != SWITCH_STATUS_SUCCESS ||
 		switch_thread_cond_create(&schan->cond, pool) != SWITCH_STATUS_SUCCESS ||
@@ -909,6 +957,165 @@ static switch_status_t speech_channel_destroy(speech_channel_t *schannel)
 		if (schannel->mutex) {
 			switch_mutex_unlock(schannel->mutex);
 		}
+
+		/* a pooled channel lives in its own pool, nothing may touch it past this point */
+		if (schannel->own_pool) {
+			switch_memory_pool_t *pool = schannel->own_pool;
+			switch_core_destroy_memory_pool(&pool);
+		}
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/**
+ * Create a speech channel that can be kept on its profile's idle list after its speech handle closes
+ *
+ * @param schannel the created channel
+ * @param name the name of the channel
+ * @param type the type of channel to create
+ * @param app the application
+ * @param rate the rate to use
+ * @return SWITCH_STATUS_SUCCESS if successful
+ */
+static switch_status_t speech_channel_create_pooled(speech_channel_t ** schannel, const char *name, speech_channel_type_t type,
+													mod_unimrcp_application_t *app, uint16_t rate)
+{
+	switch_memory_pool_t *pool = NULL;
+	speech_channel_t *schan = NULL;
+
+	*schannel = NULL;
+
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+	if (speech_channel_create(&schan, name, type, app, rate, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_core_destroy_memory_pool(&pool);
+		return SWITCH_STATUS_FALSE;
+	}
+	schan->own_pool = pool;
+	switch_copy_string(schan->name_buf, name, sizeof(schan->name_buf));
+	schan->name = schan->name_buf;
+
+	/* the recognizer stream is bound once per MRCP session, so its data has to live as long as the session */
+	if (type == SPEECH_CHANNEL_RECOGNIZER) {
+		schan->data = switch_core_alloc(pool, sizeof(recognizer_data_t));
+	}
+
+	*schannel = schan;
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/**
+ * Point a pooled channel's per-request allocations at a speech handle's pool
+ *
+ * @param schannel the pooled channel
+ * @param pool the speech handle's memory pool
+ */
+static void speech_channel_attach(speech_channel_t *schannel, switch_memory_pool_t *pool)
+{
+	switch_mutex_lock(schannel->mutex);
+	if (schannel->params) {
+		switch_core_hash_destroy(&schannel->params);
+	}
+	schannel->memory_pool = pool;
+	switch_core_hash_init(&schannel->params, pool);
+	audio_queue_clear(schannel->audio_queue);
+	switch_mutex_unlock(schannel->mutex);
+}
+
+/**
+ * Take a ready MRCP session off the profile's idle list
+ *
+ * @param profile the profile
+ * @param type the type of channel wanted
+ * @param rate the rate the speech handle was opened with
+ * @param name the name of the new speech handle (for logging)
+ * @param pool the speech handle's memory pool
+ * @return the channel, or NULL if none could be reused
+ */
+static speech_channel_t *speech_channel_lease(profile_t *profile, speech_channel_type_t type, uint16_t rate, const char *name, switch_memory_pool_t *pool)
+{
+	speech_channel_t *schannel = NULL;
+
+	while (profile->session_pool_size) {
+		speech_channel_t *cur, *last = NULL;
+
+		switch_mutex_lock(profile->mutex);
+		for (cur = profile->idle[type]; cur; last = cur, cur = cur->next) {
+			if (cur->requested_rate == rate) {
+				if (last) {
+					last->next = cur->next;
+				} else {
+					profile->idle[type] = cur->next;
+				}
+				cur->next = NULL;
+				profile->idle_count[type]--;
+				break;
+			}
+		}
+		switch_mutex_unlock(profile->mutex);
+
+		if (!(schannel = cur)) {
+			break;
+		}
+
+		/* the server may have dropped the session while it sat idle */
+		if (schannel->state == SPEECH_CHANNEL_READY) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "(%s) Reusing MRCP session for %s\n", schannel->name, name);
+			speech_channel_attach(schannel, pool);
+			break;
+		}
+
+		speech_channel_destroy(schannel);
+		schannel = NULL;
+	}
+
+	return schannel;
+}
+
+/**
+ * Done with the channel.  A pooled channel in a clean state is kept on its profile's idle list
+ * rather than tearing the MRCP session down; everything else is destroyed.
+ *
+ * @param schannel the channel
+ * @return SWITCH_STATUS_SUCCESS
+ */
+static switch_status_t speech_channel_release(speech_channel_t *schannel)
+{
+	profile_t *profile = schannel->profile;
+	int ready = 0, pooled = 0;
+
+	if (!schannel->own_pool || !profile) {
+		return speech_channel_destroy(schannel);
+	}
+
+	switch_mutex_lock(schannel->mutex);
+	if (schannel->state == SPEECH_CHANNEL_READY) {
+		ready = 1;
+		/* the params and anything else per-request were allocated from the handle's pool */
+		if (schannel->params) {
+			switch_core_hash_destroy(&schannel->params);
+		}
+		schannel->memory_pool = schannel->own_pool;
+		audio_queue_clear(schannel->audio_queue);
+	}
+	switch_mutex_unlock(schannel->mutex);
+
+	switch_mutex_lock(profile->mutex);
+	if (ready && globals.running && profile->idle_count[schannel->type] < profile->session_pool_size) {
+		schannel->idle_since = switch_micro_time_now();
+		schannel->next = profile->idle[schannel->type];
+		profile->idle[schannel->type] = schannel;
+		profile->idle_count[schannel->type]++;
+		pooled = 1;
+	}
+	switch_mutex_unlock(profile->mutex);
+
+	if (pooled) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "(%s) MRCP session kept for reuse\n", schannel->name);
+	} else {
+		speech_channel_destroy(schannel);
 	}
 
 	return SWITCH_STATUS_SUCCESS;
@@ -1585,14 +1792,6 @@ static switch_status_t synth_speech_open(switch_speech_handle_t *sh, const char
 		name = switch_core_sprintf(sh->memory_pool, "TTS-%d", speech_channel_number);
 	}
 
-	/* Allocate the channel */
-	if (speech_channel_create(&schannel, name, SPEECH_CHANNEL_SYNTHESIZER, &globals.synth, (uint16_t) rate, sh->memory_pool) != SWITCH_STATUS_SUCCESS) {
-		status = SWITCH_STATUS_FALSE;
-		goto done;
-	}
-	sh->private_info = schannel;
-
-	/* Open the channel */
 	if (zstr(profile_name)) {
 		profile_name = globals.unimrcp_default_synth_profile;
 	}
@@ -1602,8 +1801,32 @@ static switch_status_t synth_speech_open(switch_speech_handle_t *sh, const char
 		status = SWITCH_STATUS_FALSE;
 		goto done;
 	}
-	if ((status = speech_channel_open(schannel, profile)) != SWITCH_STATUS_SUCCESS) {
-		goto done;
+
+	/* Reuse an idle MRCP session or allocate a new channel */
+	if ((schannel = speech_channel_lease(profile, SPEECH_CHANNEL_SYNTHESIZER, (uint16_t) rate, name, sh->memory_pool))) {
+		sh->private_info = schannel;
+	} else {
+		if (profile->session_pool_size) {
+			if (speech_channel_create_pooled(&schannel, name, SPEECH_CHANNEL_SYNTHESIZER, &globals.synth, (uint16_t) rate) != SWITCH_STATUS_SUCCESS) {
+				status = SWITCH_STATUS_FALSE;
+				goto done;
+			}
+			speech_channel_attach(schannel, sh->memory_pool);
+		} else if (speech_channel_create(&schannel, name, SPEECH_CHANNEL_SYNTHESIZER, &globals.synth, (uint16_t) rate, sh->memory_pool) != SWITCH_STATUS_SUCCESS) {
+			status = SWITCH_STATUS_FALSE;
+			goto done;
+		}
+		sh->private_info = schannel;
+
+		/* Open the channel */
+		if ((status = speech_channel_open(schannel, profile)) != SWITCH_STATUS_SUCCESS) {
+			if (schannel->own_pool) {
+				/* close is never called for a handle that failed to open */
+				speech_channel_destroy(schannel);
+				sh->private_info = NULL;
+			}
+			goto done;
+		}
 	}
 
 	/* Set session TTS params */
@@ -1639,7 +1862,7 @@ static switch_status_t synth_speech_close(switch_speech_handle_t *sh, switch_spe
 {
 	speech_channel_t *schannel = (speech_channel_t *) sh->private_info;
 	speech_channel_stop(schannel);
-	speech_channel_destroy(schannel);
+	speech_channel_release(schannel);
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -2892,6 +3115,7 @@ static switch_status_t recog_asr_open(switch_asr_handle_t *ah, const char *codec
 	profile_t *profile = NULL;
 	recognizer_data_t *r = NULL;
 	switch_hash_index_t *hi = NULL;
+	int reused = 0;
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "asr_handle: name = %s, codec = %s, rate = %d, grammar = %s, param = %s\n",
 					  ah->name, ah->codec, ah->rate, ah->grammar, ah->param);
@@ -2909,19 +3133,6 @@ static switch_status_t recog_asr_open(switch_asr_handle_t *ah, const char *codec
 		name = switch_core_sprintf(ah->memory_pool, "ASR-%d", speech_channel_number);
 	}
 
-	/* Allocate the channel */
-	if (speech_channel_create(&schannel, name, SPEECH_CHANNEL_RECOGNIZER, &globals.recog, (uint16_t) rate, ah->memory_pool) != SWITCH_STATUS_SUCCESS) {
-		status = SWITCH_STATUS_FALSE;
-		goto done;
-	}
-	ah->private_info = schannel;
-	r = (recognizer_data_t *) switch_core_alloc(ah->memory_pool, sizeof(recognizer_data_t));
-	schannel->data = r;
-	memset(r, 0, sizeof(recognizer_data_t));
-	switch_core_hash_init(&r->grammars, ah->memory_pool);
-	switch_core_hash_init(&r->enabled_grammars, ah->memory_pool);
-
-	/* Open the channel */
 	if (zstr(profile_name)) {
 		profile_name = globals.unimrcp_default_recog_profile;
 	}
@@ -2931,7 +3142,46 @@ static switch_status_t recog_asr_open(switch_asr_handle_t *ah, const char *codec
 		status = SWITCH_STATUS_FALSE;
 		goto done;
 	}
-	if ((status = speech_channel_open(schannel, profile)) != SWITCH_STATUS_SUCCESS) {
+
+	/* Reuse an idle MRCP session or allocate a new channel */
+	if ((schannel = speech_channel_lease(profile, SPEECH_CHANNEL_RECOGNIZER, (uint16_t) rate, name, ah->memory_pool))) {
+		reused = 1;
+	} else if (profile->session_pool_size) {
+		if (speech_channel_create_pooled(&schannel, name, SPEECH_CHANNEL_RECOGNIZER, &globals.recog, (uint16_t) rate) != SWITCH_STATUS_SUCCESS) {
+			status = SWITCH_STATUS_FALSE;
+			goto done;
+		}
+		speech_channel_attach(schannel, ah->memory_pool);
+		memset(schannel->data, 0, sizeof(recognizer_data_t));
+	} else {
+		if (speech_channel_create(&schannel, name, SPEECH_CHANNEL_RECOGNIZER, &globals.recog, (uint16_t) rate, ah->memory_pool) != SWITCH_STATUS_SUCCESS) {
+			status = SWITCH_STATUS_FALSE;
+			goto done;
+		}
+		schannel->data = switch_core_alloc(ah->memory_pool, sizeof(recognizer_data_t));
+		memset(schannel->data, 0, sizeof(recognizer_data_t));
+	}
+	ah->private_info = schannel;
+
+	/* everything but the stream bound to the MRCP session starts over with each handle */
+	r = (recognizer_data_t *) schannel->data;
+	r->result = NULL;
+	r->start_of_input = 0;
+	r->timers_started = 0;
+	r->dtmf_generator = NULL;
+	r->dtmf_generator_active = 0;
+	switch_core_hash_init(&r->grammars, ah->memory_pool);
+	switch_core_hash_init(&r->enabled_grammars, ah->memory_pool);
+
+	/* Open the channel */
+	if (!reused && (status = speech_channel_open(schannel, profile)) != SWITCH_STATUS_SUCCESS) {
+		if (schannel->own_pool) {
+			/* close is never called for a handle that failed to open */
+			switch_core_hash_destroy(&r->grammars);
+			switch_core_hash_destroy(&r->enabled_grammars);
+			speech_channel_destroy(schannel);
+			ah->private_info = NULL;
+		}
 		goto done;
 	}
 
@@ -3183,9 +3433,10 @@ static switch_status_t recog_asr_close(switch_asr_handle_t *ah, switch_asr_flag_
 		if (r->dtmf_generator) {
 			r->dtmf_generator_active = 0;
 			mpf_dtmf_generator_destroy(r->dtmf_generator);
+			r->dtmf_generator = NULL;
 		}
 		switch_mutex_unlock(schannel->mutex);
-		speech_channel_destroy(schannel);
+		speech_channel_release(schannel);
 	}
 	/* this lets FreeSWITCH's speech_thread know the handle is closed */
 	switch_set_flag(ah, SWITCH_ASR_FLAG_CLOSED);
@@ -3729,6 +3980,21 @@ static int process_profile_config(profile_t *profile, const char *param, const c
 		profile->srgs_mime_type = switch_core_strdup(pool, val);
 	} else if (strcasecmp(param, "ssml-mime-type") == 0) {
 		profile->ssml_mime_type = switch_core_strdup(pool, val);
+	} else if (strcasecmp(param, "session-pool-size") == 0) {
+		profile->session_pool_size = zstr(val) ? 0 : atoi(val);
+		if (profile->session_pool_size < 0) {
+			profile->session_pool_size = 0;
+		}
+	} else if (strcasecmp(param, "prestart-sessions") == 0) {
+		profile->prestart_sessions = zstr(val) ? 0 : atoi(val);
+		if (profile->prestart_sessions < 0) {
+			profile->prestart_sessions = 0;
+		}
+	} else if (strcasecmp(param, "session-idle-timeout") == 0) {
+		profile->session_idle_timeout = zstr(val) ? 0 : atoi(val);
+		if (profile->session_idle_timeout <= 0) {
+			profile->session_idle_timeout = DEFAULT_SESSION_IDLE_TIMEOUT;
+		}
 	} else {
 		mine = 0;
 	}
@@ -4162,6 +4428,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_unimrcp_load)
 
 	/* Start the client stack */
 	mrcp_client_start(globals.mrcp_client);
+	globals.running = 1;
 
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
@@ -4173,6 +4440,19 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_unimrcp_load)
  */
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_unimrcp_shutdown)
 {
+	switch_hash_index_t *hi = NULL;
+
+	/* stop maintaining the idle sessions and tear them down while the client stack is still up */
+	globals.running = 0;
+	while (globals.runtime_running) {
+		switch_yield(100000);
+	}
+	for (hi = switch_hash_first(NULL, globals.profiles); hi; hi = switch_hash_next(hi)) {
+		void *val;
+		switch_hash_this(hi, NULL, NULL, &val);
+		profile_destroy_sessions((profile_t *) val);
+	}
+
 	synth_shutdown();
 	recog_shutdown();
 
@@ -4193,9 +4473,128 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_unimrcp_shutdown)
  */
 SWITCH_MODULE_RUNTIME_FUNCTION(mod_unimrcp_runtime)
 {
+	globals.runtime_running = 1;
+
+	/* expire idle sessions and keep the prestarted ones topped up */
+	while (globals.running) {
+		switch_hash_index_t *hi = NULL;
+		profile_t *profiles[128];
+		int count = 0, i;
+
+		/* the profile list is fixed after load, sweep outside the hash since opening a session blocks */
+		for (hi = switch_hash_first(NULL, globals.profiles); hi && count < 128; hi = switch_hash_next(hi)) {
+			void *val;
+			switch_hash_this(hi, NULL, NULL, &val);
+			profiles[count++] = (profile_t *) val;
+		}
+		for (i = 0; i < count && globals.running; i++) {
+			profile_sweep_sessions(profiles[i]);
+		}
+
+		switch_yield(1000000);
+	}
+
+	globals.runtime_running = 0;
 	return SWITCH_STATUS_TERM;
 }
 
+/**
+ * Terminate the profile's expired idle sessions and open sessions until prestart-sessions are idle
+ *
+ * @param profile the profile
+ */
+static void profile_sweep_sessions(profile_t *profile)
+{
+	switch_time_t now = switch_micro_time_now();
+	speech_channel_type_t type;
+
+	if (!profile->session_pool_size) {
+		return;
+	}
+
+	for (type = SPEECH_CHANNEL_SYNTHESIZER; type <= SPEECH_CHANNEL_RECOGNIZER; type++) {
+		speech_channel_t *expired = NULL, *cur, *next, *last = NULL;
+		int want;
+
+		/* sessions beyond the prestart count that have idled too long go away */
+		switch_mutex_lock(profile->mutex);
+		for (cur = profile->idle[type]; cur; cur = next) {
+			next = cur->next;
+			if (profile->idle_count[type] > profile->prestart_sessions &&
+				(cur->state != SPEECH_CHANNEL_READY || now - cur->idle_since > (switch_time_t) profile->session_idle_timeout * 1000000)) {
+				if (last) {
+					last->next = next;
+				} else {
+					profile->idle[type] = next;
+				}
+				profile->idle_count[type]--;
+				cur->next = expired;
+				expired = cur;
+			} else {
+				last = cur;
+			}
+		}
+		want = profile->prestart_sessions - profile->idle_count[type];
+		if (want > profile->session_pool_size - profile->idle_count[type]) {
+			want = profile->session_pool_size - profile->idle_count[type];
+		}
+		switch_mutex_unlock(profile->mutex);
+
+		for (cur = expired; cur; cur = next) {
+			next = cur->next;
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "(%s) Terminating idle MRCP session\n", cur->name);
+			speech_channel_destroy(cur);
+		}
+
+		while (want-- > 0 && globals.running && now >= profile->prestart_retry) {
+			speech_channel_t *schannel = NULL;
+			char name[128];
+
+			switch_snprintf(name, sizeof(name), "%s %s-%d", profile->name, type == SPEECH_CHANNEL_SYNTHESIZER ? "TTS" : "ASR", get_next_speech_channel_number());
+			if (speech_channel_create_pooled(&schannel, name, type, type == SPEECH_CHANNEL_SYNTHESIZER ? &globals.synth : &globals.recog,
+											 PRESTART_RATE) != SWITCH_STATUS_SUCCESS) {
+				break;
+			}
+			if (schannel->data) {
+				memset(schannel->data, 0, sizeof(recognizer_data_t));
+			}
+			if (speech_channel_open(schannel, profile) != SWITCH_STATUS_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "(%s) Failed to prestart MRCP session, retrying in %d seconds\n",
+								  schannel->name, PRESTART_RETRY_USEC / 1000000);
+				speech_channel_destroy(schannel);
+				profile->prestart_retry = switch_micro_time_now() + PRESTART_RETRY_USEC;
+				break;
+			}
+			speech_channel_release(schannel);
+		}
+	}
+}
+
+/**
+ * Terminate all of the profile's idle sessions
+ *
+ * @param profile the profile
+ */
+static void profile_destroy_sessions(profile_t *profile)
+{
+	speech_channel_type_t type;
+
+	for (type = SPEECH_CHANNEL_SYNTHESIZER; type <= SPEECH_CHANNEL_RECOGNIZER; type++) {
+		speech_channel_t *cur, *next;
+
+		switch_mutex_lock(profile->mutex);
+		cur = profile->idle[type];
+		profile->idle[type] = NULL;
+		profile->idle_count[type] = 0;
+		switch_mutex_unlock(profile->mutex);
+
+		for (; cur; cur = next) {
+			next = cur->next;
+			speech_channel_destroy(cur);
+		}
+	}
+}
+
 /**
  * Translate log level string to enum
  * @param level log level string
@@ -35,7 +35,8 @@
 #include <fcntl.h>
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_dialplan_xml_load);
-SWITCH_MODULE_DEFINITION(mod_dialplan_xml, mod_dialplan_xml_load, NULL, NULL);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_dialplan_xml_shutdown);
+SWITCH_MODULE_DEFINITION(mod_dialplan_xml, mod_dialplan_xml_load, mod_dialplan_xml_shutdown, NULL);
 
 typedef enum {
 	BREAK_ON_TRUE,
@@ -44,6 +45,635 @@ typedef enum {
 	BREAK_NEVER
 } break_t;
 
+/*
+ * The dialplan is compiled once per XML root: every attribute a call would read is looked up here, expressions
+ * that have nothing to expand are compiled to a regex up front, the ones that do are compiled to an expansion
+ * template and actions are split out of the tree.
+ * The static root is compiled on reloadxml and kept (holding a reference to that root) until the next one,
+ * dialplans coming from a binding like xml_curl get a throw-away program for the one context they are used for.
+ */
+
+typedef enum {
+	DP_FIELD_NONE,
+	DP_FIELD_EXPAND,
+	DP_FIELD_PROFILE
+} dp_field_type_t;
+
+typedef enum {
+	DP_REGEX_NONE,
+	DP_REGEX_ANY,
+	DP_REGEX_ALL,
+	DP_REGEX_XOR
+} dp_regex_rule_t;
+
+typedef struct {
+	switch_xml_t xml;			/* only for switch_xml_std_datetime_check() */
+	int has_time;
+	const char *field;
+	dp_field_type_t field_type;
+	switch_expand_template_t *field_tpl;	/* DP_FIELD_EXPAND */
+	const char *expression;
+	int expand;
+	switch_expand_template_t *expression_tpl;	/* set when expand is */
+	switch_regex_t *re;			/* set when the expression never changes */
+	int bad;					/* does not compile, never matches */
+} dp_match_t;
+
+typedef struct {
+	const char *application;
+	const char *data;
+	int loop_count;
+	int xinline;
+} dp_action_t;
+
+typedef struct {
+	dp_match_t match;
+	int nested;
+	break_t do_break_i;
+	const char *do_break_a;
+	dp_regex_rule_t regex_rule;
+	dp_match_t *regexes;
+	int regex_count;
+	dp_action_t *actions;
+	int action_count;
+	dp_action_t *anti_actions;
+	int anti_action_count;
+} dp_condition_t;
+
+typedef struct {
+	const char *name;
+	const char *cont;
+	dp_condition_t *conditions;
+	int condition_count;
+} dp_extension_t;
+
+/* extensions whose first condition is a literal anchored destination_number match, by that literal */
+typedef struct dp_index_entry {
+	int idx;
+	struct dp_index_entry *next;
+	struct dp_index_entry *tail;
+} dp_index_entry_t;
+
+typedef struct {
+	const char *name;
+	dp_extension_t *extensions;
+	int extension_count;
+	switch_hash_t *exact;
+	switch_hash_t *prefix;
+	int *always;				/* everything that could not be indexed, in order */
+	int always_count;
+	int indexed;
+} dp_context_t;
+
+typedef struct {
+	uint32_t contexts;
+	uint32_t extensions;
+	uint32_t conditions;
+	uint32_t matches;
+	uint32_t precompiled;
+	uint32_t expanded;
+	uint32_t bad;
+	uint32_t actions;
+	uint32_t indexed;
+} dp_compile_stats_t;
+
+typedef struct dp_program {
+	switch_memory_pool_t *pool;
+	switch_xml_t root;			/* reference held on the static root, NULL for a throw-away program */
+	switch_xml_t cfg;
+	switch_hash_t *contexts;
+	dp_context_t *context;		/* the one context of a throw-away program */
+	int precompile;
+	int refs;
+	switch_regex_t **res;
+	int re_count;
+	int re_size;
+	dp_compile_stats_t stats;
+	switch_time_t compiled;
+	switch_time_t compile_usec;
+} dp_program_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	switch_memory_pool_t *pool;
+	dp_program_t *program;
+	switch_event_node_t *reload_node;
+	uint64_t hits;
+	uint64_t transient;
+	uint64_t indexed_lookups;
+	uint64_t candidates;
+	uint64_t skipped;
+	uint32_t compiles;
+} globals;
+
+static const char *DP_TIME_ATTRS[] = {
+	"date-time", "year", "yday", "mon", "mday", "week", "mweek", "wday", "hour", "minute", "minute-of-day", "time-of-day", NULL
+};
+
+static void dp_program_add_re(dp_program_t *program, switch_regex_t *re)
+{
+	if (program->re_count == program->re_size) {
+		program->re_size = program->re_size ? program->re_size * 2 : 64;
+		program->res = realloc(program->res, program->re_size * sizeof(*program->res));
+		switch_assert(program->res);
+	}
+	program->res[program->re_count++] = re;
+}
+
+static void dp_compile_match(dp_program_t *program, dp_match_t *m, switch_xml_t xml, int precompile)
+{
+	switch_xml_t xexpression;
+	int i;
+
+	m->xml = xml;
+
+	for (i = 0; DP_TIME_ATTRS[i]; i++) {
+		if (switch_xml_attr(xml, DP_TIME_ATTRS[i])) {
+			m->has_time = 1;
+			break;
+		}
+	}
+
+	if ((m->field = switch_xml_attr(xml, "field"))) {
+		m->field_type = strchr(m->field, '$') ? DP_FIELD_EXPAND : DP_FIELD_PROFILE;
+		if (m->field_type == DP_FIELD_EXPAND) {
+			switch_expand_template_create(&m->field_tpl, m->field, program->pool);
+		}
+	}
+
+	if ((xexpression = switch_xml_child(xml, "expression"))) {
+		m->expression = switch_str_nil(xexpression->txt);
+	} else {
+		m->expression = switch_xml_attr_soft(xml, "expression");
+	}
+
+	m->expand = switch_string_var_check_const(m->expression) || switch_string_has_escaped_data(m->expression);
+
+	program->stats.matches++;
+
+	if (m->expand) {
+		switch_expand_template_create(&m->expression_tpl, m->expression, program->pool);
+		program->stats.expanded++;
+	} else if (precompile && m->field && program->precompile) {
+		if ((m->re = switch_regex_compile_expression(m->expression))) {
+			dp_program_add_re(program, m->re);
+			program->stats.precompiled++;
+		} else {
+			m->bad = 1;
+			program->stats.bad++;
+		}
+	}
+}
+
+static dp_action_t *dp_compile_actions(dp_program_t *program, switch_xml_t xcond, const char *tag, int *count)
+{
+	switch_xml_t xaction;
+	dp_action_t *actions;
+	int n = 0;
+
+	for (xaction = switch_xml_child(xcond, tag); xaction; xaction = xaction->next) {
+		n++;
+	}
+
+	if (!(*count = n)) {
+		return NULL;
+	}
+
+	actions = switch_core_alloc(program->pool, n * sizeof(*actions));
+
+	for (n = 0, xaction = switch_xml_child(xcond, tag); xaction; xaction = xaction->next, n++) {
+		const char *loop = switch_xml_attr(xaction, "loop");
+
+		actions[n].application = switch_xml_attr_soft(xaction, "application");
+		if (!zstr(xaction->txt)) {
+			actions[n].data = xaction->txt;
+		} else {
+			actions[n].data = switch_xml_attr_soft(xaction, "data");
+		}
+		actions[n].loop_count = loop ? atoi(loop) : 1;
+		actions[n].xinline = switch_true(switch_xml_attr_soft(xaction, "inline"));
+	}
+
+	program->stats.actions += *count;
+
+	return actions;
+}
+
+static void dp_compile_condition(dp_program_t *program, dp_condition_t *cond, switch_xml_t xcond)
+{
+	const char *do_break_a, *regex_rule;
+	switch_xml_t xregex;
+	int n = 0;
+
+	cond->nested = switch_xml_child(xcond, "condition") ? 1 : 0;
+	cond->do_break_i = BREAK_ON_FALSE;
+
+	if ((do_break_a = switch_xml_attr(xcond, "break"))) {
+		cond->do_break_a = do_break_a;
+		if (!strcasecmp(do_break_a, "on-true")) {
+			cond->do_break_i = BREAK_ON_TRUE;
+		} else if (!strcasecmp(do_break_a, "on-false")) {
+			cond->do_break_i = BREAK_ON_FALSE;
+		} else if (!strcasecmp(do_break_a, "always")) {
+			cond->do_break_i = BREAK_ALWAYS;
+		} else if (!strcasecmp(do_break_a, "never")) {
+			cond->do_break_i = BREAK_NEVER;
+		} else {
+			cond->do_break_a = NULL;
+		}
+	}
+
+	if ((regex_rule = switch_xml_attr(xcond, "regex"))) {
+		if (!strcasecmp(regex_rule, "all")) {
+			cond->regex_rule = DP_REGEX_ALL;
+		} else if (!strcasecmp(regex_rule, "xor")) {
+			cond->regex_rule = DP_REGEX_XOR;
+		} else {
+			cond->regex_rule = DP_REGEX_ANY;
+		}
+
+		for (xregex = switch_xml_child(xcond, "regex"); xregex; xregex = xregex->next) {
+			n++;
+		}
+
+		if ((cond->regex_count = n)) {
+			cond->regexes = switch_core_alloc(program->pool, n * sizeof(*cond->regexes));
+			for (n = 0, xregex = switch_xml_child(xcond, "regex"); xregex; xregex = xregex->next, n++) {
+				dp_compile_match(program, &cond->regexes[n], xregex, 1);
+			}
+		}
+	}
+
+	/* with regex= the condition only contributes its times and field */
+	dp_compile_match(program, &cond->match, xcond, cond->regex_rule == DP_REGEX_NONE);
+
+	cond->actions = dp_compile_actions(program, xcond, "action", &cond->action_count);
+	cond->anti_actions = dp_compile_actions(program, xcond, "anti-action", &cond->anti_action_count);
+
+	program->stats.conditions++;
+}
+
+static dp_context_t *dp_compile_context(dp_program_t *program, switch_xml_t xcontext)
+{
+	dp_context_t *context = switch_core_alloc(program->pool, sizeof(*context));
+	switch_xml_t xexten, xcond;
+	int n = 0, c;
+
+	context->name = switch_xml_attr_soft(xcontext, "name");
+
+	for (xexten = switch_xml_child(xcontext, "extension"); xexten; xexten = xexten->next) {
+		n++;
+	}
+
+	if ((context->extension_count = n)) {
+		context->extensions = switch_core_alloc(program->pool, n * sizeof(*context->extensions));
+	}
+
+	for (n = 0, xexten = switch_xml_child(xcontext, "extension"); xexten; xexten = xexten->next, n++) {
+		dp_extension_t *exten = &context->extensions[n];
+
+		exten->name = switch_xml_attr(xexten, "name");
+		exten->cont = switch_xml_attr(xexten, "continue");
+
+		for (c = 0, xcond = switch_xml_child(xexten, "condition"); xcond; xcond = xcond->next) {
+			c++;
+		}
+
+		if ((exten->condition_count = c)) {
+			exten->conditions = switch_core_alloc(program->pool, c * sizeof(*exten->conditions));
+			for (c = 0, xcond = switch_xml_child(xexten, "condition"); xcond; xcond = xcond->next, c++) {
+				dp_compile_condition(program, &exten->conditions[c], xcond);
+			}
+		}
+	}
+
+	program->stats.contexts++;
+	program->stats.extensions += context->extension_count;
+
+	return context;
+}
+
+/*
+ * An extension can be left out for a destination when its first condition is a plain regex on destination_number
+ * that cannot match it and nothing else happens on the way out: no times, no regex= list, no anti-actions and a
+ * break that stops there.  Its expression has to be ^ followed by literal characters and then $, a trailing
+ * pattern, or nothing, with no alternation anywhere, so the literal is an exact key or a prefix every match has.
+ */
+static switch_bool_t dp_index_key(dp_program_t *program, const char *expression, char **key, int *exact)
+{
+	const char *p;
+	char buf[256];
+	size_t len = 0;
+
+	if (*expression != '^' || strchr(expression, '|')) {
+		return SWITCH_FALSE;
+	}
+
+	for (p = expression + 1; *p && len < sizeof(buf) - 1; p++) {
+		if (*p == '\\' && *(p + 1) && !isalnum((unsigned char) *(p + 1))) {
+			buf[len++] = *++p;
+		} else if (isalnum((unsigned char) *p) || strchr("+#-_@,:/=%!~ ", *p)) {
+			buf[len++] = *p;
+		} else {
+			break;
+		}
+	}
+
+	if (*p == '?' || *p == '*' || *p == '{') {
+		/* the last literal is optional */
+		if (len) {
+			len--;
+		}
+		*exact = 0;
+	} else {
+		*exact = *p == '$' && !*(p + 1);
+	}
+
+	if (!len) {
+		return SWITCH_FALSE;
+	}
+
+	buf[len] = '\0';
+	*key = switch_core_strdup(program->pool, buf);
+
+	return SWITCH_TRUE;
+}
+
+static switch_bool_t dp_indexable(dp_extension_t *exten)
+{
+	dp_condition_t *cond;
+
+	if (!exten->condition_count) {
+		return SWITCH_FALSE;
+	}
+
+	cond = &exten->conditions[0];
+
+	return !cond->nested && cond->regex_rule == DP_REGEX_NONE && !cond->match.has_time && !cond->anti_action_count &&
+		(cond->do_break_i == BREAK_ON_FALSE || cond->do_break_i == BREAK_ALWAYS) &&
+		cond->match.field_type == DP_FIELD_PROFILE && !strcasecmp(cond->match.field, "destination_number") &&
+		!cond->match.expand && cond->match.re;
+}
+
+static void dp_index_add(dp_program_t *program, switch_hash_t *hash, const char *key, int idx)
+{
+	dp_index_entry_t *entry = switch_core_alloc(program->pool, sizeof(*entry)), *head;
+
+	entry->idx = idx;
+
+	if ((head = switch_core_hash_find(hash, key))) {
+		head->tail->next = entry;
+		head->tail = entry;
+	} else {
+		entry->tail = entry;
+		switch_core_hash_insert(hash, key, entry);
+	}
+}
+
+static void dp_index_context(dp_program_t *program, dp_context_t *context)
+{
+	int x;
+
+	switch_core_hash_init(&context->exact, program->pool);
+	switch_core_hash_init(&context->prefix, program->pool);
+	context->always = switch_core_alloc(program->pool, (context->extension_count + 1) * sizeof(int));
+
+	for (x = 0; x < context->extension_count; x++) {
+		dp_extension_t *exten = &context->extensions[x];
+		char *key = NULL;
+		int exact = 0;
+
+		if (dp_indexable(exten) && dp_index_key(program, exten->conditions[0].match.expression, &key, &exact)) {
+			dp_index_add(program, exact ? context->exact : context->prefix, key, x);
+			context->indexed++;
+		} else {
+			context->always[context->always_count++] = x;
+		}
+	}
+
+	program->stats.indexed += context->indexed;
+}
+
+static int dp_int_cmp(const void *a, const void *b)
+{
+	return *(const int *) a - *(const int *) b;
+}
+
+static void dp_index_collect(dp_index_entry_t *entry, int *list, int *count)
+{
+	for (; entry; entry = entry->next) {
+		list[(*count)++] = entry->idx;
+	}
+}
+
+/* the extensions worth running for dest in dialplan order, from first on; free() the result */
+static int *dp_index_candidates(dp_context_t *context, const char *dest, int first, int *count)
+{
+	int *list, n = 0, i, j;
+	size_t len = strlen(dest), l;
+	char *buf;
+
+	list = malloc((context->extension_count + 1) * sizeof(int));
+	switch_assert(list);
+
+	for (i = 0; i < context->always_count; i++) {
+		list[n++] = context->always[i];
+	}
+
+	buf = strdup(dest);
+	switch_assert(buf);
+
+	dp_index_collect(switch_core_hash_find(context->exact, dest), list, &n);
+
+	/* $ also matches in front of a trailing newline */
+	if (len && dest[len - 1] == '\n') {
+		buf[len - 1] = '\0';
+		dp_index_collect(switch_core_hash_find(context->exact, buf), list, &n);
+	}
+
+	for (l = len; l > 0; l--) {
+		buf[l] = '\0';
+		dp_index_collect(switch_core_hash_find(context->prefix, buf), list, &n);
+	}
+
+	free(buf);
+
+	qsort(list, n, sizeof(int), dp_int_cmp);
+
+	for (i = j = 0; i < n; i++) {
+		if (list[i] >= first) {
+			list[j++] = list[i];
+		}
+	}
+
+	*count = j;
+
+	return list;
+}
+
+/* root is a reference on the static root the program keeps, or NULL for a program used for one call against xcontext */
+static dp_program_t *dp_program_create(switch_xml_t root, switch_xml_t cfg, switch_xml_t xcontext)
+{
+	switch_memory_pool_t *pool;
+	dp_program_t *program;
+	switch_time_t start = switch_time_now();
+
+	switch_core_new_memory_pool(&pool);
+	program = switch_core_alloc(pool, sizeof(*program));
+	program->pool = pool;
+	program->root = root;
+	program->cfg = cfg;
+	program->refs = 1;
+	program->precompile = root ? 1 : 0;
+
+	if (root) {
+		switch_core_hash_init_case(&program->contexts, pool, SWITCH_FALSE);
+
+		for (xcontext = switch_xml_child(cfg, "context"); xcontext; xcontext = xcontext->next) {
+			const char *name = switch_xml_attr(xcontext, "name");
+
+			/* same as switch_xml_find_child(), the first context by that name wins */
+			if (name && !switch_core_hash_find(program->contexts, name)) {
+				dp_context_t *context = dp_compile_context(program, xcontext);
+
+				dp_index_context(program, context);
+				switch_core_hash_insert(program->contexts, name, context);
+			}
+		}
+	} else {
+		program->context = dp_compile_context(program, xcontext);
+	}
+
+	program->compiled = switch_time_now();
+	program->compile_usec = program->compiled - start;
+
+	return program;
+}
+
+static void dp_program_destroy(dp_program_t *program)
+{
+	switch_memory_pool_t *pool = program->pool;
+	int i;
+
+	for (i = 0; i < program->re_count; i++) {
+		switch_regex_safe_free(program->res[i]);
+	}
+	switch_safe_free(program->res);
+
+	if (program->contexts) {
+		switch_hash_index_t *hi;
+		void *val;
+
+		for (hi = switch_hash_first(NULL, program->contexts); hi; hi = switch_hash_next(hi)) {
+			dp_context_t *context;
+
+			switch_hash_this(hi, NULL, NULL, &val);
+			context = (dp_context_t *) val;
+
+			if (context->exact) {
+				switch_core_hash_destroy(&context->exact);
+			}
+			if (context->prefix) {
+				switch_core_hash_destroy(&context->prefix);
+			}
+		}
+
+		switch_core_hash_destroy(&program->contexts);
+	}
+
+	if (program->root) {
+		switch_xml_free(program->root);
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+}
+
+static void dp_program_release(dp_program_t *program)
+{
+	int last;
+
+	if (!program) {
+		return;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	last = !--program->refs;
+	switch_mutex_unlock(globals.mutex);
+
+	if (last) {
+		dp_program_destroy(program);
+	}
+}
+
+/* takes over the reference on root */
+static void dp_program_install(switch_xml_t root, switch_xml_t cfg)
+{
+	dp_program_t *program = dp_program_create(root, cfg, NULL), *old;
+
+	switch_mutex_lock(globals.mutex);
+	old = globals.program;
+	globals.program = program;
+	globals.compiles++;
+	switch_mutex_unlock(globals.mutex);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Compiled dialplan: %u contexts %u extensions %u conditions in %" SWITCH_TIME_T_FMT "us\n",
+					  program->stats.contexts, program->stats.extensions, program->stats.conditions, program->compile_usec);
+
+	dp_program_release(old);
+}
+
+static void dp_compile_root(void)
+{
+	switch_xml_t root = switch_xml_root(), section;
+
+	if ((section = switch_xml_find_child(root, "section", "name", "dialplan"))) {
+		dp_program_install(root, section);
+	} else {
+		switch_xml_free(root);
+	}
+}
+
+static void reload_event_handler(switch_event_t *event)
+{
+	dp_compile_root();
+}
+
+/* the compiled program for the root a lookup returned, NULL when it is not the static root */
+static dp_program_t *dp_program_get(switch_xml_t xml, switch_xml_t cfg)
+{
+	dp_program_t *program = NULL;
+	switch_xml_t root;
+
+	switch_mutex_lock(globals.mutex);
+	if (globals.program && globals.program->root == xml && globals.program->cfg == cfg) {
+		program = globals.program;
+		program->refs++;
+		globals.hits++;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	if (program) {
+		return program;
+	}
+
+	root = switch_xml_root();
+	if (root != xml) {
+		switch_xml_free(root);
+		return NULL;
+	}
+
+	/* reloadxml has not reached us yet */
+	dp_program_install(root, cfg);
+
+	switch_mutex_lock(globals.mutex);
+	if (globals.program && globals.program->root == xml && globals.program->cfg == cfg) {
+		program = globals.program;
+		program->refs++;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return program;
+}
 
 static switch_status_t exec_app(switch_core_session_t *session, const char *app, const char *arg)
 {
@@ -79,15 +709,70 @@ static switch_status_t exec_app(switch_core_session_t *session, const char *app,
 	return status;
 }
 
-static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *caller_profile, switch_xml_t xexten, switch_caller_extension_t **extension)
+static int dp_time_check(dp_match_t *m, int *offset)
+{
+	return m->has_time ? switch_xml_std_datetime_check(m->xml, offset) : -1;
+}
+
+static const char *dp_expression(switch_channel_t *channel, dp_match_t *m, char **expression_expanded)
+{
+	*expression_expanded = NULL;
+
+	if (m->expand && (*expression_expanded = switch_channel_expand_template(channel, m->expression_tpl)) == switch_expand_template_get_source(m->expression_tpl)) {
+		*expression_expanded = NULL;
+	}
+
+	return *expression_expanded ? *expression_expanded : m->expression;
+}
+
+static const char *dp_field_data(switch_channel_t *channel, switch_caller_profile_t *caller_profile, dp_match_t *m, char **field_expanded)
+{
+	const char *field_data = NULL;
+
+	*field_expanded = NULL;
+
+	if (m->field_type == DP_FIELD_EXPAND) {
+		if ((*field_expanded = switch_channel_expand_template(channel, m->field_tpl)) == switch_expand_template_get_source(m->field_tpl)) {
+			*field_expanded = NULL;
+			field_data = m->field;
+		} else {
+			field_data = *field_expanded;
+		}
+	} else {
+		field_data = switch_caller_get_field_by_name(caller_profile, m->field);
+	}
+
+	return field_data ? field_data : "";
+}
+
+/* the match count, the caller only needs ovector afterwards so nothing is handed back to free */
+static int dp_regex(dp_match_t *m, const char *field_data, const char *expression, int *ovector, uint32_t olen)
+{
+	switch_regex_t *re = NULL;
+	int proceed;
+
+	if (m->re) {
+		return switch_regex_exec(m->re, field_data, ovector, olen);
+	}
+
+	if (m->bad) {
+		return 0;
+	}
+
+	proceed = switch_regex_perform(field_data, expression, &re, ovector, olen);
+	switch_regex_safe_free(re);
+
+	return proceed;
+}
+
+static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *caller_profile, dp_extension_t *dexten, switch_caller_extension_t **extension)
 {
-	switch_xml_t xcond, xaction, xexpression, xregex;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
-	char *exten_name = (char *) switch_xml_attr(xexten, "name");
+	const char *exten_name = dexten->name;
 	int proceed = 0, save_proceed = 0;
 	char *expression_expanded = NULL, *field_expanded = NULL;
-	switch_regex_t *re = NULL, *save_re = NULL;
 	int offset = 0;
+	int c, i;
 	const char *tzoff = switch_channel_get_variable(channel, "tod_tz_offset");
 
 	if (!zstr(tzoff) && switch_is_number(tzoff)) {
@@ -100,43 +785,29 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 		exten_name = "_anon_";
 	}
 
-	for (xcond = switch_xml_child(xexten, "condition"); xcond; xcond = xcond->next) {
-		char *field = NULL;
-		char *do_break_a = NULL;
-		char *expression = NULL, *save_expression = NULL, *save_field_data = NULL;
-		char *regex_rule = NULL;
+	for (c = 0; c < dexten->condition_count; c++) {
+		dp_condition_t *cond = &dexten->conditions[c];
+		const char *field = NULL;
+		const char *do_break_a = cond->do_break_a;
+		const char *expression = NULL;
+		char *save_expression = NULL, *save_field_data = NULL;
 		const char *field_data = NULL;
 		int ovector[30];
+		int saved = 0;
 		switch_bool_t anti_action = SWITCH_TRUE;
-		break_t do_break_i = BREAK_ON_FALSE;
 
-		int time_match = switch_xml_std_datetime_check(xcond, tzoff ? &offset : NULL);
+		int time_match = dp_time_check(&cond->match, tzoff ? &offset : NULL);
 
 		switch_safe_free(field_expanded);
 		switch_safe_free(expression_expanded);
 
-		if (switch_xml_child(xcond, "condition")) {
+		if (cond->nested) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Nested conditions are not allowed!\n");
 			proceed = 1;
 			goto done;
 		}
 
-		field = (char *) switch_xml_attr(xcond, "field");
-
-
-		if ((do_break_a = (char *) switch_xml_attr(xcond, "break"))) {
-			if (!strcasecmp(do_break_a, "on-true")) {
-				do_break_i = BREAK_ON_TRUE;
-			} else if (!strcasecmp(do_break_a, "on-false")) {
-				do_break_i = BREAK_ON_FALSE;
-			} else if (!strcasecmp(do_break_a, "always")) {
-				do_break_i = BREAK_ALWAYS;
-			} else if (!strcasecmp(do_break_a, "never")) {
-				do_break_i = BREAK_NEVER;
-			} else {
-				do_break_a = NULL;
-			}
-		}
+		field = cond->match.field;
 
 		if (time_match == 1) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(session), SWITCH_LOG_DEBUG,
@@ -151,17 +822,22 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 		}
 		
 		
-		if ((regex_rule = (char *) switch_xml_attr(xcond, "regex"))) {
-			int all = !strcasecmp(regex_rule, "all");
-			int xor = !strcasecmp(regex_rule, "xor");
+		if (cond->regex_rule != DP_REGEX_NONE) {
+			int all = cond->regex_rule == DP_REGEX_ALL;
+			int xor = cond->regex_rule == DP_REGEX_XOR;
 			int pass = 0;
 			int fail = 0;
 			int total = 0;
 
 			switch_channel_del_variable_prefix(channel, "DP_REGEX_MATCH");
 
-			for (xregex = switch_xml_child(xcond, "regex"); xregex; xregex = xregex->next) {
-				time_match = switch_xml_std_datetime_check(xregex, tzoff ? &offset : NULL);
+			for (i = 0; i < cond->regex_count; i++) {
+				dp_match_t *m = &cond->regexes[i];
+
+				switch_safe_free(field_expanded);
+				switch_safe_free(expression_expanded);
+
+				time_match = dp_time_check(m, tzoff ? &offset : NULL);
 
 				if (time_match == 1) {
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(session), SWITCH_LOG_DEBUG,
@@ -174,39 +850,16 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 									  switch_channel_get_name(channel), exten_name);
 				}
 
-
-				if ((xexpression = switch_xml_child(xregex, "expression"))) {
-					expression = switch_str_nil(xexpression->txt);
-				} else {
-					expression = (char *) switch_xml_attr_soft(xregex, "expression");
-				}
-				
-				if ((expression_expanded = switch_channel_expand_variables(channel, expression)) == expression) {
-					expression_expanded = NULL;
-				} else {
-					expression = expression_expanded;
-				}
+				expression = dp_expression(channel, m, &expression_expanded);
 				
 				total++;
 				
-				field = (char *) switch_xml_attr(xregex, "field");
+				field = m->field;
 				
 				if (field) {
-					if (strchr(field, '$')) {
-						if ((field_expanded = switch_channel_expand_variables(channel, field)) == field) {
-							field_expanded = NULL;
-							field_data = field;
-						} else {
-							field_data = field_expanded;
-						}
-					} else {
-						field_data = switch_caller_get_field_by_name(caller_profile, field);
-					}
-					if (!field_data) {
-						field_data = "";
-					}
+					field_data = dp_field_data(channel, caller_profile, m, &field_expanded);
 					
-					if ((proceed = switch_regex_perform(field_data, expression, &re, ovector, sizeof(ovector) / sizeof(ovector[0])))) {
+					if ((proceed = dp_regex(m, field_data, expression, ovector, sizeof(ovector) / sizeof(ovector[0])))) {
 						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(session), SWITCH_LOG_DEBUG,
 										  "Dialplan: %s Regex (PASS) [%s] %s(%s) =~ /%s/ match=%s\n",
 										  switch_channel_get_name(channel), exten_name, field, field_data, expression, all ? "all" : "any");
@@ -236,26 +889,17 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 					switch_snprintf(var, sizeof(var), "DP_REGEX_MATCH_%d", total);
 
 					switch_channel_set_variable(channel, var, NULL);
-					switch_capture_regex(re, proceed, field_data, ovector, var, switch_regex_set_var_callback, session);
+					switch_capture_regex(NULL, proceed, field_data, ovector, var, switch_regex_set_var_callback, session);
 					
 					switch_safe_free(save_expression);
 					switch_safe_free(save_field_data);
-					switch_regex_safe_free(save_re);
-					
 					
 					save_expression = strdup(expression);
 					save_field_data = strdup(field_data);
-					save_re = re;
+					/* only a regex that matched is carried over to the actions */
+					saved = proceed > 0;
 					save_proceed = proceed;
-					
-					re = NULL;
 				}
-
-				switch_regex_safe_free(re);
-
-				switch_safe_free(field_expanded);
-				switch_safe_free(expression_expanded);
-				
 			}
 
 			if (xor) {
@@ -268,38 +912,13 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 				}
 			}
 
-			switch_safe_free(field_expanded);
-			switch_safe_free(expression_expanded);
-			
 		} else {
-			if ((xexpression = switch_xml_child(xcond, "expression"))) {
-				expression = switch_str_nil(xexpression->txt);
-			} else {
-				expression = (char *) switch_xml_attr_soft(xcond, "expression");
-			}
-
-			if ((expression_expanded = switch_channel_expand_variables(channel, expression)) == expression) {
-				expression_expanded = NULL;
-			} else {
-				expression = expression_expanded;
-			}
+			expression = dp_expression(channel, &cond->match, &expression_expanded);
 			
 			if (field) {
-				if (strchr(field, '$')) {
-					if ((field_expanded = switch_channel_expand_variables(channel, field)) == field) {
-						field_expanded = NULL;
-						field_data = field;
-					} else {
-						field_data = field_expanded;
-					}
-				} else {
-					field_data = switch_caller_get_field_by_name(caller_profile, field);
-				}
-				if (!field_data) {
-					field_data = "";
-				}
+				field_data = dp_field_data(channel, caller_profile, &cond->match, &field_expanded);
 
-				if ((proceed = switch_regex_perform(field_data, expression, &re, ovector, sizeof(ovector) / sizeof(ovector[0])))) {
+				if ((proceed = dp_regex(&cond->match, field_data, expression, ovector, sizeof(ovector) / sizeof(ovector[0])))) {
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(session), SWITCH_LOG_DEBUG,
 									  "Dialplan: %s Regex (PASS) [%s] %s(%s) =~ /%s/ break=%s\n",
 									  switch_channel_get_name(channel), exten_name, field, field_data, expression, do_break_a ? do_break_a : "on-false");
@@ -318,33 +937,25 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 
 		}
 
-		if (save_re) {
-			re = save_re;
-			save_re = NULL;
-			
+		if (saved) {
+			switch_safe_free(field_expanded);
+			switch_safe_free(expression_expanded);
+
 			expression = expression_expanded = save_expression;
 			save_expression = NULL;
 			field_data = field_expanded = save_field_data;
-			field = (char *) field_data;
+			field = field_data;
 			save_field_data = NULL;
 			proceed = save_proceed;
 		}
 
+		switch_safe_free(save_expression);
+		switch_safe_free(save_field_data);
 
 		if (anti_action) {
-			for (xaction = switch_xml_child(xcond, "anti-action"); xaction; xaction = xaction->next) {
-				const char *application = switch_xml_attr_soft(xaction, "application");
-				const char *loop = switch_xml_attr(xaction, "loop");
-				const char *data;
-				const char *inline_ = switch_xml_attr_soft(xaction, "inline");
-				int xinline = switch_true(inline_);
-				int loop_count = 1;
-
-				if (!zstr(xaction->txt)) {
-					data = xaction->txt;
-				} else {
-					data = (char *) switch_xml_attr_soft(xaction, "data");
-				}
+			for (i = 0; i < cond->anti_action_count; i++) {
+				dp_action_t *action = &cond->anti_actions[i];
+				int loop_count = action->loop_count;
 
 				if (!*extension) {
 					if ((*extension = switch_caller_extension_new(session, exten_name, caller_profile->destination_number)) == 0) {
@@ -354,54 +965,44 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 					}
 				}
 
-				if (loop) {
-					loop_count = atoi(loop);
-				}
-
 				for (;loop_count > 0; loop_count--) {
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(session), SWITCH_LOG_DEBUG,
-							"Dialplan: %s ANTI-Action %s(%s) %s\n", switch_channel_get_name(channel), application, data, xinline ? "INLINE" : "");
+							"Dialplan: %s ANTI-Action %s(%s) %s\n", switch_channel_get_name(channel), action->application, action->data,
+							action->xinline ? "INLINE" : "");
 
-					if (xinline) {
-						exec_app(session, application, data);
+					if (action->xinline) {
+						exec_app(session, action->application, action->data);
 					} else {
-						switch_caller_extension_add_application(session, *extension, application, data);
+						switch_caller_extension_add_application(session, *extension, action->application, action->data);
 					}
 				}
 				proceed = 1;
 			}
 		} else {
-			if (field && strchr(expression, '(')) {
+			int capture = field && expression && strchr(expression, '(');
+
+			if (capture) {
 				switch_channel_set_variable(channel, "DP_MATCH", NULL);
-				switch_capture_regex(re, proceed, field_data, ovector, "DP_MATCH", switch_regex_set_var_callback, session);
+				switch_capture_regex(NULL, proceed, field_data, ovector, "DP_MATCH", switch_regex_set_var_callback, session);
 			}
 
-			for (xaction = switch_xml_child(xcond, "action"); xaction; xaction = xaction->next) {
-				char *application = (char *) switch_xml_attr_soft(xaction, "application");
-				const char *loop = switch_xml_attr(xaction, "loop");
-				char *data = NULL;
+			for (i = 0; i < cond->action_count; i++) {
+				dp_action_t *action = &cond->actions[i];
+				const char *data = action->data;
 				char *substituted = NULL;
 				uint32_t len = 0;
-				char *app_data = NULL;
-				const char *inline_ = switch_xml_attr_soft(xaction, "inline");
-				int xinline = switch_true(inline_);
-				int loop_count = 1;
+				const char *app_data = NULL;
+				int loop_count = action->loop_count;
 
-				if (!zstr(xaction->txt)) {
-					data = xaction->txt;
-				} else {
-					data = (char *) switch_xml_attr_soft(xaction, "data");
-				}
-
-				if (field && strchr(expression, '(')) {
-					len = (uint32_t) (strlen(data) + strlen(field_data) + 10) * proceed;
+				if (capture) {
+					len = (uint32_t) (strlen(data) + strlen(field_data) + 10) * (proceed ? proceed : 1);
 					if (!(substituted = malloc(len))) {
 						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Memory Error!\n");
 						proceed = 0;
 						goto done;
 					}
 					memset(substituted, 0, len);
-					switch_perform_substitution(re, proceed, data, field_data, substituted, len, ovector);
+					switch_perform_substitution(NULL, proceed, data, field_data, substituted, len, ovector);
 					app_data = substituted;
 				} else {
 					app_data = data;
@@ -410,37 +1011,34 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 				if (!*extension) {
 					if ((*extension = switch_caller_extension_new(session, exten_name, caller_profile->destination_number)) == 0) {
 						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Memory Error!\n");
+						switch_safe_free(substituted);
 						proceed = 0;
 						goto done;
 					}
 				}
 
-				if (loop) {
-					loop_count = atoi(loop);
-				}
 				for (;loop_count > 0; loop_count--) {
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(session), SWITCH_LOG_DEBUG,
-							"Dialplan: %s Action %s(%s) %s\n", switch_channel_get_name(channel), application, app_data, xinline ? "INLINE" : "");
+							"Dialplan: %s Action %s(%s) %s\n", switch_channel_get_name(channel), action->application, app_data,
+							action->xinline ? "INLINE" : "");
 
-					if (xinline) {
-						exec_app(session, application, app_data);
+					if (action->xinline) {
+						exec_app(session, action->application, app_data);
 					} else {
-						switch_caller_extension_add_application(session, *extension, application, app_data);
+						switch_caller_extension_add_application(session, *extension, action->application, app_data);
 					}
 				}
 				switch_safe_free(substituted);
 			}
 		}
-		switch_regex_safe_free(re);
 
-		if (((anti_action == SWITCH_FALSE && do_break_i == BREAK_ON_TRUE) ||
-			 (anti_action == SWITCH_TRUE && do_break_i == BREAK_ON_FALSE)) || do_break_i == BREAK_ALWAYS) {
+		if (((anti_action == SWITCH_FALSE && cond->do_break_i == BREAK_ON_TRUE) ||
+			 (anti_action == SWITCH_TRUE && cond->do_break_i == BREAK_ON_FALSE)) || cond->do_break_i == BREAK_ALWAYS) {
 			break;
 		}
 	}
 
   done:
-	switch_regex_safe_free(re);
 	switch_safe_free(field_expanded);
 	switch_safe_free(expression_expanded);
 	return proceed;
@@ -467,9 +1065,12 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 {
 	switch_caller_extension_t *extension = NULL;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
-	switch_xml_t alt_root = NULL, cfg, xml = NULL, xcontext, xexten = NULL;
+	switch_xml_t alt_root = NULL, cfg, xml = NULL, xcontext = NULL;
+	dp_program_t *program = NULL;
+	dp_context_t *context = NULL;
 	char *alt_path = (char *) arg;
 	const char *hunt = NULL;
+	int x = 0, i, n = 0, *candidates = NULL;
 
 	if (!caller_profile) {
 		if (!(caller_profile = switch_channel_get_caller_profile(channel))) {
@@ -510,25 +1111,52 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 	}
 
 	/* get a handle to the context tag */
-	if (!(xcontext = switch_xml_find_child(cfg, "context", "name", caller_profile->context))) {
-		if (!(xcontext = switch_xml_find_child(cfg, "context", "name", "global"))) {
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Context %s not found\n", caller_profile->context);
-			goto done;
+	if ((program = dp_program_get(xml, cfg))) {
+		if (!(context = switch_core_hash_find(program->contexts, caller_profile->context))) {
+			context = switch_core_hash_find(program->contexts, "global");
 		}
+	} else if ((xcontext = switch_xml_find_child(cfg, "context", "name", caller_profile->context)) ||
+			   (xcontext = switch_xml_find_child(cfg, "context", "name", "global"))) {
+		program = dp_program_create(NULL, cfg, xcontext);
+		context = program->context;
+		switch_mutex_lock(globals.mutex);
+		globals.transient++;
+		switch_mutex_unlock(globals.mutex);
+	}
+
+	if (!context) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Context %s not found\n", caller_profile->context);
+		goto done;
 	}
 
 	if ((hunt = switch_channel_get_variable(channel, "auto_hunt")) && switch_true(hunt)) {
-		xexten = switch_xml_find_child(xcontext, "extension", "name", caller_profile->destination_number);
+		for (x = 0; x < context->extension_count; x++) {
+			if (context->extensions[x].name && !strcasecmp(context->extensions[x].name, caller_profile->destination_number)) {
+				break;
+			}
+		}
+
+		if (x == context->extension_count) {
+			x = 0;
+		}
 	}
 
-	if (!xexten) {
-		xexten = switch_xml_child(xcontext, "extension");
+	if (context->indexed && caller_profile->destination_number) {
+		candidates = dp_index_candidates(context, caller_profile->destination_number, x, &n);
+		switch_mutex_lock(globals.mutex);
+		globals.indexed_lookups++;
+		globals.candidates += n;
+		globals.skipped += context->extension_count - x - n;
+		switch_mutex_unlock(globals.mutex);
+	} else {
+		n = context->extension_count - x;
 	}
 
-	while (xexten) {
+	for (i = 0; i < n; i++) {
+		dp_extension_t *dexten = &context->extensions[candidates ? candidates[i] : x + i];
 		int proceed = 0;
-		const char *cont = switch_xml_attr(xexten, "continue");
-		const char *exten_name = switch_xml_attr(xexten, "name");
+		const char *cont = dexten->cont;
+		const char *exten_name = dexten->name;
 
 		if (!exten_name) {
 			exten_name = "UNKNOWN";
@@ -538,35 +1166,100 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 						  "Dialplan: %s parsing [%s->%s] continue=%s\n",
 						  switch_channel_get_name(channel), caller_profile->context, exten_name, cont ? cont : "false");
 
-		proceed = parse_exten(session, caller_profile, xexten, &extension);
+		proceed = parse_exten(session, caller_profile, dexten, &extension);
 
 		if (proceed && !switch_true(cont)) {
 			break;
 		}
-
-		xexten = xexten->next;
 	}
 
-	switch_xml_free(xml);
-	xml = NULL;
-
   done:
+	switch_safe_free(candidates);
+	/* the program may point into xml, it goes first */
+	dp_program_release(program);
 	switch_xml_free(xml);
 	return extension;
 }
 
+#define DP_STATS_SYNTAX "[compile]"
+SWITCH_STANDARD_API(dialplan_stats_function)
+{
+	dp_program_t *program;
+
+	if (!zstr(cmd) && !strcasecmp(cmd, "compile")) {
+		dp_compile_root();
+	}
+
+	switch_mutex_lock(globals.mutex);
+	if ((program = globals.program)) {
+		program->refs++;
+	}
+	stream->write_function(stream, "compiles: %u\nhits: %" SWITCH_UINT64_T_FMT "\nuncompiled-lookups: %" SWITCH_UINT64_T_FMT "\n",
+						   globals.compiles, globals.hits, globals.transient);
+	stream->write_function(stream, "indexed-lookups: %" SWITCH_UINT64_T_FMT "\ncandidates: %" SWITCH_UINT64_T_FMT "\nskipped: %" SWITCH_UINT64_T_FMT "\n",
+						   globals.indexed_lookups, globals.candidates, globals.skipped);
+	switch_mutex_unlock(globals.mutex);
+
+	if (!program) {
+		stream->write_function(stream, "program: none\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	stream->write_function(stream, "compile-time: %" SWITCH_TIME_T_FMT "us\n", program->compile_usec);
+	stream->write_function(stream, "compiled-age: %" SWITCH_TIME_T_FMT "s\n", (switch_time_now() - program->compiled) / 1000000);
+	stream->write_function(stream, "contexts: %u\nextensions: %u\nconditions: %u\nactions: %u\n",
+						   program->stats.contexts, program->stats.extensions, program->stats.conditions, program->stats.actions);
+	stream->write_function(stream, "expressions: %u\nprecompiled: %u\nexpanded-per-call: %u\ninvalid: %u\n",
+						   program->stats.matches, program->stats.precompiled, program->stats.expanded, program->stats.bad);
+	stream->write_function(stream, "indexed-extensions: %u\n", program->stats.indexed);
+
+	dp_program_release(program);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_dialplan_xml_load)
 {
 	switch_dialplan_interface_t *dp_interface;
+	switch_api_interface_t *api_interface;
+
+	memset(&globals, 0, sizeof(globals));
+	globals.pool = pool;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+
+	if (switch_event_bind_removable(modname, SWITCH_EVENT_RELOADXML, SWITCH_EVENT_SUBCLASS_ANY, reload_event_handler, NULL,
+									&globals.reload_node) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
+		return SWITCH_STATUS_GENERR;
+	}
+
+	dp_compile_root();
 
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 	SWITCH_ADD_DIALPLAN(dp_interface, "XML", dialplan_hunt);
+	SWITCH_ADD_API(api_interface, "dialplan_xml_stats", "XML dialplan compile stats", dialplan_stats_function, DP_STATS_SYNTAX);
 
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_dialplan_xml_shutdown)
+{
+	dp_program_t *program;
+
+	switch_event_unbind(&globals.reload_node);
+
+	switch_mutex_lock(globals.mutex);
+	program = globals.program;
+	globals.program = NULL;
+	switch_mutex_unlock(globals.mutex);
+
+	dp_program_release(program);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
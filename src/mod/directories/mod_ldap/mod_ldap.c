@@ -41,10 +41,29 @@
 #endif
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_ldap_load);
-SWITCH_MODULE_DEFINITION(mod_ldap, mod_ldap_load, NULL, NULL);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_ldap_shutdown);
+SWITCH_MODULE_DEFINITION(mod_ldap, mod_ldap_load, mod_ldap_shutdown, NULL);
+
+/* bound connections kept per server and bind dn between handles */
+#define MOD_LDAP_POOL_SIZE 8
+/* seconds a search may take before the connection is given up */
+#define MOD_LDAP_TIMEOUT 5
+
+typedef struct ldap_pool {
+	LDAP *idle[MOD_LDAP_POOL_SIZE];
+	int idle_count;
+} ldap_pool_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_hash_t *pools;
+} globals;
 
 struct ldap_context {
 	LDAP *ld;
+	ldap_pool_t *pool;
+	int failed;
 	LDAPMessage *msg;
 	LDAPMessage *entry;
 	BerElement *ber;
@@ -58,6 +77,26 @@ struct ldap_context {
 };
 
 
+/* The idle connections for one server bound as one dn, the password is part of the key so a changed one binds again */
+static ldap_pool_t *mod_ldap_find_pool(const char *source, const char *dsn, const char *passwd)
+{
+	ldap_pool_t *pool;
+	char *key = switch_mprintf("%s|%s|%s", switch_str_nil(source), switch_str_nil(dsn), switch_str_nil(passwd));
+
+	switch_assert(key);
+
+	switch_mutex_lock(globals.mutex);
+	if (!(pool = switch_core_hash_find(globals.pools, key))) {
+		pool = switch_core_alloc(globals.pool, sizeof(*pool));
+		switch_core_hash_insert(globals.pools, key, pool);
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	free(key);
+
+	return pool;
+}
+
 static switch_status_t mod_ldap_open(switch_directory_handle_t *dh, char *source, char *dsn, char *passwd)
 {
 	struct ldap_context *context;
@@ -68,16 +107,31 @@ static switch_status_t mod_ldap_open(switch_directory_handle_t *dh, char *source
 		return SWITCH_STATUS_MEMERR;
 	}
 
+	context->pool = mod_ldap_find_pool(source, dsn, passwd);
+
+	switch_mutex_lock(globals.mutex);
+	if (context->pool->idle_count) {
+		context->ld = context->pool->idle[--context->pool->idle_count];
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	if (context->ld) {
+		dh->private_info = context;
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	if ((context->ld = ldap_init(source, LDAP_PORT)) == NULL) {
 		return SWITCH_STATUS_FALSE;
 	}
 
 	/* set the LDAP version to be 3 */
 	if (ldap_set_option(context->ld, LDAP_OPT_PROTOCOL_VERSION, &desired_version) != LDAP_OPT_SUCCESS) {
+		ldap_unbind_s(context->ld);
 		return SWITCH_STATUS_FALSE;
 	}
 
 	if (ldap_bind_s(context->ld, dsn, passwd, auth_method) != LDAP_SUCCESS) {
+		ldap_unbind_s(context->ld);
 		return SWITCH_STATUS_FALSE;
 	}
 
@@ -89,11 +143,42 @@ static switch_status_t mod_ldap_open(switch_directory_handle_t *dh, char *source
 static switch_status_t mod_ldap_close(switch_directory_handle_t *dh)
 {
 	struct ldap_context *context;
+	LDAP *ld;
 
 	context = dh->private_info;
 	switch_assert(context != NULL);
 
-	ldap_unbind_s(context->ld);
+	if (context->vals) {
+		ldap_value_free(context->vals);
+		context->vals = NULL;
+	}
+
+	if (context->ber) {
+		ber_free(context->ber, 0);
+		context->ber = NULL;
+	}
+
+	if (context->msg) {
+		ldap_msgfree(context->msg);
+		context->msg = NULL;
+	}
+
+	ld = context->ld;
+	context->ld = NULL;
+
+	/* a connection that worked goes back for the next handle */
+	if (!context->failed) {
+		switch_mutex_lock(globals.mutex);
+		if (context->pool->idle_count < MOD_LDAP_POOL_SIZE) {
+			context->pool->idle[context->pool->idle_count++] = ld;
+			ld = NULL;
+		}
+		switch_mutex_unlock(globals.mutex);
+	}
+
+	if (ld) {
+		ldap_unbind_s(ld);
+	}
 
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -102,6 +187,12 @@ static switch_status_t mod_ldap_query(switch_directory_handle_t *dh, char *base,
 {
 	struct ldap_context *context;
 	char **attrs = NULL;
+#ifdef MSLDAP
+	struct l_timeval tv = { MOD_LDAP_TIMEOUT, 0 };
+#else
+	struct timeval tv = { MOD_LDAP_TIMEOUT, 0 };
+#endif
+	int rc;
 
 	context = dh->private_info;
 	switch_assert(context != NULL);
@@ -111,7 +202,18 @@ static switch_status_t mod_ldap_query(switch_directory_handle_t *dh, char *base,
 	__analysis_assume(attrs);
 #endif
 
-	if (ldap_search_s(context->ld, base, LDAP_SCOPE_SUBTREE, query, attrs, 0, &context->msg) != LDAP_SUCCESS) {
+	if (context->msg) {
+		ldap_msgfree(context->msg);
+		context->msg = NULL;
+	}
+	context->itt = 0;
+	context->entry = NULL;
+
+	if ((rc = ldap_search_ext_s(context->ld, base, LDAP_SCOPE_SUBTREE, query, attrs, 0, NULL, NULL, &tv, 0, &context->msg)) != LDAP_SUCCESS) {
+		/* nothing found leaves the connection as good as it was */
+		if (rc != LDAP_NO_SUCH_OBJECT) {
+			context->failed = 1;
+		}
 		return SWITCH_STATUS_FALSE;
 	}
 
@@ -209,6 +311,12 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_ldap_load)
 
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
+
+	memset(&globals, 0, sizeof(globals));
+	globals.pool = pool;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&globals.pools, pool);
+
 	dir_interface = switch_loadable_module_create_interface(*module_interface, SWITCH_DIRECTORY_INTERFACE);
 	dir_interface->interface_name = "ldap";
 	dir_interface->directory_open = mod_ldap_open;
@@ -221,6 +329,27 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_ldap_load)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_ldap_shutdown)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	ldap_pool_t *pool;
+
+	switch_mutex_lock(globals.mutex);
+	for (hi = switch_hash_first(NULL, globals.pools); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		pool = (ldap_pool_t *) val;
+		while (pool->idle_count) {
+			ldap_unbind_s(pool->idle[--pool->idle_count]);
+		}
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	switch_core_hash_destroy(&globals.pools);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
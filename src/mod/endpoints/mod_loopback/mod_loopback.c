@@ -55,7 +55,8 @@ typedef enum {
 	TFLAG_APP = (1 << 7),
 	TFLAG_RUNNING_APP = (1 << 8),
 	TFLAG_BOWOUT_USED = (1 << 9),
-	TFLAG_CLEAR = (1 << 10)
+	TFLAG_CLEAR = (1 << 10),
+	TFLAG_PASSTHRU = (1 << 11)
 } TFLAGS;
 
 struct private_object {
@@ -82,7 +83,11 @@ struct private_object {
 	switch_caller_profile_t *caller_profile;
 	int32_t bowout_frame_count;
 	char *other_uuid;
-	switch_queue_t *frame_queue;
+	/* frames written by the other leg, preallocated and swapped with write_frame on read */
+	switch_mutex_t *ring_mutex;
+	switch_frame_t *ring[FRAME_QUEUE_LEN];
+	uint32_t ring_head;
+	uint32_t ring_count;
 	int64_t packet_count;
 	int first_cng;
 };
@@ -110,13 +115,84 @@ static switch_status_t channel_kill_channel(switch_core_session_t *session, int
 
 static void clear_queue(private_t *tech_pvt)
 {
-	void *pop;
+	switch_mutex_lock(tech_pvt->ring_mutex);
+	tech_pvt->ring_head = 0;
+	tech_pvt->ring_count = 0;
+	switch_mutex_unlock(tech_pvt->ring_mutex);
+}
+
+static void ring_init(private_t *tech_pvt, switch_memory_pool_t *pool)
+{
+	int i;
+
+	switch_mutex_init(&tech_pvt->ring_mutex, SWITCH_MUTEX_NESTED, pool);
+
+	for (i = 0; i < FRAME_QUEUE_LEN; i++) {
+		tech_pvt->ring[i] = switch_core_alloc(pool, sizeof(switch_frame_t));
+		tech_pvt->ring[i]->data = switch_core_alloc(pool, SWITCH_RECOMMENDED_BUFFER_SIZE);
+		tech_pvt->ring[i]->buflen = SWITCH_RECOMMENDED_BUFFER_SIZE;
+	}
+
+	/* the slot the reader is holding, never touched by the writer */
+	tech_pvt->write_frame = switch_core_alloc(pool, sizeof(switch_frame_t));
+	tech_pvt->write_frame->data = tech_pvt->write_databuf;
+	tech_pvt->write_frame->buflen = sizeof(tech_pvt->write_databuf);
+}
+
+/* copy a frame into the other leg's ring, dropping the oldest one when it is full */
+static switch_status_t ring_push(private_t *tech_pvt, switch_frame_t *frame)
+{
+	switch_frame_t *slot;
+	void *data;
+	uint32_t buflen;
+
+	if (frame->datalen > SWITCH_RECOMMENDED_BUFFER_SIZE) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(tech_pvt->ring_mutex);
+
+	if (switch_test_flag(tech_pvt, TFLAG_PASSTHRU)) {
+		/* only the latest frame is kept so the reader gets it on its next tick */
+		tech_pvt->ring_head = 0;
+		tech_pvt->ring_count = 0;
+	} else if (tech_pvt->ring_count == FRAME_QUEUE_LEN) {
+		tech_pvt->ring_head = (tech_pvt->ring_head + 1) % FRAME_QUEUE_LEN;
+		tech_pvt->ring_count--;
+	}
+
+	slot = tech_pvt->ring[(tech_pvt->ring_head + tech_pvt->ring_count) % FRAME_QUEUE_LEN];
+	data = slot->data;
+	buflen = slot->buflen;
+	*slot = *frame;
+	slot->data = data;
+	slot->buflen = buflen;
+	slot->codec = NULL;
+	switch_clear_flag(slot, SFF_DYNAMIC);
+	memcpy(slot->data, frame->data, frame->datalen);
+	tech_pvt->ring_count++;
+
+	switch_mutex_unlock(tech_pvt->ring_mutex);
 
-	while (switch_queue_trypop(tech_pvt->frame_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
-		switch_frame_t *frame = (switch_frame_t *) pop;
-		switch_frame_free(&frame);
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* swap the oldest queued frame with the one the reader held last */
+static switch_frame_t *ring_pop(private_t *tech_pvt)
+{
+	switch_frame_t *frame = NULL;
+
+	switch_mutex_lock(tech_pvt->ring_mutex);
+	if (tech_pvt->ring_count) {
+		frame = tech_pvt->ring[tech_pvt->ring_head];
+		tech_pvt->ring[tech_pvt->ring_head] = tech_pvt->write_frame;
+		tech_pvt->write_frame = frame;
+		tech_pvt->ring_head = (tech_pvt->ring_head + 1) % FRAME_QUEUE_LEN;
+		tech_pvt->ring_count--;
 	}
+	switch_mutex_unlock(tech_pvt->ring_mutex);
 
+	return frame;
 }
 
 static switch_status_t tech_init(private_t *tech_pvt, switch_core_session_t *session, switch_codec_t *codec)
@@ -204,7 +280,7 @@ static switch_status_t tech_init(private_t *tech_pvt, switch_core_session_t *ses
 		switch_mutex_init(&tech_pvt->flag_mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session));
 		switch_mutex_init(&tech_pvt->mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session));
 		switch_core_session_set_private(session, tech_pvt);
-		switch_queue_create(&tech_pvt->frame_queue, FRAME_QUEUE_LEN, switch_core_session_get_pool(session));
+		ring_init(tech_pvt, switch_core_session_get_pool(session));
 		tech_pvt->session = session;
 		tech_pvt->channel = switch_core_session_get_channel(session);
 	}
@@ -321,6 +397,12 @@ static switch_status_t channel_on_init(switch_core_session_t *session)
 	}
 
 	switch_channel_set_variable(channel, "loopback_leg", switch_test_flag(tech_pvt, TFLAG_BLEG) ? "B" : "A");
+
+	if (switch_true(switch_channel_get_variable(channel, "loopback_passthrough"))) {
+		switch_set_flag_locked(tech_pvt, TFLAG_PASSTHRU);
+		switch_set_flag_locked(tech_pvt->other_tech_pvt, TFLAG_PASSTHRU);
+	}
+
 	switch_channel_set_state(channel, CS_ROUTING);
 
   end:
@@ -401,7 +483,6 @@ static switch_status_t channel_on_destroy(switch_core_session_t *session)
 {
 	switch_channel_t *channel = NULL;
 	private_t *tech_pvt = NULL;
-	void *pop;
 	switch_event_t *vars;
 
 	channel = switch_core_session_get_channel(session);
@@ -425,14 +506,6 @@ static switch_status_t channel_on_destroy(switch_core_session_t *session)
 			switch_core_codec_destroy(&tech_pvt->write_codec);
 		}
 
-		if (tech_pvt->write_frame) {
-			switch_frame_free(&tech_pvt->write_frame);
-		}
-
-		while (switch_queue_trypop(tech_pvt->frame_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
-			switch_frame_t *frame = (switch_frame_t *) pop;
-			switch_frame_free(&frame);
-		}
 	}
 
 
@@ -583,7 +656,6 @@ static switch_status_t channel_read_frame(switch_core_session_t *session, switch
 	private_t *tech_pvt = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	switch_mutex_t *mutex = NULL;
-	void *pop = NULL;
 
 	channel = switch_core_session_get_channel(session);
 	switch_assert(channel != NULL);
@@ -612,12 +684,7 @@ static switch_status_t channel_read_frame(switch_core_session_t *session, switch
 		switch_clear_flag(tech_pvt, TFLAG_CLEAR);
 	}
 
-	if (switch_queue_trypop(tech_pvt->frame_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
-		if (tech_pvt->write_frame) {
-			switch_frame_free(&tech_pvt->write_frame);
-		}
-		
-		tech_pvt->write_frame = (switch_frame_t *) pop;
+	if (ring_pop(tech_pvt)) {
 		tech_pvt->write_frame->codec = &tech_pvt->read_codec;
 		*frame = tech_pvt->write_frame;
 		tech_pvt->packet_count++;
@@ -769,8 +836,6 @@ static switch_status_t channel_write_frame(switch_core_session_t *session, switc
 	}
 
 	if (switch_test_flag(tech_pvt, TFLAG_LINKED) && tech_pvt->other_tech_pvt) {
-		switch_frame_t *clone;
-		
 		if (frame->codec->implementation != tech_pvt->write_codec.implementation) {
 			/* change codecs to match */
 			tech_init(tech_pvt, session, frame->codec);
@@ -778,19 +843,8 @@ static switch_status_t channel_write_frame(switch_core_session_t *session, switc
 		}
 
 
-		if (switch_frame_dup(frame, &clone) != SWITCH_STATUS_SUCCESS) {
-			abort();
-		}
-		
-		if ((status = switch_queue_trypush(tech_pvt->other_tech_pvt->frame_queue, clone)) != SWITCH_STATUS_SUCCESS) { 
-			clear_queue(tech_pvt->other_tech_pvt);
-			status = switch_queue_trypush(tech_pvt->other_tech_pvt->frame_queue, clone);
-		}
-
-		if (status == SWITCH_STATUS_SUCCESS) {
+		if (ring_push(tech_pvt->other_tech_pvt, frame) == SWITCH_STATUS_SUCCESS) {
 			switch_set_flag_locked(tech_pvt->other_tech_pvt, TFLAG_WRITE);
-		} else {
-			switch_frame_free(&clone);
 		}
 
 		status = SWITCH_STATUS_SUCCESS;
@@ -827,6 +827,8 @@ switch_status_t rtmp_session_destroy(rtmp_session_t **session)
 	switch_mutex_unlock((*session)->profile->mutex);
 	
 	switch_core_hash_destroy(&(*session)->session_hash);
+
+	switch_safe_free((*session)->out_buf);
 	
 	switch_core_destroy_memory_pool(&(*session)->pool);
 	
@@ -1278,6 +1280,7 @@ static switch_xml_config_item_t *get_instructions(rtmp_profile_t *profile) {
 						   "io module", "I/O module to use (if unsure use tcp)"),
 		SWITCH_CONFIG_ITEM("auth-calls", SWITCH_CONFIG_BOOL, CONFIG_RELOADABLE, &profile->auth_calls, SWITCH_FALSE, NULL, "true|false", "Set to true in order to reject unauthenticated calls"),
 		SWITCH_CONFIG_ITEM("chunksize", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &profile->chunksize, 128, &opt_chunksize, "", "RTMP Sending chunksize"),
+		SWITCH_CONFIG_ITEM("media-chunksize", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &profile->media_chunksize, 1024, &opt_chunksize, "", "RTMP Sending chunksize once a stream starts playing"),
 		SWITCH_CONFIG_ITEM("buffer-len", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &profile->buffer_len, 500, &opt_bufferlen, "", "Length of the receiving buffer to be used by the flash clients, in miliseconds"),
 		SWITCH_CONFIG_ITEM_END()
 	};
@@ -356,6 +356,7 @@ struct rtmp_profile {
 	const char *bind_address;	/* < Bind address */
 	const char *io_name;		/* < Name of I/O module (from config) */
 	int chunksize;				/* < Override default chunksize (from config) */
+	int media_chunksize;		/* < Outgoing chunksize once media starts playing (from config) */
 	int buffer_len;				/* < Receive buffer length the flash clients should use */ 
 	
 	switch_hash_t *reg_hash;	/* < Registration hashtable */
@@ -435,6 +436,12 @@ struct rtmp_session {
 	int hspos;
 	uint16_t in_chunksize;
 	uint16_t out_chunksize;
+
+	/* Outgoing wire buffer, chunked messages are assembled here and written out at once (under socket_mutex) */
+	unsigned char *out_buf;
+	switch_size_t out_buf_size;
+	switch_size_t out_buf_len;
+	int out_cork;
 	
 	/* Connect params */
 	const char *flashVer;
@@ -613,6 +620,13 @@ switch_status_t rtmp_send_notify_free(rtmp_session_t *rsession, uint8_t amfnumbe
 switch_status_t rtmp_send_invoke_v(rtmp_session_t *rsession, uint8_t amfnumber, uint8_t type, uint32_t timestamp, uint32_t stream_id, va_list list, switch_bool_t freethem);
 switch_status_t rtmp_send_message(rtmp_session_t *rsession, uint8_t amfnumber, uint32_t timestamp, uint8_t type, uint32_t stream_id, const unsigned char *message, switch_size_t len, uint32_t flags);
 
+/*!
+ * \brief Hold outgoing messages in the session's wire buffer until rtmp_uncork_output() so they go out in a single write
+ * \note Audio and video messages always flush whatever is pending
+ */
+void rtmp_cork_output(rtmp_session_t *rsession);
+switch_status_t rtmp_uncork_output(rtmp_session_t *rsession);
+
 void rtmp_send_event(rtmp_session_t *rsession, switch_event_t *event);
 void rtmp_notify_call_state(switch_core_session_t *session);
 void rtmp_send_display_update(switch_core_session_t *session);
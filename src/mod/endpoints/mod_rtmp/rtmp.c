@@ -171,7 +171,10 @@ void rtmp_handle_invoke(rtmp_session_t *rsession, int amfnumber)
 		command);
 
 	if ((function = (rtmp_invoke_function_t)(intptr_t)switch_core_hash_find(rtmp_globals.invoke_hash, command))) {
+		/* Replies to an invoke usually come in bursts, send them as one write */
+		rtmp_cork_output(rsession);
 		function(rsession, state, amfnumber, transaction_id, argc - 2, argv + 2);
+		rtmp_uncork_output(rsession);
 	} else {
 		switch_log_printf(SWITCH_CHANNEL_UUID_LOG(rsession->uuid), SWITCH_LOG_WARNING, "Unhandled invoke for \"%s\"\n",
 			command);
@@ -543,7 +546,56 @@ switch_status_t rtmp_send_invoke_v(rtmp_session_t *rsession, uint8_t amfnumber,
 	return rtmp_send_message(rsession, amfnumber, timestamp, type, stream_id, buf, helper.pos, 0);
 }
 
-/* Break message down into 128 bytes chunks, add the appropriate headers and send it out */
+static switch_status_t rtmp_flush_output(rtmp_session_t *rsession)
+{
+	switch_size_t len = rsession->out_buf_len;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	if (len > 0) {
+		status = rsession->profile->io->write(rsession, rsession->out_buf, &len);
+		rsession->out_buf_len = 0;
+	}
+
+	return status;
+}
+
+static void rtmp_output_append(rtmp_session_t *rsession, const unsigned char *data, switch_size_t len)
+{
+	if (rsession->out_buf_len + len > rsession->out_buf_size) {
+		switch_size_t size = rsession->out_buf_size ? rsession->out_buf_size : RTMP_TCP_READ_BUF;
+		while (size < rsession->out_buf_len + len) {
+			size *= 2;
+		}
+		rsession->out_buf = realloc(rsession->out_buf, size);
+		switch_assert(rsession->out_buf);
+		rsession->out_buf_size = size;
+	}
+	memcpy(rsession->out_buf + rsession->out_buf_len, data, len);
+	rsession->out_buf_len += len;
+	rsession->send += len;
+}
+
+void rtmp_cork_output(rtmp_session_t *rsession)
+{
+	switch_mutex_lock(rsession->socket_mutex);
+	rsession->out_cork++;
+	switch_mutex_unlock(rsession->socket_mutex);
+}
+
+switch_status_t rtmp_uncork_output(rtmp_session_t *rsession)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	switch_mutex_lock(rsession->socket_mutex);
+	if (rsession->out_cork > 0 && --rsession->out_cork == 0) {
+		status = rtmp_flush_output(rsession);
+	}
+	switch_mutex_unlock(rsession->socket_mutex);
+
+	return status;
+}
+
+/* Break message down into chunks, add the appropriate headers and write the whole thing out at once */
 switch_status_t rtmp_send_message(rtmp_session_t *rsession, uint8_t amfnumber, uint32_t timestamp, uint8_t type, uint32_t stream_id, const unsigned char *message, switch_size_t len, uint32_t flags)
 {
 	switch_size_t pos = 0;
@@ -631,38 +683,25 @@ switch_status_t rtmp_send_message(rtmp_session_t *rsession, uint8_t amfnumber, u
 
 	switch_mutex_lock(rsession->socket_mutex);
 	chunksize = (len - pos) < rsession->out_chunksize ? (len - pos) : rsession->out_chunksize;
-	if (rsession->profile->io->write(rsession, (unsigned char*)header, &hdrsize) != SWITCH_STATUS_SUCCESS) {
-		switch_goto_status(SWITCH_STATUS_FALSE, end);
-	}
-	rsession->send += hdrsize;
+	rtmp_output_append(rsession, header, hdrsize);
 	
-	/* Write one chunk of data */
-	if (rsession->profile->io->write(rsession, (unsigned char*)message, &chunksize) != SWITCH_STATUS_SUCCESS) {
-		switch_goto_status(SWITCH_STATUS_FALSE, end);
-	}
-	rsession->send += chunksize;
+	/* Append one chunk of data */
+	rtmp_output_append(rsession, message, chunksize);
 	pos += chunksize;
 	
-	/* Send more chunks if we need to */
+	/* Append more chunks if we need to */
 	while (((signed)len - (signed)pos) > 0) {
-		switch_mutex_unlock(rsession->socket_mutex);
-		/* Let other threads send data on the socket */
-		switch_mutex_lock(rsession->socket_mutex);
-		hdrsize = 1;
-		if (rsession->profile->io->write(rsession, (unsigned char*)&microhdr, &hdrsize) != SWITCH_STATUS_SUCCESS) {
-			switch_goto_status(SWITCH_STATUS_FALSE, end);
-		}
-		rsession->send += hdrsize;
+		rtmp_output_append(rsession, &microhdr, 1);
 		
 		chunksize = (len - pos) < rsession->out_chunksize ? (len - pos) : rsession->out_chunksize;
-				
-		if (rsession->profile->io->write(rsession, message + pos, &chunksize) != SWITCH_STATUS_SUCCESS) {
-			switch_goto_status(SWITCH_STATUS_FALSE, end);
-		}
-		rsession->send += chunksize;
+		rtmp_output_append(rsession, message + pos, chunksize);
 		pos += chunksize;
 	}
-end:
+
+	if (!rsession->out_cork || type == RTMP_TYPE_AUDIO || type == RTMP_TYPE_VIDEO) {
+		status = rtmp_flush_output(rsession);
+	}
+
 	switch_mutex_unlock(rsession->socket_mutex);
 	return status;
 }
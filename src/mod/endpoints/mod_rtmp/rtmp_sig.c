@@ -188,8 +188,8 @@ RTMP_INVOKE_FUNCTION(rtmp_i_play)
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Got play for %s on stream %d\n", switch_str_nil(amf0_get_string(argv[1])),
 		state->stream_id);
 
-	/* Set outgoing chunk size to 1024 bytes */
-	rtmp_set_chunksize(rsession, 1024);
+	/* Use a larger outgoing chunk size for media so each packet fits in a single chunk */
+	rtmp_set_chunksize(rsession, rsession->profile->media_chunksize);
 	
 	rsession->media_streamid = state->stream_id;
 
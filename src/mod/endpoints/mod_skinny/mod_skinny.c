@@ -93,6 +93,17 @@ static char buttons_sql[] =
 "   settings         VARCHAR(44)\n"
 ");\n";
 
+static char *indexes_sql[] = {
+	"CREATE INDEX skinny_devices_name ON skinny_devices (name, instance)",
+	"CREATE INDEX skinny_lines_device ON skinny_lines (device_name, device_instance)",
+	"CREATE INDEX skinny_lines_value ON skinny_lines (value)",
+	"CREATE INDEX skinny_buttons_device ON skinny_buttons (device_name, device_instance)",
+	"CREATE INDEX skinny_active_lines_device ON skinny_active_lines (device_name, device_instance, line_instance)",
+	"CREATE INDEX skinny_active_lines_uuid ON skinny_active_lines (channel_uuid)",
+	"CREATE INDEX skinny_active_lines_call_id ON skinny_active_lines (call_id)",
+	NULL
+};
+
 static char active_lines_sql[] =
 "CREATE TABLE skinny_active_lines (\n"
 "   device_name      VARCHAR(16),\n"
@@ -190,19 +201,40 @@ switch_status_t skinny_profile_find_listener_by_device_name(skinny_profile_t *pr
 
 switch_status_t skinny_profile_find_listener_by_device_name_and_instance(skinny_profile_t *profile, const char *device_name, uint32_t device_instance, listener_t **listener)
 {
+	char key[32];
 	listener_t *l;
 
+	switch_snprintf(key, sizeof(key), "%s:%d", device_name, device_instance);
+
 	switch_mutex_lock(profile->listener_mutex);
-	for (l = profile->listeners; l; l = l->next) {
-		if (!strcmp(l->device_name, device_name) && (l->device_instance == device_instance)) {
-			*listener = l;
-		}
+	if ((l = (listener_t *) switch_core_hash_find(profile->device_listener_hash, key))) {
+		*listener = l;
 	}
 	switch_mutex_unlock(profile->listener_mutex);
 
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* Claim the device for this listener, fails if another listener already has it */
+switch_status_t skinny_profile_register_listener(skinny_profile_t *profile, listener_t *listener, const char *device_name, uint32_t device_instance)
+{
+	char key[32];
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	switch_snprintf(key, sizeof(key), "%s:%d", device_name, device_instance);
+
+	switch_mutex_lock(profile->listener_mutex);
+	if (!switch_core_hash_find(profile->device_listener_hash, key)) {
+		switch_copy_string(listener->device_name, device_name, sizeof(listener->device_name));
+		listener->device_instance = device_instance;
+		switch_core_hash_insert(profile->device_listener_hash, key, listener);
+		status = SWITCH_STATUS_SUCCESS;
+	}
+	switch_mutex_unlock(profile->listener_mutex);
+
+	return status;
+}
+
 struct skinny_profile_find_session_uuid_helper {
 	skinny_profile_t *profile;
 	char *channel_uuid;
@@ -351,6 +383,33 @@ end:
 	return status;
 }
 
+switch_status_t skinny_execute_sql_trans(skinny_profile_t *profile, char *sql, switch_mutex_t *mutex)
+{
+	switch_cache_db_handle_t *dbh = NULL;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (mutex) {
+		switch_mutex_lock(mutex);
+	}
+
+	if (!(dbh = skinny_get_db_handle(profile))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening DB\n");
+		goto end;
+	}
+
+	status = switch_cache_db_persistant_execute_trans(dbh, sql, 1);
+
+end:
+
+	switch_cache_db_release_db_handle(&dbh);
+
+	if (mutex) {
+		switch_mutex_unlock(mutex);
+	}
+
+	return status;
+}
+
 switch_bool_t skinny_execute_sql_callback(skinny_profile_t *profile, switch_mutex_t *mutex, char *sql, switch_core_db_callback_func_t callback,
 		void *pdata)
 {
@@ -1244,65 +1303,45 @@ static void walk_listeners(skinny_listener_callback_func_t callback, void *pvt)
 	switch_mutex_unlock(globals.mutex);
 }
 
-static int flush_listener_callback(void *pArg, int argc, char **argv, char **columnNames)
-{
-	char *profile_name = argv[0];
-	char *value = argv[1];
-	char *domain_name = argv[2];
-	char *device_name = argv[3];
-	char *device_instance = argv[4];
-
-	char *token = switch_mprintf("skinny/%q/%q/%q:%q", profile_name, value, device_name, device_instance);
-	switch_core_del_registration(value, domain_name, token);
-	switch_safe_free(token);
-
-	return 0;
-}
-
 static void flush_listener(listener_t *listener)
 {
 
 	if(!zstr(listener->device_name)) {
 		skinny_profile_t *profile = listener->profile;
+		char key[32];
 		char *sql;
+		uint32_t i;
 
-		if ((sql = switch_mprintf(
-						"SELECT '%q', value, '%q', '%q', '%d' "
-						"FROM skinny_lines "
-						"WHERE device_name='%s' AND device_instance=%d "
-						"ORDER BY position",
-						profile->name, profile->domain, listener->device_name, listener->device_instance,
-						listener->device_name, listener->device_instance
-					 ))) {
-			skinny_execute_sql_callback(profile, profile->sql_mutex, sql, flush_listener_callback, NULL);
-			switch_safe_free(sql);
+		for (i = 0; i < listener->line_count; i++) {
+			char *token = switch_mprintf("skinny/%q/%q/%q:%d", profile->name, listener->lines[i].value,
+					listener->device_name, listener->device_instance);
+			switch_core_del_registration(listener->lines[i].value, profile->domain, token);
+			switch_safe_free(token);
 		}
 
 		if ((sql = switch_mprintf(
 						"DELETE FROM skinny_devices "
-						"WHERE name='%s' and instance=%d",
-						listener->device_name, listener->device_instance))) {
-			skinny_execute_sql(profile, sql, profile->sql_mutex);
-			switch_safe_free(sql);
-		}
-
-		if ((sql = switch_mprintf(
+						"WHERE name='%s' and instance=%d;\n"
 						"DELETE FROM skinny_lines "
-						"WHERE device_name='%s' and device_instance=%d",
-						listener->device_name, listener->device_instance))) {
-			skinny_execute_sql(profile, sql, profile->sql_mutex);
-			switch_safe_free(sql);
-		}
-
-		if ((sql = switch_mprintf(
+						"WHERE device_name='%s' and device_instance=%d;\n"
 						"DELETE FROM skinny_buttons "
-						"WHERE device_name='%s' and device_instance=%d",
+						"WHERE device_name='%s' and device_instance=%d;\n",
+						listener->device_name, listener->device_instance,
+						listener->device_name, listener->device_instance,
 						listener->device_name, listener->device_instance))) {
-			skinny_execute_sql(profile, sql, profile->sql_mutex);
+			skinny_execute_sql_trans(profile, sql, profile->sql_mutex);
 			switch_safe_free(sql);
 		}
 
+		switch_snprintf(key, sizeof(key), "%s:%d", listener->device_name, listener->device_instance);
+		switch_mutex_lock(profile->listener_mutex);
+		if (switch_core_hash_find(profile->device_listener_hash, key) == listener) {
+			switch_core_hash_delete(profile->device_listener_hash, key);
+		}
 		strcpy(listener->device_name, "");
+		listener->line_count = 0;
+		listener->button_count = 0;
+		switch_mutex_unlock(profile->listener_mutex);
 	}
 }
 
@@ -1773,6 +1812,7 @@ static switch_status_t load_skinny_config(void)
 				switch_core_db_t *db;
 				skinny_profile_t *profile = NULL;
 				switch_xml_t param;
+				int i;
 
 				if (switch_core_new_memory_pool(&profile_pool) != SWITCH_STATUS_SUCCESS) {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "OH OH no pool\n");
@@ -1786,6 +1826,7 @@ static switch_status_t load_skinny_config(void)
 				switch_mutex_init(&profile->listener_mutex, SWITCH_MUTEX_NESTED, profile->pool);
 				switch_mutex_init(&profile->sock_mutex, SWITCH_MUTEX_NESTED, profile->pool);
 				switch_mutex_init(&profile->flag_mutex, SWITCH_MUTEX_NESTED, profile->pool);
+				switch_core_hash_init(&profile->device_listener_hash, profile->pool);
 
 				for (param = switch_xml_child(xsettings, "param"); param; param = param->next) {
 					char *var = (char *) switch_xml_attr_soft(param, "name");
@@ -1930,12 +1971,19 @@ static switch_status_t load_skinny_config(void)
 					switch_odbc_handle_exec(profile->master_odbc, lines_sql, NULL, NULL);
 					switch_odbc_handle_exec(profile->master_odbc, buttons_sql, NULL, NULL);
 					switch_odbc_handle_exec(profile->master_odbc, active_lines_sql, NULL, NULL);
+					/* these fail harmlessly once the indexes exist */
+					for (i = 0; indexes_sql[i]; i++) {
+						switch_odbc_handle_exec(profile->master_odbc, indexes_sql[i], NULL, NULL);
+					}
 				} else {
 					if ((db = switch_core_db_open_file(profile->dbname))) {
 						switch_core_db_test_reactive(db, "SELECT headset FROM skinny_devices", "DROP TABLE skinny_devices", devices_sql);
 						switch_core_db_test_reactive(db, "SELECT * FROM skinny_lines", "DROP TABLE skinny_lines", lines_sql);
 						switch_core_db_test_reactive(db, "SELECT * FROM skinny_buttons", "DROP TABLE skinny_buttons", buttons_sql);
 						switch_core_db_test_reactive(db, "SELECT * FROM skinny_active_lines", "DROP TABLE skinny_active_lines", active_lines_sql);
+						for (i = 0; indexes_sql[i]; i++) {
+							switch_core_db_exec(db, indexes_sql[i], NULL, NULL, NULL);
+						}
 					} else {
 						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Cannot Open SQL Database!\n");
 						continue;
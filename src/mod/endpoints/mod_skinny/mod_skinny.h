@@ -104,6 +104,8 @@ struct skinny_profile {
 	struct listener *listeners;
 	int flags;
 	switch_mutex_t *flag_mutex;
+	/* registered listeners by "device_name:device_instance", under listener_mutex */
+	switch_hash_t *device_listener_hash;
 	/* call id */
 	uint32_t next_call_id;
 	/* others */
@@ -131,6 +133,19 @@ typedef enum {
 } listener_flag_t;
 
 #define SKINNY_MAX_LINES 42
+
+/* A line or button from the device's directory entry, kept with the listener and mirrored to skinny_lines/skinny_buttons */
+struct skinny_device_button {
+	uint32_t position;
+	uint32_t type;
+	uint32_t line_instance;
+	char *label;
+	char *value;
+	char *caller_name;
+	char *settings;
+};
+typedef struct skinny_device_button skinny_device_button_t;
+
 struct listener {
 	skinny_profile_t *profile;
 	char device_name[16];
@@ -140,6 +155,18 @@ struct listener {
 	char firmware_version[16];
 	char *soft_key_set_set;
 
+	/* registered device, mirrored to skinny_devices */
+	uint32_t device_user_id;
+	char device_ip[16];
+	uint32_t device_max_streams;
+	uint32_t device_port;
+	char *device_codec_string;
+	/* lines and other buttons, each sorted by position */
+	skinny_device_button_t lines[SKINNY_MAX_LINES];
+	uint32_t line_count;
+	skinny_device_button_t buttons[SKINNY_MAX_LINES];
+	uint32_t button_count;
+
 	switch_socket_t *sock;
 	switch_memory_pool_t *pool;
 	switch_thread_rwlock_t *rwlock;
@@ -218,6 +245,7 @@ skinny_profile_t *skinny_find_profile(const char *profile_name);
 switch_status_t skinny_profile_dump(const skinny_profile_t *profile, switch_stream_handle_t *stream);
 switch_status_t skinny_profile_find_listener_by_device_name(skinny_profile_t *profile, const char *device_name, listener_t **listener);
 switch_status_t skinny_profile_find_listener_by_device_name_and_instance(skinny_profile_t *profile, const char *device_name, uint32_t device_instance, listener_t **listener);
+switch_status_t skinny_profile_register_listener(skinny_profile_t *profile, listener_t *listener, const char *device_name, uint32_t device_instance);
 char * skinny_profile_find_session_uuid(skinny_profile_t *profile, listener_t *listener, uint32_t *line_instance_p, uint32_t call_id);
 #ifdef SWITCH_DEBUG_RWLOCKS
 switch_core_session_t * skinny_profile_perform_find_session(skinny_profile_t *profile, listener_t *listener, uint32_t *line_instance_p, uint32_t call_id, const char *file, const char *func, int line);
@@ -235,6 +263,7 @@ void profile_walk_listeners(skinny_profile_t *profile, skinny_listener_callback_
 /*****************************************************************************/
 switch_cache_db_handle_t *skinny_get_db_handle(skinny_profile_t *profile);
 switch_status_t skinny_execute_sql(skinny_profile_t *profile, char *sql, switch_mutex_t *mutex);
+switch_status_t skinny_execute_sql_trans(skinny_profile_t *profile, char *sql, switch_mutex_t *mutex);
 switch_bool_t skinny_execute_sql_callback(skinny_profile_t *profile,
 		switch_mutex_t *mutex, char *sql, switch_core_db_callback_func_t callback, void *pdata);
 
@@ -186,50 +186,25 @@ switch_status_t skinny_read_packet(listener_t *listener, skinny_message_t **req)
 }
 
 /*****************************************************************************/
-int skinny_device_event_callback(void *pArg, int argc, char **argv, char **columnNames)
-{
-	switch_event_t *event = (switch_event_t *) pArg;
-
-	char *profile_name = argv[0];
-	char *device_name = argv[1];
-	char *user_id = argv[2];
-	char *device_instance = argv[3];
-	char *ip = argv[4];
-	char *device_type = argv[5];
-	char *max_streams = argv[6];
-	char *port = argv[7];
-	char *codec_string = argv[8];
-
-	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Profile-Name", "%s", profile_name);
-	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Device-Name", "%s", device_name);
-	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Station-User-Id", "%s", user_id);
-	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Station-Instance", "%s", device_instance);
-	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-IP-Address", "%s", ip);
-	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Device-Type", "%s", device_type);
-	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Max-Streams", "%s", max_streams);
-	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Port", "%s", port);
-	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Codecs", "%s", codec_string);
-
-	return 0;
-}
-
 switch_status_t skinny_device_event(listener_t *listener, switch_event_t **ev, switch_event_types_t event_id, const char *subclass_name)
 {
 	switch_event_t *event = NULL;
-	char *sql;
 	skinny_profile_t *profile;
 	assert(listener->profile);
 	profile = listener->profile;
 
 	switch_event_create_subclass(&event, event_id, subclass_name);
 	switch_assert(event);
-	if ((sql = switch_mprintf("SELECT '%s', name, user_id, instance, ip, type, max_streams, port, codec_string "
-					"FROM skinny_devices "
-					"WHERE name='%s' AND instance=%d",
-					listener->profile->name,
-					listener->device_name, listener->device_instance))) {
-		skinny_execute_sql_callback(profile, profile->sql_mutex, sql, skinny_device_event_callback, event);
-		switch_safe_free(sql);
+	if (!zstr(listener->device_name)) {
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Profile-Name", "%s", profile->name);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Device-Name", "%s", listener->device_name);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Station-User-Id", "%d", listener->device_user_id);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Station-Instance", "%d", listener->device_instance);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-IP-Address", "%s", listener->device_ip);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Device-Type", "%d", listener->device_type);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Max-Streams", "%d", listener->device_max_streams);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Port", "%d", listener->device_port);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Skinny-Codecs", "%s", switch_str_nil(listener->device_codec_string));
 	}
 
 	*ev = event;
@@ -278,183 +253,99 @@ switch_status_t skinny_session_walk_lines_by_call_id(skinny_profile_t *profile,
 /*****************************************************************************/
 /* SKINNY BUTTONS */
 /*****************************************************************************/
-struct line_get_helper {
-	uint32_t pos;
-	struct line_stat_res_message *button;
-};
-
-int skinny_line_get_callback(void *pArg, int argc, char **argv, char **columnNames)
+/* Lines and buttons come from the listener's copy of the directory entry, see skinny_handle_register() */
+static skinny_device_button_t *skinny_button_nth(listener_t *listener, uint32_t instance, switch_bool_t features, uint32_t type)
 {
-	struct line_get_helper *helper = pArg;
+	uint32_t i, pos = 0;
 
-	helper->pos++;
-	if (helper->pos == atoi(argv[0])) { /* wanted_position */
-		helper->button->number = helper->pos;
-		strncpy(helper->button->name,  argv[2], 24); /* label */
-		strncpy(helper->button->shortname,  argv[3], 40); /* value */
-		strncpy(helper->button->displayname,  argv[4], 44); /* caller_name */
+	for (i = 0; i < listener->button_count; i++) {
+		uint32_t button_type = listener->buttons[i].type;
+		if (features ? (button_type == SKINNY_BUTTON_SPEED_DIAL || button_type == SKINNY_BUTTON_SERVICE_URL) : (button_type != type)) {
+			continue;
+		}
+		if (++pos == instance) {
+			return &listener->buttons[i];
+		}
 	}
-	return 0;
+	return NULL;
 }
 
 void skinny_line_get(listener_t *listener, uint32_t instance, struct line_stat_res_message **button)
 {
-	struct line_get_helper helper = {0};
-	char *sql;
+	struct line_stat_res_message *res;
 
 	switch_assert(listener);
 	switch_assert(listener->profile);
 	switch_assert(listener->device_name);
 
-	helper.button = switch_core_alloc(listener->pool, sizeof(struct line_stat_res_message));
-
-	if ((sql = switch_mprintf(
-					"SELECT '%d' AS wanted_position, position, label, value, caller_name "
-					"FROM skinny_lines "
-					"WHERE device_name='%s' AND device_instance=%d "
-					"ORDER BY position",
-					instance,
-					listener->device_name, listener->device_instance
-				 ))) {
-		skinny_execute_sql_callback(listener->profile, listener->profile->sql_mutex, sql, skinny_line_get_callback, &helper);
-		switch_safe_free(sql);
-	}
-	*button = helper.button;
-}
-
-struct speed_dial_get_helper {
-	uint32_t pos;
-	struct speed_dial_stat_res_message *button;
-};
+	res = switch_core_alloc(listener->pool, sizeof(struct line_stat_res_message));
 
-int skinny_speed_dial_get_callback(void *pArg, int argc, char **argv, char **columnNames)
-{
-	struct speed_dial_get_helper *helper = pArg;
-
-	helper->pos++;
-	if (helper->pos == atoi(argv[0])) { /* wanted_position */
-		helper->button->number = helper->pos; /* value */
-		strncpy(helper->button->line,  argv[3], 24); /* value */
-		strncpy(helper->button->label,  argv[2], 40); /* label */
+	if (instance > 0 && instance <= listener->line_count) {
+		skinny_device_button_t *line = &listener->lines[instance - 1];
+		res->number = instance;
+		strncpy(res->name, line->label, 24);
+		strncpy(res->shortname, line->value, 40);
+		strncpy(res->displayname, line->caller_name, 44);
 	}
-	return 0;
+	*button = res;
 }
 
 void skinny_speed_dial_get(listener_t *listener, uint32_t instance, struct speed_dial_stat_res_message **button)
 {
-	struct speed_dial_get_helper helper = {0};
-	char *sql;
+	struct speed_dial_stat_res_message *res;
+	skinny_device_button_t *b;
 
 	switch_assert(listener);
 	switch_assert(listener->profile);
 	switch_assert(listener->device_name);
 
-	helper.button = switch_core_alloc(listener->pool, sizeof(struct speed_dial_stat_res_message));
+	res = switch_core_alloc(listener->pool, sizeof(struct speed_dial_stat_res_message));
 
-	if ((sql = switch_mprintf(
-					"SELECT '%d' AS wanted_position, position, label, value, settings "
-					"FROM skinny_buttons "
-					"WHERE device_name='%s' AND device_instance=%d AND type=%d "
-					"ORDER BY position",
-					instance,
-					listener->device_name, listener->device_instance,
-					SKINNY_BUTTON_SPEED_DIAL
-				 ))) {
-		skinny_execute_sql_callback(listener->profile, listener->profile->sql_mutex, sql, skinny_speed_dial_get_callback, &helper);
-		switch_safe_free(sql);
-	}
-	*button = helper.button;
-}
-
-struct service_url_get_helper {
-	uint32_t pos;
-	struct service_url_stat_res_message *button;
-};
-
-int skinny_service_url_get_callback(void *pArg, int argc, char **argv, char **columnNames)
-{
-	struct service_url_get_helper *helper = pArg;
-
-	helper->pos++;
-	if (helper->pos == atoi(argv[0])) { /* wanted_position */
-		helper->button->index = helper->pos;
-		strncpy(helper->button->url, argv[3], 256); /* value */
-		strncpy(helper->button->display_name,  argv[2], 40); /* label */
+	if ((b = skinny_button_nth(listener, instance, SWITCH_FALSE, SKINNY_BUTTON_SPEED_DIAL))) {
+		res->number = instance;
+		strncpy(res->line, b->value, 24);
+		strncpy(res->label, b->label, 40);
 	}
-	return 0;
+	*button = res;
 }
 
 void skinny_service_url_get(listener_t *listener, uint32_t instance, struct service_url_stat_res_message **button)
 {
-	struct service_url_get_helper helper = {0};
-	char *sql;
+	struct service_url_stat_res_message *res;
+	skinny_device_button_t *b;
 
 	switch_assert(listener);
 	switch_assert(listener->profile);
 	switch_assert(listener->device_name);
 
-	helper.button = switch_core_alloc(listener->pool, sizeof(struct service_url_stat_res_message));
-
-	if ((sql = switch_mprintf(
-					"SELECT '%d' AS wanted_position, position, label, value, settings "
-					"FROM skinny_buttons "
-					"WHERE device_name='%s' AND device_instance=%d AND type=%d "
-					"ORDER BY position",
-					instance,
-					listener->device_name,
-					listener->device_instance,
-					SKINNY_BUTTON_SERVICE_URL
-				 ))) {
-		skinny_execute_sql_callback(listener->profile, listener->profile->sql_mutex, sql, skinny_service_url_get_callback, &helper);
-		switch_safe_free(sql);
-	}
-	*button = helper.button;
-}
-
-struct feature_get_helper {
-	uint32_t pos;
-	struct feature_stat_res_message *button;
-};
+	res = switch_core_alloc(listener->pool, sizeof(struct service_url_stat_res_message));
 
-int skinny_feature_get_callback(void *pArg, int argc, char **argv, char **columnNames)
-{
-	struct feature_get_helper *helper = pArg;
-
-	helper->pos++;
-	if (helper->pos == atoi(argv[0])) { /* wanted_position */
-		helper->button->index = helper->pos;
-		helper->button->id = helper->pos;
-		strncpy(helper->button->text_label,  argv[2], 40); /* label */
-		helper->button->status = atoi(argv[3]); /* value */
+	if ((b = skinny_button_nth(listener, instance, SWITCH_FALSE, SKINNY_BUTTON_SERVICE_URL))) {
+		res->index = instance;
+		strncpy(res->url, b->value, 256);
+		strncpy(res->display_name, b->label, 40);
 	}
-	return 0;
+	*button = res;
 }
 
 void skinny_feature_get(listener_t *listener, uint32_t instance, struct feature_stat_res_message **button)
 {
-	struct feature_get_helper helper = {0};
-	char *sql;
+	struct feature_stat_res_message *res;
+	skinny_device_button_t *b;
 
 	switch_assert(listener);
 	switch_assert(listener->profile);
 	switch_assert(listener->device_name);
 
-	helper.button = switch_core_alloc(listener->pool, sizeof(struct feature_stat_res_message));
+	res = switch_core_alloc(listener->pool, sizeof(struct feature_stat_res_message));
 
-	if ((sql = switch_mprintf(
-					"SELECT '%d' AS wanted_position, position, label, value, settings "
-					"FROM skinny_buttons "
-					"WHERE device_name='%s' AND device_instance=%d AND NOT (type=%d OR type=%d) "
-					"ORDER BY position",
-					instance,
-					listener->device_name,
-					listener->device_instance,
-					SKINNY_BUTTON_SPEED_DIAL, SKINNY_BUTTON_SERVICE_URL
-				 ))) {
-		skinny_execute_sql_callback(listener->profile, listener->profile->sql_mutex, sql, skinny_feature_get_callback, &helper);
-		switch_safe_free(sql);
+	if ((b = skinny_button_nth(listener, instance, SWITCH_TRUE, 0))) {
+		res->index = instance;
+		res->id = instance;
+		strncpy(res->text_label, b->label, 40);
+		res->status = atoi(b->value);
 	}
-	*button = helper.button;
+	*button = res;
 }
 
 /*****************************************************************************/
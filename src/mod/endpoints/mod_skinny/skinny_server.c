@@ -915,6 +915,27 @@ switch_status_t skinny_handle_keep_alive_message(listener_t *listener, skinny_me
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static void skinny_device_button_insert(listener_t *listener, skinny_device_button_t *list, uint32_t *count,
+		uint32_t position, uint32_t type, uint32_t line_instance,
+		const char *label, const char *value, const char *caller_name, const char *settings)
+{
+	uint32_t i = *count;
+
+	/* keep the list sorted by position */
+	while (i > 0 && list[i-1].position > position) {
+		list[i] = list[i-1];
+		i--;
+	}
+	list[i].position = position;
+	list[i].type = type;
+	list[i].line_instance = line_instance;
+	list[i].label = switch_core_strdup(listener->pool, switch_str_nil(label));
+	list[i].value = switch_core_strdup(listener->pool, switch_str_nil(value));
+	list[i].caller_name = switch_core_strdup(listener->pool, switch_str_nil(caller_name));
+	list[i].settings = switch_core_strdup(listener->pool, switch_str_nil(settings));
+	(*count)++;
+}
+
 switch_status_t skinny_handle_register(listener_t *listener, skinny_message_t *request)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
@@ -922,8 +943,7 @@ switch_status_t skinny_handle_register(listener_t *listener, skinny_message_t *r
 	switch_event_t *event = NULL;
 	switch_event_t *params = NULL;
 	switch_xml_t xroot, xdomain, xgroup, xuser, xskinny, xparams, xparam, xbuttons, xbutton;
-	listener_t *listener2 = NULL;
-	char *sql;
+	switch_stream_handle_t stream = { 0 };
 	assert(listener->profile);
 	profile = listener->profile;
 
@@ -949,9 +969,8 @@ switch_status_t skinny_handle_register(listener_t *listener, skinny_message_t *r
 		goto end;
 	}
 
-	skinny_profile_find_listener_by_device_name_and_instance(listener->profile,
-			request->data.reg.device_name, request->data.reg.instance, &listener2);
-	if (listener2) {
+	if (skinny_profile_register_listener(listener->profile, listener,
+			request->data.reg.device_name, request->data.reg.instance) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
 				"Device %s:%d is already registred on another listener.\n",
 				request->data.reg.device_name, request->data.reg.instance);
@@ -960,26 +979,27 @@ switch_status_t skinny_handle_register(listener_t *listener, skinny_message_t *r
 		goto end;
 	}
 
-	if ((sql = switch_mprintf(
-					"INSERT INTO skinny_devices "
-					"(name, user_id, instance, ip, type, max_streams, codec_string) "
-					"VALUES ('%s','%d','%d', '%s', '%d', '%d', '%s')",
-					request->data.reg.device_name,
-					request->data.reg.user_id,
-					request->data.reg.instance,
-					inet_ntoa(request->data.reg.ip),
-					request->data.reg.device_type,
-					request->data.reg.max_streams,
-					"" /* codec_string */
-				 ))) {
-		skinny_execute_sql(profile, sql, profile->sql_mutex);
-		switch_safe_free(sql);
-	}
-
-
-	strncpy(listener->device_name, request->data.reg.device_name, 16);
-	listener->device_instance = request->data.reg.instance;
 	listener->device_type = request->data.reg.device_type;
+	listener->device_user_id = request->data.reg.user_id;
+	listener->device_max_streams = request->data.reg.max_streams;
+	listener->device_port = 0;
+	listener->device_codec_string = NULL;
+	switch_copy_string(listener->device_ip, inet_ntoa(request->data.reg.ip), sizeof(listener->device_ip));
+	listener->line_count = 0;
+	listener->button_count = 0;
+
+	SWITCH_STANDARD_STREAM(stream);
+	stream.write_function(&stream,
+			"INSERT INTO skinny_devices "
+			"(name, user_id, instance, ip, type, max_streams, codec_string) "
+			"VALUES ('%s','%d','%d', '%s', '%d', '%d', '%s');\n",
+			listener->device_name,
+			listener->device_user_id,
+			listener->device_instance,
+			listener->device_ip,
+			listener->device_type,
+			listener->device_max_streams,
+			"" /* codec_string */);
 
 	xskinny = switch_xml_child(xuser, "skinny");
 	if (xskinny) {
@@ -996,7 +1016,7 @@ switch_status_t skinny_handle_register(listener_t *listener, skinny_message_t *r
 		}
 		if ((xbuttons = switch_xml_child(xskinny, "buttons"))) {
 			uint32_t line_instance = 1;
-			char *network_ip = inet_ntoa(request->data.reg.ip);
+			char *network_ip = listener->device_ip;
 			int network_port = 0;
 			char network_port_c[6];
 			snprintf(network_port_c, sizeof(network_port_c), "%d", network_port);
@@ -1005,6 +1025,12 @@ switch_status_t skinny_handle_register(listener_t *listener, skinny_message_t *r
 				uint32_t type = skinny_str2button(switch_xml_attr_soft(xbutton, "type"));
 				const char *label = switch_xml_attr_soft(xbutton, "label");
 				const char *value = switch_xml_attr_soft(xbutton, "value");
+				if (position < 1 || position > SKINNY_MAX_BUTTON_COUNT) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING,
+							"Ignoring button at invalid position %d on device %s:%d.\n",
+							position, listener->device_name, listener->device_instance);
+					continue;
+				}
 				if(type ==  SKINNY_BUTTON_LINE) {
 					const char *caller_name = switch_xml_attr_soft(xbutton, "caller-name");
 					const char *reg_metadata = switch_xml_attr_soft(xbutton, "registration-metadata");
@@ -1015,26 +1041,28 @@ switch_status_t skinny_handle_register(listener_t *listener, skinny_message_t *r
 					const char *forward_busy = switch_xml_attr_soft(xbutton, "forward-busy");
 					const char *forward_noanswer = switch_xml_attr_soft(xbutton, "forward-noanswer");
 					uint32_t noanswer_duration = atoi(switch_xml_attr_soft(xbutton, "noanswer-duration"));
-					if ((sql = switch_mprintf(
-									"INSERT INTO skinny_lines "
-									"(device_name, device_instance, position, line_instance, "
-									"label, value, caller_name, "
-									"ring_on_idle, ring_on_active, busy_trigger, "
-									"forward_all, forward_busy, forward_noanswer, noanswer_duration) "
-									"VALUES('%s', %d, %d, %d, '%s', '%s', '%s', %d, %d, %d, '%s', '%s', '%s', %d)",
-									request->data.reg.device_name, request->data.reg.instance, position, line_instance,
-									label, value, caller_name,
-									ring_on_idle, ring_on_active, busy_trigger,
-									forward_all, forward_busy, forward_noanswer, noanswer_duration))) {
-						char *token, *url;
-						skinny_execute_sql(profile, sql, profile->sql_mutex);
-						switch_safe_free(sql);
-						token = switch_mprintf("skinny/%q/%q/%q:%d", profile->name, value, request->data.reg.device_name, request->data.reg.instance);
-						url = switch_mprintf("skinny/%q/%q", profile->name, value);
-						switch_core_add_registration(value, profile->domain, token, url, 0, network_ip, network_port_c, "tcp", reg_metadata);
-						switch_safe_free(token);
-						switch_safe_free(url);
+					char *token, *url;
+					if (listener->line_count >= SKINNY_MAX_LINES) {
+						continue;
 					}
+					skinny_device_button_insert(listener, listener->lines, &listener->line_count,
+							position, type, line_instance, label, value, caller_name, NULL);
+					stream.write_function(&stream,
+							"INSERT INTO skinny_lines "
+							"(device_name, device_instance, position, line_instance, "
+							"label, value, caller_name, "
+							"ring_on_idle, ring_on_active, busy_trigger, "
+							"forward_all, forward_busy, forward_noanswer, noanswer_duration) "
+							"VALUES('%s', %d, %d, %d, '%s', '%s', '%s', %d, %d, %d, '%s', '%s', '%s', %d);\n",
+							listener->device_name, listener->device_instance, position, line_instance,
+							label, value, caller_name,
+							ring_on_idle, ring_on_active, busy_trigger,
+							forward_all, forward_busy, forward_noanswer, noanswer_duration);
+					token = switch_mprintf("skinny/%q/%q/%q:%d", profile->name, value, listener->device_name, listener->device_instance);
+					url = switch_mprintf("skinny/%q/%q", profile->name, value);
+					switch_core_add_registration(value, profile->domain, token, url, 0, network_ip, network_port_c, "tcp", reg_metadata);
+					switch_safe_free(token);
+					switch_safe_free(url);
 					if (line_instance == 1) {
 						switch_event_t *message_query_event = NULL;
 						if (switch_event_create(&message_query_event, SWITCH_EVENT_MESSAGE_QUERY) == SWITCH_STATUS_SUCCESS) {
@@ -1046,24 +1074,31 @@ switch_status_t skinny_handle_register(listener_t *listener, skinny_message_t *r
 					line_instance++;
 				} else {
 					const char *settings = switch_xml_attr_soft(xbutton, "settings");
-					if ((sql = switch_mprintf(
-									"INSERT INTO skinny_buttons "
-									"(device_name, device_instance, position, type, label, value, settings) "
-									"VALUES('%s', %d, %d, %d, '%s', '%s', '%s')",
-									request->data.reg.device_name,
-									request->data.reg.instance,
-									position,
-									type,
-									label,
-									value,
-									settings))) {
-						skinny_execute_sql(profile, sql, profile->sql_mutex);
-						switch_safe_free(sql);
+					if (listener->button_count >= SKINNY_MAX_LINES) {
+						continue;
 					}
+					skinny_device_button_insert(listener, listener->buttons, &listener->button_count,
+							position, type, 0, label, value, NULL, settings);
+					stream.write_function(&stream,
+							"INSERT INTO skinny_buttons "
+							"(device_name, device_instance, position, type, label, value, settings) "
+							"VALUES('%s', %d, %d, %d, '%s', '%s', '%s');\n",
+							listener->device_name,
+							listener->device_instance,
+							position,
+							type,
+							label,
+							value,
+							settings);
 				}
 			}
 		}
 	}
+
+	/* The tables only mirror the listener for api and call lookups, write them in one go */
+	skinny_execute_sql_trans(profile, (char *) stream.data, profile->sql_mutex);
+	switch_safe_free(stream.data);
+
 	if (xroot) {
 		switch_xml_free(xroot);
 	}
@@ -1102,6 +1137,8 @@ switch_status_t skinny_handle_port_message(listener_t *listener, skinny_message_
 
 	skinny_check_data_length(request, sizeof(request->data.as_uint16));
 
+	listener->device_port = request->data.port.port;
+
 	if ((sql = switch_mprintf(
 					"UPDATE skinny_devices SET port=%d WHERE name='%s' and instance=%d",
 					request->data.port.port,
@@ -1376,58 +1413,31 @@ switch_status_t skinny_handle_line_stat_request(listener_t *listener, skinny_mes
 	return SWITCH_STATUS_SUCCESS;
 }
 
-int skinny_config_stat_res_callback(void *pArg, int argc, char **argv, char **columnNames)
-{
-	skinny_message_t *message = pArg;
-	char *device_name = argv[0];
-	int user_id = atoi(argv[1]);
-	int instance = atoi(argv[2]);
-	char *user_name = argv[3];
-	char *server_name = argv[4];
-	int number_lines = atoi(argv[5]);
-	int number_speed_dials = atoi(argv[6]);
-
-	strncpy(message->data.config_res.device_name, device_name, 16);
-	message->data.config_res.user_id = user_id;
-	message->data.config_res.instance = instance;
-	strncpy(message->data.config_res.user_name, user_name, 40);
-	strncpy(message->data.config_res.server_name, server_name, 40);
-	message->data.config_res.number_lines = number_lines;
-	message->data.config_res.number_speed_dials = number_speed_dials;
-
-	return 0;
-}
-
 switch_status_t skinny_handle_config_stat_request(listener_t *listener, skinny_message_t *request)
 {
-	char *sql;
 	skinny_message_t *message;
-	skinny_profile_t *profile;
+	uint32_t i, number_speed_dials = 0;
 
 	switch_assert(listener->profile);
 	switch_assert(listener->device_name);
 
-	profile = listener->profile;
-
 	message = switch_core_alloc(listener->pool, 12+sizeof(message->data.config_res));
 	message->type = CONFIG_STAT_RES_MESSAGE;
 	message->length = 4 + sizeof(message->data.config_res);
 
-	if ((sql = switch_mprintf(
-					"SELECT name, user_id, instance, '' AS user_name, '' AS server_name, "
-					"(SELECT COUNT(*) FROM skinny_lines WHERE device_name='%s' AND device_instance=%d) AS number_lines, "
-					"(SELECT COUNT(*) FROM skinny_buttons WHERE device_name='%s' AND device_instance=%d AND type=%d) AS number_speed_dials "
-					"FROM skinny_devices WHERE name='%s' ",
-					listener->device_name,
-					listener->device_instance,
-					listener->device_name,
-					listener->device_instance,
-					SKINNY_BUTTON_SPEED_DIAL,
-					listener->device_name
-				 ))) {
-		skinny_execute_sql_callback(profile, profile->sql_mutex, sql, skinny_config_stat_res_callback, message);
-		switch_safe_free(sql);
+	for (i = 0; i < listener->button_count; i++) {
+		if (listener->buttons[i].type == SKINNY_BUTTON_SPEED_DIAL) {
+			number_speed_dials++;
+		}
 	}
+
+	strncpy(message->data.config_res.device_name, listener->device_name, 16);
+	message->data.config_res.user_id = listener->device_user_id;
+	message->data.config_res.instance = listener->device_instance;
+	/* user_name and server_name are left empty */
+	message->data.config_res.number_lines = listener->line_count;
+	message->data.config_res.number_speed_dials = number_speed_dials;
+
 	skinny_send_reply(listener, message);
 
 	return SWITCH_STATUS_SUCCESS;
@@ -1438,47 +1448,33 @@ switch_status_t skinny_handle_time_date_request(listener_t *listener, skinny_mes
 	return send_define_current_time_date(listener);
 }
 
-struct button_template_helper {
-	skinny_message_t *message;
-	int count[SKINNY_BUTTON_UNDEFINED+1];
-	int max_position;
-};
-
-int skinny_handle_button_template_request_callback(void *pArg, int argc, char **argv, char **columnNames)
+static void skinny_button_template_add(skinny_message_t *message, int *count, int *max_position, uint32_t position, uint32_t type)
 {
-	struct button_template_helper *helper = pArg;
-	skinny_message_t *message = helper->message;
-	/* char *device_name = argv[0]; */
-	/* uint32_t device_instance = argv[1]; */
-	int position = atoi(argv[2]);
-	uint32_t type = atoi(argv[3]);
-	/* int relative_position = atoi(argv[4]); */
+	if (position < 1 || position > SKINNY_MAX_BUTTON_COUNT) {
+		return;
+	}
 
-	message->data.button_template.btn[position-1].instance_number = ++helper->count[type];
+	message->data.button_template.btn[position-1].instance_number = ++count[type];
 	message->data.button_template.btn[position-1].button_definition = type;
 
 	message->data.button_template.button_count++;
 	message->data.button_template.total_button_count++;
-	if(position > helper->max_position) {
-		helper->max_position = position;
+	if((int) position > *max_position) {
+		*max_position = position;
 	}
-
-	return 0;
 }
 
 switch_status_t skinny_handle_button_template_request(listener_t *listener, skinny_message_t *request)
 {
 	skinny_message_t *message;
-	struct button_template_helper helper = {0};
-	skinny_profile_t *profile;
-	char *sql;
+	int count[SKINNY_BUTTON_UNDEFINED+1] = {0};
+	int max_position = 0;
+	uint32_t j;
 	int i;
 
 	switch_assert(listener->profile);
 	switch_assert(listener->device_name);
 
-	profile = listener->profile;
-
 	message = switch_core_alloc(listener->pool, 12+sizeof(message->data.button_template));
 	message->type = BUTTON_TEMPLATE_RES_MESSAGE;
 	message->length = 4 + sizeof(message->data.button_template);
@@ -1487,38 +1483,21 @@ switch_status_t skinny_handle_button_template_request(listener_t *listener, skin
 	message->data.button_template.button_count = 0;
 	message->data.button_template.total_button_count = 0;
 
-	helper.message = message;
-
 	/* Add buttons */
-	if ((sql = switch_mprintf(
-					"SELECT device_name, device_instance, position, MIN(type, %d) AS type "
-					"FROM skinny_buttons "
-					"WHERE device_name='%s' AND device_instance=%d "
-					"ORDER BY position",
-					SKINNY_BUTTON_UNDEFINED,
-					listener->device_name, listener->device_instance
-				 ))) {
-		skinny_execute_sql_callback(profile, profile->sql_mutex, sql, skinny_handle_button_template_request_callback, &helper);
-		switch_safe_free(sql);
+	for (j = 0; j < listener->button_count; j++) {
+		skinny_button_template_add(message, count, &max_position, listener->buttons[j].position,
+				listener->buttons[j].type < SKINNY_BUTTON_UNDEFINED ? listener->buttons[j].type : SKINNY_BUTTON_UNDEFINED);
 	}
 
 	/* Add lines */
-	if ((sql = switch_mprintf(
-					"SELECT device_name, device_instance, position, %d AS type "
-					"FROM skinny_lines "
-					"WHERE device_name='%s' AND device_instance=%d "
-					"ORDER BY position",
-					SKINNY_BUTTON_LINE,
-					listener->device_name, listener->device_instance
-				 ))) {
-		skinny_execute_sql_callback(profile, profile->sql_mutex, sql, skinny_handle_button_template_request_callback, &helper);
-		switch_safe_free(sql);
+	for (j = 0; j < listener->line_count; j++) {
+		skinny_button_template_add(message, count, &max_position, listener->lines[j].position, SKINNY_BUTTON_LINE);
 	}
 
 	/* Fill remaining buttons with Undefined */
-	for(i = 0; i+1 < helper.max_position; i++) {
+	for(i = 0; i+1 < max_position; i++) {
 		if(message->data.button_template.btn[i].button_definition == SKINNY_BUTTON_UNKNOWN) {
-			message->data.button_template.btn[i].instance_number = ++helper.count[SKINNY_BUTTON_UNDEFINED];
+			message->data.button_template.btn[i].instance_number = ++count[SKINNY_BUTTON_UNDEFINED];
 			message->data.button_template.btn[i].button_definition = SKINNY_BUTTON_UNDEFINED;
 			message->data.button_template.button_count++;
 			message->data.button_template.total_button_count++;
@@ -1601,6 +1580,7 @@ switch_status_t skinny_handle_capabilities_response(listener_t *listener, skinny
 		}
 	}
 	codec_string[string_len] = '\0';
+	listener->device_codec_string = codec_string;
 	if ((sql = switch_mprintf(
 					"UPDATE skinny_devices SET codec_string='%s' WHERE name='%s'",
 					codec_string,
@@ -999,6 +999,8 @@ static switch_status_t sofia_read_frame(switch_core_session_t *session, switch_f
 			sofia_clear_flag(tech_pvt, TFLAG_SIMPLIFY);
 		}
 
+		sofia_glue_check_rtp_relay(tech_pvt);
+
 		while (sofia_test_flag(tech_pvt, TFLAG_IO) && tech_pvt->read_frame.datalen == 0) {
 			tech_pvt->read_frame.flags = SFF_NONE;
 
@@ -1535,7 +1537,9 @@ static switch_status_t sofia_receive_message(switch_core_session_t *session, swi
 					}
 					if (switch_rtp_activate_jitter_buffer(tech_pvt->rtp_session, qlen, maxqlen,
 														  tech_pvt->read_impl.samples_per_packet, 
-														  tech_pvt->read_impl.samples_per_second, max_drift) == SWITCH_STATUS_SUCCESS) {
+														  tech_pvt->read_impl.samples_per_second, max_drift,
+														  switch_true(switch_channel_get_variable(tech_pvt->channel, "jitterbuffer_adaptive")) ?
+														  SWITCH_RTP_JB_ADAPTIVE : 0) == SWITCH_STATUS_SUCCESS) {
 						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(tech_pvt->session), 
 										  SWITCH_LOG_DEBUG, "Setting Jitterbuffer to %dms (%d frames) (%d max frames) (%d max drift)\n", 
 										  len, qlen, maxqlen, max_drift);
@@ -1647,7 +1651,8 @@ static switch_status_t sofia_receive_message(switch_core_session_t *session, swi
 				} else {
 					rtp_flush_read_buffer(tech_pvt->rtp_session, SWITCH_RTP_FLUSH_ONCE);
 				}
-				
+
+				sofia_glue_start_rtp_relay(tech_pvt, msg->string_arg);
 			}
 		}
 		goto end;
@@ -1678,6 +1683,8 @@ static switch_status_t sofia_receive_message(switch_core_session_t *session, swi
 			
 			sofia_glue_tech_track(tech_pvt->profile, session);
 
+			switch_rtp_relay_stop(tech_pvt->rtp_session);
+
 			if (sofia_test_flag(tech_pvt, TFLAG_JB_PAUSED)) {
 				sofia_clear_flag(tech_pvt, TFLAG_JB_PAUSED);
 				if (switch_channel_test_flag(tech_pvt->channel, CF_JITTERBUFFER)) {
@@ -2831,6 +2838,10 @@ static uint32_t sofia_profile_reg_count(sofia_profile_t *profile)
 	struct cb_helper_sql2str cb;
 	char reg_count[80] = "";
 	char *sql;
+	if (profile->reg_store) {
+		return sofia_reg_store_size(profile);
+	}
+
 	cb.buf = reg_count;
 	cb.len = sizeof(reg_count);
 	sql = switch_mprintf("select count(*) from sip_registrations where profile_name = '%q'", profile->name);
@@ -2849,6 +2860,7 @@ static switch_status_t cmd_status(char **argv, int argc, switch_stream_handle_t
 	void *val;
 	const void *vvar;
 	int c = 0;
+	uint32_t auth_users, auth_nonces, auth_hits, auth_misses;
 	int ac = 0;
 	const char *line = "=================================================================================================";
 
@@ -3015,6 +3027,21 @@ static switch_status_t cmd_status(char **argv, int argc, switch_stream_handle_t
 					stream->write_function(stream, "CALLS-OUT        \t%u\n", profile->ob_calls);
 					stream->write_function(stream, "FAILED-CALLS-OUT \t%u\n", profile->ob_failed_calls);
 					stream->write_function(stream, "REGISTRATIONS    \t%lu\n", sofia_profile_reg_count(profile));
+					if (profile->notify_rate_limit) {
+						stream->write_function(stream, "NOTIFY-RATE      \t%u/s (%u paced)\n", profile->notify_rate_limit, profile->notify_paced);
+					}
+					if (sofia_reg_auth_cache_stats(profile, &auth_users, &auth_nonces, &auth_hits, &auth_misses)) {
+						stream->write_function(stream, "AUTH-CACHE       \t%u users, %u nonces (%u hits, %u misses)\n",
+											   auth_users, auth_nonces, auth_hits, auth_misses);
+					}
+					if (profile->sql_queue) {
+						stream->write_function(stream, "SQL-QUEUE        \t%u (max %u)\n", switch_queue_size(profile->sql_queue), profile->sql_queue_max_depth);
+						stream->write_function(stream, "SQL-BATCH        \t%u\n", profile->sql_batch_max);
+						stream->write_function(stream, "SQL-COMMITS      \t%u (%" SWITCH_UINT64_T_FMT " statements, %u sync)\n",
+											   profile->sql_commits, profile->sql_committed, profile->sql_sync_fallbacks);
+						stream->write_function(stream, "SQL-COMMIT-MS    \t%u last, %u max, %u avg\n", profile->sql_commit_last_ms, profile->sql_commit_max_ms,
+											   profile->sql_commits ? (uint32_t) (profile->sql_commit_total_ms / profile->sql_commits) : 0);
+					}
 				}
 
 				cb.profile = profile;
@@ -3293,6 +3320,20 @@ static switch_status_t cmd_xml_status(char **argv, int argc, switch_stream_handl
 					stream->write_function(stream, "    <failed-calls-in>%u</failed-calls-in>\n", profile->ib_failed_calls);
 					stream->write_function(stream, "    <failed-calls-out>%u</failed-calls-out>\n", profile->ob_failed_calls);
 					stream->write_function(stream, "    <registrations>%lu</registrations>\n", sofia_profile_reg_count(profile));
+					if (profile->notify_rate_limit) {
+						stream->write_function(stream, "    <notify-rate-limit>%u</notify-rate-limit>\n", profile->notify_rate_limit);
+						stream->write_function(stream, "    <notify-paced>%u</notify-paced>\n", profile->notify_paced);
+					}
+					if (profile->sql_queue) {
+						stream->write_function(stream, "    <sql-queue>%u</sql-queue>\n", switch_queue_size(profile->sql_queue));
+						stream->write_function(stream, "    <sql-queue-max>%u</sql-queue-max>\n", profile->sql_queue_max_depth);
+						stream->write_function(stream, "    <sql-batch>%u</sql-batch>\n", profile->sql_batch_max);
+						stream->write_function(stream, "    <sql-commits>%u</sql-commits>\n", profile->sql_commits);
+						stream->write_function(stream, "    <sql-committed>%" SWITCH_UINT64_T_FMT "</sql-committed>\n", profile->sql_committed);
+						stream->write_function(stream, "    <sql-sync-fallbacks>%u</sql-sync-fallbacks>\n", profile->sql_sync_fallbacks);
+						stream->write_function(stream, "    <sql-commit-last-ms>%u</sql-commit-last-ms>\n", profile->sql_commit_last_ms);
+						stream->write_function(stream, "    <sql-commit-max-ms>%u</sql-commit-max-ms>\n", profile->sql_commit_max_ms);
+					}
 					stream->write_function(stream, "  </profile-info>\n");
 				}
 
@@ -3536,6 +3577,24 @@ static switch_status_t cmd_profile(char **argv, int argc, switch_stream_handle_t
 	}
 
 
+	if (!strcasecmp(argv[1], "flush_auth_cache")) {
+		uint32_t r;
+
+		if (argc > 2 && strchr(argv[2], '@')) {
+			char *user = strdup(argv[2]);
+			char *domain = strchr(user, '@');
+
+			*domain++ = '\0';
+			r = sofia_reg_auth_cache_flush(profile, user, domain);
+			free(user);
+		} else {
+			r = sofia_reg_auth_cache_flush(profile, NULL, NULL);
+		}
+
+		stream->write_function(stream, "+OK %u cached user%s flushed\n", r, r == 1 ? "" : "s");
+		goto done;
+	}
+
 	if (!strcasecmp(argv[1], "flush_inbound_reg")) {
 		int reboot = 0;
 
@@ -3803,7 +3862,10 @@ SWITCH_STANDARD_API(sofia_count_reg_function)
 				domain = profile->name;
 			}
 
-			if (zstr(user)) {
+			if (profile->reg_store && !zstr(user)) {
+				sql = NULL;
+				switch_snprintf(reg_count, sizeof(reg_count), "%d", sofia_reg_store_select(profile, user, domain, NULL, NULL, 0, NULL, NULL, NULL));
+			} else if (zstr(user)) {
 				sql = switch_mprintf("select count(*) "
 									 "from sip_registrations where (sip_host='%q' or presence_hosts like '%%%q%%')",
 									 domain, domain);
@@ -3813,9 +3875,10 @@ SWITCH_STANDARD_API(sofia_count_reg_function)
 									 "from sip_registrations where sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%')",
 									 user, domain, domain);
 			}
-			switch_assert(sql);
-			sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, sql2str_callback, &cb);
-			switch_safe_free(sql);
+			if (sql) {
+				sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, sql2str_callback, &cb);
+				switch_safe_free(sql);
+			}
 			if (!zstr(reg_count)) {
 				stream->write_function(stream, "%s", reg_count);
 			} else {
@@ -3898,14 +3961,20 @@ SWITCH_STANDARD_API(sofia_username_of_function)
 
 			switch_assert(!zstr(user));
 
-			sql = switch_mprintf("select sip_username "
-									"from sip_registrations where sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%')",
-									user, domain, domain);
+			if (profile->reg_store) {
+				static const sofia_reg_col_t username_col[] = { REG_COL_SIP_USERNAME };
+
+				sofia_reg_store_select(profile, user, domain, NULL, username_col, 1, NULL, sql2str_callback, &cb);
+			} else {
+				sql = switch_mprintf("select sip_username "
+									 "from sip_registrations where sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%')",
+									 user, domain, domain);
 
-			switch_assert(sql);
+				switch_assert(sql);
 
-			sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, sql2str_callback, &cb);
-			switch_safe_free(sql);
+				sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, sql2str_callback, &cb);
+				switch_safe_free(sql);
+			}
 			if (!zstr(username)) {
 				stream->write_function(stream, "%s", username);
 			} else {
@@ -3944,6 +4013,13 @@ static void select_from_profile(sofia_profile_t *profile,
 	cb.profile = profile;
 	cb.stream = stream;
 
+	if (profile->reg_store) {
+		static const sofia_reg_col_t contact_cols[] = { REG_COL_CONTACT, REG_COL_PROFILE_NAME };
+
+		sofia_reg_store_select(profile, user, domain, exclude_contact, contact_cols, 2, (concat != NULL) ? concat : "", contact_callback, &cb);
+		return;
+	}
+
 	if (exclude_contact) {
 		sql = switch_mprintf("select contact, profile_name, '%q' "
 							 "from sip_registrations where sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%') "
@@ -4146,6 +4222,7 @@ SWITCH_STANDARD_API(sofia_function)
 		"             watchdog <on|off>\n\n"
 		"sofia profile <name> [start | stop | restart | rescan] [wait]\n"
 		"                     flush_inbound_reg [<call_id> | <[user]@domain>] [reboot]\n"
+		"                     flush_auth_cache [<user>@<domain>]\n"
 		"                     check_sync [<call_id> | <[user]@domain>]\n"
 		"                     [register | unregister] [<gateway name> | all]\n"
 		"                     killgw <gateway name>\n"
@@ -4157,6 +4234,8 @@ SWITCH_STANDARD_API(sofia_function)
 		"sofia <status|xmlstatus> gateway <name>\n\n"
 		"sofia loglevel <all|default|tport|iptsec|nea|nta|nth_client|nth_server|nua|soa|sresolv|stun> [0-9]\n"
 		"sofia tracelevel <console|alert|crit|err|warning|notice|info|debug>\n\n"
+		"sofia recover [flush]\n"
+		"sofia replication\n\n"
 		"sofia help\n"
 		"--------------------------------------------------------------------------------\n";
 
@@ -4286,6 +4365,9 @@ SWITCH_STANDARD_API(sofia_function)
 		
 		goto done;
 
+	} else if (!strcasecmp(argv[0], "replication")) {
+		sofia_glue_replicate_status(stream);
+		goto done;
 	} else if (!strcasecmp(argv[0], "recover")) {
 		if (argv[1] && !strcasecmp(argv[1], "flush")) {
 			sofia_glue_recover(SWITCH_TRUE);
@@ -5182,6 +5264,22 @@ static void general_event_handler(switch_event_t *event)
 
 		}
 		break;
+	case SWITCH_EVENT_RELOADXML:
+		{
+			switch_hash_index_t *hi;
+			void *val;
+
+			/* the directory may have changed under the cached users */
+			switch_mutex_lock(mod_sofia_globals.hash_mutex);
+			if (mod_sofia_globals.profile_hash) {
+				for (hi = switch_hash_first(NULL, mod_sofia_globals.profile_hash); hi; hi = switch_hash_next(hi)) {
+					switch_hash_this(hi, NULL, NULL, &val);
+					sofia_reg_auth_cache_flush((sofia_profile_t *) val, NULL, NULL);
+				}
+			}
+			switch_mutex_unlock(mod_sofia_globals.hash_mutex);
+		}
+		break;
 	case SWITCH_EVENT_TRAP:
 		{
 			const char *cond = switch_event_get_header(event, "condition");
@@ -5426,6 +5524,100 @@ SWITCH_STANDARD_APP(sofia_sla_function)
 	switch_ivr_eavesdrop_session(session, data, NULL, ED_MUX_READ | ED_MUX_WRITE | ED_COPY_DISPLAY);
 }
 
+static void sofia_metrics_collector(switch_stream_handle_t *stream, void *user_data)
+{
+	static const char *names[] = { "sofia_calls_total", "sofia_failed_calls_total" };
+	static const char *help[] = { "Calls handled per profile", "Failed calls per profile" };
+	switch_hash_index_t *hi;
+	const void *vvar;
+	void *val;
+	int x;
+
+	switch_mutex_lock(mod_sofia_globals.hash_mutex);
+	for (x = 0; x < 2; x++) {
+		switch_metric_write_family(stream, names[x], help[x], SWITCH_METRIC_COUNTER);
+
+		for (hi = switch_hash_first(NULL, mod_sofia_globals.profile_hash); hi; hi = switch_hash_next(hi)) {
+			sofia_profile_t *profile;
+			char labels[256];
+
+			switch_hash_this(hi, &vvar, NULL, &val);
+			profile = (sofia_profile_t *) val;
+
+			if (strcmp(vvar, profile->name)) {	/* alias */
+				continue;
+			}
+
+			switch_snprintf(labels, sizeof(labels), "profile=\"%s\",direction=\"inbound\"", profile->name);
+			switch_metric_write_value(stream, names[x], labels, x ? profile->ib_failed_calls : profile->ib_calls);
+			switch_snprintf(labels, sizeof(labels), "profile=\"%s\",direction=\"outbound\"", profile->name);
+			switch_metric_write_value(stream, names[x], labels, x ? profile->ob_failed_calls : profile->ob_calls);
+		}
+	}
+
+	switch_metric_write_family(stream, "sofia_profile_inuse", "Channels in use per profile", SWITCH_METRIC_GAUGE);
+	for (hi = switch_hash_first(NULL, mod_sofia_globals.profile_hash); hi; hi = switch_hash_next(hi)) {
+		sofia_profile_t *profile;
+		char labels[256];
+
+		switch_hash_this(hi, &vvar, NULL, &val);
+		profile = (sofia_profile_t *) val;
+
+		if (strcmp(vvar, profile->name)) {
+			continue;
+		}
+
+		switch_snprintf(labels, sizeof(labels), "profile=\"%s\"", profile->name);
+		switch_metric_write_value(stream, "sofia_profile_inuse", labels, profile->inuse);
+	}
+
+	switch_metric_write_family(stream, "sofia_overload_shed_total", "Requests refused by overload control per profile", SWITCH_METRIC_COUNTER);
+	for (hi = switch_hash_first(NULL, mod_sofia_globals.profile_hash); hi; hi = switch_hash_next(hi)) {
+		static const char *classes[SOFIA_OC_CLASSES] = { "options", "register", "request", "invite" };
+		sofia_profile_t *profile;
+		char labels[256];
+
+		switch_hash_this(hi, &vvar, NULL, &val);
+		profile = (sofia_profile_t *) val;
+
+		if (strcmp(vvar, profile->name) || !sofia_test_pflag(profile, PFLAG_OVERLOAD_CONTROL)) {
+			continue;
+		}
+
+		for (x = 0; x < SOFIA_OC_CLASSES; x++) {
+			switch_snprintf(labels, sizeof(labels), "profile=\"%s\",class=\"%s\"", profile->name, classes[x]);
+			switch_metric_write_value(stream, "sofia_overload_shed_total", labels, (int64_t) profile->oc_shed[x]);
+		}
+		switch_snprintf(labels, sizeof(labels), "profile=\"%s\",class=\"rate-limit\"", profile->name);
+		switch_metric_write_value(stream, "sofia_overload_shed_total", labels, (int64_t) profile->oc_limited);
+	}
+
+	switch_metric_write_family(stream, "sofia_tls_handshakes_total", "TLS handshakes per profile", SWITCH_METRIC_COUNTER);
+	switch_metric_write_family(stream, "sofia_tls_handshake_microseconds_total", "Time spent in TLS handshakes per profile", SWITCH_METRIC_COUNTER);
+	for (hi = switch_hash_first(NULL, mod_sofia_globals.profile_hash); hi; hi = switch_hash_next(hi)) {
+		sofia_profile_t *profile;
+		tport_tls_stats_t stats;
+		char labels[256];
+
+		switch_hash_this(hi, &vvar, NULL, &val);
+		profile = (sofia_profile_t *) val;
+
+		if (strcmp(vvar, profile->name) || !sofia_test_pflag(profile, PFLAG_TLS) || !profile->nua ||
+			tport_tls_stats(nta_agent_tports(profile->nua->nua_nta), &stats)) {
+			continue;
+		}
+
+		switch_snprintf(labels, sizeof(labels), "profile=\"%s\",type=\"full\"", profile->name);
+		switch_metric_write_value(stream, "sofia_tls_handshakes_total", labels, stats.tls_full);
+		switch_snprintf(labels, sizeof(labels), "profile=\"%s\",type=\"resumed\"", profile->name);
+		switch_metric_write_value(stream, "sofia_tls_handshakes_total", labels, stats.tls_resumed);
+		switch_snprintf(labels, sizeof(labels), "profile=\"%s\",type=\"failed\"", profile->name);
+		switch_metric_write_value(stream, "sofia_tls_handshakes_total", labels, stats.tls_failed);
+		switch_snprintf(labels, sizeof(labels), "profile=\"%s\"", profile->name);
+		switch_metric_write_value(stream, "sofia_tls_handshake_microseconds_total", labels, (int64_t) stats.tls_usec);
+	}
+	switch_mutex_unlock(mod_sofia_globals.hash_mutex);
+}
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_sofia_load)
 {
@@ -5472,17 +5664,18 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_sofia_load)
 		mod_sofia_globals.max_msg_queues = SOFIA_MAX_MSG_QUEUE;
 	}
 
-	switch_queue_create(&mod_sofia_globals.msg_queue, SOFIA_MSG_QUEUE_SIZE * mod_sofia_globals.max_msg_queues, mod_sofia_globals.pool);
+	sofia_msg_queue_init();
 
-	/* start one message thread */
-	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Starting initial message thread.\n");
-	sofia_msg_thread_start(0);
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Starting %d message threads.\n", mod_sofia_globals.max_msg_queues);
+	sofia_msg_thread_start(mod_sofia_globals.max_msg_queues - 1);
 
 	if (config_sofia(0, NULL) != SWITCH_STATUS_SUCCESS) {
 		mod_sofia_globals.running = 0;
 		return SWITCH_STATUS_GENERR;
 	}
 
+	sofia_glue_replicate_start();
+
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Waiting for profiles to start\n");
 	switch_yield(1500000);
 
@@ -5548,6 +5741,11 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_sofia_load)
 		return SWITCH_STATUS_GENERR;
 	}
 
+	if (switch_event_bind(modname, SWITCH_EVENT_RELOADXML, SWITCH_EVENT_SUBCLASS_ANY, general_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
+		return SWITCH_STATUS_GENERR;
+	}
+
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 	sofia_endpoint_interface = switch_loadable_module_create_interface(*module_interface, SWITCH_ENDPOINT_INTERFACE);
@@ -5590,6 +5788,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_sofia_load)
 	switch_console_set_complete("add sofia profile ::sofia::list_profiles restart");
 
 	switch_console_set_complete("add sofia profile ::sofia::list_profiles flush_inbound_reg");
+	switch_console_set_complete("add sofia profile ::sofia::list_profiles flush_auth_cache");
 	switch_console_set_complete("add sofia profile ::sofia::list_profiles check_sync");
 	switch_console_set_complete("add sofia profile ::sofia::list_profiles register ::sofia::list_profile_gateway");
 	switch_console_set_complete("add sofia profile ::sofia::list_profiles unregister ::sofia::list_profile_gateway");
@@ -5622,6 +5821,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_sofia_load)
 	SWITCH_ADD_API(api_interface, "sofia_dig", "SIP DIG", sip_dig_function, "<url>");
 	SWITCH_ADD_CHAT(chat_interface, SOFIA_CHAT_PROTO, sofia_presence_chat_send);
 
+	switch_metric_register_collector("sofia", sofia_metrics_collector, NULL);
+	switch_core_add_load_source("sofia-msg-queue", sofia_msg_queue_load, NULL);
+
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -5632,6 +5834,9 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_sofia_shutdown)
 	int i;
 
 
+	switch_metric_unregister_collector("sofia");
+	switch_core_remove_load_source("sofia-msg-queue");
+
 	switch_console_del_complete_func("::sofia::list_profiles");
 	switch_console_set_complete("del sofia");
 
@@ -5658,18 +5863,15 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_sofia_shutdown)
 	}
 
 
-	for (i = 0; mod_sofia_globals.msg_queue_thread[i]; i++) {
-		switch_queue_push(mod_sofia_globals.msg_queue, NULL);
-	}
+	sofia_msg_queue_shutdown();
 
 
-	for (i = 0; mod_sofia_globals.msg_queue_thread[i]; i++) {
-		switch_status_t st;
-		switch_thread_join(&st, mod_sofia_globals.msg_queue_thread[i]);
+	//switch_yield(1000000);
+	if (mod_sofia_globals.sres_cache) {
+		sres_cache_unref(mod_sofia_globals.sres_cache);
+		mod_sofia_globals.sres_cache = NULL;
 	}
 
-
-	//switch_yield(1000000);
 	su_deinit();
 
 	switch_mutex_lock(mod_sofia_globals.hash_mutex);
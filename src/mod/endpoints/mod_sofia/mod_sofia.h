@@ -67,6 +67,41 @@ typedef struct sofia_gateway_subscription sofia_gateway_subscription_t;
 
 struct sofia_profile;
 typedef struct sofia_profile sofia_profile_t;
+
+struct sofia_reg_store;
+typedef struct sofia_reg_store sofia_reg_store_t;
+
+/* sip-header-vars: the X-/P- headers of an INVITE that become sip_h_ variables */
+typedef struct sofia_header_vars {
+	char **names;				/* sorted for bsearch */
+	int nnames;
+	char **prefixes;			/* entries given as Name-* */
+	int nprefixes;
+} sofia_header_vars_t;
+
+/* hierarchical timer wheel with one second resolution, 4 levels of 64 slots (about 194 days) plus an overflow list */
+#define SOFIA_WHEEL_BITS 6
+#define SOFIA_WHEEL_SLOTS (1 << SOFIA_WHEEL_BITS)
+#define SOFIA_WHEEL_LEVELS 4
+
+typedef struct sofia_wheel_node {
+	time_t due;
+	void *data;
+	struct sofia_wheel_node *next;
+	struct sofia_wheel_node **pprev;
+} sofia_wheel_node_t;
+
+typedef struct sofia_wheel {
+	sofia_wheel_node_t *slot[SOFIA_WHEEL_LEVELS][SOFIA_WHEEL_SLOTS];
+	sofia_wheel_node_t *overflow;
+	time_t now;
+	uint32_t count;
+} sofia_wheel_t;
+
+struct sofia_sub_timers;
+typedef struct sofia_sub_timers sofia_sub_timers_t;
+struct sofia_auth_cache;
+typedef struct sofia_auth_cache sofia_auth_cache_t;
 #define NUA_MAGIC_T sofia_profile_t
 
 typedef struct sofia_private sofia_private_t;
@@ -128,6 +163,10 @@ typedef struct private_object private_object_t;
 #include <sofia-sip/nea.h>
 #include <sofia-sip/msg_addr.h>
 #include <sofia-sip/tport_tag.h>
+#include <sofia-sip/tport.h>
+#include <sofia-sip/nta_tport.h>
+#include <sofia-sip/sresolv.h>
+#include <sofia-resolv/sres_cache.h>
 #include <sofia-sip/sip_extra.h>
 #include "nua_stack.h"
 #include "sofia-sip/msg_parser.h"
@@ -269,6 +308,10 @@ typedef enum {
 	PFLAG_CONFIRM_BLIND_TRANSFER,
 	PFLAG_THREAD_PER_REG,
 	PFLAG_MWI_USE_REG_CALLID,
+	PFLAG_RTP_REACTOR,
+	PFLAG_RTP_RELAY_DURING_BRIDGE,
+	PFLAG_OVERLOAD_CONTROL,
+	PFLAG_NAT_KEEPALIVE_CRLF,
 	/* No new flags below this line */
 	PFLAG_MAX
 } PFLAGS;
@@ -347,8 +390,39 @@ typedef enum {
 #define SOFIA_MAX_MSG_QUEUE 64
 #define SOFIA_MSG_QUEUE_SIZE 100
 
+/* call signalling is drained ahead of registrations/subscriptions, but never more than this many in a row */
+#define SOFIA_MSG_CALL_BURST 8
+
+/* new out of dialog requests in the order they are shed, everything else is always let in */
+typedef enum {
+	SOFIA_OC_OPTIONS,
+	SOFIA_OC_REGISTER,
+	SOFIA_OC_REQUEST,
+	SOFIA_OC_INVITE,
+	SOFIA_OC_CLASSES,
+	SOFIA_OC_KEEP = SOFIA_OC_CLASSES
+} sofia_oc_class_t;
+
+/* sources tracked per profile before the table is started over */
+#define SOFIA_OC_MAX_SOURCES 65536
+
+typedef enum {
+	SOFIA_MSG_LANE_CALL,
+	SOFIA_MSG_LANE_BULK,
+	SOFIA_MSG_LANES
+} sofia_msg_lane_t;
+
+/* one per message thread, everything for a given Call-ID lands on the same one so it is handled in order */
+typedef struct sofia_msg_shard_s {
+	switch_queue_t *lane[SOFIA_MSG_LANES];
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+} sofia_msg_shard_t;
+
 struct mod_sofia_globals {
 	switch_memory_pool_t *pool;
+	/* one DNS cache for every profile, a name one profile resolved is known to all of them */
+	sres_cache_t *sres_cache;
 	switch_hash_t *profile_hash;
 	switch_hash_t *gateway_hash;
 	switch_mutex_t *hash_mutex;
@@ -362,7 +436,7 @@ struct mod_sofia_globals {
 	char hostname[512];
 	switch_queue_t *presence_queue;
 	switch_queue_t *mwi_queue;
-	switch_queue_t *msg_queue;
+	sofia_msg_shard_t msg_shard[SOFIA_MAX_MSG_QUEUE];
 	switch_thread_t *msg_queue_thread[SOFIA_MAX_MSG_QUEUE];
 	int msg_queue_len;
 	struct sofia_private destroy_private;
@@ -384,6 +458,18 @@ struct mod_sofia_globals {
 	int tracelevel;
 	char *capture_server;	
 	int rewrite_multicasted_fs_path;
+	uint32_t presence_coalesce_ms;
+	uint32_t mwi_coalesce_ms;
+	/* call state streamed to a standby, and received from peers we stand by for */
+	char *replicate_to;
+	char *replicate_listen;
+	switch_queue_t *replicate_queue;
+	switch_mutex_t *replicate_mutex;
+	switch_hash_t *replicate_tracked;
+	switch_hash_t *replicate_replicas;
+	int replicate_connected;
+	uint32_t replicate_sent;
+	uint32_t replicate_received;
 };
 extern struct mod_sofia_globals mod_sofia_globals;
 
@@ -588,6 +674,7 @@ struct sofia_profile {
 	char *rtcp_audio_interval_msec;
 	char *rtcp_video_interval_msec;
 	char *jb_msec;
+	char *rtp_tx_batch;
 	char *pnp_prov_url;
 	char *pnp_notify_profile;
 	sofia_cid_type_t cid_type;
@@ -619,6 +706,12 @@ struct sofia_profile {
 	//su_home_t *home;
 	switch_hash_t *chat_hash;
 	switch_hash_t *mwi_debounce_hash;
+	/* parsed codec strings and negotiated audio picks, see sofia_glue.c */
+	switch_mutex_t *codec_cache_mutex;
+	switch_hash_t *codec_cache;
+	struct sofia_codec_cache_entry *codec_cache_head;
+	uint32_t codec_cache_count;
+	uint32_t codec_cache_generation;
 	//switch_core_db_t *master_db;
 	switch_thread_rwlock_t *rwlock;
 	switch_mutex_t *flag_mutex;
@@ -627,6 +720,10 @@ struct sofia_profile {
 	uint32_t session_timeout;
 	uint32_t minimum_session_expires;
 	uint32_t max_proceeding;
+	/* notify-rate-limit pacing, theoretical arrival time of the next NOTIFY */
+	uint32_t notify_rate_limit;
+	switch_time_t notify_tat;
+	uint32_t notify_paced;
 	uint32_t rtp_timeout_sec;
 	uint32_t rtp_hold_timeout_sec;
 	char *odbc_dsn;
@@ -634,6 +731,27 @@ struct sofia_profile {
 	char *odbc_pass;
 	//  switch_odbc_handle_t *master_odbc;
 	switch_queue_t *sql_queue;
+	switch_thread_id_t sql_worker_id;
+	/* group commit sizing and stats, only the worker thread writes these except sql_sync_fallbacks */
+	uint32_t sql_batch_max;
+	uint32_t sql_queue_max_depth;
+	uint32_t sql_commits;
+	uint64_t sql_committed;
+	uint32_t sql_commit_last_ms;
+	uint32_t sql_commit_max_ms;
+	uint64_t sql_commit_total_ms;
+	uint32_t sql_sync_fallbacks;
+	/* registration-store: 0 off, 1 memory with write-behind sql, 2 memory only */
+	int reg_store_mode;
+	sofia_reg_store_t *reg_store;
+	su_timer_t *keepalive_timer;
+	/* NULL for every X-/P- header, replaced (never freed, it is in the pool) on reload */
+	sofia_header_vars_t *header_vars;
+	int auth_nonce_memory;
+	uint32_t auth_user_cache_ttl;
+	uint32_t auth_user_negative_cache_ttl;
+	sofia_auth_cache_t *auth_cache;
+	sofia_sub_timers_t *sub_timers;
 	char *acl[SOFIA_MAX_ACL];
 	uint32_t acl_count;
 	char *proxy_acl[SOFIA_MAX_ACL];
@@ -671,17 +789,28 @@ struct sofia_profile {
 	int watchdog_enabled;
 	switch_mutex_t *gw_mutex;
 	uint32_t queued_events;
+	uint32_t oc_start;
+	uint32_t oc_source_rate;
+	switch_hash_t *oc_sources;
+	uint32_t oc_source_count;
+	switch_time_t oc_sweep;
+	uint64_t oc_shed[SOFIA_OC_CLASSES];
+	uint64_t oc_limited;
 	uint32_t cseq_base;
 	int tls_only;
 	int tls_verify_date;
 	enum tport_tls_verify_policy tls_verify_policy;
 	int tls_verify_depth;
 	char *tls_passphrase;
+	uint32_t tls_session_cache_size;
+	uint32_t tls_session_timeout;
+	char *tls_ticket_keys;
 	char *tls_verify_in_subjects_str;
 	su_strlst_t *tls_verify_in_subjects;
 	uint32_t sip_force_expires;
 	uint32_t sip_expires_max_deviation;
 	int ireg_seconds;
+	uint32_t gateway_register_burst;
 	sofia_paid_type_t paid_type;
 	uint32_t rtp_digit_delay;
 };
@@ -905,6 +1034,8 @@ void sofia_glue_deactivate_rtp(private_object_t *tech_pvt);
 void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch_port_t port, const char *sr, int force);
 
 void sofia_glue_tech_prepare_codecs(private_object_t *tech_pvt);
+void sofia_glue_codec_cache_destroy(sofia_profile_t *profile);
+void sofia_oc_reset_sources(sofia_profile_t *profile, switch_time_t now);
 
 const char *sofia_glue_get_codec_string(private_object_t *tech_pvt);
 
@@ -1001,6 +1132,7 @@ void sofia_glue_actually_execute_sql_trans(sofia_profile_t *profile, char *sql,
 void sofia_glue_execute_sql_now(sofia_profile_t *profile, char **sqlp, switch_bool_t sql_already_dynamic);
 void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot);
 void sofia_reg_check_gateway(sofia_profile_t *profile, time_t now);
+int sofia_reg_jitter(int seconds);
 void sofia_sub_check_gateway(sofia_profile_t *profile, time_t now);
 void sofia_reg_unregister(sofia_profile_t *profile);
 switch_status_t sofia_glue_ext_address_lookup(sofia_profile_t *profile, private_object_t *tech_pvt, char **ip, switch_port_t *port,
@@ -1024,6 +1156,8 @@ char *sofia_overcome_sip_uri_weakness(switch_core_session_t *session, const char
 switch_bool_t sofia_glue_execute_sql_callback(sofia_profile_t *profile, switch_mutex_t *mutex, char *sql, switch_core_db_callback_func_t callback,
 											  void *pdata);
 char *sofia_glue_execute_sql2str(sofia_profile_t *profile, switch_mutex_t *mutex, char *sql, char *resbuf, size_t len);
+switch_bool_t sofia_glue_execute_prepared_callback(sofia_profile_t *profile, switch_mutex_t *mutex, const char *sql,
+												   const switch_cache_db_arg_t *args, int argc, switch_core_db_callback_func_t callback, void *pdata);
 void sofia_glue_check_video_codecs(private_object_t *tech_pvt);
 void sofia_glue_del_profile(sofia_profile_t *profile);
 
@@ -1165,6 +1299,8 @@ void sofia_glue_tech_untrack(sofia_profile_t *profile, switch_core_session_t *se
 void sofia_glue_tech_track(sofia_profile_t *profile, switch_core_session_t *session);
 int sofia_glue_recover(switch_bool_t flush);
 int sofia_glue_profile_recover(sofia_profile_t *profile, switch_bool_t flush);
+void sofia_glue_replicate_start(void);
+void sofia_glue_replicate_status(switch_stream_handle_t *stream);
 void sofia_profile_destroy(sofia_profile_t *profile);
 switch_status_t sip_dig_function(_In_opt_z_ const char *cmd, _In_opt_ switch_core_session_t *session, _In_ switch_stream_handle_t *stream);
 const char *sofia_gateway_status_name(sofia_gateway_status_t status);
@@ -1174,8 +1310,62 @@ void sofia_glue_copy_t38_options(switch_t38_options_t *t38_options, switch_core_
 switch_t38_options_t *sofia_glue_extract_t38_options(switch_core_session_t *session, const char *r_sdp);
 char *sofia_glue_get_multipart(switch_core_session_t *session, const char *prefix, const char *sdp, char **mp_type);
 void sofia_glue_tech_simplify(private_object_t *tech_pvt);
+void sofia_glue_start_rtp_relay(private_object_t *tech_pvt, const char *uuid);
+void sofia_glue_check_rtp_relay(private_object_t *tech_pvt);
 switch_console_callback_match_t *sofia_reg_find_reg_url_multi(sofia_profile_t *profile, const char *user, const char *host);
 switch_console_callback_match_t *sofia_reg_find_reg_url_with_positive_expires_multi(sofia_profile_t *profile, const char *user, const char *host);
+
+typedef enum {
+	REG_COL_CALL_ID,
+	REG_COL_SIP_USER,
+	REG_COL_SIP_HOST,
+	REG_COL_PRESENCE_HOSTS,
+	REG_COL_CONTACT,
+	REG_COL_STATUS,
+	REG_COL_RPID,
+	REG_COL_EXPIRES,
+	REG_COL_USER_AGENT,
+	REG_COL_SERVER_USER,
+	REG_COL_SERVER_HOST,
+	REG_COL_PROFILE_NAME,
+	REG_COL_NETWORK_IP,
+	REG_COL_NETWORK_PORT,
+	REG_COL_SIP_USERNAME,
+	REG_COL_MAX
+} sofia_reg_col_t;
+
+void sofia_reg_store_create(sofia_profile_t *profile);
+void sofia_reg_store_destroy(sofia_profile_t *profile);
+void sofia_reg_store_load(sofia_profile_t *profile);
+uint32_t sofia_reg_store_size(sofia_profile_t *profile);
+void sofia_reg_store_add(sofia_profile_t *profile, const char *col[REG_COL_MAX], long expires);
+void sofia_reg_store_del(sofia_profile_t *profile, const char *call_id, const char *user, const char *host, const char *contact);
+void sofia_reg_store_set_expires(sofia_profile_t *profile, const char *user, const char *host, long expires);
+int sofia_reg_store_touch(sofia_profile_t *profile, const char *user, const char *host, const char *contact,
+						  const char *network_ip, const char *network_port, long expires);
+int sofia_reg_store_select(sofia_profile_t *profile, const char *user, const char *host, const char *exclude_contact,
+						   const sofia_reg_col_t *cols, int ncols, const char *extra, switch_core_db_callback_func_t callback, void *pArg);
+void sofia_reg_store_tick(sofia_profile_t *profile, time_t now);
+void sofia_reg_keepalive_start(sofia_profile_t *profile);
+void sofia_reg_keepalive_stop(sofia_profile_t *profile);
+void sofia_reg_auth_cache_create(sofia_profile_t *profile);
+void sofia_reg_auth_cache_destroy(sofia_profile_t *profile);
+void sofia_reg_auth_cache_tick(sofia_profile_t *profile, time_t now);
+uint32_t sofia_reg_auth_cache_flush(sofia_profile_t *profile, const char *user, const char *domain);
+switch_bool_t sofia_reg_auth_cache_stats(sofia_profile_t *profile, uint32_t *users, uint32_t *nonces, uint32_t *hits, uint32_t *misses);
+
+void sofia_wheel_init(sofia_wheel_t *wheel, time_t now);
+void sofia_wheel_add(sofia_wheel_t *wheel, sofia_wheel_node_t *node, time_t due);
+void sofia_wheel_del(sofia_wheel_t *wheel, sofia_wheel_node_t *node);
+sofia_wheel_node_t *sofia_wheel_advance(sofia_wheel_t *wheel, time_t now);
+#define sofia_wheel_node_linked(_node) ((_node)->pprev != NULL)
+
+void sofia_presence_sub_timers_create(sofia_profile_t *profile);
+void sofia_presence_sub_timers_destroy(sofia_profile_t *profile);
+void sofia_presence_sub_timer_set(sofia_profile_t *profile, const char *call_id, const char *sub_to_user, const char *event, time_t expires);
+switch_bool_t sofia_presence_sub_watched(sofia_profile_t *profile, const char *user, const char *event, const char *alt_event, const char *call_id);
+void sofia_presence_sub_timer_del(sofia_profile_t *profile, const char *call_id);
+void sofia_presence_sub_timers_rescan(sofia_profile_t *profile);
 switch_bool_t sofia_glue_profile_exists(const char *key);
 void sofia_glue_global_siptrace(switch_bool_t on);
 void sofia_glue_global_capture(switch_bool_t on);
@@ -1191,6 +1381,9 @@ void sofia_process_dispatch_event(sofia_dispatch_event_t **dep);
 char *sofia_glue_get_host(const char *str, switch_memory_pool_t *pool);
 void sofia_presence_check_subscriptions(sofia_profile_t *profile, time_t now);
 void sofia_msg_thread_start(int idx);
+void sofia_msg_queue_init(void);
+uint32_t sofia_msg_queue_load(void *user_data);
+void sofia_msg_queue_shutdown(void);
 
 
 /* For Emacs:
@@ -57,6 +57,8 @@ extern su_log_t su_log_default[];
 static void config_sofia_profile_urls(sofia_profile_t * profile);
 static void parse_gateways(sofia_profile_t *profile, switch_xml_t gateways_tag);
 static void parse_domain_tag(sofia_profile_t *profile, switch_xml_t x_domain_tag, const char *dname, const char *parse, const char *alias);
+static sofia_header_vars_t *parse_header_vars(sofia_profile_t *profile, const char *val);
+static switch_bool_t header_var_wanted(sofia_profile_t *profile, const char *name);
 
 void sofia_handle_sip_i_reinvite(switch_core_session_t *session,
 								 nua_t *nua, sofia_profile_t *profile, nua_handle_t *nh, sofia_private_t *sofia_private, sip_t const *sip,
@@ -93,6 +95,7 @@ void sofia_handle_sip_r_notify(switch_core_session_t *session, int status,
 		
 		sql = switch_mprintf("delete from sip_subscriptions where call_id='%q'", sip->sip_call_id->i_id);
 		switch_assert(sql != NULL);
+		sofia_presence_sub_timer_del(profile, sip->sip_call_id->i_id);
 		sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
 		nua_handle_destroy(nh);
 	}
@@ -1361,19 +1364,113 @@ void sofia_process_dispatch_event(sofia_dispatch_event_t **dep)
 static int msg_queue_threads = 0;
 //static int count = 0;
 
-void *SWITCH_THREAD_FUNC sofia_msg_thread_run(switch_thread_t *thread, void *obj)
+/* registrations, subscriptions and out of dialog traffic can wait behind call setup and teardown */
+static sofia_msg_lane_t sofia_msg_lane(sofia_dispatch_event_t *de)
 {
-	void *pop;
-	switch_queue_t *q = (switch_queue_t *) obj;
-	int my_id;
+	switch (de->data->e_event) {
+	case nua_i_register:
+	case nua_i_subscribe:
+	case nua_i_notify:
+	case nua_i_publish:
+	case nua_i_options:
+	case nua_i_message:
+	case nua_r_register:
+	case nua_r_unregister:
+	case nua_r_subscribe:
+	case nua_r_unsubscribe:
+	case nua_r_notify:
+	case nua_r_publish:
+	case nua_r_options:
+	case nua_r_message:
+		return SOFIA_MSG_LANE_BULK;
+	default:
+		return SOFIA_MSG_LANE_CALL;
+	}
+}
 
+static sofia_msg_shard_t *sofia_msg_shard(sofia_dispatch_event_t *de)
+{
+	unsigned int hash;
 
-	for (my_id = 0; my_id < mod_sofia_globals.msg_queue_len; my_id++) {
-		if (mod_sofia_globals.msg_queue_thread[my_id] == thread) {
-			break;
+	if (de->sip && de->sip->sip_call_id && !zstr(de->sip->sip_call_id->i_id)) {
+		switch_ssize_t len = (switch_ssize_t) strlen(de->sip->sip_call_id->i_id);
+		hash = switch_hashfunc_default(de->sip->sip_call_id->i_id, &len);
+	} else {
+		hash = (unsigned int) ((intptr_t) de->nh >> 4);
+	}
+
+	return &mod_sofia_globals.msg_shard[hash % mod_sofia_globals.max_msg_queues];
+}
+
+static uint32_t sofia_msg_queue_size(void)
+{
+	uint32_t size = 0;
+	int i, j;
+
+	for (i = 0; i < mod_sofia_globals.max_msg_queues; i++) {
+		for (j = 0; j < SOFIA_MSG_LANES; j++) {
+			if (mod_sofia_globals.msg_shard[i].lane[j]) {
+				size += switch_queue_size(mod_sofia_globals.msg_shard[i].lane[j]);
+			}
 		}
 	}
-	
+
+	return size;
+}
+
+/* core load source: how full the dispatch queues are, out of the point where new requests get a 503 */
+uint32_t sofia_msg_queue_load(void *user_data)
+{
+	uint32_t capacity = ((SOFIA_MSG_QUEUE_SIZE * mod_sofia_globals.max_msg_queues) * 900) / 1000;
+
+	return capacity ? (sofia_msg_queue_size() * 100) / capacity : 0;
+}
+
+static void sofia_msg_shard_push(sofia_msg_shard_t *shard, sofia_msg_lane_t lane, void *data)
+{
+	switch_queue_push(shard->lane[lane], data);
+
+	switch_mutex_lock(shard->mutex);
+	switch_thread_cond_signal(shard->cond);
+	switch_mutex_unlock(shard->mutex);
+}
+
+void sofia_msg_queue_init(void)
+{
+	int i, j;
+
+	for (i = 0; i < mod_sofia_globals.max_msg_queues; i++) {
+		sofia_msg_shard_t *shard = &mod_sofia_globals.msg_shard[i];
+
+		for (j = 0; j < SOFIA_MSG_LANES; j++) {
+			switch_queue_create(&shard->lane[j], SOFIA_MSG_QUEUE_SIZE * mod_sofia_globals.max_msg_queues, mod_sofia_globals.pool);
+		}
+		switch_mutex_init(&shard->mutex, SWITCH_MUTEX_NESTED, mod_sofia_globals.pool);
+		switch_thread_cond_create(&shard->cond, mod_sofia_globals.pool);
+	}
+}
+
+void sofia_msg_queue_shutdown(void)
+{
+	int i;
+
+	for (i = 0; mod_sofia_globals.msg_queue_thread[i]; i++) {
+		sofia_msg_shard_push(&mod_sofia_globals.msg_shard[i], SOFIA_MSG_LANE_CALL, NULL);
+	}
+
+	for (i = 0; mod_sofia_globals.msg_queue_thread[i]; i++) {
+		switch_status_t st;
+		switch_thread_join(&st, mod_sofia_globals.msg_queue_thread[i]);
+	}
+}
+
+void *SWITCH_THREAD_FUNC sofia_msg_thread_run(switch_thread_t *thread, void *obj)
+{
+	void *pop;
+	sofia_msg_shard_t *shard = (sofia_msg_shard_t *) obj;
+	int my_id = (int) (shard - mod_sofia_globals.msg_shard);
+	int burst = 0;
+
 	switch_mutex_lock(mod_sofia_globals.mutex); 
 	msg_queue_threads++;
 	switch_mutex_unlock(mod_sofia_globals.mutex); 
@@ -1382,9 +1479,25 @@ void *SWITCH_THREAD_FUNC sofia_msg_thread_run(switch_thread_t *thread, void *obj
 
 
 	for(;;) {
+		switch_status_t status = SWITCH_STATUS_FALSE;
 
-		if (switch_queue_pop(q, &pop) != SWITCH_STATUS_SUCCESS) {
-			switch_cond_next();
+		if (burst < SOFIA_MSG_CALL_BURST) {
+			if ((status = switch_queue_trypop(shard->lane[SOFIA_MSG_LANE_CALL], &pop)) == SWITCH_STATUS_SUCCESS) {
+				burst++;
+			}
+		}
+
+		if (status != SWITCH_STATUS_SUCCESS) {
+			burst = 0;
+			status = switch_queue_trypop(shard->lane[SOFIA_MSG_LANE_BULK], &pop);
+		}
+
+		if (status != SWITCH_STATUS_SUCCESS && (status = switch_queue_trypop(shard->lane[SOFIA_MSG_LANE_CALL], &pop)) != SWITCH_STATUS_SUCCESS) {
+			switch_mutex_lock(shard->mutex);
+			if (!switch_queue_size(shard->lane[SOFIA_MSG_LANE_CALL]) && !switch_queue_size(shard->lane[SOFIA_MSG_LANE_BULK])) {
+				switch_thread_cond_timedwait(shard->cond, shard->mutex, 100000);
+			}
+			switch_mutex_unlock(shard->mutex);
 			continue;
 		}
 
@@ -1397,7 +1510,7 @@ void *SWITCH_THREAD_FUNC sofia_msg_thread_run(switch_thread_t *thread, void *obj
 		}
 	}
 
-	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "MSG Thread Ended\n");
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "MSG Thread %d Ended\n", my_id);
 
 	switch_mutex_lock(mod_sofia_globals.mutex); 
 	msg_queue_threads--;
@@ -1406,6 +1519,7 @@ void *SWITCH_THREAD_FUNC sofia_msg_thread_run(switch_thread_t *thread, void *obj
 	return NULL;	
 }
 
+/* starts every thread up to and including idx, the shard a Call-ID maps to never changes so they all run from the start */
 void sofia_msg_thread_start(int idx)
 {
 
@@ -1430,7 +1544,7 @@ void sofia_msg_thread_start(int idx)
 				switch_thread_create(&mod_sofia_globals.msg_queue_thread[i], 
 									 thd_attr, 
 									 sofia_msg_thread_run, 
-									 mod_sofia_globals.msg_queue, 
+									 &mod_sofia_globals.msg_shard[i], 
 									 mod_sofia_globals.pool);
 			}
 		}
@@ -1442,9 +1556,7 @@ void sofia_msg_thread_start(int idx)
 //static int foo = 0;
 static void sofia_queue_message(sofia_dispatch_event_t *de)
 {
-	int launch = 0;
-
-	if (mod_sofia_globals.running == 0 || !mod_sofia_globals.msg_queue) {
+	if (mod_sofia_globals.running == 0 || !mod_sofia_globals.msg_queue_len) {
 		sofia_process_dispatch_event(&de);
 		return;
 	}
@@ -1455,21 +1567,176 @@ static void sofia_queue_message(sofia_dispatch_event_t *de)
 		return;
 	}
 
+	sofia_msg_shard_push(sofia_msg_shard(de), sofia_msg_lane(de), de);
+}
 
-	if ((switch_queue_size(mod_sofia_globals.msg_queue) > (SOFIA_MSG_QUEUE_SIZE * msg_queue_threads))) {
-		launch++;
+/*
+ * Overload control.  It runs on the profile thread before anything is queued, so a shed request costs a 503 and
+ * nothing else.  Only new out of dialog requests are ever shed, responses, ACK, BYE and everything in a dialog are
+ * let through because dropping them only makes more work later.  Once the message queues are oc_start permille full,
+ * OPTIONS go first, then REGISTER, then the other requests, and new INVITEs are shed by a fraction rising to all of
+ * them where the queues are 90% full.  The Retry-After grows with the load and is spread out so the retries don't all
+ * come back at once.
+ */
+
+typedef struct {
+	double tokens;
+	switch_time_t last;
+} sofia_oc_source_t;
+
+static sofia_oc_class_t sofia_oc_classify(nua_event_t event, sofia_private_t *sofia_private, sip_t const *sip)
+{
+	if (sofia_private || !sip || (sip->sip_to && sip->sip_to->a_tag)) {
+		return SOFIA_OC_KEEP;
+	}
+
+	switch (event) {
+	case nua_i_options:
+		return SOFIA_OC_OPTIONS;
+	case nua_i_register:
+		return SOFIA_OC_REGISTER;
+	case nua_i_subscribe:
+	case nua_i_publish:
+	case nua_i_message:
+	case nua_i_notify:
+		return SOFIA_OC_REQUEST;
+	case nua_i_invite:
+		return SOFIA_OC_INVITE;
+	default:
+		return SOFIA_OC_KEEP;
+	}
+}
+
+/* permille of the class to shed at a load of load permille */
+static uint32_t sofia_oc_loss(sofia_profile_t *profile, sofia_oc_class_t oc_class, uint32_t load)
+{
+	uint32_t start = profile->oc_start, step;
+
+	if (start >= 900) {
+		return 0;
 	}
 
+	step = (900 - start) / 3;
 
-	if (launch) {
-		if (mod_sofia_globals.msg_queue_len < mod_sofia_globals.max_msg_queues) {
-			sofia_msg_thread_start(mod_sofia_globals.msg_queue_len + 1);
+	switch (oc_class) {
+	case SOFIA_OC_OPTIONS:
+		return load >= start ? 1000 : 0;
+	case SOFIA_OC_REGISTER:
+		return load >= start + step ? 1000 : 0;
+	case SOFIA_OC_REQUEST:
+		return load >= start + 2 * step ? 1000 : 0;
+	case SOFIA_OC_INVITE:
+		start += 2 * step;
+		if (load <= start) {
+			return 0;
 		}
+		return load >= 900 ? 1000 : ((load - start) * 1000) / (900 - start);
+	default:
+		return 0;
 	}
+}
+
+/* token bucket per source address, a burst of twice the rate is allowed */
+static switch_bool_t sofia_oc_source_ok(sofia_profile_t *profile, nua_t *nua)
+{
+	msg_t *msg = nua_current_request(nua);
+	su_addrinfo_t *ai;
+	sofia_oc_source_t *src;
+	char ip[80];
+	switch_time_t now = switch_micro_time_now();
 
-	switch_queue_push(mod_sofia_globals.msg_queue, de);
+	if (!msg || !(ai = msg_addrinfo(msg)) || !ai->ai_addr) {
+		return SWITCH_TRUE;
+	}
+
+	get_addr(ip, sizeof(ip), ai->ai_addr, ai->ai_addrlen);
+
+	if (!profile->oc_sources || profile->oc_source_count >= SOFIA_OC_MAX_SOURCES || now - profile->oc_sweep > 60000000) {
+		sofia_oc_reset_sources(profile, now);
+	}
+
+	if (!(src = switch_core_hash_find(profile->oc_sources, ip))) {
+		switch_zmalloc(src, sizeof(*src));
+		src->tokens = profile->oc_source_rate * 2;
+		src->last = now;
+		switch_core_hash_insert(profile->oc_sources, ip, src);
+		profile->oc_source_count++;
+	}
+
+	src->tokens += (double) (now - src->last) * profile->oc_source_rate / 1000000;
+	src->last = now;
+
+	if (src->tokens > profile->oc_source_rate * 2) {
+		src->tokens = profile->oc_source_rate * 2;
+	}
+
+	if (src->tokens < 1) {
+		return SWITCH_FALSE;
+	}
+
+	src->tokens--;
+
+	return SWITCH_TRUE;
 }
 
+/* sources don't stay long, so the table is simply started over every minute or when it gets too big */
+void sofia_oc_reset_sources(sofia_profile_t *profile, switch_time_t now)
+{
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+
+	if (profile->oc_sources) {
+		while ((hi = switch_hash_first(NULL, profile->oc_sources))) {
+			switch_hash_this(hi, &var, NULL, &val);
+			switch_core_hash_delete(profile->oc_sources, var);
+			free(val);
+		}
+
+		if (!now) {
+			switch_core_hash_destroy(&profile->oc_sources);
+		}
+	} else if (now) {
+		switch_core_hash_init(&profile->oc_sources, NULL);
+	}
+
+	profile->oc_source_count = 0;
+	profile->oc_sweep = now;
+}
+
+/* returns true when the request was shed and answered */
+static switch_bool_t sofia_oc_shed(nua_event_t event, nua_t *nua, sofia_profile_t *profile, nua_handle_t *nh, sofia_private_t *sofia_private,
+								   sip_t const *sip)
+{
+	sofia_oc_class_t oc_class = sofia_oc_classify(event, sofia_private, sip);
+	uint32_t capacity = SOFIA_MSG_QUEUE_SIZE * mod_sofia_globals.max_msg_queues;
+	uint32_t load, loss;
+	char retry_after[16];
+
+	if (oc_class == SOFIA_OC_KEEP) {
+		return SWITCH_FALSE;
+	}
+
+	if (profile->oc_source_rate && !sofia_oc_source_ok(profile, nua)) {
+		profile->oc_limited++;
+		nua_respond(nh, 503, "Rate Limited", SIPTAG_RETRY_AFTER_STR("5"), TAG_END());
+		nua_handle_destroy(nh);
+		return SWITCH_TRUE;
+	}
+
+	load = capacity ? (sofia_msg_queue_size() * 1000) / capacity : 0;
+
+	if (!(loss = sofia_oc_loss(profile, oc_class, load)) || (loss < 1000 && (uint32_t) (rand() % 1000) >= loss)) {
+		return SWITCH_FALSE;
+	}
+
+	profile->oc_shed[oc_class]++;
+	switch_snprintf(retry_after, sizeof(retry_after), "%d", 1 + (int) (load / 100) + rand() % 5);
+	nua_respond(nh, 503, "Server Overloaded", SIPTAG_RETRY_AFTER_STR(retry_after), TAG_END());
+	nua_handle_destroy(nh);
+
+	return SWITCH_TRUE;
+}
 
 void sofia_event_callback(nua_event_t event,
 						  int status,
@@ -1481,11 +1748,15 @@ void sofia_event_callback(nua_event_t event,
 	int critical = (((SOFIA_MSG_QUEUE_SIZE * mod_sofia_globals.max_msg_queues) * 900) / 1000);
 
 
-	if (switch_queue_size(mod_sofia_globals.msg_queue) > critical) {
+	if (sofia_msg_queue_size() > critical) {
 		nua_respond(nh, 503, "System Busy", SIPTAG_RETRY_AFTER_STR("300"), TAG_END());
 		return;
 	}
 
+	if (sofia_test_pflag(profile, PFLAG_OVERLOAD_CONTROL) && sofia_oc_shed(event, nua, profile, nh, sofia_private, sip)) {
+		return;
+	}
+
 	if (sofia_test_pflag(profile, PFLAG_STANDBY)) {
 		if (event < nua_r_set_params || event > nua_r_authenticate) {
 			nua_respond(nh, 503, "System Paused", TAG_END());
@@ -1684,9 +1955,39 @@ void event_handler(switch_event_t *event)
 		}
 
 		switch_mutex_lock(profile->ireg_mutex);
-		sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+		if (sofia_test_pflag(profile, PFLAG_MULTIREG)) {
+			sofia_reg_store_del(profile, call_id, NULL, NULL, NULL);
+		} else {
+			sofia_reg_store_del(profile, NULL, from_user, from_host, NULL);
+		}
+
+		if (profile->reg_store_mode == 2) {
+			switch_safe_free(sql);
+		} else {
+			sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+		}
 
 		switch_find_local_ip(guess_ip4, sizeof(guess_ip4), NULL, AF_INET);
+
+		if (profile->reg_store) {
+			const char *col[REG_COL_MAX] = { 0 };
+
+			col[REG_COL_CALL_ID] = call_id;
+			col[REG_COL_SIP_USER] = from_user;
+			col[REG_COL_SIP_HOST] = from_host;
+			col[REG_COL_PRESENCE_HOSTS] = presence_hosts;
+			col[REG_COL_CONTACT] = contact_str;
+			col[REG_COL_STATUS] = "Registered";
+			col[REG_COL_RPID] = rpid;
+			col[REG_COL_USER_AGENT] = user_agent;
+			col[REG_COL_SERVER_USER] = to_user;
+			col[REG_COL_SERVER_HOST] = guess_ip4;
+			col[REG_COL_NETWORK_IP] = network_ip;
+			col[REG_COL_NETWORK_PORT] = network_port;
+			col[REG_COL_SIP_USERNAME] = username;
+			sofia_reg_store_add(profile, col, expires);
+		}
+
 		sql = switch_mprintf("insert into sip_registrations "
 							 "(call_id, sip_user, sip_host, presence_hosts, contact, status, rpid, expires,"
 							 "user_agent, server_user, server_host, profile_name, hostname, network_ip, network_port, sip_username, sip_realm," 
@@ -1696,6 +1997,10 @@ void event_handler(switch_event_t *event)
 							 profile_name, mod_sofia_globals.hostname, network_ip, network_port, username, realm, mwi_user, mwi_host,
 							 orig_server_host, orig_hostname);
 
+		if (profile->reg_store_mode == 2) {
+			switch_safe_free(sql);
+		}
+
 		if (sql) {
 			sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Propagating registration for %s@%s->%s\n", from_user, from_host, contact_str);
@@ -1753,6 +2058,45 @@ void watchdog_triggered_abort(void) {
 
 
 #define SQLLEN 1024 * 1024
+
+/* statements per transaction, grown while the queue stays deeper than a batch and cut back when a commit gets slow */
+#define SQL_BATCH_MIN 128
+#define SQL_BATCH_DEFAULT 1024
+#define SQL_BATCH_MAX 16384
+#define SQL_COMMIT_TARGET_MS 250
+
+static void sofia_sql_batch_adapt(sofia_profile_t *profile, uint32_t statements, uint32_t took)
+{
+	uint32_t depth = switch_queue_size(profile->sql_queue);
+
+	profile->sql_commits++;
+	profile->sql_committed += statements;
+	profile->sql_commit_last_ms = took;
+	profile->sql_commit_total_ms += took;
+
+	if (took > profile->sql_commit_max_ms) {
+		profile->sql_commit_max_ms = took;
+	}
+
+	if (depth > profile->sql_queue_max_depth) {
+		profile->sql_queue_max_depth = depth;
+	}
+
+	if (took > SQL_COMMIT_TARGET_MS) {
+		if (profile->sql_batch_max > SQL_BATCH_MIN) {
+			profile->sql_batch_max /= 2;
+		}
+	} else if (depth > profile->sql_batch_max && statements >= profile->sql_batch_max) {
+		if (profile->sql_batch_max < SQL_BATCH_MAX) {
+			profile->sql_batch_max *= 2;
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Profile %s: %u queued sql statements, batching %u per commit\n",
+							  profile->name, depth, profile->sql_batch_max);
+		}
+	} else if (depth < profile->sql_batch_max / 4 && profile->sql_batch_max > SQL_BATCH_DEFAULT) {
+		profile->sql_batch_max /= 2;
+	}
+}
+
 void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread, void *obj)
 {
 	sofia_profile_t *profile = (sofia_profile_t *) obj;
@@ -1773,6 +2117,9 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 		sqlbuf = (char *) malloc(sql_len);
 	}
 
+	profile->sql_worker_id = switch_thread_self();
+	profile->sql_batch_max = SQL_BATCH_DEFAULT;
+
 	sofia_set_pflag_locked(profile, PFLAG_WORKER_RUNNING);
 
 	switch_queue_create(&profile->sql_queue, SOFIA_QUEUE_SIZE, profile->pool);
@@ -1784,7 +2131,7 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 			/* Do we have enough statements or is the timeout expired */
 			while (sql || (sofia_test_pflag(profile, PFLAG_RUNNING) && mod_sofia_globals.running == 1 &&
 						switch_micro_time_now() - last_check < 1000000 &&
-				    	(statements == 0 || (statements <= 1024 && (switch_micro_time_now() - last_commit)/1000 < profile->trans_timeout)))) {
+				    	(statements == 0 || (statements <= profile->sql_batch_max && (switch_micro_time_now() - last_commit)/1000 < profile->trans_timeout)))) {
 				
 				switch_interval_time_t sleepy_time = !statements ? 1000000 : switch_micro_time_now() - last_commit - profile->trans_timeout*1000;
 
@@ -1802,7 +2149,8 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 					if (len + newlen + 10 > sql_len) {
 						switch_size_t new_mlen = len + newlen + 10 + 10240;
 						
-						if (new_mlen < SQLLEN) {
+						/* bigger batches get a proportionally bigger buffer */
+						if (new_mlen < (switch_size_t) SQLLEN * (profile->sql_batch_max > SQL_BATCH_DEFAULT ? profile->sql_batch_max / SQL_BATCH_DEFAULT : 1)) {
 							sql_len = new_mlen;
 							
 							if (!(tmp = realloc(sqlbuf, sql_len))) {
@@ -1828,11 +2176,14 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 			last_commit = switch_micro_time_now();
 			
 			if (len) {
+				switch_time_t started = last_commit;
+
 				//printf("TRANS:\n%s\n", sqlbuf);
 				switch_mutex_lock(profile->ireg_mutex);
 				sofia_glue_actually_execute_sql_trans(profile, sqlbuf, NULL);
 				//sofia_glue_actually_execute_sql(profile, "commit;\n", NULL);
 				switch_mutex_unlock(profile->ireg_mutex);
+				sofia_sql_batch_adapt(profile, statements, (uint32_t) ((switch_micro_time_now() - started) / 1000));
 				statements = 0;
 				len = 0;
 			}
@@ -1890,6 +2241,8 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 				}
 			
 				sofia_sub_check_gateway(profile, time(NULL));
+				sofia_reg_store_tick(profile, switch_epoch_time_now(NULL));
+				sofia_reg_auth_cache_tick(profile, switch_epoch_time_now(NULL));
 			}
 			
 			last_check = switch_micro_time_now();
@@ -2009,11 +2362,14 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 	int sanity;
 	switch_thread_t *worker_thread;
 	switch_status_t st;
+	char load_name[128];
 
 	switch_mutex_lock(mod_sofia_globals.mutex);
 	mod_sofia_globals.threads++;
 	switch_mutex_unlock(mod_sofia_globals.mutex);
 
+	switch_core_thread_set_role_affinity(SWITCH_THREAD_ROLE_SIGNALING);
+
 	profile->s_root = su_root_create(NULL);
 	//profile->home = su_home_new(sizeof(*profile->home));
 
@@ -2026,6 +2382,11 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 		goto end;
 	}
 
+	sofia_reg_store_create(profile);
+	sofia_reg_store_load(profile);
+	sofia_reg_auth_cache_create(profile);
+	sofia_presence_sub_timers_create(profile);
+
 	supported = switch_core_sprintf(profile->pool, "%s%s%sprecondition, path, replaces", use_100rel ? "100rel, " : "", use_timer ? "timer, " : "", use_rfc_5626 ? "outbound, " : "");
 
 	if (sofia_test_pflag(profile, PFLAG_AUTO_NAT) && switch_nat_get_type()) {
@@ -2071,6 +2432,13 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 									  TPTAG_TLS_VERIFY_SUBJECTS(profile->tls_verify_in_subjects)),
 							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS),
 									 TPTAG_TLS_VERSION(profile->tls_version)),
+							  TAG_IF(mod_sofia_globals.sres_cache, SRESTAG_CACHE(mod_sofia_globals.sres_cache)),
+							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS) && profile->tls_session_cache_size,
+									 TPTAG_TLS_SESSION_CACHE_SIZE(profile->tls_session_cache_size)),
+							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS) && profile->tls_session_timeout,
+									 TPTAG_TLS_SESSION_TIMEOUT(profile->tls_session_timeout)),
+							  TAG_IF(sofia_test_pflag(profile, PFLAG_TLS) && profile->tls_ticket_keys,
+									 TPTAG_TLS_TICKET_KEYS(profile->tls_ticket_keys)),
 							  TAG_IF(!strchr(profile->sipip, ':'),
 									 NTATAG_UDP_MTU(65535)),
 							  TAG_IF(sofia_test_pflag(profile, PFLAG_DISABLE_SRV),
@@ -2217,11 +2585,20 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 	switch_yield(1000000);
 
 
+	sofia_reg_keepalive_start(profile);
+
+	/* every SIP message of the profile goes through this thread */
+	switch_snprintf(load_name, sizeof(load_name), "sofia-%s", profile->name);
+	switch_core_add_thread_load_source(load_name);
+
 	while (mod_sofia_globals.running == 1 && sofia_test_pflag(profile, PFLAG_RUNNING) && sofia_test_pflag(profile, PFLAG_WORKER_RUNNING)) {
 		su_root_step(profile->s_root, 1000);
 		profile->last_root_step = switch_time_now();
 	}
 
+	switch_core_remove_load_source(load_name);
+	sofia_reg_keepalive_stop(profile);
+
 	sofia_clear_pflag_locked(profile, PFLAG_RUNNING);
 
 	switch_core_session_hupall_matching_var("sofia_profile_name", profile->name, SWITCH_CAUSE_MANAGER_REQUEST);
@@ -2266,6 +2643,9 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 	nua_destroy(profile->nua);
 
 	switch_mutex_lock(profile->ireg_mutex);
+	sofia_reg_store_destroy(profile);
+	sofia_reg_auth_cache_destroy(profile);
+	sofia_presence_sub_timers_destroy(profile);
 	switch_mutex_unlock(profile->ireg_mutex);
 
 	switch_mutex_lock(profile->flag_mutex);
@@ -2309,6 +2689,8 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 	sofia_glue_del_profile(profile);
 	switch_core_hash_destroy(&profile->chat_hash);
 	switch_core_hash_destroy(&profile->mwi_debounce_hash);
+	sofia_oc_reset_sources(profile, 0);
+	sofia_glue_codec_cache_destroy(profile);
 	
 	switch_thread_rwlock_unlock(profile->rwlock);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Write unlock %s\n", profile->name);
@@ -2800,7 +3182,8 @@ static void parse_gateways(sofia_profile_t *profile, switch_xml_t gateways_tag)
 					gateway->ping_freq = ping_freq;
 					gateway->ping_max = ping_max;
 					gateway->ping_min = ping_min;
-					gateway->ping = switch_epoch_time_now(NULL) + ping_freq;
+					/* the first ping anywhere in the first period, so gateways loaded together don't all ping together */
+					gateway->ping = switch_epoch_time_now(NULL) + 1 + rand() % ping_freq;
 					gateway->options_to_uri = switch_core_sprintf(gateway->pool, "<sip:%s>",
 						!zstr(from_domain) ? from_domain : proxy);
 					gateway->options_from_uri = gateway->options_to_uri;
@@ -2934,6 +3317,80 @@ static void parse_domain_tag(sofia_profile_t *profile, switch_xml_t x_domain_tag
 	}
 }
 
+static int header_name_cmp(const void *a, const void *b)
+{
+	return strcasecmp(*(char * const *) a, *(char * const *) b);
+}
+
+/* "all" (the default) for every X-/P- header, otherwise a comma separated list of names and Name-* prefixes */
+static sofia_header_vars_t *parse_header_vars(sofia_profile_t *profile, const char *val)
+{
+	sofia_header_vars_t *hv;
+	char *dup, *argv[256] = { 0 };
+	int argc, i;
+
+	if (zstr(val) || !strcasecmp(val, "all")) {
+		return NULL;
+	}
+
+	hv = switch_core_alloc(profile->pool, sizeof(*hv));
+	dup = switch_core_strdup(profile->pool, val);
+	argc = switch_separate_string(dup, ',', argv, (sizeof(argv) / sizeof(argv[0])));
+
+	hv->names = switch_core_alloc(profile->pool, sizeof(char *) * (argc + 1));
+	hv->prefixes = switch_core_alloc(profile->pool, sizeof(char *) * (argc + 1));
+
+	for (i = 0; i < argc; i++) {
+		char *name = argv[i];
+		switch_size_t len;
+
+		while (*name == ' ') {
+			name++;
+		}
+
+		if (!strcasecmp(name, "none") || !(len = strlen(name))) {
+			continue;
+		}
+
+		while (len && name[len - 1] == ' ') {
+			name[--len] = '\0';
+		}
+
+		if (name[len - 1] == '*') {
+			name[len - 1] = '\0';
+			hv->prefixes[hv->nprefixes++] = name;
+		} else {
+			hv->names[hv->nnames++] = name;
+		}
+	}
+
+	qsort(hv->names, hv->nnames, sizeof(char *), header_name_cmp);
+
+	return hv;
+}
+
+static switch_bool_t header_var_wanted(sofia_profile_t *profile, const char *name)
+{
+	sofia_header_vars_t *hv = profile->header_vars;
+	int i;
+
+	if (!hv) {
+		return SWITCH_TRUE;
+	}
+
+	if (hv->nnames && bsearch(&name, hv->names, hv->nnames, sizeof(char *), header_name_cmp)) {
+		return SWITCH_TRUE;
+	}
+
+	for (i = 0; i < hv->nprefixes; i++) {
+		if (!strncasecmp(name, hv->prefixes[i], strlen(hv->prefixes[i]))) {
+			return SWITCH_TRUE;
+		}
+	}
+
+	return SWITCH_FALSE;
+}
+
 static void config_sofia_profile_urls(sofia_profile_t * profile)
 {
 
@@ -3053,6 +3510,12 @@ switch_status_t reconfig_sofia(sofia_profile_t *profile)
 				mod_sofia_globals.debug_presence = atoi(val);
 			} else if (!strcasecmp(var, "debug-sla")) {
 				mod_sofia_globals.debug_sla = atoi(val);
+			} else if (!strcasecmp(var, "presence-coalesce-ms")) {
+				int ms = atoi(val);
+				mod_sofia_globals.presence_coalesce_ms = ms > 0 ? (uint32_t) ms : 0;
+			} else if (!strcasecmp(var, "mwi-coalesce-ms")) {
+				int ms = atoi(val);
+				mod_sofia_globals.mwi_coalesce_ms = ms > 0 ? (uint32_t) ms : 0;
 			} else if (!strcasecmp(var, "auto-restart")) {
 				mod_sofia_globals.auto_restart = switch_true(val);
 			} else if (!strcasecmp(var, "reg-deny-binding-fetch-and-no-lookup")) {          /* backwards compatibility */
@@ -3143,6 +3606,12 @@ switch_status_t reconfig_sofia(sofia_profile_t *profile)
 						} else {
 							sofia_clear_pflag(profile, PFLAG_DISABLE_HOLD);
 						}
+					} else if (!strcasecmp(var, "rtp-tx-batch")) {
+						if (!zstr(val) && strcasecmp(val, "false")) {
+							profile->rtp_tx_batch = switch_core_strdup(profile->pool, val);
+						} else {
+							profile->rtp_tx_batch = NULL;
+						}
 					} else if (!strcasecmp(var, "auto-jitterbuffer-msec")) {
 						int msec = atoi(val);
 						if (msec > 19) {
@@ -3346,6 +3815,12 @@ switch_status_t reconfig_sofia(sofia_profile_t *profile)
 						} else {
 							sofia_clear_pflag(profile, PFLAG_RTP_AUTOFLUSH_DURING_BRIDGE);
 						}
+					} else if (!strcasecmp(var, "rtp-relay-during-bridge")) {
+						if (switch_true(val)) {
+							sofia_set_pflag(profile, PFLAG_RTP_RELAY_DURING_BRIDGE);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_RTP_RELAY_DURING_BRIDGE);
+						}
 					} else if (!strcasecmp(var, "rtp-notimer-during-bridge")) {
 						if (switch_true(val)) {
 							sofia_set_pflag(profile, PFLAG_RTP_NOTIMER_DURING_BRIDGE);
@@ -3521,6 +3996,12 @@ switch_status_t reconfig_sofia(sofia_profile_t *profile)
 						} else {
 							sofia_clear_pflag(profile, PFLAG_AUTOFLUSH);
 						}
+					} else if (!strcasecmp(var, "rtp-reactor")) {
+						if (switch_true(val)) {
+							sofia_set_pflag(profile, PFLAG_RTP_REACTOR);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_RTP_REACTOR);
+						}
 					} else if (!strcasecmp(var, "rtp-autofix-timing")) {
 						if (switch_true(val)) {
 							sofia_set_pflag(profile, PFLAG_AUTOFIX_TIMING);
@@ -3533,6 +4014,12 @@ switch_status_t reconfig_sofia(sofia_profile_t *profile)
 						} else {
 							sofia_clear_pflag(profile, PFLAG_NAT_OPTIONS_PING);
 						}
+					} else if (!strcasecmp(var, "nat-keepalive")) {
+						if (!strcasecmp(val, "crlf")) {
+							sofia_set_pflag(profile, PFLAG_NAT_KEEPALIVE_CRLF);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_NAT_KEEPALIVE_CRLF);
+						}
 					} else if (!strcasecmp(var, "all-reg-options-ping")) {
 						if (switch_true(val)) {
 							sofia_set_pflag(profile, PFLAG_ALL_REG_OPTIONS_PING);
@@ -3612,6 +4099,12 @@ switch_status_t reconfig_sofia(sofia_profile_t *profile)
 						}
 					} else if (!strcasecmp(var, "nonce-ttl")) {
 						profile->nonce_ttl = atoi(val);
+					} else if (!strcasecmp(var, "auth-user-cache-ttl")) {
+						int v = atoi(val);
+						profile->auth_user_cache_ttl = v > 0 ? (uint32_t) v : 0;
+					} else if (!strcasecmp(var, "auth-user-negative-cache-ttl")) {
+						int v = atoi(val);
+						profile->auth_user_negative_cache_ttl = v > 0 ? (uint32_t) v : 0;
 					} else if (!strcasecmp(var, "dialplan")) {
 						profile->dialplan = switch_core_strdup(profile->pool, val);
 					} else if (!strcasecmp(var, "max-calls")) {
@@ -3666,12 +4159,31 @@ switch_status_t reconfig_sofia(sofia_profile_t *profile)
 							profile->timer_t4 = 4000;
 						}
 						nua_set_params(profile->nua, NTATAG_SIP_T4(profile->timer_t4), TAG_END());
+					} else if (!strcasecmp(var, "overload-control")) {
+						if (switch_true(val)) {
+							sofia_set_pflag(profile, PFLAG_OVERLOAD_CONTROL);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_OVERLOAD_CONTROL);
+						}
+					} else if (!strcasecmp(var, "overload-shed-start")) {
+						int v = atoi(val);
+						if (v > 0 && v < 90) {
+							profile->oc_start = v * 10;
+						}
+					} else if (!strcasecmp(var, "rate-limit-per-source")) {
+						int v = atoi(val);
+						profile->oc_source_rate = v > 0 ? v : 0;
 					} else if (!strcasecmp(var, "sip-options-respond-503-on-busy")) {
                                                 if (switch_true(val)) {
                                                         sofia_set_pflag(profile, PFLAG_OPTIONS_RESPOND_503_ON_BUSY);
                                                 } else {
                                                         sofia_clear_pflag(profile, PFLAG_OPTIONS_RESPOND_503_ON_BUSY);
                                                 }
+					} else if (!strcasecmp(var, "gateway-register-burst")) {
+						int v = atoi(val);
+						profile->gateway_register_burst = v > 0 ? v : 0;
+					} else if (!strcasecmp(var, "sip-header-vars")) {
+						profile->header_vars = parse_header_vars(profile, val);
 					} else if (!strcasecmp(var, "sip-force-expires")) {
 						int32_t sip_force_expires = atoi(val);
 						if (sip_force_expires >= 0) {
@@ -3790,6 +4302,8 @@ switch_status_t config_sofia(int reload, char *profile_name)
 			return SWITCH_STATUS_FALSE;
 		}
 
+		mod_sofia_globals.sres_cache = sres_cache_new(0);
+
 		/* Redirect loggers in sofia */
 		su_log_redirect(su_log_default, logger, NULL);
 		su_log_redirect(tport_log, logger, NULL);
@@ -3839,6 +4353,12 @@ switch_status_t config_sofia(int reload, char *profile_name)
 				mod_sofia_globals.debug_presence = atoi(val);
 			} else if (!strcasecmp(var, "debug-sla")) {
 				mod_sofia_globals.debug_sla = atoi(val);
+			} else if (!strcasecmp(var, "presence-coalesce-ms")) {
+				int ms = atoi(val);
+				mod_sofia_globals.presence_coalesce_ms = ms > 0 ? (uint32_t) ms : 0;
+			} else if (!strcasecmp(var, "mwi-coalesce-ms")) {
+				int ms = atoi(val);
+				mod_sofia_globals.mwi_coalesce_ms = ms > 0 ? (uint32_t) ms : 0;
 			} else if (!strcasecmp(var, "auto-restart")) {
 				mod_sofia_globals.auto_restart = switch_true(val);
 			} else if (!strcasecmp(var, "reg-deny-binding-fetch-and-no-lookup")) {          /* backwards compatibility */
@@ -3862,6 +4382,11 @@ switch_status_t config_sofia(int reload, char *profile_name)
 			else if (!strcasecmp(var, "capture-server")) {
                                  mod_sofia_globals.capture_server = switch_core_strdup(mod_sofia_globals.pool, val);
                         }
+			else if (!strcasecmp(var, "replicate-to") && !zstr(val)) {
+				mod_sofia_globals.replicate_to = switch_core_strdup(mod_sofia_globals.pool, val);
+			} else if (!strcasecmp(var, "replicate-listen") && !zstr(val)) {
+				mod_sofia_globals.replicate_listen = switch_core_strdup(mod_sofia_globals.pool, val);
+			}
 		}
 	}
 
@@ -3923,10 +4448,13 @@ switch_status_t config_sofia(int reload, char *profile_name)
 				profile->dbname = switch_core_strdup(profile->pool, url);
 				switch_core_hash_init(&profile->chat_hash, profile->pool);
 				switch_core_hash_init(&profile->mwi_debounce_hash, profile->pool);
+				switch_mutex_init(&profile->codec_cache_mutex, SWITCH_MUTEX_NESTED, profile->pool);
 				switch_thread_rwlock_create(&profile->rwlock, profile->pool);
 				switch_mutex_init(&profile->flag_mutex, SWITCH_MUTEX_NESTED, profile->pool);
 				profile->dtmf_duration = 100;
 				profile->rtp_digit_delay = 40;
+				profile->oc_start = 500;
+				profile->gateway_register_burst = 200;
 				profile->sip_force_expires = 0;
 				profile->sip_expires_max_deviation = 0;
 				profile->tls_version = 0;
@@ -4115,6 +4643,12 @@ switch_status_t config_sofia(int reload, char *profile_name)
 						} else {
 							sofia_clear_pflag(profile, PFLAG_DISABLE_HOLD);
 						}
+					} else if (!strcasecmp(var, "rtp-tx-batch")) {
+						if (!zstr(val) && strcasecmp(val, "false")) {
+							profile->rtp_tx_batch = switch_core_strdup(profile->pool, val);
+						} else {
+							profile->rtp_tx_batch = NULL;
+						}
 					} else if (!strcasecmp(var, "auto-jitterbuffer-msec")) {
 						int msec = atoi(val);
 						if (msec > 19) {
@@ -4168,6 +4702,12 @@ switch_status_t config_sofia(int reload, char *profile_name)
 						} else {
 							sofia_clear_pflag(profile, PFLAG_RTP_AUTOFLUSH_DURING_BRIDGE);
 						}
+					} else if (!strcasecmp(var, "rtp-relay-during-bridge")) {
+						if (switch_true(val)) {
+							sofia_set_pflag(profile, PFLAG_RTP_RELAY_DURING_BRIDGE);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_RTP_RELAY_DURING_BRIDGE);
+						}
 					} else if (!strcasecmp(var, "rtp-notimer-during-bridge")) {
 						if (switch_true(val)) {
 							sofia_set_pflag(profile, PFLAG_RTP_NOTIMER_DURING_BRIDGE);
@@ -4259,6 +4799,16 @@ switch_status_t config_sofia(int reload, char *profile_name)
 						profile->user_agent_filter = switch_core_strdup(profile->pool, val);
 					} else if (!strcasecmp(var, "max-registrations-per-extension")) {
 						profile->max_registrations_perext = atoi(val);
+					} else if (!strcasecmp(var, "auth-nonce-store")) {
+						profile->auth_nonce_memory = !strcasecmp(val, "memory");
+					} else if (!strcasecmp(var, "registration-store")) {
+						if (!strcasecmp(val, "memory-only")) {
+							profile->reg_store_mode = 2;
+						} else if (switch_true(val)) {
+							profile->reg_store_mode = 1;
+						} else {
+							profile->reg_store_mode = 0;
+						}
 					} else if (!strcasecmp(var, "rfc2833-pt")) {
 						profile->te = (switch_payload_t) atoi(val);
 					} else if (!strcasecmp(var, "cng-pt") && !sofia_test_pflag(profile, PFLAG_SUPPRESS_CNG)) {
@@ -4398,6 +4948,9 @@ switch_status_t config_sofia(int reload, char *profile_name)
 						if (v_max_proceeding >= 0) {
 							profile->max_proceeding = v_max_proceeding;
 						}
+					} else if (!strcasecmp(var, "notify-rate-limit")) {
+						int v = atoi(val);
+						profile->notify_rate_limit = v > 0 ? (uint32_t) v : 0;
 					} else if (!strcasecmp(var, "rtp-timeout-sec")) {
 						int v = atoi(val);
 						if (v >= 0) {
@@ -4519,6 +5072,12 @@ switch_status_t config_sofia(int reload, char *profile_name)
 						} else {
 							sofia_clear_pflag(profile, PFLAG_AUTOFLUSH);
 						}
+					} else if (!strcasecmp(var, "rtp-reactor")) {
+						if (switch_true(val)) {
+							sofia_set_pflag(profile, PFLAG_RTP_REACTOR);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_RTP_REACTOR);
+						}
 					} else if (!strcasecmp(var, "rtp-autofix-timing")) {
 						if (switch_true(val)) {
 							sofia_set_pflag(profile, PFLAG_AUTOFIX_TIMING);
@@ -4533,6 +5092,12 @@ switch_status_t config_sofia(int reload, char *profile_name)
 						} else {
 							sofia_clear_pflag(profile, PFLAG_NAT_OPTIONS_PING);
 						}
+					} else if (!strcasecmp(var, "nat-keepalive")) {
+						if (!strcasecmp(val, "crlf")) {
+							sofia_set_pflag(profile, PFLAG_NAT_KEEPALIVE_CRLF);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_NAT_KEEPALIVE_CRLF);
+						}
 					} else if (!strcasecmp(var, "all-reg-options-ping")) { 
 						if (switch_true(val)) {
 							sofia_set_pflag(profile, PFLAG_ALL_REG_OPTIONS_PING);
@@ -4569,6 +5134,12 @@ switch_status_t config_sofia(int reload, char *profile_name)
 						}
 					} else if (!strcasecmp(var, "nonce-ttl")) {
 						profile->nonce_ttl = atoi(val);
+					} else if (!strcasecmp(var, "auth-user-cache-ttl")) {
+						int v = atoi(val);
+						profile->auth_user_cache_ttl = v > 0 ? (uint32_t) v : 0;
+					} else if (!strcasecmp(var, "auth-user-negative-cache-ttl")) {
+						int v = atoi(val);
+						profile->auth_user_negative_cache_ttl = v > 0 ? (uint32_t) v : 0;
 					} else if (!strcasecmp(var, "accept-blind-reg")) {
 						if (switch_true(val)) {
 							sofia_set_pflag(profile, PFLAG_BLIND_REG);
@@ -4743,6 +5314,14 @@ switch_status_t config_sofia(int reload, char *profile_name)
 						profile->tls_passphrase = switch_core_strdup(profile->pool, val);
 					} else if (!strcasecmp(var, "tls-verify-in-subjects")) {
 						profile->tls_verify_in_subjects_str = switch_core_strdup(profile->pool, val);
+					} else if (!strcasecmp(var, "tls-session-cache-size")) {
+						int v = atoi(val);
+						profile->tls_session_cache_size = v > 0 ? v : 0;
+					} else if (!strcasecmp(var, "tls-session-timeout")) {
+						int v = atoi(val);
+						profile->tls_session_timeout = v > 0 ? v : 0;
+					} else if (!strcasecmp(var, "tls-ticket-keys")) {
+						profile->tls_ticket_keys = zstr(val) ? NULL : switch_core_strdup(profile->pool, val);
 					} else if (!strcasecmp(var, "tls-version")) {
 
 						if (!strcasecmp(val, "tlsv1")) {
@@ -4778,12 +5357,33 @@ switch_status_t config_sofia(int reload, char *profile_name)
 						} else {
 							profile->timer_t4 = 4000;
 						}
+					} else if (!strcasecmp(var, "overload-control")) {
+						if (switch_true(val)) {
+							sofia_set_pflag(profile, PFLAG_OVERLOAD_CONTROL);
+						} else {
+							sofia_clear_pflag(profile, PFLAG_OVERLOAD_CONTROL);
+						}
+					} else if (!strcasecmp(var, "overload-shed-start")) {
+						int v = atoi(val);
+						if (v > 0 && v < 90) {
+							profile->oc_start = v * 10;
+						} else {
+							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "overload-shed-start must be between 1 and 89 (percent)\n");
+						}
+					} else if (!strcasecmp(var, "rate-limit-per-source")) {
+						int v = atoi(val);
+						profile->oc_source_rate = v > 0 ? v : 0;
                                         } else if (!strcasecmp(var, "sip-options-respond-503-on-busy")) {
                                                 if (switch_true(val)) {
                                                         sofia_set_pflag(profile, PFLAG_OPTIONS_RESPOND_503_ON_BUSY);
                                                 } else {
                                                         sofia_clear_pflag(profile, PFLAG_OPTIONS_RESPOND_503_ON_BUSY);
                                                 }
+					} else if (!strcasecmp(var, "gateway-register-burst")) {
+						int v = atoi(val);
+						profile->gateway_register_burst = v > 0 ? v : 0;
+					} else if (!strcasecmp(var, "sip-header-vars")) {
+						profile->header_vars = parse_header_vars(profile, val);
 					} else if (!strcasecmp(var, "sip-force-expires")) {
 						int32_t sip_force_expires = atoi(val);
 						if (sip_force_expires >= 0) {
@@ -5021,7 +5621,7 @@ static void sofia_handle_sip_r_options(switch_core_session_t *session, int statu
 							  gateway->name, status, gateway->ping_min, gateway->ping_count, gateway->ping_max, sofia_gateway_status_name(gateway->status));
 		}
 
-		gateway->ping = switch_epoch_time_now(NULL) + gateway->ping_freq;
+		gateway->ping = switch_epoch_time_now(NULL) + gateway->ping_freq - sofia_reg_jitter(gateway->ping_freq);
 		sofia_reg_release_gateway(gateway);
 		gateway->pinging = 0;
 	} else if (sofia_test_pflag(profile, PFLAG_UNREG_OPTIONS_FAIL) && (status != 200 && status != 486) && sip && sip->sip_to) {
@@ -5032,7 +5632,12 @@ static void sofia_handle_sip_r_options(switch_core_session_t *session, int statu
 
 		sql = switch_mprintf("update sip_registrations set expires=%ld where sip_user='%s' and sip_host='%s'",
 							 (long) now, sip->sip_to->a_url->url_user, sip->sip_to->a_url->url_host);
-		sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+		sofia_reg_store_set_expires(profile, sip->sip_to->a_url->url_user, sip->sip_to->a_url->url_host, (long) now);
+		if (profile->reg_store_mode == 2) {
+			switch_safe_free(sql);
+		} else {
+			sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+		}
 	}
 }
 
@@ -7951,7 +8556,13 @@ void sofia_handle_sip_i_invite(nua_t *nua, sofia_profile_t *profile, nua_handle_
 	}
 
 	if (!session) {
-		nua_respond(nh, 503, "Maximum Calls In Progress", SIPTAG_RETRY_AFTER_STR("300"), TAG_END());
+		int32_t max_load = switch_core_max_component_load(-1);
+
+		if (max_load && switch_core_component_load(NULL, 0) >= (uint32_t) max_load) {
+			nua_respond(nh, 503, "Server Overloaded", SIPTAG_RETRY_AFTER_STR("5"), TAG_END());
+		} else {
+			nua_respond(nh, 503, "Maximum Calls In Progress", SIPTAG_RETRY_AFTER_STR("300"), TAG_END());
+		}
 		goto fail;
 	}
 
@@ -8734,24 +9345,22 @@ void sofia_handle_sip_i_invite(nua_t *nua, sofia_profile_t *profile, nua_handle_
 			} else if (!strcasecmp(un->un_name, "X-FS-Support")) {
 				tech_pvt->x_freeswitch_support_remote = switch_core_session_strdup(session, un->un_value);
 			} else if (!strncasecmp(un->un_name, "X-", 2) || !strncasecmp(un->un_name, "P-", 2)) {
-				if (!zstr(un->un_value)) {
+				if (!zstr(un->un_value) && header_var_wanted(profile, un->un_name)) {
 					char new_name[512] = "";
+					switch_size_t len;
 					int reps = 0;
-					for (;;) {
-						char postfix[25] = "";
-						if (reps > 0) {
-							switch_snprintf(postfix, sizeof(postfix), "-%d", reps);
-						}
-						reps++;
-						switch_snprintf(new_name, sizeof(new_name), "%s%s%s", SOFIA_SIP_HEADER_PREFIX, un->un_name, postfix);
 
-						if (switch_channel_get_variable(channel, new_name)) {
-							continue;
-						}
+					/* the name is written once, a repeated header only rewrites the -N on the end */
+					len = switch_snprintf(new_name, sizeof(new_name), "%s%s", SOFIA_SIP_HEADER_PREFIX, un->un_name);
+					if (len > sizeof(new_name) - 16) {
+						len = sizeof(new_name) - 16;
+					}
 
-						switch_channel_set_variable(channel, new_name, un->un_value);
-						break;
+					while (switch_channel_get_variable(channel, new_name)) {
+						switch_snprintf(new_name + len, sizeof(new_name) - len, "-%d", ++reps);
 					}
+
+					switch_channel_set_variable(channel, new_name, un->un_value);
 				}
 			}
 		}
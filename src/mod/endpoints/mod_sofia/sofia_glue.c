@@ -39,9 +39,43 @@
 switch_cache_db_handle_t *sofia_glue_get_db_handle(sofia_profile_t *profile);
 
 
+/*
+ * Appends to an SDP being built.  The offset is kept so each append costs only what it writes instead of
+ * scanning the whole buffer again, anything past the end is dropped like switch_snprintf() would.
+ */
+typedef struct {
+	char *buf;
+	switch_size_t len;
+	switch_size_t size;
+} sdp_buf_t;
+
+static void sdp_printf(sdp_buf_t *sb, const char *fmt, ...) PRINTF_FUNCTION(2, 3);
+
+static void sdp_printf(sdp_buf_t *sb, const char *fmt, ...)
+{
+	va_list ap;
+	int ret;
+
+	if (sb->len + 1 >= sb->size) {
+		return;
+	}
+
+	va_start(ap, fmt);
+	ret = switch_vsnprintf(sb->buf + sb->len, sb->size - sb->len, fmt, ap);
+	va_end(ap);
+
+	if (ret > 0) {
+		sb->len += ret;
+		if (sb->len >= sb->size) {
+			sb->len = sb->size - 1;
+		}
+	}
+}
+
 void sofia_glue_set_image_sdp(private_object_t *tech_pvt, switch_t38_options_t *t38_options, int insist)
 {
 	char buf[2048] = "";
+	sdp_buf_t sb = { buf, 0, sizeof(buf) };
 	char max_buf[128] = "";
 	char max_data[128] = "";
 	const char *ip;
@@ -107,7 +141,7 @@ void sofia_glue_set_image_sdp(private_object_t *tech_pvt, switch_t38_options_t *
 	family = strchr(ip, ':') ? "IP6" : "IP4";
 
 
-	switch_snprintf(buf, sizeof(buf),
+	sdp_printf(&sb,
 					"v=0\n"
 					"o=%s %010u %010u IN %s %s\n"
 					"s=%s\n" "c=IN %s %s\n" "t=0 0\n", username, tech_pvt->owner_id, tech_pvt->session_id, family, ip, username, family, ip);
@@ -136,7 +170,7 @@ void sofia_glue_set_image_sdp(private_object_t *tech_pvt, switch_t38_options_t *
 	}
 	
 
-	switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf),
+	sdp_printf(&sb,
 					"m=image %d udptl t38\n"
 					"a=T38FaxVersion:%d\n"
 					"a=T38MaxBitRate:%d\n"
@@ -164,7 +198,7 @@ void sofia_glue_set_image_sdp(private_object_t *tech_pvt, switch_t38_options_t *
 
 
 	if (insist) {
-		switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "m=audio 0 RTP/AVP 19\n");
+		sdp_printf(&sb, "m=audio 0 RTP/AVP 19\n");
 	}
 
 	sofia_glue_tech_set_local_sdp(tech_pvt, buf, SWITCH_TRUE);
@@ -176,7 +210,7 @@ void sofia_glue_set_image_sdp(private_object_t *tech_pvt, switch_t38_options_t *
 
 }
 
-static void generate_m(private_object_t *tech_pvt, char *buf, size_t buflen, 
+static void generate_m(private_object_t *tech_pvt, sdp_buf_t *sb,
 					   switch_port_t port,
 					   int cur_ptime, const char *append_audio, const char *sr, int use_cng, int cng_type, switch_event_t *map, int verbose_sdp, int secure)
 {
@@ -185,7 +219,7 @@ static void generate_m(private_object_t *tech_pvt, char *buf, size_t buflen,
 	int already_did[128] = { 0 };
 	int ptime = 0, noptime = 0;
 
-	switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "m=audio %d RTP/%sAVP", 
+	sdp_printf(sb, "m=audio %d RTP/%sAVP", 
 					port, secure ? "S" : "");
 				
 	
@@ -243,18 +277,18 @@ static void generate_m(private_object_t *tech_pvt, char *buf, size_t buflen,
 		}
 
 		
-		switch_snprintf(buf + strlen(buf), buflen - strlen(buf), " %d", tech_pvt->ianacodes[i]);
+		sdp_printf(sb, " %d", tech_pvt->ianacodes[i]);
 	}
 
 	if (tech_pvt->dtmf_type == DTMF_2833 && tech_pvt->te > 95) {
-		switch_snprintf(buf + strlen(buf), buflen - strlen(buf), " %d", tech_pvt->te);
+		sdp_printf(sb, " %d", tech_pvt->te);
 	}
 		
 	if (!sofia_test_pflag(tech_pvt->profile, PFLAG_SUPPRESS_CNG) && cng_type && use_cng) {
-		switch_snprintf(buf + strlen(buf), buflen - strlen(buf), " %d", cng_type);
+		sdp_printf(sb, " %d", cng_type);
 	}
 		
-	switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "\n");
+	sdp_printf(sb, "\n");
 
 
 	memset(already_did, 0, sizeof(already_did));
@@ -306,33 +340,33 @@ static void generate_m(private_object_t *tech_pvt, char *buf, size_t buflen,
 		}
 		
 		if (tech_pvt->ianacodes[i] > 95 || verbose_sdp) {
-			switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "a=rtpmap:%d %s/%d\n", tech_pvt->ianacodes[i], imp->iananame, rate);
+			sdp_printf(sb, "a=rtpmap:%d %s/%d\n", tech_pvt->ianacodes[i], imp->iananame, rate);
 		}
 
 		if (fmtp) {
-			switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "a=fmtp:%d %s\n", tech_pvt->ianacodes[i], fmtp);
+			sdp_printf(sb, "a=fmtp:%d %s\n", tech_pvt->ianacodes[i], fmtp);
 		}
 	}
 
 
 	if ((tech_pvt->dtmf_type == DTMF_2833 || sofia_test_pflag(tech_pvt->profile, PFLAG_LIBERAL_DTMF) || sofia_test_flag(tech_pvt, TFLAG_LIBERAL_DTMF)) 
 		&& tech_pvt->te > 95) {
-		switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "a=rtpmap:%d telephone-event/8000\na=fmtp:%d 0-16\n", tech_pvt->te, tech_pvt->te);
+		sdp_printf(sb, "a=rtpmap:%d telephone-event/8000\na=fmtp:%d 0-16\n", tech_pvt->te, tech_pvt->te);
 	}
 
 	if (secure) {
-		switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "a=crypto:%s\n", tech_pvt->local_crypto_key);
-		//switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=encryption:optional\n");
+		sdp_printf(sb, "a=crypto:%s\n", tech_pvt->local_crypto_key);
+		//sdp_printf(&sb, "a=encryption:optional\n");
 	}
 
 	if (!cng_type) {
-		//switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "a=rtpmap:%d CN/8000\n", cng_type);
+		//sdp_printf(sb, "a=rtpmap:%d CN/8000\n", cng_type);
 		//} else {
-		switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "a=silenceSupp:off - - - -\n");
+		sdp_printf(sb, "a=silenceSupp:off - - - -\n");
 	}
 
 	if (append_audio) {
-		switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "%s%s", append_audio, end_of(append_audio) == '\n' ? "" : "\n");
+		sdp_printf(sb, "%s%s", append_audio, end_of(append_audio) == '\n' ? "" : "\n");
 	}
 
 	if (!cur_ptime) {
@@ -340,18 +374,18 @@ static void generate_m(private_object_t *tech_pvt, char *buf, size_t buflen,
 	}
 	
 	if (!noptime && cur_ptime) {
-		switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "a=ptime:%d\n", cur_ptime);
+		sdp_printf(sb, "a=ptime:%d\n", cur_ptime);
 	}
 
 	if (tech_pvt->local_sdp_audio_zrtp_hash) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(tech_pvt->session), SWITCH_LOG_DEBUG, "Adding audio a=zrtp-hash:%s\n",
 						  tech_pvt->local_sdp_audio_zrtp_hash);
-		switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "a=zrtp-hash:%s\n",
+		sdp_printf(sb, "a=zrtp-hash:%s\n",
 						tech_pvt->local_sdp_audio_zrtp_hash);
 	}
 
 	if (sr) {
-		switch_snprintf(buf + strlen(buf), buflen - strlen(buf), "a=%s\n", sr);
+		sdp_printf(sb, "a=%s\n", sr);
 	}
 }
 
@@ -376,6 +410,7 @@ void sofia_glue_check_dtmf_type(private_object_t *tech_pvt)
 void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch_port_t port, const char *sr, int force)
 {
 	char buf[2048];
+	sdp_buf_t sb = { buf, 0, sizeof(buf) };
 	int ptime = 0;
 	uint32_t rate = 0;
 	uint32_t v_port;
@@ -490,7 +525,7 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 	}
 
 	family = strchr(ip, ':') ? "IP6" : "IP4";
-	switch_snprintf(buf, sizeof(buf),
+	sdp_printf(&sb,
 					"v=0\n"
 					"o=%s %010u %010u IN %s %s\n"
 					"s=%s\n"
@@ -499,25 +534,25 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 					username, tech_pvt->owner_id, tech_pvt->session_id, family, ip, username, family, ip, srbuf);
 
 	if (tech_pvt->rm_encoding) {
-		switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "m=audio %d RTP/%sAVP", 
+		sdp_printf(&sb, "m=audio %d RTP/%sAVP", 
 						port, (!zstr(tech_pvt->local_crypto_key) && sofia_test_flag(tech_pvt, TFLAG_SECURE)) ? "S" : "");
 
-		switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), " %d", tech_pvt->pt);
+		sdp_printf(&sb, " %d", tech_pvt->pt);
 
 		if ((tech_pvt->dtmf_type == DTMF_2833 || sofia_test_pflag(tech_pvt->profile, PFLAG_LIBERAL_DTMF) || sofia_test_flag(tech_pvt, TFLAG_LIBERAL_DTMF)) && tech_pvt->te > 95) {
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), " %d", tech_pvt->te);
+			sdp_printf(&sb, " %d", tech_pvt->te);
 		}
 		
 		if (!sofia_test_pflag(tech_pvt->profile, PFLAG_SUPPRESS_CNG) && tech_pvt->cng_pt && use_cng) {
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), " %d", tech_pvt->cng_pt);
+			sdp_printf(&sb, " %d", tech_pvt->cng_pt);
 		}
 		
-		switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "\n");
+		sdp_printf(&sb, "\n");
 
 		rate = tech_pvt->rm_rate;
-		switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=rtpmap:%d %s/%d\n", tech_pvt->agreed_pt, tech_pvt->rm_encoding, rate);
+		sdp_printf(&sb, "a=rtpmap:%d %s/%d\n", tech_pvt->agreed_pt, tech_pvt->rm_encoding, rate);
 		if (fmtp_out) {
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=fmtp:%d %s\n", tech_pvt->agreed_pt, fmtp_out);
+			sdp_printf(&sb, "a=fmtp:%d %s\n", tech_pvt->agreed_pt, fmtp_out);
 		}
 
 		if (tech_pvt->read_codec.implementation && !ptime) {
@@ -527,40 +562,40 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 
 		if ((tech_pvt->dtmf_type == DTMF_2833 || sofia_test_pflag(tech_pvt->profile, PFLAG_LIBERAL_DTMF) || sofia_test_flag(tech_pvt, TFLAG_LIBERAL_DTMF))
 			&& tech_pvt->te > 95) {
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=rtpmap:%d telephone-event/8000\na=fmtp:%d 0-16\n", tech_pvt->te, tech_pvt->te);
+			sdp_printf(&sb, "a=rtpmap:%d telephone-event/8000\na=fmtp:%d 0-16\n", tech_pvt->te, tech_pvt->te);
 		}
 		if (!sofia_test_pflag(tech_pvt->profile, PFLAG_SUPPRESS_CNG) && tech_pvt->cng_pt && use_cng) {
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=rtpmap:%d CN/8000\n", tech_pvt->cng_pt);
+			sdp_printf(&sb, "a=rtpmap:%d CN/8000\n", tech_pvt->cng_pt);
 			if (!tech_pvt->rm_encoding) {
 				tech_pvt->cng_pt = 0;
 			}
 		} else {
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=silenceSupp:off - - - -\n");
+			sdp_printf(&sb, "a=silenceSupp:off - - - -\n");
 		}
 
 		if (append_audio) {
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "%s%s", append_audio, end_of(append_audio) == '\n' ? "" : "\n");
+			sdp_printf(&sb, "%s%s", append_audio, end_of(append_audio) == '\n' ? "" : "\n");
 		}
 
 		if (ptime) {
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=ptime:%d\n", ptime);
+			sdp_printf(&sb, "a=ptime:%d\n", ptime);
 		}
 
 
 		if (tech_pvt->local_sdp_audio_zrtp_hash) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(tech_pvt->session), SWITCH_LOG_DEBUG, "Adding audio a=zrtp-hash:%s\n",
 							  tech_pvt->local_sdp_audio_zrtp_hash);
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=zrtp-hash:%s\n",
+			sdp_printf(&sb, "a=zrtp-hash:%s\n",
 							tech_pvt->local_sdp_audio_zrtp_hash);
 		}
 
 		if (sr) {
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=%s\n", sr);
+			sdp_printf(&sb, "a=%s\n", sr);
 		}
 	
 		if (!zstr(tech_pvt->local_crypto_key) && sofia_test_flag(tech_pvt, TFLAG_SECURE)) {
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=crypto:%s\n", tech_pvt->local_crypto_key);
-			//switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=encryption:optional\n");
+			sdp_printf(&sb, "a=crypto:%s\n", tech_pvt->local_crypto_key);
+			//sdp_printf(&sb, "a=encryption:optional\n");
 		}
 
 	} else if (tech_pvt->num_codecs) {
@@ -579,12 +614,10 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 		mult = switch_channel_get_variable(tech_pvt->channel, "sdp_m_per_ptime");
 		
 		if (mult && switch_false(mult)) {
-			char *bp = buf;
 			int both = 1;
 
 			if ((!zstr(tech_pvt->local_crypto_key) && sofia_test_flag(tech_pvt, TFLAG_SECURE))) {
-				generate_m(tech_pvt, buf, sizeof(buf), port, 0, append_audio, sr, use_cng, cng_type, map, verbose_sdp, 1);
-				bp = (buf + strlen(buf));
+				generate_m(tech_pvt, &sb, port, 0, append_audio, sr, use_cng, cng_type, map, verbose_sdp, 1);
 
 				/* asterisk can't handle AVP and SAVP in sep streams, way to blow off the spec....*/
 				if (switch_true(switch_channel_get_variable(tech_pvt->channel, "sdp_secure_savp_only"))) {
@@ -594,7 +627,7 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 			}
 
 			if (both) {
-				generate_m(tech_pvt, bp, sizeof(buf) - strlen(buf), port, 0, append_audio, sr, use_cng, cng_type, map, verbose_sdp, 0);
+				generate_m(tech_pvt, &sb, port, 0, append_audio, sr, use_cng, cng_type, map, verbose_sdp, 0);
 			}
 
 		} else {
@@ -613,14 +646,12 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 				}
 				
 				if (cur_ptime != this_ptime) {
-					char *bp = buf;
 					int both = 1;
 
 					cur_ptime = this_ptime;			
 					
 					if ((!zstr(tech_pvt->local_crypto_key) && sofia_test_flag(tech_pvt, TFLAG_SECURE))) {
-						generate_m(tech_pvt, buf, sizeof(buf), port, cur_ptime, append_audio, sr, use_cng, cng_type, map, verbose_sdp, 1);
-						bp = (buf + strlen(buf));
+						generate_m(tech_pvt, &sb, port, cur_ptime, append_audio, sr, use_cng, cng_type, map, verbose_sdp, 1);
 
 						/* asterisk can't handle AVP and SAVP in sep streams, way to blow off the spec....*/
 						if (switch_true(switch_channel_get_variable(tech_pvt->channel, "sdp_secure_savp_only"))) {
@@ -629,7 +660,7 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 					}
 
 					if (both) {
-						generate_m(tech_pvt, bp, sizeof(buf) - strlen(buf), port, cur_ptime, append_audio, sr, use_cng, cng_type, map, verbose_sdp, 0);
+						generate_m(tech_pvt, &sb, port, cur_ptime, append_audio, sr, use_cng, cng_type, map, verbose_sdp, 0);
 					}
 				}
 				
@@ -644,12 +675,12 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 		}
 
 		if ((v_port = tech_pvt->adv_sdp_video_port)) {
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "m=video %d RTP/AVP", v_port);
+			sdp_printf(&sb, "m=video %d RTP/AVP", v_port);
 
 			/*****************************/
 			if (tech_pvt->video_rm_encoding) {
 				sofia_glue_tech_set_video_codec(tech_pvt, 0);
-				switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), " %d", tech_pvt->video_agreed_pt);
+				sdp_printf(&sb, " %d", tech_pvt->video_agreed_pt);
 			} else if (tech_pvt->num_codecs) {
 				int i;
 				int already_did[128] = { 0 };
@@ -667,19 +698,19 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 						already_did[tech_pvt->ianacodes[i]] = 1;
 					}
 
-					switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), " %d", tech_pvt->ianacodes[i]);
+					sdp_printf(&sb, " %d", tech_pvt->ianacodes[i]);
 					if (!ptime) {
 						ptime = imp->microseconds_per_packet / 1000;
 					}
 				}
 			}
 
-			switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "\n");
+			sdp_printf(&sb, "\n");
 
 			if (tech_pvt->video_rm_encoding) {
 				const char *of;
 				rate = tech_pvt->video_rm_rate;
-				switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=rtpmap:%d %s/%ld\n", tech_pvt->video_pt, tech_pvt->video_rm_encoding,
+				sdp_printf(&sb, "a=rtpmap:%d %s/%ld\n", tech_pvt->video_pt, tech_pvt->video_rm_encoding,
 								tech_pvt->video_rm_rate);
 
 				if (sofia_test_flag(tech_pvt, TFLAG_RECOVERING)) {
@@ -702,7 +733,7 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 				}
 
 				if (pass_fmtp) {
-					switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=fmtp:%d %s\n", tech_pvt->video_pt, pass_fmtp);
+					sdp_printf(&sb, "a=fmtp:%d %s\n", tech_pvt->video_pt, pass_fmtp);
 				}
 
 			} else if (tech_pvt->num_codecs) {
@@ -730,7 +761,7 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 					}
 					
 					
-					switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=rtpmap:%d %s/%d\n", ianacode, imp->iananame,
+					sdp_printf(&sb, "a=rtpmap:%d %s/%d\n", ianacode, imp->iananame,
 									imp->samples_per_second);
 					
 					if (!zstr(ov_fmtp)) {
@@ -747,7 +778,7 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 					}
 					
 					if (!zstr(fmtp) && strcasecmp(fmtp, "_blank_")) {
-						switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=fmtp:%d %s\n", ianacode, fmtp);
+						sdp_printf(&sb, "a=fmtp:%d %s\n", ianacode, fmtp);
 					}
 				}
 				
@@ -756,7 +787,7 @@ void sofia_glue_set_local_sdp(private_object_t *tech_pvt, const char *ip, switch
 			if (tech_pvt->local_sdp_video_zrtp_hash) {
 				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(tech_pvt->session), SWITCH_LOG_DEBUG, "Adding video a=zrtp-hash:%s\n",
 								  tech_pvt->local_sdp_video_zrtp_hash);
-				switch_snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf), "a=zrtp-hash:%s\n",
+				sdp_printf(&sb, "a=zrtp-hash:%s\n",
 								tech_pvt->local_sdp_video_zrtp_hash);
 			}
 		}
@@ -795,6 +826,204 @@ const char *sofia_glue_get_codec_string(private_object_t *tech_pvt)
 	return !zstr(preferred) ? preferred : fallback;
 }
 
+/*
+ * Codec cache.  Trunks send the same codec string and the same offer over and over, so the profile keeps the
+ * implementations a codec string sorts to and, per audio m-line, which rtpmap won against which local list.
+ * Everything is dropped when a codec module comes or goes, or when the cache fills up.
+ */
+
+#define SOFIA_CODEC_CACHE_MAX 512
+
+struct sofia_codec_cache_entry {
+	int num_codecs;
+	const switch_codec_implementation_t *codecs[SWITCH_MAX_CODECS];
+	int map_index;
+	const switch_codec_implementation_t *mimp;
+	struct sofia_codec_cache_entry *next;
+};
+
+/* must hold profile->codec_cache_mutex */
+static void sofia_glue_codec_cache_reset(sofia_profile_t *profile)
+{
+	struct sofia_codec_cache_entry *entry;
+
+	while ((entry = profile->codec_cache_head)) {
+		profile->codec_cache_head = entry->next;
+		free(entry);
+	}
+
+	if (profile->codec_cache) {
+		switch_core_hash_destroy(&profile->codec_cache);
+	}
+
+	switch_core_hash_init(&profile->codec_cache, NULL);
+	profile->codec_cache_count = 0;
+	profile->codec_cache_generation = switch_loadable_module_codec_generation();
+}
+
+void sofia_glue_codec_cache_destroy(sofia_profile_t *profile)
+{
+	struct sofia_codec_cache_entry *entry;
+
+	if (!profile->codec_cache_mutex) {
+		return;
+	}
+
+	switch_mutex_lock(profile->codec_cache_mutex);
+	while ((entry = profile->codec_cache_head)) {
+		profile->codec_cache_head = entry->next;
+		free(entry);
+	}
+
+	if (profile->codec_cache) {
+		switch_core_hash_destroy(&profile->codec_cache);
+	}
+	switch_mutex_unlock(profile->codec_cache_mutex);
+}
+
+/* must hold profile->codec_cache_mutex */
+static struct sofia_codec_cache_entry *sofia_glue_codec_cache_find(sofia_profile_t *profile, const char *key)
+{
+	if (!profile->codec_cache || profile->codec_cache_generation != switch_loadable_module_codec_generation()) {
+		sofia_glue_codec_cache_reset(profile);
+		return NULL;
+	}
+
+	return (struct sofia_codec_cache_entry *) switch_core_hash_find(profile->codec_cache, key);
+}
+
+/* must hold profile->codec_cache_mutex */
+static struct sofia_codec_cache_entry *sofia_glue_codec_cache_add(sofia_profile_t *profile, const char *key)
+{
+	struct sofia_codec_cache_entry *entry;
+
+	if (!profile->codec_cache || profile->codec_cache_count >= SOFIA_CODEC_CACHE_MAX ||
+		profile->codec_cache_generation != switch_loadable_module_codec_generation()) {
+		sofia_glue_codec_cache_reset(profile);
+	}
+
+	switch_zmalloc(entry, sizeof(*entry));
+	entry->next = profile->codec_cache_head;
+	profile->codec_cache_head = entry;
+	profile->codec_cache_count++;
+	switch_core_hash_insert(profile->codec_cache, key, entry);
+
+	return entry;
+}
+
+static int sofia_glue_get_codecs_cached(sofia_profile_t *profile, const char *codec_string, char **codec_order, int codec_order_last,
+										const switch_codec_implementation_t **codecs)
+{
+	struct sofia_codec_cache_entry *entry;
+	char *key;
+	int num;
+
+	if (!profile->codec_cache_mutex) {
+		return codec_string ? switch_loadable_module_get_codecs_sorted(codecs, SWITCH_MAX_CODECS, codec_order, codec_order_last) :
+			switch_loadable_module_get_codecs(codecs, SWITCH_MAX_CODECS);
+	}
+
+	key = switch_mprintf("l:%s", switch_str_nil(codec_string));
+
+	switch_mutex_lock(profile->codec_cache_mutex);
+	if ((entry = sofia_glue_codec_cache_find(profile, key))) {
+		num = entry->num_codecs;
+		memcpy(codecs, entry->codecs, num * sizeof(codecs[0]));
+		switch_mutex_unlock(profile->codec_cache_mutex);
+		free(key);
+		return num;
+	}
+	switch_mutex_unlock(profile->codec_cache_mutex);
+
+	num = codec_string ? switch_loadable_module_get_codecs_sorted(codecs, SWITCH_MAX_CODECS, codec_order, codec_order_last) :
+		switch_loadable_module_get_codecs(codecs, SWITCH_MAX_CODECS);
+
+	switch_mutex_lock(profile->codec_cache_mutex);
+	if (!(entry = sofia_glue_codec_cache_find(profile, key))) {
+		entry = sofia_glue_codec_cache_add(profile, key);
+		entry->num_codecs = num;
+		memcpy(entry->codecs, codecs, num * sizeof(codecs[0]));
+	}
+	switch_mutex_unlock(profile->codec_cache_mutex);
+
+	free(key);
+
+	return num;
+}
+
+/* the pick only depends on these, two offers with the same key negotiate the same way */
+static char *sofia_glue_negotiate_key(private_object_t *tech_pvt, sdp_media_t *m, const switch_codec_implementation_t **codec_array,
+									  int total_codecs, int ptime, int maxptime, int greedy, int scrooge)
+{
+	switch_stream_handle_t stream = { 0 };
+	sdp_rtpmap_t *map;
+	int i;
+
+	SWITCH_STANDARD_STREAM(stream);
+	stream.write_function(&stream, "n:%d:%d:%d:%d:%d:%d:", greedy, scrooge, !!(tech_pvt->profile->ndlb & PFLAG_NDLB_ALLOW_BAD_IANANAME),
+						  ptime, maxptime, tech_pvt->num_codecs);
+
+	for (i = 0; i < total_codecs; i++) {
+		stream.write_function(&stream, "%p,", (void *) codec_array[i]);
+	}
+
+	for (map = m->m_rtpmaps; map; map = map->rm_next) {
+		stream.write_function(&stream, "|%u/%s/%lu/%s", map->rm_pt, switch_str_nil(map->rm_encoding), map->rm_rate, switch_str_nil(map->rm_fmtp));
+	}
+
+	return (char *) stream.data;
+}
+
+static int sofia_glue_negotiate_cache_get(sofia_profile_t *profile, const char *key, const switch_codec_implementation_t **mimp)
+{
+	struct sofia_codec_cache_entry *entry;
+	int map_index = -1;
+
+	if (!profile->codec_cache_mutex || !key) {
+		return -1;
+	}
+
+	switch_mutex_lock(profile->codec_cache_mutex);
+	if ((entry = sofia_glue_codec_cache_find(profile, key))) {
+		map_index = entry->map_index;
+		*mimp = entry->mimp;
+	}
+	switch_mutex_unlock(profile->codec_cache_mutex);
+
+	return map_index;
+}
+
+static void sofia_glue_negotiate_cache_set(sofia_profile_t *profile, const char *key, int map_index, const switch_codec_implementation_t *mimp)
+{
+	struct sofia_codec_cache_entry *entry;
+
+	if (!profile->codec_cache_mutex || !key) {
+		return;
+	}
+
+	switch_mutex_lock(profile->codec_cache_mutex);
+	if (!(entry = sofia_glue_codec_cache_find(profile, key))) {
+		entry = sofia_glue_codec_cache_add(profile, key);
+	}
+	entry->map_index = map_index;
+	entry->mimp = mimp;
+	switch_mutex_unlock(profile->codec_cache_mutex);
+}
+
+static void sofia_glue_negotiate_cache_del(sofia_profile_t *profile, const char *key)
+{
+	if (!profile->codec_cache_mutex || !key) {
+		return;
+	}
+
+	/* the entry itself stays on the list until the next reset */
+	switch_mutex_lock(profile->codec_cache_mutex);
+	if (profile->codec_cache) {
+		switch_core_hash_delete(profile->codec_cache, key);
+	}
+	switch_mutex_unlock(profile->codec_cache_mutex);
+}
+
 void sofia_glue_tech_prepare_codecs(private_object_t *tech_pvt)
 {
 	const char *abs, *codec_string = NULL;
@@ -847,10 +1076,10 @@ void sofia_glue_tech_prepare_codecs(private_object_t *tech_pvt)
 		if ((tmp_codec_string = switch_core_session_strdup(tech_pvt->session, codec_string))) {
 			tech_pvt->codec_order_last = switch_separate_string(tmp_codec_string, ',', tech_pvt->codec_order, SWITCH_MAX_CODECS);
 			tech_pvt->num_codecs =
-				switch_loadable_module_get_codecs_sorted(tech_pvt->codecs, SWITCH_MAX_CODECS, tech_pvt->codec_order, tech_pvt->codec_order_last);
+				sofia_glue_get_codecs_cached(tech_pvt->profile, codec_string, tech_pvt->codec_order, tech_pvt->codec_order_last, tech_pvt->codecs);
 		}
 	} else {
-		tech_pvt->num_codecs = switch_loadable_module_get_codecs(tech_pvt->codecs, sizeof(tech_pvt->codecs) / sizeof(tech_pvt->codecs[0]));
+		tech_pvt->num_codecs = sofia_glue_get_codecs_cached(tech_pvt->profile, NULL, NULL, 0, tech_pvt->codecs);
 	}
 
 
@@ -2764,6 +2993,7 @@ static void set_stats(switch_rtp_t *rtp_session, private_object_t *tech_pvt, con
 {
 	switch_rtp_stats_t *stats = switch_rtp_get_stats(rtp_session, NULL);
 	char var_name[256] = "", var_val[35] = "";
+	switch_size_t relayed = 0;
 
 	if (stats) {
 
@@ -2777,6 +3007,10 @@ static void set_stats(switch_rtp_t *rtp_session, private_object_t *tech_pvt, con
 		add_stat(stats->inbound.cng_packet_count, "in_cng_packet_count");
 		add_stat(stats->inbound.flush_packet_count, "in_flush_packet_count");
 		add_stat(stats->inbound.largest_jb_size, "in_largest_jb_size");
+		add_stat(stats->inbound.jb_size, "in_jb_size");
+		add_stat(stats->inbound.jb_target_size, "in_jb_target_size");
+		add_stat(stats->inbound.jb_plc_count, "in_jb_plc_count");
+		add_stat(stats->inbound.jb_jitter_ms, "in_jb_jitter_ms");
 
 		add_stat(stats->outbound.raw_bytes, "out_raw_bytes");
 		add_stat(stats->outbound.media_bytes, "out_media_bytes");
@@ -2785,10 +3019,19 @@ static void set_stats(switch_rtp_t *rtp_session, private_object_t *tech_pvt, con
 		add_stat(stats->outbound.skip_packet_count, "out_skip_packet_count");
 		add_stat(stats->outbound.dtmf_packet_count, "out_dtmf_packet_count");
 		add_stat(stats->outbound.cng_packet_count, "out_cng_packet_count");
+		add_stat(stats->outbound.batch_count, "out_batch_count");
+		add_stat(stats->outbound.largest_batch, "out_largest_batch");
 
 		add_stat(stats->rtcp.packet_count, "rtcp_packet_count");
 		add_stat(stats->rtcp.octet_count, "rtcp_octet_count");
 
+		if (switch_rtp_relay_active(rtp_session, &relayed) || relayed) {
+			add_stat(relayed, "relay_packet_count");
+		}
+
+		switch_core_session_trace(tech_pvt->session, SWITCH_TRACE_RTP, (uint32_t) stats->inbound.skip_packet_count,
+								  (uint32_t) stats->inbound.packet_count, (uint32_t) stats->outbound.packet_count, prefix);
+
 	}
 }
 
@@ -3161,6 +3404,13 @@ switch_status_t sofia_glue_activate_rtp(private_object_t *tech_pvt, switch_rtp_f
 
 	if (switch_rtp_ready(tech_pvt->rtp_session)) {
 		switch_rtp_reset_media_timer(tech_pvt->rtp_session);
+
+		if (sofia_test_flag(tech_pvt, TFLAG_REINVITE) && switch_rtp_relay_active(tech_pvt->rtp_session, NULL)) {
+			/* the media may be changing under us, go back to the session until the next bridge */
+			switch_rtp_relay_stop(tech_pvt->rtp_session);
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(tech_pvt->session), SWITCH_LOG_DEBUG, "%s stop RTP relay for re-INVITE.\n",
+							  switch_channel_get_name(tech_pvt->channel));
+		}
 	}
 
 	if ((var = switch_channel_get_variable(tech_pvt->channel, SOFIA_SECURE_MEDIA_VARIABLE)) && switch_true(var)) {
@@ -3412,6 +3662,25 @@ switch_status_t sofia_glue_activate_rtp(private_object_t *tech_pvt, switch_rtp_f
 
 		switch_rtp_intentional_bugs(tech_pvt->rtp_session, tech_pvt->rtp_bugs | tech_pvt->profile->manual_rtp_bugs);
 
+		if ((val = switch_channel_get_variable(tech_pvt->channel, "rtp_use_reactor")) ? switch_true(val) :
+			sofia_test_pflag(tech_pvt->profile, PFLAG_RTP_REACTOR)) {
+			switch_rtp_activate_reactor(tech_pvt->rtp_session);
+		}
+
+		if ((val = switch_channel_get_variable(tech_pvt->channel, "rtp_tx_batch")) || (val = tech_pvt->profile->rtp_tx_batch)) {
+			int max_packets = atoi(val);
+			int max_usec = 0;
+			char *p;
+
+			if ((p = strchr(val, ':'))) {
+				max_usec = atoi(p + 1);
+			}
+
+			if (max_packets > 1 && max_usec >= 0) {
+				switch_rtp_set_tx_batch(tech_pvt->rtp_session, (uint32_t) max_packets, (uint32_t) max_usec);
+			}
+		}
+
 		if ((vad_in && inb) || (vad_out && !inb)) {
 			switch_rtp_enable_vad(tech_pvt->rtp_session, tech_pvt->session, &tech_pvt->read_codec, SWITCH_VAD_FLAG_TALKING | SWITCH_VAD_FLAG_EVENTS_TALK | SWITCH_VAD_FLAG_EVENTS_NOTALK);
 			sofia_set_flag(tech_pvt, TFLAG_VAD);
@@ -3480,7 +3749,9 @@ switch_status_t sofia_glue_activate_rtp(private_object_t *tech_pvt, switch_rtp_f
 				}
 				if (switch_rtp_activate_jitter_buffer(tech_pvt->rtp_session, qlen, maxqlen,
 													  tech_pvt->read_impl.samples_per_packet, 
-													  tech_pvt->read_impl.samples_per_second, max_drift) == SWITCH_STATUS_SUCCESS) {
+													  tech_pvt->read_impl.samples_per_second, max_drift,
+													  switch_true(switch_channel_get_variable(tech_pvt->channel, "jitterbuffer_adaptive")) ?
+													  SWITCH_RTP_JB_ADAPTIVE : 0) == SWITCH_STATUS_SUCCESS) {
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(tech_pvt->session), 
 									  SWITCH_LOG_DEBUG, "Setting Jitterbuffer to %dms (%d frames)\n", jb_msec, qlen);
 					switch_channel_set_flag(tech_pvt->channel, CF_JITTERBUFFER);
@@ -4528,6 +4799,7 @@ uint8_t sofia_glue_negotiate_sdp(switch_core_session_t *session, const char *r_s
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	const char *val;
 	const char *crypto = NULL;
+	switch_time_t started = switch_micro_time_now();
 	int got_crypto = 0, got_audio = 0, got_avp = 0, got_savp = 0, got_udptl = 0;
 	int scrooge = 0;
 	sdp_parser_t *parser = NULL;
@@ -4535,6 +4807,9 @@ uint8_t sofia_glue_negotiate_sdp(switch_core_session_t *session, const char *r_s
 	int reneg = 1;
 	const switch_codec_implementation_t **codec_array;
 	int total_codecs;
+	char *cache_key = NULL;
+	int cache_map = -1;
+	const switch_codec_implementation_t *cache_mimp = NULL;
 
 
 	codec_array = tech_pvt->codecs;
@@ -4890,6 +5165,10 @@ uint8_t sofia_glue_negotiate_sdp(switch_core_session_t *session, const char *r_s
 				break;
 			}
 
+			switch_safe_free(cache_key);
+			cache_key = sofia_glue_negotiate_key(tech_pvt, m, codec_array, total_codecs, ptime, maxptime, greedy, scrooge);
+			cache_map = sofia_glue_negotiate_cache_get(tech_pvt->profile, cache_key, &cache_mimp);
+
 		greed:
 			x = 0;
 
@@ -4964,6 +5243,17 @@ uint8_t sofia_glue_negotiate_sdp(switch_core_session_t *session, const char *r_s
 					continue;
 				}
 
+				if (cache_map >= 0) {
+					/* seen this offer against this codec list before, only the rtpmap that won then is worth a look */
+					if (x - 1 != cache_map) {
+						continue;
+					}
+
+					mimp = cache_mimp;
+					match = 1;
+					goto matched;
+				}
+
 				if (greedy) {
 					first = mine;
 					last = first + 1;
@@ -5081,6 +5371,7 @@ uint8_t sofia_glue_negotiate_sdp(switch_core_session_t *session, const char *r_s
 					continue;
 				}
 
+			matched:
 				if (mimp) {
 					char tmp[50];
 					tech_pvt->rm_encoding = switch_core_session_strdup(session, (char *) map->rm_encoding);
@@ -5112,6 +5403,9 @@ uint8_t sofia_glue_negotiate_sdp(switch_core_session_t *session, const char *r_s
 				if (match) {
 					if (sofia_glue_tech_set_codec(tech_pvt, 1) == SWITCH_STATUS_SUCCESS) {
 						got_audio = 1;
+						if (cache_map < 0) {
+							sofia_glue_negotiate_cache_set(tech_pvt->profile, cache_key, x - 1, mimp);
+						}
 					} else {
 						match = 0;
 					}
@@ -5157,6 +5451,14 @@ uint8_t sofia_glue_negotiate_sdp(switch_core_session_t *session, const char *r_s
 			}
 
 			
+			if (!match && cache_map >= 0) {
+				/* what worked last time did not this time, negotiate the long way */
+				sofia_glue_negotiate_cache_del(tech_pvt->profile, cache_key);
+				cache_map = -1;
+				skip = 0;
+				goto greed;
+			}
+
 			if (!match && greedy && mine < total_codecs) {
 				mine++;
 				skip = 0;
@@ -5262,9 +5564,13 @@ uint8_t sofia_glue_negotiate_sdp(switch_core_session_t *session, const char *r_s
 		sdp_parser_free(parser);
 	}
 
+	switch_safe_free(cache_key);
+
 	tech_pvt->cng_pt = cng_pt;
 	sofia_set_flag_locked(tech_pvt, TFLAG_SDP);
 
+	switch_core_session_record_phase(session, SWITCH_PHASE_MEDIA, started, 0);
+
 	return match;
 }
 
@@ -5699,6 +6005,12 @@ static int recover_callback(void *pArg, int argc, char **argv, char **columnName
 	const char *tmp;
 	const char *rr;
 
+	if (!zstr(argv[2]) && (session = switch_core_session_locate(argv[2]))) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "%s is already up, not recovering it again\n", argv[2]);
+		switch_core_session_rwunlock(session);
+		return 0;
+	}
+
 	xml = switch_xml_parse_str_dynamic(argv[3], SWITCH_TRUE);
 
 	if (!xml)
@@ -5947,6 +6259,618 @@ static int recover_callback(void *pArg, int argc, char **argv, char **columnName
 
 }
 
+/* Call state replication: with replicate-to set every tracked call is also streamed to a standby node,
+   which keeps it in memory and hands it to recover_callback on "sofia recover" instead of reading the DB.
+
+   A frame is "<op> <runtime_uuid> <profile> <hostname> <uuid> <len>\n" followed by len bytes of metadata,
+   op is T (track), U (untrack), S (start of a full resync from that runtime) or E (end of the resync). */
+
+#define REPLICATE_RETRY_USEC 2000000
+#define REPLICATE_MAX_FRAME (16 * 1024 * 1024)
+
+typedef struct {
+	char *runtime_uuid;
+	char *profile_name;
+	char *hostname;
+	char *uuid;
+	char *metadata;
+} sofia_replica_t;
+
+typedef struct {
+	switch_size_t len;
+	char data[1];
+} replicate_frame_t;
+
+static sofia_replica_t *replica_new(const char *runtime_uuid, const char *profile_name, const char *hostname, const char *uuid, const char *metadata)
+{
+	sofia_replica_t *rep;
+
+	switch_zmalloc(rep, sizeof(*rep));
+	rep->runtime_uuid = strdup(runtime_uuid);
+	rep->profile_name = strdup(profile_name);
+	rep->hostname = strdup(hostname);
+	rep->uuid = strdup(uuid);
+	rep->metadata = strdup(metadata);
+
+	return rep;
+}
+
+static void replica_free(sofia_replica_t *rep)
+{
+	if (rep) {
+		switch_safe_free(rep->runtime_uuid);
+		switch_safe_free(rep->profile_name);
+		switch_safe_free(rep->hostname);
+		switch_safe_free(rep->uuid);
+		switch_safe_free(rep->metadata);
+		free(rep);
+	}
+}
+
+/* call with replicate_mutex held, takes ownership of rep */
+static void replica_store(switch_hash_t *hash, sofia_replica_t *rep)
+{
+	replica_free(switch_core_hash_find(hash, rep->uuid));
+	switch_core_hash_insert(hash, rep->uuid, rep);
+}
+
+/* call with replicate_mutex held */
+static void replica_remove(switch_hash_t *hash, const char *uuid)
+{
+	sofia_replica_t *rep;
+
+	if ((rep = switch_core_hash_find(hash, uuid))) {
+		switch_core_hash_delete(hash, uuid);
+		replica_free(rep);
+	}
+}
+
+static replicate_frame_t *replicate_frame(char op, const char *runtime_uuid, const char *profile_name, const char *hostname,
+										  const char *uuid, const char *metadata)
+{
+	replicate_frame_t *frame;
+	switch_size_t mlen = metadata ? strlen(metadata) : 0;
+	char head[1024];
+	int hlen;
+
+	hlen = switch_snprintf(head, sizeof(head), "%c %s %s %s %s %" SWITCH_SIZE_T_FMT "\n", op,
+						   zstr(runtime_uuid) ? "-" : runtime_uuid, zstr(profile_name) ? "-" : profile_name,
+						   zstr(hostname) ? "-" : hostname, zstr(uuid) ? "-" : uuid, mlen);
+
+	switch_zmalloc(frame, sizeof(*frame) + hlen + mlen);
+	memcpy(frame->data, head, hlen);
+	if (mlen) {
+		memcpy(frame->data + hlen, metadata, mlen);
+	}
+	frame->len = hlen + mlen;
+
+	return frame;
+}
+
+static void replicate_queue(replicate_frame_t *frame)
+{
+	if (switch_queue_trypush(mod_sofia_globals.replicate_queue, frame) != SWITCH_STATUS_SUCCESS) {
+		/* the standby is behind or away, the resync when it next connects will cover this */
+		free(frame);
+	}
+}
+
+static void sofia_glue_replicate_track(sofia_profile_t *profile, switch_core_session_t *session, const char *metadata)
+{
+	sofia_replica_t *rep;
+
+	if (!mod_sofia_globals.replicate_queue) {
+		return;
+	}
+
+	rep = replica_new(switch_core_get_uuid(), profile->name, mod_sofia_globals.hostname, switch_core_session_get_uuid(session), metadata);
+
+	switch_mutex_lock(mod_sofia_globals.replicate_mutex);
+	replicate_queue(replicate_frame('T', rep->runtime_uuid, rep->profile_name, rep->hostname, rep->uuid, rep->metadata));
+	replica_store(mod_sofia_globals.replicate_tracked, rep);
+	switch_mutex_unlock(mod_sofia_globals.replicate_mutex);
+}
+
+static void sofia_glue_replicate_untrack(sofia_profile_t *profile, switch_core_session_t *session)
+{
+	const char *uuid = switch_core_session_get_uuid(session);
+
+	if (!mod_sofia_globals.replicate_queue) {
+		return;
+	}
+
+	switch_mutex_lock(mod_sofia_globals.replicate_mutex);
+	replicate_queue(replicate_frame('U', switch_core_get_uuid(), profile->name, mod_sofia_globals.hostname, uuid, NULL));
+	replica_remove(mod_sofia_globals.replicate_tracked, uuid);
+	switch_mutex_unlock(mod_sofia_globals.replicate_mutex);
+}
+
+static switch_status_t replicate_write(switch_socket_t *sock, const char *data, switch_size_t len)
+{
+	while (len) {
+		switch_size_t n = len;
+
+		if (switch_socket_send(sock, data, &n) != SWITCH_STATUS_SUCCESS || !n) {
+			return SWITCH_STATUS_FALSE;
+		}
+
+		data += n;
+		len -= n;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_socket_t *replicate_connect(const char *host, switch_port_t port, switch_memory_pool_t *pool)
+{
+	switch_sockaddr_t *sa = NULL;
+	switch_socket_t *sock = NULL;
+
+	if (switch_sockaddr_info_get(&sa, host, SWITCH_UNSPEC, port, 0, pool) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_create(&sock, switch_sockaddr_get_family(sa), SOCK_STREAM, SWITCH_PROTO_TCP, pool) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	switch_socket_timeout_set(sock, 3000000);
+
+	if (switch_socket_connect(sock, sa) != SWITCH_STATUS_SUCCESS) {
+		switch_socket_close(sock);
+		return NULL;
+	}
+
+	switch_socket_opt_set(sock, SWITCH_SO_TCP_NODELAY, 1);
+
+	return sock;
+}
+
+/* Copy every tracked call under the lock, then write them out without holding up call setup */
+static switch_status_t replicate_resync(switch_socket_t *sock)
+{
+	switch_hash_index_t *hi;
+	replicate_frame_t **frames = NULL;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	const char *ruuid = switch_core_get_uuid();
+	replicate_frame_t *frame;
+	int count = 0, size = 0, i;
+
+	switch_mutex_lock(mod_sofia_globals.replicate_mutex);
+	for (hi = switch_hash_first(NULL, mod_sofia_globals.replicate_tracked); hi; hi = switch_hash_next(hi)) {
+		const void *key;
+		void *val;
+		sofia_replica_t *rep;
+
+		switch_hash_this(hi, &key, NULL, &val);
+		rep = (sofia_replica_t *) val;
+
+		if (count == size) {
+			size = size ? size * 2 : 256;
+			frames = realloc(frames, size * sizeof(*frames));
+			switch_assert(frames);
+		}
+
+		frames[count++] = replicate_frame('T', rep->runtime_uuid, rep->profile_name, rep->hostname, rep->uuid, rep->metadata);
+	}
+	switch_mutex_unlock(mod_sofia_globals.replicate_mutex);
+
+	frame = replicate_frame('S', ruuid, NULL, mod_sofia_globals.hostname, NULL, NULL);
+	status = replicate_write(sock, frame->data, frame->len);
+	free(frame);
+
+	for (i = 0; i < count; i++) {
+		if (status == SWITCH_STATUS_SUCCESS) {
+			status = replicate_write(sock, frames[i]->data, frames[i]->len);
+		}
+		free(frames[i]);
+	}
+	switch_safe_free(frames);
+
+	if (status == SWITCH_STATUS_SUCCESS) {
+		frame = replicate_frame('E', ruuid, NULL, mod_sofia_globals.hostname, NULL, NULL);
+		status = replicate_write(sock, frame->data, frame->len);
+		free(frame);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Replicated %d tracked call(s) to %s\n", count, mod_sofia_globals.replicate_to);
+	}
+
+	return status;
+}
+
+static void *SWITCH_THREAD_FUNC replicate_send_run(switch_thread_t *thread, void *obj)
+{
+	switch_memory_pool_t *pool = NULL;
+	switch_socket_t *sock = NULL;
+	switch_time_t next_try = 0;
+	char *host = strdup(mod_sofia_globals.replicate_to), *p;
+	switch_port_t port = 5095;
+
+	if ((p = strrchr(host, ':'))) {
+		*p++ = '\0';
+		port = (switch_port_t) atoi(p);
+	}
+
+	switch_mutex_lock(mod_sofia_globals.mutex);
+	mod_sofia_globals.threads++;
+	switch_mutex_unlock(mod_sofia_globals.mutex);
+
+	while (mod_sofia_globals.running == 1) {
+		void *pop = NULL;
+
+		if (!sock && switch_micro_time_now() >= next_try) {
+			switch_core_new_memory_pool(&pool);
+
+			if ((sock = replicate_connect(host, port, pool)) && replicate_resync(sock) == SWITCH_STATUS_SUCCESS) {
+				mod_sofia_globals.replicate_connected = 1;
+			} else {
+				if (sock) {
+					switch_socket_close(sock);
+					sock = NULL;
+				}
+				switch_core_destroy_memory_pool(&pool);
+				next_try = switch_micro_time_now() + REPLICATE_RETRY_USEC;
+			}
+		}
+
+		if (switch_queue_pop_timeout(mod_sofia_globals.replicate_queue, &pop, 500000) == SWITCH_STATUS_SUCCESS && pop) {
+			replicate_frame_t *frame = (replicate_frame_t *) pop;
+
+			if (sock) {
+				if (replicate_write(sock, frame->data, frame->len) == SWITCH_STATUS_SUCCESS) {
+					mod_sofia_globals.replicate_sent++;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Lost replication stream to %s\n", mod_sofia_globals.replicate_to);
+					switch_socket_close(sock);
+					sock = NULL;
+					switch_core_destroy_memory_pool(&pool);
+					mod_sofia_globals.replicate_connected = 0;
+					next_try = switch_micro_time_now() + REPLICATE_RETRY_USEC;
+				}
+			}
+
+			free(frame);
+		}
+	}
+
+	if (sock) {
+		switch_socket_close(sock);
+		switch_core_destroy_memory_pool(&pool);
+	}
+	mod_sofia_globals.replicate_connected = 0;
+	free(host);
+
+	switch_mutex_lock(mod_sofia_globals.mutex);
+	mod_sofia_globals.threads--;
+	switch_mutex_unlock(mod_sofia_globals.mutex);
+
+	return NULL;
+}
+
+typedef struct {
+	switch_socket_t *sock;
+	switch_pollfd_t *pollfd;
+	switch_memory_pool_t *pool;
+	char buf[65536];
+	switch_size_t len;
+	switch_size_t pos;
+} replicate_reader_t;
+
+/* Read exactly len bytes, waking up now and then to notice a shutdown */
+static switch_status_t replicate_read(replicate_reader_t *rd, char *out, switch_size_t len)
+{
+	while (len) {
+		switch_size_t n;
+
+		if (rd->pos == rd->len) {
+			int32_t nsds = 0;
+
+			if (mod_sofia_globals.running != 1) {
+				return SWITCH_STATUS_FALSE;
+			}
+
+			if (switch_poll(rd->pollfd, 1, &nsds, 1000000) != SWITCH_STATUS_SUCCESS || nsds < 1) {
+				continue;
+			}
+
+			rd->pos = 0;
+			rd->len = sizeof(rd->buf);
+
+			if (switch_socket_recv(rd->sock, rd->buf, &rd->len) != SWITCH_STATUS_SUCCESS || !rd->len) {
+				rd->len = 0;
+				return SWITCH_STATUS_FALSE;
+			}
+		}
+
+		n = rd->len - rd->pos;
+		if (n > len) {
+			n = len;
+		}
+
+		memcpy(out, rd->buf + rd->pos, n);
+		rd->pos += n;
+		out += n;
+		len -= n;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_bool_t replica_runtime_match(const void *key, const void *val, void *pData)
+{
+	sofia_replica_t *rep = (sofia_replica_t *) val;
+
+	if (!strcmp(rep->runtime_uuid, (const char *) pData)) {
+		replica_free(rep);
+		return SWITCH_TRUE;
+	}
+
+	return SWITCH_FALSE;
+}
+
+static void *SWITCH_THREAD_FUNC replicate_conn_run(switch_thread_t *thread, void *obj)
+{
+	replicate_reader_t *rd = (replicate_reader_t *) obj;
+	switch_memory_pool_t *pool = rd->pool;
+	char head[1024];
+	int synced = 0;
+
+	switch_mutex_lock(mod_sofia_globals.mutex);
+	mod_sofia_globals.threads++;
+	switch_mutex_unlock(mod_sofia_globals.mutex);
+
+	while (mod_sofia_globals.running == 1) {
+		char op, ruuid[256], profile_name[256], hostname[256], uuid[256];
+		switch_size_t hlen = 0, mlen;
+		char *metadata = NULL;
+		unsigned long ulen = 0;
+
+		/* the header line */
+		while (hlen < sizeof(head) - 1 && replicate_read(rd, head + hlen, 1) == SWITCH_STATUS_SUCCESS && head[hlen] != '\n') {
+			hlen++;
+		}
+
+		if (hlen >= sizeof(head) - 1 || head[hlen] != '\n') {
+			break;
+		}
+		head[hlen] = '\0';
+
+		if (sscanf(head, "%c %255s %255s %255s %255s %lu", &op, ruuid, profile_name, hostname, uuid, &ulen) != 6 || ulen > REPLICATE_MAX_FRAME) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Bad replication frame [%s]\n", head);
+			break;
+		}
+
+		mlen = (switch_size_t) ulen;
+		switch_zmalloc(metadata, mlen + 1);
+		if (mlen && replicate_read(rd, metadata, mlen) != SWITCH_STATUS_SUCCESS) {
+			free(metadata);
+			break;
+		}
+
+		switch_mutex_lock(mod_sofia_globals.replicate_mutex);
+		switch (op) {
+		case 'S':
+			switch_core_hash_delete_multi(mod_sofia_globals.replicate_replicas, replica_runtime_match, ruuid);
+			synced = 0;
+			break;
+		case 'T':
+			replica_store(mod_sofia_globals.replicate_replicas, replica_new(ruuid, profile_name, hostname, uuid, metadata));
+			mod_sofia_globals.replicate_received++;
+			synced++;
+			break;
+		case 'U':
+			replica_remove(mod_sofia_globals.replicate_replicas, uuid);
+			mod_sofia_globals.replicate_received++;
+			break;
+		case 'E':
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Replica of %s (%s) is in sync, %d call(s)\n", hostname, ruuid, synced);
+			break;
+		default:
+			break;
+		}
+		switch_mutex_unlock(mod_sofia_globals.replicate_mutex);
+
+		free(metadata);
+	}
+
+	switch_socket_close(rd->sock);
+	switch_core_destroy_memory_pool(&pool);
+
+	switch_mutex_lock(mod_sofia_globals.mutex);
+	mod_sofia_globals.threads--;
+	switch_mutex_unlock(mod_sofia_globals.mutex);
+
+	return NULL;
+}
+
+static void *SWITCH_THREAD_FUNC replicate_listen_run(switch_thread_t *thread, void *obj)
+{
+	switch_sockaddr_t *sa = NULL;
+	switch_socket_t *sock = NULL;
+	switch_pollfd_t *pollfd = NULL;
+	char *ip = switch_core_strdup(mod_sofia_globals.pool, mod_sofia_globals.replicate_listen), *p;
+	switch_port_t port = 5095;
+
+	if ((p = strrchr(ip, ':'))) {
+		*p++ = '\0';
+		port = (switch_port_t) atoi(p);
+	}
+
+	if (switch_sockaddr_info_get(&sa, ip, SWITCH_UNSPEC, port, 0, mod_sofia_globals.pool) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_create(&sock, switch_sockaddr_get_family(sa), SOCK_STREAM, SWITCH_PROTO_TCP, mod_sofia_globals.pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot create replication socket on %s\n", mod_sofia_globals.replicate_listen);
+		return NULL;
+	}
+
+	switch_socket_opt_set(sock, SWITCH_SO_REUSEADDR, 1);
+
+	if (switch_socket_bind(sock, sa) != SWITCH_STATUS_SUCCESS || switch_socket_listen(sock, 5) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot listen for replication on %s\n", mod_sofia_globals.replicate_listen);
+		switch_socket_close(sock);
+		return NULL;
+	}
+
+	/* wake up every second so a shutdown is noticed */
+	switch_socket_create_pollset(&pollfd, sock, SWITCH_POLLIN | SWITCH_POLLERR, mod_sofia_globals.pool);
+
+	switch_mutex_lock(mod_sofia_globals.mutex);
+	mod_sofia_globals.threads++;
+	switch_mutex_unlock(mod_sofia_globals.mutex);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Accepting call replication on %s\n", mod_sofia_globals.replicate_listen);
+
+	while (mod_sofia_globals.running == 1) {
+		switch_memory_pool_t *pool = NULL;
+		switch_socket_t *inbound = NULL;
+		switch_threadattr_t *thd_attr = NULL;
+		switch_thread_t *conn_thread;
+		replicate_reader_t *rd;
+		int32_t nsds = 0;
+
+		if (switch_poll(pollfd, 1, &nsds, 1000000) != SWITCH_STATUS_SUCCESS || nsds < 1) {
+			continue;
+		}
+
+		switch_core_new_memory_pool(&pool);
+
+		if (switch_socket_accept(&inbound, sock, pool) != SWITCH_STATUS_SUCCESS) {
+			switch_core_destroy_memory_pool(&pool);
+			continue;
+		}
+
+		rd = switch_core_alloc(pool, sizeof(*rd));
+		rd->sock = inbound;
+		rd->pool = pool;
+		switch_socket_create_pollset(&rd->pollfd, inbound, SWITCH_POLLIN | SWITCH_POLLERR, pool);
+
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_detach_set(thd_attr, 1);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		if (switch_thread_create(&conn_thread, thd_attr, replicate_conn_run, rd, pool) != SWITCH_STATUS_SUCCESS) {
+			switch_socket_close(inbound);
+			switch_core_destroy_memory_pool(&pool);
+		}
+	}
+
+	switch_socket_close(sock);
+
+	switch_mutex_lock(mod_sofia_globals.mutex);
+	mod_sofia_globals.threads--;
+	switch_mutex_unlock(mod_sofia_globals.mutex);
+
+	return NULL;
+}
+
+void sofia_glue_replicate_start(void)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	switch_thread_t *thread;
+
+	if (zstr(mod_sofia_globals.replicate_to) && zstr(mod_sofia_globals.replicate_listen)) {
+		return;
+	}
+
+	switch_mutex_init(&mod_sofia_globals.replicate_mutex, SWITCH_MUTEX_NESTED, mod_sofia_globals.pool);
+	switch_core_hash_init(&mod_sofia_globals.replicate_tracked, mod_sofia_globals.pool);
+	switch_core_hash_init(&mod_sofia_globals.replicate_replicas, mod_sofia_globals.pool);
+
+	if (!zstr(mod_sofia_globals.replicate_to)) {
+		switch_queue_create(&mod_sofia_globals.replicate_queue, SOFIA_QUEUE_SIZE, mod_sofia_globals.pool);
+		switch_threadattr_create(&thd_attr, mod_sofia_globals.pool);
+		switch_threadattr_detach_set(thd_attr, 1);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&thread, thd_attr, replicate_send_run, NULL, mod_sofia_globals.pool);
+	}
+
+	if (!zstr(mod_sofia_globals.replicate_listen)) {
+		switch_threadattr_create(&thd_attr, mod_sofia_globals.pool);
+		switch_threadattr_detach_set(thd_attr, 1);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&thread, thd_attr, replicate_listen_run, NULL, mod_sofia_globals.pool);
+	}
+}
+
+void sofia_glue_replicate_status(switch_stream_handle_t *stream)
+{
+	int tracked = 0, replicas = 0;
+	switch_hash_index_t *hi;
+
+	if (!mod_sofia_globals.replicate_mutex) {
+		stream->write_function(stream, "Call replication is not configured\n");
+		return;
+	}
+
+	switch_mutex_lock(mod_sofia_globals.replicate_mutex);
+	for (hi = switch_hash_first(NULL, mod_sofia_globals.replicate_tracked); hi; hi = switch_hash_next(hi)) {
+		tracked++;
+	}
+	for (hi = switch_hash_first(NULL, mod_sofia_globals.replicate_replicas); hi; hi = switch_hash_next(hi)) {
+		replicas++;
+	}
+	switch_mutex_unlock(mod_sofia_globals.replicate_mutex);
+
+	if (!zstr(mod_sofia_globals.replicate_to)) {
+		stream->write_function(stream, "Replicating to %s: %s, %d call(s) tracked, %u update(s) sent\n", mod_sofia_globals.replicate_to,
+							   mod_sofia_globals.replicate_connected ? "connected" : "disconnected", tracked, mod_sofia_globals.replicate_sent);
+	}
+
+	if (!zstr(mod_sofia_globals.replicate_listen)) {
+		stream->write_function(stream, "Replicas from peers on %s: %d call(s), %u update(s) received\n", mod_sofia_globals.replicate_listen,
+							   replicas, mod_sofia_globals.replicate_received);
+	}
+}
+
+/* Take the replicated calls of a profile out of memory and resurrect them, or just drop them on a flush */
+static int replica_recover(sofia_profile_t *profile, switch_bool_t flush, struct recover_helper *h)
+{
+	switch_hash_index_t *hi;
+	sofia_replica_t **found = NULL;
+	const char *ruuid = switch_core_get_uuid();
+	int count = 0, size = 0, i;
+
+	if (!mod_sofia_globals.replicate_replicas) {
+		return 0;
+	}
+
+	switch_mutex_lock(mod_sofia_globals.replicate_mutex);
+	for (hi = switch_hash_first(NULL, mod_sofia_globals.replicate_replicas); hi; hi = switch_hash_next(hi)) {
+		const void *key;
+		void *val;
+		sofia_replica_t *rep;
+
+		switch_hash_this(hi, &key, NULL, &val);
+		rep = (sofia_replica_t *) val;
+
+		if (strcmp(rep->profile_name, profile->name) || !strcmp(rep->runtime_uuid, ruuid)) {
+			continue;
+		}
+
+		if (count == size) {
+			size = size ? size * 2 : 256;
+			found = realloc(found, size * sizeof(*found));
+			switch_assert(found);
+		}
+		found[count++] = rep;
+	}
+
+	for (i = 0; i < count; i++) {
+		switch_core_hash_delete(mod_sofia_globals.replicate_replicas, found[i]->uuid);
+	}
+	switch_mutex_unlock(mod_sofia_globals.replicate_mutex);
+
+	for (i = 0; i < count; i++) {
+		if (!flush) {
+			char *argv[4];
+
+			argv[0] = found[i]->profile_name;
+			argv[1] = found[i]->hostname;
+			argv[2] = found[i]->uuid;
+			argv[3] = found[i]->metadata;
+			recover_callback(h, 4, argv, NULL);
+		}
+		replica_free(found[i]);
+	}
+	switch_safe_free(found);
+
+	return count;
+}
+
 int sofia_glue_recover(switch_bool_t flush)
 {
 	sofia_profile_t *profile;
@@ -5980,9 +6904,12 @@ int sofia_glue_profile_recover(sofia_profile_t *profile, switch_bool_t flush)
 		sofia_clear_pflag_locked(profile, PFLAG_STANDBY);
 
 		if (flush) {
+			replica_recover(profile, SWITCH_TRUE, &h);
 			sql = switch_mprintf("delete from sip_recovery where profile_name='%q'", profile->name);
 			sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
 		} else {
+			/* calls streamed to us from a peer need no DB round trip, the SQL pass below skips any of them it finds again */
+			replica_recover(profile, SWITCH_FALSE, &h);
 
 			sql = switch_mprintf("select profile_name, hostname, uuid, metadata "
 								 "from sip_recovery where runtime_uuid!='%q' and profile_name='%q'", switch_core_get_uuid(), profile->name);
@@ -6050,6 +6977,7 @@ void sofia_glue_tech_untrack(sofia_profile_t *profile, switch_core_session_t *se
 		}
 		
 		sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+		sofia_glue_replicate_untrack(profile, session);
 		sofia_clear_flag(tech_pvt, TFLAG_TRACKED);
 		
 		switch_safe_free(sql);
@@ -6093,6 +7021,7 @@ void sofia_glue_tech_track(sofia_profile_t *profile, switch_core_session_t *sess
 		}
 
 		sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
+		sofia_glue_replicate_track(profile, session, xml_cdr_text);
 		
 		free(xml_cdr_text);
 		sofia_set_flag(tech_pvt, TFLAG_TRACKED);
@@ -6418,8 +7347,21 @@ void sofia_glue_execute_sql(sofia_profile_t *profile, char **sqlp, switch_bool_t
 		}
 
 		switch_assert(d_sql);
-		if ((status = switch_queue_trypush(profile->sql_queue, d_sql)) == SWITCH_STATUS_SUCCESS) {
+		if ((status = switch_queue_trypush(profile->sql_queue, d_sql)) != SWITCH_STATUS_SUCCESS &&
+			!(sofia_test_pflag(profile, PFLAG_WORKER_RUNNING) && switch_thread_equal(profile->sql_worker_id, switch_thread_self()))) {
+			int sanity = 100;
+
+			/* a full queue means the worker is mid commit, give it a moment rather than
+			   falling back to one commit per statement right when the db is busiest */
+			while (--sanity > 0 && (status = switch_queue_trypush(profile->sql_queue, d_sql)) != SWITCH_STATUS_SUCCESS) {
+				switch_yield(1000);
+			}
+		}
+
+		if (status == SWITCH_STATUS_SUCCESS) {
 			d_sql = NULL;
+		} else {
+			profile->sql_sync_fallbacks++;
 		}
 	} else if (sql_already_dynamic) {
 		d_sql = sql;
@@ -6555,6 +7497,39 @@ switch_bool_t sofia_glue_execute_sql_callback(sofia_profile_t *profile,
 	return ret;
 }
 
+switch_bool_t sofia_glue_execute_prepared_callback(sofia_profile_t *profile, switch_mutex_t *mutex, const char *sql,
+												   const switch_cache_db_arg_t *args, int argc, switch_core_db_callback_func_t callback, void *pdata)
+{
+	switch_bool_t ret = SWITCH_FALSE;
+	char *errmsg = NULL;
+	switch_cache_db_handle_t *dbh = NULL;
+
+	if (mutex) {
+		switch_mutex_lock(mutex);
+	}
+
+	if (!(dbh = sofia_glue_get_db_handle(profile))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening DB\n");
+		goto end;
+	}
+
+	if (switch_cache_db_execute_prepared(dbh, sql, args, argc, callback, pdata, &errmsg) == SWITCH_STATUS_SUCCESS) {
+		ret = SWITCH_TRUE;
+	}
+
+	switch_safe_free(errmsg);
+
+ end:
+
+	switch_cache_db_release_db_handle(&dbh);
+
+	if (mutex) {
+		switch_mutex_unlock(mutex);
+	}
+
+	return ret;
+}
+
 char *sofia_glue_execute_sql2str(sofia_profile_t *profile, switch_mutex_t *mutex, char *sql, char *resbuf, size_t len)
 {
 	char *ret = NULL;
@@ -6821,6 +7796,69 @@ switch_status_t sofia_glue_send_notify(sofia_profile_t *profile, const char *use
 }
 
 
+static switch_bool_t rtp_relay_enabled(private_object_t *tech_pvt)
+{
+	const char *val;
+
+	if ((val = switch_channel_get_variable(tech_pvt->channel, "rtp_relay_during_bridge"))) {
+		return switch_true(val) ? SWITCH_TRUE : SWITCH_FALSE;
+	}
+
+	return sofia_test_pflag(tech_pvt->profile, PFLAG_RTP_RELAY_DURING_BRIDGE) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+void sofia_glue_start_rtp_relay(private_object_t *tech_pvt, const char *uuid)
+{
+	switch_core_session_t *other_session = NULL;
+	private_object_t *other_tech_pvt;
+
+	if (zstr(uuid) || !switch_rtp_ready(tech_pvt->rtp_session) || switch_rtp_relay_active(tech_pvt->rtp_session, NULL) ||
+		switch_channel_test_flag(tech_pvt->channel, CF_PROXY_MODE) || !rtp_relay_enabled(tech_pvt)) {
+		return;
+	}
+
+	if (!(other_session = switch_core_session_locate(uuid))) {
+		return;
+	}
+
+	if (!switch_core_session_compare(tech_pvt->session, other_session) ||
+		!(other_tech_pvt = switch_core_session_get_private(other_session)) ||
+		!switch_rtp_ready(other_tech_pvt->rtp_session) ||
+		switch_channel_test_flag(other_tech_pvt->channel, CF_PROXY_MODE) || !rtp_relay_enabled(other_tech_pvt)) {
+		goto end;
+	}
+
+	/* anything tapping the media has to keep seeing it */
+	if (switch_core_media_bug_count(tech_pvt->session, NULL) || switch_core_media_bug_count(other_session, NULL)) {
+		goto end;
+	}
+
+	if (!tech_pvt->read_impl.iananame || !other_tech_pvt->read_impl.iananame ||
+		strcasecmp(tech_pvt->read_impl.iananame, other_tech_pvt->read_impl.iananame) ||
+		tech_pvt->read_impl.actual_samples_per_second != other_tech_pvt->read_impl.actual_samples_per_second ||
+		tech_pvt->read_impl.microseconds_per_packet != other_tech_pvt->read_impl.microseconds_per_packet) {
+		goto end;
+	}
+
+	if (switch_rtp_relay_start(tech_pvt->rtp_session, other_tech_pvt->rtp_session) == SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(tech_pvt->session), SWITCH_LOG_DEBUG, "%s relay RTP with %s.\n",
+						  switch_channel_get_name(tech_pvt->channel), switch_channel_get_name(other_tech_pvt->channel));
+	}
+
+ end:
+
+	switch_core_session_rwunlock(other_session);
+}
+
+void sofia_glue_check_rtp_relay(private_object_t *tech_pvt)
+{
+	if (switch_rtp_relay_active(tech_pvt->rtp_session, NULL) && switch_core_media_bug_count(tech_pvt->session, NULL)) {
+		switch_rtp_relay_stop(tech_pvt->rtp_session);
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(tech_pvt->session), SWITCH_LOG_DEBUG, "%s stop RTP relay, media bug added.\n",
+						  switch_channel_get_name(tech_pvt->channel));
+	}
+}
+
 void sofia_glue_tech_simplify(private_object_t *tech_pvt)
 {
 	const char *uuid, *network_addr_a = NULL, *network_addr_b = NULL, *simplify, *simplify_other_channel;
@@ -7185,6 +8223,114 @@ char *sofia_glue_get_host(const char *str, switch_memory_pool_t *pool)
 	return s;
 }
 
+/*
+ * Timer wheel.  wheel->now is the last second already handed out, a node sits in the lowest level whose span
+ * covers its distance from there and drops a level each time the level above wraps onto its slot, so an
+ * advance only ever touches the slots the clock moves over.  Not locked, the owner serializes access.
+ */
+static void sofia_wheel_place(sofia_wheel_t *wheel, sofia_wheel_node_t *node)
+{
+	sofia_wheel_node_t **list = NULL;
+	time_t at = node->due > wheel->now ? node->due : wheel->now + 1;
+	time_t delta = at - wheel->now;
+	int level;
+
+	for (level = 0; level < SOFIA_WHEEL_LEVELS; level++) {
+		if (delta < ((time_t) 1 << (SOFIA_WHEEL_BITS * (level + 1)))) {
+			list = &wheel->slot[level][(at >> (SOFIA_WHEEL_BITS * level)) & (SOFIA_WHEEL_SLOTS - 1)];
+			break;
+		}
+	}
+
+	if (!list) {
+		list = &wheel->overflow;
+	}
+
+	if ((node->next = *list)) {
+		node->next->pprev = &node->next;
+	}
+	node->pprev = list;
+	*list = node;
+}
+
+static void sofia_wheel_cascade(sofia_wheel_t *wheel, sofia_wheel_node_t **list)
+{
+	sofia_wheel_node_t *node, *next;
+
+	node = *list;
+	*list = NULL;
+
+	for (; node; node = next) {
+		next = node->next;
+		sofia_wheel_place(wheel, node);
+	}
+}
+
+void sofia_wheel_init(sofia_wheel_t *wheel, time_t now)
+{
+	memset(wheel, 0, sizeof(*wheel));
+	wheel->now = now;
+}
+
+void sofia_wheel_add(sofia_wheel_t *wheel, sofia_wheel_node_t *node, time_t due)
+{
+	sofia_wheel_del(wheel, node);
+	node->due = due;
+	sofia_wheel_place(wheel, node);
+	wheel->count++;
+}
+
+void sofia_wheel_del(sofia_wheel_t *wheel, sofia_wheel_node_t *node)
+{
+	if (!sofia_wheel_node_linked(node)) {
+		return;
+	}
+
+	if ((*node->pprev = node->next)) {
+		node->next->pprev = node->pprev;
+	}
+
+	node->next = NULL;
+	node->pprev = NULL;
+	wheel->count--;
+}
+
+/* unlinks and returns everything due up to now chained on ->next, the caller must save ->next before re-adding a node */
+sofia_wheel_node_t *sofia_wheel_advance(sofia_wheel_t *wheel, time_t now)
+{
+	sofia_wheel_node_t *due = NULL, *node, *next;
+	time_t t;
+	int level;
+
+	while (wheel->now < now) {
+		t = ++wheel->now;
+
+		for (level = 1; level < SOFIA_WHEEL_LEVELS; level++) {
+			if (t & (((time_t) 1 << (SOFIA_WHEEL_BITS * level)) - 1)) {
+				break;
+			}
+			sofia_wheel_cascade(wheel, &wheel->slot[level][(t >> (SOFIA_WHEEL_BITS * level)) & (SOFIA_WHEEL_SLOTS - 1)]);
+		}
+
+		if (level == SOFIA_WHEEL_LEVELS && !(t & (((time_t) 1 << (SOFIA_WHEEL_BITS * SOFIA_WHEEL_LEVELS)) - 1))) {
+			sofia_wheel_cascade(wheel, &wheel->overflow);
+		}
+
+		node = wheel->slot[0][t & (SOFIA_WHEEL_SLOTS - 1)];
+		wheel->slot[0][t & (SOFIA_WHEEL_SLOTS - 1)] = NULL;
+
+		for (; node; node = next) {
+			next = node->next;
+			node->pprev = NULL;
+			node->next = due;
+			due = node;
+			wheel->count--;
+		}
+	}
+
+	return due;
+}
+
 
 /* For Emacs:
  * Local Variables:
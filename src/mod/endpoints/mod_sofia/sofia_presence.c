@@ -1119,6 +1119,15 @@ static void actual_sofia_presence_event_handler(switch_event_t *event)
 					proto = SOFIA_CHAT_PROTO;
 				}
 
+				if (!sofia_presence_sub_watched(profile, euser, event_type, alt_event_type, call_id)) {
+					if (mod_sofia_globals.debug_presence > 1) {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s: nobody is subscribed to %s@%s, skipping\n",
+										  profile->name, euser, host);
+					}
+					sofia_glue_release_profile(profile);
+					continue;
+				}
+
 				if (zstr(uuid)) {
 				
 					sql = switch_mprintf("select state,status,rpid,presence_id from sip_dialogs "
@@ -1344,11 +1353,141 @@ static void actual_sofia_presence_event_handler(switch_event_t *event)
 
 static int EVENT_THREAD_RUNNING = 0;
 static int EVENT_THREAD_STARTED = 0;
+static switch_thread_id_t EVENT_THREAD_ID = 0;
+
+/*
+ * presence-coalesce-ms: PRESENCE_IN events for the same dialog that arrive within the window are folded into
+ * the newest one, so a call going early/ringing/confirmed in quick succession costs one round of NOTIFYs.
+ * mwi-coalesce-ms does the same for MESSAGE_WAITING per mailbox and subscription, the newest event carries the
+ * full counts so it stands in for the ones it replaces.  Everything else flushes what is pending first to keep
+ * the order the events were fired in.  Only the event thread touches this.
+ */
+typedef struct pres_pending {
+	switch_event_t *event;
+	switch_time_t due;
+	char *key;
+	struct pres_pending *next;
+} pres_pending_t;
+
+typedef struct {
+	switch_memory_pool_t *pool;
+	switch_hash_t *hash;
+	pres_pending_t *head;
+	pres_pending_t *tail;
+	uint32_t *window_ms;
+	char *(*key)(switch_event_t *event);
+	void (*handler)(switch_event_t *event);
+} pres_coalesce_t;
+
+static char *pres_coalesce_key(switch_event_t *event)
+{
+	const char *from = switch_event_get_header(event, "from");
+	const char *uuid = switch_event_get_header(event, "unique-id");
+	const char *event_type = switch_event_get_header(event, "event_type");
+
+	if (event->event_id != SWITCH_EVENT_PRESENCE_IN || zstr(from) || zstr(uuid) || switch_event_get_header(event, "presence-call-info")) {
+		return NULL;
+	}
+
+	return switch_mprintf("%s|%s|%s", from, switch_str_nil(event_type), uuid);
+}
+
+static char *mwi_coalesce_key(switch_event_t *event)
+{
+	const char *account = switch_event_get_header(event, "mwi-message-account");
+
+	if (zstr(account) || !switch_event_get_header(event, "mwi-messages-waiting")) {
+		return NULL;
+	}
+
+	return switch_mprintf("%s|%s|%s|%s", account, switch_event_get_header_nil(event, "sofia-profile"),
+						  switch_event_get_header_nil(event, "call-id"), switch_event_get_header_nil(event, "sub-call-id"));
+}
+
+static void pres_coalesce_init(pres_coalesce_t *pc, uint32_t *window_ms, char *(*key)(switch_event_t *), void (*handler)(switch_event_t *))
+{
+	memset(pc, 0, sizeof(*pc));
+	pc->window_ms = window_ms;
+	pc->key = key;
+	pc->handler = handler;
+	switch_core_new_memory_pool(&pc->pool);
+	switch_core_hash_init(&pc->hash, pc->pool);
+}
+
+/* drops whatever is still held, only on the way out */
+static void pres_coalesce_destroy(pres_coalesce_t *pc)
+{
+	pres_pending_t *pp;
+
+	while ((pp = pc->head)) {
+		pc->head = pp->next;
+		switch_event_destroy(&pp->event);
+		free(pp->key);
+		free(pp);
+	}
+
+	switch_core_hash_destroy(&pc->hash);
+	switch_core_destroy_memory_pool(&pc->pool);
+}
+
+static void pres_coalesce_flush(pres_coalesce_t *pc, switch_time_t now)
+{
+	pres_pending_t *pp;
+
+	while ((pp = pc->head) && (!now || pp->due <= now)) {
+		if (!(pc->head = pp->next)) {
+			pc->tail = NULL;
+		}
+		switch_core_hash_delete(pc->hash, pp->key);
+
+		pc->handler(pp->event);
+		switch_event_destroy(&pp->event);
+		free(pp->key);
+		free(pp);
+	}
+}
+
+/* takes the event, returns SWITCH_FALSE when it isn't one to hold back and the caller still owns it */
+static switch_bool_t pres_coalesce_add(pres_coalesce_t *pc, switch_event_t *event)
+{
+	pres_pending_t *pp;
+	char *key;
+
+	if (!*pc->window_ms || !(key = pc->key(event))) {
+		return SWITCH_FALSE;
+	}
+
+	if ((pp = switch_core_hash_find(pc->hash, key))) {
+		if (mod_sofia_globals.debug_presence > 1) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "coalescing %s\n", key);
+		}
+		switch_event_destroy(&pp->event);
+		pp->event = event;
+		free(key);
+		return SWITCH_TRUE;
+	}
+
+	switch_zmalloc(pp, sizeof(*pp));
+	pp->event = event;
+	pp->key = key;
+	pp->due = switch_time_now() + (switch_time_t) *pc->window_ms * 1000;
+	switch_core_hash_insert(pc->hash, key, pp);
+
+	if (pc->tail) {
+		pc->tail->next = pp;
+	} else {
+		pc->head = pp;
+	}
+	pc->tail = pp;
+
+	return SWITCH_TRUE;
+}
 
 void *SWITCH_THREAD_FUNC sofia_presence_event_thread_run(switch_thread_t *thread, void *obj)
 {
 	void *pop;
 	int done = 0;
+	pres_coalesce_t pc, mc;
 
 	switch_mutex_lock(mod_sofia_globals.mutex);
 	if (!EVENT_THREAD_RUNNING) {
@@ -1365,6 +1504,10 @@ void *SWITCH_THREAD_FUNC sofia_presence_event_thread_run(switch_thread_t *thread
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Event Thread Started\n");
 
+	EVENT_THREAD_ID = switch_thread_self();
+	pres_coalesce_init(&pc, &mod_sofia_globals.presence_coalesce_ms, pres_coalesce_key, actual_sofia_presence_event_handler);
+	pres_coalesce_init(&mc, &mod_sofia_globals.mwi_coalesce_ms, mwi_coalesce_key, actual_sofia_presence_mwi_event_handler);
+
 	while (mod_sofia_globals.running == 1) {
 		int count = 0;
 
@@ -1374,11 +1517,23 @@ void *SWITCH_THREAD_FUNC sofia_presence_event_thread_run(switch_thread_t *thread
 			if (!pop) {
 				break;
 			}
-			actual_sofia_presence_event_handler(event);
-			switch_event_destroy(&event);
+
+			if (!pres_coalesce_add(&pc, event)) {
+				pres_coalesce_flush(&pc, 0);
+				actual_sofia_presence_event_handler(event);
+				switch_event_destroy(&event);
+			}
 			count++;
 		}
 
+		if (pc.head) {
+			pres_coalesce_flush(&pc, switch_time_now());
+		}
+
+		if (mc.head) {
+			pres_coalesce_flush(&mc, switch_time_now());
+		}
+
 		if (switch_queue_trypop(mod_sofia_globals.mwi_queue, &pop) == SWITCH_STATUS_SUCCESS) {
 			switch_event_t *event = (switch_event_t *) pop;
 
@@ -1386,16 +1541,23 @@ void *SWITCH_THREAD_FUNC sofia_presence_event_thread_run(switch_thread_t *thread
 				break;
 			}
 
-			actual_sofia_presence_mwi_event_handler(event);
-			switch_event_destroy(&event);
+			if (!pres_coalesce_add(&mc, event)) {
+				pres_coalesce_flush(&mc, 0);
+				actual_sofia_presence_mwi_event_handler(event);
+				switch_event_destroy(&event);
+			}
 			count++;
 		}
 
 		if (!count) {
-			switch_yield(100000);
+			switch_yield((pc.head || mc.head) ? 10000 : 100000);
 		}
 	}
 
+	pres_coalesce_destroy(&pc);
+	pres_coalesce_destroy(&mc);
+	EVENT_THREAD_ID = 0;
+
 	while (switch_queue_trypop(mod_sofia_globals.presence_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
 		switch_event_t *event = (switch_event_t *) pop;
 		switch_event_destroy(&event);
@@ -1843,6 +2005,34 @@ static int sofia_dialog_probe_callback(void *pArg, int argc, char **argv, char *
 	return 0;
 }
 
+/*
+ * notify-rate-limit: NOTIFYs per second for the profile, with up to a second's worth allowed in a burst.
+ * Every NOTIFY counts against it but only the presence event thread is ever made to wait,
+ * the sip stack and the worker thread never block here.
+ */
+static void sofia_presence_notify_pace(sofia_profile_t *profile)
+{
+	switch_time_t now, wait;
+
+	if (!profile->notify_rate_limit) {
+		return;
+	}
+
+	switch_mutex_lock(profile->ireg_mutex);
+	now = switch_time_now();
+	if (profile->notify_tat < now) {
+		profile->notify_tat = now;
+	}
+	wait = profile->notify_tat - now - 1000000;
+	profile->notify_tat += 1000000 / profile->notify_rate_limit;
+	switch_mutex_unlock(profile->ireg_mutex);
+
+	if (wait > 0 && EVENT_THREAD_ID && switch_thread_equal(switch_thread_self(), EVENT_THREAD_ID)) {
+		profile->notify_paced++;
+		switch_yield(wait);
+	}
+}
+
 #define send_presence_notify(_a,_b,_c,_d,_e,_f,_g,_h,_i,_j,_k,_l) \
 _send_presence_notify(_a,_b,_c,_d,_e,_f,_g,_h,_i,_j,_k,_l,__FILE__, __SWITCH_FUNC__, __LINE__)
 
@@ -2005,6 +2195,8 @@ static void _send_presence_notify(sofia_profile_t *profile,
 	}
 
 	
+	sofia_presence_notify_pace(profile);
+
 	switch_mutex_lock(profile->ireg_mutex);
 	if (!profile->cseq_base) {
 		profile->cseq_base = (now - 1312693200) * 10;
@@ -3104,6 +3296,7 @@ static int sync_sla(sofia_profile_t *profile, const char *to_user, const char *t
 								 "call_id='%q' "
 								 "and event='line-seize'", (long) switch_epoch_time_now(NULL),
 								 call_id);
+			sofia_presence_sub_timer_set(profile, call_id, NULL, NULL, switch_epoch_time_now(NULL));
 			
 			sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
 			
@@ -3132,6 +3325,7 @@ static int sync_sla(sofia_profile_t *profile, const char *to_user, const char *t
 								 "and event='line-seize'", (long) switch_epoch_time_now(NULL),
 								 mod_sofia_globals.hostname, profile->name, to_user, to_host
 								 );
+			sofia_presence_sub_timers_rescan(profile);
 			
 			if (mod_sofia_globals.debug_sla > 1) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "CLEAR SQL %s\n", sql);
@@ -3418,6 +3612,7 @@ void sofia_presence_handle_sip_i_subscribe(int status,
 							 "where hostname='%q' and profile_name='%q' and call_id='%q' and profile_name='%q'",
 							 (long) switch_epoch_time_now(NULL) + exp_delta, contact_str, mod_sofia_globals.hostname, profile->name,
 							 call_id, profile->name);
+		sofia_presence_sub_timer_set(profile, call_id, to_user, event, switch_epoch_time_now(NULL) + exp_delta);
 
 		if (mod_sofia_globals.debug_presence > 0 || mod_sofia_globals.debug_sla > 0) {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
@@ -3430,6 +3625,7 @@ void sofia_presence_handle_sip_i_subscribe(int status,
 		if (sub_state == nua_substate_terminated) {
 			sql = switch_mprintf("delete from sip_subscriptions where call_id='%q' and profile_name='%q' and hostname='%q'", 
 								 call_id, profile->name, mod_sofia_globals.hostname);
+			sofia_presence_sub_timer_del(profile, call_id);
 		
 			if (mod_sofia_globals.debug_presence > 0 || mod_sofia_globals.debug_sla > 0) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
@@ -3462,6 +3658,7 @@ void sofia_presence_handle_sip_i_subscribe(int status,
 								 (long) switch_epoch_time_now(NULL) + exp_delta,
 								 full_agent, accept, profile->name, mod_sofia_globals.hostname, 
 								 np.network_port, np.network_ip, orig_proto, full_to, to_tag);
+			sofia_presence_sub_timer_set(profile, call_id, to_user, event, switch_epoch_time_now(NULL) + exp_delta);
 
 			switch_assert(sql != NULL);
 			
@@ -4242,52 +4439,305 @@ void sofia_presence_set_chat_hash(private_object_t *tech_pvt, sip_t const *sip)
 }
 
 
-void sofia_presence_check_subscriptions(sofia_profile_t *profile, time_t now) 
+/*
+ * Subscription expiry timers.  Every subscription this box holds gets a node on a timer wheel keyed by call-id,
+ * so the periodic check only goes to sip_subscriptions for the call-ids that actually came due.  Anything that
+ * changes expires in bulk without a call-id asks for one full rescan instead.
+ *
+ * The same entries double as the subscription index: by_watch counts the subscriptions per sub_to_user|event,
+ * which lets a presence event for something nobody watches skip the subscription queries altogether.
+ */
+struct sofia_sub_timers {
+	switch_mutex_t *mutex;
+	switch_hash_t *by_call_id;
+	switch_hash_t *by_watch;
+	sofia_wheel_t wheel;
+	int rescan;
+};
+
+typedef struct sofia_sub_timer {
+	sofia_wheel_node_t node;
+	char *watch;
+	char call_id[1];
+} sofia_sub_timer_t;
+
+static void sub_watch_ref(sofia_sub_timers_t *timers, sofia_sub_timer_t *timer, const char *user, const char *event)
+{
+	intptr_t count;
+
+	timer->watch = switch_mprintf("%s|%s", user, event);
+	count = (intptr_t) switch_core_hash_find(timers->by_watch, timer->watch);
+	switch_core_hash_insert(timers->by_watch, timer->watch, (void *) (count + 1));
+}
+
+static void sub_watch_unref(sofia_sub_timers_t *timers, sofia_sub_timer_t *timer)
+{
+	intptr_t count;
+
+	if (!timer->watch) {
+		return;
+	}
+
+	if ((count = (intptr_t) switch_core_hash_find(timers->by_watch, timer->watch)) > 1) {
+		switch_core_hash_insert(timers->by_watch, timer->watch, (void *) (count - 1));
+	} else {
+		switch_core_hash_delete(timers->by_watch, timer->watch);
+	}
+
+	switch_safe_free(timer->watch);
+}
+
+#define SUB_TIMER_BATCH 100
+
+static int sub_timers_load_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	sofia_profile_t *profile = (sofia_profile_t *) pArg;
+
+	if (argc > 3 && argv[0]) {
+		sofia_presence_sub_timer_set(profile, argv[0], argv[2], argv[3], (time_t) atol(switch_str_nil(argv[1])));
+	}
+
+	return 0;
+}
+
+void sofia_presence_sub_timers_create(sofia_profile_t *profile)
 {
+	sofia_sub_timers_t *timers;
 	char *sql;
 
-	if (now) {
-		struct pres_sql_cb cb = {profile, 0};
+	if (profile->sub_timers) {
+		return;
+	}
 
-		if (profile->pres_type != PRES_TYPE_FULL) {
-			if (mod_sofia_globals.debug_presence > 0) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "check_subs: %s is passive, skipping\n", (char *) profile->name);
-			}
-			return;
+	timers = switch_core_alloc(profile->pool, sizeof(*timers));
+	switch_mutex_init(&timers->mutex, SWITCH_MUTEX_NESTED, profile->pool);
+	switch_core_hash_init_case(&timers->by_call_id, profile->pool, SWITCH_TRUE);
+	switch_core_hash_init_case(&timers->by_watch, profile->pool, SWITCH_TRUE);
+	sofia_wheel_init(&timers->wheel, switch_epoch_time_now(NULL));
+	profile->sub_timers = timers;
+
+	sql = switch_mprintf("select call_id, expires, sub_to_user, event from sip_subscriptions "
+						 "where expires > 0 and profile_name='%q' and hostname='%q'",
+						 profile->name, mod_sofia_globals.hostname);
+	sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, sub_timers_load_callback, profile);
+	switch_safe_free(sql);
+}
+
+void sofia_presence_sub_timers_destroy(sofia_profile_t *profile)
+{
+	sofia_sub_timers_t *timers = profile->sub_timers;
+	switch_hash_index_t *hi;
+	void *val;
+
+	if (!timers) {
+		return;
+	}
+
+	profile->sub_timers = NULL;
+
+	switch_mutex_lock(timers->mutex);
+	for (hi = switch_hash_first(NULL, timers->by_call_id); hi; hi = switch_hash_next(hi)) {
+		sofia_sub_timer_t *timer;
+
+		switch_hash_this(hi, NULL, NULL, &val);
+		timer = (sofia_sub_timer_t *) val;
+		switch_safe_free(timer->watch);
+		free(timer);
+	}
+	switch_core_hash_destroy(&timers->by_call_id);
+	switch_core_hash_destroy(&timers->by_watch);
+	switch_mutex_unlock(timers->mutex);
+}
+
+/* sub_to_user and event may be NULL when the subscription is already known and only expires changes */
+void sofia_presence_sub_timer_set(sofia_profile_t *profile, const char *call_id, const char *sub_to_user, const char *event, time_t expires)
+{
+	sofia_sub_timers_t *timers = profile->sub_timers;
+	sofia_sub_timer_t *timer;
+
+	if (!timers || zstr(call_id)) {
+		return;
+	}
+
+	if (expires <= 0) {
+		sofia_presence_sub_timer_del(profile, call_id);
+		return;
+	}
+
+	switch_mutex_lock(timers->mutex);
+	if (!(timer = switch_core_hash_find(timers->by_call_id, call_id))) {
+		size_t len = strlen(call_id);
+
+		switch_zmalloc(timer, sizeof(*timer) + len);
+		memcpy(timer->call_id, call_id, len + 1);
+		timer->node.data = timer;
+		switch_core_hash_insert(timers->by_call_id, timer->call_id, timer);
+	}
+
+	if (sub_to_user && event) {
+		sub_watch_unref(timers, timer);
+		sub_watch_ref(timers, timer, sub_to_user, event);
+	}
+
+	sofia_wheel_add(&timers->wheel, &timer->node, expires);
+	switch_mutex_unlock(timers->mutex);
+}
+
+void sofia_presence_sub_timer_del(sofia_profile_t *profile, const char *call_id)
+{
+	sofia_sub_timers_t *timers = profile->sub_timers;
+	sofia_sub_timer_t *timer;
+
+	if (!timers || zstr(call_id)) {
+		return;
+	}
+
+	switch_mutex_lock(timers->mutex);
+	if ((timer = switch_core_hash_find(timers->by_call_id, call_id))) {
+		sofia_wheel_del(&timers->wheel, &timer->node);
+		switch_core_hash_delete(timers->by_call_id, call_id);
+		sub_watch_unref(timers, timer);
+		free(timer);
+	}
+	switch_mutex_unlock(timers->mutex);
+}
+
+/*
+ * Can a presence event for user (by event or alt_event) or for the subscription call_id reach anybody here,
+ * SWITCH_TRUE whenever it can't be ruled out.  sub_to_host is left to the sql, so this only ever says no
+ * when not one subscription on the profile is for that user and package.
+ */
+switch_bool_t sofia_presence_sub_watched(sofia_profile_t *profile, const char *user, const char *event, const char *alt_event, const char *call_id)
+{
+	sofia_sub_timers_t *timers = profile->sub_timers;
+	switch_bool_t watched = SWITCH_TRUE;
+	char key[512];
+
+	if (!timers || timers->rescan) {
+		return SWITCH_TRUE;
+	}
+
+	switch_mutex_lock(timers->mutex);
+	if (!zstr(call_id)) {
+		watched = switch_core_hash_find(timers->by_call_id, call_id) ? SWITCH_TRUE : SWITCH_FALSE;
+	} else if (user) {
+		switch_snprintf(key, sizeof(key), "%s|%s", user, switch_str_nil(event));
+		watched = switch_core_hash_find(timers->by_watch, key) ? SWITCH_TRUE : SWITCH_FALSE;
+
+		if (!watched && alt_event) {
+			switch_snprintf(key, sizeof(key), "%s|%s", user, alt_event);
+			watched = switch_core_hash_find(timers->by_watch, key) ? SWITCH_TRUE : SWITCH_FALSE;
 		}
+	}
+	switch_mutex_unlock(timers->mutex);
 
-		sql = switch_mprintf("update sip_subscriptions set version=version+1 where "
-							 "((expires > 0 and expires <= %ld)) and profile_name='%q' and hostname='%q'", 
-							 (long) now, profile->name, mod_sofia_globals.hostname);
+	return watched;
+}
 
-		sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
-		switch_safe_free(sql);
+void sofia_presence_sub_timers_rescan(sofia_profile_t *profile)
+{
+	if (profile->sub_timers) {
+		profile->sub_timers->rescan = 1;
+	}
+}
+
+static void sofia_presence_expire_subscriptions(sofia_profile_t *profile, time_t now, const char *in_call_ids)
+{
+	struct pres_sql_cb cb = {profile, 0};
+	char *sql;
+	char *where;
+
+	if (in_call_ids) {
+		where = switch_mprintf("((expires > 0 and expires <= %ld)) and call_id in (%s) and profile_name='%q' and hostname='%q'",
+							   (long) now, in_call_ids, profile->name, mod_sofia_globals.hostname);
+	} else {
+		where = switch_mprintf("((expires > 0 and expires <= %ld)) and profile_name='%q' and hostname='%q'",
+							   (long) now, profile->name, mod_sofia_globals.hostname);
+	}
+
+	sql = switch_mprintf("update sip_subscriptions set version=version+1 where %s", where);
+
+	sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+	switch_safe_free(sql);
+
+	sql = switch_mprintf("select full_to, full_from, contact, -1, call_id, event, network_ip, network_port, "
+						 "NULL as ct, NULL as pt "
+						 " from sip_subscriptions where %s", where);
+
+	sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, sofia_presence_send_sql, &cb);
+	switch_safe_free(sql);
 
-		sql = switch_mprintf("select full_to, full_from, contact, -1, call_id, event, network_ip, network_port, "
-							 "NULL as ct, NULL as pt "
-							 " from sip_subscriptions where ((expires > 0 and expires <= %ld)) and profile_name='%q' and hostname='%q'",
-							 (long) now, profile->name, mod_sofia_globals.hostname);
+	if (cb.ttl) {
+		sql = switch_mprintf("delete from sip_subscriptions where %s", where);
 
-		sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, sofia_presence_send_sql, &cb);
+		if (mod_sofia_globals.debug_presence > 0 || mod_sofia_globals.debug_sla > 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
+							  "sub del sql: %s\n", sql);		
+		}
+
+		sofia_glue_actually_execute_sql(profile, sql, profile->ireg_mutex);
 		switch_safe_free(sql);
+	}
+
+	switch_safe_free(where);
+}
 
-		if (cb.ttl) {
-			sql = switch_mprintf("delete from sip_subscriptions where ((expires > 0 and expires <= %ld)) "
-								 "and profile_name='%q' and hostname='%q'",
-								 (long) now, profile->name, mod_sofia_globals.hostname);
+void sofia_presence_check_subscriptions(sofia_profile_t *profile, time_t now) 
+{
+	sofia_sub_timers_t *timers = profile->sub_timers;
+	sofia_wheel_node_t *due, *node, *next;
+	switch_stream_handle_t stream = { 0 };
+	int batch = 0;
 
-			if (mod_sofia_globals.debug_presence > 0 || mod_sofia_globals.debug_sla > 0) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
-								  "sub del sql: %s\n", sql);		
-			}
+	if (!now) {
+		return;
+	}
 
-			sofia_glue_actually_execute_sql(profile, sql, profile->ireg_mutex);
-			switch_safe_free(sql);
+	if (profile->pres_type != PRES_TYPE_FULL) {
+		if (mod_sofia_globals.debug_presence > 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "check_subs: %s is passive, skipping\n", (char *) profile->name);
 		}
+		return;
+	}
+
+	if (!timers || timers->rescan) {
+		if (timers) {
+			timers->rescan = 0;
+		}
+		sofia_presence_expire_subscriptions(profile, now, NULL);
+		return;
+	}
+
+	switch_mutex_lock(timers->mutex);
+	due = sofia_wheel_advance(&timers->wheel, now);
+	for (node = due; node; node = node->next) {
+		switch_core_hash_delete(timers->by_call_id, ((sofia_sub_timer_t *) node->data)->call_id);
+		sub_watch_unref(timers, (sofia_sub_timer_t *) node->data);
 	}
+	switch_mutex_unlock(timers->mutex);
 
+	/* the due timers are off the wheel and out of the hash, nobody else can reach them now */
+	for (node = due; node; node = next) {
+		sofia_sub_timer_t *timer = (sofia_sub_timer_t *) node->data;
+		char *quoted;
 
+		next = node->next;
 
+		if (!batch) {
+			SWITCH_STANDARD_STREAM(stream);
+		}
+
+		quoted = switch_mprintf("%s'%q'", batch ? "," : "", timer->call_id);
+		stream.write_function(&stream, "%s", quoted);
+		switch_safe_free(quoted);
+		free(timer);
+
+		if (++batch == SUB_TIMER_BATCH || !next) {
+			sofia_presence_expire_subscriptions(profile, now, (char *) stream.data);
+			switch_safe_free(stream.data);
+			batch = 0;
+		}
+	}
 }
 
 
@@ -38,6 +38,612 @@
  */
 #include "mod_sofia.h"
 
+/*
+ * In memory registrations (registration-store).  Entries are found by call-id, by sip_user (a user's few
+ * contacts are then filtered by host) and by expiry through a timer wheel, so neither a REGISTER,
+ * a contact lookup nor the expiry sweep has to go to the database.  sip_registrations is still kept,
+ * write-behind, for everything else that reads it unless registration-store is memory-only.
+ * A second wheel spaces the nat options pings out per registration instead of pinging all of them at once.
+ * It is run from a timer on the stack thread, so with nat-keepalive=crlf a ping can go straight out of the
+ * transport as a bare CRLF instead of as an OPTIONS transaction.
+ */
+int sofia_reg_del_callback(void *pArg, int argc, char **argv, char **columnNames);
+int sofia_reg_check_callback(void *pArg, int argc, char **argv, char **columnNames);
+int sofia_reg_nat_callback(void *pArg, int argc, char **argv, char **columnNames);
+
+typedef struct sofia_reg_entry {
+	char *col[REG_COL_MAX];
+	long expires;
+	sofia_wheel_node_t expire_node;
+	sofia_wheel_node_t ping_node;
+	struct sofia_reg_entry *user_next;
+	struct sofia_reg_entry *all_next;
+	struct sofia_reg_entry **all_pprev;
+	struct sofia_reg_entry *dead_next;
+} sofia_reg_entry_t;
+
+struct sofia_reg_store {
+	switch_mutex_t *mutex;
+	switch_hash_t *by_call_id;
+	switch_hash_t *by_user;
+	sofia_reg_entry_t *all;
+	sofia_wheel_t expire_wheel;
+	sofia_wheel_t ping_wheel;
+	uint32_t count;
+};
+
+static void reg_entry_free(sofia_reg_entry_t *entry)
+{
+	int i;
+
+	for (i = 0; i < REG_COL_MAX; i++) {
+		switch_safe_free(entry->col[i]);
+	}
+
+	free(entry);
+}
+
+/* expires > 0 is what the table sweep looks at, anything else never expires */
+static void reg_wheel_link(sofia_reg_store_t *store, sofia_reg_entry_t *entry)
+{
+	if (entry->expires > 0) {
+		sofia_wheel_add(&store->expire_wheel, &entry->expire_node, (time_t) entry->expires);
+	}
+}
+
+static void reg_wheel_unlink(sofia_reg_store_t *store, sofia_reg_entry_t *entry)
+{
+	sofia_wheel_del(&store->expire_wheel, &entry->expire_node);
+}
+
+/* take an entry out of every index, the caller frees it */
+static void reg_store_unlink(sofia_reg_store_t *store, sofia_reg_entry_t *entry)
+{
+	sofia_reg_entry_t *head, *ep, *last = NULL;
+
+	reg_wheel_unlink(store, entry);
+	sofia_wheel_del(&store->ping_wheel, &entry->ping_node);
+
+	if ((*entry->all_pprev = entry->all_next)) {
+		entry->all_next->all_pprev = entry->all_pprev;
+	}
+	entry->all_next = NULL;
+	entry->all_pprev = NULL;
+
+	if (switch_core_hash_find(store->by_call_id, entry->col[REG_COL_CALL_ID]) == entry) {
+		switch_core_hash_delete(store->by_call_id, entry->col[REG_COL_CALL_ID]);
+	}
+
+	if ((head = switch_core_hash_find(store->by_user, entry->col[REG_COL_SIP_USER]))) {
+		for (ep = head; ep; ep = ep->user_next) {
+			if (ep == entry) {
+				if (last) {
+					last->user_next = ep->user_next;
+				} else if (ep->user_next) {
+					switch_core_hash_insert(store->by_user, entry->col[REG_COL_SIP_USER], ep->user_next);
+				} else {
+					switch_core_hash_delete(store->by_user, entry->col[REG_COL_SIP_USER]);
+				}
+				break;
+			}
+			last = ep;
+		}
+	}
+
+	entry->user_next = NULL;
+	store->count--;
+}
+
+static switch_bool_t reg_host_match(sofia_reg_entry_t *entry, const char *host)
+{
+	if (!host) {
+		return SWITCH_TRUE;
+	}
+
+	/* sip_host='host' or presence_hosts like '%host%' */
+	return (!strcmp(entry->col[REG_COL_SIP_HOST], host) || switch_stristr(host, entry->col[REG_COL_PRESENCE_HOSTS])) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+void sofia_reg_store_create(sofia_profile_t *profile)
+{
+	sofia_reg_store_t *store;
+
+	if (!profile->reg_store_mode || profile->reg_store) {
+		return;
+	}
+
+	store = switch_core_alloc(profile->pool, sizeof(*store));
+	switch_mutex_init(&store->mutex, SWITCH_MUTEX_NESTED, profile->pool);
+	switch_core_hash_init_case(&store->by_call_id, profile->pool, SWITCH_TRUE);
+	switch_core_hash_init_case(&store->by_user, profile->pool, SWITCH_TRUE);
+	sofia_wheel_init(&store->expire_wheel, switch_epoch_time_now(NULL));
+	sofia_wheel_init(&store->ping_wheel, switch_epoch_time_now(NULL));
+
+	profile->reg_store = store;
+}
+
+void sofia_reg_store_destroy(sofia_profile_t *profile)
+{
+	sofia_reg_store_t *store = profile->reg_store;
+	sofia_reg_entry_t *entry;
+
+	if (!store) {
+		return;
+	}
+
+	profile->reg_store = NULL;
+
+	switch_mutex_lock(store->mutex);
+	while ((entry = store->all)) {
+		reg_store_unlink(store, entry);
+		reg_entry_free(entry);
+	}
+	switch_core_hash_destroy(&store->by_call_id);
+	switch_core_hash_destroy(&store->by_user);
+	switch_mutex_unlock(store->mutex);
+}
+
+/* each registration gets pinged as often as the old sweep over the table would have */
+static time_t reg_ping_interval(sofia_profile_t *profile)
+{
+	return profile->ireg_seconds > 0 ? profile->ireg_seconds : 1;
+}
+
+uint32_t sofia_reg_store_size(sofia_profile_t *profile)
+{
+	return profile->reg_store ? profile->reg_store->count : 0;
+}
+
+void sofia_reg_store_add(sofia_profile_t *profile, const char *col[REG_COL_MAX], long expires)
+{
+	sofia_reg_store_t *store = profile->reg_store;
+	sofia_reg_entry_t *entry, *old;
+	char buf[32];
+	int i;
+
+	if (!store || zstr(col[REG_COL_CALL_ID]) || zstr(col[REG_COL_SIP_USER])) {
+		return;
+	}
+
+	switch_zmalloc(entry, sizeof(*entry));
+
+	for (i = 0; i < REG_COL_MAX; i++) {
+		entry->col[i] = strdup(switch_str_nil(col[i]));
+	}
+
+	switch_safe_free(entry->col[REG_COL_PROFILE_NAME]);
+	entry->col[REG_COL_PROFILE_NAME] = strdup(profile->name);
+	switch_snprintf(buf, sizeof(buf), "%ld", expires);
+	switch_safe_free(entry->col[REG_COL_EXPIRES]);
+	entry->col[REG_COL_EXPIRES] = strdup(buf);
+	entry->expires = expires;
+	entry->expire_node.data = entry;
+	entry->ping_node.data = entry;
+
+	switch_mutex_lock(store->mutex);
+
+	/* call_id is not unique in the table, but the newest row is the one that counts */
+	if ((old = switch_core_hash_find(store->by_call_id, entry->col[REG_COL_CALL_ID]))) {
+		reg_store_unlink(store, old);
+		reg_entry_free(old);
+	}
+
+	switch_core_hash_insert(store->by_call_id, entry->col[REG_COL_CALL_ID], entry);
+	entry->user_next = switch_core_hash_find(store->by_user, entry->col[REG_COL_SIP_USER]);
+	switch_core_hash_insert(store->by_user, entry->col[REG_COL_SIP_USER], entry);
+	if ((entry->all_next = store->all)) {
+		entry->all_next->all_pprev = &entry->all_next;
+	}
+	entry->all_pprev = &store->all;
+	store->all = entry;
+	reg_wheel_link(store, entry);
+	/* anywhere in the first interval, or everything loaded at startup would stay in one slot of the wheel */
+	sofia_wheel_add(&store->ping_wheel, &entry->ping_node, switch_epoch_time_now(NULL) + 1 + rand() % reg_ping_interval(profile));
+	store->count++;
+
+	switch_mutex_unlock(store->mutex);
+}
+
+/* delete where call_id=<call_id>, or where sip_user=<user> and sip_host=<host> [and contact=<contact>] */
+void sofia_reg_store_del(sofia_profile_t *profile, const char *call_id, const char *user, const char *host, const char *contact)
+{
+	sofia_reg_store_t *store = profile->reg_store;
+	sofia_reg_entry_t *entry, *next;
+
+	if (!store) {
+		return;
+	}
+
+	switch_mutex_lock(store->mutex);
+
+	if (call_id) {
+		if ((entry = switch_core_hash_find(store->by_call_id, call_id))) {
+			reg_store_unlink(store, entry);
+			reg_entry_free(entry);
+		}
+	} else if (user && host) {
+		for (entry = switch_core_hash_find(store->by_user, user); entry; entry = next) {
+			next = entry->user_next;
+
+			if (!strcmp(entry->col[REG_COL_SIP_HOST], host) && (!contact || !strcmp(entry->col[REG_COL_CONTACT], contact))) {
+				reg_store_unlink(store, entry);
+				reg_entry_free(entry);
+			}
+		}
+	}
+
+	switch_mutex_unlock(store->mutex);
+}
+
+static void reg_entry_set_expires(sofia_reg_store_t *store, sofia_reg_entry_t *entry, long expires)
+{
+	char buf[32];
+
+	reg_wheel_unlink(store, entry);
+	entry->expires = expires;
+	switch_snprintf(buf, sizeof(buf), "%ld", expires);
+	switch_safe_free(entry->col[REG_COL_EXPIRES]);
+	entry->col[REG_COL_EXPIRES] = strdup(buf);
+	reg_wheel_link(store, entry);
+}
+
+void sofia_reg_store_set_expires(sofia_profile_t *profile, const char *user, const char *host, long expires)
+{
+	sofia_reg_store_t *store = profile->reg_store;
+	sofia_reg_entry_t *entry;
+
+	if (!store || !user || !host) {
+		return;
+	}
+
+	switch_mutex_lock(store->mutex);
+	for (entry = switch_core_hash_find(store->by_user, user); entry; entry = entry->user_next) {
+		if (!strcmp(entry->col[REG_COL_SIP_HOST], host)) {
+			reg_entry_set_expires(store, entry, expires);
+		}
+	}
+	switch_mutex_unlock(store->mutex);
+}
+
+/* update ... where sip_user=<user> and sip_host=<host> and contact=<contact>, returns how many matched */
+int sofia_reg_store_touch(sofia_profile_t *profile, const char *user, const char *host, const char *contact,
+						  const char *network_ip, const char *network_port, long expires)
+{
+	sofia_reg_store_t *store = profile->reg_store;
+	sofia_reg_entry_t *entry;
+	int matches = 0;
+
+	if (!store || !user || !host || !contact) {
+		return 0;
+	}
+
+	switch_mutex_lock(store->mutex);
+	for (entry = switch_core_hash_find(store->by_user, user); entry; entry = entry->user_next) {
+		if (!strcmp(entry->col[REG_COL_SIP_HOST], host) && !strcmp(entry->col[REG_COL_CONTACT], contact)) {
+			switch_safe_free(entry->col[REG_COL_NETWORK_IP]);
+			entry->col[REG_COL_NETWORK_IP] = strdup(switch_str_nil(network_ip));
+			switch_safe_free(entry->col[REG_COL_NETWORK_PORT]);
+			entry->col[REG_COL_NETWORK_PORT] = strdup(switch_str_nil(network_port));
+			reg_entry_set_expires(store, entry, expires);
+			matches++;
+		}
+	}
+	switch_mutex_unlock(store->mutex);
+
+	return matches;
+}
+
+/* 
+ * "select <cols>[, <extra>] from sip_registrations where sip_user=<user> [and (sip_host=<host> or presence_hosts like '%<host>%')]
+ * [and contact not like '%<exclude_contact>%']", returns the number of rows handed to callback (callback may be NULL to count).
+ */
+int sofia_reg_store_select(sofia_profile_t *profile, const char *user, const char *host, const char *exclude_contact,
+						   const sofia_reg_col_t *cols, int ncols, const char *extra, switch_core_db_callback_func_t callback, void *pArg)
+{
+	sofia_reg_store_t *store = profile->reg_store;
+	sofia_reg_entry_t *entry;
+	char *argv[REG_COL_MAX + 1];
+	int i, matches = 0;
+
+	if (!store || !user || ncols > REG_COL_MAX) {
+		return 0;
+	}
+
+	switch_mutex_lock(store->mutex);
+	for (entry = switch_core_hash_find(store->by_user, user); entry; entry = entry->user_next) {
+		if (!reg_host_match(entry, host) || (exclude_contact && switch_stristr(exclude_contact, entry->col[REG_COL_CONTACT]))) {
+			continue;
+		}
+
+		matches++;
+
+		if (!callback) {
+			continue;
+		}
+
+		for (i = 0; i < ncols; i++) {
+			argv[i] = entry->col[cols[i]];
+		}
+
+		if (extra) {
+			argv[i++] = (char *) extra;
+		}
+
+		if (callback(pArg, i, argv, NULL)) {
+			break;
+		}
+	}
+	switch_mutex_unlock(store->mutex);
+
+	return matches;
+}
+
+/* the column order sofia_reg_del_callback and sofia_reg_check_callback expect */
+static const sofia_reg_col_t REG_DEL_COLS[] = {
+	REG_COL_CALL_ID, REG_COL_SIP_USER, REG_COL_SIP_HOST, REG_COL_CONTACT, REG_COL_STATUS, REG_COL_RPID, REG_COL_EXPIRES,
+	REG_COL_USER_AGENT, REG_COL_SERVER_USER, REG_COL_SERVER_HOST, REG_COL_PROFILE_NAME, REG_COL_NETWORK_IP
+};
+
+#define REG_DEL_NCOLS (sizeof(REG_DEL_COLS) / sizeof(REG_DEL_COLS[0]))
+
+/* run callback on a list of unlinked entries outside the store lock and free them */
+static void reg_store_reap(sofia_profile_t *profile, sofia_reg_entry_t *dead, int reboot, switch_core_db_callback_func_t callback)
+{
+	sofia_reg_entry_t *next;
+	char *argv[REG_DEL_NCOLS + 1];
+	char reboot_str[16];
+	int i;
+
+	switch_snprintf(reboot_str, sizeof(reboot_str), "%d", reboot);
+
+	for (; dead; dead = next) {
+		next = dead->dead_next;
+
+		for (i = 0; i < (int) REG_DEL_NCOLS; i++) {
+			argv[i] = dead->col[REG_DEL_COLS[i]];
+		}
+
+		if (reboot >= 0) {
+			argv[i++] = reboot_str;
+		}
+
+		callback(profile, i, argv, NULL);
+		reg_entry_free(dead);
+	}
+}
+
+/* expires > 0 and expires <= now, or every entry with expires > 0 when now is 0 */
+static void reg_store_expire(sofia_profile_t *profile, time_t now, int reboot)
+{
+	sofia_reg_store_t *store = profile->reg_store;
+	sofia_reg_entry_t *dead = NULL, *entry, *next;
+	sofia_wheel_node_t *node, *nnext;
+
+	if (!store) {
+		return;
+	}
+
+	switch_mutex_lock(store->mutex);
+
+	if (!now) {
+		for (entry = store->all; entry; entry = next) {
+			next = entry->all_next;
+			if (entry->expires > 0) {
+				reg_store_unlink(store, entry);
+				entry->dead_next = dead;
+				dead = entry;
+			}
+		}
+	} else {
+		for (node = sofia_wheel_advance(&store->expire_wheel, now); node; node = nnext) {
+			nnext = node->next;
+			entry = (sofia_reg_entry_t *) node->data;
+			reg_store_unlink(store, entry);
+			entry->dead_next = dead;
+			dead = entry;
+		}
+	}
+
+	switch_mutex_unlock(store->mutex);
+
+	reg_store_reap(profile, dead, reboot, sofia_reg_del_callback);
+}
+
+/* the columns sofia_reg_nat_callback expects */
+static const sofia_reg_col_t REG_NAT_COLS[] = {
+	REG_COL_CALL_ID, REG_COL_SIP_USER, REG_COL_SIP_HOST, REG_COL_CONTACT, REG_COL_STATUS, REG_COL_RPID, REG_COL_EXPIRES,
+	REG_COL_USER_AGENT, REG_COL_SERVER_USER, REG_COL_SERVER_HOST, REG_COL_PROFILE_NAME
+};
+
+#define REG_NAT_NCOLS (sizeof(REG_NAT_COLS) / sizeof(REG_NAT_COLS[0]))
+
+/* a CRLF keepalive from the transport the registration came in on, SWITCH_FALSE when it needs an OPTIONS after all */
+static switch_bool_t reg_store_send_crlf(sofia_profile_t *profile, sofia_reg_entry_t *entry)
+{
+	const char *contact = entry->col[REG_COL_CONTACT];
+	tp_name_t tpn = { 0 };
+	tport_t *tports;
+
+	if (zstr(entry->col[REG_COL_NETWORK_IP]) || zstr(entry->col[REG_COL_NETWORK_PORT]) || !(tports = nta_agent_tports(profile->nua->nua_nta))) {
+		return SWITCH_FALSE;
+	}
+
+	if (switch_stristr("transport=tls", contact) || switch_stristr("sips:", contact)) {
+		tpn.tpn_proto = "tls";
+	} else if (switch_stristr("transport=tcp", contact)) {
+		tpn.tpn_proto = "tcp";
+	} else if (!switch_stristr("transport=", contact) || switch_stristr("transport=udp", contact)) {
+		tpn.tpn_proto = "udp";
+	} else {
+		return SWITCH_FALSE;
+	}
+
+	tpn.tpn_canon = tpn.tpn_host = entry->col[REG_COL_NETWORK_IP];
+	tpn.tpn_port = entry->col[REG_COL_NETWORK_PORT];
+
+	return tport_send_ping(tports, &tpn) == 0 ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+/* ping whatever registrations came due, same selection as the nat-options-ping/all-reg-options-ping queries */
+static void reg_store_ping(sofia_profile_t *profile, time_t now)
+{
+	sofia_reg_store_t *store = profile->reg_store;
+	sofia_reg_entry_t *entry;
+	sofia_wheel_node_t *node, *next;
+	switch_bool_t all = sofia_test_pflag(profile, PFLAG_ALL_REG_OPTIONS_PING) ? SWITCH_TRUE : SWITCH_FALSE;
+	switch_bool_t nat = sofia_test_pflag(profile, PFLAG_NAT_OPTIONS_PING) ? SWITCH_TRUE : SWITCH_FALSE;
+	switch_bool_t crlf = sofia_test_pflag(profile, PFLAG_NAT_KEEPALIVE_CRLF) ? SWITCH_TRUE : SWITCH_FALSE;
+	char *argv[REG_NAT_NCOLS];
+	int i;
+
+	switch_mutex_lock(store->mutex);
+	for (node = sofia_wheel_advance(&store->ping_wheel, now); node; node = next) {
+		next = node->next;
+		entry = (sofia_reg_entry_t *) node->data;
+
+		if ((all || (nat && (switch_stristr("NAT", entry->col[REG_COL_STATUS]) || switch_stristr("fs_nat=yes", entry->col[REG_COL_CONTACT])))) &&
+			!(crlf && reg_store_send_crlf(profile, entry))) {
+			for (i = 0; i < (int) REG_NAT_NCOLS; i++) {
+				argv[i] = entry->col[REG_NAT_COLS[i]];
+			}
+			sofia_reg_nat_callback(profile, i, argv, NULL);
+		}
+
+		sofia_wheel_add(&store->ping_wheel, node, now + reg_ping_interval(profile));
+	}
+	switch_mutex_unlock(store->mutex);
+}
+
+/* called every second from the profile worker thread, only touches what is due */
+void sofia_reg_store_tick(sofia_profile_t *profile, time_t now)
+{
+	if (!profile->reg_store) {
+		return;
+	}
+
+	switch_mutex_lock(profile->ireg_mutex);
+	reg_store_expire(profile, now, 0);
+	switch_mutex_unlock(profile->ireg_mutex);
+}
+
+static void reg_keepalive_timer(su_root_magic_t *magic, su_timer_t *t, su_timer_arg_t *arg)
+{
+	sofia_profile_t *profile = (sofia_profile_t *) arg;
+
+	if (profile->reg_store) {
+		reg_store_ping(profile, switch_epoch_time_now(NULL));
+	}
+}
+
+/* called from the profile thread, the pings then go out of su_root_step() along with everything else the stack sends */
+void sofia_reg_keepalive_start(sofia_profile_t *profile)
+{
+	if (!profile->reg_store || profile->keepalive_timer) {
+		return;
+	}
+
+	if (!(profile->keepalive_timer = su_timer_create(su_root_task(profile->s_root), 1000)) ||
+		su_timer_set_for_ever(profile->keepalive_timer, reg_keepalive_timer, profile) < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "%s: cannot start the registration keepalive timer\n", profile->name);
+		su_timer_destroy(profile->keepalive_timer);
+		profile->keepalive_timer = NULL;
+	}
+}
+
+void sofia_reg_keepalive_stop(sofia_profile_t *profile)
+{
+	if (profile->keepalive_timer) {
+		su_timer_destroy(profile->keepalive_timer);
+		profile->keepalive_timer = NULL;
+	}
+}
+
+/* call_id=<call_id> or (sip_user=<user> and sip_host=<host>), or sip_host=<host> without a user */
+static void reg_store_match_call_id(sofia_profile_t *profile, const char *call_id, const char *user, const char *host, switch_bool_t remove,
+									int reboot, switch_core_db_callback_func_t callback)
+{
+	sofia_reg_store_t *store = profile->reg_store;
+	sofia_reg_entry_t *dead = NULL, *entry, *next;
+
+	if (!store) {
+		return;
+	}
+
+	switch_mutex_lock(store->mutex);
+	for (entry = store->all; entry; entry = next) {
+		next = entry->all_next;
+
+		if (strcmp(entry->col[REG_COL_CALL_ID], call_id) &&
+			(strcmp(entry->col[REG_COL_SIP_HOST], host) || (!zstr(user) && strcmp(entry->col[REG_COL_SIP_USER], user)))) {
+			continue;
+		}
+
+		if (remove) {
+			reg_store_unlink(store, entry);
+			entry->dead_next = dead;
+			dead = entry;
+		} else {
+			char *argv[REG_DEL_NCOLS];
+			int j;
+
+			for (j = 0; j < (int) REG_DEL_NCOLS; j++) {
+				argv[j] = entry->col[REG_DEL_COLS[j]];
+			}
+			callback(profile, j, argv, NULL);
+		}
+	}
+	switch_mutex_unlock(store->mutex);
+
+	reg_store_reap(profile, dead, reboot, callback);
+}
+
+static int reg_store_load_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	sofia_profile_t *profile = (sofia_profile_t *) pArg;
+	const char *col[REG_COL_MAX] = { 0 };
+	int i;
+
+	for (i = 0; i < argc && i < REG_COL_MAX; i++) {
+		col[i] = argv[i];
+	}
+
+	sofia_reg_store_add(profile, col, atol(switch_str_nil(col[REG_COL_EXPIRES])));
+
+	return 0;
+}
+
+/* pick up what's already in the table from before a restart, runs once after the profile's db is set up */
+void sofia_reg_store_load(sofia_profile_t *profile)
+{
+	char *sql;
+
+	if (!profile->reg_store) {
+		return;
+	}
+
+	/* same order as sofia_reg_col_t */
+	sql = switch_mprintf("select call_id,sip_user,sip_host,presence_hosts,contact,status,rpid,expires,user_agent,server_user,server_host,"
+						 "profile_name,network_ip,network_port,sip_username from sip_registrations where profile_name='%q' and hostname='%q'",
+						 profile->name, mod_sofia_globals.hostname);
+	sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, reg_store_load_callback, profile);
+	switch_safe_free(sql);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Profile %s: %u registrations loaded into the registration store\n",
+					  profile->name, sofia_reg_store_size(profile));
+}
+
+/* registration writes: immediate without the store, write-behind with it, dropped when it is memory only */
+static void reg_store_sql(sofia_profile_t *profile, char **sqlp)
+{
+	if (!profile->reg_store) {
+		sofia_glue_execute_sql_now(profile, sqlp, SWITCH_TRUE);
+	} else if (profile->reg_store_mode == 1) {
+		sofia_glue_execute_sql(profile, sqlp, SWITCH_TRUE);
+	} else {
+		switch_safe_free(*sqlp);
+	}
+}
+
 static void sofia_reg_new_handle(sofia_gateway_t *gateway_ptr, int attach)
 {
 	int ss_state = nua_callstate_authenticating;
@@ -272,11 +878,22 @@ void sofia_sub_check_gateway(sofia_profile_t *profile, time_t now)
 	switch_mutex_unlock(profile->gw_mutex);
 }
 
+/* up to a tenth of seconds, taken off timers so gateways that started together drift apart instead of firing together forever */
+int sofia_reg_jitter(int seconds)
+{
+	if (seconds < 10) {
+		return 0;
+	}
+
+	return rand() % (seconds / 10 + 1);
+}
+
 void sofia_reg_check_gateway(sofia_profile_t *profile, time_t now)
 {
 	sofia_gateway_t *check, *gateway_ptr, *last = NULL;
 	switch_event_t *event;
 	int delta = 0;
+	uint32_t sent = 0;
 
 	switch_mutex_lock(profile->gw_mutex);
 	for (gateway_ptr = profile->gateways; gateway_ptr; gateway_ptr = gateway_ptr->next) {
@@ -382,6 +999,8 @@ void sofia_reg_check_gateway(sofia_profile_t *profile, time_t now)
 			if (delta < 1) {
 				delta = 1;
 			}
+
+			delta -= sofia_reg_jitter(delta);
 			
 			gateway_ptr->expires = now + delta;
 
@@ -395,6 +1014,12 @@ void sofia_reg_check_gateway(sofia_profile_t *profile, time_t now)
 			gateway_ptr->status = SOFIA_GATEWAY_DOWN;
 			break;
 		case REG_STATE_UNREGED:
+			/* with thousands of gateways the ones over budget wait for the next pass instead of going out in one burst */
+			if (now && profile->gateway_register_burst && sent >= profile->gateway_register_burst) {
+				break;
+			}
+			sent++;
+
 			gateway_ptr->retry = 0;
 
 			if (!gateway_ptr->nh) {
@@ -468,7 +1093,7 @@ void sofia_reg_check_gateway(sofia_profile_t *profile, time_t now)
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s Failed Registration [%d], setting retry to %d seconds.\n",
 								  gateway_ptr->name, gateway_ptr->failure_status, sec);
 
-				gateway_ptr->retry = switch_epoch_time_now(NULL) + sec;
+				gateway_ptr->retry = switch_epoch_time_now(NULL) + sec + sofia_reg_jitter(sec);
 				gateway_ptr->status = SOFIA_GATEWAY_DOWN;
 				gateway_ptr->state = REG_STATE_FAIL_WAIT;
 				gateway_ptr->failure_status = 0;
@@ -671,17 +1296,26 @@ void sofia_reg_expire_call_id(sofia_profile_t *profile, const char *call_id, int
 		sqlextra = switch_mprintf(" or (sip_user='%q' and sip_host='%q')", user, host);
 	}
 
-	sql = switch_mprintf("select call_id,sip_user,sip_host,contact,status,rpid,expires"
-						 ",user_agent,server_user,server_host,profile_name,network_ip"
-						 ",%d from sip_registrations where call_id='%q' %s", reboot, call_id, sqlextra);
+	if (profile->reg_store) {
+		switch_mutex_lock(profile->ireg_mutex);
+		reg_store_match_call_id(profile, call_id, user, host, SWITCH_TRUE, reboot, sofia_reg_del_callback);
+		switch_mutex_unlock(profile->ireg_mutex);
 
-	switch_mutex_lock(profile->ireg_mutex);
-	sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_reg_del_callback, profile);
-	switch_mutex_unlock(profile->ireg_mutex);
-	switch_safe_free(sql);
+		sql = switch_mprintf("delete from sip_registrations where call_id='%q' %s", call_id, sqlextra);
+		reg_store_sql(profile, &sql);
+	} else {
+		sql = switch_mprintf("select call_id,sip_user,sip_host,contact,status,rpid,expires"
+							 ",user_agent,server_user,server_host,profile_name,network_ip"
+							 ",%d from sip_registrations where call_id='%q' %s", reboot, call_id, sqlextra);
 
-	sql = switch_mprintf("delete from sip_registrations where call_id='%q' %s", call_id, sqlextra);
-	sofia_glue_execute_sql_now(profile, &sql, SWITCH_FALSE);
+		switch_mutex_lock(profile->ireg_mutex);
+		sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_reg_del_callback, profile);
+		switch_mutex_unlock(profile->ireg_mutex);
+		switch_safe_free(sql);
+
+		sql = switch_mprintf("delete from sip_registrations where call_id='%q' %s", call_id, sqlextra);
+		sofia_glue_execute_sql_now(profile, &sql, SWITCH_FALSE);
+	}
 
 	switch_safe_free(sqlextra);
 	switch_safe_free(sql);
@@ -695,24 +1329,41 @@ void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot)
 
 	switch_mutex_lock(profile->ireg_mutex);
 
-	if (now) {
-		switch_snprintf(sql, sizeof(sql), "select call_id,sip_user,sip_host,contact,status,rpid,expires"
-						",user_agent,server_user,server_host,profile_name,network_ip"
-						",%d from sip_registrations where expires > 0 and expires <= %ld", reboot, (long) now);
-	} else {
-		switch_snprintf(sql, sizeof(sql), "select call_id,sip_user,sip_host,contact,status,rpid,expires"
-						",user_agent,server_user,server_host,profile_name,network_ip" ",%d from sip_registrations where expires > 0", reboot);
-	}
+	if (profile->reg_store) {
+		/* normally sofia_reg_store_tick got there first, the table delete is write-behind */
+		reg_store_expire(profile, now, reboot);
 
-	sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_reg_del_callback, profile);
-	if (now) {
-		switch_snprintfv(sql, sizeof(sql), "delete from sip_registrations where expires > 0 and expires <= %ld and hostname='%q'",
-						(long) now, mod_sofia_globals.hostname);
+		if (profile->reg_store_mode == 1) {
+			char *del;
+
+			if (now) {
+				del = switch_mprintf("delete from sip_registrations where expires > 0 and expires <= %ld and hostname='%q'",
+									 (long) now, mod_sofia_globals.hostname);
+			} else {
+				del = switch_mprintf("delete from sip_registrations where expires > 0 and hostname='%q'", mod_sofia_globals.hostname);
+			}
+			sofia_glue_execute_sql(profile, &del, SWITCH_TRUE);
+		}
 	} else {
-		switch_snprintfv(sql, sizeof(sql), "delete from sip_registrations where expires > 0 and hostname='%q'", mod_sofia_globals.hostname);
-	}
+		if (now) {
+			switch_snprintf(sql, sizeof(sql), "select call_id,sip_user,sip_host,contact,status,rpid,expires"
+							",user_agent,server_user,server_host,profile_name,network_ip"
+							",%d from sip_registrations where expires > 0 and expires <= %ld", reboot, (long) now);
+		} else {
+			switch_snprintf(sql, sizeof(sql), "select call_id,sip_user,sip_host,contact,status,rpid,expires"
+							",user_agent,server_user,server_host,profile_name,network_ip" ",%d from sip_registrations where expires > 0", reboot);
+		}
 
-	sofia_glue_actually_execute_sql(profile, sql, NULL);
+		sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_reg_del_callback, profile);
+		if (now) {
+			switch_snprintfv(sql, sizeof(sql), "delete from sip_registrations where expires > 0 and expires <= %ld and hostname='%q'",
+							(long) now, mod_sofia_globals.hostname);
+		} else {
+			switch_snprintfv(sql, sizeof(sql), "delete from sip_registrations where expires > 0 and hostname='%q'", mod_sofia_globals.hostname);
+		}
+
+		sofia_glue_actually_execute_sql(profile, sql, NULL);
+	}
 
 
 
@@ -738,14 +1389,16 @@ void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot)
 
 	sofia_glue_actually_execute_sql(profile, sql, NULL);
 
-	if (now) {
-		switch_snprintfv(sql, sizeof(sql), "delete from sip_authentication where expires > 0 and expires <= %ld and hostname='%q'",
-						(long) now, mod_sofia_globals.hostname);
-	} else {
-		switch_snprintfv(sql, sizeof(sql), "delete from sip_authentication where expires > 0 and hostname='%q'", mod_sofia_globals.hostname);
-	}
+	if (!profile->auth_nonce_memory) {
+		if (now) {
+			switch_snprintfv(sql, sizeof(sql), "delete from sip_authentication where expires > 0 and expires <= %ld and hostname='%q'",
+							(long) now, mod_sofia_globals.hostname);
+		} else {
+			switch_snprintfv(sql, sizeof(sql), "delete from sip_authentication where expires > 0 and hostname='%q'", mod_sofia_globals.hostname);
+		}
 
-	sofia_glue_actually_execute_sql(profile, sql, NULL);
+		sofia_glue_actually_execute_sql(profile, sql, NULL);
+	}
 	
 	sofia_presence_check_subscriptions(profile, now);
 
@@ -759,7 +1412,8 @@ void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot)
 	sofia_glue_actually_execute_sql(profile, sql, NULL);
 
 
-	if (now) {
+	/* the store pings from its own wheel in sofia_reg_store_tick */
+	if (now && !profile->reg_store) {
 		if (sofia_test_pflag(profile, PFLAG_ALL_REG_OPTIONS_PING)) {
 			switch_snprintf(sql, sizeof(sql), "select call_id,sip_user,sip_host,contact,status,rpid,"
 							"expires,user_agent,server_user,server_host,profile_name"
@@ -818,13 +1472,19 @@ void sofia_reg_check_call_id(sofia_profile_t *profile, const char *call_id)
 		sqlextra = switch_mprintf(" or (sip_user='%q' and sip_host='%q')", user, host);
 	}
 
-	sql = switch_mprintf("select call_id,sip_user,sip_host,contact,status,rpid,expires"
-						 ",user_agent,server_user,server_host,profile_name,network_ip"
-						 " from sip_registrations where call_id='%q' %s", call_id, sqlextra);
+	if (profile->reg_store) {
+		switch_mutex_lock(profile->ireg_mutex);
+		reg_store_match_call_id(profile, call_id, user, host, SWITCH_FALSE, 0, sofia_reg_check_callback);
+		switch_mutex_unlock(profile->ireg_mutex);
+	} else {
+		sql = switch_mprintf("select call_id,sip_user,sip_host,contact,status,rpid,expires"
+							 ",user_agent,server_user,server_host,profile_name,network_ip"
+							 " from sip_registrations where call_id='%q' %s", call_id, sqlextra);
 
-	switch_mutex_lock(profile->ireg_mutex);
-	sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_reg_check_callback, profile);
-	switch_mutex_unlock(profile->ireg_mutex);
+		switch_mutex_lock(profile->ireg_mutex);
+		sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_reg_check_callback, profile);
+		switch_mutex_unlock(profile->ireg_mutex);
+	}
 
 	switch_safe_free(sql);
 	switch_safe_free(sqlextra);
@@ -838,12 +1498,15 @@ void sofia_reg_check_sync(sofia_profile_t *profile)
 
 	switch_mutex_lock(profile->ireg_mutex);
 
-	switch_snprintf(sql, sizeof(sql), "select call_id,sip_user,sip_host,contact,status,rpid,expires"
-					",user_agent,server_user,server_host,profile_name,network_ip" 
-					" from sip_registrations where expires > 0");
-
+	if (profile->reg_store) {
+		reg_store_expire(profile, 0, -1);
+	} else {
+		switch_snprintf(sql, sizeof(sql), "select call_id,sip_user,sip_host,contact,status,rpid,expires"
+						",user_agent,server_user,server_host,profile_name,network_ip" 
+						" from sip_registrations where expires > 0");
 
-	sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_reg_del_callback, profile);
+		sofia_glue_execute_sql_callback(profile, NULL, sql, sofia_reg_del_callback, profile);
+	}
 	switch_snprintfv(sql, sizeof(sql), "delete from sip_registrations where expires > 0 and hostname='%q'", mod_sofia_globals.hostname);
 	sofia_glue_actually_execute_sql(profile, sql, NULL);
 
@@ -864,10 +1527,30 @@ void sofia_reg_check_sync(sofia_profile_t *profile)
 
 }
 
+/* the registration lookups run constantly, keep their text fixed so the handle's prepared statement is reused */
+#define REG_LOOKUP_SQL(_cols) "select " _cols " from sip_registrations where sip_user=?"
+#define REG_LOOKUP_HOST_SQL(_cols) "select " _cols " from sip_registrations where sip_user=? and (sip_host=? or presence_hosts like ?)"
+
+static const sofia_reg_col_t REG_CONTACT_COLS[] = { REG_COL_CONTACT, REG_COL_EXPIRES };
+
+static void reg_lookup_args(switch_cache_db_arg_t *args, int *argc, const char *user, const char *host, char *like, switch_size_t like_len)
+{
+	*argc = 0;
+	switch_cache_db_arg_text(&args[(*argc)++], user);
+
+	if (host) {
+		switch_snprintf(like, like_len, "%%%s%%", host);
+		switch_cache_db_arg_text(&args[(*argc)++], host);
+		switch_cache_db_arg_text(&args[(*argc)++], like);
+	}
+}
+
 char *sofia_reg_find_reg_url(sofia_profile_t *profile, const char *user, const char *host, char *val, switch_size_t len)
 {
 	struct callback_t cbt = { 0 };
-	char sql[512] = "";
+	switch_cache_db_arg_t args[3];
+	char like[512] = "";
+	int argc;
 
 	if (!user) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Called with null user!\n");
@@ -877,17 +1560,15 @@ char *sofia_reg_find_reg_url(sofia_profile_t *profile, const char *user, const c
 	cbt.val = val;
 	cbt.len = len;
 
-	if (host) {
-		switch_snprintfv(sql, sizeof(sql), "select contact from sip_registrations where sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%')",
-						user, host, host);
+	if (profile->reg_store) {
+		sofia_reg_store_select(profile, user, host, NULL, REG_CONTACT_COLS, 1, NULL, sofia_reg_find_callback, &cbt);
 	} else {
-		switch_snprintfv(sql, sizeof(sql), "select contact from sip_registrations where sip_user='%q'", user);
+		reg_lookup_args(args, &argc, user, host, like, sizeof(like));
+		sofia_glue_execute_prepared_callback(profile, profile->ireg_mutex, host ? REG_LOOKUP_HOST_SQL("contact") : REG_LOOKUP_SQL("contact"),
+											 args, argc, sofia_reg_find_callback, &cbt);
 	}
 
 
-	sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, sofia_reg_find_callback, &cbt);
-
-
 	if (cbt.matches) {
 		return val;
 	} else {
@@ -899,23 +1580,23 @@ char *sofia_reg_find_reg_url(sofia_profile_t *profile, const char *user, const c
 switch_console_callback_match_t *sofia_reg_find_reg_url_multi(sofia_profile_t *profile, const char *user, const char *host)
 {
 	struct callback_t cbt = { 0 };
-	char sql[512] = "";
+	switch_cache_db_arg_t args[3];
+	char like[512] = "";
+	int argc;
 
 	if (!user) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Called with null user!\n");
 		return NULL;
 	}
 
-	if (host) {
-		switch_snprintfv(sql, sizeof(sql), "select contact from sip_registrations where sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%')",
-						user, host, host);
+	if (profile->reg_store) {
+		sofia_reg_store_select(profile, user, host, NULL, REG_CONTACT_COLS, 1, NULL, sofia_reg_find_callback, &cbt);
 	} else {
-		switch_snprintfv(sql, sizeof(sql), "select contact from sip_registrations where sip_user='%q'", user);
+		reg_lookup_args(args, &argc, user, host, like, sizeof(like));
+		sofia_glue_execute_prepared_callback(profile, profile->ireg_mutex, host ? REG_LOOKUP_HOST_SQL("contact") : REG_LOOKUP_SQL("contact"),
+											 args, argc, sofia_reg_find_callback, &cbt);
 	}
 
-
-	sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, sofia_reg_find_callback, &cbt);
-
 	return cbt.list;
 }
 
@@ -923,26 +1604,307 @@ switch_console_callback_match_t *sofia_reg_find_reg_url_multi(sofia_profile_t *p
 switch_console_callback_match_t *sofia_reg_find_reg_url_with_positive_expires_multi(sofia_profile_t *profile, const char *user, const char *host)
 {
 	struct callback_t cbt = { 0 };
-	char sql[512] = "";
+	switch_cache_db_arg_t args[3];
+	char like[512] = "";
+	int argc;
 
 	if (!user) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Called with null user!\n");
 		return NULL;
 	}
 
-	if (host) {
-		switch_snprintfv(sql, sizeof(sql), "select contact,expires from sip_registrations where sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%')",
-						user, host, host);
+	if (profile->reg_store) {
+		sofia_reg_store_select(profile, user, host, NULL, REG_CONTACT_COLS, 2, NULL, sofia_reg_find_reg_with_positive_expires_callback, &cbt);
 	} else {
-		switch_snprintfv(sql, sizeof(sql), "select contact,expires from sip_registrations where sip_user='%q'", user);
+		reg_lookup_args(args, &argc, user, host, like, sizeof(like));
+		sofia_glue_execute_prepared_callback(profile, profile->ireg_mutex, host ? REG_LOOKUP_HOST_SQL("contact,expires") : REG_LOOKUP_SQL("contact,expires"),
+											 args, argc, sofia_reg_find_reg_with_positive_expires_callback, &cbt);
 	}
 
-	sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, sofia_reg_find_reg_with_positive_expires_callback, &cbt);
-
 	return cbt.list;
 }
 
 
+/*
+ * Digest nonces and directory lookups for auth, kept per profile.
+ * With auth-nonce-store=memory the nonces never touch sip_authentication, and auth-user-cache-ttl /
+ * auth-user-negative-cache-ttl keep the merged user (or the fact there is none) around so a phone
+ * re-registering every minute does not cost a directory lookup each time.  The cached user ignores the
+ * per request params, so only turn it on when the directory answers the same for every request.
+ */
+typedef struct {
+	sofia_wheel_node_t node;
+	time_t expires;
+	unsigned long last_nc;
+	char *nonce;
+} auth_nonce_t;
+
+typedef struct {
+	sofia_wheel_node_t node;
+	switch_xml_t user;			/* NULL is a cached miss */
+	char *key;
+} auth_user_t;
+
+struct sofia_auth_cache {
+	switch_mutex_t *mutex;
+	switch_hash_t *nonces;
+	switch_hash_t *users;
+	sofia_wheel_t nonce_wheel;
+	sofia_wheel_t user_wheel;
+	uint32_t hits;
+	uint32_t misses;
+};
+
+static void auth_nonce_free(sofia_auth_cache_t *cache, auth_nonce_t *an)
+{
+	sofia_wheel_del(&cache->nonce_wheel, &an->node);
+	switch_core_hash_delete(cache->nonces, an->nonce);
+	free(an->nonce);
+	free(an);
+}
+
+static void auth_user_free(sofia_auth_cache_t *cache, auth_user_t *au)
+{
+	sofia_wheel_del(&cache->user_wheel, &au->node);
+	switch_core_hash_delete(cache->users, au->key);
+	if (au->user) {
+		switch_xml_free(au->user);
+	}
+	free(au->key);
+	free(au);
+}
+
+void sofia_reg_auth_cache_create(sofia_profile_t *profile)
+{
+	sofia_auth_cache_t *cache;
+
+	if (profile->auth_cache) {
+		return;
+	}
+
+	cache = switch_core_alloc(profile->pool, sizeof(*cache));
+	switch_mutex_init(&cache->mutex, SWITCH_MUTEX_NESTED, profile->pool);
+	switch_core_hash_init_case(&cache->nonces, profile->pool, SWITCH_TRUE);
+	switch_core_hash_init_case(&cache->users, profile->pool, SWITCH_TRUE);
+	sofia_wheel_init(&cache->nonce_wheel, switch_epoch_time_now(NULL));
+	sofia_wheel_init(&cache->user_wheel, switch_epoch_time_now(NULL));
+
+	profile->auth_cache = cache;
+}
+
+void sofia_reg_auth_cache_destroy(sofia_profile_t *profile)
+{
+	sofia_auth_cache_t *cache = profile->auth_cache;
+	switch_hash_index_t *hi;
+	void *val;
+
+	if (!cache) {
+		return;
+	}
+
+	profile->auth_cache = NULL;
+
+	switch_mutex_lock(cache->mutex);
+	while ((hi = switch_hash_first(NULL, cache->nonces))) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		auth_nonce_free(cache, (auth_nonce_t *) val);
+	}
+	while ((hi = switch_hash_first(NULL, cache->users))) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		auth_user_free(cache, (auth_user_t *) val);
+	}
+	switch_core_hash_destroy(&cache->nonces);
+	switch_core_hash_destroy(&cache->users);
+	switch_mutex_unlock(cache->mutex);
+}
+
+void sofia_reg_auth_cache_tick(sofia_profile_t *profile, time_t now)
+{
+	sofia_auth_cache_t *cache = profile->auth_cache;
+	sofia_wheel_node_t *node, *next;
+
+	if (!cache) {
+		return;
+	}
+
+	switch_mutex_lock(cache->mutex);
+	for (node = sofia_wheel_advance(&cache->nonce_wheel, now); node; node = next) {
+		next = node->next;
+		auth_nonce_free(cache, (auth_nonce_t *) node->data);
+	}
+	for (node = sofia_wheel_advance(&cache->user_wheel, now); node; node = next) {
+		next = node->next;
+		auth_user_free(cache, (auth_user_t *) node->data);
+	}
+	switch_mutex_unlock(cache->mutex);
+}
+
+/* user and domain both NULL drops every cached user */
+uint32_t sofia_reg_auth_cache_flush(sofia_profile_t *profile, const char *user, const char *domain)
+{
+	sofia_auth_cache_t *cache = profile->auth_cache;
+	switch_hash_index_t *hi;
+	auth_user_t *au;
+	void *val;
+	uint32_t r = 0;
+
+	if (!cache) {
+		return 0;
+	}
+
+	switch_mutex_lock(cache->mutex);
+	if (user && domain) {
+		char *key = switch_mprintf("%s@%s", user, domain);
+
+		if ((au = switch_core_hash_find(cache->users, key))) {
+			auth_user_free(cache, au);
+			r++;
+		}
+		free(key);
+	} else {
+		while ((hi = switch_hash_first(NULL, cache->users))) {
+			switch_hash_this(hi, NULL, NULL, &val);
+			auth_user_free(cache, (auth_user_t *) val);
+			r++;
+		}
+	}
+	switch_mutex_unlock(cache->mutex);
+
+	return r;
+}
+
+switch_bool_t sofia_reg_auth_cache_stats(sofia_profile_t *profile, uint32_t *users, uint32_t *nonces, uint32_t *hits, uint32_t *misses)
+{
+	sofia_auth_cache_t *cache = profile->auth_cache;
+
+	if (!cache || (!profile->auth_nonce_memory && !profile->auth_user_cache_ttl && !profile->auth_user_negative_cache_ttl)) {
+		return SWITCH_FALSE;
+	}
+
+	switch_mutex_lock(cache->mutex);
+	*users = cache->user_wheel.count;
+	*nonces = cache->nonce_wheel.count;
+	*hits = cache->hits;
+	*misses = cache->misses;
+	switch_mutex_unlock(cache->mutex);
+
+	return SWITCH_TRUE;
+}
+
+static void auth_nonce_add(sofia_profile_t *profile, const char *nonce, time_t expires)
+{
+	sofia_auth_cache_t *cache = profile->auth_cache;
+	auth_nonce_t *an;
+
+	switch_zmalloc(an, sizeof(*an));
+	an->nonce = strdup(nonce);
+	an->expires = expires;
+	an->node.data = an;
+
+	switch_mutex_lock(cache->mutex);
+	switch_core_hash_insert(cache->nonces, an->nonce, an);
+	sofia_wheel_add(&cache->nonce_wheel, &an->node, expires);
+	switch_mutex_unlock(cache->mutex);
+}
+
+/* same answer as the select on sip_authentication: known, not expired and, when nc is in play, not replayed */
+static switch_bool_t auth_nonce_check(sofia_profile_t *profile, const char *nonce, unsigned long nc, int *last_nc)
+{
+	sofia_auth_cache_t *cache = profile->auth_cache;
+	auth_nonce_t *an;
+	switch_bool_t r = SWITCH_FALSE;
+
+	switch_mutex_lock(cache->mutex);
+	if ((an = switch_core_hash_find(cache->nonces, nonce))) {
+		if (an->expires > switch_epoch_time_now(NULL) && (!nc || an->last_nc < nc)) {
+			*last_nc = (int) an->last_nc;
+			r = SWITCH_TRUE;
+		} else {
+			auth_nonce_free(cache, an);
+		}
+	}
+	switch_mutex_unlock(cache->mutex);
+
+	return r;
+}
+
+static void auth_nonce_update(sofia_profile_t *profile, const char *nonce, time_t expires, unsigned long nc)
+{
+	sofia_auth_cache_t *cache = profile->auth_cache;
+	auth_nonce_t *an;
+
+	switch_mutex_lock(cache->mutex);
+	if ((an = switch_core_hash_find(cache->nonces, nonce))) {
+		an->expires = expires;
+		an->last_nc = nc;
+		sofia_wheel_add(&cache->nonce_wheel, &an->node, expires);
+	}
+	switch_mutex_unlock(cache->mutex);
+}
+
+static switch_status_t auth_locate_user(sofia_profile_t *profile, const char *user_name, const char *domain_name, const char *ip,
+										switch_xml_t *user, switch_event_t *params)
+{
+	sofia_auth_cache_t *cache = profile->auth_cache;
+	uint32_t ttl = profile->auth_user_cache_ttl, negative_ttl = profile->auth_user_negative_cache_ttl;
+	switch_status_t status;
+	auth_user_t *au;
+	char *key;
+
+	if (!cache || (!ttl && !negative_ttl)) {
+		return switch_xml_locate_user_merged("id", user_name, domain_name, ip, user, params);
+	}
+
+	key = switch_mprintf("%s@%s", user_name, domain_name);
+
+	switch_mutex_lock(cache->mutex);
+	if ((au = switch_core_hash_find(cache->users, key))) {
+		cache->hits++;
+		if (au->user) {
+			*user = switch_xml_dup(au->user);
+			status = SWITCH_STATUS_SUCCESS;
+		} else {
+			status = SWITCH_STATUS_FALSE;
+		}
+		switch_mutex_unlock(cache->mutex);
+		free(key);
+		return status;
+	}
+	cache->misses++;
+	switch_mutex_unlock(cache->mutex);
+
+	status = switch_xml_locate_user_merged("id", user_name, domain_name, ip, user, params);
+
+	if (status == SWITCH_STATUS_SUCCESS ? ttl : negative_ttl) {
+		switch_zmalloc(au, sizeof(*au));
+		au->key = key;
+		au->node.data = au;
+		if (status == SWITCH_STATUS_SUCCESS) {
+			au->user = switch_xml_dup(*user);
+		}
+
+		switch_mutex_lock(cache->mutex);
+		if (!switch_core_hash_find(cache->users, key)) {
+			switch_core_hash_insert(cache->users, key, au);
+			sofia_wheel_add(&cache->user_wheel, &au->node, switch_epoch_time_now(NULL) + (status == SWITCH_STATUS_SUCCESS ? ttl : negative_ttl));
+			au = NULL;
+		}
+		switch_mutex_unlock(cache->mutex);
+
+		if (au) {
+			if (au->user) {
+				switch_xml_free(au->user);
+			}
+			free(au->key);
+			free(au);
+		}
+	} else {
+		free(key);
+	}
+
+	return status;
+}
+
 void sofia_reg_auth_challenge(sofia_profile_t *profile, nua_handle_t *nh, sofia_dispatch_event_t *de,
 							  sofia_regtype_t regtype, const char *realm, int stale)
 {
@@ -959,13 +1921,17 @@ void sofia_reg_auth_challenge(sofia_profile_t *profile, nua_handle_t *nh, sofia_
 	switch_uuid_get(&uuid);
 	switch_uuid_format(uuid_str, &uuid);
 
-	sql = switch_mprintf("insert into sip_authentication (nonce,expires,profile_name,hostname, last_nc) "
-						 "values('%q', %ld, '%q', '%q', 0)", uuid_str,
-						 (long) switch_epoch_time_now(NULL) + (profile->nonce_ttl ? profile->nonce_ttl : DEFAULT_NONCE_TTL),
-						 profile->name, mod_sofia_globals.hostname);
-	switch_assert(sql != NULL);
-	sofia_glue_actually_execute_sql(profile, sql, profile->ireg_mutex);
-	switch_safe_free(sql);
+	if (profile->auth_nonce_memory && profile->auth_cache) {
+		auth_nonce_add(profile, uuid_str, switch_epoch_time_now(NULL) + (profile->nonce_ttl ? profile->nonce_ttl : DEFAULT_NONCE_TTL));
+	} else {
+		sql = switch_mprintf("insert into sip_authentication (nonce,expires,profile_name,hostname, last_nc) "
+							 "values('%q', %ld, '%q', '%q', 0)", uuid_str,
+							 (long) switch_epoch_time_now(NULL) + (profile->nonce_ttl ? profile->nonce_ttl : DEFAULT_NONCE_TTL),
+							 profile->name, mod_sofia_globals.hostname);
+		switch_assert(sql != NULL);
+		sofia_glue_actually_execute_sql(profile, sql, profile->ireg_mutex);
+		switch_safe_free(sql);
+	}
 
 	auth_str = switch_mprintf("Digest realm=\"%q\", nonce=\"%q\",%s algorithm=MD5, qop=\"auth\"", realm, uuid_str, stale ? " stale=true," : "");
 
@@ -980,17 +1946,28 @@ void sofia_reg_auth_challenge(sofia_profile_t *profile, nua_handle_t *nh, sofia_
 	switch_safe_free(auth_str);
 }
 
+static int sofia_reg_regcount_callback(void *pArg, int argc, char **argv, char **columnNames);
+
 uint32_t sofia_reg_reg_count(sofia_profile_t *profile, const char *user, const char *host)
 {
-	char buf[32] = "";
-	char *sql;
-	
-	sql = switch_mprintf("select count(*) from sip_registrations where profile_name='%q' and "
-						 "sip_user='%q' and (sip_host='%q' or presence_hosts like '%%%q%%')", profile->name, user, host, host);
-	
-	sofia_glue_execute_sql2str(profile, profile->ireg_mutex, sql, buf, sizeof(buf));
-	switch_safe_free(sql);
-	return atoi(buf);													
+	switch_cache_db_arg_t args[4];
+	char like[512] = "";
+	int count = 0;
+
+	if (profile->reg_store) {
+		return (uint32_t) sofia_reg_store_select(profile, user, host, NULL, NULL, 0, NULL, NULL, NULL);
+	}
+
+	switch_snprintf(like, sizeof(like), "%%%s%%", switch_str_nil(host));
+	switch_cache_db_arg_text(&args[0], profile->name);
+	switch_cache_db_arg_text(&args[1], user);
+	switch_cache_db_arg_text(&args[2], host);
+	switch_cache_db_arg_text(&args[3], like);
+
+	sofia_glue_execute_prepared_callback(profile, profile->ireg_mutex,
+										 "select count(*) from sip_registrations where profile_name=? and sip_user=? and (sip_host=? or presence_hosts like ?)",
+										 args, 4, sofia_reg_regcount_callback, &count);
+	return count;
 }
 
 static int debounce_check(sofia_profile_t *profile, const char *user, const char *host)
@@ -1544,7 +2521,18 @@ uint8_t sofia_reg_handle_register(nua_t *nua, sofia_profile_t *profile, nua_hand
 				sql = switch_mprintf("delete from sip_registrations where sip_user='%q' and sip_host='%q'", to_user, reg_host);
 			}
 			switch_mutex_lock(profile->ireg_mutex);
-			sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+			if (multi_reg && !multi_reg_contact) {
+				sofia_reg_store_del(profile, call_id, NULL, NULL, NULL);
+			} else {
+				sofia_reg_store_del(profile, NULL, to_user, reg_host, multi_reg ? contact_str : NULL);
+			}
+			reg_store_sql(profile, &sql);
+		} else if (profile->reg_store) {
+			switch_mutex_lock(profile->ireg_mutex);
+			if (sofia_reg_store_touch(profile, to_user, reg_host, contact_str, network_ip, network_port_c,
+									  (long) switch_epoch_time_now(NULL) + (long) exptime + 60) > 0) {
+				update_registration = SWITCH_TRUE;
+			}
 		} else {
 			char buf[32] = "";
 			sql = switch_mprintf("select count(*) from sip_registrations where sip_user='%q' and sip_host='%q' and contact='%q'", to_user, reg_host, contact_str);
@@ -1579,6 +2567,25 @@ uint8_t sofia_reg_handle_register(nua_t *nua, sofia_profile_t *profile, nua_hand
 					contact_str, reg_desc, rpid, (long) switch_epoch_time_now(NULL) + (long) exptime + 60, 
 					agent, from_user, guess_ip4, profile->name, mod_sofia_globals.hostname, network_ip, network_port_c, username, realm, 
 								 mwi_user, mwi_host, guess_ip4, mod_sofia_globals.hostname, sub_host);
+
+			if (profile->reg_store) {
+				const char *col[REG_COL_MAX] = { 0 };
+
+				col[REG_COL_CALL_ID] = call_id;
+				col[REG_COL_SIP_USER] = to_user;
+				col[REG_COL_SIP_HOST] = reg_host;
+				col[REG_COL_PRESENCE_HOSTS] = profile->presence_hosts;
+				col[REG_COL_CONTACT] = contact_str;
+				col[REG_COL_STATUS] = reg_desc;
+				col[REG_COL_RPID] = rpid;
+				col[REG_COL_USER_AGENT] = agent;
+				col[REG_COL_SERVER_USER] = from_user;
+				col[REG_COL_SERVER_HOST] = guess_ip4;
+				col[REG_COL_NETWORK_IP] = network_ip;
+				col[REG_COL_NETWORK_PORT] = network_port_c;
+				col[REG_COL_SIP_USERNAME] = username;
+				sofia_reg_store_add(profile, col, (long) switch_epoch_time_now(NULL) + (long) exptime + 60);
+			}
 		} else {
 			sql = switch_mprintf("update sip_registrations set "
 								 "sub_host='%q', network_ip='%q',network_port='%q',"
@@ -1589,7 +2596,7 @@ uint8_t sofia_reg_handle_register(nua_t *nua, sofia_profile_t *profile, nua_hand
 		}				 
 
 		if (sql) {
-			sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+			reg_store_sql(profile, &sql);
 		}
 
 		if (!update_registration && sofia_reg_reg_count(profile, to_user, reg_host) == 1) {
@@ -1666,17 +2673,20 @@ uint8_t sofia_reg_handle_register(nua_t *nua, sofia_profile_t *profile, nua_hand
 			if (multi_reg_contact) {
 				sql =
 					switch_mprintf("delete from sip_registrations where sip_user='%q' and sip_host='%q' and contact='%q'", to_user, reg_host, contact_str);
+				sofia_reg_store_del(profile, NULL, to_user, reg_host, contact_str);
 			} else {
 				sql = switch_mprintf("delete from sip_registrations where call_id='%q'", call_id);
+				sofia_reg_store_del(profile, call_id, NULL, NULL, NULL);
 			}
 
-			sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+			reg_store_sql(profile, &sql);
 
 			switch_safe_free(icontact);
 		} else {
 
 			if ((sql = switch_mprintf("delete from sip_registrations where sip_user='%q' and sip_host='%q'", to_user, reg_host))) {
-				sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
+				sofia_reg_store_del(profile, NULL, to_user, reg_host, NULL);
+				reg_store_sql(profile, &sql);
 			}
 		}
 	}
@@ -2327,22 +3337,30 @@ auth_res_t sofia_reg_parse_auth(sofia_profile_t *profile,
 
 	if (zstr(np)) {
 		nonce_cb_t cb = { 0 };
+		switch_cache_db_arg_t args[2];
 		long nc_long = 0;
 		first = 1;
 
-		if (nc) {
-			nc_long = strtoul(nc, 0, 16);
-			sql = switch_mprintf("select nonce,last_nc from sip_authentication where nonce='%q' and last_nc < %lu", nonce, nc_long);
-		} else {
-			sql = switch_mprintf("select nonce from sip_authentication where nonce='%q'", nonce);
-		}
-
 		cb.nonce = np;
 		cb.nplen = nplen;
 
-		switch_assert(sql != NULL);
-		sofia_glue_execute_sql_callback(profile, profile->ireg_mutex, sql, sofia_reg_nonce_callback, &cb);
-		free(sql);
+		switch_cache_db_arg_text(&args[0], nonce);
+
+		if (profile->auth_nonce_memory && profile->auth_cache) {
+			if (!auth_nonce_check(profile, nonce, nc ? strtoul(nc, 0, 16) : 0, &cb.last_nc)) {
+				ret = AUTH_STALE;
+				goto end;
+			}
+			switch_copy_string(np, nonce, nplen);
+		} else if (nc) {
+			nc_long = strtoul(nc, 0, 16);
+			switch_cache_db_arg_int64(&args[1], (int64_t) nc_long);
+			sofia_glue_execute_prepared_callback(profile, profile->ireg_mutex, "select nonce,last_nc from sip_authentication where nonce=? and last_nc < ?",
+												 args, 2, sofia_reg_nonce_callback, &cb);
+		} else {
+			sofia_glue_execute_prepared_callback(profile, profile->ireg_mutex, "select nonce from sip_authentication where nonce=?",
+												 args, 1, sofia_reg_nonce_callback, &cb);
+		}
 
 		//if (!sofia_glue_execute_sql2str(profile, profile->ireg_mutex, sql, np, nplen)) {
 		if (zstr(np)) {
@@ -2431,7 +3449,7 @@ auth_res_t sofia_reg_parse_auth(sofia_profile_t *profile,
 		domain_name = realm;
 	}
 
-	if (switch_xml_locate_user_merged("id", zstr(username) ? "nobody" : username, domain_name, ip, &user, params) != SWITCH_STATUS_SUCCESS) {
+	if (auth_locate_user(profile, zstr(username) ? "nobody" : username, domain_name, ip, &user, params) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Can't find user [%s@%s]\n"
 						  "You must define a domain called '%s' in your directory and add a user with the id=\"%s\" attribute\n"
 						  "and you must configure your device to use the proper domain in it's authentication credentials.\n", username, domain_name,
@@ -2773,12 +3791,16 @@ auth_res_t sofia_reg_parse_auth(sofia_profile_t *profile,
 #else
 #define	LL_FMT "l"
 #endif
-		sql = switch_mprintf("update sip_authentication set expires='%" LL_FMT "u',last_nc=%lu where nonce='%s'",
-							 switch_epoch_time_now(NULL) + (profile->nonce_ttl ? profile->nonce_ttl : exptime + 10), ncl, nonce);
+		if (profile->auth_nonce_memory && profile->auth_cache) {
+			auth_nonce_update(profile, nonce, switch_epoch_time_now(NULL) + (profile->nonce_ttl ? profile->nonce_ttl : exptime + 10), ncl);
+		} else {
+			sql = switch_mprintf("update sip_authentication set expires='%" LL_FMT "u',last_nc=%lu where nonce='%s'",
+								 switch_epoch_time_now(NULL) + (profile->nonce_ttl ? profile->nonce_ttl : exptime + 10), ncl, nonce);
 
-		switch_assert(sql != NULL);
-		sofia_glue_actually_execute_sql(profile, sql, profile->ireg_mutex);
-		switch_safe_free(sql);
+			switch_assert(sql != NULL);
+			sofia_glue_actually_execute_sql(profile, sql, profile->ireg_mutex);
+			switch_safe_free(sql);
+		}
 
 		if (ret == AUTH_OK)
 			ret = AUTH_RENEWED;
@@ -0,0 +1,874 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2012, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * mod_cdr_columnar.c -- Append-only, block compressed columnar CDR files
+ *
+ * File layout, all integers little endian:
+ *
+ *   header:  "FSCDRCOL" | u16 version | u16 columns | columns * (u8 type | u8 name_len | name)
+ *   block:   "FCB1" | u32 rows | u32 raw_len | u32 zlib_len | u32 crc32(raw) | zlib_len bytes
+ *
+ * The inflated block holds one segment per column in header order, each
+ * prefixed with its varint byte length so readers can skip columns:
+ *
+ *   string:    rows * (varint len | bytes)
+ *   dict:      varint entries | entries * (varint len | bytes) | rows * varint index (0 is empty)
+ *   int:       rows * zigzag varint
+ *   timestamp: rows * zigzag varint delta from the previous row (microseconds)
+ *
+ * Dictionaries are per block so every block decodes on its own.
+ */
+#include <sys/stat.h>
+#include <switch.h>
+#include <zlib.h>
+
+#define CDR_FILE_MAGIC "FSCDRCOL"
+#define CDR_FILE_VERSION 1
+#define CDR_BLOCK_MAGIC "FCB1"
+#define CDR_BLOCK_HEADER_SIZE 20
+#define CDR_MAX_BLOCK_ROWS 1048576
+
+typedef enum {
+	CDR_LEG_A = (1 << 0),
+	CDR_LEG_B = (1 << 1)
+} cdr_leg_t;
+
+typedef enum {
+	CDR_COL_STRING,
+	CDR_COL_DICT,
+	CDR_COL_INT,
+	CDR_COL_TIMESTAMP
+} cdr_col_type_t;
+
+typedef struct {
+	uint8_t *data;
+	switch_size_t len;
+	switch_size_t size;
+} cdr_buf_t;
+
+typedef struct {
+	char *name;
+	char *var;
+	cdr_col_type_t type;
+	cdr_buf_t values;
+	cdr_buf_t dict;
+	switch_hash_t *dict_hash;
+	uint32_t dict_count;
+	int64_t last;
+} cdr_column_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_mutex_t *write_mutex;
+	cdr_column_t *columns;
+	int column_count;
+	cdr_buf_t header;
+	char *log_dir;
+	char *path;
+	int fd;
+	int64_t bytes;
+	uint32_t rows;
+	uint32_t block_rows;
+	int level;
+	int flush_interval;
+	int rotate;
+	int shutdown;
+	cdr_leg_t legs;
+	uint64_t total_rows;
+	uint64_t total_blocks;
+	uint64_t raw_bytes;
+	uint64_t zlib_bytes;
+	uint64_t lost_rows;
+} globals;
+
+static struct {
+	const char *name;
+	cdr_col_type_t type;
+} default_columns[] = {
+	{"uuid", CDR_COL_STRING},
+	{"bleg_uuid", CDR_COL_STRING},
+	{"direction", CDR_COL_DICT},
+	{"caller_id_name", CDR_COL_STRING},
+	{"caller_id_number", CDR_COL_STRING},
+	{"destination_number", CDR_COL_STRING},
+	{"context", CDR_COL_DICT},
+	{"start_uepoch", CDR_COL_TIMESTAMP},
+	{"answer_uepoch", CDR_COL_TIMESTAMP},
+	{"end_uepoch", CDR_COL_TIMESTAMP},
+	{"duration", CDR_COL_INT},
+	{"billsec", CDR_COL_INT},
+	{"billmsec", CDR_COL_INT},
+	{"hangup_cause", CDR_COL_DICT},
+	{"accountcode", CDR_COL_DICT},
+	{"read_codec", CDR_COL_DICT},
+	{"write_codec", CDR_COL_DICT},
+	{"sip_gateway_name", CDR_COL_DICT},
+	{NULL, CDR_COL_STRING}
+};
+
+SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_columnar_load);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_cdr_columnar_shutdown);
+SWITCH_MODULE_DEFINITION(mod_cdr_columnar, mod_cdr_columnar_load, mod_cdr_columnar_shutdown, NULL);
+
+static void cdr_buf_put(cdr_buf_t *buf, const void *data, switch_size_t len)
+{
+	if (buf->len + len > buf->size) {
+		switch_size_t size = buf->size ? buf->size : 1024;
+
+		while (size < buf->len + len) {
+			size *= 2;
+		}
+
+		buf->data = realloc(buf->data, size);
+		switch_assert(buf->data);
+		buf->size = size;
+	}
+
+	memcpy(buf->data + buf->len, data, len);
+	buf->len += len;
+}
+
+static int varint_size(uint64_t v)
+{
+	int n = 1;
+
+	while (v >= 0x80) {
+		v >>= 7;
+		n++;
+	}
+
+	return n;
+}
+
+static void cdr_buf_put_varint(cdr_buf_t *buf, uint64_t v)
+{
+	uint8_t tmp[10];
+	int i = 0;
+
+	while (v >= 0x80) {
+		tmp[i++] = (uint8_t) (v | 0x80);
+		v >>= 7;
+	}
+	tmp[i++] = (uint8_t) v;
+
+	cdr_buf_put(buf, tmp, i);
+}
+
+static void cdr_buf_put_zigzag(cdr_buf_t *buf, int64_t v)
+{
+	cdr_buf_put_varint(buf, ((uint64_t) v << 1) ^ (uint64_t) (v >> 63));
+}
+
+static void cdr_buf_put_string(cdr_buf_t *buf, const char *s, switch_size_t len)
+{
+	cdr_buf_put_varint(buf, len);
+	if (len) {
+		cdr_buf_put(buf, s, len);
+	}
+}
+
+static void cdr_set_u16(uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+}
+
+static void cdr_set_u32(uint8_t *p, uint32_t v)
+{
+	p[0] = (uint8_t) v;
+	p[1] = (uint8_t) (v >> 8);
+	p[2] = (uint8_t) (v >> 16);
+	p[3] = (uint8_t) (v >> 24);
+}
+
+static const char *cdr_col_type2str(cdr_col_type_t type)
+{
+	switch (type) {
+	case CDR_COL_DICT:
+		return "dict";
+	case CDR_COL_INT:
+		return "int";
+	case CDR_COL_TIMESTAMP:
+		return "timestamp";
+	default:
+		return "string";
+	}
+}
+
+static cdr_col_type_t cdr_str2col_type(const char *str)
+{
+	if (!zstr(str)) {
+		if (!strcasecmp(str, "dict")) {
+			return CDR_COL_DICT;
+		} else if (!strcasecmp(str, "int")) {
+			return CDR_COL_INT;
+		} else if (!strcasecmp(str, "timestamp")) {
+			return CDR_COL_TIMESTAMP;
+		}
+	}
+
+	return CDR_COL_STRING;
+}
+
+/* append one row worth of this column, caller holds globals.mutex */
+static void column_add(cdr_column_t *col, const char *val)
+{
+	switch_size_t len = val ? strlen(val) : 0;
+	int64_t n;
+
+	switch (col->type) {
+	case CDR_COL_STRING:
+		cdr_buf_put_string(&col->values, val, len);
+		break;
+	case CDR_COL_DICT:
+		{
+			uint32_t idx = 0;
+
+			if (len) {
+				if (!col->dict_hash) {
+					switch_core_hash_init(&col->dict_hash, NULL);
+				}
+
+				if (!(idx = (uint32_t) (intptr_t) switch_core_hash_find(col->dict_hash, val))) {
+					idx = ++col->dict_count;
+					switch_core_hash_insert(col->dict_hash, val, (void *) (intptr_t) idx);
+					cdr_buf_put_string(&col->dict, val, len);
+				}
+			}
+
+			cdr_buf_put_varint(&col->values, idx);
+		}
+		break;
+	case CDR_COL_INT:
+	case CDR_COL_TIMESTAMP:
+		n = len ? (int64_t) strtoll(val, NULL, 10) : 0;
+
+		if (col->type == CDR_COL_TIMESTAMP) {
+			cdr_buf_put_zigzag(&col->values, n - col->last);
+			col->last = n;
+		} else {
+			cdr_buf_put_zigzag(&col->values, n);
+		}
+		break;
+	}
+}
+
+static void column_reset(cdr_column_t *col)
+{
+	col->values.len = 0;
+	col->dict.len = 0;
+	col->dict_count = 0;
+	col->last = 0;
+
+	if (col->dict_hash) {
+		switch_core_hash_destroy(&col->dict_hash);
+	}
+}
+
+static void column_free(cdr_column_t *col)
+{
+	column_reset(col);
+	switch_safe_free(col->values.data);
+	switch_safe_free(col->dict.data);
+	col->values.size = col->dict.size = 0;
+}
+
+/* serialize the pending rows into payload and start a new block, caller holds globals.mutex */
+static void encode_block(cdr_buf_t *payload)
+{
+	int x;
+
+	for (x = 0; x < globals.column_count; x++) {
+		cdr_column_t *col = &globals.columns[x];
+
+		if (col->type == CDR_COL_DICT) {
+			cdr_buf_put_varint(payload, varint_size(col->dict_count) + col->dict.len + col->values.len);
+			cdr_buf_put_varint(payload, col->dict_count);
+			if (col->dict.len) {
+				cdr_buf_put(payload, col->dict.data, col->dict.len);
+			}
+		} else {
+			cdr_buf_put_varint(payload, col->values.len);
+		}
+
+		if (col->values.len) {
+			cdr_buf_put(payload, col->values.data, col->values.len);
+		}
+
+		column_reset(col);
+	}
+
+	globals.rows = 0;
+}
+
+static off_t fd_size(int fd)
+{
+	struct stat s = { 0 };
+	fstat(fd, &s);
+	return s.st_size;
+}
+
+static int write_all(int fd, const uint8_t *data, switch_size_t len)
+{
+	while (len) {
+		ssize_t bytes = write(fd, data, len);
+
+		if (bytes <= 0) {
+			if (bytes < 0 && errno == EINTR) {
+				continue;
+			}
+			return -1;
+		}
+
+		data += bytes;
+		len -= bytes;
+	}
+
+	return 0;
+}
+
+static void move_aside(const char *path)
+{
+	switch_time_exp_t tm;
+	char date[80] = "";
+	switch_size_t retsize;
+	char *p;
+
+	switch_time_exp_lt(&tm, switch_micro_time_now());
+	switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d-%H-%M-%S", &tm);
+
+	p = switch_mprintf("%s.%s", path, date);
+	switch_assert(p);
+	switch_file_rename(path, p, globals.pool);
+	free(p);
+}
+
+/* a file written with another column layout would be unreadable past that point, so never append to one */
+static int header_matches(int fd)
+{
+	uint8_t *buf;
+	int r = 0;
+
+	switch_zmalloc(buf, globals.header.len);
+
+	if (pread(fd, buf, globals.header.len, 0) == (ssize_t) globals.header.len) {
+		r = !memcmp(buf, globals.header.data, globals.header.len);
+	}
+
+	free(buf);
+
+	return r;
+}
+
+/* caller holds globals.write_mutex */
+static void do_open(void)
+{
+	int x = 0;
+
+	if (globals.fd > -1) {
+		close(globals.fd);
+		globals.fd = -1;
+	}
+
+	for (x = 0; x < 10; x++) {
+		if ((globals.fd = open(globals.path, O_RDWR | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR)) > -1) {
+			break;
+		}
+		switch_yield(100000);
+	}
+
+	if (globals.fd < 0) {
+		switch_event_t *event;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Error opening %s\n", globals.path);
+		if (switch_event_create(&event, SWITCH_EVENT_TRAP) == SWITCH_STATUS_SUCCESS) {
+			switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Critical-Error", "Error opening cdr file %s\n", globals.path);
+			switch_event_fire(&event);
+		}
+		return;
+	}
+
+	if ((globals.bytes = fd_size(globals.fd)) && !header_matches(globals.fd)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s has a different column layout, moving it aside\n", globals.path);
+		close(globals.fd);
+		move_aside(globals.path);
+		if ((globals.fd = open(globals.path, O_RDWR | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR)) < 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Error opening %s\n", globals.path);
+			return;
+		}
+		globals.bytes = fd_size(globals.fd);
+	}
+
+	if (!globals.bytes) {
+		if (write_all(globals.fd, globals.header.data, globals.header.len)) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Error writing header to %s\n", globals.path);
+			close(globals.fd);
+			globals.fd = -1;
+			return;
+		}
+		globals.bytes = globals.header.len;
+	}
+}
+
+/* caller holds globals.write_mutex */
+static void do_rotate(void)
+{
+	if (globals.fd > -1) {
+		close(globals.fd);
+		globals.fd = -1;
+	}
+
+	if (globals.rotate) {
+		move_aside(globals.path);
+	}
+
+	do_open();
+
+	if (globals.fd > -1) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "%s CDR logfile %s\n", globals.rotate ? "Rotated" : "Re-opened", globals.path);
+	}
+}
+
+/* caller holds globals.write_mutex */
+static void write_block(cdr_buf_t *payload, uint32_t rows)
+{
+	uLongf zlen = compressBound((uLong) payload->len);
+	uint8_t *block;
+	switch_size_t len;
+	int r;
+
+	switch_zmalloc(block, CDR_BLOCK_HEADER_SIZE + zlen);
+
+	if ((r = compress2(block + CDR_BLOCK_HEADER_SIZE, &zlen, payload->data, (uLong) payload->len, globals.level)) != Z_OK) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error compressing block (%d), %u CDRs lost\n", r, rows);
+		globals.lost_rows += rows;
+		goto end;
+	}
+
+	memcpy(block, CDR_BLOCK_MAGIC, 4);
+	cdr_set_u32(block + 4, rows);
+	cdr_set_u32(block + 8, (uint32_t) payload->len);
+	cdr_set_u32(block + 12, (uint32_t) zlen);
+	cdr_set_u32(block + 16, (uint32_t) crc32(crc32(0L, Z_NULL, 0), payload->data, (uInt) payload->len));
+	len = CDR_BLOCK_HEADER_SIZE + zlen;
+
+	if (globals.fd < 0) {
+		do_open();
+	} else if (globals.bytes + len > UINT_MAX) {
+		do_rotate();
+	}
+
+	if (globals.fd < 0 || write_all(globals.fd, block, len)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Write error to file %s, %u CDRs lost\n", globals.path, rows);
+		globals.lost_rows += rows;
+
+		/* drop the partial block so the rest of the file stays readable, then start over on a fresh file */
+		if (globals.fd > -1) {
+			if (ftruncate(globals.fd, globals.bytes)) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Error truncating %s\n", globals.path);
+			}
+			do_rotate();
+		}
+		goto end;
+	}
+
+	globals.bytes += len;
+	globals.total_rows += rows;
+	globals.total_blocks++;
+	globals.raw_bytes += payload->len;
+	globals.zlib_bytes += zlen;
+
+  end:
+
+	free(block);
+}
+
+static void flush_block(void)
+{
+	cdr_buf_t payload = { 0 };
+	uint32_t rows;
+
+	switch_mutex_lock(globals.mutex);
+
+	if (!(rows = globals.rows)) {
+		switch_mutex_unlock(globals.mutex);
+		return;
+	}
+
+	encode_block(&payload);
+
+	/* take the writer before letting go of the block so blocks land in order, new rows can pile up meanwhile */
+	switch_mutex_lock(globals.write_mutex);
+	switch_mutex_unlock(globals.mutex);
+
+	write_block(&payload, rows);
+
+	switch_mutex_unlock(globals.write_mutex);
+
+	switch_safe_free(payload.data);
+}
+
+static switch_status_t my_on_reporting(switch_core_session_t *session)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	int x, full;
+
+	if (globals.shutdown) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!((globals.legs & CDR_LEG_A) && (globals.legs & CDR_LEG_B))) {
+		if ((globals.legs & CDR_LEG_A)) {
+			if (switch_channel_get_originator_caller_profile(channel)) {
+				return SWITCH_STATUS_SUCCESS;
+			}
+		} else {
+			if (switch_channel_get_originatee_caller_profile(channel)) {
+				return SWITCH_STATUS_SUCCESS;
+			}
+		}
+	}
+
+	switch_mutex_lock(globals.mutex);
+	for (x = 0; x < globals.column_count; x++) {
+		column_add(&globals.columns[x], switch_channel_get_variable(channel, globals.columns[x].var));
+	}
+	full = ++globals.rows >= globals.block_rows;
+	switch_mutex_unlock(globals.mutex);
+
+	if (full) {
+		flush_block();
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void do_rotate_all(void)
+{
+	if (globals.shutdown) {
+		return;
+	}
+
+	flush_block();
+
+	switch_mutex_lock(globals.write_mutex);
+	do_rotate();
+	switch_mutex_unlock(globals.write_mutex);
+}
+
+SWITCH_STANDARD_SCHED_FUNC(cdr_columnar_flush_callback)
+{
+	flush_block();
+
+	if (!globals.shutdown) {
+		task->runtime = switch_epoch_time_now(NULL) + globals.flush_interval;
+	}
+}
+
+static void event_handler(switch_event_t *event)
+{
+	const char *sig = switch_event_get_header(event, "Trapped-Signal");
+
+	if (sig && !strcmp(sig, "HUP")) {
+		do_rotate_all();
+	}
+}
+
+#define CDR_COLUMNAR_SYNTAX "rotate|flush|status"
+SWITCH_STANDARD_API(cdr_columnar_function)
+{
+	if (zstr(cmd)) {
+		stream->write_function(stream, "-USAGE: %s\n", CDR_COLUMNAR_SYNTAX);
+	} else if (!strcmp(cmd, "rotate")) {
+		do_rotate_all();
+		stream->write_function(stream, "+OK");
+	} else if (!strcmp(cmd, "flush")) {
+		flush_block();
+		stream->write_function(stream, "+OK");
+	} else if (!strcmp(cmd, "status")) {
+		int x;
+
+		switch_mutex_lock(globals.write_mutex);
+		stream->write_function(stream, "File: %s\n", globals.path);
+		stream->write_function(stream, "Bytes: %" SWITCH_INT64_T_FMT "\n", globals.bytes);
+		stream->write_function(stream, "Blocks written: %" SWITCH_UINT64_T_FMT "\n", globals.total_blocks);
+		stream->write_function(stream, "CDRs written: %" SWITCH_UINT64_T_FMT "\n", globals.total_rows);
+		stream->write_function(stream, "CDRs lost: %" SWITCH_UINT64_T_FMT "\n", globals.lost_rows);
+		stream->write_function(stream, "Raw bytes: %" SWITCH_UINT64_T_FMT "\n", globals.raw_bytes);
+		stream->write_function(stream, "Compressed bytes: %" SWITCH_UINT64_T_FMT "\n", globals.zlib_bytes);
+		switch_mutex_unlock(globals.write_mutex);
+
+		switch_mutex_lock(globals.mutex);
+		stream->write_function(stream, "CDRs pending: %u/%u\n", globals.rows, globals.block_rows);
+		switch_mutex_unlock(globals.mutex);
+
+		stream->write_function(stream, "Columns:\n");
+		for (x = 0; x < globals.column_count; x++) {
+			stream->write_function(stream, "  %s %s (%s)\n", globals.columns[x].name,
+								   cdr_col_type2str(globals.columns[x].type), globals.columns[x].var);
+		}
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", CDR_COLUMNAR_SYNTAX);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+
+static switch_state_handler_table_t state_handlers = {
+	/*.on_init */ NULL,
+	/*.on_routing */ NULL,
+	/*.on_execute */ NULL,
+	/*.on_hangup */ NULL,
+	/*.on_exchange_media */ NULL,
+	/*.on_soft_execute */ NULL,
+	/*.on_consume_media */ NULL,
+	/*.on_hibernate */ NULL,
+	/*.on_reset */ NULL,
+	/*.on_park */ NULL,
+	/*.on_reporting */ my_on_reporting
+};
+
+
+static void build_header(void)
+{
+	uint8_t tmp[4];
+	int x;
+
+	cdr_buf_put(&globals.header, CDR_FILE_MAGIC, 8);
+	cdr_set_u16(tmp, CDR_FILE_VERSION);
+	cdr_set_u16(tmp + 2, (uint16_t) globals.column_count);
+	cdr_buf_put(&globals.header, tmp, 4);
+
+	for (x = 0; x < globals.column_count; x++) {
+		size_t len = strlen(globals.columns[x].name);
+
+		tmp[0] = (uint8_t) globals.columns[x].type;
+		tmp[1] = (uint8_t) len;
+		cdr_buf_put(&globals.header, tmp, 2);
+		cdr_buf_put(&globals.header, globals.columns[x].name, len);
+	}
+}
+
+static switch_status_t load_config(switch_memory_pool_t *pool)
+{
+	char *cf = "cdr_columnar.conf";
+	switch_xml_t cfg, xml = NULL, settings, param, columns = NULL;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	char *file_name = "Master.fscdr";
+	int x = 0;
+
+	memset(&globals, 0, sizeof(globals));
+	globals.pool = pool;
+	globals.fd = -1;
+	globals.legs = CDR_LEG_A;
+	globals.block_rows = 4096;
+	globals.level = Z_DEFAULT_COMPRESSION;
+	globals.flush_interval = 60;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&globals.write_mutex, SWITCH_MUTEX_NESTED, pool);
+
+	if ((xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
+
+		if ((settings = switch_xml_child(cfg, "settings"))) {
+			for (param = switch_xml_child(settings, "param"); param; param = param->next) {
+				char *var = (char *) switch_xml_attr_soft(param, "name");
+				char *val = (char *) switch_xml_attr_soft(param, "value");
+				if (!strcasecmp(var, "legs")) {
+					globals.legs = 0;
+
+					if (strchr(val, 'a')) {
+						globals.legs |= CDR_LEG_A;
+					}
+
+					if (strchr(val, 'b')) {
+						globals.legs |= CDR_LEG_B;
+					}
+				} else if (!strcasecmp(var, "log-base")) {
+					globals.log_dir = switch_core_sprintf(pool, "%s%scdr-columnar", val, SWITCH_PATH_SEPARATOR);
+				} else if (!strcasecmp(var, "file-name") && !zstr(val)) {
+					file_name = switch_core_strdup(pool, val);
+				} else if (!strcasecmp(var, "rotate-on-hup")) {
+					globals.rotate = switch_true(val);
+				} else if (!strcasecmp(var, "block-rows")) {
+					int tmp = atoi(val);
+					if (tmp > 0 && tmp <= CDR_MAX_BLOCK_ROWS) {
+						globals.block_rows = tmp;
+					}
+				} else if (!strcasecmp(var, "compression-level")) {
+					int tmp = atoi(val);
+					if (tmp >= 0 && tmp <= 9) {
+						globals.level = tmp;
+					}
+				} else if (!strcasecmp(var, "flush-interval")) {
+					globals.flush_interval = atoi(val);
+				}
+			}
+		}
+
+		columns = switch_xml_child(cfg, "columns");
+	}
+
+	if (columns && (param = switch_xml_child(columns, "column"))) {
+		for (; param; param = param->next) {
+			x++;
+		}
+
+		globals.columns = switch_core_alloc(pool, sizeof(cdr_column_t) * x);
+		x = 0;
+
+		for (param = switch_xml_child(columns, "column"); param; param = param->next) {
+			const char *name = switch_xml_attr(param, "name");
+			const char *var = switch_xml_attr(param, "var");
+			cdr_column_t *col = &globals.columns[x];
+
+			if (zstr(name)) {
+				name = var;
+			}
+
+			if (zstr(name) || strlen(name) > 255) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Skipping column without a usable name\n");
+				continue;
+			}
+
+			col->name = switch_core_strdup(pool, name);
+			col->var = switch_core_strdup(pool, zstr(var) ? name : var);
+			col->type = cdr_str2col_type(switch_xml_attr(param, "type"));
+			x++;
+		}
+	} else {
+		for (; default_columns[x].name; x++);
+
+		globals.columns = switch_core_alloc(pool, sizeof(cdr_column_t) * x);
+
+		for (x = 0; default_columns[x].name; x++) {
+			globals.columns[x].name = globals.columns[x].var = (char *) default_columns[x].name;
+			globals.columns[x].type = default_columns[x].type;
+		}
+	}
+
+	globals.column_count = x;
+
+	if (xml) {
+		switch_xml_free(xml);
+	}
+
+	if (!globals.log_dir) {
+		globals.log_dir = switch_core_sprintf(pool, "%s%scdr-columnar", SWITCH_GLOBAL_dirs.log_dir, SWITCH_PATH_SEPARATOR);
+	}
+
+	globals.path = switch_core_sprintf(pool, "%s%s%s", globals.log_dir, SWITCH_PATH_SEPARATOR, file_name);
+
+	if (!globals.column_count) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "No columns configured\n");
+		status = SWITCH_STATUS_FALSE;
+	}
+
+	build_header();
+
+	return status;
+}
+
+
+SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_columnar_load)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	switch_api_interface_t *api_interface;
+
+	if ((status = load_config(pool)) != SWITCH_STATUS_SUCCESS) {
+		return status;
+	}
+
+	if ((status = switch_dir_make_recursive(globals.log_dir, SWITCH_DEFAULT_DIR_PERMS, pool)) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error creating %s\n", globals.log_dir);
+		return status;
+	}
+
+	switch_mutex_lock(globals.write_mutex);
+	do_open();
+	switch_mutex_unlock(globals.write_mutex);
+
+	if ((status = switch_event_bind(modname, SWITCH_EVENT_TRAP, SWITCH_EVENT_SUBCLASS_ANY, event_handler, NULL)) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
+		return status;
+	}
+
+	if (globals.flush_interval > 0) {
+		switch_scheduler_add_task(switch_epoch_time_now(NULL) + globals.flush_interval, cdr_columnar_flush_callback, "cdr_columnar_flush",
+								  "mod_cdr_columnar", 0, NULL, SSHF_NONE);
+	}
+
+	switch_core_add_state_handler(&state_handlers);
+	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
+
+	SWITCH_ADD_API(api_interface, "cdr_columnar", "cdr_columnar controls", cdr_columnar_function, CDR_COLUMNAR_SYNTAX);
+	switch_console_set_complete("add cdr_columnar rotate");
+	switch_console_set_complete("add cdr_columnar flush");
+	switch_console_set_complete("add cdr_columnar status");
+
+	return status;
+}
+
+
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_cdr_columnar_shutdown)
+{
+	int x;
+
+	switch_console_set_complete("del cdr_columnar");
+
+	globals.shutdown = 1;
+	switch_event_unbind_callback(event_handler);
+	switch_core_remove_state_handler(&state_handlers);
+	switch_scheduler_del_task_group("mod_cdr_columnar");
+
+	flush_block();
+
+	switch_mutex_lock(globals.write_mutex);
+	if (globals.fd > -1) {
+		close(globals.fd);
+		globals.fd = -1;
+	}
+	switch_mutex_unlock(globals.write_mutex);
+
+	for (x = 0; x < globals.column_count; x++) {
+		column_free(&globals.columns[x]);
+	}
+	switch_safe_free(globals.header.data);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -28,28 +28,70 @@
  */
 #include <sys/stat.h>
 #include <switch.h>
+#ifndef WIN32
+#include <sys/uio.h>
+#define CDR_CSV_BUFFERED
+#endif
+
+#define CDR_IOV_MAX 64
 
 typedef enum {
 	CDR_LEG_A = (1 << 0),
 	CDR_LEG_B = (1 << 1)
 } cdr_leg_t;
 
+typedef enum {
+	CDR_FSYNC_NEVER,
+	CDR_FSYNC_FLUSH,
+	CDR_FSYNC_ROTATE
+} cdr_fsync_t;
+
 struct cdr_fd {
 	int fd;
 	char *path;
 	int64_t bytes;
 	switch_mutex_t *mutex;
+#ifdef CDR_CSV_BUFFERED
+	/* lines waiting for the flusher thread */
+	struct iovec iov[CDR_IOV_MAX];
+	char *lines[CDR_IOV_MAX];
+	int iov_count;
+	switch_size_t pending;
+	int dirty;
+	struct cdr_fd *next_dirty;
+#endif
 };
 typedef struct cdr_fd cdr_fd_t;
 
+/* a line for the flusher, a NULL fd asks it to rotate every file */
+typedef struct {
+	cdr_fd_t *fd;
+	char *data;
+	switch_size_t len;
+} cdr_line_t;
+
 const char *default_template =
 	"\"${caller_id_name}\",\"${caller_id_number}\",\"${destination_number}\",\"${context}\",\"${start_stamp}\","
 	"\"${answer_stamp}\",\"${end_stamp}\",\"${duration}\",\"${billsec}\",\"${hangup_cause}\",\"${uuid}\",\"${bleg_uuid}\", \"${accountcode}\"\n";
 
+/* used when the configured default-template does not exist */
+const char *fallback_template =
+	"\"${accountcode}\",\"${caller_id_number}\",\"${destination_number}\",\"${context}\",\"${caller_id}\",\"${channel_name}\",\"${bridge_channel}\",\"${last_app}\",\"${last_arg}\",\"${start_stamp}\",\"${answer_stamp}\",\"${end_stamp}\",\"${duration}\",\"${billsec}\",\"${hangup_cause}\",\"${amaflags}\",\"${uuid}\",\"${userfield}\";";
+
 static struct {
 	switch_memory_pool_t *pool;
 	switch_hash_t *fd_hash;
+	switch_mutex_t *fd_mutex;
+	switch_queue_t *queue;
+	switch_thread_t *flush_thread;
+	switch_size_t buffer_size;
+	uint32_t queue_size;
+	uint32_t flush_interval;
+	cdr_fsync_t fsync_policy;
+	cdr_fd_t *dirty;
+	switch_time_t last_flush;
 	switch_hash_t *template_hash;
+	switch_expand_template_t *fallback_template;
 	char *log_dir;
 	char *default_template;
 	int masterfileonly;
@@ -95,6 +137,10 @@ static void do_rotate(cdr_fd_t *fd)
 	switch_size_t retsize;
 	char *p;
 
+	if (fd->fd > -1 && globals.fsync_policy != CDR_FSYNC_NEVER) {
+		fsync(fd->fd);
+	}
+
 	close(fd->fd);
 	fd->fd = -1;
 
@@ -124,12 +170,28 @@ static void do_rotate(cdr_fd_t *fd)
 
 }
 
-static void write_cdr(const char *path, const char *log_line)
+static void do_rotate_all_now(void)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	cdr_fd_t *fd;
+
+	switch_mutex_lock(globals.fd_mutex);
+	for (hi = switch_hash_first(NULL, globals.fd_hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		fd = (cdr_fd_t *) val;
+		switch_mutex_lock(fd->mutex);
+		do_rotate(fd);
+		switch_mutex_unlock(fd->mutex);
+	}
+	switch_mutex_unlock(globals.fd_mutex);
+}
+
+static cdr_fd_t *get_cdr_fd(const char *path)
 {
 	cdr_fd_t *fd = NULL;
-	unsigned int bytes_in, bytes_out;
-	int loops = 0;
 
+	switch_mutex_lock(globals.fd_mutex);
 	if (!(fd = switch_core_hash_find(globals.fd_hash, path))) {
 		fd = switch_core_alloc(globals.pool, sizeof(*fd));
 		switch_assert(fd);
@@ -139,6 +201,171 @@ static void write_cdr(const char *path, const char *log_line)
 		fd->path = switch_core_strdup(globals.pool, path);
 		switch_core_hash_insert(globals.fd_hash, path, fd);
 	}
+	switch_mutex_unlock(globals.fd_mutex);
+
+	return fd;
+}
+
+#ifdef CDR_CSV_BUFFERED
+/* write everything pending on this file in one go, only the flusher thread touches the pending lines */
+static void flush_cdr_fd(cdr_fd_t *fd)
+{
+	struct iovec *iov = fd->iov;
+	int iovcnt = fd->iov_count, loops = 0, x;
+	ssize_t bytes_in;
+
+	if (!iovcnt) {
+		return;
+	}
+
+	switch_mutex_lock(fd->mutex);
+
+	if (fd->fd < 0) {
+		do_reopen(fd);
+		if (fd->fd < 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error opening %s\n", fd->path);
+			goto end;
+		}
+	}
+
+	if (fd->bytes + fd->pending > UINT_MAX) {
+		do_rotate(fd);
+	}
+
+	while (iovcnt && loops < 10) {
+		if ((bytes_in = writev(fd->fd, iov, iovcnt)) > 0) {
+			fd->bytes += bytes_in;
+
+			/* skip what made it out, a short write leaves us in the middle of a line */
+			while (iovcnt && (size_t) bytes_in >= iov->iov_len) {
+				bytes_in -= iov->iov_len;
+				iov++;
+				iovcnt--;
+			}
+			if (iovcnt && bytes_in) {
+				iov->iov_base = (char *) iov->iov_base + bytes_in;
+				iov->iov_len -= bytes_in;
+			}
+			continue;
+		}
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Write error to file %s %d lines pending\n", fd->path, iovcnt);
+		do_rotate(fd);
+		switch_yield(250000);
+		loops++;
+	}
+
+	if (globals.fsync_policy == CDR_FSYNC_FLUSH && fd->fd > -1) {
+		fsync(fd->fd);
+	}
+
+  end:
+
+	switch_mutex_unlock(fd->mutex);
+
+	for (x = 0; x < fd->iov_count; x++) {
+		free(fd->lines[x]);
+	}
+	fd->iov_count = 0;
+	fd->pending = 0;
+}
+
+static void flush_all_cdr_fds(void)
+{
+	cdr_fd_t *fd;
+
+	for (fd = globals.dirty; fd; fd = fd->next_dirty) {
+		flush_cdr_fd(fd);
+		fd->dirty = 0;
+	}
+	globals.dirty = NULL;
+	globals.last_flush = switch_micro_time_now();
+}
+
+static void *SWITCH_THREAD_FUNC cdr_flush_thread(switch_thread_t *thread, void *obj)
+{
+	void *pop = NULL;
+
+	for (;;) {
+		cdr_line_t *line;
+		switch_status_t status = switch_queue_pop_timeout(globals.queue, &pop, globals.flush_interval * 1000);
+
+		if (status == SWITCH_STATUS_SUCCESS && (line = (cdr_line_t *) pop)) {
+			cdr_fd_t *fd = line->fd;
+
+			if (!fd) {
+				/* rotation requested, everything before it goes into the old files */
+				flush_all_cdr_fds();
+				do_rotate_all_now();
+				free(line);
+				continue;
+			}
+
+			if (fd->iov_count == CDR_IOV_MAX) {
+				flush_cdr_fd(fd);
+			}
+
+			fd->lines[fd->iov_count] = line->data;
+			fd->iov[fd->iov_count].iov_base = line->data;
+			fd->iov[fd->iov_count].iov_len = line->len;
+			fd->iov_count++;
+			fd->pending += line->len;
+			free(line);
+
+			if (!fd->dirty) {
+				fd->dirty = 1;
+				fd->next_dirty = globals.dirty;
+				globals.dirty = fd;
+			}
+
+			if (fd->pending >= globals.buffer_size || fd->iov_count == CDR_IOV_MAX) {
+				flush_cdr_fd(fd);
+			}
+		} else if (globals.shutdown && status != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+
+		if (globals.dirty && switch_micro_time_now() - globals.last_flush >= (switch_time_t) globals.flush_interval * 1000) {
+			flush_all_cdr_fds();
+		}
+	}
+
+	flush_all_cdr_fds();
+
+	return NULL;
+}
+
+static void queue_cdr(cdr_fd_t *fd, const char *log_line)
+{
+	cdr_line_t *line;
+
+	switch_zmalloc(line, sizeof(*line));
+	line->fd = fd;
+	if (fd) {
+		line->len = strlen(log_line);
+		line->data = strdup(log_line);
+		switch_assert(line->data);
+	}
+
+	/* blocks when the flusher is that far behind rather than dropping a record */
+	switch_queue_push(globals.queue, line);
+}
+#endif
+
+static void write_cdr(const char *path, const char *log_line)
+{
+	cdr_fd_t *fd = NULL;
+	unsigned int bytes_in, bytes_out;
+	int loops = 0;
+
+	fd = get_cdr_fd(path);
+
+#ifdef CDR_CSV_BUFFERED
+	if (globals.queue) {
+		queue_cdr(fd, log_line);
+		return;
+	}
+#endif
 
 	switch_mutex_lock(fd->mutex);
 	bytes_out = (unsigned) strlen(log_line);
@@ -174,7 +401,8 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
-	const char *log_dir = NULL, *accountcode = NULL, *a_template_str = NULL, *g_template_str = NULL;
+	const char *log_dir = NULL, *accountcode = NULL;
+	switch_expand_template_t *a_template = NULL, *g_template = NULL;
 	char *log_line, *path = NULL;
 
 	if (globals.shutdown) {
@@ -215,22 +443,21 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 		}
 	}
 
-	g_template_str = (const char *) switch_core_hash_find(globals.template_hash, globals.default_template);
+	g_template = (switch_expand_template_t *) switch_core_hash_find(globals.template_hash, globals.default_template);
 
 	if ((accountcode = switch_channel_get_variable(channel, "ACCOUNTCODE"))) {
-		a_template_str = (const char *) switch_core_hash_find(globals.template_hash, accountcode);
+		a_template = (switch_expand_template_t *) switch_core_hash_find(globals.template_hash, accountcode);
 	}
 
-	if (!g_template_str) {
-		g_template_str =
-			"\"${accountcode}\",\"${caller_id_number}\",\"${destination_number}\",\"${context}\",\"${caller_id}\",\"${channel_name}\",\"${bridge_channel}\",\"${last_app}\",\"${last_arg}\",\"${start_stamp}\",\"${answer_stamp}\",\"${end_stamp}\",\"${duration}\",\"${billsec}\",\"${hangup_cause}\",\"${amaflags}\",\"${uuid}\",\"${userfield}\";";
+	if (!g_template) {
+		g_template = globals.fallback_template;
 	}
 
-	if (!a_template_str) {
-		a_template_str = g_template_str;
+	if (!a_template) {
+		a_template = g_template;
 	}
 
-	log_line = switch_channel_expand_variables(channel, a_template_str);
+	log_line = switch_channel_expand_template(channel, a_template);
 
 	if ((accountcode) && (!globals.masterfileonly)) {
 		path = switch_mprintf("%s%s%s.csv", log_dir, SWITCH_PATH_SEPARATOR, accountcode);
@@ -239,11 +466,11 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 		free(path);
 	}
 
-	if (g_template_str != a_template_str) {
-		if (log_line != a_template_str) {
+	if (g_template != a_template) {
+		if (log_line != switch_expand_template_get_source(a_template)) {
 			switch_safe_free(log_line);
 		}
-		log_line = switch_channel_expand_variables(channel, g_template_str);
+		log_line = switch_channel_expand_template(channel, g_template);
 	}
 
 	if (!log_line) {
@@ -257,7 +484,7 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 	free(path);
 
 
-	if (log_line != g_template_str) {
+	if (log_line != switch_expand_template_get_source(g_template)) {
 		free(log_line);
 	}
 
@@ -267,21 +494,19 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 
 static void do_rotate_all()
 {
-	switch_hash_index_t *hi;
-	void *val;
-	cdr_fd_t *fd;
-
 	if (globals.shutdown) {
 		return;
 	}
 
-	for (hi = switch_hash_first(NULL, globals.fd_hash); hi; hi = switch_hash_next(hi)) {
-		switch_hash_this(hi, NULL, NULL, &val);
-		fd = (cdr_fd_t *) val;
-		switch_mutex_lock(fd->mutex);
-		do_rotate(fd);
-		switch_mutex_unlock(fd->mutex);
+#ifdef CDR_CSV_BUFFERED
+	if (globals.queue) {
+		/* the flusher rotates once the lines queued so far are written */
+		queue_cdr(NULL, NULL);
+		return;
 	}
+#endif
+
+	do_rotate_all_now();
 }
 
 
@@ -323,6 +548,15 @@ static switch_state_handler_table_t state_handlers = {
 
 
 
+/* templates are compiled once here, every CDR only evaluates them */
+static void add_template(switch_memory_pool_t *pool, const char *name, const char *str)
+{
+	switch_expand_template_t *tpl;
+
+	switch_expand_template_create(&tpl, str, pool);
+	switch_core_hash_insert(globals.template_hash, name, tpl);
+}
+
 static switch_status_t load_config(switch_memory_pool_t *pool)
 {
 	char *cf = "cdr_csv.conf";
@@ -331,11 +565,15 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 
 	memset(&globals, 0, sizeof(globals));
 	switch_core_hash_init(&globals.fd_hash, pool);
+	switch_mutex_init(&globals.fd_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_core_hash_init(&globals.template_hash, pool);
+	globals.flush_interval = 1000;
+	globals.queue_size = 10000;
 
 	globals.pool = pool;
 
-	switch_core_hash_insert(globals.template_hash, "default", default_template);
+	add_template(pool, "default", default_template);
+	switch_expand_template_create(&globals.fallback_template, fallback_template, pool);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Adding default template.\n");
 	globals.legs = CDR_LEG_A;
 
@@ -365,6 +603,26 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 					globals.default_template = switch_core_strdup(pool, val);
 				} else if (!strcasecmp(var, "master-file-only")) {
 					globals.masterfileonly = switch_true(val);
+				} else if (!strcasecmp(var, "buffer-size")) {
+					globals.buffer_size = switch_atoui(val);
+				} else if (!strcasecmp(var, "flush-interval")) {
+					int tmp = atoi(val);
+					if (tmp > 0) {
+						globals.flush_interval = tmp;
+					}
+				} else if (!strcasecmp(var, "queue-size")) {
+					int tmp = atoi(val);
+					if (tmp > 0) {
+						globals.queue_size = tmp;
+					}
+				} else if (!strcasecmp(var, "fsync")) {
+					if (!strcasecmp(val, "flush")) {
+						globals.fsync_policy = CDR_FSYNC_FLUSH;
+					} else if (!strcasecmp(val, "rotate")) {
+						globals.fsync_policy = CDR_FSYNC_ROTATE;
+					} else {
+						globals.fsync_policy = CDR_FSYNC_NEVER;
+					}
 				}
 			}
 		}
@@ -382,7 +640,7 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 						tpl = switch_core_strdup(pool, param->txt);
 					}
 
-					switch_core_hash_insert(globals.template_hash, var, tpl);
+					add_template(pool, var, tpl);
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Adding template %s.\n", var);
 				}
 			}
@@ -420,6 +678,22 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_csv_load)
 		return status;
 	}
 
+#ifdef CDR_CSV_BUFFERED
+	if (globals.buffer_size) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		globals.last_flush = switch_micro_time_now();
+		switch_queue_create(&globals.queue, globals.queue_size, pool);
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.flush_thread, thd_attr, cdr_flush_thread, NULL, pool);
+	}
+#else
+	if (globals.buffer_size) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "buffer-size is not supported on this platform, writing directly\n");
+	}
+#endif
+
 	switch_core_add_state_handler(&state_handlers);
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
@@ -438,6 +712,14 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_cdr_csv_shutdown)
 	switch_event_unbind_callback(event_handler);
 	switch_core_remove_state_handler(&state_handlers);
 
+	if (globals.flush_thread) {
+		switch_status_t st;
+
+		/* the flusher drains the queue before it goes */
+		switch_thread_join(&st, globals.flush_thread);
+		globals.flush_thread = NULL;
+	}
+
 
 	return SWITCH_STATUS_SUCCESS;
 }
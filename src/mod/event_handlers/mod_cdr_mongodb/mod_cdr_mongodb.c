@@ -33,17 +33,50 @@
 #include <switch.h>
 #include <mongo.h>
 
+/* seconds between attempts to send the spool back to the server */
+#define CDR_MONGO_REPLAY_INTERVAL 30
+
 static struct {
 	switch_memory_pool_t *pool;
 	int shutdown;
 	char *mongo_host;
 	uint32_t mongo_port;
 	char *mongo_namespace;
+	char *mongo_db;
 	mongo mongo_conn[1];
 	switch_mutex_t *mongo_mutex;
 	switch_bool_t log_b;
+	/* finished CDRs waiting for the writer thread, inserted batch_size at a time */
+	switch_queue_t *queue;
+	switch_thread_t *writer_thread;
+	uint32_t batch_size;
+	uint32_t flush_interval;
+	uint32_t queue_size;
+	char *write_concern;
+	uint32_t write_timeout;
+	switch_bool_t write_journal;
+	char *spool_dir;
+	char *spool_path;
+	switch_mutex_t *spool_mutex;
+	time_t last_replay;
 } globals;
 
+static switch_xml_config_int_options_t config_opt_batch_size = { SWITCH_TRUE, 1, SWITCH_TRUE, 10000 };
+static switch_xml_config_int_options_t config_opt_flush_interval = { SWITCH_TRUE, 10, SWITCH_TRUE, 60000 };
+static switch_xml_config_int_options_t config_opt_queue_size = { SWITCH_TRUE, 100, SWITCH_TRUE, 1000000 };
+static switch_xml_config_int_options_t config_opt_write_timeout = { SWITCH_TRUE, 0, SWITCH_TRUE, 600000 };
+
+static switch_status_t config_validate_spool_dir(switch_xml_config_item_t *item, const char *newvalue, switch_config_callback_type_t callback_type, switch_bool_t changed)
+{
+	if ((callback_type == CONFIG_LOAD || callback_type == CONFIG_RELOAD)) {
+		if (zstr(newvalue)) {
+			globals.spool_dir = switch_core_sprintf(globals.pool, "%s%scdr-mongodb", SWITCH_GLOBAL_dirs.log_dir, SWITCH_PATH_SEPARATOR);
+		}
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static switch_xml_config_item_t config_settings[] = {
 	/* key, flags, ptr, default_value, syntax, helptext */
 	SWITCH_CONFIG_ITEM_STRING_STRDUP("host", CONFIG_REQUIRED, &globals.mongo_host, "127.0.0.1", NULL, "MongoDB server host address"),
@@ -52,6 +85,22 @@ static switch_xml_config_item_t config_settings[] = {
 	/* key, type, flags, ptr, default_value, data, syntax, helptext */
 	SWITCH_CONFIG_ITEM("port", SWITCH_CONFIG_INT, CONFIG_REQUIRED, &globals.mongo_port, 27017, NULL, NULL, "MongoDB server TCP port"),
 	SWITCH_CONFIG_ITEM("log-b-leg", SWITCH_CONFIG_BOOL, CONFIG_RELOADABLE, &globals.log_b, SWITCH_TRUE, NULL, NULL, "Log B-leg in addition to A-leg"),
+	SWITCH_CONFIG_ITEM("batch-size", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &globals.batch_size, (void *) 100, &config_opt_batch_size, NULL,
+					   "Most CDRs sent with one insert"),
+	SWITCH_CONFIG_ITEM("flush-interval", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &globals.flush_interval, (void *) 1000, &config_opt_flush_interval, NULL,
+					   "Longest a CDR waits for its batch to fill, in milliseconds"),
+	SWITCH_CONFIG_ITEM("queue-size", SWITCH_CONFIG_INT, 0, &globals.queue_size, (void *) 10000, &config_opt_queue_size, NULL,
+					   "CDRs waiting for the writer before they go straight to the spool"),
+	SWITCH_CONFIG_ITEM_STRING_STRDUP("write-concern", CONFIG_RELOADABLE, &globals.write_concern, "1", "0|1|N|majority",
+					   "Acknowledgement required for each batch, 0 sends without waiting"),
+	SWITCH_CONFIG_ITEM("write-timeout", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &globals.write_timeout, (void *) 0, &config_opt_write_timeout, NULL,
+					   "Longest to wait for the write concern, in milliseconds, 0 waits for ever"),
+	SWITCH_CONFIG_ITEM("write-journal", SWITCH_CONFIG_BOOL, CONFIG_RELOADABLE, &globals.write_journal, SWITCH_FALSE, NULL, NULL,
+					   "Wait for each batch to reach the journal"),
+
+	/* key, type, flags, ptr, defaultvalue, function, functiondata, syntax, helptext */
+	SWITCH_CONFIG_ITEM_CALLBACK("spool-dir", SWITCH_CONFIG_STRING, 0, &globals.spool_dir, NULL, config_validate_spool_dir, NULL, NULL,
+								"Where CDRs the server could not take are kept until it can"),
 
 	SWITCH_CONFIG_ITEM_END()
 };
@@ -79,6 +128,303 @@ static void set_bson_profile_data(bson *b, switch_caller_profile_t *caller_profi
 }
 
 
+static void free_cdr(bson *b)
+{
+	bson_destroy(b);
+	free(b);
+}
+
+/* The server could not take this CDR, append it to the spool as raw BSON, the documents carry their own length */
+static void spool_cdr(const bson *b)
+{
+	FILE *out;
+
+	switch_mutex_lock(globals.spool_mutex);
+
+	if (!(out = fopen(globals.spool_path, "ab"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error opening %s, CDR lost\n", globals.spool_path);
+	} else {
+		if (fwrite(bson_data(b), bson_size(b), 1, out) != 1) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error writing %s, CDR lost\n", globals.spool_path);
+		}
+		fclose(out);
+	}
+
+	switch_mutex_unlock(globals.spool_mutex);
+}
+
+/* getlasterror with the configured w/wtimeout/j, the old driver has no write concern of its own */
+static int check_write_concern(void)
+{
+	bson cmd, out = { NULL, 0 };
+	bson_iterator it;
+	int w, rc;
+
+	if (zstr(globals.write_concern) || !strcmp(globals.write_concern, "0")) {
+		return MONGO_OK;
+	}
+
+	bson_init(&cmd);
+	bson_append_int(&cmd, "getlasterror", 1);
+	if (switch_is_number(globals.write_concern)) {
+		if ((w = atoi(globals.write_concern)) > 1) {
+			bson_append_int(&cmd, "w", w);
+		}
+	} else {
+		bson_append_string(&cmd, "w", globals.write_concern);
+	}
+	if (globals.write_timeout) {
+		bson_append_int(&cmd, "wtimeout", globals.write_timeout);
+	}
+	if (globals.write_journal) {
+		bson_append_bool(&cmd, "j", 1);
+	}
+	bson_finish(&cmd);
+
+	if ((rc = mongo_run_command(globals.mongo_conn, globals.mongo_db, &cmd, &out)) == MONGO_OK) {
+		if (bson_find(&it, &out, "err") == BSON_STRING) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "MongoDB write error: %s\n", bson_iterator_string(&it));
+			globals.mongo_conn->err = MONGO_COMMAND_FAILED;
+			rc = MONGO_ERROR;
+		}
+		bson_destroy(&out);
+	}
+
+	bson_destroy(&cmd);
+
+	return rc;
+}
+
+static int send_cdrs(const bson **cdrs, int count)
+{
+	int rc;
+
+	if (count == 1) {
+		rc = mongo_insert(globals.mongo_conn, globals.mongo_namespace, cdrs[0]);
+	} else {
+		rc = mongo_insert_batch(globals.mongo_conn, globals.mongo_namespace, cdrs, count);
+	}
+
+	if (rc == MONGO_OK) {
+		rc = check_write_concern();
+	}
+
+	return rc;
+}
+
+static switch_bool_t connection_lost(void)
+{
+	return globals.mongo_conn->err == MONGO_IO_ERROR || globals.mongo_conn->err == MONGO_SOCKET_ERROR ||
+		globals.mongo_conn->err == MONGO_READ_SIZE_ERROR || !mongo_is_connected(globals.mongo_conn);
+}
+
+/*
+ * Insert a batch, reconnecting once if the connection dropped. A document the server will never accept
+ * is dropped, anything that could not be delivered goes to the spool.
+ */
+static switch_status_t writer_flush(bson **batch, int count)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	int i, rc;
+
+	switch_mutex_lock(globals.mongo_mutex);
+
+	if ((rc = send_cdrs((const bson **) batch, count)) != MONGO_OK && connection_lost()) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "MongoDB connection failed; attempting reconnect...\n");
+		if (mongo_reconnect(globals.mongo_conn) != MONGO_OK) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "MongoDB reconnect failed with error code %d, spooling %d CDRs\n",
+							  globals.mongo_conn->err, count);
+			for (i = 0; i < count; i++) {
+				spool_cdr(batch[i]);
+			}
+			status = SWITCH_STATUS_FALSE;
+			goto end;
+		}
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "MongoDB connection re-established.\n");
+		rc = send_cdrs((const bson **) batch, count);
+	}
+
+	if (rc == MONGO_OK) {
+		goto end;
+	}
+
+	if (connection_lost()) {
+		for (i = 0; i < count; i++) {
+			spool_cdr(batch[i]);
+		}
+		status = SWITCH_STATUS_FALSE;
+	} else if (count > 1 && (globals.mongo_conn->err == MONGO_BSON_INVALID || globals.mongo_conn->err == MONGO_BSON_TOO_LARGE)) {
+		/* the batch is refused whole before anything is sent, find the culprits one at a time */
+		for (i = 0; i < count; i++) {
+			if (send_cdrs((const bson **) &batch[i], 1) != MONGO_OK) {
+				if (connection_lost()) {
+					spool_cdr(batch[i]);
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "mongo_insert: error code %d, CDR dropped\n", globals.mongo_conn->err);
+				}
+			}
+		}
+	} else {
+		/* the server has the batch, or part of it, sending it again would only duplicate what did get in */
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "mongo_insert_batch: error code %d on %d CDRs\n", globals.mongo_conn->err, count);
+	}
+
+  end:
+
+	switch_mutex_unlock(globals.mongo_mutex);
+
+	return status;
+}
+
+/* Move the spool aside and feed it back to the server, whatever still fails is spooled again */
+static void writer_replay(bson **batch, int batch_max)
+{
+	char *replay;
+	FILE *in;
+	char hdr[4];
+	int len, count = 0, replayed = 0;
+	time_t now = switch_epoch_time_now(NULL);
+
+	if (now - globals.last_replay < CDR_MONGO_REPLAY_INTERVAL) {
+		return;
+	}
+	globals.last_replay = now;
+
+	if (switch_file_exists(globals.spool_path, NULL) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	/* nothing new may have come along to notice the server is back */
+	if (!mongo_is_connected(globals.mongo_conn)) {
+		int rc;
+
+		switch_mutex_lock(globals.mongo_mutex);
+		rc = mongo_reconnect(globals.mongo_conn);
+		switch_mutex_unlock(globals.mongo_mutex);
+
+		if (rc != MONGO_OK) {
+			return;
+		}
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "MongoDB connection re-established.\n");
+	}
+
+	replay = switch_mprintf("%s.replay", globals.spool_path);
+	assert(replay);
+
+	/* new failures go to a fresh spool file from here on */
+	switch_mutex_lock(globals.spool_mutex);
+	if (switch_file_exists(globals.spool_path, NULL) != SWITCH_STATUS_SUCCESS || rename(globals.spool_path, replay)) {
+		switch_mutex_unlock(globals.spool_mutex);
+		goto end;
+	}
+	switch_mutex_unlock(globals.spool_mutex);
+
+	if (!(in = fopen(replay, "rb"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error opening %s\n", replay);
+		goto end;
+	}
+
+	while (fread(hdr, sizeof(hdr), 1, in) == 1) {
+		char *data;
+
+		bson_little_endian32(&len, hdr);
+		if (len < 5 || len > globals.mongo_conn->max_bson_size || !(data = bson_malloc(len))) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Corrupt document in %s, the rest is lost\n", replay);
+			break;
+		}
+
+		memcpy(data, hdr, sizeof(hdr));
+		if (fread(data + sizeof(hdr), len - sizeof(hdr), 1, in) != 1) {
+			bson_free(data);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Truncated document in %s\n", replay);
+			break;
+		}
+
+		switch_zmalloc(batch[count], sizeof(bson));
+		bson_init_finished_data(batch[count++], data);
+
+		if (count == batch_max || count >= (int) globals.batch_size) {
+			writer_flush(batch, count);
+			replayed += count;
+			while (count) {
+				free_cdr(batch[--count]);
+			}
+		}
+	}
+
+	if (count) {
+		writer_flush(batch, count);
+		replayed += count;
+		while (count) {
+			free_cdr(batch[--count]);
+		}
+	}
+
+	fclose(in);
+	unlink(replay);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Replayed %d spooled CDRs from %s\n", replayed, globals.spool_path);
+
+  end:
+
+	switch_safe_free(replay);
+}
+
+static void *SWITCH_THREAD_FUNC cdr_writer_thread(switch_thread_t *thread, void *obj)
+{
+	bson **batch;
+	int count = 0, done = 0, batch_max;
+	switch_time_t first = 0;
+
+	/* batch-size is reloadable, keep to the size the array was made for */
+	batch_max = globals.batch_size;
+	switch_zmalloc(batch, sizeof(*batch) * batch_max);
+
+	while (!done) {
+		switch_interval_time_t flush_us = (switch_interval_time_t) globals.flush_interval * 1000, wait = 1000000;
+		void *pop = NULL;
+
+		if (count) {
+			wait = first + flush_us - switch_micro_time_now();
+			if (wait < 1) {
+				wait = 1;
+			}
+		}
+
+		if (switch_queue_pop_timeout(globals.queue, &pop, wait) == SWITCH_STATUS_SUCCESS) {
+			if (!pop) {
+				done = 1;
+			} else {
+				if (!count) {
+					first = switch_micro_time_now();
+				}
+				batch[count++] = (bson *) pop;
+			}
+		}
+
+		if (count && (done || count >= batch_max || count >= (int) globals.batch_size || switch_micro_time_now() - first >= flush_us)) {
+			switch_status_t status = writer_flush(batch, count);
+
+			while (count) {
+				free_cdr(batch[--count]);
+			}
+
+			if (status != SWITCH_STATUS_SUCCESS) {
+				continue;
+			}
+		}
+
+		if (!done && !count) {
+			writer_replay(batch, batch_max);
+		}
+	}
+
+	free(batch);
+
+	return NULL;
+}
+
+
 static switch_status_t my_on_reporting(switch_core_session_t *session)
 {
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
@@ -86,7 +432,7 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 	switch_event_header_t *hi;
 	switch_caller_profile_t *caller_profile;
 	switch_app_log_t *app_log;
-	bson cdr;
+	bson cdr, *queued;
 	int is_b;
 	char *tmp;
 
@@ -293,34 +639,16 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 
 	bson_finish(&cdr);
 
-	switch_mutex_lock(globals.mongo_mutex);
-
-	if (mongo_insert(globals.mongo_conn, globals.mongo_namespace, &cdr) != MONGO_OK) {
-		if (globals.mongo_conn->err == MONGO_IO_ERROR) {
-			mongo_error_t db_status;
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "MongoDB connection failed; attempting reconnect...\n");
-			db_status = mongo_reconnect(globals.mongo_conn);
-
-			if (db_status != MONGO_OK) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "MongoDB reconnect failed with error code %d\n", db_status);
-				status = SWITCH_STATUS_FALSE;
-			} else {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "MongoDB connection re-established.\n");
-				if (mongo_insert(globals.mongo_conn, globals.mongo_namespace, &cdr) != MONGO_OK) {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "mongo_insert: error code %d\n", globals.mongo_conn->err);
-					status = SWITCH_STATUS_FALSE;
-				}
-			}
+	/* the writer owns the document from here, when it is too far behind the CDR goes straight to the spool */
+	switch_zmalloc(queued, sizeof(*queued));
+	*queued = cdr;
 
-		} else {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "mongo_insert: error code %d\n", globals.mongo_conn->err);
-			status = SWITCH_STATUS_FALSE;
-		}
+	if (switch_queue_trypush(globals.queue, queued) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "CDR queue full, spooling\n");
+		spool_cdr(queued);
+		free_cdr(queued);
 	}
 
-	switch_mutex_unlock(globals.mongo_mutex);
-	bson_destroy(&cdr);
-
 	return status;
 }
 
@@ -344,10 +672,22 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 {
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 
+	char *p;
+
 	if (switch_xml_config_parse_module_settings("cdr_mongodb.conf", SWITCH_FALSE, config_settings) != SWITCH_STATUS_SUCCESS) {
 		return SWITCH_STATUS_FALSE;
 	}
 
+	/* getlasterror runs against the database half of database.collection */
+	if (!zstr(globals.mongo_namespace)) {
+		globals.mongo_db = switch_core_strdup(pool, globals.mongo_namespace);
+		if ((p = strchr(globals.mongo_db, '.'))) {
+			*p = '\0';
+		}
+	}
+
+	globals.spool_path = switch_core_sprintf(pool, "%s%scdr-spool.bson", globals.spool_dir, SWITCH_PATH_SEPARATOR);
+
 	return status;
 }
 
@@ -356,6 +696,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_mongodb_load)
 {
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 	mongo_error_t db_status;
+	switch_threadattr_t *thd_attr = NULL;
 
 	memset(&globals, 0, sizeof(globals));
 	globals.pool = pool;
@@ -385,6 +726,16 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_mongodb_load)
 	}
 
 	switch_mutex_init(&globals.mongo_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&globals.spool_mutex, SWITCH_MUTEX_NESTED, pool);
+
+	if (switch_dir_make_recursive(globals.spool_dir, SWITCH_DEFAULT_DIR_PERMS, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error creating %s\n", globals.spool_dir);
+	}
+
+	switch_queue_create(&globals.queue, globals.queue_size, pool);
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&globals.writer_thread, thd_attr, cdr_writer_thread, NULL, pool);
 
 	switch_core_add_state_handler(&state_handlers);
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
@@ -395,9 +746,19 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_mongodb_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_cdr_mongodb_shutdown)
 {
+	switch_status_t st;
+
 	globals.shutdown = 1;
 	switch_core_remove_state_handler(&state_handlers);
+
+	/* the writer sends or spools everything queued ahead of its NULL */
+	if (globals.writer_thread) {
+		switch_queue_push(globals.queue, NULL);
+		switch_thread_join(&st, globals.writer_thread);
+	}
+
 	switch_mutex_destroy(globals.mongo_mutex);
+	switch_mutex_destroy(globals.spool_mutex);
 
 	mongo_destroy(globals.mongo_conn);
 
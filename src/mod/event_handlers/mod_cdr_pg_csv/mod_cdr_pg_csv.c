@@ -73,16 +73,42 @@ typedef struct {
 	cdr_field_t fields[1];
 } db_schema_t;
 
+/* one CDR on its way to a writer: the COPY row it is loaded with, and the VALUES list for a plain INSERT or the spool */
+typedef struct {
+	char *row;
+	switch_size_t row_len;
+	char *values;
+} cdr_record_t;
+
+/* a writer thread with its own connection, they all take from the same queue */
+typedef struct {
+	int id;
+	PGconn *conn;
+	int online;
+	int hup;
+	switch_thread_t *thread;
+} cdr_writer_t;
+
+#define CDR_PG_MAX_WRITERS 16
+/* seconds between attempts to load the spool back into the database */
+#define CDR_PG_REPLAY_INTERVAL 30
+
 static struct {
 	switch_memory_pool_t *pool;
 	switch_hash_t *fd_hash;
+	switch_mutex_t *fd_mutex;
 	int shutdown;
 	char *db_info;
 	char *db_table;
 	db_schema_t *db_schema;
-	PGconn *db_connection;
-	switch_mutex_t *db_mutex;
-	int db_online;
+	int db_connections;
+	int batch_size;
+	int flush_interval;
+	int queue_size;
+	switch_queue_t *queue;
+	cdr_writer_t writers[CDR_PG_MAX_WRITERS];
+	int hup;
+	time_t last_replay;
 	cdr_leg_t legs;
 	char *spool_dir;
 	spool_format_t spool_format;
@@ -103,6 +129,11 @@ static switch_xml_config_enum_item_t config_opt_spool_format_enum[] = {
         {NULL, 0}
 };
 
+static switch_xml_config_int_options_t config_opt_db_connections = { SWITCH_TRUE, 1, SWITCH_TRUE, CDR_PG_MAX_WRITERS };
+static switch_xml_config_int_options_t config_opt_batch_size = { SWITCH_TRUE, 1, SWITCH_TRUE, 100000 };
+static switch_xml_config_int_options_t config_opt_flush_interval = { SWITCH_TRUE, 10, SWITCH_TRUE, 60000 };
+static switch_xml_config_int_options_t config_opt_queue_size = { SWITCH_TRUE, 100, SWITCH_TRUE, 1000000 };
+
 static switch_status_t config_validate_spool_dir(switch_xml_config_item_t *item, const char *newvalue, switch_config_callback_type_t callback_type, switch_bool_t changed)
 {
 	if ((callback_type == CONFIG_LOAD || callback_type == CONFIG_RELOAD)) {
@@ -122,6 +153,14 @@ static switch_xml_config_item_t config_settings[] = {
 	SWITCH_CONFIG_ITEM("spool-format", SWITCH_CONFIG_ENUM, CONFIG_RELOADABLE, &globals.spool_format, (void *) SPOOL_FORMAT_CSV, &config_opt_spool_format_enum, "csv|sql", "Disk spool format to use if SQL insert fails."),
 	SWITCH_CONFIG_ITEM("rotate-on-hup", SWITCH_CONFIG_BOOL, CONFIG_RELOADABLE, &globals.rotate, SWITCH_FALSE, NULL, NULL, NULL),
 	SWITCH_CONFIG_ITEM("debug", SWITCH_CONFIG_BOOL, CONFIG_RELOADABLE, &globals.debug, SWITCH_FALSE, NULL, NULL, NULL),
+	SWITCH_CONFIG_ITEM("db-connections", SWITCH_CONFIG_INT, 0, &globals.db_connections, (void *) 2, &config_opt_db_connections, NULL,
+					   "Writer threads, each with its own connection"),
+	SWITCH_CONFIG_ITEM("batch-size", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &globals.batch_size, (void *) 500, &config_opt_batch_size, NULL,
+					   "Most CDRs loaded with one COPY"),
+	SWITCH_CONFIG_ITEM("flush-interval", SWITCH_CONFIG_INT, CONFIG_RELOADABLE, &globals.flush_interval, (void *) 1000, &config_opt_flush_interval, NULL,
+					   "Longest a CDR waits for its batch to fill, in milliseconds"),
+	SWITCH_CONFIG_ITEM("queue-size", SWITCH_CONFIG_INT, 0, &globals.queue_size, (void *) 50000, &config_opt_queue_size, NULL,
+					   "CDRs waiting for a writer before they go straight to the spool"),
 
 	/* key, type, flags, ptr, defaultvalue, function, functiondata, syntax, helptext */
 	SWITCH_CONFIG_ITEM_CALLBACK("spool-dir", SWITCH_CONFIG_STRING, CONFIG_RELOADABLE, &globals.spool_dir, NULL, config_validate_spool_dir, NULL, NULL, NULL),
@@ -196,6 +235,7 @@ static void spool_cdr(const char *path, const char *log_line)
 	unsigned int bytes_in, bytes_out;
 	int loops = 0;
 
+	switch_mutex_lock(globals.fd_mutex);
 	if (!(fd = switch_core_hash_find(globals.fd_hash, path))) {
 		fd = switch_core_alloc(globals.pool, sizeof(*fd));
 		switch_assert(fd);
@@ -205,6 +245,7 @@ static void spool_cdr(const char *path, const char *log_line)
 		fd->path = switch_core_strdup(globals.pool, path);
 		switch_core_hash_insert(globals.fd_hash, path, fd);
 	}
+	switch_mutex_unlock(globals.fd_mutex);
 
 	if (end_of(log_line) != '\n') {
 		log_line_lf = switch_mprintf("%s\n", log_line);
@@ -244,67 +285,383 @@ static void spool_cdr(const char *path, const char *log_line)
 	switch_safe_free(log_line_lf);
 }
 
-static switch_status_t insert_cdr(const char *values)
+static char *spool_path(void)
 {
-	char *sql = NULL, *path = NULL;
-	PGresult *res;
+	return switch_mprintf("%s%scdr-spool.%s", globals.spool_dir, SWITCH_PATH_SEPARATOR, globals.spool_format == SPOOL_FORMAT_SQL ? "sql" : "csv");
+}
 
-	sql = switch_mprintf("INSERT INTO %s (%s) VALUES (%s);", globals.db_table, globals.db_schema->columns, values);
-	assert(sql);
+static char *insert_sql(const char *values)
+{
+	return switch_mprintf("INSERT INTO %s (%s) VALUES (%s);", globals.db_table, globals.db_schema->columns, values);
+}
 
-	if (globals.debug) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Query: \"%s\"\n", sql);
+/* The database could not take this CDR, spool the attempted query to disk */
+static void spool_record(cdr_record_t *rec)
+{
+	char *path = spool_path(), *sql = NULL;
+
+	assert(path);
+
+	if (globals.spool_format == SPOOL_FORMAT_SQL) {
+		sql = insert_sql(rec->values);
+		assert(sql);
+		spool_cdr(path, sql);
+	} else {
+		spool_cdr(path, rec->values);
 	}
 
-	switch_mutex_lock(globals.db_mutex);
+	switch_safe_free(sql);
+	switch_safe_free(path);
+}
 
-	if (!globals.db_online || PQstatus(globals.db_connection) != CONNECTION_OK) {
-		globals.db_connection = PQconnectdb(globals.db_info);
+static void free_record(cdr_record_t *rec)
+{
+	switch_safe_free(rec->row);
+	switch_safe_free(rec->values);
+	free(rec);
+}
+
+static void writer_disconnect(cdr_writer_t *w)
+{
+	if (w->conn) {
+		PQfinish(w->conn);
+		w->conn = NULL;
 	}
+	w->online = 0;
+}
 
-	if (PQstatus(globals.db_connection) == CONNECTION_OK) {
-		globals.db_online = 1;
-	} else {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Connection to database failed: %s", PQerrorMessage(globals.db_connection));
-		goto error;
+static switch_status_t writer_connect(cdr_writer_t *w)
+{
+	/* SIGHUP drops every connection, each writer notices on its next use */
+	if (w->hup != globals.hup) {
+		w->hup = globals.hup;
+		writer_disconnect(w);
+	}
+
+	if (w->conn && PQstatus(w->conn) == CONNECTION_OK) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	writer_disconnect(w);
+	w->conn = PQconnectdb(globals.db_info);
+
+	if (PQstatus(w->conn) == CONNECTION_OK) {
+		w->online = 1;
+		return SWITCH_STATUS_SUCCESS;
 	}
 
-	res = PQexec(globals.db_connection, sql);
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Connection to database failed: %s", PQerrorMessage(w->conn));
+	writer_disconnect(w);
+
+	return SWITCH_STATUS_FALSE;
+}
+
+static switch_status_t writer_exec(cdr_writer_t *w, const char *sql)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	PGresult *res;
+
+	if (globals.debug) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Query: \"%s\"\n", sql);
+	}
+
+	res = PQexec(w->conn, sql);
 	if (PQresultStatus(res) != PGRES_COMMAND_OK) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "INSERT command failed: %s", PQresultErrorMessage(res));
-		PQclear(res);
-		goto error;
+		status = SWITCH_STATUS_FALSE;
 	}
-
 	PQclear(res);
+
+	return status;
+}
+
+/* load a batch with a single COPY, all or nothing */
+static switch_status_t writer_copy(cdr_writer_t *w, cdr_record_t **batch, int count)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	PGresult *res;
+	char *sql;
+	int i;
+
+	sql = switch_mprintf("COPY %s (%s) FROM STDIN;", globals.db_table, globals.db_schema->columns);
+	assert(sql);
+	res = PQexec(w->conn, sql);
 	switch_safe_free(sql);
 
-	switch_mutex_unlock(globals.db_mutex);
+	if (PQresultStatus(res) != PGRES_COPY_IN) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "COPY command failed: %s", PQresultErrorMessage(res));
+		PQclear(res);
+		return SWITCH_STATUS_FALSE;
+	}
+	PQclear(res);
 
-	return SWITCH_STATUS_SUCCESS;
+	for (i = 0; i < count; i++) {
+		if (PQputCopyData(w->conn, batch[i]->row, (int) batch[i]->row_len) != 1) {
+			break;
+		}
+	}
+
+	if (PQputCopyEnd(w->conn, i < count ? "write failed" : NULL) != 1) {
+		status = SWITCH_STATUS_FALSE;
+	}
+
+	while ((res = PQgetResult(w->conn))) {
+		if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "COPY of %d CDRs failed: %s", count, PQresultErrorMessage(res));
+			status = SWITCH_STATUS_FALSE;
+		}
+		PQclear(res);
+	}
 
+	return status;
+}
 
-  error:
+static void writer_flush(cdr_writer_t *w, cdr_record_t **batch, int count)
+{
+	int i;
 
-	PQfinish(globals.db_connection);
-	globals.db_online = 0;
-	switch_mutex_unlock(globals.db_mutex);
+	if (writer_connect(w) != SWITCH_STATUS_SUCCESS) {
+		for (i = 0; i < count; i++) {
+			spool_record(batch[i]);
+		}
+	} else if (writer_copy(w, batch, count) != SWITCH_STATUS_SUCCESS) {
+		/* one bad row fails the whole COPY, go one by one so only the bad ones end up in the spool */
+		for (i = 0; i < count; i++) {
+			char *sql;
+
+			if (PQstatus(w->conn) != CONNECTION_OK) {
+				spool_record(batch[i]);
+				continue;
+			}
 
-	/* SQL INSERT failed for whatever reason. Spool the attempted query to disk */
-	if (globals.spool_format == SPOOL_FORMAT_SQL) {
-		path = switch_mprintf("%s%scdr-spool.sql", globals.spool_dir, SWITCH_PATH_SEPARATOR);
-		assert(path);
-		spool_cdr(path, sql);
-	} else {
-		path = switch_mprintf("%s%scdr-spool.csv", globals.spool_dir, SWITCH_PATH_SEPARATOR);
-		assert(path);
-		spool_cdr(path, values);
+			sql = insert_sql(batch[i]->values);
+			assert(sql);
+			if (writer_exec(w, sql) != SWITCH_STATUS_SUCCESS) {
+				spool_record(batch[i]);
+			}
+			switch_safe_free(sql);
+		}
+
+		if (PQstatus(w->conn) != CONNECTION_OK) {
+			writer_disconnect(w);
+		}
 	}
 
+	for (i = 0; i < count; i++) {
+		free_record(batch[i]);
+		batch[i] = NULL;
+	}
+}
+
+/* Move the spool aside and feed it back to the database, whatever still fails is spooled again */
+static void writer_replay(cdr_writer_t *w)
+{
+	char *path, *replay = NULL, *line = NULL, *sql;
+	switch_size_t line_size = 4096, line_len;
+	cdr_fd_t *fd;
+	struct stat st;
+	FILE *in = NULL;
+	time_t now = switch_epoch_time_now(NULL);
+	int replayed = 0, failed = 0;
+
+	if (now - globals.last_replay < CDR_PG_REPLAY_INTERVAL) {
+		return;
+	}
+	globals.last_replay = now;
+
+	path = spool_path();
+	assert(path);
+
+	if (stat(path, &st) || !st.st_size || writer_connect(w) != SWITCH_STATUS_SUCCESS) {
+		goto end;
+	}
+
+	replay = switch_mprintf("%s.replay", path);
+	assert(replay);
+
+	switch_mutex_lock(globals.fd_mutex);
+	fd = switch_core_hash_find(globals.fd_hash, path);
+	switch_mutex_unlock(globals.fd_mutex);
+
+	/* new failures go to a fresh spool file from here on */
+	if (fd) {
+		switch_mutex_lock(fd->mutex);
+	}
+	if (rename(path, replay)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error moving %s to %s\n", path, replay);
+		if (fd) {
+			switch_mutex_unlock(fd->mutex);
+		}
+		goto end;
+	}
+	if (fd) {
+		if (fd->fd > -1) {
+			close(fd->fd);
+			fd->fd = -1;
+		}
+		switch_mutex_unlock(fd->mutex);
+	}
+
+	if (!(in = fopen(replay, "r"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error opening %s\n", replay);
+		goto end;
+	}
+
+	switch_malloc(line, line_size);
+
+	for (;;) {
+		line_len = 0;
+
+		/* a line may be longer than the buffer */
+		while (fgets(line + line_len, (int) (line_size - line_len), in)) {
+			line_len += strlen(line + line_len);
+			if (line_len && line[line_len - 1] == '\n') {
+				break;
+			}
+			line_size *= 2;
+			line = realloc(line, line_size);
+			switch_assert(line);
+		}
+
+		if (!line_len) {
+			break;
+		}
+
+		while (line_len && (line[line_len - 1] == '\n' || line[line_len - 1] == '\r')) {
+			line[--line_len] = '\0';
+		}
+
+		if (!line_len) {
+			continue;
+		}
+
+		if (globals.spool_format == SPOOL_FORMAT_SQL) {
+			sql = NULL;
+		} else {
+			sql = insert_sql(line);
+			assert(sql);
+		}
+
+		if (PQstatus(w->conn) == CONNECTION_OK && writer_exec(w, sql ? sql : line) == SWITCH_STATUS_SUCCESS) {
+			replayed++;
+		} else {
+			spool_cdr(path, line);
+			failed++;
+		}
+
+		switch_safe_free(sql);
+	}
+
+	fclose(in);
+	unlink(replay);
+
+	if (PQstatus(w->conn) != CONNECTION_OK) {
+		writer_disconnect(w);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, failed ? SWITCH_LOG_WARNING : SWITCH_LOG_NOTICE, "Replayed %d spooled CDRs from %s, %d spooled again\n",
+					  replayed, path, failed);
+
+  end:
+
+	switch_safe_free(line);
+	switch_safe_free(replay);
 	switch_safe_free(path);
-	switch_safe_free(sql);
+}
 
-	return SWITCH_STATUS_FALSE;
+static void *SWITCH_THREAD_FUNC cdr_writer_thread(switch_thread_t *thread, void *obj)
+{
+	cdr_writer_t *w = (cdr_writer_t *) obj;
+	cdr_record_t **batch;
+	int count = 0, done = 0, batch_max = globals.batch_size;
+	switch_time_t first = 0;
+
+	switch_zmalloc(batch, sizeof(*batch) * batch_max);
+
+	while (!done) {
+		switch_interval_time_t flush_us = (switch_interval_time_t) globals.flush_interval * 1000, wait = 1000000;
+		int batch_size = globals.batch_size > batch_max ? batch_max : globals.batch_size;
+		switch_time_t now;
+		void *pop = NULL;
+
+		if (count) {
+			wait = first + flush_us - switch_micro_time_now();
+			if (wait < 1) {
+				wait = 1;
+			}
+		}
+
+		if (switch_queue_pop_timeout(globals.queue, &pop, wait) == SWITCH_STATUS_SUCCESS) {
+			if (!pop) {
+				done = 1;
+			} else {
+				if (!count) {
+					first = switch_micro_time_now();
+				}
+				batch[count++] = (cdr_record_t *) pop;
+			}
+		}
+
+		now = switch_micro_time_now();
+
+		if (count && (done || count >= batch_size || now - first >= flush_us)) {
+			writer_flush(w, batch, count);
+			count = 0;
+		}
+
+		/* the first writer puts the spool back once the database is reachable again */
+		if (!w->id && !count && !done) {
+			writer_replay(w);
+		}
+	}
+
+	writer_disconnect(w);
+	free(batch);
+
+	return NULL;
+}
+
+/* append one field to a COPY text row, NULL is \N */
+static void copy_field(switch_stream_handle_t *stream, const char *var, int first)
+{
+	const char *p;
+	char *out, *o;
+
+	if (!first) {
+		stream->raw_write_function(stream, (uint8_t *) "\t", 1);
+	}
+
+	if (!var) {
+		stream->raw_write_function(stream, (uint8_t *) "\\N", 2);
+		return;
+	}
+
+	switch_malloc(out, strlen(var) * 2 + 1);
+	for (p = var, o = out; *p; p++) {
+		switch (*p) {
+		case '\\':
+			*o++ = '\\';
+			*o++ = '\\';
+			break;
+		case '\t':
+			*o++ = '\\';
+			*o++ = 't';
+			break;
+		case '\n':
+			*o++ = '\\';
+			*o++ = 'n';
+			break;
+		case '\r':
+			*o++ = '\\';
+			*o++ = 'r';
+			break;
+		default:
+			*o++ = *p;
+			break;
+		}
+	}
+	stream->raw_write_function(stream, (uint8_t *) out, o - out);
+	free(out);
 }
 
 static switch_status_t my_on_reporting(switch_core_session_t *session)
@@ -315,6 +672,8 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 	const char *var = NULL;
 	cdr_field_t *cdr_field = NULL;
 	switch_size_t len, offset;
+	switch_stream_handle_t row = { 0 };
+	cdr_record_t *rec;
 
 	if (globals.shutdown) {
 		return SWITCH_STATUS_SUCCESS;
@@ -352,9 +711,13 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 
 	switch_zmalloc(values, 1);
 	offset = 0;
+	SWITCH_STANDARD_STREAM(row);
 
 	for (cdr_field = globals.db_schema->fields; cdr_field->var_name; cdr_field++) {
-		if ((var = switch_channel_get_variable(channel, cdr_field->var_name))) {
+		var = switch_channel_get_variable(channel, cdr_field->var_name);
+		copy_field(&row, (zstr(var) && !(cdr_field->quote && cdr_field->not_null)) ? NULL : switch_str_nil(var), cdr_field == globals.db_schema->fields);
+
+		if (var) {
 			/* Allocate sufficient buffer for PQescapeString */
 			len = strlen(var);
 			tmp = switch_core_session_alloc(session, len * 2 + 1);
@@ -381,9 +744,19 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 		offset += len;
 	}
 	*(values + --offset) = '\0';
-
-	insert_cdr(values);
-	switch_safe_free(values);
+	row.raw_write_function(&row, (uint8_t *) "\n", 1);
+
+	switch_zmalloc(rec, sizeof(*rec));
+	rec->values = values;
+	rec->row = (char *) row.data;
+	rec->row_len = row.data_len;
+
+	/* the writers are behind, rather spool than hold up the session */
+	if (switch_queue_trypush(globals.queue, rec) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "CDR queue full, spooling\n");
+		spool_record(rec);
+		free_record(rec);
+	}
 
 	return status;
 }
@@ -408,10 +781,7 @@ static void event_handler(switch_event_t *event)
 			do_rotate(fd);
 			switch_mutex_unlock(fd->mutex);
 		}
-		if (globals.db_online) {
-			PQfinish(globals.db_connection);
-			globals.db_online = 0;
-		}
+		globals.hup++;
 	}
 }
 
@@ -441,15 +811,9 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 	switch_size_t len = 0;
 	cdr_field_t *cdr_field;
 
-	if (globals.db_online) {
-		PQfinish(globals.db_connection);
-		switch_mutex_destroy(globals.db_mutex);
-		globals.db_online = 0;
-	}
-
 	memset(&globals, 0, sizeof(globals));
 	switch_core_hash_init(&globals.fd_hash, pool);
-	switch_mutex_init(&globals.db_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&globals.fd_mutex, SWITCH_MUTEX_NESTED, pool);
 
 	globals.pool = pool;
 
@@ -522,6 +886,8 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_pg_csv_load)
 {
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	switch_threadattr_t *thd_attr = NULL;
+	int i;
 
 	load_config(pool);
 
@@ -535,6 +901,15 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_pg_csv_load)
 		return status;
 	}
 
+	switch_queue_create(&globals.queue, globals.queue_size, pool);
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	for (i = 0; i < globals.db_connections; i++) {
+		globals.writers[i].id = i;
+		switch_thread_create(&globals.writers[i].thread, thd_attr, cdr_writer_thread, &globals.writers[i], pool);
+	}
+
 	switch_core_add_state_handler(&state_handlers);
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
@@ -544,17 +919,26 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_pg_csv_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_cdr_pg_csv_shutdown)
 {
+	switch_status_t st;
+	int i;
 
 	globals.shutdown = 1;
 
-	if (globals.db_online) {
-		PQfinish(globals.db_connection);
-		globals.db_online = 0;
-	}
-
 	switch_event_unbind_callback(event_handler);
 	switch_core_remove_state_handler(&state_handlers);
 
+	/* the writers load or spool everything queued ahead of their NULL */
+	for (i = 0; i < globals.db_connections; i++) {
+		if (globals.writers[i].thread) {
+			switch_queue_push(globals.queue, NULL);
+		}
+	}
+	for (i = 0; i < globals.db_connections; i++) {
+		if (globals.writers[i].thread) {
+			switch_thread_join(&st, globals.writers[i].thread);
+		}
+	}
+
 
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -70,6 +70,14 @@ static struct {
 	switch_hash_t *template_hash;
 	char *default_template;
 	int shutdown;
+	/* INSERTs waiting for the writer thread, committed batch_size at a time */
+	switch_queue_t *queue;
+	switch_thread_t *writer_thread;
+	int batch_size;
+	int flush_interval;
+	int queue_size;
+	char *journal_mode;
+	char *synchronous;
 } globals;
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_sqlite_load);
@@ -89,6 +97,123 @@ switch_cache_db_handle_t *cdr_get_db_handle(void)
 }
 
 
+/* the writer keeps its handle for life, the pragmas only need to be set once per connection */
+static switch_cache_db_handle_t *writer_db_handle(void)
+{
+	switch_cache_db_handle_t *dbh;
+	char *sql;
+
+	if (!(dbh = cdr_get_db_handle())) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening DB\n");
+		return NULL;
+	}
+
+	if (!zstr(globals.journal_mode)) {
+		sql = switch_mprintf("PRAGMA journal_mode=%s;", globals.journal_mode);
+		switch_cache_db_execute_sql(dbh, sql, NULL);
+		switch_safe_free(sql);
+	}
+
+	if (!zstr(globals.synchronous)) {
+		sql = switch_mprintf("PRAGMA synchronous=%s;", globals.synchronous);
+		switch_cache_db_execute_sql(dbh, sql, NULL);
+		switch_safe_free(sql);
+	}
+
+	return dbh;
+}
+
+/* commit a batch in one transaction, when that fails insert one at a time so a bad CDR does not take the rest with it */
+static void writer_flush(switch_cache_db_handle_t *dbh, char **batch, int count, switch_stream_handle_t *buf)
+{
+	int i;
+
+	if (count > 1) {
+		buf->data_len = 0;
+		buf->end = buf->data;
+		for (i = 0; i < count; i++) {
+			buf->write_function(buf, "%s;\n", batch[i]);
+		}
+
+		if (switch_cache_db_persistant_execute_trans(dbh, (char *) buf->data, 1) == SWITCH_STATUS_SUCCESS) {
+			goto done;
+		}
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Batch of %d CDRs failed, inserting one by one\n", count);
+	}
+
+	for (i = 0; i < count; i++) {
+		if (globals.debug) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Writing SQL to DB: %s\n", batch[i]);
+		}
+		if (switch_cache_db_execute_sql(dbh, batch[i], NULL) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error writing CDR: %s\n", batch[i]);
+		}
+	}
+
+  done:
+
+	for (i = 0; i < count; i++) {
+		switch_safe_free(batch[i]);
+	}
+}
+
+static void *SWITCH_THREAD_FUNC cdr_writer_thread(switch_thread_t *thread, void *obj)
+{
+	switch_cache_db_handle_t *dbh = NULL;
+	switch_stream_handle_t buf = { 0 };
+	char **batch;
+	int count = 0, done = 0;
+	switch_time_t first = 0;
+
+	switch_zmalloc(batch, sizeof(*batch) * globals.batch_size);
+	SWITCH_STANDARD_STREAM(buf);
+
+	while (!done) {
+		switch_interval_time_t flush_us = (switch_interval_time_t) globals.flush_interval * 1000, wait = 1000000;
+		void *pop = NULL;
+
+		if (count) {
+			wait = first + flush_us - switch_micro_time_now();
+			if (wait < 1) {
+				wait = 1;
+			}
+		}
+
+		if (switch_queue_pop_timeout(globals.queue, &pop, wait) == SWITCH_STATUS_SUCCESS) {
+			if (!pop) {
+				done = 1;
+			} else {
+				if (!count) {
+					first = switch_micro_time_now();
+				}
+				batch[count++] = (char *) pop;
+			}
+		}
+
+		if (count && (done || count >= globals.batch_size || switch_micro_time_now() - first >= flush_us)) {
+			if (!dbh && !(dbh = writer_db_handle())) {
+				int i;
+
+				for (i = 0; i < count; i++) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Lost CDR: %s\n", batch[i]);
+					switch_safe_free(batch[i]);
+				}
+			} else {
+				writer_flush(dbh, batch, count, &buf);
+			}
+			count = 0;
+		}
+	}
+
+	if (dbh) {
+		switch_cache_db_release_db_handle(&dbh);
+	}
+	switch_safe_free(buf.data);
+	free(batch);
+
+	return NULL;
+}
+
 static switch_status_t write_cdr(char *sql)
 {
 	switch_cache_db_handle_t *dbh = NULL;
@@ -161,8 +286,12 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 
 	sql = switch_mprintf("INSERT INTO %s VALUES (%s)", globals.db_table, expanded_vars);
 	assert(sql);
-	write_cdr(sql);
-	switch_safe_free(sql);
+
+	/* the writer owns it from here, when it is too far behind write it ourselves */
+	if (!globals.queue || switch_queue_trypush(globals.queue, sql) != SWITCH_STATUS_SUCCESS) {
+		write_cdr(sql);
+		switch_safe_free(sql);
+	}
 
 	if (expanded_vars != template_str) {
 		switch_safe_free(expanded_vars);
@@ -203,6 +332,9 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 	switch_core_hash_insert(globals.template_hash, "default", default_template);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Adding default template.\n");
 	globals.legs = CDR_LEG_A;
+	globals.batch_size = 200;
+	globals.flush_interval = 1000;
+	globals.queue_size = 10000;
 
 	if ((xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 
@@ -228,6 +360,33 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 					}
 				} else if (!strcasecmp(var, "default-template")) {
 					globals.default_template = switch_core_strdup(pool, val);
+				} else if (!strcasecmp(var, "batch-size")) {
+					int tmp = atoi(val);
+					if (tmp >= 0 && tmp <= 100000) {
+						globals.batch_size = tmp;
+					}
+				} else if (!strcasecmp(var, "flush-interval")) {
+					int tmp = atoi(val);
+					if (tmp >= 10 && tmp <= 60000) {
+						globals.flush_interval = tmp;
+					}
+				} else if (!strcasecmp(var, "queue-size")) {
+					int tmp = atoi(val);
+					if (tmp >= 100 && tmp <= 1000000) {
+						globals.queue_size = tmp;
+					}
+				} else if (!strcasecmp(var, "journal-mode")) {
+					if (!strcasecmp(val, "wal") || !strcasecmp(val, "delete") || !strcasecmp(val, "truncate") || !strcasecmp(val, "persist")) {
+						globals.journal_mode = switch_core_strdup(pool, val);
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Unsupported journal-mode %s\n", val);
+					}
+				} else if (!strcasecmp(var, "synchronous")) {
+					if (!strcasecmp(val, "off") || !strcasecmp(val, "normal") || !strcasecmp(val, "full")) {
+						globals.synchronous = switch_core_strdup(pool, val);
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Unsupported synchronous %s\n", val);
+					}
 				}
 			}
 		}
@@ -286,6 +445,16 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_sqlite_load)
 
 	load_config(pool);
 
+	/* batch-size 0 keeps writing every CDR from the session's own thread */
+	if (globals.batch_size) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		switch_queue_create(&globals.queue, globals.queue_size, pool);
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.writer_thread, thd_attr, cdr_writer_thread, NULL, pool);
+	}
+
 	switch_core_add_state_handler(&state_handlers);
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
@@ -295,9 +464,17 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_cdr_sqlite_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_cdr_sqlite_shutdown)
 {
+	switch_status_t st;
+
 	globals.shutdown = 1;
 	switch_core_remove_state_handler(&state_handlers);
 
+	/* the writer commits whatever was queued ahead of the NULL */
+	if (globals.writer_thread) {
+		switch_queue_push(globals.queue, NULL);
+		switch_thread_join(&st, globals.writer_thread);
+	}
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
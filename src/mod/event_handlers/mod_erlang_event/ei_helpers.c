@@ -257,6 +257,48 @@ void ei_x_print_msg(ei_x_buff * buf, erlang_pid * pid, int send)
 }
 
 
+shared_event_t *shared_event_create(switch_event_t *event)
+{
+	switch_event_t *clone = NULL;
+	shared_event_t *sev;
+	ei_x_buff ebuf;
+
+	/* encoding url decodes the header values in place, so work on a copy */
+	if (switch_event_dup(&clone, event) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	ei_x_new(&ebuf);
+	ei_encode_switch_event(&ebuf, clone);
+	switch_event_destroy(&clone);
+
+	if ((sev = malloc(sizeof(*sev) + ebuf.index))) {
+		switch_atomic_set(&sev->refs, 1);
+		sev->len = ebuf.index;
+		memcpy(sev->buff, ebuf.buff, ebuf.index);
+	}
+
+	ei_x_free(&ebuf);
+
+	return sev;
+}
+
+shared_event_t *shared_event_ref(shared_event_t *sev)
+{
+	switch_atomic_inc(&sev->refs);
+	return sev;
+}
+
+void shared_event_release(shared_event_t **sev)
+{
+	if (*sev) {
+		if (!switch_atomic_dec(&(*sev)->refs)) {
+			free(*sev);
+		}
+		*sev = NULL;
+	}
+}
+
 int ei_sendto(ei_cnode * ec, int fd, struct erlang_process *process, ei_x_buff * buf)
 {
 	int ret;
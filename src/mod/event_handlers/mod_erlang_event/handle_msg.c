@@ -1015,7 +1015,10 @@ static switch_status_t handle_msg_atom(listener_t *listener, erlang_msg * msg, e
 	} else if (!strncmp(atom, "noevents", MAXATOMLEN)) {
 		void *pop;
 		/*purge the event queue */
-		while (switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS);
+		while (switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			shared_event_t *sev = (shared_event_t *) pop;
+			shared_event_release(&sev);
+		}
 
 		if (switch_test_flag(listener, LFLAG_EVENTS)) {
 			uint8_t x = 0;
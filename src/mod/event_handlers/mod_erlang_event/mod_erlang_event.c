@@ -166,7 +166,7 @@ static void send_event_to_attached_sessions(listener_t *listener, switch_event_t
 
 static void event_handler(switch_event_t *event)
 {
-	switch_event_t *clone = NULL;
+	shared_event_t *shared = NULL;
 	listener_t *l, *lp;
 
 	switch_assert(event != NULL);
@@ -204,21 +204,24 @@ static void event_handler(switch_event_t *event)
 
 
 		if (send) {
-			if (switch_event_dup(&clone, event) == SWITCH_STATUS_SUCCESS) {
-				if (switch_queue_trypush(l->event_queue, clone) == SWITCH_STATUS_SUCCESS) {
+			/* encode the event the first time a listener wants it, the rest share that term */
+			if (shared || (shared = shared_event_create(event))) {
+				shared_event_t *sev = shared_event_ref(shared);
+
+				if (switch_queue_trypush(l->event_queue, sev) == SWITCH_STATUS_SUCCESS) {
 					if (l->lost_events) {
+						switch_event_t *trap = NULL;
 						int le = l->lost_events;
 						l->lost_events = 0;
 						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Lost %d events!\n", le);
-						clone = NULL;
-						if (switch_event_create(&clone, SWITCH_EVENT_TRAP) == SWITCH_STATUS_SUCCESS) {
-							switch_event_add_header(clone, SWITCH_STACK_BOTTOM, "info", "lost %d events", le);
-							switch_event_fire(&clone);
+						if (switch_event_create(&trap, SWITCH_EVENT_TRAP) == SWITCH_STATUS_SUCCESS) {
+							switch_event_add_header(trap, SWITCH_STACK_BOTTOM, "info", "lost %d events", le);
+							switch_event_fire(&trap);
 						}
 					}
 				} else {
 					l->lost_events++;
-					switch_event_destroy(&clone);
+					shared_event_release(&sev);
 				}
 			} else {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Memory Error!\n");
@@ -227,6 +230,8 @@ static void event_handler(switch_event_t *event)
 
 	}
 	switch_thread_rwlock_unlock(globals.listener_rwlock);
+
+	shared_event_release(&shared);
 }
 
 
@@ -719,28 +724,86 @@ static void check_log_queue(listener_t *listener)
 	}
 }
 
+/* Send up to event-batch-size queued events as one {events, [Event, ...]} message */
+static void send_event_batch(listener_t *listener)
+{
+	shared_event_t *batch[MAX_EVENT_BATCH];
+	uint32_t count = 0, i;
+	void *pop;
+	ei_x_buff ebuf;
+
+	while (count < prefs.event_batch && switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		batch[count++] = (shared_event_t *) pop;
+	}
+
+	if (!count) {
+		return;
+	}
+
+	ei_x_new_with_version(&ebuf);
+	ei_x_encode_tuple_header(&ebuf, 2);
+	ei_x_encode_atom(&ebuf, "events");
+	ei_x_encode_list_header(&ebuf, count);
+
+	for (i = 0; i < count; i++) {
+		ei_x_append_buf(&ebuf, batch[i]->buff, batch[i]->len);
+		shared_event_release(&batch[i]);
+	}
+
+	ei_x_encode_empty_list(&ebuf);
+
+	switch_mutex_lock(listener->sock_mutex);
+	ei_sendto(listener->ec, listener->sockfd, &listener->event_process, &ebuf);
+	switch_mutex_unlock(listener->sock_mutex);
+
+	ei_x_free(&ebuf);
+}
+
 static void check_event_queue(listener_t *listener)
 {
 	void *pop;
 
 	/* send out any pending crap in the event queue */
-	if (switch_test_flag(listener, LFLAG_EVENTS)) {
-		if (switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
-
-			switch_event_t *pevent = (switch_event_t *) pop;
+	if (!switch_test_flag(listener, LFLAG_EVENTS)) {
+		return;
+	}
 
-			ei_x_buff ebuf;
-			ei_x_new_with_version(&ebuf);
+	if (prefs.event_batch > 1) {
+		unsigned int queued = switch_queue_size(listener->event_queue);
+		switch_time_t now;
 
-			ei_encode_switch_event(&ebuf, pevent);
+		if (!queued) {
+			listener->batch_start = 0;
+			return;
+		}
 
-			switch_mutex_lock(listener->sock_mutex);
-			ei_sendto(listener->ec, listener->sockfd, &listener->event_process, &ebuf);
-			switch_mutex_unlock(listener->sock_mutex);
+		/* hold back a partial batch until the oldest event in it has waited event-flush-interval */
+		now = switch_micro_time_now();
+		if (!listener->batch_start) {
+			listener->batch_start = now;
+		}
 
-			ei_x_free(&ebuf);
-			switch_event_destroy(&pevent);
+		if (queued < prefs.event_batch && now - listener->batch_start < (switch_time_t) prefs.event_flush_interval * 1000) {
+			return;
 		}
+
+		send_event_batch(listener);
+		listener->batch_start = queued > prefs.event_batch ? now : 0;
+
+	} else if (switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		shared_event_t *sev = (shared_event_t *) pop;
+
+		ei_x_buff ebuf;
+		ei_x_new_with_version(&ebuf);
+
+		ei_x_append_buf(&ebuf, sev->buff, sev->len);
+
+		switch_mutex_lock(listener->sock_mutex);
+		ei_sendto(listener->ec, listener->sockfd, &listener->event_process, &ebuf);
+		switch_mutex_unlock(listener->sock_mutex);
+
+		ei_x_free(&ebuf);
+		shared_event_release(&sev);
 	}
 }
 
@@ -788,8 +851,8 @@ static void handle_exit(listener_t *listener, erlang_pid * pid)
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Event handler process for node %s exited\n", pid->node);
 		/*purge the event queue */
 		while (switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
-			switch_event_t *pevent = (switch_event_t *) pop;
-			switch_event_destroy(&pevent);
+			shared_event_t *sev = (shared_event_t *) pop;
+			shared_event_release(&sev);
 		}
 
 		if (switch_test_flag(listener, LFLAG_EVENTS)) {
@@ -1075,6 +1138,8 @@ static int config(void)
 	prefs.shortname = SWITCH_TRUE;
 	prefs.encoding = ERLANG_STRING;
 	prefs.compat_rel = 0;
+	prefs.event_batch = 1;
+	prefs.event_flush_interval = 20;
 
 	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Open of %s failed\n", cf);
@@ -1111,6 +1176,18 @@ static int config(void)
 					} else {
 						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid encoding strategy '%s' specified\n", val);
 					}
+				} else if (!strcmp(var, "event-batch-size")) {
+					int n = atoi(val);
+					if (n >= 1 && n <= MAX_EVENT_BATCH) {
+						prefs.event_batch = (uint32_t) n;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid event-batch-size '%s' specified, must be 1 to %d\n", val, MAX_EVENT_BATCH);
+					}
+				} else if (!strcmp(var, "event-flush-interval")) {
+					int n = atoi(val);
+					if (n >= 1) {
+						prefs.event_flush_interval = (uint32_t) n;
+					}
 				} else if (!strcasecmp(var, "apply-inbound-acl") && ! zstr(val)) {
 					if (prefs.acl_count < MAX_ACL) {
 						prefs.acl[prefs.acl_count++] = strdup(val);
@@ -133,6 +133,7 @@ struct listener {
 	switch_hash_t *sessions;
 	int lost_events;
 	int lost_logs;
+	switch_time_t batch_start;
 	uint32_t id;
 	char remote_ip[50];
 	/*switch_port_t remote_port; */
@@ -206,9 +207,21 @@ struct prefs_struct {
 	uint32_t id;
 	erlang_encoding_t encoding;
 	int compat_rel;
+	uint32_t event_batch;
+	uint32_t event_flush_interval;
 };
 typedef struct prefs_struct prefs_t;
 
+#define MAX_EVENT_BATCH 256
+
+/* An event ei encoded once, without the version magic, and shared by every listener it is queued to */
+struct shared_event {
+	volatile switch_atomic_t refs;
+	int len;
+	char buff[1];
+};
+typedef struct shared_event shared_event_t;
+
 /* shared globals */
 #ifdef DEFINE_GLOBALS
 globals_t globals;
@@ -241,6 +254,9 @@ int ei_compare_pids(erlang_pid * pid1, erlang_pid * pid2);
 int ei_decode_string_or_binary(char *buf, int *index, int maxlen, char *dst);
 switch_status_t initialise_ei(struct ei_cnode_s *ec);
 #define ei_encode_switch_event(_b, _e) ei_encode_switch_event_tag(_b, _e, "event")
+shared_event_t *shared_event_create(switch_event_t *event);
+shared_event_t *shared_event_ref(shared_event_t *sev);
+void shared_event_release(shared_event_t **sev);
 
 /* crazy macro for toggling encoding type */
 #define _ei_x_encode_string(buf, string) switch (prefs.encoding) { \
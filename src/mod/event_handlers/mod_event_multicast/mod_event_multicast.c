@@ -33,8 +33,16 @@
 #include <openssl/evp.h>
 #endif
 #include <switch.h>
+#include <zlib.h>
 
 #define MULTICAST_BUFFSIZE 65536
+/* largest run of events packed into one datagram before compression and encryption */
+#define MULTICAST_BATCH_MAX (MULTICAST_BUFFSIZE - 1024)
+/* a compressed datagram is "\0Z", the u32 network order length of the events and the deflate stream */
+#define MULTICAST_ZHEADER 6
+#define MULTICAST_ZMAX (1024 * 1024)
+/* a sequence this far behind the newest seen from a peer means the peer restarted */
+#define MULTICAST_RESTART_GAP 1024
 
 /* magic byte sequence */
 static unsigned char MAGIC[] = { 226, 132, 177, 197, 152, 198, 142, 211, 172, 197, 158, 208, 169, 208, 135, 197, 166, 207, 154, 196, 166 };
@@ -62,11 +70,37 @@ static struct {
 	switch_mutex_t *mutex;
 	switch_hash_t *peer_hash;
 	int loopback;
+	uint32_t batch_mtu;
+	uint32_t batch_interval;
+	switch_bool_t compress;
+	uint32_t compress_min;
+	uint32_t zratio;
+	switch_hash_t *header_hash;
+	uint32_t sequence;
+	switch_mutex_t *batch_mutex;
+	char *batch;
+	switch_size_t batch_len;
+	uint32_t batch_events;
+	switch_thread_t *flush_thread;
+	int flushing;
+	uint64_t tx_events;
+	uint64_t tx_datagrams;
+	uint64_t tx_raw_bytes;
+	uint64_t tx_bytes;
+	uint64_t rx_events;
+	uint64_t rx_datagrams;
+	uint64_t rx_duplicates;
+	uint64_t rx_errors;
 } globals;
 
 struct peer_status {
 	switch_bool_t active;
 	time_t lastseen;
+	uint32_t max_seq;
+	uint64_t window;
+	uint64_t received;
+	uint64_t duplicates;
+	uint64_t lost;
 };
 
 SWITCH_DECLARE_GLOBAL_STRING_FUNC(set_global_address, globals.address);
@@ -90,6 +124,15 @@ static switch_status_t load_config(void)
 	globals.ttl = 1;
 	globals.key_count = 0;
 	globals.loopback = 0;
+	globals.batch_mtu = 0;
+	globals.batch_interval = 20;
+	globals.compress = SWITCH_FALSE;
+	globals.compress_min = 256;
+	globals.zratio = 100;
+
+	if (globals.header_hash) {
+		switch_core_hash_destroy(&globals.header_hash);
+	}
 
 	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Open of %s failed\n", cf);
@@ -123,6 +166,47 @@ static switch_status_t load_config(void)
 				}
 			} else if (!strcasecmp(var, "loopback")) {
 				globals.loopback = switch_true(val);
+			} else if (!strcasecmp(var, "batch-mtu")) {
+				int mtu = atoi(val);
+				if (mtu == 0 || (mtu >= 512 && mtu <= MULTICAST_BATCH_MAX)) {
+					globals.batch_mtu = (uint32_t) mtu;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Invalid batch-mtu '%s' specified, not batching\n", val);
+				}
+			} else if (!strcasecmp(var, "batch-interval")) {
+				int ms = atoi(val);
+				if (ms > 0 && ms <= 1000) {
+					globals.batch_interval = (uint32_t) ms;
+				}
+			} else if (!strcasecmp(var, "compress")) {
+				globals.compress = switch_true(val);
+			} else if (!strcasecmp(var, "compress-min")) {
+				int min = atoi(val);
+				if (min >= 0) {
+					globals.compress_min = (uint32_t) min;
+				}
+			} else if (!strcasecmp(var, "send-headers") && !zstr(val)) {
+				char *dup = strdup(val), *names[128] = { 0 };
+				int i, argc = switch_separate_string(dup, ',', names, (sizeof(names) / sizeof(names[0])));
+
+				/* the headers the far end needs to route and dedup the event are always sent */
+				switch_core_hash_init_nocase(&globals.header_hash, module_pool);
+				switch_core_hash_insert(globals.header_hash, "Event-Name", MARKER);
+				switch_core_hash_insert(globals.header_hash, "Event-Subclass", MARKER);
+				switch_core_hash_insert(globals.header_hash, "Core-UUID", MARKER);
+				switch_core_hash_insert(globals.header_hash, "Multicast-Sender", MARKER);
+				switch_core_hash_insert(globals.header_hash, "Multicast-Sequence", MARKER);
+
+				for (i = 0; i < argc; i++) {
+					char *name = names[i];
+					while (*name == ' ') {
+						name++;
+					}
+					if (!zstr(name)) {
+						switch_core_hash_insert(globals.header_hash, name, MARKER);
+					}
+				}
+				free(dup);
 			}
 
 		}
@@ -169,8 +253,233 @@ static switch_status_t load_config(void)
 
 }
 
+/* call with globals.mutex held */
+static struct peer_status *peer_get(const char *sender)
+{
+	struct peer_status *p;
+
+	if (!(p = switch_core_hash_find(globals.peer_hash, sender))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Host %s not already in hash\n", sender);
+		p = switch_core_alloc(module_pool, sizeof(struct peer_status));
+		p->active = SWITCH_FALSE;
+		p->lastseen = 0;
+		switch_core_hash_insert(globals.peer_hash, sender, p);
+	}
+
+	return p;
+}
+
+/* Track the last 64 sequence numbers from a peer, the same idea as an SRTP replay window */
+static switch_bool_t peer_duplicate(struct peer_status *p, uint32_t seq)
+{
+	uint32_t diff;
+
+	p->received++;
+
+	if (!p->max_seq || seq + MULTICAST_RESTART_GAP < p->max_seq) {
+		p->max_seq = seq;
+		p->window = 1;
+		return SWITCH_FALSE;
+	}
+
+	if (seq > p->max_seq) {
+		diff = seq - p->max_seq;
+		p->lost += diff - 1;
+		p->window = diff >= 64 ? 1 : (p->window << diff) | 1;
+		p->max_seq = seq;
+		return SWITCH_FALSE;
+	}
+
+	diff = p->max_seq - seq;
+
+	if (diff >= 64 || (p->window & ((uint64_t) 1 << diff))) {
+		p->received--;
+		p->duplicates++;
+		return SWITCH_TRUE;
+	}
+
+	/* a late arrival, it was counted as lost when the window moved past it */
+	p->window |= (uint64_t) 1 << diff;
+	if (p->lost) {
+		p->lost--;
+	}
+
+	return SWITCH_FALSE;
+}
+
+/* A copy of the event with only the configured headers, call with globals.mutex held */
+static switch_event_t *filter_event(switch_event_t *event)
+{
+	switch_event_t *clone = NULL;
+	switch_event_header_t *hp;
+
+	if (switch_event_create_plain(&clone, event->event_id) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	for (hp = event->headers; hp; hp = hp->next) {
+		if (switch_core_hash_find(globals.header_hash, hp->name)) {
+			switch_event_add_header_string(clone, SWITCH_STACK_BOTTOM, hp->name, hp->value);
+		}
+	}
+
+	if (event->body) {
+		switch_event_add_body(clone, "%s", event->body);
+	}
+
+	return clone;
+}
+
+/* Send one datagram of events, each already followed by MAGIC, call with globals.batch_mutex held */
+static void multicast_send(const char *data, switch_size_t len)
+{
+	const char *payload = data;
+	char *zbuf = NULL;
+	char *buf = NULL;
+
+	globals.tx_raw_bytes += len;
+
+	if (globals.compress && len >= globals.compress_min) {
+		uLongf zlen = compressBound((uLong) len);
+
+		zbuf = malloc(zlen + MULTICAST_ZHEADER);
+		switch_assert(zbuf);
+
+		if (compress2((Bytef *) zbuf + MULTICAST_ZHEADER, &zlen, (const Bytef *) data, (uLong) len, Z_DEFAULT_COMPRESSION) == Z_OK &&
+			zlen + MULTICAST_ZHEADER < len) {
+			uint32_t raw = htonl((uint32_t) len);
+
+			zbuf[0] = '\0';
+			zbuf[1] = 'Z';
+			memcpy(zbuf + 2, &raw, sizeof(raw));
+
+			/* leave some slack so a batch of less compressible events still fits the mtu */
+			globals.zratio = (uint32_t) ((len * 100 / zlen) * 7 / 8);
+			if (globals.zratio < 100) {
+				globals.zratio = 100;
+			} else if (globals.zratio > 1000) {
+				globals.zratio = 1000;
+			}
+
+			payload = zbuf;
+			len = zlen + MULTICAST_ZHEADER;
+		}
+	}
+
+#ifdef HAVE_OPENSSL
+	if (globals.psk) {
+		int outlen, tmplen;
+		EVP_CIPHER_CTX ctx;
+		char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+		switch_uuid_t uuid;
+
+		switch_uuid_get(&uuid);
+		switch_uuid_format(uuid_str, &uuid);
+
+		buf = malloc(len + SWITCH_UUID_FORMATTED_LENGTH + EVP_MAX_BLOCK_LENGTH + 1);
+		switch_assert(buf);
+		switch_copy_string(buf, uuid_str, SWITCH_UUID_FORMATTED_LENGTH);
+
+		EVP_CIPHER_CTX_init(&ctx);
+		EVP_EncryptInit(&ctx, EVP_bf_cbc(), NULL, NULL);
+		EVP_CIPHER_CTX_set_key_length(&ctx, strlen(globals.psk));
+		EVP_EncryptInit(&ctx, NULL, (unsigned char *) globals.psk, (unsigned char *) uuid_str);
+		EVP_EncryptUpdate(&ctx, (unsigned char *) buf + SWITCH_UUID_FORMATTED_LENGTH, &outlen, (unsigned char *) payload, (int) len);
+		EVP_EncryptFinal(&ctx, (unsigned char *) buf + SWITCH_UUID_FORMATTED_LENGTH + outlen, &tmplen);
+		outlen += tmplen;
+		EVP_CIPHER_CTX_cleanup(&ctx);
+
+		len = (size_t) outlen + SWITCH_UUID_FORMATTED_LENGTH;
+		payload = buf;
+	}
+#endif
+
+	globals.tx_datagrams++;
+	globals.tx_bytes += len;
+
+	switch_socket_sendto(globals.udp_socket, globals.addr, 0, payload, &len);
+
+	switch_safe_free(zbuf);
+	switch_safe_free(buf);
+}
+
+/* How much event text one datagram may carry, call with globals.batch_mutex held */
+static switch_size_t batch_limit(void)
+{
+	switch_size_t room = globals.batch_mtu;
+
+#ifdef HAVE_OPENSSL
+	if (globals.psk) {
+		room -= SWITCH_UUID_FORMATTED_LENGTH + EVP_MAX_BLOCK_LENGTH;
+	}
+#endif
+
+	if (globals.compress) {
+		room = (room - MULTICAST_ZHEADER) * globals.zratio / 100;
+	}
+
+	return room > MULTICAST_BATCH_MAX ? MULTICAST_BATCH_MAX : room;
+}
+
+/* call with globals.batch_mutex held */
+static void batch_flush(void)
+{
+	if (globals.batch_len) {
+		multicast_send(globals.batch, globals.batch_len);
+		globals.batch_len = 0;
+		globals.batch_events = 0;
+	}
+}
+
+static void multicast_queue(const char *packet)
+{
+	switch_size_t len = strlen(packet), mlen = strlen((char *) MAGIC);
+
+	switch_mutex_lock(globals.batch_mutex);
+
+	globals.tx_events++;
+
+	if (globals.batch_mtu && len + mlen <= batch_limit()) {
+		if (globals.batch_len + len + mlen > batch_limit()) {
+			batch_flush();
+		}
+
+		memcpy(globals.batch + globals.batch_len, packet, len);
+		memcpy(globals.batch + globals.batch_len + len, MAGIC, mlen);
+		globals.batch_len += len + mlen;
+		globals.batch_events++;
+	} else {
+		/* not batching, or too big to share a datagram */
+		char *buf = malloc(len + mlen + 1);
+
+		switch_assert(buf);
+		memcpy(buf, packet, len);
+		memcpy(buf + len, MAGIC, mlen + 1);
+
+		batch_flush();
+		multicast_send(buf, len + mlen);
+		free(buf);
+	}
+
+	switch_mutex_unlock(globals.batch_mutex);
+}
+
+static void *SWITCH_THREAD_FUNC flush_thread_run(switch_thread_t *thread, void *obj)
+{
+	while (globals.flushing) {
+		switch_yield(globals.batch_interval * 1000);
+
+		switch_mutex_lock(globals.batch_mutex);
+		batch_flush();
+		switch_mutex_unlock(globals.batch_mutex);
+	}
+
+	return NULL;
+}
+
 static void event_handler(switch_event_t *event)
 {
+	switch_event_t *filtered = NULL;
 	uint8_t send = 0;
 
 	if (globals.running != 1) {
@@ -185,14 +494,8 @@ static void event_handler(switch_event_t *event)
 			struct peer_status *p;
 			time_t now = switch_epoch_time_now(NULL);
 
-			if (!(p = switch_core_hash_find(globals.peer_hash, sender))) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Host %s not already in hash\n", sender);
-				p = switch_core_alloc(module_pool, sizeof(struct peer_status));
-				p->active = SWITCH_FALSE;
-				p->lastseen = 0;
-				/*} else { */
-				/*switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Host %s last seen %d seconds ago\n", sender, now - p->lastseen); */
-			}
+			switch_mutex_lock(globals.mutex);
+			p = peer_get(sender);
 
 			if (!p->active) {
 				switch_event_t *local_event;
@@ -212,8 +515,7 @@ static void event_handler(switch_event_t *event)
 			}
 			p->active = SWITCH_TRUE;
 			p->lastseen = now;
-
-			switch_core_hash_insert(globals.peer_hash, sender, p);
+			switch_mutex_unlock(globals.mutex);
 		}
 
 		/* ignore our own events to avoid ping pong */
@@ -247,6 +549,7 @@ static void event_handler(switch_event_t *event)
 		struct peer_status *last;
 		char *host;
 
+		switch_mutex_lock(globals.mutex);
 		for (cur = switch_hash_first(NULL, globals.peer_hash); cur; cur = switch_hash_next(cur)) {
 			switch_hash_this(cur, &key, &keylen, &value);
 			host = (char *) key;
@@ -266,6 +569,7 @@ static void event_handler(switch_event_t *event)
 				}
 			}
 		}
+		switch_mutex_unlock(globals.mutex);
 	}
 
 	switch_mutex_lock(globals.mutex);
@@ -276,6 +580,14 @@ static void event_handler(switch_event_t *event)
 			send = 1;
 		}
 	}
+
+	if (send && event->event_id != SWITCH_EVENT_LOG) {
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Multicast-Sender", switch_core_get_switchname());
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Multicast-Sequence", "%u", ++globals.sequence);
+		if (globals.header_hash) {
+			filtered = filter_event(event);
+		}
+	}
 	switch_mutex_unlock(globals.mutex);
 
 	if (send) {
@@ -285,58 +597,18 @@ static void event_handler(switch_event_t *event)
 		case SWITCH_EVENT_LOG:
 			return;
 		default:
-			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Multicast-Sender", switch_core_get_switchname());
-			if (switch_event_serialize(event, &packet, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS) {
-				size_t len;
-				char *buf;
-#ifdef HAVE_OPENSSL
-				int outlen, tmplen;
-				EVP_CIPHER_CTX ctx;
-				char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
-				switch_uuid_t uuid;
-
-				switch_uuid_get(&uuid);
-				switch_uuid_format(uuid_str, &uuid);
-				len = strlen(packet) + SWITCH_UUID_FORMATTED_LENGTH + EVP_MAX_IV_LENGTH + strlen((char *) MAGIC);
-#else
-				len = strlen(packet) + strlen((char *) MAGIC);
-#endif
-				buf = malloc(len + 1);
-				memset(buf, 0, len + 1);
-				switch_assert(buf);
-
-#ifdef HAVE_OPENSSL
-				if (globals.psk) {
-					switch_copy_string(buf, uuid_str, SWITCH_UUID_FORMATTED_LENGTH);
-
-					EVP_CIPHER_CTX_init(&ctx);
-					EVP_EncryptInit(&ctx, EVP_bf_cbc(), NULL, NULL);
-					EVP_CIPHER_CTX_set_key_length(&ctx, strlen(globals.psk));
-					EVP_EncryptInit(&ctx, NULL, (unsigned char *) globals.psk, (unsigned char *) uuid_str);
-					EVP_EncryptUpdate(&ctx, (unsigned char *) buf + SWITCH_UUID_FORMATTED_LENGTH,
-									  &outlen, (unsigned char *) packet, (int) strlen(packet));
-					EVP_EncryptUpdate(&ctx, (unsigned char *) buf + SWITCH_UUID_FORMATTED_LENGTH + outlen,
-									  &tmplen, (unsigned char *) MAGIC, (int) strlen((char *) MAGIC));
-					outlen += tmplen;
-					EVP_EncryptFinal(&ctx, (unsigned char *) buf + SWITCH_UUID_FORMATTED_LENGTH + outlen, &tmplen);
-					outlen += tmplen;
-					len = (size_t) outlen + SWITCH_UUID_FORMATTED_LENGTH;
-					*(buf + SWITCH_UUID_FORMATTED_LENGTH + outlen) = '\0';
-				} else {
-#endif
-					switch_copy_string(buf, packet, len);
-					switch_copy_string(buf + strlen(packet), (char *) MAGIC, strlen((char *) MAGIC) + 1);
-#ifdef HAVE_OPENSSL
-				}
-#endif
-
-				switch_socket_sendto(globals.udp_socket, globals.addr, 0, buf, &len);
+			if (switch_event_serialize(filtered ? filtered : event, &packet, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS) {
+				multicast_queue(packet);
 				switch_safe_free(packet);
-				switch_safe_free(buf);
 			}
 			break;
 		}
 	}
+
+	if (filtered) {
+		switch_event_destroy(&filtered);
+	}
+
 	return;
 }
 
@@ -351,30 +623,47 @@ SWITCH_STANDARD_API(multicast_peers)
 	char *host;
 	int i = 0;
 
+	switch_mutex_lock(globals.mutex);
 	for (cur = switch_hash_first(NULL, globals.peer_hash); cur; cur = switch_hash_next(cur)) {
 		switch_hash_this(cur, &key, &keylen, &value);
 		host = (char *) key;
 		last = (struct peer_status *) value;
 
-		stream->write_function(stream, "Peer %s %s; last seen %d seconds ago\n", host, last->active ? "UP" : "DOWN", now - last->lastseen);
+		stream->write_function(stream, "Peer %s %s; last seen %d seconds ago; received %" SWITCH_UINT64_T_FMT " duplicate %" SWITCH_UINT64_T_FMT
+							   " lost %" SWITCH_UINT64_T_FMT "\n", host, last->active ? "UP" : "DOWN", now - last->lastseen,
+							   last->received, last->duplicates, last->lost);
 		i++;
 	}
+	switch_mutex_unlock(globals.mutex);
 
 	if (i == 0) {
 		stream->write_function(stream, "No multicast peers seen\n");
 	}
 
+	switch_mutex_lock(globals.batch_mutex);
+	stream->write_function(stream, "Sent %" SWITCH_UINT64_T_FMT " events in %" SWITCH_UINT64_T_FMT " datagrams, %" SWITCH_UINT64_T_FMT
+						   " bytes of %" SWITCH_UINT64_T_FMT " before compression\n",
+						   globals.tx_events, globals.tx_datagrams, globals.tx_bytes, globals.tx_raw_bytes);
+	switch_mutex_unlock(globals.batch_mutex);
+
+	stream->write_function(stream, "Received %" SWITCH_UINT64_T_FMT " events in %" SWITCH_UINT64_T_FMT " datagrams, %" SWITCH_UINT64_T_FMT
+						   " duplicates, %" SWITCH_UINT64_T_FMT " bad datagrams\n",
+						   globals.rx_events, globals.rx_datagrams, globals.rx_duplicates, globals.rx_errors);
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_event_multicast_load)
 {
 	switch_api_interface_t *api_interface;
+	switch_threadattr_t *thd_attr = NULL;
 	switch_status_t status = SWITCH_STATUS_GENERR;
 
 	memset(&globals, 0, sizeof(globals));
 
 	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&globals.batch_mutex, SWITCH_MUTEX_NESTED, pool);
+	globals.batch = switch_core_alloc(pool, MULTICAST_BATCH_MAX);
 	module_pool = pool;
 
 	switch_core_hash_init(&globals.event_hash, module_pool);
@@ -437,6 +726,17 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_event_multicast_load)
 		switch_goto_status(SWITCH_STATUS_GENERR, fail);
 	}
 
+	/* the flusher is always started so batching can be turned on with a reloadxml */
+	globals.flushing = 1;
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	if (switch_thread_create(&globals.flush_thread, thd_attr, flush_thread_run, NULL, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't start the batch thread!\n");
+		globals.flushing = 0;
+		globals.flush_thread = NULL;
+		switch_goto_status(SWITCH_STATUS_GENERR, fail);
+	}
+
 	if (switch_event_bind(modname, SWITCH_EVENT_ALL, SWITCH_EVENT_SUBCLASS_ANY, event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, fail);
@@ -456,6 +756,12 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_event_multicast_load)
 
   fail:
 
+	if (globals.flush_thread) {
+		switch_status_t st;
+		globals.flushing = 0;
+		switch_thread_join(&st, globals.flush_thread);
+	}
+
 	if (globals.udp_socket) {
 		switch_socket_close(globals.udp_socket);
 	}
@@ -474,6 +780,17 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_event_multicast_shutdown)
 	globals.running = 0;
 	switch_event_unbind_callback(event_handler);
 
+	if (globals.flush_thread) {
+		switch_status_t st;
+		globals.flushing = 0;
+		switch_thread_join(&st, globals.flush_thread);
+		globals.flush_thread = NULL;
+	}
+
+	switch_mutex_lock(globals.batch_mutex);
+	batch_flush();
+	switch_mutex_unlock(globals.batch_mutex);
+
 	if (globals.udp_socket) {
 		switch_socket_shutdown(globals.udp_socket, 2);
 	}
@@ -483,6 +800,9 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_event_multicast_shutdown)
 	switch_event_free_subclass(MULTICAST_PEERDOWN);
 
 	switch_core_hash_destroy(&globals.event_hash);
+	if (globals.header_hash) {
+		switch_core_hash_destroy(&globals.header_hash);
+	}
 
 	switch_safe_free(globals.address);
 	switch_safe_free(globals.bindings);
@@ -490,10 +810,88 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_event_multicast_shutdown)
 	return SWITCH_STATUS_SUCCESS;
 }
 
-SWITCH_MODULE_RUNTIME_FUNCTION(mod_event_multicast_runtime)
+static void multicast_fire(char *packet)
 {
 	switch_event_t *local_event;
-	char *buf, *m;
+
+	/*switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "\nEVENT\n--------------------------------\n%s\n", packet); */
+	if (switch_event_create_subclass(&local_event, SWITCH_EVENT_CUSTOM, MULTICAST_EVENT) == SWITCH_STATUS_SUCCESS) {
+		char *var, *val, *term = NULL, tmpname[128];
+		char *sender, *seq;
+		switch_bool_t dup = SWITCH_FALSE;
+
+		switch_event_add_header_string(local_event, SWITCH_STACK_BOTTOM, "Multicast", "yes");
+		var = packet;
+		while (*var) {
+			if ((val = strchr(var, ':')) != 0) {
+				*val++ = '\0';
+				while (*val == ' ') {
+					val++;
+				}
+				if ((term = strchr(val, '\r')) != 0 || (term = strchr(val, '\n')) != 0) {
+					*term = '\0';
+					while (*term == '\r' || *term == '\n') {
+						term++;
+					}
+				}
+				switch_url_decode(val);
+				switch_snprintf(tmpname, sizeof(tmpname), "Orig-%s", var);
+				switch_event_add_header_string(local_event, SWITCH_STACK_BOTTOM, tmpname, val);
+				var = term + 1;
+			} else {
+				break;
+			}
+		}
+
+		if (var && strlen(var) > 1) {
+			switch_event_add_body(local_event, "%s", var);
+		}
+
+		/* peers that predate Multicast-Sequence are never treated as duplicates */
+		if ((sender = switch_event_get_header(local_event, "orig-multicast-sender")) &&
+			(seq = switch_event_get_header(local_event, "orig-multicast-sequence"))) {
+			uint32_t n = (uint32_t) strtoul(seq, NULL, 10);
+
+			if (n) {
+				switch_mutex_lock(globals.mutex);
+				dup = peer_duplicate(peer_get(sender), n);
+				switch_mutex_unlock(globals.mutex);
+			}
+		}
+
+		if (dup) {
+			globals.rx_duplicates++;
+			switch_event_destroy(&local_event);
+		} else {
+			globals.rx_events++;
+			switch_event_fire(&local_event);
+		}
+	}
+}
+
+/* A datagram holds one or more events, each followed by MAGIC */
+static void multicast_receive(char *packet)
+{
+	size_t mlen = strlen((char *) MAGIC);
+	char *m;
+	int n = 0;
+
+	while ((m = strstr(packet, (char *) MAGIC))) {
+		*m = '\0';
+		multicast_fire(packet);
+		packet = m + mlen;
+		n++;
+	}
+
+	if (!n) {
+		globals.rx_errors++;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Failed to find magic string\n");
+	}
+}
+
+SWITCH_MODULE_RUNTIME_FUNCTION(mod_event_multicast_runtime)
+{
+	char *buf;
 	switch_sockaddr_t *addr;
 
 	buf = (char *) malloc(MULTICAST_BUFFSIZE);
@@ -502,10 +900,11 @@ SWITCH_MODULE_RUNTIME_FUNCTION(mod_event_multicast_runtime)
 	globals.running = 1;
 	while (globals.running == 1) {
 		char *myaddr;
-		size_t len = MULTICAST_BUFFSIZE;
+		size_t len = MULTICAST_BUFFSIZE - 1;
 		char *packet;
+		char *tmp = NULL, *zbuf = NULL;
 		switch_status_t status;
-		memset(buf, 0, len);
+		memset(buf, 0, MULTICAST_BUFFSIZE);
 
 		switch_sockaddr_ip_get(&myaddr, globals.addr);
 		if ((status = switch_socket_recvfrom(addr, globals.udp_socket, 0, buf, &len)) != SWITCH_STATUS_SUCCESS || !len || !globals.running) {
@@ -522,22 +921,27 @@ SWITCH_MODULE_RUNTIME_FUNCTION(mod_event_multicast_runtime)
 		}
 #endif
 
+		globals.rx_datagrams++;
 		packet = buf;
 
 #ifdef HAVE_OPENSSL
 		if (globals.psk) {
 			char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
-			char *tmp;
 			int outl, tmplen;
 			EVP_CIPHER_CTX ctx;
 
+			if (len <= SWITCH_UUID_FORMATTED_LENGTH) {
+				globals.rx_errors++;
+				continue;
+			}
+
 			len -= SWITCH_UUID_FORMATTED_LENGTH;
 
-			tmp = malloc(len);
+			tmp = malloc(len + 1);
 
-			memset(tmp, 0, len);
+			memset(tmp, 0, len + 1);
 
-			switch_copy_string(uuid_str, packet, SWITCH_UUID_FORMATTED_LENGTH);
+			switch_copy_string(uuid_str, packet, SWITCH_UUID_FORMATTED_LENGTH + 1);
 			packet += SWITCH_UUID_FORMATTED_LENGTH;
 
 			EVP_CIPHER_CTX_init(&ctx);
@@ -545,63 +949,51 @@ SWITCH_MODULE_RUNTIME_FUNCTION(mod_event_multicast_runtime)
 			EVP_CIPHER_CTX_set_key_length(&ctx, strlen(globals.psk));
 			EVP_DecryptInit(&ctx, NULL, (unsigned char *) globals.psk, (unsigned char *) uuid_str);
 			EVP_DecryptUpdate(&ctx, (unsigned char *) tmp, &outl, (unsigned char *) packet, (int) len);
-			EVP_DecryptFinal(&ctx, (unsigned char *) tmp + outl, &tmplen);
+			if (!EVP_DecryptFinal(&ctx, (unsigned char *) tmp + outl, &tmplen)) {
+				tmplen = 0;
+			}
+			EVP_CIPHER_CTX_cleanup(&ctx);
 
 			*(tmp + outl + tmplen) = '\0';
+			len = (size_t) (outl + tmplen);
 
 			/*switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "decrypted event as %s\n----------\n of actual length %d (%d) %d\n", tmp, outl + tmplen, (int) len, (int) strlen(tmp)); */
 			packet = tmp;
 
 		}
 #endif
-		if ((m = strchr(packet, (int) MAGIC[0])) != 0) {
-			/*switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Found start of magic string\n"); */
-			if (!strncmp((char *) MAGIC, m, strlen((char *) MAGIC))) {
-				/*switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Found entire magic string\n"); */
-				*m = '\0';
-			} else {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Failed to find entire magic string\n");
-				continue;
-			}
-		} else {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Failed to find start of magic string\n");
-			continue;
-		}
 
-		/*switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "\nEVENT %d\n--------------------------------\n%s\n", (int) len, packet); */
-		if (switch_event_create_subclass(&local_event, SWITCH_EVENT_CUSTOM, MULTICAST_EVENT) == SWITCH_STATUS_SUCCESS) {
-			char *var, *val, *term = NULL, tmpname[128];
-			switch_event_add_header_string(local_event, SWITCH_STACK_BOTTOM, "Multicast", "yes");
-			var = packet;
-			while (*var) {
-				if ((val = strchr(var, ':')) != 0) {
-					*val++ = '\0';
-					while (*val == ' ') {
-						val++;
-					}
-					if ((term = strchr(val, '\r')) != 0 || (term = strchr(val, '\n')) != 0) {
-						*term = '\0';
-						while (*term == '\r' || *term == '\n') {
-							term++;
-						}
-					}
-					switch_url_decode(val);
-					switch_snprintf(tmpname, sizeof(tmpname), "Orig-%s", var);
-					switch_event_add_header_string(local_event, SWITCH_STACK_BOTTOM, tmpname, val);
-					var = term + 1;
-				} else {
-					break;
-				}
-			}
+		if (len > MULTICAST_ZHEADER && packet[0] == '\0' && packet[1] == 'Z') {
+			uint32_t raw;
+			uLongf zlen;
 
-			if (var && strlen(var) > 1) {
-				switch_event_add_body(local_event, "%s", var);
+			memcpy(&raw, packet + 2, sizeof(raw));
+			zlen = raw = ntohl(raw);
+
+			if (!raw || raw > MULTICAST_ZMAX) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Bad compressed length %u\n", raw);
+				globals.rx_errors++;
+				goto next;
 			}
 
-			switch_event_fire(&local_event);
+			zbuf = malloc(raw + 1);
+			switch_assert(zbuf);
 
+			if (uncompress((Bytef *) zbuf, &zlen, (const Bytef *) packet + MULTICAST_ZHEADER, (uLong) (len - MULTICAST_ZHEADER)) != Z_OK) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Failed to decompress datagram\n");
+				globals.rx_errors++;
+				goto next;
+			}
+
+			zbuf[zlen] = '\0';
+			packet = zbuf;
 		}
 
+		multicast_receive(packet);
+
+	  next:
+		switch_safe_free(tmp);
+		switch_safe_free(zbuf);
 	}
 
 
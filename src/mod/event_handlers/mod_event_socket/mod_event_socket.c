@@ -30,9 +30,16 @@
  *
  */
 #include <switch.h>
+#if defined(__linux__)
+#include <sys/epoll.h>
+#define LISTENER_IO
+#endif
 #define CMD_BUFLEN 1024 * 1000
 #define MAX_QUEUE_LEN 25000
 #define MAX_MISSED 500
+#define IO_THREADS_MAX 16
+#define EVENT_BATCH_MAX 16
+#define MY_EVENT_BACKPRESSURE "event_socket::backpressure"
 SWITCH_MODULE_LOAD_FUNCTION(mod_event_socket_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_event_socket_shutdown);
 SWITCH_MODULE_RUNTIME_FUNCTION(mod_event_socket_runtime);
@@ -57,13 +64,16 @@ typedef enum {
 	LFLAG_RESUME = (1 << 13),
 	LFLAG_AUTH_EVENTS = (1 << 14),
 	LFLAG_ALL_EVENTS_AUTHED = (1 << 15),
-	LFLAG_ALLOW_LOG = (1 << 16)
+	LFLAG_ALLOW_LOG = (1 << 16),
+	LFLAG_QUEUE_HIGH = (1 << 17),
+	LFLAG_DEGRADE = (1 << 18)
 } event_flag_t;
 
 typedef enum {
 	EVENT_FORMAT_PLAIN,
 	EVENT_FORMAT_XML,
-	EVENT_FORMAT_JSON
+	EVENT_FORMAT_JSON,
+	EVENT_FORMAT_BINARY
 } event_format_t;
 
 struct listener {
@@ -76,7 +86,6 @@ struct listener {
 	switch_mutex_t *filter_mutex;
 	uint32_t flags;
 	switch_log_level_t level;
-	char *ebuf;
 	uint8_t event_list[SWITCH_EVENT_ALL + 1];
 	uint8_t allowed_event_list[SWITCH_EVENT_ALL + 1];
 	switch_hash_t *event_hash;
@@ -94,18 +103,65 @@ struct listener {
 	char remote_ip[50];
 	switch_port_t remote_port;
 	switch_event_t *filters;
+	struct event_filter *compiled_filters;
+	uint32_t binary_names_sent;
 	time_t linger_timeout;
+	/* event queue depth that raises and clears LFLAG_QUEUE_HIGH, 0 disables */
+	uint32_t queue_high;
+	uint32_t queue_low;
+	/* set when an io thread watches the socket so the listener can sleep instead of polling */
+	struct listener_io_handle *io_handle;
+	switch_mutex_t *io_mutex;
+	switch_thread_cond_t *io_cond;
+	int io_ready;
 	struct listener *next;
 };
 
 typedef struct listener listener_t;
 
+/* one entry of listener->filters, parsed once when the filter list changes */
+typedef struct event_filter {
+	char *name;
+	char *comp_to;
+	int pos;
+	int regex;
+	switch_regex_t *re;
+	struct event_filter *next;
+} event_filter_t;
+
+#define SHARED_EVENT_LOCKS 16
+#define BINARY_NAMES_MAX 4096
+
 static struct {
 	switch_mutex_t *listener_mutex;
+	switch_mutex_t *shared_event_mutex[SHARED_EVENT_LOCKS];
+	/* header names interned for the binary format, ids are never reused so every connection can share them */
+	switch_mutex_t *binary_mutex;
+	switch_hash_t *binary_hash;
+	switch_memory_pool_t *binary_pool;
+	char *binary_names[BINARY_NAMES_MAX];
+	uint32_t binary_name_count;
 	switch_event_node_t *node;
 	int debug;
 } globals;
 
+/* 
+ * One copy of an event shared by every listener it is queued to.  The event is never
+ * modified once shared and each wire format is rendered the first time a listener asks
+ * for it, then reused by the rest.
+ */
+typedef struct shared_event {
+	switch_event_t *event;
+	uint32_t refs;
+	char *plain;
+	char *json;
+	char *xml;
+	char *binary;
+	switch_size_t binary_len;
+	/* the binary rendering refers to interned names below this id */
+	uint32_t binary_names;
+} shared_event_t;
+
 static struct {
 	switch_socket_t *sock;
 	switch_mutex_t *sock_mutex;
@@ -126,6 +182,10 @@ static struct {
 	uint32_t acl_count;
 	uint32_t id;
 	int nat_map;
+	uint32_t io_threads;
+	uint32_t queue_high;
+	uint32_t queue_low;
+	int queue_degrade;
 } prefs;
 
 
@@ -138,6 +198,8 @@ static const char *format2str(event_format_t format)
 		return "xml";
 	case EVENT_FORMAT_JSON:
 		return "json";
+	case EVENT_FORMAT_BINARY:
+		return "binary";
 	}
 
 	return "invalid";
@@ -147,6 +209,694 @@ static void remove_listener(listener_t *listener);
 static void kill_listener(listener_t *l, const char *message);
 static void kill_all_listeners(void);
 
+static void free_compiled_filters(listener_t *l)
+{
+	event_filter_t *fp;
+
+	while ((fp = l->compiled_filters)) {
+		l->compiled_filters = fp->next;
+		switch_regex_safe_free(fp->re);
+		switch_safe_free(fp->name);
+		switch_safe_free(fp->comp_to);
+		free(fp);
+	}
+}
+
+/* call with filter_mutex held after every change to l->filters */
+static void compile_filters(listener_t *l)
+{
+	event_filter_t *fp, *last = NULL;
+	switch_event_header_t *hp;
+
+	free_compiled_filters(l);
+
+	if (!l->filters) {
+		return;
+	}
+
+	for (hp = l->filters->headers; hp; hp = hp->next) {
+		const char *comp_to = hp->value;
+		int pos = 1;
+
+		while (comp_to && *comp_to) {
+			if (*comp_to == '+') {
+				pos = 1;
+			} else if (*comp_to == '-') {
+				pos = 0;
+			} else if (*comp_to != ' ') {
+				break;
+			}
+			comp_to++;
+		}
+
+		switch_zmalloc(fp, sizeof(*fp));
+		fp->name = strdup(hp->name);
+		fp->comp_to = comp_to ? strdup(comp_to) : NULL;
+		fp->pos = pos;
+
+		if (hp->value && *hp->value == '/') {
+			fp->regex = 1;
+			fp->re = switch_regex_compile_expression(comp_to);
+		}
+
+		if (last) {
+			last->next = fp;
+		} else {
+			l->compiled_filters = fp;
+		}
+		last = fp;
+	}
+}
+
+static int filters_match(listener_t *l, switch_event_t *event)
+{
+	event_filter_t *fp;
+	const char *hval;
+	int send = 0;
+
+	for (fp = l->compiled_filters; fp; fp = fp->next) {
+		int cmp = 0;
+
+		if (send && fp->pos) {
+			continue;
+		}
+
+		if (!fp->comp_to) {
+			continue;
+		}
+
+		if (!(hval = switch_event_get_header(event, fp->name))) {
+			continue;
+		}
+
+		if (fp->regex) {
+			int ovector[30];
+			cmp = !!switch_regex_exec(fp->re, hval, ovector, sizeof(ovector) / sizeof(ovector[0]));
+		} else {
+			cmp = !strcasecmp(hval, fp->comp_to);
+		}
+
+		if (cmp) {
+			if (fp->pos) {
+				send = 1;
+			} else {
+				send = 0;
+				break;
+			}
+		}
+	}
+
+	return send;
+}
+
+static switch_mutex_t *shared_event_mutex(shared_event_t *sevent)
+{
+	return globals.shared_event_mutex[((uintptr_t) sevent >> 6) % SHARED_EVENT_LOCKS];
+}
+
+static shared_event_t *shared_event_create(switch_event_t **event)
+{
+	shared_event_t *sevent;
+
+	switch_zmalloc(sevent, sizeof(*sevent));
+	sevent->event = *event;
+	sevent->refs = 1;
+	*event = NULL;
+
+	return sevent;
+}
+
+static void shared_event_ref(shared_event_t *sevent)
+{
+	switch_mutex_t *mutex = shared_event_mutex(sevent);
+
+	switch_mutex_lock(mutex);
+	sevent->refs++;
+	switch_mutex_unlock(mutex);
+}
+
+static void shared_event_release(shared_event_t **sevent)
+{
+	shared_event_t *se = *sevent;
+	switch_mutex_t *mutex;
+	uint32_t refs;
+
+	*sevent = NULL;
+
+	if (!se) {
+		return;
+	}
+
+	mutex = shared_event_mutex(se);
+	switch_mutex_lock(mutex);
+	refs = --se->refs;
+	switch_mutex_unlock(mutex);
+
+	if (refs) {
+		return;
+	}
+
+	if (se->event) {
+		switch_event_destroy(&se->event);
+	}
+
+	switch_safe_free(se->plain);
+	switch_safe_free(se->json);
+	switch_safe_free(se->xml);
+	switch_safe_free(se->binary);
+	free(se);
+}
+
+/* 
+ * The binary format is a series of records, all integers in network byte order:
+ *   'N' uint16 id, uint16 len, name   defines an interned header name for the rest of the connection
+ *   'H' uint16 id, uint32 len, value  a header using an interned name
+ *   'I' uint16 len, name, uint32 len, value  a header with an inline name once the intern table is full
+ *   'B' uint32 len, body
+ */
+typedef struct binary_buf {
+	char *data;
+	switch_size_t len;
+	switch_size_t size;
+} binary_buf_t;
+
+static void binary_put(binary_buf_t *bb, const void *data, switch_size_t len)
+{
+	if (bb->len + len > bb->size) {
+		char *tmp;
+
+		while (bb->len + len > bb->size) {
+			bb->size = bb->size ? bb->size * 2 : 1024;
+		}
+
+		tmp = realloc(bb->data, bb->size);
+		switch_assert(tmp);
+		bb->data = tmp;
+	}
+
+	memcpy(bb->data + bb->len, data, len);
+	bb->len += len;
+}
+
+static void binary_put_u16(binary_buf_t *bb, uint16_t v)
+{
+	v = htons(v);
+	binary_put(bb, &v, sizeof(v));
+}
+
+static void binary_put_u32(binary_buf_t *bb, uint32_t v)
+{
+	v = htonl(v);
+	binary_put(bb, &v, sizeof(v));
+}
+
+static int binary_name_id(const char *name)
+{
+	void *val;
+	int id = -1;
+
+	switch_mutex_lock(globals.binary_mutex);
+	if ((val = switch_core_hash_find(globals.binary_hash, name))) {
+		id = (int) (intptr_t) val - 1;
+	} else if (globals.binary_name_count < BINARY_NAMES_MAX) {
+		id = globals.binary_name_count;
+		globals.binary_names[id] = switch_core_strdup(globals.binary_pool, name);
+		switch_core_hash_insert(globals.binary_hash, globals.binary_names[id], (void *) (intptr_t) (id + 1));
+		globals.binary_name_count++;
+	}
+	switch_mutex_unlock(globals.binary_mutex);
+
+	return id;
+}
+
+/* call with the shared event mutex held */
+static void shared_event_render_binary(shared_event_t *sevent)
+{
+	binary_buf_t bb = { 0 };
+	switch_event_header_t *hp;
+	uint32_t max = 0;
+	char type;
+
+	switch_event_expand_snapshot(sevent->event);
+
+	for (hp = sevent->event->headers; hp; hp = hp->next) {
+		uint32_t vlen = (uint32_t) strlen(hp->value);
+		int id = binary_name_id(hp->name);
+
+		if (id >= 0) {
+			type = 'H';
+			binary_put(&bb, &type, 1);
+			binary_put_u16(&bb, (uint16_t) id);
+			if ((uint32_t) id >= max) {
+				max = id + 1;
+			}
+		} else {
+			uint16_t nlen = (uint16_t) strlen(hp->name);
+
+			type = 'I';
+			binary_put(&bb, &type, 1);
+			binary_put_u16(&bb, nlen);
+			binary_put(&bb, hp->name, nlen);
+		}
+
+		binary_put_u32(&bb, vlen);
+		binary_put(&bb, hp->value, vlen);
+	}
+
+	if (sevent->event->body) {
+		uint32_t blen = (uint32_t) strlen(sevent->event->body);
+
+		type = 'B';
+		binary_put(&bb, &type, 1);
+		binary_put_u32(&bb, blen);
+		binary_put(&bb, sevent->event->body, blen);
+	}
+
+	if (!bb.data) {
+		type = 'B';
+		binary_put(&bb, &type, 1);
+		binary_put_u32(&bb, 0);
+	}
+
+	sevent->binary = bb.data;
+	sevent->binary_len = bb.len;
+	sevent->binary_names = max;
+}
+
+/* the names this connection has not seen yet, up to the ones the event needs */
+static char *binary_name_defs(listener_t *listener, uint32_t upto, switch_size_t *len)
+{
+	binary_buf_t bb = { 0 };
+	char type = 'N';
+	uint32_t id;
+
+	switch_mutex_lock(globals.binary_mutex);
+	for (id = listener->binary_names_sent; id < upto; id++) {
+		uint16_t nlen = (uint16_t) strlen(globals.binary_names[id]);
+
+		binary_put(&bb, &type, 1);
+		binary_put_u16(&bb, (uint16_t) id);
+		binary_put_u16(&bb, nlen);
+		binary_put(&bb, globals.binary_names[id], nlen);
+	}
+	switch_mutex_unlock(globals.binary_mutex);
+
+	if (upto > listener->binary_names_sent) {
+		listener->binary_names_sent = upto;
+	}
+
+	*len = bb.len;
+	return bb.data;
+}
+
+static const char *shared_event_render(shared_event_t *sevent, event_format_t format)
+{
+	switch_mutex_t *mutex = shared_event_mutex(sevent);
+	char *r = NULL;
+
+	switch_mutex_lock(mutex);
+
+	switch (format) {
+	case EVENT_FORMAT_PLAIN:
+		if (!sevent->plain) {
+			switch_event_serialize(sevent->event, &sevent->plain, SWITCH_TRUE);
+		}
+		r = sevent->plain;
+		break;
+	case EVENT_FORMAT_JSON:
+		if (!sevent->json) {
+			switch_event_serialize_json(sevent->event, &sevent->json);
+		}
+		r = sevent->json;
+		break;
+	case EVENT_FORMAT_BINARY:
+		if (!sevent->binary) {
+			shared_event_render_binary(sevent);
+		}
+		r = sevent->binary;
+		break;
+	default:
+		if (!sevent->xml) {
+			switch_xml_t xml;
+
+			if ((xml = switch_event_xmlize(sevent->event, SWITCH_VA_NONE))) {
+				sevent->xml = switch_xml_toxml(xml, SWITCH_FALSE);
+				switch_xml_free(xml);
+			}
+		}
+		r = sevent->xml;
+		break;
+	}
+
+	switch_mutex_unlock(mutex);
+
+	return r;
+}
+
+/* a copy for congested listeners that asked to be degraded, without the channel variables */
+static shared_event_t *shared_event_create_degraded(switch_event_t *event)
+{
+	switch_event_header_t *hp, *prev = NULL;
+	switch_event_t *clone = NULL;
+
+	if (switch_event_dup(&clone, event) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	switch_event_expand_snapshot(clone);
+
+	for (hp = clone->headers; hp;) {
+		if (!strncmp(hp->name, "variable_", 9)) {
+			char *name = strdup(hp->name);
+
+			switch_assert(name);
+			switch_event_del_header(clone, name);
+			free(name);
+			hp = prev ? prev->next : clone->headers;
+		} else {
+			prev = hp;
+			hp = hp->next;
+		}
+	}
+
+	return shared_event_create(&clone);
+}
+
+static void fire_backpressure_event(listener_t *listener, const char *state, uint32_t depth)
+{
+	switch_event_t *event;
+
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(listener->session), SWITCH_LOG_WARNING, "Listener %u event queue %s water mark, %u queued%s\n",
+					  listener->id, state, depth, switch_test_flag(listener, LFLAG_DEGRADE) && !strcmp(state, "high") ? ", dropping channel variables" : "");
+
+	if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, MY_EVENT_BACKPRESSURE) == SWITCH_STATUS_SUCCESS) {
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Listener-ID", "%u", listener->id);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Remote-IP", listener->remote_ip);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Remote-Port", "%d", (int) listener->remote_port);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Water-Mark", state);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Queue-Depth", "%u", depth);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Queue-High", "%u", listener->queue_high);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Queue-Low", "%u", listener->queue_low);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Degrade", switch_test_flag(listener, LFLAG_DEGRADE) ? "true" : "false");
+		if (listener->session) {
+			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Unique-ID", switch_core_session_get_uuid(listener->session));
+		}
+		switch_event_fire(&event);
+	}
+}
+
+/* call after the consumer has drained the queue */
+static void check_low_water(listener_t *listener)
+{
+	uint32_t depth;
+
+	if (!switch_test_flag(listener, LFLAG_QUEUE_HIGH)) {
+		return;
+	}
+
+	if ((depth = switch_queue_size(listener->event_queue)) <= listener->queue_low) {
+		switch_clear_flag_locked(listener, LFLAG_QUEUE_HIGH);
+		fire_backpressure_event(listener, "low", depth);
+	}
+}
+
+static void listener_set_watermarks(listener_t *listener, uint32_t high, uint32_t low, int degrade)
+{
+	if (low >= high) {
+		low = high / 2;
+	}
+
+	listener->queue_high = high;
+	listener->queue_low = low;
+
+	if (degrade) {
+		switch_set_flag_locked(listener, LFLAG_DEGRADE);
+	} else {
+		switch_clear_flag_locked(listener, LFLAG_DEGRADE);
+	}
+
+	if (!high) {
+		switch_clear_flag_locked(listener, LFLAG_QUEUE_HIGH);
+	}
+}
+
+/* 
+ * Listener io threads: a few threads watch every listener socket with epoll.  When data
+ * arrives, or an event or log line is queued, the listener thread is woken from its
+ * condition instead of spinning on a non-blocking recv.  Sockets are armed one shot and
+ * re-armed by the listener each time it goes back to sleep.
+ */
+typedef struct listener_io_thread {
+	int epfd;
+	switch_mutex_t *mutex;
+	switch_thread_t *thread;
+	struct listener_io_handle *dead;
+} listener_io_thread_t;
+
+typedef struct listener_io_handle {
+	listener_t *listener;
+	listener_io_thread_t *io;
+	int fd;
+	int armed;
+	int dead;
+	struct listener_io_handle *next;
+} listener_io_handle_t;
+
+static struct {
+	listener_io_thread_t threads[IO_THREADS_MAX];
+	uint32_t count;
+	uint32_t next;
+	int running;
+} io_globals;
+
+static void listener_wake(listener_t *listener)
+{
+	if (!listener->io_mutex) {
+		return;
+	}
+
+	switch_mutex_lock(listener->io_mutex);
+	listener->io_ready = 1;
+	switch_thread_cond_signal(listener->io_cond);
+	switch_mutex_unlock(listener->io_mutex);
+}
+
+#ifdef LISTENER_IO
+static void *SWITCH_THREAD_FUNC listener_io_thread_run(switch_thread_t *thread, void *obj)
+{
+	listener_io_thread_t *io = (listener_io_thread_t *) obj;
+	struct epoll_event events[128];
+	listener_io_handle_t *handle;
+	int n, i;
+
+	while (io_globals.running) {
+		n = epoll_wait(io->epfd, events, sizeof(events) / sizeof(events[0]), 100);
+
+		if (n < 0 && errno != EINTR) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Listener io thread epoll_wait failed: %s\n", strerror(errno));
+			switch_yield(100000);
+		}
+
+		switch_mutex_lock(io->mutex);
+
+		for (i = 0; i < n; i++) {
+			handle = (listener_io_handle_t *) events[i].data.ptr;
+
+			if (!handle->dead) {
+				handle->armed = 0;
+				listener_wake(handle->listener);
+			}
+		}
+
+		/* anything detached before we took the lock can no longer show up in epoll_wait() */
+		while ((handle = io->dead)) {
+			io->dead = handle->next;
+			free(handle);
+		}
+
+		switch_mutex_unlock(io->mutex);
+	}
+
+	return NULL;
+}
+
+static void listener_io_start(switch_memory_pool_t *pool)
+{
+	uint32_t i;
+
+	if (!prefs.io_threads) {
+		return;
+	}
+
+	if (prefs.io_threads > IO_THREADS_MAX) {
+		prefs.io_threads = IO_THREADS_MAX;
+	}
+
+	io_globals.running = 1;
+
+	for (i = 0; i < prefs.io_threads; i++) {
+		listener_io_thread_t *io = &io_globals.threads[io_globals.count];
+		switch_threadattr_t *thd_attr = NULL;
+
+		if ((io->epfd = epoll_create(1024)) < 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot create listener epoll set: %s\n", strerror(errno));
+			break;
+		}
+
+		switch_mutex_init(&io->mutex, SWITCH_MUTEX_NESTED, pool);
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&io->thread, thd_attr, listener_io_thread_run, io, pool);
+		io_globals.count++;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Started %u listener io thread(s)\n", io_globals.count);
+}
+
+static void listener_io_stop(void)
+{
+	listener_io_handle_t *handle;
+	switch_status_t st;
+	uint32_t i;
+
+	if (!io_globals.count) {
+		return;
+	}
+
+	io_globals.running = 0;
+
+	for (i = 0; i < io_globals.count; i++) {
+		listener_io_thread_t *io = &io_globals.threads[i];
+
+		switch_thread_join(&st, io->thread);
+		close(io->epfd);
+
+		while ((handle = io->dead)) {
+			io->dead = handle->next;
+			free(handle);
+		}
+	}
+
+	io_globals.count = 0;
+}
+
+/* the socket may have been closed under us by kill_listener, never touch an fd number that is no longer ours */
+static int listener_io_fd_valid(listener_t *listener, listener_io_handle_t *handle)
+{
+	return listener->sock && switch_socket_fd_get(listener->sock) == handle->fd;
+}
+
+static void listener_io_attach(listener_t *listener)
+{
+	listener_io_handle_t *handle;
+	listener_io_thread_t *io;
+	int fd;
+
+	if (!io_globals.count || !listener->sock || (fd = switch_socket_fd_get(listener->sock)) < 0) {
+		return;
+	}
+
+	if (!listener->io_mutex) {
+		switch_mutex_init(&listener->io_mutex, SWITCH_MUTEX_NESTED, listener->pool);
+		switch_thread_cond_create(&listener->io_cond, listener->pool);
+	}
+
+	switch_mutex_lock(globals.listener_mutex);
+	io = &io_globals.threads[io_globals.next++ % io_globals.count];
+	switch_mutex_unlock(globals.listener_mutex);
+
+	switch_zmalloc(handle, sizeof(*handle));
+	handle->listener = listener;
+	handle->io = io;
+	handle->fd = fd;
+
+	listener->io_handle = handle;
+}
+
+static void listener_io_detach(listener_t *listener)
+{
+	listener_io_handle_t *handle;
+	listener_io_thread_t *io;
+
+	if (!(handle = listener->io_handle)) {
+		return;
+	}
+
+	io = handle->io;
+
+	switch_mutex_lock(io->mutex);
+	if (listener_io_fd_valid(listener, handle)) {
+		epoll_ctl(io->epfd, EPOLL_CTL_DEL, handle->fd, NULL);
+	}
+	handle->dead = 1;
+	handle->next = io->dead;
+	io->dead = handle;
+	switch_mutex_unlock(io->mutex);
+
+	listener->io_handle = NULL;
+}
+
+/* sleep until the socket is readable, something was queued for us or the timeout passes */
+static void listener_io_wait(listener_t *listener, uint32_t ms)
+{
+	listener_io_handle_t *handle = listener->io_handle;
+	listener_io_thread_t *io = handle->io;
+
+	switch_mutex_lock(listener->io_mutex);
+
+	if (!listener->io_ready) {
+		switch_mutex_lock(io->mutex);
+		if (!handle->armed && listener_io_fd_valid(listener, handle)) {
+			struct epoll_event ev = { 0 };
+
+			ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+			ev.data.ptr = handle;
+
+			if (epoll_ctl(io->epfd, EPOLL_CTL_MOD, handle->fd, &ev) == 0 || epoll_ctl(io->epfd, EPOLL_CTL_ADD, handle->fd, &ev) == 0) {
+				handle->armed = 1;
+			}
+		}
+		switch_mutex_unlock(io->mutex);
+
+		if (handle->armed) {
+			switch_thread_cond_timedwait(listener->io_cond, listener->io_mutex, ms * 1000);
+		}
+	}
+
+	listener->io_ready = 0;
+	switch_mutex_unlock(listener->io_mutex);
+
+	if (!handle->armed) {
+		switch_cond_next();
+	}
+}
+#else
+static void listener_io_start(switch_memory_pool_t *pool)
+{
+	if (prefs.io_threads) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "io-threads needs epoll, ignoring\n");
+		prefs.io_threads = 0;
+	}
+}
+
+static void listener_io_stop(void)
+{
+}
+
+static void listener_io_attach(listener_t *listener)
+{
+}
+
+static void listener_io_detach(listener_t *listener)
+{
+}
+
+static void listener_io_wait(listener_t *listener, uint32_t ms)
+{
+	switch_cond_next();
+}
+#endif
+
 static uint32_t next_id(void)
 {
 	uint32_t id;
@@ -172,6 +922,7 @@ static switch_status_t socket_logger(const switch_log_node_t *node, switch_log_l
 			switch_log_node_t *dnode = switch_log_node_dup(node);
 
 			if (switch_queue_trypush(l->log_queue, dnode) == SWITCH_STATUS_SUCCESS) {
+				listener_wake(l);
 				if (l->lost_logs) {
 					int ll = l->lost_logs;
 					switch_event_t *event;
@@ -210,10 +961,10 @@ static void flush_listener(listener_t *listener, switch_bool_t flush_log, switch
 
 	if (listener->event_queue) {
 		while (switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
-			switch_event_t *pevent = (switch_event_t *) pop;
+			shared_event_t *sevent = (shared_event_t *) pop;
 			if (!pop)
 				continue;
-			switch_event_destroy(&pevent);
+			shared_event_release(&sevent);
 		}
 	}
 }
@@ -252,6 +1003,7 @@ static switch_status_t expire_listener(listener_t ** listener)
 	if (l->filters) {
 		switch_event_destroy(&l->filters);
 	}
+	free_compiled_filters(l);
 
 	switch_mutex_unlock(l->filter_mutex);
 	switch_thread_rwlock_unlock(l->rwlock);
@@ -264,6 +1016,7 @@ static switch_status_t expire_listener(listener_t ** listener)
 static void event_handler(switch_event_t *event)
 {
 	switch_event_t *clone = NULL;
+	shared_event_t *shared = NULL, *degraded = NULL, *sevent;
 	listener_t *l, *lp, *last = NULL;
 	time_t now = switch_epoch_time_now(NULL);
 
@@ -309,55 +1062,8 @@ static void event_handler(switch_event_t *event)
 		if (send) {
 			switch_mutex_lock(l->filter_mutex);
 
-			if (l->filters && l->filters->headers) {
-				switch_event_header_t *hp;
-				const char *hval;
-
-				send = 0;
-				
-				for (hp = l->filters->headers; hp; hp = hp->next) {
-					if ((hval = switch_event_get_header(event, hp->name))) {
-						const char *comp_to = hp->value;
-						int pos = 1, cmp = 0;
-
-						while (comp_to && *comp_to) {
-							if (*comp_to == '+') {
-								pos = 1;
-							} else if (*comp_to == '-') {
-								pos = 0;
-							} else if (*comp_to != ' ') {
-								break;
-							}
-							comp_to++;
-						}
-
-						if (send && pos) {
-							continue;
-						}
-
-						if (!comp_to) {
-							continue;
-						}
-
-						if (*hp->value == '/') {
-							switch_regex_t *re = NULL;
-							int ovector[30];
-							cmp = !!switch_regex_perform(hval, comp_to, &re, ovector, sizeof(ovector) / sizeof(ovector[0]));
-							switch_regex_safe_free(re);
-						} else {
-							cmp = !strcasecmp(hval, comp_to);
-						}
-
-						if (cmp) {
-							if (pos) {
-								send = 1;
-							} else {
-								send = 0;
-								break;
-							}
-						}
-					}
-				}
+			if (l->compiled_filters) {
+				send = filters_match(l, event);
 			}
 
 			switch_mutex_unlock(l->filter_mutex);
@@ -370,9 +1076,31 @@ static void event_handler(switch_event_t *event)
 			}
 		}
 
+		if (send && switch_test_flag(l, LFLAG_QUEUE_HIGH) && switch_test_flag(l, LFLAG_DEGRADE)) {
+			if (!degraded) {
+				degraded = shared_event_create_degraded(event);
+			}
+			sevent = degraded;
+		} else if (send) {
+			if (!shared && switch_event_dup(&clone, event) == SWITCH_STATUS_SUCCESS) {
+				shared = shared_event_create(&clone);
+			}
+			sevent = shared;
+		}
+
 		if (send) {
-			if (switch_event_dup(&clone, event) == SWITCH_STATUS_SUCCESS) {
-				if (switch_queue_trypush(l->event_queue, clone) == SWITCH_STATUS_SUCCESS) {
+			if (sevent) {
+				shared_event_ref(sevent);
+				if (switch_queue_trypush(l->event_queue, sevent) == SWITCH_STATUS_SUCCESS) {
+					listener_wake(l);
+					if (l->queue_high && !switch_test_flag(l, LFLAG_QUEUE_HIGH)) {
+						uint32_t depth = switch_queue_size(l->event_queue);
+
+						if (depth >= l->queue_high) {
+							switch_set_flag_locked(l, LFLAG_QUEUE_HIGH);
+							fire_backpressure_event(l, "high", depth);
+						}
+					}
 					if (l->lost_events) {
 						int le = l->lost_events;
 						l->lost_events = 0;
@@ -387,7 +1115,7 @@ static void event_handler(switch_event_t *event)
 					if (++l->lost_events > MAX_MISSED) {
 						kill_listener(l, NULL);
 					}
-					switch_event_destroy(&clone);
+					shared_event_release(&sevent);
 				}
 			} else {
 				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(l->session), SWITCH_LOG_ERROR, "Memory Error!\n");
@@ -396,6 +1124,9 @@ static void event_handler(switch_event_t *event)
 		last = l;
 	}
 	switch_mutex_unlock(globals.listener_mutex);
+
+	shared_event_release(&shared);
+	shared_event_release(&degraded);
 }
 
 SWITCH_STANDARD_APP(socket_function)
@@ -477,6 +1208,7 @@ SWITCH_STANDARD_APP(socket_function)
 
 	switch_mutex_init(&listener->flag_mutex, SWITCH_MUTEX_NESTED, listener->pool);
 	switch_mutex_init(&listener->filter_mutex, SWITCH_MUTEX_NESTED, listener->pool);
+	listener_set_watermarks(listener, prefs.queue_high, prefs.queue_low, prefs.queue_degrade);
 
 	switch_core_hash_init(&listener->event_hash, listener->pool);
 	switch_set_flag(listener, LFLAG_AUTHED);
@@ -551,6 +1283,9 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_event_socket_shutdown)
 	}
 
 	switch_event_unbind(&globals.node);
+	switch_event_free_subclass(MY_EVENT_BACKPRESSURE);
+
+	listener_io_stop();
 
 	switch_safe_free(prefs.ip);
 	switch_safe_free(prefs.password);
@@ -625,6 +1360,7 @@ static void kill_listener(listener_t *l, const char *message)
 		switch_socket_shutdown(l->sock, SWITCH_SHUTDOWN_READWRITE);
 		switch_socket_close(l->sock);
 	}
+	listener_wake(l);
 
 }
 
@@ -759,6 +1495,7 @@ SWITCH_STANDARD_API(event_sink_function)
 
 	  filter_end:
 
+		compile_filters(listener);
 		switch_mutex_unlock(listener->filter_mutex);
 
 	} else if (!strcasecmp(wcmd, "stop-logging")) {
@@ -832,6 +1569,7 @@ SWITCH_STANDARD_API(event_sink_function)
 		listener->format = EVENT_FORMAT_PLAIN;
 		switch_mutex_init(&listener->flag_mutex, SWITCH_MUTEX_NESTED, listener->pool);
 		switch_mutex_init(&listener->filter_mutex, SWITCH_MUTEX_NESTED, listener->pool);
+		listener_set_watermarks(listener, prefs.queue_high, prefs.queue_low, prefs.queue_degrade);
 
 		switch_core_hash_init(&listener->event_hash, listener->pool);
 		switch_set_flag(listener, LFLAG_AUTHED);
@@ -949,7 +1687,7 @@ SWITCH_STANDARD_API(event_sink_function)
 		char *id = switch_event_get_header(stream->param_event, "listen-id");
 		uint32_t idl = 0;
 		void *pop;
-		switch_event_t *pevent = NULL;
+		shared_event_t *sevent = NULL;
 
 		if (id) {
 			idl = (uint32_t) atol(id);
@@ -991,39 +1729,30 @@ SWITCH_STANDARD_API(event_sink_function)
 		stream->write_function(stream, "<events>\n");
 
 		while (switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
-			//char *etype;
-			pevent = (switch_event_t *) pop;
-
-			if (listener->format == EVENT_FORMAT_PLAIN) {
-				//etype = "plain";
-				switch_event_serialize(pevent, &listener->ebuf, SWITCH_TRUE);
-				stream->write_function(stream, "<event type=\"plain\">\n%s</event>", listener->ebuf);
-			} else if (listener->format == EVENT_FORMAT_JSON) {
-				//etype = "json";
-				switch_event_serialize_json(pevent, &listener->ebuf);
-			} else {
-				switch_xml_t xml;
-				//etype = "xml";
+			const char *ebuf;
 
-				if ((xml = switch_event_xmlize(pevent, SWITCH_VA_NONE))) {
-					listener->ebuf = switch_xml_toxml(xml, SWITCH_FALSE);
-					switch_xml_free(xml);
-				} else {
+			sevent = (shared_event_t *) pop;
+
+			if (!(ebuf = shared_event_render(sevent, listener->format))) {
+				if (listener->format == EVENT_FORMAT_XML) {
 					stream->write_function(stream, "<data><reply type=\"error\">XML Render Error</reply></data>\n");
 					break;
 				}
-
-				stream->write_function(stream, "%s\n", listener->ebuf);
+			} else if (listener->format == EVENT_FORMAT_PLAIN) {
+				stream->write_function(stream, "<event type=\"plain\">\n%s</event>", ebuf);
+			} else if (listener->format == EVENT_FORMAT_XML) {
+				stream->write_function(stream, "%s\n", ebuf);
 			}
 
-			switch_safe_free(listener->ebuf);
-			switch_event_destroy(&pevent);
+			shared_event_release(&sevent);
 		}
 
+		check_low_water(listener);
+
 		stream->write_function(stream, " </events>\n</data>\n");
 
-		if (pevent) {
-			switch_event_destroy(&pevent);
+		if (sevent) {
+			shared_event_release(&sevent);
 		}
 
 		switch_thread_rwlock_unlock(listener->rwlock);
@@ -1069,14 +1798,28 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_event_socket_load)
 {
 	switch_application_interface_t *app_interface;
 	switch_api_interface_t *api_interface;
+	int x;
 
 	memset(&globals, 0, sizeof(globals));
 
 	switch_mutex_init(&globals.listener_mutex, SWITCH_MUTEX_NESTED, pool);
 
+	for (x = 0; x < SHARED_EVENT_LOCKS; x++) {
+		switch_mutex_init(&globals.shared_event_mutex[x], SWITCH_MUTEX_NESTED, pool);
+	}
+
+	globals.binary_pool = pool;
+	switch_mutex_init(&globals.binary_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&globals.binary_hash, pool);
+
 	memset(&listen_list, 0, sizeof(listen_list));
 	switch_mutex_init(&listen_list.sock_mutex, SWITCH_MUTEX_NESTED, pool);
 
+	if (switch_event_reserve_subclass(MY_EVENT_BACKPRESSURE) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't register subclass %s!\n", MY_EVENT_BACKPRESSURE);
+		return SWITCH_STATUS_TERM;
+	}
+
 	if (switch_event_bind_removable(modname, SWITCH_EVENT_ALL, SWITCH_EVENT_SUBCLASS_ANY, event_handler, NULL, &globals.node) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		return SWITCH_STATUS_GENERR;
@@ -1093,6 +1836,73 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_event_socket_load)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* 
+ * Write up to EVENT_BATCH_MAX queued events with one switch_socket_sendv().
+ * Returns how many events were taken off the queue.
+ */
+static int send_event_batch(listener_t *listener)
+{
+	char hbuf[EVENT_BATCH_MAX][128];
+	shared_event_t *sevents[EVENT_BATCH_MAX];
+	char *defs[EVENT_BATCH_MAX] = { 0 };
+	switch_io_vec_t vec[EVENT_BATCH_MAX * 3];
+	int32_t nvec = 0;
+	int n = 0, i;
+	switch_size_t len;
+	void *pop;
+
+	while (n < EVENT_BATCH_MAX && switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		shared_event_t *sevent = (shared_event_t *) pop;
+		const char *ebuf;
+
+		sevents[n] = sevent;
+
+		if (!(ebuf = shared_event_render(sevent, listener->format))) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(listener->session), SWITCH_LOG_ERROR, "%s ERROR!\n", 
+							  listener->format == EVENT_FORMAT_XML ? "XML" : "Serialize");
+			n++;
+			continue;
+		}
+
+		if (listener->format == EVENT_FORMAT_BINARY) {
+			switch_size_t dlen = 0;
+
+			defs[n] = binary_name_defs(listener, sevent->binary_names, &dlen);
+			len = dlen + sevent->binary_len;
+			switch_snprintf(hbuf[n], sizeof(hbuf[n]), "Content-Length: %" SWITCH_SSIZE_T_FMT "\n" "Content-Type: text/event-binary\n" "\n", len);
+
+			vec[nvec].base = hbuf[n];
+			vec[nvec++].len = strlen(hbuf[n]);
+			vec[nvec].base = defs[n];
+			vec[nvec++].len = dlen;
+			vec[nvec].base = ebuf;
+			vec[nvec++].len = sevent->binary_len;
+		} else {
+			len = strlen(ebuf);
+			switch_snprintf(hbuf[n], sizeof(hbuf[n]), "Content-Length: %" SWITCH_SSIZE_T_FMT "\n" "Content-Type: text/event-%s\n" "\n", 
+							len, format2str(listener->format));
+
+			vec[nvec].base = hbuf[n];
+			vec[nvec++].len = strlen(hbuf[n]);
+			vec[nvec].base = ebuf;
+			vec[nvec++].len = len;
+		}
+
+		n++;
+	}
+
+	if (nvec) {
+		switch_socket_sendv(listener->sock, vec, nvec, &len);
+	}
+
+	for (i = 0; i < n; i++) {
+		switch_safe_free(defs[i]);
+		shared_event_release(&sevents[i]);
+	}
+
+	return n;
+}
+
 static switch_status_t read_packet(listener_t *listener, switch_event_t **event, uint32_t timeout)
 {
 	switch_size_t mlen, bytes = 0;
@@ -1289,7 +2099,12 @@ static switch_status_t read_packet(listener_t *listener, switch_event_t **event,
 				if (switch_channel_get_state(chan) < CS_HANGUP && switch_channel_test_flag(chan, CF_DIVERT_EVENTS)) {
 					switch_event_t *e = NULL;
 					while (switch_core_session_dequeue_event(listener->session, &e, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS) {
-						if (switch_queue_trypush(listener->event_queue, e) != SWITCH_STATUS_SUCCESS) {
+						shared_event_t *sevent = shared_event_create(&e);
+
+						if (switch_queue_trypush(listener->event_queue, sevent) != SWITCH_STATUS_SUCCESS) {
+							e = sevent->event;
+							sevent->event = NULL;
+							shared_event_release(&sevent);
 							switch_core_session_queue_event(listener->session, &e);
 							break;
 						}
@@ -1298,49 +2113,10 @@ static switch_status_t read_packet(listener_t *listener, switch_event_t **event,
 			}
 
 			if (switch_test_flag(listener, LFLAG_EVENTS)) {
-				while (switch_queue_trypop(listener->event_queue, &pop) == SWITCH_STATUS_SUCCESS) {
-					char hbuf[512];
-					switch_event_t *pevent = (switch_event_t *) pop;
-					char *etype;
-
+				while (send_event_batch(listener)) {
 					do_sleep = 0;
-					if (listener->format == EVENT_FORMAT_PLAIN) {
-						etype = "plain";
-						switch_event_serialize(pevent, &listener->ebuf, SWITCH_TRUE);
-					} else if (listener->format == EVENT_FORMAT_JSON) {
-						etype = "json";
-						switch_event_serialize_json(pevent, &listener->ebuf);
-					} else {
-						switch_xml_t xml;
-						etype = "xml";
-
-						if ((xml = switch_event_xmlize(pevent, SWITCH_VA_NONE))) {
-							listener->ebuf = switch_xml_toxml(xml, SWITCH_FALSE);
-							switch_xml_free(xml);
-						} else {
-							switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(listener->session), SWITCH_LOG_ERROR, "XML ERROR!\n");
-							goto endloop;
-						}
-					}
-
-					switch_assert(listener->ebuf);
-
-					len = strlen(listener->ebuf);
-
-					switch_snprintf(hbuf, sizeof(hbuf), "Content-Length: %" SWITCH_SSIZE_T_FMT "\n" "Content-Type: text/event-%s\n" "\n", len, etype);
-
-					len = strlen(hbuf);
-					switch_socket_send(listener->sock, hbuf, &len);
-
-					len = strlen(listener->ebuf);
-					switch_socket_send(listener->sock, listener->ebuf, &len);
-
-					switch_safe_free(listener->ebuf);
-
-				  endloop:
-
-					switch_event_destroy(&pevent);
 				}
+				check_low_water(listener);
 			}
 		}
 
@@ -1381,7 +2157,12 @@ static switch_status_t read_packet(listener_t *listener, switch_event_t **event,
 		}
 
 		if (do_sleep) {
-			switch_cond_next();
+			if (listener->io_handle) {
+				/* sessions still have to notice diverted events and hangup promptly */
+				listener_io_wait(listener, listener->session ? 20 : 1000);
+			} else {
+				switch_cond_next();
+			}
 		}
 	}
 
@@ -1400,9 +2181,40 @@ struct api_command_struct {
 	int bg;
 	int ack;
 	int console_execute;
+	int chunked;
+	int chunk_failed;
+	switch_size_t chunk_bytes;
 	switch_memory_pool_t *pool;
 };
 
+/* output beyond this is sent on as api/response-chunk packets when the client asked for chunked_response */
+#define API_CHUNK_LEN 65536
+
+static switch_status_t api_stream_flush(switch_stream_handle_t *handle, const uint8_t *data, switch_size_t datalen)
+{
+	struct api_command_struct *acs = (struct api_command_struct *) handle->flush_user_data;
+	char buf[128] = "";
+	switch_size_t blen, len = datalen;
+
+	if (acs->chunk_failed) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_snprintf(buf, sizeof(buf), "Content-Type: api/response-chunk\nContent-Length: %" SWITCH_SSIZE_T_FMT "\n\n", datalen);
+	blen = strlen(buf);
+
+	if (switch_socket_send(acs->listener->sock, buf, &blen) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_send(acs->listener->sock, (const char *) data, &len) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Error sending chunked output of %s, discarding the rest.\n", acs->api_cmd);
+		acs->chunk_failed = 1;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	acs->chunk_bytes += datalen;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static void *SWITCH_THREAD_FUNC api_exec(switch_thread_t *thread, void *obj)
 {
 
@@ -1432,6 +2244,12 @@ static void *SWITCH_THREAD_FUNC api_exec(switch_thread_t *thread, void *obj)
 
 	SWITCH_STANDARD_STREAM(stream);
 
+	if (acs->chunked && !acs->bg) {
+		stream.flush_function = api_stream_flush;
+		stream.flush_user_data = acs;
+		stream.flush_len = API_CHUNK_LEN;
+	}
+
 	if (acs->console_execute) {
 		if ((status = switch_console_execute(acs->api_cmd, 0, &stream)) != SWITCH_STATUS_SUCCESS) {
 			stream.write_function(&stream, "-ERR %s Command not found!\n", acs->api_cmd);
@@ -1463,11 +2281,12 @@ static void *SWITCH_THREAD_FUNC api_exec(switch_thread_t *thread, void *obj)
 			switch_event_add_body(event, "%s", reply);
 			switch_event_fire(&event);
 		}
-	} else {
+	} else if (!acs->chunk_failed) {
 		switch_size_t rlen, blen;
 		char buf[1024] = "";
 
-		if (!(rlen = strlen(reply))) {
+		/* the last api/response of a chunked reply may be empty when the output ended on a flush */
+		if (!(rlen = strlen(reply)) && !acs->chunk_bytes) {
 			reply = "-ERR no reply\n";
 			rlen = strlen(reply);
 		}
@@ -1475,7 +2294,9 @@ static void *SWITCH_THREAD_FUNC api_exec(switch_thread_t *thread, void *obj)
 		switch_snprintf(buf, sizeof(buf), "Content-Type: api/response\nContent-Length: %" SWITCH_SSIZE_T_FMT "\n\n", rlen);
 		blen = strlen(buf);
 		switch_socket_send(acs->listener->sock, buf, &blen);
-		switch_socket_send(acs->listener->sock, reply, &rlen);
+		if (rlen) {
+			switch_socket_send(acs->listener->sock, reply, &rlen);
+		}
 	}
 
 	switch_safe_free(stream.data);
@@ -1848,6 +2669,7 @@ static switch_status_t parse_command(listener_t *listener, switch_event_t **even
 		} else {
 			switch_snprintf(reply, reply_len, "-ERR invalid syntax");
 		}
+		compile_filters(listener);
 		switch_mutex_unlock(listener->filter_mutex);
 
 		goto done;
@@ -1981,6 +2803,9 @@ static switch_status_t parse_command(listener_t *listener, switch_event_t **even
 			if (strstr(cmd, "json") || strstr(cmd, "JSON")) {
 				listener->format = EVENT_FORMAT_JSON;
 			}
+			if (strstr(cmd, "binary") || strstr(cmd, "BINARY")) {
+				listener->format = EVENT_FORMAT_BINARY;
+			}
 			switch_snprintf(reply, reply_len, "+OK Events Enabled");
 			goto done;
 		}
@@ -2135,6 +2960,7 @@ static switch_status_t parse_command(listener_t *listener, switch_event_t **even
 	} else if (!strncasecmp(cmd, "api ", 4)) {
 		struct api_command_struct acs = { 0 };
 		char *console_execute = switch_event_get_header(*event, "console_execute");
+		char *chunked = switch_event_get_header(*event, "chunked_response");
 
 		char *api_cmd = cmd + 4;
 		char *arg = NULL;
@@ -2169,6 +2995,7 @@ static switch_status_t parse_command(listener_t *listener, switch_event_t **even
 		acs.api_cmd = api_cmd;
 		acs.arg = arg;
 		acs.bg = 0;
+		acs.chunked = switch_true(chunked);
 
 
 		api_exec(NULL, (void *) &acs);
@@ -2297,6 +3124,32 @@ static switch_status_t parse_command(listener_t *listener, switch_event_t **even
 		} else {
 			switch_snprintf(reply, reply_len, "-ERR not controlling a session");
 		}
+	} else if (!strncasecmp(cmd, "queue_watermarks", 16)) {
+		char *argv[3] = { 0 };
+		char *mydata = NULL;
+		int argc = 0;
+
+		if (*(cmd + 16) == ' ' && *(cmd + 17) && (mydata = strdup(cmd + 17))) {
+			argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
+		}
+
+		if (argc > 0) {
+			uint32_t high = (uint32_t) atoi(argv[0]);
+			uint32_t low = argc > 1 ? (uint32_t) atoi(argv[1]) : high / 2;
+			int degrade = argc > 2 && !strcasecmp(argv[2], "degrade");
+
+			listener_set_watermarks(listener, high, low, degrade);
+			if (listener->queue_high) {
+				switch_snprintf(reply, reply_len, "+OK queue water marks high %u low %u%s", listener->queue_high, listener->queue_low, 
+								switch_test_flag(listener, LFLAG_DEGRADE) ? " degrade" : "");
+			} else {
+				switch_snprintf(reply, reply_len, "+OK queue water marks disabled");
+			}
+		} else {
+			switch_snprintf(reply, reply_len, "-ERR usage queue_watermarks <high> [<low>] [degrade]");
+		}
+
+		switch_safe_free(mydata);
 	} else if (!strncasecmp(cmd, "nolog", 5)) {
 		flush_listener(listener, SWITCH_TRUE, SWITCH_FALSE);
 		if (switch_test_flag(listener, LFLAG_LOG)) {
@@ -2331,6 +3184,9 @@ static switch_status_t parse_command(listener_t *listener, switch_event_t **even
 					} else if (!strcasecmp(cur, "json")) {
 						listener->format = EVENT_FORMAT_JSON;
 						goto end;
+					} else if (!strcasecmp(cur, "binary")) {
+						listener->format = EVENT_FORMAT_BINARY;
+						goto end;
 					}
 				}
 
@@ -2529,6 +3385,7 @@ static void *SWITCH_THREAD_FUNC listener_run(switch_thread_t *thread, void *obj)
 
 	switch_socket_opt_set(listener->sock, SWITCH_SO_NONBLOCK, TRUE);
 	switch_set_flag_locked(listener, LFLAG_RUNNING);
+	listener_io_attach(listener);
 	add_listener(listener);
 
 	if (session && switch_test_flag(listener, LFLAG_AUTHED)) {
@@ -2623,6 +3480,7 @@ static void *SWITCH_THREAD_FUNC listener_run(switch_thread_t *thread, void *obj)
 	}
 
 	remove_listener(listener);
+	listener_io_detach(listener);
 
 	if (globals.debug > 0) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Session complete, waiting for children\n");
@@ -2634,6 +3492,7 @@ static void *SWITCH_THREAD_FUNC listener_run(switch_thread_t *thread, void *obj)
 	if (listener->filters) {
 		switch_event_destroy(&listener->filters);
 	}
+	free_compiled_filters(listener);
 	switch_mutex_unlock(listener->filter_mutex);
 
 	if (listener->session) {
@@ -2723,6 +3582,14 @@ static int config(void)
 					prefs.port = (uint16_t) atoi(val);
 				} else if (!strcmp(var, "password")) {
 					set_pref_pass(val);
+				} else if (!strcasecmp(var, "io-threads")) {
+					prefs.io_threads = atoi(val);
+				} else if (!strcasecmp(var, "queue-high-water")) {
+					prefs.queue_high = atoi(val);
+				} else if (!strcasecmp(var, "queue-low-water")) {
+					prefs.queue_low = atoi(val);
+				} else if (!strcasecmp(var, "queue-degrade")) {
+					prefs.queue_degrade = switch_true(val);
 				} else if (!strcasecmp(var, "apply-inbound-acl") && ! zstr(val)) {
 					if (prefs.acl_count < MAX_ACL) {
 						prefs.acl[prefs.acl_count++] = strdup(val);
@@ -2775,6 +3642,7 @@ SWITCH_MODULE_RUNTIME_FUNCTION(mod_event_socket_runtime)
 	}
 
 	config();
+	listener_io_start(pool);
 
 	while (!prefs.done) {
 		rv = switch_sockaddr_info_get(&sa, prefs.ip, SWITCH_UNSPEC, prefs.port, 0, pool);
@@ -2848,6 +3716,7 @@ SWITCH_MODULE_RUNTIME_FUNCTION(mod_event_socket_runtime)
 
 		switch_mutex_init(&listener->flag_mutex, SWITCH_MUTEX_NESTED, listener->pool);
 		switch_mutex_init(&listener->filter_mutex, SWITCH_MUTEX_NESTED, listener->pool);
+		listener_set_watermarks(listener, prefs.queue_high, prefs.queue_low, prefs.queue_degrade);
 
 		switch_core_hash_init(&listener->event_hash, listener->pool);
 
@@ -3,67 +3,149 @@
 #include <exception>
 #include <stdexcept>
 #include <memory>
+#include <string>
 
 #include "mod_event_zmq.h"
 
 namespace mod_event_zmq {
 
-// Handles publishing events out to clients
+// Settings from event_zmq.conf, the defaults match the module's old hard coded behaviour
+struct ZmqConfig {
+	ZmqConfig() :
+		bind(DEFAULT_BIND), queue_size(DEFAULT_QUEUE_SIZE), batch_size(DEFAULT_BATCH_SIZE), hwm(0) { }
+
+	void Load() {
+		switch_xml_t cfg, xml, settings, param;
+
+		if (!(xml = switch_xml_open_cfg(CONFIG_NAME, &cfg, NULL))) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "No %s, using defaults\n", CONFIG_NAME);
+			return;
+		}
+
+		if ((settings = switch_xml_child(cfg, "settings"))) {
+			for (param = switch_xml_child(settings, "param"); param; param = param->next) {
+				const char *var = switch_xml_attr_soft(param, "name");
+				const char *val = switch_xml_attr_soft(param, "value");
+
+				if (!strcasecmp(var, "bind") && !zstr(val)) {
+					bind = val;
+				} else if (!strcasecmp(var, "queue-size")) {
+					int n = atoi(val);
+					if (n > 0) queue_size = n;
+				} else if (!strcasecmp(var, "batch-size")) {
+					int n = atoi(val);
+					if (n > 0) batch_size = n;
+				} else if (!strcasecmp(var, "hwm")) {
+					int n = atoi(val);
+					if (n >= 0) hwm = n;
+				} else if (!strcasecmp(var, "topic-prefix")) {
+					topic_prefix = val;
+				}
+			}
+		}
+
+		switch_xml_free(xml);
+	}
+
+	std::string bind;
+	uint32_t queue_size;
+	uint32_t batch_size;
+	uint64_t hwm;
+	std::string topic_prefix;
+};
+
+// Handles publishing events out to clients, only ever used from the thread that created it
 class ZmqEventPublisher {
 public:
-	ZmqEventPublisher(zmq::context_t &context) :
-		_publisher(context, ZMQ_PUB)
+	ZmqEventPublisher(zmq::context_t &context, const ZmqConfig &config) :
+		_publisher(context, ZMQ_PUB), _topic_prefix(config.topic_prefix)
 	{
-		_publisher.bind("tcp://*:5556");
+		// Past the high water mark a PUB socket drops messages for that subscriber rather than blocking us
+		if (config.hwm) {
+			_publisher.setsockopt(ZMQ_HWM, &config.hwm, sizeof(config.hwm));
+		}
+
+		_publisher.bind(config.bind.c_str());
 
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Listening for clients\n");
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Listening for clients on %s\n", config.bind.c_str());
 	}
 
-	void PublishEvent(const switch_event_t *event) {
-		// Serialize the event into a JSON string
-		char* pjson;
-		switch_event_serialize_json(const_cast<switch_event_t*>(event), &pjson);
+	// Sends the events as multipart messages of [topic, json, json, ...], consecutive events with the same
+	// topic share a message so subscribers filtering on a prefix pay for one topic frame per run
+	uint32_t PublishBatch(switch_event_t **events, uint32_t count) {
+		uint32_t messages = 0;
+		uint32_t i = 0;
+
+		while (i < count) {
+			std::string topic = Topic(events[i]);
+			uint32_t end = i + 1;
+
+			while (end < count && Topic(events[end]) == topic) {
+				end++;
+			}
+
+			zmq::message_t topic_msg(topic.size());
+			memcpy(topic_msg.data(), topic.data(), topic.size());
+			_publisher.send(topic_msg, ZMQ_SNDMORE);
+
+			for (; i < end; i++) {
+				// Serialize the event into a JSON string and use it as the message body
+				char *pjson = NULL;
+				switch_event_serialize_json(events[i], &pjson);
+
+				zmq::message_t msg(pjson, strlen(pjson), free_message_data, NULL);
+				_publisher.send(msg, i + 1 < end ? ZMQ_SNDMORE : 0);
+			}
+
+			messages++;
+		}
 
-		// Use the JSON string as the message body
-		zmq::message_t msg(pjson, strlen(pjson), free_message_data, NULL);
-		
-		// Send the message
-		_publisher.send(msg);
+		return messages;
 	}
 
 private:
-	static void free_message_data(void *data, void *hint) {
-		free (data);
-	}
+	std::string Topic(switch_event_t *event) {
+		std::string topic(_topic_prefix);
 
-	zmq::socket_t _publisher;
-};
+		topic += switch_event_name(event->event_id);
 
-class char_msg : public zmq::message_t {
-public:
-	char_msg() : zmq::message_t(sizeof(char)) { }
-	char_msg(char data) : zmq::message_t(sizeof(char)) {
-		*char_data() = data;
+		if (event->event_id == SWITCH_EVENT_CUSTOM && event->subclass_name) {
+			topic += ".";
+			topic += event->subclass_name;
+		}
+
+		return topic;
 	}
 
-	char* char_data() {
-		return static_cast<char*>(this->data());
+	static void free_message_data(void *data, void *hint) {
+		free (data);
 	}
+
+	zmq::socket_t _publisher;
+	std::string _topic_prefix;
 };
 
 // Handles global inititalization and teardown of the module
 class ZmqModule {
 public:
 	ZmqModule(switch_loadable_module_interface_t **module_interface, switch_memory_pool_t *pool) :
-		_context(1), _term_rep(_context, ZMQ_REP), _term_req(_context, ZMQ_REQ), _publisher(_context) {
+		_context(1), _queue(NULL), _node(NULL), _running(true), _listening(true) {
+		switch_api_interface_t *api_interface;
+
+		_config.Load();
 
-		// Set up the term messaging connection
-		_term_rep.bind(TERM_URI);
-		_term_req.connect(TERM_URI);
+		switch_atomic_set(&_published, 0);
+		switch_atomic_set(&_dropped, 0);
+		switch_atomic_set(&_messages, 0);
+
+		// Events are handed to the runtime thread, which owns the publisher socket, through a bounded queue
+		if (switch_queue_create(&_queue, _config.queue_size, pool) != SWITCH_STATUS_SUCCESS) {
+			throw std::runtime_error("Couldn't create the event queue.");
+		}
 
 		// Subscribe to all switch events of any subclass
 		// Store a pointer to ourself in the user data
-		if (switch_event_bind_removable(modname, SWITCH_EVENT_ALL, SWITCH_EVENT_SUBCLASS_ANY, event_handler, static_cast<void*>(&_publisher), &_node)
+		if (switch_event_bind_removable(modname, SWITCH_EVENT_ALL, SWITCH_EVENT_SUBCLASS_ANY, event_handler, static_cast<void*>(this), &_node)
 				!= SWITCH_STATUS_SUCCESS) {
 			throw std::runtime_error("Couldn't bind to switch events.");
 		}
@@ -71,46 +153,33 @@ public:
 
 		// Create our module interface registration
 		*module_interface = switch_loadable_module_create_module_interface(pool, modname);
+		SWITCH_ADD_API(api_interface, "event_zmq", "0MQ event publisher", api_handler, "status");
 
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Module loaded\n");
 	}
 
 	void Listen() {
-		// All we do is sit here and block the run loop thread so it doesn't return
-		// it seems that if you want to keep your module running you can't return from the run loop
-		
-		char_msg msg;
-		while(true) {
-			// Listen for term message
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Entered run loop, waiting for term message\n");
-			_term_rep.recv(&msg);
-			if(*msg.char_data() == MODULE_TERM_REQ_MESSAGE) {
-				// Ack term message
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Got term message, sending ack and leaving run loop\n");
-
-				*msg.char_data() = MODULE_TERM_ACK_MESSAGE;
-				_term_rep.send(msg);
-
-				break;
-			}
+		// Shutdown waits on _listening, which is set from load so it can't miss a run loop that is just starting
+		try {
+			Publish();
+		} catch(...) {
+			_listening = false;
+			throw;
 		}
+		_listening = false;
 	}
 
 	void Shutdown() {
-		// Send term message
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Shutdown requested, sending term message to runloop\n");
-		char_msg msg(MODULE_TERM_REQ_MESSAGE);
-		_term_req.send(msg);
-
-		while(true) {
-			// Wait for the term ack message
-			_term_req.recv(&msg);
-			if(*msg.char_data() == MODULE_TERM_ACK_MESSAGE) {
-				// Continue shutdown
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Got term ack message, continuing shutdown\n");
-				break;
-			}
+		// Stop taking events and wait for the run loop to close the publisher
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Shutdown requested, waiting for the run loop\n");
+		switch_event_unbind(&_node);
+		_running = false;
+
+		while (_listening) {
+			switch_yield(10000);
 		}
+
+		Drain();
 	}
 
 	~ZmqModule() {
@@ -120,25 +189,117 @@ public:
 	}
 
 private:
-	// Dispatches events to the publisher
+	void Publish() {
+		// The run loop thread is the publisher thread, the socket is created, used and closed here only
+		ZmqEventPublisher publisher(_context, _config);
+		switch_event_t **batch = new switch_event_t *[_config.batch_size];
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Entered run loop, publishing queued events\n");
+
+		while (_running) {
+			void *pop = NULL;
+			uint32_t count = 0;
+
+			if (switch_queue_pop_timeout(_queue, &pop, 100000) != SWITCH_STATUS_SUCCESS || !pop) {
+				continue;
+			}
+
+			// Drain whatever else is already waiting, up to a batch
+			batch[count++] = static_cast<switch_event_t*>(pop);
+			while (count < _config.batch_size && switch_queue_trypop(_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+				batch[count++] = static_cast<switch_event_t*>(pop);
+			}
+
+			try {
+				switch_atomic_add(&_messages, publisher.PublishBatch(batch, count));
+				switch_atomic_add(&_published, count);
+			} catch(std::exception &ex) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Error publishing events via 0MQ: %s\n", ex.what());
+			}
+
+			DestroyEvents(batch, count);
+		}
+
+		Drain();
+		delete [] batch;
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Leaving run loop\n");
+	}
+
+	static void DestroyEvents(switch_event_t **events, uint32_t count) {
+		for (uint32_t i = 0; i < count; i++) {
+			switch_event_destroy(&events[i]);
+		}
+	}
+
+	void Drain() {
+		void *pop = NULL;
+
+		while (switch_queue_trypop(_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			switch_event_t *event = static_cast<switch_event_t*>(pop);
+			switch_event_destroy(&event);
+		}
+	}
+
+	void Enqueue(switch_event_t *event) {
+		switch_event_t *clone = NULL;
+
+		if (!_running) {
+			return;
+		}
+
+		// Never block the dispatch thread, when the publisher falls behind the event is counted and dropped
+		if (switch_event_dup(&clone, event) != SWITCH_STATUS_SUCCESS) {
+			switch_atomic_inc(&_dropped);
+			return;
+		}
+
+		if (switch_queue_trypush(_queue, clone) != SWITCH_STATUS_SUCCESS) {
+			switch_event_destroy(&clone);
+			switch_atomic_inc(&_dropped);
+		}
+	}
+
+	void Status(switch_stream_handle_t *stream) {
+		stream->write_function(stream, "bind: %s\n", _config.bind.c_str());
+		stream->write_function(stream, "queued: %u/%u\n", switch_queue_size(_queue), _config.queue_size);
+		stream->write_function(stream, "published: %u\n", switch_atomic_read(&_published));
+		stream->write_function(stream, "messages: %u\n", switch_atomic_read(&_messages));
+		stream->write_function(stream, "dropped: %u\n", switch_atomic_read(&_dropped));
+	}
+
+	// Dispatches events to the publisher thread
 	static void event_handler(switch_event_t *event) {
-		try {
-			ZmqEventPublisher *publisher = static_cast<ZmqEventPublisher*>(event->bind_user_data);
-			publisher->PublishEvent(event);
-		} catch(std::exception ex) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Error publishing event via 0MQ: %s\n", ex.what());
-		} catch(...) { // Exceptions must not propogate to C caller
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Unknown error publishing event via 0MQ\n");
+		ZmqModule *module = static_cast<ZmqModule*>(event->bind_user_data);
+		module->Enqueue(event);
+	}
+
+	static switch_status_t api_handler(const char *cmd, switch_core_session_t *session, switch_stream_handle_t *stream) {
+		ZmqModule *module = instance();
+
+		if (!module || (!zstr(cmd) && strcasecmp(cmd, "status"))) {
+			stream->write_function(stream, "-USAGE: event_zmq status\n");
+			return SWITCH_STATUS_SUCCESS;
 		}
+
+		module->Status(stream);
+		return SWITCH_STATUS_SUCCESS;
 	}
 
-	switch_event_node_t *_node;
+	static ZmqModule *instance();
+
+	ZmqConfig _config;
 
 	zmq::context_t _context;
-	zmq::socket_t _term_rep;
-	zmq::socket_t _term_req;
+	switch_queue_t *_queue;
+	switch_event_node_t *_node;
+
+	volatile bool _running;
+	volatile bool _listening;
 
-	ZmqEventPublisher _publisher;
+	volatile switch_atomic_t _published;
+	volatile switch_atomic_t _dropped;
+	volatile switch_atomic_t _messages;
 };
 
 //*****************************//
@@ -146,6 +307,10 @@ private:
 //*****************************//
 std::auto_ptr<ZmqModule> module;
 
+ZmqModule *ZmqModule::instance() {
+	return module.get();
+}
+
 
 //*****************************//
 //  Module interface funtions  //
@@ -187,6 +352,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(shutdown) {
 	} catch(...) { // Exceptions must not propogate to C caller
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unknown error shutting down module\n");
 	}
+	return SWITCH_STATUS_SUCCESS;
 }
 
 }
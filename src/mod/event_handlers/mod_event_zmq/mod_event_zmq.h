@@ -2,10 +2,11 @@
 #define MOD_EVENT_ZMQ_H
 
 namespace mod_event_zmq {
-static const char MODULE_TERM_REQ_MESSAGE = 1;
-static const char MODULE_TERM_ACK_MESSAGE = 2;
+static const char *CONFIG_NAME = "event_zmq.conf";
 
-static const char *TERM_URI = "inproc://mod_event_zmq_term";
+static const char *DEFAULT_BIND = "tcp://*:5556";
+static const uint32_t DEFAULT_QUEUE_SIZE = 10000;
+static const uint32_t DEFAULT_BATCH_SIZE = 64;
 
 SWITCH_MODULE_LOAD_FUNCTION(load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(shutdown);
@@ -40,6 +40,7 @@
 #define ENCODING_NONE 0
 #define ENCODING_DEFAULT 1
 #define ENCODING_BASE64 2
+#define CDR_STREAM_CHUNK 8192
 
 static struct {
 	char *cred;
@@ -183,7 +184,7 @@ static switch_status_t set_json_cdr_log_dirs()
 
 static switch_status_t my_on_reporting(switch_core_session_t *session)
 {
-	cJSON *json_cdr = NULL;
+	switch_stream_handle_t stream = { 0 };
 	char *json_text = NULL;
 	char *path = NULL;
 	char *curl_json_text = NULL;
@@ -215,17 +216,17 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 		a_prefix = "a_";
 
 
-	if (switch_ivr_generate_json_cdr(session, &json_cdr, globals.encode_values == ENCODING_DEFAULT) != SWITCH_STATUS_SUCCESS) {
+	/* render the JSON straight into a buffer, no intermediate cJSON object */
+	SWITCH_STANDARD_STREAM(stream);
+	stream.alloc_chunk = CDR_STREAM_CHUNK;
+
+	if (switch_ivr_stream_json_cdr(session, &stream, globals.encode_values == ENCODING_DEFAULT) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Generating Data!\n");
+		switch_safe_free(stream.data);
 		return SWITCH_STATUS_FALSE;
 	}
-	
-	json_text = cJSON_PrintUnformatted(json_cdr);
 
-	if (!json_text) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error!\n");
-		goto error;
-	}
+	json_text = (char *) stream.data;
 
 	switch_thread_rwlock_rdlock(globals.log_path_lock);
 
@@ -439,8 +440,7 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 	if (curl_json_text != json_text) {
 		switch_safe_free(curl_json_text);
 	}
-	
-	cJSON_Delete(json_cdr);
+
 	switch_safe_free(json_text);
 
 	return status;
@@ -49,10 +49,45 @@ static struct {
 static int RUNNING = 1;
 static int THREADS = 0;
 
+/* frames a listener may fall behind before it is considered leaked and skipped ahead */
+#define LOCAL_STREAM_RING_LEN 384
+
+/*
+  One writer, any number of readers and no locks: the source thread fills the slot after the last one
+  and bumps head, every listener keeps its own position.  A reader that finds head a whole ring ahead
+  of the slot it just copied was lapped while copying and drops it.
+*/
+typedef struct local_stream_ring {
+	switch_byte_t *data;
+	uint32_t *lens;
+	uint32_t slot_len;
+	uint32_t slots;
+	volatile switch_atomic_t head;
+} local_stream_ring_t;
+
+/* the stream encoded once for everybody writing with the same codec */
+struct local_stream_encoder {
+	char *name;
+	switch_codec_t codec;
+	switch_buffer_t *pcm;
+	switch_byte_t *frame;
+	uint32_t frame_len;
+	uint32_t samples_per_packet;
+	switch_byte_t *silence;
+	uint32_t silence_len;
+	local_stream_ring_t ring;
+	int refs;
+	struct local_stream_encoder *next;
+};
+
+typedef struct local_stream_encoder local_stream_encoder_t;
+
 struct local_stream_context {
 	struct local_stream_source *source;
-	switch_mutex_t *audio_mutex;
-	switch_buffer_t *audio_buffer;
+	local_stream_encoder_t *encoder;
+	uint32_t pos;
+	uint32_t offset;
+	volatile switch_atomic_t catchup;
 	int err;
 	const char *file;
 	const char *func;
@@ -90,10 +125,173 @@ struct local_stream_source {
 	int32_t chime_counter;
 	int32_t chime_max_counter;
 	switch_file_handle_t chime_fh;
+	int share_encoded;
+	local_stream_ring_t ring;
+	local_stream_encoder_t *encoders;
 };
 
 typedef struct local_stream_source local_stream_source_t;
 
+static void ring_init(local_stream_ring_t *ring, uint32_t slot_len, uint32_t slots)
+{
+	memset(ring, 0, sizeof(*ring));
+	ring->slot_len = slot_len;
+	ring->slots = slots;
+	switch_zmalloc(ring->data, slot_len * slots);
+	switch_zmalloc(ring->lens, sizeof(uint32_t) * slots);
+}
+
+static void ring_destroy(local_stream_ring_t *ring)
+{
+	switch_safe_free(ring->data);
+	switch_safe_free(ring->lens);
+}
+
+static void ring_publish(local_stream_ring_t *ring, const void *data, uint32_t len)
+{
+	uint32_t slot = switch_atomic_read(&ring->head) % ring->slots;
+
+	if (len > ring->slot_len) {
+		len = ring->slot_len;
+	}
+
+	memcpy(ring->data + slot * ring->slot_len, data, len);
+	ring->lens[slot] = len;
+	switch_atomic_inc(&ring->head);
+}
+
+/* copy frame pos, returns its length, 0 when it is not there yet and -1 when it is gone */
+static int ring_copy(local_stream_ring_t *ring, uint32_t pos, uint32_t offset, void *data, uint32_t len)
+{
+	uint32_t head = switch_atomic_read(&ring->head), slot = pos % ring->slots, have;
+
+	if (head == pos) {
+		return 0;
+	}
+
+	if (head - pos >= ring->slots) {
+		return -1;
+	}
+
+	have = ring->lens[slot];
+
+	if (offset >= have) {
+		return 0;
+	}
+
+	have -= offset;
+
+	if (have > len) {
+		have = len;
+	}
+
+	memcpy(data, ring->data + slot * ring->slot_len + offset, have);
+
+	if (switch_atomic_read(&ring->head) - pos >= ring->slots) {
+		return -1;
+	}
+
+	return (int) have;
+}
+
+static void encoder_destroy(local_stream_encoder_t **encp)
+{
+	local_stream_encoder_t *enc = *encp;
+
+	*encp = NULL;
+
+	if (switch_core_codec_ready(&enc->codec)) {
+		switch_core_codec_destroy(&enc->codec);
+	}
+
+	if (enc->pcm) {
+		switch_buffer_destroy(&enc->pcm);
+	}
+
+	ring_destroy(&enc->ring);
+	switch_safe_free(enc->frame);
+	switch_safe_free(enc->silence);
+	switch_safe_free(enc->name);
+	free(enc);
+}
+
+static local_stream_encoder_t *encoder_create(local_stream_source_t *source, const switch_codec_implementation_t *impl, const char *name)
+{
+	local_stream_encoder_t *enc;
+	uint32_t enclen, rate = impl->actual_samples_per_second;
+	unsigned int flag = 0;
+
+	switch_zmalloc(enc, sizeof(*enc));
+	enc->name = strdup(name);
+	enc->samples_per_packet = impl->samples_per_packet;
+	enc->frame_len = impl->samples_per_packet * 2;
+	ring_init(&enc->ring, impl->encoded_bytes_per_packet, LOCAL_STREAM_RING_LEN);
+	switch_zmalloc(enc->frame, enc->frame_len);
+	switch_zmalloc(enc->silence, impl->encoded_bytes_per_packet);
+
+	if (switch_core_codec_init_with_bitrate(&enc->codec, impl->iananame, NULL, impl->samples_per_second, impl->microseconds_per_packet / 1000, 1,
+											impl->bits_per_second, SWITCH_CODEC_FLAG_ENCODE, NULL, NULL) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Can't encode stream %s as %s\n", source->name, name);
+		encoder_destroy(&enc);
+		return NULL;
+	}
+
+	/* what an underrun sends instead of nothing */
+	enclen = impl->encoded_bytes_per_packet;
+	if (switch_core_codec_encode(&enc->codec, NULL, enc->frame, enc->frame_len, impl->actual_samples_per_second,
+								 enc->silence, &enclen, &rate, &flag) != SWITCH_STATUS_SUCCESS || enclen != impl->encoded_bytes_per_packet) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Can't encode stream %s as %s, frames are not %u bytes\n",
+						  source->name, name, impl->encoded_bytes_per_packet);
+		encoder_destroy(&enc);
+		return NULL;
+	}
+
+	enc->silence_len = enclen;
+	switch_buffer_create_dynamic(&enc->pcm, enc->frame_len, enc->frame_len * 2, 0);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Stream %s now also encoded as %s\n", source->name, name);
+
+	return enc;
+}
+
+/* called by the source thread with source->mutex held, encoders nobody listens to any more go here too */
+static void encode_frames(local_stream_source_t *source, const switch_byte_t *data, uint32_t len)
+{
+	local_stream_encoder_t *enc, *next, *last = NULL;
+	uint8_t out[SWITCH_RECOMMENDED_BUFFER_SIZE];
+
+	for (enc = source->encoders; enc; enc = next) {
+		next = enc->next;
+
+		if (!enc->refs) {
+			if (last) {
+				last->next = next;
+			} else {
+				source->encoders = next;
+			}
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Stream %s no longer encoded as %s\n", source->name, enc->name);
+			encoder_destroy(&enc);
+			continue;
+		}
+
+		switch_buffer_write(enc->pcm, data, len);
+
+		while (switch_buffer_inuse(enc->pcm) >= enc->frame_len) {
+			uint32_t enclen = sizeof(out), rate = source->rate;
+			unsigned int flag = 0;
+
+			switch_buffer_read(enc->pcm, enc->frame, enc->frame_len);
+
+			if (switch_core_codec_encode(&enc->codec, NULL, enc->frame, enc->frame_len, source->rate, out, &enclen, &rate, &flag) == SWITCH_STATUS_SUCCESS
+				&& enclen) {
+				ring_publish(&enc->ring, out, enclen);
+			}
+		}
+
+		last = enc;
+	}
+}
+
 static int do_rand(void)
 {
 	double r;
@@ -127,6 +325,7 @@ static void *SWITCH_THREAD_FUNC read_stream_thread(switch_thread_t *thread, void
 
 	switch_buffer_create_dynamic(&audio_buffer, 1024, source->prebuf + 10, 0);
 	dist_buf = switch_core_alloc(source->pool, source->prebuf + 10);
+	ring_init(&source->ring, (uint32_t) source->samples * 2, LOCAL_STREAM_RING_LEN);
 
 	if (source->shuffle) {
 		skip = do_rand();
@@ -286,21 +485,18 @@ static void *SWITCH_THREAD_FUNC read_stream_thread(switch_thread_t *thread, void
 				if (!is_open || used >= source->prebuf || (source->total && used > source->samples * 2)) {
 					used = switch_buffer_read(audio_buffer, dist_buf, source->samples * 2);
 					if (source->total) {
+						/* everybody reads the same copy, listeners only cost the source a flag check */
+						ring_publish(&source->ring, dist_buf, (uint32_t) used);
 
 						switch_mutex_lock(source->mutex);
 						for (cp = source->context_list; cp && RUNNING; cp = cp->next) {
 							if (switch_test_flag(cp->handle, SWITCH_FILE_CALLBACK)) {
-								continue;
-							}
-							switch_mutex_lock(cp->audio_mutex);
-							if (switch_buffer_inuse(cp->audio_buffer) > source->samples * 768) {
-								switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Leaking stream handle! [%s() %s:%d]\n", cp->func, cp->file,
-												  cp->line);
-								switch_buffer_zero(cp->audio_buffer);
-							} else {
-								switch_buffer_write(cp->audio_buffer, dist_buf, used);
+								/* busy elsewhere, what plays meanwhile is skipped like before */
+								switch_atomic_set(&cp->catchup, 1);
 							}
-							switch_mutex_unlock(cp->audio_mutex);
+						}
+						if (source->encoders) {
+							encode_frames(source, dist_buf, (uint32_t) used);
 						}
 						switch_mutex_unlock(source->mutex);
 					}
@@ -335,6 +531,13 @@ static void *SWITCH_THREAD_FUNC read_stream_thread(switch_thread_t *thread, void
 	switch_thread_rwlock_wrlock(source->rwlock);
 	switch_thread_rwlock_unlock(source->rwlock);
 
+	while (source->encoders) {
+		local_stream_encoder_t *enc = source->encoders;
+		source->encoders = enc->next;
+		encoder_destroy(&enc);
+	}
+
+	ring_destroy(&source->ring);
 	switch_buffer_destroy(&audio_buffer);
 
 	if (fd > -1) {
@@ -416,19 +619,13 @@ static switch_status_t local_stream_file_open(switch_file_handle_t *handle, cons
 	handle->interval = source->interval;
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Opening Stream [%s] %dhz\n", path, handle->samplerate);
 
-	switch_mutex_init(&context->audio_mutex, SWITCH_MUTEX_NESTED, handle->memory_pool);
-	if (switch_buffer_create_dynamic(&context->audio_buffer, 512, 1024, 0) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Memory Error!\n");
-		status = SWITCH_STATUS_MEMERR;
-		goto end;
-	}
-
 	context->source = source;
 	context->file = handle->file;
 	context->func = handle->func;
 	context->line = handle->line;
 	context->handle = handle;
 	switch_mutex_lock(source->mutex);
+	context->pos = switch_atomic_read(&source->ring.head);
 	context->next = source->context_list;
 	source->context_list = context;
 	source->total++;
@@ -456,26 +653,109 @@ static switch_status_t local_stream_file_close(switch_file_handle_t *handle)
 		last = cp;
 	}
 	context->source->total--;
+	if (context->encoder) {
+		/* the source thread frees it once nobody is left */
+		context->encoder->refs--;
+		context->encoder = NULL;
+	}
 	switch_mutex_unlock(context->source->mutex);
-	switch_buffer_destroy(&context->audio_buffer);
 	switch_thread_rwlock_unlock(context->source->rwlock);
 
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static void context_catchup(local_stream_context_t *context, local_stream_ring_t *ring)
+{
+	uint32_t head = switch_atomic_read(&ring->head);
+
+	if (switch_atomic_read(&context->catchup)) {
+		switch_atomic_set(&context->catchup, 0);
+	} else if (head - context->pos >= ring->slots) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Leaking stream handle! [%s() %s:%d]\n", context->func, context->file, context->line);
+	} else {
+		return;
+	}
+
+	context->pos = head;
+	context->offset = 0;
+}
+
+/* whole encoded frames, *len is in bytes */
+static switch_status_t local_stream_file_read_native(switch_file_handle_t *handle, void *data, size_t *len)
+{
+	local_stream_context_t *context = handle->private_info;
+	local_stream_encoder_t *enc = context->encoder;
+	switch_byte_t *p = data;
+	size_t room = *len, got = 0;
+	int frames = 0, x;
+
+	if (room < enc->silence_len) {
+		*len = 0;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	context_catchup(context, &enc->ring);
+
+	while (room - got >= enc->ring.slot_len && (x = ring_copy(&enc->ring, context->pos, 0, p + got, enc->ring.slot_len)) != 0) {
+		if (x < 0) {
+			context->pos = switch_atomic_read(&enc->ring.head);
+			got = 0;
+			frames = 0;
+			break;
+		}
+		got += x;
+		frames++;
+		context->pos++;
+	}
+
+	if (!frames) {
+		memcpy(data, enc->silence, enc->silence_len);
+		got = enc->silence_len;
+		frames = 1;
+	}
+
+	*len = got;
+	handle->sample_count += frames * enc->samples_per_packet;
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static switch_status_t local_stream_file_read(switch_file_handle_t *handle, void *data, size_t *len)
 {
 	local_stream_context_t *context = handle->private_info;
-	switch_size_t bytes = 0;
-	size_t need = *len * 2;
+	local_stream_ring_t *ring = &context->source->ring;
+	switch_byte_t *p = data;
+	size_t need = *len * 2, bytes = 0;
+	int x;
 
 	if (!context->source->ready) {
 		*len = 0;
 		return SWITCH_STATUS_FALSE;
 	}
 
-	switch_mutex_lock(context->audio_mutex);
-	if ((bytes = switch_buffer_read(context->audio_buffer, data, need))) {
+	if (context->encoder) {
+		return local_stream_file_read_native(handle, data, len);
+	}
+
+	context_catchup(context, ring);
+
+	while (bytes < need && (x = ring_copy(ring, context->pos, context->offset, p + bytes, (uint32_t) (need - bytes))) != 0) {
+		if (x < 0) {
+			context->pos = switch_atomic_read(&ring->head);
+			context->offset = 0;
+			bytes = 0;
+			break;
+		}
+
+		bytes += x;
+		context->offset += x;
+
+		if (context->offset >= ring->lens[context->pos % ring->slots]) {
+			context->pos++;
+			context->offset = 0;
+		}
+	}
+
+	if (bytes) {
 		*len = bytes / 2;
 	} else {
 		if (need > 2560) {
@@ -484,11 +764,62 @@ static switch_status_t local_stream_file_read(switch_file_handle_t *handle, void
 		memset(data, 255, need);
 		*len = need / 2;
 	}
-	switch_mutex_unlock(context->audio_mutex);
+
 	handle->sample_count += *len;
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static switch_status_t local_stream_file_native(switch_file_handle_t *handle, switch_codec_t *codec)
+{
+	local_stream_context_t *context = handle->private_info;
+	local_stream_source_t *source = context->source;
+	const switch_codec_implementation_t *impl = codec->implementation;
+	local_stream_encoder_t *enc;
+	char *name;
+
+	if (!source->share_encoded || context->encoder || !source->ready || source->channels != 1) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (impl->actual_samples_per_second != (uint32_t) source->rate || impl->number_of_channels != 1 || !impl->encoded_bytes_per_packet ||
+		!impl->samples_per_packet || !strcasecmp(impl->iananame, "L16")) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	name = switch_core_sprintf(handle->memory_pool, "%s@%uh@%ui@%d",
+							   impl->iananame, impl->samples_per_second, impl->microseconds_per_packet / 1000, impl->bits_per_second);
+
+	switch_mutex_lock(source->mutex);
+
+	for (enc = source->encoders; enc; enc = enc->next) {
+		if (!strcmp(enc->name, name)) {
+			break;
+		}
+	}
+
+	if (!enc && (enc = encoder_create(source, impl, name))) {
+		enc->next = source->encoders;
+		source->encoders = enc;
+	}
+
+	if (enc) {
+		enc->refs++;
+		context->encoder = enc;
+		context->pos = switch_atomic_read(&enc->ring.head);
+		context->offset = 0;
+	}
+
+	switch_mutex_unlock(source->mutex);
+
+	if (!enc) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_set_flag(handle, SWITCH_FILE_NATIVE);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 /* Registration */
 
 static char *supported_formats[SWITCH_MAX_CODECS] = { 0 };
@@ -534,6 +865,7 @@ static void launch_threads(void)
 		source->prebuf = DEFAULT_PREBUFFER_SIZE;
 		source->stopped = 0;
 		source->chime_freq = 30;
+		source->share_encoded = 1;
 
 		for (param = switch_xml_child(directory, "param"); param; param = param->next) {
 			char *var = (char *) switch_xml_attr_soft(param, "name");
@@ -580,6 +912,8 @@ static void launch_threads(void)
 				}
 			} else if (!strcasecmp(var, "timer-name")) {
 				source->timer_name = switch_core_strdup(source->pool, val);
+			} else if (!strcasecmp(var, "share-encoded")) {
+				source->share_encoded = switch_true(val);
 			}
 		}
 
@@ -754,7 +1088,7 @@ SWITCH_STANDARD_API(start_local_stream_function)
 	char *mycmd = NULL, *argv[8] = { 0 };
 	char *local_stream_name = NULL, *path = NULL, *timer_name = NULL, *chime_list = NULL, *list_dup = NULL;
 	uint32_t prebuf = 1;
-	int rate = 8000, shuffle = 1, interval = 20, chime_freq = 30;
+	int rate = 8000, shuffle = 1, interval = 20, chime_freq = 30, share_encoded = 1;
 	uint8_t channels = 1;
 	uint32_t chime_max = 0;
 	int argc = 0;
@@ -864,6 +1198,8 @@ SWITCH_STANDARD_API(start_local_stream_function)
 						}
 					} else if (!strcasecmp(var, "chime-list")) {
 		                                chime_list = val;
+					} else if (!strcasecmp(var, "share-encoded")) {
+						share_encoded = switch_true(val);
 					}
 				}
 				break;
@@ -919,6 +1255,7 @@ SWITCH_STANDARD_API(start_local_stream_function)
 	source->prebuf = prebuf;
 	source->stopped = 0;
 	source->shuffle = shuffle;
+	source->share_encoded = share_encoded;
 	source->samples = switch_samples_per_packet(source->rate, source->interval);
 
 	switch_mutex_init(&source->mutex, SWITCH_MUTEX_NESTED, source->pool);
@@ -955,6 +1292,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_local_stream_load)
 	file_interface->file_open = local_stream_file_open;
 	file_interface->file_close = local_stream_file_close;
 	file_interface->file_read = local_stream_file_read;
+	file_interface->file_native = local_stream_file_native;
 
 	if (switch_event_bind(modname, SWITCH_EVENT_SHUTDOWN, SWITCH_EVENT_SUBCLASS_ANY, event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind event handler!\n");
@@ -30,16 +30,134 @@
  *
  */
 #include <switch.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_native_file_load);
-SWITCH_MODULE_DEFINITION(mod_native_file, mod_native_file_load, NULL, NULL);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_native_file_shutdown);
+SWITCH_MODULE_DEFINITION(mod_native_file, mod_native_file_load, mod_native_file_shutdown, NULL);
+
+/*
+ * Files opened only for reading are mapped instead of read a frame at a time.  Every handle on the same file shares
+ * one read only mapping out of the page cache, so a prompt played to many callers costs a memcpy per frame and no
+ * syscalls.  A file that changed (mtime, size or inode) since it was mapped gets a new mapping, the old one stays
+ * until its last handle closes.  Replace prompts by renaming a new file over them, truncating a mapped file in place
+ * faults the readers.
+ */
+struct native_file_map {
+	char *path;
+	uint8_t *data;
+	switch_size_t len;
+	time_t mtime;
+	ino_t ino;
+	int refs;
+	int stale;
+};
+
+typedef struct native_file_map native_file_map_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *maps;
+} globals;
 
 struct native_file_context {
 	switch_file_t *fd;
+	native_file_map_t *map;
+	switch_size_t offset;
 };
 
 typedef struct native_file_context native_file_context;
 
+#ifndef WIN32
+static void native_file_map_free(native_file_map_t *map)
+{
+	if (map->len) {
+		munmap(map->data, map->len);
+	}
+	switch_safe_free(map->path);
+	free(map);
+}
+
+/* a referenced mapping of the file, NULL to read it the usual way */
+static native_file_map_t *native_file_map_get(const char *path)
+{
+	native_file_map_t *map;
+	struct stat st;
+	void *data = NULL;
+	int fd;
+
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+		return NULL;
+	}
+
+	switch_mutex_lock(globals.mutex);
+
+	if ((map = switch_core_hash_find(globals.maps, path))) {
+		if (map->mtime == st.st_mtime && map->len == (switch_size_t) st.st_size && map->ino == st.st_ino) {
+			map->refs++;
+			switch_mutex_unlock(globals.mutex);
+			return map;
+		}
+
+		switch_core_hash_delete(globals.maps, path);
+		map->stale = 1;
+		if (!map->refs) {
+			native_file_map_free(map);
+		}
+	}
+
+	switch_mutex_unlock(globals.mutex);
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		return NULL;
+	}
+
+	if (st.st_size > 0 && (data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		close(fd);
+		return NULL;
+	}
+
+	close(fd);
+
+	if (data) {
+		madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+	}
+
+	switch_zmalloc(map, sizeof(*map));
+	map->path = strdup(path);
+	map->data = data;
+	map->len = (switch_size_t) st.st_size;
+	map->mtime = st.st_mtime;
+	map->ino = st.st_ino;
+	map->refs = 1;
+
+	switch_mutex_lock(globals.mutex);
+	if (!switch_core_hash_find(globals.maps, path)) {
+		switch_core_hash_insert(globals.maps, path, map);
+	} else {
+		/* another handle mapped it meanwhile, this one lives as long as its handle */
+		map->stale = 1;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return map;
+}
+
+static void native_file_map_release(native_file_map_t *map)
+{
+	switch_mutex_lock(globals.mutex);
+	if (--map->refs == 0) {
+		if (!map->stale) {
+			switch_core_hash_delete(globals.maps, map->path);
+		}
+		native_file_map_free(map);
+	}
+	switch_mutex_unlock(globals.mutex);
+}
+#endif
+
 static switch_status_t native_file_file_open(switch_file_handle_t *handle, const char *path)
 {
 	native_file_context *context;
@@ -70,6 +188,12 @@ static switch_status_t native_file_file_open(switch_file_handle_t *handle, const
 		flags |= SWITCH_FOPEN_READ;
 	}
 
+#ifndef WIN32
+	if (!switch_test_flag(handle, SWITCH_FILE_FLAG_WRITE) && (context->map = native_file_map_get(path))) {
+		goto opened;
+	}
+#endif
+
 	if (switch_file_open(&context->fd, path, flags, SWITCH_FPROT_UREAD | SWITCH_FPROT_UWRITE, handle->memory_pool) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error opening %s\n", path);
 		return SWITCH_STATUS_GENERR;
@@ -81,6 +205,9 @@ static switch_status_t native_file_file_open(switch_file_handle_t *handle, const
 		handle->pos = samples;
 	}
 
+#ifndef WIN32
+  opened:
+#endif
 	handle->samples = 0;
 	handle->samplerate = 8000;
 	handle->channels = 1;
@@ -101,6 +228,10 @@ static switch_status_t native_file_file_truncate(switch_file_handle_t *handle, i
 	native_file_context *context = handle->private_info;
 	switch_status_t status;
 
+	if (!context->fd) {
+		return SWITCH_STATUS_FALSE;
+	}
+
 	if ((status = switch_file_trunc(context->fd, offset)) == SWITCH_STATUS_SUCCESS) {
 		handle->pos = 0;
 	}
@@ -118,6 +249,13 @@ static switch_status_t native_file_file_close(switch_file_handle_t *handle)
 		context->fd = NULL;
 	}
 
+#ifndef WIN32
+	if (context->map) {
+		native_file_map_release(context->map);
+		context->map = NULL;
+	}
+#endif
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -127,6 +265,27 @@ static switch_status_t native_file_file_seek(switch_file_handle_t *handle, unsig
 
 	native_file_context *context = handle->private_info;
 
+	if (context->map) {
+		int64_t offset = samples;
+
+		if (whence == SEEK_CUR) {
+			offset += context->offset;
+		} else if (whence == SEEK_END) {
+			offset += context->map->len;
+		}
+
+		if (offset < 0) {
+			offset = 0;
+		} else if (offset > (int64_t) context->map->len) {
+			offset = context->map->len;
+		}
+
+		/* same as switch_file_seek() leaves it below */
+		context->offset = (switch_size_t) offset;
+		handle->pos += offset;
+		return SWITCH_STATUS_FALSE;
+	}
+
 	status = switch_file_seek(context->fd, whence, &samples);
 	if (status == SWITCH_STATUS_SUCCESS) {
 		handle->pos += samples;
@@ -140,6 +299,24 @@ static switch_status_t native_file_file_read(switch_file_handle_t *handle, void
 
 	native_file_context *context = handle->private_info;
 
+	if (context->map) {
+		switch_size_t left = context->map->len - context->offset;
+
+		if (!left) {
+			*len = 0;
+			return SWITCH_STATUS_FALSE;
+		}
+
+		if (*len > left) {
+			*len = left;
+		}
+
+		memcpy(data, context->map->data + context->offset, *len);
+		context->offset += *len;
+		handle->pos += *len;
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	status = switch_file_read(context->fd, data, len);
 	if (status == SWITCH_STATUS_SUCCESS) {
 		handle->pos += *len;
@@ -151,6 +328,10 @@ static switch_status_t native_file_file_write(switch_file_handle_t *handle, void
 {
 	native_file_context *context = handle->private_info;
 
+	if (!context->fd) {
+		return SWITCH_STATUS_FALSE;
+	}
+
 	return switch_file_write(context->fd, data, len);
 }
 
@@ -180,6 +361,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_native_file_load)
 		supported_formats[x] = switch_core_strdup(pool, codecs[x]->iananame);
 	}
 
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&globals.maps, pool);
+
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 	file_interface = switch_loadable_module_create_interface(*module_interface, SWITCH_FILE_INTERFACE);
 	file_interface->interface_name = modname;
@@ -197,6 +381,14 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_native_file_load)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_native_file_shutdown)
+{
+	/* the module is only unloaded with no handle open, so nothing is mapped anymore */
+	switch_core_hash_destroy(&globals.maps);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
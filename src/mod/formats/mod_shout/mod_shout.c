@@ -42,6 +42,10 @@
 #define MP3_SCACHE 16384 * 2
 #define MP3_DCACHE 8192 * 2
 #define MP3_TOOSMALL -1234
+#define SHOUT_MAX_WORKERS 16
+#define SHOUT_WORK_QUEUE_LEN 1024
+/* how far past the encoder a recording may run before the session encodes it itself */
+#define SHOUT_WRITE_BACKLOG 8
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_shout_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_shout_shutdown);
@@ -56,6 +60,10 @@ static struct {
 	uint32_t brate;
 	uint32_t resample;
 	uint32_t quality;
+	uint32_t worker_threads;
+	switch_queue_t *work_queue;
+	switch_thread_t *workers[SHOUT_MAX_WORKERS];
+	switch_memory_pool_t *pool;
 } globals;
 
 mpg123_handle *our_mpg123_new(const char *decoder, int *error)
@@ -139,21 +147,41 @@ struct shout_context {
 	unsigned char *mp3buf;
 	switch_size_t mp3buflen;
 	switch_thread_rwlock_t *rwlock;
+	/* local files: the worker pool decodes ahead of playback and encodes behind recording */
+	switch_mutex_t *codec_mutex;
+	int queued;
+	switch_size_t read_ahead;
+	switch_size_t write_chunk;
+	int16_t *pcm;
 };
 
 typedef struct shout_context shout_context_t;
 
 static void decode_fd(shout_context_t *context, void *data, size_t bytes);
+static void encode_pending(shout_context_t *context);
 
 static inline void free_context(shout_context_t *context)
 {
 	int ret;
 
 	if (context) {
+		int queued;
+
 		switch_mutex_lock(context->audio_mutex);
 		context->err++;
 		switch_mutex_unlock(context->audio_mutex);
 
+		/* a worker may still hold it */
+		for (;;) {
+			switch_mutex_lock(context->audio_mutex);
+			queued = context->queued;
+			switch_mutex_unlock(context->audio_mutex);
+			if (!queued) {
+				break;
+			}
+			switch_yield(1000);
+		}
+
 		if (context->stream_url) {
 			int sanity = 0;
 
@@ -179,6 +207,9 @@ static inline void free_context(shout_context_t *context)
 			int len;
 			int16_t blank[2048] = { 0 }, *r = NULL;
 
+			if (context->audio_buffer) {
+				encode_pending(context);
+			}
 
 			if (context->channels == 2) {
 				r = blank;
@@ -331,42 +362,233 @@ static void log_msg(char const *fmt, va_list ap)
 	}
 }
 
-static void decode_fd(shout_context_t *context, void *data, size_t bytes)
+static switch_size_t audio_inuse(shout_context_t *context)
 {
-	int decode_status = 0;
-	size_t usedlen;
+	switch_size_t inuse;
 
-	while (!context->err && !context->eof && switch_buffer_inuse(context->audio_buffer) < bytes) {
-		usedlen = 0;
+	switch_mutex_lock(context->audio_mutex);
+	inuse = switch_buffer_inuse(context->audio_buffer);
+	switch_mutex_unlock(context->audio_mutex);
 
-		decode_status = mpg123_read(context->mh, context->decode_buf, sizeof(context->decode_buf), &usedlen);
+	return inuse;
+}
 
-		if (decode_status == MPG123_NEW_FORMAT) {
-			continue;
-		} else if (decode_status == MPG123_OK) {
-			;
-		} else if (decode_status == MPG123_DONE || decode_status == MPG123_NEED_MORE) {
+/* decodes one block of a local file into the audio buffer, call with the codec_mutex held */
+static switch_status_t decode_block(shout_context_t *context)
+{
+	int decode_status = 0;
+	size_t usedlen = 0;
+
+	decode_status = mpg123_read(context->mh, context->decode_buf, sizeof(context->decode_buf), &usedlen);
+
+	if (decode_status == MPG123_NEW_FORMAT) {
+		return SWITCH_STATUS_SUCCESS;
+	} else if (decode_status == MPG123_OK) {
+		;
+	} else if (decode_status == MPG123_DONE || decode_status == MPG123_NEED_MORE) {
+		context->eof++;
+	} else if (decode_status == MPG123_ERR || decode_status > 0) {
+		if (++context->mp3err >= 5) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Decoder Error!\n");
 			context->eof++;
-		} else if (decode_status == MPG123_ERR || decode_status > 0) {
-			if (++context->mp3err >= 5) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Decoder Error!\n");
-				context->eof++;
-				goto error;
-			}
-			continue;
+			switch_mutex_lock(context->audio_mutex);
+			context->err++;
+			switch_mutex_unlock(context->audio_mutex);
+			return SWITCH_STATUS_FALSE;
 		}
+		return SWITCH_STATUS_SUCCESS;
+	}
 
-		context->mp3err = 0;
+	context->mp3err = 0;
 
+	if (usedlen) {
+		switch_mutex_lock(context->audio_mutex);
 		switch_buffer_write(context->audio_buffer, context->decode_buf, usedlen);
+		switch_mutex_unlock(context->audio_mutex);
 	}
 
-	return;
+	return SWITCH_STATUS_SUCCESS;
+}
 
-  error:
-	switch_mutex_lock(context->audio_mutex);
-	context->err++;
-	switch_mutex_unlock(context->audio_mutex);
+static void decode_fd(shout_context_t *context, void *data, size_t bytes)
+{
+	while (!context->err && !context->eof && audio_inuse(context) < bytes) {
+		switch_mutex_lock(context->codec_mutex);
+		/* the worker may have filled it while we waited */
+		if (!context->eof && audio_inuse(context) < bytes) {
+			decode_block(context);
+		}
+		switch_mutex_unlock(context->codec_mutex);
+	}
+}
+
+/* encodes interleaved samples of a local recording, call with the codec_mutex held */
+static switch_status_t encode_pcm(shout_context_t *context, int16_t *audio, size_t nsamples)
+{
+	int rlen = 0;
+
+	if (!context->lame_ready) {
+		lame_init_params(context->gfp);
+		lame_print_config(context->gfp);
+		context->lame_ready = 1;
+	}
+
+	if (context->mp3buflen < nsamples * 4) {
+		context->mp3buflen = nsamples * 4;
+		context->mp3buf = switch_core_alloc(context->memory_pool, context->mp3buflen);
+	}
+
+	if (context->channels == 2) {
+		switch_size_t i, j = 0;
+
+		if (context->llen < nsamples) {
+			context->l = switch_core_alloc(context->memory_pool, nsamples * 2);
+			context->r = switch_core_alloc(context->memory_pool, nsamples * 2);
+			context->llen = context->rlen = nsamples;
+		}
+
+		for (i = 0; i < nsamples; i++) {
+			context->l[i] = audio[j++];
+			context->r[i] = audio[j++];
+		}
+
+		if ((rlen = lame_encode_buffer(context->gfp, context->l, context->r, nsamples, context->mp3buf, context->mp3buflen)) < 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "MP3 encode error %d!\n", rlen);
+			return SWITCH_STATUS_FALSE;
+		}
+
+	} else if (context->channels == 1) {
+		if ((rlen = lame_encode_buffer(context->gfp, audio, NULL, nsamples, context->mp3buf, context->mp3buflen)) < 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "MP3 encode error %d!\n", rlen);
+			return SWITCH_STATUS_FALSE;
+		}
+	} else {
+		rlen = 0;
+	}
+
+	if (rlen) {
+		int ret = fwrite(context->mp3buf, 1, rlen, context->fp);
+		if (ret < 0) {
+			return SWITCH_STATUS_FALSE;
+		}
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* encodes whatever a local recording has buffered */
+static void encode_pending(shout_context_t *context)
+{
+	switch_size_t bytes;
+
+	switch_mutex_lock(context->codec_mutex);
+
+	for (;;) {
+		switch_mutex_lock(context->audio_mutex);
+		bytes = switch_buffer_read(context->audio_buffer, context->pcm, context->write_chunk);
+		switch_mutex_unlock(context->audio_mutex);
+
+		if (!bytes) {
+			break;
+		}
+
+		if (encode_pcm(context, context->pcm, bytes / (sizeof(int16_t) * context->channels)) != SWITCH_STATUS_SUCCESS) {
+			switch_mutex_lock(context->audio_mutex);
+			context->err++;
+			switch_buffer_zero(context->audio_buffer);
+			switch_mutex_unlock(context->audio_mutex);
+			break;
+		}
+	}
+
+	switch_mutex_unlock(context->codec_mutex);
+}
+
+/* hand a local file to the worker pool, call with the audio_mutex held */
+static void queue_work(shout_context_t *context)
+{
+	if (context->queued || context->err || !globals.work_queue) {
+		return;
+	}
+
+	if (switch_queue_trypush(globals.work_queue, context) == SWITCH_STATUS_SUCCESS) {
+		context->queued = 1;
+	}
+}
+
+static void do_work(shout_context_t *context)
+{
+	if (context->err) {
+		return;
+	}
+
+	if (context->fp) {
+		encode_pending(context);
+		return;
+	}
+
+	while (!context->err && !context->eof && audio_inuse(context) < context->read_ahead) {
+		switch_mutex_lock(context->codec_mutex);
+		decode_block(context);
+		switch_mutex_unlock(context->codec_mutex);
+	}
+}
+
+static void *SWITCH_THREAD_FUNC shout_worker_thread(switch_thread_t *thread, void *obj)
+{
+	void *pop;
+
+	while (switch_queue_pop(globals.work_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		shout_context_t *context = (shout_context_t *) pop;
+
+		do_work(context);
+
+		switch_mutex_lock(context->audio_mutex);
+		context->queued = 0;
+		switch_mutex_unlock(context->audio_mutex);
+	}
+
+	return NULL;
+}
+
+static void start_workers(void)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	uint32_t i;
+
+	if (!globals.worker_threads) {
+		return;
+	}
+
+	switch_core_new_memory_pool(&globals.pool);
+	switch_queue_create(&globals.work_queue, SHOUT_WORK_QUEUE_LEN, globals.pool);
+
+	for (i = 0; i < globals.worker_threads; i++) {
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.workers[i], thd_attr, shout_worker_thread, NULL, globals.pool);
+	}
+}
+
+static void stop_workers(void)
+{
+	switch_status_t st;
+	uint32_t i;
+
+	if (!globals.work_queue) {
+		return;
+	}
+
+	for (i = 0; i < globals.worker_threads; i++) {
+		switch_queue_push(globals.work_queue, NULL);
+	}
+
+	for (i = 0; i < globals.worker_threads; i++) {
+		switch_thread_join(&st, globals.workers[i]);
+	}
+
+	globals.work_queue = NULL;
+	switch_core_destroy_memory_pool(&globals.pool);
 }
 
 static size_t stream_callback(void *ptr, size_t size, size_t nmemb, void *data)
@@ -647,6 +869,7 @@ static switch_status_t shout_file_open(switch_file_handle_t *handle, const char
 	switch_thread_rwlock_rdlock(context->rwlock);
 
 	switch_mutex_init(&context->audio_mutex, SWITCH_MUTEX_NESTED, context->memory_pool);
+	switch_mutex_init(&context->codec_mutex, SWITCH_MUTEX_NESTED, context->memory_pool);
 
 	if (switch_test_flag(handle, SWITCH_FILE_FLAG_READ)) {
 		if (switch_buffer_create_dynamic(&context->audio_buffer, TC_BUFFER_SIZE, TC_BUFFER_SIZE * 2, 0) != SWITCH_STATUS_SUCCESS) {
@@ -684,7 +907,7 @@ static switch_status_t shout_file_open(switch_file_handle_t *handle, const char
 				mpg123err = mpg123_strerror(context->mh);
 				goto error;
 			}
-
+			context->read_ahead = context->samplerate * sizeof(int16_t);
 		}
 	} else if (switch_test_flag(handle, SWITCH_FILE_FLAG_WRITE)) {
 		if (!(context->gfp = lame_init())) {
@@ -841,6 +1064,15 @@ static switch_status_t shout_file_open(switch_file_handle_t *handle, const char
 				lame_print_config(context->gfp);
 				context->lame_ready = 1;
 			}
+
+			if (globals.work_queue) {
+				context->write_chunk = (handle->samplerate / 4) * sizeof(int16_t) * handle->channels;
+				context->pcm = switch_core_alloc(context->memory_pool, context->write_chunk);
+				if (switch_buffer_create_dynamic(&context->audio_buffer, context->write_chunk, context->write_chunk * 2, 0) != SWITCH_STATUS_SUCCESS) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Memory Error!\n");
+					goto error;
+				}
+			}
 		}
 	}
 
@@ -886,8 +1118,12 @@ static switch_status_t shout_file_seek(switch_file_handle_t *handle, unsigned in
 			samples -= switch_buffer_inuse(context->audio_buffer) / sizeof(int16_t);
 		}
 
+		switch_mutex_lock(context->codec_mutex);
+		switch_mutex_lock(context->audio_mutex);
 		switch_buffer_zero(context->audio_buffer);
 		*cur_sample = mpg123_seek(context->mh, (off_t) samples, whence);
+		switch_mutex_unlock(context->audio_mutex);
+		switch_mutex_unlock(context->codec_mutex);
 
 		return *cur_sample >= 0 ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
 	}
@@ -909,6 +1145,10 @@ static switch_status_t shout_file_read(switch_file_handle_t *handle, void *data,
 
 	switch_mutex_lock(context->audio_mutex);
 	rb = switch_buffer_read(context->audio_buffer, data, bytes);
+	/* the core's I/O threads already read ahead of us when handle->io is set */
+	if (!handle->handler && !handle->io && !context->eof && switch_buffer_inuse(context->audio_buffer) < context->read_ahead / 2) {
+		queue_work(context);
+	}
 	switch_mutex_unlock(context->audio_mutex);
 
 	if (!rb && (context->eof || context->err)) {
@@ -939,7 +1179,6 @@ static switch_status_t shout_file_read(switch_file_handle_t *handle, void *data,
 static switch_status_t shout_file_write(switch_file_handle_t *handle, void *data, size_t *len)
 {
 	shout_context_t *context;
-	int rlen = 0;
 	int16_t *audio = data;
 	size_t nsamples = *len;
 
@@ -992,49 +1231,34 @@ static switch_status_t shout_file_write(switch_file_handle_t *handle, void *data
 		return SWITCH_STATUS_SUCCESS;
 	}
 
-	if (!context->lame_ready) {
-		lame_init_params(context->gfp);
-		lame_print_config(context->gfp);
-		context->lame_ready = 1;
-	}
-
-	if (context->mp3buflen < nsamples * 4) {
-		context->mp3buflen = nsamples * 4;
-		context->mp3buf = switch_core_alloc(context->memory_pool, context->mp3buflen);
-	}
-
-	if (handle->channels == 2) {
-		switch_size_t i, j = 0;
-
-		if (context->llen < nsamples) {
-			context->l = switch_core_alloc(context->memory_pool, nsamples * 2);
-			context->r = switch_core_alloc(context->memory_pool, nsamples * 2);
-			context->llen = context->rlen = nsamples;
-		}
+	if (context->audio_buffer && !handle->io) {
+		switch_size_t inuse;
 
-		for (i = 0; i < nsamples; i++) {
-			context->l[i] = audio[j++];
-			context->r[i] = audio[j++];
+		switch_mutex_lock(context->audio_mutex);
+		switch_buffer_write(context->audio_buffer, audio, nsamples * sizeof(int16_t) * context->channels);
+		inuse = switch_buffer_inuse(context->audio_buffer);
+		if (inuse >= context->write_chunk) {
+			queue_work(context);
 		}
+		switch_mutex_unlock(context->audio_mutex);
 
-		if ((rlen = lame_encode_buffer(context->gfp, context->l, context->r, nsamples, context->mp3buf, context->mp3buflen)) < 0) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "MP3 encode error %d!\n", rlen);
-			return SWITCH_STATUS_FALSE;
+		/* the workers are behind, keep the backlog bounded */
+		if (inuse > context->write_chunk * SHOUT_WRITE_BACKLOG) {
+			encode_pending(context);
 		}
+	} else {
+		switch_status_t status;
 
-	} else if (handle->channels == 1) {
-		if ((rlen = lame_encode_buffer(context->gfp, audio, NULL, nsamples, context->mp3buf, context->mp3buflen)) < 0) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "MP3 encode error %d!\n", rlen);
-			return SWITCH_STATUS_FALSE;
+		switch_mutex_lock(context->codec_mutex);
+		if (context->audio_buffer) {
+			/* anything queued before the core took over the writes goes first */
+			encode_pending(context);
 		}
-	} else {
-		rlen = 0;
-	}
+		status = encode_pcm(context, audio, nsamples);
+		switch_mutex_unlock(context->codec_mutex);
 
-	if (rlen) {
-		int ret = fwrite(context->mp3buf, 1, rlen, context->fp);
-		if (ret < 0) {
-			return SWITCH_STATUS_FALSE;
+		if (status != SWITCH_STATUS_SUCCESS) {
+			return status;
 		}
 	}
 
@@ -1497,6 +1721,7 @@ static switch_status_t load_config(void)
 	switch_xml_t cfg, xml, settings, param;
 
 	memset(&globals, 0, sizeof(globals));
+	globals.worker_threads = 2;
 
 	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Open of %s failed\n", cf);
@@ -1532,6 +1757,13 @@ static switch_status_t load_config(void)
 				if (tmp > 0) {
 					globals.quality = tmp;
 				}
+			} else if (!strcmp(var, "worker-threads")) {
+				int tmp = atoi(val);
+				if (tmp >= 0 && tmp <= SHOUT_MAX_WORKERS) {
+					globals.worker_threads = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "worker-threads must be between 0 and %d\n", SHOUT_MAX_WORKERS);
+				}
 			}
 		}
 	}
@@ -1566,6 +1798,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_shout_load)
 	shout_init();
 	mpg123_init();
 	load_config();
+	start_workers();
 
 	SWITCH_ADD_API(shout_api_interface, "telecast", "telecast", telecast_api_function, TELECAST_SYNTAX);
 
@@ -1575,6 +1808,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_shout_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_shout_shutdown)
 {
+	stop_workers();
 	mpg123_exit();
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -12,11 +12,146 @@ JavaSession::JavaSession(switch_core_session_t *session) : CoreSession(session)
 {
 }
 
+#define FRAME_TAP_PRIVATE "_java_frame_tap_"
+
+/* the frames are the session's own, the listener sees them through read only direct buffers that are made once per frame buffer */
+struct java_frame_tap
+{
+    switch_core_session_t *session;
+    jobject listener;
+    jmethodID onFrame;
+    jobject view[2];
+    void *viewData[2];
+    jlong viewLen[2];
+    int rate;
+};
+
+typedef struct java_frame_tap java_frame_tap_t;
+
+static jobject new_frame_view(JNIEnv *env, void *data, jlong len)
+{
+    jclass ByteBuffer = NULL, ByteOrder = NULL;
+    jobject direct = NULL, readOnly = NULL, order = NULL, ordered = NULL, view = NULL;
+    jmethodID asReadOnlyBuffer, orderMethod, nativeOrder;
+
+    if ((ByteBuffer = env->FindClass("java/nio/ByteBuffer")) == NULL ||
+        (ByteOrder = env->FindClass("java/nio/ByteOrder")) == NULL)
+        goto done;
+
+    if ((asReadOnlyBuffer = env->GetMethodID(ByteBuffer, "asReadOnlyBuffer", "()Ljava/nio/ByteBuffer;")) == NULL ||
+        (orderMethod = env->GetMethodID(ByteBuffer, "order", "(Ljava/nio/ByteOrder;)Ljava/nio/ByteBuffer;")) == NULL ||
+        (nativeOrder = env->GetStaticMethodID(ByteOrder, "nativeOrder", "()Ljava/nio/ByteOrder;")) == NULL)
+        goto done;
+
+    if ((direct = env->NewDirectByteBuffer(data, len)) == NULL ||
+        (readOnly = env->CallObjectMethod(direct, asReadOnlyBuffer)) == NULL ||
+        (order = env->CallStaticObjectMethod(ByteOrder, nativeOrder)) == NULL ||
+        (ordered = env->CallObjectMethod(readOnly, orderMethod, order)) == NULL)
+        goto done;
+
+    view = env->NewGlobalRef(ordered);
+
+done:
+    if (env->ExceptionCheck())
+        env->ExceptionDescribe();
+    if (ordered != NULL)
+        env->DeleteLocalRef(ordered);
+    if (order != NULL)
+        env->DeleteLocalRef(order);
+    if (readOnly != NULL)
+        env->DeleteLocalRef(readOnly);
+    if (direct != NULL)
+        env->DeleteLocalRef(direct);
+    if (ByteOrder != NULL)
+        env->DeleteLocalRef(ByteOrder);
+    if (ByteBuffer != NULL)
+        env->DeleteLocalRef(ByteBuffer);
+    return view;
+}
+
+static void free_frame_tap(java_frame_tap_t *tap)
+{
+    JNIEnv *env = mod_java_get_env();
+    int i;
+
+    if (env != NULL)
+    {
+        for (i = 0; i < 2; i++)
+            if (tap->view[i] != NULL)
+                env->DeleteGlobalRef(tap->view[i]);
+        if (tap->listener != NULL)
+            env->DeleteGlobalRef(tap->listener);
+    }
+    else
+        switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "error getting JNIEnv, memory leaked!\n");
+
+    free(tap);
+}
+
+static switch_bool_t frame_tap_callback(switch_media_bug_t *bug, void *user_data, switch_abc_type_t type)
+{
+    java_frame_tap_t *tap = (java_frame_tap_t *) user_data;
+    const switch_frame_t *frame = NULL;
+    JNIEnv *env;
+    int dir = 0;
+
+    switch (type)
+    {
+    case SWITCH_ABC_TYPE_TAP_READ:
+        frame = switch_core_media_bug_get_tap_read_frame(bug);
+        break;
+    case SWITCH_ABC_TYPE_TAP_WRITE:
+        frame = switch_core_media_bug_get_tap_write_frame(bug);
+        dir = 1;
+        break;
+    case SWITCH_ABC_TYPE_CLOSE:
+        {
+            switch_channel_t *channel = switch_core_session_get_channel(tap->session);
+            if (switch_channel_get_private(channel, FRAME_TAP_PRIVATE) == bug)
+                switch_channel_set_private(channel, FRAME_TAP_PRIVATE, NULL);
+            free_frame_tap(tap);
+        }
+        return SWITCH_TRUE;
+    default:
+        return SWITCH_TRUE;
+    }
+
+    if (frame == NULL || !frame->datalen || (env = mod_java_get_env()) == NULL)
+        return SWITCH_TRUE;
+
+    if (tap->viewData[dir] != frame->data || tap->viewLen[dir] < (jlong) frame->datalen)
+    {
+        if (tap->view[dir] != NULL)
+            env->DeleteGlobalRef(tap->view[dir]);
+        tap->viewData[dir] = frame->data;
+        tap->viewLen[dir] = frame->buflen > frame->datalen ? frame->buflen : frame->datalen;
+        if ((tap->view[dir] = new_frame_view(env, frame->data, tap->viewLen[dir])) == NULL)
+        {
+            tap->viewData[dir] = NULL;
+            return SWITCH_FALSE;
+        }
+    }
+
+    env->CallVoidMethod(tap->listener, tap->onFrame, tap->view[dir], (jint) frame->datalen,
+                        (jint) (frame->rate ? frame->rate : tap->rate), (jboolean) (dir ? JNI_TRUE : JNI_FALSE));
+    if (env->ExceptionCheck())
+    {
+        /* a listener that throws is taken off the session */
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+        return SWITCH_FALSE;
+    }
+
+    return SWITCH_TRUE;
+}
+
 JavaSession::~JavaSession()
 {
     JNIEnv *env;
     jint res;
 
+    stopFrameListener();
+
     res = javaVM->GetEnv((void**)&env, JNI_VERSION_1_4);
     if (res == JNI_OK)
     {
@@ -328,3 +463,68 @@ done:
     return status;
 }
 
+bool JavaSession::startFrameListener(jobject frameListener, bool readStream, bool writeStream)
+{
+    JNIEnv *env;
+    jclass klass;
+    java_frame_tap_t *tap;
+    switch_media_bug_t *bug = NULL;
+    switch_codec_implementation_t read_impl;
+    switch_media_bug_flag_t flags = SMBF_BOTH;
+
+    if (!session || !frameListener || (!readStream && !writeStream))
+        return false;
+
+    if ((env = mod_java_get_env()) == NULL)
+    {
+        switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "error getting JNIEnv!\n");
+        return false;
+    }
+
+    stopFrameListener();
+
+    if ((tap = (java_frame_tap_t *) calloc(1, sizeof(*tap))) == NULL)
+        return false;
+
+    tap->session = session;
+    memset(&read_impl, 0, sizeof(read_impl));
+    switch_core_session_get_read_impl(session, &read_impl);
+    tap->rate = read_impl.actual_samples_per_second;
+
+    klass = env->GetObjectClass(frameListener);
+    tap->onFrame = env->GetMethodID(klass, "onFrame", "(Ljava/nio/ByteBuffer;IIZ)V");
+    env->DeleteLocalRef(klass);
+    if (tap->onFrame == NULL || (tap->listener = env->NewGlobalRef(frameListener)) == NULL)
+    {
+        free_frame_tap(tap);
+        return false;
+    }
+
+    if (readStream)
+        flags = (switch_media_bug_flag_t) (flags | SMBF_TAP_READ);
+    if (writeStream)
+        flags = (switch_media_bug_flag_t) (flags | SMBF_TAP_WRITE);
+
+    if (switch_core_media_bug_add(session, "java_frame_listener", NULL, frame_tap_callback, tap, 0, flags, &bug) != SWITCH_STATUS_SUCCESS)
+    {
+        free_frame_tap(tap);
+        return false;
+    }
+
+    switch_channel_set_private(channel, FRAME_TAP_PRIVATE, bug);
+    return true;
+}
+
+void JavaSession::stopFrameListener()
+{
+    switch_media_bug_t *bug;
+
+    if (!session || !channel)
+        return;
+
+    if ((bug = (switch_media_bug_t *) switch_channel_get_private(channel, FRAME_TAP_PRIVATE)))
+    {
+        switch_channel_set_private(channel, FRAME_TAP_PRIVATE, NULL);
+        switch_core_media_bug_remove(session, &bug);
+    }
+}
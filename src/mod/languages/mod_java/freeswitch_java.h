@@ -6,6 +6,10 @@
 
 extern JavaVM *javaVM;
 
+#ifndef SWIG
+extern "C" JNIEnv *mod_java_get_env(void);
+#endif
+
 class JavaSession:public CoreSession {
   public:
 	JavaSession();
@@ -19,6 +23,10 @@ class JavaSession:public CoreSession {
 	void setHangupHook(jobject hangupHook);
 	virtual void check_hangup_hook();
 	virtual switch_status_t run_dtmf_callback(void *input, switch_input_type_t itype);
+
+	/** Hand every decoded frame of the session to frameListener, see org.freeswitch.FrameListener */
+	bool startFrameListener(jobject frameListener, bool readStream, bool writeStream);
+	void stopFrameListener();
 };
 
 #endif
@@ -22,6 +22,9 @@
 %typemap(jtype) jobject hangupHook "org.freeswitch.HangupHook"
 %typemap(jstype) jobject hangupHook "org.freeswitch.HangupHook"
 
+%typemap(jtype) jobject frameListener "org.freeswitch.FrameListener"
+%typemap(jstype) jobject frameListener "org.freeswitch.FrameListener"
+
 // Taken from various.i definitions for BYTE
 %typemap(jni) char *dtmf_buf "jbyteArray"
 %typemap(jtype) char *dtmf_buf "byte[]"
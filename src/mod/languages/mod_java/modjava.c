@@ -32,6 +32,7 @@
 
 #include <switch.h>
 #include <jni.h>
+#include <pthread.h>
 
 
 static switch_memory_pool_t *memoryPool = NULL;
@@ -39,6 +40,36 @@ static switch_dso_handle_t *javaVMHandle = NULL;
 
 JavaVM *javaVM = NULL;
 
+/* threads that mod_java_get_env() attached are detached by this key's destructor when they exit */
+static pthread_key_t attachedKey;
+static int attachedKeyCreated = 0;
+
+static switch_mutex_t *launcherMutex = NULL;
+static jclass launcherClass = NULL;
+static jmethodID launcherMethod = NULL;
+
+/* java apps handed to threads that stay attached to the VM instead of attaching the session thread */
+struct java_job {
+	const char *uuid;
+	const char *args;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	int done;
+};
+
+typedef struct java_job java_job_t;
+
+static struct {
+	switch_queue_t *queue;
+	switch_thread_t **threads;
+	uint32_t thread_count;
+	uint32_t idle;
+	switch_mutex_t *mutex;
+	int running;
+} executor;
+
+static int executorThreads = 0;
+
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_java_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_java_shutdown);
@@ -60,28 +91,83 @@ struct vm_control {
 typedef struct vm_control vm_control_t;
 static vm_control_t  vmControl;
 
-static void launch_java(switch_core_session_t *session, const char *data, JNIEnv *env)
+static void detach_thread(void *data)
 {
-    jclass Launcher = NULL;
-    jmethodID launch = NULL;
-    jstring uuid = NULL;
-    jstring args = NULL;
+    if (javaVM != NULL)
+        (*javaVM)->DetachCurrentThread(javaVM);
+}
+
+/* the JNIEnv of the calling thread, attaching it for the rest of its life if it is not attached yet */
+JNIEnv *mod_java_get_env(void)
+{
+    JNIEnv *env = NULL;
+    jint res;
+
+    if (javaVM == NULL)
+        return NULL;
+
+    res = (*javaVM)->GetEnv(javaVM, (void**) &env, JNI_VERSION_1_4);
+    if (res == JNI_EDETACHED)
+    {
+        if ((*javaVM)->AttachCurrentThreadAsDaemon(javaVM, (void**) &env, NULL) != JNI_OK)
+        {
+            switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error attaching thread to Java VM!\n");
+            return NULL;
+        }
+        if (attachedKeyCreated)
+            pthread_setspecific(attachedKey, javaVM);
+    }
+    else if (res != JNI_OK)
+        return NULL;
+
+    return env;
+}
+
+static switch_status_t find_launcher(JNIEnv *env)
+{
+    jclass Launcher;
+    switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+    switch_mutex_lock(launcherMutex);
+    if (launcherClass != NULL)
+        goto done;
 
     Launcher = (*env)->FindClass(env, "org/freeswitch/Launcher");
     if (Launcher == NULL)
     {
         (*env)->ExceptionDescribe(env);
+        status = SWITCH_STATUS_FALSE;
         goto done;
     }
 
-    launch = (*env)->GetStaticMethodID(env, Launcher, "launch", "(Ljava/lang/String;Ljava/lang/String;)V");
-    if (launch == NULL)
+    launcherMethod = (*env)->GetStaticMethodID(env, Launcher, "launch", "(Ljava/lang/String;Ljava/lang/String;)V");
+    if (launcherMethod == NULL)
     {
         (*env)->ExceptionDescribe(env);
+        (*env)->DeleteLocalRef(env, Launcher);
+        status = SWITCH_STATUS_FALSE;
         goto done;
     }
 
-    uuid = (*env)->NewStringUTF(env, switch_core_session_get_uuid(session));
+    launcherClass = (*env)->NewGlobalRef(env, Launcher);
+    (*env)->DeleteLocalRef(env, Launcher);
+    if (launcherClass == NULL)
+        status = SWITCH_STATUS_FALSE;
+
+done:
+    switch_mutex_unlock(launcherMutex);
+    return status;
+}
+
+static void launch_java(const char *session_uuid, const char *data, JNIEnv *env)
+{
+    jstring uuid = NULL;
+    jstring args = NULL;
+
+    if (find_launcher(env) != SWITCH_STATUS_SUCCESS)
+        goto done;
+
+    uuid = (*env)->NewStringUTF(env, session_uuid);
     if (uuid == NULL)
     {
         (*env)->ExceptionDescribe(env);
@@ -95,7 +181,7 @@ static void launch_java(switch_core_session_t *session, const char *data, JNIEnv
         goto done;
     }
 
-    (*env)->CallStaticVoidMethod(env, Launcher, launch, uuid, args);
+    (*env)->CallStaticVoidMethod(env, launcherClass, launcherMethod, uuid, args);
     if ((*env)->ExceptionOccurred(env))
         (*env)->ExceptionDescribe(env);
 
@@ -104,8 +190,143 @@ done:
         (*env)->DeleteLocalRef(env, args);
     if (uuid != NULL)
         (*env)->DeleteLocalRef(env, uuid);
-    if (Launcher != NULL)
-        (*env)->DeleteLocalRef(env, Launcher);
+}
+
+static void *SWITCH_THREAD_FUNC executor_thread(switch_thread_t *thread, void *obj)
+{
+    JNIEnv *env;
+    void *pop;
+
+    if ((*javaVM)->AttachCurrentThreadAsDaemon(javaVM, (void**) &env, NULL) != JNI_OK)
+    {
+        switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error attaching executor thread to Java VM!\n");
+        return NULL;
+    }
+
+    switch_mutex_lock(executor.mutex);
+    executor.idle++;
+    switch_mutex_unlock(executor.mutex);
+
+    while (executor.running)
+    {
+        java_job_t *job;
+
+        if (switch_queue_pop_timeout(executor.queue, &pop, 1000000) != SWITCH_STATUS_SUCCESS || !pop)
+            continue;
+
+        job = (java_job_t *) pop;
+        launch_java(job->uuid, job->args, env);
+
+        switch_mutex_lock(executor.mutex);
+        executor.idle++;
+        switch_mutex_unlock(executor.mutex);
+
+        switch_mutex_lock(job->mutex);
+        job->done = 1;
+        switch_thread_cond_signal(job->cond);
+        switch_mutex_unlock(job->mutex);
+    }
+
+    switch_mutex_lock(executor.mutex);
+    executor.idle--;
+    switch_mutex_unlock(executor.mutex);
+
+    /* let go of anything that was queued after the others stopped looking */
+    while (switch_queue_trypop(executor.queue, &pop) == SWITCH_STATUS_SUCCESS && pop)
+    {
+        java_job_t *job = (java_job_t *) pop;
+
+        switch_mutex_lock(job->mutex);
+        job->done = 1;
+        switch_thread_cond_signal(job->cond);
+        switch_mutex_unlock(job->mutex);
+    }
+
+    (*javaVM)->DetachCurrentThread(javaVM);
+    return NULL;
+}
+
+static void executor_start(void)
+{
+    switch_threadattr_t *thd_attr = NULL;
+    uint32_t i;
+
+    if (executorThreads <= 0)
+        return;
+
+    switch_mutex_init(&executor.mutex, SWITCH_MUTEX_NESTED, memoryPool);
+    switch_queue_create(&executor.queue, executorThreads, memoryPool);
+    executor.threads = switch_core_alloc(memoryPool, executorThreads * sizeof(switch_thread_t *));
+    executor.running = 1;
+
+    switch_threadattr_create(&thd_attr, memoryPool);
+    switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+    for (i = 0; i < (uint32_t) executorThreads; i++)
+    {
+        if (switch_thread_create(&executor.threads[i], thd_attr, executor_thread, NULL, memoryPool) != SWITCH_STATUS_SUCCESS)
+            break;
+        executor.thread_count++;
+    }
+
+    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Started %u Java executor threads\n", executor.thread_count);
+}
+
+static void executor_stop(void)
+{
+    switch_status_t st;
+    uint32_t i;
+
+    if (!executor.thread_count)
+        return;
+
+    executor.running = 0;
+    for (i = 0; i < executor.thread_count; i++)
+        switch_thread_join(&st, executor.threads[i]);
+    executor.thread_count = 0;
+}
+
+/* runs the app on an idle executor thread and waits for it, SWITCH_STATUS_FALSE if none is idle */
+static switch_status_t executor_launch(switch_core_session_t *session, const char *data)
+{
+    java_job_t job = { 0 };
+    int claimed = 0;
+
+    if (!executor.thread_count)
+        return SWITCH_STATUS_FALSE;
+
+    switch_mutex_lock(executor.mutex);
+    if (executor.running && executor.idle > 0)
+    {
+        executor.idle--;
+        claimed = 1;
+    }
+    switch_mutex_unlock(executor.mutex);
+
+    if (!claimed)
+        return SWITCH_STATUS_FALSE;
+
+    job.uuid = switch_core_session_get_uuid(session);
+    job.args = data;
+    switch_mutex_init(&job.mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session));
+    switch_thread_cond_create(&job.cond, switch_core_session_get_pool(session));
+
+    switch_mutex_lock(job.mutex);
+    if (switch_queue_trypush(executor.queue, &job) != SWITCH_STATUS_SUCCESS)
+    {
+        switch_mutex_unlock(job.mutex);
+        switch_mutex_lock(executor.mutex);
+        executor.idle++;
+        switch_mutex_unlock(executor.mutex);
+        return SWITCH_STATUS_FALSE;
+    }
+
+    /* the app drives the session from the executor thread, this one only waits for it to return */
+    while (!job.done)
+        switch_thread_cond_wait(job.cond, job.mutex);
+    switch_mutex_unlock(job.mutex);
+
+    return SWITCH_STATUS_SUCCESS;
 }
 
 static switch_status_t exec_user_method(user_method_t * userMethod) {
@@ -177,10 +398,21 @@ SWITCH_STANDARD_APP(java_function)
     if (javaVM == NULL)
         return;
 
+    if (executor_launch(session, data) == SWITCH_STATUS_SUCCESS)
+        return;
+
+    res = (*javaVM)->GetEnv(javaVM, (void**) &env, JNI_VERSION_1_4);
+    if (res == JNI_OK)
+    {
+        /* already attached for good by mod_java_get_env(), leave it that way */
+        launch_java(switch_core_session_get_uuid(session), data, env);
+        return;
+    }
+
     res = (*javaVM)->AttachCurrentThread(javaVM, (void*) &env, NULL);
     if (res == JNI_OK)
     {
-        launch_java(session, data, env);
+        launch_java(switch_core_session_get_uuid(session), data, env);
         (*javaVM)->DetachCurrentThread(javaVM);
     }
     else
@@ -199,6 +431,7 @@ static switch_status_t load_config(JavaVMOption **javaOptions, int *optionCount,
         switch_xml_t options;
         switch_xml_t startup;
         switch_xml_t shutdown;
+        switch_xml_t executorConf;
 
         javavm = switch_xml_child(cfg, "javavm");
         if (javavm != NULL)
@@ -265,6 +498,18 @@ static switch_status_t load_config(JavaVMOption **javaOptions, int *optionCount,
 	<shutdown class="net/cog/fs/system/Control" method="shutdown" arg="shutdown arg"/>
 	*/
 
+        executorThreads = 0;
+        executorConf = switch_xml_child(cfg, "executor");
+        if (executorConf != NULL)
+        {
+            executorThreads = atoi(switch_xml_attr_soft(executorConf, "threads"));
+            if (executorThreads < 0 || executorThreads > 1024)
+            {
+                switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "executor threads must be between 0 and 1024\n");
+                executorThreads = 0;
+            }
+        }
+
         memset(vmControl, 0, sizeof(struct vm_control));
         startup = switch_xml_child(cfg, "startup");
         if (startup != NULL) {
@@ -356,6 +601,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_java_load)
             if (status == SWITCH_STATUS_SUCCESS) {
 				status = exec_user_method(&vmControl.startup);
                 if (status == SWITCH_STATUS_SUCCESS){
+                    switch_mutex_init(&launcherMutex, SWITCH_MUTEX_NESTED, memoryPool);
+                    if (!attachedKeyCreated && pthread_key_create(&attachedKey, detach_thread) == 0)
+                        attachedKeyCreated = 1;
+                    executor_start();
                     return SWITCH_STATUS_SUCCESS;
                 }
 			}
@@ -375,6 +624,20 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_java_shutdown)
     if (javaVM == NULL)
         return SWITCH_STATUS_FALSE;
 
+    executor_stop();
+
+    if (launcherClass != NULL)
+    {
+        JNIEnv *env;
+        if ((*javaVM)->AttachCurrentThread(javaVM, (void*) &env, NULL) == JNI_OK)
+        {
+            (*env)->DeleteGlobalRef(env, launcherClass);
+            (*javaVM)->DetachCurrentThread(javaVM);
+        }
+        launcherClass = NULL;
+        launcherMethod = NULL;
+    }
+
     exec_user_method(&vmControl.shutdown);
     (*javaVM)->DestroyJavaVM(javaVM);
     javaVM = NULL;
@@ -0,0 +1,17 @@
+package org.freeswitch;
+
+import java.nio.ByteBuffer;
+
+public interface FrameListener
+{
+    /**
+     * Called from the media thread with every decoded frame of the session.
+     * The buffer is a read only view straight onto the frame, it is only valid
+     * for the duration of the call and must be copied to be kept.
+     * @param frame the frame data in native byte order
+     * @param length the number of valid bytes in frame
+     * @param rate the sample rate
+     * @param write true for a frame written to the channel, false for one read from it
+     */
+    public void onFrame(ByteBuffer frame, int length, int rate, boolean write);
+}
@@ -12,6 +12,7 @@ package org.freeswitch;
 import java.io.*;
 import java.net.*;
 import java.lang.reflect.*;
+import java.util.*;
 
 /**
  *
@@ -42,6 +43,32 @@ public class Launcher
         }
     }
 
+    private static class CachedLoader
+    {
+        long lastModified;
+        URLClassLoader classLoader;
+    }
+
+    private static final Map<String, CachedLoader> classLoaders = new HashMap<String, CachedLoader>();
+
+    /** One class loader per jar, so classes are only loaded again when the jar changes. */
+    private static synchronized ClassLoader getClassLoader(String jar) throws Exception
+    {
+        File file = new File(jar);
+        long lastModified = file.lastModified();
+        CachedLoader cached = classLoaders.get(jar);
+        if (cached == null || cached.lastModified != lastModified)
+        {
+            URL urls[] = new URL[1];
+            urls[0] = file.toURI().toURL();
+            cached = new CachedLoader();
+            cached.lastModified = lastModified;
+            cached.classLoader = new URLClassLoader(urls);
+            classLoaders.put(jar, cached);
+        }
+        return cached.classLoader;
+    }
+
     public static void launch(String sessionUuid, String args) throws Exception
     {
         String argv[] = args.split("[ ]");
@@ -59,10 +86,7 @@ public class Launcher
         {
             if (argv.length < 2)
                 throw new Exception("Too few arguments: must specify fully qualified class name when loading from JAR file");
-            URL urls[] = new URL[1];
-            urls[0] = new File(argv[0]).toURI().toURL();
-            URLClassLoader urlClassLoader = new URLClassLoader(urls);
-            klazz = Class.forName(argv[1], true, urlClassLoader);
+            klazz = Class.forName(argv[1], true, getClassLoader(argv[0]));
             argsOffset = argv[0].length() + argv[1].length() + 2;
         }
         else
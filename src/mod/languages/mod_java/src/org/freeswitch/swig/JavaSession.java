@@ -61,6 +61,14 @@ public class JavaSession extends CoreSession {
     freeswitchJNI.JavaSession_setHangupHook(swigCPtr, this, hangupHook);
   }
 
+  public boolean startFrameListener(org.freeswitch.FrameListener frameListener, boolean readStream, boolean writeStream) {
+    return freeswitchJNI.JavaSession_startFrameListener(swigCPtr, this, frameListener, readStream, writeStream);
+  }
+
+  public void stopFrameListener() {
+    freeswitchJNI.JavaSession_stopFrameListener(swigCPtr, this);
+  }
+
   public void check_hangup_hook() {
     freeswitchJNI.JavaSession_check_hangup_hook(swigCPtr, this);
   }
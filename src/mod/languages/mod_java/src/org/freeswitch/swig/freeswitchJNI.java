@@ -170,6 +170,8 @@ class freeswitchJNI {
   public final static native boolean JavaSession_end_allow_threads(long jarg1, JavaSession jarg1_);
   public final static native void JavaSession_setDTMFCallback(long jarg1, JavaSession jarg1_, org.freeswitch.DTMFCallback jarg2, String jarg3);
   public final static native void JavaSession_setHangupHook(long jarg1, JavaSession jarg1_, org.freeswitch.HangupHook jarg2);
+  public final static native boolean JavaSession_startFrameListener(long jarg1, JavaSession jarg1_, org.freeswitch.FrameListener jarg2, boolean jarg3, boolean jarg4);
+  public final static native void JavaSession_stopFrameListener(long jarg1, JavaSession jarg1_);
   public final static native void JavaSession_check_hangup_hook(long jarg1, JavaSession jarg1_);
   public final static native long JavaSession_run_dtmf_callback(long jarg1, JavaSession jarg1_, long jarg2, long jarg3);
   public final static native long SWIGJavaSessionUpcast(long jarg1);
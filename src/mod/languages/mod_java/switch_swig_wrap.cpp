@@ -3293,6 +3293,38 @@ SWIGEXPORT void JNICALL Java_org_freeswitch_swig_freeswitchJNI_JavaSession_1setH
 }
 
 
+SWIGEXPORT jboolean JNICALL Java_org_freeswitch_swig_freeswitchJNI_JavaSession_1startFrameListener(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_, jobject jarg2, jboolean jarg3, jboolean jarg4) {
+  jboolean jresult = 0 ;
+  JavaSession *arg1 = (JavaSession *) 0 ;
+  jobject arg2 ;
+  bool arg3 ;
+  bool arg4 ;
+  bool result;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(JavaSession **)&jarg1; 
+  arg2 = jarg2; 
+  arg3 = jarg3 ? true : false; 
+  arg4 = jarg4 ? true : false; 
+  result = (bool)(arg1)->startFrameListener(arg2,arg3,arg4);
+  jresult = (jboolean)result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void JNICALL Java_org_freeswitch_swig_freeswitchJNI_JavaSession_1stopFrameListener(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_) {
+  JavaSession *arg1 = (JavaSession *) 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(JavaSession **)&jarg1; 
+  (arg1)->stopFrameListener();
+}
+
+
 SWIGEXPORT void JNICALL Java_org_freeswitch_swig_freeswitchJNI_JavaSession_1check_1hangup_1hook(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_) {
   JavaSession *arg1 = (JavaSession *) 0 ;
   
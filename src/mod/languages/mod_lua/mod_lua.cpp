@@ -44,8 +44,25 @@ SWITCH_MODULE_DEFINITION_EX(mod_lua, mod_lua_load, mod_lua_shutdown, NULL, SMODF
 static struct {
 	switch_memory_pool_t *pool;
 	char *xml_handler;
+	switch_mutex_t *mutex;
+	switch_hash_t *chunk_hash;
+	switch_bool_t chunk_cache;
+	uint32_t state_pool_size;
+	lua_State **idle_states;
+	uint32_t idle_count;
 } globals;
 
+/* compiled scripts, keyed by path and checked against the file's mtime and size on every load */
+typedef struct {
+	char *name;
+	char *code;
+	size_t len;
+	time_t mtime;
+	off_t size;
+} lua_chunk_t;
+
+#define LUA_PRISTINE_KEY "mod_lua_pristine"
+
 int luaopen_freeswitch(lua_State * L);
 int lua_thread(const char *text);
 
@@ -128,6 +145,212 @@ static lua_State *lua_init(void)
 }
 
 
+static int lua_chunk_writer(lua_State * L, const void *p, size_t sz, void *ud)
+{
+	switch_buffer_write((switch_buffer_t *) ud, p, sz);
+	return 0;
+}
+
+static void lua_chunk_free(lua_chunk_t *chunk)
+{
+	switch_safe_free(chunk->code);
+	switch_safe_free(chunk->name);
+	free(chunk);
+}
+
+/* luaL_loadfile() that only parses a script again once it changed on disk */
+static int lua_load_script(lua_State * L, const char *file)
+{
+	struct stat st;
+	lua_chunk_t *chunk, *old;
+	switch_buffer_t *buffer = NULL;
+	int status;
+
+	if (!globals.chunk_cache || stat(file, &st)) {
+		return luaL_loadfile(L, file);
+	}
+
+	switch_mutex_lock(globals.mutex);
+	if ((chunk = (lua_chunk_t *) switch_core_hash_find(globals.chunk_hash, file)) && chunk->mtime == st.st_mtime && chunk->size == st.st_size) {
+		status = luaL_loadbuffer(L, chunk->code, chunk->len, chunk->name);
+		switch_mutex_unlock(globals.mutex);
+		return status;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	if ((status = luaL_loadfile(L, file))) {
+		return status;
+	}
+
+	switch_buffer_create_dynamic(&buffer, 4096, 4096, 0);
+	switch_assert(buffer);
+
+	if (!lua_dump(L, lua_chunk_writer, buffer) && switch_buffer_inuse(buffer)) {
+		chunk = (lua_chunk_t *) calloc(1, sizeof(*chunk));
+		switch_assert(chunk);
+		chunk->len = switch_buffer_inuse(buffer);
+		chunk->code = (char *) malloc(chunk->len);
+		switch_assert(chunk->code);
+		switch_buffer_read(buffer, chunk->code, chunk->len);
+		chunk->name = switch_mprintf("@%s", file);
+		chunk->mtime = st.st_mtime;
+		chunk->size = st.st_size;
+
+		switch_mutex_lock(globals.mutex);
+		if ((old = (lua_chunk_t *) switch_core_hash_find(globals.chunk_hash, file))) {
+			lua_chunk_free(old);
+		}
+		switch_core_hash_insert(globals.chunk_hash, file, chunk);
+		switch_mutex_unlock(globals.mutex);
+	}
+
+	switch_buffer_destroy(&buffer);
+
+	return 0;
+}
+
+/* copies[tbl] = a shallow copy of tbl, both are absolute stack indexes */
+static void lua_snapshot_table(lua_State * L, int copies, int tbl)
+{
+	lua_pushvalue(L, tbl);
+	lua_newtable(L);
+	lua_pushnil(L);
+	while (lua_next(L, tbl)) {
+		lua_pushvalue(L, -2);
+		lua_insert(L, -2);
+		lua_rawset(L, -4);
+	}
+	lua_rawset(L, copies);
+}
+
+/*
+ * A pooled state has to look fresh to the next script, so what a new state holds is remembered once: the globals,
+ * the fields of every library table and what require has loaded.  Putting that back between uses drops whatever a
+ * script added, including the session, stream and env objects handed to it, and undoes what it replaced.
+ */
+static void lua_snapshot_state(lua_State * L)
+{
+	int copies, top = lua_gettop(L);
+
+	lua_newtable(L);
+	copies = lua_gettop(L);
+
+	lua_pushnil(L);
+	while (lua_next(L, LUA_GLOBALSINDEX)) {
+		if (lua_istable(L, -1)) {
+			lua_snapshot_table(L, copies, lua_gettop(L));
+		}
+		lua_pop(L, 1);
+	}
+
+	lua_getfield(L, LUA_GLOBALSINDEX, "package");
+	if (lua_istable(L, -1)) {
+		lua_getfield(L, -1, "loaded");
+		if (lua_istable(L, -1)) {
+			lua_snapshot_table(L, copies, lua_gettop(L));
+		}
+		lua_pop(L, 1);
+	}
+	lua_pop(L, 1);
+
+	lua_setfield(L, LUA_REGISTRYINDEX, LUA_PRISTINE_KEY);
+	lua_settop(L, top);
+}
+
+static void lua_restore_table(lua_State * L, int tbl, int copy)
+{
+	/* clearing fields is fine while traversing, adding them is not */
+	lua_pushnil(L);
+	while (lua_next(L, tbl)) {
+		lua_pop(L, 1);
+		lua_pushvalue(L, -1);
+		lua_rawget(L, copy);
+		if (lua_isnil(L, -1)) {
+			lua_pushvalue(L, -2);
+			lua_pushnil(L);
+			lua_rawset(L, tbl);
+		}
+		lua_pop(L, 1);
+	}
+
+	lua_pushnil(L);
+	while (lua_next(L, copy)) {
+		lua_pushvalue(L, -2);
+		lua_insert(L, -2);
+		lua_rawset(L, tbl);
+	}
+}
+
+static void lua_reset_state(lua_State * L)
+{
+	int copies;
+
+	lua_settop(L, 0);
+	lua_sethook(L, NULL, 0, 0);
+
+	lua_getfield(L, LUA_REGISTRYINDEX, LUA_PRISTINE_KEY);
+	copies = lua_gettop(L);
+
+	lua_pushnil(L);
+	while (lua_next(L, copies)) {
+		lua_restore_table(L, lua_gettop(L) - 1, lua_gettop(L));
+		lua_pop(L, 1);
+	}
+
+	lua_pushnil(L);
+	lua_setmetatable(L, LUA_GLOBALSINDEX);
+	lua_settop(L, 0);
+
+	/* runs the finalizers of what the script left behind, a session object lets go of its session here */
+	lua_gc(L, LUA_GCCOLLECT, 0);
+}
+
+/* an idle state from the pool or a new one, give it back with lua_release_state() */
+static lua_State *lua_take_state(void)
+{
+	lua_State *L = NULL;
+
+	if (globals.state_pool_size) {
+		switch_mutex_lock(globals.mutex);
+		if (globals.idle_count) {
+			L = globals.idle_states[--globals.idle_count];
+		}
+		switch_mutex_unlock(globals.mutex);
+
+		if (!L && (L = lua_init())) {
+			lua_snapshot_state(L);
+		}
+
+		return L;
+	}
+
+	return lua_init();
+}
+
+static void lua_release_state(lua_State * L)
+{
+	if (!L) {
+		return;
+	}
+
+	if (globals.state_pool_size) {
+		lua_reset_state(L);
+
+		switch_mutex_lock(globals.mutex);
+		if (globals.idle_count < globals.state_pool_size) {
+			globals.idle_states[globals.idle_count++] = L;
+			L = NULL;
+		}
+		switch_mutex_unlock(globals.mutex);
+
+		if (!L) {
+			return;
+		}
+	}
+
+	lua_uninit(L);
+}
+
 static int lua_parse_and_execute(lua_State * L, char *input_code)
 {
 	int error = 0;
@@ -187,7 +410,7 @@ static int lua_parse_and_execute(lua_State * L, char *input_code)
 				switch_assert(fdup);
 				file = fdup;
 			}
-			error = luaL_loadfile(L, file) || docall(L, 0, 0, 0);
+			error = lua_load_script(L, file) || docall(L, 0, 0, 0);
 			switch_safe_free(fdup);
 		}
 	}
@@ -212,7 +435,7 @@ static void *SWITCH_THREAD_FUNC lua_thread_run(switch_thread_t *thread, void *ob
 {
 	struct lua_thread_helper *lth = (struct lua_thread_helper *) obj;
 	switch_memory_pool_t *pool = lth->pool;
-	lua_State *L = lua_init();	/* opens Lua */
+	lua_State *L = lua_take_state();	/* opens Lua */
 
 	lua_parse_and_execute(L, lth->input_code);
 
@@ -220,7 +443,7 @@ static void *SWITCH_THREAD_FUNC lua_thread_run(switch_thread_t *thread, void *ob
 
 	switch_core_destroy_memory_pool(&pool);
 
-	lua_uninit(L);
+	lua_release_state(L);
 
 	return NULL;
 }
@@ -233,7 +456,7 @@ static switch_xml_t lua_fetch(const char *section,
 	switch_xml_t xml = NULL;
 
 	if (!zstr(globals.xml_handler)) {
-		lua_State *L = lua_init();
+		lua_State *L = lua_take_state();
 		char *mycmd = strdup(globals.xml_handler);
 		const char *str;
 		int error;
@@ -262,6 +485,8 @@ static switch_xml_t lua_fetch(const char *section,
 
 		if( error = lua_parse_and_execute(L, mycmd) ){
 		    switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "LUA script parse/execute error!\n");
+			lua_release_state(L);
+			free(mycmd);
 		    return NULL;
 		}
 
@@ -279,7 +504,7 @@ static switch_xml_t lua_fetch(const char *section,
 			}
 		}
 
-		lua_uninit(L);
+		lua_release_state(L);
 		free(mycmd);
 	}
 
@@ -319,6 +544,16 @@ static switch_status_t do_config(void)
 					cpath_stream.write_function(&cpath_stream, ";");
 				}
 				cpath_stream.write_function(&cpath_stream, "%s", val);
+			} else if (!strcmp(var, "state-pool-size")) {
+				int tmp = atoi(val);
+
+				if (tmp >= 0 && tmp <= 1024) {
+					globals.state_pool_size = (uint32_t) tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "state-pool-size must be between 0 (off) and 1024\n");
+				}
+			} else if (!strcmp(var, "bytecode-cache")) {
+				globals.chunk_cache = switch_true(val) ? SWITCH_TRUE : SWITCH_FALSE;
 			} else if (!strcmp(var, "script-directory") && !zstr(val)) {
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "lua: appending script directory: '%s'\n", val);
 				if (path_stream.data_len) {
@@ -329,6 +564,10 @@ static switch_status_t do_config(void)
 		}
 	}
 
+	if (globals.state_pool_size) {
+		globals.idle_states = (lua_State **) switch_core_alloc(globals.pool, globals.state_pool_size * sizeof(lua_State *));
+	}
+
 	if (cpath_stream.data_len) {
 		char *lua_cpath = NULL;
 		if (lua_cpath = getenv("LUA_CPATH")) {
@@ -407,7 +646,7 @@ int lua_thread(const char *text)
 
 SWITCH_STANDARD_APP(lua_function)
 {
-	lua_State *L = lua_init();
+	lua_State *L;
 	char *mycmd;
 
 	if (zstr(data)) {
@@ -415,13 +654,15 @@ SWITCH_STANDARD_APP(lua_function)
 		return;
 	}
 
+	L = lua_take_state();
+
 	mod_lua_conjure_session(L, session, "session", 1);
 
 	mycmd = strdup((char *) data);
 	switch_assert(mycmd);
 
 	lua_parse_and_execute(L, mycmd);
-	lua_uninit(L);
+	lua_release_state(L);
 	free(mycmd);
 
 }
@@ -441,7 +682,7 @@ SWITCH_STANDARD_API(luarun_api_function)
 
 SWITCH_STANDARD_CHAT_APP(lua_chat_function)
 {
-	lua_State *L = lua_init();
+	lua_State *L = lua_take_state();
 	char *dup = NULL;
 
 	if (data) {
@@ -450,7 +691,7 @@ SWITCH_STANDARD_CHAT_APP(lua_chat_function)
 
 	mod_lua_conjure_event(L, message, "message", 1);
 	lua_parse_and_execute(L, (char *)dup);
-	lua_uninit(L);
+	lua_release_state(L);
 
 	switch_safe_free(dup);
 
@@ -461,7 +702,7 @@ SWITCH_STANDARD_CHAT_APP(lua_chat_function)
 SWITCH_STANDARD_API(lua_api_function)
 {
 
-	lua_State *L = lua_init();
+	lua_State *L;
 	char *mycmd;
 	int error;
 
@@ -469,6 +710,7 @@ SWITCH_STANDARD_API(lua_api_function)
 		stream->write_function(stream, "");
 	} else {
 
+		L = lua_take_state();
 		mycmd = strdup(cmd);
 		switch_assert(mycmd);
 
@@ -489,7 +731,7 @@ SWITCH_STANDARD_API(lua_api_function)
 				stream->write_function(stream, "-ERR encountered\n");
 			}
 		}
-		lua_uninit(L);
+		lua_release_state(L);
 		free(mycmd);
 	}
 	return SWITCH_STATUS_SUCCESS;
@@ -497,7 +739,7 @@ SWITCH_STANDARD_API(lua_api_function)
 
 SWITCH_STANDARD_DIALPLAN(lua_dialplan_hunt)
 {
-	lua_State *L = lua_init();
+	lua_State *L = lua_take_state();
 	switch_caller_extension_t *extension = NULL;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	char *cmd = NULL;
@@ -609,7 +851,7 @@ SWITCH_STANDARD_DIALPLAN(lua_dialplan_hunt)
 
  done:
 	switch_safe_free(cmd);
-	lua_uninit(L);
+	lua_release_state(L);
 	return extension;
 }
 
@@ -633,6 +875,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lua_load)
 
 
 	globals.pool = pool;
+	globals.chunk_cache = SWITCH_TRUE;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_core_hash_init(&globals.chunk_hash, globals.pool);
 	do_config();
 
 	/* indicate that the module should continue to be loaded */
@@ -641,6 +886,22 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lua_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_lua_shutdown)
 {
+	switch_hash_index_t *hi;
+	void *val;
+
+	switch_mutex_lock(globals.mutex);
+	while (globals.idle_count) {
+		lua_uninit(globals.idle_states[--globals.idle_count]);
+	}
+	globals.state_pool_size = 0;
+
+	for (hi = switch_hash_first(NULL, globals.chunk_hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		lua_chunk_free((lua_chunk_t *) val);
+	}
+	switch_core_hash_destroy(&globals.chunk_hash);
+	switch_mutex_unlock(globals.mutex);
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
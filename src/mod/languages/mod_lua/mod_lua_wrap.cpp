@@ -3822,6 +3822,156 @@ fail:
 }
 
 
+static int _wrap_EventConsumer_popBatch(lua_State* L) {
+  int SWIG_arg = -1;
+  EventConsumer *arg1 = (EventConsumer *) 0 ;
+  int arg2 = (int) 100 ;
+  int arg3 = (int) 0 ;
+  int result;
+  
+  SWIG_check_num_args("popBatch",1,3)
+  if(!SWIG_isptrtype(L,1)) SWIG_fail_arg("popBatch",1,"EventConsumer *");
+  if(lua_gettop(L)>=2 && !lua_isnumber(L,2)) SWIG_fail_arg("popBatch",2,"int");
+  if(lua_gettop(L)>=3 && !lua_isnumber(L,3)) SWIG_fail_arg("popBatch",3,"int");
+  
+  if (!SWIG_IsOK(SWIG_ConvertPtr(L,1,(void**)&arg1,SWIGTYPE_p_EventConsumer,0))){
+    SWIG_fail_ptr("EventConsumer_popBatch",1,SWIGTYPE_p_EventConsumer);
+  }
+  
+  if(lua_gettop(L)>=2){
+    arg2 = (int)lua_tonumber(L, 2);
+  }
+  if(lua_gettop(L)>=3){
+    arg3 = (int)lua_tonumber(L, 3);
+  }
+  result = (int)(arg1)->popBatch(arg2,arg3);
+  SWIG_arg=0;
+  lua_pushnumber(L, (lua_Number) result); SWIG_arg++; 
+  return SWIG_arg;
+  
+  if(0) SWIG_fail;
+  
+fail:
+  lua_error(L);
+  return SWIG_arg;
+}
+
+
+static int _wrap_EventConsumer_batchHeader(lua_State* L) {
+  int SWIG_arg = -1;
+  EventConsumer *arg1 = (EventConsumer *) 0 ;
+  int arg2 ;
+  char *arg3 = (char *) 0 ;
+  char *result = 0 ;
+  
+  SWIG_check_num_args("batchHeader",3,3)
+  if(!SWIG_isptrtype(L,1)) SWIG_fail_arg("batchHeader",1,"EventConsumer *");
+  if(!lua_isnumber(L,2)) SWIG_fail_arg("batchHeader",2,"int");
+  if(!lua_isstring(L,3)) SWIG_fail_arg("batchHeader",3,"char const *");
+  
+  if (!SWIG_IsOK(SWIG_ConvertPtr(L,1,(void**)&arg1,SWIGTYPE_p_EventConsumer,0))){
+    SWIG_fail_ptr("EventConsumer_batchHeader",1,SWIGTYPE_p_EventConsumer);
+  }
+  
+  arg2 = (int)lua_tonumber(L, 2);
+  arg3 = (char *)lua_tostring(L, 3);
+  result = (char *)(arg1)->batchHeader(arg2,(char const *)arg3);
+  SWIG_arg=0;
+  lua_pushstring(L,(const char*)result); SWIG_arg++; 
+  return SWIG_arg;
+  
+  if(0) SWIG_fail;
+  
+fail:
+  lua_error(L);
+  return SWIG_arg;
+}
+
+
+static int _wrap_EventConsumer_batchBody(lua_State* L) {
+  int SWIG_arg = -1;
+  EventConsumer *arg1 = (EventConsumer *) 0 ;
+  int arg2 ;
+  char *result = 0 ;
+  
+  SWIG_check_num_args("batchBody",2,2)
+  if(!SWIG_isptrtype(L,1)) SWIG_fail_arg("batchBody",1,"EventConsumer *");
+  if(!lua_isnumber(L,2)) SWIG_fail_arg("batchBody",2,"int");
+  
+  if (!SWIG_IsOK(SWIG_ConvertPtr(L,1,(void**)&arg1,SWIGTYPE_p_EventConsumer,0))){
+    SWIG_fail_ptr("EventConsumer_batchBody",1,SWIGTYPE_p_EventConsumer);
+  }
+  
+  arg2 = (int)lua_tonumber(L, 2);
+  result = (char *)(arg1)->batchBody(arg2);
+  SWIG_arg=0;
+  lua_pushstring(L,(const char*)result); SWIG_arg++; 
+  return SWIG_arg;
+  
+  if(0) SWIG_fail;
+  
+fail:
+  lua_error(L);
+  return SWIG_arg;
+}
+
+
+static int _wrap_EventConsumer_batchType(lua_State* L) {
+  int SWIG_arg = -1;
+  EventConsumer *arg1 = (EventConsumer *) 0 ;
+  int arg2 ;
+  char *result = 0 ;
+  
+  SWIG_check_num_args("batchType",2,2)
+  if(!SWIG_isptrtype(L,1)) SWIG_fail_arg("batchType",1,"EventConsumer *");
+  if(!lua_isnumber(L,2)) SWIG_fail_arg("batchType",2,"int");
+  
+  if (!SWIG_IsOK(SWIG_ConvertPtr(L,1,(void**)&arg1,SWIGTYPE_p_EventConsumer,0))){
+    SWIG_fail_ptr("EventConsumer_batchType",1,SWIGTYPE_p_EventConsumer);
+  }
+  
+  arg2 = (int)lua_tonumber(L, 2);
+  result = (char *)(arg1)->batchType(arg2);
+  SWIG_arg=0;
+  lua_pushstring(L,(const char*)result); SWIG_arg++; 
+  return SWIG_arg;
+  
+  if(0) SWIG_fail;
+  
+fail:
+  lua_error(L);
+  return SWIG_arg;
+}
+
+
+static int _wrap_EventConsumer_batchEvent(lua_State* L) {
+  int SWIG_arg = -1;
+  EventConsumer *arg1 = (EventConsumer *) 0 ;
+  int arg2 ;
+  Event *result = 0 ;
+  
+  SWIG_check_num_args("batchEvent",2,2)
+  if(!SWIG_isptrtype(L,1)) SWIG_fail_arg("batchEvent",1,"EventConsumer *");
+  if(!lua_isnumber(L,2)) SWIG_fail_arg("batchEvent",2,"int");
+  
+  if (!SWIG_IsOK(SWIG_ConvertPtr(L,1,(void**)&arg1,SWIGTYPE_p_EventConsumer,0))){
+    SWIG_fail_ptr("EventConsumer_batchEvent",1,SWIGTYPE_p_EventConsumer);
+  }
+  
+  arg2 = (int)lua_tonumber(L, 2);
+  result = (Event *)(arg1)->batchEvent(arg2);
+  SWIG_arg=0;
+  SWIG_NewPointerObj(L,result,SWIGTYPE_p_Event,1); SWIG_arg++; 
+  return SWIG_arg;
+  
+  if(0) SWIG_fail;
+  
+fail:
+  lua_error(L);
+  return SWIG_arg;
+}
+
+
 static void swig_delete_EventConsumer(void *obj) {
 EventConsumer *arg1 = (EventConsumer *) obj;
 delete arg1;
@@ -3829,6 +3979,11 @@ delete arg1;
 static swig_lua_method swig_EventConsumer_methods[] = {
     {"bind", _wrap_EventConsumer_bind}, 
     {"pop", _wrap_EventConsumer_pop}, 
+    {"popBatch", _wrap_EventConsumer_popBatch}, 
+    {"batchHeader", _wrap_EventConsumer_batchHeader}, 
+    {"batchBody", _wrap_EventConsumer_batchBody}, 
+    {"batchType", _wrap_EventConsumer_batchType}, 
+    {"batchEvent", _wrap_EventConsumer_batchEvent}, 
     {0,0}
 };
 static swig_lua_attribute swig_EventConsumer_attributes[] = {
@@ -5808,6 +5963,141 @@ fail:
 }
 
 
+static int _wrap_CoreSession_executeAsync(lua_State* L) {
+  int SWIG_arg = -1;
+  CoreSession *arg1 = (CoreSession *) 0 ;
+  char *arg2 = (char *) 0 ;
+  char *arg3 = (char *) NULL ;
+  char *arg4 = (char *) NULL ;
+  char *result = 0 ;
+  
+  SWIG_check_num_args("executeAsync",2,4)
+  if(!SWIG_isptrtype(L,1)) SWIG_fail_arg("executeAsync",1,"CoreSession *");
+  if(!lua_isstring(L,2)) SWIG_fail_arg("executeAsync",2,"char const *");
+  if(lua_gettop(L)>=3 && !lua_isstring(L,3)) SWIG_fail_arg("executeAsync",3,"char const *");
+  if(lua_gettop(L)>=4 && !lua_isstring(L,4)) SWIG_fail_arg("executeAsync",4,"char const *");
+  
+  if (!SWIG_IsOK(SWIG_ConvertPtr(L,1,(void**)&arg1,SWIGTYPE_p_CoreSession,0))){
+    SWIG_fail_ptr("CoreSession_executeAsync",1,SWIGTYPE_p_CoreSession);
+  }
+  
+  arg2 = (char *)lua_tostring(L, 2);
+  if(lua_gettop(L)>=3){
+    arg3 = (char *)lua_tostring(L, 3);
+  }
+  if(lua_gettop(L)>=4){
+    arg4 = (char *)lua_tostring(L, 4);
+  }
+  result = (char *)(arg1)->executeAsync((char const *)arg2,(char const *)arg3,(char const *)arg4);
+  SWIG_arg=0;
+  lua_pushstring(L,(const char*)result); SWIG_arg++;
+  return SWIG_arg;
+  
+  if(0) SWIG_fail;
+  
+fail:
+  lua_error(L);
+  return SWIG_arg;
+}
+
+
+static int _wrap_CoreSession_streamFileAsync(lua_State* L) {
+  int SWIG_arg = -1;
+  CoreSession *arg1 = (CoreSession *) 0 ;
+  char *arg2 = (char *) 0 ;
+  char *arg3 = (char *) NULL ;
+  char *result = 0 ;
+  
+  SWIG_check_num_args("streamFileAsync",2,3)
+  if(!SWIG_isptrtype(L,1)) SWIG_fail_arg("streamFileAsync",1,"CoreSession *");
+  if(!lua_isstring(L,2)) SWIG_fail_arg("streamFileAsync",2,"char *");
+  if(lua_gettop(L)>=3 && !lua_isstring(L,3)) SWIG_fail_arg("streamFileAsync",3,"char const *");
+  
+  if (!SWIG_IsOK(SWIG_ConvertPtr(L,1,(void**)&arg1,SWIGTYPE_p_CoreSession,0))){
+    SWIG_fail_ptr("CoreSession_streamFileAsync",1,SWIGTYPE_p_CoreSession);
+  }
+  
+  arg2 = (char *)lua_tostring(L, 2);
+  if(lua_gettop(L)>=3){
+    arg3 = (char *)lua_tostring(L, 3);
+  }
+  result = (char *)(arg1)->streamFileAsync(arg2,(char const *)arg3);
+  SWIG_arg=0;
+  lua_pushstring(L,(const char*)result); SWIG_arg++;
+  return SWIG_arg;
+  
+  if(0) SWIG_fail;
+  
+fail:
+  lua_error(L);
+  return SWIG_arg;
+}
+
+
+static int _wrap_CoreSession_playAndGetDigitsAsync(lua_State* L) {
+  int SWIG_arg = -1;
+  CoreSession *arg1 = (CoreSession *) 0 ;
+  int arg2 ;
+  int arg3 ;
+  int arg4 ;
+  int arg5 ;
+  char *arg6 = (char *) 0 ;
+  char *arg7 = (char *) 0 ;
+  char *arg8 = (char *) 0 ;
+  char *arg9 = (char *) 0 ;
+  char *arg10 = (char *) NULL ;
+  int arg11 = (int) 0 ;
+  char *arg12 = (char *) NULL ;
+  char *result = 0 ;
+  
+  SWIG_check_num_args("playAndGetDigitsAsync",9,12)
+  if(!SWIG_isptrtype(L,1)) SWIG_fail_arg("playAndGetDigitsAsync",1,"CoreSession *");
+  if(!lua_isnumber(L,2)) SWIG_fail_arg("playAndGetDigitsAsync",2,"int");
+  if(!lua_isnumber(L,3)) SWIG_fail_arg("playAndGetDigitsAsync",3,"int");
+  if(!lua_isnumber(L,4)) SWIG_fail_arg("playAndGetDigitsAsync",4,"int");
+  if(!lua_isnumber(L,5)) SWIG_fail_arg("playAndGetDigitsAsync",5,"int");
+  if(!lua_isstring(L,6)) SWIG_fail_arg("playAndGetDigitsAsync",6,"char *");
+  if(!lua_isstring(L,7)) SWIG_fail_arg("playAndGetDigitsAsync",7,"char *");
+  if(!lua_isstring(L,8)) SWIG_fail_arg("playAndGetDigitsAsync",8,"char *");
+  if(!lua_isstring(L,9)) SWIG_fail_arg("playAndGetDigitsAsync",9,"char *");
+  if(lua_gettop(L)>=10 && !lua_isstring(L,10)) SWIG_fail_arg("playAndGetDigitsAsync",10,"char const *");
+  if(lua_gettop(L)>=11 && !lua_isnumber(L,11)) SWIG_fail_arg("playAndGetDigitsAsync",11,"int");
+  if(lua_gettop(L)>=12 && !lua_isstring(L,12)) SWIG_fail_arg("playAndGetDigitsAsync",12,"char const *");
+  
+  if (!SWIG_IsOK(SWIG_ConvertPtr(L,1,(void**)&arg1,SWIGTYPE_p_CoreSession,0))){
+    SWIG_fail_ptr("CoreSession_playAndGetDigitsAsync",1,SWIGTYPE_p_CoreSession);
+  }
+  
+  arg2 = (int)lua_tonumber(L, 2);
+  arg3 = (int)lua_tonumber(L, 3);
+  arg4 = (int)lua_tonumber(L, 4);
+  arg5 = (int)lua_tonumber(L, 5);
+  arg6 = (char *)lua_tostring(L, 6);
+  arg7 = (char *)lua_tostring(L, 7);
+  arg8 = (char *)lua_tostring(L, 8);
+  arg9 = (char *)lua_tostring(L, 9);
+  if(lua_gettop(L)>=10){
+    arg10 = (char *)lua_tostring(L, 10);
+  }
+  if(lua_gettop(L)>=11){
+    arg11 = (int)lua_tonumber(L, 11);
+  }
+  if(lua_gettop(L)>=12){
+    arg12 = (char *)lua_tostring(L, 12);
+  }
+  result = (char *)(arg1)->playAndGetDigitsAsync(arg2,arg3,arg4,arg5,arg6,arg7,arg8,arg9,(char const *)arg10,arg11,(char const *)arg12);
+  SWIG_arg=0;
+  lua_pushstring(L,(const char*)result); SWIG_arg++;
+  return SWIG_arg;
+  
+  if(0) SWIG_fail;
+  
+fail:
+  lua_error(L);
+  return SWIG_arg;
+}
+
+
 static int _wrap_CoreSession_sendEvent(lua_State* L) {
   int SWIG_arg = -1;
   CoreSession *arg1 = (CoreSession *) 0 ;
@@ -6104,6 +6394,9 @@ static swig_lua_method swig_CoreSession_methods[] = {
     {"mediaReady", _wrap_CoreSession_mediaReady}, 
     {"waitForAnswer", _wrap_CoreSession_waitForAnswer}, 
     {"execute", _wrap_CoreSession_execute}, 
+    {"executeAsync", _wrap_CoreSession_executeAsync}, 
+    {"streamFileAsync", _wrap_CoreSession_streamFileAsync}, 
+    {"playAndGetDigitsAsync", _wrap_CoreSession_playAndGetDigitsAsync}, 
     {"sendEvent", _wrap_CoreSession_sendEvent}, 
     {"setEventData", _wrap_CoreSession_setEventData}, 
     {"getXMLCDR", _wrap_CoreSession_getXMLCDR}, 
@@ -62,6 +62,16 @@ SWITCH_MODULE_DEFINITION_EX(mod_python, mod_python_load, mod_python_shutdown, NU
 static struct {
 	switch_memory_pool_t *pool;
 	char *xml_handler;
+	/* imported modules are kept and only reloaded once their source changes, see python_module_changed() */
+	switch_bool_t module_cache;
+	switch_hash_t *module_hash;
+	switch_mutex_t *module_mutex;
+	/* python_async jobs, run one at a time per worker on a thread state the worker keeps */
+	uint32_t worker_threads;
+	uint32_t worker_queue_size;
+	switch_queue_t *job_queue;
+	switch_thread_t **workers;
+	int running;
 } globals;
 
 struct switch_py_thread {
@@ -168,6 +178,52 @@ static void print_python_error(const char * script)
 }
 
 
+/* true when the source of an imported module changed since it was last (re)loaded, call it holding the GIL */
+static switch_bool_t python_module_changed(const char *name, PyObject *module)
+{
+	PyObject *file;
+	char *path = NULL, *ext;
+	struct stat st;
+	time_t *mtime;
+	switch_bool_t changed = SWITCH_FALSE;
+
+	if (!(file = PyObject_GetAttrString(module, "__file__"))) {
+		PyErr_Clear();
+		return SWITCH_FALSE;
+	}
+
+	if (PyString_Check(file)) {
+		path = strdup(PyString_AsString(file));
+	}
+	Py_DECREF(file);
+
+	if (!path) {
+		return SWITCH_FALSE;
+	}
+
+	/* the compiled file is written by the import itself, the source is what gets edited */
+	if ((ext = strrchr(path, '.')) && (!strcmp(ext, ".pyc") || !strcmp(ext, ".pyo"))) {
+		*(ext + 3) = '\0';
+	}
+
+	if (!stat(path, &st)) {
+		switch_mutex_lock(globals.module_mutex);
+		if (!(mtime = switch_core_hash_find(globals.module_hash, name))) {
+			switch_zmalloc(mtime, sizeof(*mtime));
+			*mtime = st.st_mtime;
+			switch_core_hash_insert(globals.module_hash, name, mtime);
+		} else if (*mtime != st.st_mtime) {
+			*mtime = st.st_mtime;
+			changed = SWITCH_TRUE;
+		}
+		switch_mutex_unlock(globals.module_mutex);
+	}
+
+	free(path);
+
+	return changed;
+}
+
 static void eval_some_python(const char *funcname, char *args, switch_core_session_t *session, switch_stream_handle_t *stream, switch_event_t *params,
 							 char **str, struct switch_py_thread *pt)
 {
@@ -176,11 +232,13 @@ static void eval_some_python(const char *funcname, char *args, switch_core_sessi
 	char *argv[2] = { 0 };
 	int argc;
 	char *script = NULL;
-	PyObject *module = NULL, *sp = NULL, *stp = NULL, *eve = NULL;
+	PyObject *module = NULL, *reloaded, *sp = NULL, *stp = NULL, *eve = NULL;
 	PyObject *function = NULL;
 	PyObject *arg = NULL;
 	PyObject *result = NULL;
 	char *p;
+	/* a worker brings the thread state it keeps */
+	int own_tstate = !(pt && pt->tstate);
 
 	if (str) {
 		*str = NULL;
@@ -211,15 +269,19 @@ static void eval_some_python(const char *funcname, char *args, switch_core_sessi
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Invoking py module: %s\n", script);
 
-	tstate = PyThreadState_New(mainThreadState->interp);
-	if (!tstate) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "error acquiring tstate\n");
-		goto done;
-	}
+	if (own_tstate) {
+		tstate = PyThreadState_New(mainThreadState->interp);
+		if (!tstate) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "error acquiring tstate\n");
+			goto done;
+		}
 
-	/* Save state in thread struct so we can terminate it later if needed */
-	if (pt)
-		pt->tstate = tstate;
+		/* Save state in thread struct so we can terminate it later if needed */
+		if (pt)
+			pt->tstate = tstate;
+	} else {
+		tstate = pt->tstate;
+	}
 
 	// swap in thread state
 	PyEval_AcquireThread(tstate);
@@ -233,13 +295,16 @@ static void eval_some_python(const char *funcname, char *args, switch_core_sessi
 		PyErr_Clear();
 		goto done_swap_out;
 	}
-	// reload the module
-	module = PyImport_ReloadModule(module);
-	if (!module) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error reloading module\n");
-		print_python_error(script);
-		PyErr_Clear();
-		goto done_swap_out;
+	// reload the module, a cached one only when its source changed
+	if (!globals.module_cache || python_module_changed(script, module)) {
+		reloaded = PyImport_ReloadModule(module);
+		Py_DECREF(module);
+		if (!(module = reloaded)) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error reloading module\n");
+			print_python_error(script);
+			PyErr_Clear();
+			goto done_swap_out;
+		}
 	}
 	// get the handler function to be called
 	function = PyObject_GetAttrString(module, (char *) funcname);
@@ -307,7 +372,13 @@ static void eval_some_python(const char *funcname, char *args, switch_core_sessi
 		Py_DECREF(sp);
 	}
 
-	if (tstate) {
+	if (module) {
+		Py_DECREF(module);
+	}
+
+	if (tstate && !own_tstate) {
+		PyEval_ReleaseThread(tstate);
+	} else if (tstate) {
 		// thread state must be cleared explicitly or we'll get memory leaks
 		PyThreadState_Clear(tstate);
 		PyEval_ReleaseThread(tstate);
@@ -378,6 +449,22 @@ static switch_status_t do_config(void)
 				if (val) {
 					py_thread(val);
 				}
+			} else if (!strcmp(var, "module-cache")) {
+				globals.module_cache = switch_true(val) ? SWITCH_TRUE : SWITCH_FALSE;
+			} else if (!strcmp(var, "worker-threads")) {
+				int tmp = atoi(val);
+
+				if (tmp >= 0 && tmp <= 256) {
+					globals.worker_threads = (uint32_t) tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "worker-threads must be between 0 (off) and 256\n");
+				}
+			} else if (!strcmp(var, "worker-queue-size")) {
+				int tmp = atoi(val);
+
+				if (tmp > 0) {
+					globals.worker_queue_size = (uint32_t) tmp;
+				}
 			}
 		}
 	}
@@ -456,6 +543,120 @@ static void *SWITCH_THREAD_FUNC py_thread_run(switch_thread_t *thread, void *obj
 	return NULL;
 }
 
+/* a python_async worker, the thread state is made on this thread once and kept for every job it runs */
+static void *SWITCH_THREAD_FUNC py_worker_run(switch_thread_t *thread, void *obj)
+{
+	struct switch_py_thread *pt = (struct switch_py_thread *) obj;
+	void *pop = NULL;
+
+	PyEval_AcquireLock();
+	pt->tstate = PyThreadState_New(mainThreadState->interp);
+	PyEval_ReleaseLock();
+
+	if (!pt->tstate) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "error acquiring tstate for a worker\n");
+		return NULL;
+	}
+
+	switch_mutex_lock(THREAD_POOL_LOCK);
+	pt->next = thread_pool_head;
+	pt->prev = NULL;
+	if (pt->next)
+		pt->next->prev = pt;
+	thread_pool_head = pt;
+	switch_mutex_unlock(THREAD_POOL_LOCK);
+
+	while (globals.running) {
+		if (switch_queue_pop_timeout(globals.job_queue, &pop, 500000) != SWITCH_STATUS_SUCCESS || !pop) {
+			continue;
+		}
+
+		pt->args = (char *) pop;
+		eval_some_python("runtime", pt->args, NULL, NULL, NULL, NULL, pt);
+		pt->args = "(idle)";
+		free(pop);
+		pop = NULL;
+	}
+
+	switch_mutex_lock(THREAD_POOL_LOCK);
+	if (pt->next)
+		pt->next->prev = pt->prev;
+	if (pt->prev)
+		pt->prev->next = pt->next;
+	if (thread_pool_head == pt)
+		thread_pool_head = pt->next;
+	switch_mutex_unlock(THREAD_POOL_LOCK);
+
+	PyEval_AcquireThread(pt->tstate);
+	PyThreadState_Clear(pt->tstate);
+	PyEval_ReleaseThread(pt->tstate);
+	PyThreadState_Delete(pt->tstate);
+	pt->tstate = NULL;
+
+	return NULL;
+}
+
+static void py_workers_start(void)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	struct switch_py_thread *pt;
+	uint32_t i;
+
+	if (!globals.worker_threads) {
+		return;
+	}
+
+	if (!globals.worker_queue_size) {
+		globals.worker_queue_size = 1000;
+	}
+
+	switch_queue_create(&globals.job_queue, globals.worker_queue_size, globals.pool);
+	globals.workers = switch_core_alloc(globals.pool, globals.worker_threads * sizeof(switch_thread_t *));
+	globals.running = 1;
+
+	for (i = 0; i < globals.worker_threads; i++) {
+		pt = switch_core_alloc(globals.pool, sizeof(*pt));
+		pt->pool = globals.pool;
+		pt->args = "(idle)";
+
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.workers[i], thd_attr, py_worker_run, pt, globals.pool);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Started %u python worker threads\n", globals.worker_threads);
+}
+
+/* workers that are idle leave within half a second, busy ones once their job is done or killed */
+static void py_workers_stop(void)
+{
+	if (globals.running) {
+		globals.running = 0;
+		switch_yield(600000);
+	}
+}
+
+static void py_workers_join(void)
+{
+	switch_status_t st;
+	void *pop;
+	uint32_t i;
+
+	if (!globals.job_queue) {
+		return;
+	}
+
+	for (i = 0; i < globals.worker_threads; i++) {
+		if (globals.workers[i]) {
+			switch_thread_join(&st, globals.workers[i]);
+		}
+	}
+
+	while (switch_queue_trypop(globals.job_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		free(pop);
+	}
+}
+
 SWITCH_STANDARD_API(api_python)
 {
 
@@ -502,6 +703,84 @@ SWITCH_STANDARD_API(launch_python)
 }
 
 
+SWITCH_STANDARD_API(async_python)
+{
+	char *job;
+
+	if (zstr(cmd)) {
+		stream->write_function(stream, "-USAGE: python_async <module> [args]\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	/* without workers it is pyrun */
+	if (!globals.running) {
+		py_thread(cmd);
+		stream->write_function(stream, "+OK\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	job = strdup(cmd);
+	switch_assert(job);
+
+	if (switch_queue_trypush(globals.job_queue, job) != SWITCH_STATUS_SUCCESS) {
+		free(job);
+		stream->write_function(stream, "-ERR queue full\n");
+	} else {
+		stream->write_function(stream, "+OK queued\n");
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_STANDARD_API(reload_python)
+{
+	PyThreadState *tstate;
+	PyObject *module, *reloaded;
+	time_t *mtime;
+
+	if (zstr(cmd)) {
+		stream->write_function(stream, "-USAGE: python_reload <module>\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!(tstate = PyThreadState_New(mainThreadState->interp))) {
+		stream->write_function(stream, "-ERR error acquiring tstate\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	PyEval_AcquireThread(tstate);
+	init_freeswitch();
+
+	if ((module = PyImport_ImportModule((char *) cmd))) {
+		reloaded = PyImport_ReloadModule(module);
+		Py_DECREF(module);
+		module = reloaded;
+	}
+
+	if (module) {
+		Py_DECREF(module);
+		stream->write_function(stream, "+OK reloaded %s\n", cmd);
+	} else {
+		print_python_error(cmd);
+		PyErr_Clear();
+		stream->write_function(stream, "-ERR reloading %s failed\n", cmd);
+	}
+
+	PyThreadState_Clear(tstate);
+	PyEval_ReleaseThread(tstate);
+	PyThreadState_Delete(tstate);
+
+	/* start over with whatever is on disk now */
+	switch_mutex_lock(globals.module_mutex);
+	if ((mtime = switch_core_hash_find(globals.module_hash, cmd))) {
+		switch_core_hash_delete(globals.module_hash, cmd);
+		free(mtime);
+	}
+	switch_mutex_unlock(globals.module_mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_CHAT_APP(python_chat_function)
 {
 	eval_some_python("chat", (char *) data, NULL, NULL, message, NULL, NULL);
@@ -553,13 +832,19 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_python_load)
 	}
 
 	switch_mutex_init(&THREAD_POOL_LOCK, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&globals.module_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&globals.module_hash, pool);
+	globals.module_cache = SWITCH_TRUE;
 
 	do_config();
+	py_workers_start();
 
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 	SWITCH_ADD_API(api_interface, "pyrun", "run a python script", launch_python, "python </path/to/script>");
 	SWITCH_ADD_API(api_interface, "python", "run a python script", api_python, "python </path/to/script>");
+	SWITCH_ADD_API(api_interface, "python_async", "queue a python script on the worker threads", async_python, "<module> [args]");
+	SWITCH_ADD_API(api_interface, "python_reload", "reload a cached python module", reload_python, "<module>");
 	SWITCH_ADD_APP(app_interface, "python", "Launch python ivr", "Run a python ivr on a channel", python_function, "<script> [additional_vars [...]]",
 				   SAF_SUPPORT_NOMEDIA);
 	SWITCH_ADD_CHAT_APP(chat_app_interface, "python", "execute a python script", "execute a python script", python_chat_function, "<script>", SCAF_NONE);
@@ -577,8 +862,21 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_python_shutdown)
 	int thread_cnt = 0;
 	struct switch_py_thread *pt = NULL;
 	struct switch_py_thread *nextpt;
+	switch_hash_index_t *hi;
+	void *val;
 	int i;
 
+	/* workers finish the job they are on and go, what is still queued is dropped */
+	py_workers_stop();
+
+	switch_mutex_lock(globals.module_mutex);
+	for (hi = switch_hash_first(NULL, globals.module_hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		free(val);
+	}
+	switch_core_hash_destroy(&globals.module_hash);
+	switch_mutex_unlock(globals.module_mutex);
+
 	/* Kill all remaining threads */
 	pt = thread_pool_head;
 	PyEval_AcquireLock();
@@ -615,6 +913,8 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_python_shutdown)
 			pt = nextpt;
 		}
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Forcing python shutdown. This might cause freeswitch to crash!\n");
+	} else {
+		py_workers_join();
 	}
 
 
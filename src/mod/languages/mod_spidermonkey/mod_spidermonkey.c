@@ -88,6 +88,7 @@ static JSBool session_originate(JSContext * cx, JSObject * obj, uintN argc, jsva
 static JSBool session_set_callerdata(JSContext * cx, JSObject * obj, uintN argc, jsval * argv, jsval * rval);
 static switch_api_interface_t *js_run_interface = NULL;
 static switch_api_interface_t *jsapi_interface = NULL;
+static switch_api_interface_t *jsbench_interface = NULL;
 
 struct js_env {
 	size_t gStackChunkSize;
@@ -113,6 +114,33 @@ static struct {
 	switch_memory_pool_t *pool;
 } module_manager;
 
+/* a compiled script kept by a vm, checked against the file's mtime and size every time it runs */
+typedef struct {
+	JSScript *script;
+	JSObject *scrobj;
+	time_t mtime;
+	off_t size;
+} js_cached_script_t;
+
+/* a runtime and context that outlive one script, each run gets a fresh global object */
+typedef struct js_vm js_vm_t;
+struct js_vm {
+	struct js_env *env;
+	JSContext *cx;
+	JSObject *compile_scope;
+	switch_hash_t *scripts;
+	switch_memory_pool_t *pool;
+	js_vm_t *next;
+};
+
+static struct {
+	switch_mutex_t *mutex;
+	js_vm_t *idle;
+	uint32_t idle_count;
+	uint32_t pool_size;
+	switch_bool_t script_cache;
+} vm_manager;
+
 struct sm_loadable_module {
 	char *filename;
 	void *lib;
@@ -1016,8 +1044,29 @@ static switch_status_t load_modules(void)
 	switch_core_hash_init(&module_manager.mod_hash, module_manager.pool);
 	switch_core_hash_init(&module_manager.load_hash, module_manager.pool);
 
+	vm_manager.script_cache = SWITCH_TRUE;
+	vm_manager.pool_size = 0;
+
 	if ((xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
-		switch_xml_t mods, ld;
+		switch_xml_t mods, ld, settings, param;
+
+		if ((settings = switch_xml_child(cfg, "settings"))) {
+			for (param = switch_xml_child(settings, "param"); param; param = param->next) {
+				const char *var = switch_xml_attr_soft(param, "name");
+				const char *val = switch_xml_attr_soft(param, "value");
+
+				if (!strcasecmp(var, "context-pool-size")) {
+					int tmp = atoi(val);
+					if (tmp >= 0 && tmp <= 1024) {
+						vm_manager.pool_size = (uint32_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "context-pool-size must be between 0 and 1024\n");
+					}
+				} else if (!strcasecmp(var, "script-cache")) {
+					vm_manager.script_cache = switch_true(val);
+				}
+			}
+		}
 
 		if ((mods = switch_xml_child(cfg, "modules"))) {
 			for (ld = switch_xml_child(mods, "load"); ld; ld = ld->next) {
@@ -1058,6 +1107,151 @@ static switch_status_t init_js(struct js_env *env)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static js_vm_t *js_vm_create(void)
+{
+	switch_memory_pool_t *pool;
+	js_vm_t *vm;
+
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	vm = switch_core_alloc(pool, sizeof(*vm));
+	vm->pool = pool;
+	vm->env = switch_core_alloc(pool, sizeof(*vm->env));
+
+	if (init_js(vm->env) != SWITCH_STATUS_SUCCESS) {
+		switch_core_destroy_memory_pool(&pool);
+		return NULL;
+	}
+
+	if (!(vm->cx = JS_NewContext(vm->env->rt, vm->env->gStackChunkSize))) {
+		JS_DestroyRuntime(vm->env->rt);
+		switch_core_destroy_memory_pool(&pool);
+		return NULL;
+	}
+
+	JS_SetErrorReporter(vm->cx, js_error);
+	JS_SetContextPrivate(vm->cx, vm);
+	switch_core_hash_init(&vm->scripts, pool);
+
+	return vm;
+}
+
+static void js_vm_destroy(js_vm_t **vmp)
+{
+	js_vm_t *vm = *vmp;
+	switch_memory_pool_t *pool;
+	switch_hash_index_t *hi;
+	const void *key;
+	void *val;
+
+	*vmp = NULL;
+
+	for (hi = switch_hash_first(NULL, vm->scripts); hi; hi = switch_hash_next(hi)) {
+		js_cached_script_t *cs;
+
+		switch_hash_this(hi, &key, NULL, &val);
+		cs = (js_cached_script_t *) val;
+		JS_RemoveRootRT(vm->env->rt, &cs->scrobj);
+	}
+
+	if (vm->compile_scope) {
+		JS_RemoveRootRT(vm->env->rt, &vm->compile_scope);
+	}
+
+#ifdef JS_THREADSAFE
+	JS_SetContextThread(vm->cx);
+#endif
+	JS_DestroyContext(vm->cx);
+	JS_DestroyRuntime(vm->env->rt);
+	switch_core_hash_destroy(&vm->scripts);
+
+	pool = vm->pool;
+	switch_core_destroy_memory_pool(&pool);
+}
+
+/* 1 the script ran, 0 it failed, -1 it could not be loaded, -2 it is not something this vm caches */
+static int js_vm_eval_file(js_vm_t *vm, JSObject *obj, const char *file, jsval *rval)
+{
+	JSContext *cx = vm->cx;
+	js_cached_script_t *cs;
+	JSScript *script;
+	JSObject *scrobj;
+	struct stat st;
+
+	if (!vm_manager.script_cache || stat(file, &st)) {
+		return -2;
+	}
+
+	if (!(cs = (js_cached_script_t *) switch_core_hash_find(vm->scripts, file)) || cs->mtime != st.st_mtime || cs->size != st.st_size) {
+		/* functions are compiled against a scope of their own and cloned onto whatever global runs them */
+		if (!vm->compile_scope) {
+			if (!(vm->compile_scope = JS_NewObject(cx, &global_class, NULL, NULL))) {
+				return -2;
+			}
+			JS_AddNamedRoot(cx, &vm->compile_scope, "mod_spidermonkey compile scope");
+			JS_InitStandardClasses(cx, vm->compile_scope);
+		}
+
+		if (!(script = JS_CompileFile(cx, vm->compile_scope, file))) {
+			return -1;
+		}
+
+		if (!(scrobj = JS_NewScriptObject(cx, script))) {
+			JS_DestroyScript(cx, script);
+			return -1;
+		}
+
+		if (cs) {
+			JS_RemoveRoot(cx, &cs->scrobj);
+		} else {
+			cs = switch_core_alloc(vm->pool, sizeof(*cs));
+			switch_core_hash_insert(vm->scripts, file, cs);
+		}
+
+		cs->script = script;
+		cs->scrobj = scrobj;
+		cs->mtime = st.st_mtime;
+		cs->size = st.st_size;
+		JS_AddNamedRoot(cx, &cs->scrobj, "mod_spidermonkey cached script");
+	}
+
+	return JS_ExecuteScript(cx, obj, cs->script, rval) == JS_TRUE ? 1 : 0;
+}
+
+/* eval_some_js() that goes through the compiled script cache of the context's vm */
+static int js_eval_cached(const char *code, JSContext * cx, JSObject * obj, jsval * rval)
+{
+	js_vm_t *vm = (js_vm_t *) JS_GetContextPrivate(cx);
+	char *path = NULL;
+	const char *file;
+	int result = -2;
+
+	if (!vm || code[0] == '~' || !vm_manager.script_cache) {
+		return eval_some_js(code, cx, obj, rval);
+	}
+
+	if (switch_is_file_path(code)) {
+		file = code;
+	} else {
+		file = path = switch_mprintf("%s%s%s", SWITCH_GLOBAL_dirs.script_dir, SWITCH_PATH_SEPARATOR, code);
+	}
+
+	if (file) {
+		JS_ClearPendingException(cx);
+		result = js_vm_eval_file(vm, obj, file, rval);
+	}
+
+	switch_safe_free(path);
+
+	if (result == -2) {
+		result = eval_some_js(code, cx, obj, rval);
+	}
+
+	return result;
+}
+
 JSObject *new_js_event(switch_event_t *event, char *name, JSContext * cx, JSObject * obj)
 {
 	struct event_obj *eo;
@@ -3395,7 +3589,7 @@ static JSBool js_include(JSContext * cx, JSObject * obj, uintN argc, jsval * arg
 {
 	char *code;
 	if (argc > 0 && (code = JS_GetStringBytes(JS_ValueToString(cx, argv[0])))) {
-		if (eval_some_js(code, cx, obj, rval) <= 0) {
+		if (js_eval_cached(code, cx, obj, rval) <= 0) {
 			return JS_FALSE;
 		}
 		return JS_TRUE;
@@ -3628,7 +3822,53 @@ static int env_init(JSContext * cx, JSObject * javascript_object)
 	return 1;
 }
 
-static void js_parse_and_execute(switch_core_session_t *session, const char *input_code, struct request_obj *ro)
+static js_vm_t *js_vm_take(void)
+{
+	js_vm_t *vm = NULL;
+
+	switch_mutex_lock(vm_manager.mutex);
+	if ((vm = vm_manager.idle)) {
+		vm_manager.idle = vm->next;
+		vm_manager.idle_count--;
+		vm->next = NULL;
+	}
+	switch_mutex_unlock(vm_manager.mutex);
+
+	if (vm) {
+#ifdef JS_THREADSAFE
+		JS_SetContextThread(vm->cx);
+#endif
+		return vm;
+	}
+
+	return js_vm_create();
+}
+
+static void js_vm_release(js_vm_t *vm)
+{
+	if (vm_manager.pool_size) {
+		/* nothing is left that can reach the last global so this runs the finalizers of everything the script made */
+		JS_GC(vm->cx);
+#ifdef JS_THREADSAFE
+		JS_ClearContextThread(vm->cx);
+#endif
+
+		switch_mutex_lock(vm_manager.mutex);
+		if (vm_manager.idle_count < vm_manager.pool_size) {
+			vm->next = vm_manager.idle;
+			vm_manager.idle = vm;
+			vm_manager.idle_count++;
+			vm = NULL;
+		}
+		switch_mutex_unlock(vm_manager.mutex);
+	}
+
+	if (vm) {
+		js_vm_destroy(&vm);
+	}
+}
+
+static void js_vm_run(js_vm_t *vm, switch_core_session_t *session, const char *input_code, struct request_obj *ro)
 {
 	JSObject *javascript_global_object = NULL;
 	char buf[1024], *arg, *argv[512];
@@ -3636,34 +3876,22 @@ static void js_parse_and_execute(switch_core_session_t *session, const char *inp
 	int argc = 0, x = 0, y = 0;
 	unsigned int flags = 0;
 	struct js_session *jss = NULL;
-	JSContext *cx = NULL;
+	JSContext *cx = vm->cx;
 	jsval rval;
-	struct js_env env = { 0 };
-
-	if (zstr(input_code)) {
-		return;
-	}
 
-	init_js(&env);
+	JS_BeginRequest(cx);
+	JS_ClearPendingException(cx);
+	javascript_global_object = JS_NewObject(cx, &global_class, NULL, NULL);
+	env_init(cx, javascript_global_object);
+	JS_SetGlobalObject(cx, javascript_global_object);
 
-	if ((cx = JS_NewContext(env.rt, env.gStackChunkSize))) {
-		JS_BeginRequest(cx);
-		JS_SetErrorReporter(cx, js_error);
-		javascript_global_object = JS_NewObject(cx, &global_class, NULL, NULL);
-		env_init(cx, javascript_global_object);
-		JS_SetGlobalObject(cx, javascript_global_object);
-
-		/* Emaculent conception of session object into the script if one is available */
-		if (!(session && new_js_session(cx, javascript_global_object, session, &jss, "session", flags))) {
-			switch_snprintf(buf, sizeof(buf), "~var session = false;");
-			eval_some_js(buf, cx, javascript_global_object, &rval);
-		}
-		if (ro) {
-			new_request(cx, javascript_global_object, ro);
-		}
-
-	} else {
-		abort();
+	/* Emaculent conception of session object into the script if one is available */
+	if (!(session && new_js_session(cx, javascript_global_object, session, &jss, "session", flags))) {
+		switch_snprintf(buf, sizeof(buf), "~var session = false;");
+		eval_some_js(buf, cx, javascript_global_object, &rval);
+	}
+	if (ro) {
+		new_request(cx, javascript_global_object, ro);
 	}
 
 	script = input_code;
@@ -3691,15 +3919,28 @@ static void js_parse_and_execute(switch_core_session_t *session, const char *inp
 		}
 	}
 
-	if (cx) {
-		eval_some_js(script, cx, javascript_global_object, &rval);
-		JS_DestroyContext(cx);
-	}
+	js_eval_cached(script, cx, javascript_global_object, &rval);
 
+	JS_ClearPendingException(cx);
+	JS_ClearScope(cx, javascript_global_object);
+	JS_SetGlobalObject(cx, NULL);
+	JS_EndRequest(cx);
+}
 
-	JS_DestroyRuntime(env.rt);
+static void js_parse_and_execute(switch_core_session_t *session, const char *input_code, struct request_obj *ro)
+{
+	js_vm_t *vm;
 
-	return;
+	if (zstr(input_code)) {
+		return;
+	}
+
+	if (!(vm = js_vm_take())) {
+		abort();
+	}
+
+	js_vm_run(vm, session, input_code, ro);
+	js_vm_release(vm);
 }
 
 SWITCH_STANDARD_APP(js_dp_function)
@@ -3780,6 +4021,63 @@ SWITCH_STANDARD_API(jsapi_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* runs a script over and over, first on a new runtime every time and then on one that is kept, to see what a call costs */
+SWITCH_STANDARD_API(jsbench_function)
+{
+	char *mycmd = NULL, *script = NULL, *code;
+	int i, runs = 0, done = 0;
+	switch_time_t start, fresh = 0, kept = 0;
+	js_vm_t *vm;
+
+	if (!zstr(cmd) && (mycmd = strdup(cmd)) && (script = strchr(mycmd, ' '))) {
+		*script++ = '\0';
+		runs = atoi(mycmd);
+	}
+
+	if (runs <= 0 || zstr(script)) {
+		stream->write_function(stream, "USAGE: %s\n", jsbench_interface->syntax);
+		switch_safe_free(mycmd);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	start = switch_micro_time_now();
+	for (i = 0; i < runs; i++) {
+		if (!(vm = js_vm_create()) || !(code = strdup(script))) {
+			break;
+		}
+		js_vm_run(vm, NULL, code, NULL);
+		free(code);
+		js_vm_destroy(&vm);
+	}
+	fresh = switch_micro_time_now() - start;
+	done = i;
+
+	if (done == runs && (vm = js_vm_create())) {
+		start = switch_micro_time_now();
+		for (i = 0; i < runs; i++) {
+			if (!(code = strdup(script))) {
+				break;
+			}
+			js_vm_run(vm, NULL, code, NULL);
+			free(code);
+			JS_GC(vm->cx);
+		}
+		kept = switch_micro_time_now() - start;
+		js_vm_destroy(&vm);
+	}
+
+	if (done == runs && i == runs) {
+		stream->write_function(stream, "runs: %d\n", runs);
+		stream->write_function(stream, "new context: %" SWITCH_TIME_T_FMT "us per run\n", fresh / runs);
+		stream->write_function(stream, "kept context%s: %" SWITCH_TIME_T_FMT "us per run\n", vm_manager.script_cache ? " and script cache" : "", kept / runs);
+	} else {
+		stream->write_function(stream, "-ERR cannot create a context\n");
+	}
+
+	switch_safe_free(mycmd);
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_API(launch_async)
 {
 	if (zstr(cmd)) {
@@ -3805,10 +4103,13 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_spidermonkey_load)
 		return SWITCH_STATUS_FALSE;
 	}
 
+	switch_mutex_init(&vm_manager.mutex, SWITCH_MUTEX_NESTED, module_manager.pool);
+
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 	SWITCH_ADD_API(js_run_interface, "jsrun", "run a script", launch_async, "jsrun <script> [additional_vars [...]]");
 	SWITCH_ADD_API(jsapi_interface, "jsapi", "execute an api call", jsapi_function, "jsapi <script> [additional_vars [...]]");
+	SWITCH_ADD_API(jsbench_interface, "jsbench", "time a script on new and kept contexts", jsbench_function, "jsbench <runs> <script> [additional_vars [...]]");
 	SWITCH_ADD_APP(app_interface, "javascript", "Launch JS ivr", "Run a javascript ivr on a channel", js_dp_function, "<script> [additional_vars [...]]",
 				   SAF_SUPPORT_NOMEDIA);
 
@@ -3818,6 +4119,17 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_spidermonkey_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_spidermonkey_shutdown)
 {
+	js_vm_t *vm;
+
+	switch_mutex_lock(vm_manager.mutex);
+	while ((vm = vm_manager.idle)) {
+		vm_manager.idle = vm->next;
+		js_vm_destroy(&vm);
+	}
+	vm_manager.idle_count = 0;
+	vm_manager.pool_size = 0;
+	switch_mutex_unlock(vm_manager.mutex);
+
 	switch_core_hash_destroy(&module_manager.mod_hash);
 	switch_core_hash_destroy(&module_manager.load_hash);
 	return SWITCH_STATUS_SUCCESS;
@@ -43,10 +43,22 @@ SWITCH_MODULE_DEFINITION(mod_logfile, mod_logfile_load, mod_logfile_shutdown, NU
 static switch_memory_pool_t *module_pool = NULL;
 static switch_hash_t *profile_hash = NULL;
 
+typedef enum {
+	LOGFILE_OVERFLOW_BLOCK,
+	LOGFILE_OVERFLOW_DROP
+} logfile_overflow_t;
+
 static struct {
 	int rotate;
 	switch_mutex_t *mutex;
 	switch_event_node_t *node;
+	switch_size_t buffer_size;
+	int flush_interval;
+	int queue_size;
+	logfile_overflow_t overflow;
+	switch_queue_t *queue;
+	switch_thread_t *writer_thread;
+	int running;
 } globals;
 
 struct logfile_profile {
@@ -60,10 +72,23 @@ struct logfile_profile {
 	uint32_t all_level;
 	uint32_t suffix;			/* suffix of the highest logfile name */
 	switch_bool_t log_uuid;
+	struct logfile_chunk *chunk;	/* lines not yet handed to the writer thread */
+	switch_mutex_t *chunk_mutex;
+	switch_size_t dropped;		/* bytes lost to the overflow policy since the last write */
 };
 
 typedef struct logfile_profile logfile_profile_t;
 
+/* buffered lines on their way to the writer thread */
+struct logfile_chunk {
+	logfile_profile_t *profile;
+	switch_size_t len;
+	switch_size_t size;
+	char data[1];
+};
+
+typedef struct logfile_chunk logfile_chunk_t;
+
 static switch_status_t load_profile(switch_xml_t xml);
 
 #if 0
@@ -223,11 +248,10 @@ static switch_status_t mod_logfile_rotate(logfile_profile_t *profile)
 }
 
 /* write to the actual logfile */
-static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, char *log_data)
+static switch_status_t mod_logfile_file_write(logfile_profile_t *profile, const char *log_data, switch_size_t len)
 {
-	switch_size_t len;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
-	len = strlen(log_data);
+	switch_size_t bytes = len;
 
 	if (len <= 0 || !profile->log_afd) {
 		return SWITCH_STATUS_FALSE;
@@ -235,18 +259,18 @@ static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, char *l
 
 	switch_mutex_lock(globals.mutex);
 
-	if (switch_file_write(profile->log_afd, log_data, &len) != SWITCH_STATUS_SUCCESS) {
+	if (switch_file_write(profile->log_afd, log_data, &bytes) != SWITCH_STATUS_SUCCESS) {
 		switch_file_close(profile->log_afd);
 		if ((status = mod_logfile_openlogfile(profile, SWITCH_TRUE)) == SWITCH_STATUS_SUCCESS) {
-			len = strlen(log_data);
-			switch_file_write(profile->log_afd, log_data, &len);
+			bytes = len;
+			switch_file_write(profile->log_afd, log_data, &bytes);
 		}
 	}
 
 	switch_mutex_unlock(globals.mutex);
 
 	if (status == SWITCH_STATUS_SUCCESS) {
-		profile->log_size += len;
+		profile->log_size += bytes;
 
 		if (profile->roll_size && profile->log_size >= profile->roll_size) {
 			mod_logfile_rotate(profile);
@@ -256,6 +280,155 @@ static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, char *l
 	return status;
 }
 
+/* detach the pending lines from the profile, caller holds profile->chunk_mutex */
+static logfile_chunk_t *mod_logfile_take_chunk(logfile_profile_t *profile)
+{
+	logfile_chunk_t *chunk = profile->chunk;
+
+	profile->chunk = NULL;
+
+	return chunk;
+}
+
+static void mod_logfile_write_chunk(logfile_chunk_t *chunk)
+{
+	logfile_profile_t *profile = chunk->profile;
+	switch_size_t dropped;
+
+	switch_mutex_lock(profile->chunk_mutex);
+	dropped = profile->dropped;
+	profile->dropped = 0;
+	switch_mutex_unlock(profile->chunk_mutex);
+
+	if (dropped) {
+		char msg[128];
+		switch_snprintf(msg, sizeof(msg), "[mod_logfile] %" SWITCH_SIZE_T_FMT " bytes of log output dropped, writer could not keep up\n", dropped);
+		mod_logfile_file_write(profile, msg, strlen(msg));
+	}
+
+	mod_logfile_file_write(profile, chunk->data, chunk->len);
+	free(chunk);
+}
+
+/* hand the pending lines to the writer thread, caller holds profile->chunk_mutex */
+static void mod_logfile_commit(logfile_profile_t *profile)
+{
+	logfile_chunk_t *chunk;
+
+	if (!(chunk = mod_logfile_take_chunk(profile))) {
+		return;
+	}
+
+	if (switch_queue_trypush(globals.queue, chunk) == SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	if (globals.overflow == LOGFILE_OVERFLOW_DROP) {
+		profile->dropped += chunk->len;
+		free(chunk);
+	} else {
+		/* this only ever stalls the log thread, switch_log_vprintf() never waits on it */
+		switch_mutex_unlock(profile->chunk_mutex);
+		switch_queue_push(globals.queue, chunk);
+		switch_mutex_lock(profile->chunk_mutex);
+	}
+}
+
+static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, char *log_data)
+{
+	switch_size_t len = strlen(log_data);
+	logfile_chunk_t *chunk;
+
+	if (!globals.queue) {
+		return mod_logfile_file_write(profile, log_data, len);
+	}
+
+	if (len <= 0) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(profile->chunk_mutex);
+
+	if (profile->chunk && profile->chunk->len + len > profile->chunk->size) {
+		mod_logfile_commit(profile);
+	}
+
+	if (!(chunk = profile->chunk)) {
+		switch_size_t size = len > globals.buffer_size ? len : globals.buffer_size;
+
+		chunk = malloc(sizeof(*chunk) + size);
+		switch_assert(chunk);
+		chunk->profile = profile;
+		chunk->len = 0;
+		chunk->size = size;
+		profile->chunk = chunk;
+	}
+
+	memcpy(chunk->data + chunk->len, log_data, len);
+	chunk->len += len;
+
+	if (chunk->len >= chunk->size) {
+		mod_logfile_commit(profile);
+	}
+
+	switch_mutex_unlock(profile->chunk_mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* write out whatever the profiles have buffered, only called from the writer thread */
+static void mod_logfile_flush_profiles(void)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	logfile_profile_t *profile;
+	logfile_chunk_t *chunk;
+
+	for (hi = switch_hash_first(NULL, profile_hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		profile = (logfile_profile_t *) val;
+
+		switch_mutex_lock(profile->chunk_mutex);
+		chunk = mod_logfile_take_chunk(profile);
+		switch_mutex_unlock(profile->chunk_mutex);
+
+		if (chunk) {
+			mod_logfile_write_chunk(chunk);
+		}
+	}
+}
+
+static void *SWITCH_THREAD_FUNC mod_logfile_writer_thread(switch_thread_t *thread, void *obj)
+{
+	switch_time_t last_flush = switch_micro_time_now();
+	void *pop;
+
+	for (;;) {
+		switch_status_t status = switch_queue_pop_timeout(globals.queue, &pop, (switch_interval_time_t) globals.flush_interval * 1000);
+
+		if (status == SWITCH_STATUS_SUCCESS && pop) {
+			mod_logfile_write_chunk((logfile_chunk_t *) pop);
+		} else if (!globals.running) {
+			break;
+		}
+
+		if (switch_micro_time_now() - last_flush >= (switch_time_t) globals.flush_interval * 1000) {
+			mod_logfile_flush_profiles();
+			last_flush = switch_micro_time_now();
+		}
+	}
+
+	while (switch_queue_trypop(globals.queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		if (pop) {
+			mod_logfile_write_chunk((logfile_chunk_t *) pop);
+		}
+	}
+
+	mod_logfile_flush_profiles();
+
+	return NULL;
+}
+
 static switch_status_t process_node(const switch_log_node_t *node, switch_log_level_t level)
 {
 	switch_hash_index_t *hi;
@@ -321,6 +494,7 @@ static switch_status_t load_profile(switch_xml_t xml)
 	new_profile = switch_core_alloc(module_pool, sizeof(*new_profile));
 	memset(new_profile, 0, sizeof(*new_profile));
 	switch_core_hash_init(&(new_profile->log_hash), module_pool);
+	switch_mutex_init(&new_profile->chunk_mutex, SWITCH_MUTEX_NESTED, module_pool);
 	new_profile->name = switch_core_strdup(module_pool, switch_str_nil(name));
 
 	new_profile->suffix = 1;
@@ -407,6 +581,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load)
 
 	memset(&globals, 0, sizeof(globals));
 	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, module_pool);
+	globals.flush_interval = 1000;
+	globals.queue_size = 64;
 
 	if (profile_hash) {
 		switch_core_hash_destroy(&profile_hash);
@@ -430,6 +606,20 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load)
 				char *val = (char *) switch_xml_attr_soft(param, "value");
 				if (!strcmp(var, "rotate-on-hup")) {
 					globals.rotate = switch_true(val);
+				} else if (!strcmp(var, "buffer-size")) {
+					globals.buffer_size = switch_atoui(val);
+				} else if (!strcmp(var, "flush-interval")) {
+					int tmp = atoi(val);
+					if (tmp > 0) {
+						globals.flush_interval = tmp;
+					}
+				} else if (!strcmp(var, "buffer-queue")) {
+					int tmp = atoi(val);
+					if (tmp > 0) {
+						globals.queue_size = tmp;
+					}
+				} else if (!strcmp(var, "overflow")) {
+					globals.overflow = !strcasecmp(val, "drop") ? LOGFILE_OVERFLOW_DROP : LOGFILE_OVERFLOW_BLOCK;
 				}
 			}
 		}
@@ -445,6 +635,16 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load)
 		switch_xml_free(xml);
 	}
 
+	if (globals.buffer_size) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		switch_queue_create(&globals.queue, globals.queue_size, module_pool);
+		globals.running = 1;
+		switch_threadattr_create(&thd_attr, module_pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.writer_thread, thd_attr, mod_logfile_writer_thread, NULL, module_pool);
+	}
+
 	switch_log_bind_logger(mod_logfile_logger, SWITCH_LOG_DEBUG, SWITCH_FALSE);
 
 	return SWITCH_STATUS_SUCCESS;
@@ -459,6 +659,16 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_logfile_shutdown)
 	switch_log_unbind_logger(mod_logfile_logger);
 	switch_event_unbind(&globals.node);
 
+	if (globals.writer_thread) {
+		switch_status_t st;
+
+		/* the writer drains the queue and the profile buffers before it goes */
+		globals.running = 0;
+		switch_queue_trypush(globals.queue, NULL);
+		switch_thread_join(&st, globals.writer_thread);
+		globals.writer_thread = NULL;
+	}
+
 	for (hi = switch_hash_first(NULL, profile_hash); hi; hi = switch_hash_next(hi)) {
 		logfile_profile_t *profile;
 		switch_hash_this(hi, &var, NULL, &val);
@@ -39,6 +39,22 @@
 #define ENCODING_DEFAULT 1
 #define ENCODING_BASE64 2
 #define ENCODING_TEXTXML 3
+#define CDR_STREAM_CHUNK 8192
+#define MAX_WORKERS 32
+#define MAX_BATCH_SIZE 100
+
+typedef struct cdr_job {
+	char *name;					/* [a_]uuid, used in the url and for file names */
+	char *xml_text;
+	switch_time_t queued;
+} cdr_job_t;
+
+typedef struct cdr_conn {
+	switch_CURL *curl_handle;
+	switch_curl_slist_t *headers;
+	switch_curl_slist_t *slist;
+	int worker;
+} cdr_conn_t;
 
 static struct {
 	char *cred;
@@ -68,6 +84,23 @@ static struct {
 	int rotate;
 	int auth_scheme;
 	int timeout;
+	uint32_t queue_size;
+	uint32_t worker_count;
+	uint32_t batch_size;
+	switch_queue_t *queue;
+	switch_thread_t *workers[MAX_WORKERS];
+	switch_mutex_t *stats_mutex;
+	struct {
+		uint64_t queued;
+		uint64_t delivered;
+		uint64_t failed;
+		uint64_t spilled;
+		uint64_t posts;
+		uint64_t post_usec;
+		uint64_t latency_usec;
+		switch_time_t latency_max;
+		uint32_t peak_depth;
+	} stats;
 	switch_memory_pool_t *pool;
 	switch_event_node_t *node;
 } globals;
@@ -177,260 +210,540 @@ static switch_status_t set_xml_cdr_log_dirs()
 	return status;
 }
 
-static switch_status_t my_on_reporting(switch_core_session_t *session)
+static void write_cdr_file(const char *dir, const char *name, const char *xml_text)
 {
-	switch_xml_t cdr = NULL;
-	char *xml_text = NULL;
-	char *path = NULL;
-	char *curl_xml_text = NULL;
-	const char *logdir = NULL;
-	char *xml_text_escaped = NULL;
+	char *path;
 	int fd = -1;
-	uint32_t cur_try;
-	long httpRes;
-	switch_CURL *curl_handle = NULL;
-	switch_curl_slist_t *headers = NULL;
-	switch_curl_slist_t *slist = NULL;
-	switch_channel_t *channel = switch_core_session_get_channel(session);
-	switch_status_t status = SWITCH_STATUS_FALSE;
-	int is_b;
-	const char *a_prefix = "";
 
-	if (globals.shutdown) {
-		return SWITCH_STATUS_SUCCESS;
+	if (!(path = switch_mprintf("%s%s%s.cdr.xml", dir, SWITCH_PATH_SEPARATOR, name))) {
+		return;
+	}
+#ifdef _MSC_VER
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) > -1) {
+#else
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)) > -1) {
+#endif
+		int wrote;
+		wrote = write(fd, xml_text, (unsigned) strlen(xml_text));
+		wrote++;
+		close(fd);
+		fd = -1;
+	} else {
+		char ebuf[512] = { 0 };
+#ifdef WIN32
+		strerror_s(ebuf, sizeof(ebuf), errno);
+#else
+		strerror_r(errno, ebuf, sizeof(ebuf));
+#endif
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error writing [%s][%s]\n", path, ebuf);
 	}
 
-	is_b = channel && switch_channel_get_originator_caller_profile(channel);
-	if (!globals.log_b && is_b) {
-		const char *force_cdr = switch_channel_get_variable(channel, SWITCH_FORCE_PROCESS_CDR_VARIABLE);
-		if (!switch_true(force_cdr)) {
-			return SWITCH_STATUS_SUCCESS;
+	switch_safe_free(path);
+}
+
+/* failed posts and anything that did not fit the queue end up in err-log-dir */
+static void spill_cdr(cdr_job_t *job)
+{
+	switch_thread_rwlock_rdlock(globals.log_path_lock);
+	write_cdr_file(globals.err_log_dir, job->name, job->xml_text);
+	switch_thread_rwlock_unlock(globals.log_path_lock);
+}
+
+static void cdr_job_destroy(cdr_job_t **jobp)
+{
+	cdr_job_t *job = *jobp;
+
+	if (job) {
+		*jobp = NULL;
+		switch_safe_free(job->name);
+		switch_safe_free(job->xml_text);
+		free(job);
+	}
+}
+
+static void cdr_conn_open(cdr_conn_t *conn)
+{
+	switch_CURL *curl_handle = conn->curl_handle = switch_curl_easy_init();
+
+	if (globals.encode == ENCODING_TEXTXML) {
+		conn->headers = switch_curl_slist_append(conn->headers, "Content-Type: text/xml");
+	} else if (globals.encode == ENCODING_DEFAULT) {
+		conn->headers = switch_curl_slist_append(conn->headers, "Content-Type: application/x-www-form-urlencoded");
+	} else if (globals.encode) {
+		conn->headers = switch_curl_slist_append(conn->headers, "Content-Type: application/x-www-form-base64-encoded");
+	} else {
+		conn->headers = switch_curl_slist_append(conn->headers, "Content-Type: application/x-www-form-plaintext");
+	}
+
+	if (!zstr(globals.cred)) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPAUTH, globals.auth_scheme);
+		switch_curl_easy_setopt(curl_handle, CURLOPT_USERPWD, globals.cred);
+	}
+
+	switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, conn->headers);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_POST, 1);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "freeswitch-xml/1.0");
+	switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, httpCallBack);
+
+	if (globals.disable100continue) {
+		conn->slist = switch_curl_slist_append(conn->slist, "Expect:");
+		switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, conn->slist);
+	}
+
+	if (globals.ssl_cert_file) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSLCERT, globals.ssl_cert_file);
+	}
+
+	if (globals.ssl_key_file) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEY, globals.ssl_key_file);
+	}
+
+	if (globals.ssl_key_password) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEYPASSWD, globals.ssl_key_password);
+	}
+
+	if (globals.ssl_version) {
+		if (!strcasecmp(globals.ssl_version, "SSLv3")) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_SSLv3);
+		} else if (!strcasecmp(globals.ssl_version, "TLSv1")) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1);
 		}
 	}
-	if (!is_b && globals.prefix_a)
-		a_prefix = "a_";
 
-	if (switch_ivr_generate_xml_cdr(session, &cdr) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Generating Data!\n");
-		return SWITCH_STATUS_FALSE;
+	if (globals.ssl_cacert_file) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_CAINFO, globals.ssl_cacert_file);
 	}
 
-	/* build the XML */
-	xml_text = switch_xml_toxml(cdr, SWITCH_TRUE);
-	if (!xml_text) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error!\n");
-		goto error;
+	switch_curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, globals.timeout);
+
+	/* these were used for testing, optionally they may be enabled if someone desires
+	   switch_curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1); // 302 recursion level
+	 */
+}
+
+static void cdr_conn_close(cdr_conn_t *conn)
+{
+	if (conn->curl_handle) {
+		switch_curl_easy_cleanup(conn->curl_handle);
+		conn->curl_handle = NULL;
+	}
+	if (conn->headers) {
+		switch_curl_slist_free_all(conn->headers);
+		conn->headers = NULL;
+	}
+	if (conn->slist) {
+		switch_curl_slist_free_all(conn->slist);
+		conn->slist = NULL;
 	}
+}
 
-	switch_thread_rwlock_rdlock(globals.log_path_lock);
+/* one cdr is posted as it always was, a batch as cdr=...&cdr=... or a <cdrs> document for textxml */
+static char *cdr_post_body(cdr_job_t **jobs, int count)
+{
+	switch_stream_handle_t stream = { 0 };
+	char *buf = NULL;
+	switch_size_t buflen = 0;
+	int i;
 
-	if (!(logdir = switch_channel_get_variable(channel, "xml_cdr_base"))) {
-		logdir = globals.log_dir;
+	if (globals.encode == ENCODING_TEXTXML && count == 1) {
+		return strdup(jobs[0]->xml_text);
 	}
 
-	if (!zstr(logdir) && (globals.log_http_and_disk || !globals.url_count)) {
-		path = switch_mprintf("%s%s%s%s.cdr.xml", logdir, SWITCH_PATH_SEPARATOR, a_prefix, switch_core_session_get_uuid(session));
-		switch_thread_rwlock_unlock(globals.log_path_lock);
-		if (path) {
-#ifdef _MSC_VER
-			if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) > -1) {
-#else
-			if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)) > -1) {
-#endif
-				int wrote;
-				wrote = write(fd, xml_text, (unsigned) strlen(xml_text));
-				wrote++;
-				close(fd);
-				fd = -1;
+	SWITCH_STANDARD_STREAM(stream);
+	stream.alloc_chunk = CDR_STREAM_CHUNK;
+
+	if (globals.encode == ENCODING_TEXTXML) {
+		stream.write_function(&stream, "<?xml version=\"1.0\"?>\n<cdrs>\n");
+	}
+
+	for (i = 0; i < count; i++) {
+		const char *text = jobs[i]->xml_text;
+
+		if (globals.encode == ENCODING_TEXTXML) {
+			const char *body = text;
+
+			if (!strncmp(body, "<?xml", 5) && (body = strchr(body, '\n'))) {
+				body++;
 			} else {
-				char ebuf[512] = { 0 };
-#ifdef WIN32
-				strerror_s(ebuf, sizeof(ebuf), errno);
-#else
-				strerror_r(errno, ebuf, sizeof(ebuf));
-#endif
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error writing [%s][%s]\n", path, ebuf);
+				body = text;
 			}
-			switch_safe_free(path);
+			stream.raw_write_function(&stream, (uint8_t *) body, strlen(body));
+			continue;
 		}
-	} else {
-		switch_thread_rwlock_unlock(globals.log_path_lock);
-	}
 
-	/* try to post it to the web server */
-	if (globals.url_count) {
-		char *destUrl = NULL;
-		curl_handle = switch_curl_easy_init();
+		stream.write_function(&stream, "%scdr=", i ? "&" : "");
 
-		if (globals.encode == ENCODING_TEXTXML) {
-			headers = switch_curl_slist_append(headers, "Content-Type: text/xml");
-		} else if (globals.encode) {
-			switch_size_t need_bytes = strlen(xml_text) * 3 + 1;
+		if (globals.encode) {
+			switch_size_t need_bytes = strlen(text) * 3 + 1;
+
+			if (need_bytes > buflen) {
+				switch_safe_free(buf);
+				buf = malloc(need_bytes);
+				switch_assert(buf);
+				buflen = need_bytes;
+			}
+			memset(buf, 0, need_bytes);
 
-			xml_text_escaped = malloc(need_bytes);
-			switch_assert(xml_text_escaped);
-			memset(xml_text_escaped, 0, need_bytes);
 			if (globals.encode == ENCODING_DEFAULT) {
-				headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
-				switch_url_encode(xml_text, xml_text_escaped, need_bytes);
+				switch_url_encode(text, buf, need_bytes);
 			} else {
-				headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-base64-encoded");
-				switch_b64_encode((unsigned char *) xml_text, need_bytes / 3, (unsigned char *) xml_text_escaped, need_bytes);
+				switch_b64_encode((unsigned char *) text, need_bytes / 3, (unsigned char *) buf, need_bytes);
 			}
-			switch_safe_free(xml_text);
-			xml_text = xml_text_escaped;
-		} else {
-			headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-plaintext");
+			text = buf;
 		}
 
-		if (globals.encode == ENCODING_TEXTXML) {
-			curl_xml_text = xml_text;
-		} else if (!(curl_xml_text = switch_mprintf("cdr=%s", xml_text))) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error!\n");
-			goto error;
-		}
+		stream.raw_write_function(&stream, (uint8_t *) text, strlen(text));
+	}
 
-		if (!zstr(globals.cred)) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPAUTH, globals.auth_scheme);
-			switch_curl_easy_setopt(curl_handle, CURLOPT_USERPWD, globals.cred);
+	if (globals.encode == ENCODING_TEXTXML) {
+		stream.write_function(&stream, "</cdrs>\n");
+	}
+
+	switch_safe_free(buf);
+
+	return stream.data;
+}
+
+/* post, rotating through the urls on failure, the retries run in the calling thread */
+static switch_status_t cdr_post(cdr_conn_t *conn, const char *post, const char *query)
+{
+	switch_CURL *curl_handle = conn->curl_handle;
+	uint32_t cur_try;
+	long httpRes = 0;
+
+	switch_curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, post);
+
+	for (cur_try = 0; cur_try < globals.retries; cur_try++) {
+		char *destUrl = NULL;
+
+		if (cur_try > 0) {
+			if (globals.shutdown && conn->worker) {
+				break;
+			}
+			switch_yield(globals.delay * 1000000);
 		}
 
-		switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_POST, 1);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, curl_xml_text);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "freeswitch-xml/1.0");
-		switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, httpCallBack);
+		destUrl = switch_mprintf("%s?%s", globals.urls[globals.url_index], query);
+		switch_curl_easy_setopt(curl_handle, CURLOPT_URL, destUrl);
 
-		if (globals.disable100continue) {
-			slist = switch_curl_slist_append(slist, "Expect:");
-			switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, slist);
+		if (!strncasecmp(destUrl, "https", 5)) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0);
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 0);
 		}
 
-		if (globals.ssl_cert_file) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLCERT, globals.ssl_cert_file);
+		if (globals.enable_cacert_check) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, TRUE);
 		}
 
-		if (globals.ssl_key_file) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEY, globals.ssl_key_file);
+		if (globals.enable_ssl_verifyhost) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 2);
 		}
 
-		if (globals.ssl_key_password) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEYPASSWD, globals.ssl_key_password);
+		httpRes = 0;
+		switch_curl_easy_perform(curl_handle);
+		switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &httpRes);
+		switch_safe_free(destUrl);
+		if (httpRes >= 200 && httpRes <= 299) {
+			return SWITCH_STATUS_SUCCESS;
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Got error [%ld] posting to web server [%s]\n",
+							  httpRes, globals.urls[globals.url_index]);
+			globals.url_index++;
+			switch_assert(globals.url_count <= MAX_URLS);
+			if (globals.url_index >= globals.url_count) {
+				globals.url_index = 0;
+			}
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Retry will be with url [%s]\n", globals.urls[globals.url_index]);
 		}
+	}
 
-		if (globals.ssl_version) {
-			if (!strcasecmp(globals.ssl_version, "SSLv3")) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_SSLv3);
-			} else if (!strcasecmp(globals.ssl_version, "TLSv1")) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1);
+	return SWITCH_STATUS_FALSE;
+}
+
+static void cdr_deliver(cdr_conn_t *conn, cdr_job_t **jobs, int count)
+{
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	switch_time_t start = switch_micro_time_now(), now;
+	char *post, *query;
+	int i;
+
+	if (count == 1) {
+		query = switch_mprintf("uuid=%s", jobs[0]->name);
+	} else {
+		query = switch_mprintf("batch=%d", count);
+	}
+
+	if ((post = cdr_post_body(jobs, count)) && query) {
+		status = cdr_post(conn, post, query);
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error!\n");
+	}
+
+	now = switch_micro_time_now();
+
+	switch_mutex_lock(globals.stats_mutex);
+	globals.stats.posts++;
+	globals.stats.post_usec += now - start;
+	if (status == SWITCH_STATUS_SUCCESS) {
+		globals.stats.delivered += count;
+		for (i = 0; i < count; i++) {
+			switch_time_t latency = now - jobs[i]->queued;
+
+			globals.stats.latency_usec += latency;
+			if (latency > globals.stats.latency_max) {
+				globals.stats.latency_max = latency;
 			}
 		}
+	} else {
+		globals.stats.failed += count;
+	}
+	switch_mutex_unlock(globals.stats_mutex);
 
-		if (globals.ssl_cacert_file) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_CAINFO, globals.ssl_cacert_file);
+	if (status != SWITCH_STATUS_SUCCESS) {
+		/* if we are here the web post failed for some reason */
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to post to web server, writing to file\n");
+		for (i = 0; i < count; i++) {
+			spill_cdr(jobs[i]);
 		}
-		
-		switch_curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, globals.timeout);
+	}
 
-		/* these were used for testing, optionally they may be enabled if someone desires
-		   switch_curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1); // 302 recursion level
-		 */
+	switch_safe_free(query);
+	switch_safe_free(post);
+}
 
-		for (cur_try = 0; cur_try < globals.retries; cur_try++) {
-			if (cur_try > 0) {
-				switch_yield(globals.delay * 1000000);
-			}
+static void *SWITCH_THREAD_FUNC cdr_worker_thread(switch_thread_t *thread, void *obj)
+{
+	cdr_conn_t conn = { 0 };
+	cdr_job_t *jobs[MAX_BATCH_SIZE];
+	void *pop = NULL;
+	int i;
 
-			destUrl = switch_mprintf("%s?uuid=%s%s", globals.urls[globals.url_index], a_prefix, switch_core_session_get_uuid(session));
-			switch_curl_easy_setopt(curl_handle, CURLOPT_URL, destUrl);
+	/* the handle lives as long as the worker so the connection to the collector is kept open */
+	cdr_conn_open(&conn);
+	conn.worker = 1;
 
-			if (!strncasecmp(destUrl, "https", 5)) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0);
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 0);
-			}
+	for (;;) {
+		int count = 0;
 
-			if (globals.enable_cacert_check) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, TRUE);
+		if (switch_queue_pop_timeout(globals.queue, &pop, 500000) != SWITCH_STATUS_SUCCESS) {
+			if (globals.shutdown) {
+				break;
 			}
+			continue;
+		}
+
+		if (!pop) {
+			continue;
+		}
 
-			if (globals.enable_ssl_verifyhost) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 2);
+		jobs[count++] = (cdr_job_t *) pop;
+
+		while (count < (int) globals.batch_size && switch_queue_trypop(globals.queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			if (pop) {
+				jobs[count++] = (cdr_job_t *) pop;
 			}
+		}
 
-			switch_curl_easy_perform(curl_handle);
-			switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &httpRes);
-			switch_safe_free(destUrl);
-			if (httpRes >= 200 && httpRes <= 299) {
-				goto success;
-			} else {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Got error [%ld] posting to web server [%s]\n",
-								  httpRes, globals.urls[globals.url_index]);
-				globals.url_index++;
-				switch_assert(globals.url_count <= MAX_URLS);
-				if (globals.url_index >= globals.url_count) {
-					globals.url_index = 0;
-				}
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Retry will be with url [%s]\n", globals.urls[globals.url_index]);
+		if (globals.shutdown) {
+			/* don't hold the shutdown up waiting on a collector, keep them for later */
+			for (i = 0; i < count; i++) {
+				spill_cdr(jobs[i]);
 			}
+			switch_mutex_lock(globals.stats_mutex);
+			globals.stats.spilled += count;
+			switch_mutex_unlock(globals.stats_mutex);
+		} else {
+			cdr_deliver(&conn, jobs, count);
 		}
-		switch_curl_easy_cleanup(curl_handle);
-		switch_curl_slist_free_all(headers);
-		switch_curl_slist_free_all(slist);
-		slist = NULL;
-		headers = NULL;
-		curl_handle = NULL;
 
-		/* if we are here the web post failed for some reason */
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to post to web server, writing to file\n");
+		for (i = 0; i < count; i++) {
+			cdr_job_destroy(&jobs[i]);
+		}
+	}
 
-		switch_thread_rwlock_rdlock(globals.log_path_lock);
-		path = switch_mprintf("%s%s%s%s.cdr.xml", globals.err_log_dir, SWITCH_PATH_SEPARATOR, a_prefix, switch_core_session_get_uuid(session));
-		switch_thread_rwlock_unlock(globals.log_path_lock);
-		if (path) {
-#ifdef _MSC_VER
-			if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) > -1) {
-#else
-			if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)) > -1) {
-#endif
-				int wrote;
-				wrote = write(fd, xml_text, (unsigned) strlen(xml_text));
-				wrote++;
-				close(fd);
-				fd = -1;
-			} else {
-				char ebuf[512] = { 0 };
-#ifdef WIN32
-				strerror_s(ebuf, sizeof(ebuf), errno);
-#else
-				strerror_r(errno, ebuf, sizeof(ebuf));
-#endif
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error![%s]\n", ebuf);
-			}
+	cdr_conn_close(&conn);
+
+	return NULL;
+}
+
+static void start_workers(void)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	uint32_t i;
+
+	switch_mutex_init(&globals.stats_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+
+	if (!globals.queue_size || !globals.url_count) {
+		return;
+	}
+
+	switch_queue_create(&globals.queue, globals.queue_size, globals.pool);
+
+	for (i = 0; i < globals.worker_count; i++) {
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.workers[i], thd_attr, cdr_worker_thread, NULL, globals.pool);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Delivering CDRs with %u threads, queue size %u, batch size %u\n",
+					  globals.worker_count, globals.queue_size, globals.batch_size);
+}
+
+static void stop_workers(void)
+{
+	switch_status_t st;
+	void *pop = NULL;
+	uint32_t i;
+
+	if (!globals.queue) {
+		return;
+	}
+
+	for (i = 0; i < globals.worker_count; i++) {
+		if (globals.workers[i]) {
+			switch_thread_join(&st, globals.workers[i]);
+			globals.workers[i] = NULL;
+		}
+	}
+
+	while (switch_queue_trypop(globals.queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		cdr_job_t *job = (cdr_job_t *) pop;
+
+		if (job) {
+			spill_cdr(job);
+			cdr_job_destroy(&job);
+		}
+	}
+}
+
+static switch_status_t my_on_reporting(switch_core_session_t *session)
+{
+	switch_stream_handle_t stream = { 0 };
+	char *xml_text = NULL;
+	const char *logdir = NULL;
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	int is_b;
+	const char *a_prefix = "";
+
+	if (globals.shutdown) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	is_b = channel && switch_channel_get_originator_caller_profile(channel);
+	if (!globals.log_b && is_b) {
+		const char *force_cdr = switch_channel_get_variable(channel, SWITCH_FORCE_PROCESS_CDR_VARIABLE);
+		if (!switch_true(force_cdr)) {
+			return SWITCH_STATUS_SUCCESS;
 		}
 	}
+	if (!is_b && globals.prefix_a)
+		a_prefix = "a_";
 
-  success:
-	status = SWITCH_STATUS_SUCCESS;
+	/* render the XML straight into a buffer, no intermediate tree */
+	SWITCH_STANDARD_STREAM(stream);
+	stream.alloc_chunk = CDR_STREAM_CHUNK;
 
-  error:
-	if (curl_handle) {
-		switch_curl_easy_cleanup(curl_handle);
+	if (switch_ivr_stream_xml_cdr(session, &stream, SWITCH_TRUE) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Generating Data!\n");
+		switch_safe_free(stream.data);
+		return SWITCH_STATUS_FALSE;
 	}
-	if (headers) {
-		switch_curl_slist_free_all(headers);
+
+	xml_text = (char *) stream.data;
+
+	switch_thread_rwlock_rdlock(globals.log_path_lock);
+
+	if (!(logdir = switch_channel_get_variable(channel, "xml_cdr_base"))) {
+		logdir = globals.log_dir;
 	}
-	if (slist) {
-		switch_curl_slist_free_all(slist);
+
+	if (!zstr(logdir) && (globals.log_http_and_disk || !globals.url_count)) {
+		char *name = switch_mprintf("%s%s", a_prefix, switch_core_session_get_uuid(session));
+
+		if (name) {
+			write_cdr_file(logdir, name, xml_text);
+			free(name);
+		}
 	}
-	if (curl_xml_text != xml_text) {
-		switch_safe_free(curl_xml_text);
+
+	switch_thread_rwlock_unlock(globals.log_path_lock);
+
+	/* try to post it to the web server */
+	if (globals.url_count) {
+		cdr_job_t *job;
+
+		switch_zmalloc(job, sizeof(*job));
+		job->name = switch_mprintf("%s%s", a_prefix, switch_core_session_get_uuid(session));
+		job->xml_text = xml_text;
+		job->queued = switch_micro_time_now();
+		xml_text = NULL;
+
+		if (globals.queue) {
+			uint32_t depth;
+
+			/* hand it to the delivery threads, the session does not wait on the collector */
+			if (switch_queue_trypush(globals.queue, job) == SWITCH_STATUS_SUCCESS) {
+				depth = switch_queue_size(globals.queue);
+				switch_mutex_lock(globals.stats_mutex);
+				globals.stats.queued++;
+				if (depth > globals.stats.peak_depth) {
+					globals.stats.peak_depth = depth;
+				}
+				switch_mutex_unlock(globals.stats_mutex);
+				job = NULL;
+			} else {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Delivery queue full, writing %s to file\n", job->name);
+				spill_cdr(job);
+				switch_mutex_lock(globals.stats_mutex);
+				globals.stats.spilled++;
+				switch_mutex_unlock(globals.stats_mutex);
+			}
+		} else {
+			cdr_conn_t conn = { 0 };
+
+			cdr_conn_open(&conn);
+			cdr_deliver(&conn, &job, 1);
+			cdr_conn_close(&conn);
+		}
+
+		cdr_job_destroy(&job);
 	}
+
 	switch_safe_free(xml_text);
-	switch_safe_free(path);
-	switch_xml_free(cdr);
 
-	return status;
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define XML_CDR_SYNTAX "status"
+SWITCH_STANDARD_API(xml_cdr_function)
+{
+	uint64_t delivered, posts;
+
+	if (zstr(cmd) || strcasecmp(cmd, "status")) {
+		stream->write_function(stream, "-USAGE: %s\n", XML_CDR_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_mutex_lock(globals.stats_mutex);
+	delivered = globals.stats.delivered;
+	posts = globals.stats.posts;
+
+	stream->write_function(stream, "mode: %s\n", globals.queue ? "queued" : "inline");
+	if (globals.queue) {
+		stream->write_function(stream, "threads: %u\nbatch-size: %u\nqueue-size: %u\nqueue-depth: %u\npeak-depth: %u\n",
+							   globals.worker_count, globals.batch_size, globals.queue_size, switch_queue_size(globals.queue), globals.stats.peak_depth);
+	}
+	stream->write_function(stream, "queued: %" SWITCH_UINT64_T_FMT "\ndelivered: %" SWITCH_UINT64_T_FMT "\nfailed: %" SWITCH_UINT64_T_FMT
+						   "\nspilled: %" SWITCH_UINT64_T_FMT "\nposts: %" SWITCH_UINT64_T_FMT "\n",
+						   globals.stats.queued, delivered, globals.stats.failed, globals.stats.spilled, posts);
+	stream->write_function(stream, "avg-post-ms: %.2f\navg-latency-ms: %.2f\nmax-latency-ms: %.2f\n",
+						   posts ? (double) globals.stats.post_usec / posts / 1000 : 0.0,
+						   delivered ? (double) globals.stats.latency_usec / delivered / 1000 : 0.0,
+						   (double) globals.stats.latency_max / 1000);
+	switch_mutex_unlock(globals.stats_mutex);
+
+	return SWITCH_STATUS_SUCCESS;
 }
 
 static void event_handler(switch_event_t *event)
@@ -463,6 +776,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_cdr_load)
 	char *cf = "xml_cdr.conf";
 	switch_xml_t cfg, xml, settings, param;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	switch_api_interface_t *api_interface;
 
 	/* test global state handlers */
 	switch_core_add_state_handler(&state_handlers);
@@ -481,6 +795,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_cdr_load)
 	globals.disable100continue = 0;
 	globals.pool = pool;
 	globals.auth_scheme = CURLAUTH_BASIC;
+	globals.worker_count = 2;
+	globals.batch_size = 1;
 
 	switch_thread_rwlock_create(&globals.log_path_lock, pool);
 
@@ -529,6 +845,22 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_cdr_load)
 				} else {
 					globals.encode = switch_true(val) ? ENCODING_DEFAULT : ENCODING_NONE;
 				}
+			} else if (!strcasecmp(var, "queue-size") && !zstr(val)) {
+				globals.queue_size = switch_atoui(val);
+			} else if (!strcasecmp(var, "delivery-threads") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp > 0 && tmp <= MAX_WORKERS) {
+					globals.worker_count = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "delivery-threads must be between 1 and %d\n", MAX_WORKERS);
+				}
+			} else if (!strcasecmp(var, "batch-size") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp > 0 && tmp <= MAX_BATCH_SIZE) {
+					globals.batch_size = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "batch-size must be between 1 and %d\n", MAX_BATCH_SIZE);
+				}
 			} else if (!strcasecmp(var, "retries") && !zstr(val)) {
 				globals.retries = switch_atoui(val);
 			} else if (!strcasecmp(var, "rotate") && !zstr(val)) {
@@ -608,6 +940,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_cdr_load)
 
 	switch_xml_free(xml);
 
+	start_workers();
+
+	SWITCH_ADD_API(api_interface, "xml_cdr", "XML CDR delivery status", xml_cdr_function, XML_CDR_SYNTAX);
+
 	return status;
 }
 
@@ -616,11 +952,13 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_xml_cdr_shutdown)
 
 	globals.shutdown = 1;
 
+	switch_core_remove_state_handler(&state_handlers);
+	stop_workers();
+
 	switch_safe_free(globals.log_dir);
 	switch_safe_free(globals.err_log_dir);
 
 	switch_event_unbind(&globals.node);
-	switch_core_remove_state_handler(&state_handlers);
 
 	switch_thread_rwlock_destroy(globals.log_path_lock);
 
@@ -39,7 +39,14 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_xml_curl_shutdown);
 SWITCH_MODULE_DEFINITION(mod_xml_curl, mod_xml_curl_load, mod_xml_curl_shutdown, NULL);
 
 
+/* upper bounds of the fetch latency buckets in ms, the last one catches the rest */
+static const uint32_t LATENCY_BUCKETS[] = { 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 0 };
+#define LATENCY_BUCKET_COUNT (sizeof(LATENCY_BUCKETS) / sizeof(LATENCY_BUCKETS[0]))
+
+#define XML_CURL_DEFAULT_POOL_SIZE 8
+
 struct xml_binding {
+	char *name;
 	char *method;
 	char *url;
 	char *bindings;
@@ -59,6 +66,19 @@ struct xml_binding {
 	int use_dynamic_url;
 	int auth_scheme;
 	int timeout;
+	int enable_http2;
+	/* idle handles keep their connections open for the next fetch */
+	switch_mutex_t *mutex;
+	switch_CURL **idle;
+	int idle_count;
+	int pool_size;
+	uint64_t fetches;
+	uint64_t errors;
+	uint64_t reused;
+	switch_time_t total_usec;
+	switch_time_t max_usec;
+	uint64_t latency[LATENCY_BUCKET_COUNT];
+	struct xml_binding *next;
 };
 
 static int keep_files_around = 0;
@@ -68,9 +88,9 @@ typedef struct xml_binding xml_binding_t;
 #define XML_CURL_MAX_BYTES 1024 * 1024
 
 struct config_data {
-	char *name;
-	int fd;
+	char *data;
 	switch_size_t bytes;
+	switch_size_t size;
 	switch_size_t max_bytes;
 	int err;
 };
@@ -84,9 +104,33 @@ static struct {
 	switch_memory_pool_t *pool;
 	hash_node_t *hash_root;
 	hash_node_t *hash_tail;
+	xml_binding_t *bindings;
 } globals;
 
-#define XML_CURL_SYNTAX "[debug_on|debug_off]"
+static void binding_stats(xml_binding_t *binding, switch_stream_handle_t *stream)
+{
+	uint32_t lower = 0;
+	size_t i;
+
+	switch_mutex_lock(binding->mutex);
+	stream->write_function(stream, "Binding [%s] %s\n", binding->name, binding->url);
+	stream->write_function(stream, "  fetches: %" SWITCH_UINT64_T_FMT " errors: %" SWITCH_UINT64_T_FMT " reused: %" SWITCH_UINT64_T_FMT
+						   " idle: %d/%d\n", binding->fetches, binding->errors, binding->reused, binding->idle_count, binding->pool_size);
+	stream->write_function(stream, "  avg: %" SWITCH_TIME_T_FMT "us max: %" SWITCH_TIME_T_FMT "us\n",
+						   binding->fetches ? binding->total_usec / (switch_time_t) binding->fetches : 0, binding->max_usec);
+
+	for (i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+		if (LATENCY_BUCKETS[i]) {
+			stream->write_function(stream, "  %5u-%ums: %" SWITCH_UINT64_T_FMT "\n", lower, LATENCY_BUCKETS[i], binding->latency[i]);
+			lower = LATENCY_BUCKETS[i];
+		} else {
+			stream->write_function(stream, "  %5ums+: %" SWITCH_UINT64_T_FMT "\n", lower, binding->latency[i]);
+		}
+	}
+	switch_mutex_unlock(binding->mutex);
+}
+
+#define XML_CURL_SYNTAX "[debug_on|debug_off|stats]"
 SWITCH_STANDARD_API(xml_curl_function)
 {
 	if (session) {
@@ -101,6 +145,14 @@ SWITCH_STANDARD_API(xml_curl_function)
 		keep_files_around = 1;
 	} else if (!strcasecmp(cmd, "debug_off")) {
 		keep_files_around = 0;
+	} else if (!strcasecmp(cmd, "stats")) {
+		xml_binding_t *binding;
+
+		for (binding = globals.bindings; binding; binding = binding->next) {
+			binding_stats(binding, stream);
+		}
+
+		return SWITCH_STATUS_SUCCESS;
 	} else {
 		goto usage;
 	}
@@ -113,25 +165,147 @@ SWITCH_STANDARD_API(xml_curl_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
-static size_t file_callback(void *ptr, size_t size, size_t nmemb, void *data)
+static size_t buffer_callback(void *ptr, size_t size, size_t nmemb, void *data)
 {
 	register unsigned int realsize = (unsigned int) (size * nmemb);
 	struct config_data *config_data = data;
-	int x;
 
-	config_data->bytes += realsize;
-
-	if (config_data->bytes > config_data->max_bytes) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Oversized file detected [%d bytes]\n", (int) config_data->bytes);
+	if (config_data->bytes + realsize > config_data->max_bytes) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Oversized file detected [%d bytes]\n", (int) (config_data->bytes + realsize));
 		config_data->err = 1;
 		return 0;
 	}
 
-	x = write(config_data->fd, ptr, realsize);
-	if (x != (int) realsize) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write! %d out of %d\n", x, realsize);
+	if (config_data->bytes + realsize + 1 > config_data->size) {
+		switch_size_t new_size = config_data->size ? config_data->size : 4096;
+		char *new_data;
+
+		while (new_size < config_data->bytes + realsize + 1) {
+			new_size *= 2;
+		}
+
+		if (!(new_data = realloc(config_data->data, new_size))) {
+			config_data->err = 1;
+			return 0;
+		}
+
+		config_data->data = new_data;
+		config_data->size = new_size;
+	}
+
+	memcpy(config_data->data + config_data->bytes, ptr, realsize);
+	config_data->bytes += realsize;
+	config_data->data[config_data->bytes] = '\0';
+
+	return realsize;
+}
+
+static switch_CURL *binding_handle_get(xml_binding_t *binding)
+{
+	switch_CURL *curl_handle = NULL;
+
+	switch_mutex_lock(binding->mutex);
+	if (binding->idle_count) {
+		curl_handle = binding->idle[--binding->idle_count];
+		binding->reused++;
+	}
+	switch_mutex_unlock(binding->mutex);
+
+	return curl_handle ? curl_handle : switch_curl_easy_init();
+}
+
+static void binding_handle_put(xml_binding_t *binding, switch_CURL *curl_handle)
+{
+	if (binding->cookie_file) {
+		/* the jar is only written on cleanup otherwise */
+		curl_easy_setopt(curl_handle, CURLOPT_COOKIELIST, "FLUSH");
+	}
+
+	/* drop the options and keep the connection cache */
+	curl_easy_reset(curl_handle);
+
+	switch_mutex_lock(binding->mutex);
+	if (binding->idle_count < binding->pool_size) {
+		binding->idle[binding->idle_count++] = curl_handle;
+		curl_handle = NULL;
+	}
+	switch_mutex_unlock(binding->mutex);
+
+	if (curl_handle) {
+		switch_curl_easy_cleanup(curl_handle);
+	}
+}
+
+static void binding_account(xml_binding_t *binding, switch_time_t usec, int err)
+{
+	uint32_t ms = (uint32_t) (usec / 1000);
+	size_t i;
+
+	for (i = 0; LATENCY_BUCKETS[i] && ms >= LATENCY_BUCKETS[i]; i++);
+
+	switch_mutex_lock(binding->mutex);
+	binding->fetches++;
+	if (err) {
+		binding->errors++;
+	}
+	binding->total_usec += usec;
+	if (usec > binding->max_usec) {
+		binding->max_usec = usec;
+	}
+	binding->latency[i]++;
+	switch_mutex_unlock(binding->mutex);
+}
+
+/* the preprocessor only runs on files, so responses that need it still go through one */
+static switch_xml_t parse_response(xml_binding_t *binding, struct config_data *config_data, const char *data)
+{
+	char filename[512] = "";
+	switch_uuid_t uuid;
+	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	switch_xml_t xml = NULL;
+	int use_file = keep_files_around || strstr(config_data->data, "X-PRE-PROCESS") != NULL;
+
+	if (use_file) {
+		int fd;
+
+		switch_uuid_get(&uuid);
+		switch_uuid_format(uuid_str, &uuid);
+		switch_snprintf(filename, sizeof(filename), "%s%s%s.tmp.xml", SWITCH_GLOBAL_dirs.temp_dir, SWITCH_PATH_SEPARATOR, uuid_str);
+
+		if ((fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR)) > -1) {
+			int x = write(fd, config_data->data, config_data->bytes);
+
+			if (x != (int) config_data->bytes) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write! %d out of %d\n", x, (int) config_data->bytes);
+			}
+			close(fd);
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening temp file!\n");
+			use_file = 0;
+		}
 	}
-	return x;
+
+	if (use_file && strstr(config_data->data, "X-PRE-PROCESS")) {
+		xml = switch_xml_parse_file(filename);
+	} else if ((xml = switch_xml_parse_str_arena(config_data->data, SWITCH_FALSE))) {
+		/* the xml owns the buffer now */
+		config_data->data = NULL;
+	}
+
+	if (!xml) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Parsing Result! [%s]\ndata: [%s]\n", binding->url, data);
+	}
+
+	if (use_file) {
+		/* Debug by leaving the file behind for review */
+		if (keep_files_around) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "XML response is in %s\n", filename);
+		} else if (unlink(filename) != 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "XML response file [%s] delete failed\n", filename);
+		}
+	}
+
+	return xml;
 }
 
 
@@ -140,13 +314,11 @@ static size_t file_callback(void *ptr, size_t size, size_t nmemb, void *data)
 static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, const char *key_name, const char *key_value, switch_event_t *params,
 								  void *user_data)
 {
-	char filename[512] = "";
 	switch_CURL *curl_handle = NULL;
 	struct config_data config_data;
 	switch_xml_t xml = NULL;
 	char *data = NULL;
-	switch_uuid_t uuid;
-	char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	switch_time_t started;
 	xml_binding_t *binding = (xml_binding_t *) user_data;
 	char *file_url;
 	switch_curl_slist_t *slist = NULL;
@@ -202,11 +374,7 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 		sprintf(uri, "%s%c%s", dynamic_url, strchr(dynamic_url, '?') != NULL ? '&' : '?', data);
 	}
 
-	switch_uuid_get(&uuid);
-	switch_uuid_format(uuid_str, &uuid);
-
-	switch_snprintf(filename, sizeof(filename), "%s%s%s.tmp.xml", SWITCH_GLOBAL_dirs.temp_dir, SWITCH_PATH_SEPARATOR, uuid_str);
-	curl_handle = switch_curl_easy_init();
+	curl_handle = binding_handle_get(binding);
 	headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
 
 	if (!strncasecmp(binding->url, "https", 5)) {
@@ -216,10 +384,9 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 
 	memset(&config_data, 0, sizeof(config_data));
 
-	config_data.name = filename;
 	config_data.max_bytes = XML_CURL_MAX_BYTES;
 
-	if ((config_data.fd = open(filename, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR)) > -1) {
+	if (curl_handle) {
 		if (!zstr(binding->cred)) {
 			switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPAUTH, binding->auth_scheme);
 			switch_curl_easy_setopt(curl_handle, CURLOPT_USERPWD, binding->cred);
@@ -233,7 +400,7 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 		if (!binding->use_get_style)
 			switch_curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, data);
 		switch_curl_easy_setopt(curl_handle, CURLOPT_URL, binding->use_get_style ? uri : dynamic_url);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, file_callback);
+		switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, buffer_callback);
 		switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *) &config_data);
 		switch_curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "freeswitch-xml/1.0");
 
@@ -288,14 +455,21 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 			curl_easy_setopt(curl_handle, CURLOPT_INTERFACE, binding->bind_local);
 		}
 
+#ifdef CURL_VERSION_HTTP2
+		if (binding->enable_http2) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_0);
+		}
+#endif
+
+		started = switch_time_now();
 		switch_curl_easy_perform(curl_handle);
 		switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &httpRes);
-		switch_curl_easy_cleanup(curl_handle);
+		binding_account(binding, switch_time_now() - started, config_data.err || httpRes != 200);
+		binding_handle_put(binding, curl_handle);
 		switch_curl_slist_free_all(headers);
 		switch_curl_slist_free_all(slist);
-		close(config_data.fd);
 	} else {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Opening temp file!\n");
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error allocating curl handle!\n");
 	}
 
 	if (config_data.err) {
@@ -303,8 +477,10 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 		xml = NULL;
 	} else {
 		if (httpRes == 200) {
-			if (!(xml = switch_xml_parse_file(filename))) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Parsing Result! [%s]\ndata: [%s]\n", binding->url, data);
+			if (config_data.data) {
+				xml = parse_response(binding, &config_data, data);
+			} else {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Empty Result! [%s]\ndata: [%s]\n", binding->url, data);
 			}
 		} else {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Received HTTP error %ld trying to fetch %s\ndata: [%s]\n", httpRes, binding->url,
@@ -313,15 +489,7 @@ static switch_xml_t xml_url_fetch(const char *section, const char *tag_name, con
 		}
 	}
 
-	/* Debug by leaving the file behind for review */
-	if (keep_files_around) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "XML response is in %s\n", filename);
-	} else {
-		if (unlink(filename) != 0) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "XML response file [%s] delete failed\n", filename);
-		}
-	}
-
+	switch_safe_free(config_data.data);
 	switch_safe_free(data);
 	if (binding->use_get_style == 1)
 		switch_safe_free(uri);
@@ -369,6 +537,10 @@ static switch_status_t do_config(void)
 		char *cookie_file = NULL;
 		hash_node_t *hash_node;
 		int auth_scheme = CURLAUTH_BASIC;
+		int pool_size = XML_CURL_DEFAULT_POOL_SIZE, enable_http2 = 0;
+		uint32_t cache_ttl = 0;
+		char *cache_key_params = NULL;
+		switch_xml_binding_t *xml_binding = NULL;
 		need_vars_map = 0;
 		vars_map = NULL;
 
@@ -447,6 +619,30 @@ static switch_status_t do_config(void)
 				}
 			} else if (!strcasecmp(var, "bind-local")) {
 				bind_local = val;
+			} else if (!strcasecmp(var, "connection-pool-size")) {
+				int tmp = atoi(val);
+				if (tmp >= 0) {
+					pool_size = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Can't set a negative connection-pool-size!\n");
+				}
+			} else if (!strcasecmp(var, "cache-ttl")) {
+				int tmp = atoi(val);
+				if (tmp >= 0) {
+					cache_ttl = tmp;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Can't set a negative cache-ttl!\n");
+				}
+			} else if (!strcasecmp(var, "cache-key-params")) {
+				cache_key_params = val;
+			} else if (!strcasecmp(var, "enable-http2")) {
+#ifdef CURL_VERSION_HTTP2
+				enable_http2 = switch_true(val);
+#else
+				if (switch_true(val)) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "enable-http2 needs a newer libcurl, ignored\n");
+				}
+#endif
 			}
 		}
 
@@ -464,8 +660,15 @@ static switch_status_t do_config(void)
 		}
 		memset(binding, 0, sizeof(*binding));
 
+		binding->name = strdup(zstr(bname) ? "N/A" : bname);
 		binding->auth_scheme = auth_scheme;
 		binding->timeout = timeout;
+		binding->enable_http2 = enable_http2;
+		binding->pool_size = pool_size;
+		if (pool_size) {
+			switch_zmalloc(binding->idle, pool_size * sizeof(switch_CURL *));
+		}
+		switch_mutex_init(&binding->mutex, SWITCH_MUTEX_NESTED, globals.pool);
 		binding->url = strdup(url);
 		switch_assert(binding->url);
 
@@ -537,7 +740,17 @@ static switch_status_t do_config(void)
 
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Binding [%s] XML Fetch Function [%s] [%s]\n",
 						  zstr(bname) ? "N/A" : bname, binding->url, binding->bindings ? binding->bindings : "all");
-		switch_xml_bind_search_function(xml_url_fetch, switch_xml_parse_section_string(binding->bindings), binding);
+		switch_xml_bind_search_function_ret(xml_url_fetch, switch_xml_parse_section_string(binding->bindings), binding, &xml_binding);
+		if (cache_ttl && xml_binding) {
+			/* the url is part of the name so answers from an old url are never reused */
+			char *snapshot_name = switch_mprintf("xml_curl:%s:%s", zstr(bname) ? "" : bname, binding->url);
+
+			switch_xml_set_binding_cache(xml_binding, cache_ttl, cache_key_params);
+			switch_xml_set_binding_name(xml_binding, snapshot_name);
+			switch_safe_free(snapshot_name);
+		}
+		binding->next = globals.bindings;
+		globals.bindings = binding;
 		x++;
 		binding = NULL;
 	}
@@ -567,6 +780,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_curl_load)
 	SWITCH_ADD_API(xml_curl_api_interface, "xml_curl", "XML Curl", xml_curl_function, XML_CURL_SYNTAX);
 	switch_console_set_complete("add xml_curl debug_on");
 	switch_console_set_complete("add xml_curl debug_off");
+	switch_console_set_complete("add xml_curl stats");
 
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
@@ -575,6 +789,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_curl_load)
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_xml_curl_shutdown)
 {
 	hash_node_t *ptr = NULL;
+	xml_binding_t *binding;
 
 	while (globals.hash_root) {
 		ptr = globals.hash_root;
@@ -585,6 +800,15 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_xml_curl_shutdown)
 
 	switch_xml_unbind_search_function_ptr(xml_url_fetch);
 
+	for (binding = globals.bindings; binding; binding = binding->next) {
+		switch_mutex_lock(binding->mutex);
+		while (binding->idle_count) {
+			switch_curl_easy_cleanup(binding->idle[--binding->idle_count]);
+		}
+		binding->pool_size = 0;
+		switch_mutex_unlock(binding->mutex);
+	}
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
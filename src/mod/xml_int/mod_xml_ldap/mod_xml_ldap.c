@@ -58,6 +58,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_ldap_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_xml_ldap_shutdown);
 SWITCH_MODULE_DEFINITION(mod_xml_ldap, mod_xml_ldap_load, mod_xml_ldap_shutdown, NULL);
 
+/* most bound connections a binding keeps around between lookups */
+#define XML_LDAP_MAX_POOL 64
+
 typedef struct xml_binding {
 	char *bindings;
 	char *host;
@@ -67,8 +70,21 @@ typedef struct xml_binding {
 	char *filter;
 	char **attrs;
 	lutilSASLdefaults *defaults;
+	/* bound connections waiting for the next lookup, guarded by mutex */
+	switch_mutex_t *mutex;
+	LDAP *idle[XML_LDAP_MAX_POOL];
+	int idle_count;
+	int pool_size;
+	/* milliseconds a search may take, 0 waits for ever */
+	int timeout;
+	struct xml_binding *next;
 } xml_binding_t;
 
+static struct {
+	switch_memory_pool_t *pool;
+	xml_binding_t *bindings;
+} globals;
+
 typedef struct ldap_c {
 	LDAP *ld;
 	LDAPMessage *msg;
@@ -212,6 +228,138 @@ static switch_status_t xml_ldap_directory_result(void *ldap_connection, xml_bind
 }
 
 
+/* A new connection, bound the way the binding says */
+static LDAP *xml_ldap_connect(xml_binding_t *binding)
+{
+	LDAP *ld;
+	int auth_method = LDAP_AUTH_SIMPLE;
+	int desired_version = LDAP_VERSION3;
+	char *sp = NULL;
+
+	if ((ld = (LDAP *) ldap_init(binding->host, LDAP_PORT)) == NULL) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to connect to ldap server.%s\n", binding->host);
+		return NULL;
+	}
+
+	if (ldap_set_option(ld, LDAP_OPT_PROTOCOL_VERSION, &desired_version) != LDAP_OPT_SUCCESS) {
+		goto fail;
+	}
+
+	ldap_set_option(ld, LDAP_OPT_X_SASL_SECPROPS, &sp);
+
+#ifdef LDAP_OPT_NETWORK_TIMEOUT
+	if (binding->timeout) {
+		struct timeval tv = { binding->timeout / 1000, (binding->timeout % 1000) * 1000 };
+		ldap_set_option(ld, LDAP_OPT_NETWORK_TIMEOUT, &tv);
+	}
+#endif
+
+	if (binding->binddn) {
+		if (ldap_bind_s(ld, binding->binddn, binding->bindpass, auth_method) != LDAP_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to bind to ldap server %s as %s\n", binding->host, binding->binddn);
+			goto fail;
+		}
+	} else {
+		if (ldap_sasl_interactive_bind_s
+			(ld, NULL, binding->defaults->mech, NULL, NULL, (unsigned) (intptr_t) LDAP_SASL_SIMPLE, lutil_sasl_interact,
+			 binding->defaults) != LDAP_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to sasl_bind to ldap server %s as %s\n", binding->host,
+							  binding->defaults->authcid);
+			goto fail;
+		}
+	}
+
+	return ld;
+
+  fail:
+	ldap_unbind_s(ld);
+	return NULL;
+}
+
+/* Take a bound connection from the pool, or bind a new one. reused tells the caller the server may have dropped it meanwhile */
+static LDAP *xml_ldap_get_connection(xml_binding_t *binding, switch_bool_t pooled, switch_bool_t *reused)
+{
+	LDAP *ld = NULL;
+
+	*reused = SWITCH_FALSE;
+
+	if (pooled) {
+		switch_mutex_lock(binding->mutex);
+		if (binding->idle_count) {
+			ld = binding->idle[--binding->idle_count];
+			*reused = SWITCH_TRUE;
+		}
+		switch_mutex_unlock(binding->mutex);
+	}
+
+	if (!ld) {
+		ld = xml_ldap_connect(binding);
+	}
+
+	return ld;
+}
+
+/* Hand a connection back, one that failed or does not fit in the pool is unbound */
+static void xml_ldap_release_connection(xml_binding_t *binding, LDAP *ld, switch_bool_t ok)
+{
+	if (ok) {
+		switch_mutex_lock(binding->mutex);
+		if (binding->idle_count < binding->pool_size) {
+			binding->idle[binding->idle_count++] = ld;
+			ld = NULL;
+		}
+		switch_mutex_unlock(binding->mutex);
+	}
+
+	if (ld) {
+		ldap_unbind_s(ld);
+	}
+}
+
+/* Unbind every idle connection, once one has gone stale the rest usually have too */
+static void xml_ldap_flush_pool(xml_binding_t *binding)
+{
+	LDAP *idle[XML_LDAP_MAX_POOL];
+	int i, count;
+
+	switch_mutex_lock(binding->mutex);
+	count = binding->idle_count;
+	memcpy(idle, binding->idle, count * sizeof(LDAP *));
+	binding->idle_count = 0;
+	switch_mutex_unlock(binding->mutex);
+
+	for (i = 0; i < count; i++) {
+		ldap_unbind_s(idle[i]);
+	}
+}
+
+/* Search without waiting longer than the binding allows, returns the LDAP result code */
+static int xml_ldap_query(xml_binding_t *binding, LDAP *ld, const char *base, const char *filter, LDAPMessage **msg)
+{
+	struct timeval tv, *tvp = NULL;
+	int msgid, rc;
+
+	if (binding->timeout) {
+		tv.tv_sec = binding->timeout / 1000;
+		tv.tv_usec = (binding->timeout % 1000) * 1000;
+		tvp = &tv;
+	}
+
+	if ((rc = ldap_search_ext(ld, base, LDAP_SCOPE_SUBTREE, filter, NULL, 0, NULL, NULL, tvp, 0, &msgid)) != LDAP_SUCCESS) {
+		return rc;
+	}
+
+	switch (ldap_result(ld, msgid, LDAP_MSG_ALL, tvp, msg)) {
+	case -1:
+		return LDAP_SERVER_DOWN;
+	case 0:
+		/* the connection is dropped after a timeout, unbinding abandons the search with it */
+		return LDAP_TIMEOUT;
+	default:
+		return ldap_result2error(ld, *msg, 0);
+	}
+}
+
 static switch_xml_t xml_ldap_search(const char *section, const char *tag_name, const char *key_name, const char *key_value, switch_event_t *params,
 									void *user_data)
 {
@@ -220,16 +368,15 @@ static switch_xml_t xml_ldap_search(const char *section, const char *tag_name, c
 
 	switch_xml_t xml = NULL, sub = NULL;
 
-	struct ldap_c ldap_connection;
+	struct ldap_c ldap_connection = { 0 };
 	struct ldap_c *ldap = &ldap_connection;
 
-	int auth_method = LDAP_AUTH_SIMPLE;
-	int desired_version = LDAP_VERSION3;
 	xml_ldap_query_type_t query_type;
 	char *dir_exten = NULL, *dir_domain = NULL;
 
 	char *search_filter = NULL, *search_base = NULL;
-	int off = 0, ret = 1;
+	int off = 0, ret = 1, rc = LDAP_OTHER, attempt;
+	switch_bool_t reused = SWITCH_FALSE, ld_ok = SWITCH_FALSE;
 
 	//char *buf;
 	//buf = malloc(4096);
@@ -340,36 +487,34 @@ static switch_xml_t xml_ldap_search(const char *section, const char *tag_name, c
 
 
 
-	if ((ldap->ld = (LDAP *) ldap_init(binding->host, LDAP_PORT)) == NULL) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to connect to ldap server.%s\n", binding->host);
-		goto cleanup;
-	}
-
-	if (ldap_set_option(ldap->ld, LDAP_OPT_PROTOCOL_VERSION, &desired_version) != LDAP_OPT_SUCCESS) {
-		goto cleanup;
-	}
+	/* a pooled connection the server has closed fails the first try, the second always binds a fresh one */
+	for (attempt = 0; attempt < 2; attempt++) {
+		if (!(ldap->ld = xml_ldap_get_connection(binding, attempt == 0, &reused))) {
+			goto cleanup;
+		}
 
-	ldap_set_option(ldap->ld, LDAP_OPT_X_SASL_SECPROPS, &ldap->sp);
+		if ((rc = xml_ldap_query(binding, ldap->ld, search_base, search_filter, &ldap->msg)) == LDAP_SUCCESS || rc == LDAP_NO_SUCH_OBJECT) {
+			ld_ok = SWITCH_TRUE;
+			break;
+		}
 
+		if (ldap->msg) {
+			ldap_msgfree(ldap->msg);
+			ldap->msg = NULL;
+		}
 
+		xml_ldap_release_connection(binding, ldap->ld, SWITCH_FALSE);
+		ldap->ld = NULL;
 
-	if (binding->binddn) {
-		if (ldap_bind_s(ldap->ld, binding->binddn, binding->bindpass, auth_method) != LDAP_SUCCESS) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to bind to ldap server %s as %s\n", binding->host, binding->binddn);
-			goto cleanup;
-		}
-	} else {
-		if (ldap_sasl_interactive_bind_s
-			(ldap->ld, NULL, binding->defaults->mech, NULL, NULL, (unsigned) (intptr_t) LDAP_SASL_SIMPLE, lutil_sasl_interact,
-			 binding->defaults) != LDAP_SUCCESS) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to sasl_bind to ldap server %s as %s\n", binding->host,
-							  binding->defaults->authcid);
-			goto cleanup;
+		if (!reused || rc == LDAP_TIMEOUT) {
+			break;
 		}
+
+		xml_ldap_flush_pool(binding);
 	}
 
-	if (ldap_search_s(ldap->ld, search_base, LDAP_SCOPE_SUBTREE, search_filter, NULL, 0, &ldap->msg) != LDAP_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Query failed: -b \"%s\" \"%s\"\n", search_base, search_filter);
+	if (!ld_ok) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Query failed: -b \"%s\" \"%s\": %s\n", search_base, search_filter, ldap_err2string(rc));
 		goto cleanup;
 	}
 
@@ -389,7 +534,7 @@ static switch_xml_t xml_ldap_search(const char *section, const char *tag_name, c
 	}
 
 	if (ldap->ld) {
-		ldap_unbind_s(ldap->ld);
+		xml_ldap_release_connection(binding, ldap->ld, ld_ok);
 	}
 
 	switch_safe_free(search_filter);
@@ -412,6 +557,7 @@ static switch_status_t do_config(void)
 	char *cf = "xml_ldap.conf";
 	switch_xml_t cfg, xml, bindings_tag, binding_tag, param;
 	xml_binding_t *binding = NULL;
+	switch_xml_binding_t *xml_binding = NULL;
 	int x = 0;
 
 	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
@@ -426,6 +572,8 @@ static switch_status_t do_config(void)
 
 	for (binding_tag = switch_xml_child(bindings_tag, "binding"); binding_tag; binding_tag = binding_tag->next) {
 		char *bname = (char *) switch_xml_attr_soft(binding_tag, "name");
+		uint32_t cache_ttl = 0;
+		const char *cache_key_params = "user,domain";
 
 		if (!(binding = malloc(sizeof(*binding)))) {
 			goto done;
@@ -437,6 +585,9 @@ static switch_status_t do_config(void)
 		}
 		memset(binding->defaults, 0, sizeof(lutilSASLdefaults));
 
+		binding->pool_size = 4;
+		binding->timeout = 5000;
+
 		for (param = switch_xml_child(binding_tag, "param"); param; param = param->next) {
 
 			char *var = (char *) switch_xml_attr_soft(param, "name");
@@ -463,6 +614,23 @@ static switch_status_t do_config(void)
 				binding->defaults->authcid = strdup(val);
 			} else if (!strcasecmp(var, "authzid")) {
 				binding->defaults->authzid = strdup(val);
+			} else if (!strcasecmp(var, "pool-size")) {
+				int tmp = atoi(val);
+				if (tmp >= 0 && tmp <= XML_LDAP_MAX_POOL) {
+					binding->pool_size = tmp;
+				}
+			} else if (!strcasecmp(var, "timeout")) {
+				int tmp = atoi(val);
+				if (tmp >= 0) {
+					binding->timeout = tmp;
+				}
+			} else if (!strcasecmp(var, "cache-ttl")) {
+				int tmp = atoi(val);
+				if (tmp >= 0) {
+					cache_ttl = (uint32_t) tmp;
+				}
+			} else if (!strcasecmp(var, "cache-key-params")) {
+				cache_key_params = val;
 			}
 
 		}
@@ -476,8 +644,19 @@ static switch_status_t do_config(void)
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Binding [%s] XML Fetch Function [%s] (%s) [%s]\n",
 						  zstr(bname) ? "N/A" : bname, binding->basedn, binding->filter, binding->bindings ? binding->bindings : "all");
 
-		switch_xml_bind_search_function(xml_ldap_search, switch_xml_parse_section_string(bname), binding);
+		switch_mutex_init(&binding->mutex, SWITCH_MUTEX_NESTED, globals.pool);
+
+		switch_xml_bind_search_function_ret(xml_ldap_search, switch_xml_parse_section_string(bname), binding, &xml_binding);
+		if (cache_ttl && xml_binding) {
+			/* the server and base are part of the name so answers from another directory are never reused */
+			char *snapshot_name = switch_mprintf("xml_ldap:%s:%s:%s", zstr(bname) ? "" : bname, switch_str_nil(binding->host), binding->basedn);
 
+			switch_xml_set_binding_cache(xml_binding, cache_ttl, cache_key_params);
+			switch_xml_set_binding_name(xml_binding, snapshot_name);
+			switch_safe_free(snapshot_name);
+		}
+		binding->next = globals.bindings;
+		globals.bindings = binding;
 		x++;
 		binding = NULL;
 	}
@@ -493,6 +672,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_ldap_load)
 {
 	switch_api_interface_t *xml_ldap_api_interface;
 
+	memset(&globals, 0, sizeof(globals));
+	globals.pool = pool;
+
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
@@ -509,6 +691,15 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_ldap_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_xml_ldap_shutdown)
 {
+	xml_binding_t *binding;
+
+	/* no lookup can get at a binding after this, the pooled connections can go */
+	switch_xml_unbind_search_function_ptr(xml_ldap_search);
+
+	for (binding = globals.bindings; binding; binding = binding->next) {
+		xml_ldap_flush_pool(binding);
+	}
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -599,6 +599,10 @@ abyss_bool handler_hook(TSession * r)
 	} else if ((command = strstr(r->requestInfo.uri, "/xmlapi/"))) {
 		command += 8;
 		xml++;
+	} else if (!strcmp(r->requestInfo.uri, "/metrics")) {
+		/* where prometheus looks by default */
+		command = "metrics";
+		text++;
 	} else {
 		return FALSE;
 	}
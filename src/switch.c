@@ -418,6 +418,7 @@ int main(int argc, char *argv[])
 		"\t-nonatmap              -- disable auto nat port mapping\n"
 		"\t-nocal                 -- disable clock calibration\n"
 		"\t-nort                  -- disable clock clock_realtime\n"
+		"\t-xml-snapshot          -- start from a snapshot of the preprocessed xml when no included file changed\n"
 		"\t-stop                  -- stop freeswitch\n"
 		"\t-nc                    -- do not output to a console and background\n"
 #ifndef WIN32
@@ -614,6 +615,11 @@ int main(int argc, char *argv[])
 			known_opt++;
 		}
 
+		if (local_argv[x] && !strcmp(local_argv[x], "-xml-snapshot")) {
+			flags |= SCF_XML_SNAPSHOT;
+			known_opt++;
+		}
+
 		if (local_argv[x] && !strcmp(local_argv[x], "-vg")) {
 			flags |= SCF_VG;
 			known_opt++;
@@ -54,6 +54,7 @@
 #include <apr_strings.h>
 #define APR_WANT_STDIO
 #define APR_WANT_STRFUNC
+#define APR_WANT_IOVEC
 #include <apr_want.h>
 #include <apr_file_info.h>
 #include <apr_fnmatch.h>
@@ -685,6 +686,17 @@ SWITCH_DECLARE(switch_status_t) switch_socket_close(switch_socket_t *sock)
 	return apr_socket_close(sock);
 }
 
+SWITCH_DECLARE(int) switch_socket_fd_get(switch_socket_t *sock)
+{
+	apr_os_sock_t fd = -1;
+
+	if (!sock || apr_os_sock_get(&fd, sock) != APR_SUCCESS) {
+		return -1;
+	}
+
+	return (int) fd;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_socket_bind(switch_socket_t *sock, switch_sockaddr_t *sa)
 {
 	return apr_socket_bind(sock, sa);
@@ -730,6 +742,63 @@ SWITCH_DECLARE(switch_status_t) switch_socket_send(switch_socket_t *sock, const
 	return status;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_socket_sendv(switch_socket_t *sock, const switch_io_vec_t *vec, int32_t nvec, switch_size_t *len)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	struct iovec iov[SWITCH_IO_VEC_MAX];
+	switch_size_t wrote = 0, need;
+	int32_t i, n = 0;
+	int to_count = 0;
+
+	if (nvec > SWITCH_IO_VEC_MAX) {
+		*len = 0;
+		return SWITCH_STATUS_GENERR;
+	}
+
+	for (i = 0; i < nvec; i++) {
+		if (vec[i].len) {
+			iov[n].iov_base = (void *) vec[i].base;
+			iov[n].iov_len = vec[i].len;
+			n++;
+		}
+	}
+
+	i = 0;
+
+	while (i < n) {
+		need = 0;
+		status = apr_socket_sendv(sock, iov + i, n - i, &need);
+		wrote += need;
+
+		/* step over whatever made it out, a short write can stop in the middle of a buffer */
+		while (i < n && need >= iov[i].iov_len) {
+			need -= iov[i].iov_len;
+			i++;
+		}
+
+		if (i < n && need) {
+			iov[i].iov_base = (char *) iov[i].iov_base + need;
+			iov[i].iov_len -= need;
+		}
+
+		if (status == SWITCH_STATUS_BREAK || status == 730035 || status == 35) {
+			if (++to_count > 60000) {
+				status = SWITCH_STATUS_FALSE;
+				break;
+			}
+			switch_yield(10000);
+			status = SWITCH_STATUS_SUCCESS;
+		} else if (status != SWITCH_STATUS_SUCCESS) {
+			break;
+		} else {
+			to_count = 0;
+		}
+	}
+
+	*len = wrote;
+	return status;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_socket_send_nonblock(switch_socket_t *sock, const char *buf, switch_size_t *len)
 {
 	if (!sock || !buf || !len) {
@@ -844,6 +913,38 @@ SWITCH_DECLARE(uint16_t) switch_sockaddr_get_port(switch_sockaddr_t *sa)
 	return sa->port;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_sockaddr_set_native(switch_sockaddr_t *sa, const void *native, switch_size_t len)
+{
+	const struct sockaddr *addr = (const struct sockaddr *) native;
+
+	if (!sa || !addr || !len || len > sizeof(sa->sa)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	memcpy(&sa->sa, addr, len);
+	sa->family = addr->sa_family;
+
+	if (sa->family == APR_INET) {
+		sa->salen = sizeof(struct sockaddr_in);
+		sa->addr_str_len = 16;
+		sa->ipaddr_ptr = &(sa->sa.sin.sin_addr);
+		sa->ipaddr_len = sizeof(struct in_addr);
+	}
+#if APR_HAVE_IPV6
+	else if (sa->family == APR_INET6) {
+		sa->salen = sizeof(struct sockaddr_in6);
+		sa->addr_str_len = 46;
+		sa->ipaddr_ptr = &(sa->sa.sin6.sin6_addr);
+		sa->ipaddr_len = sizeof(struct in6_addr);
+	}
+#endif
+
+	/* sin_port and sin6_port live at the same offset */
+	sa->port = ntohs(sa->sa.sin.sin_port);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_DECLARE(int32_t) switch_sockaddr_get_family(switch_sockaddr_t *sa)
 {
 	return sa->family;
@@ -1078,6 +1179,115 @@ SWITCH_DECLARE(switch_status_t) switch_queue_trypush(switch_queue_t *queue, void
 	return s;
 }
 
+/* Vyukov's intrusive MPSC queue: producers swing head to their node and then link the old head to it,
+   the consumer follows the links from tail and parks a stub node on the queue when it would empty it. */
+struct switch_mpsc_queue {
+	switch_mpsc_node_t *volatile head;
+	switch_mpsc_node_t *tail;
+	switch_mpsc_node_t stub;
+	volatile apr_uint32_t size;
+	volatile apr_uint32_t popping;
+	uint32_t capacity;
+};
+
+static void mpsc_link(switch_mpsc_queue_t *queue, switch_mpsc_node_t *node)
+{
+	switch_mpsc_node_t *prev;
+
+	node->next = NULL;
+
+	do {
+		prev = queue->head;
+	} while (apr_atomic_casptr((volatile void **) &queue->head, node, prev) != prev);
+
+	/* until this lands the consumer sees the chain end early and reports empty */
+	apr_atomic_casptr((volatile void **) &prev->next, node, NULL);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_mpsc_queue_create(switch_mpsc_queue_t **queue, uint32_t capacity, switch_memory_pool_t *pool)
+{
+	switch_mpsc_queue_t *q;
+
+	if (!(q = apr_pcalloc(pool, sizeof(*q)))) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	q->head = q->tail = &q->stub;
+	q->capacity = capacity;
+	*queue = q;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_mpsc_queue_trypush(switch_mpsc_queue_t *queue, switch_mpsc_node_t *node, void *data)
+{
+	if (queue->capacity && apr_atomic_inc32(&queue->size) >= queue->capacity) {
+		apr_atomic_dec32(&queue->size);
+		return SWITCH_STATUS_FALSE;
+	} else if (!queue->capacity) {
+		apr_atomic_inc32(&queue->size);
+	}
+
+	node->data = data;
+	mpsc_link(queue, node);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_mpsc_queue_trypop(switch_mpsc_queue_t *queue, void **data)
+{
+	switch_mpsc_node_t *tail, *next;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (!apr_atomic_read32(&queue->size)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (apr_atomic_cas32(&queue->popping, 1, 0) != 0) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	tail = queue->tail;
+	next = tail->next;
+
+	if (tail == &queue->stub) {
+		if (!next) {
+			goto end;
+		}
+		queue->tail = tail = next;
+		next = next->next;
+	}
+
+	if (!next) {
+		if (tail != queue->head) {
+			/* a producer has swung head but not linked yet */
+			goto end;
+		}
+
+		mpsc_link(queue, &queue->stub);
+
+		if (!(next = tail->next)) {
+			goto end;
+		}
+	}
+
+	queue->tail = next;
+	*data = tail->data;
+	apr_atomic_dec32(&queue->size);
+	status = SWITCH_STATUS_SUCCESS;
+
+  end:
+
+	apr_atomic_set32(&queue->popping, 0);
+
+	return status;
+}
+
+SWITCH_DECLARE(uint32_t) switch_mpsc_queue_size(switch_mpsc_queue_t *queue)
+{
+	return apr_atomic_read32(&queue->size);
+}
+
 SWITCH_DECLARE(int) switch_vasprintf(char **ret, const char *fmt, va_list ap)
 {
 #ifdef HAVE_VASPRINTF
@@ -337,6 +337,211 @@ SWITCH_DECLARE(void) switch_buffer_destroy(switch_buffer_t **buffer)
 	}
 }
 
+/* Single producer / single consumer ring.  head and tail are free running counters that are
+   masked on access, each lives on its own cache line so the two sides never share one. */
+
+#define SWITCH_RING_CACHE_LINE 64
+
+#if defined(__GNUC__)
+#define switch_ring_barrier() __sync_synchronize()
+#elif defined(_MSC_VER)
+#define switch_ring_barrier() MemoryBarrier()
+#else
+#define switch_ring_barrier()
+#endif
+
+struct switch_ringbuffer {
+	volatile switch_size_t head;
+	char head_pad[SWITCH_RING_CACHE_LINE - sizeof(switch_size_t)];
+	volatile switch_size_t tail;
+	char tail_pad[SWITCH_RING_CACHE_LINE - sizeof(switch_size_t)];
+	switch_byte_t *data;
+	switch_size_t size;
+	switch_size_t mask;
+};
+
+SWITCH_DECLARE(switch_status_t) switch_ringbuffer_create(switch_ringbuffer_t **ringbuffer, switch_size_t size)
+{
+	switch_ringbuffer_t *new_ring;
+	switch_size_t real_size = SWITCH_RING_CACHE_LINE;
+
+	while (real_size < size) {
+		real_size <<= 1;
+	}
+
+	if (!(new_ring = malloc(sizeof(*new_ring)))) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	memset(new_ring, 0, sizeof(*new_ring));
+
+	if (!(new_ring->data = malloc(real_size))) {
+		free(new_ring);
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	new_ring->size = real_size;
+	new_ring->mask = real_size - 1;
+
+	*ringbuffer = new_ring;
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_ringbuffer_destroy(switch_ringbuffer_t **ringbuffer)
+{
+	if (ringbuffer && *ringbuffer) {
+		switch_safe_free((*ringbuffer)->data);
+		free(*ringbuffer);
+		*ringbuffer = NULL;
+	}
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_len(switch_ringbuffer_t *ringbuffer)
+{
+	return ringbuffer->size;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_inuse(switch_ringbuffer_t *ringbuffer)
+{
+	switch_size_t tail = ringbuffer->tail;
+	switch_size_t head = ringbuffer->head;
+
+	return head - tail;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_freespace(switch_ringbuffer_t *ringbuffer)
+{
+	return ringbuffer->size - switch_ringbuffer_inuse(ringbuffer);
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_reserve_zerocopy(switch_ringbuffer_t *ringbuffer, void **ptr)
+{
+	switch_size_t head = ringbuffer->head;
+	switch_size_t free_len = ringbuffer->size - (head - ringbuffer->tail);
+	switch_size_t to_end = ringbuffer->size - (head & ringbuffer->mask);
+
+	*ptr = ringbuffer->data + (head & ringbuffer->mask);
+
+	return free_len < to_end ? free_len : to_end;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_commit(switch_ringbuffer_t *ringbuffer, switch_size_t datalen)
+{
+	switch_size_t free_len = switch_ringbuffer_freespace(ringbuffer);
+
+	if (datalen > free_len) {
+		datalen = free_len;
+	}
+
+	/* the data must be visible before the consumer can see the new head */
+	switch_ring_barrier();
+	ringbuffer->head += datalen;
+
+	return datalen;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_write(switch_ringbuffer_t *ringbuffer, const void *data, switch_size_t datalen)
+{
+	switch_size_t head, index, first;
+
+	switch_assert(ringbuffer != NULL);
+
+	if (!datalen || switch_ringbuffer_freespace(ringbuffer) < datalen) {
+		return 0;
+	}
+
+	head = ringbuffer->head;
+	index = head & ringbuffer->mask;
+	first = ringbuffer->size - index;
+
+	if (first > datalen) {
+		first = datalen;
+	}
+
+	memcpy(ringbuffer->data + index, data, first);
+
+	if (first < datalen) {
+		memcpy(ringbuffer->data, (const switch_byte_t *) data + first, datalen - first);
+	}
+
+	switch_ring_barrier();
+	ringbuffer->head = head + datalen;
+
+	return datalen;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_peek_zerocopy(switch_ringbuffer_t *ringbuffer, const void **ptr)
+{
+	switch_size_t tail = ringbuffer->tail;
+	switch_size_t used = ringbuffer->head - tail;
+	switch_size_t to_end = ringbuffer->size - (tail & ringbuffer->mask);
+
+	/* do not look at the data until we have seen the head that published it */
+	switch_ring_barrier();
+	*ptr = ringbuffer->data + (tail & ringbuffer->mask);
+
+	return used < to_end ? used : to_end;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_toss(switch_ringbuffer_t *ringbuffer, switch_size_t datalen)
+{
+	switch_size_t used = switch_ringbuffer_inuse(ringbuffer);
+
+	if (datalen > used) {
+		datalen = used;
+	}
+
+	/* finish reading the data before the producer can reuse the space */
+	switch_ring_barrier();
+	ringbuffer->tail += datalen;
+
+	return datalen;
+}
+
+SWITCH_DECLARE(switch_size_t) switch_ringbuffer_read(switch_ringbuffer_t *ringbuffer, void *data, switch_size_t datalen)
+{
+	switch_size_t tail, used, index, first;
+
+	switch_assert(ringbuffer != NULL);
+
+	tail = ringbuffer->tail;
+	used = ringbuffer->head - tail;
+
+	if (!used || !datalen) {
+		return 0;
+	}
+
+	if (datalen > used) {
+		datalen = used;
+	}
+
+	switch_ring_barrier();
+
+	index = tail & ringbuffer->mask;
+	first = ringbuffer->size - index;
+
+	if (first > datalen) {
+		first = datalen;
+	}
+
+	memcpy(data, ringbuffer->data + index, first);
+
+	if (first < datalen) {
+		memcpy((switch_byte_t *) data + first, ringbuffer->data, datalen - first);
+	}
+
+	switch_ring_barrier();
+	ringbuffer->tail = tail + datalen;
+
+	return datalen;
+}
+
+SWITCH_DECLARE(void) switch_ringbuffer_zero(switch_ringbuffer_t *ringbuffer)
+{
+	switch_ring_barrier();
+	ringbuffer->tail = ringbuffer->head;
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
@@ -120,6 +120,29 @@ typedef enum {
 	LP_ORIGINATEE
 } switch_originator_type_t;
 
+/* the profiles are filled in before they are linked in and never freed before the session, so readers only need the
+   stores that built them to land before the pointer does */
+#if defined(__GNUC__)
+#define profile_publish_barrier() __sync_synchronize()
+#elif defined(_MSC_VER)
+#define profile_publish_barrier() MemoryBarrier()
+#else
+#define profile_publish_barrier()
+#endif
+
+/* what the profile headers were made from, a shallow compare tells when they have to be made again */
+typedef struct {
+	switch_caller_profile_t *caller;
+	switch_caller_profile_t *other;
+	switch_originator_type_t other_type;
+	switch_caller_profile_t caller_copy;
+	switch_caller_profile_t other_copy;
+	switch_channel_timetable_t caller_times;
+	switch_channel_timetable_t other_times;
+	int caller_soft;
+	int other_soft;
+} profile_shadow_t;
+
 struct switch_channel {
 	char *name;
 	switch_call_direction_t direction;
@@ -141,6 +164,11 @@ struct switch_channel {
 	const switch_state_handler_table_t *state_handlers[SWITCH_MAX_STATE_HANDLERS];
 	int state_handler_index;
 	switch_event_t *variables;
+	/* frozen copy of variables shared by the events fired until the next change, guarded by profile_mutex */
+	switch_event_snapshot_t *variables_snapshot;
+	/* frozen Caller- and Other-Leg- headers shared by the events fired while the profiles still match profile_shadow */
+	switch_event_snapshot_t *profile_snapshot;
+	profile_shadow_t profile_shadow;
 	switch_event_t *scope_variables;
 	switch_hash_t *private_hash;
 	switch_hash_t *app_flag_hash;
@@ -154,6 +182,15 @@ struct switch_channel {
 	switch_event_t *app_list;
 	switch_event_t *api_list;
 	switch_event_t *var_list;
+	/* woken on every state or flag change, guarded by waiter_mutex */
+	switch_mutex_t *waiter_mutex;
+	switch_channel_waiter_t *waiter;
+};
+
+struct switch_channel_waiter {
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	uint32_t pending;
 };
 
 
@@ -347,6 +384,7 @@ SWITCH_DECLARE(switch_status_t) switch_channel_alloc(switch_channel_t **channel,
 	switch_mutex_init(&(*channel)->flag_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_mutex_init(&(*channel)->state_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_mutex_init(&(*channel)->profile_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&(*channel)->waiter_mutex, SWITCH_MUTEX_NESTED, pool);
 	(*channel)->hangup_cause = SWITCH_CAUSE_NONE;
 	(*channel)->name = "";
 	(*channel)->direction = direction;
@@ -355,6 +393,88 @@ SWITCH_DECLARE(switch_status_t) switch_channel_alloc(switch_channel_t **channel,
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_channel_waiter_create(switch_channel_waiter_t **waiter, switch_memory_pool_t *pool)
+{
+	switch_channel_waiter_t *w;
+
+	switch_assert(pool != NULL);
+
+	if (!(w = switch_core_alloc(pool, sizeof(*w)))) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	switch_mutex_init(&w->mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_thread_cond_create(&w->cond, pool);
+	*waiter = w;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_channel_waiter_signal(switch_channel_waiter_t *waiter)
+{
+	switch_mutex_lock(waiter->mutex);
+	waiter->pending++;
+	switch_thread_cond_signal(waiter->cond);
+	switch_mutex_unlock(waiter->mutex);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_channel_waiter_wait(switch_channel_waiter_t *waiter, uint32_t ms)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	switch_mutex_lock(waiter->mutex);
+	if (!waiter->pending) {
+		switch_thread_cond_timedwait(waiter->cond, waiter->mutex, (switch_interval_time_t) ms * 1000);
+	}
+	if (!waiter->pending) {
+		status = SWITCH_STATUS_TIMEOUT;
+	}
+	waiter->pending = 0;
+	switch_mutex_unlock(waiter->mutex);
+
+	return status;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_channel_set_waiter(switch_channel_t *channel, switch_channel_waiter_t *waiter)
+{
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	switch_assert(channel != NULL);
+
+	switch_mutex_lock(channel->waiter_mutex);
+	if (!channel->waiter || channel->waiter == waiter) {
+		channel->waiter = waiter;
+		status = SWITCH_STATUS_SUCCESS;
+	}
+	switch_mutex_unlock(channel->waiter_mutex);
+
+	return status;
+}
+
+SWITCH_DECLARE(void) switch_channel_clear_waiter(switch_channel_t *channel, switch_channel_waiter_t *waiter)
+{
+	switch_assert(channel != NULL);
+
+	switch_mutex_lock(channel->waiter_mutex);
+	if (channel->waiter == waiter) {
+		channel->waiter = NULL;
+	}
+	switch_mutex_unlock(channel->waiter_mutex);
+}
+
+static void channel_wake_waiter(switch_channel_t *channel)
+{
+	if (!channel->waiter) {
+		return;
+	}
+
+	switch_mutex_lock(channel->waiter_mutex);
+	if (channel->waiter) {
+		switch_channel_waiter_signal(channel->waiter);
+	}
+	switch_mutex_unlock(channel->waiter_mutex);
+}
+
 SWITCH_DECLARE(switch_size_t) switch_channel_has_dtmf(switch_channel_t *channel)
 {
 	switch_size_t has;
@@ -579,7 +699,12 @@ SWITCH_DECLARE(void) switch_channel_uninit(switch_channel_t *channel)
 	if (channel->app_flag_hash) {
 		switch_core_hash_destroy(&channel->app_flag_hash);
 	}
+	if (channel->session) {
+		switch_channel_index_variables(channel, switch_core_session_get_uuid(channel->session), SWITCH_FALSE);
+	}
 	switch_mutex_lock(channel->profile_mutex);
+	switch_event_snapshot_release(&channel->variables_snapshot);
+	switch_event_snapshot_release(&channel->profile_snapshot);
 	switch_event_destroy(&channel->variables);
 	switch_event_destroy(&channel->api_list);
 	switch_event_destroy(&channel->var_list);
@@ -1002,6 +1127,9 @@ SWITCH_DECLARE(switch_status_t) switch_channel_set_profile_var(switch_channel_t
 			}
 		}
 	}
+
+	/* a changed field shows up in the shallow compare, be explicit anyway */
+	switch_event_snapshot_release(&channel->profile_snapshot);
 	switch_mutex_unlock(channel->profile_mutex);
 
 	return status;
@@ -1192,15 +1320,45 @@ SWITCH_DECLARE(void) switch_channel_set_presence_data_vals(switch_channel_t *cha
 }
 
 
+/* call with profile_mutex held, after the variable changed */
+static void channel_index_update(switch_channel_t *channel, const char *varname, const char *old_val)
+{
+	if (channel->session) {
+		switch_core_session_variable_index_update(switch_core_session_get_uuid(channel->session), varname, old_val,
+												  switch_event_get_header(channel->variables, varname));
+	}
+}
+
+SWITCH_DECLARE(void) switch_channel_index_variables(switch_channel_t *channel, const char *uuid, switch_bool_t add)
+{
+	switch_event_header_t *hp;
+
+	switch_mutex_lock(channel->profile_mutex);
+	if (channel->variables) {
+		for (hp = channel->variables->headers; hp; hp = hp->next) {
+			if (switch_core_session_variable_indexed(hp->name)) {
+				switch_core_session_variable_index_update(uuid, hp->name, add ? NULL : hp->value, add ? hp->value : NULL);
+			}
+		}
+	}
+	switch_mutex_unlock(channel->profile_mutex);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_channel_set_variable_var_check(switch_channel_t *channel,
 																	  const char *varname, const char *value, switch_bool_t var_check)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
+	switch_bool_t indexed = switch_core_session_variable_indexed(varname);
+	char *old_val = NULL;
 
 	switch_assert(channel != NULL);
 
 	switch_mutex_lock(channel->profile_mutex);
 	if (channel->variables && !zstr(varname)) {
+		switch_event_snapshot_release(&channel->variables_snapshot);
+		if (indexed) {
+			old_val = switch_safe_strdup(switch_event_get_header(channel->variables, varname));
+		}
 		if (zstr(value)) {
 			switch_event_del_header(channel->variables, varname);
 		} else {
@@ -1215,6 +1373,10 @@ SWITCH_DECLARE(switch_status_t) switch_channel_set_variable_var_check(switch_cha
 				switch_log_printf(SWITCH_CHANNEL_CHANNEL_LOG(channel), SWITCH_LOG_CRIT, "Invalid data (${%s} contains a variable)\n", varname);
 			}
 		}
+		if (indexed) {
+			channel_index_update(channel, varname, old_val);
+			switch_safe_free(old_val);
+		}
 		status = SWITCH_STATUS_SUCCESS;
 	}
 	switch_mutex_unlock(channel->profile_mutex);
@@ -1227,11 +1389,17 @@ SWITCH_DECLARE(switch_status_t) switch_channel_add_variable_var_check(switch_cha
 																	  const char *varname, const char *value, switch_bool_t var_check, switch_stack_t stack)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
+	switch_bool_t indexed = switch_core_session_variable_indexed(varname);
+	char *old_val = NULL;
 
 	switch_assert(channel != NULL);
 
 	switch_mutex_lock(channel->profile_mutex);
 	if (channel->variables && !zstr(varname)) {
+		switch_event_snapshot_release(&channel->variables_snapshot);
+		if (indexed) {
+			old_val = switch_safe_strdup(switch_event_get_header(channel->variables, varname));
+		}
 		if (zstr(value)) {
 			switch_event_del_header(channel->variables, varname);
 		} else {
@@ -1246,6 +1414,10 @@ SWITCH_DECLARE(switch_status_t) switch_channel_add_variable_var_check(switch_cha
 				switch_log_printf(SWITCH_CHANNEL_CHANNEL_LOG(channel), SWITCH_LOG_CRIT, "Invalid data (${%s} contains a variable)\n", varname);
 			}
 		}
+		if (indexed) {
+			channel_index_update(channel, varname, old_val);
+			switch_safe_free(old_val);
+		}
 		status = SWITCH_STATUS_SUCCESS;
 	}
 	switch_mutex_unlock(channel->profile_mutex);
@@ -1267,6 +1439,13 @@ SWITCH_DECLARE(switch_status_t) switch_channel_set_variable_printf(switch_channe
 
 	switch_mutex_lock(channel->profile_mutex);
 	if (channel->variables && !zstr(varname)) {
+		switch_bool_t indexed = switch_core_session_variable_indexed(varname);
+		char *old_val = NULL;
+
+		switch_event_snapshot_release(&channel->variables_snapshot);
+		if (indexed) {
+			old_val = switch_safe_strdup(switch_event_get_header(channel->variables, varname));
+		}
 		switch_event_del_header(channel->variables, varname);
 
 		va_start(ap, fmt);
@@ -1274,12 +1453,21 @@ SWITCH_DECLARE(switch_status_t) switch_channel_set_variable_printf(switch_channe
 		va_end(ap);
 
 		if (ret == -1) {
+			if (indexed) {
+				channel_index_update(channel, varname, old_val);
+				switch_safe_free(old_val);
+			}
 			switch_mutex_unlock(channel->profile_mutex);
 			return SWITCH_STATUS_MEMERR;
 		}
 
 		status = switch_channel_set_variable(channel, varname, data);
 		free(data);
+
+		if (indexed) {
+			channel_index_update(channel, varname, old_val);
+			switch_safe_free(old_val);
+		}
 	}
 	switch_mutex_unlock(channel->profile_mutex);
 
@@ -1590,6 +1778,8 @@ SWITCH_DECLARE(void) switch_channel_set_flag_value(switch_channel_t *channel, sw
 	channel->flags[flag] = value;
 	switch_mutex_unlock(channel->flag_mutex);
 
+	channel_wake_waiter(channel);
+
 	if (HELD) {
 		switch_channel_set_callstate(channel, CCS_HELD);
 		switch_mutex_lock(channel->profile_mutex);
@@ -1616,6 +1806,8 @@ SWITCH_DECLARE(void) switch_channel_set_flag_recursive(switch_channel_t *channel
 	channel->flags[flag]++;
 	switch_mutex_unlock(channel->flag_mutex);
 
+	channel_wake_waiter(channel);
+
 	if (flag == CF_OUTBOUND) {
 		switch_channel_set_variable(channel, "is_outbound", "true");
 	}
@@ -1737,6 +1929,8 @@ SWITCH_DECLARE(void) switch_channel_clear_flag(switch_channel_t *channel, switch
 	channel->flags[flag] = 0;
 	switch_mutex_unlock(channel->flag_mutex);
 
+	channel_wake_waiter(channel);
+
 	if (ACTIVE) {
 		switch_channel_set_callstate(channel, CCS_ACTIVE);
 		switch_mutex_lock(channel->profile_mutex);
@@ -1975,6 +2169,8 @@ SWITCH_DECLARE(switch_channel_state_t) switch_channel_perform_set_running_state(
 
 	switch_mutex_unlock(channel->state_mutex);
 
+	channel_wake_waiter(channel);
+
 	return (switch_channel_state_t) SWITCH_STATUS_SUCCESS;
 }
 
@@ -2177,6 +2373,8 @@ SWITCH_DECLARE(switch_channel_state_t) switch_channel_perform_set_state(switch_c
 		switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, switch_channel_get_uuid(channel), SWITCH_LOG_DEBUG, "(%s) State Change %s -> %s\n",
 						  channel->name, state_names[last_state], state_names[state]);
 
+		switch_core_session_trace(channel->session, SWITCH_TRACE_STATE, last_state, state, 0, NULL);
+
 		channel->state = state;
 
 		if (state == CS_HANGUP && !channel->hangup_cause) {
@@ -2196,9 +2394,90 @@ SWITCH_DECLARE(switch_channel_state_t) switch_channel_perform_set_state(switch_c
   done:
 
 	switch_mutex_unlock(channel->state_mutex);
+
+	if (ok) {
+		channel_wake_waiter(channel);
+	}
+
 	return channel->state;
 }
 
+static int profile_soft_count(switch_caller_profile_t *caller_profile)
+{
+	profile_node_t *pn;
+	int count = 0;
+
+	for (pn = caller_profile->soft; pn; pn = pn->next) {
+		count++;
+	}
+
+	return count;
+}
+
+static void profile_shadow_take(profile_shadow_t *shadow, switch_caller_profile_t *profile, switch_caller_profile_t *copy,
+								switch_channel_timetable_t *times, int *soft)
+{
+	memcpy(copy, profile, sizeof(*copy));
+
+	if (profile->times) {
+		memcpy(times, profile->times, sizeof(*times));
+	}
+
+	*soft = profile_soft_count(profile);
+}
+
+static switch_bool_t profile_shadow_match(switch_caller_profile_t *profile, switch_caller_profile_t *copy,
+										  switch_channel_timetable_t *times, int soft)
+{
+	return !memcmp(copy, profile, sizeof(*copy)) && (!profile->times || !memcmp(times, profile->times, sizeof(*times))) &&
+		profile_soft_count(profile) == soft;
+}
+
+/* call with profile_mutex held */
+static switch_event_snapshot_t *channel_profile_snapshot(switch_channel_t *channel, switch_caller_profile_t *caller_profile,
+														 switch_caller_profile_t *other_profile, switch_originator_type_t other_type)
+{
+	profile_shadow_t *shadow = &channel->profile_shadow;
+	switch_event_t *headers;
+
+	if (channel->profile_snapshot) {
+		if (shadow->caller == caller_profile && shadow->other == other_profile && shadow->other_type == other_type &&
+			profile_shadow_match(caller_profile, &shadow->caller_copy, &shadow->caller_times, shadow->caller_soft) &&
+			(!other_profile || profile_shadow_match(other_profile, &shadow->other_copy, &shadow->other_times, shadow->other_soft))) {
+			return channel->profile_snapshot;
+		}
+
+		switch_event_snapshot_release(&channel->profile_snapshot);
+	}
+
+	if (switch_event_create_subclass(&headers, SWITCH_EVENT_CLONE, NULL) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	switch_caller_profile_event_set_data(caller_profile, "Caller", headers);
+
+	if (other_profile) {
+		switch_event_add_header_string(headers, SWITCH_STACK_BOTTOM, "Other-Type", other_type == LP_ORIGINATOR ? "originator" : "originatee");
+		switch_caller_profile_event_set_data(other_profile, "Other-Leg", headers);
+	}
+
+	switch_event_snapshot_create(&channel->profile_snapshot, headers, "");
+	switch_event_destroy(&headers);
+
+	if (channel->profile_snapshot) {
+		memset(shadow, 0, sizeof(*shadow));
+		shadow->caller = caller_profile;
+		shadow->other = other_profile;
+		shadow->other_type = other_type;
+		profile_shadow_take(shadow, caller_profile, &shadow->caller_copy, &shadow->caller_times, &shadow->caller_soft);
+		if (other_profile) {
+			profile_shadow_take(shadow, other_profile, &shadow->other_copy, &shadow->other_times, &shadow->other_soft);
+		}
+	}
+
+	return channel->profile_snapshot;
+}
+
 SWITCH_DECLARE(void) switch_channel_event_set_basic_data(switch_channel_t *channel, switch_event_t *event)
 {
 	switch_caller_profile_t *caller_profile, *originator_caller_profile = NULL, *originatee_caller_profile = NULL;
@@ -2276,7 +2555,24 @@ SWITCH_DECLARE(void) switch_channel_event_set_basic_data(switch_channel_t *chann
 		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Channel-Write-Codec-Bit-Rate", "%d", impl.bits_per_second);
 	}
 
-	/* Index Caller's Profile */
+	/* Index Caller's Profile, the headers only change when the profiles do so the events share one frozen copy */
+	if (caller_profile && !switch_test_flag(event, EF_UNIQ_HEADERS)) {
+		switch_caller_profile_t *other_profile = NULL;
+		switch_event_snapshot_t *snapshot;
+
+		if (originator_caller_profile && channel->last_profile_type == LP_ORIGINATOR) {
+			other_profile = originator_caller_profile;
+		} else if (originatee_caller_profile && channel->last_profile_type == LP_ORIGINATEE) {
+			other_profile = originatee_caller_profile;
+		}
+
+		if ((snapshot = channel_profile_snapshot(channel, caller_profile, other_profile, channel->last_profile_type)) &&
+			switch_event_borrow_snapshot(event, snapshot) == SWITCH_STATUS_SUCCESS) {
+			switch_mutex_unlock(channel->profile_mutex);
+			return;
+		}
+	}
+
 	if (caller_profile) {
 		switch_caller_profile_event_set_data(caller_profile, "Caller", event);
 	}
@@ -2358,16 +2654,24 @@ SWITCH_DECLARE(void) switch_channel_event_set_extended_data(switch_channel_t *ch
 		}
 
 		if (channel->variables) {
-			for (hi = channel->variables->headers; hi; hi = hi->next) {
-				char buf[1024];
-				char *vvar = NULL, *vval = NULL;
+			/* events that are only fired get a reference to the variables, the variable_ headers are made when a consumer needs them */
+			if (!channel->variables_snapshot && !switch_test_flag(event, EF_UNIQ_HEADERS)) {
+				switch_event_snapshot_create(&channel->variables_snapshot, channel->variables, "variable_");
+			}
 
-				vvar = (char *) hi->name;
-				vval = (char *) hi->value;
+			if (!channel->variables_snapshot || switch_test_flag(event, EF_UNIQ_HEADERS) || 
+				switch_event_add_snapshot(event, channel->variables_snapshot) != SWITCH_STATUS_SUCCESS) {
+				for (hi = channel->variables->headers; hi; hi = hi->next) {
+					char buf[1024];
+					char *vvar = NULL, *vval = NULL;
+
+					vvar = (char *) hi->name;
+					vval = (char *) hi->value;
 				
-				switch_assert(vvar && vval);
-				switch_snprintf(buf, sizeof(buf), "variable_%s", vvar);
-				switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, buf, vval);
+					switch_assert(vvar && vval);
+					switch_snprintf(buf, sizeof(buf), "variable_%s", vvar);
+					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, buf, vval);
+				}
 			}
 		}
 	}
@@ -2378,6 +2682,9 @@ SWITCH_DECLARE(void) switch_channel_event_set_extended_data(switch_channel_t *ch
 
 SWITCH_DECLARE(void) switch_channel_event_set_data(switch_channel_t *channel, switch_event_t *event)
 {
+	/* channel events carry a few hundred headers, keep them out of the general heap */
+	switch_event_use_arena(event, 0);
+
 	switch_mutex_lock(channel->profile_mutex);
 	switch_channel_event_set_basic_data(channel, event);
 	switch_channel_event_set_extended_data(channel, event);
@@ -2430,21 +2737,22 @@ SWITCH_DECLARE(void) switch_channel_set_caller_profile(switch_channel_t *channel
 
 
 	caller_profile->next = channel->caller_profile;
-	channel->caller_profile = caller_profile;
 	caller_profile->profile_index = switch_core_sprintf(caller_profile->pool, "%d", ++channel->profile_index);
+	profile_publish_barrier();
+	channel->caller_profile = caller_profile;
 
 	switch_mutex_unlock(channel->profile_mutex);
 }
 
 SWITCH_DECLARE(switch_caller_profile_t *) switch_channel_get_caller_profile(switch_channel_t *channel)
 {
-	switch_caller_profile_t *profile;
+	switch_caller_profile_t *profile, *hunt;
 	switch_assert(channel != NULL);
-	switch_mutex_lock(channel->profile_mutex);
-	if ((profile = channel->caller_profile) && profile->hunt_caller_profile) {
-		profile = profile->hunt_caller_profile;
+
+	if ((profile = channel->caller_profile) && (hunt = profile->hunt_caller_profile)) {
+		profile = hunt;
 	}
-	switch_mutex_unlock(channel->profile_mutex);
+
 	return profile;
 }
 
@@ -2460,6 +2768,7 @@ SWITCH_DECLARE(void) switch_channel_set_originator_caller_profile(switch_channel
 
 	if (channel->caller_profile) {
 		caller_profile->next = channel->caller_profile->originator_caller_profile;
+		profile_publish_barrier();
 		channel->caller_profile->originator_caller_profile = caller_profile;
 		channel->last_profile_type = LP_ORIGINATOR;
 	}
@@ -2477,6 +2786,7 @@ SWITCH_DECLARE(void) switch_channel_set_hunt_caller_profile(switch_channel_t *ch
 	channel->caller_profile->hunt_caller_profile = NULL;
 	if (channel->caller_profile && caller_profile) {
 		caller_profile->direction = channel->direction;
+		profile_publish_barrier();
 		channel->caller_profile->hunt_caller_profile = caller_profile;
 	}
 	switch_mutex_unlock(channel->profile_mutex);
@@ -2491,6 +2801,7 @@ SWITCH_DECLARE(void) switch_channel_set_origination_caller_profile(switch_channe
 
 	if (channel->caller_profile) {
 		caller_profile->next = channel->caller_profile->origination_caller_profile;
+		profile_publish_barrier();
 		channel->caller_profile->origination_caller_profile = caller_profile;
 	}
 	switch_assert(channel->caller_profile->origination_caller_profile->next != channel->caller_profile->origination_caller_profile);
@@ -2499,14 +2810,12 @@ SWITCH_DECLARE(void) switch_channel_set_origination_caller_profile(switch_channe
 
 SWITCH_DECLARE(switch_caller_profile_t *) switch_channel_get_origination_caller_profile(switch_channel_t *channel)
 {
-	switch_caller_profile_t *profile = NULL;
+	switch_caller_profile_t *caller_profile, *profile = NULL;
 	switch_assert(channel != NULL);
 
-	switch_mutex_lock(channel->profile_mutex);
-	if (channel->caller_profile) {
-		profile = channel->caller_profile->origination_caller_profile;
+	if ((caller_profile = channel->caller_profile)) {
+		profile = caller_profile->origination_caller_profile;
 	}
-	switch_mutex_unlock(channel->profile_mutex);
 
 	return profile;
 }
@@ -2521,6 +2830,7 @@ SWITCH_DECLARE(void) switch_channel_set_originatee_caller_profile(switch_channel
 
 	if (channel->caller_profile) {
 		caller_profile->next = channel->caller_profile->originatee_caller_profile;
+		profile_publish_barrier();
 		channel->caller_profile->originatee_caller_profile = caller_profile;
 		channel->last_profile_type = LP_ORIGINATEE;
 	}
@@ -2530,29 +2840,24 @@ SWITCH_DECLARE(void) switch_channel_set_originatee_caller_profile(switch_channel
 
 SWITCH_DECLARE(switch_caller_profile_t *) switch_channel_get_originator_caller_profile(switch_channel_t *channel)
 {
-	switch_caller_profile_t *profile = NULL;
+	switch_caller_profile_t *caller_profile, *profile = NULL;
 	switch_assert(channel != NULL);
 
-	switch_mutex_lock(channel->profile_mutex);
-	
-	if (channel->caller_profile) {
-		profile = channel->caller_profile->originator_caller_profile;
+	if ((caller_profile = channel->caller_profile)) {
+		profile = caller_profile->originator_caller_profile;
 	}
-	switch_mutex_unlock(channel->profile_mutex);
 
 	return profile;
 }
 
 SWITCH_DECLARE(switch_caller_profile_t *) switch_channel_get_originatee_caller_profile(switch_channel_t *channel)
 {
-	switch_caller_profile_t *profile = NULL;
+	switch_caller_profile_t *caller_profile, *profile = NULL;
 	switch_assert(channel != NULL);
 
-	switch_mutex_lock(channel->profile_mutex);
-	if (channel->caller_profile) {
-		profile = channel->caller_profile->originatee_caller_profile;
+	if ((caller_profile = channel->caller_profile)) {
+		profile = caller_profile->originatee_caller_profile;
 	}
-	switch_mutex_unlock(channel->profile_mutex);
 
 	return profile;
 }
@@ -2846,6 +3151,8 @@ SWITCH_DECLARE(void) switch_channel_set_bridge_time(switch_channel_t *channel)
 		channel->caller_profile->times->bridged = switch_micro_time_now();
 	}
 	switch_mutex_unlock(channel->profile_mutex);
+
+	switch_core_session_record_phase(channel->session, SWITCH_PHASE_BRIDGE, 0, 0);
 }
 
 
@@ -2901,6 +3208,8 @@ SWITCH_DECLARE(switch_channel_state_t) switch_channel_perform_hangup(switch_chan
 		switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, switch_channel_get_uuid(channel), SWITCH_LOG_NOTICE, "Hangup %s [%s] [%s]\n",
 						  channel->name, state_names[last_state], switch_channel_cause2str(channel->hangup_cause));
 
+		switch_core_session_trace(channel->session, SWITCH_TRACE_HANGUP, hangup_cause, last_state, 0, func);
+
 
 		switch_channel_set_variable_partner(channel, "last_bridge_hangup_cause", switch_channel_cause2str(hangup_cause));
 
@@ -3296,6 +3605,8 @@ SWITCH_DECLARE(switch_status_t) switch_channel_perform_mark_answered(switch_chan
 		switch_mutex_unlock(channel->profile_mutex);
 	}
 
+	switch_core_session_record_phase(channel->session, SWITCH_PHASE_ANSWER, 0, 0);
+
 	switch_channel_check_zrtp(channel);
 	switch_channel_set_flag(channel, CF_ANSWERED);
 	switch_channel_set_callstate(channel, CCS_ACTIVE);
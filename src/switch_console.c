@@ -120,10 +120,38 @@ static switch_status_t console_xml_config(void)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static switch_status_t console_stream_flush(switch_stream_handle_t *handle)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	if (handle->data_len) {
+		status = handle->flush_function(handle, handle->data, handle->data_len);
+	}
+
+	handle->data_len = 0;
+	handle->end = handle->data;
+	*(uint8_t *) handle->end = '\0';
+
+	return status;
+}
+
 SWITCH_DECLARE_NONSTD(switch_status_t) switch_console_stream_raw_write(switch_stream_handle_t *handle, uint8_t *data, switch_size_t datalen)
 {
 	switch_size_t need = handle->data_len + datalen;
 
+	if (handle->flush_function && need >= handle->flush_len) {
+		if (console_stream_flush(handle) != SWITCH_STATUS_SUCCESS) {
+			return SWITCH_STATUS_FALSE;
+		}
+
+		/* bigger than a whole flush, hand it straight through */
+		if (datalen >= handle->flush_len) {
+			return handle->flush_function(handle, data, datalen);
+		}
+
+		need = datalen;
+	}
+
 	if (need >= handle->data_size) {
 		void *new_data;
 		need += handle->alloc_chunk;
@@ -167,6 +195,25 @@ SWITCH_DECLARE_NONSTD(switch_status_t) switch_console_stream_write(switch_stream
 		switch_size_t remaining = handle->data_size - handle->data_len;
 		switch_size_t need = strlen(data) + 1;
 
+		if (handle->flush_function && handle->data_len + need > handle->flush_len) {
+			switch_status_t status = console_stream_flush(handle);
+
+			/* bigger than a whole flush, hand it straight through */
+			if (status == SWITCH_STATUS_SUCCESS && need > handle->flush_len) {
+				status = handle->flush_function(handle, (uint8_t *) data, need - 1);
+				free(data);
+				return status;
+			}
+
+			if (status != SWITCH_STATUS_SUCCESS) {
+				free(data);
+				return SWITCH_STATUS_FALSE;
+			}
+
+			remaining = handle->data_size - handle->data_len;
+			end = handle->end;
+		}
+
 		if ((remaining < need) && handle->alloc_len) {
 			switch_size_t new_len;
 			void *new_data;
@@ -50,6 +50,13 @@
 #endif
 #endif
 #include <errno.h>
+#if !defined(WIN32) && defined(HAVE_CLOCK_GETTIME)
+#include <pthread.h>
+#include <time.h>
+#if defined(_POSIX_THREAD_CPUTIME) && _POSIX_THREAD_CPUTIME >= 0
+#define SWITCH_THREAD_CPU_CLOCK 1
+#endif
+#endif
 
 
 SWITCH_DECLARE_DATA switch_directories SWITCH_GLOBAL_dirs = { 0 };
@@ -87,6 +94,7 @@ static void send_heartbeat(void)
 		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Session-Per-Sec", "%u", runtime.sps);
 		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Session-Since-Startup", "%" SWITCH_SIZE_T_FMT, switch_core_session_id() - 1);
 		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Idle-CPU", "%f", switch_core_idle_cpu());
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Max-Component-Load", "%u", switch_core_component_load(NULL, 0));
 		switch_event_fire(&event);
 	}
 }
@@ -160,6 +168,17 @@ SWITCH_STANDARD_SCHED_FUNC(heartbeat_callback)
 }
 
 
+SWITCH_STANDARD_SCHED_FUNC(event_stats_callback)
+{
+	if (runtime.event_stats_interval) {
+		switch_event_fire_stats();
+	}
+
+	/* reschedule this task, checking again later in case it gets turned on */
+	task->runtime = switch_epoch_time_now(NULL) + (runtime.event_stats_interval ? runtime.event_stats_interval : 60);
+}
+
+
 SWITCH_STANDARD_SCHED_FUNC(check_ip_callback)
 {
 	check_ip();
@@ -202,6 +221,57 @@ SWITCH_DECLARE(FILE *) switch_core_data_channel(switch_text_channel_t channel)
 }
 
 
+static switch_state_handler_t state_handler_for(const switch_state_handler_table_t *state_handler, switch_state_handler_name_t shn)
+{
+	switch (shn) {
+	case SWITCH_SHN_ON_INIT:
+		return state_handler->on_init;
+	case SWITCH_SHN_ON_ROUTING:
+		return state_handler->on_routing;
+	case SWITCH_SHN_ON_EXECUTE:
+		return state_handler->on_execute;
+	case SWITCH_SHN_ON_HANGUP:
+		return state_handler->on_hangup;
+	case SWITCH_SHN_ON_EXCHANGE_MEDIA:
+		return state_handler->on_exchange_media;
+	case SWITCH_SHN_ON_SOFT_EXECUTE:
+		return state_handler->on_soft_execute;
+	case SWITCH_SHN_ON_CONSUME_MEDIA:
+		return state_handler->on_consume_media;
+	case SWITCH_SHN_ON_HIBERNATE:
+		return state_handler->on_hibernate;
+	case SWITCH_SHN_ON_RESET:
+		return state_handler->on_reset;
+	case SWITCH_SHN_ON_PARK:
+		return state_handler->on_park;
+	case SWITCH_SHN_ON_REPORTING:
+		return state_handler->on_reporting;
+	case SWITCH_SHN_ON_DESTROY:
+		return state_handler->on_destroy;
+	}
+
+	return NULL;
+}
+
+/* caller holds runtime.global_mutex.  The state machine walks one of these lists per state change, so a handler
+   that only cares about hangup costs nothing on the other states.  The lists are rewritten in place, only ever
+   growing at the tail when a handler is added, the same as the table they mirror. */
+static void state_dispatch_rebuild(void)
+{
+	int shn, index, n;
+
+	for (shn = SWITCH_SHN_ON_INIT; shn <= SWITCH_SHN_ON_DESTROY; shn++) {
+		for (index = 0, n = 0; index < runtime.state_handler_index && index < SWITCH_MAX_STATE_HANDLERS; index++) {
+			switch_state_handler_t fn;
+
+			if (runtime.state_handlers[index] && (fn = state_handler_for(runtime.state_handlers[index], (switch_state_handler_name_t) shn))) {
+				runtime.state_dispatch[shn][n++] = fn;
+			}
+		}
+		runtime.state_dispatch[shn][n] = NULL;
+	}
+}
+
 SWITCH_DECLARE(void) switch_core_remove_state_handler(const switch_state_handler_table_t *state_handler)
 {
 	int index, tmp_index = 0;
@@ -223,6 +293,7 @@ SWITCH_DECLARE(void) switch_core_remove_state_handler(const switch_state_handler
 	for (index = 0; index < tmp_index; index++) {
 		runtime.state_handlers[runtime.state_handler_index++] = tmp[index];
 	}
+	state_dispatch_rebuild();
 	switch_mutex_unlock(runtime.global_mutex);
 }
 
@@ -238,6 +309,7 @@ SWITCH_DECLARE(int) switch_core_add_state_handler(const switch_state_handler_tab
 		index = -1;
 	} else {
 		runtime.state_handlers[index] = state_handler;
+		state_dispatch_rebuild();
 	}
 
 	switch_mutex_unlock(runtime.global_mutex);
@@ -254,6 +326,161 @@ SWITCH_DECLARE(const switch_state_handler_table_t *) switch_core_get_state_handl
 	return runtime.state_handlers[index];
 }
 
+/*
+ * Load sources: single threaded pieces (a sofia profile's root, an event dispatcher, the sql queue) that can be
+ * pegged while the box as a whole looks idle.  Each one is either the CPU time of the thread that registered
+ * it, read from that thread's CPU clock, or a callback reporting how full it is.  The timer thread samples them
+ * once a second and session admission compares the busiest one against max-component-load.
+ */
+#define LOAD_SOURCE_MAX 128
+
+typedef struct load_source {
+	char name[64];
+	switch_core_load_func_t func;
+	void *user_data;
+	int thread;
+#ifdef SWITCH_THREAD_CPU_CLOCK
+	clockid_t clock;
+	int64_t last_cpu;
+#endif
+	switch_time_t last_wall;
+	uint32_t load;
+} load_source_t;
+
+static load_source_t load_sources[LOAD_SOURCE_MAX];
+static int load_source_count;
+
+static switch_status_t load_source_add(const char *name, switch_core_load_func_t func, void *user_data, int thread)
+{
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	load_source_t *src;
+
+	switch_mutex_lock(runtime.global_mutex);
+	if (load_source_count < LOAD_SOURCE_MAX) {
+		src = &load_sources[load_source_count];
+		memset(src, 0, sizeof(*src));
+		switch_copy_string(src->name, name, sizeof(src->name));
+		src->func = func;
+		src->user_data = user_data;
+		src->thread = thread;
+		src->last_wall = switch_time_now();
+		status = SWITCH_STATUS_SUCCESS;
+#ifdef SWITCH_THREAD_CPU_CLOCK
+		if (thread) {
+			struct timespec ts;
+
+			if (pthread_getcpuclockid(pthread_self(), &src->clock) || clock_gettime(src->clock, &ts)) {
+				status = SWITCH_STATUS_NOTIMPL;
+			} else {
+				src->last_cpu = (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+			}
+		}
+#else
+		if (thread) {
+			status = SWITCH_STATUS_NOTIMPL;
+		}
+#endif
+		if (status == SWITCH_STATUS_SUCCESS) {
+			load_source_count++;
+		}
+	}
+	switch_mutex_unlock(runtime.global_mutex);
+
+	return status;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_add_load_source(const char *name, switch_core_load_func_t func, void *user_data)
+{
+	switch_assert(func);
+	return load_source_add(name, func, user_data, 0);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_add_thread_load_source(const char *name)
+{
+	return load_source_add(name, NULL, NULL, 1);
+}
+
+SWITCH_DECLARE(void) switch_core_remove_load_source(const char *name)
+{
+	int i;
+
+	switch_mutex_lock(runtime.global_mutex);
+	for (i = 0; i < load_source_count; i++) {
+		if (!strcmp(load_sources[i].name, name)) {
+			load_sources[i] = load_sources[--load_source_count];
+			break;
+		}
+	}
+	switch_mutex_unlock(runtime.global_mutex);
+}
+
+void switch_core_sample_load_sources(void)
+{
+	switch_time_t now = switch_time_now();
+	uint32_t max = 0;
+	const char *max_name = "";
+	int i;
+
+	switch_mutex_lock(runtime.global_mutex);
+	for (i = 0; i < load_source_count; i++) {
+		load_source_t *src = &load_sources[i];
+
+		if (src->func) {
+			src->load = src->func(src->user_data);
+		}
+#ifdef SWITCH_THREAD_CPU_CLOCK
+		else {
+			struct timespec ts;
+
+			if (!clock_gettime(src->clock, &ts) && now > src->last_wall) {
+				int64_t cpu = (int64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+
+				src->load = (uint32_t) (((cpu - src->last_cpu) * 100) / (now - src->last_wall));
+				src->last_cpu = cpu;
+			}
+		}
+#endif
+		src->last_wall = now;
+
+		if (src->load > 100) {
+			src->load = 100;
+		}
+
+		if (src->load > max) {
+			max = src->load;
+			max_name = src->name;
+		}
+	}
+	switch_copy_string(runtime.component_load_name, max_name, sizeof(runtime.component_load_name));
+	runtime.component_load = max;
+	switch_mutex_unlock(runtime.global_mutex);
+}
+
+SWITCH_DECLARE(uint32_t) switch_core_component_load(char *name, switch_size_t len)
+{
+	uint32_t load;
+
+	switch_mutex_lock(runtime.global_mutex);
+	load = runtime.component_load;
+	if (name && len) {
+		switch_copy_string(name, runtime.component_load_name, len);
+	}
+	switch_mutex_unlock(runtime.global_mutex);
+
+	return load;
+}
+
+SWITCH_DECLARE(void) switch_core_load_sources_status(switch_stream_handle_t *stream)
+{
+	int i;
+
+	switch_mutex_lock(runtime.global_mutex);
+	for (i = 0; i < load_source_count; i++) {
+		stream->write_function(stream, "%s %u%%\n", load_sources[i].name, load_sources[i].load);
+	}
+	switch_mutex_unlock(runtime.global_mutex);
+}
+
 SWITCH_DECLARE(void) switch_core_dump_variables(switch_stream_handle_t *stream)
 {
 	switch_event_header_t *hi;
@@ -1353,6 +1580,239 @@ SWITCH_DECLARE(switch_status_t) switch_core_thread_set_cpu_affinity(int cpu)
 	return status;
 }
 
+#define THREAD_AFFINITY_MAX_CPUS 1024
+
+/* the cpus a role hands out, slot n is cpus[slot_start[n]] .. cpus[slot_start[n] + slot_len[n] - 1] */
+struct switch_thread_affinity {
+	int *cpus;
+	int *slot_start;
+	int *slot_len;
+	int slots;
+	/* a lost increment between two racing threads only doubles up one slot */
+	uint32_t next;
+};
+
+static const char *THREAD_ROLE_NAMES[SWITCH_THREAD_ROLE_MAX] = { "session", "media", "signaling", "event" };
+
+/* "0-3,8" style, as used by taskset and /sys/devices/system/node */
+static int parse_cpu_list(const char *str, int *cpus, int max)
+{
+	int count = 0;
+	const char *p = str;
+
+	while (p && *p && count < max) {
+		char *end;
+		long first, last;
+
+		while (*p == ' ' || *p == ',' || *p == '\n') {
+			p++;
+		}
+
+		if (!*p) {
+			break;
+		}
+
+		first = strtol(p, &end, 10);
+		if (end == p || first < 0) {
+			return -1;
+		}
+
+		last = first;
+		p = end;
+
+		if (*p == '-') {
+			p++;
+			last = strtol(p, &end, 10);
+			if (end == p || last < first) {
+				return -1;
+			}
+			p = end;
+		}
+
+		for (; first <= last && count < max; first++) {
+			cpus[count++] = (int) first;
+		}
+
+		if (*p && *p != ',' && *p != ' ' && *p != '\n') {
+			return -1;
+		}
+	}
+
+	return count;
+}
+
+static struct switch_thread_affinity *thread_affinity_alloc(int cpu_count, int slots)
+{
+	struct switch_thread_affinity *affinity = switch_core_alloc(runtime.memory_pool, sizeof(*affinity));
+
+	affinity->cpus = switch_core_alloc(runtime.memory_pool, sizeof(int) * cpu_count);
+	affinity->slot_start = switch_core_alloc(runtime.memory_pool, sizeof(int) * slots);
+	affinity->slot_len = switch_core_alloc(runtime.memory_pool, sizeof(int) * slots);
+
+	return affinity;
+}
+
+/* one slot per node with all of its cpus, NULL when there are not at least two nodes to choose from */
+static struct switch_thread_affinity *thread_affinity_numa(void)
+{
+#ifdef __linux__
+	struct switch_thread_affinity *affinity = NULL;
+	int node_cpus[THREAD_AFFINITY_MAX_CPUS];
+	int cpus[THREAD_AFFINITY_MAX_CPUS];
+	int node_start[64], node_len[64];
+	int nodes = 0, total = 0, x;
+
+	for (nodes = 0; nodes < 64; nodes++) {
+		char path[128], buf[1024] = "";
+		FILE *f;
+		int n;
+
+		switch_snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", nodes);
+
+		if (!(f = fopen(path, "r"))) {
+			break;
+		}
+
+		if (!fgets(buf, sizeof(buf), f)) {
+			*buf = '\0';
+		}
+		fclose(f);
+
+		if ((n = parse_cpu_list(buf, node_cpus, THREAD_AFFINITY_MAX_CPUS - total)) <= 0) {
+			n = 0;
+		}
+
+		memcpy(cpus + total, node_cpus, sizeof(int) * n);
+		node_start[nodes] = total;
+		node_len[nodes] = n;
+		total += n;
+	}
+
+	if (nodes < 2 || !total) {
+		return NULL;
+	}
+
+	affinity = thread_affinity_alloc(total, nodes);
+	memcpy(affinity->cpus, cpus, sizeof(int) * total);
+
+	for (x = 0; x < nodes; x++) {
+		if (node_len[x]) {
+			affinity->slot_start[affinity->slots] = node_start[x];
+			affinity->slot_len[affinity->slots] = node_len[x];
+			affinity->slots++;
+		}
+	}
+
+	return affinity;
+#else
+	return NULL;
+#endif
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_thread_set_affinity_policy(switch_thread_role_t role, const char *policy)
+{
+	struct switch_thread_affinity *affinity = NULL;
+	int x;
+
+	if (role >= SWITCH_THREAD_ROLE_MAX) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (zstr(policy) || !strcasecmp(policy, "disabled")) {
+		affinity = NULL;
+	} else if (!strcasecmp(policy, "spread")) {
+		affinity = thread_affinity_alloc(runtime.cpu_count, runtime.cpu_count);
+
+		for (x = 0; x < runtime.cpu_count; x++) {
+			affinity->cpus[x] = x;
+			affinity->slot_start[x] = x;
+			affinity->slot_len[x] = 1;
+		}
+		affinity->slots = runtime.cpu_count;
+	} else if (!strcasecmp(policy, "numa")) {
+		if (!(affinity = thread_affinity_numa())) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "No numa nodes to spread %s threads over, leaving them unpinned\n",
+							  THREAD_ROLE_NAMES[role]);
+		}
+	} else {
+		int cpus[THREAD_AFFINITY_MAX_CPUS];
+		int count = parse_cpu_list(policy, cpus, THREAD_AFFINITY_MAX_CPUS);
+
+		if (count <= 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid %s-thread-affinity [%s]\n", THREAD_ROLE_NAMES[role], policy);
+			return SWITCH_STATUS_FALSE;
+		}
+
+		affinity = thread_affinity_alloc(count, count);
+
+		for (x = 0; x < count; x++) {
+			affinity->cpus[x] = cpus[x];
+			affinity->slot_start[x] = x;
+			affinity->slot_len[x] = 1;
+		}
+		affinity->slots = count;
+	}
+
+	/* a replaced policy stays in the core pool, a thread may still be reading it */
+	runtime.thread_affinity[role] = affinity;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_thread_set_role_affinity(switch_thread_role_t role)
+{
+	struct switch_thread_affinity *affinity;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	int *cpus, count, slot;
+
+	if (role >= SWITCH_THREAD_ROLE_MAX || !(affinity = runtime.thread_affinity[role]) || !affinity->slots) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	slot = (int) (affinity->next++ % (uint32_t) affinity->slots);
+	cpus = affinity->cpus + affinity->slot_start[slot];
+	count = affinity->slot_len[slot];
+
+	{
+#ifdef HAVE_CPU_SET_MACROS
+		cpu_set_t set;
+		int x;
+
+		CPU_ZERO(&set);
+		for (x = 0; x < count; x++) {
+			if (cpus[x] < CPU_SETSIZE) {
+				CPU_SET(cpus[x], &set);
+			}
+		}
+
+		if (!sched_setaffinity(0, sizeof(set), &set)) {
+			status = SWITCH_STATUS_SUCCESS;
+		}
+#else
+#if WIN32
+		DWORD_PTR mask = 0;
+		int x;
+
+		for (x = 0; x < count; x++) {
+			if (cpus[x] < (int) (sizeof(mask) * 8)) {
+				mask |= ((DWORD_PTR) 1) << cpus[x];
+			}
+		}
+
+		if (mask && SetThreadAffinityMask(GetCurrentThread(), mask)) {
+			status = SWITCH_STATUS_SUCCESS;
+		}
+#endif
+#endif
+	}
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Cannot pin %s thread to slot %d\n", THREAD_ROLE_NAMES[role], slot);
+	}
+
+	return status;
+}
+
 
 static void switch_core_set_serial(void)
 {
@@ -1421,6 +1881,21 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 
 	runtime.max_db_handles = 50;
 	runtime.db_handle_timeout = 5000000;
+	runtime.event_stats_interval = 60;
+	runtime.regex_cache_size = 1024;
+	runtime.sched_threads = 2;
+	runtime.pool_recycle_max_free = 128 * 1024;
+	runtime.session_trace_size = 32;
+	runtime.file_cache_max_file = 4 * 1024 * 1024;
+	runtime.file_cache_native = SWITCH_TRUE;
+	runtime.file_io_depth = 64 * 1024;
+	runtime.dns_cache_ttl = 60;
+	runtime.dns_negative_ttl = 10;
+	runtime.dns_cache_stale = 3600;
+	runtime.codec_offload_batch = 32;
+	runtime.file_io_write_chunk = 16 * 1024;
+	runtime.session_trace_dump = SWITCH_TRACE_DUMP_FAILED;
+	runtime.core_db_channels = 1;
 	
 	runtime.runlevel++;
 	runtime.sql_buffer_len = 1024 * 32;
@@ -1491,7 +1966,19 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 
 	switch_thread_rwlock_create(&runtime.global_var_rwlock, runtime.memory_pool);
 	switch_core_set_globals();
+	switch_metrics_init(runtime.memory_pool);
+	switch_prefix_init(runtime.memory_pool);
+	switch_resolve_cache_init(runtime.memory_pool);
+	switch_snapshot_init(runtime.memory_pool);
+	switch_core_intern_init(runtime.memory_pool);
+	runtime.frame_slab = switch_slab_create("frame", sizeof(switch_frame_t), 0);
+	runtime.message_slab = switch_slab_create("session_message", sizeof(switch_core_session_message_t), 0);
+	switch_metric_register_collector("memory", switch_core_memory_metrics, NULL);
 	switch_core_session_init(runtime.memory_pool);
+	switch_regex_init(runtime.memory_pool);
+	switch_core_file_cache_init(runtime.memory_pool);
+	switch_core_speech_pool_init(runtime.memory_pool);
+	switch_resample_init(runtime.memory_pool);
 	switch_event_create_plain(&runtime.global_vars, SWITCH_EVENT_CHANNEL_DATA);
 	switch_core_hash_init(&runtime.mime_types, runtime.memory_pool);
 	switch_core_hash_init_case(&runtime.ptimes, runtime.memory_pool, SWITCH_FALSE);
@@ -1545,6 +2032,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 
 	switch_load_core_config("switch.conf");
 
+	if (runtime.pool_prewarm) {
+		switch_core_memory_prewarm(runtime.pool_prewarm);
+	}
+
+	switch_core_file_io_init();
+	switch_core_codec_offload_init();
+
 	switch_core_state_machine_init(runtime.memory_pool);
 
 	if (switch_core_sqldb_start(runtime.memory_pool, switch_test_flag((&runtime), SCF_USE_SQL) ? SWITCH_TRUE : SWITCH_FALSE) != SWITCH_STATUS_SUCCESS) {
@@ -1556,6 +2050,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 
 	switch_nat_late_init();
 
+	switch_sln_kernel_init();
+
 	switch_rtp_init(runtime.memory_pool);
 
 	runtime.running = 1;
@@ -1563,6 +2059,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	
 	switch_scheduler_add_task(switch_epoch_time_now(NULL), heartbeat_callback, "heartbeat", "core", 0, NULL, SSHF_NONE | SSHF_NO_DEL);
 
+	switch_scheduler_add_task(switch_epoch_time_now(NULL) + 60, event_stats_callback, "event_stats", "core", 0, NULL, SSHF_NONE | SSHF_NO_DEL);
+
 	switch_scheduler_add_task(switch_epoch_time_now(NULL), check_ip_callback, "check_ip", "core", 0, NULL, SSHF_NONE | SSHF_NO_DEL | SSHF_OWN_THREAD);
 
 	switch_uuid_get(&uuid);
@@ -1700,6 +2198,149 @@ static void switch_load_core_config(const char *file)
 					} else {
 						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "max-db-handles must be between 5 and 5000\n");
 					}
+				} else if (!strcasecmp(var, "pool-recycle-max")) {
+					runtime.pool_recycle_max = (uint32_t) atol(val);
+				} else if (!strcasecmp(var, "pool-recycle-max-free")) {
+					long tmp = atol(val);
+
+					if (tmp >= 8192 && tmp <= 16 * 1024 * 1024) {
+						runtime.pool_recycle_max_free = (uint32_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "pool-recycle-max-free must be between 8192 and 16777216\n");
+					}
+				} else if (!strcasecmp(var, "pool-accounting")) {
+					runtime.pool_accounting = switch_true(val);
+				} else if (!strcasecmp(var, "pool-prewarm")) {
+					runtime.pool_prewarm = (uint32_t) atol(val);
+				} else if (!strcasecmp(var, "scheduler-threads")) {
+					int tmp = atoi(val);
+
+					if (tmp > 0 && tmp < 65) {
+						runtime.sched_threads = tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "scheduler-threads must be between 1 and 64\n");
+					}
+				} else if (!strcasecmp(var, "core-db-channels")) {
+					runtime.core_db_channels = switch_true(val);
+				} else if (!strcasecmp(var, "prompt-cache-size")) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0 && tmp <= 65536) {
+						runtime.file_cache_size = (switch_size_t) tmp * 1024 * 1024;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "prompt-cache-size must be between 0 (off) and 65536 megabytes\n");
+					}
+				} else if (!strcasecmp(var, "prompt-cache-max-file")) {
+					int tmp = atoi(val);
+
+					if (tmp > 0 && tmp <= 1024 * 1024) {
+						runtime.file_cache_max_file = (switch_size_t) tmp * 1024;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "prompt-cache-max-file must be between 1 and 1048576 kilobytes\n");
+					}
+				} else if (!strcasecmp(var, "prompt-cache-native")) {
+					runtime.file_cache_native = switch_true(val);
+				} else if (!strcasecmp(var, "speech-handle-pool-size")) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0 && tmp <= 1024) {
+						runtime.speech_pool_size = (uint32_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "speech-handle-pool-size must be between 0 (off) and 1024\n");
+					}
+				} else if (!strcasecmp(var, "tts-cache")) {
+					runtime.tts_cache = switch_true(val);
+				} else if (!strcasecmp(var, "tts-cache-dir") && !zstr(val)) {
+					runtime.tts_cache_dir = switch_core_strdup(runtime.memory_pool, val);
+				} else if (!strcasecmp(var, "dns-cache-ttl")) {
+					int tmp = atoi(val);
+
+					runtime.dns_cache_ttl = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "dns-negative-ttl")) {
+					int tmp = atoi(val);
+
+					runtime.dns_negative_ttl = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "dns-cache-stale")) {
+					int tmp = atoi(val);
+
+					runtime.dns_cache_stale = tmp > 0 ? (uint32_t) tmp : 0;
+				} else if (!strcasecmp(var, "file-io-threads")) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0 && tmp <= 64) {
+						runtime.file_io_threads = (uint32_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "file-io-threads must be between 0 (off) and 64\n");
+					}
+				} else if (!strcasecmp(var, "file-io-depth")) {
+					long tmp = atol(val);
+
+					if (tmp >= 16384 && tmp <= 16 * 1024 * 1024) {
+						runtime.file_io_depth = (switch_size_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "file-io-depth must be between 16384 and 16777216 bytes\n");
+					}
+				} else if (!strcasecmp(var, "file-io-write-chunk")) {
+					long tmp = atol(val);
+
+					if (tmp >= 4096 && tmp <= 8 * 1024 * 1024) {
+						/* whole pages */
+						runtime.file_io_write_chunk = (switch_size_t) (tmp - tmp % 4096);
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "file-io-write-chunk must be between 4096 and 8388608 bytes\n");
+					}
+				} else if (!strcasecmp(var, "file-io-fsync")) {
+					runtime.file_io_fsync = switch_true(val);
+				} else if (!strcasecmp(var, "codec-offload-threads")) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0 && tmp <= 64) {
+						runtime.codec_offload_threads = (uint32_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "codec-offload-threads must be between 0 (off) and 64\n");
+					}
+				} else if (!strcasecmp(var, "codec-offload-batch")) {
+					int tmp = atoi(val);
+
+					if (tmp >= 1 && tmp <= 256) {
+						runtime.codec_offload_batch = (uint32_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "codec-offload-batch must be between 1 and 256 frames\n");
+					}
+				} else if (!strcasecmp(var, "codec-offload-codecs") && !zstr(val)) {
+					runtime.codec_offload_codecs = switch_core_strdup(runtime.memory_pool, val);
+				} else if (!strcasecmp(var, "regex-cache-size")) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0) {
+						runtime.regex_cache_size = (uint32_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "regex-cache-size must be 0 (off) or more patterns\n");
+					}
+				} else if (!strcasecmp(var, "session-trace-size")) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0 && tmp <= 4096) {
+						runtime.session_trace_size = (uint32_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "session-trace-size must be between 0 (off) and 4096 records\n");
+					}
+				} else if (!strcasecmp(var, "session-trace-dump")) {
+					if (!strcasecmp(val, "always")) {
+						runtime.session_trace_dump = SWITCH_TRACE_DUMP_ALWAYS;
+					} else if (!strcasecmp(val, "failed")) {
+						runtime.session_trace_dump = SWITCH_TRACE_DUMP_FAILED;
+					} else {
+						runtime.session_trace_dump = SWITCH_TRACE_DUMP_NEVER;
+					}
+				} else if (!strcasecmp(var, "event-stats-interval")) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0) {
+						runtime.event_stats_interval = (uint32_t) tmp;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "event-stats-interval must be 0 (off) or more seconds\n");
+					}
 				} else if (!strcasecmp(var, "db-handle-timeout")) {
 					long tmp = atol(val);
 					
@@ -1799,6 +2440,19 @@ static void switch_load_core_config(const char *file)
 					switch_time_set_matrix(switch_true(val));
 				} else if (!strcasecmp(var, "max-sessions") && !zstr(val)) {
 					switch_core_session_limit(atoi(val));
+				} else if (!strcasecmp(var, "indexed-channel-variables") && !zstr(val)) {
+					char *dup = strdup(val);
+					char *names[64] = { 0 };
+					int i, n;
+
+					switch_assert(dup);
+					n = switch_separate_string(dup, ',', names, (sizeof(names) / sizeof(names[0])));
+					for (i = 0; i < n; i++) {
+						char *name = switch_strip_whitespace(names[i]);
+						switch_core_session_index_variable(name);
+						switch_safe_free(name);
+					}
+					free(dup);
 				} else if (!strcasecmp(var, "verbose-channel-events") && !zstr(val)) {
 					int v = switch_true(val);
 					if (v) {
@@ -1806,6 +2460,12 @@ static void switch_load_core_config(const char *file)
 					} else {
 						switch_clear_flag((&runtime), SCF_VERBOSE_EVENTS);
 					}
+				} else if (!strcasecmp(var, "media-latency-probe") && !zstr(val)) {
+					if (switch_true(val)) {
+						switch_set_flag((&runtime), SCF_MEDIA_LATENCY_PROBE);
+					} else {
+						switch_clear_flag((&runtime), SCF_MEDIA_LATENCY_PROBE);
+					}
 				} else if (!strcasecmp(var, "threaded-system-exec") && !zstr(val)) {
 #ifdef WIN32
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "threaded-system-exec is not implemented on this platform\n");
@@ -1819,6 +2479,14 @@ static void switch_load_core_config(const char *file)
 #endif
 				} else if (!strcasecmp(var, "min-idle-cpu") && !zstr(val)) {
 					switch_core_min_idle_cpu(atof(val));
+				} else if (!strcasecmp(var, "max-component-load") && !zstr(val)) {
+					int tmp = atoi(val);
+
+					if (tmp >= 0 && tmp <= 100) {
+						switch_core_max_component_load(tmp);
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "max-component-load must be between 0 and 100\n");
+					}
 				} else if (!strcasecmp(var, "tipping-point") && !zstr(val)) {
 					runtime.tipping_point = atoi(val);
 				} else if (!strcasecmp(var, "1ms-timer") && switch_true(val)) {
@@ -1829,10 +2497,41 @@ static void switch_load_core_config(const char *file)
 					} else {
 						runtime.timer_affinity = atoi(val);
 					}
+				} else if (!strcasecmp(var, "session-thread-affinity") && !zstr(val)) {
+					switch_core_thread_set_affinity_policy(SWITCH_THREAD_ROLE_SESSION, val);
+				} else if (!strcasecmp(var, "media-thread-affinity") && !zstr(val)) {
+					switch_core_thread_set_affinity_policy(SWITCH_THREAD_ROLE_MEDIA, val);
+				} else if (!strcasecmp(var, "signaling-thread-affinity") && !zstr(val)) {
+					switch_core_thread_set_affinity_policy(SWITCH_THREAD_ROLE_SIGNALING, val);
+				} else if (!strcasecmp(var, "event-thread-affinity") && !zstr(val)) {
+					switch_core_thread_set_affinity_policy(SWITCH_THREAD_ROLE_EVENT, val);
+				} else if (!strcasecmp(var, "timer-shards") && !zstr(val)) {
+					if (!strcasecmp(val, "auto")) {
+						runtime.timer_shards = -1;
+					} else {
+						runtime.timer_shards = atoi(val);
+					}
 				} else if (!strcasecmp(var, "rtp-start-port") && !zstr(val)) {
 					switch_rtp_set_start_port((switch_port_t) atoi(val));
 				} else if (!strcasecmp(var, "rtp-end-port") && !zstr(val)) {
 					switch_rtp_set_end_port((switch_port_t) atoi(val));
+				} else if (!strcasecmp(var, "media-workers") && !zstr(val)) {
+					int tmp = !strcasecmp(val, "auto") ? runtime.cpu_count : atoi(val);
+					if (tmp > 0) {
+						switch_ivr_set_media_workers((uint32_t) tmp);
+					}
+				} else if (!strcasecmp(var, "state-snapshot")) {
+					switch_snapshot_set_enabled(switch_true(val));
+				} else if (!strcasecmp(var, "state-snapshot-max-age") && !zstr(val)) {
+					int tmp = atoi(val);
+					if (tmp >= 0) {
+						switch_snapshot_set_max_age((uint32_t) tmp);
+					}
+				} else if (!strcasecmp(var, "rtp-reactor-threads") && !zstr(val)) {
+					int tmp = atoi(val);
+					if (tmp > 0) {
+						switch_rtp_set_reactor_threads((uint32_t) tmp);
+					}
 				} else if (!strcasecmp(var, "core-db-name") && !zstr(val)) {
 					runtime.dbname = switch_core_strdup(runtime.memory_pool, val);
 				} else if (!strcasecmp(var, "core-db-dsn") && !zstr(val)) {
@@ -1922,13 +2621,16 @@ SWITCH_DECLARE(switch_status_t) switch_core_init_and_modload(switch_core_flag_t
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Bringing up environment.\n");
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Loading Modules.\n");
+	switch_snapshot_open();
 	if (switch_loadable_module_init(SWITCH_TRUE) != SWITCH_STATUS_SUCCESS) {
 		*err = "Cannot load modules";
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Error: %s\n", *err);
 		return SWITCH_STATUS_GENERR;
 	}
+	switch_snapshot_release();
 
 	switch_load_network_lists(SWITCH_FALSE);
+	switch_load_prefix_tables(SWITCH_FALSE);
 
 	switch_load_core_config("post_load_switch.conf");
 
@@ -2325,6 +3027,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "End existing sessions\n");
 	switch_core_session_hupall(SWITCH_CAUSE_SYSTEM_SHUTDOWN);
+	switch_ivr_media_workers_shutdown();
+
+	switch_snapshot_save();
+
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Clean up modules.\n");
 
 	switch_loadable_module_shutdown();
@@ -2342,11 +3048,21 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 		switch_nat_shutdown();
 	}
 	switch_xml_destroy();
+	switch_regex_shutdown();
+	switch_core_speech_pool_shutdown();
+	switch_core_file_cache_shutdown();
+	switch_core_file_io_shutdown();
+	switch_core_codec_offload_shutdown();
+	switch_resample_shutdown();
 
 	switch_console_shutdown();
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Closing Event Engine.\n");
 	switch_event_shutdown();
+	switch_metrics_shutdown();
+	switch_prefix_shutdown();
+	switch_resolve_cache_shutdown();
+	switch_snapshot_shutdown();
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Finalizing Shutdown.\n");
 	switch_log_shutdown();
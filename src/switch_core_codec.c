@@ -599,6 +599,391 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_reset(switch_codec_t *codec)
 }
 
 
+/*
+ * Codec offload.  An engine claims implementations when a handle is opened, after that every encode and decode on
+ * the handle becomes a job on a queue shared by all legs.  The offload threads pop whatever is waiting, up to
+ * codec-offload-batch jobs, and hand each engine its share in one call, so a card or a GPU sees hundreds of frames
+ * per round trip instead of one.  The session thread waits for its own job, the frame timing seen by the rest of
+ * the core does not change.
+ */
+
+#define CODEC_OFFLOAD_MAX_THREADS 64
+#define CODEC_OFFLOAD_MAX_BATCH 256
+
+typedef struct codec_offload_engine {
+	switch_codec_offload_engine_t engine;
+	int dead;
+	struct codec_offload_engine *next;
+} codec_offload_engine_t;
+
+typedef struct {
+	codec_offload_engine_t *engine;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+} codec_offload_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_thread_rwlock_t *rwlock;
+	switch_mutex_t *mutex;
+	codec_offload_engine_t *engines;
+	switch_queue_t *queue;
+	switch_thread_t *threads[CODEC_OFFLOAD_MAX_THREADS];
+	int thread_count;
+	uint32_t batch;
+	uint64_t jobs;
+	uint64_t batches;
+	uint64_t inline_jobs;
+	uint32_t largest_batch;
+} CODEC_OFFLOAD;
+
+SWITCH_DECLARE(void) switch_core_codec_offload_run(switch_codec_offload_job_t *job)
+{
+	const switch_codec_implementation_t *impl = job->codec->implementation;
+
+	if (job->encode) {
+		job->status = impl->encode(job->codec, job->other_codec, job->in_data, job->in_len, job->in_rate,
+								   job->out_data, job->out_len, job->out_rate, job->flag);
+	} else {
+		job->status = impl->decode(job->codec, job->other_codec, job->in_data, job->in_len, job->in_rate,
+								   job->out_data, job->out_len, job->out_rate, job->flag);
+	}
+}
+
+/* the software engine, it only moves the work of the codecs named in codec-offload-codecs onto the offload threads */
+static switch_bool_t codec_offload_cpu_claim(const switch_codec_implementation_t *implementation, void *user_data)
+{
+	const char *list = (const char *) user_data, *p;
+	size_t len;
+
+	if (!list || !implementation->iananame) {
+		return SWITCH_FALSE;
+	}
+
+	len = strlen(implementation->iananame);
+
+	for (p = list; (p = switch_stristr(implementation->iananame, p)); p += len) {
+		if ((p == list || *(p - 1) == ',') && (p[len] == '\0' || p[len] == ',')) {
+			return SWITCH_TRUE;
+		}
+	}
+
+	return SWITCH_FALSE;
+}
+
+static void codec_offload_cpu_process(switch_codec_offload_job_t **jobs, uint32_t count, void *user_data)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		switch_core_codec_offload_run(jobs[i]);
+	}
+}
+
+static void codec_offload_dispatch(codec_offload_engine_t *engine, switch_codec_offload_job_t **jobs, uint32_t count)
+{
+	uint32_t i;
+
+	switch_thread_rwlock_rdlock(CODEC_OFFLOAD.rwlock);
+	if (engine->dead) {
+		for (i = 0; i < count; i++) {
+			switch_core_codec_offload_run(jobs[i]);
+		}
+	} else {
+		engine->engine.process(jobs, count, engine->engine.user_data);
+	}
+	switch_thread_rwlock_unlock(CODEC_OFFLOAD.rwlock);
+}
+
+static void codec_offload_complete(switch_codec_offload_job_t *job)
+{
+	codec_offload_t *co = (codec_offload_t *) job->codec->offload;
+
+	switch_mutex_lock(co->mutex);
+	job->done = 1;
+	switch_thread_cond_signal(co->cond);
+	switch_mutex_unlock(co->mutex);
+}
+
+/* runs one round of popped jobs, grouped so every engine gets a single call */
+static void codec_offload_service(switch_codec_offload_job_t **jobs, uint32_t count)
+{
+	switch_codec_offload_job_t *batch[CODEC_OFFLOAD_MAX_BATCH];
+	uint32_t i, j, n;
+
+	for (i = 0; i < count; i++) {
+		codec_offload_engine_t *engine;
+
+		if (!jobs[i]) {
+			continue;
+		}
+
+		engine = ((codec_offload_t *) jobs[i]->codec->offload)->engine;
+
+		for (n = 0, j = i; j < count; j++) {
+			if (jobs[j] && ((codec_offload_t *) jobs[j]->codec->offload)->engine == engine) {
+				batch[n++] = jobs[j];
+				jobs[j] = NULL;
+			}
+		}
+
+		codec_offload_dispatch(engine, batch, n);
+
+		for (j = 0; j < n; j++) {
+			codec_offload_complete(batch[j]);
+		}
+	}
+
+	switch_mutex_lock(CODEC_OFFLOAD.mutex);
+	CODEC_OFFLOAD.jobs += count;
+	CODEC_OFFLOAD.batches++;
+	if (count > CODEC_OFFLOAD.largest_batch) {
+		CODEC_OFFLOAD.largest_batch = count;
+	}
+	switch_mutex_unlock(CODEC_OFFLOAD.mutex);
+}
+
+static void *SWITCH_THREAD_FUNC codec_offload_thread(switch_thread_t *thread, void *obj)
+{
+	switch_queue_t *queue = (switch_queue_t *) obj;
+	switch_codec_offload_job_t *jobs[CODEC_OFFLOAD_MAX_BATCH];
+	void *pop;
+	int running = 1;
+
+	while (running && switch_queue_pop(queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		uint32_t count = 0;
+
+		jobs[count++] = (switch_codec_offload_job_t *) pop;
+
+		while (count < CODEC_OFFLOAD.batch && switch_queue_trypop(queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			if (!pop) {
+				running = 0;
+				break;
+			}
+			jobs[count++] = (switch_codec_offload_job_t *) pop;
+		}
+
+		codec_offload_service(jobs, count);
+	}
+
+	return NULL;
+}
+
+/* called with codec->mutex held so the handle has at most one job out */
+static switch_status_t codec_offload_submit(switch_codec_t *codec, switch_codec_offload_job_t *job)
+{
+	codec_offload_t *co = (codec_offload_t *) codec->offload;
+	switch_queue_t *queue = CODEC_OFFLOAD.queue;
+
+	switch_mutex_lock(co->mutex);
+	if (!queue || switch_queue_trypush(queue, job) != SWITCH_STATUS_SUCCESS) {
+		switch_mutex_unlock(co->mutex);
+
+		/* no threads or they are backed up, the engine still gets the frame, just from this thread */
+		codec_offload_dispatch(co->engine, &job, 1);
+
+		switch_mutex_lock(CODEC_OFFLOAD.mutex);
+		CODEC_OFFLOAD.inline_jobs++;
+		switch_mutex_unlock(CODEC_OFFLOAD.mutex);
+
+		return job->status;
+	}
+
+	while (!job->done) {
+		switch_thread_cond_wait(co->cond, co->mutex);
+	}
+	switch_mutex_unlock(co->mutex);
+
+	return job->status;
+}
+
+static void codec_offload_attach(switch_codec_t *codec)
+{
+	codec_offload_engine_t *engine;
+	codec_offload_t *co;
+
+	codec->offload = NULL;
+
+	if (!CODEC_OFFLOAD.rwlock || !CODEC_OFFLOAD.engines) {
+		return;
+	}
+
+	switch_thread_rwlock_rdlock(CODEC_OFFLOAD.rwlock);
+	for (engine = CODEC_OFFLOAD.engines; engine; engine = engine->next) {
+		if (!engine->dead && engine->engine.claim(codec->implementation, engine->engine.user_data)) {
+			break;
+		}
+	}
+	switch_thread_rwlock_unlock(CODEC_OFFLOAD.rwlock);
+
+	if (!engine) {
+		return;
+	}
+
+	co = switch_core_alloc(codec->memory_pool, sizeof(*co));
+	co->engine = engine;
+	switch_mutex_init(&co->mutex, SWITCH_MUTEX_NESTED, codec->memory_pool);
+	switch_thread_cond_create(&co->cond, codec->memory_pool);
+	codec->offload = co;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_codec_offload_register(const switch_codec_offload_engine_t *engine)
+{
+	codec_offload_engine_t *node;
+
+	if (!CODEC_OFFLOAD.rwlock || !engine || zstr(engine->name) || !engine->claim || !engine->process) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_thread_rwlock_wrlock(CODEC_OFFLOAD.rwlock);
+	for (node = CODEC_OFFLOAD.engines; node; node = node->next) {
+		if (!node->dead && !strcasecmp(node->engine.name, engine->name)) {
+			switch_thread_rwlock_unlock(CODEC_OFFLOAD.rwlock);
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Codec offload engine %s is already registered\n", engine->name);
+			return SWITCH_STATUS_FALSE;
+		}
+	}
+
+	/* never freed before shutdown, handles opened on an engine keep pointing at it after it unregisters */
+	node = switch_core_alloc(CODEC_OFFLOAD.pool, sizeof(*node));
+	node->engine = *engine;
+	node->engine.name = switch_core_strdup(CODEC_OFFLOAD.pool, engine->name);
+	node->next = CODEC_OFFLOAD.engines;
+	CODEC_OFFLOAD.engines = node;
+	switch_thread_rwlock_unlock(CODEC_OFFLOAD.rwlock);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Registered codec offload engine %s\n", engine->name);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_codec_offload_unregister(const char *name)
+{
+	codec_offload_engine_t *node;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (!CODEC_OFFLOAD.rwlock || zstr(name)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* the write lock waits out any batch still inside the engine */
+	switch_thread_rwlock_wrlock(CODEC_OFFLOAD.rwlock);
+	for (node = CODEC_OFFLOAD.engines; node; node = node->next) {
+		if (!node->dead && !strcasecmp(node->engine.name, name)) {
+			node->dead = 1;
+			status = SWITCH_STATUS_SUCCESS;
+			break;
+		}
+	}
+	switch_thread_rwlock_unlock(CODEC_OFFLOAD.rwlock);
+
+	return status;
+}
+
+SWITCH_DECLARE(void) switch_core_codec_offload_stats(switch_stream_handle_t *stream)
+{
+	codec_offload_engine_t *node;
+
+	if (!CODEC_OFFLOAD.rwlock) {
+		stream->write_function(stream, "-ERR codec offload not initialized\n");
+		return;
+	}
+
+	switch_mutex_lock(CODEC_OFFLOAD.mutex);
+	stream->write_function(stream, "threads: %d\nbatch: %u\njobs: %" SWITCH_UINT64_T_FMT "\nbatches: %" SWITCH_UINT64_T_FMT
+						   "\nlargest-batch: %u\ninline-jobs: %" SWITCH_UINT64_T_FMT "\n",
+						   CODEC_OFFLOAD.thread_count, CODEC_OFFLOAD.batch, CODEC_OFFLOAD.jobs, CODEC_OFFLOAD.batches,
+						   CODEC_OFFLOAD.largest_batch, CODEC_OFFLOAD.inline_jobs);
+	switch_mutex_unlock(CODEC_OFFLOAD.mutex);
+
+	switch_thread_rwlock_rdlock(CODEC_OFFLOAD.rwlock);
+	for (node = CODEC_OFFLOAD.engines; node; node = node->next) {
+		if (!node->dead) {
+			stream->write_function(stream, "engine: %s\n", node->engine.name);
+		}
+	}
+	switch_thread_rwlock_unlock(CODEC_OFFLOAD.rwlock);
+}
+
+void switch_core_codec_offload_init(void)
+{
+	int i;
+
+	if (CODEC_OFFLOAD.rwlock) {
+		return;
+	}
+
+	switch_core_new_memory_pool(&CODEC_OFFLOAD.pool);
+	switch_thread_rwlock_create(&CODEC_OFFLOAD.rwlock, CODEC_OFFLOAD.pool);
+	switch_mutex_init(&CODEC_OFFLOAD.mutex, SWITCH_MUTEX_NESTED, CODEC_OFFLOAD.pool);
+	CODEC_OFFLOAD.batch = runtime.codec_offload_batch > CODEC_OFFLOAD_MAX_BATCH ? CODEC_OFFLOAD_MAX_BATCH : runtime.codec_offload_batch;
+
+	if (!CODEC_OFFLOAD.batch) {
+		CODEC_OFFLOAD.batch = 1;
+	}
+
+	if (!runtime.codec_offload_threads) {
+		return;
+	}
+
+	switch_queue_create(&CODEC_OFFLOAD.queue, SWITCH_CORE_QUEUE_LEN, CODEC_OFFLOAD.pool);
+	CODEC_OFFLOAD.thread_count = runtime.codec_offload_threads > CODEC_OFFLOAD_MAX_THREADS ?
+		CODEC_OFFLOAD_MAX_THREADS : (int) runtime.codec_offload_threads;
+
+	for (i = 0; i < CODEC_OFFLOAD.thread_count; i++) {
+		switch_threadattr_t *thd_attr;
+
+		switch_threadattr_create(&thd_attr, CODEC_OFFLOAD.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&CODEC_OFFLOAD.threads[i], thd_attr, codec_offload_thread, CODEC_OFFLOAD.queue, CODEC_OFFLOAD.pool);
+	}
+
+	if (runtime.codec_offload_codecs) {
+		switch_codec_offload_engine_t cpu = { 0 };
+
+		cpu.name = "cpu";
+		cpu.claim = codec_offload_cpu_claim;
+		cpu.process = codec_offload_cpu_process;
+		cpu.user_data = runtime.codec_offload_codecs;
+		switch_core_codec_offload_register(&cpu);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Started %d codec offload threads, up to %u frames per batch\n",
+					  CODEC_OFFLOAD.thread_count, CODEC_OFFLOAD.batch);
+}
+
+void switch_core_codec_offload_shutdown(void)
+{
+	switch_queue_t *queue = CODEC_OFFLOAD.queue;
+	void *pop;
+	int i;
+
+	if (!queue) {
+		return;
+	}
+
+	/* new jobs run inline from here on */
+	CODEC_OFFLOAD.queue = NULL;
+
+	for (i = 0; i < CODEC_OFFLOAD.thread_count; i++) {
+		switch_queue_push(queue, NULL);
+	}
+
+	for (i = 0; i < CODEC_OFFLOAD.thread_count; i++) {
+		switch_status_t st;
+		switch_thread_join(&st, CODEC_OFFLOAD.threads[i]);
+	}
+	CODEC_OFFLOAD.thread_count = 0;
+
+	/* anything queued behind the stop markers still has a session thread waiting on it */
+	while (switch_queue_trypop(queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		if (pop) {
+			switch_codec_offload_job_t *job = (switch_codec_offload_job_t *) pop;
+			codec_offload_service(&job, 1);
+		}
+	}
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_codec_copy(switch_codec_t *codec, switch_codec_t *new_codec, switch_memory_pool_t *pool)
 {
 	switch_status_t status;
@@ -627,6 +1012,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_copy(switch_codec_t *codec, sw
 	}
 
 	new_codec->implementation->init(new_codec, new_codec->flags, NULL);
+	codec_offload_attach(new_codec);
 
 	switch_mutex_init(&new_codec->mutex, SWITCH_MUTEX_NESTED, new_codec->memory_pool);
 
@@ -698,6 +1084,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_init_with_bitrate(switch_codec
 
 		implementation->init(codec, flags, codec_settings);
 		switch_mutex_init(&codec->mutex, SWITCH_MUTEX_NESTED, codec->memory_pool);
+		codec_offload_attach(codec);
 		switch_set_flag(codec, SWITCH_CODEC_FLAG_READY);
 		return SWITCH_STATUS_SUCCESS;
 	} else {
@@ -734,8 +1121,24 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_encode(switch_codec_t *codec,
 	}
 
 	if (codec->mutex) switch_mutex_lock(codec->mutex);
-	status = codec->implementation->encode(codec, other_codec, decoded_data, decoded_data_len,
-										   decoded_rate, encoded_data, encoded_data_len, encoded_rate, flag);
+	if (codec->offload) {
+		switch_codec_offload_job_t job = { 0 };
+
+		job.codec = codec;
+		job.other_codec = other_codec;
+		job.encode = SWITCH_TRUE;
+		job.in_data = decoded_data;
+		job.in_len = decoded_data_len;
+		job.in_rate = decoded_rate;
+		job.out_data = encoded_data;
+		job.out_len = encoded_data_len;
+		job.out_rate = encoded_rate;
+		job.flag = flag;
+		status = codec_offload_submit(codec, &job);
+	} else {
+		status = codec->implementation->encode(codec, other_codec, decoded_data, decoded_data_len,
+											   decoded_rate, encoded_data, encoded_data_len, encoded_rate, flag);
+	}
 	if (codec->mutex) switch_mutex_unlock(codec->mutex);
 
 	return status;
@@ -779,8 +1182,24 @@ SWITCH_DECLARE(switch_status_t) switch_core_codec_decode(switch_codec_t *codec,
 	}
 	
 	if (codec->mutex) switch_mutex_lock(codec->mutex);
-	status = codec->implementation->decode(codec, other_codec, encoded_data, encoded_data_len, encoded_rate,
-										   decoded_data, decoded_data_len, decoded_rate, flag);
+	if (codec->offload) {
+		switch_codec_offload_job_t job = { 0 };
+
+		job.codec = codec;
+		job.other_codec = other_codec;
+		job.encode = SWITCH_FALSE;
+		job.in_data = encoded_data;
+		job.in_len = encoded_data_len;
+		job.in_rate = encoded_rate;
+		job.out_data = decoded_data;
+		job.out_len = decoded_data_len;
+		job.out_rate = decoded_rate;
+		job.flag = flag;
+		status = codec_offload_submit(codec, &job);
+	} else {
+		status = codec->implementation->decode(codec, other_codec, encoded_data, encoded_data_len, encoded_rate,
+											   decoded_data, decoded_data_len, decoded_rate, flag);
+	}
 	if (codec->mutex) switch_mutex_unlock(codec->mutex);
 
 	return status;
@@ -153,6 +153,11 @@ SWITCH_DECLARE(int) switch_core_db_bind_double(switch_core_db_stmt_t *pStmt, int
 	return sqlite3_bind_double(pStmt, i, dValue);
 }
 
+SWITCH_DECLARE(int) switch_core_db_bind_null(switch_core_db_stmt_t *pStmt, int i)
+{
+	return sqlite3_bind_null(pStmt, i);
+}
+
 SWITCH_DECLARE(int64_t) switch_core_db_last_insert_rowid(switch_core_db_t *db)
 {
 	return sqlite3_last_insert_rowid(db);
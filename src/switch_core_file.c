@@ -36,6 +36,863 @@
 #include <switch.h>
 #include "private/switch_core_pvt.h"
 
+/*
+ * Prompt cache.  IVRs play the same few hundred prompts to every caller, so a file opened for plain reading is
+ * decoded once to mono L16 at the rate it is asked for and every handle on it reads from that one shared copy,
+ * with no decode, resample or file I/O of its own.  Entries are keyed by rate and path, referenced while a handle
+ * reads from them and evicted least recently used first once prompt-cache-size is reached.  The file is stat()ed
+ * again at most every FILE_CACHE_RECHECK seconds and a changed one is decoded again.
+ * Sessions whose write codec has a constant frame size can also read a variant of the prompt encoded once for that
+ * codec, so the frames go out without being encoded per call.
+ */
+#define FILE_CACHE_RECHECK 5
+
+typedef struct switch_file_cache_variant {
+	char *name;
+	/* NULL when the codec did not hand out constant size frames, remembered so it is not tried again */
+	uint8_t *data;
+	switch_size_t datalen;
+	uint32_t frame_bytes;
+	uint32_t frame_samples;
+	struct switch_file_cache_variant *next;
+} file_cache_variant_t;
+
+typedef struct switch_file_cache_node {
+	char *key;
+	/* NULL for a file that is too big or not L16, remembered so it is not decoded again on every play */
+	int16_t *data;
+	switch_size_t samples;
+	switch_size_t bytes;
+	time_t mtime;
+	int64_t size;
+	time_t checked;
+	int refs;
+	int dead;
+	file_cache_variant_t *variants;
+	struct switch_file_cache_node *prev;
+	struct switch_file_cache_node *next;
+} file_cache_node_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *hash;
+	file_cache_node_t *head;
+	file_cache_node_t *tail;
+	uint32_t count;
+	switch_size_t bytes;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+} FILE_CACHE;
+
+static void file_cache_variant_free(file_cache_variant_t *variant)
+{
+	switch_safe_free(variant->data);
+	switch_safe_free(variant->name);
+	free(variant);
+}
+
+static void file_cache_node_free(file_cache_node_t *node)
+{
+	file_cache_variant_t *variant;
+
+	while ((variant = node->variants)) {
+		node->variants = variant->next;
+		file_cache_variant_free(variant);
+	}
+
+	switch_safe_free(node->data);
+	switch_safe_free(node->key);
+	free(node);
+}
+
+static void file_cache_unlink(file_cache_node_t *node)
+{
+	if (node->prev) {
+		node->prev->next = node->next;
+	} else {
+		FILE_CACHE.head = node->next;
+	}
+
+	if (node->next) {
+		node->next->prev = node->prev;
+	} else {
+		FILE_CACHE.tail = node->prev;
+	}
+
+	node->prev = node->next = NULL;
+}
+
+static void file_cache_push(file_cache_node_t *node)
+{
+	node->prev = NULL;
+	if ((node->next = FILE_CACHE.head)) {
+		FILE_CACHE.head->prev = node;
+	} else {
+		FILE_CACHE.tail = node;
+	}
+	FILE_CACHE.head = node;
+}
+
+/* takes the node out of the cache, it is freed now or by the last file_cache_release() */
+static void file_cache_drop(file_cache_node_t *node)
+{
+	file_cache_unlink(node);
+	switch_core_hash_delete(FILE_CACHE.hash, node->key);
+	FILE_CACHE.count--;
+	FILE_CACHE.bytes -= node->bytes;
+
+	if (node->refs) {
+		node->dead = 1;
+	} else {
+		file_cache_node_free(node);
+	}
+}
+
+/* called locked, hands out a reference when there is audio to read */
+static file_cache_node_t *file_cache_hit(file_cache_node_t *node)
+{
+	FILE_CACHE.hits++;
+
+	if (node != FILE_CACHE.head) {
+		file_cache_unlink(node);
+		file_cache_push(node);
+	}
+
+	if (!node->data) {
+		return NULL;
+	}
+
+	node->refs++;
+
+	return node;
+}
+
+static void file_cache_release(file_cache_node_t *node)
+{
+	switch_mutex_lock(FILE_CACHE.mutex);
+	if (!--node->refs && node->dead) {
+		file_cache_node_free(node);
+	}
+	switch_mutex_unlock(FILE_CACHE.mutex);
+}
+
+static switch_bool_t file_cache_stat(const char *path, time_t *mtime, int64_t *size)
+{
+	struct stat st;
+
+	if (stat(path, &st) || !(st.st_mode & S_IFREG)) {
+		return SWITCH_FALSE;
+	}
+
+	*mtime = st.st_mtime;
+	*size = (int64_t) st.st_size;
+
+	return SWITCH_TRUE;
+}
+
+/* decodes the whole file through a handle of its own, NULL when it does not open at all */
+static file_cache_node_t *file_cache_load(const char *path, uint32_t rate, int64_t size)
+{
+	switch_file_handle_t fh = { 0 };
+	file_cache_node_t *node;
+	int16_t buf[1024];
+	switch_size_t len, alloced = 0;
+	int too_big = 0;
+
+	if (switch_core_file_open(&fh, path, 1, rate, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT | SWITCH_FILE_NOCACHE, NULL) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	switch_zmalloc(node, sizeof(*node));
+
+	if (size > (int64_t) runtime.file_cache_max_file || switch_test_flag((&fh), SWITCH_FILE_NATIVE)) {
+		switch_core_file_close(&fh);
+		return node;
+	}
+
+	for (;;) {
+		len = sizeof(buf) / sizeof(buf[0]);
+
+		if (switch_core_file_read(&fh, buf, &len) != SWITCH_STATUS_SUCCESS || !len) {
+			break;
+		}
+
+		if ((node->samples + len) * sizeof(int16_t) > runtime.file_cache_max_file) {
+			too_big = 1;
+			break;
+		}
+
+		if (node->samples + len > alloced) {
+			void *mem;
+
+			alloced = (node->samples + len) * 2;
+			mem = realloc(node->data, alloced * sizeof(int16_t));
+			switch_assert(mem);
+			node->data = mem;
+		}
+
+		memcpy(node->data + node->samples, buf, len * sizeof(int16_t));
+		node->samples += len;
+	}
+
+	switch_core_file_close(&fh);
+
+	if (too_big || !node->samples) {
+		switch_safe_free(node->data);
+		node->samples = 0;
+	} else if (alloced > node->samples) {
+		void *mem = realloc(node->data, node->samples * sizeof(int16_t));
+
+		if (mem) {
+			node->data = mem;
+		}
+	}
+
+	return node;
+}
+
+/* a referenced node to read from or NULL to open the file the usual way */
+static file_cache_node_t *file_cache_get(const char *path, uint32_t rate)
+{
+	file_cache_node_t *node, *old;
+	time_t now = switch_epoch_time_now(NULL), mtime = 0;
+	int64_t size = 0;
+	char *key;
+
+	if (!FILE_CACHE.mutex || !runtime.file_cache_size) {
+		return NULL;
+	}
+
+	key = switch_mprintf("%u:%s", rate, path);
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+	if ((node = switch_core_hash_find(FILE_CACHE.hash, key)) && now - node->checked < FILE_CACHE_RECHECK) {
+		node = file_cache_hit(node);
+		switch_mutex_unlock(FILE_CACHE.mutex);
+		free(key);
+		return node;
+	}
+	switch_mutex_unlock(FILE_CACHE.mutex);
+
+	if (!file_cache_stat(path, &mtime, &size)) {
+		free(key);
+		return NULL;
+	}
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+	if ((node = switch_core_hash_find(FILE_CACHE.hash, key))) {
+		if (node->mtime == mtime && node->size == size) {
+			node->checked = now;
+			node = file_cache_hit(node);
+			switch_mutex_unlock(FILE_CACHE.mutex);
+			free(key);
+			return node;
+		}
+
+		/* changed on disk */
+		file_cache_drop(node);
+	}
+	FILE_CACHE.misses++;
+	switch_mutex_unlock(FILE_CACHE.mutex);
+
+	if (!(node = file_cache_load(path, rate, size))) {
+		free(key);
+		return NULL;
+	}
+
+	node->key = key;
+	node->mtime = mtime;
+	node->size = size;
+	node->checked = now;
+	node->bytes = sizeof(*node) + strlen(key) + node->samples * sizeof(int16_t);
+	node->refs = node->data ? 1 : 0;
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+	if ((old = switch_core_hash_find(FILE_CACHE.hash, key))) {
+		/* somebody else decoded it meanwhile, theirs stays */
+		old = file_cache_hit(old);
+		switch_mutex_unlock(FILE_CACHE.mutex);
+		file_cache_node_free(node);
+		return old;
+	}
+
+	switch_core_hash_insert(FILE_CACHE.hash, key, node);
+	file_cache_push(node);
+	FILE_CACHE.count++;
+	FILE_CACHE.bytes += node->bytes;
+
+	while (FILE_CACHE.bytes > runtime.file_cache_size && FILE_CACHE.tail && FILE_CACHE.tail != node) {
+		file_cache_drop(FILE_CACHE.tail);
+		FILE_CACHE.evictions++;
+	}
+	switch_mutex_unlock(FILE_CACHE.mutex);
+
+	return node->data ? node : NULL;
+}
+
+static file_cache_variant_t *file_cache_variant_find(file_cache_node_t *node, const char *name)
+{
+	file_cache_variant_t *variant;
+
+	for (variant = node->variants; variant; variant = variant->next) {
+		if (!strcmp(variant->name, name)) {
+			break;
+		}
+	}
+
+	return variant;
+}
+
+/* encodes all of the node's audio a frame at a time, the last frame padded with silence */
+static file_cache_variant_t *file_cache_variant_encode(file_cache_node_t *node, const switch_codec_implementation_t *impl, char *name)
+{
+	switch_codec_t codec = { 0 };
+	file_cache_variant_t *variant;
+	int16_t *frame;
+	uint8_t enc[SWITCH_RECOMMENDED_BUFFER_SIZE];
+	switch_size_t pos, frames;
+	uint32_t spf = impl->samples_per_packet;
+
+	switch_zmalloc(variant, sizeof(*variant));
+	variant->name = name;
+	variant->frame_bytes = impl->encoded_bytes_per_packet;
+	variant->frame_samples = spf;
+
+	if (switch_core_codec_init_with_bitrate(&codec, impl->iananame, NULL, impl->samples_per_second, impl->microseconds_per_packet / 1000, 1,
+											impl->bits_per_second, SWITCH_CODEC_FLAG_ENCODE, NULL, NULL) != SWITCH_STATUS_SUCCESS) {
+		return variant;
+	}
+
+	frames = (node->samples + spf - 1) / spf;
+	switch_zmalloc(frame, spf * sizeof(int16_t));
+	switch_zmalloc(variant->data, frames * variant->frame_bytes);
+
+	for (pos = 0; pos < frames; pos++) {
+		switch_size_t off = pos * spf, n = node->samples - off > spf ? spf : node->samples - off;
+		uint32_t enclen = sizeof(enc), rate = impl->actual_samples_per_second;
+		unsigned int flag = 0;
+
+		memcpy(frame, node->data + off, n * sizeof(int16_t));
+		if (n < spf) {
+			memset(frame + n, 0, (spf - n) * sizeof(int16_t));
+		}
+
+		if (switch_core_codec_encode(&codec, NULL, frame, spf * sizeof(int16_t), impl->actual_samples_per_second,
+									 enc, &enclen, &rate, &flag) != SWITCH_STATUS_SUCCESS || enclen != variant->frame_bytes) {
+			switch_safe_free(variant->data);
+			break;
+		}
+
+		memcpy(variant->data + variant->datalen, enc, enclen);
+		variant->datalen += enclen;
+	}
+
+	if (!variant->data) {
+		variant->datalen = 0;
+	}
+
+	free(frame);
+	switch_core_codec_destroy(&codec);
+
+	return variant;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_file_cache_native(switch_file_handle_t *fh, switch_codec_t *codec)
+{
+	const switch_codec_implementation_t *impl;
+	file_cache_node_t *node = fh->cache_node;
+	file_cache_variant_t *variant, *old;
+	char *name;
+
+	if (fh->cache_variant || !switch_core_codec_ready(codec)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!node) {
+		/* anything the core already holds in linear form would be lost, the module has to be read straight */
+		if (fh->file_interface->file_native && !switch_test_flag(fh, SWITCH_FILE_NATIVE) && !fh->pre_buffer && !fh->buffer && !fh->resampler && !fh->io) {
+			return fh->file_interface->file_native(fh, codec);
+		}
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!runtime.file_cache_native) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	impl = codec->implementation;
+
+	if (impl->actual_samples_per_second != fh->samplerate || impl->number_of_channels != 1 || !impl->encoded_bytes_per_packet ||
+		!impl->samples_per_packet || !strcasecmp(impl->iananame, "L16")) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	name = switch_mprintf("%s@%uh@%ui@%d", impl->iananame, impl->samples_per_second, impl->microseconds_per_packet / 1000, impl->bits_per_second);
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+	variant = file_cache_variant_find(node, name);
+	switch_mutex_unlock(FILE_CACHE.mutex);
+
+	if (variant) {
+		free(name);
+	} else {
+		variant = file_cache_variant_encode(node, impl, name);
+
+		switch_mutex_lock(FILE_CACHE.mutex);
+		if ((old = file_cache_variant_find(node, name))) {
+			/* somebody else encoded it meanwhile, theirs stays */
+			file_cache_variant_free(variant);
+			variant = old;
+		} else if (node->dead) {
+			file_cache_variant_free(variant);
+			variant = NULL;
+		} else {
+			variant->next = node->variants;
+			node->variants = variant;
+			node->bytes += sizeof(*variant) + variant->datalen;
+			FILE_CACHE.bytes += sizeof(*variant) + variant->datalen;
+		}
+		switch_mutex_unlock(FILE_CACHE.mutex);
+	}
+
+	if (!variant || !variant->data) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	fh->cache_variant = variant;
+	fh->cache_pos = (fh->cache_pos / variant->frame_samples) * variant->frame_bytes;
+	switch_set_flag(fh, SWITCH_FILE_NATIVE);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+void switch_core_file_cache_init(switch_memory_pool_t *pool)
+{
+	switch_mutex_init(&FILE_CACHE.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init_case(&FILE_CACHE.hash, pool, SWITCH_TRUE);
+}
+
+void switch_core_file_cache_shutdown(void)
+{
+	if (!FILE_CACHE.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+	while (FILE_CACHE.head) {
+		file_cache_drop(FILE_CACHE.head);
+	}
+	switch_core_hash_destroy(&FILE_CACHE.hash);
+	switch_mutex_unlock(FILE_CACHE.mutex);
+	FILE_CACHE.mutex = NULL;
+}
+
+SWITCH_DECLARE(void) switch_core_file_cache_flush(void)
+{
+	if (!FILE_CACHE.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+	while (FILE_CACHE.head) {
+		file_cache_drop(FILE_CACHE.head);
+	}
+	switch_mutex_unlock(FILE_CACHE.mutex);
+}
+
+SWITCH_DECLARE(void) switch_core_file_cache_stats(switch_stream_handle_t *stream)
+{
+	uint64_t total;
+
+	if (!FILE_CACHE.mutex) {
+		stream->write_function(stream, "-ERR prompt cache not running\n");
+		return;
+	}
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+	total = FILE_CACHE.hits + FILE_CACHE.misses;
+	stream->write_function(stream, "files: %u\nbytes: %" SWITCH_SIZE_T_FMT "/%" SWITCH_SIZE_T_FMT "\nhits: %" SWITCH_UINT64_T_FMT
+						   "\nmisses: %" SWITCH_UINT64_T_FMT "\nevictions: %" SWITCH_UINT64_T_FMT "\nhit-rate: %u%%\n",
+						   FILE_CACHE.count, FILE_CACHE.bytes, runtime.file_cache_size, FILE_CACHE.hits, FILE_CACHE.misses,
+						   FILE_CACHE.evictions, total ? (uint32_t) (FILE_CACHE.hits * 100 / total) : 0);
+	switch_mutex_unlock(FILE_CACHE.mutex);
+}
+
+/*
+ * Async file I/O.  With file-io-threads set, the module reads and writes of regular files run on a small pool of I/O
+ * threads instead of the session's media thread: playback reads ahead into a buffer of file-io-depth bytes and
+ * recordings queue up to the same depth behind the writer, so a slow disk or NFS share only stalls a session once
+ * that buffer runs dry or full.  Anything else the module does (seek, strings, truncate, close) first waits for the
+ * handle's outstanding I/O and then runs on the caller as before.
+ * Writers queue the PCM exactly as it was handed to switch_core_file_write(), resampling and the module's encoding
+ * happen on the I/O thread, which only takes whole file-io-write-chunk blocks until the handle is synced or closed.
+ */
+#define FILE_IO_MAX_THREADS 64
+#define FILE_IO_CHUNK 16384
+
+typedef struct switch_file_io {
+	switch_file_handle_t *fh;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	switch_buffer_t *buffer;
+	uint8_t *chunk;
+	switch_size_t chunk_len;
+	switch_size_t depth;
+	uint32_t unit;
+	switch_bool_t writer;
+	int queued;
+	int flush;
+	int eof;
+	switch_status_t error;
+} file_io_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_queue_t *queue;
+	switch_thread_t *threads[FILE_IO_MAX_THREADS];
+	int thread_count;
+	switch_mutex_t *mutex;
+	uint32_t handles;
+	uint64_t read_bytes;
+	uint64_t write_bytes;
+	uint64_t read_stalls;
+	uint64_t write_stalls;
+	uint64_t write_errors;
+	switch_time_t stall_time;
+	switch_time_t stall_max;
+} FILE_IO;
+
+static void file_io_count(uint64_t *counter, uint64_t value)
+{
+	switch_mutex_lock(FILE_IO.mutex);
+	*counter += value;
+	switch_mutex_unlock(FILE_IO.mutex);
+}
+
+static void file_io_stalled(uint64_t *counter, switch_time_t started)
+{
+	switch_time_t waited = switch_micro_time_now() - started;
+
+	switch_mutex_lock(FILE_IO.mutex);
+	(*counter)++;
+	FILE_IO.stall_time += waited;
+	if (waited > FILE_IO.stall_max) {
+		FILE_IO.stall_max = waited;
+	}
+	switch_mutex_unlock(FILE_IO.mutex);
+}
+
+/* called locked, hands the handle to an I/O thread unless one has it already */
+static void file_io_kick(file_io_t *io)
+{
+	if (!io->queued) {
+		io->queued = 1;
+		switch_queue_push(FILE_IO.queue, io);
+	}
+}
+
+static switch_status_t file_write_process(switch_file_handle_t *fh, void *data, switch_size_t *len);
+
+/* runs on an I/O thread, the module is called unlocked so the session can keep using the buffer meanwhile */
+static void file_io_service(file_io_t *io)
+{
+	switch_file_handle_t *fh = io->fh;
+	switch_size_t bytes, len;
+	switch_status_t status;
+
+	switch_mutex_lock(io->mutex);
+	for (;;) {
+		if (io->writer) {
+			if (io->error != SWITCH_STATUS_SUCCESS || (!io->flush && switch_buffer_inuse(io->buffer) < io->chunk_len) ||
+				!(bytes = switch_buffer_read(io->buffer, io->chunk, io->chunk_len))) {
+				break;
+			}
+			switch_thread_cond_broadcast(io->cond);
+			switch_mutex_unlock(io->mutex);
+
+			len = bytes / io->unit;
+			status = file_write_process(fh, io->chunk, &len);
+			file_io_count(&FILE_IO.write_bytes, bytes);
+
+			switch_mutex_lock(io->mutex);
+			if (status != SWITCH_STATUS_SUCCESS) {
+				io->error = status;
+				file_io_count(&FILE_IO.write_errors, 1);
+			}
+		} else {
+			switch_size_t inuse = switch_buffer_inuse(io->buffer);
+
+			if (io->eof || inuse >= io->depth) {
+				break;
+			}
+
+			bytes = io->depth - inuse;
+			if (bytes > io->chunk_len) {
+				bytes = io->chunk_len;
+			}
+
+			if (!(len = bytes / io->unit)) {
+				break;
+			}
+			switch_mutex_unlock(io->mutex);
+
+			status = fh->file_interface->file_read(fh, io->chunk, &len);
+
+			switch_mutex_lock(io->mutex);
+			if (status != SWITCH_STATUS_SUCCESS || !len) {
+				io->eof = 1;
+			} else {
+				switch_buffer_write(io->buffer, io->chunk, len * io->unit);
+				file_io_count(&FILE_IO.read_bytes, len * io->unit);
+			}
+			switch_thread_cond_broadcast(io->cond);
+		}
+	}
+	io->queued = 0;
+	switch_thread_cond_broadcast(io->cond);
+	switch_mutex_unlock(io->mutex);
+}
+
+static void *SWITCH_THREAD_FUNC file_io_thread(switch_thread_t *thread, void *obj)
+{
+	void *pop;
+
+	while (switch_queue_pop(FILE_IO.queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		file_io_service((file_io_t *) pop);
+	}
+
+	return NULL;
+}
+
+static void file_io_attach(switch_file_handle_t *fh)
+{
+	file_io_t *io;
+
+	io = switch_core_alloc(fh->memory_pool, sizeof(*io));
+	io->fh = fh;
+	io->writer = (fh->flags & SWITCH_FILE_FLAG_WRITE) ? SWITCH_TRUE : SWITCH_FALSE;
+	io->unit = (switch_test_flag(fh, SWITCH_FILE_NATIVE) ? 1 : 2) * (fh->channels ? fh->channels : 1);
+	io->depth = runtime.file_io_depth;
+	io->error = SWITCH_STATUS_SUCCESS;
+
+	/* writers take whole chunks, at most half the queue so the session can fill one while the other is written */
+	if (io->writer) {
+		io->chunk_len = runtime.file_io_write_chunk < io->depth / 2 ? runtime.file_io_write_chunk : io->depth / 2;
+	} else {
+		io->chunk_len = FILE_IO_CHUNK;
+	}
+	io->chunk_len -= io->chunk_len % io->unit;
+	io->chunk = switch_core_alloc(fh->memory_pool, io->chunk_len);
+	switch_mutex_init(&io->mutex, SWITCH_MUTEX_NESTED, fh->memory_pool);
+	switch_thread_cond_create(&io->cond, fh->memory_pool);
+	switch_buffer_create_dynamic(&io->buffer, FILE_IO_CHUNK, io->depth, 0);
+	fh->io = io;
+
+	switch_mutex_lock(FILE_IO.mutex);
+	FILE_IO.handles++;
+	switch_mutex_unlock(FILE_IO.mutex);
+
+	if (!io->writer) {
+		/* start reading ahead right away so the first frame does not wait on the disk */
+		switch_mutex_lock(io->mutex);
+		file_io_kick(io);
+		switch_mutex_unlock(io->mutex);
+	}
+}
+
+/* waits for the handle's outstanding I/O, queued writes included, and returns with the handle locked */
+static void file_io_sync(file_io_t *io)
+{
+	switch_mutex_lock(io->mutex);
+	io->flush = 1;
+	while (io->queued || (io->writer && io->error == SWITCH_STATUS_SUCCESS && switch_buffer_inuse(io->buffer))) {
+		file_io_kick(io);
+		switch_thread_cond_timedwait(io->cond, io->mutex, 20000);
+	}
+	io->flush = 0;
+}
+
+static void file_io_detach(switch_file_handle_t *fh)
+{
+	file_io_t *io = fh->io;
+
+	file_io_sync(io);
+	fh->io = NULL;
+	switch_mutex_unlock(io->mutex);
+
+	switch_buffer_destroy(&io->buffer);
+
+	switch_mutex_lock(FILE_IO.mutex);
+	FILE_IO.handles--;
+	switch_mutex_unlock(FILE_IO.mutex);
+}
+
+/* undoes file_io_sync(), dropping what was read ahead when the module has moved to another position */
+static void file_io_release(file_io_t *io, switch_bool_t moved)
+{
+	if (moved && !io->writer) {
+		switch_buffer_zero(io->buffer);
+		io->eof = 0;
+		file_io_kick(io);
+	}
+	switch_mutex_unlock(io->mutex);
+}
+
+static switch_status_t file_io_read(file_io_t *io, void *data, switch_size_t *len)
+{
+	switch_size_t want = *len * io->unit;
+	switch_time_t started = 0;
+
+	/* the read ahead never holds more than depth */
+	if (want > io->depth) {
+		want = io->depth - io->depth % io->unit;
+	}
+
+	switch_mutex_lock(io->mutex);
+	while (switch_buffer_inuse(io->buffer) < want && !io->eof) {
+		if (!started) {
+			started = switch_micro_time_now();
+		}
+		file_io_kick(io);
+		switch_thread_cond_timedwait(io->cond, io->mutex, 20000);
+	}
+
+	*len = switch_buffer_read(io->buffer, data, want) / io->unit;
+
+	if (!io->eof && switch_buffer_inuse(io->buffer) < io->depth / 2) {
+		file_io_kick(io);
+	}
+	switch_mutex_unlock(io->mutex);
+
+	if (started) {
+		file_io_stalled(&FILE_IO.read_stalls, started);
+	}
+
+	return *len ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
+}
+
+static switch_status_t file_io_write(file_io_t *io, void *data, switch_size_t *len)
+{
+	switch_size_t bytes = *len * io->unit;
+	switch_time_t started = 0;
+	switch_status_t status;
+
+	switch_mutex_lock(io->mutex);
+	while (io->error == SWITCH_STATUS_SUCCESS && switch_buffer_inuse(io->buffer) && switch_buffer_inuse(io->buffer) + bytes > io->depth) {
+		if (!started) {
+			started = switch_micro_time_now();
+		}
+		file_io_kick(io);
+		switch_thread_cond_timedwait(io->cond, io->mutex, 20000);
+	}
+
+	if ((status = io->error) == SWITCH_STATUS_SUCCESS) {
+		switch_buffer_write(io->buffer, data, bytes);
+
+		if (switch_buffer_inuse(io->buffer) >= io->chunk_len) {
+			file_io_kick(io);
+		}
+	} else {
+		*len = 0;
+	}
+	switch_mutex_unlock(io->mutex);
+
+	if (started) {
+		file_io_stalled(&FILE_IO.write_stalls, started);
+	}
+
+	return status;
+}
+
+static inline switch_status_t file_module_read(switch_file_handle_t *fh, void *data, switch_size_t *len)
+{
+	return fh->io ? file_io_read(fh->io, data, len) : fh->file_interface->file_read(fh, data, len);
+}
+
+void switch_core_file_io_init(void)
+{
+	int i;
+
+	if (!runtime.file_io_threads || FILE_IO.queue) {
+		return;
+	}
+
+	switch_core_new_memory_pool(&FILE_IO.pool);
+	switch_mutex_init(&FILE_IO.mutex, SWITCH_MUTEX_NESTED, FILE_IO.pool);
+	switch_queue_create(&FILE_IO.queue, SWITCH_CORE_QUEUE_LEN, FILE_IO.pool);
+
+	FILE_IO.thread_count = runtime.file_io_threads > FILE_IO_MAX_THREADS ? FILE_IO_MAX_THREADS : (int) runtime.file_io_threads;
+
+	for (i = 0; i < FILE_IO.thread_count; i++) {
+		switch_threadattr_t *thd_attr;
+
+		switch_threadattr_create(&thd_attr, FILE_IO.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&FILE_IO.threads[i], thd_attr, file_io_thread, NULL, FILE_IO.pool);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Started %d file I/O threads, %" SWITCH_SIZE_T_FMT " bytes per handle\n",
+					  FILE_IO.thread_count, runtime.file_io_depth);
+}
+
+void switch_core_file_io_shutdown(void)
+{
+	switch_queue_t *queue = FILE_IO.queue;
+	int i;
+
+	if (!queue) {
+		return;
+	}
+
+	/* new handles go synchronous from here on */
+	FILE_IO.queue = NULL;
+
+	for (i = 0; i < FILE_IO.thread_count; i++) {
+		switch_queue_push(queue, NULL);
+	}
+
+	for (i = 0; i < FILE_IO.thread_count; i++) {
+		switch_status_t st;
+		switch_thread_join(&st, FILE_IO.threads[i]);
+	}
+
+	switch_core_destroy_memory_pool(&FILE_IO.pool);
+	FILE_IO.thread_count = 0;
+}
+
+SWITCH_DECLARE(void) switch_core_file_io_stats(switch_stream_handle_t *stream)
+{
+	if (!FILE_IO.queue) {
+		stream->write_function(stream, "-ERR async file I/O not running\n");
+		return;
+	}
+
+	switch_mutex_lock(FILE_IO.mutex);
+	stream->write_function(stream, "threads: %d\ndepth: %" SWITCH_SIZE_T_FMT "\nhandles: %u\nread-bytes: %" SWITCH_UINT64_T_FMT
+						   "\nwrite-bytes: %" SWITCH_UINT64_T_FMT "\nread-stalls: %" SWITCH_UINT64_T_FMT "\nwrite-stalls: %" SWITCH_UINT64_T_FMT
+						   "\nwrite-errors: %" SWITCH_UINT64_T_FMT "\nstall-ms: %" SWITCH_INT64_T_FMT "\nstall-max-ms: %" SWITCH_INT64_T_FMT "\n",
+						   FILE_IO.thread_count, runtime.file_io_depth, FILE_IO.handles, FILE_IO.read_bytes, FILE_IO.write_bytes,
+						   FILE_IO.read_stalls, FILE_IO.write_stalls, FILE_IO.write_errors,
+						   (int64_t) (FILE_IO.stall_time / 1000), (int64_t) (FILE_IO.stall_max / 1000));
+	switch_mutex_unlock(FILE_IO.mutex);
+}
+
+/* the module has closed the file already, so it is opened again just to get it onto the disk */
+static void file_fsync(const char *path)
+{
+#ifndef WIN32
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) > -1) {
+		if (fsync(fd)) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "fsync of [%s] failed: %s\n", path, strerror(errno));
+		}
+		close(fd);
+	}
+#endif
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file, const char *func, int line,
 															  switch_file_handle_t *fh,
 															  const char *file_path,
@@ -66,6 +923,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 
 	fh->flags = flags;
 
+	if ((flags & SWITCH_FILE_FLAG_WRITE) && runtime.file_io_fsync) {
+		switch_set_flag(fh, SWITCH_FILE_FSYNC);
+	}
+
 	if (pool) {
 		fh->memory_pool = pool;
 	} else {
@@ -127,6 +988,19 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 	fh->func = func;
 	fh->line = line;
 
+	if (!is_stream && (flags & SWITCH_FILE_FLAG_READ) && !(flags & (SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_RAW | SWITCH_FILE_NOCACHE)) &&
+		(fh->cache_node = file_cache_get(fh->file_path, fh->samplerate))) {
+		fh->spool_path = NULL;
+		fh->handler = NULL;
+		fh->channels = 1;
+		fh->native_rate = fh->samplerate;
+		fh->sample_count = fh->cache_node->samples;
+		fh->seekable = 1;
+		fh->cache_pos = 0;
+		switch_set_flag(fh, SWITCH_FILE_OPEN);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 
 	if (spool_path) {
 		char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
@@ -193,6 +1067,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "File has %d channels, muxing to mono will occur.\n", fh->channels);
 	}
 
+	if (FILE_IO.queue && !is_stream && !(flags & SWITCH_FILE_NOCACHE)) {
+		file_io_attach(fh);
+	}
+
 	switch_set_flag(fh, SWITCH_FILE_OPEN);
 	return status;
 
@@ -217,6 +1095,51 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_read(switch_file_handle_t *fh,
 		return SWITCH_STATUS_FALSE;
 	}
 
+	if (fh->cache_variant) {
+		file_cache_variant_t *variant = fh->cache_variant;
+		switch_size_t avail = variant->datalen - fh->cache_pos;
+
+		if (!avail) {
+			*len = 0;
+			return SWITCH_STATUS_FALSE;
+		}
+
+		/* whole frames only */
+		*len -= *len % variant->frame_bytes;
+		if (!*len) {
+			*len = variant->frame_bytes;
+		}
+
+		if (*len > avail) {
+			*len = avail;
+		}
+
+		memcpy(data, variant->data + fh->cache_pos, *len);
+		fh->cache_pos += *len;
+		fh->samples_in += (*len / variant->frame_bytes) * variant->frame_samples;
+
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (fh->cache_node) {
+		switch_size_t avail = fh->cache_node->samples - fh->cache_pos;
+
+		if (!avail) {
+			*len = 0;
+			return SWITCH_STATUS_FALSE;
+		}
+
+		if (*len > avail) {
+			*len = avail;
+		}
+
+		memcpy(data, fh->cache_node->data + fh->cache_pos, *len * sizeof(int16_t));
+		fh->cache_pos += *len;
+		fh->samples_in += *len;
+
+		return SWITCH_STATUS_SUCCESS;
+	}
+
   top:
 
 	if (fh->buffer && switch_buffer_inuse(fh->buffer) >= *len * 2) {
@@ -242,7 +1165,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_read(switch_file_handle_t *fh,
 			rlen = asis ? fh->pre_buffer_datalen : fh->pre_buffer_datalen / 2;
 
 			if (switch_buffer_inuse(fh->pre_buffer) < rlen * 2) {
-				if ((status = fh->file_interface->file_read(fh, fh->pre_buffer_data, &rlen)) != SWITCH_STATUS_SUCCESS || !rlen) {
+				if ((status = file_module_read(fh, fh->pre_buffer_data, &rlen)) != SWITCH_STATUS_SUCCESS || !rlen) {
 					switch_set_flag(fh, SWITCH_FILE_BUFFER_DONE);
 				} else {
 					fh->samples_in += rlen;
@@ -266,7 +1189,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_read(switch_file_handle_t *fh,
 
 	} else {
 
-		if ((status = fh->file_interface->file_read(fh, data, len)) != SWITCH_STATUS_SUCCESS || !*len) {
+		if ((status = file_module_read(fh, data, len)) != SWITCH_STATUS_SUCCESS || !*len) {
 			switch_set_flag(fh, SWITCH_FILE_DONE);
 			goto top;
 		}
@@ -327,8 +1250,6 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_read(switch_file_handle_t *fh,
 
 SWITCH_DECLARE(switch_status_t) switch_core_file_write(switch_file_handle_t *fh, void *data, switch_size_t *len)
 {
-	switch_size_t orig_len = *len;
-
 	switch_assert(fh != NULL);
 	switch_assert(fh->file_interface != NULL);
 
@@ -340,6 +1261,18 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_write(switch_file_handle_t *fh,
 		return SWITCH_STATUS_FALSE;
 	}
 
+	if (fh->io && fh->io->writer) {
+		return file_io_write(fh->io, data, len);
+	}
+
+	return file_write_process(fh, data, len);
+}
+
+/* resampling, pre buffering and the module write, on the caller or on an I/O thread */
+static switch_status_t file_write_process(switch_file_handle_t *fh, void *data, switch_size_t *len)
+{
+	switch_size_t orig_len = *len;
+
 	if (!switch_test_flag(fh, SWITCH_FILE_NATIVE) && fh->native_rate != fh->samplerate) {
 		if (!fh->resampler) {
 			if (switch_resample_create(&fh->resampler,
@@ -413,6 +1346,35 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_seek(switch_file_handle_t *fh,
 	
 	switch_assert(fh != NULL);
 
+	if (switch_test_flag(fh, SWITCH_FILE_OPEN) && fh->cache_node) {
+		int64_t target;
+
+		if (whence == SWITCH_SEEK_CUR) {
+			target = (int64_t) fh->offset_pos + samples;
+		} else if (whence == SWITCH_SEEK_END) {
+			target = (int64_t) fh->cache_node->samples + samples;
+		} else {
+			target = samples;
+		}
+
+		if (target < 0) {
+			target = 0;
+		} else if (target > (int64_t) fh->cache_node->samples) {
+			target = (int64_t) fh->cache_node->samples;
+		}
+
+		switch_set_flag(fh, SWITCH_FILE_SEEK);
+		if (fh->cache_variant) {
+			target -= target % fh->cache_variant->frame_samples;
+			fh->cache_pos = (switch_size_t) (target / fh->cache_variant->frame_samples) * fh->cache_variant->frame_bytes;
+		} else {
+			fh->cache_pos = (switch_size_t) target;
+		}
+		fh->offset_pos = *cur_pos = (unsigned int) target;
+
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	if (!switch_test_flag(fh, SWITCH_FILE_OPEN) || !fh->file_interface->file_seek) {
 		ok = 0;
 	} else if (switch_test_flag(fh, SWITCH_FILE_FLAG_WRITE)) {
@@ -435,6 +1397,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_seek(switch_file_handle_t *fh,
 		switch_buffer_zero(fh->pre_buffer);
 	}
 
+	if (fh->io) {
+		file_io_sync(fh->io);
+	}
+
 	if (whence == SWITCH_SEEK_CUR) {
 		unsigned int cur = 0;
 
@@ -454,6 +1420,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_seek(switch_file_handle_t *fh,
 		fh->samples_out = *cur_pos;
 	}
 
+	if (fh->io) {
+		file_io_release(fh->io, SWITCH_TRUE);
+	}
+
 	return status;
 }
 
@@ -466,10 +1436,20 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_set_string(switch_file_handle_t
 		return SWITCH_STATUS_FALSE;
 	}
 
-	if (!fh->file_interface->file_set_string) {
+	if (fh->cache_node || !fh->file_interface->file_set_string) {
 		return SWITCH_STATUS_FALSE;
 	}
 
+	if (fh->io) {
+		switch_status_t status;
+
+		file_io_sync(fh->io);
+		status = fh->file_interface->file_set_string(fh, col, string);
+		file_io_release(fh->io, SWITCH_FALSE);
+
+		return status;
+	}
+
 	return fh->file_interface->file_set_string(fh, col, string);
 }
 
@@ -482,10 +1462,20 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_get_string(switch_file_handle_t
 		return SWITCH_STATUS_FALSE;
 	}
 
-	if (!fh->file_interface->file_get_string) {
+	if (fh->cache_node || !fh->file_interface->file_get_string) {
 		return SWITCH_STATUS_FALSE;
 	}
 
+	if (fh->io) {
+		switch_status_t status;
+
+		file_io_sync(fh->io);
+		status = fh->file_interface->file_get_string(fh, col, string);
+		file_io_release(fh->io, SWITCH_FALSE);
+
+		return status;
+	}
+
 	return fh->file_interface->file_get_string(fh, col, string);
 }
 
@@ -504,7 +1494,15 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_truncate(switch_file_handle_t *
 		return SWITCH_STATUS_FALSE;
 	}
 
-	if ((status = fh->file_interface->file_truncate(fh, offset)) == SWITCH_STATUS_SUCCESS) {
+	if (fh->io) {
+		file_io_sync(fh->io);
+		status = fh->file_interface->file_truncate(fh, offset);
+		file_io_release(fh->io, SWITCH_FALSE);
+	} else {
+		status = fh->file_interface->file_truncate(fh, offset);
+	}
+
+	if (status == SWITCH_STATUS_SUCCESS) {
 		if (fh->buffer) {
 			switch_buffer_zero(fh->buffer);
 		}
@@ -530,6 +1528,11 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_close(switch_file_handle_t *fh)
 		return SWITCH_STATUS_FALSE;
 	}
 
+	/* queued writes go through the pre buffer, so they are drained first */
+	if (fh->io) {
+		file_io_detach(fh);
+	}
+
 	if (fh->buffer) {
 		switch_buffer_destroy(&fh->buffer);
 	}
@@ -557,7 +1560,15 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_close(switch_file_handle_t *fh)
 	}
 
 	switch_clear_flag(fh, SWITCH_FILE_OPEN);
-	status = fh->file_interface->file_close(fh);
+
+	if (fh->cache_node) {
+		file_cache_release(fh->cache_node);
+		fh->cache_node = NULL;
+		fh->cache_variant = NULL;
+		status = SWITCH_STATUS_SUCCESS;
+	} else {
+		status = fh->file_interface->file_close(fh);
+	}
 
 	switch_resample_destroy(&fh->resampler);
 
@@ -578,6 +1589,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_close(switch_file_handle_t *fh)
 		free(command);
 	}
 
+	if (switch_test_flag(fh, SWITCH_FILE_FSYNC) && fh->file_path) {
+		file_fsync(fh->file_path);
+	}
 
 	UNPROTECT_INTERFACE(fh->file_interface);
 
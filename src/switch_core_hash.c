@@ -34,14 +34,257 @@
 
 #include <switch.h>
 #include "private/switch_core_pvt.h"
-#include <sqlite3.h>
-#include "../../../libs/sqlite/src/hash.h"
+
+/*
+ * Open addressing with robin hood probing.  The slot array only holds the
+ * full hash and an index into a dense entry array so probing never leaves
+ * it until the hashes match, and iteration walks the entries in insertion
+ * order.  Deleted entries leave a hole (key == NULL) that is squeezed out
+ * the next time the entry array has to grow, which keeps deleting the
+ * current element while iterating safe.  Inserting while iterating is not.
+ */
+
+#define HASH_MIN_SLOTS 8
+
+struct HashElem {
+	switch_hash_t *hash;
+	char *key;
+	void *data;
+	uint32_t hval;
+	uint32_t klen;
+};
+
+typedef struct {
+	uint32_t hval;
+	uint32_t idx;				/* entry index + 1, 0 is an empty slot */
+} hash_slot_t;
 
 struct switch_hash {
-	Hash table;
+	hash_slot_t *slots;
+	struct HashElem *entries;
+	uint32_t mask;
+	uint32_t count;				/* live entries */
+	uint32_t used;				/* entries handed out, holes included */
+	uint32_t size;				/* entries allocated */
+	switch_bool_t case_sensitive;
 	switch_memory_pool_t *pool;
 };
 
+/* FNV-1a, folding case for the nocase tables, the length comes for free */
+static inline uint32_t hash_key(const switch_hash_t *hash, const char *key, uint32_t *klen)
+{
+	const unsigned char *p = (const unsigned char *) key;
+	uint32_t h = 2166136261U;
+
+	if (hash->case_sensitive) {
+		for (; *p; p++) {
+			h = (h ^ *p) * 16777619U;
+		}
+	} else {
+		for (; *p; p++) {
+			unsigned char c = *p;
+
+			if (c >= 'A' && c <= 'Z') {
+				c += 'a' - 'A';
+			}
+			h = (h ^ c) * 16777619U;
+		}
+	}
+
+	*klen = (uint32_t) (p - (const unsigned char *) key);
+
+	return h;
+}
+
+static inline uint32_t slot_dist(const switch_hash_t *hash, uint32_t pos, uint32_t hval)
+{
+	return (pos - (hval & hash->mask)) & hash->mask;
+}
+
+static int hash_find_slot(switch_hash_t *hash, const char *key, uint32_t hval, uint32_t klen)
+{
+	uint32_t pos, dist = 0;
+
+	if (!hash->slots) {
+		return -1;
+	}
+
+	pos = hval & hash->mask;
+
+	for (;;) {
+		hash_slot_t *slot = &hash->slots[pos];
+
+		if (!slot->idx || slot_dist(hash, pos, slot->hval) < dist) {
+			return -1;
+		}
+
+		if (slot->hval == hval) {
+			struct HashElem *e = &hash->entries[slot->idx - 1];
+
+			if (e->klen == klen && (hash->case_sensitive ? !memcmp(e->key, key, klen) : !strncasecmp(e->key, key, klen))) {
+				return (int) pos;
+			}
+		}
+
+		pos = (pos + 1) & hash->mask;
+		dist++;
+	}
+}
+
+static void hash_place(switch_hash_t *hash, uint32_t hval, uint32_t idx)
+{
+	hash_slot_t cur, tmp;
+	uint32_t pos = hval & hash->mask, dist = 0;
+
+	cur.hval = hval;
+	cur.idx = idx;
+
+	for (;;) {
+		hash_slot_t *slot = &hash->slots[pos];
+		uint32_t sdist;
+
+		if (!slot->idx) {
+			*slot = cur;
+			return;
+		}
+
+		/* take from the rich: whoever is closer to home moves on */
+		if ((sdist = slot_dist(hash, pos, slot->hval)) < dist) {
+			tmp = *slot;
+			*slot = cur;
+			cur = tmp;
+			dist = sdist;
+		}
+
+		pos = (pos + 1) & hash->mask;
+		dist++;
+	}
+}
+
+static void hash_unplace(switch_hash_t *hash, uint32_t pos)
+{
+	uint32_t next = (pos + 1) & hash->mask;
+
+	/* backward shift instead of tombstones */
+	while (hash->slots[next].idx && slot_dist(hash, next, hash->slots[next].hval)) {
+		hash->slots[pos] = hash->slots[next];
+		pos = next;
+		next = (next + 1) & hash->mask;
+	}
+
+	hash->slots[pos].idx = 0;
+}
+
+static void hash_rebuild(switch_hash_t *hash)
+{
+	uint32_t nslots = HASH_MIN_SLOTS, x, n = 0;
+	struct HashElem *entries;
+
+	/* keep the slots at most 3/4 full */
+	while (nslots - nslots / 4 < hash->count * 2) {
+		nslots <<= 1;
+	}
+
+	switch_zmalloc(entries, sizeof(*entries) * (nslots - nslots / 4));
+
+	for (x = 0; x < hash->used; x++) {
+		if (hash->entries[x].key) {
+			entries[n++] = hash->entries[x];
+		}
+	}
+
+	switch_safe_free(hash->entries);
+	switch_safe_free(hash->slots);
+
+	hash->entries = entries;
+	hash->size = nslots - nslots / 4;
+	hash->used = n;
+	hash->mask = nslots - 1;
+	switch_zmalloc(hash->slots, sizeof(*hash->slots) * nslots);
+
+	for (x = 0; x < n; x++) {
+		hash_place(hash, entries[x].hval, x + 1);
+	}
+}
+
+static void hash_remove(switch_hash_t *hash, uint32_t pos)
+{
+	struct HashElem *e = &hash->entries[hash->slots[pos].idx - 1];
+
+	hash_unplace(hash, pos);
+
+	free(e->key);
+	e->key = NULL;
+	e->data = NULL;
+
+	if (!--hash->count) {
+		hash->used = 0;
+	}
+}
+
+static void hash_set_h(switch_hash_t *hash, const char *key, uint32_t hval, uint32_t klen, const void *data)
+{
+	struct HashElem *e;
+	int pos;
+
+	if ((pos = hash_find_slot(hash, key, hval, klen)) >= 0) {
+		if (data) {
+			hash->entries[hash->slots[pos].idx - 1].data = (void *) data;
+		} else {
+			hash_remove(hash, (uint32_t) pos);
+		}
+		return;
+	}
+
+	if (!data) {
+		return;
+	}
+
+	if (hash->used == hash->size) {
+		hash_rebuild(hash);
+	}
+
+	e = &hash->entries[hash->used++];
+	e->hash = hash;
+	e->hval = hval;
+	e->klen = klen;
+	e->data = (void *) data;
+	e->key = malloc(klen + 1);
+	switch_assert(e->key);
+	memcpy(e->key, key, klen + 1);
+	hash->count++;
+
+	hash_place(hash, hval, hash->used);
+}
+
+static inline void hash_set(switch_hash_t *hash, const char *key, const void *data)
+{
+	uint32_t hval, klen;
+
+	hval = hash_key(hash, key, &klen);
+	hash_set_h(hash, key, hval, klen, data);
+}
+
+static void *hash_get_h(switch_hash_t *hash, const char *key, uint32_t hval, uint32_t klen)
+{
+	int pos;
+
+	if ((pos = hash_find_slot(hash, key, hval, klen)) < 0) {
+		return NULL;
+	}
+
+	return hash->entries[hash->slots[pos].idx - 1].data;
+}
+
+static inline void *hash_get(switch_hash_t *hash, const char *key)
+{
+	uint32_t hval, klen;
+
+	hval = hash_key(hash, key, &klen);
+
+	return hash_get_h(hash, key, hval, klen);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_hash_init_case(switch_hash_t **hash, switch_memory_pool_t *pool, switch_bool_t case_sensitive)
 {
 	switch_hash_t *newhash;
@@ -55,7 +298,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_hash_init_case(switch_hash_t **hash,
 
 	switch_assert(newhash);
 
-	sqlite3HashInit(&newhash->table, case_sensitive ? SQLITE_HASH_BINARY : SQLITE_HASH_STRING, 1);
+	newhash->case_sensitive = case_sensitive;
 	*hash = newhash;
 
 	return SWITCH_STATUS_SUCCESS;
@@ -63,8 +306,16 @@ SWITCH_DECLARE(switch_status_t) switch_core_hash_init_case(switch_hash_t **hash,
 
 SWITCH_DECLARE(switch_status_t) switch_core_hash_destroy(switch_hash_t **hash)
 {
+	uint32_t x;
+
 	switch_assert(hash != NULL && *hash != NULL);
-	sqlite3HashClear(&(*hash)->table);
+
+	for (x = 0; x < (*hash)->used; x++) {
+		switch_safe_free((*hash)->entries[x].key);
+	}
+
+	switch_safe_free((*hash)->entries);
+	switch_safe_free((*hash)->slots);
 
 	if (!(*hash)->pool) {
 		free(*hash);
@@ -77,7 +328,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_hash_destroy(switch_hash_t **hash)
 
 SWITCH_DECLARE(switch_status_t) switch_core_hash_insert(switch_hash_t *hash, const char *key, const void *data)
 {
-	sqlite3HashInsert(&hash->table, key, (int) strlen(key) + 1, (void *) data);
+	hash_set(hash, key, data);
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -87,7 +338,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_hash_insert_locked(switch_hash_t *ha
 		switch_mutex_lock(mutex);
 	}
 
-	sqlite3HashInsert(&hash->table, key, (int) strlen(key) + 1, (void *) data);
+	hash_set(hash, key, data);
 
 	if (mutex) {
 		switch_mutex_unlock(mutex);
@@ -102,7 +353,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_hash_insert_wrlock(switch_hash_t *ha
 		switch_thread_rwlock_wrlock(rwlock);
 	}
 
-	sqlite3HashInsert(&hash->table, key, (int) strlen(key) + 1, (void *) data);
+	hash_set(hash, key, data);
 
 	if (rwlock) {
 		switch_thread_rwlock_unlock(rwlock);
@@ -113,7 +364,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_hash_insert_wrlock(switch_hash_t *ha
 
 SWITCH_DECLARE(switch_status_t) switch_core_hash_delete(switch_hash_t *hash, const char *key)
 {
-	sqlite3HashInsert(&hash->table, key, (int) strlen(key) + 1, NULL);
+	hash_set(hash, key, NULL);
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -123,7 +374,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_hash_delete_locked(switch_hash_t *ha
 		switch_mutex_lock(mutex);
 	}
 
-	sqlite3HashInsert(&hash->table, key, (int) strlen(key) + 1, NULL);
+	hash_set(hash, key, NULL);
 
 	if (mutex) {
 		switch_mutex_unlock(mutex);
@@ -138,7 +389,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_hash_delete_wrlock(switch_hash_t *ha
 		switch_thread_rwlock_wrlock(rwlock);
 	}
 
-	sqlite3HashInsert(&hash->table, key, (int) strlen(key) + 1, NULL);
+	hash_set(hash, key, NULL);
 
 	if (rwlock) {
 		switch_thread_rwlock_unlock(rwlock);
@@ -185,7 +436,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_hash_delete_multi(switch_hash_t *has
 
 SWITCH_DECLARE(void *) switch_core_hash_find(switch_hash_t *hash, const char *key)
 {
-	return sqlite3HashFind(&hash->table, key, (int) strlen(key) + 1);
+	return hash_get(hash, key);
 }
 
 SWITCH_DECLARE(void *) switch_core_hash_find_locked(switch_hash_t *hash, const char *key, switch_mutex_t *mutex)
@@ -196,7 +447,7 @@ SWITCH_DECLARE(void *) switch_core_hash_find_locked(switch_hash_t *hash, const c
 		switch_mutex_lock(mutex);
 	}
 
-	val = sqlite3HashFind(&hash->table, key, (int) strlen(key) + 1);
+	val = hash_get(hash, key);
 
 	if (mutex) {
 		switch_mutex_unlock(mutex);
@@ -213,7 +464,7 @@ SWITCH_DECLARE(void *) switch_core_hash_find_rdlock(switch_hash_t *hash, const c
 		switch_thread_rwlock_rdlock(rwlock);
 	}
 
-	val = sqlite3HashFind(&hash->table, key, (int) strlen(key) + 1);
+	val = hash_get(hash, key);
 
 	if (rwlock) {
 		switch_thread_rwlock_unlock(rwlock);
@@ -224,27 +475,310 @@ SWITCH_DECLARE(void *) switch_core_hash_find_rdlock(switch_hash_t *hash, const c
 
 SWITCH_DECLARE(switch_hash_index_t *) switch_hash_first(char *deprecate_me, switch_hash_t *hash)
 {
-	return (switch_hash_index_t *) sqliteHashFirst(&hash->table);
+	uint32_t x;
+
+	for (x = 0; x < hash->used; x++) {
+		if (hash->entries[x].key) {
+			return &hash->entries[x];
+		}
+	}
+
+	return NULL;
 }
 
 SWITCH_DECLARE(switch_hash_index_t *) switch_hash_next(switch_hash_index_t *hi)
 {
-	return (switch_hash_index_t *) sqliteHashNext((HashElem *) hi);
+	switch_hash_t *hash = hi->hash;
+	uint32_t x;
+
+	for (x = (uint32_t) (hi - hash->entries) + 1; x < hash->used; x++) {
+		if (hash->entries[x].key) {
+			return &hash->entries[x];
+		}
+	}
+
+	return NULL;
 }
 
 SWITCH_DECLARE(void) switch_hash_this(switch_hash_index_t *hi, const void **key, switch_ssize_t *klen, void **val)
 {
 	if (key) {
-		*key = sqliteHashKey((HashElem *) hi);
+		*key = hi->key;
 		if (klen) {
-			*klen = strlen((char *) *key) + 1;
+			*klen = hi->klen + 1;
 		}
 	}
 	if (val) {
-		*val = sqliteHashData((HashElem *) hi);
+		*val = hi->data;
 	}
 }
 
+typedef struct {
+	switch_thread_rwlock_t *rwlock;
+	switch_hash_t table;
+} hash_stripe_t;
+
+struct switch_striped_hash {
+	hash_stripe_t *stripes;
+	uint32_t count;
+	uint32_t bits;
+	switch_memory_pool_t *pool;
+	switch_bool_t free_pool;
+};
+
+/* the stripe comes from the top bits, the tables inside use the low ones */
+static inline hash_stripe_t *stripe_for(switch_striped_hash_t *hash, const char *key, uint32_t *hval, uint32_t *klen)
+{
+	*hval = hash_key(&hash->stripes[0].table, key, klen);
+
+	return &hash->stripes[hash->bits ? *hval >> (32 - hash->bits) : 0];
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_striped_hash_init(switch_striped_hash_t **hash, switch_memory_pool_t *pool, uint32_t stripes,
+															 switch_bool_t case_sensitive)
+{
+	switch_striped_hash_t *newhash;
+	switch_bool_t free_pool = SWITCH_FALSE;
+	uint32_t x;
+
+	if (!pool) {
+		if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+			return SWITCH_STATUS_MEMERR;
+		}
+		free_pool = SWITCH_TRUE;
+	}
+
+	if (!stripes) {
+		stripes = 16;
+	}
+
+	newhash = switch_core_alloc(pool, sizeof(*newhash));
+	newhash->pool = pool;
+	newhash->free_pool = free_pool;
+
+	for (newhash->count = 1; newhash->count < stripes && newhash->bits < 16; newhash->count <<= 1) {
+		newhash->bits++;
+	}
+
+	newhash->stripes = switch_core_alloc(pool, sizeof(hash_stripe_t) * newhash->count);
+
+	for (x = 0; x < newhash->count; x++) {
+		switch_thread_rwlock_create(&newhash->stripes[x].rwlock, pool);
+		newhash->stripes[x].table.case_sensitive = case_sensitive;
+		newhash->stripes[x].table.pool = pool;
+	}
+
+	*hash = newhash;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_striped_hash_destroy(switch_striped_hash_t **hash)
+{
+	switch_memory_pool_t *pool;
+	uint32_t x, y;
+
+	switch_assert(hash != NULL && *hash != NULL);
+
+	for (x = 0; x < (*hash)->count; x++) {
+		switch_hash_t *table = &(*hash)->stripes[x].table;
+
+		for (y = 0; y < table->used; y++) {
+			switch_safe_free(table->entries[y].key);
+		}
+
+		switch_safe_free(table->entries);
+		switch_safe_free(table->slots);
+		switch_thread_rwlock_destroy((*hash)->stripes[x].rwlock);
+	}
+
+	if ((*hash)->free_pool) {
+		pool = (*hash)->pool;
+		switch_core_destroy_memory_pool(&pool);
+	}
+
+	*hash = NULL;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_striped_hash_insert(switch_striped_hash_t *hash, const char *key, const void *data)
+{
+	uint32_t hval, klen;
+	hash_stripe_t *stripe = stripe_for(hash, key, &hval, &klen);
+
+	switch_thread_rwlock_wrlock(stripe->rwlock);
+	hash_set_h(&stripe->table, key, hval, klen, data);
+	switch_thread_rwlock_unlock(stripe->rwlock);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_striped_hash_delete(switch_striped_hash_t *hash, const char *key)
+{
+	return switch_core_striped_hash_insert(hash, key, NULL);
+}
+
+SWITCH_DECLARE(void *) switch_core_striped_hash_find(switch_striped_hash_t *hash, const char *key)
+{
+	uint32_t hval, klen;
+	hash_stripe_t *stripe = stripe_for(hash, key, &hval, &klen);
+	void *val;
+
+	switch_thread_rwlock_rdlock(stripe->rwlock);
+	val = hash_get_h(&stripe->table, key, hval, klen);
+	switch_thread_rwlock_unlock(stripe->rwlock);
+
+	return val;
+}
+
+SWITCH_DECLARE(void *) switch_core_striped_hash_find_callback(switch_striped_hash_t *hash, const char *key,
+															  switch_striped_hash_callback_t callback, void *pData)
+{
+	uint32_t hval, klen;
+	hash_stripe_t *stripe = stripe_for(hash, key, &hval, &klen);
+	void *val;
+
+	switch_thread_rwlock_rdlock(stripe->rwlock);
+	if ((val = hash_get_h(&stripe->table, key, hval, klen))) {
+		val = callback(key, val, pData);
+	}
+	switch_thread_rwlock_unlock(stripe->rwlock);
+
+	return val;
+}
+
+SWITCH_DECLARE(void *) switch_core_striped_hash_update(switch_striped_hash_t *hash, const char *key,
+													   switch_striped_hash_callback_t callback, void *pData)
+{
+	uint32_t hval, klen;
+	hash_stripe_t *stripe = stripe_for(hash, key, &hval, &klen);
+	void *val, *new_val;
+
+	switch_thread_rwlock_wrlock(stripe->rwlock);
+	val = hash_get_h(&stripe->table, key, hval, klen);
+	if ((new_val = callback(key, val, pData)) != val) {
+		hash_set_h(&stripe->table, key, hval, klen, new_val);
+	}
+	switch_thread_rwlock_unlock(stripe->rwlock);
+
+	return new_val;
+}
+
+SWITCH_DECLARE(void *) switch_core_striped_hash_walk(switch_striped_hash_t *hash, switch_striped_hash_callback_t callback, void *pData)
+{
+	switch_hash_index_t *hi;
+	void *ret = NULL;
+	uint32_t x;
+
+	for (x = 0; x < hash->count && !ret; x++) {
+		hash_stripe_t *stripe = &hash->stripes[x];
+
+		switch_thread_rwlock_rdlock(stripe->rwlock);
+		for (hi = switch_hash_first(NULL, &stripe->table); hi && !ret; hi = switch_hash_next(hi)) {
+			ret = callback(hi->key, hi->data, pData);
+		}
+		switch_thread_rwlock_unlock(stripe->rwlock);
+	}
+
+	return ret;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_striped_hash_delete_multi(switch_striped_hash_t *hash, switch_hash_delete_callback_t callback, void *pData)
+{
+	switch_status_t status = SWITCH_STATUS_GENERR;
+	switch_hash_index_t *hi;
+	uint32_t x;
+
+	for (x = 0; x < hash->count; x++) {
+		hash_stripe_t *stripe = &hash->stripes[x];
+
+		switch_thread_rwlock_wrlock(stripe->rwlock);
+		/* deleting the current element doesn't disturb the walk */
+		for (hi = switch_hash_first(NULL, &stripe->table); hi; hi = switch_hash_next(hi)) {
+			if (callback(hi->key, hi->data, pData)) {
+				hash_set_h(&stripe->table, hi->key, hi->hval, hi->klen, NULL);
+				status = SWITCH_STATUS_SUCCESS;
+			}
+		}
+		switch_thread_rwlock_unlock(stripe->rwlock);
+	}
+
+	return status;
+}
+
+/*
+ * Interned names: one permanent copy of each header/variable name, shared by every event that uses it, with its
+ * case insensitive hash computed once. Atoms are never freed, so the table is capped and only takes short names;
+ * anything else is left to be copied as before.
+ */
+#define INTERN_MAX_ATOMS 65536
+#define INTERN_MAX_LEN 128
+
+typedef struct {
+	unsigned int ci_hash;
+	char str[1];
+} hash_atom_t;
+
+static struct {
+	switch_striped_hash_t *table;
+	volatile uint32_t count;
+} INTERN;
+
+static void *intern_callback(const char *key, void *val, void *pData)
+{
+	hash_atom_t *atom;
+	switch_size_t len;
+	switch_ssize_t hlen = -1;
+
+	if (val) {
+		return val;
+	}
+
+	if (INTERN.count >= INTERN_MAX_ATOMS) {
+		return NULL;
+	}
+
+	len = strlen(key);
+	atom = malloc(sizeof(*atom) + len);
+	switch_assert(atom);
+	memcpy(atom->str, key, len + 1);
+	atom->ci_hash = switch_ci_hashfunc_default(atom->str, &hlen);
+	INTERN.count++;
+
+	return atom;
+}
+
+void switch_core_intern_init(switch_memory_pool_t *pool)
+{
+	switch_core_striped_hash_init(&INTERN.table, pool, 32, SWITCH_TRUE);
+}
+
+SWITCH_DECLARE(const char *) switch_core_intern(const char *str)
+{
+	hash_atom_t *atom;
+
+	if (!INTERN.table || zstr(str) || strlen(str) > INTERN_MAX_LEN) {
+		return NULL;
+	}
+
+	if (!(atom = switch_core_striped_hash_find(INTERN.table, str))) {
+		atom = switch_core_striped_hash_update(INTERN.table, str, intern_callback, NULL);
+	}
+
+	return atom ? atom->str : NULL;
+}
+
+SWITCH_DECLARE(unsigned int) switch_core_intern_hash(const char *atom)
+{
+	return ((const hash_atom_t *) (atom - offsetof(hash_atom_t, str)))->ci_hash;
+}
+
+SWITCH_DECLARE(uint32_t) switch_core_intern_count(void)
+{
+	return INTERN.count;
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
@@ -35,6 +35,198 @@
 #include <switch.h>
 #include "private/switch_core_pvt.h"
 
+/* count a heap allocation made from the frame paths, see io_allocs */
+static void session_io_alloc(switch_core_session_t *session)
+{
+	session->io_allocs++;
+	switch_metric_inc(session_manager.io_allocs);
+}
+
+/* must hold resample_mutex */
+static switch_status_t session_resampler_activate(switch_core_session_t *session, switch_audio_resampler_t **resampler,
+												  switch_audio_resampler_t **idle, uint32_t from_rate, uint32_t to_rate, uint32_t to_size)
+{
+	if (*idle && (*idle)->from_rate == (int) from_rate && (*idle)->to_rate == (int) to_rate) {
+		*resampler = *idle;
+		*idle = NULL;
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_resample_destroy(idle);
+	session_io_alloc(session);
+
+	return switch_resample_create(resampler, from_rate, to_rate, to_size, SWITCH_RESAMPLE_QUALITY, 1);
+}
+
+/* must hold resample_mutex, keeps the resampler around so a codec flapping between NOOP and RESAMPLE doesn't malloc per frame */
+static void session_resampler_park(switch_audio_resampler_t **resampler, switch_audio_resampler_t **idle)
+{
+	switch_resample_destroy(idle);
+	*idle = *resampler;
+	*resampler = NULL;
+}
+
+/* bugs that only tap native frames do not need the audio decoded for them */
+static switch_bool_t session_bugs_need_pcm(switch_core_session_t *session)
+{
+	switch_media_bug_t *bp;
+	switch_bool_t need = SWITCH_FALSE;
+
+	if (!session->bugs) {
+		return SWITCH_FALSE;
+	}
+
+	switch_thread_rwlock_rdlock(session->bug_rwlock);
+	for (bp = session->bugs; bp; bp = bp->next) {
+		if ((bp->flags & (SMBF_READ_STREAM | SMBF_WRITE_STREAM | SMBF_READ_REPLACE | SMBF_WRITE_REPLACE | SMBF_READ_PING | SMBF_TAP_READ | SMBF_TAP_WRITE))) {
+			need = SWITCH_TRUE;
+			break;
+		}
+	}
+	switch_thread_rwlock_unlock(session->bug_rwlock);
+
+	return need;
+}
+
+/* the frame at the rate a tap bug asked for, converted only by the first bug that wants it in this pass */
+static switch_frame_t *session_tap_frame(switch_core_session_t *session, int dir, switch_frame_t *frame, uint32_t rate)
+{
+	switch_tap_frame_t *tf, *slot = NULL;
+	uint32_t from_rate = frame->rate;
+	int i;
+
+	if (!from_rate && frame->codec && frame->codec->implementation) {
+		from_rate = frame->codec->implementation->actual_samples_per_second;
+	}
+
+	if (!from_rate || from_rate == rate || !frame->datalen) {
+		return frame;
+	}
+
+	for (i = 0; i < SWITCH_TAP_RATES; i++) {
+		tf = &session->tap_frames[dir][i];
+		if (tf->rate == rate) {
+			slot = tf;
+			break;
+		}
+		if (!slot && !tf->rate) {
+			slot = tf;
+		}
+	}
+
+	if (!slot) {
+		return NULL;
+	}
+
+	if (slot->resampler && slot->from_rate == from_rate && slot->gen == session->tap_gen[dir]) {
+		return &slot->frame;
+	}
+
+	switch_mutex_lock(session->resample_mutex);
+	if (slot->resampler && slot->from_rate != from_rate) {
+		switch_resample_destroy(&slot->resampler);
+	}
+
+	if (!slot->resampler) {
+		if (switch_resample_create(&slot->resampler, from_rate, rate, SWITCH_RECOMMENDED_BUFFER_SIZE, SWITCH_RESAMPLE_QUALITY, 1) != SWITCH_STATUS_SUCCESS) {
+			switch_mutex_unlock(session->resample_mutex);
+			return NULL;
+		}
+		slot->from_rate = from_rate;
+		slot->rate = rate;
+	}
+
+	switch_resample_process(slot->resampler, frame->data, frame->datalen / 2);
+	slot->frame = *frame;
+	slot->frame.data = slot->resampler->to;
+	slot->frame.samples = slot->resampler->to_len;
+	slot->frame.datalen = slot->resampler->to_len * 2;
+	slot->frame.buflen = slot->resampler->to_size * 2;
+	slot->frame.rate = rate;
+	slot->gen = session->tap_gen[dir];
+	switch_mutex_unlock(session->resample_mutex);
+
+	return &slot->frame;
+}
+
+/* 
+ * hands a frame to the bugs tapping one direction, encoded for the native taps and decoded for the others.
+ * the decoded taps get the session's own frame with no copy and no lock, they run in the media thread
+ * under the bug read lock so the bug cannot be closed under them.
+ */
+static void session_tap_bugs(switch_core_session_t *session, switch_frame_t *frame, switch_media_bug_flag_t flag)
+{
+	switch_media_bug_t *bp;
+	int prune = 0, dir = flag == SMBF_TAP_WRITE;
+
+	/* every bug asking for the same rate in this pass shares one conversion */
+	if ((flag & (SMBF_TAP_READ | SMBF_TAP_WRITE))) {
+		session->tap_gen[dir]++;
+	}
+
+	switch_thread_rwlock_rdlock(session->bug_rwlock);
+	for (bp = session->bugs; bp; bp = bp->next) {
+		switch_bool_t ok = SWITCH_TRUE;
+
+		if (!bp->ready || !(bp->flags & flag)) {
+			continue;
+		}
+
+		if (switch_channel_test_flag(session->channel, CF_PAUSE_BUGS) && !switch_core_media_bug_test_flag(bp, SMBF_NO_PAUSE)) {
+			continue;
+		}
+
+		if (!switch_channel_test_flag(session->channel, CF_ANSWERED) && switch_core_media_bug_test_flag(bp, SMBF_ANSWER_REQ)) {
+			continue;
+		}
+
+		if (switch_test_flag(bp, SMBF_PRUNE)) {
+			prune++;
+			continue;
+		}
+
+		if (bp->callback) {
+			switch_frame_t *tap_frame = frame;
+
+			if ((flag & (SMBF_TAP_READ | SMBF_TAP_WRITE)) && bp->tap_rate && !(tap_frame = session_tap_frame(session, dir, frame, bp->tap_rate))) {
+				continue;
+			}
+
+			if (flag == SMBF_TAP_READ) {
+				bp->tap_read_frame = tap_frame;
+				ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_TAP_READ);
+				bp->tap_read_frame = NULL;
+			} else if (flag == SMBF_TAP_WRITE) {
+				bp->tap_write_frame = tap_frame;
+				ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_TAP_WRITE);
+				bp->tap_write_frame = NULL;
+			} else if (flag == SMBF_TAP_NATIVE_READ) {
+				switch_mutex_lock(bp->read_mutex);
+				bp->native_read_frame = frame;
+				ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_TAP_NATIVE_READ);
+				bp->native_read_frame = NULL;
+				switch_mutex_unlock(bp->read_mutex);
+			} else {
+				switch_mutex_lock(bp->write_mutex);
+				bp->native_write_frame = frame;
+				ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_TAP_NATIVE_WRITE);
+				bp->native_write_frame = NULL;
+				switch_mutex_unlock(bp->write_mutex);
+			}
+		}
+
+		if ((bp->stop_time && bp->stop_time <= switch_epoch_time_now(NULL)) || ok == SWITCH_FALSE) {
+			switch_set_flag(bp, SMBF_PRUNE);
+			prune++;
+		}
+	}
+	switch_thread_rwlock_unlock(session->bug_rwlock);
+
+	if (prune) {
+		switch_core_media_bug_prune(session);
+	}
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_session_write_video_frame(switch_core_session_t *session, switch_frame_t *frame, switch_io_flag_t flags,
 																	  int stream_id)
 {
@@ -245,6 +437,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 
 	codec_impl = *(*frame)->codec->implementation;
 
+	if (session->bugs && !switch_test_flag(*frame, SFF_CNG)) {
+		session_tap_bugs(session, *frame, SMBF_TAP_NATIVE_READ);
+	}
+
 	if (session->read_codec->implementation->impl_id != codec_impl.impl_id) {
 		need_codec = TRUE;
 	} 
@@ -253,7 +449,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 		do_resample = 1;
 	}
 
-	if (session->bugs && !need_codec) {
+	if (!need_codec && session_bugs_need_pcm(session)) {
 		do_bugs = 1;
 		need_codec = 1;
 	}
@@ -335,6 +531,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 				}
 
 				session->raw_read_frame.timestamp = 0;
+				session->raw_read_frame.ingress = 0;
 				session->raw_read_frame.datalen = read_frame->codec->implementation->decoded_bytes_per_packet;
 				session->raw_read_frame.samples = session->raw_read_frame.datalen / sizeof(int16_t);
 				read_frame = &session->raw_read_frame;
@@ -410,10 +607,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 			case SWITCH_STATUS_RESAMPLE:
 				if (!session->read_resampler) {
 					switch_mutex_lock(session->resample_mutex);
-					status = switch_resample_create(&session->read_resampler,
-													read_frame->codec->implementation->actual_samples_per_second,
-													session->read_impl.actual_samples_per_second,
-													session->read_impl.decoded_bytes_per_packet, SWITCH_RESAMPLE_QUALITY, 1);
+					status = session_resampler_activate(session, &session->read_resampler, &session->read_resampler_idle,
+														read_frame->codec->implementation->actual_samples_per_second,
+														session->read_impl.actual_samples_per_second,
+														session->read_impl.decoded_bytes_per_packet);
 
 					switch_mutex_unlock(session->resample_mutex);
 
@@ -434,6 +631,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 				session->raw_read_frame.ssrc = read_frame->ssrc;
 				session->raw_read_frame.seq = read_frame->seq;
 				session->raw_read_frame.m = read_frame->m;
+				session->raw_read_frame.ingress = read_frame->ingress;
 				session->raw_read_frame.payload = read_frame->payload;
 				session->raw_read_frame.flags = 0;
 				if (switch_test_flag(read_frame, SFF_PLC)) {
@@ -444,7 +642,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 			case SWITCH_STATUS_NOOP:
 				if (session->read_resampler) {
 					switch_mutex_lock(session->resample_mutex);
-					switch_resample_destroy(&session->read_resampler);
+					session_resampler_park(&session->read_resampler, &session->read_resampler_idle);
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_NOTICE, "Deactivating read resampler\n");
 					switch_mutex_unlock(session->resample_mutex);
 				}
@@ -460,6 +658,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 				session->raw_read_frame.ssrc = read_frame->ssrc;
 				session->raw_read_frame.seq = read_frame->seq;
 				session->raw_read_frame.m = read_frame->m;
+				session->raw_read_frame.ingress = read_frame->ingress;
 				session->raw_read_frame.payload = read_frame->payload;
 				session->raw_read_frame.flags = 0;
 				if (switch_test_flag(read_frame, SFF_PLC)) {
@@ -505,6 +704,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 						bp->read_replace_frame_out = read_frame;
 						bp->read_demux_frame = NULL;
 						if ((ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_READ_REPLACE)) == SWITCH_TRUE) {
+							if (bp->read_replace_frame_out != read_frame) {
+								bp->read_replace_frame_out->ingress = read_frame->ingress;
+							}
 							read_frame = bp->read_replace_frame_out;
 						}
 					}
@@ -523,6 +725,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 			}
 		}
 
+		if (session->bugs) {
+			session_tap_bugs(session, read_frame, SMBF_TAP_READ);
+		}
+
 		if (session->bugs) {
 			switch_media_bug_t *bp;
 			switch_bool_t ok = SWITCH_TRUE;
@@ -543,22 +749,23 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 				}
 
 				if (ok && bp->ready && switch_test_flag(bp, SMBF_READ_STREAM)) {
-					switch_mutex_lock(bp->read_mutex);
+					/* we are the only producer on this ring so the write needs no lock, the mutex only serializes the callback */
 					if (bp->read_demux_frame) {
 						uint8_t data[SWITCH_RECOMMENDED_BUFFER_SIZE];
 						int bytes = read_frame->datalen / 2;
 
 						memcpy(data, read_frame->data, read_frame->datalen);
 						switch_unmerge_sln((int16_t *)data, bytes, bp->read_demux_frame->data, bytes);
-						switch_buffer_write(bp->raw_read_buffer, data, read_frame->datalen);
+						switch_ringbuffer_write(bp->raw_read_buffer, data, read_frame->datalen);
 					} else {
-						switch_buffer_write(bp->raw_read_buffer, read_frame->data, read_frame->datalen);
+						switch_ringbuffer_write(bp->raw_read_buffer, read_frame->data, read_frame->datalen);
 					}
 
 					if (bp->callback) {
+						switch_mutex_lock(bp->read_mutex);
 						ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_READ);
+						switch_mutex_unlock(bp->read_mutex);
 					}
-					switch_mutex_unlock(bp->read_mutex);
 				}
 
 				if ((bp->stop_time && bp->stop_time <= switch_epoch_time_now(NULL)) || ok == SWITCH_FALSE) {
@@ -596,6 +803,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Engaging Read Buffer at %u bytes vs %u\n",
 									  (uint32_t) bytes, (uint32_t) (*frame)->datalen);
 					switch_buffer_create_dynamic(&session->raw_read_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, 0);
+					session_io_alloc(session);
 				}
 
 				if (!switch_buffer_write(session->raw_read_buffer, read_frame->data, read_frame->datalen)) {
@@ -644,6 +852,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 						session->enc_read_frame.ssrc = read_frame->ssrc;
 						session->enc_read_frame.seq = read_frame->seq;
 						session->enc_read_frame.m = read_frame->m;
+						session->enc_read_frame.ingress = read_frame->ingress;
 						session->enc_read_frame.payload = session->read_impl.ianacode;
 					}
 					*frame = &session->enc_read_frame;
@@ -653,6 +862,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 					session->raw_read_frame.timestamp = read_frame->timestamp;
 					session->raw_read_frame.payload = enc_frame->codec->implementation->ianacode;
 					session->raw_read_frame.m = read_frame->m;
+					session->raw_read_frame.ingress = read_frame->ingress;
 					session->raw_read_frame.ssrc = read_frame->ssrc;
 					session->raw_read_frame.seq = read_frame->seq;
 					*frame = enc_frame;
@@ -739,14 +949,76 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(switch_core_sessi
 	return status;
 }
 
+#define LATENCY_BUCKETS 500
+
+/* time from the network to the endpoint write for a frame that knows where it came in, in 1ms buckets with the last one open ended */
+static void session_latency_sample(switch_core_session_t *session, switch_frame_t *frame)
+{
+	switch_time_t delta = switch_micro_time_now() - frame->ingress;
+	uint32_t ms;
+
+	if (delta < 0) {
+		return;
+	}
+
+	if (!session->latency_hist) {
+		session->latency_hist = switch_core_session_alloc(session, sizeof(uint32_t) * LATENCY_BUCKETS);
+	}
+
+	if ((ms = (uint32_t) (delta / 1000)) >= LATENCY_BUCKETS) {
+		ms = LATENCY_BUCKETS - 1;
+	}
+
+	session->latency_hist[ms]++;
+	session->latency_count++;
+
+	if (delta > session->latency_max) {
+		session->latency_max = delta;
+	}
+}
+
+static uint32_t latency_percentile(switch_core_session_t *session, uint32_t pct)
+{
+	uint32_t want = (uint32_t) (((uint64_t) session->latency_count * pct + 99) / 100), seen = 0, i;
+
+	for (i = 0; i < LATENCY_BUCKETS; i++) {
+		if ((seen += session->latency_hist[i]) >= want) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+void switch_core_session_latency_report(switch_core_session_t *session)
+{
+	if (!session->latency_count) {
+		return;
+	}
+
+	switch_channel_set_variable_printf(session->channel, "media_latency_samples", "%u", session->latency_count);
+	switch_channel_set_variable_printf(session->channel, "media_latency_p50_ms", "%u", latency_percentile(session, 50));
+	switch_channel_set_variable_printf(session->channel, "media_latency_p95_ms", "%u", latency_percentile(session, 95));
+	switch_channel_set_variable_printf(session->channel, "media_latency_p99_ms", "%u", latency_percentile(session, 99));
+	switch_channel_set_variable_printf(session->channel, "media_latency_max_ms", "%u", (uint32_t) (session->latency_max / 1000));
+}
+
 static switch_status_t perform_write(switch_core_session_t *session, switch_frame_t *frame, switch_io_flag_t flags, int stream_id)
 {
 	switch_io_event_hook_write_frame_t *ptr;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 
+	if (session->bugs && !(frame->flags & (SFF_CNG | SFF_NOT_AUDIO))) {
+		session_tap_bugs(session, frame, SMBF_TAP_NATIVE_WRITE);
+	}
+
 	if (session->endpoint_interface->io_routines->write_frame) {
 
 		if ((status = session->endpoint_interface->io_routines->write_frame(session, frame, flags, stream_id)) == SWITCH_STATUS_SUCCESS) {
+			if (frame->ingress && !(frame->flags & (SFF_CNG | SFF_NOT_AUDIO)) && switch_test_flag((&runtime), SCF_MEDIA_LATENCY_PROBE)) {
+				session_latency_sample(session, frame);
+			}
+
 			for (ptr = session->event_hooks.write_frame; ptr; ptr = ptr->next) {
 				if ((status = ptr->write_frame(session, frame, flags, stream_id)) != SWITCH_STATUS_SUCCESS) {
 					break;
@@ -847,7 +1119,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 		need_codec = TRUE;
 	}
 
-	if (session->bugs && !need_codec) {
+	if (!need_codec && session_bugs_need_pcm(session)) {
 		do_bugs = TRUE;
 		need_codec = TRUE;
 	}
@@ -918,10 +1190,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 			write_frame->rate = frame->codec->implementation->actual_samples_per_second;
 			if (!session->write_resampler) {
 				switch_mutex_lock(session->resample_mutex);
-				status = switch_resample_create(&session->write_resampler,
-												frame->codec->implementation->actual_samples_per_second,
-												session->write_impl.actual_samples_per_second,
-												session->write_impl.decoded_bytes_per_packet, SWITCH_RESAMPLE_QUALITY, 1);
+				status = session_resampler_activate(session, &session->write_resampler, &session->write_resampler_idle,
+													frame->codec->implementation->actual_samples_per_second,
+													session->write_impl.actual_samples_per_second,
+													session->write_impl.decoded_bytes_per_packet);
 
 
 				switch_mutex_unlock(session->resample_mutex);
@@ -935,6 +1207,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 			session->raw_write_frame.timestamp = frame->timestamp;
 			session->raw_write_frame.rate = frame->rate;
 			session->raw_write_frame.m = frame->m;
+			session->raw_write_frame.ingress = frame->ingress;
 			session->raw_write_frame.ssrc = frame->ssrc;
 			session->raw_write_frame.seq = frame->seq;
 			session->raw_write_frame.payload = frame->payload;
@@ -951,7 +1224,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 		case SWITCH_STATUS_NOOP:
 			if (session->write_resampler) {
 				switch_mutex_lock(session->resample_mutex);
-				switch_resample_destroy(&session->write_resampler);
+				session_resampler_park(&session->write_resampler, &session->write_resampler_idle);
 				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_NOTICE, "Deactivating write resampler\n");
 				switch_mutex_unlock(session->resample_mutex);
 			}
@@ -1001,6 +1274,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 
 
 
+	if (session->bugs) {
+		session_tap_bugs(session, write_frame, SMBF_TAP_WRITE);
+	}
+
 	if (session->bugs) {
 		switch_media_bug_t *bp;
 		int prune = 0;
@@ -1026,9 +1303,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 			}
 
 			if (switch_test_flag(bp, SMBF_WRITE_STREAM)) {
-				switch_mutex_lock(bp->write_mutex);
-				switch_buffer_write(bp->raw_write_buffer, write_frame->data, write_frame->datalen);
-				switch_mutex_unlock(bp->write_mutex);
+				switch_ringbuffer_write(bp->raw_write_buffer, write_frame->data, write_frame->datalen);
 				
 				if (bp->callback) {
 					ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_WRITE);
@@ -1041,6 +1316,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 					bp->write_replace_frame_in = write_frame;
 					bp->write_replace_frame_out = write_frame;
 					if ((ok = bp->callback(bp, bp->user_data, SWITCH_ABC_TYPE_WRITE_REPLACE)) == SWITCH_TRUE) {
+						if (bp->write_replace_frame_out != write_frame) {
+							bp->write_replace_frame_out->ingress = write_frame->ingress;
+						}
 						write_frame = bp->write_replace_frame_out;
 					}
 				}
@@ -1110,6 +1388,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 				}
 				session->enc_write_frame.payload = session->write_impl.ianacode;
 				session->enc_write_frame.m = frame->m;
+				session->enc_write_frame.ingress = frame->ingress;
 				session->enc_write_frame.ssrc = frame->ssrc;
 				session->enc_write_frame.seq = frame->seq;
 				session->enc_write_frame.flags = 0;
@@ -1154,6 +1433,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Write Buffer Failed!\n");
 					goto error;
 				}
+				session_io_alloc(session);
 
 				/* Need to retrain the recording data */
 				switch_core_media_bug_flush_all(session);
@@ -1204,16 +1484,17 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 					session->enc_write_frame.codec = session->write_codec;
 					session->enc_write_frame.samples = enc_frame->datalen / sizeof(int16_t);
 					session->enc_write_frame.m = frame->m;
+					session->enc_write_frame.ingress = frame->ingress;
 					session->enc_write_frame.ssrc = frame->ssrc;
 					session->enc_write_frame.payload = session->write_impl.ianacode;
 					write_frame = &session->enc_write_frame;
 					if (!session->write_resampler) {
 						switch_mutex_lock(session->resample_mutex);
 						if (!session->write_resampler) {
-							status = switch_resample_create(&session->write_resampler,
-															frame->codec->implementation->actual_samples_per_second,
-															session->write_impl.actual_samples_per_second,
-															session->write_impl.decoded_bytes_per_packet, SWITCH_RESAMPLE_QUALITY, 1);
+							status = session_resampler_activate(session, &session->write_resampler, &session->write_resampler_idle,
+																frame->codec->implementation->actual_samples_per_second,
+																session->write_impl.actual_samples_per_second,
+																session->write_impl.decoded_bytes_per_packet);
 						}
 						switch_mutex_unlock(session->resample_mutex);
 
@@ -1228,6 +1509,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 					session->enc_write_frame.codec = session->write_codec;
 					session->enc_write_frame.samples = enc_frame->datalen / sizeof(int16_t);
 					session->enc_write_frame.m = frame->m;
+					session->enc_write_frame.ingress = frame->ingress;
 					session->enc_write_frame.ssrc = frame->ssrc;
 					session->enc_write_frame.payload = session->write_impl.ianacode;
 					session->enc_write_frame.flags = 0;
@@ -1237,7 +1519,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_frame(switch_core_sess
 					if (session->write_resampler) {
 						switch_mutex_lock(session->resample_mutex);
 						if (session->write_resampler) {
-							switch_resample_destroy(&session->write_resampler);
+							session_resampler_park(&session->write_resampler, &session->write_resampler_idle);
 							switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_NOTICE, "Deactivating write resampler\n");
 						}
 						switch_mutex_unlock(session->resample_mutex);
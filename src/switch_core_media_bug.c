@@ -40,11 +40,11 @@ static void switch_core_media_bug_destroy(switch_media_bug_t *bug)
 	switch_event_t *event = NULL;
 
 	if (bug->raw_read_buffer) {
-		switch_buffer_destroy(&bug->raw_read_buffer);
+		switch_ringbuffer_destroy(&bug->raw_read_buffer);
 	}
 
 	if (bug->raw_write_buffer) {
-		switch_buffer_destroy(&bug->raw_write_buffer);
+		switch_ringbuffer_destroy(&bug->raw_write_buffer);
 	}
 
 	if (switch_event_create(&event, SWITCH_EVENT_MEDIA_BUG_STOP) == SWITCH_STATUS_SUCCESS) {
@@ -108,6 +108,31 @@ SWITCH_DECLARE(void) switch_core_media_bug_set_read_replace_frame(switch_media_b
 	bug->read_replace_frame_out = frame;
 }
 
+SWITCH_DECLARE(switch_frame_t *) switch_core_media_bug_get_native_read_frame(switch_media_bug_t *bug)
+{
+	return bug->native_read_frame;
+}
+
+SWITCH_DECLARE(switch_frame_t *) switch_core_media_bug_get_native_write_frame(switch_media_bug_t *bug)
+{
+	return bug->native_write_frame;
+}
+
+SWITCH_DECLARE(void) switch_core_media_bug_set_tap_rate(switch_media_bug_t *bug, uint32_t rate)
+{
+	bug->tap_rate = rate;
+}
+
+SWITCH_DECLARE(const switch_frame_t *) switch_core_media_bug_get_tap_read_frame(switch_media_bug_t *bug)
+{
+	return bug->tap_read_frame;
+}
+
+SWITCH_DECLARE(const switch_frame_t *) switch_core_media_bug_get_tap_write_frame(switch_media_bug_t *bug)
+{
+	return bug->tap_write_frame;
+}
+
 SWITCH_DECLARE(void) switch_core_media_bug_set_read_demux_frame(switch_media_bug_t *bug, switch_frame_t *frame)
 {
 	bug->read_demux_frame = frame;
@@ -125,13 +150,13 @@ SWITCH_DECLARE(void) switch_core_media_bug_flush(switch_media_bug_t *bug)
 
 	if (bug->raw_read_buffer) {
 		switch_mutex_lock(bug->read_mutex);
-		switch_buffer_zero(bug->raw_read_buffer);
+		switch_ringbuffer_zero(bug->raw_read_buffer);
 		switch_mutex_unlock(bug->read_mutex);
 	}
 
 	if (bug->raw_write_buffer) {
 		switch_mutex_lock(bug->write_mutex);
-		switch_buffer_zero(bug->raw_write_buffer);
+		switch_ringbuffer_zero(bug->raw_write_buffer);
 		switch_mutex_unlock(bug->write_mutex);
 	}
 
@@ -142,17 +167,13 @@ SWITCH_DECLARE(void) switch_core_media_bug_flush(switch_media_bug_t *bug)
 SWITCH_DECLARE(void) switch_core_media_bug_inuse(switch_media_bug_t *bug, switch_size_t *readp, switch_size_t *writep)
 {
 	if (switch_test_flag(bug, SMBF_READ_STREAM)) {
-		switch_mutex_lock(bug->read_mutex);
-		*readp = bug->raw_read_buffer ? switch_buffer_inuse(bug->raw_read_buffer) : 0;
-		switch_mutex_unlock(bug->read_mutex);
+		*readp = bug->raw_read_buffer ? switch_ringbuffer_inuse(bug->raw_read_buffer) : 0;
 	} else {
 		*readp = 0;
 	}
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_mutex_lock(bug->write_mutex);
-		*writep = bug->raw_write_buffer ? switch_buffer_inuse(bug->raw_write_buffer) : 0;
-		switch_mutex_unlock(bug->write_mutex);
+		*writep = bug->raw_write_buffer ? switch_ringbuffer_inuse(bug->raw_write_buffer) : 0;
 	} else {
 		*writep = 0;
 	}
@@ -211,15 +232,11 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	frame->datalen = 0;
 
 	if (switch_test_flag(bug, SMBF_READ_STREAM)) {
-		switch_mutex_lock(bug->read_mutex);
-		do_read = switch_buffer_inuse(bug->raw_read_buffer);
-		switch_mutex_unlock(bug->read_mutex);
+		do_read = switch_ringbuffer_inuse(bug->raw_read_buffer);
 	}
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_mutex_lock(bug->write_mutex);
-		do_write = switch_buffer_inuse(bug->raw_write_buffer);
-		switch_mutex_unlock(bug->write_mutex);
+		do_write = switch_ringbuffer_inuse(bug->raw_write_buffer);
 	}
 
 	if (bug->record_frame_size && bug->record_pre_buffer_max && (do_read || do_write) && bug->record_pre_buffer_count < bug->record_pre_buffer_max) {
@@ -282,7 +299,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	
 	if (do_read) {
 		switch_mutex_lock(bug->read_mutex);
-		frame->datalen = (uint32_t) switch_buffer_read(bug->raw_read_buffer, frame->data, do_read);
+		frame->datalen = (uint32_t) switch_ringbuffer_read(bug->raw_read_buffer, frame->data, do_read);
 		if (frame->datalen != do_read) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(switch_core_media_bug_get_session(bug)), SWITCH_LOG_ERROR, "Framing Error Reading!\n");
 			switch_core_media_bug_flush(bug);
@@ -298,7 +315,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 	if (do_write) {
 		switch_assert(bug->raw_write_buffer);
 		switch_mutex_lock(bug->write_mutex);
-		datalen = (uint32_t) switch_buffer_read(bug->raw_write_buffer, bug->data, do_write);
+		datalen = (uint32_t) switch_ringbuffer_read(bug->raw_write_buffer, bug->data, do_write);
 		if (datalen != do_write) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(switch_core_media_bug_get_session(bug)), SWITCH_LOG_ERROR, "Framing Error Writing!\n");
 			switch_core_media_bug_flush(bug);
@@ -390,6 +407,18 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_read(switch_media_bug_t *b
 }
 
 #define MAX_BUG_BUFFER 1024 * 512
+#define BUG_RING_FRAMES 256
+
+static switch_size_t bug_ring_size(uint32_t bytes)
+{
+	switch_size_t size = (switch_size_t) bytes * BUG_RING_FRAMES;
+
+	if (!size || size > MAX_BUG_BUFFER) {
+		size = MAX_BUG_BUFFER;
+	}
+
+	return size;
+}
 SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t *session,
 														  const char *function,
 														  const char *target,
@@ -474,14 +503,23 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t
 	}
 
 	if (switch_test_flag(bug, SMBF_READ_STREAM) || switch_test_flag(bug, SMBF_READ_PING)) {
-		switch_buffer_create_dynamic(&bug->raw_read_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
+		switch_ringbuffer_create(&bug->raw_read_buffer, bug_ring_size(bytes));
 		switch_mutex_init(&bug->read_mutex, SWITCH_MUTEX_NESTED, session->pool);
 	}
 
 	bytes = bug->write_impl.decoded_bytes_per_packet;
 
 	if (switch_test_flag(bug, SMBF_WRITE_STREAM)) {
-		switch_buffer_create_dynamic(&bug->raw_write_buffer, bytes * SWITCH_BUFFER_BLOCK_FRAMES, bytes * SWITCH_BUFFER_START_FRAMES, MAX_BUG_BUFFER);
+		switch_ringbuffer_create(&bug->raw_write_buffer, bug_ring_size(bytes));
+		switch_mutex_init(&bug->write_mutex, SWITCH_MUTEX_NESTED, session->pool);
+	}
+
+	/* native taps only need their callback serialized */
+	if (switch_test_flag(bug, SMBF_TAP_NATIVE_READ) && !bug->read_mutex) {
+		switch_mutex_init(&bug->read_mutex, SWITCH_MUTEX_NESTED, session->pool);
+	}
+
+	if (switch_test_flag(bug, SMBF_TAP_NATIVE_WRITE) && !bug->write_mutex) {
 		switch_mutex_init(&bug->write_mutex, SWITCH_MUTEX_NESTED, session->pool);
 	}
 
@@ -608,7 +646,7 @@ SWITCH_DECLARE(uint32_t) switch_core_media_bug_count(switch_core_session_t *orig
 	if (orig_session->bugs) {
 		switch_thread_rwlock_rdlock(orig_session->bug_rwlock);
 		for (bp = orig_session->bugs; bp; bp = bp->next) {
-			if (!switch_test_flag(bp, SMBF_PRUNE) && !switch_test_flag(bp, SMBF_LOCK) && !strcmp(bp->function, function)) {
+			if (!switch_test_flag(bp, SMBF_PRUNE) && !switch_test_flag(bp, SMBF_LOCK) && (!function || !strcmp(bp->function, function))) {
 				x++;
 			}
 		}
@@ -54,8 +54,174 @@ static struct {
 	switch_queue_t *pool_recycle_queue;
 	switch_memory_pool_t *memory_pool;
 	int pool_thread_running;
+	switch_mutex_t *slab_mutex;
+	switch_slab_t *slabs;
+	switch_mutex_t *acct_mutex;
+	switch_hash_t *acct_hash;
 } memory_manager;
 
+/*
+ * With pool-accounting on, every allocation through the switch_core_* pool helpers is charged to the tag the pool
+ * was created with (file:line of the switch_core_new_memory_pool() call), and given back when the pool is cleared or
+ * destroyed. Only what goes through those helpers is seen, not direct apr_* calls.
+ */
+typedef struct {
+	char *tag;
+	switch_size_t current;
+	switch_size_t high;
+	uint64_t total;
+	uint32_t pools;
+	uint32_t pools_high;
+} pool_tag_stats_t;
+
+typedef struct {
+	pool_tag_stats_t *stats;
+	switch_size_t bytes;
+} pool_acct_t;
+
+#define POOL_ACCT_KEY "__pool_acct"
+
+static apr_status_t pool_acct_cleanup(void *data)
+{
+	pool_acct_t *acct = (pool_acct_t *) data;
+
+	switch_mutex_lock(memory_manager.acct_mutex);
+	acct->stats->current -= acct->bytes;
+	acct->stats->pools--;
+	switch_mutex_unlock(memory_manager.acct_mutex);
+
+	return APR_SUCCESS;
+}
+
+static void pool_account_bytes(switch_memory_pool_t *pool, switch_size_t bytes)
+{
+	pool_acct_t *acct = NULL;
+	pool_tag_stats_t *stats;
+	const char *tag;
+
+	/* the pool's userdata table isn't thread safe, so the lookup happens under the lock as well */
+	switch_mutex_lock(memory_manager.acct_mutex);
+
+	apr_pool_userdata_get((void **) &acct, POOL_ACCT_KEY, pool);
+
+	if (!acct) {
+		if (!(tag = apr_pool_tag(pool, NULL))) {
+			switch_mutex_unlock(memory_manager.acct_mutex);
+			return;
+		}
+
+		if (!(stats = switch_core_hash_find(memory_manager.acct_hash, tag))) {
+			switch_zmalloc(stats, sizeof(*stats));
+			stats->tag = strdup(tag);
+			switch_core_hash_insert(memory_manager.acct_hash, tag, stats);
+		}
+		if (++stats->pools > stats->pools_high) {
+			stats->pools_high = stats->pools;
+		}
+
+		acct = apr_palloc(pool, sizeof(*acct));
+		acct->stats = stats;
+		acct->bytes = 0;
+		apr_pool_userdata_setn(acct, POOL_ACCT_KEY, pool_acct_cleanup, pool);
+	}
+
+	acct->bytes += bytes;
+	stats = acct->stats;
+	stats->current += bytes;
+	stats->total += bytes;
+	if (stats->current > stats->high) {
+		stats->high = stats->current;
+	}
+
+	switch_mutex_unlock(memory_manager.acct_mutex);
+}
+
+#define pool_account(_pool, _bytes) if (runtime.pool_accounting) pool_account_bytes(_pool, _bytes)
+
+static int pool_stats_cmp(const void *a, const void *b)
+{
+	const pool_tag_stats_t *sa = *(const pool_tag_stats_t **) a;
+	const pool_tag_stats_t *sb = *(const pool_tag_stats_t **) b;
+
+	if (sa->current != sb->current) {
+		return sa->current > sb->current ? -1 : 1;
+	}
+
+	return sa->high > sb->high ? -1 : sa->high < sb->high;
+}
+
+SWITCH_DECLARE(void) switch_core_memory_pool_stats(switch_stream_handle_t *stream, int top)
+{
+	switch_hash_index_t *hi;
+	pool_tag_stats_t **list = NULL;
+	int count = 0, x;
+
+	if (!runtime.pool_accounting) {
+		stream->write_function(stream, "-ERR pool accounting is off\n");
+		return;
+	}
+
+	switch_mutex_lock(memory_manager.acct_mutex);
+
+	for (hi = switch_hash_first(NULL, memory_manager.acct_hash); hi; hi = switch_hash_next(hi)) {
+		count++;
+	}
+
+	if (count) {
+		switch_zmalloc(list, sizeof(*list) * count);
+
+		for (x = 0, hi = switch_hash_first(NULL, memory_manager.acct_hash); hi; hi = switch_hash_next(hi)) {
+			void *val;
+
+			switch_hash_this(hi, NULL, NULL, &val);
+			list[x++] = (pool_tag_stats_t *) val;
+		}
+
+		qsort(list, count, sizeof(*list), pool_stats_cmp);
+	}
+
+	stream->write_function(stream, "%12s %12s %14s %6s %6s  %s\n", "current", "high", "total", "pools", "peak", "tag");
+
+	for (x = 0; x < count && (top <= 0 || x < top); x++) {
+		stream->write_function(stream, "%12" SWITCH_SIZE_T_FMT " %12" SWITCH_SIZE_T_FMT " %14" SWITCH_UINT64_T_FMT " %6u %6u  %s\n",
+							   list[x]->current, list[x]->high, list[x]->total, list[x]->pools, list[x]->pools_high, list[x]->tag);
+	}
+
+	switch_mutex_unlock(memory_manager.acct_mutex);
+
+	switch_safe_free(list);
+}
+
+/*
+ * Slab caches keep freed fixed size objects around for the next allocation instead of handing them back to malloc.
+ * Each cache is split into shards picked by thread id, so a thread allocating and freeing frames mostly reuses its
+ * own magazine without fighting other threads over a lock. Every object is a plain malloc() of the cache's size,
+ * anything freed into a cache may have been malloc'd by someone else and vice versa.
+ */
+#define SLAB_SHARDS 16
+#define SLAB_DEPTH 128
+
+typedef struct {
+	switch_mutex_t *mutex;
+	void **items;
+	uint32_t count;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t frees;
+	uint64_t spills;
+	/* keep neighbouring shards off each other's cache line */
+	char pad[64];
+} slab_shard_t;
+
+struct switch_slab {
+	char *name;
+	switch_size_t size;
+	uint32_t depth;
+	int closed;
+	slab_shard_t shards[SLAB_SHARDS];
+	struct switch_slab *next;
+};
+
 SWITCH_DECLARE(switch_memory_pool_t *) switch_core_session_get_pool(switch_core_session_t *session)
 {
 	switch_assert(session != NULL);
@@ -86,6 +252,7 @@ SWITCH_DECLARE(void *) switch_core_perform_session_alloc(switch_core_session_t *
 
 	ptr = apr_palloc(session->pool, memory);
 	switch_assert(ptr != NULL);
+	pool_account(session->pool, memory);
 
 	memset(ptr, 0, memory);
 
@@ -118,6 +285,7 @@ SWITCH_DECLARE(void *) switch_core_perform_permanent_alloc(switch_size_t memory,
 #endif
 
 	ptr = apr_palloc(memory_manager.memory_pool, memory);
+	pool_account(memory_manager.memory_pool, memory);
 
 	switch_assert(ptr != NULL);
 	memset(ptr, 0, memory);
@@ -153,6 +321,7 @@ SWITCH_DECLARE(char *) switch_core_perform_permanent_strdup(const char *todup, c
 	len = strlen(todup) + 1;
 	duped = apr_pstrmemdup(memory_manager.memory_pool, todup, len);
 	switch_assert(duped != NULL);
+	pool_account(memory_manager.memory_pool, len);
 
 #ifdef DEBUG_ALLOC
 	switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_CONSOLE, "Perm Allocate %s %d\n", 
@@ -199,6 +368,7 @@ SWITCH_DECLARE(char *) switch_core_vsprintf(switch_memory_pool_t *pool, const ch
 
 	result = apr_pvsprintf(pool, fmt, ap);
 	switch_assert(result != NULL);
+	pool_account(pool, strlen(result) + 1);
 
 #ifdef LOCK_MORE
 #ifdef USE_MEM_LOCK
@@ -254,6 +424,7 @@ SWITCH_DECLARE(char *) switch_core_perform_session_strdup(switch_core_session_t
 
 	duped = apr_pstrdup(session->pool, todup);
 	switch_assert(duped != NULL);
+	pool_account(session->pool, strlen(duped) + 1);
 
 #ifdef LOCK_MORE
 #ifdef USE_MEM_LOCK
@@ -293,6 +464,7 @@ SWITCH_DECLARE(char *) switch_core_perform_strdup(switch_memory_pool_t *pool, co
 
 	duped = apr_pstrmemdup(pool, todup, len);
 	switch_assert(duped != NULL);
+	pool_account(pool, len);
 
 #ifdef LOCK_MORE
 #ifdef USE_MEM_LOCK
@@ -326,7 +498,11 @@ SWITCH_DECLARE(void) switch_pool_clear(switch_memory_pool_t *p)
 {
 #ifdef PER_POOL_LOCK
 	apr_thread_mutex_t *my_mutex;
+	apr_allocator_t *my_allocator = apr_pool_allocator_get(p);
+
+	/* the mutex lives in the pool itself, so it goes away with the clear */
 	apr_pool_mutex_set(p, NULL);
+	apr_allocator_mutex_set(my_allocator, NULL);
 #endif
 
 	apr_pool_clear(p);
@@ -337,12 +513,36 @@ SWITCH_DECLARE(void) switch_pool_clear(switch_memory_pool_t *p)
 		abort();
 	}
 
+	apr_allocator_mutex_set(my_allocator, my_mutex);
 	apr_pool_mutex_set(p, my_mutex);
 
 #endif
 
 }
 
+/* 
+   With pool-recycle-max set, pools handed back to the pool thread are cleared and parked instead of destroyed,
+   keeping up to pool-recycle-max-free bytes of blocks each, so the next session gets a pool whose allocator
+   does not have to go to malloc for its first allocations.
+*/
+static int pool_recycle(switch_memory_pool_t *pool)
+{
+#ifdef PER_POOL_LOCK
+	if (!runtime.pool_recycle_max || (uint32_t) switch_queue_size(memory_manager.pool_recycle_queue) >= runtime.pool_recycle_max) {
+		return 0;
+	}
+
+	apr_allocator_max_free_set(apr_pool_allocator_get(pool), runtime.pool_recycle_max_free);
+	switch_pool_clear(pool);
+	/* the old tag was allocated from the pool */
+	apr_pool_tag(pool, "recycled");
+
+	return switch_queue_trypush(memory_manager.pool_recycle_queue, pool) == SWITCH_STATUS_SUCCESS;
+#else
+	return 0;
+#endif
+}
+
 
 
 SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(switch_memory_pool_t **pool, const char *file, const char *func, int line)
@@ -356,16 +556,19 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(switch_memor
 #ifdef PER_POOL_LOCK
 	apr_allocator_t *my_allocator = NULL;
 	apr_thread_mutex_t *my_mutex;
-#else
-	void *pop = NULL;
 #endif
+	void *pop = NULL;
 
 #ifdef USE_MEM_LOCK
 	switch_mutex_lock(memory_manager.mem_lock);
 #endif
 	switch_assert(pool != NULL);
 
-#ifndef PER_POOL_LOCK
+#ifdef PER_POOL_LOCK
+	if (runtime.pool_recycle_max && switch_queue_trypop(memory_manager.pool_recycle_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		*pool = (switch_memory_pool_t *) pop;
+	} else {
+#else
 	if (switch_queue_trypop(memory_manager.pool_recycle_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
 		*pool = (switch_memory_pool_t *) pop;
 	} else {
@@ -388,6 +591,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(switch_memor
 		apr_allocator_owner_set(my_allocator, *pool);
 
 		apr_pool_mutex_set(*pool, my_mutex);
+	}
 
 #else
 		apr_pool_create(pool, NULL);
@@ -396,7 +600,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_new_memory_pool(switch_memor
 #endif
 #endif
 
-	tmp = switch_core_sprintf(*pool, "%s:%d", file, line);
+	/* straight from apr so accounting won't look at a tag left over from before a recycle */
+	tmp = apr_psprintf(*pool, "%s:%d", file, line);
 	apr_pool_tag(*pool, tmp);
 
 #ifdef DEBUG_ALLOC2
@@ -466,6 +671,7 @@ SWITCH_DECLARE(void *) switch_core_perform_alloc(switch_memory_pool_t *pool, swi
 	ptr = apr_palloc(pool, memory);
 	switch_assert(ptr != NULL);
 	memset(ptr, 0, memory);
+	pool_account(pool, memory);
 
 #ifdef LOCK_MORE
 #ifdef USE_MEM_LOCK
@@ -478,7 +684,7 @@ SWITCH_DECLARE(void *) switch_core_perform_alloc(switch_memory_pool_t *pool, swi
 
 SWITCH_DECLARE(void) switch_core_memory_reclaim(void)
 {
-#if !defined(PER_POOL_LOCK) && !defined(INSTANTLY_DESTROY_POOLS)
+#if !defined(INSTANTLY_DESTROY_POOLS)
 	switch_memory_pool_t *pool;
 	void *pop = NULL;
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Returning %d recycled memory pool(s)\n",
@@ -522,13 +728,15 @@ static void *SWITCH_THREAD_FUNC pool_thread(switch_thread_t *thread, void *obj)
 					break;
 				}
 #if defined(PER_POOL_LOCK) || defined(DESTROY_POOLS)
+				if (!pool_recycle(pop)) {
 #ifdef USE_MEM_LOCK
-				switch_mutex_lock(memory_manager.mem_lock);
+					switch_mutex_lock(memory_manager.mem_lock);
 #endif
-				apr_pool_destroy(pop);
+					apr_pool_destroy(pop);
 #ifdef USE_MEM_LOCK
-				switch_mutex_unlock(memory_manager.mem_lock);
+					switch_mutex_unlock(memory_manager.mem_lock);
 #endif
+				}
 #else
 				apr_pool_mutex_set(pop, NULL);
 				apr_pool_clear(pop);
@@ -583,6 +791,231 @@ static void *SWITCH_THREAD_FUNC pool_thread(switch_thread_t *thread, void *obj)
 static switch_thread_t *pool_thread_p = NULL;
 #endif
 
+static int slab_shard(void)
+{
+	uint64_t id = (uint64_t) (uintptr_t) switch_thread_self();
+
+	/* thread ids tend to be aligned pointers, mix them before taking the top bits */
+	id *= 0x9E3779B97F4A7C15ULL;
+
+	return (int) (id >> 60) % SLAB_SHARDS;
+}
+
+SWITCH_DECLARE(switch_slab_t *) switch_slab_create(const char *name, switch_size_t size, uint32_t depth)
+{
+	switch_slab_t *slab;
+	int x;
+
+	switch_assert(memory_manager.memory_pool != NULL);
+
+	if (!depth) {
+		depth = SLAB_DEPTH;
+	}
+
+	switch_mutex_lock(memory_manager.slab_mutex);
+	slab = apr_pcalloc(memory_manager.memory_pool, sizeof(*slab));
+	slab->name = apr_pstrdup(memory_manager.memory_pool, name);
+	slab->size = size;
+	slab->depth = depth;
+
+	for (x = 0; x < SLAB_SHARDS; x++) {
+		switch_mutex_init(&slab->shards[x].mutex, SWITCH_MUTEX_NESTED, memory_manager.memory_pool);
+		slab->shards[x].items = apr_palloc(memory_manager.memory_pool, sizeof(void *) * depth);
+	}
+
+	slab->next = memory_manager.slabs;
+	memory_manager.slabs = slab;
+	switch_mutex_unlock(memory_manager.slab_mutex);
+
+	return slab;
+}
+
+SWITCH_DECLARE(void *) switch_slab_alloc(switch_slab_t *slab)
+{
+	slab_shard_t *shard;
+	void *ptr = NULL;
+
+	if (!slab || slab->closed) {
+		return slab ? malloc(slab->size) : NULL;
+	}
+
+	shard = &slab->shards[slab_shard()];
+
+	switch_mutex_lock(shard->mutex);
+	if (shard->count) {
+		ptr = shard->items[--shard->count];
+		shard->hits++;
+	} else {
+		shard->misses++;
+	}
+	switch_mutex_unlock(shard->mutex);
+
+	if (!ptr) {
+		ptr = malloc(slab->size);
+	}
+
+	return ptr;
+}
+
+SWITCH_DECLARE(void) switch_slab_free(switch_slab_t *slab, void *ptr)
+{
+	slab_shard_t *shard;
+
+	if (!ptr) {
+		return;
+	}
+
+	if (!slab || slab->closed) {
+		free(ptr);
+		return;
+	}
+
+	shard = &slab->shards[slab_shard()];
+
+	switch_mutex_lock(shard->mutex);
+	shard->frees++;
+	if (shard->count < slab->depth) {
+		shard->items[shard->count++] = ptr;
+		ptr = NULL;
+	} else {
+		shard->spills++;
+	}
+	switch_mutex_unlock(shard->mutex);
+
+	/* magazine is full, let malloc have it */
+	switch_safe_free(ptr);
+}
+
+SWITCH_DECLARE(void) switch_slab_stats(switch_stream_handle_t *stream)
+{
+	switch_slab_t *slab;
+	int x;
+
+	stream->write_function(stream, "%-24s %6s %8s %12s %12s %12s\n", "name", "size", "cached", "hits", "misses", "spills");
+
+	switch_mutex_lock(memory_manager.slab_mutex);
+	for (slab = memory_manager.slabs; slab; slab = slab->next) {
+		uint64_t hits = 0, misses = 0, spills = 0;
+		uint32_t cached = 0;
+
+		for (x = 0; x < SLAB_SHARDS; x++) {
+			switch_mutex_lock(slab->shards[x].mutex);
+			cached += slab->shards[x].count;
+			hits += slab->shards[x].hits;
+			misses += slab->shards[x].misses;
+			spills += slab->shards[x].spills;
+			switch_mutex_unlock(slab->shards[x].mutex);
+		}
+
+		stream->write_function(stream, "%-24s %6u %8u %12" SWITCH_UINT64_T_FMT " %12" SWITCH_UINT64_T_FMT " %12" SWITCH_UINT64_T_FMT "\n",
+							   slab->name, (unsigned) slab->size, cached, hits, misses, spills);
+	}
+	switch_mutex_unlock(memory_manager.slab_mutex);
+}
+
+void switch_core_memory_metrics(switch_stream_handle_t *stream, void *user_data)
+{
+	switch_slab_t *slab;
+	char labels[128];
+	int x, pass;
+	static const char *families[][2] = {
+		{ "freeswitch_slab_hits_total", "Allocations served from a slab cache" },
+		{ "freeswitch_slab_misses_total", "Allocations that fell through to malloc" },
+		{ "freeswitch_slab_spills_total", "Frees that found the magazine full" },
+		{ "freeswitch_slab_cached", "Objects sitting in a slab cache" }
+	};
+
+	switch_mutex_lock(memory_manager.slab_mutex);
+	for (pass = 0; pass < 4; pass++) {
+		switch_metric_write_family(stream, families[pass][0], families[pass][1], pass == 3 ? SWITCH_METRIC_GAUGE : SWITCH_METRIC_COUNTER);
+
+		for (slab = memory_manager.slabs; slab; slab = slab->next) {
+			int64_t value = 0;
+
+			for (x = 0; x < SLAB_SHARDS; x++) {
+				switch (pass) {
+				case 0:
+					value += (int64_t) slab->shards[x].hits;
+					break;
+				case 1:
+					value += (int64_t) slab->shards[x].misses;
+					break;
+				case 2:
+					value += (int64_t) slab->shards[x].spills;
+					break;
+				default:
+					value += slab->shards[x].count;
+					break;
+				}
+			}
+
+			switch_snprintf(labels, sizeof(labels), "slab=\"%s\"", slab->name);
+			switch_metric_write_value(stream, families[pass][0], labels, value);
+		}
+	}
+	switch_mutex_unlock(memory_manager.slab_mutex);
+
+	switch_metric_write_family(stream, "freeswitch_pools_recycled", "Cleared memory pools waiting to be reused", SWITCH_METRIC_GAUGE);
+	switch_metric_write_value(stream, "freeswitch_pools_recycled", NULL, switch_queue_size(memory_manager.pool_recycle_queue));
+}
+
+void switch_core_memory_prewarm(uint32_t count)
+{
+#if defined(PER_POOL_LOCK) && !defined(INSTANTLY_DESTROY_POOLS)
+	uint32_t x, parked = 0;
+	switch_memory_pool_t **pools;
+
+	if (!runtime.pool_recycle_max) {
+		return;
+	}
+
+	if (count > runtime.pool_recycle_max) {
+		count = runtime.pool_recycle_max;
+	}
+
+	/* create them all before parking any or switch_core_new_memory_pool() would just hand us back the last one */
+	switch_zmalloc(pools, sizeof(*pools) * count);
+
+	for (x = 0; x < count; x++) {
+		switch_core_new_memory_pool(&pools[x]);
+		/* make the allocator hold on to some blocks before it's parked */
+		apr_palloc(pools[x], runtime.pool_recycle_max_free / 2);
+	}
+
+	for (x = 0; x < count; x++) {
+		if (!pool_recycle(pools[x])) {
+			apr_pool_destroy(pools[x]);
+		} else {
+			parked++;
+		}
+	}
+
+	free(pools);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Pre-warmed %u memory pool(s)\n", parked);
+#endif
+}
+
+static void slab_close_all(void)
+{
+	switch_slab_t *slab;
+	int x;
+
+	switch_mutex_lock(memory_manager.slab_mutex);
+	for (slab = memory_manager.slabs; slab; slab = slab->next) {
+		for (x = 0; x < SLAB_SHARDS; x++) {
+			switch_mutex_lock(slab->shards[x].mutex);
+			while (slab->shards[x].count) {
+				free(slab->shards[x].items[--slab->shards[x].count]);
+			}
+			switch_mutex_unlock(slab->shards[x].mutex);
+		}
+		/* anything still in flight goes straight back to malloc from now on */
+		slab->closed = 1;
+	}
+	switch_mutex_unlock(memory_manager.slab_mutex);
+}
+
 void switch_core_memory_stop(void)
 {
 #ifndef INSTANTLY_DESTROY_POOLS
@@ -593,6 +1026,8 @@ void switch_core_memory_stop(void)
 	memory_manager.pool_thread_running = 0;
 	switch_thread_join(&st, pool_thread_p);
 #endif
+
+	slab_close_all();
 }
 
 switch_memory_pool_t *switch_core_memory_init(void)
@@ -635,6 +1070,10 @@ switch_memory_pool_t *switch_core_memory_init(void)
 	switch_mutex_init(&memory_manager.mem_lock, SWITCH_MUTEX_NESTED, memory_manager.memory_pool);
 #endif
 
+	switch_mutex_init(&memory_manager.slab_mutex, SWITCH_MUTEX_NESTED, memory_manager.memory_pool);
+	switch_mutex_init(&memory_manager.acct_mutex, SWITCH_MUTEX_NESTED, memory_manager.memory_pool);
+	switch_core_hash_init(&memory_manager.acct_hash, NULL);
+
 #ifdef INSTANTLY_DESTROY_POOLS
 	{
 		void *foo;
@@ -35,6 +35,15 @@
 #include <switch.h>
 #include "private/switch_core_pvt.h"
 
+/* how long a freed port rests before it is handed out again, late packets for the old call die off meanwhile */
+#define PORT_QUARANTINE_USEC 2000000
+
+/*
+ * track[] holds 1 for a port in use, -1 for one in quarantine and 0 for a free one.
+ * Free ports sit in free_list in no particular order and a request takes a random entry, moving the last one
+ * into its place, so it never scans.  Freed ports go on the quarantine ring in the order they were freed and
+ * go back to the free list once their time is up, or earlier when nothing else is left.
+ */
 struct switch_core_port_allocator {
 	switch_port_t start;
 	switch_port_t end;
@@ -42,6 +51,12 @@ struct switch_core_port_allocator {
 	int8_t *track;
 	uint32_t track_len;
 	uint32_t track_used;
+	uint32_t *free_list;
+	uint32_t free_count;
+	uint32_t *quarantine;
+	switch_time_t *quarantine_until;
+	uint32_t quarantine_head;
+	uint32_t quarantine_count;
 	switch_port_flag_t flags;
 	switch_mutex_t *mutex;
 	switch_memory_pool_t *pool;
@@ -97,12 +112,21 @@ SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_new(switch_port_t sta
 	}
 
 	alloc->track = switch_core_alloc(pool, (alloc->track_len + 2) * sizeof(switch_byte_t));
+	alloc->free_list = switch_core_alloc(pool, alloc->track_len * sizeof(uint32_t));
+	alloc->quarantine = switch_core_alloc(pool, alloc->track_len * sizeof(uint32_t));
+	alloc->quarantine_until = switch_core_alloc(pool, alloc->track_len * sizeof(switch_time_t));
+
+	for (alloc->free_count = 0; alloc->free_count < alloc->track_len; alloc->free_count++) {
+		alloc->free_list[alloc->free_count] = alloc->free_count;
+	}
 
 	alloc->start = start;
 	alloc->next = start;
 	alloc->end = end;
 
 
+	srand((unsigned) ((unsigned) (intptr_t) alloc + (unsigned) (intptr_t) switch_thread_self() + switch_micro_time_now()));
+
 	switch_mutex_init(&alloc->mutex, SWITCH_MUTEX_NESTED, pool);
 	alloc->pool = pool;
 	*new_allocator = alloc;
@@ -110,6 +134,27 @@ SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_new(switch_port_t sta
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* must hold alloc->mutex */
+static void release_quarantine(switch_core_port_allocator_t *alloc, switch_bool_t force)
+{
+	switch_time_t now = switch_micro_time_now();
+
+	while (alloc->quarantine_count && (force || alloc->quarantine_until[alloc->quarantine_head] <= now)) {
+		uint32_t index = alloc->quarantine[alloc->quarantine_head];
+
+		if (++alloc->quarantine_head >= alloc->track_len) {
+			alloc->quarantine_head = 0;
+		}
+		alloc->quarantine_count--;
+
+		alloc->track[index] = 0;
+		alloc->free_list[alloc->free_count++] = index;
+
+		/* only take what is needed when nothing else is free */
+		force = SWITCH_FALSE;
+	}
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_request_port(switch_core_port_allocator_t *alloc, switch_port_t *port_ptr)
 {
 	switch_port_t port = 0;
@@ -118,44 +163,29 @@ SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_request_port(switch_c
 	int odd = switch_test_flag(alloc, SPF_ODD);
 
 	switch_mutex_lock(alloc->mutex);
-	srand((unsigned) ((unsigned) (intptr_t) port_ptr + (unsigned) (intptr_t) switch_thread_self() + switch_micro_time_now()));
 
-	while (alloc->track_used < alloc->track_len) {
-		uint32_t index;
-		uint32_t tries = 0;
+	if (alloc->quarantine_count) {
+		release_quarantine(alloc, alloc->free_count ? SWITCH_FALSE : SWITCH_TRUE);
+	}
 
+	if (alloc->free_count) {
 		/* randomly pick a port */
-		index = rand() % alloc->track_len;
+		uint32_t pos = rand() % alloc->free_count;
+		uint32_t index = alloc->free_list[pos];
 
-		/* if it is used walk up the list to find a free one */
-		while (alloc->track[index] && tries < alloc->track_len) {
-			tries++;
-			if (alloc->track[index] < 0) {
-				alloc->track[index]++;
-			}
-			if (++index >= alloc->track_len) {
-				index = 0;
-			}
-		}
-
-		if (tries < alloc->track_len) {
-			alloc->track[index] = 1;
-			alloc->track_used++;
-			status = SWITCH_STATUS_SUCCESS;
+		alloc->free_list[pos] = alloc->free_list[--alloc->free_count];
+		alloc->track[index] = 1;
+		alloc->track_used++;
+		status = SWITCH_STATUS_SUCCESS;
 
-			if ((even && odd)) {
-				port = (switch_port_t) (index + alloc->start);
-			} else {
-				port = (switch_port_t) (index + (alloc->start / 2));
-				port *= 2;
-			}
-			goto end;
+		if ((even && odd)) {
+			port = (switch_port_t) (index + alloc->start);
+		} else {
+			port = (switch_port_t) (index + (alloc->start / 2));
+			port *= 2;
 		}
 	}
 
-
-  end:
-
 	switch_mutex_unlock(alloc->mutex);
 
 	if (status == SWITCH_STATUS_SUCCESS) {
@@ -180,9 +210,22 @@ SWITCH_DECLARE(switch_status_t) switch_core_port_allocator_free_port(switch_core
 		index /= 2;
 	}
 
+	if (index < 0 || (uint32_t) index >= alloc->track_len) {
+		return status;
+	}
+
 	switch_mutex_lock(alloc->mutex);
 	if (alloc->track[index] > 0) {
-		alloc->track[index] = -4;
+		uint32_t tail = alloc->quarantine_head + alloc->quarantine_count;
+
+		if (tail >= alloc->track_len) {
+			tail -= alloc->track_len;
+		}
+
+		alloc->track[index] = -1;
+		alloc->quarantine[tail] = index;
+		alloc->quarantine_until[tail] = switch_micro_time_now() + PORT_QUARANTINE_USEC;
+		alloc->quarantine_count++;
 		alloc->track_used--;
 		status = SWITCH_STATUS_SUCCESS;
 	}
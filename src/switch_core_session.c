@@ -105,6 +105,60 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_set_codec_slin(switch_core_s
 }
 
 
+typedef struct {
+	const char *file;
+	const char *func;
+	int line;
+} session_locate_t;
+
+/* runs with the session's stripe of the session table read locked so the session can't be destroyed under us */
+static void *session_locate_callback(const char *key, void *val, void *pData)
+{
+	switch_core_session_t *session = (switch_core_session_t *) val;
+#ifdef SWITCH_DEBUG_RWLOCKS
+	session_locate_t *where = (session_locate_t *) pData;
+
+	if (switch_core_session_perform_read_lock(session, where->file, where->func, where->line) != SWITCH_STATUS_SUCCESS) {
+#if EMACS_CC_MODE_IS_BUGGY
+	}
+#endif
+#else
+	if (switch_core_session_read_lock(session) != SWITCH_STATUS_SUCCESS) {
+#endif
+		/* not available, forget it */
+		return NULL;
+	}
+
+	return session;
+}
+
+static void *session_force_locate_callback(const char *key, void *val, void *pData)
+{
+	switch_core_session_t *session = (switch_core_session_t *) val;
+	switch_status_t status;
+#ifdef SWITCH_DEBUG_RWLOCKS
+	session_locate_t *where = (session_locate_t *) pData;
+#endif
+
+	/* Acquire a read lock on the session */
+	if (switch_test_flag(session, SSF_DESTROYED)) {
+		status = SWITCH_STATUS_FALSE;
+#ifdef SWITCH_DEBUG_RWLOCKS
+		switch_log_printf(SWITCH_CHANNEL_ID_LOG, where->file, where->func, where->line, key, SWITCH_LOG_ERROR, "%s %s Read lock FAIL\n",
+						  switch_core_session_get_uuid(session), switch_channel_get_name(session->channel));
+#endif
+	} else {
+		status = (switch_status_t) switch_thread_rwlock_tryrdlock(session->rwlock);
+#ifdef SWITCH_DEBUG_RWLOCKS
+		switch_log_printf(SWITCH_CHANNEL_ID_LOG, where->file, where->func, where->line, key, SWITCH_LOG_ERROR, "%s %s Read lock ACQUIRED\n",
+						  switch_core_session_get_uuid(session), switch_channel_get_name(session->channel));
+#endif
+	}
+
+	/* not available, forget it */
+	return status == SWITCH_STATUS_SUCCESS ? session : NULL;
+}
+
 #ifdef SWITCH_DEBUG_RWLOCKS
 SWITCH_DECLARE(switch_core_session_t *) switch_core_session_perform_locate(const char *uuid_str, const char *file, const char *func, int line)
 #else
@@ -112,24 +166,16 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_locate(const char *u
 #endif
 {
 	switch_core_session_t *session = NULL;
+	session_locate_t where = { 0 };
 
-	if (uuid_str) {
-		switch_mutex_lock(runtime.session_hash_mutex);
-		if ((session = switch_core_hash_find(session_manager.session_table, uuid_str))) {
-			/* Acquire a read lock on the session */
 #ifdef SWITCH_DEBUG_RWLOCKS
-			if (switch_core_session_perform_read_lock(session, file, func, line) != SWITCH_STATUS_SUCCESS) {
-#if EMACS_CC_MODE_IS_BUGGY
-			}
-#endif
-#else
-			if (switch_core_session_read_lock(session) != SWITCH_STATUS_SUCCESS) {
+	where.file = file;
+	where.func = func;
+	where.line = line;
 #endif
-				/* not available, forget it */
-				session = NULL;
-			}
-		}
-		switch_mutex_unlock(runtime.session_hash_mutex);
+
+	if (uuid_str) {
+		session = switch_core_striped_hash_find_callback(session_manager.session_table, uuid_str, session_locate_callback, &where);
 	}
 
 	/* if its not NULL, now it's up to you to rwunlock this */
@@ -146,33 +192,16 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_force_locate(const c
 #endif
 {
 	switch_core_session_t *session = NULL;
-	switch_status_t status;
-
-	if (uuid_str) {
-		switch_mutex_lock(runtime.session_hash_mutex);
-		if ((session = switch_core_hash_find(session_manager.session_table, uuid_str))) {
-			/* Acquire a read lock on the session */
+	session_locate_t where = { 0 };
 
-			if (switch_test_flag(session, SSF_DESTROYED)) {
-				status = SWITCH_STATUS_FALSE;
-#ifdef SWITCH_DEBUG_RWLOCKS
-				switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, uuid_str, SWITCH_LOG_ERROR, "%s %s Read lock FAIL\n",
-								  switch_core_session_get_uuid(session), switch_channel_get_name(session->channel));
-#endif
-			} else {
-				status = (switch_status_t) switch_thread_rwlock_tryrdlock(session->rwlock);
 #ifdef SWITCH_DEBUG_RWLOCKS
-				switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, uuid_str, SWITCH_LOG_ERROR, "%s %s Read lock ACQUIRED\n",
-								  switch_core_session_get_uuid(session), switch_channel_get_name(session->channel));
+	where.file = file;
+	where.func = func;
+	where.line = line;
 #endif
-			}
 
-			if (status != SWITCH_STATUS_SUCCESS) {
-				/* not available, forget it */
-				session = NULL;
-			}
-		}
-		switch_mutex_unlock(runtime.session_hash_mutex);
+	if (uuid_str) {
+		session = switch_core_striped_hash_find_callback(session_manager.session_table, uuid_str, session_force_locate_callback, &where);
 	}
 
 	/* if its not NULL, now it's up to you to rwunlock this */
@@ -200,144 +229,411 @@ struct str_node {
 	struct str_node *next;
 };
 
-SWITCH_DECLARE(void) switch_core_session_hupall_matching_var(const char *var_name, const char *var_val, switch_call_cause_t cause)
-{
-	switch_hash_index_t *hi;
-	void *val;
-	switch_core_session_t *session;
+typedef struct {
 	switch_memory_pool_t *pool;
-	struct str_node *head = NULL, *np;
+	const switch_endpoint_interface_t *endpoint_interface;
+	struct str_node *head;
+} session_collect_t;
 
-	switch_core_new_memory_pool(&pool);
+static void *session_collect_callback(const char *key, void *val, void *pData)
+{
+	session_collect_t *collect = (session_collect_t *) pData;
+	switch_core_session_t *session = (switch_core_session_t *) val;
+	struct str_node *np;
 
-	if (!var_val)
+	if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
+		if (!collect->endpoint_interface || session->endpoint_interface == collect->endpoint_interface) {
+			np = switch_core_alloc(collect->pool, sizeof(*np));
+			np->str = switch_core_strdup(collect->pool, session->uuid_str);
+			np->next = collect->head;
+			collect->head = np;
+		}
+		switch_core_session_rwunlock(session);
+	}
+
+	return NULL;
+}
+
+/* Opt-in index of channel variables: "name=value" -> set of uuids, for the names listed in indexed-channel-variables */
+typedef struct {
+	switch_hash_t *uuids;
+	uint32_t count;
+} var_index_set_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *names;
+	switch_hash_t *values;
+	int count;
+} var_index;
+
+static char *var_index_key(const char *name, const char *value)
+{
+	return switch_mprintf("%s=%s", name, value);
+}
+
+SWITCH_DECLARE(void) switch_core_session_index_variable(const char *var_name)
+{
+	char *name;
+
+	if (zstr(var_name)) {
 		return;
+	}
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	for (hi = switch_hash_first(NULL, session_manager.session_table); hi; hi = switch_hash_next(hi)) {
-		switch_hash_this(hi, NULL, NULL, &val);
-		if (val) {
-			session = (switch_core_session_t *) val;
-			if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-				np = switch_core_alloc(pool, sizeof(*np));
-				np->str = switch_core_strdup(pool, session->uuid_str);
-				np->next = head;
-				head = np;
-				switch_core_session_rwunlock(session);
+	switch_mutex_lock(var_index.mutex);
+	if (!switch_core_hash_find(var_index.names, var_name)) {
+		/* sessions that already have it set are not back filled */
+		name = switch_core_strdup(session_manager.memory_pool, var_name);
+		switch_core_hash_insert(var_index.names, name, name);
+		var_index.count++;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Indexing channel variable %s\n", name);
+	}
+	switch_mutex_unlock(var_index.mutex);
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_core_session_variable_indexed(const char *var_name)
+{
+	switch_bool_t r = SWITCH_FALSE;
+
+	if (!var_index.count || zstr(var_name)) {
+		return SWITCH_FALSE;
+	}
+
+	switch_mutex_lock(var_index.mutex);
+	r = switch_core_hash_find(var_index.names, var_name) ? SWITCH_TRUE : SWITCH_FALSE;
+	switch_mutex_unlock(var_index.mutex);
+
+	return r;
+}
+
+SWITCH_DECLARE(void) switch_core_session_variable_index_update(const char *uuid, const char *var_name, const char *old_val, const char *new_val)
+{
+	const char *name;
+	var_index_set_t *set;
+	char *key;
+
+	if (!var_index.count || zstr(uuid) || zstr(var_name)) {
+		return;
+	}
+
+	if (old_val && new_val && !strcmp(old_val, new_val)) {
+		return;
+	}
+
+	switch_mutex_lock(var_index.mutex);
+
+	if (!(name = switch_core_hash_find(var_index.names, var_name))) {
+		goto end;
+	}
+
+	if (!zstr(old_val)) {
+		key = var_index_key(name, old_val);
+		if ((set = switch_core_hash_find(var_index.values, key)) && switch_core_hash_find(set->uuids, uuid)) {
+			switch_core_hash_delete(set->uuids, uuid);
+			if (--set->count == 0) {
+				switch_core_hash_delete(var_index.values, key);
+				switch_core_hash_destroy(&set->uuids);
+				free(set);
 			}
 		}
+		switch_safe_free(key);
 	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
 
-	for(np = head; np; np = np->next) {
-		if ((session = switch_core_session_locate(np->str))) {
-			const char *this_val;
-			if (switch_channel_up_nosig(session->channel) &&
-				(this_val = switch_channel_get_variable(session->channel, var_name)) && (!strcmp(this_val, var_val))) {			
-				switch_channel_hangup(session->channel, cause);
-			}
-			switch_core_session_rwunlock(session);
+	if (!zstr(new_val)) {
+		key = var_index_key(name, new_val);
+		if (!(set = switch_core_hash_find(var_index.values, key))) {
+			switch_zmalloc(set, sizeof(*set));
+			switch_core_hash_init(&set->uuids, NULL);
+			switch_core_hash_insert(var_index.values, key, set);
 		}
+		if (!switch_core_hash_find(set->uuids, uuid)) {
+			switch_core_hash_insert(set->uuids, uuid, set);
+			set->count++;
+		}
+		switch_safe_free(key);
 	}
 
-	switch_core_destroy_memory_pool(&pool);
+  end:
 
+	switch_mutex_unlock(var_index.mutex);
 }
 
-SWITCH_DECLARE(void) switch_core_session_hupall_endpoint(const switch_endpoint_interface_t *endpoint_interface, switch_call_cause_t cause)
+SWITCH_DECLARE(switch_status_t) switch_core_session_find_by_variable(const char *var_name, const char *var_val, switch_console_callback_match_t **matches)
 {
+	const char *name;
+	var_index_set_t *set;
 	switch_hash_index_t *hi;
-	void *val;
+	char *key;
+
+	switch_assert(matches);
+	*matches = NULL;
+
+	if (!var_index.count || zstr(var_name) || !var_val) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(var_index.mutex);
+
+	if (!(name = switch_core_hash_find(var_index.names, var_name))) {
+		switch_mutex_unlock(var_index.mutex);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	key = var_index_key(name, var_val);
+	if ((set = switch_core_hash_find(var_index.values, key))) {
+		for (hi = switch_hash_first(NULL, set->uuids); hi; hi = switch_hash_next(hi)) {
+			const void *uuid;
+			void *val;
+			switch_hash_this(hi, &uuid, NULL, &val);
+			switch_console_push_match(matches, (const char *) uuid);
+		}
+	}
+	switch_safe_free(key);
+
+	switch_mutex_unlock(var_index.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define BULK_MAX_WORKERS 16
+#define BULK_SESSIONS_PER_WORKER 64
+
+typedef struct {
+	char **uuids;
+	uint32_t total;
+	uint32_t next;
+	uint32_t done;
+	uint32_t matched;
+	switch_mutex_t *mutex;
+	switch_core_session_bulk_callback_t callback;
+	void *user_data;
+} session_bulk_t;
+
+static void *SWITCH_THREAD_FUNC session_bulk_thread(switch_thread_t *thread, void *obj)
+{
+	session_bulk_t *bulk = (session_bulk_t *) obj;
 	switch_core_session_t *session;
-	switch_memory_pool_t *pool;
-    struct str_node *head = NULL, *np;
-	
-	switch_core_new_memory_pool(&pool);
-	
-	switch_mutex_lock(runtime.session_hash_mutex);
-	for (hi = switch_hash_first(NULL, session_manager.session_table); hi; hi = switch_hash_next(hi)) {
-		switch_hash_this(hi, NULL, NULL, &val);
-		if (val) {
-			session = (switch_core_session_t *) val;
-			if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-				if (session->endpoint_interface == endpoint_interface) {
-					np = switch_core_alloc(pool, sizeof(*np));
-                    np->str = switch_core_strdup(pool, session->uuid_str);
-                    np->next = head;
-					head = np;
-				}
-				switch_core_session_rwunlock(session);
+	uint32_t idx;
+	int matched;
+
+	for (;;) {
+		switch_mutex_lock(bulk->mutex);
+		idx = bulk->next++;
+		switch_mutex_unlock(bulk->mutex);
+
+		if (idx >= bulk->total) {
+			break;
+		}
+
+		matched = 0;
+
+		if ((session = switch_core_session_locate(bulk->uuids[idx]))) {
+			matched = bulk->callback(session, bulk->user_data) == SWITCH_STATUS_SUCCESS;
+			switch_core_session_rwunlock(session);
+		}
+
+		switch_mutex_lock(bulk->mutex);
+		bulk->done++;
+		bulk->matched += matched;
+		switch_mutex_unlock(bulk->mutex);
+	}
+
+	return NULL;
+}
+
+static uint32_t session_bulk_run(switch_memory_pool_t *pool, struct str_node *head,
+								 switch_core_session_bulk_callback_t callback, void *user_data,
+								 switch_core_session_bulk_progress_t progress, void *progress_data)
+{
+	session_bulk_t bulk = { 0 };
+	switch_thread_t *threads[BULK_MAX_WORKERS] = { 0 };
+	switch_threadattr_t *thd_attr = NULL;
+	switch_time_t last_report = 0;
+	struct str_node *np;
+	uint32_t workers = 0, i, done = 0;
+
+	for (np = head; np; np = np->next) {
+		bulk.total++;
+	}
+
+	if (!bulk.total) {
+		return 0;
+	}
+
+	bulk.uuids = switch_core_alloc(pool, sizeof(char *) * bulk.total);
+	for (i = 0, np = head; np; np = np->next) {
+		bulk.uuids[i++] = np->str;
+	}
+	bulk.callback = callback;
+	bulk.user_data = user_data;
+	switch_mutex_init(&bulk.mutex, SWITCH_MUTEX_NESTED, pool);
+
+	workers = bulk.total / BULK_SESSIONS_PER_WORKER + 1;
+	if (workers > switch_core_cpu_count() * 2) {
+		workers = switch_core_cpu_count() * 2;
+	}
+	if (workers > BULK_MAX_WORKERS) {
+		workers = BULK_MAX_WORKERS;
+	}
+
+	if (workers > 1) {
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		for (i = 0; i < workers; i++) {
+			if (switch_thread_create(&threads[i], thd_attr, session_bulk_thread, &bulk, pool) != SWITCH_STATUS_SUCCESS) {
+				threads[i] = NULL;
+				break;
 			}
 		}
+		workers = i;
 	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
 
-	for(np = head; np; np = np->next) {
-		if ((session = switch_core_session_locate(np->str))) {
-			switch_channel_hangup(session->channel, cause);
-			switch_core_session_rwunlock(session);
+	if (workers < 2) {
+		/* not worth the threads, or not enough of them could be started */
+		session_bulk_thread(NULL, &bulk);
+		if (threads[0]) {
+			switch_status_t st;
+			switch_thread_join(&st, threads[0]);
+		}
+	} else {
+		while (done < bulk.total) {
+			switch_yield(100000);
+
+			switch_mutex_lock(bulk.mutex);
+			done = bulk.done;
+			switch_mutex_unlock(bulk.mutex);
+
+			if (progress && done < bulk.total) {
+				progress(done, bulk.total, progress_data);
+			} else if (!progress && switch_epoch_time_now(NULL) > last_report) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Bulk session operation %u/%u done\n", done, bulk.total);
+				last_report = switch_epoch_time_now(NULL);
+			}
+		}
+
+		for (i = 0; i < workers; i++) {
+			switch_status_t st;
+			switch_thread_join(&st, threads[i]);
 		}
 	}
 
-	switch_core_destroy_memory_pool(&pool);
+	if (progress) {
+		progress(bulk.total, bulk.total, progress_data);
+	}
 
+	return bulk.matched;
 }
 
-SWITCH_DECLARE(void) switch_core_session_hupall(switch_call_cause_t cause)
+SWITCH_DECLARE(uint32_t) switch_core_session_bulk_exec(const switch_endpoint_interface_t *endpoint_interface,
+													   switch_core_session_bulk_callback_t callback, void *user_data,
+													   switch_core_session_bulk_progress_t progress, void *progress_data)
 {
-	switch_hash_index_t *hi;
-	void *val;
-	switch_core_session_t *session;
 	switch_memory_pool_t *pool;
-	struct str_node *head = NULL, *np;
+	session_collect_t collect = { 0 };
+	uint32_t matched;
+
+	switch_assert(callback);
 
 	switch_core_new_memory_pool(&pool);
 
+	/* Only the uuids are taken under the session table locks, the work happens without them */
+	collect.pool = pool;
+	collect.endpoint_interface = endpoint_interface;
+	switch_core_striped_hash_walk(session_manager.session_table, session_collect_callback, &collect);
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	for (hi = switch_hash_first(NULL, session_manager.session_table); hi; hi = switch_hash_next(hi)) {
-		switch_hash_this(hi, NULL, NULL, &val);
-		if (val) {
-			session = (switch_core_session_t *) val;
-			if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-				np = switch_core_alloc(pool, sizeof(*np));
-				np->str = switch_core_strdup(pool, session->uuid_str);
-				np->next = head;
-				head = np;
-				switch_core_session_rwunlock(session);
-			}
+	matched = session_bulk_run(pool, collect.head, callback, user_data, progress, progress_data);
+
+	switch_core_destroy_memory_pool(&pool);
+
+	return matched;
+}
+
+typedef struct {
+	const char *var_name;
+	const char *var_val;
+	switch_call_cause_t cause;
+} hupall_helper_t;
+
+static switch_status_t hupall_callback(switch_core_session_t *session, void *user_data)
+{
+	hupall_helper_t *helper = (hupall_helper_t *) user_data;
+	const char *this_val;
+
+	if (helper->var_name) {
+		if (!switch_channel_up_nosig(session->channel) ||
+			!(this_val = switch_channel_get_variable(session->channel, helper->var_name)) || strcmp(this_val, helper->var_val)) {
+			return SWITCH_STATUS_FALSE;
 		}
 	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
 
-	for(np = head; np; np = np->next) { 
-		if ((session = switch_core_session_locate(np->str))) {
-			switch_channel_hangup(session->channel, cause);
-			switch_core_session_rwunlock(session);
+	switch_channel_hangup(session->channel, helper->cause);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_core_session_hupall_matching_var(const char *var_name, const char *var_val, switch_call_cause_t cause)
+{
+	hupall_helper_t helper = { 0 };
+
+	switch_console_callback_match_t *matches = NULL;
+
+	if (!var_val)
+		return;
+
+	helper.var_name = var_name;
+	helper.var_val = var_val;
+	helper.cause = cause;
+
+	if (switch_core_session_find_by_variable(var_name, var_val, &matches) == SWITCH_STATUS_SUCCESS) {
+		switch_memory_pool_t *pool;
+		switch_console_callback_match_node_t *m;
+		struct str_node *head = NULL, *np;
+
+		switch_core_new_memory_pool(&pool);
+		for (m = matches ? matches->head : NULL; m; m = m->next) {
+			np = switch_core_alloc(pool, sizeof(*np));
+			np->str = switch_core_strdup(pool, m->val);
+			np->next = head;
+			head = np;
 		}
+		switch_console_free_matches(&matches);
+
+		session_bulk_run(pool, head, hupall_callback, &helper, NULL, NULL);
+		switch_core_destroy_memory_pool(&pool);
+		return;
 	}
 
-	switch_core_destroy_memory_pool(&pool);
+	switch_core_session_bulk_exec(NULL, hupall_callback, &helper, NULL, NULL);
+}
+
+SWITCH_DECLARE(void) switch_core_session_hupall_endpoint(const switch_endpoint_interface_t *endpoint_interface, switch_call_cause_t cause)
+{
+	hupall_helper_t helper = { 0 };
 
+	helper.cause = cause;
+	switch_core_session_bulk_exec(endpoint_interface, hupall_callback, &helper, NULL, NULL);
 }
 
+SWITCH_DECLARE(void) switch_core_session_hupall(switch_call_cause_t cause)
+{
+	hupall_helper_t helper = { 0 };
+
+	helper.cause = cause;
+	switch_core_session_bulk_exec(NULL, hupall_callback, &helper, NULL, NULL);
+}
 
 SWITCH_DECLARE(switch_status_t) switch_core_session_message_send(const char *uuid_str, switch_core_session_message_t *message)
 {
 	switch_core_session_t *session = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	if ((session = switch_core_hash_find(session_manager.session_table, uuid_str)) != 0) {
-		/* Acquire a read lock on the session or forget it the channel is dead */
-		if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-			if (switch_channel_up_nosig(session->channel)) {
-				status = switch_core_session_receive_message(session, message);
-			}
-			switch_core_session_rwunlock(session);
+	/* Acquire a read lock on the session or forget it the channel is dead */
+	if ((session = switch_core_session_locate(uuid_str))) {
+		if (switch_channel_up_nosig(session->channel)) {
+			status = switch_core_session_receive_message(session, message);
 		}
+		switch_core_session_rwunlock(session);
 	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
 
 	return status;
 }
@@ -347,17 +643,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_event_send(const char *uuid_
 	switch_core_session_t *session = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	if ((session = switch_core_hash_find(session_manager.session_table, uuid_str)) != 0) {
-		/* Acquire a read lock on the session or forget it the channel is dead */
-		if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-			if (switch_channel_up_nosig(session->channel)) {
-				status = switch_core_session_queue_event(session, event);
-			}
-			switch_core_session_rwunlock(session);
+	/* Acquire a read lock on the session or forget it the channel is dead */
+	if ((session = switch_core_session_locate(uuid_str))) {
+		if (switch_channel_up_nosig(session->channel)) {
+			status = switch_core_session_queue_event(session, event);
 		}
+		switch_core_session_rwunlock(session);
 	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
 
 	return status;
 }
@@ -677,6 +969,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_perform_receive_message(swit
 		message->message_id = SWITCH_MESSAGE_INVALID-1;
 	}
 
+	switch_core_session_trace(session, SWITCH_TRACE_MESSAGE, message->message_id, 0, 0, message->from);
+
 	switch_log_printf(SWITCH_CHANNEL_ID_LOG, message->_file, message->_func, message->_line,
 					  switch_core_session_get_uuid(session), SWITCH_LOG_DEBUG1, "%s receive message [%s]\n",
 					  switch_channel_get_name(session->channel), message_names[message->message_id]);
@@ -813,7 +1107,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_queue_indication(switch_core
 {
 	switch_core_session_message_t *msg;
 
-	if ((msg = malloc(sizeof(*msg)))) {
+	if ((msg = switch_slab_alloc(runtime.message_slab))) {
 		memset(msg, 0, sizeof(*msg));
 		msg->message_id = indication;
 		msg->from = __FILE__;
@@ -832,7 +1126,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_queue_message(switch_core_se
 	switch_assert(session != NULL);
 
 	if (session->message_queue) {
-		if (switch_queue_trypush(session->message_queue, message) == SWITCH_STATUS_SUCCESS) {
+		if (switch_mpsc_queue_trypush(session->message_queue, &message->qnode, message) == SWITCH_STATUS_SUCCESS) {
 			status = SWITCH_STATUS_SUCCESS;
 		}
 
@@ -864,7 +1158,7 @@ SWITCH_DECLARE(void) switch_core_session_free_message(switch_core_session_messag
 			switch_safe_free(s);
 		}
 
-		switch_safe_free(to_free);
+		switch_slab_free(runtime.message_slab, to_free);
 	}
 }
 
@@ -875,8 +1169,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_dequeue_message(switch_core_
 
 	switch_assert(session != NULL);
 
-	if (session->message_queue && switch_queue_size(session->message_queue)) {
-		if ((status = (switch_status_t) switch_queue_trypop(session->message_queue, &pop)) == SWITCH_STATUS_SUCCESS) {
+	if (session->message_queue && switch_mpsc_queue_size(session->message_queue)) {
+		if ((status = switch_mpsc_queue_trypop(session->message_queue, &pop)) == SWITCH_STATUS_SUCCESS) {
 			*message = (switch_core_session_message_t *) pop;
 			if ((*message)->delivery_time && (*message)->delivery_time > switch_epoch_time_now(NULL)) {
 				switch_core_session_queue_message(session, *message);
@@ -899,7 +1193,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_flush_message(switch_core_se
 
 
 	if (session->message_queue) {
-		while ((status = (switch_status_t) switch_queue_trypop(session->message_queue, &pop)) == SWITCH_STATUS_SUCCESS) {
+		while ((status = switch_mpsc_queue_trypop(session->message_queue, &pop)) == SWITCH_STATUS_SUCCESS) {
 			message = (switch_core_session_message_t *) pop;
 			switch_ivr_process_indications(session, message);
 			switch_core_session_free_message(&message);
@@ -991,7 +1285,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_queue_event(switch_core_sess
 	switch_assert(session != NULL);
 
 	if (session->event_queue) {
-		if (switch_queue_trypush(session->event_queue, *event) == SWITCH_STATUS_SUCCESS) {
+		if (switch_mpsc_queue_trypush(session->event_queue, &(*event)->qnode, *event) == SWITCH_STATUS_SUCCESS) {
 			*event = NULL;
 			status = SWITCH_STATUS_SUCCESS;
 
@@ -1009,11 +1303,11 @@ SWITCH_DECLARE(uint32_t) switch_core_session_messages_waiting(switch_core_sessio
 	int x = 0;
 
 	if (session->private_event_queue) {
-		x += switch_queue_size(session->private_event_queue);
+		x += switch_mpsc_queue_size(session->private_event_queue);
 	}
 
 	if (session->message_queue) {
-		x += switch_queue_size(session->message_queue);
+		x += switch_mpsc_queue_size(session->message_queue);
 	}
 
 	return x;
@@ -1022,7 +1316,7 @@ SWITCH_DECLARE(uint32_t) switch_core_session_messages_waiting(switch_core_sessio
 SWITCH_DECLARE(uint32_t) switch_core_session_event_count(switch_core_session_t *session)
 {
 	if (session->event_queue) {
-		return switch_queue_size(session->event_queue);
+		return switch_mpsc_queue_size(session->event_queue);
 	}
 
 	return 0;
@@ -1036,7 +1330,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_dequeue_event(switch_core_se
 	switch_assert(session != NULL);
 
 	if (session->event_queue && (force || !switch_channel_test_flag(session->channel, CF_DIVERT_EVENTS))) {
-		if ((status = (switch_status_t) switch_queue_trypop(session->event_queue, &pop)) == SWITCH_STATUS_SUCCESS) {
+		if ((status = switch_mpsc_queue_trypop(session->event_queue, &pop)) == SWITCH_STATUS_SUCCESS) {
 			*event = (switch_event_t *) pop;
 		}
 	}
@@ -1047,7 +1341,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_dequeue_event(switch_core_se
 SWITCH_DECLARE(switch_status_t) switch_core_session_queue_private_event(switch_core_session_t *session, switch_event_t **event, switch_bool_t priority)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
-	switch_queue_t *queue;
+	switch_mpsc_queue_t *queue;
 
 	switch_assert(session != NULL);
 
@@ -1055,7 +1349,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_queue_private_event(switch_c
 		queue = priority ? session->private_event_queue_pri : session->private_event_queue;
 
 		(*event)->event_id = SWITCH_EVENT_PRIVATE_COMMAND;
-		if (switch_queue_trypush(queue, *event) == SWITCH_STATUS_SUCCESS) {
+		if (switch_mpsc_queue_trypush(queue, &(*event)->qnode, *event) == SWITCH_STATUS_SUCCESS) {
 			*event = NULL;
 			switch_core_session_kill_channel(session, SWITCH_SIG_BREAK);
 			status = SWITCH_STATUS_SUCCESS;
@@ -1081,11 +1375,11 @@ SWITCH_DECLARE(uint32_t) switch_core_session_private_event_count(switch_core_ses
 	if (session->private_event_queue) {
 
 		if (!switch_channel_test_flag(channel, CF_EVENT_LOCK)) {
-			count = switch_queue_size(session->private_event_queue);
+			count = switch_mpsc_queue_size(session->private_event_queue);
 		}
 
 		if (!switch_channel_test_flag(channel, CF_EVENT_LOCK_PRI)) {
-			count += switch_queue_size(session->private_event_queue_pri);
+			count += switch_mpsc_queue_size(session->private_event_queue_pri);
 		}
 
 		if (count == 0) {
@@ -1101,10 +1395,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_dequeue_private_event(switch
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	void *pop;
 	switch_channel_t *channel = switch_core_session_get_channel(session);
-	switch_queue_t *queue;
+	switch_mpsc_queue_t *queue;
 
 	if (session->private_event_queue) {
-		if (switch_queue_size(session->private_event_queue_pri)) {
+		if (switch_mpsc_queue_size(session->private_event_queue_pri)) {
 			queue = session->private_event_queue_pri;
 
 			if (switch_channel_test_flag(channel, CF_EVENT_LOCK_PRI)) {
@@ -1118,7 +1412,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_dequeue_private_event(switch
 			}
 		}
 
-		if ((status = (switch_status_t) switch_queue_trypop(queue, &pop)) == SWITCH_STATUS_SUCCESS) {
+		if ((status = switch_mpsc_queue_trypop(queue, &pop)) == SWITCH_STATUS_SUCCESS) {
 			*event = (switch_event_t *) pop;
 		} else {
 			check_media(session);
@@ -1135,10 +1429,10 @@ SWITCH_DECLARE(uint32_t) switch_core_session_flush_private_events(switch_core_se
 	void *pop;
 
 	if (session->private_event_queue) {
-		while ((status = (switch_status_t) switch_queue_trypop(session->private_event_queue_pri, &pop)) == SWITCH_STATUS_SUCCESS) {
+		while ((status = switch_mpsc_queue_trypop(session->private_event_queue_pri, &pop)) == SWITCH_STATUS_SUCCESS) {
 			x++;
 		}
-		while ((status = (switch_status_t) switch_queue_trypop(session->private_event_queue, &pop)) == SWITCH_STATUS_SUCCESS) {
+		while ((status = switch_mpsc_queue_trypop(session->private_event_queue, &pop)) == SWITCH_STATUS_SUCCESS) {
 			x++;
 		}
 		check_media(session);
@@ -1151,6 +1445,7 @@ SWITCH_DECLARE(void) switch_core_session_reset(switch_core_session_t *session, s
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	switch_size_t has;
+	int i;
 
 	if (reset_read_codec) {
 		switch_core_session_set_read_codec(session, NULL);
@@ -1160,7 +1455,18 @@ SWITCH_DECLARE(void) switch_core_session_reset(switch_core_session_t *session, s
 	switch_mutex_lock(session->resample_mutex);
 	switch_resample_destroy(&session->read_resampler);
 	switch_resample_destroy(&session->write_resampler);
+	switch_resample_destroy(&session->read_resampler_idle);
+	switch_resample_destroy(&session->write_resampler_idle);
+	for (i = 0; i < SWITCH_TAP_RATES; i++) {
+		switch_resample_destroy(&session->tap_frames[0][i].resampler);
+		switch_resample_destroy(&session->tap_frames[1][i].resampler);
+	}
+	memset(session->tap_frames, 0, sizeof(session->tap_frames));
 	switch_mutex_unlock(session->resample_mutex);
+
+	if (session->io_allocs) {
+		switch_channel_set_variable_printf(channel, "io_allocs", "%u", session->io_allocs);
+	}
 	/* clear indications */
 	switch_core_session_flush_message(session);
 
@@ -1276,8 +1582,9 @@ SWITCH_DECLARE(void) switch_core_session_perform_destroy(switch_core_session_t *
 
 	switch_scheduler_del_task_group((*session)->uuid_str);
 
+	switch_core_striped_hash_delete(session_manager.session_table, (*session)->uuid_str);
+
 	switch_mutex_lock(runtime.session_hash_mutex);
-	switch_core_hash_delete(session_manager.session_table, (*session)->uuid_str);
 	if (session_manager.session_count) {
 		session_manager.session_count--;
 		if (session_manager.session_count == 0) {
@@ -1408,6 +1715,9 @@ static void *SWITCH_THREAD_FUNC switch_core_session_thread(switch_thread_t *thre
 	session->thread = thread;
 	session->thread_id = switch_thread_self();
 
+	/* pinned before the call runs so the memory it touches first is local to where it stays */
+	switch_core_thread_set_role_affinity(SWITCH_THREAD_ROLE_SESSION);
+
 	switch_core_session_run(session);
 	switch_core_media_bug_remove_all(session);
 
@@ -1509,8 +1819,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_set_uuid(switch_core_session
 
 	switch_assert(use_uuid);
 
+	/* the mutex keeps two uuid changes from racing for the same new uuid */
 	switch_mutex_lock(runtime.session_hash_mutex);
-	if (switch_core_hash_find(session_manager.session_table, use_uuid)) {
+	if (switch_core_striped_hash_find(session_manager.session_table, use_uuid)) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Duplicate UUID!\n");
 		switch_mutex_unlock(runtime.session_hash_mutex);
 		return SWITCH_STATUS_FALSE;
@@ -1531,9 +1842,11 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_set_uuid(switch_core_session
 
 	switch_event_create(&event, SWITCH_EVENT_CHANNEL_UUID);
 	switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Old-Unique-ID", session->uuid_str);
-	switch_core_hash_delete(session_manager.session_table, session->uuid_str);
+	switch_core_striped_hash_delete(session_manager.session_table, session->uuid_str);
+	switch_channel_index_variables(session->channel, session->uuid_str, SWITCH_FALSE);
 	switch_set_string(session->uuid_str, use_uuid);
-	switch_core_hash_insert(session_manager.session_table, session->uuid_str, session);
+	switch_channel_index_variables(session->channel, session->uuid_str, SWITCH_TRUE);
+	switch_core_striped_hash_insert(session_manager.session_table, session->uuid_str, session);
 	switch_mutex_unlock(runtime.session_hash_mutex);
 	switch_channel_event_set_data(session->channel, event);
 	switch_event_fire(&event);
@@ -1825,7 +2138,7 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_request_uuid(switch_
 	int32_t sps = 0;
 
 
-	if (use_uuid && switch_core_hash_find(session_manager.session_table, use_uuid)) {
+	if (use_uuid && switch_core_striped_hash_find(session_manager.session_table, use_uuid)) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Duplicate UUID!\n");
 		return NULL;
 	}
@@ -1849,6 +2162,16 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_request_uuid(switch_
 		return NULL;
 	}
 
+	/* a pegged single threaded component does not show in the idle cpu of a big box */
+	if (direction == SWITCH_CALL_DIRECTION_INBOUND && runtime.max_component_load && !(originate_flags & SOF_NO_LIMITS) &&
+		runtime.component_load >= runtime.max_component_load) {
+		char name[64] = "";
+		uint32_t load = switch_core_component_load(name, sizeof(name));
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Refusing inbound session, %s is %u%% busy\n", name, load);
+		return NULL;
+	}
+
 	PROTECT_INTERFACE(endpoint_interface);
 
 	if (!(originate_flags & SOF_NO_LIMITS)) {
@@ -1907,6 +2230,15 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_request_uuid(switch_
 	switch_channel_set_variable(session->channel, "call_uuid", session->uuid_str);
 
 	session->endpoint_interface = endpoint_interface;
+	session->created = switch_micro_time_now();
+
+	if (runtime.session_trace_size) {
+		session->trace = switch_core_alloc(session->pool, sizeof(*session->trace) +
+										   sizeof(switch_session_trace_record_t) * (runtime.session_trace_size - 1));
+		session->trace->size = runtime.session_trace_size;
+		switch_mutex_init(&session->trace->mutex, SWITCH_MUTEX_NESTED, session->pool);
+	}
+
 	session->raw_write_frame.data = session->raw_write_buf;
 	session->raw_write_frame.buflen = sizeof(session->raw_write_buf);
 	session->raw_read_frame.data = session->raw_read_buf;
@@ -1927,14 +2259,15 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_request_uuid(switch_
 	switch_thread_cond_create(&session->cond, session->pool);
 	switch_thread_rwlock_create(&session->rwlock, session->pool);
 	switch_thread_rwlock_create(&session->io_rwlock, session->pool);
-	switch_queue_create(&session->message_queue, SWITCH_MESSAGE_QUEUE_LEN, session->pool);
+	switch_mpsc_queue_create(&session->message_queue, SWITCH_MESSAGE_QUEUE_LEN, session->pool);
 	switch_queue_create(&session->signal_data_queue, SWITCH_MESSAGE_QUEUE_LEN, session->pool);
-	switch_queue_create(&session->event_queue, SWITCH_EVENT_QUEUE_LEN, session->pool);
-	switch_queue_create(&session->private_event_queue, SWITCH_EVENT_QUEUE_LEN, session->pool);
-	switch_queue_create(&session->private_event_queue_pri, SWITCH_EVENT_QUEUE_LEN, session->pool);
+	switch_mpsc_queue_create(&session->event_queue, SWITCH_EVENT_QUEUE_LEN, session->pool);
+	switch_mpsc_queue_create(&session->private_event_queue, SWITCH_EVENT_QUEUE_LEN, session->pool);
+	switch_mpsc_queue_create(&session->private_event_queue_pri, SWITCH_EVENT_QUEUE_LEN, session->pool);
+
+	switch_core_striped_hash_insert(session_manager.session_table, session->uuid_str, session);
 
 	switch_mutex_lock(runtime.session_hash_mutex);
-	switch_core_hash_insert(session_manager.session_table, session->uuid_str, session);
 	session->id = session_manager.session_id++;
 	session_manager.session_count++;
 	switch_mutex_unlock(runtime.session_hash_mutex);
@@ -2028,6 +2361,15 @@ SWITCH_DECLARE(double) switch_core_idle_cpu(void)
 	return runtime.profile_time;
 }
 
+SWITCH_DECLARE(int32_t) switch_core_max_component_load(int32_t new_limit)
+{
+	if (new_limit >= 0) {
+		runtime.max_component_load = (uint32_t) new_limit;
+	}
+
+	return (int32_t) runtime.max_component_load;
+}
+
 SWITCH_DECLARE(uint32_t) switch_core_sessions_per_second(uint32_t new_limit)
 {
 	if (new_limit) {
@@ -2037,18 +2379,51 @@ SWITCH_DECLARE(uint32_t) switch_core_sessions_per_second(uint32_t new_limit)
 	return runtime.sps_total;
 }
 
+static const char *PHASE_NAMES[SWITCH_PHASE_COUNT] = {
+	"route",
+	"dialplan",
+	"xml_fetch",
+	"media",
+	"originate_ring",
+	"originate_answer",
+	"answer",
+	"bridge",
+	"sql"
+};
+
+static switch_metric_t *PHASE_METRICS[SWITCH_PHASE_COUNT] = { 0 };
+
 void switch_core_session_init(switch_memory_pool_t *pool)
 {
+	int x;
+
 	memset(&session_manager, 0, sizeof(session_manager));
 	session_manager.session_limit = 1000;
 	session_manager.session_id = 1;
 	session_manager.memory_pool = pool;
-	switch_core_hash_init(&session_manager.session_table, session_manager.memory_pool);
+	switch_core_striped_hash_init(&session_manager.session_table, session_manager.memory_pool, 64, SWITCH_TRUE);
+
+	memset(&var_index, 0, sizeof(var_index));
+	switch_mutex_init(&var_index.mutex, SWITCH_MUTEX_NESTED, session_manager.memory_pool);
+	switch_core_hash_init_nocase(&var_index.names, session_manager.memory_pool);
+	switch_core_hash_init(&var_index.values, NULL);
+
+	for (x = 0; x < SWITCH_PHASE_COUNT; x++) {
+		char name[128];
+
+		switch_snprintf(name, sizeof(name), "freeswitch_session_setup_usec{phase=\"%s\"}", PHASE_NAMES[x]);
+		/* anything past a minute is just "slow" */
+		PHASE_METRICS[x] = switch_metric_register_histogram(name, "Call setup phase latency in microseconds", 60000000);
+	}
+
+	session_manager.io_allocs = switch_metric_register("freeswitch_session_io_allocs_total",
+													   "Heap allocations made while reading or writing frames, should stay flat in steady state",
+													   SWITCH_METRIC_COUNTER);
 }
 
 void switch_core_session_uninit(void)
 {
-	switch_core_hash_destroy(&session_manager.session_table);
+	switch_core_striped_hash_destroy(&session_manager.session_table);
 }
 
 SWITCH_DECLARE(switch_app_log_t *) switch_core_session_get_app_log(switch_core_session_t *session)
@@ -2056,6 +2431,125 @@ SWITCH_DECLARE(switch_app_log_t *) switch_core_session_get_app_log(switch_core_s
 	return session->app_log;
 }
 
+SWITCH_DECLARE(void) switch_core_session_trace(switch_core_session_t *session, switch_session_trace_type_t type,
+											   uint32_t a, uint32_t b, uint32_t c, const char *str)
+{
+	switch_session_trace_ring_t *ring;
+	switch_session_trace_record_t *rec;
+
+	if (!session || !(ring = session->trace)) {
+		return;
+	}
+
+	switch_mutex_lock(ring->mutex);
+	rec = &ring->records[ring->count++ % ring->size];
+	rec->timestamp = switch_micro_time_now();
+	rec->type = (uint16_t) type;
+	rec->a = a;
+	rec->b = b;
+	rec->c = c;
+	if (str) {
+		switch_copy_string(rec->str, str, sizeof(rec->str));
+	} else {
+		*rec->str = '\0';
+	}
+	switch_mutex_unlock(ring->mutex);
+}
+
+SWITCH_DECLARE(void) switch_core_session_record_phase(switch_core_session_t *session, switch_session_phase_t phase,
+													  switch_time_t start, switch_time_t end)
+{
+	switch_time_t elapsed;
+
+	switch_assert(phase < SWITCH_PHASE_COUNT);
+
+	if (!start) {
+		/* phases measured from session creation only count once per session, not again after a transfer */
+		if (!session || (session->phases & (1 << phase))) {
+			return;
+		}
+		session->phases |= (1 << phase);
+		start = session->created;
+	}
+
+	if (!end) {
+		end = switch_micro_time_now();
+	}
+
+	if (end < start) {
+		return;
+	}
+
+	elapsed = end - start;
+	switch_metric_observe(PHASE_METRICS[phase], elapsed);
+
+	if (session) {
+		char var[64];
+
+		switch_snprintf(var, sizeof(var), "setup_%s_usec", PHASE_NAMES[phase]);
+		switch_channel_set_variable_printf(session->channel, var, "%" SWITCH_TIME_T_FMT, elapsed);
+	}
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_session_trace_dump(switch_core_session_t *session, switch_stream_handle_t *stream)
+{
+	switch_session_trace_ring_t *ring = session->trace;
+	switch_time_t first = 0;
+	uint32_t x, start;
+
+	if (!ring) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(ring->mutex);
+
+	start = ring->count > ring->size ? ring->count - ring->size : 0;
+
+	if (start) {
+		stream->write_function(stream, "(%u older records overwritten)\n", start);
+	}
+
+	for (x = start; x < ring->count; x++) {
+		switch_session_trace_record_t *rec = &ring->records[x % ring->size];
+		switch_time_t offset;
+
+		if (!first) {
+			first = rec->timestamp;
+		}
+		offset = rec->timestamp - first;
+
+		stream->write_function(stream, "%4u +%" SWITCH_TIME_T_FMT ".%06d ", x, offset / 1000000, (int) (offset % 1000000));
+
+		switch ((switch_session_trace_type_t) rec->type) {
+		case SWITCH_TRACE_STATE:
+			stream->write_function(stream, "STATE %s -> %s\n",
+								   switch_channel_state_name((switch_channel_state_t) rec->a), switch_channel_state_name((switch_channel_state_t) rec->b));
+			break;
+		case SWITCH_TRACE_MESSAGE:
+			stream->write_function(stream, "MESSAGE %s%s%s\n", message_names[rec->a < SWITCH_MESSAGE_INVALID ? rec->a : SWITCH_MESSAGE_INVALID],
+								   *rec->str ? " from " : "", rec->str);
+			break;
+		case SWITCH_TRACE_APP:
+			stream->write_function(stream, "APP %s\n", rec->str);
+			break;
+		case SWITCH_TRACE_HANGUP:
+			stream->write_function(stream, "HANGUP %s [%s]%s%s\n", switch_channel_cause2str((switch_call_cause_t) rec->a),
+								   switch_channel_state_name((switch_channel_state_t) rec->b), *rec->str ? " from " : "", rec->str);
+			break;
+		case SWITCH_TRACE_RTP:
+			stream->write_function(stream, "RTP %s in %u out %u skip %u\n", rec->str, rec->b, rec->c, rec->a);
+			break;
+		default:
+			stream->write_function(stream, "%s %u %u %u\n", *rec->str ? rec->str : "USER", rec->a, rec->b, rec->c);
+			break;
+		}
+	}
+
+	switch_mutex_unlock(ring->mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_session_get_app_flags(const char *app, int32_t *flags)
 {
 	switch_application_interface_t *application_interface;
@@ -2082,6 +2576,12 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_get_app_flags(const char *ap
 }
 
 SWITCH_DECLARE(switch_status_t) switch_core_session_execute_application_async(switch_core_session_t *session, const char *app, const char *arg)
+{
+	return switch_core_session_execute_application_async_uuid(session, app, arg, NULL);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_session_execute_application_async_uuid(switch_core_session_t *session, const char *app, const char *arg,
+																				   const char *app_uuid)
 {
 	switch_event_t *execute_event;
 	char *ap, *arp;
@@ -2103,6 +2603,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_execute_application_async(sw
 		if (arg) {
 			switch_event_add_header_string(execute_event, SWITCH_STACK_BOTTOM, "execute-app-arg", arg);
 		}
+
+		if (app_uuid) {
+			switch_event_add_header_string(execute_event, SWITCH_STACK_BOTTOM, "event-uuid", app_uuid);
+		}
 		
 		if (!switch_channel_test_flag(session->channel, CF_PROXY_MODE)) {
 			switch_channel_set_flag(session->channel, CF_BLOCK_BROADCAST_UNTIL_MEDIA);
@@ -2261,6 +2765,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_exec(switch_core_session_t *
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(session), SWITCH_LOG_DEBUG, "EXECUTE %s %s(%s)\n",
 					  switch_channel_get_name(session->channel), app, switch_str_nil(expanded));
 
+	switch_core_session_trace(session, SWITCH_TRACE_APP, 0, 0, 0, app);
+
 	if ((var = switch_channel_get_variable(session->channel, "verbose_presence")) && switch_true(var)) {
 		char *myarg = NULL;
 		if (expanded) {
@@ -2322,10 +2828,14 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_exec(switch_core_session_t *
 
 	if (switch_event_create(&event, SWITCH_EVENT_CHANNEL_EXECUTE_COMPLETE) == SWITCH_STATUS_SUCCESS) {
 		const char *resp = switch_channel_get_variable(session->channel, SWITCH_CURRENT_APPLICATION_RESPONSE_VARIABLE);
+		const char *app_uuid = switch_channel_get_variable(session->channel, "app_uuid");
 		switch_channel_event_set_data(session->channel, event);
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Application", application_interface->interface_name);
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Application-Data", expanded);
 		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Application-Response", resp ? resp : "_none_");
+		if (app_uuid) {
+			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Application-UUID", app_uuid);
+		}
 		switch_event_fire(&event);
 	}
 
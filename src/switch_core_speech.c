@@ -83,6 +83,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_speech_open(switch_speech_handle_t *
 	sh->samples = switch_samples_per_packet(rate, interval);
 	sh->samplerate = rate;
 	sh->native_rate = rate;
+	if (voice_name) {
+		switch_copy_string(sh->voice, voice_name, sizeof(sh->voice));
+	}
 
 	if ((status = sh->speech_interface->speech_open(sh, voice_name, rate, flags)) == SWITCH_STATUS_SUCCESS) {
 		switch_set_flag(sh, SWITCH_SPEECH_FLAG_OPEN);
@@ -169,6 +172,10 @@ SWITCH_DECLARE(void) switch_core_speech_text_param_tts(switch_speech_handle_t *s
 {
 	switch_assert(sh != NULL);
 
+	if (!strcasecmp(param, "voice") && val) {
+		switch_copy_string(sh->voice, val, sizeof(sh->voice));
+	}
+
 	if (sh->speech_interface->speech_text_param_tts) {
 		sh->speech_interface->speech_text_param_tts(sh, param, val);
 	}
@@ -291,6 +298,274 @@ SWITCH_DECLARE(switch_status_t) switch_core_speech_close(switch_speech_handle_t
 	return status;
 }
 
+/*
+ * Speech handle pool.  Opening a handle is the expensive part of a short prompt for most engines (a network
+ * session for the MRCP ones, loading a voice for the local ones), so handles given back after speaking are kept
+ * open, up to speech-handle-pool-size of them per module, voice, rate and interval, and handed to the next caller
+ * asking for the same.  Handles idle for SPEECH_POOL_IDLE seconds are closed, as are all of a module's before it
+ * is unloaded.
+ */
+#define SPEECH_POOL_IDLE 60
+
+typedef struct speech_pool_node {
+	/* first, a released handle is its node */
+	switch_speech_handle_t sh;
+	char key[256];
+	char module[128];
+	switch_speech_flag_t flags;
+	time_t idle_since;
+	struct speech_pool_node *next;
+} speech_pool_node_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *hash;
+	switch_memory_pool_t *pool;
+	uint32_t idle;
+	time_t reaped;
+	int tts_dir_made;
+} SPEECH_POOL;
+
+static void speech_pool_node_close(speech_pool_node_t *node)
+{
+	switch_speech_flag_t flags = SWITCH_SPEECH_FLAG_NONE;
+
+	switch_core_speech_close(&node->sh, &flags);
+	free(node);
+}
+
+/* unlinks the idle handles matching, the caller closes them without the lock held */
+static speech_pool_node_t *speech_pool_collect(const char *module_name, time_t older_than)
+{
+	switch_hash_index_t *hi;
+	speech_pool_node_t *collected = NULL, *node, *next, *keep;
+	const void *var;
+	void *val;
+	char **del = NULL;
+	int i, ndel = 0;
+
+	for (hi = switch_hash_first(NULL, SPEECH_POOL.hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, &var, NULL, &val);
+		keep = NULL;
+
+		for (node = (speech_pool_node_t *) val; node; node = next) {
+			next = node->next;
+
+			if ((!module_name || !strcasecmp(node->module, module_name)) && (!older_than || node->idle_since < older_than)) {
+				node->next = collected;
+				collected = node;
+				SPEECH_POOL.idle--;
+			} else {
+				node->next = keep;
+				keep = node;
+			}
+		}
+
+		if (keep) {
+			switch_core_hash_insert(SPEECH_POOL.hash, (const char *) var, keep);
+		} else {
+			/* keys can move as entries go, so they are copied and deleted after the walk */
+			del = realloc(del, (ndel + 1) * sizeof(*del));
+			switch_assert(del);
+			del[ndel++] = strdup((const char *) var);
+		}
+	}
+
+	for (i = 0; i < ndel; i++) {
+		switch_core_hash_delete(SPEECH_POOL.hash, del[i]);
+		free(del[i]);
+	}
+	switch_safe_free(del);
+
+	return collected;
+}
+
+static void speech_pool_close_all(speech_pool_node_t *node)
+{
+	speech_pool_node_t *next;
+
+	for (; node; node = next) {
+		next = node->next;
+		speech_pool_node_close(node);
+	}
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_speech_open_pooled(switch_speech_handle_t **sh,
+															   const char *module_name,
+															   const char *voice_name,
+															   unsigned int rate, unsigned int interval, switch_speech_flag_t *flags)
+{
+	speech_pool_node_t *node = NULL;
+	char key[256];
+	switch_status_t status;
+
+	if (!sh || !flags || zstr(module_name)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	*sh = NULL;
+	switch_snprintf(key, sizeof(key), "%s|%s|%u|%u", module_name, switch_str_nil(voice_name), rate, interval);
+
+	if (SPEECH_POOL.mutex && runtime.speech_pool_size) {
+		switch_mutex_lock(SPEECH_POOL.mutex);
+		if ((node = switch_core_hash_find(SPEECH_POOL.hash, key))) {
+			if (node->next) {
+				switch_core_hash_insert(SPEECH_POOL.hash, key, node->next);
+			} else {
+				switch_core_hash_delete(SPEECH_POOL.hash, key);
+			}
+			node->next = NULL;
+			SPEECH_POOL.idle--;
+		}
+		switch_mutex_unlock(SPEECH_POOL.mutex);
+	}
+
+	if (node) {
+		*sh = &node->sh;
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	switch_zmalloc(node, sizeof(*node));
+	switch_copy_string(node->key, key, sizeof(node->key));
+	switch_copy_string(node->module, module_name, sizeof(node->module));
+	if (strchr(node->module, ':')) {
+		*strchr(node->module, ':') = '\0';
+	}
+	node->flags = *flags;
+
+	if ((status = switch_core_speech_open(&node->sh, module_name, voice_name, rate, interval, flags, NULL)) != SWITCH_STATUS_SUCCESS) {
+		free(node);
+		return status;
+	}
+
+	*sh = &node->sh;
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_core_speech_release(switch_speech_handle_t **sh)
+{
+	speech_pool_node_t *node, *head, *stale = NULL;
+	time_t now = switch_epoch_time_now(NULL);
+	uint32_t count = 0;
+
+	if (!sh || !*sh) {
+		return;
+	}
+
+	node = (speech_pool_node_t *) *sh;
+	*sh = NULL;
+
+	if (!SPEECH_POOL.mutex || !runtime.speech_pool_size || !switch_test_flag(&node->sh, SWITCH_SPEECH_FLAG_OPEN)) {
+		speech_pool_node_close(node);
+		return;
+	}
+
+	/* whatever was left of the last text goes, the handle starts over as it was opened */
+	switch_core_speech_flush_tts(&node->sh);
+	if (node->sh.buffer) {
+		switch_buffer_zero(node->sh.buffer);
+	}
+	node->sh.flags = node->flags | (node->sh.flags & (SWITCH_SPEECH_FLAG_OPEN | SWITCH_SPEECH_FLAG_FREE_POOL));
+	node->idle_since = now;
+
+	switch_mutex_lock(SPEECH_POOL.mutex);
+	for (head = switch_core_hash_find(SPEECH_POOL.hash, node->key); head; head = head->next) {
+		count++;
+	}
+
+	if (count < runtime.speech_pool_size) {
+		node->next = switch_core_hash_find(SPEECH_POOL.hash, node->key);
+		switch_core_hash_insert(SPEECH_POOL.hash, node->key, node);
+		SPEECH_POOL.idle++;
+		node = NULL;
+	}
+
+	if (now - SPEECH_POOL.reaped >= 5) {
+		SPEECH_POOL.reaped = now;
+		stale = speech_pool_collect(NULL, now - SPEECH_POOL_IDLE);
+	}
+	switch_mutex_unlock(SPEECH_POOL.mutex);
+
+	if (node) {
+		speech_pool_node_close(node);
+	}
+
+	speech_pool_close_all(stale);
+}
+
+SWITCH_DECLARE(void) switch_core_speech_pool_flush(const char *module_name)
+{
+	speech_pool_node_t *collected;
+
+	if (!SPEECH_POOL.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(SPEECH_POOL.mutex);
+	collected = speech_pool_collect(module_name, 0);
+	switch_mutex_unlock(SPEECH_POOL.mutex);
+
+	speech_pool_close_all(collected);
+}
+
+/*
+ * Rendered speech cache.  The same menus and greetings are spoken over and over, so with tts-cache on what a handle
+ * renders for some text is kept as a wav file named after the engine, voice, rate and text.  Playing it back goes
+ * through the prompt cache like any other file, so repeated text costs neither the engine nor the disk.
+ */
+#define TTS_CACHE_MAX_TEXT 4096
+
+SWITCH_DECLARE(switch_status_t) switch_core_speech_cache_path(switch_speech_handle_t *sh, const char *text, char *buf, switch_size_t buflen)
+{
+	char digest[SWITCH_MD5_DIGEST_STRING_SIZE] = { 0 };
+	const char *dir;
+	char *key;
+
+	switch_assert(sh != NULL);
+
+	if (!runtime.tts_cache || zstr(text) || strlen(text) > TTS_CACHE_MAX_TEXT || !sh->speech_interface) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	key = switch_mprintf("%s:%s|%s|%u|%s", sh->speech_interface->interface_name, switch_str_nil(sh->param), sh->voice, sh->samplerate, text);
+	switch_md5_string(digest, key, strlen(key));
+	free(key);
+
+	if (!(dir = runtime.tts_cache_dir)) {
+		dir = switch_core_sprintf(runtime.memory_pool, "%s%stts", SWITCH_GLOBAL_dirs.storage_dir, SWITCH_PATH_SEPARATOR);
+		runtime.tts_cache_dir = (char *) dir;
+	}
+
+	if (!SPEECH_POOL.tts_dir_made) {
+		switch_dir_make_recursive(dir, SWITCH_DEFAULT_DIR_PERMS, SPEECH_POOL.pool);
+		SPEECH_POOL.tts_dir_made = 1;
+	}
+
+	switch_snprintf(buf, buflen, "%s%s%s.wav", dir, SWITCH_PATH_SEPARATOR, digest);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+void switch_core_speech_pool_init(switch_memory_pool_t *pool)
+{
+	SPEECH_POOL.pool = pool;
+	switch_mutex_init(&SPEECH_POOL.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&SPEECH_POOL.hash, pool);
+}
+
+void switch_core_speech_pool_shutdown(void)
+{
+	if (!SPEECH_POOL.mutex) {
+		return;
+	}
+
+	switch_core_speech_pool_flush(NULL);
+	switch_mutex_lock(SPEECH_POOL.mutex);
+	switch_core_hash_destroy(&SPEECH_POOL.hash);
+	switch_mutex_unlock(SPEECH_POOL.mutex);
+	SPEECH_POOL.mutex = NULL;
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
@@ -38,6 +38,16 @@
 #define SWITCH_SQL_QUEUE_LEN 100000
 #define SWITCH_SQL_QUEUE_PAUSE_LEN 90000
 
+/* statements switch_cache_db_execute_prepared() keeps per core db handle, the least recently used one goes */
+#define SCDB_STMT_CACHE_LEN 32
+
+typedef struct {
+	char *sql;
+	unsigned long hash;
+	switch_core_db_stmt_t *stmt;
+	uint32_t used;
+} scdb_stmt_t;
+
 struct switch_cache_db_handle {
 	char name[CACHE_DB_LEN];
 	switch_cache_db_handle_type_t type;
@@ -53,8 +63,19 @@ struct switch_cache_db_handle {
 	char last_user[CACHE_DB_LEN];
 	uint32_t use_count;
 	struct switch_cache_db_handle *next;
+	struct switch_cache_db_handle *bucket_next;
+	scdb_stmt_t stmt_cache[SCDB_STMT_CACHE_LEN];
+	uint32_t stmt_tick;
 };
 
+/* handles are also filed by the hash of their connect string so an acquire only ever locks and walks its own bucket */
+#define SWITCH_DBH_BUCKETS 32
+
+typedef struct {
+	switch_mutex_t *mutex;
+	switch_cache_db_handle_t *head;
+} dbh_bucket_t;
+
 static struct {
 	switch_cache_db_handle_t *event_db;
 	switch_queue_t *sql_queue[2];
@@ -68,12 +89,15 @@ static struct {
 	switch_mutex_t *io_mutex;
 	switch_mutex_t *dbh_mutex;
 	switch_cache_db_handle_t *handle_pool;
+	dbh_bucket_t dbh_bucket[SWITCH_DBH_BUCKETS];
 	switch_thread_cond_t *cond;
 	switch_mutex_t *cond_mutex;
 	uint32_t total_handles;
-	uint32_t total_used_handles;
+	volatile switch_atomic_t total_used_handles;
 } sql_manager;
 
+#define dbh_bucket_of(_hash) (&sql_manager.dbh_bucket[(_hash) % SWITCH_DBH_BUCKETS])
+
 
 static switch_cache_db_handle_t *create_handle(switch_cache_db_handle_type_t type)
 {
@@ -92,6 +116,7 @@ static switch_cache_db_handle_t *create_handle(switch_cache_db_handle_type_t typ
 static void add_handle(switch_cache_db_handle_t *dbh, const char *db_str, const char *db_callsite_str, const char *thread_str)
 {
 	switch_ssize_t hlen = -1;
+	dbh_bucket_t *bucket;
 
 	switch_mutex_lock(sql_manager.dbh_mutex);
 
@@ -102,20 +127,165 @@ static void add_handle(switch_cache_db_handle_t *dbh, const char *db_str, const
 	dbh->thread_hash = switch_ci_hashfunc_default(thread_str, &hlen);
 
 	dbh->use_count++;
-	sql_manager.total_used_handles++;
+	switch_atomic_inc(&sql_manager.total_used_handles);
 	dbh->next = sql_manager.handle_pool;
 
 	sql_manager.handle_pool = dbh;
 	sql_manager.total_handles++;
 	switch_mutex_lock(dbh->mutex);
+
+	bucket = dbh_bucket_of(dbh->hash);
+	switch_mutex_lock(bucket->mutex);
+	dbh->bucket_next = bucket->head;
+	bucket->head = dbh;
+	switch_mutex_unlock(bucket->mutex);
+
 	switch_mutex_unlock(sql_manager.dbh_mutex);
 }
 
+static void stmt_cache_flush(switch_cache_db_handle_t *dbh)
+{
+	int i;
+
+	for (i = 0; i < SCDB_STMT_CACHE_LEN; i++) {
+		scdb_stmt_t *slot = &dbh->stmt_cache[i];
+
+		if (slot->stmt) {
+			switch_core_db_finalize(slot->stmt);
+			slot->stmt = NULL;
+		}
+		switch_safe_free(slot->sql);
+		slot->hash = 0;
+		slot->used = 0;
+	}
+}
+
+static scdb_stmt_t *stmt_cache_get(switch_cache_db_handle_t *dbh, const char *sql, switch_bool_t fresh, char **errmsg)
+{
+	switch_ssize_t hlen = -1;
+	unsigned long hash = switch_hashfunc_default(sql, &hlen);
+	scdb_stmt_t *slot = NULL, *lru = NULL;
+	const char *tail = NULL;
+	int i;
+
+	for (i = 0; i < SCDB_STMT_CACHE_LEN; i++) {
+		scdb_stmt_t *sp = &dbh->stmt_cache[i];
+
+		if (sp->stmt && sp->hash == hash && !strcmp(sp->sql, sql)) {
+			slot = sp;
+			break;
+		}
+
+		if (!lru || !sp->stmt || (lru->stmt && sp->used < lru->used)) {
+			lru = sp;
+		}
+	}
+
+	if (slot && fresh) {
+		lru = slot;
+		slot = NULL;
+	}
+
+	if (!slot) {
+		slot = lru;
+
+		if (slot->stmt) {
+			switch_core_db_finalize(slot->stmt);
+			slot->stmt = NULL;
+		}
+		switch_safe_free(slot->sql);
+
+		if (switch_core_db_prepare(dbh->native_handle.core_db_dbh, sql, -1, &slot->stmt, &tail) != SWITCH_CORE_DB_OK || !slot->stmt) {
+			*errmsg = strdup(switch_str_nil(switch_core_db_errmsg(dbh->native_handle.core_db_dbh)));
+			if (slot->stmt) {
+				switch_core_db_finalize(slot->stmt);
+				slot->stmt = NULL;
+			}
+			return NULL;
+		}
+
+		slot->sql = strdup(sql);
+		slot->hash = hash;
+	}
+
+	slot->used = ++dbh->stmt_tick;
+
+	return slot;
+}
+
+/* ODBC has no statement cache here, quote the values into the sql in place of each '?' outside a literal */
+static char *prepared_render(const char *sql, const switch_cache_db_arg_t *args, int argc)
+{
+	switch_stream_handle_t stream = { 0 };
+	const char *p;
+	int quoted = 0, n = 0;
+
+	SWITCH_STANDARD_STREAM(stream);
+
+	for (p = sql; *p; p++) {
+		if (*p == '\'') {
+			quoted = !quoted;
+		}
+
+		if (*p != '?' || quoted) {
+			stream.write_function(&stream, "%c", *p);
+			continue;
+		}
+
+		if (n >= argc) {
+			stream.write_function(&stream, "NULL");
+			continue;
+		}
+
+		switch (args[n].type) {
+		case SCDB_ARG_TEXT:
+			{
+				char *q = switch_mprintf("'%q'", args[n].text);
+				stream.write_function(&stream, "%s", q);
+				free(q);
+			}
+			break;
+		case SCDB_ARG_INT:
+		case SCDB_ARG_INT64:
+			stream.write_function(&stream, "%" SWITCH_INT64_T_FMT, args[n].num);
+			break;
+		case SCDB_ARG_DOUBLE:
+			stream.write_function(&stream, "%f", args[n].dbl);
+			break;
+		default:
+			stream.write_function(&stream, "NULL");
+			break;
+		}
+
+		n++;
+	}
+
+	return (char *) stream.data;
+}
+
 static void del_handle(switch_cache_db_handle_t *dbh)
 {
 	switch_cache_db_handle_t *dbh_ptr, *last = NULL;
+	dbh_bucket_t *bucket = dbh_bucket_of(dbh->hash);
 
 	switch_mutex_lock(sql_manager.dbh_mutex);
+
+	switch_mutex_lock(bucket->mutex);
+	for (dbh_ptr = bucket->head; dbh_ptr; dbh_ptr = dbh_ptr->bucket_next) {
+		if (dbh_ptr == dbh) {
+			if (last) {
+				last->bucket_next = dbh_ptr->bucket_next;
+			} else {
+				bucket->head = dbh_ptr->bucket_next;
+			}
+			break;
+		}
+
+		last = dbh_ptr;
+	}
+	switch_mutex_unlock(bucket->mutex);
+
+	last = NULL;
 	for (dbh_ptr = sql_manager.handle_pool; dbh_ptr; dbh_ptr = dbh_ptr->next) {
 		if (dbh_ptr == dbh) {
 			if (last) {
@@ -137,38 +307,42 @@ static switch_cache_db_handle_t *get_handle(const char *db_str, const char *user
 	switch_ssize_t hlen = -1;
 	unsigned long hash = 0, thread_hash = 0;
 	switch_cache_db_handle_t *dbh_ptr, *r = NULL;
+	dbh_bucket_t *bucket;
 
 	hash = switch_ci_hashfunc_default(db_str, &hlen);
 	thread_hash = switch_ci_hashfunc_default(thread_str, &hlen);
-	
-	switch_mutex_lock(sql_manager.dbh_mutex);
+	bucket = dbh_bucket_of(hash);
 
-	for (dbh_ptr = sql_manager.handle_pool; dbh_ptr; dbh_ptr = dbh_ptr->next) {
-		if (dbh_ptr->thread_hash == thread_hash && dbh_ptr->hash == hash &&
+	/* only this dsn's bucket is locked, the global pool lock is left to add, delete and prune */
+	switch_mutex_lock(bucket->mutex);
+
+	/* the handle this thread holds or released last, thread_hash is kept across release for this */
+	for (dbh_ptr = bucket->head; dbh_ptr; dbh_ptr = dbh_ptr->bucket_next) {
+		if (dbh_ptr->thread_hash == thread_hash && dbh_ptr->hash == hash && !strcasecmp(dbh_ptr->name, db_str) &&
 			!switch_test_flag(dbh_ptr, CDF_PRUNE) && switch_mutex_trylock(dbh_ptr->mutex) == SWITCH_STATUS_SUCCESS) {
 			r = dbh_ptr;
+			break;
 		}
 	}
-			
+
 	if (!r) {
-		for (dbh_ptr = sql_manager.handle_pool; dbh_ptr; dbh_ptr = dbh_ptr->next) {
-			if (dbh_ptr->hash == hash && !dbh_ptr->use_count && !switch_test_flag(dbh_ptr, CDF_PRUNE) && 
+		for (dbh_ptr = bucket->head; dbh_ptr; dbh_ptr = dbh_ptr->bucket_next) {
+			if (dbh_ptr->hash == hash && !dbh_ptr->use_count && !switch_test_flag(dbh_ptr, CDF_PRUNE) && !strcasecmp(dbh_ptr->name, db_str) &&
 				switch_mutex_trylock(dbh_ptr->mutex) == SWITCH_STATUS_SUCCESS) {
 				r = dbh_ptr;
-			break;
+				break;
+			}
 		}
-	}	
 	}
-	
+
 	if (r) {
 		r->use_count++;
-		sql_manager.total_used_handles++;
-		r->hash = switch_ci_hashfunc_default(db_str, &hlen);
+		switch_atomic_inc(&sql_manager.total_used_handles);
 		r->thread_hash = thread_hash;
 		switch_set_string(r->last_user, user_str);
 	}
 
-	switch_mutex_unlock(sql_manager.dbh_mutex);
+	switch_mutex_unlock(bucket->mutex);
 
 	return r;
 	
@@ -225,6 +399,8 @@ SWITCH_DECLARE(switch_status_t) _switch_core_db_handle(switch_cache_db_handle_t
 static void sql_close(time_t prune)
 {
 	switch_cache_db_handle_t *dbh = NULL;
+	dbh_bucket_t *bucket;
+	switch_status_t got;
 	int locked = 0;
 
 	switch_mutex_lock(sql_manager.dbh_mutex);
@@ -238,11 +414,18 @@ static void sql_close(time_t prune)
 			diff = (time_t) prune - dbh->last_used;
 		}
 
+		bucket = dbh_bucket_of(dbh->hash);
+		switch_mutex_lock(bucket->mutex);
+
 		if (prune > 0 && (dbh->use_count || (diff < SQL_CACHE_TIMEOUT && !switch_test_flag(dbh, CDF_PRUNE)))) {
+			switch_mutex_unlock(bucket->mutex);
 			continue;
 		}
 
-		if (switch_mutex_trylock(dbh->mutex) == SWITCH_STATUS_SUCCESS) {
+		got = switch_mutex_trylock(dbh->mutex);
+		switch_mutex_unlock(bucket->mutex);
+
+		if (got == SWITCH_STATUS_SUCCESS) {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG10, "Dropping idle DB connection %s\n", dbh->name);
 
 			switch (dbh->type) {
@@ -253,6 +436,7 @@ static void sql_close(time_t prune)
 				break;
 			case SCDB_TYPE_CORE_DB:
 				{
+					stmt_cache_flush(dbh);
 					switch_core_db_close(dbh->native_handle.core_db_dbh);
 					dbh->native_handle.core_db_dbh = NULL;
 				}
@@ -295,20 +479,20 @@ SWITCH_DECLARE(void) switch_cache_db_flush_handles(void)
 SWITCH_DECLARE(void) switch_cache_db_release_db_handle(switch_cache_db_handle_t **dbh)
 {
 	if (dbh && *dbh) {
-		switch_mutex_lock(sql_manager.dbh_mutex);
+		dbh_bucket_t *bucket = dbh_bucket_of((*dbh)->hash);
+
+		switch_mutex_lock(bucket->mutex);
 		(*dbh)->last_used = switch_epoch_time_now(NULL);
 
 		(*dbh)->io_mutex = NULL;
 		
 		if ((*dbh)->use_count) {
-			if (--(*dbh)->use_count == 0) {
-				(*dbh)->thread_hash = 1;
-			}
+			(*dbh)->use_count--;
 		}
 		switch_mutex_unlock((*dbh)->mutex);
-		sql_manager.total_used_handles--;
+		switch_atomic_dec(&sql_manager.total_used_handles);
 		*dbh = NULL;
-		switch_mutex_unlock(sql_manager.dbh_mutex);
+		switch_mutex_unlock(bucket->mutex);
 	}
 }
 
@@ -336,7 +520,7 @@ SWITCH_DECLARE(switch_status_t) _switch_cache_db_get_db_handle(switch_cache_db_h
 	const char *db_user = NULL;
 	const char *db_pass = NULL;
 
-	while(runtime.max_db_handles && sql_manager.total_handles >= runtime.max_db_handles && sql_manager.total_used_handles >= sql_manager.total_handles) {
+	while(runtime.max_db_handles && sql_manager.total_handles >= runtime.max_db_handles && switch_atomic_read(&sql_manager.total_used_handles) >= sql_manager.total_handles) {
 		if (!waiting++) {
 			switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, NULL, SWITCH_LOG_WARNING, "Max handles %u exceeded, blocking....\n", 
 							  runtime.max_db_handles);
@@ -579,6 +763,7 @@ SWITCH_DECLARE(switch_status_t) switch_cache_db_execute_sql(switch_cache_db_hand
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	switch_mutex_t *io_mutex = dbh->io_mutex;
+	switch_time_t start = switch_micro_time_now();
 
 	if (io_mutex) switch_mutex_lock(io_mutex);
 
@@ -592,6 +777,8 @@ SWITCH_DECLARE(switch_status_t) switch_cache_db_execute_sql(switch_cache_db_hand
 
 	if (io_mutex) switch_mutex_unlock(io_mutex);
 
+	switch_core_session_record_phase(NULL, SWITCH_PHASE_SQL, start, 0);
+
 	return status;
 
 }
@@ -892,6 +1079,121 @@ SWITCH_DECLARE(switch_status_t) switch_cache_db_execute_sql_callback(switch_cach
 	return status;
 }
 
+#define SCDB_PREPARED_COLS 64
+
+SWITCH_DECLARE(switch_status_t) switch_cache_db_execute_prepared(switch_cache_db_handle_t *dbh, const char *sql,
+																 const switch_cache_db_arg_t *args, int argc,
+																 switch_core_db_callback_func_t callback, void *pdata, char **err)
+{
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	char *errmsg = NULL;
+	switch_mutex_t *io_mutex = dbh->io_mutex;
+	switch_bool_t fresh = SWITCH_FALSE;
+	scdb_stmt_t *slot;
+	int i, rc;
+
+	if (err) {
+		*err = NULL;
+	}
+
+	if (dbh->type == SCDB_TYPE_ODBC) {
+		char *rendered = prepared_render(sql, args, argc);
+
+		if (callback) {
+			status = switch_cache_db_execute_sql_callback(dbh, rendered, callback, pdata, err);
+		} else {
+			status = switch_cache_db_execute_sql_real(dbh, rendered, err);
+		}
+
+		switch_safe_free(rendered);
+		return status;
+	}
+
+	if (io_mutex) switch_mutex_lock(io_mutex);
+
+ again:
+
+	if (!(slot = stmt_cache_get(dbh, sql, fresh, &errmsg))) {
+		goto end;
+	}
+
+	for (i = 0; i < argc; i++) {
+		switch (args[i].type) {
+		case SCDB_ARG_TEXT:
+			switch_core_db_bind_text(slot->stmt, i + 1, args[i].text, -1, SWITCH_CORE_DB_STATIC);
+			break;
+		case SCDB_ARG_INT:
+			switch_core_db_bind_int(slot->stmt, i + 1, (int) args[i].num);
+			break;
+		case SCDB_ARG_INT64:
+			switch_core_db_bind_int64(slot->stmt, i + 1, args[i].num);
+			break;
+		case SCDB_ARG_DOUBLE:
+			switch_core_db_bind_double(slot->stmt, i + 1, args[i].dbl);
+			break;
+		default:
+			switch_core_db_bind_null(slot->stmt, i + 1);
+			break;
+		}
+	}
+
+	while ((rc = switch_core_db_step(slot->stmt)) == SWITCH_CORE_DB_ROW) {
+		char *cols[SCDB_PREPARED_COLS], *names[SCDB_PREPARED_COLS];
+		int ncol = switch_core_db_column_count(slot->stmt);
+
+		if (!callback) {
+			continue;
+		}
+
+		if (ncol > SCDB_PREPARED_COLS) {
+			ncol = SCDB_PREPARED_COLS;
+		}
+
+		for (i = 0; i < ncol; i++) {
+			cols[i] = (char *) switch_core_db_column_text(slot->stmt, i);
+			names[i] = (char *) switch_core_db_column_name(slot->stmt, i);
+		}
+
+		if (callback(pdata, ncol, cols, names)) {
+			rc = SWITCH_CORE_DB_DONE;
+			break;
+		}
+	}
+
+	/* statements from the legacy prepare only report a schema change on reset, prepare it again once */
+	if (switch_core_db_reset(slot->stmt) == SWITCH_CORE_DB_SCHEMA && !fresh) {
+		fresh = SWITCH_TRUE;
+		goto again;
+	}
+
+	/* the args belong to the caller, don't leave the statement pointing at them */
+	for (i = 0; i < argc; i++) {
+		switch_core_db_bind_null(slot->stmt, i + 1);
+	}
+
+	if (rc == SWITCH_CORE_DB_DONE) {
+		status = SWITCH_STATUS_SUCCESS;
+	} else {
+		errmsg = strdup(switch_str_nil(switch_core_db_errmsg(dbh->native_handle.core_db_dbh)));
+	}
+
+ end:
+
+	if (errmsg) {
+		dbh->last_used = switch_epoch_time_now(NULL) - (SQL_CACHE_TIMEOUT * 2);
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "SQL ERR: [%s] %s\n", sql, errmsg);
+		if (err) {
+			*err = errmsg;
+		} else {
+			free(errmsg);
+		}
+	}
+
+	if (io_mutex) switch_mutex_unlock(io_mutex);
+
+	return status;
+}
+
 SWITCH_DECLARE(switch_bool_t) switch_cache_db_test_reactive(switch_cache_db_handle_t *dbh,
 															const char *test_sql, const char *drop_sql, const char *reactive_sql)
 {
@@ -983,6 +1285,12 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_db_thread(switch_thread_t *threa
 	return NULL;
 }
 
+/* the core sql queue as a load source, full is where the thread starts pausing the producers */
+static uint32_t switch_core_sql_queue_load(void *user_data)
+{
+	return (uint32_t) (((switch_queue_size(sql_manager.sql_queue[0]) + switch_queue_size(sql_manager.sql_queue[1])) * 100) / SWITCH_SQL_QUEUE_PAUSE_LEN);
+}
+
 static void *SWITCH_THREAD_FUNC switch_core_sql_thread(switch_thread_t *thread, void *obj)
 {
 	void *pop = NULL;
@@ -1013,6 +1321,7 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_thread(switch_thread_t *thread,
 	}
 
 	sql_manager.thread_running = 1;
+	switch_core_add_load_source("core-sql-queue", switch_core_sql_queue_load, NULL);
 
 	switch_mutex_lock(sql_manager.cond_mutex);
 
@@ -1162,6 +1471,7 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_thread(switch_thread_t *thread,
 
 	free(sqlbuf);
 
+	switch_core_remove_load_source("core-sql-queue");
 	sql_manager.thread_running = 0;
 
 	switch_cache_db_release_db_handle(&sql_manager.event_db);
@@ -1169,6 +1479,753 @@ static void *SWITCH_THREAD_FUNC switch_core_sql_thread(switch_thread_t *thread,
 	return NULL;
 }
 
+/* 
+ * In memory copy of the channels and calls tables, kept by core_event_handler so "show channels" and "show calls"
+ * never have to touch the database.  Records are spread over a few independently locked hashes by uuid, and a
+ * thread never holds more than one stripe at a time.
+ */
+#define CHANNEL_STORE_STRIPES 16
+
+typedef enum {
+	CHANNEL_COL_UUID,
+	CHANNEL_COL_DIRECTION,
+	CHANNEL_COL_CREATED,
+	CHANNEL_COL_CREATED_EPOCH,
+	CHANNEL_COL_NAME,
+	CHANNEL_COL_STATE,
+	CHANNEL_COL_CID_NAME,
+	CHANNEL_COL_CID_NUM,
+	CHANNEL_COL_IP_ADDR,
+	CHANNEL_COL_DEST,
+	CHANNEL_COL_APPLICATION,
+	CHANNEL_COL_APPLICATION_DATA,
+	CHANNEL_COL_DIALPLAN,
+	CHANNEL_COL_CONTEXT,
+	CHANNEL_COL_READ_CODEC,
+	CHANNEL_COL_READ_RATE,
+	CHANNEL_COL_READ_BIT_RATE,
+	CHANNEL_COL_WRITE_CODEC,
+	CHANNEL_COL_WRITE_RATE,
+	CHANNEL_COL_WRITE_BIT_RATE,
+	CHANNEL_COL_SECURE,
+	CHANNEL_COL_HOSTNAME,
+	CHANNEL_COL_PRESENCE_ID,
+	CHANNEL_COL_PRESENCE_DATA,
+	CHANNEL_COL_CALLSTATE,
+	CHANNEL_COL_CALLEE_NAME,
+	CHANNEL_COL_CALLEE_NUM,
+	CHANNEL_COL_CALLEE_DIRECTION,
+	CHANNEL_COL_CALL_UUID,
+	CHANNEL_COL_SENT_CALLEE_NAME,
+	CHANNEL_COL_SENT_CALLEE_NUM,
+	CHANNEL_COL_MAX
+} channel_col_t;
+
+/* same names and order as the channels table */
+static char *CHANNEL_COL_NAMES[CHANNEL_COL_MAX] = {
+	"uuid", "direction", "created", "created_epoch", "name", "state", "cid_name", "cid_num", "ip_addr", "dest",
+	"application", "application_data", "dialplan", "context", "read_codec", "read_rate", "read_bit_rate",
+	"write_codec", "write_rate", "write_bit_rate", "secure", "hostname", "presence_id", "presence_data",
+	"callstate", "callee_name", "callee_num", "callee_direction", "call_uuid", "sent_callee_name", "sent_callee_num"
+};
+
+/* the columns of the basic_calls view, a is the caller leg and b the callee */
+static const channel_col_t BASIC_CALL_A_COLS[] = {
+	CHANNEL_COL_UUID, CHANNEL_COL_DIRECTION, CHANNEL_COL_CREATED, CHANNEL_COL_CREATED_EPOCH, CHANNEL_COL_NAME, CHANNEL_COL_STATE,
+	CHANNEL_COL_CID_NAME, CHANNEL_COL_CID_NUM, CHANNEL_COL_IP_ADDR, CHANNEL_COL_DEST, CHANNEL_COL_PRESENCE_ID, CHANNEL_COL_PRESENCE_DATA,
+	CHANNEL_COL_CALLSTATE, CHANNEL_COL_CALLEE_NAME, CHANNEL_COL_CALLEE_NUM, CHANNEL_COL_CALLEE_DIRECTION, CHANNEL_COL_CALL_UUID,
+	CHANNEL_COL_HOSTNAME, CHANNEL_COL_SENT_CALLEE_NAME, CHANNEL_COL_SENT_CALLEE_NUM
+};
+
+static const channel_col_t BASIC_CALL_B_COLS[] = {
+	CHANNEL_COL_UUID, CHANNEL_COL_DIRECTION, CHANNEL_COL_CREATED, CHANNEL_COL_CREATED_EPOCH, CHANNEL_COL_NAME, CHANNEL_COL_STATE,
+	CHANNEL_COL_CID_NAME, CHANNEL_COL_CID_NUM, CHANNEL_COL_IP_ADDR, CHANNEL_COL_DEST, CHANNEL_COL_PRESENCE_ID, CHANNEL_COL_PRESENCE_DATA,
+	CHANNEL_COL_CALLSTATE, CHANNEL_COL_CALLEE_NAME, CHANNEL_COL_CALLEE_NUM, CHANNEL_COL_CALLEE_DIRECTION,
+	CHANNEL_COL_SENT_CALLEE_NAME, CHANNEL_COL_SENT_CALLEE_NUM
+};
+
+#define BASIC_CALL_A_LEN (sizeof(BASIC_CALL_A_COLS) / sizeof(BASIC_CALL_A_COLS[0]))
+#define BASIC_CALL_B_LEN (sizeof(BASIC_CALL_B_COLS) / sizeof(BASIC_CALL_B_COLS[0]))
+#define BASIC_CALL_COLS (BASIC_CALL_A_LEN + BASIC_CALL_B_LEN + 1)
+
+static char *BASIC_CALL_NAMES[BASIC_CALL_COLS] = {
+	"uuid", "direction", "created", "created_epoch", "name", "state", "cid_name", "cid_num", "ip_addr", "dest",
+	"presence_id", "presence_data", "callstate", "callee_name", "callee_num", "callee_direction", "call_uuid",
+	"hostname", "sent_callee_name", "sent_callee_num",
+	"b_uuid", "b_direction", "b_created", "b_created_epoch", "b_name", "b_state", "b_cid_name", "b_cid_num", "b_ip_addr", "b_dest",
+	"b_presence_id", "b_presence_data", "b_callstate", "b_callee_name", "b_callee_num", "b_callee_direction",
+	"b_sent_callee_name", "b_sent_callee_num",
+	"call_created_epoch"
+};
+
+typedef struct store_channel {
+	/* NULL where the table would hold NULL */
+	char *col[CHANNEL_COL_MAX];
+	/* the row in the calls table: the callee when this is the caller leg, or the caller when this is the callee */
+	char *callee_uuid;
+	char *caller_uuid;
+	time_t call_created_epoch;
+} store_channel_t;
+
+typedef struct {
+	channel_col_t col;
+	const char *header;
+} store_map_t;
+
+static const store_map_t STORE_CODEC_MAP[] = {
+	{CHANNEL_COL_READ_CODEC, "channel-read-codec-name"},
+	{CHANNEL_COL_READ_RATE, "channel-read-codec-rate"},
+	{CHANNEL_COL_READ_BIT_RATE, "channel-read-codec-bit-rate"},
+	{CHANNEL_COL_WRITE_CODEC, "channel-write-codec-name"},
+	{CHANNEL_COL_WRITE_RATE, "channel-write-codec-rate"},
+	{CHANNEL_COL_WRITE_BIT_RATE, "channel-write-codec-bit-rate"}
+};
+
+static const store_map_t STORE_EXECUTE_MAP[] = {
+	{CHANNEL_COL_APPLICATION, "application"},
+	{CHANNEL_COL_APPLICATION_DATA, "application-data"},
+	{CHANNEL_COL_PRESENCE_ID, "channel-presence-id"},
+	{CHANNEL_COL_PRESENCE_DATA, "channel-presence-data"}
+};
+
+static const store_map_t STORE_ORIGINATE_MAP[] = {
+	{CHANNEL_COL_PRESENCE_ID, "channel-presence-id"},
+	{CHANNEL_COL_PRESENCE_DATA, "channel-presence-data"},
+	{CHANNEL_COL_CALL_UUID, "channel-call-uuid"}
+};
+
+static const store_map_t STORE_CALL_UPDATE_MAP[] = {
+	{CHANNEL_COL_CALLEE_NAME, "caller-callee-id-name"},
+	{CHANNEL_COL_CALLEE_NUM, "caller-callee-id-number"},
+	{CHANNEL_COL_SENT_CALLEE_NAME, "sent-callee-id-name"},
+	{CHANNEL_COL_SENT_CALLEE_NUM, "sent-callee-id-number"},
+	{CHANNEL_COL_CALLEE_DIRECTION, "direction"},
+	{CHANNEL_COL_CID_NAME, "caller-caller-id-name"},
+	{CHANNEL_COL_CID_NUM, "caller-caller-id-number"}
+};
+
+static const store_map_t STORE_CALLSTATE_MAP[] = {
+	{CHANNEL_COL_CALLSTATE, "channel-call-state"}
+};
+
+static const store_map_t STORE_STATE_MAP[] = {
+	{CHANNEL_COL_STATE, "channel-state"}
+};
+
+static const store_map_t STORE_ROUTING_MAP[] = {
+	{CHANNEL_COL_STATE, "channel-state"},
+	{CHANNEL_COL_CID_NAME, "caller-caller-id-name"},
+	{CHANNEL_COL_CID_NUM, "caller-caller-id-number"},
+	{CHANNEL_COL_CALLEE_NAME, "caller-callee-id-name"},
+	{CHANNEL_COL_CALLEE_NUM, "caller-callee-id-number"},
+	{CHANNEL_COL_SENT_CALLEE_NAME, "sent-callee-id-name"},
+	{CHANNEL_COL_SENT_CALLEE_NUM, "sent-callee-id-number"},
+	{CHANNEL_COL_IP_ADDR, "caller-network-addr"},
+	{CHANNEL_COL_DEST, "caller-destination-number"},
+	{CHANNEL_COL_DIALPLAN, "caller-dialplan"},
+	{CHANNEL_COL_CONTEXT, "caller-context"},
+	{CHANNEL_COL_PRESENCE_ID, "channel-presence-id"},
+	{CHANNEL_COL_PRESENCE_DATA, "channel-presence-data"}
+};
+
+static const store_map_t STORE_CREATE_MAP[] = {
+	{CHANNEL_COL_UUID, "unique-id"},
+	{CHANNEL_COL_DIRECTION, "call-direction"},
+	{CHANNEL_COL_CREATED, "event-date-local"},
+	{CHANNEL_COL_NAME, "channel-name"},
+	{CHANNEL_COL_STATE, "channel-state"},
+	{CHANNEL_COL_CALLSTATE, "channel-call-state"},
+	{CHANNEL_COL_DIALPLAN, "caller-dialplan"},
+	{CHANNEL_COL_CONTEXT, "caller-context"}
+};
+
+static struct {
+	switch_mutex_t *mutex[CHANNEL_STORE_STRIPES];
+	switch_hash_t *hash[CHANNEL_STORE_STRIPES];
+	int running;
+} channel_store;
+
+static uint32_t store_stripe(const char *uuid)
+{
+	switch_ssize_t len = -1;
+
+	return switch_hashfunc_default(uuid, &len) % CHANNEL_STORE_STRIPES;
+}
+
+static void store_set(store_channel_t *ch, channel_col_t col, const char *val)
+{
+	switch_safe_free(ch->col[col]);
+	ch->col[col] = strdup(switch_str_nil(val));
+}
+
+static void store_channel_free(store_channel_t **chp)
+{
+	store_channel_t *ch = *chp;
+	int i;
+
+	*chp = NULL;
+
+	for (i = 0; i < CHANNEL_COL_MAX; i++) {
+		switch_safe_free(ch->col[i]);
+	}
+
+	switch_safe_free(ch->callee_uuid);
+	switch_safe_free(ch->caller_uuid);
+	free(ch);
+}
+
+static void store_update(const char *uuid, switch_event_t *event, const store_map_t *map, int len)
+{
+	store_channel_t *ch;
+	uint32_t s;
+	int i;
+
+	if (zstr(uuid)) {
+		return;
+	}
+
+	s = store_stripe(uuid);
+
+	switch_mutex_lock(channel_store.mutex[s]);
+	if ((ch = switch_core_hash_find(channel_store.hash[s], uuid))) {
+		for (i = 0; i < len; i++) {
+			store_set(ch, map[i].col, switch_event_get_header_nil(event, map[i].header));
+		}
+	}
+	switch_mutex_unlock(channel_store.mutex[s]);
+}
+
+static void store_set_col(const char *uuid, channel_col_t col, const char *val)
+{
+	store_channel_t *ch;
+	uint32_t s;
+
+	if (zstr(uuid)) {
+		return;
+	}
+
+	s = store_stripe(uuid);
+
+	switch_mutex_lock(channel_store.mutex[s]);
+	if ((ch = switch_core_hash_find(channel_store.hash[s], uuid))) {
+		store_set(ch, col, val);
+	}
+	switch_mutex_unlock(channel_store.mutex[s]);
+}
+
+/* update channels set <col>=<val or the row's own uuid> where <col>=<match> */
+static void store_replace_all(channel_col_t col, const char *match, const char *val)
+{
+	switch_hash_index_t *hi;
+	void *v;
+	int s;
+
+	if (zstr(match)) {
+		return;
+	}
+
+	for (s = 0; s < CHANNEL_STORE_STRIPES; s++) {
+		switch_mutex_lock(channel_store.mutex[s]);
+		for (hi = switch_hash_first(NULL, channel_store.hash[s]); hi; hi = switch_hash_next(hi)) {
+			store_channel_t *ch;
+
+			switch_hash_this(hi, NULL, NULL, &v);
+			ch = (store_channel_t *) v;
+
+			if (ch->col[col] && !strcmp(ch->col[col], match)) {
+				store_set(ch, col, val ? val : ch->col[CHANNEL_COL_UUID]);
+			}
+		}
+		switch_mutex_unlock(channel_store.mutex[s]);
+	}
+}
+
+/* clear the caller or callee side of the call row on one leg, if it still points at the other */
+static void store_call_clear(const char *uuid, const char *other, switch_bool_t caller_side)
+{
+	store_channel_t *ch;
+	uint32_t s;
+	char **p;
+
+	if (zstr(uuid)) {
+		return;
+	}
+
+	s = store_stripe(uuid);
+
+	switch_mutex_lock(channel_store.mutex[s]);
+	if ((ch = switch_core_hash_find(channel_store.hash[s], uuid))) {
+		p = caller_side ? &ch->callee_uuid : &ch->caller_uuid;
+
+		if (*p && (!other || !strcmp(*p, other))) {
+			switch_safe_free(*p);
+			if (caller_side) {
+				ch->call_created_epoch = 0;
+			}
+		}
+	}
+	switch_mutex_unlock(channel_store.mutex[s]);
+}
+
+/* delete from calls where caller_uuid=<uuid> or callee_uuid=<uuid> */
+static void store_call_delete(const char *uuid)
+{
+	store_channel_t *ch;
+	char *callee = NULL, *caller = NULL;
+	uint32_t s;
+
+	if (zstr(uuid)) {
+		return;
+	}
+
+	s = store_stripe(uuid);
+
+	switch_mutex_lock(channel_store.mutex[s]);
+	if ((ch = switch_core_hash_find(channel_store.hash[s], uuid))) {
+		callee = ch->callee_uuid;
+		caller = ch->caller_uuid;
+		ch->callee_uuid = ch->caller_uuid = NULL;
+		ch->call_created_epoch = 0;
+	}
+	switch_mutex_unlock(channel_store.mutex[s]);
+
+	store_call_clear(callee, uuid, SWITCH_FALSE);
+	store_call_clear(caller, uuid, SWITCH_TRUE);
+
+	switch_safe_free(callee);
+	switch_safe_free(caller);
+}
+
+static void store_call_create(const char *a_uuid, const char *b_uuid)
+{
+	store_channel_t *ch;
+	uint32_t s;
+
+	if (zstr(a_uuid) || zstr(b_uuid)) {
+		return;
+	}
+
+	s = store_stripe(a_uuid);
+	switch_mutex_lock(channel_store.mutex[s]);
+	if ((ch = switch_core_hash_find(channel_store.hash[s], a_uuid))) {
+		switch_safe_free(ch->callee_uuid);
+		ch->callee_uuid = strdup(b_uuid);
+		ch->call_created_epoch = switch_epoch_time_now(NULL);
+	}
+	switch_mutex_unlock(channel_store.mutex[s]);
+
+	s = store_stripe(b_uuid);
+	switch_mutex_lock(channel_store.mutex[s]);
+	if ((ch = switch_core_hash_find(channel_store.hash[s], b_uuid))) {
+		switch_safe_free(ch->caller_uuid);
+		ch->caller_uuid = strdup(a_uuid);
+	}
+	switch_mutex_unlock(channel_store.mutex[s]);
+}
+
+static void store_insert(store_channel_t *ch)
+{
+	store_channel_t *old;
+	uint32_t s = store_stripe(ch->col[CHANNEL_COL_UUID]);
+
+	switch_mutex_lock(channel_store.mutex[s]);
+	if ((old = switch_core_hash_find(channel_store.hash[s], ch->col[CHANNEL_COL_UUID]))) {
+		switch_core_hash_delete(channel_store.hash[s], old->col[CHANNEL_COL_UUID]);
+		store_channel_free(&old);
+	}
+	switch_core_hash_insert(channel_store.hash[s], ch->col[CHANNEL_COL_UUID], ch);
+	switch_mutex_unlock(channel_store.mutex[s]);
+}
+
+static store_channel_t *store_remove(const char *uuid)
+{
+	store_channel_t *ch;
+	uint32_t s;
+
+	if (zstr(uuid)) {
+		return NULL;
+	}
+
+	s = store_stripe(uuid);
+
+	switch_mutex_lock(channel_store.mutex[s]);
+	if ((ch = switch_core_hash_find(channel_store.hash[s], uuid))) {
+		switch_core_hash_delete(channel_store.hash[s], uuid);
+	}
+	switch_mutex_unlock(channel_store.mutex[s]);
+
+	return ch;
+}
+
+static void store_clear(void)
+{
+	switch_hash_index_t *hi;
+	store_channel_t *ch;
+	void *v;
+	int s;
+
+	for (s = 0; s < CHANNEL_STORE_STRIPES; s++) {
+		switch_mutex_lock(channel_store.mutex[s]);
+		while ((hi = switch_hash_first(NULL, channel_store.hash[s]))) {
+			switch_hash_this(hi, NULL, NULL, &v);
+			ch = (store_channel_t *) v;
+			switch_core_hash_delete(channel_store.hash[s], ch->col[CHANNEL_COL_UUID]);
+			store_channel_free(&ch);
+		}
+		switch_mutex_unlock(channel_store.mutex[s]);
+	}
+}
+
+#define store_update_map(_uuid, _event, _map) store_update(_uuid, _event, _map, sizeof(_map) / sizeof(_map[0]))
+
+/* returns SWITCH_TRUE for the events whose SQL only touches the channels and calls tables */
+static switch_bool_t channel_store_event(switch_event_t *event)
+{
+	const char *uuid;
+	
+	if (!channel_store.running) {
+		return SWITCH_FALSE;
+	}
+
+	uuid = switch_event_get_header(event, "unique-id");
+
+	switch (event->event_id) {
+	case SWITCH_EVENT_CHANNEL_CREATE:
+		if (!zstr(uuid)) {
+			store_channel_t *ch;
+			char epoch[32];
+			int i;
+
+			switch_zmalloc(ch, sizeof(*ch));
+			for (i = 0; i < (int) (sizeof(STORE_CREATE_MAP) / sizeof(STORE_CREATE_MAP[0])); i++) {
+				store_set(ch, STORE_CREATE_MAP[i].col, switch_event_get_header_nil(event, STORE_CREATE_MAP[i].header));
+			}
+			switch_snprintf(epoch, sizeof(epoch), "%ld", (long) switch_epoch_time_now(NULL));
+			store_set(ch, CHANNEL_COL_CREATED_EPOCH, epoch);
+			store_set(ch, CHANNEL_COL_HOSTNAME, switch_core_get_switchname());
+			store_insert(ch);
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_DESTROY:
+		if (!zstr(uuid)) {
+			store_channel_t *ch;
+
+			store_call_delete(uuid);
+			if ((ch = store_remove(uuid))) {
+				store_channel_free(&ch);
+			}
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_UUID:
+		{
+			const char *old_uuid = switch_event_get_header(event, "old-unique-id");
+			store_channel_t *ch;
+
+			if (!zstr(uuid) && (ch = store_remove(old_uuid))) {
+				store_set(ch, CHANNEL_COL_UUID, uuid);
+				store_insert(ch);
+			}
+			store_replace_all(CHANNEL_COL_CALL_UUID, old_uuid, switch_str_nil(uuid));
+		}
+		break;
+	case SWITCH_EVENT_CODEC:
+		store_update_map(uuid, event, STORE_CODEC_MAP);
+		break;
+	case SWITCH_EVENT_CHANNEL_HOLD:
+	case SWITCH_EVENT_CHANNEL_UNHOLD:
+	case SWITCH_EVENT_CHANNEL_EXECUTE:
+		store_update_map(uuid, event, STORE_EXECUTE_MAP);
+		break;
+	case SWITCH_EVENT_CHANNEL_ORIGINATE:
+		store_update_map(uuid, event, STORE_ORIGINATE_MAP);
+		break;
+	case SWITCH_EVENT_CALL_UPDATE:
+		store_update_map(uuid, event, STORE_CALL_UPDATE_MAP);
+		break;
+	case SWITCH_EVENT_CHANNEL_CALLSTATE:
+		{
+			char *num = switch_event_get_header_nil(event, "channel-call-state-number");
+			switch_channel_callstate_t callstate = CCS_DOWN;
+
+			if (num) {
+				callstate = atoi(num);
+			}
+
+			if (callstate != CCS_DOWN && callstate != CCS_HANGUP) {
+				store_update_map(uuid, event, STORE_CALLSTATE_MAP);
+			}
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_STATE:
+		{
+			char *state = switch_event_get_header_nil(event, "channel-state-number");
+			switch_channel_state_t state_i = CS_DESTROY;
+
+			if (!zstr(state)) {
+				state_i = atoi(state);
+			}
+
+			switch (state_i) {
+			case CS_NEW:
+			case CS_DESTROY:
+			case CS_REPORTING:
+				break;
+			case CS_ROUTING:
+				store_update_map(uuid, event, STORE_ROUTING_MAP);
+				break;
+			default:
+				store_update_map(uuid, event, STORE_STATE_MAP);
+				break;
+			}
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_BRIDGE:
+		{
+			const char *a_uuid, *b_uuid, *call_uuid = switch_event_get_header_nil(event, "channel-call-uuid");
+
+			a_uuid = switch_event_get_header(event, "Bridge-A-Unique-ID");
+			b_uuid = switch_event_get_header(event, "Bridge-B-Unique-ID");
+
+			if (zstr(a_uuid) || zstr(b_uuid)) {
+				a_uuid = switch_event_get_header_nil(event, "caller-unique-id");
+				b_uuid = switch_event_get_header_nil(event, "other-leg-unique-id");
+			}
+
+			store_set_col(a_uuid, CHANNEL_COL_CALL_UUID, call_uuid);
+			store_set_col(b_uuid, CHANNEL_COL_CALL_UUID, call_uuid);
+			store_call_create(a_uuid, b_uuid);
+		}
+		break;
+	case SWITCH_EVENT_CHANNEL_UNBRIDGE:
+		store_replace_all(CHANNEL_COL_CALL_UUID, switch_event_get_header_nil(event, "channel-call-uuid"), NULL);
+		store_call_delete(switch_event_get_header_nil(event, "caller-unique-id"));
+		break;
+	case SWITCH_EVENT_CALL_SECURE:
+		{
+			const char *type = switch_event_get_header_nil(event, "secure_type");
+
+			if (!zstr(type)) {
+				store_set_col(switch_event_get_header_nil(event, "caller-unique-id"), CHANNEL_COL_SECURE, type);
+			}
+		}
+		break;
+	case SWITCH_EVENT_SHUTDOWN:
+		store_clear();
+		return SWITCH_FALSE;
+	default:
+		return SWITCH_FALSE;
+	}
+
+	return SWITCH_TRUE;
+}
+
+static void channel_store_start(void)
+{
+	int s;
+
+	for (s = 0; s < CHANNEL_STORE_STRIPES; s++) {
+		switch_mutex_init(&channel_store.mutex[s], SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
+		switch_core_hash_init(&channel_store.hash[s], sql_manager.memory_pool);
+	}
+
+	channel_store.running = 1;
+}
+
+static void channel_store_stop(void)
+{
+	int s;
+
+	if (!channel_store.running) {
+		return;
+	}
+
+	channel_store.running = 0;
+	store_clear();
+
+	for (s = 0; s < CHANNEL_STORE_STRIPES; s++) {
+		switch_core_hash_destroy(&channel_store.hash[s]);
+	}
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_core_channel_store_running(void)
+{
+	return channel_store.running ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+/* a case insensitive sql LIKE with % and _ */
+static switch_bool_t store_like(const char *str, const char *pat)
+{
+	for (; *pat; pat++, str++) {
+		if (*pat == '%') {
+			while (*pat == '%') {
+				pat++;
+			}
+			if (!*pat) {
+				return SWITCH_TRUE;
+			}
+			for (; *str; str++) {
+				if (store_like(str, pat)) {
+					return SWITCH_TRUE;
+				}
+			}
+			return SWITCH_FALSE;
+		}
+
+		if (!*str || (*pat != '_' && switch_tolower(*pat) != switch_tolower(*str))) {
+			return SWITCH_FALSE;
+		}
+	}
+
+	return *str ? SWITCH_FALSE : SWITCH_TRUE;
+}
+
+static int store_row_cmp(const void *a, const void *b)
+{
+	const store_channel_t *ca = *(const store_channel_t **) a, *cb = *(const store_channel_t **) b;
+	long ea = atol(switch_str_nil(ca->col[CHANNEL_COL_CREATED_EPOCH])), eb = atol(switch_str_nil(cb->col[CHANNEL_COL_CREATED_EPOCH]));
+
+	return ea < eb ? -1 : (ea > eb ? 1 : 0);
+}
+
+static int store_call_cmp(const void *a, const void *b)
+{
+	const store_channel_t *ca = *(const store_channel_t **) a, *cb = *(const store_channel_t **) b;
+
+	if (ca->call_created_epoch != cb->call_created_epoch) {
+		return ca->call_created_epoch < cb->call_created_epoch ? -1 : 1;
+	}
+
+	return store_row_cmp(a, b);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_channel_store_walk(switch_bool_t calls, const char *like, switch_core_db_callback_func_t callback, void *pArg)
+{
+	store_channel_t **rows = NULL;
+	switch_hash_t *by_uuid = NULL;
+	switch_memory_pool_t *pool = NULL;
+	switch_hash_index_t *hi;
+	char *pattern = NULL;
+	int count = 0, size = 0, s, i, j;
+	void *v;
+
+	if (!channel_store.running) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!zstr(like)) {
+		pattern = strchr(like, '%') ? strdup(like) : switch_mprintf("%%%s%%", like);
+	}
+
+	/* copy everything out first so the callback never runs under a stripe lock */
+	for (s = 0; s < CHANNEL_STORE_STRIPES; s++) {
+		switch_mutex_lock(channel_store.mutex[s]);
+		for (hi = switch_hash_first(NULL, channel_store.hash[s]); hi; hi = switch_hash_next(hi)) {
+			store_channel_t *ch, *copy;
+
+			switch_hash_this(hi, NULL, NULL, &v);
+			ch = (store_channel_t *) v;
+
+			if (count == size) {
+				store_channel_t **tmp;
+
+				size = size ? size * 2 : 64;
+				tmp = realloc(rows, sizeof(*rows) * size);
+				switch_assert(tmp);
+				rows = tmp;
+			}
+
+			switch_zmalloc(copy, sizeof(*copy));
+			for (i = 0; i < CHANNEL_COL_MAX; i++) {
+				if (ch->col[i]) {
+					copy->col[i] = strdup(ch->col[i]);
+				}
+			}
+			copy->callee_uuid = ch->callee_uuid ? strdup(ch->callee_uuid) : NULL;
+			copy->caller_uuid = ch->caller_uuid ? strdup(ch->caller_uuid) : NULL;
+			copy->call_created_epoch = ch->call_created_epoch;
+			rows[count++] = copy;
+		}
+		switch_mutex_unlock(channel_store.mutex[s]);
+	}
+
+	if (count) {
+		qsort(rows, count, sizeof(*rows), calls ? store_call_cmp : store_row_cmp);
+	}
+
+	if (calls) {
+		switch_core_new_memory_pool(&pool);
+		switch_core_hash_init(&by_uuid, pool);
+		for (i = 0; i < count; i++) {
+			switch_core_hash_insert(by_uuid, rows[i]->col[CHANNEL_COL_UUID], rows[i]);
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		store_channel_t *a = rows[i];
+
+		if (!calls) {
+			if (pattern && !store_like(switch_str_nil(a->col[CHANNEL_COL_UUID]), pattern) && !store_like(switch_str_nil(a->col[CHANNEL_COL_NAME]), pattern) &&
+				!store_like(switch_str_nil(a->col[CHANNEL_COL_CID_NAME]), pattern) && !store_like(switch_str_nil(a->col[CHANNEL_COL_CID_NUM]), pattern) &&
+				!store_like(switch_str_nil(a->col[CHANNEL_COL_PRESENCE_DATA]), pattern)) {
+				continue;
+			}
+
+			if (callback(pArg, CHANNEL_COL_MAX, a->col, CHANNEL_COL_NAMES)) {
+				break;
+			}
+		} else {
+			char *argv[BASIC_CALL_COLS] = { 0 };
+			store_channel_t *b = NULL;
+			char epoch[32];
+
+			/* like the view, callee legs only show up as the b side of their caller */
+			if (a->caller_uuid && !a->callee_uuid) {
+				continue;
+			}
+
+			if (a->callee_uuid) {
+				b = switch_core_hash_find(by_uuid, a->callee_uuid);
+			}
+
+			for (j = 0; j < (int) BASIC_CALL_A_LEN; j++) {
+				argv[j] = a->col[BASIC_CALL_A_COLS[j]];
+			}
+
+			if (b) {
+				for (j = 0; j < (int) BASIC_CALL_B_LEN; j++) {
+					argv[BASIC_CALL_A_LEN + j] = b->col[BASIC_CALL_B_COLS[j]];
+				}
+			}
+
+			if (a->callee_uuid) {
+				switch_snprintf(epoch, sizeof(epoch), "%ld", (long) a->call_created_epoch);
+				argv[BASIC_CALL_COLS - 1] = epoch;
+			}
+
+			if (callback(pArg, BASIC_CALL_COLS, argv, BASIC_CALL_NAMES)) {
+				break;
+			}
+		}
+	}
+
+	if (by_uuid) {
+		switch_core_hash_destroy(&by_uuid);
+	}
+
+	if (pool) {
+		switch_core_destroy_memory_pool(&pool);
+	}
+
+	for (i = 0; i < count; i++) {
+		store_channel_free(&rows[i]);
+	}
+
+	switch_safe_free(rows);
+	switch_safe_free(pattern);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static char *parse_presence_data_cols(switch_event_t *event)
 {
 	char *cols[128] = { 0 };
@@ -1226,6 +2283,11 @@ static void core_event_handler(switch_event_t *event)
 
 	switch_assert(event);
 
+	/* with the store serving channel lookups the tables are only a mirror, and an optional one */
+	if (channel_store_event(event) && !runtime.core_db_channels) {
+		return;
+	}
+
 	switch (event->event_id) {
 	case SWITCH_EVENT_ADD_SCHEDULE:
 		{
@@ -1960,11 +3022,15 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
 	switch_threadattr_t *thd_attr;
 	switch_cache_db_handle_t *dbh;
 	uint32_t sanity = 400;
+	int i;
 
 	sql_manager.memory_pool = pool;
 	sql_manager.manage = manage;
 
 	switch_mutex_init(&sql_manager.dbh_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
+	for (i = 0; i < SWITCH_DBH_BUCKETS; i++) {
+		switch_mutex_init(&sql_manager.dbh_bucket[i].mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
+	}
 	switch_mutex_init(&sql_manager.io_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
 	switch_mutex_init(&sql_manager.cond_mutex, SWITCH_MUTEX_NESTED, sql_manager.memory_pool);
 
@@ -2123,8 +3189,11 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
  skip:
 
 	if (sql_manager.manage) {
-		if (switch_event_bind_removable("core_db", SWITCH_EVENT_ALL, SWITCH_EVENT_SUBCLASS_ANY,
-										core_event_handler, NULL, &sql_manager.event_node) != SWITCH_STATUS_SUCCESS) {
+		channel_store_start();
+
+		/* the db writer is the slowest consumer we have, give it its own queue so it can't hold up other bindings */
+		if (switch_event_bind_queued("core_db", SWITCH_EVENT_ALL, SWITCH_EVENT_SUBCLASS_ANY,
+									 core_event_handler, NULL, 0, SWITCH_EVENT_QUEUE_BLOCK, &sql_manager.event_node) != SWITCH_STATUS_SUCCESS) {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind event handler!\n");
 		}
 
@@ -2153,6 +3222,7 @@ void switch_core_sqldb_stop(void)
 	switch_status_t st;
 
 	switch_event_unbind(&sql_manager.event_node);
+	channel_store_stop();
 
 	if (sql_manager.thread && sql_manager.thread_running) {
 
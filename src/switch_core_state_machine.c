@@ -104,6 +104,7 @@ static void switch_core_standard_on_routing(switch_core_session_t *session)
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "%s Standard ROUTING\n", switch_channel_get_name(session->channel));
 
 	switch_channel_set_variable(session->channel, "call_uuid", switch_core_session_get_uuid(session));
+	switch_core_session_record_phase(session, SWITCH_PHASE_ROUTE, 0, 0);
 		
 	if ((switch_channel_test_flag(session->channel, CF_ANSWERED) ||
 		 switch_channel_test_flag(session->channel, CF_EARLY_MEDIA) ||
@@ -118,6 +119,7 @@ static void switch_core_standard_on_routing(switch_core_session_t *session)
 	} else {
 		char *dp[25];
 		int argc, x, count = 0;
+		switch_time_t hunt_start;
 
 		if ((extension = switch_channel_get_queued_extension(session->channel))) {
 			switch_channel_set_caller_extension(session->channel, extension);
@@ -146,7 +148,9 @@ static void switch_core_standard_on_routing(switch_core_session_t *session)
 
 					count++;
 
+					hunt_start = switch_micro_time_now();
 					extension = dialplan_interface->hunt_function(session, dparg, NULL);
+					switch_core_session_record_phase(session, SWITCH_PHASE_DIALPLAN, hunt_start, 0);
 					UNPROTECT_INTERFACE(dialplan_interface);
 
 					if (extension) {
@@ -289,7 +293,7 @@ void switch_core_state_machine_init(switch_memory_pool_t *pool)
 	return;
 }
 
-#define STATE_MACRO(__STATE, __STATE_STR)						do {	\
+#define STATE_MACRO(__STATE, __STATE_STR, __SHN)				do {	\
 		midstate = state;												\
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "(%s) State %s\n", switch_channel_get_name(session->channel), __STATE_STR);	\
 		if (!driver_state_handler->on_##__STATE || (driver_state_handler->on_##__STATE(session) == SWITCH_STATUS_SUCCESS \
@@ -309,11 +313,9 @@ void switch_core_state_machine_init(switch_memory_pool_t *pool)
 			index = 0;													\
 			if (!proceed) global_proceed = 0;							\
 			proceed = 1;												\
-			while (do_extra_handlers && proceed && (application_state_handler = switch_core_get_state_handler(index++)) != 0) { \
-				if (!application_state_handler || !application_state_handler->on_##__STATE || \
-					(application_state_handler->on_##__STATE &&			\
-					 application_state_handler->on_##__STATE(session) == SWITCH_STATUS_SUCCESS \
-					 )) {												\
+			/* only the global handlers that implement this state */	\
+			while (do_extra_handlers && proceed && (global_state_handler = runtime.state_dispatch[__SHN][index++]) != 0) { \
+				if (global_state_handler(session) == SWITCH_STATUS_SUCCESS) { \
 					proceed++;											\
 					continue;											\
 				} else {												\
@@ -335,6 +337,7 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 	const switch_endpoint_interface_t *endpoint_interface;
 	const switch_state_handler_table_t *driver_state_handler = NULL;
 	const switch_state_handler_table_t *application_state_handler = NULL;
+	switch_state_handler_t global_state_handler = NULL;
 	int silly = 0;
 	uint32_t new_loops = 60000;
 
@@ -421,7 +424,7 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 				{
 					switch_event_t *event;
 
-					STATE_MACRO(init, "INIT");
+					STATE_MACRO(init, "INIT", SWITCH_SHN_ON_INIT);
 					
 					if (switch_event_create(&event, SWITCH_EVENT_CHANNEL_CREATE) == SWITCH_STATUS_SUCCESS) {
 						switch_channel_event_set_data(session->channel, event);
@@ -430,29 +433,29 @@ SWITCH_DECLARE(void) switch_core_session_run(switch_core_session_t *session)
 				}
 				break;
 			case CS_ROUTING:	/* Look for a dialplan and find something to do */
-				STATE_MACRO(routing, "ROUTING");
+				STATE_MACRO(routing, "ROUTING", SWITCH_SHN_ON_ROUTING);
 				break;
 			case CS_RESET:		/* Reset */
-				STATE_MACRO(reset, "RESET");
+				STATE_MACRO(reset, "RESET", SWITCH_SHN_ON_RESET);
 				break;
 				/* These other states are intended for prolonged durations so we do not signal lock for them */
 			case CS_EXECUTE:	/* Execute an Operation */
-				STATE_MACRO(execute, "EXECUTE");
+				STATE_MACRO(execute, "EXECUTE", SWITCH_SHN_ON_EXECUTE);
 				break;
 			case CS_EXCHANGE_MEDIA:	/* loop all data back to source */
-				STATE_MACRO(exchange_media, "EXCHANGE_MEDIA");
+				STATE_MACRO(exchange_media, "EXCHANGE_MEDIA", SWITCH_SHN_ON_EXCHANGE_MEDIA);
 				break;
 			case CS_SOFT_EXECUTE:	/* send/recieve data to/from another channel */
-				STATE_MACRO(soft_execute, "SOFT_EXECUTE");
+				STATE_MACRO(soft_execute, "SOFT_EXECUTE", SWITCH_SHN_ON_SOFT_EXECUTE);
 				break;
 			case CS_PARK:		/* wait in limbo */
-				STATE_MACRO(park, "PARK");
+				STATE_MACRO(park, "PARK", SWITCH_SHN_ON_PARK);
 				break;
 			case CS_CONSUME_MEDIA:	/* wait in limbo */
-				STATE_MACRO(consume_media, "CONSUME_MEDIA");
+				STATE_MACRO(consume_media, "CONSUME_MEDIA", SWITCH_SHN_ON_CONSUME_MEDIA);
 				break;
 			case CS_HIBERNATE:	/* sleep */
-				STATE_MACRO(hibernate, "HIBERNATE");
+				STATE_MACRO(hibernate, "HIBERNATE", SWITCH_SHN_ON_HIBERNATE);
 				break;
 			case CS_NONE:
 				abort();
@@ -505,6 +508,7 @@ SWITCH_DECLARE(void) switch_core_session_destroy_state(switch_core_session_t *se
 	const switch_endpoint_interface_t *endpoint_interface;
 	const switch_state_handler_table_t *driver_state_handler = NULL;
 	const switch_state_handler_table_t *application_state_handler = NULL;
+	switch_state_handler_t global_state_handler = NULL;
 	int proceed = 1;
 	int global_proceed = 1;
 	int do_extra_handlers = 1;
@@ -524,7 +528,7 @@ SWITCH_DECLARE(void) switch_core_session_destroy_state(switch_core_session_t *se
 	driver_state_handler = endpoint_interface->state_handler;
 	switch_assert(driver_state_handler != NULL);
 
-	STATE_MACRO(destroy, "DESTROY");
+	STATE_MACRO(destroy, "DESTROY", SWITCH_SHN_ON_DESTROY);
 
 	return;
 }
@@ -583,6 +587,7 @@ SWITCH_DECLARE(void) switch_core_session_hangup_state(switch_core_session_t *ses
 	const switch_endpoint_interface_t *endpoint_interface;
 	const switch_state_handler_table_t *driver_state_handler = NULL;
 	const switch_state_handler_table_t *application_state_handler = NULL;
+	switch_state_handler_t global_state_handler = NULL;
 	const char *hook_var;
 	int use_session = 0;
 
@@ -611,6 +616,7 @@ SWITCH_DECLARE(void) switch_core_session_hangup_state(switch_core_session_t *ses
 	switch_assert(driver_state_handler != NULL);
 
 	switch_channel_set_hangup_time(session->channel);
+	switch_core_session_latency_report(session);
 
 	switch_core_media_bug_remove_all(session);
 
@@ -622,7 +628,7 @@ SWITCH_DECLARE(void) switch_core_session_hangup_state(switch_core_session_t *ses
 
 	switch_channel_set_timestamps(session->channel);
 
-	STATE_MACRO(hangup, "HANGUP");
+	STATE_MACRO(hangup, "HANGUP", SWITCH_SHN_ON_HANGUP);
 
 	if ((hook_var = switch_channel_get_variable(session->channel, SWITCH_API_HANGUP_HOOK_VARIABLE))) {
 
@@ -637,12 +643,62 @@ SWITCH_DECLARE(void) switch_core_session_hangup_state(switch_core_session_t *ses
 
 }
 
+/* the causes a call normally ends with, anything else is worth a look at the trace */
+static switch_bool_t trace_cause_failed(switch_call_cause_t cause)
+{
+	switch (cause) {
+	case SWITCH_CAUSE_NONE:
+	case SWITCH_CAUSE_NORMAL_CLEARING:
+	case SWITCH_CAUSE_USER_BUSY:
+	case SWITCH_CAUSE_NO_USER_RESPONSE:
+	case SWITCH_CAUSE_NO_ANSWER:
+	case SWITCH_CAUSE_ORIGINATOR_CANCEL:
+	case SWITCH_CAUSE_LOSE_RACE:
+	case SWITCH_CAUSE_PICKED_OFF:
+	case SWITCH_CAUSE_ATTENDED_TRANSFER:
+	case SWITCH_CAUSE_BLIND_TRANSFER:
+	case SWITCH_CAUSE_SUCCESS:
+		return SWITCH_FALSE;
+	default:
+		return SWITCH_TRUE;
+	}
+}
+
+static void trace_report(switch_core_session_t *session, switch_call_cause_t cause)
+{
+	switch_stream_handle_t stream = { 0 };
+	const char *var = switch_channel_get_variable(session->channel, "session_trace_dump");
+
+	if (!session->trace) {
+		return;
+	}
+
+	if (var) {
+		if (!switch_true(var)) {
+			return;
+		}
+	} else if (runtime.session_trace_dump == SWITCH_TRACE_DUMP_NEVER ||
+			   (runtime.session_trace_dump == SWITCH_TRACE_DUMP_FAILED && !trace_cause_failed(cause))) {
+		return;
+	}
+
+	SWITCH_STANDARD_STREAM(stream);
+
+	if (switch_core_session_trace_dump(session, &stream) == SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "%s ended with %s, session trace:\n%s",
+						  switch_channel_get_name(session->channel), switch_channel_cause2str(cause), (char *) stream.data);
+	}
+
+	switch_safe_free(stream.data);
+}
+
 SWITCH_DECLARE(void) switch_core_session_reporting_state(switch_core_session_t *session)
 {
 	switch_channel_state_t state = switch_channel_get_state(session->channel), midstate = state;
 	const switch_endpoint_interface_t *endpoint_interface;
 	const switch_state_handler_table_t *driver_state_handler = NULL;
 	const switch_state_handler_table_t *application_state_handler = NULL;
+	switch_state_handler_t global_state_handler = NULL;
 	int proceed = 1;
 	int global_proceed = 1;
 	int do_extra_handlers = 1;
@@ -682,7 +738,9 @@ SWITCH_DECLARE(void) switch_core_session_reporting_state(switch_core_session_t *
 		}
 	}
 
-	STATE_MACRO(reporting, "REPORTING");
+	STATE_MACRO(reporting, "REPORTING", SWITCH_SHN_ON_REPORTING);
+
+	trace_report(session, cause);
 
 	if ((hook_var = switch_channel_get_variable(session->channel, SWITCH_API_REPORTING_HOOK_VARIABLE))) {
 
@@ -56,6 +56,7 @@ SWITCH_DECLARE_CONSTRUCTOR EventConsumer::EventConsumer(const char *event_name,
 	switch_core_new_memory_pool(&pool);	
 	switch_queue_create(&events, 5000, pool);
 	node_index = 0;
+	batch_len = 0;
 	
 	if (!zstr(event_name)) {
 		bind(event_name, subclass_name);
@@ -108,6 +109,96 @@ SWITCH_DECLARE(Event *) EventConsumer::pop(int block, int timeout)
 	return ret;
 }
 
+void EventConsumer::free_batch(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < batch_len; i++) {
+		if (batch[i]) {
+			switch_event_destroy(&batch[i]);
+		}
+	}
+
+	batch_len = 0;
+}
+
+switch_event_t *EventConsumer::batch_get(int index)
+{
+	if (index < 0 || (uint32_t) index >= batch_len) {
+		return NULL;
+	}
+
+	return batch[index];
+}
+
+SWITCH_DECLARE(int) EventConsumer::popBatch(int max, int timeout)
+{
+	void *pop = NULL;
+	switch_time_t end = 0, now;
+
+	free_batch();
+
+	if (max <= 0 || max > EVENT_CONSUMER_BATCH_MAX) {
+		max = EVENT_CONSUMER_BATCH_MAX;
+	}
+
+	if (timeout > 0) {
+		end = switch_micro_time_now() + (switch_time_t) timeout * 1000;
+	}
+
+	while (batch_len < (uint32_t) max) {
+		pop = NULL;
+
+		if (switch_queue_trypop(events, &pop) != SWITCH_STATUS_SUCCESS || !pop) {
+			if (!end || (now = switch_micro_time_now()) >= end) {
+				break;
+			}
+
+			if (switch_queue_pop_timeout(events, &pop, (switch_interval_time_t) (end - now)) != SWITCH_STATUS_SUCCESS || !pop) {
+				break;
+			}
+		}
+
+		batch[batch_len++] = (switch_event_t *) pop;
+	}
+
+	return (int) batch_len;
+}
+
+SWITCH_DECLARE(const char *) EventConsumer::batchHeader(int index, const char *header_name)
+{
+	switch_event_t *event = batch_get(index);
+
+	return event && header_name ? switch_event_get_header(event, header_name) : NULL;
+}
+
+SWITCH_DECLARE(const char *) EventConsumer::batchBody(int index)
+{
+	switch_event_t *event = batch_get(index);
+
+	return event ? switch_event_get_body(event) : NULL;
+}
+
+SWITCH_DECLARE(const char *) EventConsumer::batchType(int index)
+{
+	switch_event_t *event = batch_get(index);
+
+	return event ? switch_event_name(event->event_id) : NULL;
+}
+
+SWITCH_DECLARE(Event *) EventConsumer::batchEvent(int index)
+{
+	switch_event_t *event = batch_get(index);
+
+	if (!event) {
+		return NULL;
+	}
+
+	batch[index] = NULL;
+
+	return new Event(event, 1);
+}
+
 SWITCH_DECLARE_CONSTRUCTOR EventConsumer::~EventConsumer()
 {
 	uint32_t i;
@@ -116,6 +207,8 @@ SWITCH_DECLARE_CONSTRUCTOR EventConsumer::~EventConsumer()
 		switch_event_unbind(&enodes[i]);
 	}
 
+	free_batch();
+
 	if (events) {
 		switch_queue_interrupt_all(events);
 	}
@@ -676,6 +769,68 @@ SWITCH_DECLARE(void) CoreSession::execute(const char *app, const char *data)
 	end_allow_threads();
 }
 
+SWITCH_DECLARE(const char *) CoreSession::executeAsync(const char *app, const char *data, const char *tag)
+{
+	this_check(NULL);
+	sanity_check(NULL);
+
+	if (zstr(app)) {
+		return NULL;
+	}
+
+	if (zstr(tag)) {
+		switch_uuid_str(async_tag, sizeof(async_tag));
+	} else {
+		switch_copy_string(async_tag, tag, sizeof(async_tag));
+	}
+
+	if (switch_core_session_execute_application_async_uuid(session, app, data, async_tag) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	/* the dialplan hangs up once it runs out of applications, wait in park for the queue instead */
+	if (switch_channel_get_state(channel) == CS_EXECUTE && switch_channel_up(channel)) {
+		switch_channel_set_state(channel, CS_PARK);
+	}
+
+	return async_tag;
+}
+
+SWITCH_DECLARE(const char *) CoreSession::streamFileAsync(char *file, const char *tag)
+{
+	return executeAsync("playback", file, tag);
+}
+
+SWITCH_DECLARE(const char *) CoreSession::playAndGetDigitsAsync(int min_digits, 
+																int max_digits, 
+																int max_tries, 
+																int timeout, 
+																char *terminators, 
+																char *audio_files, 
+																char *bad_input_audio_files,
+																char *digits_regex,
+																const char *var_name,
+																int digit_timeout,
+																const char *tag)
+{
+	char *data;
+	const char *r;
+
+	this_check(NULL);
+	sanity_check(NULL);
+
+	/* play_and_get_digits splits on spaces so every argument needs something in it */
+	data = switch_mprintf("%d %d %d %d %s %s %s %s %s %d", min_digits, max_digits, max_tries, timeout,
+						  zstr(terminators) ? "#" : terminators, audio_files,
+						  zstr(bad_input_audio_files) ? "silence_stream://250" : bad_input_audio_files,
+						  zstr(var_name) ? "async_digits" : var_name, zstr(digits_regex) ? ".*" : digits_regex, digit_timeout);
+
+	r = executeAsync("play_and_get_digits", data, tag);
+	switch_safe_free(data);
+
+	return r;
+}
+
 SWITCH_DECLARE(void) CoreSession::setDTMFCallback(void *cbfunc, char *funcargs) {
 
 	this_check_void();
@@ -37,6 +37,10 @@
 //#define SWITCH_EVENT_RECYCLE
 #define DISPATCH_QUEUE_LEN 100
 //#define DEBUG_DISPATCH_QUEUES
+#define EVENT_INDEX_THRESHOLD 16
+#define EVENT_INDEX_BUCKETS 128
+#define EVENT_ARENA_BLOCK 4096
+#define EVENT_LATENCY_BUCKETS 6
 
 /*! \brief A node to store binded events */
 struct switch_event_node {
@@ -50,10 +54,40 @@ struct switch_event_node {
 	switch_event_callback_t callback;
 	/*! private data */
 	void *user_data;
+	/*! private delivery queue for bindings that run on their own thread */
+	switch_queue_t *queue;
+	/*! what to do with an event when the private queue is full */
+	switch_event_queue_policy_t policy;
+	/*! events discarded because the private queue was full */
+	uint32_t dropped;
+	/*! callback invocations and the time spent in them, in microseconds */
+	uint64_t calls;
+	switch_time_t callback_time;
+	switch_time_t callback_max;
+	switch_thread_t *thread;
+	switch_mutex_t *mutex;
+	switch_memory_pool_t *pool;
 	struct switch_event_node *next;
 };
 
+/*! \brief A block of memory owned by one event, carved up for its headers and strings */
+struct switch_event_arena {
+	struct switch_event_arena *next;
+	switch_size_t size;
+	switch_size_t used;
+	char *data;
+};
+
 /*! \brief A registered custom event subclass  */
+/*! \brief Frozen headers shared by reference between events */
+struct switch_event_snapshot {
+	/*! the headers, already carrying the prefix */
+	switch_event_t *event;
+	char *prefix;
+	switch_size_t prefix_len;
+	int refs;
+};
+
 struct switch_event_subclass {
 	/*! the owner of the subclass */
 	char *owner;
@@ -83,6 +117,24 @@ static int THREAD_COUNT = 0;
 static int DISPATCH_THREAD_COUNT = 0;
 static int SYSTEM_RUNNING = 0;
 static uint64_t EVENT_SEQUENCE_NR = 0;
+/* upper bounds (usec) of the enqueue to delivery latency buckets, the last one is open ended */
+static const switch_time_t EVENT_LATENCY_LIMITS[EVENT_LATENCY_BUCKETS - 1] = { 100, 1000, 10000, 100000, 1000000 };
+static const char *EVENT_LATENCY_NAMES[EVENT_LATENCY_BUCKETS] = { "100us", "1ms", "10ms", "100ms", "1s", "inf" };
+
+typedef struct {
+	uint64_t fired;
+	uint64_t delivered;
+	uint64_t dropped;
+	uint64_t latency[EVENT_LATENCY_BUCKETS];
+	switch_time_t latency_total;
+	switch_time_t latency_max;
+} switch_event_stats_t;
+
+static switch_event_stats_t EVENT_STATS[SWITCH_EVENT_ALL + 1];
+static switch_mutex_t *STATS_MUTEX = NULL;
+static switch_mutex_t *SNAPSHOT_MUTEX = NULL;
+
+static switch_slab_t *EVENT_HEADER_SLAB = NULL;
 #ifdef SWITCH_EVENT_RECYCLE
 static switch_queue_t *EVENT_RECYCLE_QUEUE = NULL;
 static switch_queue_t *EVENT_HEADER_RECYCLE_QUEUE = NULL;
@@ -238,6 +290,7 @@ static void *SWITCH_THREAD_FUNC switch_event_dispatch_thread(switch_thread_t *th
 {
 	switch_queue_t *queue = (switch_queue_t *) obj;
 	int my_id = 0;
+	char load_name[32];
 
 	switch_mutex_lock(EVENT_QUEUE_MUTEX);
 	THREAD_COUNT++;
@@ -251,7 +304,10 @@ static void *SWITCH_THREAD_FUNC switch_event_dispatch_thread(switch_thread_t *th
 
 	EVENT_DISPATCH_QUEUE_RUNNING[my_id] = 1;
 	switch_mutex_unlock(EVENT_QUEUE_MUTEX);
-	
+
+	switch_snprintf(load_name, sizeof(load_name), "event-dispatch-%d", my_id);
+	switch_core_add_thread_load_source(load_name);
+	switch_core_thread_set_role_affinity(SWITCH_THREAD_ROLE_EVENT);
 
 	for (;;) {
 		void *pop = NULL;
@@ -274,6 +330,8 @@ static void *SWITCH_THREAD_FUNC switch_event_dispatch_thread(switch_thread_t *th
 	}
 
 
+	switch_core_remove_load_source(load_name);
+
 	switch_mutex_lock(EVENT_QUEUE_MUTEX);
 	EVENT_DISPATCH_QUEUE_RUNNING[my_id] = 0;
 	THREAD_COUNT--;
@@ -312,6 +370,12 @@ static switch_status_t switch_event_queue_dispatch_event(switch_event_t **eventp
 		switch_mutex_unlock(EVENT_QUEUE_MUTEX);
 
 		*eventp = NULL;
+		event->queued = switch_time_ref();
+
+		switch_mutex_lock(STATS_MUTEX);
+		EVENT_STATS[event->event_id].fired++;
+		switch_mutex_unlock(STATS_MUTEX);
+
 		switch_queue_push(EVENT_DISPATCH_QUEUE, event);
 		event = NULL;
 		
@@ -320,18 +384,154 @@ static switch_status_t switch_event_queue_dispatch_event(switch_event_t **eventp
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static void switch_event_node_callback(switch_event_node_t *node, switch_event_t *event)
+{
+	switch_time_t start = switch_time_ref(), spent;
+
+	node->callback(event);
+
+	spent = switch_time_ref() - start;
+
+	switch_mutex_lock(STATS_MUTEX);
+	node->calls++;
+	node->callback_time += spent;
+	if (spent > node->callback_max) {
+		node->callback_max = spent;
+	}
+	switch_mutex_unlock(STATS_MUTEX);
+}
+
+static void *SWITCH_THREAD_FUNC switch_event_node_thread(switch_thread_t *thread, void *obj)
+{
+	switch_event_node_t *node = (switch_event_node_t *) obj;
+	void *pop = NULL;
+
+	for (;;) {
+		switch_event_t *event;
+
+		if (switch_queue_pop(node->queue, &pop) != SWITCH_STATUS_SUCCESS) {
+			continue;
+		}
+
+		if (!pop) {
+			break;
+		}
+
+		event = (switch_event_t *) pop;
+		switch_event_node_callback(node, event);
+		switch_event_destroy(&event);
+	}
+
+	return NULL;
+}
+
+static void switch_event_node_queue(switch_event_node_t *node, switch_event_t *event)
+{
+	switch_event_t *clone = NULL;
+	uint32_t dropped = 0;
+
+	if (switch_event_dup(&clone, event) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	clone->bind_user_data = node->user_data;
+
+	if (node->policy == SWITCH_EVENT_QUEUE_BLOCK) {
+		switch_queue_push(node->queue, clone);
+		return;
+	}
+
+	if (switch_queue_trypush(node->queue, clone) == SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	switch_event_destroy(&clone);
+
+	switch_mutex_lock(node->mutex);
+	dropped = ++node->dropped;
+	switch_mutex_unlock(node->mutex);
+
+	switch_mutex_lock(STATS_MUTEX);
+	EVENT_STATS[event->event_id].dropped++;
+	switch_mutex_unlock(STATS_MUTEX);
+
+	if (dropped == 1 || !(dropped % 1000)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Event queue for binding %s is full, %u event(s) dropped so far\n",
+						  node->id, dropped);
+	}
+}
+
+static void switch_event_node_destroy(switch_event_node_t **nodep)
+{
+	switch_event_node_t *node = *nodep;
+
+	*nodep = NULL;
+
+	if (node->queue) {
+		switch_status_t st;
+		void *pop = NULL;
+
+		switch_queue_push(node->queue, NULL);
+		switch_thread_join(&st, node->thread);
+
+		while (switch_queue_trypop(node->queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			switch_event_t *event = (switch_event_t *) pop;
+
+			if (event) {
+				switch_event_destroy(&event);
+			}
+		}
+
+		if (node->dropped) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Event binding %s dropped %u event(s) in total\n", node->id, node->dropped);
+		}
+
+		switch_core_destroy_memory_pool(&node->pool);
+	}
+
+	FREE(node->subclass_name);
+	FREE(node->id);
+	FREE(node);
+}
+
 SWITCH_DECLARE(void) switch_event_deliver(switch_event_t **event)
 {
 	switch_event_types_t e;
 	switch_event_node_t *node;
+	int matched = 0;
+
+	if ((*event)->queued) {
+		switch_event_stats_t *stats = &EVENT_STATS[(*event)->event_id];
+		switch_time_t latency = switch_time_ref() - (*event)->queued;
+		int b;
+
+		for (b = 0; b < EVENT_LATENCY_BUCKETS - 1 && latency >= EVENT_LATENCY_LIMITS[b]; b++);
+
+		switch_mutex_lock(STATS_MUTEX);
+		stats->delivered++;
+		stats->latency[b]++;
+		stats->latency_total += latency;
+		if (latency > stats->latency_max) {
+			stats->latency_max = latency;
+		}
+		switch_mutex_unlock(STATS_MUTEX);
+	}
 
 	if (SYSTEM_RUNNING) {
 		switch_thread_rwlock_rdlock(RWLOCK);
 		for (e = (*event)->event_id;; e = SWITCH_EVENT_ALL) {
 			for (node = EVENT_NODES[e]; node; node = node->next) {
 				if (switch_events_match(*event, node)) {
+					/* nobody has to pay for the snapshot headers of an event nobody listens to */
+					if (!matched++) {
+						switch_event_expand_snapshot(*event);
+					}
+					if (node->queue) {
+						switch_event_node_queue(node, *event);
+						continue;
+					}
 					(*event)->bind_user_data = node->user_data;
-					node->callback(*event);
+					switch_event_node_callback(node, *event);
 				}
 			}
 
@@ -350,6 +550,236 @@ SWITCH_DECLARE(switch_status_t) switch_event_running(void)
 	return SYSTEM_RUNNING ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
 }
 
+typedef struct {
+	uint64_t calls;
+	uint32_t dropped;
+	uint32_t queued;
+	switch_time_t callback_time;
+	switch_time_t callback_max;
+} binding_stats_t;
+
+/* sum the callback counters of every binding by the id (usually the module name) it was bound under */
+static switch_hash_t *binding_stats(switch_memory_pool_t *pool)
+{
+	switch_hash_t *hash = NULL;
+	switch_event_types_t e;
+	switch_event_node_t *node;
+
+	switch_core_hash_init(&hash, pool);
+
+	switch_thread_rwlock_rdlock(RWLOCK);
+	switch_mutex_lock(STATS_MUTEX);
+	for (e = 0; e <= SWITCH_EVENT_ALL; e++) {
+		for (node = EVENT_NODES[e]; node; node = node->next) {
+			binding_stats_t *bs;
+
+			if (!(bs = switch_core_hash_find(hash, node->id))) {
+				bs = switch_core_alloc(pool, sizeof(*bs));
+				switch_core_hash_insert(hash, switch_core_strdup(pool, node->id), bs);
+			}
+
+			bs->calls += node->calls;
+			bs->callback_time += node->callback_time;
+			if (node->callback_max > bs->callback_max) {
+				bs->callback_max = node->callback_max;
+			}
+			bs->dropped += node->dropped;
+			if (node->queue) {
+				bs->queued += switch_queue_size(node->queue);
+			}
+		}
+	}
+	switch_mutex_unlock(STATS_MUTEX);
+	switch_thread_rwlock_unlock(RWLOCK);
+
+	return hash;
+}
+
+SWITCH_DECLARE(void) switch_event_stats(switch_stream_handle_t *stream)
+{
+	switch_event_stats_t stats[SWITCH_EVENT_ALL + 1];
+	switch_memory_pool_t *pool;
+	switch_hash_t *hash;
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+	int e, b;
+
+	switch_mutex_lock(STATS_MUTEX);
+	memcpy(stats, EVENT_STATS, sizeof(stats));
+	switch_mutex_unlock(STATS_MUTEX);
+
+	stream->write_function(stream, "Dispatch queue %u, %d dispatch thread(s)\n\n", switch_queue_size(EVENT_DISPATCH_QUEUE), DISPATCH_THREAD_COUNT);
+
+	stream->write_function(stream, "%-28s %12s %12s %10s %10s %10s", "event", "fired", "delivered", "dropped", "avg_us", "max_us");
+	for (b = 0; b < EVENT_LATENCY_BUCKETS; b++) {
+		stream->write_function(stream, " %9s", EVENT_LATENCY_NAMES[b]);
+	}
+	stream->write_function(stream, "\n");
+
+	for (e = 0; e < SWITCH_EVENT_ALL; e++) {
+		switch_event_stats_t *st = &stats[e];
+
+		if (!st->fired && !st->dropped) {
+			continue;
+		}
+
+		stream->write_function(stream, "%-28s %12" SWITCH_UINT64_T_FMT " %12" SWITCH_UINT64_T_FMT " %10" SWITCH_UINT64_T_FMT " %10" SWITCH_TIME_T_FMT " %10" SWITCH_TIME_T_FMT,
+							   EVENT_NAMES[e], st->fired, st->delivered, st->dropped,
+							   st->delivered ? st->latency_total / (switch_time_t) st->delivered : (switch_time_t) 0, st->latency_max);
+		for (b = 0; b < EVENT_LATENCY_BUCKETS; b++) {
+			stream->write_function(stream, " %9" SWITCH_UINT64_T_FMT, st->latency[b]);
+		}
+		stream->write_function(stream, "\n");
+	}
+
+	switch_core_new_memory_pool(&pool);
+	hash = binding_stats(pool);
+
+	stream->write_function(stream, "\n%-28s %12s %14s %10s %10s %10s %10s\n", "binding", "calls", "total_us", "avg_us", "max_us", "queued", "dropped");
+
+	for (hi = switch_hash_first(NULL, hash); hi; hi = switch_hash_next(hi)) {
+		binding_stats_t *bs;
+
+		switch_hash_this(hi, &var, NULL, &val);
+		bs = (binding_stats_t *) val;
+
+		stream->write_function(stream, "%-28s %12" SWITCH_UINT64_T_FMT " %14" SWITCH_TIME_T_FMT " %10" SWITCH_TIME_T_FMT " %10" SWITCH_TIME_T_FMT " %10u %10u\n",
+							   (const char *) var, bs->calls, bs->callback_time,
+							   bs->calls ? bs->callback_time / (switch_time_t) bs->calls : (switch_time_t) 0, bs->callback_max, bs->queued, bs->dropped);
+	}
+
+	switch_core_hash_destroy(&hash);
+	switch_core_destroy_memory_pool(&pool);
+}
+
+SWITCH_DECLARE(void) switch_event_fire_stats(void)
+{
+	switch_event_stats_t stats[SWITCH_EVENT_ALL + 1];
+	switch_memory_pool_t *pool;
+	switch_event_t *event;
+	switch_hash_t *hash;
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+	int e;
+
+	if (switch_event_create_subclass(&event, SWITCH_EVENT_CUSTOM, SWITCH_EVENT_STATS_SUBCLASS) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	switch_mutex_lock(STATS_MUTEX);
+	memcpy(stats, EVENT_STATS, sizeof(stats));
+	switch_mutex_unlock(STATS_MUTEX);
+
+	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Dispatch-Queue-Size", "%u", switch_queue_size(EVENT_DISPATCH_QUEUE));
+	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Dispatch-Threads", "%d", DISPATCH_THREAD_COUNT);
+
+	/* one header per event type: fired,delivered,dropped,avg_us,max_us */
+	for (e = 0; e < SWITCH_EVENT_ALL; e++) {
+		switch_event_stats_t *st = &stats[e];
+
+		if (!st->fired && !st->dropped) {
+			continue;
+		}
+
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, EVENT_NAMES[e],
+								"%" SWITCH_UINT64_T_FMT ",%" SWITCH_UINT64_T_FMT ",%" SWITCH_UINT64_T_FMT ",%" SWITCH_TIME_T_FMT ",%" SWITCH_TIME_T_FMT,
+								st->fired, st->delivered, st->dropped,
+								st->delivered ? st->latency_total / (switch_time_t) st->delivered : (switch_time_t) 0, st->latency_max);
+	}
+
+	switch_core_new_memory_pool(&pool);
+	hash = binding_stats(pool);
+
+	/* and one per binding: calls,total_us,avg_us,max_us,queued,dropped */
+	for (hi = switch_hash_first(NULL, hash); hi; hi = switch_hash_next(hi)) {
+		binding_stats_t *bs;
+		char name[256];
+
+		switch_hash_this(hi, &var, NULL, &val);
+		bs = (binding_stats_t *) val;
+
+		switch_snprintf(name, sizeof(name), "Binding-%s", (const char *) var);
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, name,
+								"%" SWITCH_UINT64_T_FMT ",%" SWITCH_TIME_T_FMT ",%" SWITCH_TIME_T_FMT ",%" SWITCH_TIME_T_FMT ",%u,%u",
+								bs->calls, bs->callback_time, bs->calls ? bs->callback_time / (switch_time_t) bs->calls : (switch_time_t) 0,
+								bs->callback_max, bs->queued, bs->dropped);
+	}
+
+	switch_core_hash_destroy(&hash);
+	switch_core_destroy_memory_pool(&pool);
+
+	switch_event_fire(&event);
+}
+
+static void event_metrics_collector(switch_stream_handle_t *stream, void *user_data)
+{
+	switch_event_stats_t stats[SWITCH_EVENT_ALL + 1];
+	int e, b;
+
+	switch_mutex_lock(STATS_MUTEX);
+	memcpy(stats, EVENT_STATS, sizeof(stats));
+	switch_mutex_unlock(STATS_MUTEX);
+
+	switch_metric_write_family(stream, "freeswitch_event_dispatch_queue", "Events waiting for a dispatch thread", SWITCH_METRIC_GAUGE);
+	switch_metric_write_value(stream, "freeswitch_event_dispatch_queue", NULL, switch_queue_size(EVENT_DISPATCH_QUEUE));
+
+	switch_metric_write_family(stream, "freeswitch_event_dispatch_threads", "Running event dispatch threads", SWITCH_METRIC_GAUGE);
+	switch_metric_write_value(stream, "freeswitch_event_dispatch_threads", NULL, DISPATCH_THREAD_COUNT);
+
+	switch_metric_write_family(stream, "freeswitch_events_fired_total", "Events queued for dispatch", SWITCH_METRIC_COUNTER);
+	for (e = 0; e < SWITCH_EVENT_ALL; e++) {
+		char labels[128];
+
+		if (!stats[e].fired) {
+			continue;
+		}
+
+		switch_snprintf(labels, sizeof(labels), "event=\"%s\"", EVENT_NAMES[e]);
+		switch_metric_write_value(stream, "freeswitch_events_fired_total", labels, (int64_t) stats[e].fired);
+	}
+
+	switch_metric_write_family(stream, "freeswitch_events_dropped_total", "Events dropped because the dispatch queue was full", SWITCH_METRIC_COUNTER);
+	for (e = 0; e < SWITCH_EVENT_ALL; e++) {
+		char labels[128];
+
+		if (!stats[e].dropped) {
+			continue;
+		}
+
+		switch_snprintf(labels, sizeof(labels), "event=\"%s\"", EVENT_NAMES[e]);
+		switch_metric_write_value(stream, "freeswitch_events_dropped_total", labels, (int64_t) stats[e].dropped);
+	}
+
+	/* the latency buckets are kept per bucket, the exposition format wants them cumulative */
+	switch_metric_write_family(stream, "freeswitch_event_latency_us", "Enqueue to delivery latency in microseconds", SWITCH_METRIC_HISTOGRAM);
+	for (e = 0; e < SWITCH_EVENT_ALL; e++) {
+		switch_event_stats_t *st = &stats[e];
+		uint64_t cum = 0;
+		char labels[128];
+
+		if (!st->delivered) {
+			continue;
+		}
+
+		for (b = 0; b < EVENT_LATENCY_BUCKETS; b++) {
+			cum += st->latency[b];
+
+			if (b < EVENT_LATENCY_BUCKETS - 1) {
+				switch_snprintf(labels, sizeof(labels), "event=\"%s\",le=\"%" SWITCH_TIME_T_FMT "\"", EVENT_NAMES[e], EVENT_LATENCY_LIMITS[b]);
+			} else {
+				switch_snprintf(labels, sizeof(labels), "event=\"%s\",le=\"+Inf\"", EVENT_NAMES[e]);
+			}
+			switch_metric_write_value(stream, "freeswitch_event_latency_us_bucket", labels, (int64_t) cum);
+		}
+
+		switch_snprintf(labels, sizeof(labels), "event=\"%s\"", EVENT_NAMES[e]);
+		switch_metric_write_value(stream, "freeswitch_event_latency_us_sum", labels, (int64_t) st->latency_total);
+		switch_metric_write_value(stream, "freeswitch_event_latency_us_count", labels, (int64_t) st->delivered);
+	}
+}
+
 SWITCH_DECLARE(const char *) switch_event_name(switch_event_types_t event)
 {
 	switch_assert(BLOCK != NULL);
@@ -464,6 +894,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_shutdown(void)
 	SYSTEM_RUNNING = 0;
 	switch_mutex_unlock(EVENT_QUEUE_MUTEX);
 
+	switch_metric_unregister_collector("event");
+
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Stopping dispatch queues\n");
 
 	
@@ -575,6 +1007,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_init(switch_memory_pool_t *pool)
 	switch_mutex_init(&BLOCK, SWITCH_MUTEX_NESTED, RUNTIME_POOL);
 	switch_mutex_init(&POOL_LOCK, SWITCH_MUTEX_NESTED, RUNTIME_POOL);
 	switch_mutex_init(&EVENT_QUEUE_MUTEX, SWITCH_MUTEX_NESTED, RUNTIME_POOL);
+	switch_mutex_init(&STATS_MUTEX, SWITCH_MUTEX_NESTED, RUNTIME_POOL);
+	switch_mutex_init(&SNAPSHOT_MUTEX, SWITCH_MUTEX_NESTED, RUNTIME_POOL);
 	switch_core_hash_init(&CUSTOM_HASH, RUNTIME_POOL);
 
 	switch_mutex_lock(EVENT_QUEUE_MUTEX);
@@ -597,6 +1031,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_init(switch_memory_pool_t *pool)
 	//switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
 	//switch_threadattr_priority_increase(thd_attr);
 
+	EVENT_HEADER_SLAB = switch_slab_create("event_header", sizeof(switch_event_header_t), 512);
+
 	switch_queue_create(&EVENT_DISPATCH_QUEUE, DISPATCH_QUEUE_LEN * MAX_DISPATCH, pool);
 	launch_dispatch_threads(1, RUNTIME_POOL);
 
@@ -613,6 +1049,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_init(switch_memory_pool_t *pool)
 	SYSTEM_RUNNING = 1;
 	switch_mutex_unlock(EVENT_QUEUE_MUTEX);
 
+	switch_metric_register_collector("event", event_metrics_collector, NULL);
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -665,6 +1103,428 @@ SWITCH_DECLARE(switch_status_t) switch_event_set_priority(switch_event_t *event,
 	return SWITCH_STATUS_SUCCESS;
 }
 
+static struct switch_event_arena *event_arena_block(switch_size_t size)
+{
+	struct switch_event_arena *block;
+
+	block = ALLOC(sizeof(*block) + size);
+	switch_assert(block);
+	block->next = NULL;
+	block->size = size;
+	block->used = 0;
+	block->data = (char *) (block + 1);
+
+	return block;
+}
+
+static void *event_alloc(switch_event_t *event, switch_size_t size)
+{
+	struct switch_event_arena *block;
+	void *ptr;
+
+	if (!event->arena) {
+		ptr = ALLOC(size);
+		switch_assert(ptr);
+		return ptr;
+	}
+
+	size = (size + 7) & ~((switch_size_t) 7);
+
+	block = event->arena;
+
+	if (block->size - block->used < size) {
+		block = event_arena_block(size > EVENT_ARENA_BLOCK ? size : EVENT_ARENA_BLOCK);
+		block->next = event->arena;
+		event->arena = block;
+	}
+
+	ptr = block->data + block->used;
+	block->used += size;
+
+	return ptr;
+}
+
+static char *event_dup(switch_event_t *event, const char *str)
+{
+	switch_size_t len;
+	char *p;
+
+	if (!event->arena) {
+		return DUP(str);
+	}
+
+	if (!str) {
+		return NULL;
+	}
+
+	len = strlen(str) + 1;
+	p = event_alloc(event, len);
+	memcpy(p, str, len);
+
+	return p;
+}
+
+static switch_bool_t event_in_arena(switch_event_t *event, const void *ptr)
+{
+	struct switch_event_arena *block;
+
+	for (block = event->arena; block; block = block->next) {
+		if ((const char *) ptr >= block->data && (const char *) ptr < block->data + block->size) {
+			return SWITCH_TRUE;
+		}
+	}
+
+	return SWITCH_FALSE;
+}
+
+/* anything carved from the arena goes away with the event, everything else is ordinary heap memory */
+#define EVENT_FREE(_event, _ptr) do { if (!(_event)->arena || !event_in_arena(_event, _ptr)) { FREE(_ptr); } else { _ptr = NULL; } } while(0)
+
+static void event_free_header(switch_event_t *event, switch_event_header_t *hp)
+{
+	switch_bool_t arena_header = event->arena && event_in_arena(event, hp);
+
+	/* expanded snapshot headers live in the arena and only own their array */
+	if (hp->borrowed) {
+		FREE(hp->array);
+		return;
+	}
+
+	if (!hp->interned) {
+		EVENT_FREE(event, hp->name);
+	}
+
+	if (hp->idx) {
+		int i = 0;
+
+		for (i = 0; i < hp->idx; i++) {
+			EVENT_FREE(event, hp->array[i]);
+		}
+		FREE(hp->array);
+	}
+
+	EVENT_FREE(event, hp->value);
+
+	if (arena_header) {
+		return;
+	}
+
+	memset(hp, 0, sizeof(*hp));
+#ifdef SWITCH_EVENT_RECYCLE
+	if (switch_queue_trypush(EVENT_HEADER_RECYCLE_QUEUE, hp) != SWITCH_STATUS_SUCCESS) {
+		switch_slab_free(EVENT_HEADER_SLAB, hp);
+	}
+#else
+	switch_slab_free(EVENT_HEADER_SLAB, hp);
+#endif
+}
+
+SWITCH_DECLARE(switch_status_t) switch_event_use_arena(switch_event_t *event, switch_size_t size)
+{
+	switch_assert(event);
+
+	if (event->arena) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	event->arena = event_arena_block(size ? size : EVENT_ARENA_BLOCK);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void event_index_free(switch_event_t *event)
+{
+	switch_safe_free(event->index);
+	event->index_size = 0;
+}
+
+/* keep headers of the same name in list order within a bucket so lookups return the first one, like a list walk would */
+static void event_index_add(switch_event_t *event, switch_event_header_t *header, switch_bool_t top)
+{
+	switch_event_header_t **hpp = &event->index[header->hash & (event->index_size - 1)];
+
+	if (top) {
+		header->index_next = *hpp;
+		*hpp = header;
+		return;
+	}
+
+	while (*hpp) {
+		hpp = &(*hpp)->index_next;
+	}
+
+	header->index_next = NULL;
+	*hpp = header;
+}
+
+static void event_index_del(switch_event_t *event, switch_event_header_t *header)
+{
+	switch_event_header_t **hpp = &event->index[header->hash & (event->index_size - 1)];
+
+	for (; *hpp; hpp = &(*hpp)->index_next) {
+		if (*hpp == header) {
+			*hpp = header->index_next;
+			break;
+		}
+	}
+}
+
+static void event_index_fill(switch_event_t *event, uint32_t size)
+{
+	switch_event_header_t *hp;
+
+	switch_safe_free(event->index);
+	switch_zmalloc(event->index, sizeof(switch_event_header_t *) * size);
+	event->index_size = size;
+
+	for (hp = event->headers; hp; hp = hp->next) {
+		event_index_add(event, hp, SWITCH_FALSE);
+	}
+}
+
+static switch_bool_t event_index_build(switch_event_t *event)
+{
+	uint32_t size = EVENT_INDEX_BUCKETS;
+
+	if (event->index) {
+		return SWITCH_TRUE;
+	}
+
+	if (event->header_count < EVENT_INDEX_THRESHOLD) {
+		return SWITCH_FALSE;
+	}
+
+	while (size < event->header_count) {
+		size <<= 1;
+	}
+
+	event_index_fill(event, size);
+
+	return SWITCH_TRUE;
+}
+
+/* channel variables can run into the hundreds, double the buckets when the chains get long so lookups stay flat */
+static void event_index_added(switch_event_t *event, switch_event_header_t *header, switch_bool_t top)
+{
+	if (!event->index) {
+		return;
+	}
+
+	if (event->header_count > event->index_size * 2) {
+		event_index_fill(event, event->index_size << 1);
+	} else {
+		event_index_add(event, header, top);
+	}
+}
+
+/* unlink a header from the list and the index, O(1) thanks to the back pointer */
+static void event_unlink_header(switch_event_t *event, switch_event_header_t *hp)
+{
+	if (hp->prev) {
+		hp->prev->next = hp->next;
+	} else {
+		event->headers = hp->next;
+	}
+
+	if (hp->next) {
+		hp->next->prev = hp->prev;
+	} else {
+		event->last_header = hp->prev;
+	}
+
+	if (event->index) {
+		event_index_del(event, hp);
+	}
+
+	hp->next = hp->prev = NULL;
+	event->header_count--;
+}
+
+/* give a header taken from the snapshot its own strings before anything changes it */
+static void event_header_own(switch_event_t *event, switch_event_header_t *hp)
+{
+	int i;
+
+	if (!hp->borrowed) {
+		return;
+	}
+
+	hp->borrowed = SWITCH_FALSE;
+	if (!hp->interned) {
+		hp->name = event_dup(event, hp->name);
+	}
+	hp->value = event_dup(event, hp->value);
+
+	for (i = 0; i < hp->idx; i++) {
+		hp->array[i] = event_dup(event, hp->array[i]);
+	}
+}
+
+static switch_bool_t event_snapshot_match(switch_event_t *event, const char *header_name)
+{
+	return event->snapshot && !event->snapshot_expanded && header_name && 
+		!strncasecmp(header_name, event->snapshot->prefix, event->snapshot->prefix_len);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_event_snapshot_create(switch_event_snapshot_t **snapshot, switch_event_t *src, const char *prefix)
+{
+	switch_event_snapshot_t *snap;
+	switch_event_header_t *hp;
+	switch_size_t len = 0, plen = strlen(prefix);
+	char buf[1024];
+
+	*snapshot = NULL;
+
+	switch_zmalloc(snap, sizeof(*snap));
+
+	if (switch_event_create_subclass(&snap->event, SWITCH_EVENT_CLONE, NULL) != SWITCH_STATUS_SUCCESS) {
+		FREE(snap);
+		return SWITCH_STATUS_GENERR;
+	}
+
+	snap->prefix = DUP(prefix);
+	snap->prefix_len = plen;
+	snap->refs = 1;
+
+	for (hp = src->headers; hp; hp = hp->next) {
+		len += ((sizeof(*hp) + 7) & ~((switch_size_t) 7)) + ((strlen(hp->name) + plen + 8) & ~((switch_size_t) 7)) + 
+			((strlen(hp->value) + 8) & ~((switch_size_t) 7));
+	}
+
+	if (len) {
+		switch_event_use_arena(snap->event, len);
+	}
+
+	for (hp = src->headers; hp; hp = hp->next) {
+		switch_snprintf(buf, sizeof(buf), "%s%s", prefix, hp->name);
+		switch_event_add_header_string(snap->event, SWITCH_STACK_BOTTOM, buf, hp->value);
+	}
+
+	*snapshot = snap;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_event_snapshot_release(switch_event_snapshot_t **snapshot)
+{
+	switch_event_snapshot_t *snap = *snapshot;
+	int refs;
+
+	*snapshot = NULL;
+
+	if (!snap) {
+		return;
+	}
+
+	switch_mutex_lock(SNAPSHOT_MUTEX);
+	refs = --snap->refs;
+	switch_mutex_unlock(SNAPSHOT_MUTEX);
+
+	if (refs) {
+		return;
+	}
+
+	switch_event_destroy(&snap->event);
+	FREE(snap->prefix);
+	FREE(snap);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_event_add_snapshot(switch_event_t *event, switch_event_snapshot_t *snapshot)
+{
+	switch_assert(event && snapshot);
+
+	if (event->snapshot) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(SNAPSHOT_MUTEX);
+	snapshot->refs++;
+	switch_mutex_unlock(SNAPSHOT_MUTEX);
+
+	event->snapshot = snapshot;
+	event->snapshot_expanded = SWITCH_FALSE;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+/* only the header structs are new, the strings stay in the snapshot which the event holds until it is destroyed */
+static void event_link_snapshot(switch_event_t *event, switch_event_snapshot_t *snapshot)
+{
+	switch_event_header_t *sp, *hp;
+
+	if (!event->arena) {
+		switch_event_use_arena(event, 0);
+	}
+
+	for (sp = snapshot->event->headers; sp; sp = sp->next) {
+		hp = event_alloc(event, sizeof(*hp));
+		memset(hp, 0, sizeof(*hp));
+		hp->name = sp->name;
+		hp->value = sp->value;
+		hp->hash = sp->hash;
+		hp->interned = sp->interned;
+		hp->borrowed = SWITCH_TRUE;
+
+		if (sp->idx) {
+			hp->array = ALLOC(sizeof(char *) * sp->idx);
+			switch_assert(hp->array);
+			memcpy(hp->array, sp->array, sizeof(char *) * sp->idx);
+			hp->idx = sp->idx;
+		}
+
+		hp->prev = event->last_header;
+		hp->next = NULL;
+		if (event->last_header) {
+			event->last_header->next = hp;
+		} else {
+			event->headers = hp;
+		}
+		event->last_header = hp;
+		event->header_count++;
+
+		event_index_added(event, hp, SWITCH_FALSE);
+	}
+}
+
+SWITCH_DECLARE(void) switch_event_expand_snapshot(switch_event_t *event)
+{
+	switch_event_header_t *sp;
+
+	if (!event->snapshot || event->snapshot_expanded) {
+		return;
+	}
+
+	event->snapshot_expanded = SWITCH_TRUE;
+
+	if (switch_test_flag(event, EF_UNIQ_HEADERS)) {
+		/* replacing existing headers is what add_header already knows how to do */
+		for (sp = event->snapshot->event->headers; sp; sp = sp->next) {
+			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, sp->name, sp->value);
+		}
+		return;
+	}
+
+	event_link_snapshot(event, event->snapshot);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_event_borrow_snapshot(switch_event_t *event, switch_event_snapshot_t *snapshot)
+{
+	switch_assert(event && snapshot);
+
+	if (event->borrowed_snapshot || switch_test_flag(event, EF_UNIQ_HEADERS)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(SNAPSHOT_MUTEX);
+	snapshot->refs++;
+	switch_mutex_unlock(SNAPSHOT_MUTEX);
+
+	event->borrowed_snapshot = snapshot;
+	event_link_snapshot(event, snapshot);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_event_rename_header(switch_event_t *event, const char *header_name, const char *new_header_name)
 {
 	switch_event_header_t *hp;
@@ -678,18 +1538,38 @@ SWITCH_DECLARE(switch_status_t) switch_event_rename_header(switch_event_t *event
 		return SWITCH_STATUS_FALSE;
 	}
 
+	if (event_snapshot_match(event, header_name) || event_snapshot_match(event, new_header_name)) {
+		switch_event_expand_snapshot(event);
+	}
+
 	hash = switch_ci_hashfunc_default(header_name, &hlen);
 
 	for (hp = event->headers; hp; hp = hp->next) {
-		if ((!hp->hash || hash == hp->hash) && !strcasecmp(hp->name, header_name)) {
-			FREE(hp->name);
-			hp->name = DUP(new_header_name);
-			hlen = -1;
-			hp->hash = switch_ci_hashfunc_default(hp->name, &hlen);
+		if ((!hp->hash || hash == hp->hash) && (hp->name == header_name || !strcasecmp(hp->name, header_name))) {
+			const char *atom;
+
+			event_header_own(event, hp);
+			if (!hp->interned) {
+				EVENT_FREE(event, hp->name);
+			}
+			if ((atom = switch_core_intern(new_header_name))) {
+				hp->name = (char *) atom;
+				hp->interned = SWITCH_TRUE;
+				hp->hash = switch_core_intern_hash(atom);
+			} else {
+				hp->name = event_dup(event, new_header_name);
+				hp->interned = SWITCH_FALSE;
+				hlen = -1;
+				hp->hash = switch_ci_hashfunc_default(hp->name, &hlen);
+			}
 			x++;
 		}
 	}
 
+	if (x) {
+		event_index_free(event);
+	}
+
 	return x ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
 }
 
@@ -705,10 +1585,23 @@ SWITCH_DECLARE(switch_event_header_t *) switch_event_get_header_ptr(switch_event
 	if (!header_name)
 		return NULL;
 
+	if (event_snapshot_match(event, header_name)) {
+		switch_event_expand_snapshot(event);
+	}
+
 	hash = switch_ci_hashfunc_default(header_name, &hlen);
 
+	if (event_index_build(event)) {
+		for (hp = event->index[hash & (event->index_size - 1)]; hp; hp = hp->index_next) {
+			if (hash == hp->hash && (hp->name == header_name || !strcasecmp(hp->name, header_name))) {
+				return hp;
+			}
+		}
+		return NULL;
+	}
+
 	for (hp = event->headers; hp; hp = hp->next) {
-		if ((!hp->hash || hash == hp->hash) && !strcasecmp(hp->name, header_name)) {
+		if ((!hp->hash || hash == hp->hash) && (hp->name == header_name || !strcasecmp(hp->name, header_name))) {
 			return hp;
 		}
 	}
@@ -741,13 +1634,41 @@ SWITCH_DECLARE(char *) switch_event_get_body(switch_event_t *event)
 	return (event ? event->body : NULL);
 }
 
-SWITCH_DECLARE(switch_status_t) switch_event_del_header_val(switch_event_t *event, const char *header_name, const char *val)
-{
-	switch_event_header_t *hp, *lp = NULL, *tp;
-	switch_status_t status = SWITCH_STATUS_FALSE;
-	int x = 0;
-	switch_ssize_t hlen = -1;
-	unsigned long hash = 0;
+SWITCH_DECLARE(switch_status_t) switch_event_del_header_val(switch_event_t *event, const char *header_name, const char *val)
+{
+	switch_event_header_t *hp, *tp;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	int x = 0;
+	switch_ssize_t hlen = -1;
+	unsigned long hash = 0;
+
+	if (event_snapshot_match(event, header_name)) {
+		switch_event_expand_snapshot(event);
+	}
+
+	/* with an index we can tell cheaply when there is nothing to delete, which is the common EF_UNIQ_HEADERS case */
+	if (event->index && !switch_event_get_header_ptr(event, header_name)) {
+		return status;
+	}
+
+	hash = switch_ci_hashfunc_default(header_name, &hlen);
+
+	/* same name means same bucket, so only the bucket needs a look and the back pointers do the unlinking */
+	if (event->index) {
+		tp = event->index[hash & (event->index_size - 1)];
+		while (tp) {
+			hp = tp;
+			tp = tp->index_next;
+
+			if (hash == hp->hash && !strcasecmp(header_name, hp->name) && (zstr(val) || !strcmp(hp->value, val))) {
+				event_unlink_header(event, hp);
+				event_free_header(event, hp);
+				status = SWITCH_STATUS_SUCCESS;
+			}
+		}
+
+		return status;
+	}
 
 	tp = event->headers;
 	while (tp) {
@@ -756,50 +1677,33 @@ SWITCH_DECLARE(switch_status_t) switch_event_del_header_val(switch_event_t *even
 
 		x++;
 		switch_assert(x < 1000000);
-		hash = switch_ci_hashfunc_default(header_name, &hlen);
 
 		if ((!hp->hash || hash == hp->hash) && !strcasecmp(header_name, hp->name) && (zstr(val) || !strcmp(hp->value, val))) {
-			if (lp) {
-				lp->next = hp->next;
-			} else {
-				event->headers = hp->next;
-			}
-			if (hp == event->last_header || !hp->next) {
-				event->last_header = lp;
-			}
-			FREE(hp->name);
-
-			if (hp->idx) {
-				int i = 0;
-
-				for (i = 0; i < hp->idx; i++) {
-					FREE(hp->array[i]);
-				}
-				FREE(hp->array);
-			}
-
-			FREE(hp->value);
-			
-			memset(hp, 0, sizeof(*hp));
-#ifdef SWITCH_EVENT_RECYCLE
-			if (switch_queue_trypush(EVENT_HEADER_RECYCLE_QUEUE, hp) != SWITCH_STATUS_SUCCESS) {
-				FREE(hp);
-			}
-#else
-			FREE(hp);
-#endif
+			event_unlink_header(event, hp);
+			event_free_header(event, hp);
 			status = SWITCH_STATUS_SUCCESS;
-		} else {
-			lp = hp;
 		}
 	}
 
 	return status;
 }
 
-static switch_event_header_t *new_header(const char *header_name)
+static switch_event_header_t *new_header(switch_event_t *event, const char *header_name)
 {
 	switch_event_header_t *header;
+	const char *atom = switch_core_intern(header_name);
+
+	if (event->arena) {
+		header = event_alloc(event, sizeof(*header));
+		memset(header, 0, sizeof(*header));
+		if (atom) {
+			header->name = (char *) atom;
+			header->interned = SWITCH_TRUE;
+		} else {
+			header->name = event_dup(event, header_name);
+		}
+		return header;
+	}
 
 #ifdef SWITCH_EVENT_RECYCLE
 		void *pop;
@@ -807,14 +1711,20 @@ static switch_event_header_t *new_header(const char *header_name)
 			header = (switch_event_header_t *) pop;
 		} else {
 #endif
-			header = ALLOC(sizeof(*header));
+			/* events can be built before switch_event_init() creates the cache */
+			header = EVENT_HEADER_SLAB ? switch_slab_alloc(EVENT_HEADER_SLAB) : ALLOC(sizeof(*header));
 			switch_assert(header);
 #ifdef SWITCH_EVENT_RECYCLE
 		}
 #endif	
 
 		memset(header, 0, sizeof(*header));
-		header->name = DUP(header_name);
+		if (atom) {
+			header->name = (char *) atom;
+			header->interned = SWITCH_TRUE;
+		} else {
+			header->name = DUP(header_name);
+		}
 
 		return header;
 
@@ -894,7 +1804,7 @@ static switch_status_t switch_event_base_add_header(switch_event_t *event, switc
 		
 		if (!(header = switch_event_get_header_ptr(event, header_name)) && index_ptr) {
 
-			header = new_header(header_name);
+			header = new_header(event, header_name);
 
 			if (switch_test_flag(event, EF_UNIQ_HEADERS)) {
 				switch_event_del_header(event, header_name);
@@ -904,11 +1814,13 @@ static switch_status_t switch_event_base_add_header(switch_event_t *event, switc
 		}
 		
 		if ((header = switch_event_get_header_ptr(event, header_name))) {
+
+			event_header_own(event, header);
 			
 			if (index_ptr) {
 				if (index > -1 && index <= 4000) {
 					if (index < header->idx) {
-						FREE(header->array[index]);
+						EVENT_FREE(event, header->array[index]);
 						header->array[index] = DUP(data);
 					} else {
 						int i;
@@ -944,9 +1856,13 @@ static switch_status_t switch_event_base_add_header(switch_event_t *event, switc
 
 	if (!header) {
 
+		if (event_snapshot_match(event, header_name)) {
+			switch_event_expand_snapshot(event);
+		}
+
 		if (zstr(data)) {
 			switch_event_del_header(event, header_name);
-			FREE(data);
+			EVENT_FREE(event, data);
 			goto end;
 		}
 
@@ -956,12 +1872,12 @@ static switch_status_t switch_event_base_add_header(switch_event_t *event, switc
 
 		if (strstr(data, "ARRAY::")) {
 			switch_event_add_array(event, header_name, data);
-			FREE(data);
+			EVENT_FREE(event, data);
 			goto end;
 		}
 
 
-		header = new_header(header_name);
+		header = new_header(event, header_name);
 	}
 	
 	if ((stack & SWITCH_STACK_PUSH) || (stack & SWITCH_STACK_UNSHIFT)) {
@@ -1004,6 +1920,9 @@ static switch_status_t switch_event_base_add_header(switch_event_t *event, switc
 
 		if (len) {
 			len += 8;
+			if (header->value && event->arena && event_in_arena(event, header->value)) {
+				header->value = NULL;
+			}
 			hv = realloc(header->value, len);
 			switch_assert(hv);
 			header->value = hv;
@@ -1019,23 +1938,32 @@ static switch_status_t switch_event_base_add_header(switch_event_t *event, switc
 	}
 
 	if (!exists) {
-		header->hash = switch_ci_hashfunc_default(header->name, &hlen);
+		header->hash = header->interned ? switch_core_intern_hash(header->name) : switch_ci_hashfunc_default(header->name, &hlen);
 
 		if ((stack & SWITCH_STACK_TOP)) {
+			header->prev = NULL;
 			header->next = event->headers;
+			if (event->headers) {
+				event->headers->prev = header;
+			}
 			event->headers = header;
 			if (!event->last_header) {
 				event->last_header = header;
 			}
 		} else {
+			header->prev = event->last_header;
+			header->next = NULL;
 			if (event->last_header) {
 				event->last_header->next = header;
 			} else {
 				event->headers = header;
-				header->next = NULL;
 			}
 			event->last_header = header;
 		}
+
+		event->header_count++;
+
+		event_index_added(event, header, (stack & SWITCH_STACK_TOP) ? SWITCH_TRUE : SWITCH_FALSE);
 	}
 
  end:
@@ -1077,7 +2005,7 @@ SWITCH_DECLARE(switch_status_t) switch_event_set_subclass_name(switch_event_t *e
 SWITCH_DECLARE(switch_status_t) switch_event_add_header_string(switch_event_t *event, switch_stack_t stack, const char *header_name, const char *data)
 {
 	if (data) {
-		return switch_event_base_add_header(event, stack, header_name, (stack & SWITCH_STACK_NODUP) ? (char *)data : DUP(data));
+		return switch_event_base_add_header(event, stack, header_name, (stack & SWITCH_STACK_NODUP) ? (char *)data : event_dup(event, data));
 	}
 	return SWITCH_STATUS_GENERR;
 }
@@ -1122,33 +2050,23 @@ SWITCH_DECLARE(void) switch_event_destroy(switch_event_t **event)
 	switch_event_header_t *hp, *this;
 
 	if (ep) {
+		struct switch_event_arena *block;
+
 		for (hp = ep->headers; hp;) {
 			this = hp;
 			hp = hp->next;
-			FREE(this->name);
-
-			if (this->idx) {
-				int i = 0;
-
-				for (i = 0; i < this->idx; i++) {
-					FREE(this->array[i]);
-				}
-				FREE(this->array);
-			}
-
-			FREE(this->value);
-			
-
-#ifdef SWITCH_EVENT_RECYCLE
-			if (switch_queue_trypush(EVENT_HEADER_RECYCLE_QUEUE, this) != SWITCH_STATUS_SUCCESS) {
-				FREE(this);
-			}
-#else
-			FREE(this);
-#endif
+			event_free_header(ep, this);
+		}
 
+		switch_event_snapshot_release(&ep->snapshot);
+		switch_event_snapshot_release(&ep->borrowed_snapshot);
 
+		while ((block = ep->arena)) {
+			ep->arena = block->next;
+			FREE(block);
 		}
+
+		event_index_free(ep);
 		FREE(ep->body);
 		FREE(ep->subclass_name);
 #ifdef SWITCH_EVENT_RECYCLE
@@ -1170,6 +2088,8 @@ SWITCH_DECLARE(void) switch_event_merge(switch_event_t *event, switch_event_t *t
 	
 	switch_assert(tomerge && event);
 
+	switch_event_expand_snapshot(tomerge);
+
 	for (hp = tomerge->headers; hp; hp = hp->next) {
 		if (hp->idx) {
 			int i;
@@ -1186,6 +2106,7 @@ SWITCH_DECLARE(void) switch_event_merge(switch_event_t *event, switch_event_t *t
 SWITCH_DECLARE(switch_status_t) switch_event_dup(switch_event_t **event, switch_event_t *todup)
 {
 	switch_event_header_t *hp;
+	switch_size_t len = 0;
 
 	if (switch_event_create_subclass(event, SWITCH_EVENT_CLONE, todup->subclass_name) != SWITCH_STATUS_SUCCESS) {
 		return SWITCH_STATUS_GENERR;
@@ -1195,6 +2116,19 @@ SWITCH_DECLARE(switch_status_t) switch_event_dup(switch_event_t **event, switch_
 	(*event)->event_user_data = todup->event_user_data;
 	(*event)->bind_user_data = todup->bind_user_data;
 	(*event)->flags = todup->flags;
+
+	/* size the copy up front so all the plain headers land in a single block */
+	for (hp = todup->headers; hp; hp = hp->next) {
+		if (!hp->idx) {
+			len += ((sizeof(*hp) + 7) & ~((switch_size_t) 7)) + ((strlen(hp->name) + 8) & ~((switch_size_t) 7)) + 
+				((strlen(hp->value) + 8) & ~((switch_size_t) 7));
+		}
+	}
+
+	if (len) {
+		switch_event_use_arena(*event, len);
+	}
+
 	for (hp = todup->headers; hp; hp = hp->next) {
 		if (todup->subclass_name && !strcmp(hp->name, "Event-Subclass")) {
 			continue;
@@ -1214,6 +2148,11 @@ SWITCH_DECLARE(switch_status_t) switch_event_dup(switch_event_t **event, switch_
 		(*event)->body = DUP(todup->body);
 	}
 
+	/* a copy can keep pointing at the same snapshot as long as neither has expanded it */
+	if (todup->snapshot && !todup->snapshot_expanded) {
+		switch_event_add_snapshot(*event, todup->snapshot);
+	}
+
 	(*event)->key = todup->key;
 
 	return SWITCH_STATUS_SUCCESS;
@@ -1235,6 +2174,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_dup_reply(switch_event_t **event, s
 	(*event)->bind_user_data = todup->bind_user_data;
 	(*event)->flags = todup->flags;
 
+	switch_event_expand_snapshot(todup);
+
 	for (hp = todup->headers; hp; hp = hp->next) {
 		char *name = hp->name, *value = hp->value;
 		
@@ -1298,6 +2239,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_serialize(switch_event_t *event, ch
 		abort();
 	}
 
+	switch_event_expand_snapshot(event);
+
 	/* switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "hit serialized!.\n"); */
 	for (hp = event->headers; hp; hp = hp->next) {
 		/*
@@ -1553,6 +2496,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_serialize_json(switch_event_t *even
 	cJSON *cj;
 
 	*str = NULL;
+
+	switch_event_expand_snapshot(event);
 	
 	cj = cJSON_CreateObject();
 
@@ -1642,6 +2587,9 @@ SWITCH_DECLARE(switch_xml_t) switch_event_xmlize(switch_event_t *event, const ch
 
 	if ((xheaders = switch_xml_add_child_d(xml, "headers", off++))) {
 		int hoff = 0;
+
+		switch_event_expand_snapshot(event);
+
 		for (hp = event->headers; hp; hp = hp->next) {
 
 			if (hp->idx) {
@@ -1741,8 +2689,9 @@ SWITCH_DECLARE(switch_status_t) switch_event_fire_detailed(const char *file, con
 	return SWITCH_STATUS_SUCCESS;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_event_bind_removable(const char *id, switch_event_types_t event, const char *subclass_name,
-															switch_event_callback_t callback, void *user_data, switch_event_node_t **node)
+static switch_status_t switch_event_bind_real(const char *id, switch_event_types_t event, const char *subclass_name,
+											  switch_event_callback_t callback, void *user_data, 
+											  uint32_t queue_len, switch_event_queue_policy_t policy, switch_event_node_t **node)
 {
 	switch_event_node_t *event_node;
 	switch_event_subclass_t *subclass = NULL;
@@ -1768,10 +2717,31 @@ SWITCH_DECLARE(switch_status_t) switch_event_bind_removable(const char *id, swit
 
 	if (event <= SWITCH_EVENT_ALL) {
 		switch_zmalloc(event_node, sizeof(*event_node));
+
+		if (queue_len) {
+			switch_threadattr_t *thd_attr;
+
+			if (switch_core_new_memory_pool(&event_node->pool) != SWITCH_STATUS_SUCCESS) {
+				free(event_node);
+				return SWITCH_STATUS_MEMERR;
+			}
+
+			event_node->id = DUP(id);
+			event_node->callback = callback;
+			event_node->policy = policy;
+			switch_mutex_init(&event_node->mutex, SWITCH_MUTEX_NESTED, event_node->pool);
+			switch_queue_create(&event_node->queue, queue_len, event_node->pool);
+			switch_threadattr_create(&thd_attr, event_node->pool);
+			switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+			switch_thread_create(&event_node->thread, thd_attr, switch_event_node_thread, event_node, event_node->pool);
+		}
+
 		switch_thread_rwlock_wrlock(RWLOCK);
 		switch_mutex_lock(BLOCK);
 		/* <LOCKED> ----------------------------------------------- */
-		event_node->id = DUP(id);
+		if (!event_node->id) {
+			event_node->id = DUP(id);
+		}
 		event_node->event_id = event;
 		if (subclass_name) {
 			event_node->subclass_name = DUP(subclass_name);
@@ -1798,6 +2768,22 @@ SWITCH_DECLARE(switch_status_t) switch_event_bind_removable(const char *id, swit
 	return SWITCH_STATUS_MEMERR;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_event_bind_removable(const char *id, switch_event_types_t event, const char *subclass_name,
+															switch_event_callback_t callback, void *user_data, switch_event_node_t **node)
+{
+	return switch_event_bind_real(id, event, subclass_name, callback, user_data, 0, SWITCH_EVENT_QUEUE_DROP, node);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_event_bind_queued(const char *id, switch_event_types_t event, const char *subclass_name,
+														 switch_event_callback_t callback, void *user_data,
+														 uint32_t queue_len, switch_event_queue_policy_t policy, switch_event_node_t **node)
+{
+	if (!queue_len) {
+		queue_len = DISPATCH_QUEUE_LEN * MAX_DISPATCH;
+	}
+
+	return switch_event_bind_real(id, event, subclass_name, callback, user_data, queue_len, policy, node);
+}
 
 SWITCH_DECLARE(switch_status_t) switch_event_bind(const char *id, switch_event_types_t event, const char *subclass_name,
 												  switch_event_callback_t callback, void *user_data)
@@ -1808,7 +2794,7 @@ SWITCH_DECLARE(switch_status_t) switch_event_bind(const char *id, switch_event_t
 
 SWITCH_DECLARE(switch_status_t) switch_event_unbind_callback(switch_event_callback_t callback)
 {
-	switch_event_node_t *n, *np, *lnp = NULL;
+	switch_event_node_t *n, *np, *lnp = NULL, *dead = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	int id;
 
@@ -1829,9 +2815,8 @@ SWITCH_DECLARE(switch_status_t) switch_event_unbind_callback(switch_event_callba
 				}
 
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Event Binding deleted for %s:%s\n", n->id, switch_event_name(n->event_id));
-				FREE(n->subclass_name);
-				FREE(n->id);
-				FREE(n);
+				n->next = dead;
+				dead = n;
 				status = SWITCH_STATUS_SUCCESS;
 			} else {
 				lnp = n;
@@ -1842,6 +2827,12 @@ SWITCH_DECLARE(switch_status_t) switch_event_unbind_callback(switch_event_callba
 	switch_thread_rwlock_unlock(RWLOCK);
 	/* </LOCKED> ----------------------------------------------- */
 
+	/* queued bindings are joined outside the lock so a callback in flight can still fire events */
+	while ((n = dead)) {
+		dead = n->next;
+		switch_event_node_destroy(&n);
+	}
+
 	return status;
 }
 
@@ -1869,9 +2860,6 @@ SWITCH_DECLARE(switch_status_t) switch_event_unbind(switch_event_node_t **node)
 				EVENT_NODES[n->event_id] = n->next;
 			}
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Event Binding deleted for %s:%s\n", n->id, switch_event_name(n->event_id));
-			FREE(n->subclass_name);
-			FREE(n->id);
-			FREE(n);
 			*node = NULL;
 			status = SWITCH_STATUS_SUCCESS;
 			break;
@@ -1882,6 +2870,10 @@ SWITCH_DECLARE(switch_status_t) switch_event_unbind(switch_event_node_t **node)
 	switch_thread_rwlock_unlock(RWLOCK);
 	/* </LOCKED> ----------------------------------------------- */
 
+	if (status == SWITCH_STATUS_SUCCESS) {
+		switch_event_node_destroy(&n);
+	}
+
 	return status;
 }
 
@@ -2218,6 +3210,414 @@ SWITCH_DECLARE(char *) switch_event_expand_headers_check(switch_event_t *event,
 	return data;
 }
 
+typedef enum {
+	TPL_LITERAL,
+	TPL_VAR,
+	TPL_RAW
+} tpl_token_type_t;
+
+/* VAR is a plain ${name[idx]:offset:len} resolved straight from the channel or event,
+   RAW is anything fancier (api calls, $${globals}, nested expansion) handed to the regular expander */
+typedef struct {
+	tpl_token_type_t type;
+	char *str;
+	switch_size_t len;
+	int idx;
+	int offset;
+	int ooffset;
+} tpl_token_t;
+
+struct switch_expand_template {
+	char *in;
+	tpl_token_t *tokens;
+	int token_count;
+	int verbatim;				/* expands to the source string itself */
+	switch_size_t literal_len;
+	switch_memory_pool_t *pool;
+};
+
+static void tpl_add_token(tpl_token_t **tokens, int *count, int *size, tpl_token_type_t type, const char *str, switch_size_t len)
+{
+	tpl_token_t *tok;
+
+	if (*count == *size) {
+		*size = *size ? *size * 2 : 8;
+		*tokens = realloc(*tokens, *size * sizeof(**tokens));
+		switch_assert(*tokens);
+	}
+
+	tok = &(*tokens)[(*count)++];
+	memset(tok, 0, sizeof(*tok));
+	tok->type = type;
+	tok->idx = -1;
+	tok->str = malloc(len + 1);
+	switch_assert(tok->str);
+	memcpy(tok->str, str, len);
+	tok->str[len] = '\0';
+	tok->len = len;
+}
+
+static void tpl_flush_literal(tpl_token_t **tokens, int *count, int *size, char *lit, switch_size_t *lit_len)
+{
+	if (*lit_len) {
+		tpl_add_token(tokens, count, size, TPL_LITERAL, lit, *lit_len);
+		*lit_len = 0;
+	}
+}
+
+SWITCH_DECLARE(switch_status_t) switch_expand_template_create(switch_expand_template_t **tplP, const char *in, switch_memory_pool_t *pool)
+{
+	switch_expand_template_t *tpl;
+	tpl_token_t *tokens = NULL;
+	int count = 0, size = 0, i;
+	char *indup = NULL, *endof_indup, *lit = NULL, *p, *sb, *mem;
+	switch_size_t lit_len = 0, need, in_len;
+	size_t vtype = 0, br = 0;
+	int nv = 0, verbatim = 0;
+
+	switch_assert(tplP);
+	*tplP = NULL;
+
+	in = switch_str_nil(in);
+	in_len = strlen(in);
+
+	if (!(switch_string_var_check_const(in) || switch_string_has_escaped_data(in))) {
+		/* switch_channel_expand_variables() hands these back untouched, escapes and all */
+		verbatim = 1;
+		if (in_len) {
+			tpl_add_token(&tokens, &count, &size, TPL_LITERAL, in, in_len);
+		}
+		goto pack;
+	}
+
+	/* the scan below follows switch_event_expand_headers_check() step for step so a template expands exactly like its source */
+	indup = strdup(in);
+	switch_assert(indup);
+	endof_indup = end_of_p(indup) + 1;
+	lit = malloc(in_len + 1);
+	switch_assert(lit);
+
+	for (p = indup; p && p < endof_indup && *p; p++) {
+		int global = 0;
+		vtype = 0;
+
+		if (*p == '\\') {
+			if (*(p + 1) == '$') {
+				nv = 1;
+				p++;
+				if (*(p + 1) == '$') {
+					p++;
+				}
+			} else if (*(p + 1) == '\'') {
+				p++;
+				continue;
+			} else if (*(p + 1) == '\\') {
+				lit[lit_len++] = *p++;
+				continue;
+			}
+		}
+
+		if (*p == '$' && !nv) {
+
+			if (*(p + 1) == '$') {
+				p++;
+				global++;
+			}
+
+			if (*(p + 1)) {
+				if (*(p + 1) == '{') {
+					vtype = global ? 3 : 1;
+				} else {
+					nv = 1;
+				}
+			} else {
+				nv = 1;
+			}
+		}
+
+		if (nv) {
+			lit[lit_len++] = *p;
+			nv = 0;
+			continue;
+		}
+
+		if (vtype) {
+			char *s = p, *e, *vname;
+
+			s++;
+
+			if ((vtype == 1 || vtype == 3) && *s == '{') {
+				br = 1;
+				s++;
+			}
+
+			e = s;
+			vname = s;
+			while (*e) {
+				if (br == 1 && *e == '}') {
+					br = 0;
+					*e++ = '\0';
+					break;
+				}
+
+				if (br > 0) {
+					if (e != s && *e == '{') {
+						br++;
+					} else if (br > 1 && *e == '}') {
+						br--;
+					}
+				}
+
+				e++;
+			}
+			p = e > endof_indup ? endof_indup : e;
+
+			tpl_flush_literal(&tokens, &count, &size, lit, &lit_len);
+
+			for (sb = vname; *sb && *sb != ' ' && *sb != '('; sb++);
+
+			if (vtype == 1 && !*sb && !switch_string_var_check_const(vname) && !switch_string_has_escaped_data(vname)) {
+				tpl_token_t *tok;
+				char *ptr;
+
+				tpl_add_token(&tokens, &count, &size, TPL_VAR, vname, strlen(vname));
+				tok = &tokens[count - 1];
+
+				if ((ptr = strchr(tok->str, ':'))) {
+					*ptr++ = '\0';
+					tok->offset = atoi(ptr);
+					if ((ptr = strchr(ptr, ':'))) {
+						ptr++;
+						tok->ooffset = atoi(ptr);
+					}
+				}
+
+				if ((ptr = strchr(tok->str, '[')) && strchr(ptr, ']')) {
+					*ptr++ = '\0';
+					tok->idx = atoi(ptr);
+				}
+
+				tok->len = strlen(tok->str);
+			} else {
+				char *raw = switch_mprintf("%s{%s}", vtype == 3 ? "$$" : "$", vname);
+
+				switch_assert(raw);
+				tpl_add_token(&tokens, &count, &size, TPL_RAW, raw, strlen(raw));
+				free(raw);
+			}
+
+			vtype = 0;
+			br = 0;
+		}
+
+		if (*p == '$') {
+			p--;
+		} else if (*p) {
+			lit[lit_len++] = *p;
+		}
+	}
+
+	tpl_flush_literal(&tokens, &count, &size, lit, &lit_len);
+
+  pack:
+
+	/* one block for the lot so it can live in a pool */
+	need = sizeof(*tpl) + count * sizeof(*tokens) + in_len + 1;
+	for (i = 0; i < count; i++) {
+		need += tokens[i].len + 1;
+	}
+
+	mem = pool ? switch_core_alloc(pool, need) : malloc(need);
+	switch_assert(mem);
+	memset(mem, 0, need);
+
+	tpl = (switch_expand_template_t *) mem;
+	mem += sizeof(*tpl);
+	tpl->tokens = (tpl_token_t *) mem;
+	mem += count * sizeof(*tokens);
+	tpl->in = mem;
+	memcpy(tpl->in, in, in_len);
+	mem += in_len + 1;
+
+	for (i = 0; i < count; i++) {
+		tpl->tokens[i] = tokens[i];
+		tpl->tokens[i].str = mem;
+		memcpy(mem, tokens[i].str, tokens[i].len);
+		mem += tokens[i].len + 1;
+		if (tokens[i].type == TPL_LITERAL) {
+			tpl->literal_len += tokens[i].len;
+		}
+		free(tokens[i].str);
+	}
+
+	tpl->token_count = count;
+	tpl->verbatim = verbatim;
+	tpl->pool = pool;
+
+	switch_safe_free(tokens);
+	switch_safe_free(lit);
+	switch_safe_free(indup);
+
+	*tplP = tpl;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_expand_template_destroy(switch_expand_template_t **tplP)
+{
+	switch_expand_template_t *tpl;
+
+	if (!tplP || !(tpl = *tplP)) {
+		return;
+	}
+
+	*tplP = NULL;
+
+	if (!tpl->pool) {
+		free(tpl);
+	}
+}
+
+SWITCH_DECLARE(const char *) switch_expand_template_get_source(switch_expand_template_t *tpl)
+{
+	return tpl ? tpl->in : NULL;
+}
+
+static void tpl_append(char **data, switch_size_t *len, switch_size_t *size, const char *s, switch_size_t slen)
+{
+	if (*len + slen + 1 > *size) {
+		char *tmp;
+
+		while (*len + slen + 1 > *size) {
+			*size *= 2;
+		}
+		tmp = realloc(*data, *size);
+		switch_assert(tmp);
+		*data = tmp;
+	}
+
+	memcpy(*data + *len, s, slen);
+	*len += slen;
+	(*data)[*len] = '\0';
+}
+
+/* ${name:offset:len} on a value of vlen bytes, same rules as the expanders */
+static void tpl_slice(const char **val, switch_size_t *vlen, int offset, int ooffset)
+{
+	if (offset >= 0) {
+		if ((switch_size_t) offset > *vlen) {
+			*vlen = 0;
+		} else {
+			*val += offset;
+			*vlen -= offset;
+		}
+	} else if ((switch_size_t) abs(offset) <= *vlen) {
+		*val += *vlen + offset;
+		*vlen = (switch_size_t) -offset;
+	}
+
+	if (ooffset > 0 && (switch_size_t) ooffset < *vlen) {
+		*vlen = ooffset;
+	}
+}
+
+static char *tpl_expand(switch_channel_t *channel, switch_event_t *event, switch_expand_template_t *tpl, switch_event_t *var_list, switch_event_t *api_list)
+{
+	char *data;
+	switch_size_t len = 0, size;
+	int i;
+
+	if (!tpl) {
+		return NULL;
+	}
+
+	if (tpl->verbatim) {
+		return tpl->in;
+	}
+
+	size = tpl->literal_len + 128;
+	data = malloc(size);
+	switch_assert(data);
+	*data = '\0';
+
+	for (i = 0; i < tpl->token_count; i++) {
+		tpl_token_t *tok = &tpl->tokens[i];
+		const char *sub_val = NULL;
+		char *expanded = NULL, *gvar = NULL;
+		switch_size_t vlen;
+
+		switch (tok->type) {
+		case TPL_LITERAL:
+			tpl_append(&data, &len, &size, tok->str, tok->len);
+			break;
+		case TPL_RAW:
+			if (channel) {
+				expanded = switch_channel_expand_variables_check(channel, tok->str, var_list, api_list, 0);
+			} else {
+				expanded = switch_event_expand_headers_check(event, tok->str, var_list, api_list, 0);
+			}
+			if (expanded) {
+				tpl_append(&data, &len, &size, expanded, strlen(expanded));
+				if (expanded != tok->str) {
+					free(expanded);
+				}
+			}
+			break;
+		case TPL_VAR:
+			if (channel) {
+				if ((sub_val = switch_channel_get_variable_dup(channel, tok->str, SWITCH_TRUE, tok->idx))) {
+					if (var_list && !switch_event_check_permission_list(var_list, tok->str)) {
+						sub_val = "INVALID";
+					}
+					if ((expanded = switch_channel_expand_variables_check(channel, sub_val, var_list, api_list, 1)) != sub_val) {
+						sub_val = expanded;
+					} else {
+						expanded = NULL;
+					}
+				}
+			} else if (!(sub_val = switch_event_get_header_idx(event, tok->str, tok->idx))) {
+				sub_val = gvar = switch_core_get_variable_dup(tok->str);
+
+				if (var_list && !switch_event_check_permission_list(var_list, tok->str)) {
+					sub_val = "INVALID";
+				}
+
+				if ((expanded = switch_event_expand_headers_check(event, sub_val, var_list, api_list, 1)) != sub_val) {
+					sub_val = expanded;
+				} else {
+					expanded = NULL;
+				}
+			}
+
+			if (sub_val) {
+				vlen = strlen(sub_val);
+				tpl_slice(&sub_val, &vlen, tok->offset, tok->ooffset);
+				tpl_append(&data, &len, &size, sub_val, vlen);
+			}
+
+			switch_safe_free(expanded);
+			switch_safe_free(gvar);
+			break;
+		}
+	}
+
+	return data;
+}
+
+SWITCH_DECLARE(char *) switch_event_expand_template_check(switch_event_t *event, switch_expand_template_t *tpl, switch_event_t *var_list, switch_event_t *api_list)
+{
+	return tpl_expand(NULL, event, tpl, var_list, api_list);
+}
+
+/* lives here rather than in switch_channel.c so the template stays private to one file */
+SWITCH_DECLARE(char *) switch_channel_expand_template_check(switch_channel_t *channel, switch_expand_template_t *tpl, switch_event_t *var_list, switch_event_t *api_list)
+{
+	switch_assert(channel);
+
+	return tpl_expand(channel, NULL, tpl, var_list, api_list);
+}
+
+
 SWITCH_DECLARE(char *) switch_event_build_param_string(switch_event_t *event, const char *prefix, switch_hash_t *vars_map)
 {
 	switch_stream_handle_t stream = { 0 };
@@ -2262,6 +3662,8 @@ SWITCH_DECLARE(char *) switch_event_build_param_string(switch_event_t *event, co
 	}
 
 	if (event) {
+		switch_event_expand_snapshot(event);
+
 		if ((hi = event->headers)) {
 
 			for (; hi; hi = hi->next) {
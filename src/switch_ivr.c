@@ -534,6 +534,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_parse_event(switch_core_session_t *se
 		char *content_type = switch_event_get_header(event, "content-type");
 		char *loop_h = switch_event_get_header(event, "loops");
 		char *hold_bleg = switch_event_get_header(event, "hold-bleg");
+		char *event_uuid = switch_event_get_header(event, "event-uuid");
 		int loops = 1;
 		int inner = 0;
 
@@ -592,6 +593,10 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_parse_event(switch_core_session_t *se
 				}
 			}
 
+			if (event_uuid) {
+				switch_channel_set_variable(channel, "app_uuid", event_uuid);
+			}
+
 			for (x = 0; x < loops || loops < 0; x++) {
 				switch_time_t b4, aftr;
 
@@ -600,6 +605,9 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_parse_event(switch_core_session_t *se
 				b4 = switch_micro_time_now();
 				if (switch_core_session_execute_application(session, app_name, app_arg) != SWITCH_STATUS_SUCCESS) {
 					if (!inner || switch_channel_test_flag(channel, CF_STOP_BROADCAST)) switch_channel_clear_flag(channel, CF_BROADCAST);
+					if (event_uuid) {
+						switch_channel_set_variable(channel, "app_uuid", NULL);
+					}
 					goto done;
 				}
 
@@ -609,6 +617,10 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_parse_event(switch_core_session_t *se
 				}
 			}
 
+			if (event_uuid) {
+				switch_channel_set_variable(channel, "app_uuid", NULL);
+			}
+
 			if (b_uuid) {
 				if ((b_session = switch_core_session_locate(b_uuid))) {
 					switch_channel_t *b_channel = switch_core_session_get_channel(b_session);
@@ -2725,6 +2737,492 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_generate_json_cdr(switch_core_session
 	
 }
 
+#define CDR_WRITER_MAX_DEPTH 16
+
+typedef struct {
+	switch_stream_handle_t *stream;
+	switch_bool_t json;
+	int depth;
+	int in_tag;
+	uint8_t has_child[CDR_WRITER_MAX_DEPTH];
+	char *buf;
+	switch_size_t buflen;
+} cdr_writer_t;
+
+#define cdr_write(_w, _s, _l) (_w)->stream->raw_write_function((_w)->stream, (uint8_t *) (_s), (_l))
+#define cdr_write_str(_w, _s) cdr_write(_w, _s, strlen(_s))
+
+/* same escaping as cJSON_PrintUnformatted(), other control characters are dropped */
+static void cdr_json_encode(cdr_writer_t *w, const char *s)
+{
+	const char *p, *run;
+
+	cdr_write(w, "\"", 1);
+
+	for (p = run = switch_str_nil(s); *p; p++) {
+		const char *esc = NULL;
+
+		if ((unsigned char) *p > 31 && *p != '"' && *p != '\\') {
+			continue;
+		}
+
+		if (p > run) {
+			cdr_write(w, run, p - run);
+		}
+		run = p + 1;
+
+		switch (*p) {
+		case '\\':
+			esc = "\\\\";
+			break;
+		case '"':
+			esc = "\\\"";
+			break;
+		case '\b':
+			esc = "\\b";
+			break;
+		case '\f':
+			esc = "\\f";
+			break;
+		case '\n':
+			esc = "\\n";
+			break;
+		case '\r':
+			esc = "\\r";
+			break;
+		case '\t':
+			esc = "\\t";
+			break;
+		default:
+			break;
+		}
+
+		if (esc) {
+			cdr_write(w, esc, 2);
+		}
+	}
+
+	if (p > run) {
+		cdr_write(w, run, p - run);
+	}
+
+	cdr_write(w, "\"", 1);
+}
+
+static void cdr_indent(cdr_writer_t *w, int depth)
+{
+	int i;
+
+	for (i = 0; i < depth; i++) {
+		cdr_write(w, "  ", 2);
+	}
+}
+
+/* account for a new child of the element currently open, the output matches switch_xml_toxml() and cJSON_PrintUnformatted() */
+static void cdr_begin_child(cdr_writer_t *w)
+{
+	if (w->json) {
+		if (w->depth && w->has_child[w->depth - 1]) {
+			cdr_write(w, ",", 1);
+		}
+	} else if (w->in_tag) {
+		cdr_write(w, ">\n", 2);
+		w->in_tag = 0;
+	}
+
+	if (w->depth) {
+		w->has_child[w->depth - 1] = 1;
+	}
+}
+
+static void cdr_open(cdr_writer_t *w, const char *name)
+{
+	switch_assert(w->depth < CDR_WRITER_MAX_DEPTH);
+
+	cdr_begin_child(w);
+
+	if (w->json) {
+		if (w->depth) {
+			cdr_json_encode(w, name);
+			cdr_write(w, ":", 1);
+		}
+		cdr_write(w, "{", 1);
+	} else {
+		cdr_indent(w, w->depth);
+		cdr_write(w, "<", 1);
+		cdr_write_str(w, name);
+		w->in_tag = 1;
+	}
+
+	w->has_child[w->depth++] = 0;
+}
+
+static void cdr_close(cdr_writer_t *w, const char *name)
+{
+	w->depth--;
+
+	if (w->json) {
+		cdr_write(w, "}", 1);
+		return;
+	}
+
+	if (w->in_tag) {
+		cdr_write(w, ">", 1);
+		w->in_tag = 0;
+	} else {
+		cdr_indent(w, w->depth);
+	}
+
+	cdr_write(w, "</", 2);
+	cdr_write_str(w, name);
+	cdr_write(w, ">\n", 2);
+}
+
+/* an attribute of the element just opened, or a plain member in json */
+static void cdr_attr(cdr_writer_t *w, const char *name, const char *val)
+{
+	if (w->json) {
+		cdr_begin_child(w);
+		cdr_json_encode(w, name);
+		cdr_write(w, ":", 1);
+		cdr_json_encode(w, val);
+		return;
+	}
+
+	switch_assert(w->in_tag);
+
+	cdr_write(w, " ", 1);
+	cdr_write_str(w, name);
+	cdr_write(w, "=\"", 2);
+	switch_xml_stream_encode(w->stream, val, SWITCH_TRUE);
+	cdr_write(w, "\"", 1);
+}
+
+static void cdr_field(cdr_writer_t *w, const char *name, const char *val)
+{
+	if (w->json) {
+		cdr_attr(w, name, val);
+		return;
+	}
+
+	cdr_begin_child(w);
+	cdr_indent(w, w->depth);
+	cdr_write(w, "<", 1);
+	cdr_write_str(w, name);
+	cdr_write(w, ">", 1);
+	switch_xml_stream_encode(w->stream, val, SWITCH_FALSE);
+
+	if (!zstr(val) && end_of(val) == '\n') {
+		cdr_indent(w, w->depth);
+	}
+
+	cdr_write(w, "</", 2);
+	cdr_write_str(w, name);
+	cdr_write(w, ">\n", 2);
+}
+
+static void cdr_field_time(cdr_writer_t *w, const char *name, switch_time_t t)
+{
+	char tmp[64];
+
+	switch_snprintf(tmp, sizeof(tmp), "%" SWITCH_TIME_T_FMT, t);
+	cdr_field(w, name, tmp);
+}
+
+/* url encode into the writer's scratch buffer, which is reused for every value */
+static const char *cdr_url_encode(cdr_writer_t *w, const char *val)
+{
+	switch_size_t need = strlen(val) * 3 + 1;
+
+	if (need > w->buflen) {
+		char *tmp;
+
+		if (!(tmp = realloc(w->buf, need))) {
+			abort();
+		}
+		w->buf = tmp;
+		w->buflen = need;
+	}
+
+	memset(w->buf, 0, need);
+	switch_url_encode(val, w->buf, need);
+
+	return w->buf;
+}
+
+static void cdr_profile_data(cdr_writer_t *w, switch_caller_profile_t *caller_profile)
+{
+	if (w->json) {
+		cdr_field(w, "username", caller_profile->username);
+		cdr_field(w, "dialplan", caller_profile->dialplan);
+		cdr_field(w, "caller_id_name", caller_profile->caller_id_name);
+		cdr_field(w, "ani", caller_profile->ani);
+		cdr_field(w, "aniii", caller_profile->aniii);
+		cdr_field(w, "caller_id_number", caller_profile->caller_id_number);
+		cdr_field(w, "network_addr", caller_profile->network_addr);
+		cdr_field(w, "rdnis", caller_profile->rdnis);
+		cdr_field(w, "destination_number", caller_profile->destination_number);
+		cdr_field(w, "uuid", caller_profile->uuid);
+		cdr_field(w, "source", caller_profile->source);
+		cdr_field(w, "context", caller_profile->context);
+		cdr_field(w, "chan_name", caller_profile->chan_name);
+		return;
+	}
+
+	cdr_field(w, "username", caller_profile->username);
+	cdr_field(w, "dialplan", caller_profile->dialplan);
+	cdr_field(w, "caller_id_name", caller_profile->caller_id_name);
+	cdr_field(w, "caller_id_number", caller_profile->caller_id_number);
+	cdr_field(w, "callee_id_name", caller_profile->callee_id_name);
+	cdr_field(w, "callee_id_number", caller_profile->callee_id_number);
+	cdr_field(w, "ani", caller_profile->ani);
+	cdr_field(w, "aniii", caller_profile->aniii);
+	cdr_field(w, "network_addr", caller_profile->network_addr);
+	cdr_field(w, "rdnis", caller_profile->rdnis);
+	cdr_field(w, "destination_number", caller_profile->destination_number);
+	cdr_field(w, "uuid", caller_profile->uuid);
+	cdr_field(w, "source", caller_profile->source);
+
+	if (caller_profile->transfer_source) {
+		cdr_field(w, "transfer_source", caller_profile->transfer_source);
+	}
+
+	cdr_field(w, "context", caller_profile->context);
+	cdr_field(w, "chan_name", caller_profile->chan_name);
+
+	if (caller_profile->soft) {
+		profile_node_t *pn;
+
+		for (pn = caller_profile->soft; pn; pn = pn->next) {
+			cdr_field(w, pn->var, pn->val);
+		}
+	}
+}
+
+static void cdr_chan_var(cdr_writer_t *w, const char *var, const char *val, switch_bool_t urlencode)
+{
+	if (zstr(var) || zstr(val)) {
+		return;
+	}
+
+	cdr_field(w, var, urlencode ? cdr_url_encode(w, val) : val);
+}
+
+static void cdr_chan_vars(cdr_writer_t *w, switch_channel_t *channel, switch_bool_t urlencode)
+{
+	switch_event_header_t *hi = switch_channel_variable_first(channel);
+
+	if (!hi)
+		return;
+
+	for (; hi; hi = hi->next) {
+		if (hi->idx && !w->json) {
+			int i;
+
+			for (i = 0; i < hi->idx; i++) {
+				cdr_chan_var(w, hi->name, hi->array[i], urlencode);
+			}
+		} else {
+			cdr_chan_var(w, hi->name, hi->value, urlencode);
+		}
+	}
+	switch_channel_variable_last(channel);
+}
+
+static void cdr_extension(cdr_writer_t *w, switch_caller_profile_t *cp, switch_bool_t with_dialplan)
+{
+	switch_caller_extension_t *ext = cp->caller_extension;
+	switch_caller_application_t *ap;
+
+	cdr_open(w, "extension");
+	cdr_attr(w, "name", ext->extension_name);
+	cdr_attr(w, "number", ext->extension_number);
+
+	if (with_dialplan) {
+		cdr_attr(w, "dialplan", cp->dialplan);
+	}
+
+	if (ext->current_application) {
+		cdr_attr(w, "current_app", ext->current_application->application_name);
+	}
+
+	for (ap = ext->applications; ap; ap = ap->next) {
+		cdr_open(w, "application");
+		if (ap == ext->current_application) {
+			cdr_attr(w, "last_executed", "true");
+		}
+		cdr_attr(w, "app_name", ap->application_name);
+		cdr_attr(w, "app_data", ap->application_data);
+		cdr_close(w, "application");
+	}
+}
+
+static void cdr_profile_list(cdr_writer_t *w, const char *name, const char *item, switch_caller_profile_t *list)
+{
+	switch_caller_profile_t *cp;
+
+	cdr_open(w, name);
+
+	for (cp = list; cp; cp = cp->next) {
+		cdr_open(w, item);
+		cdr_profile_data(w, cp);
+		cdr_close(w, item);
+	}
+
+	cdr_close(w, name);
+}
+
+static switch_status_t switch_ivr_stream_cdr(switch_core_session_t *session, switch_stream_handle_t *stream, switch_bool_t json, switch_bool_t urlencode)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	switch_caller_profile_t *caller_profile;
+	switch_app_log_t *app_log;
+	cdr_writer_t w = { 0 };
+	char tmp[512], *f;
+
+	switch_assert(stream->raw_write_function);
+
+	w.stream = stream;
+	w.json = json;
+
+	cdr_open(&w, "cdr");
+
+	cdr_open(&w, "channel_data");
+	cdr_field(&w, "state", switch_channel_state_name(switch_channel_get_state(channel)));
+	cdr_field(&w, "direction", switch_channel_direction(channel) == SWITCH_CALL_DIRECTION_OUTBOUND ? "outbound" : "inbound");
+
+	switch_snprintf(tmp, sizeof(tmp), "%d", switch_channel_get_state(channel));
+	cdr_field(&w, "state_number", tmp);
+
+	if ((f = switch_channel_get_flag_string(channel))) {
+		cdr_field(&w, "flags", f);
+		free(f);
+	}
+
+	if ((f = switch_channel_get_cap_string(channel))) {
+		cdr_field(&w, "caps", f);
+		free(f);
+	}
+	cdr_close(&w, "channel_data");
+
+	cdr_open(&w, "variables");
+	cdr_chan_vars(&w, channel, urlencode);
+	cdr_close(&w, "variables");
+
+	if ((app_log = switch_core_session_get_app_log(session))) {
+		switch_app_log_t *ap;
+
+		cdr_open(&w, "app_log");
+		for (ap = app_log; ap; ap = ap->next) {
+			cdr_open(&w, "application");
+			cdr_attr(&w, "app_name", ap->app);
+			cdr_attr(&w, "app_data", ap->arg);
+			if (!json) {
+				switch_snprintf(tmp, sizeof(tmp), "%" SWITCH_TIME_T_FMT, ap->stamp);
+				cdr_attr(&w, "app_stamp", tmp);
+			}
+			cdr_close(&w, "application");
+		}
+		cdr_close(&w, "app_log");
+	}
+
+	for (caller_profile = switch_channel_get_caller_profile(channel); caller_profile; caller_profile = caller_profile->next) {
+		cdr_open(&w, "callflow");
+
+		if (!zstr(caller_profile->dialplan)) {
+			cdr_attr(&w, "dialplan", caller_profile->dialplan);
+		}
+
+		if (!json && !zstr(caller_profile->uuid_str)) {
+			cdr_attr(&w, "unique-id", caller_profile->uuid_str);
+		}
+
+		if (!json && !zstr(caller_profile->clone_of)) {
+			cdr_attr(&w, "clone-of", caller_profile->clone_of);
+		}
+
+		if (!zstr(caller_profile->profile_index)) {
+			cdr_attr(&w, "profile_index", caller_profile->profile_index);
+		}
+
+		if (caller_profile->caller_extension) {
+			switch_caller_profile_t *cp;
+
+			cdr_extension(&w, caller_profile, SWITCH_FALSE);
+
+			for (cp = caller_profile->caller_extension->children; cp; cp = cp->next) {
+				if (!cp->caller_extension) {
+					continue;
+				}
+				cdr_open(&w, "sub_extensions");
+				cdr_extension(&w, cp, SWITCH_TRUE);
+				cdr_close(&w, "extension");
+				cdr_close(&w, "sub_extensions");
+			}
+
+			cdr_close(&w, "extension");
+		}
+
+		cdr_open(&w, "caller_profile");
+		cdr_profile_data(&w, caller_profile);
+
+		if (!json && caller_profile->origination_caller_profile) {
+			cdr_profile_list(&w, "origination", "origination_caller_profile", caller_profile->origination_caller_profile);
+		}
+
+		if (caller_profile->originator_caller_profile) {
+			cdr_profile_list(&w, "originator", "originator_caller_profile", caller_profile->originator_caller_profile);
+		}
+
+		if (caller_profile->originatee_caller_profile) {
+			cdr_profile_list(&w, "originatee", "originatee_caller_profile", caller_profile->originatee_caller_profile);
+		}
+		cdr_close(&w, "caller_profile");
+
+		if (caller_profile->times) {
+			switch_channel_timetable_t *times = caller_profile->times;
+
+			cdr_open(&w, "times");
+			cdr_field_time(&w, "created_time", times->created);
+			cdr_field_time(&w, "profile_created_time", times->profile_created);
+			cdr_field_time(&w, "progress_time", times->progress);
+			cdr_field_time(&w, "progress_media_time", times->progress_media);
+			cdr_field_time(&w, "answered_time", times->answered);
+			if (!json) {
+				cdr_field_time(&w, "bridged_time", times->bridged);
+				cdr_field_time(&w, "last_hold_time", times->last_hold);
+				cdr_field_time(&w, "hold_accum_time", times->hold_accum);
+			}
+			cdr_field_time(&w, "hangup_time", times->hungup);
+			cdr_field_time(&w, "resurrect_time", times->resurrected);
+			cdr_field_time(&w, "transfer_time", times->transferred);
+			cdr_close(&w, "times");
+		}
+
+		cdr_close(&w, "callflow");
+	}
+
+	cdr_close(&w, "cdr");
+
+	switch_safe_free(w.buf);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_ivr_stream_xml_cdr(switch_core_session_t *session, switch_stream_handle_t *stream, switch_bool_t prn_header)
+{
+	if (prn_header) {
+		stream->write_function(stream, "<?xml version=\"1.0\"?>\n");
+	}
+
+	return switch_ivr_stream_cdr(session, stream, SWITCH_FALSE, SWITCH_TRUE);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_ivr_stream_json_cdr(switch_core_session_t *session, switch_stream_handle_t *stream, switch_bool_t urlencode)
+{
+	return switch_ivr_stream_cdr(session, stream, SWITCH_TRUE, urlencode);
+}
+
 
 SWITCH_DECLARE(void) switch_ivr_park_session(switch_core_session_t *session)
 {
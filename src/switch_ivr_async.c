@@ -42,14 +42,35 @@ struct switch_ivr_dmachine_binding {
 	int32_t key;
 	switch_ivr_dmachine_callback_t callback;
 	switch_byte_t is_regex;
+	/* compiled once at bind time, NULL for a literal binding or a pattern that does not compile */
+	switch_regex_t *re;
+	/* order of binding within the realm, earlier bindings win ties */
+	uint32_t seq;
 	void *user_data;
 	struct switch_ivr_dmachine_binding *next;
 };
 typedef struct switch_ivr_dmachine_binding switch_ivr_dmachine_binding_t;
 
+/*
+ * Literal bindings are also kept in a trie over the DTMF digits so matching walks the digits entered instead of
+ * comparing them against every binding.  A node has the first binding ending on it and the newest binding that
+ * goes on past it, which is all the list walk below ever needed to know about the bindings sharing a prefix.
+ */
+#define DM_TRIE_DIGITS 16
+
+typedef struct dm_trie_node {
+	switch_ivr_dmachine_binding_t *exact;
+	uint32_t longer_seq;
+	struct dm_trie_node *next[DM_TRIE_DIGITS];
+} dm_trie_node_t;
+
 typedef struct {
 	switch_ivr_dmachine_binding_t *binding_list;
 	switch_ivr_dmachine_binding_t *tail;
+	dm_trie_node_t trie;
+	uint32_t seq;
+	/* a regex or a digit the trie has no branch for, matching walks the list */
+	switch_byte_t list_only;
 } dm_binding_head_t;
 
 struct switch_ivr_dmachine {
@@ -75,8 +96,44 @@ struct switch_ivr_dmachine {
 	void *user_data;
 	switch_mutex_t *mutex;
 	switch_status_t last_return;
+	/* bumped whenever the digits or the bindings change, ping reuses the last check until then */
+	uint32_t gen;
+	uint32_t checked_gen;
+	switch_bool_t checked_timeout;
+	int checked;
+	int checked_match;
 };
 
+static int dm_trie_index(char digit)
+{
+	if (digit >= '0' && digit <= '9') {
+		return digit - '0';
+	}
+
+	switch (digit) {
+	case '*':
+		return 10;
+	case '#':
+		return 11;
+	case 'A':
+	case 'B':
+	case 'C':
+	case 'D':
+		return 12 + (digit - 'A');
+	default:
+		return -1;
+	}
+}
+
+static void dm_realm_free_regex(dm_binding_head_t *headp)
+{
+	switch_ivr_dmachine_binding_t *bp;
+
+	for (bp = headp->binding_list; bp; bp = bp->next) {
+		switch_regex_safe_free(bp->re);
+	}
+}
+
 
 SWITCH_DECLARE(switch_status_t) switch_ivr_dmachine_last_ping(switch_ivr_dmachine_t *dmachine)
 {
@@ -174,11 +231,18 @@ SWITCH_DECLARE(void) switch_ivr_dmachine_set_input_timeout_ms(switch_ivr_dmachin
 SWITCH_DECLARE(void) switch_ivr_dmachine_destroy(switch_ivr_dmachine_t **dmachine)
 {
 	switch_memory_pool_t *pool;
+	switch_hash_index_t *hi;
+	void *val;
 
 	if (!(dmachine && *dmachine)) return;
 	
 	pool = (*dmachine)->pool;
 
+	for (hi = switch_hash_first(NULL, (*dmachine)->binding_hash); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		dm_realm_free_regex((dm_binding_head_t *) val);
+	}
+
 	switch_core_hash_destroy(&(*dmachine)->binding_hash);
 	
 	if ((*dmachine)->my_pool) {
@@ -193,6 +257,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_dmachine_set_realm(switch_ivr_dmachin
 	if (headp) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Digit parser %s: Setting realm to '%s'\n", dmachine->name, realm);
 		dmachine->realm = headp;
+		dmachine->gen++;
 		return SWITCH_STATUS_SUCCESS;
 	}
 
@@ -220,6 +285,11 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_dmachine_clear_realm(switch_ivr_dmach
 		dmachine->realm = NULL;
 	}
 
+	if (headp) {
+		dm_realm_free_regex(headp);
+	}
+	dmachine->gen++;
+
 	/* pool alloc'd just ditch it and it will give back the memory when we destroy ourselves */
 	switch_core_hash_delete(dmachine->binding_hash, realm);
 	return SWITCH_STATUS_SUCCESS;
@@ -260,6 +330,41 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_dmachine_bind(switch_ivr_dmachine_t *
 	binding->digits = switch_core_strdup(dmachine->pool, digits);
 	binding->callback = callback;
 	binding->user_data = user_data;
+	binding->seq = ++headp->seq;
+
+	if (binding->is_regex) {
+		const char *error = NULL;
+		int erroffset = 0;
+
+		if (!(binding->re = switch_regex_compile(digits, 0, &error, &erroffset, NULL))) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Digit parser %s: regex %s does not compile at %d: %s\n",
+							  dmachine->name, digits, erroffset, switch_str_nil(error));
+		}
+		headp->list_only = 1;
+	} else if (!headp->list_only) {
+		dm_trie_node_t *node = &headp->trie;
+		const char *p;
+
+		for (p = digits; *p; p++) {
+			int i = dm_trie_index(*p);
+
+			if (i < 0) {
+				headp->list_only = 1;
+				break;
+			}
+
+			node->longer_seq = binding->seq;
+
+			if (!node->next[i]) {
+				node->next[i] = switch_core_alloc(dmachine->pool, sizeof(dm_trie_node_t));
+			}
+			node = node->next[i];
+		}
+
+		if (!*p && !node->exact) {
+			node->exact = binding;
+		}
+	}
 
 	if (headp->tail) {
 		headp->tail->next = binding;
@@ -268,6 +373,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_dmachine_bind(switch_ivr_dmachine_t *
 	}
 
 	headp->tail = binding;
+	dmachine->gen++;
 
 	len = strlen(digits);
 
@@ -301,6 +407,29 @@ typedef enum {
 } dm_match_t;
 
 
+/* the same answer the list walk gives for a realm of literal bindings, in one step per digit */
+static dm_match_t dm_trie_check_match(switch_ivr_dmachine_t *dmachine, switch_ivr_dmachine_binding_t **exact_bp)
+{
+	dm_trie_node_t *node = &dmachine->realm->trie;
+	const char *p;
+
+	for (p = dmachine->digits; *p && node; p++) {
+		int i = dm_trie_index(*p);
+
+		node = i < 0 ? NULL : node->next[i];
+	}
+
+	if (!node) {
+		return DM_MATCH_NEVER;
+	}
+
+	if ((*exact_bp = node->exact)) {
+		return node->longer_seq > node->exact->seq ? DM_MATCH_BOTH : DM_MATCH_EXACT;
+	}
+
+	return node->longer_seq ? DM_MATCH_PARTIAL : DM_MATCH_NEVER;
+}
+
 static dm_match_t switch_ivr_dmachine_check_match(switch_ivr_dmachine_t *dmachine, switch_bool_t is_timeout)
 {
 	dm_match_t best = DM_MATCH_NONE;
@@ -309,9 +438,21 @@ static dm_match_t switch_ivr_dmachine_check_match(switch_ivr_dmachine_t *dmachin
 	
 	if (!dmachine->cur_digit_len || !dmachine->realm) goto end;
 
+	if (!dmachine->realm->list_only) {
+		best = dm_trie_check_match(dmachine, &exact_bp);
+
+		if (best == DM_MATCH_BOTH) {
+			both_bp = exact_bp;
+		}
+
+		goto end;
+	}
+
 	for(bp = dmachine->realm->binding_list; bp; bp = bp->next) {
 		if (bp->is_regex) {
-			switch_status_t r_status = switch_regex_match(dmachine->digits, bp->digits);
+			int ovector[255];
+			switch_status_t r_status = switch_regex_exec(bp->re, dmachine->digits, ovector, sizeof(ovector) / sizeof(ovector[0])) > 0 ?
+				SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
 			pmatches = 1;
 
 			if (r_status == SWITCH_STATUS_SUCCESS) {
@@ -413,10 +554,21 @@ SWITCH_DECLARE(const char *) switch_ivr_dmachine_get_failed_digits(switch_ivr_dm
 SWITCH_DECLARE(switch_status_t) switch_ivr_dmachine_ping(switch_ivr_dmachine_t *dmachine, switch_ivr_dmachine_match_t **match_p)
 {
 	switch_bool_t is_timeout = switch_ivr_dmachine_check_timeout(dmachine);
-	dm_match_t is_match = switch_ivr_dmachine_check_match(dmachine, is_timeout);
+	dm_match_t is_match;
 	switch_status_t r, s;
 	int clear = 0;
 
+	/* pinged every frame, the digits only change a few times a second */
+	if (dmachine->checked && dmachine->checked_gen == dmachine->gen && dmachine->checked_timeout == is_timeout) {
+		is_match = (dm_match_t) dmachine->checked_match;
+	} else {
+		is_match = switch_ivr_dmachine_check_match(dmachine, is_timeout);
+		dmachine->checked = 1;
+		dmachine->checked_gen = dmachine->gen;
+		dmachine->checked_timeout = is_timeout;
+		dmachine->checked_match = (int) is_match;
+	}
+
 	if (is_match == DM_MATCH_NEVER) {
 		is_timeout++;
 	}
@@ -538,6 +690,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_dmachine_feed(switch_ivr_dmachine_t *
 			*e++ = *p;
 			*e = '\0';
 			dmachine->cur_digit_len++;
+			dmachine->gen++;
 			switch_mutex_unlock(dmachine->mutex);
 			dmachine->last_digit_time = switch_time_now();
 			if (status == SWITCH_STATUS_SUCCESS && (istatus = switch_ivr_dmachine_ping(dmachine, match)) != SWITCH_STATUS_SUCCESS) {
@@ -558,6 +711,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_dmachine_clear(switch_ivr_dmachine_t
 	memset(dmachine->digits, 0, sizeof(dmachine->digits));
 	dmachine->cur_digit_len = 0;
 	dmachine->last_digit_time = 0;
+	dmachine->gen++;
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -1643,6 +1797,305 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_eavesdrop_session(switch_core_session
 	return status;
 }
 
+#define NATIVE_WAV_HEADER_LEN 58
+#define NATIVE_MAX_SKEW 3200
+#define NATIVE_CHUNK 8192
+
+struct native_record_helper {
+	char *file;
+	switch_file_t *fd;
+	switch_mutex_t *mutex;
+	switch_buffer_t *read_buffer;
+	switch_buffer_t *write_buffer;
+	uint32_t ianacode;
+	uint16_t format;
+	uint8_t silence;
+	switch_bool_t swap;
+	switch_bool_t failed;
+	uint32_t samples;
+	int min_sec;
+	switch_bool_t hangup_on_error;
+	uint8_t out[NATIVE_CHUNK];
+};
+
+static void native_put16(uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t) (v & 0xff);
+	p[1] = (uint8_t) (v >> 8);
+}
+
+static void native_put32(uint8_t *p, uint32_t v)
+{
+	native_put16(p, (uint16_t) (v & 0xffff));
+	native_put16(p + 2, (uint16_t) (v >> 16));
+}
+
+/* a stereo 8 bit G.711 wav, the fmt chunk carries cbSize so non PCM readers accept it and the fact chunk the sample count */
+static switch_status_t native_write_header(struct native_record_helper *rh)
+{
+	uint8_t hdr[NATIVE_WAV_HEADER_LEN];
+	uint32_t datalen = rh->samples * 2;
+	switch_size_t len = sizeof(hdr);
+	int64_t off = 0;
+
+	memcpy(hdr, "RIFF", 4);
+	native_put32(hdr + 4, NATIVE_WAV_HEADER_LEN - 8 + datalen);
+	memcpy(hdr + 8, "WAVEfmt ", 8);
+	native_put32(hdr + 16, 18);
+	native_put16(hdr + 20, rh->format);
+	native_put16(hdr + 22, 2);
+	native_put32(hdr + 24, 8000);
+	native_put32(hdr + 28, 16000);
+	native_put16(hdr + 32, 2);
+	native_put16(hdr + 34, 8);
+	native_put16(hdr + 36, 0);
+	memcpy(hdr + 38, "fact", 4);
+	native_put32(hdr + 42, 4);
+	native_put32(hdr + 46, rh->samples);
+	memcpy(hdr + 50, "data", 4);
+	native_put32(hdr + 54, datalen);
+
+	if (switch_file_seek(rh->fd, SWITCH_SEEK_SET, &off) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	return switch_file_write(rh->fd, hdr, &len);
+}
+
+static void native_pad(switch_buffer_t *buffer, uint8_t silence, switch_size_t len)
+{
+	uint8_t pad[512];
+
+	memset(pad, silence, sizeof(pad));
+
+	while (len) {
+		switch_size_t n = len > sizeof(pad) ? sizeof(pad) : len;
+		switch_buffer_write(buffer, pad, n);
+		len -= n;
+	}
+}
+
+/* interleaves whatever both directions have in common, called with rh->mutex held */
+static switch_status_t native_drain(struct native_record_helper *rh, switch_bool_t flush)
+{
+	switch_size_t rlen = switch_buffer_inuse(rh->read_buffer);
+	switch_size_t wlen = switch_buffer_inuse(rh->write_buffer);
+
+	/* one direction stalled (hold, one way audio, dtx) so fill it in to keep the channels aligned */
+	if (flush || rlen > wlen + NATIVE_MAX_SKEW) {
+		if (rlen > wlen) {
+			native_pad(rh->write_buffer, rh->silence, rlen - wlen);
+			wlen = rlen;
+		}
+	}
+
+	if (flush || wlen > rlen + NATIVE_MAX_SKEW) {
+		if (wlen > rlen) {
+			native_pad(rh->read_buffer, rh->silence, wlen - rlen);
+			rlen = wlen;
+		}
+	}
+
+	while (!rh->failed) {
+		uint8_t left[NATIVE_CHUNK / 2], right[NATIVE_CHUNK / 2];
+		switch_size_t n = rlen < wlen ? rlen : wlen, i, len;
+
+		if (n > sizeof(left)) {
+			n = sizeof(left);
+		}
+
+		if (!n || (!flush && n < sizeof(left))) {
+			break;
+		}
+
+		switch_buffer_read(rh->swap ? rh->write_buffer : rh->read_buffer, left, n);
+		switch_buffer_read(rh->swap ? rh->read_buffer : rh->write_buffer, right, n);
+		rlen -= n;
+		wlen -= n;
+
+		for (i = 0; i < n; i++) {
+			rh->out[i * 2] = left[i];
+			rh->out[i * 2 + 1] = right[i];
+		}
+
+		len = n * 2;
+		if (switch_file_write(rh->fd, rh->out, &len) != SWITCH_STATUS_SUCCESS || len != n * 2) {
+			rh->failed = SWITCH_TRUE;
+			break;
+		}
+
+		rh->samples += (uint32_t) n;
+	}
+
+	return rh->failed ? SWITCH_STATUS_FALSE : SWITCH_STATUS_SUCCESS;
+}
+
+static switch_bool_t native_record_callback(switch_media_bug_t *bug, void *user_data, switch_abc_type_t type)
+{
+	switch_core_session_t *session = switch_core_media_bug_get_session(bug);
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	struct native_record_helper *rh = (struct native_record_helper *) user_data;
+	switch_frame_t *frame = NULL;
+	switch_event_t *event;
+
+	switch (type) {
+	case SWITCH_ABC_TYPE_INIT:
+		if (switch_event_create(&event, SWITCH_EVENT_RECORD_START) == SWITCH_STATUS_SUCCESS) {
+			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Record-File-Path", rh->file);
+			switch_channel_event_set_data(channel, event);
+			switch_event_fire(&event);
+		}
+		break;
+	case SWITCH_ABC_TYPE_CLOSE:
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Stop native recording file %s\n", rh->file);
+		switch_channel_set_private(channel, rh->file, NULL);
+
+		switch_mutex_lock(rh->mutex);
+		native_drain(rh, SWITCH_TRUE);
+		if (!rh->failed) {
+			native_write_header(rh);
+		}
+		switch_file_close(rh->fd);
+		rh->fd = NULL;
+		switch_buffer_destroy(&rh->read_buffer);
+		switch_buffer_destroy(&rh->write_buffer);
+		switch_mutex_unlock(rh->mutex);
+
+		if (rh->samples < 8000 * (uint32_t) rh->min_sec) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Discarding short file %s\n", rh->file);
+			switch_channel_set_variable(channel, "RECORD_DISCARDED", "true");
+			switch_file_remove(rh->file, switch_core_session_get_pool(session));
+		}
+
+		if (switch_event_create(&event, SWITCH_EVENT_RECORD_STOP) == SWITCH_STATUS_SUCCESS) {
+			switch_channel_event_set_data(channel, event);
+			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Record-File-Path", rh->file);
+			switch_event_fire(&event);
+		}
+		break;
+	case SWITCH_ABC_TYPE_TAP_NATIVE_READ:
+		frame = switch_core_media_bug_get_native_read_frame(bug);
+		break;
+	case SWITCH_ABC_TYPE_TAP_NATIVE_WRITE:
+		frame = switch_core_media_bug_get_native_write_frame(bug);
+		break;
+	default:
+		break;
+	}
+
+	if (frame && frame->datalen) {
+		switch_status_t status;
+
+		/* a reinvite can move the leg off G.711, the gap is padded with silence once the other side runs ahead */
+		if (!frame->codec || !frame->codec->implementation || frame->codec->implementation->ianacode != rh->ianacode ||
+			frame->codec->implementation->actual_samples_per_second != 8000) {
+			return SWITCH_TRUE;
+		}
+
+		switch_mutex_lock(rh->mutex);
+		switch_buffer_write(type == SWITCH_ABC_TYPE_TAP_NATIVE_READ ? rh->read_buffer : rh->write_buffer, frame->data, frame->datalen);
+		status = native_drain(rh, SWITCH_FALSE);
+		switch_mutex_unlock(rh->mutex);
+
+		if (status != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Error writing %s\n", rh->file);
+			if (rh->hangup_on_error) {
+				switch_channel_hangup(channel, SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER);
+				switch_core_session_reset(session, SWITCH_TRUE, SWITCH_TRUE);
+			}
+			return SWITCH_FALSE;
+		}
+	}
+
+	return SWITCH_TRUE;
+}
+
+/*
+  records the encoded frames as they cross the wire so G.711 calls are never decoded for the recording,
+  returns SWITCH_STATUS_NOTIMPL when the call or the file do not allow it so the caller can record as usual
+*/
+static switch_status_t record_session_native(switch_core_session_t *session, const char *path, uint32_t limit,
+											 switch_media_bug_flag_t flags, switch_bool_t hangup_on_error)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	switch_codec_implementation_t read_impl = { 0 }, write_impl = { 0 };
+	struct native_record_helper *rh;
+	switch_media_bug_t *bug;
+	switch_status_t status;
+	const char *ext, *p;
+	time_t to = 0;
+
+	switch_core_session_get_read_impl(session, &read_impl);
+	switch_core_session_get_write_impl(session, &write_impl);
+
+	if (!path || !(ext = strrchr(path, '.')) || strcasecmp(ext, ".wav")) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Native recording needs a plain .wav path, recording %s as usual\n",
+						  switch_str_nil(path));
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	if (read_impl.ianacode != write_impl.ianacode || (read_impl.ianacode != 0 && read_impl.ianacode != 8) ||
+		read_impl.actual_samples_per_second != 8000 || write_impl.actual_samples_per_second != 8000 ||
+		(flags & (SMBF_READ_STREAM | SMBF_WRITE_STREAM)) != (SMBF_READ_STREAM | SMBF_WRITE_STREAM)) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING,
+						  "Native recording needs PCMU or PCMA both ways (%s/%s), recording %s as usual\n",
+						  switch_str_nil(read_impl.iananame), switch_str_nil(write_impl.iananame), path);
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	rh = switch_core_session_alloc(session, sizeof(*rh));
+	rh->file = switch_core_session_strdup(session, path);
+	rh->ianacode = read_impl.ianacode;
+	rh->format = read_impl.ianacode ? 6 : 7;
+	rh->silence = read_impl.ianacode ? 0xD5 : 0xFF;
+	rh->swap = (flags & SMBF_STEREO_SWAP) ? SWITCH_TRUE : SWITCH_FALSE;
+	rh->hangup_on_error = hangup_on_error;
+
+	if ((p = switch_channel_get_variable(channel, "RECORD_MIN_SEC"))) {
+		int tmp = atoi(p);
+		if (tmp >= 0) {
+			rh->min_sec = tmp;
+		}
+	}
+
+	if (switch_file_open(&rh->fd, rh->file, SWITCH_FOPEN_WRITE | SWITCH_FOPEN_CREATE | SWITCH_FOPEN_TRUNCATE | SWITCH_FOPEN_BINARY,
+						 SWITCH_FPROT_UREAD | SWITCH_FPROT_UWRITE, switch_core_session_get_pool(session)) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Error opening %s\n", rh->file);
+		if (hangup_on_error) {
+			switch_channel_hangup(channel, SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER);
+			switch_core_session_reset(session, SWITCH_TRUE, SWITCH_TRUE);
+		}
+		return SWITCH_STATUS_GENERR;
+	}
+
+	if (native_write_header(rh) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Error writing %s\n", rh->file);
+		switch_file_close(rh->fd);
+		return SWITCH_STATUS_GENERR;
+	}
+
+	switch_mutex_init(&rh->mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session));
+	switch_buffer_create_dynamic(&rh->read_buffer, NATIVE_CHUNK, NATIVE_CHUNK, 0);
+	switch_buffer_create_dynamic(&rh->write_buffer, NATIVE_CHUNK, NATIVE_CHUNK, 0);
+
+	if (limit) {
+		to = switch_epoch_time_now(NULL) + limit;
+	}
+
+	if ((status = switch_core_media_bug_add(session, "session_record", rh->file, native_record_callback, rh, to,
+											SMBF_TAP_NATIVE_READ | SMBF_TAP_NATIVE_WRITE | (flags & SMBF_ANSWER_REQ), &bug)) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Error adding media bug for file %s\n", rh->file);
+		switch_file_close(rh->fd);
+		switch_buffer_destroy(&rh->read_buffer);
+		switch_buffer_destroy(&rh->write_buffer);
+		return status;
+	}
+
+	switch_channel_set_private(channel, rh->file, bug);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_ivr_record_session(switch_core_session_t *session, char *file, uint32_t limit, switch_file_handle_t *fh)
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
@@ -1663,6 +2116,10 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_record_session(switch_core_session_t
 		hangup_on_error = switch_true(p);
 	}
 
+	if (switch_true(switch_channel_get_variable(channel, "record_fsync"))) {
+		file_flags |= SWITCH_FILE_FSYNC;
+	}
+
 	switch_core_session_get_read_impl(session, &read_impl);
 
 	if ((status = switch_channel_pre_answer(channel)) != SWITCH_STATUS_SUCCESS) {
@@ -1822,6 +2279,11 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_record_session(switch_core_session_t
 		}
 	}
 
+	if (switch_true(switch_channel_get_variable(channel, "record_native")) && !(file_flags & SWITCH_FILE_WRITE_APPEND) &&
+		(status = record_session_native(session, file_path, limit, flags, hangup_on_error)) != SWITCH_STATUS_NOTIMPL) {
+		return status;
+	}
+
 	if (switch_core_file_open(fh, file, channels, read_impl.actual_samples_per_second, file_flags, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Error opening %s\n", file);
 		if (hangup_on_error) {
@@ -2359,7 +2821,7 @@ typedef struct {
 static switch_bool_t inband_dtmf_callback(switch_media_bug_t *bug, void *user_data, switch_abc_type_t type)
 {
 	switch_inband_dtmf_t *pvt = (switch_inband_dtmf_t *) user_data;
-	switch_frame_t *frame = NULL;
+	const switch_frame_t *frame = NULL;
 	switch_channel_t *channel = switch_core_session_get_channel(pvt->session);
 	teletone_hit_type_t hit;
 
@@ -2368,8 +2830,8 @@ static switch_bool_t inband_dtmf_callback(switch_media_bug_t *bug, void *user_da
 		break;
 	case SWITCH_ABC_TYPE_CLOSE:
 		break;
-	case SWITCH_ABC_TYPE_READ_REPLACE:
-		if ((frame = switch_core_media_bug_get_read_replace_frame(bug))) {
+	case SWITCH_ABC_TYPE_TAP_READ:
+		if ((frame = switch_core_media_bug_get_tap_read_frame(bug))) {
 			if ((hit = teletone_dtmf_detect(&pvt->dtmf_detect, frame->data, frame->samples)) == TT_HIT_END) {
 				switch_dtmf_t dtmf = {0};
 
@@ -2379,7 +2841,6 @@ static switch_bool_t inband_dtmf_callback(switch_media_bug_t *bug, void *user_da
 				dtmf.source = SWITCH_DTMF_INBAND_AUDIO;
 				switch_channel_queue_dtmf(channel, &dtmf);
 			}
-			switch_core_media_bug_set_read_replace_frame(bug, frame);
 		}
 		break;
 	case SWITCH_ABC_TYPE_WRITE:
@@ -2427,7 +2888,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_inband_dtmf_session(switch_core_sessi
 	}
 
 	if ((status = switch_core_media_bug_add(session, "inband_dtmf", NULL,
-											inband_dtmf_callback, pvt, 0, SMBF_READ_REPLACE | SMBF_NO_PAUSE, &bug)) != SWITCH_STATUS_SUCCESS) {
+											inband_dtmf_callback, pvt, 0, SMBF_TAP_READ | SMBF_NO_PAUSE, &bug)) != SWITCH_STATUS_SUCCESS) {
 		return status;
 	}
 
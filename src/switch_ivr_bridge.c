@@ -148,6 +148,371 @@ SWITCH_DECLARE(void) switch_ivr_bridge_display(switch_core_session_t *session, s
 
 }
 
+/*
+ * Bridge media workers: an opt-in mode where the steady state read/write loop of an
+ * answered audio bridge is run by a small fixed set of threads ticking on the soft
+ * timer instead of by each channel's own thread.  The channel thread parks on a
+ * condition for as long as nothing but media is happening and gets its leg back the
+ * moment the full bridge loop is needed again (dtmf, messages, events, flag changes,
+ * hangup), so all of the signaling logic keeps running where it always has.
+ */
+
+#define MEDIA_WORKER_MAX 128
+
+typedef struct media_worker_leg_s {
+	switch_core_session_t *session_a;
+	switch_core_session_t *session_b;
+	switch_channel_t *chan_a;
+	switch_channel_t *chan_b;
+	int stream_id;
+	int done;
+	switch_status_t status;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	struct media_worker_s *worker;
+	struct media_worker_leg_s *next;
+} media_worker_leg_t;
+
+typedef struct media_worker_s {
+	uint32_t id;
+	uint32_t interval;
+	uint32_t samples;
+	uint32_t leg_count;
+	int dead;
+	media_worker_leg_t *legs;
+	switch_mutex_t *mutex;
+	switch_thread_t *thread;
+	struct media_worker_s *next;
+} media_worker_t;
+
+static struct {
+	uint32_t workers;
+	int running;
+	switch_mutex_t *mutex;
+	switch_memory_pool_t *pool;
+	media_worker_t *list;
+	/* uuid of the reading session -> its leg, so the other direction of a bridge can join the same worker */
+	switch_hash_t *legs;
+} media_worker_globals;
+
+static switch_bool_t media_worker_leg_needs_thread(switch_core_session_t *session_a, switch_channel_t *chan_a, switch_channel_t *chan_b)
+{
+	if (!switch_channel_ready(chan_a) || switch_channel_down_nosig(chan_b) || !switch_channel_test_flag(chan_b, CF_BRIDGED)) {
+		return SWITCH_TRUE;
+	}
+
+	if (switch_channel_test_flag(chan_a, CF_TRANSFER) || switch_channel_test_flag(chan_b, CF_TRANSFER) ||
+		switch_channel_test_flag(chan_a, CF_SUSPEND) || switch_channel_test_flag(chan_b, CF_SUSPEND) ||
+		switch_channel_test_flag(chan_b, CF_BYPASS_MEDIA_AFTER_BRIDGE)) {
+		return SWITCH_TRUE;
+	}
+
+#ifndef SWITCH_VIDEO_IN_THREADS
+	if (switch_channel_test_flag(chan_a, CF_VIDEO) && switch_channel_test_flag(chan_b, CF_VIDEO)) {
+		return SWITCH_TRUE;
+	}
+#endif
+
+	if (switch_channel_has_dtmf(chan_a) || switch_core_session_private_event_count(session_a) ||
+		switch_core_session_event_count(session_a) || switch_core_session_messages_waiting(session_a)) {
+		return SWITCH_TRUE;
+	}
+
+	return SWITCH_FALSE;
+}
+
+static void media_worker_leg_finish(media_worker_leg_t *leg, switch_status_t status)
+{
+	switch_mutex_lock(leg->mutex);
+	leg->status = status;
+	leg->done = 1;
+	switch_thread_cond_signal(leg->cond);
+	switch_mutex_unlock(leg->mutex);
+}
+
+/* one tick of the bridge loop for a leg, SWITCH_STATUS_SUCCESS keeps it on the worker */
+static switch_status_t media_worker_leg_run(media_worker_leg_t *leg)
+{
+	switch_frame_t *read_frame;
+	switch_status_t status;
+
+	if (media_worker_leg_needs_thread(leg->session_a, leg->chan_a, leg->chan_b)) {
+		media_worker_leg_finish(leg, SWITCH_STATUS_SUCCESS);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	status = switch_core_session_read_frame(leg->session_a, &read_frame, SWITCH_IO_FLAG_NOBLOCK, leg->stream_id);
+
+	if (!SWITCH_READ_ACCEPTABLE(status)) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(leg->session_a), SWITCH_LOG_DEBUG, "%s ending bridge by request from read function\n",
+						  switch_channel_get_name(leg->chan_a));
+		media_worker_leg_finish(leg, SWITCH_STATUS_FALSE);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (status == SWITCH_STATUS_BREAK || !read_frame) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (switch_test_flag(read_frame, SFF_CNG) && !switch_channel_test_flag(leg->chan_b, CF_ACCEPT_CNG)) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (switch_channel_test_flag(leg->chan_a, CF_BRIDGE_NOWRITE) || switch_channel_test_flag(leg->chan_a, CF_HOLD)) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (switch_core_session_write_frame(leg->session_b, read_frame, SWITCH_IO_FLAG_NONE, leg->stream_id) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(leg->session_a), SWITCH_LOG_DEBUG,
+						  "%s ending bridge by request from write function\n", switch_channel_get_name(leg->chan_b));
+		media_worker_leg_finish(leg, SWITCH_STATUS_FALSE);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void *SWITCH_THREAD_FUNC media_worker_thread(switch_thread_t *thread, void *obj)
+{
+	media_worker_t *worker = (media_worker_t *) obj;
+	media_worker_leg_t *leg, **lp;
+	switch_timer_t timer = { 0 };
+
+	if (switch_core_timer_init(&timer, "soft", worker->interval, worker->samples, media_worker_globals.pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Media worker %u cannot start a %ums timer\n", worker->id, worker->interval);
+		goto end;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Media worker %u started (%ums)\n", worker->id, worker->interval);
+
+	while (media_worker_globals.running) {
+		if (switch_core_timer_next(&timer) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+
+		switch_mutex_lock(worker->mutex);
+		for (lp = &worker->legs; (leg = *lp);) {
+			if (media_worker_leg_run(leg) != SWITCH_STATUS_SUCCESS) {
+				*lp = leg->next;
+				leg->worker = NULL;
+				worker->leg_count--;
+				continue;
+			}
+			lp = &leg->next;
+		}
+		switch_mutex_unlock(worker->mutex);
+	}
+
+	switch_core_timer_destroy(&timer);
+
+  end:
+
+	/* hand everything still attached back to its own thread */
+	switch_mutex_lock(worker->mutex);
+	worker->dead = 1;
+	while ((leg = worker->legs)) {
+		worker->legs = leg->next;
+		leg->worker = NULL;
+		media_worker_leg_finish(leg, SWITCH_STATUS_SUCCESS);
+	}
+	worker->leg_count = 0;
+	switch_mutex_unlock(worker->mutex);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Media worker %u stopped\n", worker->id);
+
+	return NULL;
+}
+
+/* must be called with media_worker_globals.mutex held */
+static media_worker_t *media_worker_get(uint32_t interval, uint32_t samples)
+{
+	media_worker_t *worker, *best = NULL;
+	uint32_t count = 0, i;
+
+	for (worker = media_worker_globals.list; worker; worker = worker->next) {
+		if (worker->interval == interval && !worker->dead) {
+			count++;
+			if (!best || worker->leg_count < best->leg_count) {
+				best = worker;
+			}
+		}
+	}
+
+	if (count) {
+		return best;
+	}
+
+	for (i = 0; i < media_worker_globals.workers; i++) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		worker = switch_core_alloc(media_worker_globals.pool, sizeof(*worker));
+		worker->id = i;
+		worker->interval = interval;
+		worker->samples = samples;
+		switch_mutex_init(&worker->mutex, SWITCH_MUTEX_NESTED, media_worker_globals.pool);
+
+		switch_threadattr_create(&thd_attr, media_worker_globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_threadattr_priority_increase(thd_attr);
+		switch_thread_create(&worker->thread, thd_attr, media_worker_thread, worker, media_worker_globals.pool);
+
+		worker->next = media_worker_globals.list;
+		media_worker_globals.list = worker;
+
+		if (!best) {
+			best = worker;
+		}
+	}
+
+	return best;
+}
+
+static void media_worker_leg_init(media_worker_leg_t *leg, switch_core_session_t *session_a, switch_core_session_t *session_b, int stream_id)
+{
+	leg->session_a = session_a;
+	leg->session_b = session_b;
+	leg->chan_a = switch_core_session_get_channel(session_a);
+	leg->chan_b = switch_core_session_get_channel(session_b);
+	leg->stream_id = stream_id;
+	switch_mutex_init(&leg->mutex, SWITCH_MUTEX_NESTED, switch_core_session_get_pool(session_a));
+	switch_thread_cond_create(&leg->cond, switch_core_session_get_pool(session_a));
+}
+
+/* 
+ * Put a leg right behind the other direction of its bridge so one pass of one worker carries both.
+ * Must be called with media_worker_globals.mutex held, which keeps the partner's leg alive while it is in the hash.
+ */
+static media_worker_t *media_worker_join_partner(media_worker_leg_t *leg, uint32_t interval)
+{
+	media_worker_leg_t *partner;
+	media_worker_t *worker;
+	int joined = 0;
+
+	if (!(partner = switch_core_hash_find(media_worker_globals.legs, switch_core_session_get_uuid(leg->session_b))) ||
+		partner->session_b != leg->session_a || !(worker = partner->worker) || worker->interval != interval) {
+		return NULL;
+	}
+
+	switch_mutex_lock(worker->mutex);
+	/* the worker may have handed the partner back since we looked */
+	if (!worker->dead && partner->worker == worker) {
+		leg->next = partner->next;
+		partner->next = leg;
+		leg->worker = worker;
+		worker->leg_count++;
+		joined = 1;
+	}
+	switch_mutex_unlock(worker->mutex);
+
+	return joined ? worker : NULL;
+}
+
+/* 
+ * Park the calling channel thread while a media worker carries its leg of the bridge.
+ * Returns SWITCH_STATUS_SUCCESS when the leg comes back for signaling work, SWITCH_STATUS_FALSE
+ * when the media path failed and the bridge should end, SWITCH_STATUS_NOTIMPL when no worker took it.
+ */
+static switch_status_t media_worker_run_leg(media_worker_leg_t *leg)
+{
+	media_worker_t *worker = NULL;
+	switch_codec_implementation_t read_impl = { 0 };
+	uint32_t interval;
+
+	if (!media_worker_globals.workers || !media_worker_globals.mutex) {
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	switch_core_session_get_read_impl(leg->session_a, &read_impl);
+
+	if (!read_impl.microseconds_per_packet) {
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	leg->done = 0;
+	leg->status = SWITCH_STATUS_SUCCESS;
+
+	interval = read_impl.microseconds_per_packet / 1000;
+
+	switch_mutex_lock(media_worker_globals.mutex);
+	if (media_worker_globals.running && !(worker = media_worker_join_partner(leg, interval))) {
+		if ((worker = media_worker_get(interval, read_impl.samples_per_packet))) {
+			switch_mutex_lock(worker->mutex);
+			if (worker->dead) {
+				worker = NULL;
+			} else {
+				leg->next = worker->legs;
+				worker->legs = leg;
+				leg->worker = worker;
+				worker->leg_count++;
+			}
+			switch_mutex_unlock(worker->mutex);
+		}
+	}
+
+	if (worker) {
+		switch_core_hash_insert(media_worker_globals.legs, switch_core_session_get_uuid(leg->session_a), leg);
+	}
+	switch_mutex_unlock(media_worker_globals.mutex);
+
+	if (!worker) {
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	switch_mutex_lock(leg->mutex);
+	while (!leg->done) {
+		switch_thread_cond_wait(leg->cond, leg->mutex);
+	}
+	switch_mutex_unlock(leg->mutex);
+
+	switch_mutex_lock(media_worker_globals.mutex);
+	if (switch_core_hash_find(media_worker_globals.legs, switch_core_session_get_uuid(leg->session_a)) == leg) {
+		switch_core_hash_delete(media_worker_globals.legs, switch_core_session_get_uuid(leg->session_a));
+	}
+	switch_mutex_unlock(media_worker_globals.mutex);
+
+	return leg->status;
+}
+
+SWITCH_DECLARE(void) switch_ivr_set_media_workers(uint32_t workers)
+{
+	if (workers > MEDIA_WORKER_MAX) {
+		workers = MEDIA_WORKER_MAX;
+	}
+
+	if (!media_worker_globals.pool) {
+		switch_core_new_memory_pool(&media_worker_globals.pool);
+		switch_mutex_init(&media_worker_globals.mutex, SWITCH_MUTEX_NESTED, media_worker_globals.pool);
+		switch_core_hash_init(&media_worker_globals.legs, media_worker_globals.pool);
+	}
+
+	switch_mutex_lock(media_worker_globals.mutex);
+	/* the count only applies to intervals that have not started their workers yet, 0 stops new bridges from using them */
+	media_worker_globals.workers = workers;
+	media_worker_globals.running = 1;
+	switch_mutex_unlock(media_worker_globals.mutex);
+}
+
+SWITCH_DECLARE(void) switch_ivr_media_workers_shutdown(void)
+{
+	media_worker_t *worker;
+	switch_status_t st;
+
+	if (!media_worker_globals.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(media_worker_globals.mutex);
+	media_worker_globals.running = 0;
+	media_worker_globals.workers = 0;
+
+	for (worker = media_worker_globals.list; worker; worker = worker->next) {
+		switch_thread_join(&st, worker->thread);
+	}
+
+	media_worker_globals.list = NULL;
+	switch_mutex_unlock(media_worker_globals.mutex);
+}
+
 struct switch_ivr_bridge_data {
 	switch_core_session_t *session;
 	char b_uuid[SWITCH_UUID_FORMATTED_LENGTH + 1];
@@ -182,6 +547,8 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 	time_t answer_limit = 0;
 	const char *exec_app = NULL;
 	const char *exec_data = NULL;
+	int use_media_worker = 0;
+	media_worker_leg_t media_leg = { 0 };
 
 #ifdef SWITCH_VIDEO_IN_THREADS
 	switch_thread_t *vid_thread = NULL;
@@ -208,6 +575,13 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 		exec_data = switch_channel_get_variable(chan_a, "bridge_pre_execute_data");
 	}
 
+	if (media_worker_globals.workers) {
+		const char *var = switch_channel_get_variable(chan_a, "bridge_media_worker");
+		if ((use_media_worker = var ? switch_true(var) : 1)) {
+			media_worker_leg_init(&media_leg, session_a, session_b, stream_id);
+		}
+	}
+
 	bypass_media_after_bridge = switch_channel_test_flag(chan_a, CF_BYPASS_MEDIA_AFTER_BRIDGE);
 	switch_channel_clear_flag(chan_a, CF_BYPASS_MEDIA_AFTER_BRIDGE);
 
@@ -478,6 +852,20 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 		}
 #endif
 
+		if (use_media_worker && !exec_app && !silence_val && !bypass_media_after_bridge && read_frame_count > DEFAULT_LEAD_FRAMES &&
+			switch_channel_test_flag(chan_a, CF_ANSWERED) && switch_channel_test_flag(chan_b, CF_ANSWERED) && switch_channel_media_ack(chan_a) &&
+			!media_worker_leg_needs_thread(session_a, chan_a, chan_b)) {
+			status = media_worker_run_leg(&media_leg);
+
+			if (status == SWITCH_STATUS_SUCCESS) {
+				continue;
+			} else if (status == SWITCH_STATUS_FALSE) {
+				goto end_of_bridge_loop;
+			}
+
+			use_media_worker = 0;
+		}
+
 		/* read audio from 1 channel and write it to the other */
 		status = switch_core_session_read_frame(session_a, &read_frame, SWITCH_IO_FLAG_NONE, stream_id);
 
@@ -125,6 +125,8 @@ typedef struct {
 	switch_caller_profile_t *caller_profile_override;
 	switch_bool_t check_vars;
 	switch_memory_pool_t *pool;
+	switch_channel_waiter_t *waiter;
+	int caller_waiter;
 } originate_global_t;
 
 
@@ -421,6 +423,51 @@ static void inherit_codec(switch_channel_t *caller_channel, switch_core_session_
 	}
 }
 
+/* the longest the wait loops sleep without a peer state or flag change, timeouts and cancel_cause are noticed this late */
+#define ORIGINATE_WAIT_MS 20
+
+static void attach_waiters(originate_global_t *oglobals, originate_status_t *originate_status, uint32_t len, switch_channel_t *caller_channel)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++) {
+		if (originate_status[i].peer_channel) {
+			switch_channel_set_waiter(originate_status[i].peer_channel, oglobals->waiter);
+		}
+	}
+
+	if (caller_channel && !oglobals->caller_waiter && switch_channel_set_waiter(caller_channel, oglobals->waiter) == SWITCH_STATUS_SUCCESS) {
+		oglobals->caller_waiter = 1;
+	}
+}
+
+static void detach_waiters(originate_global_t *oglobals, originate_status_t *originate_status, uint32_t len, switch_channel_t *caller_channel)
+{
+	uint32_t i;
+
+	for (i = 0; i < len; i++) {
+		if (originate_status[i].peer_channel) {
+			switch_channel_clear_waiter(originate_status[i].peer_channel, oglobals->waiter);
+		}
+	}
+
+	if (caller_channel && oglobals->caller_waiter) {
+		switch_channel_clear_waiter(caller_channel, oglobals->waiter);
+		oglobals->caller_waiter = 0;
+	}
+}
+
+/* block until a peer or the caller changes state or flags, media monitoring still has to poll */
+static void wait_for_peers(originate_global_t *oglobals)
+{
+	if (oglobals->monitor_early_media_ring || oglobals->monitor_early_media_fail || oglobals->bridge_early_media > -1) {
+		switch_cond_next();
+		return;
+	}
+
+	switch_channel_waiter_wait(oglobals->waiter, ORIGINATE_WAIT_MS);
+}
+
 static uint8_t check_channel_status(originate_global_t *oglobals, originate_status_t *originate_status, uint32_t len)
 {
 
@@ -1306,6 +1353,7 @@ typedef struct {
 	int done;
 	switch_thread_t *thread;
 	switch_mutex_t *mutex;
+	switch_channel_waiter_t *waiter;
 } enterprise_originate_handle_t;
 
 
@@ -1329,6 +1377,7 @@ static void *SWITCH_THREAD_FUNC enterprise_originate_thread(switch_thread_t *thr
 
 
 	handle->done = 1;
+	switch_channel_waiter_signal(handle->waiter);
 	switch_mutex_lock(handle->mutex);
 	switch_mutex_unlock(handle->mutex);
 
@@ -1402,8 +1451,11 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_enterprise_originate(switch_core_sess
 	struct ent_originate_ringback rb_data = { 0 };
 	const char *ringback_data = NULL;
 	switch_event_t *var_event = NULL;
+	switch_channel_waiter_t *waiter = NULL;
+	int channel_waiter = 0;
 
 	switch_core_new_memory_pool(&pool);
+	switch_channel_waiter_create(&waiter, pool);
 
 	if (zstr(bridgeto)) {
 		*cause = SWITCH_CAUSE_DESTINATION_OUT_OF_ORDER;
@@ -1498,6 +1550,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_enterprise_originate(switch_core_sess
 		handles[i].caller_profile_override = cp;
 		switch_event_dup(&handles[i].ovars, var_event);
 		handles[i].flags = flags;
+		handles[i].waiter = waiter;
 		switch_mutex_init(&handles[i].mutex, SWITCH_MUTEX_NESTED, pool);
 		switch_mutex_lock(handles[i].mutex);
 		switch_thread_create(&handles[i].thread, thd_attr, enterprise_originate_thread, &handles[i], pool);
@@ -1526,6 +1579,10 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_enterprise_originate(switch_core_sess
 	}
 
 
+	if (channel && switch_channel_set_waiter(channel, waiter) == SWITCH_STATUS_SUCCESS) {
+		channel_waiter = 1;
+	}
+
 	for (;;) {
 		running = 0;
 		over = 0;
@@ -1554,18 +1611,23 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_enterprise_originate(switch_core_sess
 			} else {
 				over++;
 			}
-
-			switch_yield(10000);
 		}
 
 		if (!running || over == x_argc) {
 			break;
 		}
+
+		/* the handles signal as they finish and the channel on hangup */
+		switch_channel_waiter_wait(waiter, ORIGINATE_WAIT_MS);
 	}
 
 
   done:
 
+	if (channel_waiter) {
+		switch_channel_clear_waiter(channel, waiter);
+	}
+
 	if (hp) {
 		*cause = hp->cause;
 		status = hp->status;
@@ -1747,6 +1809,120 @@ static void wait_for_cause(switch_channel_t *channel)
 
 
 
+/* one peer to create, filled in order so the results line up with originate_status[] */
+typedef struct {
+	char *chan_type;
+	switch_caller_profile_t *caller_profile;
+	switch_event_t *var_event;
+	switch_event_t *local_var_event;
+	switch_originate_flag_t flags;
+	switch_core_session_t *new_session;
+	switch_call_cause_t reason;
+} originate_create_t;
+
+typedef struct {
+	switch_core_session_t *session;
+	originate_create_t *create;
+	int len;
+	int next;
+	switch_mutex_t *mutex;
+	switch_call_cause_t *cancel_cause;
+} originate_create_queue_t;
+
+static void create_peer(switch_core_session_t *session, originate_create_t *create, switch_call_cause_t *cancel_cause)
+{
+	create->reason = switch_core_session_outgoing_channel(session, create->var_event, create->chan_type,
+														  create->caller_profile, &create->new_session, NULL, create->flags, cancel_cause);
+	switch_event_destroy(&create->var_event);
+}
+
+static void *SWITCH_THREAD_FUNC create_peers_thread(switch_thread_t *thread, void *obj)
+{
+	originate_create_queue_t *queue = (originate_create_queue_t *) obj;
+	int i;
+
+	for (;;) {
+		switch_mutex_lock(queue->mutex);
+		i = queue->next++;
+		switch_mutex_unlock(queue->mutex);
+
+		if (i >= queue->len) {
+			break;
+		}
+
+		create_peer(queue->session, &queue->create[i], queue->cancel_cause);
+	}
+
+	return NULL;
+}
+
+/* endpoint lookups (user/ directory dips and the like) can be slow, run up to workers of them at once */
+static void create_peers(originate_global_t *oglobals, originate_create_t *create, int len, int workers, switch_call_cause_t *cancel_cause)
+{
+	originate_create_queue_t queue = { 0 };
+	switch_thread_t *threads[MAX_PEERS] = { 0 };
+	switch_threadattr_t *thd_attr = NULL;
+	switch_status_t tstatus;
+	int i, running = 0;
+
+	if (workers > len) {
+		workers = len;
+	}
+
+	if (workers < 2) {
+		for (i = 0; i < len; i++) {
+			create_peer(oglobals->session, &create[i], cancel_cause);
+		}
+		return;
+	}
+
+	queue.session = oglobals->session;
+	queue.create = create;
+	queue.len = len;
+	queue.cancel_cause = cancel_cause;
+	switch_mutex_init(&queue.mutex, SWITCH_MUTEX_NESTED, oglobals->pool);
+
+	switch_threadattr_create(&thd_attr, oglobals->pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	/* this thread is a worker too */
+	for (i = 1; i < workers; i++) {
+		if (switch_thread_create(&threads[running], thd_attr, create_peers_thread, &queue, oglobals->pool) == SWITCH_STATUS_SUCCESS) {
+			running++;
+		}
+	}
+
+	create_peers_thread(NULL, &queue);
+
+	for (i = 0; i < running; i++) {
+		switch_thread_join(&tstatus, threads[i]);
+	}
+}
+
+/* let go of peers that were created but not taken on, e.g. when a failure ends the originate early */
+static void discard_created_peers(originate_create_t *create, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++) {
+		if (create[i].var_event) {
+			switch_event_destroy(&create[i].var_event);
+		}
+
+		if (create[i].local_var_event) {
+			switch_event_destroy(&create[i].local_var_event);
+		}
+
+		if (create[i].new_session) {
+			switch_channel_hangup(switch_core_session_get_channel(create[i].new_session), SWITCH_CAUSE_ORIGINATOR_CANCEL);
+			if (!switch_core_session_running(create[i].new_session)) {
+				switch_core_session_thread_launch(create[i].new_session);
+			}
+			create[i].new_session = NULL;
+		}
+	}
+}
+
 SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *session,
 													 switch_core_session_t **bleg,
 													 switch_call_cause_t *cause,
@@ -1759,6 +1935,9 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 													 switch_event_t *ovars, switch_originate_flag_t flags, switch_call_cause_t *cancel_cause)
 {
 	originate_status_t originate_status[MAX_PEERS] = { {0} };
+	originate_create_t create[MAX_PEERS] = { {0} };
+	int create_workers = 0;
+	const char *workers_var = NULL;
 	switch_originate_flag_t dftflags = SOF_NONE, myflags = dftflags;
 	char *pipe_names[MAX_PEERS] = { 0 };
 	char *data = NULL;
@@ -1798,6 +1977,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 	int read_packet = 0;
 	int check_reject = 1;
 	switch_codec_implementation_t read_impl = { 0 };
+	switch_time_t originate_start = switch_micro_time_now();
 	
 	if (strstr(bridgeto, SWITCH_ENT_ORIGINATE_DELIM)) {
 		return switch_ivr_enterprise_originate(session, bleg, cause, bridgeto, timelimit_sec, table, cid_name_override, cid_num_override,
@@ -1810,6 +1990,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 	oglobals.file = NULL;
 	oglobals.error_file = NULL;
 	switch_core_new_memory_pool(&oglobals.pool);
+	switch_channel_waiter_create(&oglobals.waiter, oglobals.pool);
 
 	if (caller_profile_override) {
 		oglobals.caller_profile_override = switch_caller_profile_dup(oglobals.pool, caller_profile_override);
@@ -2354,9 +2535,20 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 				and_argc = 1;
 			}
 
+			memset(create, 0, sizeof(create));
+
+			if ((workers_var = switch_event_get_header(var_event, "originate_create_workers")) ||
+				(caller_channel && (workers_var = switch_channel_get_variable(caller_channel, "originate_create_workers"))) ||
+				(workers_var = switch_core_get_variable("originate_create_workers"))) {
+				create_workers = atoi(workers_var);
+			} else {
+				create_workers = 0;
+			}
+
+			/* work out what to create in order first so only the endpoint calls run in parallel */
 			for (i = 0; i < and_argc; i++) {
 				const char *current_variable;
-				switch_event_t *local_var_event = NULL, *originate_var_event = NULL, *event = NULL;
+				switch_event_t *local_var_event = NULL, *originate_var_event = NULL;
 
 				end = NULL;
 				
@@ -2526,10 +2718,23 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 				}
 				
 				
-				reason = switch_core_session_outgoing_channel(oglobals.session, originate_var_event, chan_type,
-															  new_profile, &new_session, NULL, myflags, cancel_cause);
+				create[i].chan_type = chan_type;
+				create[i].caller_profile = new_profile;
+				create[i].var_event = originate_var_event;
+				create[i].local_var_event = local_var_event;
+				create[i].flags = myflags;
+			}
+
+			create_peers(&oglobals, create, and_argc, create_workers, cancel_cause);
+
+			for (i = 0; i < and_argc; i++) {
+				switch_event_t *local_var_event = create[i].local_var_event, *event = NULL;
 
-				switch_event_destroy(&originate_var_event);
+				chan_type = create[i].chan_type;
+				new_session = create[i].new_session;
+				reason = create[i].reason;
+				create[i].local_var_event = NULL;
+				create[i].new_session = NULL;
 
 				if (reason != SWITCH_CAUSE_SUCCESS) {
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_NOTICE, "Cannot create outgoing channel of type [%s] cause: [%s]\n",
@@ -2699,6 +2904,8 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 				}
 			}
 
+			attach_waiters(&oglobals, originate_status, and_argc, caller_channel);
+
 			switch_epoch_time_now(&start);
 
 			for (;;) {
@@ -2744,10 +2951,10 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 						}
 						goto notready;
 					}
-
-					switch_cond_next();
 				}
 
+				wait_for_peers(&oglobals);
+
 				check_per_channel_timeouts(&oglobals, originate_status, and_argc, start, &force_reason);
 
 
@@ -3026,12 +3233,14 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 			do_continue:
 
 				if (!read_packet) {
-					switch_cond_next();
+					wait_for_peers(&oglobals);
 				}
 			}
 
 		  notready:
 
+			detach_waiters(&oglobals, originate_status, and_argc, caller_channel);
+
 			if (caller_channel) {
 				holding = switch_channel_get_variable(caller_channel, SWITCH_HOLDING_UUID_VARIABLE);
 				switch_channel_set_variable(caller_channel, SWITCH_HOLDING_UUID_VARIABLE, NULL);
@@ -3318,6 +3527,9 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 
 		  done:
 
+			detach_waiters(&oglobals, originate_status, and_argc, caller_channel);
+			discard_created_peers(create, and_argc);
+
 			*cause = SWITCH_CAUSE_NONE;
 
 			if (caller_channel && !switch_channel_ready(caller_channel)) {
@@ -3571,6 +3783,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 		}
 	}
   outer_for:
+	discard_created_peers(create, MAX_PEERS);
 	switch_safe_free(loop_data);
 	switch_safe_free(odata);
 	switch_safe_free(oglobals.file);
@@ -3582,6 +3795,23 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_originate(switch_core_session_t *sess
 
 	if (*bleg) {
 		switch_channel_t *bchan = switch_core_session_get_channel(*bleg);
+		switch_caller_profile_t *bprofile = switch_channel_get_caller_profile(bchan);
+
+		if (bprofile && bprofile->times) {
+			switch_time_t ring = bprofile->times->progress;
+
+			if (!ring || (bprofile->times->progress_media && bprofile->times->progress_media < ring)) {
+				ring = bprofile->times->progress_media;
+			}
+
+			if (ring) {
+				switch_core_session_record_phase(session ? session : *bleg, SWITCH_PHASE_ORIGINATE_RING, originate_start, ring);
+			}
+
+			if (bprofile->times->answered) {
+				switch_core_session_record_phase(session ? session : *bleg, SWITCH_PHASE_ORIGINATE_ANSWER, originate_start, bprofile->times->answered);
+			}
+		}
 
 		if (session && caller_channel) {
 			switch_caller_profile_t *cloned_profile, *peer_profile = switch_channel_get_caller_profile(switch_core_session_get_channel(*bleg));
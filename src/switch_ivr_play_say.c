@@ -1051,7 +1051,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 	int more_data = 0;
 	char *playback_vars, *tmp;
 	switch_event_t *event;
-	uint32_t test_native = 0, last_native = 0;
+	uint32_t test_native = 0, last_native = 0, native_write = 0;
 
 	if (switch_channel_pre_answer(channel) != SWITCH_STATUS_SUCCESS) {
 		return SWITCH_STATUS_FALSE;
@@ -1325,9 +1325,19 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 			}
 		}
 
+		/* prompts from the cache, and streams that share their encoded frames, can go out already encoded for the codec we write with */
+		native_write = 0;
+		if ((fh->cache_node || fh->file_interface->file_native) && !fh->vol && !fh->speed) {
+			native_write = switch_core_file_cache_native(fh, switch_core_session_get_write_codec(session)) == SWITCH_STATUS_SUCCESS;
+		}
+
 		test_native = switch_test_flag(fh, SWITCH_FILE_NATIVE);
 
-		if (test_native) {
+		if (test_native && native_write) {
+			write_frame.codec = switch_core_session_get_write_codec(session);
+			samples = write_frame.codec->implementation->samples_per_packet;
+			framelen = write_frame.codec->implementation->encoded_bytes_per_packet;
+		} else if (test_native) {
 			write_frame.codec = switch_core_session_get_read_codec(session);
 			samples = read_impl.samples_per_packet;
 			framelen = read_impl.encoded_bytes_per_packet;
@@ -2100,8 +2110,12 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session
 	switch_speech_flag_t flags = SWITCH_SPEECH_FLAG_NONE;
 	switch_size_t extra = 0;
 	char *p, *tmp = NULL;
-	const char *star, *pound;
+	const char *star, *pound, *var;
 	switch_size_t starlen, poundlen;
+	switch_file_handle_t cache_fh = { 0 }, tee_fh = { 0 };
+	char cache_path[1024] = "", *tee_path = NULL;
+	int cached = 0, teeing = 0, complete = 0;
+	switch_size_t teed = 0;
 
 	if (!sh) {
 		return SWITCH_STATUS_FALSE;
@@ -2160,8 +2174,32 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session
 		text = tmp;
 	}
 
-	switch_core_speech_feed_tts(sh, text, &flags);
-	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Speaking text: %s\n", text);
+	/* text rendered before is played from its file, anything else is written aside while it is spoken */
+	if ((!(var = switch_channel_get_variable(channel, "tts_cache")) || switch_true(var)) &&
+		switch_core_speech_cache_path(sh, text, cache_path, sizeof(cache_path)) == SWITCH_STATUS_SUCCESS) {
+		if (switch_file_exists(cache_path, switch_core_session_get_pool(session)) == SWITCH_STATUS_SUCCESS &&
+			switch_core_file_open(&cache_fh, cache_path, 1, sh->samplerate, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL) == SWITCH_STATUS_SUCCESS) {
+			cached = 1;
+		} else {
+			char uuid_str[SWITCH_UUID_FORMATTED_LENGTH + 1];
+			switch_uuid_t uuid;
+
+			switch_uuid_get(&uuid);
+			switch_uuid_format(uuid_str, &uuid);
+			tee_path = switch_mprintf("%s.%s.wav", cache_path, uuid_str);
+
+			if (switch_core_file_open(&tee_fh, tee_path, 1, sh->samplerate, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT, NULL) == SWITCH_STATUS_SUCCESS) {
+				teeing = 1;
+			}
+		}
+	}
+
+	if (cached) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Speaking text from %s: %s\n", cache_path, text);
+	} else {
+		switch_core_speech_feed_tts(sh, text, &flags);
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Speaking text: %s\n", text);
+	}
 	switch_safe_free(tmp);
 	text = NULL;
 
@@ -2284,8 +2322,33 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session
 			continue;
 		}
 
-		flags = SWITCH_SPEECH_FLAG_BLOCKING;
-		status = switch_core_speech_read_tts(sh, abuf, &ilen, &flags);
+		if (cached) {
+			switch_size_t want = len / 2;
+
+			ilen = want;
+			if (switch_core_file_read(&cache_fh, abuf, &ilen) != SWITCH_STATUS_SUCCESS || !ilen) {
+				status = SWITCH_STATUS_BREAK;
+			} else {
+				if (ilen < want) {
+					memset(abuf + ilen, 0, (want - ilen) * 2);
+				}
+				ilen = want * 2;
+			}
+		} else {
+			flags = SWITCH_SPEECH_FLAG_BLOCKING;
+			status = switch_core_speech_read_tts(sh, abuf, &ilen, &flags);
+
+			if (status == SWITCH_STATUS_SUCCESS && teeing) {
+				switch_size_t samples = ilen / 2;
+
+				teed += samples;
+				if (switch_core_file_write(&tee_fh, abuf, &samples) != SWITCH_STATUS_SUCCESS) {
+					switch_core_file_close(&tee_fh);
+					switch_file_remove(tee_path, switch_core_session_get_pool(session));
+					teeing = 0;
+				}
+			}
+		}
 
 		if (status != SWITCH_STATUS_SUCCESS) {
 			write_frame.datalen = (uint32_t) codec->implementation->decoded_bytes_per_packet;
@@ -2303,6 +2366,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session
 			}
 			if (status == SWITCH_STATUS_BREAK) {
 				status = SWITCH_STATUS_SUCCESS;
+				complete = 1;
 			}
 			done = 1;
 		}
@@ -2360,7 +2424,22 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text_handle(switch_core_session
 
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "done speaking text\n");
 	flags = 0;
-	switch_core_speech_flush_tts(sh);
+
+	if (cached) {
+		switch_core_file_close(&cache_fh);
+	} else {
+		switch_core_speech_flush_tts(sh);
+	}
+
+	if (teeing) {
+		switch_core_file_close(&tee_fh);
+		/* only whole renders are kept, one cut short by a barge in would play cut short forever */
+		if (!complete || !teed || switch_file_rename(tee_path, cache_path, switch_core_session_get_pool(session)) != SWITCH_STATUS_SUCCESS) {
+			switch_file_remove(tee_path, switch_core_session_get_pool(session));
+		}
+	}
+	switch_safe_free(tee_path);
+
 	return status;
 }
 
@@ -2374,6 +2453,18 @@ struct cached_speech_handle {
 
 typedef struct cached_speech_handle cached_speech_handle_t;
 
+/* pooled handles go back to the pool, a cached one is closed and the cache cleared by the caller */
+static void speak_text_close(switch_speech_handle_t **sh, cached_speech_handle_t *cache_obj)
+{
+	switch_speech_flag_t flags = SWITCH_SPEECH_FLAG_NONE;
+
+	if (cache_obj) {
+		switch_core_speech_close(*sh, &flags);
+	} else {
+		switch_core_speech_release(sh);
+	}
+}
+
 SWITCH_DECLARE(void) switch_ivr_clear_speech_cache(switch_core_session_t *session)
 {
 	cached_speech_handle_t *cache_obj = NULL;
@@ -2406,7 +2497,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 	switch_memory_pool_t *pool = switch_core_session_get_pool(session);
 	char *codec_name;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
-	switch_speech_handle_t lsh, *sh;
+	switch_speech_handle_t *sh = NULL;
 	switch_speech_flag_t flags = SWITCH_SPEECH_FLAG_NONE;
 	const char *timer_name, *var;
 	cached_speech_handle_t *cache_obj = NULL;
@@ -2418,7 +2509,6 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 		return SWITCH_STATUS_FALSE;
 	}
 
-	sh = &lsh;
 	codec = &lcodec;
 	timer = &ltimer;
 
@@ -2453,8 +2543,13 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 	interval = read_impl.microseconds_per_packet / 1000;
 
 	if (need_create) {
-		memset(sh, 0, sizeof(*sh));
-		if ((status = switch_core_speech_open(sh, tts_name, voice_name, (uint32_t) rate, interval, &flags, NULL)) != SWITCH_STATUS_SUCCESS) {
+		if (cache_obj) {
+			memset(sh, 0, sizeof(*sh));
+			status = switch_core_speech_open(sh, tts_name, voice_name, (uint32_t) rate, interval, &flags, NULL);
+		} else {
+			status = switch_core_speech_open_pooled(&sh, tts_name, voice_name, (uint32_t) rate, interval, &flags);
+		}
+		if (status != SWITCH_STATUS_SUCCESS) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Invalid TTS module!\n");
 			switch_core_session_reset(session, SWITCH_TRUE, SWITCH_TRUE);
 			switch_ivr_clear_speech_cache(session);
@@ -2466,8 +2561,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 	}
 
 	if (switch_channel_pre_answer(channel) != SWITCH_STATUS_SUCCESS) {
-		flags = 0;
-		switch_core_speech_close(sh, &flags);
+		speak_text_close(&sh, cache_obj);
 		return SWITCH_STATUS_FALSE;
 	}
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "OPEN TTS %s\n", tts_name);
@@ -2483,8 +2577,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 		} else {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Raw Codec Activation Failed %s@%uhz 1 channel %dms\n", codec_name,
 							  rate, interval);
-			flags = 0;
-			switch_core_speech_close(sh, &flags);
+			speak_text_close(&sh, cache_obj);
 			switch_core_session_reset(session, SWITCH_TRUE, SWITCH_TRUE);
 			switch_ivr_clear_speech_cache(session);
 			return SWITCH_STATUS_GENERR;
@@ -2498,8 +2591,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 			if (switch_core_timer_init(timer, timer_name, interval, (int) sh->samples, pool) != SWITCH_STATUS_SUCCESS) {
 				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Setup timer failed!\n");
 				switch_core_codec_destroy(write_frame.codec);
-				flags = 0;
-				switch_core_speech_close(sh, &flags);
+				speak_text_close(&sh, cache_obj);
 				switch_core_session_reset(session, SWITCH_TRUE, SWITCH_TRUE);
 				switch_ivr_clear_speech_cache(session);
 				return SWITCH_STATUS_GENERR;
@@ -2518,7 +2610,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_speak_text(switch_core_session_t *ses
 	flags = 0;
 
 	if (!cache_obj) {
-		switch_core_speech_close(sh, &flags);
+		switch_core_speech_release(&sh);
 		switch_core_codec_destroy(codec);
 	}
 
@@ -54,6 +54,7 @@ struct switch_loadable_module {
 	switch_status_t status;
 	switch_thread_t *thread;
 	switch_bool_t shutting_down;
+	switch_time_t load_time;
 };
 
 struct switch_loadable_module_container {
@@ -75,6 +76,7 @@ struct switch_loadable_module_container {
 	switch_hash_t *limit_hash;
 	switch_mutex_t *mutex;
 	switch_memory_pool_t *pool;
+	uint32_t codec_generation;
 };
 
 static struct switch_loadable_module_container loadable_modules;
@@ -190,6 +192,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 										  ptr->interface_name, impl->actual_samples_per_second, impl->microseconds_per_packet / 1000, impl->bits_per_second);
 						if (!switch_core_hash_find(loadable_modules.codec_hash, impl->iananame)) {
 							switch_core_hash_insert(loadable_modules.codec_hash, impl->iananame, (const void *) ptr);
+							loadable_modules.codec_generation++;
 						}
 					}
 					if (switch_event_create(&event, SWITCH_EVENT_MODULE_LOAD) == SWITCH_STATUS_SUCCESS) {
@@ -859,6 +862,7 @@ static switch_status_t switch_loadable_module_unprocess(switch_loadable_module_t
 						switch_core_session_hupall_matching_var("write_codec", impl->iananame, SWITCH_CAUSE_MANAGER_REQUEST);
 						if (switch_core_hash_find(loadable_modules.codec_hash, impl->iananame)) {
 							switch_core_hash_delete(loadable_modules.codec_hash, impl->iananame);
+							loadable_modules.codec_generation++;
 						}
 					}
 					if (switch_event_create(&event, SWITCH_EVENT_MODULE_UNLOAD) == SWITCH_STATUS_SUCCESS) {
@@ -1020,6 +1024,9 @@ static switch_status_t switch_loadable_module_unprocess(switch_loadable_module_t
 
 			if (ptr->interface_name) {
 
+				/* idle pooled handles hold references of their own */
+				switch_core_speech_pool_flush(ptr->interface_name);
+
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Write lock interface '%s' to wait for existing references.\n",
 								  ptr->interface_name);
 
@@ -1334,6 +1341,7 @@ static switch_status_t switch_loadable_module_load_module_ex(char *dir, char *fn
 	char *file, *dot;
 	switch_loadable_module_t *new_module = NULL;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	switch_time_t started = switch_time_now();
 
 #ifdef WIN32
 	const char *ext = ".dll";
@@ -1371,6 +1379,8 @@ static switch_status_t switch_loadable_module_load_module_ex(char *dir, char *fn
 		*err = "Module already loaded";
 		status = SWITCH_STATUS_FALSE;
 	} else if ((status = switch_loadable_module_load_file(path, file, global, &new_module)) == SWITCH_STATUS_SUCCESS) {
+		new_module->load_time = switch_time_now() - started;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Module %s loaded in %" SWITCH_TIME_T_FMT "ms\n", file, new_module->load_time / 1000);
 		if ((status = switch_loadable_module_process(file, new_module)) == SWITCH_STATUS_SUCCESS && runtime) {
 			if (new_module->switch_module_runtime) {
 				new_module->thread = switch_core_launch_thread(switch_loadable_module_exec, new_module, new_module->pool);
@@ -1598,6 +1608,262 @@ static void switch_loadable_module_path_init()
 }
 #endif
 
+/* one <load> line of modules.conf, loaded on the main thread or by a loader thread */
+typedef struct module_load_job {
+	char *path;
+	char *fname;
+	char *name;
+	switch_bool_t global;
+	switch_bool_t critical;
+	switch_bool_t parallel;
+	struct module_load_job **depends;
+	int depend_count;
+	int done;
+	struct module_load_job *next;
+} module_load_job_t;
+
+typedef struct {
+	switch_queue_t *queue;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	int pending;
+} module_loader_t;
+
+static void module_load_job_run(module_load_job_t *job)
+{
+	const char *err;
+
+	if (switch_loadable_module_load_module_ex(job->path, job->fname, SWITCH_FALSE, job->global, &err) == SWITCH_STATUS_GENERR && job->critical) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failed to load critical module '%s', abort()\n", job->fname);
+		abort();
+	}
+}
+
+static void module_loader_wait(module_loader_t *loader, module_load_job_t *job)
+{
+	int i;
+
+	switch_mutex_lock(loader->mutex);
+	if (job) {
+		for (i = 0; i < job->depend_count; i++) {
+			while (!job->depends[i]->done) {
+				switch_thread_cond_wait(loader->cond, loader->mutex);
+			}
+		}
+	} else {
+		while (loader->pending) {
+			switch_thread_cond_wait(loader->cond, loader->mutex);
+		}
+	}
+	switch_mutex_unlock(loader->mutex);
+}
+
+static void *SWITCH_THREAD_FUNC module_loader_thread(switch_thread_t *thread, void *obj)
+{
+	module_loader_t *loader = (module_loader_t *) obj;
+	void *pop;
+
+	while (switch_queue_pop(loader->queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		module_load_job_t *job = (module_load_job_t *) pop;
+
+		/* jobs are queued in file order and only depend on earlier ones, so whatever this waits for is already running */
+		module_loader_wait(loader, job);
+		module_load_job_run(job);
+
+		switch_mutex_lock(loader->mutex);
+		job->done = 1;
+		loader->pending--;
+		switch_thread_cond_broadcast(loader->cond);
+		switch_mutex_unlock(loader->mutex);
+	}
+
+	return NULL;
+}
+
+static module_load_job_t *module_load_job_find(module_load_job_t *head, const char *name)
+{
+	module_load_job_t *job;
+
+	for (job = head; job; job = job->next) {
+		if (!strcasecmp(job->name, name)) {
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+  Load the <load> lines of a modules config.  With load-threads above 1 the lines marked parallel="true" are
+  handed to loader threads and run next to each other once the modules named in their depends attribute are loaded.
+  Every other line waits for all the loads before it and holds back the ones after it, exactly like a serial load.
+*/
+static void switch_loadable_module_load_config(const char *cf, switch_bool_t allow_critical, unsigned int *count)
+{
+	switch_xml_t cfg, xml, mods, settings, param, ld;
+	switch_memory_pool_t *pool = NULL;
+	module_load_job_t *head = NULL, *tail = NULL, *job;
+	module_loader_t loader = { 0 };
+	switch_thread_t **threads = NULL;
+	int load_threads = 0, thread_count = 0, i;
+	switch_status_t st;
+
+#ifdef WIN32
+	const char *ext = ".dll";
+	const char *EXT = ".DLL";
+#elif defined (MACOSX) || defined (DARWIN)
+	const char *ext = ".dylib";
+	const char *EXT = ".DYLIB";
+#else
+	const char *ext = ".so";
+	const char *EXT = ".SO";
+#endif
+
+	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "open of %s failed\n", cf);
+		return;
+	}
+
+	if (!(mods = switch_xml_child(cfg, "modules"))) {
+		switch_xml_free(xml);
+		return;
+	}
+
+	if ((settings = switch_xml_child(cfg, "settings"))) {
+		for (param = switch_xml_child(settings, "param"); param; param = param->next) {
+			const char *var = switch_xml_attr_soft(param, "name");
+			const char *val = switch_xml_attr_soft(param, "value");
+
+			if (!strcasecmp(var, "load-threads")) {
+				load_threads = atoi(val);
+				if (load_threads < 0 || load_threads > 64) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Invalid load-threads %s, loading serially\n", val);
+					load_threads = 0;
+				}
+			}
+		}
+	}
+
+	switch_core_new_memory_pool(&pool);
+
+	for (ld = switch_xml_child(mods, "load"); ld; ld = ld->next) {
+		const char *val = switch_xml_attr_soft(ld, "module");
+		const char *path = switch_xml_attr_soft(ld, "path");
+		const char *depends = switch_xml_attr_soft(ld, "depends");
+		char *p;
+
+		if (zstr(val) || (strchr(val, '.') && !strstr(val, ext) && !strstr(val, EXT))) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Invalid extension for %s\n", val);
+			continue;
+		}
+
+		if (path && zstr(path)) {
+			path = SWITCH_GLOBAL_dirs.mod_dir;
+		}
+
+		job = switch_core_alloc(pool, sizeof(*job));
+		job->path = switch_core_strdup(pool, path);
+		job->fname = switch_core_strdup(pool, val);
+		job->name = switch_core_strdup(pool, switch_cut_path(val));
+		if ((p = strchr(job->name, '.'))) {
+			*p = '\0';
+		}
+		job->global = switch_true(switch_xml_attr_soft(ld, "global"));
+		job->critical = allow_critical && switch_true(switch_xml_attr_soft(ld, "critical"));
+		job->parallel = load_threads > 1 && switch_true(switch_xml_attr_soft(ld, "parallel"));
+
+		if (job->parallel && !zstr(depends)) {
+			char *dup = switch_core_strdup(pool, depends);
+			char *argv[64] = { 0 };
+			int argc = switch_separate_string(dup, ',', argv, (sizeof(argv) / sizeof(argv[0])));
+
+			job->depends = switch_core_alloc(pool, argc * sizeof(*job->depends));
+			for (i = 0; i < argc; i++) {
+				module_load_job_t *dep;
+				char *dname = argv[i];
+
+				while (*dname == ' ') {
+					dname++;
+				}
+				if (zstr(dname)) {
+					continue;
+				}
+				if ((dep = module_load_job_find(head, dname))) {
+					job->depends[job->depend_count++] = dep;
+				} else if (!switch_core_hash_find_locked(loadable_modules.module_hash, dname, loadable_modules.mutex)) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s depends on %s which is not loaded before it\n", job->name, dname);
+				}
+			}
+		}
+
+		if (tail) {
+			tail->next = job;
+		} else {
+			head = job;
+		}
+		tail = job;
+		(*count)++;
+	}
+
+	switch_xml_free(xml);
+
+	for (job = head; job; job = job->next) {
+		if (job->parallel) {
+			thread_count++;
+		}
+	}
+
+	if (thread_count) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		if (thread_count > load_threads) {
+			thread_count = load_threads;
+		}
+
+		switch_mutex_init(&loader.mutex, SWITCH_MUTEX_NESTED, pool);
+		switch_thread_cond_create(&loader.cond, pool);
+		switch_queue_create(&loader.queue, SWITCH_CORE_QUEUE_LEN, pool);
+		threads = switch_core_alloc(pool, thread_count * sizeof(*threads));
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+		for (i = 0; i < thread_count; i++) {
+			if (switch_thread_create(&threads[i], thd_attr, module_loader_thread, &loader, pool) != SWITCH_STATUS_SUCCESS) {
+				break;
+			}
+		}
+		thread_count = i;
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Loading %s with %d loader threads\n", cf, thread_count);
+	}
+
+	for (job = head; job; job = job->next) {
+		if (job->parallel && thread_count) {
+			switch_mutex_lock(loader.mutex);
+			loader.pending++;
+			switch_mutex_unlock(loader.mutex);
+			switch_queue_push(loader.queue, job);
+		} else {
+			if (thread_count) {
+				module_loader_wait(&loader, NULL);
+			}
+			module_load_job_run(job);
+			job->done = 1;
+		}
+	}
+
+	if (thread_count) {
+		for (i = 0; i < thread_count; i++) {
+			switch_queue_push(loader.queue, NULL);
+		}
+		for (i = 0; i < thread_count; i++) {
+			switch_thread_join(&st, threads[i]);
+		}
+	}
+
+	switch_core_destroy_memory_pool(&pool);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autoload)
 {
 
@@ -1606,10 +1872,10 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 	apr_int32_t finfo_flags = APR_FINFO_DIRENT | APR_FINFO_TYPE | APR_FINFO_NAME;
 	char *cf = "modules.conf";
 	char *pcf = "post_load_modules.conf";
-	switch_xml_t cfg, xml;
 	unsigned char all = 0;
 	unsigned int count = 0;
 	const char *err;
+	switch_time_t started;
 
 
 #ifdef WIN32
@@ -1654,66 +1920,11 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 
 	if (!autoload) return SWITCH_STATUS_SUCCESS;
 
-	if ((xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
-		switch_xml_t mods, ld;
-		if ((mods = switch_xml_child(cfg, "modules"))) {
-			for (ld = switch_xml_child(mods, "load"); ld; ld = ld->next) {
-				switch_bool_t global = SWITCH_FALSE;
-				const char *val = switch_xml_attr_soft(ld, "module");
-				const char *path = switch_xml_attr_soft(ld, "path");
-				const char *critical = switch_xml_attr_soft(ld, "critical");
-				const char *sglobal = switch_xml_attr_soft(ld, "global");
-				if (zstr(val) || (strchr(val, '.') && !strstr(val, ext) && !strstr(val, EXT))) {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Invalid extension for %s\n", val);
-					continue;
-				}
-				global = switch_true(sglobal);
-				
-				if (path && zstr(path)) {
-					path = SWITCH_GLOBAL_dirs.mod_dir;
-				}
-				if (switch_loadable_module_load_module_ex((char *) path, (char *) val, SWITCH_FALSE, global, &err) == SWITCH_STATUS_GENERR) {
-					if (critical && switch_true(critical)) {
-						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failed to load critical module '%s', abort()\n", val);
-						abort();
-					}
-				}
-				count++;
-			}
-		}
-		switch_xml_free(xml);
-
-	} else {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "open of %s failed\n", cf);
-	}
-
-	if ((xml = switch_xml_open_cfg(pcf, &cfg, NULL))) {
-		switch_xml_t mods, ld;
-
-		if ((mods = switch_xml_child(cfg, "modules"))) {
-			for (ld = switch_xml_child(mods, "load"); ld; ld = ld->next) {
-				switch_bool_t global = SWITCH_FALSE;
-				const char *val = switch_xml_attr_soft(ld, "module");
-				const char *path = switch_xml_attr_soft(ld, "path");
-				const char *sglobal = switch_xml_attr_soft(ld, "global");
-				if (zstr(val) || (strchr(val, '.') && !strstr(val, ext) && !strstr(val, EXT))) {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Invalid extension for %s\n", val);
-					continue;
-				}
-				global = switch_true(sglobal);
-
-				if (path && zstr(path)) {
-					path = SWITCH_GLOBAL_dirs.mod_dir;
-				}
-				switch_loadable_module_load_module_ex((char *) path, (char *) val, SWITCH_FALSE, global, &err);
-				count++;
-			}
-		}
-		switch_xml_free(xml);
-
-	} else {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "open of %s failed\n", pcf);
-	}
+	started = switch_time_now();
+	switch_loadable_module_load_config(cf, SWITCH_TRUE, &count);
+	switch_loadable_module_load_config(pcf, SWITCH_FALSE, &count);
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Loaded %u modules in %" SWITCH_TIME_T_FMT "ms\n", count,
+					  (switch_time_now() - started) / 1000);
 
 	if (!count) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "No modules loaded, assuming 'load all'\n");
@@ -2035,6 +2246,11 @@ static void switch_loadable_module_sort_codecs(const switch_codec_implementation
 }
 
 
+SWITCH_DECLARE(uint32_t) switch_loadable_module_codec_generation(void)
+{
+	return loadable_modules.codec_generation;
+}
+
 SWITCH_DECLARE(int) switch_loadable_module_get_codecs(const switch_codec_implementation_t **array, int arraylen)
 {
 	switch_hash_index_t *hi;
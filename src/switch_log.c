@@ -58,6 +58,7 @@ static switch_memory_pool_t *LOG_POOL = NULL;
 static switch_log_binding_t *BINDINGS = NULL;
 static switch_mutex_t *BINDLOCK = NULL;
 static switch_queue_t *LOG_QUEUE = NULL;
+static switch_slab_t *LOG_NODE_SLAB = NULL;
 #ifdef SWITCH_LOG_RECYCLE
 static switch_queue_t *LOG_RECYCLE_QUEUE = NULL;
 #endif
@@ -95,7 +96,7 @@ static switch_log_node_t *switch_log_node_alloc()
 		node = (switch_log_node_t *) pop;
 	} else {
 #endif
-		node = malloc(sizeof(*node));
+		node = LOG_NODE_SLAB ? switch_slab_alloc(LOG_NODE_SLAB) : malloc(sizeof(*node));
 		switch_assert(node);
 #ifdef SWITCH_LOG_RECYCLE
 	}
@@ -137,10 +138,10 @@ SWITCH_DECLARE(void) switch_log_node_free(switch_log_node_t **pnode)
 		switch_safe_free(node->data);
 #ifdef SWITCH_LOG_RECYCLE
 		if (switch_queue_trypush(LOG_RECYCLE_QUEUE, node) != SWITCH_STATUS_SUCCESS) {
-			free(node);
+			switch_slab_free(LOG_NODE_SLAB, node);
 		}
 #else
-		free(node);
+		switch_slab_free(LOG_NODE_SLAB, node);
 #endif
 	}
 	*pnode = NULL;
@@ -237,6 +238,16 @@ SWITCH_DECLARE(switch_status_t) switch_log_unbind_logger(switch_log_function_t f
 		}
 		last = ptr;
 	}
+
+	if (status == SWITCH_STATUS_SUCCESS) {
+		/* let switch_log_vprintf() go back to skipping levels nobody wants anymore */
+		MAX_LEVEL = 0;
+		for (ptr = BINDINGS; ptr; ptr = ptr->next) {
+			if ((uint8_t) ptr->level > MAX_LEVEL) {
+				MAX_LEVEL = (uint8_t) ptr->level;
+			}
+		}
+	}
 	switch_mutex_unlock(BINDLOCK);
 
 	return status;
@@ -278,6 +289,8 @@ SWITCH_DECLARE(switch_status_t) switch_log_bind_logger(switch_log_function_t fun
 
 static switch_thread_t *thread;
 
+#define LOG_BATCH_MAX 64
+
 static void *SWITCH_THREAD_FUNC log_thread(switch_thread_t *t, void *obj)
 {
 
@@ -288,8 +301,9 @@ static void *SWITCH_THREAD_FUNC log_thread(switch_thread_t *t, void *obj)
 
 	while (THREAD_RUNNING == 1) {
 		void *pop = NULL;
-		switch_log_node_t *node = NULL;
+		switch_log_node_t *nodes[LOG_BATCH_MAX];
 		switch_log_binding_t *binding;
+		int count = 0, x, stop = 0;
 
 		if (switch_queue_pop(LOG_QUEUE, &pop) != SWITCH_STATUS_SUCCESS) {
 			break;
@@ -299,17 +313,34 @@ static void *SWITCH_THREAD_FUNC log_thread(switch_thread_t *t, void *obj)
 			break;
 		}
 
-		node = (switch_log_node_t *) pop;
+		nodes[count++] = (switch_log_node_t *) pop;
+
+		/* take whatever else is already waiting so the bindings are locked once per batch, not once per line */
+		while (count < LOG_BATCH_MAX && switch_queue_trypop(LOG_QUEUE, &pop) == SWITCH_STATUS_SUCCESS) {
+			if (!pop) {
+				stop = 1;
+				break;
+			}
+			nodes[count++] = (switch_log_node_t *) pop;
+		}
+
 		switch_mutex_lock(BINDLOCK);
-		for (binding = BINDINGS; binding; binding = binding->next) {
-			if (binding->level >= node->level) {
-				binding->function(node, node->level);
+		for (x = 0; x < count; x++) {
+			for (binding = BINDINGS; binding; binding = binding->next) {
+				if (binding->level >= nodes[x]->level) {
+					binding->function(nodes[x], nodes[x]->level);
+				}
 			}
 		}
 		switch_mutex_unlock(BINDLOCK);
 
-		switch_log_node_free(&node);
+		for (x = 0; x < count; x++) {
+			switch_log_node_free(&nodes[x]);
+		}
 
+		if (stop) {
+			break;
+		}
 	}
 
 	THREAD_RUNNING = 0;
@@ -327,24 +358,66 @@ SWITCH_DECLARE(void) switch_log_printf(switch_text_channel_t channel, const char
 	va_end(ap);
 }
 
+/* format prefix and message into one allocation, short messages are only formatted once into the stack buffer */
+static int log_format(char **ret, const char *prefix, switch_size_t plen, const char *fmt, va_list ap)
+{
+	char buf[1024];
+	char *data, *body = NULL;
+	va_list ap2;
+	int len;
+
+#ifdef _MSC_VER
+	ap2 = ap;
+#else
+	va_copy(ap2, ap);
+#endif
+	len = vsnprintf(buf, sizeof(buf), fmt, ap2);
+	va_end(ap2);
+
+	if (len < 0) {
+		/* some vsnprintf()s only ever say it did not fit */
+		if ((len = switch_vasprintf(&body, fmt, ap)) < 0) {
+			return -1;
+		}
+	}
+
+	if (!(data = malloc(plen + len + 1))) {
+		switch_safe_free(body);
+		return -1;
+	}
+
+	if (plen) {
+		memcpy(data, prefix, plen);
+	}
+
+	if (body) {
+		memcpy(data + plen, body, len + 1);
+		free(body);
+	} else if ((switch_size_t) len < sizeof(buf)) {
+		memcpy(data + plen, buf, len + 1);
+	} else {
+		vsnprintf(data + plen, len + 1, fmt, ap);
+	}
+
+	*ret = data;
+
+	return (int) plen + len;
+}
+
 #define do_mods (LOG_QUEUE && THREAD_RUNNING)
 SWITCH_DECLARE(void) switch_log_vprintf(switch_text_channel_t channel, const char *file, const char *func, int line,
 										const char *userdata, switch_log_level_t level, const char *fmt, va_list ap)
 {
 	char *data = NULL;
-	char *new_fmt = NULL;
+	char prefix[256] = "";
+	switch_size_t plen = 0;
 	int ret = 0;
 	FILE *handle;
-	const char *filep = (file ? switch_cut_path(file) : "");
-	const char *funcp = (func ? func : "");
+	const char *filep;
+	const char *funcp;
 	char *content = NULL;
-	switch_time_t now = switch_micro_time_now();
-	uint32_t len;
-#ifdef SWITCH_FUNC_IN_LOG
-	const char *extra_fmt = "%s [%s] %s:%d %s()%c%s";
-#else
-	const char *extra_fmt = "%s [%s] %s:%d%c%s";
-#endif
+	switch_time_t now;
+	int to_console;
 	switch_log_level_t limit_level = runtime.hard_log_level;
 
 	if (channel == SWITCH_CHANNEL_ID_SESSION && userdata) {
@@ -369,48 +442,42 @@ SWITCH_DECLARE(void) switch_log_vprintf(switch_text_channel_t channel, const cha
 	switch_assert(level < SWITCH_LOG_INVALID);
 
 	handle = switch_core_data_channel(channel);
+	to_console = handle && (console_mods_loaded == 0 || !do_mods);
+
+	/* nobody bound would take this level and it is not going to the console either, don't bother formatting it */
+	if (channel != SWITCH_CHANNEL_ID_EVENT && !to_console && !(do_mods && level <= MAX_LEVEL)) {
+		return;
+	}
+
+	now = switch_micro_time_now();
+	filep = (file ? switch_cut_path(file) : "");
+	funcp = (func ? func : "");
 
 	if (channel != SWITCH_CHANNEL_ID_LOG_CLEAN) {
-		char date[80] = "";
-		//switch_size_t retsize;
 		switch_time_exp_t tm;
 
 		switch_time_exp_lt(&tm, now);
-		switch_snprintf(date, sizeof(date), "%0.4d-%0.2d-%0.2d %0.2d:%0.2d:%0.2d.%0.6d",
-						tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_usec);
-
-		//switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d %T", &tm);
-
 #ifdef SWITCH_FUNC_IN_LOG
-		len = (uint32_t) (strlen(extra_fmt) + strlen(date) + strlen(filep) + 32 + strlen(funcp) + strlen(fmt));
+		switch_snprintf(prefix, sizeof(prefix), "%0.4d-%0.2d-%0.2d %0.2d:%0.2d:%0.2d.%0.6d [%s] %s:%d %s() ",
+						tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_usec,
+						switch_log_level2str(level), filep, line, funcp);
 #else
-		len = (uint32_t) (strlen(extra_fmt) + strlen(date) + strlen(filep) + 32 + strlen(fmt));
+		switch_snprintf(prefix, sizeof(prefix), "%0.4d-%0.2d-%0.2d %0.2d:%0.2d:%0.2d.%0.6d [%s] %s:%d ",
+						tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec, tm.tm_usec,
+						switch_log_level2str(level), filep, line);
 #endif
-		new_fmt = malloc(len + 1);
-		switch_assert(new_fmt);
-#ifdef SWITCH_FUNC_IN_LOG
-		switch_snprintf(new_fmt, len, extra_fmt, date, switch_log_level2str(level), filep, line, funcp, 128, fmt);
-#else
-		switch_snprintf(new_fmt, len, extra_fmt, date, switch_log_level2str(level), filep, line, 128, fmt);
-#endif
-
-		fmt = new_fmt;
+		plen = strlen(prefix);
 	}
 
-	ret = switch_vasprintf(&data, fmt, ap);
+	ret = log_format(&data, prefix, plen, fmt, ap);
 
 	if (ret == -1) {
 		fprintf(stderr, "Memory Error\n");
 		goto end;
 	}
 
-	if (channel == SWITCH_CHANNEL_ID_LOG_CLEAN) {
-		content = data;
-	} else {
-		if ((content = strchr(data, 128))) {
-			*content = ' ';
-		}
-	}
+	/* content starts at the space closing the prefix, as it always has */
+	content = plen ? data + plen - 1 : data;
 
 	if (channel == SWITCH_CHANNEL_ID_EVENT) {
 		switch_event_t *event;
@@ -430,40 +497,38 @@ SWITCH_DECLARE(void) switch_log_vprintf(switch_text_channel_t channel, const cha
 		goto end;
 	}
 
-	if (console_mods_loaded == 0 || !do_mods) {
-		if (handle) {
-			int aok = 1;
+	if (to_console) {
+		int aok = 1;
 #ifndef WIN32
 
-			fd_set can_write;
-			int fd;
-			struct timeval to;
-
-			fd = fileno(handle);
-			memset(&to, 0, sizeof(to));
-			FD_ZERO(&can_write);
-			FD_SET(fd, &can_write);
-			to.tv_sec = 0;
-			to.tv_usec = 100000;
-			if (select(fd + 1, NULL, &can_write, NULL, &to) > 0) {
-				aok = FD_ISSET(fd, &can_write);
-			} else {
-				aok = 0;
-			}
+		fd_set can_write;
+		int fd;
+		struct timeval to;
+
+		fd = fileno(handle);
+		memset(&to, 0, sizeof(to));
+		FD_ZERO(&can_write);
+		FD_SET(fd, &can_write);
+		to.tv_sec = 0;
+		to.tv_usec = 100000;
+		if (select(fd + 1, NULL, &can_write, NULL, &to) > 0) {
+			aok = FD_ISSET(fd, &can_write);
+		} else {
+			aok = 0;
+		}
 #endif
-			if (aok) {
-				if (COLORIZE) {
+		if (aok) {
+			if (COLORIZE) {
 
 #ifdef WIN32
-					SetConsoleTextAttribute(hStdout, COLORS[level]);
-					WriteFile(hStdout, data, (DWORD) strlen(data), NULL, NULL);
-					SetConsoleTextAttribute(hStdout, wOldColorAttrs);
+				SetConsoleTextAttribute(hStdout, COLORS[level]);
+				WriteFile(hStdout, data, (DWORD) strlen(data), NULL, NULL);
+				SetConsoleTextAttribute(hStdout, wOldColorAttrs);
 #else
-					fprintf(handle, "%s%s%s", COLORS[level], data, SWITCH_SEQ_DEFAULT_COLOR);
+				fprintf(handle, "%s%s%s", COLORS[level], data, SWITCH_SEQ_DEFAULT_COLOR);
 #endif
-				} else {
-					fprintf(handle, "%s", data);
-				}
+			} else {
+				fprintf(handle, "%s", data);
 			}
 		}
 	}
@@ -494,7 +559,6 @@ SWITCH_DECLARE(void) switch_log_vprintf(switch_text_channel_t channel, const cha
   end:
 
 	switch_safe_free(data);
-	switch_safe_free(new_fmt);
 
 }
 
@@ -511,6 +575,7 @@ SWITCH_DECLARE(switch_status_t) switch_log_init(switch_memory_pool_t *pool, swit
 
 
 	switch_queue_create(&LOG_QUEUE, SWITCH_CORE_QUEUE_LEN, LOG_POOL);
+	LOG_NODE_SLAB = switch_slab_create("log_node", sizeof(switch_log_node_t), 0);
 #ifdef SWITCH_LOG_RECYCLE
 	switch_queue_create(&LOG_RECYCLE_QUEUE, SWITCH_CORE_QUEUE_LEN, LOG_POOL);
 #endif
@@ -0,0 +1,654 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2012, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * switch_metrics.c - Metrics registry with Prometheus text exposition
+ *
+ * Counters and histograms are split into cache line sized shards picked by
+ * thread id so busy threads don't fight over one line, the shards are only
+ * summed up when somebody scrapes.
+ *
+ */
+
+#include <switch.h>
+
+#define METRIC_SHARDS 8
+#define METRIC_MAX_BUCKETS 62
+
+typedef struct {
+	volatile int64_t value;
+	char pad[64 - sizeof(int64_t)];
+} metric_shard_t;
+
+typedef struct metric_family {
+	char *name;
+	char *help;
+	switch_metric_type_t type;
+	switch_metric_t *series;
+	struct metric_family *next;
+} metric_family_t;
+
+struct switch_metric {
+	char *name;
+	char *labels;
+	metric_family_t *family;
+	switch_metric_type_t type;
+	int refs;
+	switch_metric_callback_t callback;
+	void *user_data;
+	metric_shard_t shards[METRIC_SHARDS];
+	/* histograms: per shard, buckets counts then +Inf then sum */
+	int buckets;
+	int stride;
+	volatile int64_t *hist;
+	struct switch_metric *next;
+};
+
+typedef struct metric_collector {
+	char *name;
+	switch_metric_collector_t collector;
+	void *user_data;
+	struct metric_collector *next;
+} metric_collector_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_thread_rwlock_t *rwlock;
+	switch_hash_t *metric_hash;
+	switch_hash_t *family_hash;
+	metric_family_t *families;
+	metric_family_t *families_tail;
+	metric_collector_t *collectors;
+#if !defined(__GNUC__) && !defined(WIN32)
+	switch_mutex_t *atomic_mutex;
+#endif
+} METRICS;
+
+#if defined(__GNUC__)
+#define metric_atomic_add(_ptr, _val) __sync_fetch_and_add(_ptr, _val)
+#elif defined(WIN32)
+#define metric_atomic_add(_ptr, _val) InterlockedExchangeAdd64(_ptr, _val)
+#else
+static void metric_atomic_add(volatile int64_t *ptr, int64_t val)
+{
+	switch_mutex_lock(METRICS.atomic_mutex);
+	*ptr += val;
+	switch_mutex_unlock(METRICS.atomic_mutex);
+}
+#endif
+
+static int metric_shard(void)
+{
+	uint64_t id = (uint64_t) (uintptr_t) switch_thread_self();
+
+	/* thread ids tend to be aligned pointers, mix them before taking the top bits */
+	id *= 0x9E3779B97F4A7C15ULL;
+
+	return (int) (id >> 61) % METRIC_SHARDS;
+}
+
+static int64_t metric_sum(switch_metric_t *metric)
+{
+	int64_t total = 0;
+	int x;
+
+	for (x = 0; x < METRIC_SHARDS; x++) {
+		total += metric->shards[x].value;
+	}
+
+	return total;
+}
+
+static switch_bool_t metric_valid_name(const char *name, switch_size_t len)
+{
+	switch_size_t x;
+
+	if (!len) {
+		return SWITCH_FALSE;
+	}
+
+	for (x = 0; x < len; x++) {
+		char c = name[x];
+
+		if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c == ':' || (x && c >= '0' && c <= '9'))) {
+			return SWITCH_FALSE;
+		}
+	}
+
+	return SWITCH_TRUE;
+}
+
+static const char *metric_type2str(switch_metric_type_t type)
+{
+	switch (type) {
+	case SWITCH_METRIC_COUNTER:
+		return "counter";
+	case SWITCH_METRIC_HISTOGRAM:
+		return "histogram";
+	default:
+		return "gauge";
+	}
+}
+
+/* find or create the series, caller holds the write lock */
+static switch_metric_t *metric_get(const char *name, const char *help, switch_metric_type_t type)
+{
+	switch_metric_t *metric;
+	metric_family_t *family;
+	const char *labels;
+	switch_size_t flen;
+	char *fname;
+
+	if ((metric = switch_core_hash_find(METRICS.metric_hash, name))) {
+		if (metric->type != type) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Metric %s is already registered as a %s\n", name, metric_type2str(metric->type));
+			return NULL;
+		}
+		metric->refs++;
+		return metric;
+	}
+
+	labels = strchr(name, '{');
+	flen = labels ? (switch_size_t) (labels - name) : strlen(name);
+
+	if (!metric_valid_name(name, flen) || (labels && end_of(labels) != '}')) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid metric name %s\n", name);
+		return NULL;
+	}
+
+	fname = malloc(flen + 1);
+	switch_assert(fname);
+	memcpy(fname, name, flen);
+	fname[flen] = '\0';
+
+	if ((family = switch_core_hash_find(METRICS.family_hash, fname))) {
+		free(fname);
+
+		if (family->type != type) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Metric family %s is already registered as a %s\n", family->name,
+							  metric_type2str(family->type));
+			return NULL;
+		}
+	} else {
+		switch_zmalloc(family, sizeof(*family));
+		family->name = fname;
+		family->help = strdup(zstr(help) ? family->name : help);
+		family->type = type;
+		switch_core_hash_insert(METRICS.family_hash, family->name, family);
+
+		if (METRICS.families_tail) {
+			METRICS.families_tail->next = family;
+		} else {
+			METRICS.families = family;
+		}
+		METRICS.families_tail = family;
+	}
+
+	switch_zmalloc(metric, sizeof(*metric));
+	metric->name = strdup(name);
+	switch_assert(metric->name);
+
+	if (labels) {
+		metric->labels = strdup(labels + 1);
+		switch_assert(metric->labels);
+		end_of(metric->labels) = '\0';
+	} else {
+		metric->labels = "";
+	}
+
+	metric->family = family;
+	metric->type = type;
+	metric->refs = 1;
+
+	/* keep the series in registration order */
+	if (family->series) {
+		switch_metric_t *last;
+		for (last = family->series; last->next; last = last->next);
+		last->next = metric;
+	} else {
+		family->series = metric;
+	}
+
+	switch_core_hash_insert(METRICS.metric_hash, metric->name, metric);
+
+	return metric;
+}
+
+SWITCH_DECLARE(switch_metric_t *) switch_metric_register(const char *name, const char *help, switch_metric_type_t type)
+{
+	switch_metric_t *metric;
+
+	switch_assert(type != SWITCH_METRIC_HISTOGRAM);
+
+	switch_thread_rwlock_wrlock(METRICS.rwlock);
+	metric = metric_get(name, help, type);
+	switch_thread_rwlock_unlock(METRICS.rwlock);
+
+	return metric;
+}
+
+SWITCH_DECLARE(switch_metric_t *) switch_metric_register_callback(const char *name, const char *help, switch_metric_type_t type,
+																  switch_metric_callback_t callback, void *user_data)
+{
+	switch_metric_t *metric;
+
+	switch_assert(type != SWITCH_METRIC_HISTOGRAM && callback);
+
+	switch_thread_rwlock_wrlock(METRICS.rwlock);
+	if ((metric = metric_get(name, help, type))) {
+		metric->callback = callback;
+		metric->user_data = user_data;
+	}
+	switch_thread_rwlock_unlock(METRICS.rwlock);
+
+	return metric;
+}
+
+SWITCH_DECLARE(switch_metric_t *) switch_metric_register_histogram(const char *name, const char *help, int64_t max)
+{
+	switch_metric_t *metric;
+
+	switch_thread_rwlock_wrlock(METRICS.rwlock);
+	if ((metric = metric_get(name, help, SWITCH_METRIC_HISTOGRAM)) && !metric->hist) {
+		int buckets = 1;
+
+		while (buckets < METRIC_MAX_BUCKETS && ((int64_t) 1 << (buckets - 1)) < max) {
+			buckets++;
+		}
+
+		metric->buckets = buckets;
+		/* round each shard up to whole cache lines */
+		metric->stride = ((buckets + 2 + 7) / 8) * 8;
+		switch_zmalloc(metric->hist, sizeof(int64_t) * metric->stride * METRIC_SHARDS);
+	}
+	switch_thread_rwlock_unlock(METRICS.rwlock);
+
+	return metric;
+}
+
+SWITCH_DECLARE(void) switch_metric_unregister(switch_metric_t **metricp)
+{
+	switch_metric_t *metric, *mp, *last = NULL;
+	metric_family_t *family, *fp, *flast = NULL;
+
+	if (!metricp || !(metric = *metricp)) {
+		return;
+	}
+
+	*metricp = NULL;
+
+	switch_thread_rwlock_wrlock(METRICS.rwlock);
+
+	if (--metric->refs > 0) {
+		goto end;
+	}
+
+	family = metric->family;
+
+	for (mp = family->series; mp; mp = mp->next) {
+		if (mp == metric) {
+			if (last) {
+				last->next = mp->next;
+			} else {
+				family->series = mp->next;
+			}
+			break;
+		}
+		last = mp;
+	}
+
+	switch_core_hash_delete(METRICS.metric_hash, metric->name);
+
+	if (!family->series) {
+		for (fp = METRICS.families; fp; fp = fp->next) {
+			if (fp == family) {
+				if (flast) {
+					flast->next = fp->next;
+				} else {
+					METRICS.families = fp->next;
+				}
+				if (METRICS.families_tail == fp) {
+					METRICS.families_tail = flast;
+				}
+				break;
+			}
+			flast = fp;
+		}
+
+		switch_core_hash_delete(METRICS.family_hash, family->name);
+		free(family->name);
+		free(family->help);
+		free(family);
+	}
+
+	if (*metric->labels) {
+		free(metric->labels);
+	}
+	free(metric->name);
+	free((void *) metric->hist);
+	free(metric);
+
+  end:
+
+	switch_thread_rwlock_unlock(METRICS.rwlock);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_metric_register_collector(const char *name, switch_metric_collector_t collector, void *user_data)
+{
+	metric_collector_t *mc, *last = NULL;
+
+	switch_thread_rwlock_wrlock(METRICS.rwlock);
+
+	for (mc = METRICS.collectors; mc; mc = mc->next) {
+		if (!strcmp(mc->name, name)) {
+			switch_thread_rwlock_unlock(METRICS.rwlock);
+			return SWITCH_STATUS_FALSE;
+		}
+		last = mc;
+	}
+
+	switch_zmalloc(mc, sizeof(*mc));
+	mc->name = strdup(name);
+	mc->collector = collector;
+	mc->user_data = user_data;
+
+	if (last) {
+		last->next = mc;
+	} else {
+		METRICS.collectors = mc;
+	}
+
+	switch_thread_rwlock_unlock(METRICS.rwlock);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_metric_unregister_collector(const char *name)
+{
+	metric_collector_t *mc, *last = NULL;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	switch_thread_rwlock_wrlock(METRICS.rwlock);
+
+	for (mc = METRICS.collectors; mc; mc = mc->next) {
+		if (!strcmp(mc->name, name)) {
+			if (last) {
+				last->next = mc->next;
+			} else {
+				METRICS.collectors = mc->next;
+			}
+			free(mc->name);
+			free(mc);
+			status = SWITCH_STATUS_SUCCESS;
+			break;
+		}
+		last = mc;
+	}
+
+	switch_thread_rwlock_unlock(METRICS.rwlock);
+
+	return status;
+}
+
+SWITCH_DECLARE(void) switch_metric_add(switch_metric_t *metric, int64_t value)
+{
+	if (!metric) {
+		return;
+	}
+
+	if (metric->type == SWITCH_METRIC_GAUGE) {
+		metric_atomic_add(&metric->shards[0].value, value);
+	} else {
+		metric_atomic_add(&metric->shards[metric_shard()].value, value);
+	}
+}
+
+SWITCH_DECLARE(void) switch_metric_set(switch_metric_t *metric, int64_t value)
+{
+	if (!metric || metric->type != SWITCH_METRIC_GAUGE) {
+		return;
+	}
+
+	/* gauges only ever use the first shard */
+	metric->shards[0].value = value;
+}
+
+SWITCH_DECLARE(void) switch_metric_observe(switch_metric_t *metric, int64_t value)
+{
+	volatile int64_t *shard;
+	int b = 0;
+
+	if (!metric || !metric->hist) {
+		return;
+	}
+
+	shard = metric->hist + metric->stride * metric_shard();
+
+	while (b < metric->buckets && ((int64_t) 1 << b) < value) {
+		b++;
+	}
+
+	/* b == buckets is the +Inf slot */
+	metric_atomic_add(&shard[b], 1);
+	metric_atomic_add(&shard[metric->buckets + 1], value);
+}
+
+SWITCH_DECLARE(int64_t) switch_metric_get(switch_metric_t *metric)
+{
+	int64_t total = 0;
+	int x, b;
+
+	if (!metric) {
+		return 0;
+	}
+
+	if (metric->callback) {
+		return metric->callback(metric, metric->user_data);
+	}
+
+	if (!metric->hist) {
+		return metric_sum(metric);
+	}
+
+	for (x = 0; x < METRIC_SHARDS; x++) {
+		for (b = 0; b <= metric->buckets; b++) {
+			total += metric->hist[metric->stride * x + b];
+		}
+	}
+
+	return total;
+}
+
+SWITCH_DECLARE(void) switch_metric_write_family(switch_stream_handle_t *stream, const char *name, const char *help, switch_metric_type_t type)
+{
+	stream->write_function(stream, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, metric_type2str(type));
+}
+
+SWITCH_DECLARE(void) switch_metric_write_value(switch_stream_handle_t *stream, const char *name, const char *labels, int64_t value)
+{
+	if (zstr(labels)) {
+		stream->write_function(stream, "%s %" SWITCH_INT64_T_FMT "\n", name, value);
+	} else {
+		stream->write_function(stream, "%s{%s} %" SWITCH_INT64_T_FMT "\n", name, labels, value);
+	}
+}
+
+static void expose_histogram(switch_stream_handle_t *stream, switch_metric_t *metric)
+{
+	const char *name = metric->family->name;
+	const char *sep = *metric->labels ? "," : "";
+	int64_t cum = 0, sum = 0;
+	int x, b;
+
+	for (b = 0; b <= metric->buckets; b++) {
+		for (x = 0; x < METRIC_SHARDS; x++) {
+			cum += metric->hist[metric->stride * x + b];
+		}
+
+		if (b < metric->buckets) {
+			stream->write_function(stream, "%s_bucket{%s%sle=\"%" SWITCH_INT64_T_FMT "\"} %" SWITCH_INT64_T_FMT "\n",
+								   name, metric->labels, sep, (int64_t) 1 << b, cum);
+		} else {
+			stream->write_function(stream, "%s_bucket{%s%sle=\"+Inf\"} %" SWITCH_INT64_T_FMT "\n", name, metric->labels, sep, cum);
+		}
+	}
+
+	for (x = 0; x < METRIC_SHARDS; x++) {
+		sum += metric->hist[metric->stride * x + metric->buckets + 1];
+	}
+
+	stream->write_function(stream, "%s_sum%s%s%s %" SWITCH_INT64_T_FMT "\n", name, *metric->labels ? "{" : "", metric->labels, *metric->labels ? "}" : "", sum);
+	stream->write_function(stream, "%s_count%s%s%s %" SWITCH_INT64_T_FMT "\n", name, *metric->labels ? "{" : "", metric->labels, *metric->labels ? "}" : "", cum);
+}
+
+SWITCH_DECLARE(void) switch_metrics_expose(switch_stream_handle_t *stream)
+{
+	metric_family_t *family;
+	metric_collector_t *mc;
+	switch_metric_t *metric;
+
+	switch_thread_rwlock_rdlock(METRICS.rwlock);
+
+	for (family = METRICS.families; family; family = family->next) {
+		switch_metric_write_family(stream, family->name, family->help, family->type);
+
+		for (metric = family->series; metric; metric = metric->next) {
+			if (metric->hist) {
+				expose_histogram(stream, metric);
+			} else {
+				switch_metric_write_value(stream, family->name, metric->labels, switch_metric_get(metric));
+			}
+		}
+	}
+
+	for (mc = METRICS.collectors; mc; mc = mc->next) {
+		mc->collector(stream, mc->user_data);
+	}
+
+	switch_thread_rwlock_unlock(METRICS.rwlock);
+}
+
+static int64_t core_sessions(switch_metric_t *metric, void *user_data)
+{
+	return switch_core_session_count();
+}
+
+static int64_t core_sessions_total(switch_metric_t *metric, void *user_data)
+{
+	return (int64_t) switch_core_session_id() - 1;
+}
+
+static int64_t core_sessions_limit(switch_metric_t *metric, void *user_data)
+{
+	return switch_core_session_limit(0);
+}
+
+static int64_t core_sps(switch_metric_t *metric, void *user_data)
+{
+	int32_t sps = 0;
+
+	switch_core_session_ctl(SCSC_LAST_SPS, &sps);
+
+	return sps;
+}
+
+static int64_t core_idle_cpu(switch_metric_t *metric, void *user_data)
+{
+	return (int64_t) switch_core_idle_cpu();
+}
+
+static int64_t core_uptime(switch_metric_t *metric, void *user_data)
+{
+	return switch_core_uptime() / 1000000;
+}
+
+SWITCH_DECLARE(void) switch_metrics_init(switch_memory_pool_t *pool)
+{
+	memset(&METRICS, 0, sizeof(METRICS));
+	METRICS.pool = pool;
+	switch_thread_rwlock_create(&METRICS.rwlock, pool);
+	switch_core_hash_init(&METRICS.metric_hash, pool);
+	switch_core_hash_init(&METRICS.family_hash, pool);
+#if !defined(__GNUC__) && !defined(WIN32)
+	switch_mutex_init(&METRICS.atomic_mutex, SWITCH_MUTEX_NESTED, pool);
+#endif
+
+	switch_metric_register_callback("freeswitch_sessions", "Sessions currently up", SWITCH_METRIC_GAUGE, core_sessions, NULL);
+	switch_metric_register_callback("freeswitch_sessions_created_total", "Sessions created since startup", SWITCH_METRIC_COUNTER,
+									core_sessions_total, NULL);
+	switch_metric_register_callback("freeswitch_sessions_limit", "Configured max-sessions", SWITCH_METRIC_GAUGE, core_sessions_limit, NULL);
+	switch_metric_register_callback("freeswitch_sessions_per_second", "Sessions created in the last second", SWITCH_METRIC_GAUGE, core_sps, NULL);
+	switch_metric_register_callback("freeswitch_idle_cpu_percent", "Idle CPU as seen by the core", SWITCH_METRIC_GAUGE, core_idle_cpu, NULL);
+	switch_metric_register_callback("freeswitch_uptime_seconds", "Seconds since startup", SWITCH_METRIC_GAUGE, core_uptime, NULL);
+}
+
+SWITCH_DECLARE(void) switch_metrics_shutdown(void)
+{
+	metric_family_t *family, *fnext;
+	switch_metric_t *metric, *mnext;
+	metric_collector_t *mc, *mcnext;
+
+	switch_thread_rwlock_wrlock(METRICS.rwlock);
+
+	for (family = METRICS.families; family; family = fnext) {
+		fnext = family->next;
+
+		for (metric = family->series; metric; metric = mnext) {
+			mnext = metric->next;
+			if (*metric->labels) {
+				free(metric->labels);
+			}
+			free(metric->name);
+			free((void *) metric->hist);
+			free(metric);
+		}
+
+		free(family->name);
+		free(family->help);
+		free(family);
+	}
+
+	for (mc = METRICS.collectors; mc; mc = mcnext) {
+		mcnext = mc->next;
+		free(mc->name);
+		free(mc);
+	}
+
+	METRICS.families = METRICS.families_tail = NULL;
+	METRICS.collectors = NULL;
+
+	switch_thread_rwlock_unlock(METRICS.rwlock);
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -154,9 +154,8 @@ static switch_status_t switch_g711u_encode(switch_codec_t *codec,
 	dbuf = decoded_data;
 	ebuf = encoded_data;
 
-	for (i = 0; i < decoded_data_len / sizeof(short); i++) {
-		ebuf[i] = linear_to_ulaw(dbuf[i]);
-	}
+	i = decoded_data_len / sizeof(short);
+	linear_to_ulaw_block(ebuf, dbuf, (int) i);
 
 	*encoded_data_len = i;
 
@@ -181,9 +180,8 @@ static switch_status_t switch_g711u_decode(switch_codec_t *codec,
 		memset(dbuf, 0, codec->implementation->decoded_bytes_per_packet);
 		*decoded_data_len = codec->implementation->decoded_bytes_per_packet;
 	} else {
-		for (i = 0; i < encoded_data_len; i++) {
-			dbuf[i] = ulaw_to_linear(ebuf[i]);
-		}
+		i = encoded_data_len;
+		ulaw_to_linear_block(dbuf, ebuf, (int) i);
 
 		*decoded_data_len = i * 2;
 	}
@@ -225,9 +223,8 @@ static switch_status_t switch_g711a_encode(switch_codec_t *codec,
 	dbuf = decoded_data;
 	ebuf = encoded_data;
 
-	for (i = 0; i < decoded_data_len / sizeof(short); i++) {
-		ebuf[i] = linear_to_alaw(dbuf[i]);
-	}
+	i = decoded_data_len / sizeof(short);
+	linear_to_alaw_block(ebuf, dbuf, (int) i);
 
 	*encoded_data_len = i;
 
@@ -252,9 +249,8 @@ static switch_status_t switch_g711a_decode(switch_codec_t *codec,
 		memset(dbuf, 0, codec->implementation->decoded_bytes_per_packet);
 		*decoded_data_len = codec->implementation->decoded_bytes_per_packet;
 	} else {
-		for (i = 0; i < encoded_data_len; i++) {
-			dbuf[i] = alaw_to_linear(ebuf[i]);
-		}
+		i = encoded_data_len;
+		alaw_to_linear_block(dbuf, ebuf, (int) i);
 
 		*decoded_data_len = i * 2;
 	}
@@ -273,6 +269,8 @@ static void mod_g711_load(switch_loadable_module_interface_t ** module_interface
 	switch_codec_interface_t *codec_interface;
 	int mpf = 10000, spf = 80, bpf = 160, ebpf = 80, count;
 
+	g711_init_tables();
+
 	SWITCH_ADD_CODEC(codec_interface, "G.711 ulaw");
 	for (count = 12; count > 0; count--) {
 		switch_core_codec_add_implementation(pool, codec_interface, SWITCH_CODEC_TYPE_AUDIO,	/* enumeration defining the type of the codec */
@@ -0,0 +1,912 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2012, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * switch_prefix.c - Longest prefix match tables over digit strings
+ *
+ * A table is a digit trie flattened into one array: a node keeps a bitmask of
+ * the digits it has children for and the index of the first of them, the
+ * children of a node are stored next to each other in digit order.  Nothing in
+ * it is a pointer so a snapshot is the array written to disk and mapped back.
+ *
+ */
+
+#include <switch.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+#define PREFIX_MAGIC 0x54504653
+#define PREFIX_VERSION 1
+#define PREFIX_MAX_DIGITS 64
+
+typedef struct {
+	uint16_t mask;				/* which of the ten digits have a child */
+	uint16_t pad;
+	uint32_t first_child;		/* index of the child for the lowest digit in mask */
+	uint32_t value;				/* offset + 1 into the strings, 0 when no prefix ends here */
+} prefix_node_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t node_size;
+	uint32_t node_count;
+	uint32_t entry_count;
+	uint32_t strings_len;
+} prefix_header_t;
+
+struct switch_prefix_table {
+	prefix_node_t *nodes;
+	uint32_t node_count;
+	uint32_t entry_count;
+	char *strings;
+	uint32_t strings_len;
+	void *map;					/* the snapshot this table is read from, NULL when it was built */
+	switch_size_t map_len;
+};
+
+typedef struct {
+	char *data;
+	uint32_t len;
+	uint32_t size;
+} prefix_blob_t;
+
+typedef struct {
+	uint32_t key;
+	uint32_t key_len;
+	uint32_t value;
+	uint32_t seq;
+	const char *key_ptr;
+} prefix_entry_t;
+
+struct switch_prefix_builder {
+	prefix_entry_t *entries;
+	uint32_t count;
+	uint32_t size;
+	prefix_blob_t keys;
+	prefix_blob_t strings;
+	switch_hash_t *values;		/* most tables repeat a handful of values, keep one copy of each */
+	prefix_node_t *nodes;
+	uint32_t node_count;
+	uint32_t node_size;
+};
+
+typedef struct {
+	char *name;
+	char *source;
+	switch_prefix_table_t *table;
+	switch_time_t loaded;
+} prefix_named_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_hash_t *tables;
+	switch_thread_rwlock_t *rwlock;
+	switch_mutex_t *load_mutex;
+} PREFIX;
+
+static uint32_t prefix_popcount(uint32_t v)
+{
+#if defined(__GNUC__)
+	return (uint32_t) __builtin_popcount(v);
+#else
+	uint32_t c;
+
+	for (c = 0; v; c++) {
+		v &= v - 1;
+	}
+
+	return c;
+#endif
+}
+
+static uint32_t prefix_blob_add(prefix_blob_t *blob, const char *str, uint32_t len)
+{
+	uint32_t off = blob->len;
+
+	if (blob->len + len + 1 > blob->size) {
+		uint32_t size = blob->size ? blob->size : 4096;
+		char *data;
+
+		while (size < blob->len + len + 1) {
+			size *= 2;
+		}
+
+		if (!(data = realloc(blob->data, size))) {
+			return UINT32_MAX;
+		}
+
+		blob->data = data;
+		blob->size = size;
+	}
+
+	memcpy(blob->data + blob->len, str, len);
+	blob->data[blob->len + len] = '\0';
+	blob->len += len + 1;
+
+	return off;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_prefix_builder_create(switch_prefix_builder_t **builder)
+{
+	switch_prefix_builder_t *b;
+
+	switch_zmalloc(b, sizeof(*b));
+	switch_core_hash_init(&b->values, NULL);
+	*builder = b;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_prefix_builder_destroy(switch_prefix_builder_t **builder)
+{
+	switch_prefix_builder_t *b;
+
+	if (!builder || !(b = *builder)) {
+		return;
+	}
+
+	switch_core_hash_destroy(&b->values);
+	switch_safe_free(b->entries);
+	switch_safe_free(b->keys.data);
+	switch_safe_free(b->strings.data);
+	switch_safe_free(b->nodes);
+	free(b);
+	*builder = NULL;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_prefix_builder_add(switch_prefix_builder_t *builder, const char *prefix, const char *value)
+{
+	char digits[PREFIX_MAX_DIGITS + 1];
+	uint32_t len = 0, value_off;
+	const char *p;
+	void *v;
+
+	if (!prefix || !value) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	for (p = prefix; *p; p++) {
+		if (!switch_isdigit(*p)) {
+			continue;
+		}
+		if (len == PREFIX_MAX_DIGITS) {
+			return SWITCH_STATUS_FALSE;
+		}
+		digits[len++] = *p;
+	}
+	digits[len] = '\0';
+
+	if ((v = switch_core_hash_find(builder->values, value))) {
+		value_off = (uint32_t) (intptr_t) v;
+	} else {
+		if ((value_off = prefix_blob_add(&builder->strings, value, (uint32_t) strlen(value))) == UINT32_MAX) {
+			return SWITCH_STATUS_MEMERR;
+		}
+		value_off++;
+		switch_core_hash_insert(builder->values, value, (void *) (intptr_t) value_off);
+	}
+
+	if (builder->count == builder->size) {
+		uint32_t size = builder->size ? builder->size * 2 : 1024;
+		prefix_entry_t *entries;
+
+		if (!(entries = realloc(builder->entries, size * sizeof(*entries)))) {
+			return SWITCH_STATUS_MEMERR;
+		}
+
+		builder->entries = entries;
+		builder->size = size;
+	}
+
+	if ((builder->entries[builder->count].key = prefix_blob_add(&builder->keys, digits, len)) == UINT32_MAX) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	builder->entries[builder->count].key_len = len;
+	builder->entries[builder->count].value = value_off;
+	builder->entries[builder->count].seq = builder->count;
+	builder->count++;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static int prefix_entry_compare(const void *a, const void *b)
+{
+	const prefix_entry_t *x = (const prefix_entry_t *) a;
+	const prefix_entry_t *y = (const prefix_entry_t *) b;
+	int r;
+
+	if ((r = strcmp(x->key_ptr, y->key_ptr))) {
+		return r;
+	}
+
+	return x->seq < y->seq ? -1 : 1;
+}
+
+/* fills node for the sorted entries [lo, hi) that all share their first depth digits, then recurses into its children */
+static switch_status_t prefix_build(switch_prefix_builder_t *b, uint32_t lo, uint32_t hi, uint32_t depth, uint32_t node, uint32_t *entries)
+{
+	uint32_t i = lo, groups = 0, first, glo, ghi, g = 0, value = 0;
+	uint16_t mask = 0;
+
+	/* sorted entries that end here come first, the last one added wins */
+	while (i < hi && b->entries[i].key_len == depth) {
+		value = b->entries[i].value;
+		i++;
+	}
+
+	if (value) {
+		(*entries)++;
+	}
+
+	for (glo = i; glo < hi; glo++) {
+		uint16_t bit = (uint16_t) (1 << (b->entries[glo].key_ptr[depth] - '0'));
+
+		if (!(mask & bit)) {
+			mask |= bit;
+			groups++;
+		}
+	}
+
+	if (b->node_count + groups > b->node_size) {
+		uint32_t size = b->node_size ? b->node_size : 1024;
+		prefix_node_t *nodes;
+
+		while (size < b->node_count + groups) {
+			size *= 2;
+		}
+
+		if (!(nodes = realloc(b->nodes, size * sizeof(*nodes)))) {
+			return SWITCH_STATUS_MEMERR;
+		}
+
+		b->nodes = nodes;
+		b->node_size = size;
+	}
+
+	first = b->node_count;
+	memset(b->nodes + first, 0, groups * sizeof(*b->nodes));
+	b->node_count += groups;
+
+	b->nodes[node].mask = mask;
+	b->nodes[node].first_child = first;
+	b->nodes[node].value = value;
+
+	for (glo = i; glo < hi; glo = ghi) {
+		char d = b->entries[glo].key_ptr[depth];
+
+		for (ghi = glo + 1; ghi < hi && b->entries[ghi].key_ptr[depth] == d; ghi++);
+
+		if (prefix_build(b, glo, ghi, depth + 1, first + g++, entries) != SWITCH_STATUS_SUCCESS) {
+			return SWITCH_STATUS_MEMERR;
+		}
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_prefix_builder_finish(switch_prefix_builder_t **builder, switch_prefix_table_t **table)
+{
+	switch_prefix_builder_t *b = *builder;
+	switch_prefix_table_t *t;
+	uint32_t i, entries = 0;
+
+	*table = NULL;
+
+	for (i = 0; i < b->count; i++) {
+		b->entries[i].key_ptr = b->keys.data + b->entries[i].key;
+	}
+
+	qsort(b->entries, b->count, sizeof(*b->entries), prefix_entry_compare);
+
+	switch_zmalloc(b->nodes, sizeof(*b->nodes));
+	b->node_count = b->node_size = 1;
+
+	if (prefix_build(b, 0, b->count, 0, 0, &entries) != SWITCH_STATUS_SUCCESS) {
+		switch_prefix_builder_destroy(builder);
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	switch_zmalloc(t, sizeof(*t));
+	t->nodes = b->nodes;
+	t->node_count = b->node_count;
+	t->entry_count = entries;
+	t->strings = b->strings.data;
+	t->strings_len = b->strings.len;
+
+	b->nodes = NULL;
+	b->strings.data = NULL;
+	switch_prefix_builder_destroy(builder);
+
+	*table = t;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(const char *) switch_prefix_table_find(switch_prefix_table_t *table, const char *number, switch_size_t *matched)
+{
+	const prefix_node_t *node;
+	const char *p, *value = NULL;
+	switch_size_t depth = 0;
+
+	if (matched) {
+		*matched = 0;
+	}
+
+	if (!table || !number) {
+		return NULL;
+	}
+
+	node = table->nodes;
+
+	if (node->value) {
+		value = table->strings + node->value - 1;
+	}
+
+	for (p = number; *p; p++) {
+		uint32_t d;
+
+		if (!switch_isdigit(*p)) {
+			continue;
+		}
+
+		d = (uint32_t) (*p - '0');
+
+		if (!(node->mask & (1 << d))) {
+			break;
+		}
+
+		node = table->nodes + node->first_child + prefix_popcount(node->mask & ((1 << d) - 1));
+		depth++;
+
+		if (node->value) {
+			value = table->strings + node->value - 1;
+			if (matched) {
+				*matched = depth;
+			}
+		}
+	}
+
+	return value;
+}
+
+SWITCH_DECLARE(uint32_t) switch_prefix_table_count(switch_prefix_table_t *table)
+{
+	return table ? table->entry_count : 0;
+}
+
+SWITCH_DECLARE(void) switch_prefix_table_destroy(switch_prefix_table_t **table)
+{
+	switch_prefix_table_t *t;
+
+	if (!table || !(t = *table)) {
+		return;
+	}
+
+	if (t->map) {
+#ifndef WIN32
+		munmap(t->map, t->map_len);
+#else
+		free(t->map);
+#endif
+	} else {
+		switch_safe_free(t->nodes);
+		switch_safe_free(t->strings);
+	}
+
+	free(t);
+	*table = NULL;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_prefix_table_save(switch_prefix_table_t *table, const char *path)
+{
+	prefix_header_t header = { 0 };
+	char *tmp;
+	FILE *f;
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	header.magic = PREFIX_MAGIC;
+	header.version = PREFIX_VERSION;
+	header.node_size = sizeof(prefix_node_t);
+	header.node_count = table->node_count;
+	header.entry_count = table->entry_count;
+	header.strings_len = table->strings_len;
+
+	tmp = switch_mprintf("%s.tmp", path);
+
+	if (!(f = fopen(tmp, "wb"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot write prefix snapshot %s\n", tmp);
+		free(tmp);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (fwrite(&header, sizeof(header), 1, f) != 1 ||
+		fwrite(table->nodes, sizeof(prefix_node_t), table->node_count, f) != table->node_count ||
+		(table->strings_len && fwrite(table->strings, 1, table->strings_len, f) != table->strings_len)) {
+		status = SWITCH_STATUS_FALSE;
+	}
+
+	if (fclose(f) != 0) {
+		status = SWITCH_STATUS_FALSE;
+	}
+
+	if (status == SWITCH_STATUS_SUCCESS) {
+#ifdef WIN32
+		remove(path);
+#endif
+		if (rename(tmp, path) != 0) {
+			status = SWITCH_STATUS_FALSE;
+		}
+	}
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot write prefix snapshot %s\n", path);
+		remove(tmp);
+	}
+
+	free(tmp);
+
+	return status;
+}
+
+/* a snapshot is trusted only after every index in it was checked, lookups don't bounds check */
+static switch_bool_t prefix_snapshot_valid(const prefix_header_t *header, switch_size_t len)
+{
+	const prefix_node_t *nodes = (const prefix_node_t *) (header + 1);
+	const char *strings;
+	uint32_t i;
+
+	if (len < sizeof(*header) || header->magic != PREFIX_MAGIC || header->version != PREFIX_VERSION ||
+		header->node_size != sizeof(prefix_node_t) || header->node_count == 0) {
+		return SWITCH_FALSE;
+	}
+
+	if ((uint64_t) len != (uint64_t) sizeof(*header) + (uint64_t) header->node_count * sizeof(prefix_node_t) + header->strings_len) {
+		return SWITCH_FALSE;
+	}
+
+	strings = (const char *) (nodes + header->node_count);
+
+	if (header->strings_len && strings[header->strings_len - 1] != '\0') {
+		return SWITCH_FALSE;
+	}
+
+	for (i = 0; i < header->node_count; i++) {
+		if ((nodes[i].mask & ~0x3ff) || (nodes[i].value && nodes[i].value > header->strings_len)) {
+			return SWITCH_FALSE;
+		}
+		if (nodes[i].mask && (nodes[i].first_child <= i ||
+							  (uint64_t) nodes[i].first_child + prefix_popcount(nodes[i].mask) > header->node_count)) {
+			return SWITCH_FALSE;
+		}
+	}
+
+	return SWITCH_TRUE;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_prefix_table_load_snapshot(switch_prefix_table_t **table, const char *path)
+{
+	switch_prefix_table_t *t;
+	prefix_header_t *header;
+	struct stat st;
+	void *map;
+	FILE *f;
+
+	*table = NULL;
+
+	if (!(f = fopen(path, "rb"))) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (fstat(fileno(f), &st) != 0 || st.st_size < (off_t) sizeof(prefix_header_t)) {
+		fclose(f);
+		return SWITCH_STATUS_FALSE;
+	}
+
+#ifndef WIN32
+	if ((map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fileno(f), 0)) == MAP_FAILED) {
+		fclose(f);
+		return SWITCH_STATUS_FALSE;
+	}
+#else
+	if (!(map = malloc((size_t) st.st_size)) || fread(map, 1, (size_t) st.st_size, f) != (size_t) st.st_size) {
+		switch_safe_free(map);
+		fclose(f);
+		return SWITCH_STATUS_FALSE;
+	}
+#endif
+	fclose(f);
+
+	header = (prefix_header_t *) map;
+
+	switch_zmalloc(t, sizeof(*t));
+	t->map = map;
+	t->map_len = (switch_size_t) st.st_size;
+
+	if (!prefix_snapshot_valid(header, t->map_len)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Ignoring invalid prefix snapshot %s\n", path);
+		switch_prefix_table_destroy(&t);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	t->nodes = (prefix_node_t *) (header + 1);
+	t->node_count = header->node_count;
+	t->entry_count = header->entry_count;
+	t->strings = (char *) (t->nodes + t->node_count);
+	t->strings_len = header->strings_len;
+
+	*table = t;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_prefix_table_load_csv(switch_prefix_table_t **table, const char *path)
+{
+	switch_prefix_builder_t *builder = NULL;
+	char line[4096];
+	uint32_t lineno = 0, bad = 0;
+	FILE *f;
+
+	*table = NULL;
+
+	if (!(f = fopen(path, "r"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot open prefix file %s\n", path);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_prefix_builder_create(&builder);
+
+	while (fgets(line, sizeof(line), f)) {
+		char *value, *end;
+
+		lineno++;
+
+		if ((end = strpbrk(line, "\r\n"))) {
+			*end = '\0';
+		}
+
+		if (zstr(line) || *line == '#') {
+			continue;
+		}
+
+		if (!(value = strchr(line, ','))) {
+			bad++;
+			continue;
+		}
+		*value++ = '\0';
+
+		end = value + strlen(value);
+		if (*value == '"' && end > value + 1 && *(end - 1) == '"') {
+			*(end - 1) = '\0';
+			value++;
+		}
+
+		if (switch_prefix_builder_add(builder, line, value) != SWITCH_STATUS_SUCCESS) {
+			bad++;
+		}
+	}
+
+	fclose(f);
+
+	if (bad) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Skipped %u of %u lines in %s\n", bad, lineno, path);
+	}
+
+	return switch_prefix_builder_finish(&builder, table);
+}
+
+static int prefix_sql_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	switch_prefix_builder_t *builder = (switch_prefix_builder_t *) pArg;
+
+	if (argc >= 2 && argv[0] && argv[1]) {
+		switch_prefix_builder_add(builder, argv[0], argv[1]);
+	}
+
+	return 0;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_prefix_table_load_sql(switch_prefix_table_t **table, const char *dsn, const char *sql)
+{
+	switch_prefix_builder_t *builder = NULL;
+	switch_cache_db_handle_t *dbh = NULL;
+	char *errmsg = NULL;
+	switch_status_t status;
+
+	*table = NULL;
+
+	if (!zstr(dsn)) {
+		switch_cache_db_connection_options_t options = { {0} };
+		char *dup = strdup(dsn), *user = NULL, *pass = NULL;
+
+		if ((user = strchr(dup, ':'))) {
+			*user++ = '\0';
+			if ((pass = strchr(user, ':'))) {
+				*pass++ = '\0';
+			}
+		}
+
+		options.odbc_options.dsn = dup;
+		options.odbc_options.user = user;
+		options.odbc_options.pass = pass;
+
+		status = switch_cache_db_get_db_handle(&dbh, SCDB_TYPE_ODBC, &options);
+		free(dup);
+	} else {
+		status = switch_core_db_handle(&dbh);
+	}
+
+	if (status != SWITCH_STATUS_SUCCESS || !dbh) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot open the database for a prefix table\n");
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_prefix_builder_create(&builder);
+
+	status = switch_cache_db_execute_sql_callback(dbh, sql, prefix_sql_callback, builder, &errmsg);
+	switch_cache_db_release_db_handle(&dbh);
+
+	if (status != SWITCH_STATUS_SUCCESS || errmsg) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Prefix table query failed [%s] %s\n", sql, switch_str_nil(errmsg));
+		switch_safe_free(errmsg);
+		switch_prefix_builder_destroy(&builder);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	return switch_prefix_builder_finish(&builder, table);
+}
+
+static void prefix_named_destroy(prefix_named_t **named, switch_bool_t with_table)
+{
+	if (with_table) {
+		switch_prefix_table_destroy(&(*named)->table);
+	}
+	switch_safe_free((*named)->name);
+	switch_safe_free((*named)->source);
+	free(*named);
+	*named = NULL;
+}
+
+/* a csv only goes through its snapshot when the snapshot is newer, a query always does on startup */
+static switch_bool_t prefix_snapshot_usable(const char *snapshot, const char *csv)
+{
+	struct stat snap_st, csv_st;
+
+	if (stat(snapshot, &snap_st) != 0) {
+		return SWITCH_FALSE;
+	}
+
+	if (csv && (stat(csv, &csv_st) != 0 || csv_st.st_mtime > snap_st.st_mtime)) {
+		return SWITCH_FALSE;
+	}
+
+	return SWITCH_TRUE;
+}
+
+SWITCH_DECLARE(void) switch_load_prefix_tables(switch_bool_t reload)
+{
+	switch_xml_t xml = NULL, cfg = NULL, x_tables, x_table;
+	switch_hash_t *tables = NULL, *old;
+	switch_hash_index_t *hi;
+
+	if (!(xml = switch_xml_open_cfg("prefix.conf", &cfg, NULL))) {
+		return;
+	}
+
+	switch_mutex_lock(PREFIX.load_mutex);
+
+	switch_core_hash_init(&tables, NULL);
+
+	if ((x_tables = switch_xml_child(cfg, "tables"))) {
+		for (x_table = switch_xml_child(x_tables, "table"); x_table; x_table = x_table->next) {
+			const char *name = switch_xml_attr(x_table, "name");
+			const char *csv = switch_xml_attr(x_table, "csv");
+			const char *sql = switch_xml_attr(x_table, "sql");
+			const char *dsn = switch_xml_attr(x_table, "dsn");
+			const char *snapshot = switch_xml_attr(x_table, "snapshot");
+			switch_prefix_table_t *table = NULL;
+			prefix_named_t *named, *prev;
+			switch_time_t start = switch_micro_time_now();
+			const char *from = NULL;
+
+			if (zstr(name) || (zstr(csv) && zstr(sql))) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "A prefix table needs a name and a csv or sql source\n");
+				continue;
+			}
+
+			if (switch_core_hash_find(tables, name)) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Duplicate prefix table %s\n", name);
+				continue;
+			}
+
+			if (!reload && !zstr(snapshot) && prefix_snapshot_usable(snapshot, zstr(csv) ? NULL : csv) &&
+				switch_prefix_table_load_snapshot(&table, snapshot) == SWITCH_STATUS_SUCCESS) {
+				from = snapshot;
+			}
+
+			if (!table) {
+				if (!zstr(csv)) {
+					switch_prefix_table_load_csv(&table, csv);
+					from = csv;
+				} else {
+					switch_prefix_table_load_sql(&table, dsn, sql);
+					from = "sql";
+				}
+
+				if (table && !zstr(snapshot)) {
+					switch_prefix_table_save(table, snapshot);
+				}
+			}
+
+			switch_zmalloc(named, sizeof(*named));
+			named->name = strdup(name);
+			named->source = strdup(zstr(csv) ? sql : csv);
+
+			if (table) {
+				named->table = table;
+				named->loaded = switch_micro_time_now();
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Loaded %u prefixes into table %s from %s in %dms\n",
+								  switch_prefix_table_count(table), name, from, (int) ((named->loaded - start) / 1000));
+			} else if (PREFIX.tables && (prev = switch_core_hash_find(PREFIX.tables, name))) {
+				/* the old hash is only read until the swap below, the table moves over and is left alone by the cleanup */
+				named->table = prev->table;
+				named->loaded = prev->loaded;
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot reload prefix table %s, keeping the old one\n", name);
+			} else {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot load prefix table %s\n", name);
+				prefix_named_destroy(&named, SWITCH_FALSE);
+				continue;
+			}
+
+			switch_core_hash_insert(tables, name, named);
+		}
+	}
+
+	switch_thread_rwlock_wrlock(PREFIX.rwlock);
+	old = PREFIX.tables;
+	PREFIX.tables = tables;
+	switch_thread_rwlock_unlock(PREFIX.rwlock);
+
+	if (old) {
+		while ((hi = switch_hash_first(NULL, old))) {
+			const void *key;
+			void *val;
+			prefix_named_t *named, *now;
+
+			switch_hash_this(hi, &key, NULL, &val);
+			named = (prefix_named_t *) val;
+			now = switch_core_hash_find(tables, named->name);
+			switch_core_hash_delete(old, key);
+			prefix_named_destroy(&named, !(now && now->table == named->table));
+		}
+		switch_core_hash_destroy(&old);
+	}
+
+	switch_mutex_unlock(PREFIX.load_mutex);
+
+	switch_xml_free(xml);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_prefix_lookup(const char *name, const char *number, char *buf, switch_size_t buflen, switch_size_t *matched)
+{
+	prefix_named_t *named;
+	const char *value;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (matched) {
+		*matched = 0;
+	}
+
+	if (zstr(name)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_thread_rwlock_rdlock(PREFIX.rwlock);
+
+	if (PREFIX.tables && (named = switch_core_hash_find(PREFIX.tables, name))) {
+		if ((value = switch_prefix_table_find(named->table, number, matched))) {
+			switch_copy_string(buf, value, buflen);
+			status = SWITCH_STATUS_SUCCESS;
+		} else {
+			status = SWITCH_STATUS_NOTFOUND;
+		}
+	}
+
+	switch_thread_rwlock_unlock(PREFIX.rwlock);
+
+	return status;
+}
+
+SWITCH_DECLARE(void) switch_prefix_tables_dump(switch_stream_handle_t *stream)
+{
+	switch_hash_index_t *hi;
+
+	stream->write_function(stream, "%-20s %10s  %s\n", "name", "prefixes", "source");
+
+	switch_thread_rwlock_rdlock(PREFIX.rwlock);
+
+	if (PREFIX.tables) {
+		for (hi = switch_hash_first(NULL, PREFIX.tables); hi; hi = switch_hash_next(hi)) {
+			void *val;
+			prefix_named_t *named;
+
+			switch_hash_this(hi, NULL, NULL, &val);
+			named = (prefix_named_t *) val;
+			stream->write_function(stream, "%-20s %10u  %s%s\n", named->name, switch_prefix_table_count(named->table), named->source,
+								   named->table->map ? " (snapshot)" : "");
+		}
+	}
+
+	switch_thread_rwlock_unlock(PREFIX.rwlock);
+}
+
+SWITCH_DECLARE(void) switch_prefix_init(switch_memory_pool_t *pool)
+{
+	memset(&PREFIX, 0, sizeof(PREFIX));
+	PREFIX.pool = pool;
+	switch_thread_rwlock_create(&PREFIX.rwlock, pool);
+	switch_mutex_init(&PREFIX.load_mutex, SWITCH_MUTEX_NESTED, pool);
+}
+
+SWITCH_DECLARE(void) switch_prefix_shutdown(void)
+{
+	switch_hash_index_t *hi;
+	switch_hash_t *tables;
+
+	switch_thread_rwlock_wrlock(PREFIX.rwlock);
+	tables = PREFIX.tables;
+	PREFIX.tables = NULL;
+	switch_thread_rwlock_unlock(PREFIX.rwlock);
+
+	if (!tables) {
+		return;
+	}
+
+	while ((hi = switch_hash_first(NULL, tables))) {
+		const void *key;
+		void *val;
+		prefix_named_t *named;
+
+		switch_hash_this(hi, &key, NULL, &val);
+		named = (prefix_named_t *) val;
+		switch_core_hash_delete(tables, key);
+		prefix_named_destroy(&named, SWITCH_TRUE);
+	}
+
+	switch_core_hash_destroy(&tables);
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
@@ -32,6 +32,7 @@
 
 #include <switch.h>
 #include <pcre.h>
+#include "private/switch_core_pvt.h"
 
 SWITCH_DECLARE(switch_regex_t *) switch_regex_compile(const char *pattern,
 													  int options, const char **errorptr, int *erroroffset, const unsigned char *tables)
@@ -52,18 +53,17 @@ SWITCH_DECLARE(void) switch_regex_free(void *data)
 
 }
 
-SWITCH_DECLARE(int) switch_regex_perform(const char *field, const char *expression, switch_regex_t **new_re, int *ovector, uint32_t olen)
+SWITCH_DECLARE(switch_regex_t *) switch_regex_compile_expression(const char *expression)
 {
 	const char *error = NULL;
 	int erroffset = 0;
 	pcre *re = NULL;
-	int match_count = 0;
 	char *tmp = NULL;
 	uint32_t flags = 0;
 	char abuf[256] = "";
 
-	if (!(field && expression)) {
-		return 0;
+	if (!expression) {
+		return NULL;
 	}
 
 	if (*expression == '_') {
@@ -100,10 +100,22 @@ SWITCH_DECLARE(int) switch_regex_perform(const char *field, const char *expressi
 	if (error) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "COMPILE ERROR: %d [%s][%s]\n", erroffset, error, expression);
 		switch_regex_safe_free(re);
-		goto end;
 	}
 
-	match_count = pcre_exec(re,	/* result of pcre_compile() */
+  end:
+	switch_safe_free(tmp);
+	return (switch_regex_t *) re;
+}
+
+SWITCH_DECLARE(int) switch_regex_exec(switch_regex_t *re, const char *field, int *ovector, uint32_t olen)
+{
+	int match_count;
+
+	if (!(re && field)) {
+		return 0;
+	}
+
+	match_count = pcre_exec((pcre *) re,	/* result of pcre_compile() */
 							NULL,	/* we didn't study the pattern */
 							field,	/* the subject string */
 							(int) strlen(field),	/* the length of the subject string */
@@ -112,16 +124,267 @@ SWITCH_DECLARE(int) switch_regex_perform(const char *field, const char *expressi
 							ovector,	/* vector of integers for substring information */
 							olen);	/* number of elements (NOT size in bytes) */
 
+	return match_count > 0 ? match_count : 0;
+}
 
-	if (match_count <= 0) {
+/*
+ * Compiled pattern cache.  Dialplan conditions, event socket filters and the regex api keep matching the
+ * same few hundred expressions, so the compiled (and studied) pattern is kept keyed by the expression and
+ * the way it is compiled, least recently used goes first once regex-cache-size is reached.
+ * An entry is referenced while it is being matched so eviction never frees it from under a matcher.
+ */
+typedef struct regex_cache_entry {
+	char *key;
+	pcre *re;
+	pcre_extra *extra;
+	size_t size;
+	int refs;
+	int dead;
+	struct regex_cache_entry *prev;
+	struct regex_cache_entry *next;
+} regex_cache_entry_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *hash;
+	regex_cache_entry_t *head;
+	regex_cache_entry_t *tail;
+	uint32_t count;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+} REGEX_CACHE;
+
+static void regex_cache_entry_free(regex_cache_entry_t *entry)
+{
+	if (entry->extra) {
+		pcre_free(entry->extra);
+	}
+	pcre_free(entry->re);
+	free(entry->key);
+	free(entry);
+}
+
+static void regex_cache_unlink(regex_cache_entry_t *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		REGEX_CACHE.head = entry->next;
+	}
+
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		REGEX_CACHE.tail = entry->prev;
+	}
+
+	entry->prev = entry->next = NULL;
+}
+
+static void regex_cache_push(regex_cache_entry_t *entry)
+{
+	entry->prev = NULL;
+	if ((entry->next = REGEX_CACHE.head)) {
+		REGEX_CACHE.head->prev = entry;
+	} else {
+		REGEX_CACHE.tail = entry;
+	}
+	REGEX_CACHE.head = entry;
+}
+
+/* takes the entry out of the cache, it is freed now or by the last regex_cache_release() */
+static void regex_cache_drop(regex_cache_entry_t *entry)
+{
+	regex_cache_unlink(entry);
+	switch_core_hash_delete(REGEX_CACHE.hash, entry->key);
+	REGEX_CACHE.count--;
+
+	if (entry->refs) {
+		entry->dead = 1;
+	} else {
+		regex_cache_entry_free(entry);
+	}
+}
+
+static pcre *regex_compile_raw(const char *expression)
+{
+	const char *error = NULL;
+	int error_offset = 0;
+	pcre *re;
+
+	re = pcre_compile(expression, 0, &error, &error_offset, NULL);
+
+	if (error != NULL) {
+		if (re) {
+			pcre_free(re);
+		}
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
+						  "Regular Expression Error expression[%s] error[%s] location[%d]\n", expression, error, error_offset);
+		return NULL;
+	}
+
+	return re;
+}
+
+/* raw patterns go straight to pcre, the others through switch_regex_compile_expression, NULL when disabled or it does not compile */
+static regex_cache_entry_t *regex_cache_get(const char *expression, switch_bool_t raw)
+{
+	regex_cache_entry_t *entry, *old;
+	const char *error = NULL;
+	char *key;
+	pcre *re;
+
+	if (!REGEX_CACHE.mutex || !runtime.regex_cache_size) {
+		return NULL;
+	}
+
+	key = switch_mprintf("%c%s", raw ? 'r' : 'e', expression);
+
+	switch_mutex_lock(REGEX_CACHE.mutex);
+	if ((entry = switch_core_hash_find(REGEX_CACHE.hash, key))) {
+		REGEX_CACHE.hits++;
+		entry->refs++;
+		if (entry != REGEX_CACHE.head) {
+			regex_cache_unlink(entry);
+			regex_cache_push(entry);
+		}
+		switch_mutex_unlock(REGEX_CACHE.mutex);
+		free(key);
+		return entry;
+	}
+	REGEX_CACHE.misses++;
+	switch_mutex_unlock(REGEX_CACHE.mutex);
+
+	if (!(re = raw ? regex_compile_raw(expression) : (pcre *) switch_regex_compile_expression(expression))) {
+		free(key);
+		return NULL;
+	}
+
+	switch_zmalloc(entry, sizeof(*entry));
+	entry->key = key;
+	entry->re = re;
+	entry->extra = pcre_study(re, 0, &error);
+	pcre_fullinfo(re, NULL, PCRE_INFO_SIZE, &entry->size);
+	entry->refs = 1;
+
+	switch_mutex_lock(REGEX_CACHE.mutex);
+	if ((old = switch_core_hash_find(REGEX_CACHE.hash, key))) {
+		/* somebody else compiled it meanwhile, theirs stays */
+		old->refs++;
+		switch_mutex_unlock(REGEX_CACHE.mutex);
+		regex_cache_entry_free(entry);
+		return old;
+	}
+
+	switch_core_hash_insert(REGEX_CACHE.hash, key, entry);
+	regex_cache_push(entry);
+	REGEX_CACHE.count++;
+
+	while (REGEX_CACHE.count > runtime.regex_cache_size && REGEX_CACHE.tail && REGEX_CACHE.tail != entry) {
+		regex_cache_drop(REGEX_CACHE.tail);
+		REGEX_CACHE.evictions++;
+	}
+	switch_mutex_unlock(REGEX_CACHE.mutex);
+
+	return entry;
+}
+
+static void regex_cache_release(regex_cache_entry_t *entry)
+{
+	switch_mutex_lock(REGEX_CACHE.mutex);
+	if (!--entry->refs && entry->dead) {
+		regex_cache_entry_free(entry);
+	}
+	switch_mutex_unlock(REGEX_CACHE.mutex);
+}
+
+/* callers own and free what switch_regex_perform hands back, so they get a copy of the cached pattern */
+static switch_regex_t *regex_cache_copy(regex_cache_entry_t *entry)
+{
+	void *re;
+
+	if (!entry->size || !(re = pcre_malloc(entry->size))) {
+		return NULL;
+	}
+
+	memcpy(re, entry->re, entry->size);
+
+	return (switch_regex_t *) re;
+}
+
+void switch_regex_init(switch_memory_pool_t *pool)
+{
+	switch_mutex_init(&REGEX_CACHE.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init_case(&REGEX_CACHE.hash, pool, SWITCH_TRUE);
+}
+
+void switch_regex_shutdown(void)
+{
+	if (!REGEX_CACHE.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(REGEX_CACHE.mutex);
+	while (REGEX_CACHE.head) {
+		regex_cache_drop(REGEX_CACHE.head);
+	}
+	switch_core_hash_destroy(&REGEX_CACHE.hash);
+	switch_mutex_unlock(REGEX_CACHE.mutex);
+	REGEX_CACHE.mutex = NULL;
+}
+
+SWITCH_DECLARE(void) switch_regex_cache_stats(switch_stream_handle_t *stream)
+{
+	uint64_t total;
+
+	if (!REGEX_CACHE.mutex) {
+		stream->write_function(stream, "-ERR regex cache not running\n");
+		return;
+	}
+
+	switch_mutex_lock(REGEX_CACHE.mutex);
+	total = REGEX_CACHE.hits + REGEX_CACHE.misses;
+	stream->write_function(stream, "size: %u/%u\nhits: %" SWITCH_UINT64_T_FMT "\nmisses: %" SWITCH_UINT64_T_FMT
+						   "\nevictions: %" SWITCH_UINT64_T_FMT "\nhit-rate: %u%%\n",
+						   REGEX_CACHE.count, runtime.regex_cache_size, REGEX_CACHE.hits, REGEX_CACHE.misses, REGEX_CACHE.evictions,
+						   total ? (uint32_t) (REGEX_CACHE.hits * 100 / total) : 0);
+	switch_mutex_unlock(REGEX_CACHE.mutex);
+}
+
+SWITCH_DECLARE(int) switch_regex_perform(const char *field, const char *expression, switch_regex_t **new_re, int *ovector, uint32_t olen)
+{
+	switch_regex_t *re = NULL;
+	regex_cache_entry_t *entry;
+	int match_count = 0;
+
+	if (!(field && expression)) {
+		return 0;
+	}
+
+	if ((entry = regex_cache_get(expression, SWITCH_FALSE))) {
+		match_count = pcre_exec(entry->re, entry->extra, field, (int) strlen(field), 0, 0, ovector, olen);
+
+		if (match_count > 0 && !(re = regex_cache_copy(entry))) {
+			match_count = 0;
+		}
+		regex_cache_release(entry);
+
+		*new_re = re;
+
+		return match_count > 0 ? match_count : 0;
+	}
+
+	if (!(re = switch_regex_compile_expression(expression))) {
+		return 0;
+	}
+
+	if (!(match_count = switch_regex_exec(re, field, ovector, olen))) {
 		switch_regex_safe_free(re);
-		match_count = 0;
 	}
 
-	*new_re = (switch_regex_t *) re;
+	*new_re = re;
 
-  end:
-	switch_safe_free(tmp);
 	return match_count;
 }
 
@@ -189,44 +452,39 @@ SWITCH_DECLARE(void) switch_capture_regex(switch_regex_t *re, int match_count, c
 
 SWITCH_DECLARE(switch_status_t) switch_regex_match_partial(const char *target, const char *expression, int *partial)
 {
-	const char *error = NULL;	/* Used to hold any errors                                           */
-	int error_offset = 0;		/* Holds the offset of an error                                      */
+	regex_cache_entry_t *entry;	/* Cached compiled regex, if the cache is on                         */
 	pcre *pcre_prepared = NULL;	/* Holds the compiled regex                                          */
+	pcre_extra *pcre_studied = NULL;	/* Study data from the cache, not used for partial matches           */
 	int match_count = 0;		/* Number of times the regex was matched                             */
 	int offset_vectors[255];	/* not used, but has to exist or pcre won't even try to find a match */
 	int pcre_flags = 0;
 
-	/* Compile the expression */
-	pcre_prepared = pcre_compile(expression, 0, &error, &error_offset, NULL);
-
-	/* See if there was an error in the expression */
-	if (error != NULL) {
-		/* Clean up after ourselves */
-		if (pcre_prepared) {
-			pcre_free(pcre_prepared);
-			pcre_prepared = NULL;
-		}
-		/* Note our error */
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
-						  "Regular Expression Error expression[%s] error[%s] location[%d]\n", expression, error, error_offset);
-
+	/* Compile the expression, or take it from the cache */
+	if ((entry = regex_cache_get(expression, SWITCH_TRUE))) {
+		pcre_prepared = entry->re;
+		pcre_studied = entry->extra;
+	} else if (!(pcre_prepared = regex_compile_raw(expression))) {
 		/* We definitely didn't match anything */
 		return SWITCH_STATUS_FALSE;
 	}
 
 	if (*partial) {
 		pcre_flags = PCRE_PARTIAL;
+		pcre_studied = NULL;
 	}
 
 	/* So far so good, run the regex */
 	match_count =
-		pcre_exec(pcre_prepared, NULL, target, (int) strlen(target), 0, pcre_flags, offset_vectors, sizeof(offset_vectors) / sizeof(offset_vectors[0]));
+		pcre_exec(pcre_prepared, pcre_studied, target, (int) strlen(target), 0, pcre_flags, offset_vectors,
+				  sizeof(offset_vectors) / sizeof(offset_vectors[0]));
 
 	/* Clean up */
-	if (pcre_prepared) {
+	if (entry) {
+		regex_cache_release(entry);
+	} else {
 		pcre_free(pcre_prepared);
-		pcre_prepared = NULL;
 	}
+	pcre_prepared = NULL;
 
 	/* switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "number of matches: %d\n", match_count); */
 
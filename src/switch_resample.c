@@ -36,6 +36,8 @@
 #include <switch_private.h>
 #endif
 #include <speex/speex_resampler.h>
+#include <math.h>
+#include "private/switch_core_pvt.h"
 
 #define NORMFACT (float)0x8000
 #define MAXSAMPLE (float)0x7FFF
@@ -52,29 +54,329 @@
 
 #define resample_buffer(a, b, c) a > b ? ((a / 1000) / 2) * c : ((b / 1000) / 2) * c
 
+/* taps per output phase of the fixed ratio kernels, about speex quality 3 for the price of quality 0 */
+#define FIXED_TAPS 16
+#define FIXED_MAX_RATIO 6
+#define FIXED_SHIFT 14
+/* speex states kept for reuse, each is a few KB */
+#define RESAMPLE_POOL_MAX 128
+
+/* a windowed sinc lowpass split into polyphase branches, shared read only once built */
+typedef struct {
+	int ratio;
+	int up;
+	int len;
+	int32_t *coefs;
+} fixed_kernel_t;
+
+typedef struct {
+	fixed_kernel_t *kernel;
+	int16_t *hist;
+	uint32_t hist_size;
+	uint32_t phase;
+} fixed_resampler_t;
+
+typedef struct resample_idle {
+	void *state;
+	uint32_t channels;
+	uint32_t from_rate;
+	uint32_t to_rate;
+	int quality;
+	struct resample_idle *next;
+} resample_idle_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	resample_idle_t *idle;
+	uint32_t idle_count;
+	fixed_kernel_t *up[FIXED_MAX_RATIO + 1];
+	fixed_kernel_t *down[FIXED_MAX_RATIO + 1];
+} RESAMPLE;
+
+static double fixed_bessel_i0(double x)
+{
+	double sum = 1.0, term = 1.0;
+	int k;
+
+	for (k = 1; k < 32; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+/* must hold RESAMPLE.mutex */
+static fixed_kernel_t *fixed_kernel_get(int ratio, int up)
+{
+	fixed_kernel_t **slot = up ? &RESAMPLE.up[ratio] : &RESAMPLE.down[ratio];
+	fixed_kernel_t *kernel;
+	double *h, cutoff, beta = 7.0, center, sum = 0;
+	int n, i, p, j;
+
+	if (*slot) {
+		return *slot;
+	}
+
+	n = ratio * FIXED_TAPS;
+	cutoff = 0.45 / ratio;
+	center = (n - 1) / 2.0;
+	switch_zmalloc(h, n * sizeof(*h));
+
+	for (i = 0; i < n; i++) {
+		double t = i - center, r = 2.0 * t / (n - 1);
+		double sinc = t == 0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+		h[i] = sinc * fixed_bessel_i0(beta * sqrt(1.0 - r * r)) / fixed_bessel_i0(beta);
+		sum += h[i];
+	}
+
+	switch_zmalloc(kernel, sizeof(*kernel));
+	kernel->ratio = ratio;
+	kernel->up = up;
+	kernel->len = up ? FIXED_TAPS : n;
+	switch_zmalloc(kernel->coefs, n * sizeof(int32_t));
+
+	/*
+	  coefficients are stored reversed so every output is a straight dot product over contiguous history,
+	  an int32 accumulator cannot overflow since the taps of any one branch sum to about unity gain
+	*/
+	if (up) {
+		for (p = 0; p < ratio; p++) {
+			for (j = 0; j < FIXED_TAPS; j++) {
+				kernel->coefs[p * FIXED_TAPS + j] = (int32_t) lrint(h[p + (FIXED_TAPS - 1 - j) * ratio] * ratio / sum * (1 << FIXED_SHIFT));
+			}
+		}
+	} else {
+		for (j = 0; j < n; j++) {
+			kernel->coefs[j] = (int32_t) lrint(h[n - 1 - j] / sum * (1 << FIXED_SHIFT));
+		}
+	}
+
+	free(h);
+	*slot = kernel;
+
+	return kernel;
+}
+
+static inline int16_t fixed_dot(const int32_t *coefs, const int16_t *x, int len)
+{
+	int32_t acc = 1 << (FIXED_SHIFT - 1);
+	int i;
+
+	/* plain loop on purpose, gcc and clang turn it into packed multiply adds at -O2 -ftree-vectorize and up */
+	for (i = 0; i < len; i++) {
+		acc += coefs[i] * x[i];
+	}
+
+	acc >>= FIXED_SHIFT;
+
+	if (acc > 32767) {
+		acc = 32767;
+	} else if (acc < -32768) {
+		acc = -32768;
+	}
+
+	return (int16_t) acc;
+}
+
+static uint32_t fixed_process(fixed_resampler_t *fr, int16_t *src, uint32_t srclen, int16_t *dst, uint32_t dstlen)
+{
+	fixed_kernel_t *k = fr->kernel;
+	uint32_t keep = k->len - 1, i, out = 0;
+	int16_t *x;
+
+	if (keep + srclen > fr->hist_size) {
+		int16_t *hist = realloc(fr->hist, (keep + srclen) * sizeof(int16_t));
+
+		if (!hist) {
+			return 0;
+		}
+
+		fr->hist = hist;
+		fr->hist_size = keep + srclen;
+	}
+
+	x = fr->hist;
+	memcpy(x + keep, src, srclen * sizeof(int16_t));
+
+	if (k->up) {
+		int p;
+
+		for (i = 0; i < srclen && out + k->ratio <= dstlen; i++) {
+			for (p = 0; p < k->ratio; p++) {
+				dst[out++] = fixed_dot(k->coefs + p * FIXED_TAPS, x + i, FIXED_TAPS);
+			}
+		}
+	} else {
+		/* the phase carries across calls so odd sized frames still decimate evenly */
+		for (i = fr->phase; i < srclen && out < dstlen; i += k->ratio) {
+			dst[out++] = fixed_dot(k->coefs, x + i, k->len);
+		}
+		fr->phase = i > srclen ? i - srclen : 0;
+	}
+
+	memmove(x, x + srclen, keep * sizeof(int16_t));
+
+	return out;
+}
+
+static fixed_resampler_t *fixed_create(uint32_t from_rate, uint32_t to_rate, uint32_t channels)
+{
+	fixed_resampler_t *fr;
+	uint32_t ratio;
+	int up = to_rate > from_rate;
+
+	if (!RESAMPLE.mutex || channels > 1 || from_rate == to_rate) {
+		return NULL;
+	}
+
+	if ((from_rate != 8000 && from_rate != 16000 && from_rate != 32000 && from_rate != 48000) ||
+		(to_rate != 8000 && to_rate != 16000 && to_rate != 32000 && to_rate != 48000)) {
+		return NULL;
+	}
+
+	if ((up && to_rate % from_rate) || (!up && from_rate % to_rate)) {
+		return NULL;
+	}
+
+	ratio = up ? to_rate / from_rate : from_rate / to_rate;
+
+	switch_zmalloc(fr, sizeof(*fr));
+	switch_mutex_lock(RESAMPLE.mutex);
+	fr->kernel = fixed_kernel_get(ratio, up);
+	switch_mutex_unlock(RESAMPLE.mutex);
+
+	fr->hist_size = fr->kernel->len - 1 + 960;
+	switch_zmalloc(fr->hist, fr->hist_size * sizeof(int16_t));
+
+	return fr;
+}
+
+static void *resample_state_get(uint32_t channels, uint32_t from_rate, uint32_t to_rate, int quality)
+{
+	resample_idle_t *node, *last = NULL;
+	void *state = NULL;
+	int err = 0;
+
+	if (RESAMPLE.mutex) {
+		switch_mutex_lock(RESAMPLE.mutex);
+		for (node = RESAMPLE.idle; node; node = node->next) {
+			if (node->channels == channels && node->from_rate == from_rate && node->to_rate == to_rate && node->quality == quality) {
+				if (last) {
+					last->next = node->next;
+				} else {
+					RESAMPLE.idle = node->next;
+				}
+				RESAMPLE.idle_count--;
+				state = node->state;
+				free(node);
+				break;
+			}
+			last = node;
+		}
+		switch_mutex_unlock(RESAMPLE.mutex);
+	}
+
+	if (!state) {
+		state = speex_resampler_init(channels, from_rate, to_rate, quality, &err);
+	}
+
+	return state;
+}
+
+static void resample_state_put(switch_audio_resampler_t *resampler)
+{
+	resample_idle_t *node = NULL;
+
+	if (RESAMPLE.mutex && RESAMPLE.idle_count < RESAMPLE_POOL_MAX && (node = malloc(sizeof(*node)))) {
+		speex_resampler_reset_mem(resampler->resampler);
+		node->state = resampler->resampler;
+		node->channels = resampler->channels;
+		node->from_rate = resampler->from_rate;
+		node->to_rate = resampler->to_rate;
+		node->quality = resampler->quality;
+
+		switch_mutex_lock(RESAMPLE.mutex);
+		if (RESAMPLE.idle_count < RESAMPLE_POOL_MAX) {
+			node->next = RESAMPLE.idle;
+			RESAMPLE.idle = node;
+			RESAMPLE.idle_count++;
+		} else {
+			free(node);
+			node = NULL;
+		}
+		switch_mutex_unlock(RESAMPLE.mutex);
+	}
+
+	if (!node) {
+		speex_resampler_destroy(resampler->resampler);
+	}
+}
+
+void switch_resample_init(switch_memory_pool_t *pool)
+{
+	switch_mutex_init(&RESAMPLE.mutex, SWITCH_MUTEX_NESTED, pool);
+}
+
+void switch_resample_shutdown(void)
+{
+	resample_idle_t *node;
+	int i;
+
+	if (!RESAMPLE.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(RESAMPLE.mutex);
+	while ((node = RESAMPLE.idle)) {
+		RESAMPLE.idle = node->next;
+		speex_resampler_destroy(node->state);
+		free(node);
+	}
+	RESAMPLE.idle_count = 0;
+
+	for (i = 0; i <= FIXED_MAX_RATIO; i++) {
+		if (RESAMPLE.up[i]) {
+			free(RESAMPLE.up[i]->coefs);
+			free(RESAMPLE.up[i]);
+			RESAMPLE.up[i] = NULL;
+		}
+		if (RESAMPLE.down[i]) {
+			free(RESAMPLE.down[i]->coefs);
+			free(RESAMPLE.down[i]);
+			RESAMPLE.down[i] = NULL;
+		}
+	}
+	switch_mutex_unlock(RESAMPLE.mutex);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resampler_t **new_resampler,
 															   uint32_t from_rate, uint32_t to_rate,
 															   uint32_t to_size,
 															   int quality, uint32_t channels, const char *file, const char *func, int line)
 {
-	int err = 0;
 	switch_audio_resampler_t *resampler;
 	double lto_rate, lfrom_rate;
 
 	switch_zmalloc(resampler, sizeof(*resampler));
 
-	resampler->resampler = speex_resampler_init(channels ? channels : 1, from_rate, to_rate, quality, &err);
+	resampler->channels = channels ? channels : 1;
+	resampler->quality = quality;
+
+	if (!(resampler->fixed = fixed_create(from_rate, to_rate, resampler->channels))) {
+		resampler->resampler = resample_state_get(resampler->channels, from_rate, to_rate, quality);
 
-	if (!resampler->resampler) {
-		free(resampler);
-		return SWITCH_STATUS_GENERR;
+		if (!resampler->resampler) {
+			free(resampler);
+			return SWITCH_STATUS_GENERR;
+		}
 	}
 
 	*new_resampler = resampler;
-	lto_rate = (double) resampler->to_rate;
-	lfrom_rate = (double) resampler->from_rate;
 	resampler->from_rate = from_rate;
 	resampler->to_rate = to_rate;
+	lto_rate = (double) resampler->to_rate;
+	lfrom_rate = (double) resampler->from_rate;
 	resampler->factor = (lto_rate / lfrom_rate);
 	resampler->rfactor = (lfrom_rate / lto_rate);
 	resampler->to_size = resample_buffer(to_rate, from_rate, (uint32_t) to_size);
@@ -86,6 +388,11 @@ SWITCH_DECLARE(switch_status_t) switch_resample_perform_create(switch_audio_resa
 
 SWITCH_DECLARE(uint32_t) switch_resample_process(switch_audio_resampler_t *resampler, int16_t *src, uint32_t srclen)
 {
+	if (resampler->fixed) {
+		resampler->to_len = fixed_process(resampler->fixed, src, srclen, resampler->to, resampler->to_size);
+		return resampler->to_len;
+	}
+
 	resampler->to_len = resampler->to_size;
 	speex_resampler_process_interleaved_int(resampler->resampler, src, &srclen, resampler->to, &resampler->to_len);
 	return resampler->to_len;
@@ -95,8 +402,13 @@ SWITCH_DECLARE(void) switch_resample_destroy(switch_audio_resampler_t **resample
 {
 
 	if (resampler && *resampler) {
+		if ((*resampler)->fixed) {
+			fixed_resampler_t *fr = (*resampler)->fixed;
+			free(fr->hist);
+			free(fr);
+		}
 		if ((*resampler)->resampler) {
-			speex_resampler_destroy((*resampler)->resampler);
+			resample_state_put(*resampler);
 		}
 		free((*resampler)->to);
 		free(*resampler);
@@ -104,21 +416,23 @@ SWITCH_DECLARE(void) switch_resample_destroy(switch_audio_resampler_t **resample
 	}
 }
 
-SWITCH_DECLARE(switch_size_t) switch_float_to_short(float *f, short *s, switch_size_t len)
+SWITCH_TARGET_CLONES SWITCH_DECLARE(switch_size_t) switch_float_to_short(float *f, short *s, switch_size_t len)
 {
 	switch_size_t i;
-	float ft;
+
+	/* branch free so it vectorizes, out of range samples still fold to half scale like they always did */
 	for (i = 0; i < len; i++) {
-		ft = f[i] * NORMFACT;
-		if (ft >= 0) {
-			s[i] = (short) (ft + 0.5);
-		} else {
-			s[i] = (short) (ft - 0.5);
+		float ft = f[i] * NORMFACT;
+		float r = ft >= 0 ? ft + 0.5f : ft - 0.5f;
+
+		r = r > 40000.0f ? 40000.0f : r;
+		r = r < -40000.0f ? -40000.0f : r;
+		{
+			int32_t l = (int32_t) r;
+			l = l > (int32_t) MAXSAMPLE ? (int32_t) MAXSAMPLE / 2 : l;
+			l = l < -(int32_t) MAXSAMPLE ? -(int32_t) MAXSAMPLE / 2 : l;
+			s[i] = (short) l;
 		}
-		if ((float) s[i] > MAXSAMPLE)
-			s[i] = (short) MAXSAMPLE / 2;
-		if (s[i] < (short) -MAXSAMPLE)
-			s[i] = (short) -MAXSAMPLE / 2;
 	}
 	return len;
 }
@@ -160,13 +474,13 @@ SWITCH_DECLARE(int) switch_float_to_char(float *f, char *c, int len)
 	return len * 2;
 }
 
-SWITCH_DECLARE(int) switch_short_to_float(short *s, float *f, int len)
+SWITCH_TARGET_CLONES SWITCH_DECLARE(int) switch_short_to_float(short *s, float *f, int len)
 {
 	int i;
+	const float scale = 1.0f / NORMFACT;
 
 	for (i = 0; i < len; i++) {
-		f[i] = (float) (s[i]) / NORMFACT;
-		/* f[i] = (float) s[i]; */
+		f[i] = (float) (s[i]) * scale;
 	}
 	return len;
 }
@@ -232,10 +546,451 @@ SWITCH_DECLARE(void) switch_generate_sln_silence(int16_t *data, uint32_t samples
 
 #endif
 
-SWITCH_DECLARE(uint32_t) switch_merge_sln(int16_t *data, uint32_t samples, int16_t *other_data, uint32_t other_samples)
+/* Mixing kernels, the scalar versions are the reference and the vector versions must give the same saturated result. */
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SLN_KERNEL_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SLN_KERNEL_AVX2
+#include <immintrin.h>
+#define SLN_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define SLN_KERNEL_NEON
+#include <arm_neon.h>
+#endif
+
+typedef struct {
+	const char *name;
+	void (*accumulate) (int32_t *acc, const int16_t *in, uint32_t samples);
+	void (*mix_out) (int16_t *out, const int32_t *acc, const int16_t *self, uint32_t self_samples, uint32_t samples);
+	void (*merge) (int16_t *data, const int16_t *other, uint32_t samples);
+	void (*volume) (int16_t *data, uint32_t samples, double rate);
+	uint32_t (*energy) (const int16_t *in, uint32_t samples);
+} sln_kernel_t;
+
+static void sln_accumulate_scalar(int32_t *acc, const int16_t *in, uint32_t samples)
+{
+	uint32_t x;
+
+	for (x = 0; x < samples; x++) {
+		acc[x] += (int32_t) in[x];
+	}
+}
+
+static void sln_mix_out_scalar(int16_t *out, const int32_t *acc, const int16_t *self, uint32_t self_samples, uint32_t samples)
+{
+	uint32_t x;
+	int32_t z;
+
+	for (x = 0; x < samples; x++) {
+		z = acc[x];
+		if (x < self_samples) {
+			z -= (int32_t) self[x];
+		}
+		switch_normalize_to_16bit(z);
+		out[x] = (int16_t) z;
+	}
+}
+
+static void sln_merge_scalar(int16_t *data, const int16_t *other, uint32_t samples)
+{
+	uint32_t x;
+	int32_t z;
+
+	for (x = 0; x < samples; x++) {
+		z = data[x] + other[x];
+		switch_normalize_to_16bit(z);
+		data[x] = (int16_t) z;
+	}
+}
+
+static void sln_volume_scalar(int16_t *data, uint32_t samples, double rate)
+{
+	uint32_t x;
+	int32_t tmp;
+
+	for (x = 0; x < samples; x++) {
+		tmp = (int32_t) (data[x] * rate);
+		switch_normalize_to_16bit(tmp);
+		data[x] = (int16_t) tmp;
+	}
+}
+
+static uint32_t sln_energy_scalar(const int16_t *in, uint32_t samples)
+{
+	uint32_t x, energy = 0;
+
+	for (x = 0; x < samples; x++) {
+		energy += (uint32_t) abs(in[x]);
+	}
+
+	return energy;
+}
+
+static const sln_kernel_t sln_kernel_scalar = { "scalar", sln_accumulate_scalar, sln_mix_out_scalar, sln_merge_scalar, sln_volume_scalar,
+												sln_energy_scalar };
+
+#ifdef SLN_KERNEL_SSE2
+static void sln_accumulate_sse2(int32_t *acc, const int16_t *in, uint32_t samples)
+{
+	uint32_t x = 0;
+
+	for (; x + 8 <= samples; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (in + x));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_si128((__m128i *) (acc + x), _mm_add_epi32(_mm_loadu_si128((const __m128i *) (acc + x)), lo));
+		_mm_storeu_si128((__m128i *) (acc + x + 4), _mm_add_epi32(_mm_loadu_si128((const __m128i *) (acc + x + 4)), hi));
+	}
+
+	sln_accumulate_scalar(acc + x, in + x, samples - x);
+}
+
+static void sln_mix_out_sse2(int16_t *out, const int32_t *acc, const int16_t *self, uint32_t self_samples, uint32_t samples)
 {
+	uint32_t x = 0;
+
+	if (self_samples > samples) {
+		self_samples = samples;
+	}
+
+	for (; x + 8 <= self_samples; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (self + x));
+		__m128i lo = _mm_sub_epi32(_mm_loadu_si128((const __m128i *) (acc + x)), _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+		__m128i hi = _mm_sub_epi32(_mm_loadu_si128((const __m128i *) (acc + x + 4)), _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+		_mm_storeu_si128((__m128i *) (out + x), _mm_packs_epi32(lo, hi));
+	}
+
+	for (; x < self_samples; x++) {
+		int32_t z = acc[x] - (int32_t) self[x];
+		switch_normalize_to_16bit(z);
+		out[x] = (int16_t) z;
+	}
+
+	for (; x + 8 <= samples; x += 8) {
+		__m128i lo = _mm_loadu_si128((const __m128i *) (acc + x));
+		__m128i hi = _mm_loadu_si128((const __m128i *) (acc + x + 4));
+		_mm_storeu_si128((__m128i *) (out + x), _mm_packs_epi32(lo, hi));
+	}
+
+	sln_mix_out_scalar(out + x, acc + x, NULL, 0, samples - x);
+}
+
+static void sln_merge_sse2(int16_t *data, const int16_t *other, uint32_t samples)
+{
+	uint32_t x = 0;
+
+	for (; x + 8 <= samples; x += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *) (data + x));
+		__m128i b = _mm_loadu_si128((const __m128i *) (other + x));
+		_mm_storeu_si128((__m128i *) (data + x), _mm_adds_epi16(a, b));
+	}
+
+	sln_merge_scalar(data + x, other + x, samples - x);
+}
+
+static void sln_volume_sse2(int16_t *data, uint32_t samples, double rate)
+{
+	uint32_t x = 0;
+	__m128 r = _mm_set1_ps((float) rate);
+
+	for (; x + 8 <= samples; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (data + x));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(lo), r));
+		hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(hi), r));
+		_mm_storeu_si128((__m128i *) (data + x), _mm_packs_epi32(lo, hi));
+	}
+
+	sln_volume_scalar(data + x, samples - x, rate);
+}
+
+static uint32_t sln_energy_sse2(const int16_t *in, uint32_t samples)
+{
+	uint32_t x = 0, lanes[4];
+	__m128i sum = _mm_setzero_si128();
+
+	/* widen before taking the magnitude, -32768 has no 16 bit absolute value */
+	for (; x + 8 <= samples; x += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (in + x));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		__m128i slo = _mm_srai_epi32(lo, 31);
+		__m128i shi = _mm_srai_epi32(hi, 31);
+		sum = _mm_add_epi32(sum, _mm_sub_epi32(_mm_xor_si128(lo, slo), slo));
+		sum = _mm_add_epi32(sum, _mm_sub_epi32(_mm_xor_si128(hi, shi), shi));
+	}
+
+	_mm_storeu_si128((__m128i *) lanes, sum);
+
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sln_energy_scalar(in + x, samples - x);
+}
+
+static const sln_kernel_t sln_kernel_sse2 = { "sse2", sln_accumulate_sse2, sln_mix_out_sse2, sln_merge_sse2, sln_volume_sse2, sln_energy_sse2 };
+#endif
+
+#ifdef SLN_KERNEL_AVX2
+SLN_AVX2_TARGET static void sln_accumulate_avx2(int32_t *acc, const int16_t *in, uint32_t samples)
+{
+	uint32_t x = 0;
+
+	for (; x + 8 <= samples; x += 8) {
+		__m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (in + x)));
+		_mm256_storeu_si256((__m256i *) (acc + x), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (acc + x)), v));
+	}
+
+	sln_accumulate_scalar(acc + x, in + x, samples - x);
+}
+
+SLN_AVX2_TARGET static void sln_mix_out_avx2(int16_t *out, const int32_t *acc, const int16_t *self, uint32_t self_samples, uint32_t samples)
+{
+	uint32_t x = 0;
+
+	if (self_samples > samples) {
+		self_samples = samples;
+	}
+
+	for (; x + 16 <= self_samples; x += 16) {
+		__m256i lo = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) (acc + x)),
+									  _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (self + x))));
+		__m256i hi = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) (acc + x + 8)),
+									  _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (self + x + 8))));
+		/* packs works per 128 bit lane so put the quadwords back in order */
+		_mm256_storeu_si256((__m256i *) (out + x), _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8));
+	}
+
+	for (; x < self_samples; x++) {
+		int32_t z = acc[x] - (int32_t) self[x];
+		switch_normalize_to_16bit(z);
+		out[x] = (int16_t) z;
+	}
+
+	for (; x + 16 <= samples; x += 16) {
+		__m256i lo = _mm256_loadu_si256((const __m256i *) (acc + x));
+		__m256i hi = _mm256_loadu_si256((const __m256i *) (acc + x + 8));
+		_mm256_storeu_si256((__m256i *) (out + x), _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8));
+	}
+
+	sln_mix_out_scalar(out + x, acc + x, NULL, 0, samples - x);
+}
+
+SLN_AVX2_TARGET static void sln_merge_avx2(int16_t *data, const int16_t *other, uint32_t samples)
+{
+	uint32_t x = 0;
+
+	for (; x + 16 <= samples; x += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *) (data + x));
+		__m256i b = _mm256_loadu_si256((const __m256i *) (other + x));
+		_mm256_storeu_si256((__m256i *) (data + x), _mm256_adds_epi16(a, b));
+	}
+
+	sln_merge_scalar(data + x, other + x, samples - x);
+}
+
+SLN_AVX2_TARGET static void sln_volume_avx2(int16_t *data, uint32_t samples, double rate)
+{
+	uint32_t x = 0;
+	__m256 r = _mm256_set1_ps((float) rate);
+
+	for (; x + 16 <= samples; x += 16) {
+		__m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (data + x)));
+		__m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (data + x + 8)));
+		lo = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(lo), r));
+		hi = _mm256_cvttps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(hi), r));
+		_mm256_storeu_si256((__m256i *) (data + x), _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8));
+	}
+
+	sln_volume_scalar(data + x, samples - x, rate);
+}
+
+SLN_AVX2_TARGET static uint32_t sln_energy_avx2(const int16_t *in, uint32_t samples)
+{
+	uint32_t x = 0, lanes[8];
+	__m256i sum = _mm256_setzero_si256();
+
+	for (; x + 16 <= samples; x += 16) {
+		sum = _mm256_add_epi32(sum, _mm256_abs_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (in + x)))));
+		sum = _mm256_add_epi32(sum, _mm256_abs_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (in + x + 8)))));
+	}
+
+	_mm256_storeu_si256((__m256i *) lanes, sum);
+
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7] + sln_energy_scalar(in + x, samples - x);
+}
+
+static const sln_kernel_t sln_kernel_avx2 = { "avx2", sln_accumulate_avx2, sln_mix_out_avx2, sln_merge_avx2, sln_volume_avx2, sln_energy_avx2 };
+#endif
+
+#ifdef SLN_KERNEL_NEON
+static void sln_accumulate_neon(int32_t *acc, const int16_t *in, uint32_t samples)
+{
+	uint32_t x = 0;
+
+	for (; x + 8 <= samples; x += 8) {
+		int16x8_t v = vld1q_s16(in + x);
+		vst1q_s32(acc + x, vaddq_s32(vld1q_s32(acc + x), vmovl_s16(vget_low_s16(v))));
+		vst1q_s32(acc + x + 4, vaddq_s32(vld1q_s32(acc + x + 4), vmovl_s16(vget_high_s16(v))));
+	}
+
+	sln_accumulate_scalar(acc + x, in + x, samples - x);
+}
+
+static void sln_mix_out_neon(int16_t *out, const int32_t *acc, const int16_t *self, uint32_t self_samples, uint32_t samples)
+{
+	uint32_t x = 0;
+
+	if (self_samples > samples) {
+		self_samples = samples;
+	}
+
+	for (; x + 8 <= self_samples; x += 8) {
+		int16x8_t v = vld1q_s16(self + x);
+		int32x4_t lo = vsubq_s32(vld1q_s32(acc + x), vmovl_s16(vget_low_s16(v)));
+		int32x4_t hi = vsubq_s32(vld1q_s32(acc + x + 4), vmovl_s16(vget_high_s16(v)));
+		vst1q_s16(out + x, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+	}
+
+	for (; x < self_samples; x++) {
+		int32_t z = acc[x] - (int32_t) self[x];
+		switch_normalize_to_16bit(z);
+		out[x] = (int16_t) z;
+	}
+
+	for (; x + 8 <= samples; x += 8) {
+		vst1q_s16(out + x, vcombine_s16(vqmovn_s32(vld1q_s32(acc + x)), vqmovn_s32(vld1q_s32(acc + x + 4))));
+	}
+
+	sln_mix_out_scalar(out + x, acc + x, NULL, 0, samples - x);
+}
+
+static void sln_merge_neon(int16_t *data, const int16_t *other, uint32_t samples)
+{
+	uint32_t x = 0;
+
+	for (; x + 8 <= samples; x += 8) {
+		vst1q_s16(data + x, vqaddq_s16(vld1q_s16(data + x), vld1q_s16(other + x)));
+	}
+
+	sln_merge_scalar(data + x, other + x, samples - x);
+}
+
+static void sln_volume_neon(int16_t *data, uint32_t samples, double rate)
+{
+	uint32_t x = 0;
+	float r = (float) rate;
+
+	for (; x + 8 <= samples; x += 8) {
+		int16x8_t v = vld1q_s16(data + x);
+		int32x4_t lo = vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), r));
+		int32x4_t hi = vcvtq_s32_f32(vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), r));
+		vst1q_s16(data + x, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi)));
+	}
+
+	sln_volume_scalar(data + x, samples - x, rate);
+}
+
+static uint32_t sln_energy_neon(const int16_t *in, uint32_t samples)
+{
+	uint32_t x = 0;
+	uint32x4_t sum = vdupq_n_u32(0);
+
+	for (; x + 8 <= samples; x += 8) {
+		int16x8_t v = vld1q_s16(in + x);
+		sum = vaddq_u32(sum, vreinterpretq_u32_s32(vabsq_s32(vmovl_s16(vget_low_s16(v)))));
+		sum = vaddq_u32(sum, vreinterpretq_u32_s32(vabsq_s32(vmovl_s16(vget_high_s16(v)))));
+	}
+
+	return vgetq_lane_u32(sum, 0) + vgetq_lane_u32(sum, 1) + vgetq_lane_u32(sum, 2) + vgetq_lane_u32(sum, 3) + sln_energy_scalar(in + x, samples - x);
+}
+
+static const sln_kernel_t sln_kernel_neon = { "neon", sln_accumulate_neon, sln_mix_out_neon, sln_merge_neon, sln_volume_neon, sln_energy_neon };
+#endif
+
+static const sln_kernel_t *sln_kernel = &sln_kernel_scalar;
+
+static const sln_kernel_t *sln_kernel_find(const char *name)
+{
+	if (!strcasecmp(name, "scalar")) {
+		return &sln_kernel_scalar;
+	}
+#ifdef SLN_KERNEL_SSE2
+	if (!strcasecmp(name, "sse2")) {
+		return &sln_kernel_sse2;
+	}
+#endif
+#ifdef SLN_KERNEL_AVX2
+	if (!strcasecmp(name, "avx2")) {
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") ? &sln_kernel_avx2 : NULL;
+	}
+#endif
+#ifdef SLN_KERNEL_NEON
+	if (!strcasecmp(name, "neon")) {
+		return &sln_kernel_neon;
+	}
+#endif
+	return NULL;
+}
+
+SWITCH_DECLARE(void) switch_sln_kernel_init(void)
+{
+	const char *best[] = { "avx2", "sse2", "neon", NULL };
+	const sln_kernel_t *kernel = NULL;
 	int i;
-	int32_t x, z;
+
+	for (i = 0; best[i] && !kernel; i++) {
+		kernel = sln_kernel_find(best[i]);
+	}
+
+	sln_kernel = kernel ? kernel : &sln_kernel_scalar;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_sln_kernel_set(const char *name)
+{
+	const sln_kernel_t *kernel;
+
+	if (zstr(name) || !(kernel = sln_kernel_find(name))) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	sln_kernel = kernel;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(const char *) switch_sln_kernel_name(void)
+{
+	return sln_kernel->name;
+}
+
+SWITCH_DECLARE(void) switch_sln_accumulate(int32_t *acc, const int16_t *data, uint32_t samples)
+{
+	sln_kernel->accumulate(acc, data, samples);
+}
+
+SWITCH_DECLARE(uint32_t) switch_sln_energy(const int16_t *data, uint32_t samples)
+{
+	return sln_kernel->energy(data, samples);
+}
+
+SWITCH_DECLARE(void) switch_sln_mix_out(int16_t *data, const int32_t *acc, const int16_t *self, uint32_t self_samples, uint32_t samples)
+{
+	if (!self) {
+		self_samples = 0;
+	}
+
+	sln_kernel->mix_out(data, acc, self, self_samples, samples);
+}
+
+SWITCH_DECLARE(uint32_t) switch_merge_sln(int16_t *data, uint32_t samples, int16_t *other_data, uint32_t other_samples)
+{
+	int32_t x;
 
 	if (samples > other_samples) {
 		x = other_samples;
@@ -243,11 +998,7 @@ SWITCH_DECLARE(uint32_t) switch_merge_sln(int16_t *data, uint32_t samples, int16
 		x = samples;
 	}
 
-	for (i = 0; i < x; i++) {
-		z = data[i] + other_data[i];
-		switch_normalize_to_16bit(z);
-		data[i] = (int16_t) z;
-	}
+	sln_kernel->merge(data, other_data, x);
 
 	return x;
 }
@@ -318,15 +1069,7 @@ SWITCH_DECLARE(void) switch_change_sln_volume_granular(int16_t *data, uint32_t s
 	newrate = chart[i];
 
 	if (newrate) {
-		int32_t tmp;
-		uint32_t x;
-		int16_t *fp = data;
-
-		for (x = 0; x < samples; x++) {
-			tmp = (int32_t) (fp[x] * newrate);
-			switch_normalize_to_16bit(tmp);
-			fp[x] = (int16_t) tmp;
-		}
+		sln_kernel->volume(data, samples, newrate);
 	}
 }
 
@@ -355,15 +1098,7 @@ SWITCH_DECLARE(void) switch_change_sln_volume(int16_t *data, uint32_t samples, i
 	newrate = chart[i];
 
 	if (newrate) {
-		int32_t tmp;
-		uint32_t x;
-		int16_t *fp = data;
-
-		for (x = 0; x < samples; x++) {
-			tmp = (int32_t) (fp[x] * newrate);
-			switch_normalize_to_16bit(tmp);
-			fp[x] = (int16_t) tmp;
-		}
+		sln_kernel->volume(data, samples, newrate);
 	}
 }
 
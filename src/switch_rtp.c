@@ -35,6 +35,9 @@
 //#define DEBUG_MISSED_SEQ
 
 #include <switch.h>
+#ifndef WIN32
+#include <switch_private.h>
+#endif
 #include <switch_stun.h>
 #include <apr_network_io.h>
 #undef PACKAGE_NAME
@@ -55,6 +58,20 @@
 
 #include "stfu.h"
 
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_RECVMMSG)
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#define RTP_REACTOR
+#endif
+
+#ifdef HAVE_SENDMMSG
+#include <sys/socket.h>
+#define RTP_TX_BATCH
+#endif
+
+#define RTP_TX_BATCH_MAX 32
+#define RTP_TX_SLOT_LEN 1500
+
 #define rtp_header_len 12
 #define RTP_START_PORT 16384
 #define RTP_END_PORT 32768
@@ -169,7 +186,8 @@ struct switch_rtp {
 	rtcp_msg_t rtcp_send_msg;
 
 	switch_sockaddr_t *remote_addr, *rtcp_remote_addr;
-	rtp_msg_t recv_msg;
+	struct rtp_packet_s *recv_packet;
+	rtp_msg_t *recv_msg;
 	rtcp_msg_t rtcp_recv_msg;
 
 	switch_sockaddr_t *remote_stun_addr;
@@ -259,9 +277,39 @@ struct switch_rtp {
 	uint8_t pause_jb;
 	uint16_t last_seq;
 	switch_time_t last_read_time;
+	switch_time_t last_ingress;
+	switch_time_t frame_ingress;
 	switch_size_t last_flush_packet_count;
 	uint32_t interdigit_delay;
 
+	uint8_t use_reactor;
+	struct rtp_reactor_handle_s *reactor_handle;
+	struct rtp_reactor_slot_s *reactor_pending;
+	switch_queue_t *reactor_ready;
+	switch_queue_t *reactor_free;
+
+	struct rtp_reactor_handle_s *rtcp_handle;
+	switch_mutex_t *rtcp_mutex;
+	int rtcp_send_rate;
+	switch_time_t rtcp_next_send;
+	switch_atomic_t rtcp_tx_packets;
+	switch_atomic_t rtcp_tx_octets;
+	switch_atomic_t rtcp_tx_ts;
+	switch_atomic_t rtcp_tx_ms;
+	switch_atomic_t rtcp_rx_seen;
+
+	uint32_t tx_batch_max;
+	uint32_t tx_batch_usec;
+	uint32_t tx_batch_len;
+	switch_time_t tx_batch_started;
+	struct rtp_tx_slot_s *tx_batch;
+
+	switch_mutex_t *relay_mutex;
+	struct switch_rtp *relay_peer;
+	uint32_t relay_ts_delta;
+	uint8_t relay_synced;
+	switch_size_t relay_packets;
+
 #ifdef ENABLE_ZRTP
 	zrtp_session_t *zrtp_session;
 	zrtp_profile_t *zrtp_profile;
@@ -290,6 +338,7 @@ typedef enum {
 } handle_rfc2833_result_t;
 
 static void do_2833(switch_rtp_t *rtp_session, switch_core_session_t *session);
+static switch_status_t read_rtcp_packet(switch_rtp_t *rtp_session, switch_size_t *bytes, switch_frame_flag_t *flags);
 
 static handle_rfc2833_result_t handle_rfc2833(switch_rtp_t *rtp_session, switch_size_t bytes, int *do_cng)
 {
@@ -312,9 +361,9 @@ static handle_rfc2833_result_t handle_rfc2833(switch_rtp_t *rtp_session, switch_
 	   doing it right. Nice guys finish last!
 	*/
 	if (bytes > rtp_header_len && !switch_test_flag(rtp_session, SWITCH_RTP_FLAG_PROXY_MEDIA) &&
-		!switch_test_flag(rtp_session, SWITCH_RTP_FLAG_PASS_RFC2833) && rtp_session->recv_te && rtp_session->recv_msg.header.pt == rtp_session->recv_te) {
+		!switch_test_flag(rtp_session, SWITCH_RTP_FLAG_PASS_RFC2833) && rtp_session->recv_te && rtp_session->recv_msg->header.pt == rtp_session->recv_te) {
 		switch_size_t len = bytes - rtp_header_len;
-		unsigned char *packet = (unsigned char *) rtp_session->recv_msg.body;
+		unsigned char *packet = (unsigned char *) rtp_session->recv_msg->body;
 		int end;
 		uint16_t duration;
 		char key;
@@ -339,8 +388,8 @@ static handle_rfc2833_result_t handle_rfc2833(switch_rtp_t *rtp_session, switch_
 		end = packet[1] & 0x80 ? 1 : 0;
 		duration = (packet[2] << 8) + packet[3];
 		key = switch_rfc2833_to_char(packet[0]);
-		in_digit_seq = ntohs((uint16_t) rtp_session->recv_msg.header.seq);
-		ts = htonl(rtp_session->recv_msg.header.ts);
+		in_digit_seq = ntohs((uint16_t) rtp_session->recv_msg->header.seq);
+		ts = htonl(rtp_session->recv_msg->header.ts);
 
 		if (in_digit_seq < rtp_session->dtmf_data.in_digit_seq) {
 			if (rtp_session->dtmf_data.in_digit_seq - in_digit_seq > 100) {
@@ -359,7 +408,7 @@ static handle_rfc2833_result_t handle_rfc2833(switch_rtp_t *rtp_session, switch_
 
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "read: %c %u %u %u %u %d %d %s\n",
 				   key, in_digit_seq, rtp_session->dtmf_data.in_digit_seq,
-				   ts, duration, rtp_session->recv_msg.header.m, end, end && !rtp_session->dtmf_data.in_digit_ts ? "ignored" : "");
+				   ts, duration, rtp_session->recv_msg->header.m, end, end && !rtp_session->dtmf_data.in_digit_ts ? "ignored" : "");
 #endif
 
 			if (!rtp_session->dtmf_data.in_digit_queued && (rtp_session->rtp_bugs & RTP_BUG_IGNORE_DTMF_DURATION) &&
@@ -445,7 +494,7 @@ static handle_rfc2833_result_t handle_rfc2833(switch_rtp_t *rtp_session, switch_
 		} else {
 #ifdef DEBUG_2833
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "drop: %c %u %u %u %u %d %d\n",
-				   key, in_digit_seq, rtp_session->dtmf_data.in_digit_seq, ts, duration, rtp_session->recv_msg.header.m, end);
+				   key, in_digit_seq, rtp_session->dtmf_data.in_digit_seq, ts, duration, rtp_session->recv_msg->header.m, end);
 #endif
 			switch_cond_next();
 			return RESULT_GOTO_RECVFROM;
@@ -457,13 +506,13 @@ static handle_rfc2833_result_t handle_rfc2833(switch_rtp_t *rtp_session, switch_
 			return RESULT_GOTO_END;
 		}
 
-		if (!rtp_session->dtmf_data.in_interleaved && rtp_session->recv_msg.header.pt != rtp_session->recv_te) {
+		if (!rtp_session->dtmf_data.in_interleaved && rtp_session->recv_msg->header.pt != rtp_session->recv_te) {
 			/* Drat, they are sending audio still as well as DTMF ok fine..... *sigh* */
 			rtp_session->dtmf_data.in_interleaved = 1;
 		}
 			
 		if (rtp_session->dtmf_data.in_interleaved || (rtp_session->rtp_bugs & RTP_BUG_IGNORE_DTMF_DURATION)) {
-			if (rtp_session->recv_msg.header.pt == rtp_session->recv_te) {
+			if (rtp_session->recv_msg->header.pt == rtp_session->recv_te) {
 				return RESULT_GOTO_RECVFROM;
 			}
 		} else {
@@ -841,6 +890,1008 @@ static void zrtp_logger(int level, const char *data, int len, int offset)
 }
 #endif
 
+/*
+ * Receive packet pool: inbound RTP is read into reference counted buffers taken from a
+ * process wide free list.  A buffer moves from the socket (or a reactor slot) into the
+ * jitter buffer and out to the frame returned by switch_rtp_zerocopy_read_frame() by
+ * handing over references instead of copying the payload.  References are only taken
+ * and dropped by the thread reading the session, the free list is shared under a mutex.
+ */
+
+#define RTP_PACKET_POOL_MAX 4096
+
+typedef struct rtp_packet_s {
+	rtp_msg_t msg;
+	uint32_t refs;
+	struct rtp_packet_s *next;
+} rtp_packet_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	rtp_packet_t *free;
+	uint32_t free_count;
+	uint32_t in_use;
+} rtp_packet_globals;
+
+static rtp_packet_t *rtp_packet_get_locked(void)
+{
+	rtp_packet_t *packet;
+
+	if ((packet = rtp_packet_globals.free)) {
+		rtp_packet_globals.free = packet->next;
+		rtp_packet_globals.free_count--;
+	} else {
+		packet = malloc(sizeof(*packet));
+		switch_assert(packet);
+	}
+
+	packet->refs = 1;
+	packet->next = NULL;
+	rtp_packet_globals.in_use++;
+
+	return packet;
+}
+
+static void rtp_packet_put_locked(rtp_packet_t *packet)
+{
+	rtp_packet_globals.in_use--;
+
+	if (rtp_packet_globals.free_count < RTP_PACKET_POOL_MAX) {
+		packet->next = rtp_packet_globals.free;
+		rtp_packet_globals.free = packet;
+		rtp_packet_globals.free_count++;
+	} else {
+		free(packet);
+	}
+}
+
+static rtp_packet_t *rtp_packet_alloc(void)
+{
+	rtp_packet_t *packet;
+
+	switch_mutex_lock(rtp_packet_globals.mutex);
+	packet = rtp_packet_get_locked();
+	switch_mutex_unlock(rtp_packet_globals.mutex);
+
+	return packet;
+}
+
+static void rtp_packet_release(rtp_packet_t *packet)
+{
+	if (!packet || --packet->refs > 0) {
+		return;
+	}
+
+	switch_mutex_lock(rtp_packet_globals.mutex);
+	rtp_packet_put_locked(packet);
+	switch_mutex_unlock(rtp_packet_globals.mutex);
+}
+
+static void rtp_packet_stfu_release(void *ref)
+{
+	rtp_packet_release((rtp_packet_t *) ref);
+}
+
+static void rtp_set_recv_packet(switch_rtp_t *rtp_session, rtp_packet_t *packet)
+{
+	rtp_packet_release(rtp_session->recv_packet);
+	rtp_session->recv_packet = packet;
+	rtp_session->recv_msg = &packet->msg;
+}
+
+/* make sure the receive buffer is ours alone before writing into it */
+static void rtp_recv_unshare(switch_rtp_t *rtp_session)
+{
+	rtp_packet_t *packet;
+
+	if (rtp_session->recv_packet->refs == 1) {
+		return;
+	}
+
+	packet = rtp_packet_alloc();
+	packet->msg.header = rtp_session->recv_msg->header;
+	rtp_set_recv_packet(rtp_session, packet);
+}
+
+/* 
+ * RTP reactor: a small pool of threads that own the receive side of many RTP sockets.
+ * Each thread sleeps in epoll_wait() and drains every readable socket with recvmmsg()
+ * into a per-session queue of preallocated packet slots, so the session thread reads
+ * media from memory instead of doing one recvfrom() per packet.
+ */
+
+#define RTP_REACTOR_MAX_THREADS 64
+#define RTP_REACTOR_SLOTS 64
+#define RTP_REACTOR_BATCH 32
+#define RTP_REACTOR_EVENTS 256
+
+typedef struct rtp_reactor_slot_s {
+	rtp_packet_t *packet;
+	switch_size_t bytes;
+#ifdef RTP_REACTOR
+	struct sockaddr_storage from;
+#endif
+	switch_size_t fromlen;
+} rtp_reactor_slot_t;
+
+typedef struct rtp_reactor_s rtp_reactor_t;
+
+typedef struct rtp_reactor_handle_s {
+	switch_rtp_t *rtp_session;
+	rtp_reactor_t *reactor;
+	int fd;
+	int dead;
+	int rtcp;
+	struct rtp_reactor_handle_s *next;
+	struct rtp_reactor_handle_s *rtcp_next;
+} rtp_reactor_handle_t;
+
+struct rtp_reactor_s {
+	uint32_t id;
+	int epfd;
+	switch_mutex_t *mutex;
+	switch_thread_t *thread;
+	rtp_reactor_handle_t *dead;
+	rtp_reactor_handle_t *rtcp_handles;
+	switch_time_t rtcp_tick;
+	switch_rtp_reactor_stats_t stats;
+};
+
+static struct {
+	rtp_reactor_t *reactors[RTP_REACTOR_MAX_THREADS];
+	uint32_t threads;
+	uint32_t started;
+	uint32_t next;
+	int running;
+	switch_mutex_t *mutex;
+	switch_memory_pool_t *pool;
+} rtp_reactor_globals = { {0}, 2 };
+
+#ifdef RTP_REACTOR
+static rtp_reactor_slot_t *rtp_reactor_get_slot(switch_rtp_t *rtp_session, rtp_reactor_t *reactor)
+{
+	void *pop = NULL;
+
+	if (switch_queue_trypop(rtp_session->reactor_free, &pop) == SWITCH_STATUS_SUCCESS) {
+		return (rtp_reactor_slot_t *) pop;
+	}
+
+	/* the session is not keeping up, sacrifice the oldest packet so we always hold the freshest audio */
+	if (switch_queue_trypop(rtp_session->reactor_ready, &pop) == SWITCH_STATUS_SUCCESS) {
+		reactor->stats.dropped++;
+		return (rtp_reactor_slot_t *) pop;
+	}
+
+	return NULL;
+}
+
+/* 
+ * Relay: a bridged pair of sessions with the same codec can have their media handed
+ * straight from the reactor thread of one to the socket of the other.  Only packets of the
+ * negotiated media payload take the shortcut, everything else (2833, CN, stray payloads)
+ * still goes up to the session so DTMF keeps working.  The packet keeps its payload and
+ * timing, the header is rewritten to carry the ssrc, sequence and time base of the leg it
+ * leaves on so the far end sees one continuous stream across the switch in and out.
+ */
+static int rtp_relay_forward(switch_rtp_t *rtp_session, rtp_reactor_slot_t *slot)
+{
+	switch_rtp_t *peer;
+	rtp_msg_t *msg = &slot->packet->msg;
+	switch_size_t bytes = slot->bytes;
+	uint32_t ts;
+	int sent = 0;
+
+	if (bytes <= rtp_header_len || msg->header.version != 2 || msg->header.pt != rtp_session->rpayload) {
+		return 0;
+	}
+
+	switch_mutex_lock(rtp_session->relay_mutex);
+	if ((peer = rtp_session->relay_peer) && switch_rtp_ready(peer) && peer->remote_addr) {
+		WRITE_INC(peer);
+
+		ts = ntohl(msg->header.ts);
+		if (!rtp_session->relay_synced) {
+			rtp_session->relay_ts_delta = peer->last_write_ts + peer->samples_per_interval - ts;
+			rtp_session->relay_synced = 1;
+		}
+		ts += rtp_session->relay_ts_delta;
+
+		peer->seq++;
+		msg->header.seq = htons(peer->seq);
+		msg->header.ts = htonl(ts);
+		msg->header.ssrc = htonl(peer->ssrc);
+		msg->header.pt = peer->payload;
+		peer->ts = peer->last_write_ts = ts;
+		peer->last_write_samplecount = peer->timer.samplecount;
+
+		if (switch_socket_sendto(peer->sock_output, peer->remote_addr, 0, (void *) msg, &bytes) == SWITCH_STATUS_SUCCESS) {
+			peer->stats.outbound.raw_bytes += bytes;
+			peer->stats.outbound.media_bytes += bytes;
+			peer->stats.outbound.media_packet_count++;
+			peer->stats.outbound.packet_count++;
+		}
+
+		WRITE_DEC(peer);
+
+		rtp_session->stats.inbound.raw_bytes += slot->bytes;
+		rtp_session->stats.inbound.media_bytes += slot->bytes;
+		rtp_session->stats.inbound.media_packet_count++;
+		rtp_session->stats.inbound.packet_count++;
+		rtp_session->relay_packets++;
+		sent = 1;
+	}
+	switch_mutex_unlock(rtp_session->relay_mutex);
+
+	return sent;
+}
+
+static void rtp_reactor_drain(rtp_reactor_t *reactor, rtp_reactor_handle_t *handle)
+{
+	switch_rtp_t *rtp_session = handle->rtp_session;
+	struct mmsghdr msgs[RTP_REACTOR_BATCH];
+	struct iovec iovs[RTP_REACTOR_BATCH];
+	rtp_reactor_slot_t *slots[RTP_REACTOR_BATCH];
+	int want, got, x;
+
+	for (;;) {
+		for (want = 0; want < RTP_REACTOR_BATCH; want++) {
+			if (!(slots[want] = rtp_reactor_get_slot(rtp_session, reactor))) {
+				break;
+			}
+		}
+
+		if (!want) {
+			break;
+		}
+
+		switch_mutex_lock(rtp_packet_globals.mutex);
+		for (x = 0; x < want; x++) {
+			if (!slots[x]->packet) {
+				slots[x]->packet = rtp_packet_get_locked();
+			}
+		}
+		switch_mutex_unlock(rtp_packet_globals.mutex);
+
+		for (x = 0; x < want; x++) {
+			iovs[x].iov_base = (void *) &slots[x]->packet->msg;
+			iovs[x].iov_len = sizeof(rtp_msg_t);
+			memset(&msgs[x], 0, sizeof(msgs[x]));
+			msgs[x].msg_hdr.msg_iov = &iovs[x];
+			msgs[x].msg_hdr.msg_iovlen = 1;
+			msgs[x].msg_hdr.msg_name = &slots[x]->from;
+			msgs[x].msg_hdr.msg_namelen = sizeof(slots[x]->from);
+		}
+
+		got = recvmmsg(handle->fd, msgs, want, MSG_DONTWAIT, NULL);
+
+		for (x = 0; x < want; x++) {
+			if (x < got) {
+				slots[x]->bytes = msgs[x].msg_len;
+				slots[x]->fromlen = msgs[x].msg_hdr.msg_namelen;
+
+				/* relayed packets are done with here, the slot goes back below like an unused one */
+				if (rtp_session->relay_peer && rtp_relay_forward(rtp_session, slots[x])) {
+					reactor->stats.relayed++;
+					continue;
+				}
+
+				if (switch_queue_trypush(rtp_session->reactor_ready, slots[x]) == SWITCH_STATUS_SUCCESS) {
+					slots[x] = NULL;
+					continue;
+				}
+
+				reactor->stats.dropped++;
+			}
+		}
+
+		/* hand the buffers we did not fill back to the shared pool so quiet sessions hold nothing */
+		switch_mutex_lock(rtp_packet_globals.mutex);
+		for (x = 0; x < want; x++) {
+			if (slots[x]) {
+				rtp_packet_put_locked(slots[x]->packet);
+				slots[x]->packet = NULL;
+			}
+		}
+		switch_mutex_unlock(rtp_packet_globals.mutex);
+
+		for (x = 0; x < want; x++) {
+			if (slots[x]) {
+				switch_queue_trypush(rtp_session->reactor_free, slots[x]);
+			}
+		}
+
+		if (got <= 0) {
+			break;
+		}
+
+		reactor->stats.packets += got;
+
+		if ((uint32_t) got > reactor->stats.max_batch) {
+			reactor->stats.max_batch = got;
+		}
+
+		if (got < want) {
+			break;
+		}
+	}
+}
+
+/*
+ * RTCP service: the RTCP socket of a session on a reactor is watched by the same reactor, so
+ * the media loop of the session never polls it.  Received packets land in rtcp_recv_msg under
+ * rtcp_mutex and are only parsed when switch_rtcp_zerocopy_read_frame() asks for them.  Sender
+ * reports are built here on their own clock from counters the write path publishes with
+ * atomic stores; a report may lag the stream by a packet, which RTCP does not care about.
+ * Secure and passthru sessions keep doing RTCP inline, the crypto contexts are not ours to share.
+ */
+#define RTP_RTCP_TICK 100000
+
+static void rtp_rtcp_drain(rtp_reactor_t *reactor, rtp_reactor_handle_t *handle)
+{
+	switch_rtp_t *rtp_session = handle->rtp_session;
+	switch_size_t bytes = 0;
+	int max = 16;
+
+	switch_mutex_lock(rtp_session->rtcp_mutex);
+	while (max-- && read_rtcp_packet(rtp_session, &bytes, NULL) == SWITCH_STATUS_SUCCESS) {
+		switch_atomic_set(&rtp_session->rtcp_rx_seen, 1);
+		reactor->stats.rtcp_received++;
+	}
+	switch_mutex_unlock(rtp_session->rtcp_mutex);
+}
+
+static void rtp_rtcp_send_report(rtp_reactor_t *reactor, switch_rtp_t *rtp_session, switch_time_t now)
+{
+	rtcp_msg_t msg;
+	struct switch_rtcp_senderinfo *sr = (struct switch_rtcp_senderinfo *) msg.body;
+	switch_size_t rtcp_bytes = sizeof(switch_rtcp_hdr_t) + sizeof(struct switch_rtcp_senderinfo);
+	switch_time_t when;
+	uint32_t packets, ms;
+
+	rtp_session->rtcp_next_send = now + (switch_time_t) rtp_session->rtcp_send_rate * 1000;
+
+	/* nothing sent yet, nothing to report */
+	if (!(packets = switch_atomic_read(&rtp_session->rtcp_tx_packets)) || !rtp_session->rtcp_sock_output || !rtp_session->rtcp_remote_addr) {
+		return;
+	}
+
+	/* the write path keeps the low 32 bits of its clock in ms, put the rest back from ours */
+	ms = switch_atomic_read(&rtp_session->rtcp_tx_ms);
+	when = now - (switch_time_t) ((uint32_t) (now / 1000) - ms) * 1000;
+
+	msg.header = rtp_session->rtcp_send_msg.header;
+	sr->ssrc = htonl(rtp_session->ssrc);
+	sr->ntp_msw = htonl((u_long) (when / 1000000 + 2208988800UL));
+	sr->ntp_lsw = htonl((u_long) (when % 1000000 * ((UINT_MAX * 1.0) / 1000000.0)));
+	sr->ts = htonl(switch_atomic_read(&rtp_session->rtcp_tx_ts));
+	sr->pc = htonl(packets);
+	sr->oc = htonl(switch_atomic_read(&rtp_session->rtcp_tx_octets));
+
+	if (switch_socket_sendto(rtp_session->rtcp_sock_output, rtp_session->rtcp_remote_addr, 0, (const char *) &msg, &rtcp_bytes) == SWITCH_STATUS_SUCCESS) {
+		reactor->stats.rtcp_sent++;
+	}
+}
+
+static void rtp_rtcp_tick(rtp_reactor_t *reactor)
+{
+	rtp_reactor_handle_t *handle;
+	switch_time_t now = switch_micro_time_now();
+
+	if (now < reactor->rtcp_tick) {
+		return;
+	}
+
+	reactor->rtcp_tick = now + RTP_RTCP_TICK;
+
+	for (handle = reactor->rtcp_handles; handle; handle = handle->rtcp_next) {
+		switch_rtp_t *rtp_session = handle->rtp_session;
+
+		if (rtp_session->rtcp_send_rate > 0 && now >= rtp_session->rtcp_next_send) {
+			rtp_rtcp_send_report(reactor, rtp_session, now);
+		}
+	}
+}
+
+static void *SWITCH_THREAD_FUNC rtp_reactor_thread(switch_thread_t *thread, void *obj)
+{
+	rtp_reactor_t *reactor = (rtp_reactor_t *) obj;
+	struct epoll_event events[RTP_REACTOR_EVENTS];
+	rtp_reactor_handle_t *handle;
+	int n, i;
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "RTP reactor %u started\n", reactor->id);
+
+	while (rtp_reactor_globals.running) {
+		n = epoll_wait(reactor->epfd, events, RTP_REACTOR_EVENTS, 100);
+
+		if (n < 0 && errno != EINTR) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "RTP reactor %u epoll_wait failed: %s\n", reactor->id, strerror(errno));
+			switch_yield(100000);
+		}
+
+		switch_mutex_lock(reactor->mutex);
+
+		if (n > 0) {
+			reactor->stats.wakeups++;
+		}
+
+		for (i = 0; i < n; i++) {
+			handle = (rtp_reactor_handle_t *) events[i].data.ptr;
+
+			if (handle->dead) {
+				continue;
+			}
+
+			if (handle->rtcp) {
+				rtp_rtcp_drain(reactor, handle);
+			} else {
+				rtp_reactor_drain(reactor, handle);
+			}
+		}
+
+		if (reactor->rtcp_handles) {
+			rtp_rtcp_tick(reactor);
+		}
+
+		/* anything detached before we took the lock can no longer show up in epoll_wait() */
+		while ((handle = reactor->dead)) {
+			reactor->dead = handle->next;
+			free(handle);
+		}
+
+		switch_mutex_unlock(reactor->mutex);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "RTP reactor %u stopped\n", reactor->id);
+
+	return NULL;
+}
+
+static switch_status_t rtp_reactor_start(void)
+{
+	uint32_t i;
+
+	if (rtp_reactor_globals.started) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	rtp_reactor_globals.running = 1;
+
+	for (i = 0; i < rtp_reactor_globals.threads; i++) {
+		rtp_reactor_t *reactor;
+		switch_threadattr_t *thd_attr = NULL;
+		int epfd;
+
+		if ((epfd = epoll_create(1024)) < 0) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot create RTP reactor epoll set: %s\n", strerror(errno));
+			break;
+		}
+
+		reactor = switch_core_alloc(rtp_reactor_globals.pool, sizeof(*reactor));
+		reactor->id = i;
+		reactor->epfd = epfd;
+		switch_mutex_init(&reactor->mutex, SWITCH_MUTEX_NESTED, rtp_reactor_globals.pool);
+
+		switch_threadattr_create(&thd_attr, rtp_reactor_globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_threadattr_priority_increase(thd_attr);
+		switch_thread_create(&reactor->thread, thd_attr, rtp_reactor_thread, reactor, rtp_reactor_globals.pool);
+
+		rtp_reactor_globals.reactors[rtp_reactor_globals.started++] = reactor;
+	}
+
+	return rtp_reactor_globals.started ? SWITCH_STATUS_SUCCESS : SWITCH_STATUS_FALSE;
+}
+
+static void rtp_reactor_stop(void)
+{
+	switch_status_t st;
+	rtp_reactor_handle_t *handle;
+	uint32_t i;
+
+	if (!rtp_reactor_globals.started) {
+		return;
+	}
+
+	rtp_reactor_globals.running = 0;
+
+	for (i = 0; i < rtp_reactor_globals.started; i++) {
+		rtp_reactor_t *reactor = rtp_reactor_globals.reactors[i];
+
+		switch_thread_join(&st, reactor->thread);
+		close(reactor->epfd);
+
+		while ((handle = reactor->dead)) {
+			reactor->dead = handle->next;
+			free(handle);
+		}
+
+		rtp_reactor_globals.reactors[i] = NULL;
+	}
+
+	rtp_reactor_globals.started = 0;
+}
+#endif
+
+static void rtp_rtcp_detach(switch_rtp_t *rtp_session)
+{
+#ifdef RTP_REACTOR
+	rtp_reactor_handle_t *handle, **hp;
+	rtp_reactor_t *reactor;
+
+	if (!(handle = rtp_session->rtcp_handle)) {
+		return;
+	}
+
+	reactor = handle->reactor;
+
+	/* once we hold the lock the reactor is not inside this session and will not be again */
+	switch_mutex_lock(reactor->mutex);
+	epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, handle->fd, NULL);
+	for (hp = &reactor->rtcp_handles; *hp; hp = &(*hp)->rtcp_next) {
+		if (*hp == handle) {
+			*hp = handle->rtcp_next;
+			break;
+		}
+	}
+	handle->dead = 1;
+	handle->next = reactor->dead;
+	reactor->dead = handle;
+	reactor->stats.rtcp_sessions--;
+	switch_mutex_unlock(reactor->mutex);
+
+	rtp_session->rtcp_handle = NULL;
+#endif
+}
+
+static void rtp_rtcp_attach(switch_rtp_t *rtp_session)
+{
+#ifdef RTP_REACTOR
+	rtp_reactor_handle_t *handle;
+	rtp_reactor_t *reactor;
+	struct epoll_event ev = { 0 };
+	int fd;
+
+	if (rtp_session->rtcp_handle || !rtp_session->reactor_handle || !rtp_session->rtcp_sock_input ||
+		!switch_test_flag(rtp_session, SWITCH_RTP_FLAG_ENABLE_RTCP) || switch_test_flag(rtp_session, SWITCH_RTP_FLAG_RTCP_PASSTHRU) ||
+		switch_test_flag(rtp_session, SWITCH_RTP_FLAG_SECURE_SEND) || switch_test_flag(rtp_session, SWITCH_RTP_FLAG_SECURE_RECV) ||
+		(fd = switch_socket_fd_get(rtp_session->rtcp_sock_input)) < 0) {
+		return;
+	}
+#ifdef ENABLE_ZRTP
+	if (zrtp_on) {
+		return;
+	}
+#endif
+
+	reactor = rtp_session->reactor_handle->reactor;
+
+	switch_zmalloc(handle, sizeof(*handle));
+	handle->rtp_session = rtp_session;
+	handle->reactor = reactor;
+	handle->fd = fd;
+	handle->rtcp = 1;
+
+	switch_socket_opt_set(rtp_session->rtcp_sock_input, SWITCH_SO_NONBLOCK, TRUE);
+	rtp_session->rtcp_next_send = switch_micro_time_now() + (switch_time_t) rtp_session->rtcp_send_rate * 1000;
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = handle;
+
+	switch_mutex_lock(reactor->mutex);
+	if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		switch_mutex_unlock(reactor->mutex);
+		free(handle);
+		return;
+	}
+	handle->rtcp_next = reactor->rtcp_handles;
+	reactor->rtcp_handles = handle;
+	reactor->stats.rtcp_sessions++;
+	switch_mutex_unlock(reactor->mutex);
+
+	rtp_session->rtcp_handle = handle;
+#endif
+}
+
+static void rtp_reactor_detach(switch_rtp_t *rtp_session)
+{
+#ifdef RTP_REACTOR
+	rtp_reactor_handle_t *handle;
+	rtp_reactor_t *reactor;
+	void *pop;
+
+	rtp_rtcp_detach(rtp_session);
+
+	if (!(handle = rtp_session->reactor_handle)) {
+		return;
+	}
+
+	reactor = handle->reactor;
+
+	switch_mutex_lock(reactor->mutex);
+	epoll_ctl(reactor->epfd, EPOLL_CTL_DEL, handle->fd, NULL);
+	handle->dead = 1;
+	handle->next = reactor->dead;
+	reactor->dead = handle;
+	reactor->stats.sessions--;
+	switch_mutex_unlock(reactor->mutex);
+
+	rtp_session->reactor_handle = NULL;
+
+	if (rtp_session->reactor_pending) {
+		rtp_packet_release(rtp_session->reactor_pending->packet);
+		rtp_session->reactor_pending->packet = NULL;
+		switch_queue_trypush(rtp_session->reactor_free, rtp_session->reactor_pending);
+		rtp_session->reactor_pending = NULL;
+	}
+
+	while (switch_queue_trypop(rtp_session->reactor_ready, &pop) == SWITCH_STATUS_SUCCESS) {
+		rtp_reactor_slot_t *slot = (rtp_reactor_slot_t *) pop;
+
+		rtp_packet_release(slot->packet);
+		slot->packet = NULL;
+		switch_queue_trypush(rtp_session->reactor_free, slot);
+	}
+
+	/* wake up anyone still waiting on the queue */
+	switch_queue_interrupt_all(rtp_session->reactor_ready);
+#endif
+}
+
+static switch_status_t rtp_reactor_attach(switch_rtp_t *rtp_session)
+{
+#ifdef RTP_REACTOR
+	rtp_reactor_handle_t *handle;
+	rtp_reactor_t *reactor = NULL;
+	struct epoll_event ev = { 0 };
+	int fd, i;
+
+	if (rtp_session->reactor_handle || !rtp_session->sock_input || (fd = switch_socket_fd_get(rtp_session->sock_input)) < 0) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!rtp_session->reactor_ready) {
+		rtp_reactor_slot_t *slots = switch_core_alloc(rtp_session->pool, sizeof(*slots) * RTP_REACTOR_SLOTS);
+
+		switch_queue_create(&rtp_session->reactor_ready, RTP_REACTOR_SLOTS, rtp_session->pool);
+		switch_queue_create(&rtp_session->reactor_free, RTP_REACTOR_SLOTS, rtp_session->pool);
+
+		for (i = 0; i < RTP_REACTOR_SLOTS; i++) {
+			switch_queue_push(rtp_session->reactor_free, &slots[i]);
+		}
+	}
+
+	switch_mutex_lock(rtp_reactor_globals.mutex);
+	if (rtp_reactor_start() == SWITCH_STATUS_SUCCESS) {
+		reactor = rtp_reactor_globals.reactors[rtp_reactor_globals.next++ % rtp_reactor_globals.started];
+	}
+	switch_mutex_unlock(rtp_reactor_globals.mutex);
+
+	if (!reactor) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_zmalloc(handle, sizeof(*handle));
+	handle->rtp_session = rtp_session;
+	handle->reactor = reactor;
+	handle->fd = fd;
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = handle;
+
+	switch_mutex_lock(reactor->mutex);
+	if (epoll_ctl(reactor->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		switch_mutex_unlock(reactor->mutex);
+		free(handle);
+		return SWITCH_STATUS_FALSE;
+	}
+	reactor->stats.sessions++;
+	switch_mutex_unlock(reactor->mutex);
+
+	rtp_session->reactor_handle = handle;
+
+	return SWITCH_STATUS_SUCCESS;
+#else
+	return SWITCH_STATUS_NOTIMPL;
+#endif
+}
+
+static switch_status_t rtp_recvfrom(switch_rtp_t *rtp_session, switch_size_t *bytes)
+{
+#ifdef RTP_REACTOR
+	if (rtp_session->reactor_handle) {
+		rtp_reactor_slot_t *slot = rtp_session->reactor_pending;
+		void *pop = NULL;
+
+		rtp_session->reactor_pending = NULL;
+
+		if (!slot && switch_queue_trypop(rtp_session->reactor_ready, &pop) == SWITCH_STATUS_SUCCESS) {
+			slot = (rtp_reactor_slot_t *) pop;
+		}
+
+		if (!slot) {
+			*bytes = 0;
+			return SWITCH_STATUS_BREAK;
+		}
+
+		*bytes = slot->bytes;
+		rtp_set_recv_packet(rtp_session, slot->packet);
+		slot->packet = NULL;
+		switch_sockaddr_set_native(rtp_session->from_addr, &slot->from, slot->fromlen);
+		switch_queue_trypush(rtp_session->reactor_free, slot);
+
+		return SWITCH_STATUS_SUCCESS;
+	}
+#endif
+
+	rtp_recv_unshare(rtp_session);
+
+	return switch_socket_recvfrom(rtp_session->from_addr, rtp_session->sock_input, 0, (void *) rtp_session->recv_msg, bytes);
+}
+
+static switch_status_t rtp_poll_read(switch_rtp_t *rtp_session, int *fdr, switch_interval_time_t timeout)
+{
+#ifdef RTP_REACTOR
+	if (rtp_session->reactor_handle) {
+		switch_status_t status;
+		void *pop = NULL;
+
+		if (rtp_session->reactor_pending) {
+			return SWITCH_STATUS_SUCCESS;
+		}
+
+		if (timeout > 0) {
+			status = switch_queue_pop_timeout(rtp_session->reactor_ready, &pop, timeout);
+		} else {
+			status = switch_queue_trypop(rtp_session->reactor_ready, &pop);
+		}
+
+		if (status == SWITCH_STATUS_SUCCESS && pop) {
+			rtp_session->reactor_pending = (rtp_reactor_slot_t *) pop;
+			*fdr = 1;
+			return SWITCH_STATUS_SUCCESS;
+		}
+
+		return SWITCH_STATUS_TIMEOUT;
+	}
+#endif
+
+	return switch_poll(rtp_session->read_pollfd, 1, fdr, timeout);
+}
+
+/* 
+ * Transmit batching: packets written on one session during the same media tick are held
+ * and handed to the kernel with a single sendmmsg().  The batch is flushed when it is full,
+ * at the end of a video frame (marker bit), when the oldest packet exceeds the latency cap,
+ * or when the session thread comes back around to read.
+ */
+
+typedef struct rtp_tx_slot_s {
+	char data[RTP_TX_SLOT_LEN];
+	switch_size_t bytes;
+} rtp_tx_slot_t;
+
+static void rtp_tx_batch_flush(switch_rtp_t *rtp_session)
+{
+	uint32_t sent = 0, len = rtp_session->tx_batch_len;
+
+	if (!len) {
+		return;
+	}
+
+	rtp_session->tx_batch_len = 0;
+
+#ifdef RTP_TX_BATCH
+	if (rtp_session->remote_addr && rtp_session->sock_output) {
+		struct mmsghdr msgs[RTP_TX_BATCH_MAX];
+		struct iovec iovs[RTP_TX_BATCH_MAX];
+		int fd = switch_socket_fd_get(rtp_session->sock_output);
+		uint32_t x;
+		int r;
+
+		for (x = 0; x < len; x++) {
+			iovs[x].iov_base = rtp_session->tx_batch[x].data;
+			iovs[x].iov_len = rtp_session->tx_batch[x].bytes;
+			memset(&msgs[x], 0, sizeof(msgs[x]));
+			msgs[x].msg_hdr.msg_iov = &iovs[x];
+			msgs[x].msg_hdr.msg_iovlen = 1;
+			msgs[x].msg_hdr.msg_name = &rtp_session->remote_addr->sa;
+			msgs[x].msg_hdr.msg_namelen = rtp_session->remote_addr->salen;
+		}
+
+		while (fd > -1 && sent < len) {
+			if ((r = sendmmsg(fd, msgs + sent, len - sent, 0)) <= 0) {
+				break;
+			}
+			sent += r;
+		}
+	}
+#endif
+
+	/* whatever the kernel would not take in one go goes out the old way */
+	for (; sent < len; sent++) {
+		switch_size_t bytes = rtp_session->tx_batch[sent].bytes;
+		switch_socket_sendto(rtp_session->sock_output, rtp_session->remote_addr, 0, rtp_session->tx_batch[sent].data, &bytes);
+	}
+
+	rtp_session->stats.outbound.batch_count++;
+
+	if (len > rtp_session->stats.outbound.largest_batch) {
+		rtp_session->stats.outbound.largest_batch = len;
+	}
+}
+
+static switch_status_t rtp_sendto(switch_rtp_t *rtp_session, void *data, switch_size_t *bytes, switch_bool_t end_of_frame)
+{
+	rtp_tx_slot_t *slot;
+	switch_time_t now;
+
+	if (!rtp_session->tx_batch_max || *bytes > RTP_TX_SLOT_LEN) {
+		rtp_tx_batch_flush(rtp_session);
+		return switch_socket_sendto(rtp_session->sock_output, rtp_session->remote_addr, 0, data, bytes);
+	}
+
+	now = switch_micro_time_now();
+
+	if (rtp_session->tx_batch_len && now - rtp_session->tx_batch_started >= rtp_session->tx_batch_usec) {
+		rtp_tx_batch_flush(rtp_session);
+	}
+
+	if (!rtp_session->tx_batch_len) {
+		rtp_session->tx_batch_started = now;
+	}
+
+	slot = &rtp_session->tx_batch[rtp_session->tx_batch_len++];
+	memcpy(slot->data, data, *bytes);
+	slot->bytes = *bytes;
+
+	if (end_of_frame || rtp_session->tx_batch_len >= rtp_session->tx_batch_max) {
+		rtp_tx_batch_flush(rtp_session);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_rtp_set_tx_batch(switch_rtp_t *rtp_session, uint32_t max_packets, uint32_t max_usec)
+{
+#ifdef RTP_TX_BATCH
+	if (max_packets > RTP_TX_BATCH_MAX) {
+		max_packets = RTP_TX_BATCH_MAX;
+	}
+
+	WRITE_INC(rtp_session);
+	rtp_tx_batch_flush(rtp_session);
+
+	if (max_packets > 1 && !rtp_session->tx_batch) {
+		rtp_session->tx_batch = switch_core_alloc(rtp_session->pool, sizeof(rtp_tx_slot_t) * RTP_TX_BATCH_MAX);
+	}
+
+	rtp_session->tx_batch_max = max_packets > 1 ? max_packets : 0;
+	rtp_session->tx_batch_usec = max_usec ? max_usec : 1000;
+	WRITE_DEC(rtp_session);
+
+	return SWITCH_STATUS_SUCCESS;
+#else
+	return SWITCH_STATUS_NOTIMPL;
+#endif
+}
+
+SWITCH_DECLARE(switch_status_t) switch_rtp_relay_start(switch_rtp_t *rtp_session, switch_rtp_t *peer)
+{
+#ifdef RTP_REACTOR
+	switch_rtp_t *legs[2] = { rtp_session, peer };
+	int i;
+
+	if (!switch_rtp_ready(rtp_session) || !switch_rtp_ready(peer) || rtp_session == peer) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	for (i = 0; i < 2; i++) {
+		if (!legs[i]->reactor_handle || !legs[i]->remote_addr ||
+			switch_test_flag(legs[i], SWITCH_RTP_FLAG_SECURE_SEND) || switch_test_flag(legs[i], SWITCH_RTP_FLAG_SECURE_RECV) ||
+			switch_test_flag(legs[i], SWITCH_RTP_FLAG_PROXY_MEDIA) || switch_test_flag(legs[i], SWITCH_RTP_FLAG_UDPTL)) {
+			return SWITCH_STATUS_FALSE;
+		}
+#ifdef ENABLE_ZRTP
+		if (legs[i]->zrtp_session) {
+			return SWITCH_STATUS_FALSE;
+		}
+#endif
+	}
+
+	if (rtp_session->samples_per_second != peer->samples_per_second || rtp_session->samples_per_interval != peer->samples_per_interval) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_rtp_relay_stop(rtp_session);
+	switch_rtp_relay_stop(peer);
+
+	for (i = 0; i < 2; i++) {
+		switch_mutex_lock(legs[i]->relay_mutex);
+		legs[i]->relay_peer = legs[!i];
+		legs[i]->relay_synced = 0;
+		switch_mutex_unlock(legs[i]->relay_mutex);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+#else
+	return SWITCH_STATUS_NOTIMPL;
+#endif
+}
+
+SWITCH_DECLARE(void) switch_rtp_relay_stop(switch_rtp_t *rtp_session)
+{
+	switch_rtp_t *peer;
+
+	if (!rtp_session || !rtp_session->relay_mutex) {
+		return;
+	}
+
+	switch_mutex_lock(rtp_session->relay_mutex);
+	peer = rtp_session->relay_peer;
+	rtp_session->relay_peer = NULL;
+	switch_mutex_unlock(rtp_session->relay_mutex);
+
+	if (peer) {
+		/* once this returns neither reactor can be in the middle of sending on the other */
+		switch_mutex_lock(peer->relay_mutex);
+		if (peer->relay_peer == rtp_session) {
+			peer->relay_peer = NULL;
+		}
+		switch_mutex_unlock(peer->relay_mutex);
+	}
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_rtp_relay_active(switch_rtp_t *rtp_session, switch_size_t *packets)
+{
+	if (packets) {
+		*packets = rtp_session ? rtp_session->relay_packets : 0;
+	}
+
+	return (rtp_session && rtp_session->relay_peer) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+SWITCH_DECLARE(uint32_t) switch_rtp_set_reactor_threads(uint32_t threads)
+{
+	if (threads) {
+		if (threads > RTP_REACTOR_MAX_THREADS) {
+			threads = RTP_REACTOR_MAX_THREADS;
+		}
+
+		if (rtp_reactor_globals.started) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "RTP reactor already running with %u threads\n",
+							  rtp_reactor_globals.started);
+		} else {
+			rtp_reactor_globals.threads = threads;
+		}
+	}
+
+	return rtp_reactor_globals.threads;
+}
+
+SWITCH_DECLARE(uint32_t) switch_rtp_get_reactor_stats(switch_rtp_reactor_stats_t *stats, uint32_t max)
+{
+	uint32_t i = 0;
+
+#ifdef RTP_REACTOR
+	if (!rtp_reactor_globals.mutex) {
+		return 0;
+	}
+
+	switch_mutex_lock(rtp_reactor_globals.mutex);
+	for (i = 0; i < rtp_reactor_globals.started && i < max; i++) {
+		rtp_reactor_t *reactor = rtp_reactor_globals.reactors[i];
+
+		switch_mutex_lock(reactor->mutex);
+		stats[i] = reactor->stats;
+		switch_mutex_unlock(reactor->mutex);
+	}
+	switch_mutex_unlock(rtp_reactor_globals.mutex);
+#endif
+
+	return i;
+}
+
 SWITCH_DECLARE(void) switch_rtp_init(switch_memory_pool_t *pool)
 {
 #ifdef ENABLE_ZRTP
@@ -887,6 +1938,9 @@ SWITCH_DECLARE(void) switch_rtp_init(switch_memory_pool_t *pool)
 	srtp_init();
 #endif
 	switch_mutex_init(&port_lock, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&rtp_reactor_globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&rtp_packet_globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	rtp_reactor_globals.pool = pool;
 	global_init = 1;
 }
 
@@ -924,6 +1978,21 @@ SWITCH_DECLARE(void) switch_rtp_shutdown(void)
 	switch_core_hash_destroy(&alloc_hash);
 	switch_mutex_unlock(port_lock);
 
+#ifdef RTP_REACTOR
+	switch_mutex_lock(rtp_reactor_globals.mutex);
+	rtp_reactor_stop();
+	switch_mutex_unlock(rtp_reactor_globals.mutex);
+#endif
+
+	switch_mutex_lock(rtp_packet_globals.mutex);
+	while (rtp_packet_globals.free) {
+		rtp_packet_t *packet = rtp_packet_globals.free;
+		rtp_packet_globals.free = packet->next;
+		free(packet);
+	}
+	rtp_packet_globals.free_count = 0;
+	switch_mutex_unlock(rtp_packet_globals.mutex);
+
 #ifdef ENABLE_ZRTP
 	if (zrtp_on) {
 		zrtp_status_t status = zrtp_status_ok;
@@ -1030,6 +2099,9 @@ static switch_status_t enable_remote_rtcp_socket(switch_rtp_t *rtp_session, cons
 	
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 
+	/* the reactor may be sending on the socket we are about to replace */
+	rtp_rtcp_detach(rtp_session);
+
 	if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_ENABLE_RTCP)) {
 
 		if (switch_sockaddr_info_get(&rtp_session->rtcp_remote_addr, rtp_session->eff_remote_host_str, SWITCH_UNSPEC, 
@@ -1060,6 +2132,8 @@ static switch_status_t enable_remote_rtcp_socket(switch_rtp_t *rtp_session, cons
 				}
 			}
 		}
+
+		rtp_rtcp_attach(rtp_session);
 	} else {
 		*err = "RTCP NOT ACTIVE!";
 	}
@@ -1103,12 +2177,16 @@ static switch_status_t enable_local_rtcp_socket(switch_rtp_t *rtp_session, const
 			goto done;
 		}
 
+		rtp_rtcp_detach(rtp_session);
+
 		rtcp_old_sock = rtp_session->rtcp_sock_input;
 		rtp_session->rtcp_sock_input = rtcp_new_sock;
 		rtcp_new_sock = NULL;
 
 		switch_socket_create_pollset(&rtp_session->rtcp_read_pollfd, rtp_session->rtcp_sock_input, SWITCH_POLLIN | SWITCH_POLLERR, rtp_session->pool);
 
+		rtp_rtcp_attach(rtp_session);
+
  done:
 		
 		if (*err) {
@@ -1229,6 +2307,10 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_set_local_address(switch_rtp_t *rtp_s
 
 	switch_socket_create_pollset(&rtp_session->read_pollfd, rtp_session->sock_input, SWITCH_POLLIN | SWITCH_POLLERR, rtp_session->pool);
 
+	if (rtp_session->use_reactor) {
+		rtp_reactor_attach(rtp_session);
+	}
+
 	if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_ENABLE_RTCP)) {
 		if ((status = enable_local_rtcp_socket(rtp_session, err)) == SWITCH_STATUS_SUCCESS) {
 			*err = "Success";
@@ -1310,6 +2392,7 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_udptl_mode(switch_rtp_t *rtp_session)
 		switch_clear_flag_locked(rtp_session, SWITCH_RTP_FLAG_USE_TIMER);
 	}
 
+	rtp_rtcp_detach(rtp_session);
 	switch_clear_flag(rtp_session, SWITCH_RTP_FLAG_ENABLE_RTCP);
 
 	if (rtp_session->rtcp_sock_input) {
@@ -1423,6 +2506,9 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_add_crypto_key(switch_rtp_t *rtp_sess
 		return SWITCH_STATUS_FALSE;
 	}
 
+	/* SRTCP shares the srtp context with the media, do it on the session thread */
+	rtp_rtcp_detach(rtp_session);
+
 	crypto_key = switch_core_alloc(rtp_session->pool, sizeof(*crypto_key));
 
 	if (direction == SWITCH_RTP_CRYPTO_RECV) {
@@ -1612,10 +2698,14 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_create(switch_rtp_t **new_rtp_session
 	rtp_session->pool = pool;
 	rtp_session->te = 101;
 	rtp_session->recv_te = 101;
+	rtp_session->recv_packet = rtp_packet_alloc();
+	rtp_session->recv_msg = &rtp_session->recv_packet->msg;
 
 	switch_mutex_init(&rtp_session->flag_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_mutex_init(&rtp_session->read_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_mutex_init(&rtp_session->write_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&rtp_session->relay_mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_mutex_init(&rtp_session->rtcp_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_mutex_init(&rtp_session->dtmf_data.dtmf_mutex, SWITCH_MUTEX_NESTED, pool);
 	switch_queue_create(&rtp_session->dtmf_data.dtmf_queue, 100, rtp_session->pool);
 	switch_queue_create(&rtp_session->dtmf_data.dtmf_inqueue, 100, rtp_session->pool);
@@ -1640,15 +2730,15 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_create(switch_rtp_t **new_rtp_session
 	rtp_session->send_msg.header.x = 0;
 	rtp_session->send_msg.header.cc = 0;
 
-	rtp_session->recv_msg.header.ssrc = 0;
-	rtp_session->recv_msg.header.ts = 0;
-	rtp_session->recv_msg.header.seq = 0;
-	rtp_session->recv_msg.header.m = 0;
-	rtp_session->recv_msg.header.pt = (switch_payload_t) htonl(payload);
-	rtp_session->recv_msg.header.version = 2;
-	rtp_session->recv_msg.header.p = 0;
-	rtp_session->recv_msg.header.x = 0;
-	rtp_session->recv_msg.header.cc = 0;
+	rtp_session->recv_msg->header.ssrc = 0;
+	rtp_session->recv_msg->header.ts = 0;
+	rtp_session->recv_msg->header.seq = 0;
+	rtp_session->recv_msg->header.m = 0;
+	rtp_session->recv_msg->header.pt = (switch_payload_t) htonl(payload);
+	rtp_session->recv_msg->header.version = 2;
+	rtp_session->recv_msg->header.p = 0;
+	rtp_session->recv_msg->header.x = 0;
+	rtp_session->recv_msg->header.cc = 0;
 
 	rtp_session->payload = payload;
 	rtp_session->rpayload = payload;
@@ -1890,13 +2980,16 @@ static void jb_callback(stfu_instance_t *i, void *udata)
 	stfu_n_report(i, &r);
 
 	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG8, 
-					  "%s JB REPORT:\nlen: %u\nin: %u\nclean: %u\ngood: %u\nbad: %u\n",
+					  "%s JB REPORT:\nlen: %u\ntarget: %u\nin: %u\nclean: %u\ngood: %u\nbad: %u\nplc: %u\njitter: %u\n",
 					  switch_core_session_get_name(session),
 					  r.qlen,
+					  r.target_qlen,
 					  r.packet_in_count,
 					  r.clean_count,
 					  r.consecutive_good_count,
-					  r.consecutive_bad_count
+					  r.consecutive_bad_count,
+					  r.plc_count,
+					  r.jitter
 					  );
 
 }
@@ -1970,7 +3063,8 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_activate_jitter_buffer(switch_rtp_t *
 																  uint32_t max_queue_frames, 
 																  uint32_t samples_per_packet, 
 																  uint32_t samples_per_second,
-																  uint32_t max_drift)
+																  uint32_t max_drift,
+																  switch_rtp_jb_flag_t jb_flags)
 {
 
 	if (!switch_rtp_ready(rtp_session)) {
@@ -1989,7 +3083,13 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_activate_jitter_buffer(switch_rtp_t *
 	if (rtp_session->jb) {
 		stfu_n_resize(rtp_session->jb, queue_frames);
 	} else {
-		rtp_session->jb = stfu_n_init(queue_frames, max_queue_frames ? max_queue_frames : 50, samples_per_packet, samples_per_second, max_drift);
+		if ((rtp_session->jb = stfu_n_init(queue_frames, max_queue_frames ? max_queue_frames : 50, samples_per_packet, samples_per_second, max_drift))) {
+			stfu_n_set_release(rtp_session->jb, rtp_packet_stfu_release);
+		}
+	}
+
+	if (rtp_session->jb && (jb_flags & SWITCH_RTP_JB_ADAPTIVE)) {
+		stfu_n_set_adaptive(rtp_session->jb, queue_frames, 0);
 	}
 	READ_DEC(rtp_session);
 	
@@ -2026,12 +3126,39 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_activate_rtcp(switch_rtp_t *rtp_sessi
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "RTCP send rate is: %d and packet rate is: %d Remote Port: %d\n", 
 						  send_rate, rtp_session->ms_per_packet, rtp_session->remote_rtcp_port);
 		rtp_session->rtcp_interval = send_rate/(rtp_session->ms_per_packet/1000);
+		rtp_session->rtcp_send_rate = send_rate;
 	}
 
 	return enable_local_rtcp_socket(rtp_session, &err) || enable_remote_rtcp_socket(rtp_session, &err);
 
 }
 
+SWITCH_DECLARE(switch_status_t) switch_rtp_activate_reactor(switch_rtp_t *rtp_session)
+{
+	switch_status_t status;
+
+	if (!switch_rtp_ready(rtp_session)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	READ_INC(rtp_session);
+	rtp_session->use_reactor = 1;
+	status = rtp_reactor_attach(rtp_session);
+	if (status != SWITCH_STATUS_SUCCESS) {
+		rtp_session->use_reactor = 0;
+	} else {
+		rtp_rtcp_attach(rtp_session);
+	}
+	READ_DEC(rtp_session);
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		switch_core_session_t *session = switch_core_memory_pool_get_data(rtp_session->pool, "__session");
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "RTP reactor not available, using direct socket reads\n");
+	}
+
+	return status;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_rtp_activate_ice(switch_rtp_t *rtp_session, char *login, char *rlogin)
 {
 	char ice_user[80];
@@ -2086,6 +3213,7 @@ SWITCH_DECLARE(void) switch_rtp_kill_socket(switch_rtp_t *rtp_session)
 {
 	switch_assert(rtp_session != NULL);
 	switch_mutex_lock(rtp_session->flag_mutex);
+	rtp_reactor_detach(rtp_session);
 	if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_IO)) {
 		switch_clear_flag(rtp_session, SWITCH_RTP_FLAG_IO);
 		if (rtp_session->sock_input) {
@@ -2136,6 +3264,8 @@ SWITCH_DECLARE(void) switch_rtp_destroy(switch_rtp_t **rtp_session)
 
 	switch_set_flag_locked((*rtp_session), SWITCH_RTP_FLAG_SHUTDOWN);
 
+	switch_rtp_relay_stop(*rtp_session);
+
 	READ_INC((*rtp_session));
 	WRITE_INC((*rtp_session));
 
@@ -2227,6 +3357,10 @@ SWITCH_DECLARE(void) switch_rtp_destroy(switch_rtp_t **rtp_session)
 	}
 
 	switch_rtp_release_port((*rtp_session)->rx_host, (*rtp_session)->rx_port);
+
+	rtp_packet_release((*rtp_session)->recv_packet);
+	(*rtp_session)->recv_packet = NULL;
+
 	switch_mutex_unlock((*rtp_session)->flag_mutex);
 
 	return;
@@ -2526,12 +3660,12 @@ static void do_flush(switch_rtp_t *rtp_session)
 		do {
 			if (switch_rtp_ready(rtp_session)) {
 				bytes = sizeof(rtp_msg_t);
-				switch_socket_recvfrom(rtp_session->from_addr, rtp_session->sock_input, 0, (void *) &rtp_session->recv_msg, &bytes);
+				rtp_recvfrom(rtp_session, &bytes);
 				if (bytes) {
 					int do_cng = 0;
 
 					/* Make sure to handle RFC2833 packets, even if we're flushing the packets */
-					if (bytes > rtp_header_len && rtp_session->recv_te && rtp_session->recv_msg.header.pt == rtp_session->recv_te) {
+					if (bytes > rtp_header_len && rtp_session->recv_te && rtp_session->recv_msg->header.pt == rtp_session->recv_te) {
 						handle_rfc2833(rtp_session, bytes, &do_cng);
 #ifdef DEBUG_2833
 						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "*** RTP packet handled in flush loop %d ***\n", do_cng);
@@ -2568,16 +3702,17 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	stfu_frame_t *jb_frame;
+	stfu_status_t jb_status;
 	uint32_t ts;
 
 	switch_assert(bytes);
  more:
 	*bytes = sizeof(rtp_msg_t);
-	status = switch_socket_recvfrom(rtp_session->from_addr, rtp_session->sock_input, 0, (void *) &rtp_session->recv_msg, bytes);
-	ts = ntohl(rtp_session->recv_msg.header.ts);
+	status = rtp_recvfrom(rtp_session, bytes);
+	ts = ntohl(rtp_session->recv_msg->header.ts);
 
 	if (*bytes) {
-		uint16_t seq = ntohs((uint16_t) rtp_session->recv_msg.header.seq);
+		uint16_t seq = ntohs((uint16_t) rtp_session->recv_msg->header.seq);
 		
 		if (rtp_session->last_seq && rtp_session->last_seq+1 != seq) {
 #ifdef DEBUG_MISSED_SEQ
@@ -2621,7 +3756,11 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 	rtp_session->last_flush_packet_count = rtp_session->stats.inbound.flush_packet_count;
 	rtp_session->last_read_time = switch_micro_time_now();
 
-	if (*bytes && (!rtp_session->recv_te || rtp_session->recv_msg.header.pt != rtp_session->recv_te) && 
+	if (*bytes) {
+		rtp_session->last_ingress = rtp_session->frame_ingress = rtp_session->last_read_time;
+	}
+
+	if (*bytes && (!rtp_session->recv_te || rtp_session->recv_msg->header.pt != rtp_session->recv_te) && 
 		ts && !rtp_session->jb && !rtp_session->pause_jb && ts == rtp_session->last_cng_ts) {
 		/* we already sent this frame..... */
 		*bytes = 0;
@@ -2630,9 +3769,9 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 
 	if (*bytes) {
 		rtp_session->stats.inbound.raw_bytes += *bytes;
-		if (rtp_session->recv_te && rtp_session->recv_msg.header.pt == rtp_session->recv_te) {
+		if (rtp_session->recv_te && rtp_session->recv_msg->header.pt == rtp_session->recv_te) {
 			rtp_session->stats.inbound.dtmf_packet_count++;
-		} else if (rtp_session->cng_pt && (rtp_session->recv_msg.header.pt == rtp_session->cng_pt || rtp_session->recv_msg.header.pt == 13)) {
+		} else if (rtp_session->cng_pt && (rtp_session->recv_msg->header.pt == rtp_session->cng_pt || rtp_session->recv_msg->header.pt == 13)) {
 			rtp_session->stats.inbound.cng_packet_count++;
 		} else {
 			rtp_session->stats.inbound.media_packet_count++;
@@ -2649,7 +3788,7 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 				unsigned int sbytes = (int) *bytes;
 				zrtp_status_t stat = 0;
 				
-				stat = zrtp_process_srtp(rtp_session->zrtp_stream, (void *) &rtp_session->recv_msg, &sbytes);
+				stat = zrtp_process_srtp(rtp_session->zrtp_stream, (void *) rtp_session->recv_msg, &sbytes);
 				
 				switch (stat) {
 				case zrtp_status_ok:
@@ -2689,10 +3828,10 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 				}
 
 				if (!(*flags & SFF_PLC)) {
-					stat = srtp_unprotect(rtp_session->recv_ctx, &rtp_session->recv_msg.header, &sbytes);
+					stat = srtp_unprotect(rtp_session->recv_ctx, &rtp_session->recv_msg->header, &sbytes);
 				}
 
-				if (stat && rtp_session->recv_msg.header.pt != rtp_session->recv_te && rtp_session->recv_msg.header.pt != rtp_session->cng_pt) {
+				if (stat && rtp_session->recv_msg->header.pt != rtp_session->recv_te && rtp_session->recv_msg->header.pt != rtp_session->cng_pt) {
 					if (++rtp_session->srtp_errs >= MAX_SRTP_ERRS) {
 						switch_core_session_t *session = switch_core_memory_pool_get_data(rtp_session->pool, "__session");
 						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR,
@@ -2714,7 +3853,7 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 	}
 
 
-	if ((rtp_session->recv_te && rtp_session->recv_msg.header.pt == rtp_session->recv_te) || 
+	if ((rtp_session->recv_te && rtp_session->recv_msg->header.pt == rtp_session->recv_te) || 
 		(*bytes < rtp_header_len && *bytes > 0) ||
 		switch_test_flag(rtp_session, SWITCH_RTP_FLAG_PROXY_MEDIA) || switch_test_flag(rtp_session, SWITCH_RTP_FLAG_UDPTL)) {
 		return SWITCH_STATUS_SUCCESS;
@@ -2724,12 +3863,12 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 	rtp_session->last_read_ts = ts;
 	
 	
-	if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_BYTESWAP) && rtp_session->recv_msg.header.pt == rtp_session->rpayload) {
-		switch_swap_linear((int16_t *)rtp_session->recv_msg.body, (int) *bytes - rtp_header_len);
+	if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_BYTESWAP) && rtp_session->recv_msg->header.pt == rtp_session->rpayload) {
+		switch_swap_linear((int16_t *)rtp_session->recv_msg->body, (int) *bytes - rtp_header_len);
 	}
 
-	if (rtp_session->jb && !rtp_session->pause_jb && rtp_session->recv_msg.header.version == 2 && *bytes) {
-		if (rtp_session->recv_msg.header.m && rtp_session->recv_msg.header.pt != rtp_session->recv_te && 
+	if (rtp_session->jb && !rtp_session->pause_jb && rtp_session->recv_msg->header.version == 2 && *bytes) {
+		if (rtp_session->recv_msg->header.m && rtp_session->recv_msg->header.pt != rtp_session->recv_te && 
 			!switch_test_flag(rtp_session, SWITCH_RTP_FLAG_VIDEO) && !(rtp_session->rtp_bugs & RTP_BUG_IGNORE_MARK_BIT)) {
 			stfu_n_reset(rtp_session->jb);
 		}
@@ -2738,10 +3877,18 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 			switch_core_timer_sync(&rtp_session->timer);
 		}
 
-		if (stfu_n_eat(rtp_session->jb, rtp_session->last_read_ts, 
-					   rtp_session->recv_msg.header.pt,
-					   rtp_session->recv_msg.body, *bytes - rtp_header_len, rtp_session->timer.samplecount) == STFU_ITS_TOO_LATE) {
-			
+		/* the jitter buffer keeps a reference to the receive buffer rather than a copy of the payload */
+		rtp_session->recv_packet->refs++;
+		jb_status = stfu_n_add_ref_data(rtp_session->jb, rtp_session->last_read_ts, 
+										rtp_session->recv_msg->header.pt,
+										rtp_session->recv_msg->body, *bytes - rtp_header_len, rtp_session->timer.samplecount,
+										rtp_session->recv_packet);
+
+		if (jb_status != STFU_IT_WORKED) {
+			rtp_session->recv_packet->refs--;
+		}
+
+		if (jb_status == STFU_ITS_TOO_LATE) {
 			goto more;
 		}
 
@@ -2754,7 +3901,17 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 
 	if (rtp_session->jb && !rtp_session->pause_jb) {
 		if ((jb_frame = stfu_n_read_a_frame(rtp_session->jb))) {
-			memcpy(rtp_session->recv_msg.body, jb_frame->data, jb_frame->dlen);
+			if (jb_frame->ref) {
+				rtp_packet_t *packet = (rtp_packet_t *) jb_frame->ref;
+
+				if (packet != rtp_session->recv_packet) {
+					packet->refs++;
+					rtp_set_recv_packet(rtp_session, packet);
+				}
+			} else {
+				rtp_recv_unshare(rtp_session);
+				memcpy(rtp_session->recv_msg->body, jb_frame->data, jb_frame->dlen);
+			}
 
 			if (jb_frame->plc) {
 				(*flags) |= SFF_PLC;
@@ -2762,8 +3919,15 @@ static switch_status_t read_rtp_packet(switch_rtp_t *rtp_session, switch_size_t
 				rtp_session->stats.inbound.jb_packet_count++;
 			}
 			*bytes = jb_frame->dlen + rtp_header_len;
-			rtp_session->recv_msg.header.ts = htonl(jb_frame->ts);
-			rtp_session->recv_msg.header.pt = jb_frame->pt;
+
+			/* the buffer does not keep arrival times, place the frame behind the newest packet by the timestamp gap */
+			rtp_session->frame_ingress = rtp_session->last_ingress;
+			if (rtp_session->samples_per_second && (int32_t) (rtp_session->last_read_ts - jb_frame->ts) > 0) {
+				rtp_session->frame_ingress -= (switch_time_t) (rtp_session->last_read_ts - jb_frame->ts) * 1000000 / rtp_session->samples_per_second;
+			}
+
+			rtp_session->recv_msg->header.ts = htonl(jb_frame->ts);
+			rtp_session->recv_msg->header.pt = jb_frame->pt;
 			status = SWITCH_STATUS_SUCCESS;
 		}
 	}
@@ -2915,6 +4079,13 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 		sleep_mss = rtp_session->timer.interval * 1000;
 	}
 
+	/* coming back to read means the media tick is over, push out anything still batched */
+	if (rtp_session->tx_batch_len) {
+		WRITE_INC(rtp_session);
+		rtp_tx_batch_flush(rtp_session);
+		WRITE_DEC(rtp_session);
+	}
+
 	READ_INC(rtp_session);
 
 	while (switch_rtp_ready(rtp_session)) {
@@ -2925,7 +4096,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 		if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_USE_TIMER)) {
 			if ((switch_test_flag(rtp_session, SWITCH_RTP_FLAG_AUTOFLUSH) || switch_test_flag(rtp_session, SWITCH_RTP_FLAG_STICKY_FLUSH)) &&
 				rtp_session->read_pollfd) {
-				if (switch_poll(rtp_session->read_pollfd, 1, &fdr, 0) == SWITCH_STATUS_SUCCESS) {
+				if (rtp_poll_read(rtp_session, &fdr, 0) == SWITCH_STATUS_SUCCESS) {
 					status = read_rtp_packet(rtp_session, &bytes, flags, SWITCH_FALSE);
 					/* switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Initial (%i) %d\n", status, bytes); */
 					if (status != SWITCH_STATUS_FALSE) {
@@ -2933,7 +4104,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 					}
 
 					if (bytes) {
-						if (switch_poll(rtp_session->read_pollfd, 1, &fdr, 0) == SWITCH_STATUS_SUCCESS) {
+						if (rtp_poll_read(rtp_session, &fdr, 0) == SWITCH_STATUS_SUCCESS) {
 							/* switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Trigger %d\n", rtp_session->hot_hits); */
 							rtp_session->hot_hits += rtp_session->samples_per_interval;
 						} else {
@@ -2991,7 +4162,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 				pt = 0;
 			}
 
-			poll_status = switch_poll(rtp_session->read_pollfd, 1, &fdr, pt);
+			poll_status = rtp_poll_read(rtp_session, &fdr, pt);
 
 			if (rtp_session->dtmf_data.out_digit_dur > 0) {
 				return_cng_frame();
@@ -3035,7 +4206,13 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 		}
 
 
-		if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_ENABLE_RTCP) && rtp_session->rtcp_read_pollfd) {
+		if (rtp_session->rtcp_handle) {
+			/* the reactor reads our RTCP, all that is left is to let it count as media for the timeout */
+			if (switch_atomic_read(&rtp_session->rtcp_rx_seen)) {
+				switch_atomic_set(&rtp_session->rtcp_rx_seen, 0);
+				switch_rtp_reset_media_timer(rtp_session);
+			}
+		} else if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_ENABLE_RTCP) && rtp_session->rtcp_read_pollfd) {
 			rtcp_poll_status = switch_poll(rtp_session->rtcp_read_pollfd, 1, &rtcp_fdr, 0);
 						
 			if (rtcp_poll_status == SWITCH_STATUS_SUCCESS) {
@@ -3114,12 +4291,12 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 		}
 
 
-		if (bytes && rtp_session->recv_msg.header.version == 2 && 
+		if (bytes && rtp_session->recv_msg->header.version == 2 && 
 			!switch_test_flag(rtp_session, SWITCH_RTP_FLAG_PROXY_MEDIA) && !switch_test_flag(rtp_session, SWITCH_RTP_FLAG_UDPTL) &&
-			rtp_session->recv_msg.header.pt != 13 && 
-			rtp_session->recv_msg.header.pt != rtp_session->recv_te && 
-			(!rtp_session->cng_pt || rtp_session->recv_msg.header.pt != rtp_session->cng_pt) && 
-			rtp_session->recv_msg.header.pt != rtp_session->rpayload) {
+			rtp_session->recv_msg->header.pt != 13 && 
+			rtp_session->recv_msg->header.pt != rtp_session->recv_te && 
+			(!rtp_session->cng_pt || rtp_session->recv_msg->header.pt != rtp_session->cng_pt) && 
+			rtp_session->recv_msg->header.pt != rtp_session->rpayload) {
 			/* drop frames of incorrect payload number and return CNG frame instead */
 			return_cng_frame();
 		}
@@ -3149,7 +4326,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 			switch_clear_flag_locked(rtp_session, SWITCH_RTP_FLAG_FLUSH);
 		}
 		
-		if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_BREAK) || (bytes && bytes == 4 && *((int *) &rtp_session->recv_msg) == UINT_MAX)) {
+		if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_BREAK) || (bytes && bytes == 4 && *((int *) rtp_session->recv_msg) == UINT_MAX)) {
 			switch_clear_flag_locked(rtp_session, SWITCH_RTP_FLAG_BREAK);
 
 			if (!switch_test_flag(rtp_session, SWITCH_RTP_FLAG_NOBLOCK) || !switch_test_flag(rtp_session, SWITCH_RTP_FLAG_USE_TIMER) || 
@@ -3170,7 +4347,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 			goto recvfrom;
 		}
 
-		if (bytes && rtp_session->recv_msg.header.m && rtp_session->recv_msg.header.pt != rtp_session->recv_te && 
+		if (bytes && rtp_session->recv_msg->header.m && rtp_session->recv_msg->header.pt != rtp_session->recv_te && 
 			!switch_test_flag(rtp_session, SWITCH_RTP_FLAG_VIDEO) && !(rtp_session->rtp_bugs & RTP_BUG_IGNORE_MARK_BIT)) {
 			rtp_flush_read_buffer(rtp_session, SWITCH_RTP_FLUSH_ONCE);
 		}
@@ -3201,12 +4378,12 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 								  my_host, switch_sockaddr_get_port(rtp_session->local_addr),
 								  old_host, rtp_session->remote_port,
 								  tx_host, switch_sockaddr_get_port(rtp_session->from_addr),
-								  rtp_session->recv_msg.header.pt, ntohl(rtp_session->recv_msg.header.ts), rtp_session->recv_msg.header.m);
+								  rtp_session->recv_msg->header.pt, ntohl(rtp_session->recv_msg->header.ts), rtp_session->recv_msg->header.m);
 
 			}
 		}
 
-		if (((rtp_session->cng_pt && rtp_session->recv_msg.header.pt == rtp_session->cng_pt) || rtp_session->recv_msg.header.pt == 13)) {
+		if (((rtp_session->cng_pt && rtp_session->recv_msg->header.pt == rtp_session->cng_pt) || rtp_session->recv_msg->header.pt == 13)) {
 			*flags |= SFF_NOT_AUDIO;
 		}
 
@@ -3214,7 +4391,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 		/* ignore packets not meant for us unless the auto-adjust window is open */
 		if (bytes) {
 			if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_AUTOADJ)) {
-				if (((rtp_session->cng_pt && rtp_session->recv_msg.header.pt == rtp_session->cng_pt) || rtp_session->recv_msg.header.pt == 13)) {
+				if (((rtp_session->cng_pt && rtp_session->recv_msg->header.pt == rtp_session->cng_pt) || rtp_session->recv_msg->header.pt == 13)) {
 					goto recvfrom;
 
 				}
@@ -3287,7 +4464,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 				goto do_continue;
 			}
 			
-			if (rtp_session->recv_msg.header.pt && (rtp_session->recv_msg.header.pt == rtp_session->cng_pt || rtp_session->recv_msg.header.pt == 13)) {
+			if (rtp_session->recv_msg->header.pt && (rtp_session->recv_msg->header.pt == rtp_session->cng_pt || rtp_session->recv_msg->header.pt == 13)) {
 				return_cng_frame();
 			}
 		}
@@ -3306,29 +4483,29 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 			do_2833(rtp_session, session);
 		}
 
-		if (bytes && rtp_session->recv_msg.header.version != 2) {
-			uint8_t *data = (uint8_t *) rtp_session->recv_msg.body;
+		if (bytes && rtp_session->recv_msg->header.version != 2) {
+			uint8_t *data = (uint8_t *) rtp_session->recv_msg->body;
 
-			if (rtp_session->recv_msg.header.version == 0) {
+			if (rtp_session->recv_msg->header.version == 0) {
 				if (rtp_session->ice_user) {
-					handle_ice(rtp_session, (void *) &rtp_session->recv_msg, bytes);
+					handle_ice(rtp_session, (void *) rtp_session->recv_msg, bytes);
 					goto recvfrom;
 				} else if (rtp_session->remote_stun_addr) {
-					handle_stun_ping_reply(rtp_session, (void *) &rtp_session->recv_msg, bytes);
+					handle_stun_ping_reply(rtp_session, (void *) rtp_session->recv_msg, bytes);
 					goto recvfrom;
 				}
 			}
 
 			if (rtp_session->invalid_handler) {
-				rtp_session->invalid_handler(rtp_session, rtp_session->sock_input, (void *) &rtp_session->recv_msg, bytes, rtp_session->from_addr);
+				rtp_session->invalid_handler(rtp_session, rtp_session->sock_input, (void *) rtp_session->recv_msg, bytes, rtp_session->from_addr);
 			}
 
 			memset(data, 0, 2);
 			data[0] = 65;
 
-			rtp_session->recv_msg.header.pt = (uint32_t) rtp_session->cng_pt ? rtp_session->cng_pt : SWITCH_RTP_CNG_PAYLOAD;
+			rtp_session->recv_msg->header.pt = (uint32_t) rtp_session->cng_pt ? rtp_session->cng_pt : SWITCH_RTP_CNG_PAYLOAD;
 			*flags |= SFF_CNG;
-			*payload_type = (switch_payload_t) rtp_session->recv_msg.header.pt;
+			*payload_type = (switch_payload_t) rtp_session->recv_msg->header.pt;
 			ret = 2 + rtp_header_len;
 			goto end;
 		}
@@ -3350,7 +4527,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 	timer_check:
 
 		if (do_cng) {
-			uint8_t *data = (uint8_t *) rtp_session->recv_msg.body;
+			uint8_t *data = (uint8_t *) rtp_session->recv_msg->body;
 
 			if (rtp_session->last_cng_ts == rtp_session->last_read_ts + rtp_session->samples_per_interval) {
 				rtp_session->last_cng_ts = 0;
@@ -3360,9 +4537,9 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 
 			memset(data, 0, 2);
 			data[0] = 65;
-			rtp_session->recv_msg.header.pt = (uint32_t) rtp_session->cng_pt ? rtp_session->cng_pt : SWITCH_RTP_CNG_PAYLOAD;
+			rtp_session->recv_msg->header.pt = (uint32_t) rtp_session->cng_pt ? rtp_session->cng_pt : SWITCH_RTP_CNG_PAYLOAD;
 			*flags |= SFF_CNG;
-			*payload_type = (switch_payload_t) rtp_session->recv_msg.header.pt;
+			*payload_type = (switch_payload_t) rtp_session->recv_msg->header.pt;
 			ret = 2 + rtp_header_len;
 			rtp_session->stats.inbound.skip_packet_count++;
 			goto end;
@@ -3387,8 +4564,8 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 			return_cng_frame();
 		}
 
-		if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_GOOGLEHACK) && rtp_session->recv_msg.header.pt == 102) {
-			rtp_session->recv_msg.header.pt = 97;
+		if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_GOOGLEHACK) && rtp_session->recv_msg->header.pt == 102) {
+			rtp_session->recv_msg->header.pt = 97;
 		}
 
 		break;
@@ -3402,7 +4579,7 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 	}
 
 	if (switch_rtp_ready(rtp_session)) {
-		*payload_type = (switch_payload_t) rtp_session->recv_msg.header.pt;
+		*payload_type = (switch_payload_t) rtp_session->recv_msg->header.pt;
 
 		if (*payload_type == SWITCH_RTP_CNG_PAYLOAD) {
 			*flags |= SFF_CNG;
@@ -3539,7 +4716,7 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_read(switch_rtp_t *rtp_session, void
 
 	*datalen = bytes;
 
-	memcpy(data, rtp_session->recv_msg.body, bytes);
+	memcpy(data, rtp_session->recv_msg->body, bytes);
 
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -3553,13 +4730,18 @@ SWITCH_DECLARE(switch_status_t) switch_rtcp_zerocopy_read_frame(switch_rtp_t *rt
 
 	/* A fresh frame has been found! */
 	if (rtp_session->rtcp_fresh_frame) {
-		struct switch_rtcp_senderinfo* sr = (struct switch_rtcp_senderinfo*)rtp_session->rtcp_recv_msg.body;
+		struct switch_rtcp_senderinfo* sr;
 		/* we remove the header lenght because with directly have a pointer on the body */
-		unsigned packet_length = (ntohs((uint16_t) rtp_session->rtcp_recv_msg.header.length) + 1) * 4 - sizeof(switch_rtcp_hdr_t);
+		unsigned packet_length;
 		unsigned int reportsOffset = sizeof(struct switch_rtcp_senderinfo);
 		int i = 0;
 		unsigned int offset;
 
+		/* the reactor may be writing the next one into rtcp_recv_msg */
+		switch_mutex_lock(rtp_session->rtcp_mutex);
+		sr = (struct switch_rtcp_senderinfo*)rtp_session->rtcp_recv_msg.body;
+		packet_length = (ntohs((uint16_t) rtp_session->rtcp_recv_msg.header.length) + 1) * 4 - sizeof(switch_rtcp_hdr_t);
+
 		/* turn the flag off! */
 		rtp_session->rtcp_fresh_frame = 0;
 
@@ -3586,6 +4768,7 @@ SWITCH_DECLARE(switch_status_t) switch_rtcp_zerocopy_read_frame(switch_rtp_t *rt
 			}
 		}
 		frame->report_count = (uint16_t)i;
+		switch_mutex_unlock(rtp_session->rtcp_mutex);
 
 		return SWITCH_STATUS_SUCCESS;
 	}
@@ -3603,8 +4786,8 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_zerocopy_read_frame(switch_rtp_t *rtp
 
 	bytes = rtp_common_read(rtp_session, &frame->payload, &frame->flags, io_flags);
 
-	frame->data = rtp_session->recv_msg.body;
-	frame->packet = &rtp_session->recv_msg;
+	frame->data = rtp_session->recv_msg->body;
+	frame->packet = rtp_session->recv_msg;
 	frame->packetlen = bytes;
 	frame->source = __FILE__;
 
@@ -3612,10 +4795,11 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_zerocopy_read_frame(switch_rtp_t *rtp
 	if (frame->payload == rtp_session->recv_te) {
 		switch_set_flag(frame, SFF_RFC2833);
 	}
-	frame->timestamp = ntohl(rtp_session->recv_msg.header.ts);
-	frame->seq = (uint16_t) ntohs((uint16_t) rtp_session->recv_msg.header.seq);
-	frame->ssrc = ntohl(rtp_session->recv_msg.header.ssrc);
-	frame->m = rtp_session->recv_msg.header.m ? SWITCH_TRUE : SWITCH_FALSE;
+	frame->timestamp = ntohl(rtp_session->recv_msg->header.ts);
+	frame->seq = (uint16_t) ntohs((uint16_t) rtp_session->recv_msg->header.seq);
+	frame->ssrc = ntohl(rtp_session->recv_msg->header.ssrc);
+	frame->m = rtp_session->recv_msg->header.m ? SWITCH_TRUE : SWITCH_FALSE;
+	frame->ingress = bytes > 0 ? rtp_session->frame_ingress : 0;
 
 #ifdef ENABLE_ZRTP
 	if (zrtp_on && switch_test_flag(rtp_session, SWITCH_ZRTP_FLAG_SECURE_MITM_RECV)) {
@@ -3693,7 +4877,7 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_zerocopy_read(switch_rtp_t *rtp_sessi
 	}
 
 	bytes = rtp_common_read(rtp_session, payload_type, flags, io_flags);
-	*data = rtp_session->recv_msg.body;
+	*data = rtp_session->recv_msg->body;
 
 	if (bytes < 0) {
 		*datalen = 0;
@@ -3800,11 +4984,11 @@ static int rtp_common_write(switch_rtp_t *rtp_session,
 	send_msg->header.ssrc = htonl(rtp_session->ssrc);
 
 	if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_GOOGLEHACK) && rtp_session->send_msg.header.pt == 97) {
-		rtp_session->recv_msg.header.pt = 102;
+		rtp_session->recv_msg->header.pt = 102;
 	}
 
 	if (switch_test_flag(rtp_session, SWITCH_RTP_FLAG_VAD) &&
-		rtp_session->recv_msg.header.pt == rtp_session->vad_data.read_codec->implementation->ianacode) {
+		rtp_session->recv_msg->header.pt == rtp_session->vad_data.read_codec->implementation->ianacode) {
 
 		int16_t decoded[SWITCH_RECOMMENDED_BUFFER_SIZE / sizeof(int16_t)] = { 0 };
 		uint32_t rate = 0;
@@ -4027,7 +5211,8 @@ static int rtp_common_write(switch_rtp_t *rtp_session,
 		}
 
 
-		if (switch_socket_sendto(rtp_session->sock_output, rtp_session->remote_addr, 0, (void *) send_msg, &bytes) != SWITCH_STATUS_SUCCESS) {
+		if (rtp_sendto(rtp_session, (void *) send_msg, &bytes,
+					   switch_test_flag(rtp_session, SWITCH_RTP_FLAG_VIDEO) && send_msg->header.m) != SWITCH_STATUS_SUCCESS) {
 			rtp_session->seq--;
 			ret = -1;
 			goto end;
@@ -4057,7 +5242,14 @@ static int rtp_common_write(switch_rtp_t *rtp_session,
 			rtp_session->last_write_timestamp = switch_micro_time_now();
 		}
 		
-		if (rtp_session->rtcp_sock_output &&
+		if (rtp_session->rtcp_handle) {
+			/* the reactor builds the sender reports from these */
+			switch_atomic_set(&rtp_session->rtcp_tx_ts, ntohl(send_msg->header.ts));
+			switch_atomic_set(&rtp_session->rtcp_tx_ms, (uint32_t) (rtp_session->send_time / 1000));
+			switch_atomic_set(&rtp_session->rtcp_tx_octets,
+							  (uint32_t) (rtp_session->stats.outbound.raw_bytes - rtp_session->stats.outbound.packet_count * sizeof(srtp_hdr_t)));
+			switch_atomic_set(&rtp_session->rtcp_tx_packets, (uint32_t) rtp_session->stats.outbound.packet_count);
+		} else if (rtp_session->rtcp_sock_output &&
 			switch_test_flag(rtp_session, SWITCH_RTP_FLAG_ENABLE_RTCP) && !switch_test_flag(rtp_session, SWITCH_RTP_FLAG_RTCP_PASSTHRU) &&
 			rtp_session->rtcp_interval && (rtp_session->stats.outbound.packet_count % rtp_session->rtcp_interval) == 0) {
 			struct switch_rtcp_senderinfo* sr = (struct switch_rtcp_senderinfo*)rtp_session->rtcp_send_msg.body;
@@ -4237,9 +5429,12 @@ SWITCH_DECLARE(int) switch_rtp_write_frame(switch_rtp_t *rtp_session, switch_fra
 		  }
 		*/
 
-		if (switch_socket_sendto(rtp_session->sock_output, rtp_session->remote_addr, 0, frame->packet, &bytes) != SWITCH_STATUS_SUCCESS) {
+		WRITE_INC(rtp_session);
+		if (rtp_sendto(rtp_session, frame->packet, &bytes, SWITCH_FALSE) != SWITCH_STATUS_SUCCESS) {
+			WRITE_DEC(rtp_session);
 			return -1;
 		}
+		WRITE_DEC(rtp_session);
 
 
 		rtp_session->stats.outbound.raw_bytes += bytes;
@@ -4248,6 +5443,11 @@ SWITCH_DECLARE(int) switch_rtp_write_frame(switch_rtp_t *rtp_session, switch_fra
 		rtp_session->stats.outbound.packet_count++;
 		return (int) bytes;
 	}
+
+	/* the reactor is feeding this leg straight from its peer */
+	if (rtp_session->relay_peer) {
+		return (int) frame->datalen;
+	}
 #ifdef ENABLE_ZRTP
 	if (zrtp_on && switch_test_flag(rtp_session, SWITCH_ZRTP_FLAG_SECURE_MITM_SEND)) {
 		zrtp_session_info_t zrtp_session_info;
@@ -4361,7 +5561,14 @@ SWITCH_DECLARE(switch_rtp_stats_t *) switch_rtp_get_stats(switch_rtp_t *rtp_sess
 	}
 
 	if (rtp_session->jb) {
+		stfu_report_t r = { 0 };
+
+		stfu_n_report(rtp_session->jb, &r);
 		s->inbound.largest_jb_size = stfu_n_get_most_qlen(rtp_session->jb);
+		s->inbound.jb_size = r.qlen;
+		s->inbound.jb_target_size = r.target_qlen;
+		s->inbound.jb_plc_count = r.plc_count;
+		s->inbound.jb_jitter_ms = rtp_session->samples_per_second ? (r.jitter * 1000) / (rtp_session->samples_per_second) : 0;
 	}
 
 	return s;
@@ -4441,6 +5648,8 @@ SWITCH_DECLARE(int) switch_rtp_write_manual(switch_rtp_t *rtp_session,
 	}
 #endif
 
+	rtp_tx_batch_flush(rtp_session);
+
 	if (switch_socket_sendto(rtp_session->sock_output, rtp_session->remote_addr, 0, (void *) &rtp_session->write_msg, &bytes) != SWITCH_STATUS_SUCCESS) {
 		rtp_session->seq--;
 		ret = -1;
@@ -31,54 +31,225 @@
  */
 
 #include <switch.h>
+#include "private/switch_core_pvt.h"
 
 struct switch_scheduler_task_container {
 	switch_scheduler_task_t task;
-	int64_t executed;
-	int in_thread;
+	switch_time_t due;
+	switch_time_t executed;
+	int heap_idx;
+	int running;
 	int destroyed;
 	switch_scheduler_func_t func;
 	switch_memory_pool_t *pool;
 	uint32_t flags;
 	char *desc;
-	struct switch_scheduler_task_container *next;
+	/* the other tasks with the same group */
+	struct switch_scheduler_task_container *gnext;
+	struct switch_scheduler_task_container *gprev;
 };
 typedef struct switch_scheduler_task_container switch_scheduler_task_container_t;
 
+#define SCHED_MAX_WAIT 1000000
+#define SCHED_MAX_THREADS 64
+
 static struct {
-	switch_scheduler_task_container_t *task_list;
+	/* binary min heap on due, heap_idx tracks each task's slot so it can be pulled out from the middle */
+	switch_scheduler_task_container_t **heap;
+	int heap_count;
+	int heap_size;
+	switch_hash_t *id_hash;
+	switch_hash_t *group_hash;
 	switch_mutex_t *task_mutex;
+	switch_thread_cond_t *task_cond;
+	switch_queue_t *work_queue;
+	switch_thread_t *workers[SCHED_MAX_THREADS];
+	int worker_count;
 	uint32_t task_id;
 	int task_thread_running;
 	switch_memory_pool_t *memory_pool;
 } globals;
 
-static void switch_scheduler_execute(switch_scheduler_task_container_t *tp)
+static void heap_swap(int a, int b)
+{
+	switch_scheduler_task_container_t *tp = globals.heap[a];
+
+	globals.heap[a] = globals.heap[b];
+	globals.heap[b] = tp;
+	globals.heap[a]->heap_idx = a;
+	globals.heap[b]->heap_idx = b;
+}
+
+static void heap_up(int i)
+{
+	while (i > 0) {
+		int parent = (i - 1) / 2;
+
+		if (globals.heap[parent]->due <= globals.heap[i]->due) {
+			break;
+		}
+		heap_swap(i, parent);
+		i = parent;
+	}
+}
+
+static void heap_down(int i)
+{
+	for (;;) {
+		int left = i * 2 + 1, right = left + 1, min = i;
+
+		if (left < globals.heap_count && globals.heap[left]->due < globals.heap[min]->due) {
+			min = left;
+		}
+		if (right < globals.heap_count && globals.heap[right]->due < globals.heap[min]->due) {
+			min = right;
+		}
+		if (min == i) {
+			break;
+		}
+		heap_swap(i, min);
+		i = min;
+	}
+}
+
+static void heap_push(switch_scheduler_task_container_t *tp)
+{
+	if (globals.heap_count == globals.heap_size) {
+		int size = globals.heap_size ? globals.heap_size * 2 : 1024;
+		switch_scheduler_task_container_t **heap = realloc(globals.heap, size * sizeof(*heap));
+
+		switch_assert(heap);
+		globals.heap = heap;
+		globals.heap_size = size;
+	}
+
+	tp->heap_idx = globals.heap_count++;
+	globals.heap[tp->heap_idx] = tp;
+	heap_up(tp->heap_idx);
+
+	if (tp->heap_idx == 0) {
+		/* new earliest task, make the timer thread recompute how long to sleep */
+		switch_thread_cond_signal(globals.task_cond);
+	}
+}
+
+static void heap_remove(switch_scheduler_task_container_t *tp)
+{
+	int i = tp->heap_idx;
+
+	if (i < 0) {
+		return;
+	}
+
+	tp->heap_idx = -1;
+
+	if (i != --globals.heap_count) {
+		globals.heap[i] = globals.heap[globals.heap_count];
+		globals.heap[i]->heap_idx = i;
+		heap_down(i);
+		heap_up(i);
+	}
+}
+
+static void task_index(switch_scheduler_task_container_t *tp)
+{
+	char id[16];
+	switch_scheduler_task_container_t *head;
+
+	switch_snprintf(id, sizeof(id), "%u", tp->task.task_id);
+	switch_core_hash_insert(globals.id_hash, id, tp);
+
+	if ((head = switch_core_hash_find(globals.group_hash, tp->task.group))) {
+		tp->gnext = head;
+		head->gprev = tp;
+	}
+	switch_core_hash_insert(globals.group_hash, tp->task.group, tp);
+}
+
+static switch_scheduler_task_container_t *task_find(uint32_t task_id)
+{
+	char id[16];
+
+	switch_snprintf(id, sizeof(id), "%u", task_id);
+	return switch_core_hash_find(globals.id_hash, id);
+}
+
+/* must hold task_mutex, the task must not be running */
+static void task_free(switch_scheduler_task_container_t *tp)
+{
+	char id[16];
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Deleting task %u %s (%s)\n",
+					  tp->task.task_id, tp->desc, switch_str_nil(tp->task.group));
+
+	heap_remove(tp);
+
+	switch_snprintf(id, sizeof(id), "%u", tp->task.task_id);
+	switch_core_hash_delete(globals.id_hash, id);
+
+	if (tp->gnext) {
+		tp->gnext->gprev = tp->gprev;
+	}
+	if (tp->gprev) {
+		tp->gprev->gnext = tp->gnext;
+	} else if (tp->gnext) {
+		switch_core_hash_insert(globals.group_hash, tp->task.group, tp->gnext);
+	} else {
+		switch_core_hash_delete(globals.group_hash, tp->task.group);
+	}
+
+	switch_safe_free(tp->task.group);
+	if (tp->task.cmd_arg && switch_test_flag(tp, SSHF_FREE_ARG)) {
+		free(tp->task.cmd_arg);
+	}
+	switch_safe_free(tp->desc);
+	free(tp);
+}
+
+static void fire_task_event(switch_scheduler_task_container_t *tp, switch_event_types_t type)
 {
 	switch_event_t *event;
+
+	if (switch_event_create(&event, type) == SWITCH_STATUS_SUCCESS) {
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-ID", "%u", tp->task.task_id);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Desc", tp->desc);
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Group", switch_str_nil(tp->task.group));
+		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-Runtime", "%" SWITCH_INT64_T_FMT, tp->task.runtime);
+		switch_event_fire(&event);
+	}
+}
+
+static void switch_scheduler_execute(switch_scheduler_task_container_t *tp)
+{
+	switch_time_t due = 0;
+
 	//switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Executing task %u %s (%s)\n", tp->task.task_id, tp->desc, switch_str_nil(tp->task.group));
 
 	tp->func(&tp->task);
 
-	if (tp->task.runtime > tp->executed) {
-		tp->executed = 0;
-		if (switch_event_create(&event, SWITCH_EVENT_RE_SCHEDULE) == SWITCH_STATUS_SUCCESS) {
-			switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-ID", "%u", tp->task.task_id);
-			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Desc", tp->desc);
-			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Group", switch_str_nil(tp->task.group));
-			switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-Runtime", "%" SWITCH_INT64_T_FMT, tp->task.runtime);
-			switch_event_fire(&event);
-		}
-	} else {
-		if (switch_event_create(&event, SWITCH_EVENT_DEL_SCHEDULE) == SWITCH_STATUS_SUCCESS) {
-			switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-ID", "%u", tp->task.task_id);
-			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Desc", tp->desc);
-			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Group", switch_str_nil(tp->task.group));
-			switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-Runtime", "%" SWITCH_INT64_T_FMT, tp->task.runtime);
-			switch_event_fire(&event);
-		}
-		tp->destroyed = 1;
+	/* the callback asks to run again by moving runtime (or runtime_ms) past the time it was executed */
+	if (tp->task.runtime_ms * 1000 > tp->executed) {
+		due = tp->task.runtime_ms * 1000;
+	} else if (tp->task.runtime * 1000000 > tp->executed) {
+		due = tp->task.runtime * 1000000;
+	}
+
+	switch_mutex_lock(globals.task_mutex);
+	tp->running = 0;
+
+	if (due && !tp->destroyed && globals.task_thread_running == 1) {
+		tp->due = due;
+		heap_push(tp);
+		fire_task_event(tp, SWITCH_EVENT_RE_SCHEDULE);
+		switch_mutex_unlock(globals.task_mutex);
+		return;
+	}
+
+	if (!tp->destroyed) {
+		fire_task_event(tp, SWITCH_EVENT_DEL_SCHEDULE);
 	}
+	task_free(tp);
+	switch_mutex_unlock(globals.task_mutex);
 }
 
 static void *SWITCH_THREAD_FUNC task_own_thread(switch_thread_t *thread, void *obj)
@@ -91,87 +262,96 @@ static void *SWITCH_THREAD_FUNC task_own_thread(switch_thread_t *thread, void *o
 
 	switch_scheduler_execute(tp);
 	switch_core_destroy_memory_pool(&pool);
-	tp->in_thread = 0;
 
 	return NULL;
 }
 
-static int task_thread_loop(int done)
+static void *SWITCH_THREAD_FUNC task_worker_thread(switch_thread_t *thread, void *obj)
 {
-	switch_scheduler_task_container_t *tofree, *tp, *last = NULL;
+	void *pop;
 
+	while (switch_queue_pop(globals.work_queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		switch_scheduler_execute((switch_scheduler_task_container_t *) pop);
+	}
 
-	switch_mutex_lock(globals.task_mutex);
+	return NULL;
+}
 
-	for (tp = globals.task_list; tp; tp = tp->next) {
-		if (done) {
-			tp->destroyed = 1;
-		} else {
-			int64_t now = switch_epoch_time_now(NULL);
-			if (now >= tp->task.runtime && !tp->in_thread) {
-				int32_t diff = (int32_t) (now - tp->task.runtime);
-				if (diff > 1) {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Task was executed late by %d seconds %u %s (%s)\n",
-									  diff, tp->task.task_id, tp->desc, switch_str_nil(tp->task.group));
-				}
-				tp->executed = now;
-				if (switch_test_flag(tp, SSHF_OWN_THREAD)) {
-					switch_thread_t *thread;
-					switch_threadattr_t *thd_attr;
-					switch_core_new_memory_pool(&tp->pool);
-					switch_threadattr_create(&thd_attr, tp->pool);
-					switch_threadattr_detach_set(thd_attr, 1);
-					tp->in_thread = 1;
-					switch_thread_create(&thread, thd_attr, task_own_thread, tp, tp->pool);
-				} else {
-					switch_scheduler_execute(tp);
-				}
-			}
+/* must hold task_mutex, hands every task that is due to a worker and returns how long to sleep */
+static switch_interval_time_t task_thread_run_due(void)
+{
+	switch_time_t now = switch_micro_time_now();
+
+	while (globals.heap_count && globals.heap[0]->due <= now) {
+		switch_scheduler_task_container_t *tp = globals.heap[0];
+		int32_t diff = (int32_t) ((now - tp->due) / 1000000);
+
+		heap_remove(tp);
+
+		if (diff > 1) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Task was executed late by %d seconds %u %s (%s)\n",
+							  diff, tp->task.task_id, tp->desc, switch_str_nil(tp->task.group));
 		}
-	}
-	switch_mutex_unlock(globals.task_mutex);
-	switch_mutex_lock(globals.task_mutex);
-	for (tp = globals.task_list; tp;) {
-		if (tp->destroyed && !tp->in_thread) {
-			tofree = tp;
-			tp = tp->next;
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Deleting task %u %s (%s)\n",
-							  tofree->task.task_id, tofree->desc, switch_str_nil(tofree->task.group));
-			if (last) {
-				last->next = tofree->next;
-			} else {
-				globals.task_list = tofree->next;
-			}
-			switch_safe_free(tofree->task.group);
-			if (tofree->task.cmd_arg && switch_test_flag(tofree, SSHF_FREE_ARG)) {
-				free(tofree->task.cmd_arg);
-			}
-			switch_safe_free(tofree->desc);
-			free(tofree);
-		} else {
-			last = tp;
-			tp = tp->next;
+
+		tp->executed = now;
+		tp->running = 1;
+
+		if (switch_test_flag(tp, SSHF_OWN_THREAD)) {
+			switch_thread_t *thread;
+			switch_threadattr_t *thd_attr;
+			switch_core_new_memory_pool(&tp->pool);
+			switch_threadattr_create(&thd_attr, tp->pool);
+			switch_threadattr_detach_set(thd_attr, 1);
+			switch_thread_create(&thread, thd_attr, task_own_thread, tp, tp->pool);
+		} else if (switch_queue_trypush(globals.work_queue, tp) != SWITCH_STATUS_SUCCESS) {
+			/* the workers are swamped, run it from here rather than block the heap */
+			switch_mutex_unlock(globals.task_mutex);
+			switch_scheduler_execute(tp);
+			switch_mutex_lock(globals.task_mutex);
+			now = switch_micro_time_now();
 		}
 	}
-	switch_mutex_unlock(globals.task_mutex);
 
-	return done;
+	if (globals.heap_count && globals.heap[0]->due - now < SCHED_MAX_WAIT) {
+		return (switch_interval_time_t) (globals.heap[0]->due - now);
+	}
+
+	return SCHED_MAX_WAIT;
 }
 
 static void *SWITCH_THREAD_FUNC switch_scheduler_task_thread(switch_thread_t *thread, void *obj)
 {
+	int i;
 
 	globals.task_thread_running = 1;
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Starting task thread\n");
+
+	switch_mutex_lock(globals.task_mutex);
 	while (globals.task_thread_running == 1) {
-		if (task_thread_loop(0)) {
+		switch_interval_time_t wait = task_thread_run_due();
+
+		if (globals.task_thread_running != 1) {
 			break;
 		}
-		switch_yield(500000);
+		switch_thread_cond_timedwait(globals.task_cond, globals.task_mutex, wait);
+	}
+	switch_mutex_unlock(globals.task_mutex);
+
+	for (i = 0; i < globals.worker_count; i++) {
+		switch_queue_push(globals.work_queue, NULL);
 	}
 
-	task_thread_loop(1);
+	for (i = 0; i < globals.worker_count; i++) {
+		switch_status_t st;
+		switch_thread_join(&st, globals.workers[i]);
+	}
+
+	switch_mutex_lock(globals.task_mutex);
+	while (globals.heap_count) {
+		task_free(globals.heap[0]);
+	}
+	switch_mutex_unlock(globals.task_mutex);
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Task thread ending\n");
 	globals.task_thread_running = 0;
@@ -179,75 +359,88 @@ static void *SWITCH_THREAD_FUNC switch_scheduler_task_thread(switch_thread_t *th
 	return NULL;
 }
 
-SWITCH_DECLARE(uint32_t) switch_scheduler_add_task(time_t task_runtime,
-												   switch_scheduler_func_t func,
-												   const char *desc, const char *group, uint32_t cmd_id, void *cmd_arg, switch_scheduler_flag_t flags)
+static uint32_t add_task(switch_time_t due, int64_t task_runtime, int64_t task_runtime_ms,
+						 switch_scheduler_func_t func, const char *desc, const char *group, uint32_t cmd_id, void *cmd_arg, switch_scheduler_flag_t flags)
 {
 	switch_scheduler_task_container_t *container, *tp;
-	switch_event_t *event;
+	uint32_t task_id;
 
-	switch_mutex_lock(globals.task_mutex);
 	switch_zmalloc(container, sizeof(*container));
 	switch_assert(func);
 	container->func = func;
 	container->task.created = switch_epoch_time_now(NULL);
 	container->task.runtime = task_runtime;
+	container->task.runtime_ms = task_runtime_ms;
 	container->task.group = strdup(group ? group : "none");
 	container->task.cmd_id = cmd_id;
 	container->task.cmd_arg = cmd_arg;
 	container->flags = flags;
 	container->desc = strdup(desc ? desc : "none");
+	container->due = due;
+	container->heap_idx = -1;
 
-	for (tp = globals.task_list; tp && tp->next; tp = tp->next);
-
-	if (tp) {
-		tp->next = container;
-	} else {
-		globals.task_list = container;
-	}
+	switch_mutex_lock(globals.task_mutex);
 
-	for (container->task.task_id = 0; !container->task.task_id; container->task.task_id = ++globals.task_id);
+	do {
+		container->task.task_id = ++globals.task_id;
+	} while (!container->task.task_id || task_find(container->task.task_id));
 
-	switch_mutex_unlock(globals.task_mutex);
+	task_index(container);
+	heap_push(container);
 
 	tp = container;
+	task_id = tp->task.task_id;
+
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Added task %u %s (%s) to run at %" SWITCH_INT64_T_FMT "\n",
 					  tp->task.task_id, tp->desc, switch_str_nil(tp->task.group), tp->task.runtime);
 
-	if (switch_event_create(&event, SWITCH_EVENT_ADD_SCHEDULE) == SWITCH_STATUS_SUCCESS) {
-		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-ID", "%u", tp->task.task_id);
-		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Desc", tp->desc);
-		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Group", switch_str_nil(tp->task.group));
-		switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-Runtime", "%" SWITCH_INT64_T_FMT, tp->task.runtime);
-		switch_event_fire(&event);
+	fire_task_event(tp, SWITCH_EVENT_ADD_SCHEDULE);
+
+	switch_mutex_unlock(globals.task_mutex);
+
+	return task_id;
+}
+
+SWITCH_DECLARE(uint32_t) switch_scheduler_add_task(time_t task_runtime,
+												   switch_scheduler_func_t func,
+												   const char *desc, const char *group, uint32_t cmd_id, void *cmd_arg, switch_scheduler_flag_t flags)
+{
+	return add_task((switch_time_t) task_runtime * 1000000, task_runtime, 0, func, desc, group, cmd_id, cmd_arg, flags);
+}
+
+SWITCH_DECLARE(uint32_t) switch_scheduler_add_task_ms(int64_t task_runtime_ms,
+													  switch_scheduler_func_t func,
+													  const char *desc, const char *group, uint32_t cmd_id, void *cmd_arg, switch_scheduler_flag_t flags)
+{
+	return add_task((switch_time_t) task_runtime_ms * 1000, task_runtime_ms / 1000, task_runtime_ms, func, desc, group, cmd_id, cmd_arg, flags);
+}
+
+/* must hold task_mutex */
+static void del_task(switch_scheduler_task_container_t *tp)
+{
+	fire_task_event(tp, SWITCH_EVENT_DEL_SCHEDULE);
+
+	if (tp->running) {
+		/* whoever is running it frees it when the callback returns */
+		tp->destroyed++;
+	} else {
+		task_free(tp);
 	}
-	return container->task.task_id;
 }
 
 SWITCH_DECLARE(uint32_t) switch_scheduler_del_task_id(uint32_t task_id)
 {
 	switch_scheduler_task_container_t *tp;
-	switch_event_t *event;
 	uint32_t delcnt = 0;
 
 	switch_mutex_lock(globals.task_mutex);
-	for (tp = globals.task_list; tp; tp = tp->next) {
-		if (tp->task.task_id == task_id) {
-			if (switch_test_flag(tp, SSHF_NO_DEL)) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Attempt made to delete undeletable task #%u (group %s)\n",
-								  tp->task.task_id, tp->task.group);
-				break;
-			}
-			tp->destroyed++;
-			if (switch_event_create(&event, SWITCH_EVENT_DEL_SCHEDULE) == SWITCH_STATUS_SUCCESS) {
-				switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-ID", "%u", tp->task.task_id);
-				switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Desc", tp->desc);
-				switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Group", switch_str_nil(tp->task.group));
-				switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-Runtime", "%" SWITCH_INT64_T_FMT, tp->task.runtime);
-				switch_event_fire(&event);
-			}
+	if ((tp = task_find(task_id)) && !tp->destroyed) {
+		if (switch_test_flag(tp, SSHF_NO_DEL)) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Attempt made to delete undeletable task #%u (group %s)\n",
+							  tp->task.task_id, tp->task.group);
+		} else {
+			del_task(tp);
 			delcnt++;
-			break;
 		}
 	}
 	switch_mutex_unlock(globals.task_mutex);
@@ -257,28 +450,29 @@ SWITCH_DECLARE(uint32_t) switch_scheduler_del_task_id(uint32_t task_id)
 
 SWITCH_DECLARE(uint32_t) switch_scheduler_del_task_group(const char *group)
 {
-	switch_scheduler_task_container_t *tp;
-	switch_event_t *event;
+	switch_scheduler_task_container_t *tp, *next;
 	uint32_t delcnt = 0;
 
+	if (zstr(group)) {
+		return 0;
+	}
+
 	switch_mutex_lock(globals.task_mutex);
-	for (tp = globals.task_list; tp; tp = tp->next) {
-		if (!zstr(group) && !strcmp(tp->task.group, group)) {
-			if (switch_test_flag(tp, SSHF_NO_DEL)) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Attempt made to delete undeletable task #%u (group %s)\n",
-								  tp->task.task_id, group);
-				continue;
-			}
-			if (switch_event_create(&event, SWITCH_EVENT_DEL_SCHEDULE) == SWITCH_STATUS_SUCCESS) {
-				switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-ID", "%u", tp->task.task_id);
-				switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Desc", tp->desc);
-				switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Task-Group", switch_str_nil(tp->task.group));
-				switch_event_add_header(event, SWITCH_STACK_BOTTOM, "Task-Runtime", "%" SWITCH_INT64_T_FMT, tp->task.runtime);
-				switch_event_fire(&event);
-			}
-			tp->destroyed++;
-			delcnt++;
+	for (tp = switch_core_hash_find(globals.group_hash, group); tp; tp = next) {
+		next = tp->gnext;
+
+		if (tp->destroyed) {
+			continue;
+		}
+
+		if (switch_test_flag(tp, SSHF_NO_DEL)) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Attempt made to delete undeletable task #%u (group %s)\n",
+							  tp->task.task_id, group);
+			continue;
 		}
+
+		del_task(tp);
+		delcnt++;
 	}
 	switch_mutex_unlock(globals.task_mutex);
 
@@ -291,10 +485,30 @@ SWITCH_DECLARE(void) switch_scheduler_task_thread_start(void)
 {
 
 	switch_threadattr_t *thd_attr;
+	int i;
 
 	switch_core_new_memory_pool(&globals.memory_pool);
 	switch_threadattr_create(&thd_attr, globals.memory_pool);
 	switch_mutex_init(&globals.task_mutex, SWITCH_MUTEX_NESTED, globals.memory_pool);
+	switch_thread_cond_create(&globals.task_cond, globals.memory_pool);
+	switch_core_hash_init(&globals.id_hash, NULL);
+	switch_core_hash_init(&globals.group_hash, NULL);
+	switch_queue_create(&globals.work_queue, SWITCH_CORE_QUEUE_LEN, globals.memory_pool);
+
+	globals.worker_count = runtime.sched_threads;
+	if (globals.worker_count < 1) {
+		globals.worker_count = 1;
+	} else if (globals.worker_count > SCHED_MAX_THREADS) {
+		globals.worker_count = SCHED_MAX_THREADS;
+	}
+
+	for (i = 0; i < globals.worker_count; i++) {
+		switch_threadattr_t *worker_attr;
+
+		switch_threadattr_create(&worker_attr, globals.memory_pool);
+		switch_threadattr_stacksize_set(worker_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.workers[i], worker_attr, task_worker_thread, NULL, globals.memory_pool);
+	}
 
 	switch_threadattr_detach_set(thd_attr, 1);
 	switch_thread_create(&task_thread_p, thd_attr, switch_scheduler_task_thread, NULL, globals.memory_pool);
@@ -307,7 +521,10 @@ SWITCH_DECLARE(void) switch_scheduler_task_thread_stop(void)
 		int sanity = 0;
 		switch_status_t st;
 
+		switch_mutex_lock(globals.task_mutex);
 		globals.task_thread_running = -1;
+		switch_thread_cond_signal(globals.task_cond);
+		switch_mutex_unlock(globals.task_mutex);
 
 		switch_thread_join(&st, task_thread_p);
 
@@ -0,0 +1,547 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2012, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * switch_snapshot.c - Runtime state kept across a restart
+ *
+ * At shutdown every registered owner writes its records into one file, at the
+ * next start the file is mapped before the modules load and each owner gets its
+ * records back when it registers.  A snapshot is used once and only when it is
+ * younger than the configured max age, anything else starts cold.
+ *
+ */
+
+#include <switch.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+#define SNAPSHOT_MAGIC 0x50534653
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_NAME_LEN 64
+#define SNAPSHOT_ALIGN(_n) (((_n) + 7) & ~((uint64_t) 7))
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	int64_t saved;				/* epoch seconds */
+	uint32_t section_count;
+	uint32_t pad;
+} snapshot_header_t;
+
+/* followed by record_count records of a uint32_t length and the data, each padded to 8 bytes */
+typedef struct {
+	char name[SNAPSHOT_NAME_LEN];
+	uint32_t version;
+	uint32_t record_count;
+	uint64_t len;
+} snapshot_section_t;
+
+struct switch_snapshot_writer {
+	FILE *f;
+	uint32_t record_count;
+	uint64_t len;
+	switch_status_t status;
+};
+
+typedef struct snapshot_owner {
+	char *name;
+	uint32_t version;
+	switch_snapshot_save_callback_t save;
+	switch_snapshot_load_callback_t load;
+	void *user_data;
+	struct snapshot_owner *next;
+} snapshot_owner_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_thread_rwlock_t *map_rwlock;
+	snapshot_owner_t *owners;
+	switch_bool_t enabled;
+	uint32_t max_age;
+	char *map;
+	switch_size_t map_len;
+	uint32_t age;
+	snapshot_section_t **sections;
+	uint8_t *consumed;
+	uint32_t section_count;
+} SNAPSHOT;
+
+static char *snapshot_path(void)
+{
+	return switch_mprintf("%s%sstate.snapshot", SWITCH_GLOBAL_dirs.db_dir, SWITCH_PATH_SEPARATOR);
+}
+
+SWITCH_DECLARE(void) switch_snapshot_set_enabled(switch_bool_t enabled)
+{
+	SNAPSHOT.enabled = enabled;
+}
+
+SWITCH_DECLARE(void) switch_snapshot_set_max_age(uint32_t seconds)
+{
+	SNAPSHOT.max_age = seconds;
+}
+
+static void snapshot_unmap(void)
+{
+	if (SNAPSHOT.map) {
+#ifndef WIN32
+		munmap(SNAPSHOT.map, SNAPSHOT.map_len);
+#else
+		free(SNAPSHOT.map);
+#endif
+	}
+	SNAPSHOT.map = NULL;
+	SNAPSHOT.map_len = 0;
+	switch_safe_free(SNAPSHOT.sections);
+	switch_safe_free(SNAPSHOT.consumed);
+	SNAPSHOT.section_count = 0;
+}
+
+/* checks every section and record against the length of the file so nothing read later can run past it */
+static switch_bool_t snapshot_index(void)
+{
+	snapshot_header_t *header = (snapshot_header_t *) SNAPSHOT.map;
+	uint64_t off = sizeof(*header);
+	uint32_t i, r;
+
+	if (SNAPSHOT.map_len < sizeof(*header) || header->magic != SNAPSHOT_MAGIC || header->version != SNAPSHOT_VERSION ||
+		header->section_count > 4096) {
+		return SWITCH_FALSE;
+	}
+
+	switch_zmalloc(SNAPSHOT.sections, (header->section_count + 1) * sizeof(*SNAPSHOT.sections));
+	switch_zmalloc(SNAPSHOT.consumed, header->section_count + 1);
+
+	for (i = 0; i < header->section_count; i++) {
+		snapshot_section_t *section;
+		uint64_t end, roff;
+
+		if (off + sizeof(*section) > SNAPSHOT.map_len) {
+			return SWITCH_FALSE;
+		}
+
+		section = (snapshot_section_t *) (SNAPSHOT.map + off);
+		off += sizeof(*section);
+		end = off + section->len;
+
+		if (end > SNAPSHOT.map_len || end < off || !memchr(section->name, '\0', sizeof(section->name))) {
+			return SWITCH_FALSE;
+		}
+
+		for (r = 0, roff = off; r < section->record_count; r++) {
+			uint32_t len;
+
+			if (roff + sizeof(len) > end) {
+				return SWITCH_FALSE;
+			}
+			memcpy(&len, SNAPSHOT.map + roff, sizeof(len));
+			roff = SNAPSHOT_ALIGN(roff + sizeof(len) + len);
+			if (roff > end) {
+				return SWITCH_FALSE;
+			}
+		}
+
+		SNAPSHOT.sections[SNAPSHOT.section_count++] = section;
+		off = end;
+	}
+
+	return SWITCH_TRUE;
+}
+
+/* hands an owner its saved records, called with the map read locked */
+static void snapshot_restore(snapshot_owner_t *owner)
+{
+	snapshot_section_t *section = NULL;
+	uint64_t off;
+	uint32_t i, r, restored = 0;
+
+	if (!SNAPSHOT.map || !owner->load) {
+		return;
+	}
+
+	switch_mutex_lock(SNAPSHOT.mutex);
+	for (i = 0; i < SNAPSHOT.section_count; i++) {
+		if (!SNAPSHOT.consumed[i] && !strcmp(SNAPSHOT.sections[i]->name, owner->name)) {
+			SNAPSHOT.consumed[i] = 1;
+			section = SNAPSHOT.sections[i];
+			break;
+		}
+	}
+	switch_mutex_unlock(SNAPSHOT.mutex);
+
+	if (!section) {
+		return;
+	}
+
+	if (section->version != owner->version) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Not restoring %s, the snapshot has version %u and it wants %u\n",
+						  owner->name, section->version, owner->version);
+		return;
+	}
+
+	off = (uint64_t) ((char *) (section + 1) - SNAPSHOT.map);
+	for (r = 0; r < section->record_count; r++) {
+		uint32_t len;
+
+		memcpy(&len, SNAPSHOT.map + off, sizeof(len));
+		if (owner->load(SNAPSHOT.map + off + sizeof(len), len, SNAPSHOT.age, owner->user_data) == SWITCH_STATUS_SUCCESS) {
+			restored++;
+		}
+		off = SNAPSHOT_ALIGN(off + sizeof(len) + len);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Restored %u of %u records for %s from a %u second old snapshot\n",
+					  restored, section->record_count, owner->name, SNAPSHOT.age);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_snapshot_register(const char *name, uint32_t version, switch_snapshot_save_callback_t save,
+														 switch_snapshot_load_callback_t load, void *user_data)
+{
+	snapshot_owner_t *owner;
+
+	if (zstr(name) || strlen(name) >= SNAPSHOT_NAME_LEN || !save) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(SNAPSHOT.mutex);
+	for (owner = SNAPSHOT.owners; owner; owner = owner->next) {
+		if (!strcmp(owner->name, name)) {
+			switch_mutex_unlock(SNAPSHOT.mutex);
+			return SWITCH_STATUS_FALSE;
+		}
+	}
+
+	switch_zmalloc(owner, sizeof(*owner));
+	owner->name = strdup(name);
+	owner->version = version;
+	owner->save = save;
+	owner->load = load;
+	owner->user_data = user_data;
+	owner->next = SNAPSHOT.owners;
+	SNAPSHOT.owners = owner;
+	switch_mutex_unlock(SNAPSHOT.mutex);
+
+	switch_thread_rwlock_rdlock(SNAPSHOT.map_rwlock);
+	snapshot_restore(owner);
+	switch_thread_rwlock_unlock(SNAPSHOT.map_rwlock);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_snapshot_unregister(const char *name)
+{
+	snapshot_owner_t *owner, *last = NULL;
+
+	switch_mutex_lock(SNAPSHOT.mutex);
+	for (owner = SNAPSHOT.owners; owner; owner = owner->next) {
+		if (!strcmp(owner->name, name)) {
+			if (last) {
+				last->next = owner->next;
+			} else {
+				SNAPSHOT.owners = owner->next;
+			}
+			break;
+		}
+		last = owner;
+	}
+	switch_mutex_unlock(SNAPSHOT.mutex);
+
+	if (!owner) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	free(owner->name);
+	free(owner);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_snapshot_write(switch_snapshot_writer_t *writer, const void *data, switch_size_t len)
+{
+	static const char zeros[8] = { 0 };
+	uint32_t rlen = (uint32_t) len;
+	uint64_t pad;
+
+	if (writer->status != SWITCH_STATUS_SUCCESS || len > 0x7fffffff) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	pad = SNAPSHOT_ALIGN(sizeof(rlen) + len) - (sizeof(rlen) + len);
+
+	if (fwrite(&rlen, sizeof(rlen), 1, writer->f) != 1 || (len && fwrite(data, len, 1, writer->f) != 1) ||
+		(pad && fwrite(zeros, (size_t) pad, 1, writer->f) != 1)) {
+		writer->status = SWITCH_STATUS_FALSE;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	writer->record_count++;
+	writer->len += sizeof(rlen) + len + pad;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_snapshot_save(void)
+{
+	snapshot_header_t header = { 0 };
+	snapshot_owner_t *owner;
+	char *path, *tmp;
+	FILE *f;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (!SNAPSHOT.enabled) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	path = snapshot_path();
+	tmp = switch_mprintf("%s.tmp", path);
+
+	if (!(f = fopen(tmp, "wb"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot write state snapshot %s\n", tmp);
+		goto end;
+	}
+
+	header.magic = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.saved = (int64_t) switch_epoch_time_now(NULL);
+
+	if (fwrite(&header, sizeof(header), 1, f) != 1) {
+		goto fail;
+	}
+
+	switch_mutex_lock(SNAPSHOT.mutex);
+	for (owner = SNAPSHOT.owners; owner; owner = owner->next) {
+		snapshot_section_t section = { {0} };
+		switch_snapshot_writer_t writer = { 0 };
+		long start = ftell(f);
+
+		switch_copy_string(section.name, owner->name, sizeof(section.name));
+		section.version = owner->version;
+
+		if (start < 0 || fwrite(&section, sizeof(section), 1, f) != 1) {
+			switch_mutex_unlock(SNAPSHOT.mutex);
+			goto fail;
+		}
+
+		writer.f = f;
+		writer.status = SWITCH_STATUS_SUCCESS;
+
+		if (owner->save(&writer, owner->user_data) != SWITCH_STATUS_SUCCESS || writer.status != SWITCH_STATUS_SUCCESS) {
+			/* an owner that cannot save is left out, the others still go in */
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Leaving %s out of the state snapshot\n", owner->name);
+			if (fseek(f, start, SEEK_SET) != 0) {
+				switch_mutex_unlock(SNAPSHOT.mutex);
+				goto fail;
+			}
+			continue;
+		}
+
+		section.record_count = writer.record_count;
+		section.len = writer.len;
+
+		if (fseek(f, start, SEEK_SET) != 0 || fwrite(&section, sizeof(section), 1, f) != 1 || fseek(f, 0, SEEK_END) != 0) {
+			switch_mutex_unlock(SNAPSHOT.mutex);
+			goto fail;
+		}
+
+		header.section_count++;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Saved %u records for %s\n", section.record_count, owner->name);
+	}
+	switch_mutex_unlock(SNAPSHOT.mutex);
+
+	/* whatever an owner that was left out wrote past the last section is never indexed */
+	if (fseek(f, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, f) != 1) {
+		goto fail;
+	}
+
+	if (fclose(f) != 0) {
+		f = NULL;
+		goto fail;
+	}
+	f = NULL;
+
+	if (rename(tmp, path) != 0) {
+		goto fail;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Saved state snapshot %s with %u sections\n", path, header.section_count);
+	status = SWITCH_STATUS_SUCCESS;
+	goto end;
+
+  fail:
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error writing state snapshot %s\n", tmp);
+	if (f) {
+		fclose(f);
+	}
+	unlink(tmp);
+
+  end:
+
+	switch_safe_free(tmp);
+	switch_safe_free(path);
+
+	return status;
+}
+
+SWITCH_DECLARE(void) switch_snapshot_open(void)
+{
+	snapshot_header_t *header;
+	snapshot_owner_t *owner;
+	struct stat st;
+	char *path;
+	FILE *f;
+	int64_t now;
+
+	if (!SNAPSHOT.enabled) {
+		return;
+	}
+
+	path = snapshot_path();
+
+	if (!(f = fopen(path, "rb"))) {
+		switch_safe_free(path);
+		return;
+	}
+
+	switch_thread_rwlock_wrlock(SNAPSHOT.map_rwlock);
+	snapshot_unmap();
+
+	if (fstat(fileno(f), &st) != 0 || st.st_size < (off_t) sizeof(snapshot_header_t)) {
+		goto end;
+	}
+
+	SNAPSHOT.map_len = (switch_size_t) st.st_size;
+#ifndef WIN32
+	if ((SNAPSHOT.map = mmap(NULL, SNAPSHOT.map_len, PROT_READ, MAP_SHARED, fileno(f), 0)) == MAP_FAILED) {
+		SNAPSHOT.map = NULL;
+		goto end;
+	}
+#else
+	if (!(SNAPSHOT.map = malloc(SNAPSHOT.map_len)) || fread(SNAPSHOT.map, 1, SNAPSHOT.map_len, f) != SNAPSHOT.map_len) {
+		switch_safe_free(SNAPSHOT.map);
+		goto end;
+	}
+#endif
+
+	if (!snapshot_index()) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Ignoring invalid state snapshot %s\n", path);
+		snapshot_unmap();
+		goto end;
+	}
+
+	header = (snapshot_header_t *) SNAPSHOT.map;
+	now = (int64_t) switch_epoch_time_now(NULL);
+	SNAPSHOT.age = now > header->saved ? (uint32_t) (now - header->saved) : 0;
+
+	if (SNAPSHOT.max_age && SNAPSHOT.age > SNAPSHOT.max_age) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Ignoring state snapshot %s, it is %u seconds old\n", path, SNAPSHOT.age);
+		snapshot_unmap();
+		goto end;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Opened state snapshot %s with %u sections\n", path, SNAPSHOT.section_count);
+
+  end:
+
+	fclose(f);
+	/* a snapshot is only ever used once, the mapping outlives the name */
+	unlink(path);
+	switch_safe_free(path);
+	switch_thread_rwlock_unlock(SNAPSHOT.map_rwlock);
+
+	switch_thread_rwlock_rdlock(SNAPSHOT.map_rwlock);
+	switch_mutex_lock(SNAPSHOT.mutex);
+	for (owner = SNAPSHOT.owners; owner; owner = owner->next) {
+		snapshot_restore(owner);
+	}
+	switch_mutex_unlock(SNAPSHOT.mutex);
+	switch_thread_rwlock_unlock(SNAPSHOT.map_rwlock);
+}
+
+SWITCH_DECLARE(void) switch_snapshot_release(void)
+{
+	uint32_t i;
+
+	switch_thread_rwlock_wrlock(SNAPSHOT.map_rwlock);
+	for (i = 0; i < SNAPSHOT.section_count; i++) {
+		if (!SNAPSHOT.consumed[i]) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Nothing registered for the %s state in the snapshot\n", SNAPSHOT.sections[i]->name);
+		}
+	}
+	snapshot_unmap();
+	switch_thread_rwlock_unlock(SNAPSHOT.map_rwlock);
+}
+
+SWITCH_DECLARE(void) switch_snapshot_dump(switch_stream_handle_t *stream)
+{
+	snapshot_owner_t *owner;
+
+	stream->write_function(stream, "state snapshot is %s, max age %us\n", SNAPSHOT.enabled ? "enabled" : "disabled", SNAPSHOT.max_age);
+
+	switch_mutex_lock(SNAPSHOT.mutex);
+	for (owner = SNAPSHOT.owners; owner; owner = owner->next) {
+		stream->write_function(stream, "%s version %u%s\n", owner->name, owner->version, owner->load ? "" : " (save only)");
+	}
+	switch_mutex_unlock(SNAPSHOT.mutex);
+}
+
+SWITCH_DECLARE(void) switch_snapshot_init(switch_memory_pool_t *pool)
+{
+	memset(&SNAPSHOT, 0, sizeof(SNAPSHOT));
+	SNAPSHOT.pool = pool;
+	SNAPSHOT.max_age = 300;
+	switch_mutex_init(&SNAPSHOT.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_thread_rwlock_create(&SNAPSHOT.map_rwlock, pool);
+}
+
+SWITCH_DECLARE(void) switch_snapshot_shutdown(void)
+{
+	snapshot_owner_t *owner;
+
+	switch_thread_rwlock_wrlock(SNAPSHOT.map_rwlock);
+	snapshot_unmap();
+	switch_thread_rwlock_unlock(SNAPSHOT.map_rwlock);
+
+	switch_mutex_lock(SNAPSHOT.mutex);
+	while ((owner = SNAPSHOT.owners)) {
+		SNAPSHOT.owners = owner->next;
+		free(owner->name);
+		free(owner);
+	}
+	switch_mutex_unlock(SNAPSHOT.mutex);
+}
+
+/* For Emacs:
+ * Local Variables:
+ * mode:c
+ * indent-tabs-mode:t
+ * tab-width:4
+ * c-basic-offset:4
+ * End:
+ * For VIM:
+ * vim:set softtabstop=4 shiftwidth=4 tabstop=4:
+ */
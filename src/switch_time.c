@@ -120,11 +120,25 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(softtimer_shutdown);
 SWITCH_MODULE_RUNTIME_FUNCTION(softtimer_runtime);
 SWITCH_MODULE_DEFINITION(CORE_SOFTTIMER_MODULE, softtimer_load, softtimer_shutdown, softtimer_runtime);
 
+/* with timer-shards set the 1ms cond only wakes one thread per shard, which in turn wakes the timers assigned to it */
+struct timer_shard {
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+	switch_thread_t *thread;
+	uint32_t count;
+	int cpu;
+};
+typedef struct timer_shard timer_shard_t;
+
+static timer_shard_t *SHARDS = NULL;
+static int SHARD_COUNT = 0;
+
 struct timer_private {
 	switch_size_t reference;
 	switch_size_t start;
 	uint32_t roll;
 	uint32_t ready;
+	timer_shard_t *shard;
 };
 typedef struct timer_private timer_private_t;
 
@@ -528,6 +542,17 @@ static switch_status_t timer_init(switch_timer_t *timer)
 			switch_thread_cond_create(&TIMER_MATRIX[timer->interval].cond, module_pool);
 		}
 		TIMER_MATRIX[timer->interval].count++;
+		if (SHARD_COUNT) {
+			int x;
+
+			private_info->shard = &SHARDS[0];
+			for (x = 1; x < SHARD_COUNT; x++) {
+				if (SHARDS[x].count < private_info->shard->count) {
+					private_info->shard = &SHARDS[x];
+				}
+			}
+			private_info->shard->count++;
+		}
 		switch_mutex_unlock(globals.mutex);
 		timer->private_info = private_info;
 		private_info->start = private_info->reference = TIMER_MATRIX[timer->interval].tick;
@@ -636,7 +661,13 @@ static switch_status_t timer_next(switch_timer_t *timer)
 			switch_os_yield();
 			globals.use_cond_yield = 0;
 		} else {
-			if (globals.use_cond_yield == 1) {
+			if (globals.use_cond_yield == 1 && private_info->shard && cond_index == 1) {
+				switch_mutex_lock(private_info->shard->mutex);
+				if (TIMER_MATRIX[timer->interval].tick < private_info->reference) {
+					switch_thread_cond_wait(private_info->shard->cond, private_info->shard->mutex);
+				}
+				switch_mutex_unlock(private_info->shard->mutex);
+			} else if (globals.use_cond_yield == 1) {
 				switch_mutex_lock(TIMER_MATRIX[cond_index].mutex);
 				if (TIMER_MATRIX[timer->interval].tick < private_info->reference) {
 					switch_thread_cond_wait(TIMER_MATRIX[cond_index].cond, TIMER_MATRIX[cond_index].mutex);
@@ -697,6 +728,10 @@ static switch_status_t timer_destroy(switch_timer_t *timer)
 	}
 
 	switch_mutex_lock(globals.mutex);
+	if (private_info && private_info->shard) {
+		private_info->shard->count--;
+		private_info->shard = NULL;
+	}
 	if (globals.timer_count) {
 		globals.timer_count--;
 		if (runtime.tipping_point && globals.timer_count == (runtime.tipping_point - 1)) {
@@ -757,6 +792,83 @@ static void win32_init_timers(void)
 #endif
 }
 
+static void *SWITCH_THREAD_FUNC timer_shard_thread(switch_thread_t *thread, void *obj)
+{
+	timer_shard_t *shard = (timer_shard_t *) obj;
+	switch_size_t tick = 0;
+
+	if (shard->cpu > -1) {
+		switch_core_thread_set_cpu_affinity(shard->cpu);
+	}
+
+	while (globals.RUNNING == 1) {
+		switch_mutex_lock(TIMER_MATRIX[1].mutex);
+		if (tick == TIMER_MATRIX[1].tick && globals.RUNNING == 1) {
+			switch_thread_cond_wait(TIMER_MATRIX[1].cond, TIMER_MATRIX[1].mutex);
+		}
+		tick = TIMER_MATRIX[1].tick;
+		switch_mutex_unlock(TIMER_MATRIX[1].mutex);
+
+		switch_mutex_lock(shard->mutex);
+		switch_thread_cond_broadcast(shard->cond);
+		switch_mutex_unlock(shard->mutex);
+	}
+
+	switch_mutex_lock(shard->mutex);
+	switch_thread_cond_broadcast(shard->cond);
+	switch_mutex_unlock(shard->mutex);
+
+	return NULL;
+}
+
+static void start_timer_shards(void)
+{
+	int x, count = runtime.timer_shards;
+
+	if (count < 0) {
+		count = runtime.cpu_count;
+	}
+
+	if (count < 2 || !TIMER_MATRIX[1].mutex) {
+		return;
+	}
+
+	SHARDS = switch_core_alloc(module_pool, sizeof(*SHARDS) * count);
+
+	for (x = 0; x < count; x++) {
+		switch_threadattr_t *thd_attr;
+
+		SHARDS[x].cpu = runtime.cpu_count > 1 ? x % runtime.cpu_count : -1;
+		switch_mutex_init(&SHARDS[x].mutex, SWITCH_MUTEX_NESTED, module_pool);
+		switch_thread_cond_create(&SHARDS[x].cond, module_pool);
+		switch_threadattr_create(&thd_attr, module_pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_threadattr_priority_increase(thd_attr);
+		switch_thread_create(&SHARDS[x].thread, thd_attr, timer_shard_thread, &SHARDS[x], module_pool);
+	}
+
+	SHARD_COUNT = count;
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Spreading timer wakeups over %d shards\n", count);
+}
+
+static void stop_timer_shards(void)
+{
+	int x;
+
+	if (!SHARD_COUNT) {
+		return;
+	}
+
+	switch_mutex_lock(TIMER_MATRIX[1].mutex);
+	switch_thread_cond_broadcast(TIMER_MATRIX[1].cond);
+	switch_mutex_unlock(TIMER_MATRIX[1].mutex);
+
+	for (x = 0; x < SHARD_COUNT; x++) {
+		switch_status_t st;
+		switch_thread_join(&st, SHARDS[x].thread);
+	}
+}
+
 SWITCH_MODULE_RUNTIME_FUNCTION(softtimer_runtime)
 {
 	switch_time_t too_late = runtime.microseconds_per_tick * 1000;
@@ -843,6 +955,12 @@ SWITCH_MODULE_RUNTIME_FUNCTION(softtimer_runtime)
 	globals.use_cond_yield = COND;
 	globals.RUNNING = 1;
 
+#ifndef DISABLE_1MS_COND
+	if (globals.use_cond_yield == 1) {
+		start_timer_shards();
+	}
+#endif
+
 	while (globals.RUNNING == 1) {
 
 #ifdef HAVE_TIMERFD_CREATE
@@ -950,6 +1068,7 @@ SWITCH_MODULE_RUNTIME_FUNCTION(softtimer_runtime)
 		if (tick >= (1000000 / runtime.microseconds_per_tick)) {
 			if (++profile_tick == 1) {
 				switch_get_system_idle_time(runtime.profile_timer, &runtime.profile_time);
+				switch_core_sample_load_sources();
 				profile_tick = 0;
 			}
 			
@@ -1010,6 +1129,8 @@ SWITCH_MODULE_RUNTIME_FUNCTION(softtimer_runtime)
 		}
 	}
 
+	stop_timer_shards();
+
 	if (tfd > -1) {
 		close(tfd);
 		tfd = -1;
@@ -46,12 +46,32 @@ struct switch_network_node {
 	switch_bool_t ok;
 	char *token;
 	char *str;
+	uint32_t seq;
 	struct switch_network_node *next;
+	struct switch_network_node *loose_next;
 };
 typedef struct switch_network_node switch_network_node_t;
 
+/*
+ * Path compressed binary trie over the prefix bits, most significant first.  Nodes without an entry only join
+ * two branches, so a list of n prefixes never has more than 2n nodes and a lookup visits at most one node per
+ * bit of the address.
+ */
+struct switch_network_trie {
+	uint32_t key[4];
+	uint32_t bits;
+	switch_network_node_t *node;
+	struct switch_network_trie *child[2];
+};
+typedef struct switch_network_trie switch_network_trie_t;
+
 struct switch_network_list {
 	struct switch_network_node *node_head;
+	switch_network_trie_t *trie4;
+	switch_network_trie_t *trie6;
+	/* ipv4 host/mask entries whose mask has holes can't go in the trie */
+	struct switch_network_node *loose_head;
+	uint32_t seq;
 	switch_bool_t default_type;
 	switch_memory_pool_t *pool;
 	char *name;
@@ -68,7 +88,9 @@ SWITCH_DECLARE(switch_status_t) switch_frame_alloc(switch_frame_t **frame, switc
 {
 	switch_frame_t *new_frame;
 
-	switch_zmalloc(new_frame, sizeof(*new_frame));
+	new_frame = switch_slab_alloc(runtime.frame_slab);
+	switch_assert(new_frame);
+	memset(new_frame, 0, sizeof(*new_frame));
 
 	switch_set_flag(new_frame, SFF_DYNAMIC);
 	new_frame->buflen = size;
@@ -91,7 +113,7 @@ SWITCH_DECLARE(switch_status_t) switch_frame_dup(switch_frame_t *orig, switch_fr
 
 	switch_assert(orig->buflen);
 
-	new_frame = malloc(sizeof(*new_frame));
+	new_frame = switch_slab_alloc(runtime.frame_slab);
 
 	switch_assert(new_frame);
 
@@ -116,7 +138,7 @@ SWITCH_DECLARE(switch_status_t) switch_frame_free(switch_frame_t **frame)
 	}
 
 	switch_safe_free((*frame)->data);
-	free(*frame);
+	switch_slab_free(runtime.frame_slab, *frame);
 	*frame = NULL;
 
 	return SWITCH_STATUS_SUCCESS;
@@ -206,56 +228,184 @@ SWITCH_DECLARE(switch_bool_t) switch_testv6_subnet(ip_t _ip, ip_t _net, ip_t _ma
 			else return SWITCH_TRUE;
 		}
 }
-SWITCH_DECLARE(switch_bool_t) switch_network_list_validate_ip6_token(switch_network_list_t *list, ip_t ip, const char **token)
+static inline uint32_t trie_bit(const uint32_t *key, uint32_t bit)
+{
+	return (key[bit / 32] >> (31 - (bit % 32))) & 1;
+}
+
+/* number of leading bits, up to max, that a and b have in common */
+static uint32_t trie_common_bits(const uint32_t *a, const uint32_t *b, uint32_t max)
 {
-	switch_network_node_t *node;
-	switch_bool_t ok = list->default_type;
 	uint32_t bits = 0;
+	int i;
 
-	for (node = list->node_head; node; node = node->next) {
-		if (node->family == AF_INET) continue;
-		if (node->bits > bits && switch_testv6_subnet(ip, node->ip, node->mask)) {
-			if (node->ok) {
-				ok = SWITCH_TRUE;
-			} else {
-				ok = SWITCH_FALSE;
-			}
+	for (i = 0; i < 4 && bits < max; i++) {
+		uint32_t diff = a[i] ^ b[i];
 
-			bits = node->bits;
+		if (!diff) {
+			bits += 32;
+			continue;
+		}
 
-			if (token) {
-				*token = node->token;
-			}
+		while (!(diff & 0x80000000)) {
+			diff <<= 1;
+			bits++;
 		}
+		break;
 	}
 
-	return ok;
+	return bits < max ? bits : max;
 }
 
-SWITCH_DECLARE(switch_bool_t) switch_network_list_validate_ip_token(switch_network_list_t *list, uint32_t ip, const char **token)
+static switch_network_trie_t *trie_new(switch_memory_pool_t *pool, const uint32_t *key, uint32_t bits, switch_network_node_t *node)
 {
-	switch_network_node_t *node;
-	switch_bool_t ok = list->default_type;
-	uint32_t bits = 0;
+	switch_network_trie_t *t = switch_core_alloc(pool, sizeof(*t));
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		uint32_t b = bits > (uint32_t) i * 32 ? bits - i * 32 : 0;
+
+		if (b >= 32) {
+			t->key[i] = key[i];
+		} else if (b) {
+			t->key[i] = key[i] & ~(0xFFFFFFFF >> b);
+		}
+	}
+
+	t->bits = bits;
+	t->node = node;
 
-	for (node = list->node_head; node; node = node->next) {
-		if (node->family == AF_INET6) continue; /* want AF_INET */
-		if (node->bits > bits && switch_test_subnet(ip, node->ip.v4, node->mask.v4)) {
-			if (node->ok) {
-				ok = SWITCH_TRUE;
+	return t;
+}
+
+static void trie_insert(switch_memory_pool_t *pool, switch_network_trie_t **tp, const uint32_t *key, uint32_t bits, switch_network_node_t *node)
+{
+	switch_network_trie_t *t, *nt, *glue;
+	uint32_t common;
+
+	while ((t = *tp)) {
+		common = trie_common_bits(key, t->key, bits < t->bits ? bits : t->bits);
+
+		if (common < t->bits) {
+			nt = trie_new(pool, key, bits, node);
+
+			if (common == bits) {
+				/* the new prefix covers this branch */
+				nt->child[trie_bit(t->key, bits)] = t;
+				*tp = nt;
 			} else {
-				ok = SWITCH_FALSE;
+				glue = trie_new(pool, key, common, NULL);
+				glue->child[trie_bit(t->key, common)] = t;
+				glue->child[trie_bit(key, common)] = nt;
+				*tp = glue;
 			}
+			return;
+		}
 
-			bits = node->bits;
+		if (t->bits == bits) {
+			/* the same prefix added again, the last one wins like it always has */
+			t->node = node;
+			return;
+		}
 
-			if (token) {
-				*token = node->token;
-			}
+		tp = &t->child[trie_bit(key, t->bits)];
+	}
+
+	*tp = trie_new(pool, key, bits, node);
+}
+
+static switch_network_node_t *trie_find(switch_network_trie_t *t, const uint32_t *key, uint32_t max)
+{
+	switch_network_node_t *best = NULL;
+
+	while (t && t->bits <= max && trie_common_bits(key, t->key, t->bits) == t->bits) {
+		if (t->node) {
+			best = t->node;
+		}
+
+		if (t->bits == max) {
+			break;
 		}
+
+		t = t->child[trie_bit(key, t->bits)];
 	}
 
-	return ok;
+	return best;
+}
+
+static void ip6_to_key(const ip_t *ip, uint32_t *key)
+{
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		const unsigned char *p = &ip->v6.s6_addr[i * 4];
+		key[i] = ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+	}
+}
+
+static switch_bool_t network_list_result(switch_network_list_t *list, switch_network_node_t *node, const char **token)
+{
+	if (!node) {
+		return list->default_type;
+	}
+
+	if (token) {
+		*token = node->token;
+	}
+
+	return node->ok ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_network_list_validate_ip6_token(switch_network_list_t *list, ip_t ip, const char **token)
+{
+	uint32_t key[4];
+
+	ip6_to_key(&ip, key);
+
+	return network_list_result(list, trie_find(list->trie6, key, 128), token);
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_network_list_validate_ip_token(switch_network_list_t *list, uint32_t ip, const char **token)
+{
+	switch_network_node_t *node, *best;
+	uint32_t key[4] = { 0 };
+
+	key[0] = ip;
+	best = trie_find(list->trie4, key, 32);
+
+	/* the longest match wins, the one added last on a tie */
+	for (node = list->loose_head; node; node = node->loose_next) {
+		if (switch_test_subnet(ip, node->ip.v4, node->mask.v4) &&
+			(!best || node->bits > best->bits || (node->bits == best->bits && node->seq > best->seq))) {
+			best = node;
+		}
+	}
+
+	return network_list_result(list, best, token);
+}
+
+static void network_list_index(switch_network_list_t *list, switch_network_node_t *node)
+{
+	uint32_t key[4] = { 0 };
+
+	node->seq = ++list->seq;
+
+	/* a /0 never matched anything, the default covers it */
+	if (!node->bits) {
+		return;
+	}
+
+	if (node->family == AF_INET6) {
+		ip6_to_key(&node->ip, key);
+		trie_insert(list->pool, &list->trie6, key, node->bits, node);
+	} else if (node->bits >= 32 || node->mask.v4 == (0xFFFFFFFF & ~(0xFFFFFFFF >> node->bits))) {
+		/* a /32 may come with an all zero mask, switch_test_subnet() compares those exactly too */
+		key[0] = node->ip.v4;
+		trie_insert(list->pool, &list->trie4, key, node->bits, node);
+	} else {
+		node->loose_next = list->loose_head;
+		list->loose_head = node;
+	}
 }
 
 SWITCH_DECLARE(switch_status_t) switch_network_list_perform_add_cidr_token(switch_network_list_t *list, const char *cidr_str, switch_bool_t ok,
@@ -291,6 +441,7 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_perform_add_cidr_token(switc
 
 	node->next = list->node_head;
 	list->node_head = node;
+	network_list_index(list, node);
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Adding %s (%s) [%s] to list %s\n",
 					  cidr_str, ok ? "allow" : "deny", switch_str_nil(token), list->name);
@@ -345,9 +496,11 @@ SWITCH_DECLARE(switch_status_t) switch_network_list_add_host_mask(switch_network
 	node->bits = (((mask.v4 + (mask.v4 >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
 
 	node->str = switch_core_sprintf(list->pool, "%s:%s", host, mask_str);
+	node->family = AF_INET;
 
 	node->next = list->node_head;
 	list->node_head = node;
+	network_list_index(list, node);
 
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -1208,7 +1361,7 @@ static int get_netmask(struct sockaddr_in *me, int *mask)
 #endif
 
 
-SWITCH_DECLARE(switch_status_t) switch_resolve_host(const char *host, char *buf, size_t buflen)
+static switch_status_t resolve_host_now(const char *host, char *buf, size_t buflen)
 {
 
 	struct addrinfo *ai;
@@ -1225,6 +1378,202 @@ SWITCH_DECLARE(switch_status_t) switch_resolve_host(const char *host, char *buf,
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/*
+ * Resolver cache.  getaddrinfo() does not tell the TTL so every answer lives dns-cache-ttl seconds.  Once 3/4 of it
+ * are gone the next lookup queues a refresh and still returns the cached address, the same happens after expiry as
+ * long as the name isn't older than dns-cache-stale.  A refresh that fails keeps the old address, that way a DNS
+ * outage doesn't stall call setup on addresses that were working a minute ago.
+ */
+
+#define RESOLVE_CACHE_MAX 8192
+
+typedef struct {
+	char addr[80];
+	switch_bool_t ok;
+	switch_bool_t refreshing;
+	switch_time_t resolved;
+	switch_time_t expires;
+	switch_time_t refresh;
+} resolve_cache_entry_t;
+
+static struct {
+	switch_hash_t *hash;
+	switch_mutex_t *mutex;
+	switch_queue_t *queue;
+	switch_thread_t *thread;
+	uint32_t count;
+	int running;
+} RESOLVE;
+
+static void resolve_cache_store(const char *host, resolve_cache_entry_t *fresh)
+{
+	resolve_cache_entry_t *entry;
+	switch_time_t now = switch_micro_time_now();
+
+	switch_mutex_lock(RESOLVE.mutex);
+	if (!(entry = switch_core_hash_find(RESOLVE.hash, host))) {
+		if (RESOLVE.count >= RESOLVE_CACHE_MAX) {
+			switch_mutex_unlock(RESOLVE.mutex);
+			switch_resolve_cache_flush(NULL);
+			switch_mutex_lock(RESOLVE.mutex);
+		}
+
+		switch_zmalloc(entry, sizeof(*entry));
+		switch_core_hash_insert(RESOLVE.hash, host, entry);
+		RESOLVE.count++;
+	}
+
+	if (fresh->ok) {
+		switch_copy_string(entry->addr, fresh->addr, sizeof(entry->addr));
+		entry->ok = SWITCH_TRUE;
+		entry->resolved = now;
+		entry->expires = now + runtime.dns_cache_ttl * 1000000LL;
+		entry->refresh = now + runtime.dns_cache_ttl * 750000LL;
+	} else if (!entry->ok || now - entry->resolved > runtime.dns_cache_stale * 1000000LL) {
+		/* nothing good to fall back on */
+		entry->ok = SWITCH_FALSE;
+		entry->resolved = now;
+		entry->expires = now + runtime.dns_negative_ttl * 1000000LL;
+		entry->refresh = entry->expires;
+	} else {
+		/* keep the old address and try again later */
+		entry->refresh = now + runtime.dns_negative_ttl * 1000000LL;
+	}
+
+	entry->refreshing = SWITCH_FALSE;
+	switch_mutex_unlock(RESOLVE.mutex);
+}
+
+static void *SWITCH_THREAD_FUNC resolve_cache_thread(switch_thread_t *thread, void *obj)
+{
+	void *pop;
+
+	while (switch_queue_pop(RESOLVE.queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		char *host = (char *) pop;
+		resolve_cache_entry_t fresh = { { 0 } };
+
+		fresh.ok = resolve_host_now(host, fresh.addr, sizeof(fresh.addr)) == SWITCH_STATUS_SUCCESS;
+		resolve_cache_store(host, &fresh);
+		free(host);
+	}
+
+	return NULL;
+}
+
+SWITCH_DECLARE(void) switch_resolve_cache_init(switch_memory_pool_t *pool)
+{
+	switch_threadattr_t *thd_attr = NULL;
+
+	memset(&RESOLVE, 0, sizeof(RESOLVE));
+	switch_mutex_init(&RESOLVE.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&RESOLVE.hash, NULL);
+	switch_queue_create(&RESOLVE.queue, RESOLVE_CACHE_MAX, pool);
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&RESOLVE.thread, thd_attr, resolve_cache_thread, NULL, pool);
+	RESOLVE.running = 1;
+}
+
+SWITCH_DECLARE(void) switch_resolve_cache_flush(const char *host)
+{
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+
+	if (!RESOLVE.running) {
+		return;
+	}
+
+	switch_mutex_lock(RESOLVE.mutex);
+	if (host) {
+		if ((val = switch_core_hash_find(RESOLVE.hash, host))) {
+			switch_core_hash_delete(RESOLVE.hash, host);
+			free(val);
+			RESOLVE.count--;
+		}
+	} else {
+		while ((hi = switch_hash_first(NULL, RESOLVE.hash))) {
+			switch_hash_this(hi, &var, NULL, &val);
+			switch_core_hash_delete(RESOLVE.hash, var);
+			free(val);
+		}
+		RESOLVE.count = 0;
+	}
+	switch_mutex_unlock(RESOLVE.mutex);
+}
+
+SWITCH_DECLARE(void) switch_resolve_cache_shutdown(void)
+{
+	switch_status_t st;
+
+	if (!RESOLVE.running) {
+		return;
+	}
+
+	switch_queue_push(RESOLVE.queue, NULL);
+	switch_thread_join(&st, RESOLVE.thread);
+
+	switch_resolve_cache_flush(NULL);
+	RESOLVE.running = 0;
+	switch_core_hash_destroy(&RESOLVE.hash);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_resolve_host(const char *host, char *buf, size_t buflen)
+{
+	resolve_cache_entry_t *entry, fresh = { { 0 } };
+	switch_status_t status = SWITCH_STATUS_NOTFOUND;
+	switch_time_t now;
+	ip_t ip;
+
+	if (!RESOLVE.running || !runtime.dns_cache_ttl || zstr(host) ||
+		switch_inet_pton(AF_INET, host, &ip) > 0 || switch_inet_pton(AF_INET6, host, &ip) > 0) {
+		return resolve_host_now(host, buf, buflen);
+	}
+
+	now = switch_micro_time_now();
+
+	switch_mutex_lock(RESOLVE.mutex);
+	if ((entry = switch_core_hash_find(RESOLVE.hash, host))) {
+		switch_time_t stale = entry->resolved + runtime.dns_cache_stale * 1000000LL;
+
+		if (now < entry->expires || (entry->ok && now < stale)) {
+			if (entry->ok) {
+				switch_copy_string(buf, entry->addr, buflen);
+				status = SWITCH_STATUS_SUCCESS;
+			} else {
+				status = SWITCH_STATUS_FALSE;
+			}
+
+			if (now >= entry->refresh && !entry->refreshing && entry->ok) {
+				char *dup = strdup(host);
+
+				if (dup && switch_queue_trypush(RESOLVE.queue, dup) == SWITCH_STATUS_SUCCESS) {
+					entry->refreshing = SWITCH_TRUE;
+				} else {
+					switch_safe_free(dup);
+				}
+			}
+		}
+	}
+	switch_mutex_unlock(RESOLVE.mutex);
+
+	if (status != SWITCH_STATUS_NOTFOUND) {
+		return status;
+	}
+
+	fresh.ok = resolve_host_now(host, fresh.addr, sizeof(fresh.addr)) == SWITCH_STATUS_SUCCESS;
+	resolve_cache_store(host, &fresh);
+
+	if (!fresh.ok) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_copy_string(buf, fresh.addr, buflen);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 
 SWITCH_DECLARE(switch_status_t) switch_find_local_ip(char *buf, int len, int *mask, int family)
 {
@@ -1916,6 +2265,9 @@ SWITCH_DECLARE(char *) switch_escape_string_pool(const char *in, switch_memory_p
 	return switch_escape_string(in, buf, len);
 }
 
+/* the characters that make the tokenizers leave their strchr() fast path */
+#define SEPARATE_SPECIAL_CHARS "\\'"
+
 /* Helper function used when separating strings to remove quotes, leading /
    trailing spaces, and to convert escaped characters. */
 static char *cleanup_separated_string(char *str, char delim)
@@ -1924,12 +2276,24 @@ static char *cleanup_separated_string(char *str, char delim)
 	char *dest;
 	char *start;
 	char *end = NULL;
+	char *last_quote;
 	int inside_quotes = 0;
 
 	/* Skip initial whitespace */
 	for (ptr = str; *ptr == ' '; ++ptr) {
 	}
 
+	if (!strpbrk(ptr, SEPARATE_SPECIAL_CHARS)) {
+		/* nothing to unquote or unescape, only trim the trailing spaces */
+		for (end = ptr + strlen(ptr); end > ptr && *(end - 1) == ' '; --end) {
+		}
+		*end = '\0';
+		return ptr;
+	}
+
+	/* text after ptr is never rewritten, so this tells if a quote has a closing one */
+	last_quote = strrchr(ptr, '\'');
+
 	for (start = dest = ptr; *ptr; ++ptr) {
 		char e;
 		int esc = 0;
@@ -1944,7 +2308,7 @@ static char *cleanup_separated_string(char *str, char delim)
 			}
 		}
 		if (!esc) {
-			if (*ptr == '\'' && (inside_quotes || ((ptr+1) && strchr(ptr+1, '\'')))) {
+			if (*ptr == '\'' && (inside_quotes || ptr < last_quote)) {
 				if ((inside_quotes = (1 - inside_quotes))) {
 					end = dest;
 				}
@@ -1972,7 +2336,7 @@ SWITCH_DECLARE(unsigned int) switch_separate_string_string(char *buf, char *deli
 	array[count++] = buf;
 
 	while (count < arraylen && array[count - 1]) {
-		if ((d = strstr(array[count - 1], delim))) {
+		if ((d = (dlen == 1 ? strchr(array[count - 1], *delim) : strstr(array[count - 1], delim)))) {
 			*d = '\0';
 			d += dlen;
 			array[count++] = d;
@@ -1993,9 +2357,27 @@ static unsigned int separate_string_char_delim(char *buf, char delim, char **arr
 
 	unsigned int count = 0;
 	char *ptr = buf;
+	char *last_quote;
 	int inside_quotes = 0;
 	unsigned int i;
 
+	if (!strpbrk(buf, SEPARATE_SPECIAL_CHARS)) {
+		/* no quotes or escapes, let strchr() find the delimiters */
+		while (*ptr && count < arraylen) {
+			char *d;
+
+			array[count++] = ptr;
+			if (count == arraylen || !(d = strchr(ptr, delim))) {
+				break;
+			}
+			*d = '\0';
+			ptr = d + 1;
+		}
+		goto cleanup;
+	}
+
+	last_quote = strrchr(buf, '\'');
+
 	while (*ptr && count < arraylen) {
 		switch (state) {
 		case START:
@@ -2005,9 +2387,9 @@ static unsigned int separate_string_char_delim(char *buf, char delim, char **arr
 
 		case FIND_DELIM:
 			/* escaped characters are copied verbatim to the destination string */
-			if (*ptr == ESCAPE_META) {
+			if (*ptr == ESCAPE_META && *(ptr + 1)) {
 				++ptr;
-			} else if (*ptr == '\'' && (inside_quotes || ((ptr+1) && strchr(ptr+1, '\'')))) {
+			} else if (*ptr == '\'' && (inside_quotes || ptr < last_quote)) {
 				inside_quotes = (1 - inside_quotes);
 			} else if (*ptr == delim && !inside_quotes) {
 				*ptr = '\0';
@@ -2017,6 +2399,7 @@ static unsigned int separate_string_char_delim(char *buf, char delim, char **arr
 			break;
 		}
 	}
+  cleanup:
 	/* strip quotes, escaped chars and leading / trailing spaces */
 
 	for (i = 0; i < count; ++i) {
@@ -2041,6 +2424,27 @@ static unsigned int separate_string_blank_delim(char *buf, char **array, unsigne
 	int inside_quotes = 0;
 	unsigned int i;
 
+	if (!strpbrk(buf, SEPARATE_SPECIAL_CHARS)) {
+		while (*ptr && count < arraylen) {
+			char *d;
+
+			array[count++] = ptr;
+			if (count == arraylen) {
+				break;
+			}
+			while (*ptr == ' ') {
+				++ptr;
+			}
+			if (!(d = strchr(ptr, ' '))) {
+				break;
+			}
+			*d = '\0';
+			for (ptr = d + 1; *ptr == ' '; ++ptr) {
+			}
+		}
+		goto cleanup;
+	}
+
 	while (*ptr && count < arraylen) {
 		switch (state) {
 		case START:
@@ -2057,7 +2461,7 @@ static unsigned int separate_string_blank_delim(char *buf, char **array, unsigne
 			break;
 
 		case FIND_DELIM:
-			if (*ptr == ESCAPE_META) {
+			if (*ptr == ESCAPE_META && *(ptr + 1)) {
 				++ptr;
 			} else if (*ptr == '\'') {
 				inside_quotes = (1 - inside_quotes);
@@ -2077,6 +2481,7 @@ static unsigned int separate_string_blank_delim(char *buf, char **array, unsigne
 			break;
 		}
 	}
+  cleanup:
 	/* strip quotes, escaped chars and leading / trailing spaces */
 
 	for (i = 0; i < count; ++i) {
@@ -2097,6 +2502,71 @@ SWITCH_DECLARE(unsigned int) switch_separate_string(char *buf, char delim, char
 	return (delim == ' ' ? separate_string_blank_delim(buf, array, arraylen) : separate_string_char_delim(buf, delim, array, arraylen));
 }
 
+SWITCH_DECLARE(unsigned int) switch_separate_string_span(const char *buf, char delim, switch_span_t *array, unsigned int arraylen)
+{
+	const char *ptr = buf, *start, *end, *last_quote = NULL;
+	int plain, inside_quotes;
+	unsigned int count = 0;
+
+	if (!buf || !array || !arraylen) {
+		return 0;
+	}
+
+	if (!(plain = !strpbrk(buf, SEPARATE_SPECIAL_CHARS))) {
+		last_quote = strrchr(buf, '\'');
+	}
+
+	while (*ptr && count < arraylen) {
+		if (delim == ' ') {
+			while (*ptr == ' ') {
+				++ptr;
+			}
+			if (!*ptr) {
+				break;
+			}
+		}
+
+		start = ptr;
+
+		if (count + 1 == arraylen) {
+			/* the last one gets the rest */
+			end = ptr + strlen(ptr);
+		} else if (plain) {
+			if (!(end = strchr(ptr, delim))) {
+				end = ptr + strlen(ptr);
+			}
+		} else {
+			for (end = ptr, inside_quotes = 0; *end; ++end) {
+				if (*end == ESCAPE_META) {
+					if (!*(end + 1)) {
+						break;
+					}
+					++end;
+				} else if (*end == '\'' && (inside_quotes || end < last_quote)) {
+					inside_quotes = (1 - inside_quotes);
+				} else if (*end == delim && !inside_quotes) {
+					break;
+				}
+			}
+		}
+
+		ptr = *end ? end + 1 : end;
+
+		while (start < end && *start == ' ') {
+			++start;
+		}
+		while (end > start && *(end - 1) == ' ') {
+			--end;
+		}
+
+		array[count].str = start;
+		array[count].len = end - start;
+		count++;
+	}
+
+	return count;
+}
+
 SWITCH_DECLARE(const char *) switch_cut_path(const char *in)
 {
 	const char *p, *ret = in;
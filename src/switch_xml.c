@@ -56,6 +56,7 @@
 
 #include <switch.h>
 #ifndef WIN32
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <switch_private.h>
 #include <glob.h>
@@ -106,6 +107,24 @@ static switch_bool_t USE_UTF_8_ENCODING = SWITCH_TRUE;
 
 static int preprocess(const char *cwd, const char *file, int write_fd, int rlevel);
 
+/* bump allocator for the tags and attribute lists of a tree parsed in arena mode */
+typedef struct xml_arena {
+	struct xml_arena *next;
+	switch_size_t size;
+	switch_size_t used;
+	char *last;
+} xml_arena_t;
+
+#define XML_ARENA_ALIGN(_s) (((_s) + 7) & ~((switch_size_t) 7))
+#define XML_ARENA_MAX_BLOCK (1024 * 1024)
+
+/* a section whose children belong to the root of an earlier load */
+typedef struct xml_graft {
+	switch_xml_t node;
+	switch_xml_t owner;
+	struct xml_graft *next;
+} xml_graft_t;
+
 typedef struct switch_xml_root *switch_xml_root_t;
 struct switch_xml_root {		/* additional data for the root tag */
 	struct switch_xml xml;		/* is a super-struct built on top of switch_xml struct */
@@ -121,17 +140,91 @@ struct switch_xml_root {		/* additional data for the root tag */
 	char ***pi;					/* processing instructions */
 	short standalone;			/* non-zero if <?xml standalone="yes"?> */
 	char err[SWITCH_XML_ERRL];	/* error string */
+	xml_graft_t *grafts;		/* sections kept from an earlier root on a partial reload */
+	switch_hash_t *user_index;	/* directory domains of this root by node address */
+	xml_arena_t *arena;			/* set while and after parsing in arena mode */
+	void *map;					/* snapshot the xml string lives in, released with the root */
+	switch_size_t map_len;
 };
 
+typedef struct {
+	switch_xml_t user;
+	switch_xml_t group;
+} xml_user_entry_t;
+
+/* the users of a domain in the order switch_xml_locate_user() walks them */
+typedef struct {
+	xml_user_entry_t *entries;
+	int count;
+	switch_hash_t *names;		/* id and number-alias to the index of the first user with it */
+	int *typed;					/* users with a type attribute, they can match on it alone */
+	int typed_count;
+} xml_user_index_t;
+
+typedef enum {
+	XML_TRACK_SECTION,
+	XML_TRACK_FILE,
+	XML_TRACK_GLOB,
+	XML_TRACK_EXEC,
+	XML_TRACK_SET,
+	XML_TRACK_VAR
+} xml_track_type_t;
+
+/* something the preprocessor read while building a root, and the section it was read for */
+typedef struct xml_track {
+	xml_track_type_t type;
+	char *path;
+	char *value;				/* what a variable was set to or expanded to */
+	char *section;
+	time_t mtime;
+	int64_t size;
+	unsigned int sig;
+	struct xml_track *next;
+} xml_track_t;
+
+typedef struct {
+	xml_track_t *head;
+	char section[256];
+	int section_level;
+	int skipping;
+	char **skip;
+	int skip_count;
+} xml_track_state_t;
+
+/* filled while preprocessing under FILE_LOCK */
+static xml_track_state_t *TRACK_STATE = NULL;
+/* what MAIN_XML_ROOT was built from, under XML_LOCK */
+static xml_track_state_t *LAST_TRACK = NULL;
+
+static void xml_track_var(xml_track_type_t type, const char *name, const char *value);
+
 char *SWITCH_XML_NIL[] = { NULL };	/* empty, null terminated array of strings */
 
 struct switch_xml_binding {
 	switch_xml_search_function_t function;
 	switch_xml_section_t sections;
 	void *user_data;
+	uint32_t cache_ttl;
+	char **cache_params;
+	int cache_param_count;
+	char *name;
 	struct switch_xml_binding *next;
 };
 
+/* one cached or in-flight answer from a binding */
+typedef struct xml_fetch_entry {
+	char *key;
+	char *section;
+	char *key_value;
+	switch_xml_t xml;
+	switch_time_t expires;
+	int fetching;
+	int hashed;
+	int refs;
+	const char *binding_name;	/* set for bindings whose answers outlive a restart */
+	struct xml_fetch_entry *next;
+} xml_fetch_entry_t;
+
 
 static switch_xml_binding_t *BINDINGS = NULL;
 static switch_xml_t MAIN_XML_ROOT = NULL;
@@ -151,6 +244,17 @@ static void *XML_OPEN_ROOT_FUNCTION_USER_DATA = NULL;
 
 static switch_hash_t *CACHE_HASH = NULL;
 
+static switch_hash_t *FETCH_CACHE_HASH = NULL;
+static switch_mutex_t *FETCH_CACHE_MUTEX = NULL;
+static switch_thread_cond_t *FETCH_CACHE_COND = NULL;
+static switch_time_t FETCH_CACHE_SWEEP = 0;
+static struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t coalesced;
+	uint32_t entries;
+} FETCH_CACHE_STATS;
+
 struct xml_section_t {
 	const char *name;
 	/* switch_xml_section_t section; */
@@ -248,6 +352,40 @@ SWITCH_DECLARE(void) switch_xml_set_binding_user_data(switch_xml_binding_t *bind
 	binding->user_data = user_data;
 }
 
+SWITCH_DECLARE(void) switch_xml_set_binding_cache(switch_xml_binding_t *binding, uint32_t ttl, const char *key_params)
+{
+	char *argv[64] = { 0 };
+	char *dup;
+	int argc = 0, i;
+
+	switch_assert(binding);
+
+	if (!zstr(key_params)) {
+		dup = switch_core_strdup(XML_MEMORY_POOL, key_params);
+		argc = switch_separate_string(dup, ',', argv, (sizeof(argv) / sizeof(argv[0])));
+		binding->cache_params = switch_core_alloc(XML_MEMORY_POOL, argc * sizeof(char *));
+		for (i = 0; i < argc; i++) {
+			binding->cache_params[i] = switch_strip_spaces(argv[i], SWITCH_FALSE);
+		}
+	}
+
+	binding->cache_param_count = argc;
+	binding->cache_ttl = ttl;
+}
+
+static void xml_fetch_cache_adopt(switch_xml_binding_t *binding);
+
+SWITCH_DECLARE(void) switch_xml_set_binding_name(switch_xml_binding_t *binding, const char *name)
+{
+	switch_assert(binding);
+
+	binding->name = zstr(name) ? NULL : switch_core_strdup(XML_MEMORY_POOL, name);
+
+	if (binding->name && binding->cache_ttl) {
+		xml_fetch_cache_adopt(binding);
+	}
+}
+
 SWITCH_DECLARE(switch_xml_section_t) switch_xml_get_binding_sections(switch_xml_binding_t *binding)
 {
 	return binding->sections;
@@ -593,6 +731,87 @@ static char *switch_xml_decode(char *s, char **ent, char t)
 	return r;
 }
 
+static void *xml_arena_alloc(switch_xml_root_t root, switch_size_t size)
+{
+	xml_arena_t *block = root->arena;
+	char *ptr;
+
+	size = XML_ARENA_ALIGN(size);
+
+	if (!block || block->used + size > block->size) {
+		switch_size_t bsize = block ? block->size * 2 : 4096;
+
+		if (bsize > XML_ARENA_MAX_BLOCK) {
+			bsize = XML_ARENA_MAX_BLOCK;
+		}
+		if (bsize < size) {
+			bsize = size;
+		}
+
+		block = malloc(sizeof(*block) + bsize);
+		switch_assert(block);
+		block->size = bsize;
+		block->used = 0;
+		block->next = root->arena;
+		root->arena = block;
+	}
+
+	ptr = (char *) (block + 1) + block->used;
+	block->used += size;
+	block->last = ptr;
+
+	return ptr;
+}
+
+/* grows the last allocation in place when it can */
+static void *xml_arena_realloc(switch_xml_root_t root, void *ptr, switch_size_t old_size, switch_size_t size)
+{
+	xml_arena_t *block = root->arena;
+	void *new_ptr;
+
+	if (!ptr) {
+		return xml_arena_alloc(root, size);
+	}
+
+	if (block && (char *) ptr == block->last && ((char *) ptr - (char *) (block + 1)) + XML_ARENA_ALIGN(size) <= block->size) {
+		block->used = ((char *) ptr - (char *) (block + 1)) + XML_ARENA_ALIGN(size);
+		return ptr;
+	}
+
+	new_ptr = xml_arena_alloc(root, size);
+	memcpy(new_ptr, ptr, old_size);
+
+	return new_ptr;
+}
+
+static void xml_arena_free(xml_arena_t *arena)
+{
+	xml_arena_t *block;
+
+	while ((block = arena)) {
+		arena = block->next;
+		free(block);
+	}
+}
+
+/* copies an attribute list out of the arena before it gets resized */
+static void xml_attr_unarena(switch_xml_t xml)
+{
+	char **attr;
+	int c;
+
+	for (c = 0; xml->attr[c]; c += 2);
+
+	attr = (char **) malloc((c + 2) * sizeof(char *));
+	switch_assert(attr);
+	memcpy(attr, xml->attr, (c + 1) * sizeof(char *));
+	attr[c + 1] = strdup(xml->attr[c + 1]);
+	switch_assert(attr[c + 1]);
+
+	xml->attr = attr;
+	xml->flags &= ~SWITCH_XML_ARENA_ATTR;
+}
+
 /* called when parser finds start of new tag */
 static void switch_xml_open_tag(switch_xml_root_t root, char *name, char **attr)
 {
@@ -604,12 +823,28 @@ static void switch_xml_open_tag(switch_xml_root_t root, char *name, char **attr)
 
 	xml = root->cur;
 
-	if (xml->name)
-		xml = switch_xml_add_child(xml, name, strlen(xml->txt));
-	else
+	if (xml->name) {
+		if (root->arena) {
+			switch_xml_t child = xml_arena_alloc(root, sizeof(struct switch_xml));
+
+			memset(child, '\0', sizeof(struct switch_xml));
+			child->name = name;
+			child->attr = SWITCH_XML_NIL;
+			child->off = strlen(xml->txt);
+			child->parent = xml;
+			child->txt = (char *) "";
+			child->flags = SWITCH_XML_ARENA;
+			xml = switch_xml_insert(child, xml, child->off);
+		} else {
+			xml = switch_xml_add_child(xml, name, strlen(xml->txt));
+		}
+	} else
 		xml->name = name;		/* first open tag */
 
 	xml->attr = attr;
+	if (root->arena && attr != SWITCH_XML_NIL) {
+		xml->flags |= SWITCH_XML_ARENA_ATTR;
+	}
 	root->cur = xml;			/* update tag insertion point */
 }
 
@@ -953,6 +1188,46 @@ static void switch_xml_free_attr(char **attr)
 	free(attr);
 }
 
+/* frees what switch_xml_decode() malloced in an attribute list kept in the arena */
+static void xml_free_arena_attr(char **attr)
+{
+	int i = 0;
+	char *m;
+
+	if (!attr || attr == SWITCH_XML_NIL)
+		return;
+	while (attr[i])
+		i += 2;
+	m = attr[i + 1];
+	for (i = 0; m[i]; i++) {
+		if (m[i] & SWITCH_XML_NAMEM)
+			free(attr[i * 2]);
+		if (m[i] & SWITCH_XML_TXTM)
+			free(attr[(i * 2) + 1]);
+	}
+}
+
+static switch_xml_t xml_parse_str(char *s, switch_size_t len, switch_bool_t arena);
+
+SWITCH_DECLARE(switch_xml_t) switch_xml_parse_str_arena(char *s, switch_bool_t dup)
+{
+	switch_xml_root_t root;
+	char *data;
+
+	switch_assert(s);
+	data = dup ? strdup(s) : s;
+
+	if ((root = (switch_xml_root_t) xml_parse_str(data, strlen(data), SWITCH_TRUE))) {
+		root->dynamic = 1;		/* Make sure we free the memory is switch_xml_free() */
+		return &root->xml;
+	} else {
+		if (dup) {
+			free(data);
+		}
+		return NULL;
+	}
+}
+
 SWITCH_DECLARE(switch_xml_t) switch_xml_parse_str_dynamic(char *s, switch_bool_t dup)
 {
 	switch_xml_root_t root;
@@ -974,11 +1249,36 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_str_dynamic(char *s, switch_bool_t
 
 /* parse the given xml string and return an switch_xml structure */
 SWITCH_DECLARE(switch_xml_t) switch_xml_parse_str(char *s, switch_size_t len)
+{
+	return xml_parse_str(s, len, SWITCH_FALSE);
+}
+
+#define xml_parse_free_attr(_root, _attr) ((_root)->arena ? xml_free_arena_attr(_attr) : switch_xml_free_attr(_attr))
+
+static switch_xml_t xml_parse_str(char *s, switch_size_t len, switch_bool_t arena)
 {
 	switch_xml_root_t root = (switch_xml_root_t) switch_xml_new(NULL);
 	char q, e, *d, **attr, **a = NULL;	/* initialize a to avoid compile warning */
 	int l, i, j;
 
+	if (arena) {
+		/* one block sized for the typical tag density of the input, more only when that was short */
+		xml_arena_t *block;
+		switch_size_t bsize = XML_ARENA_ALIGN(len * 2 + 1024);
+
+		if (bsize > XML_ARENA_MAX_BLOCK) {
+			bsize = XML_ARENA_MAX_BLOCK;
+		}
+
+		block = malloc(sizeof(*block) + bsize);
+		switch_assert(block);
+		block->size = bsize;
+		block->used = 0;
+		block->last = NULL;
+		block->next = NULL;
+		root->arena = block;
+	}
+
 	root->m = s;
 	if (!len)
 		return switch_xml_err(root, s, "root tag missing");
@@ -1009,10 +1309,15 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_str(char *s, switch_size_t len)
 				for (i = 0; (a = root->attr[i]) && strcmp(a[0], d); i++);
 
 			for (l = 0; *s && *s != '/' && *s != '>'; l += 2) {	/* new attrib */
-				attr = (l) ? (char **) realloc(attr, (l + 4) * sizeof(char *))
-					: (char **) malloc(4 * sizeof(char *));	/* allocate space */
-				attr[l + 3] = (l) ? (char *) realloc(attr[l + 1], (l / 2) + 2)
-					: (char *) malloc(2);	/* mem for list of maloced vals */
+				if (root->arena) {
+					attr = (char **) xml_arena_realloc(root, l ? attr : NULL, (l + 2) * sizeof(char *), (l + 4) * sizeof(char *));
+					attr[l + 3] = (char *) xml_arena_realloc(root, l ? attr[l + 1] : NULL, (l / 2) + 1, (l / 2) + 2);
+				} else {
+					attr = (l) ? (char **) realloc(attr, (l + 4) * sizeof(char *))
+						: (char **) malloc(4 * sizeof(char *));	/* allocate space */
+					attr[l + 3] = (l) ? (char *) realloc(attr[l + 1], (l / 2) + 2)
+						: (char *) malloc(2);	/* mem for list of maloced vals */
+				}
 				strcpy(attr[l + 3] + (l / 2), " ");	/* value is not malloced */
 				attr[l + 2] = NULL;	/* null terminate list */
 				attr[l + 1] = (char *) "";	/* temporary attribute value */
@@ -1029,7 +1334,7 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_str(char *s, switch_size_t len)
 						if (*s)
 							*(s++) = '\0';	/* null terminate attribute val */
 						else {
-							switch_xml_free_attr(attr);
+							xml_parse_free_attr(root, attr);
 							return switch_xml_err(root, d, "missing %c", q);
 						}
 
@@ -1047,7 +1352,7 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_str(char *s, switch_size_t len)
 				*(s++) = '\0';
 				if ((*s && *s != '>') || (!*s && e != '>')) {
 					if (l)
-						switch_xml_free_attr(attr);
+						xml_parse_free_attr(root, attr);
 					return switch_xml_err(root, d, "missing >");
 				}
 				switch_xml_open_tag(root, d, attr);
@@ -1058,7 +1363,7 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_str(char *s, switch_size_t len)
 				*s = q;
 			} else {
 				if (l)
-					switch_xml_free_attr(attr);
+					xml_parse_free_attr(root, attr);
 				return switch_xml_err(root, d, "missing >");
 			}
 		} else if (*s == '/') {	/* close tag */
@@ -1203,7 +1508,9 @@ static char *expand_vars(char *buf, char *ebuf, switch_size_t elen, switch_size_
 				var = rp;
 				*e++ = '\0';
 				rp = e;
-				if ((val = switch_core_get_variable_dup(var))) {
+				val = switch_core_get_variable_dup(var);
+				xml_track_var(XML_TRACK_VAR, var, val);
+				if (val) {
 					char *p;
 					for (p = val; p && *p && wp <= ep; p++) {
 						*wp++ = *p;
@@ -1224,6 +1531,151 @@ static char *expand_vars(char *buf, char *ebuf, switch_size_t elen, switch_size_
 	return ebuf;
 }
 
+static xml_track_t *xml_track_add(xml_track_type_t type, const char *path)
+{
+	xml_track_t *track;
+
+	if (!TRACK_STATE) {
+		return NULL;
+	}
+
+	switch_zmalloc(track, sizeof(*track));
+	track->type = type;
+	track->path = strdup(path);
+	track->section = *TRACK_STATE->section ? strdup(TRACK_STATE->section) : NULL;
+	track->next = TRACK_STATE->head;
+	TRACK_STATE->head = track;
+
+	return track;
+}
+
+static void xml_track_var(xml_track_type_t type, const char *name, const char *value)
+{
+	xml_track_t *track;
+
+	if ((track = xml_track_add(type, name))) {
+		track->value = value ? strdup(value) : NULL;
+	}
+}
+
+static void xml_track_stat(xml_track_t *track, time_t *mtime, int64_t *size)
+{
+	struct stat st;
+
+	if (stat(track->path, &st) == 0) {
+		*mtime = st.st_mtime;
+		*size = (int64_t) st.st_size;
+	} else {
+		*mtime = -1;
+		*size = -1;
+	}
+}
+
+static unsigned int xml_track_glob_sig(const char *pattern)
+{
+	glob_t glob_data;
+	unsigned int sig = 0;
+	size_t n;
+
+	if (glob(pattern, GLOB_NOCHECK, NULL, &glob_data) == 0) {
+		for (n = 0; n < glob_data.gl_pathc; n++) {
+			switch_ssize_t len = (switch_ssize_t) strlen(glob_data.gl_pathv[n]);
+			sig = sig * 31 + switch_hashfunc_default(glob_data.gl_pathv[n], &len);
+		}
+		globfree(&glob_data);
+	}
+
+	return sig;
+}
+
+static void xml_track_free(xml_track_state_t **state)
+{
+	xml_track_t *track;
+	int i;
+
+	if (!*state) {
+		return;
+	}
+
+	while ((track = (*state)->head)) {
+		(*state)->head = track->next;
+		switch_safe_free(track->path);
+		switch_safe_free(track->value);
+		switch_safe_free(track->section);
+		free(track);
+	}
+
+	for (i = 0; i < (*state)->skip_count; i++) {
+		switch_safe_free((*state)->skip[i]);
+	}
+	switch_safe_free((*state)->skip);
+
+	free(*state);
+	*state = NULL;
+}
+
+static switch_bool_t xml_track_skipped(xml_track_state_t *state, const char *section)
+{
+	int i;
+
+	for (i = 0; section && i < state->skip_count; i++) {
+		if (!strcasecmp(state->skip[i], section)) {
+			return SWITCH_TRUE;
+		}
+	}
+
+	return SWITCH_FALSE;
+}
+
+/* follows <section> open and close lines, returns non zero for lines of a section left out of this parse */
+static int xml_track_line(const char *line, int rlevel)
+{
+	const char *p, *e;
+
+	if (!*TRACK_STATE->section) {
+		if ((p = strstr(line, "<section")) && (p = strstr(p, "name=\"")) && (e = strchr(p + 6, '"'))) {
+			p += 6;
+			switch_copy_string(TRACK_STATE->section, p, (switch_size_t) (e - p + 1) < sizeof(TRACK_STATE->section) ?
+							   (switch_size_t) (e - p + 1) : sizeof(TRACK_STATE->section));
+			TRACK_STATE->section_level = rlevel;
+			xml_track_add(XML_TRACK_SECTION, TRACK_STATE->section);
+			TRACK_STATE->skipping = xml_track_skipped(TRACK_STATE, TRACK_STATE->section);
+
+			if ((e = strchr(e, '>')) && *(e - 1) == '/') {
+				*TRACK_STATE->section = '\0';
+				TRACK_STATE->skipping = 0;
+			}
+		}
+		return 0;
+	}
+
+	if (TRACK_STATE->section_level == rlevel && strstr(line, "</section>")) {
+		*TRACK_STATE->section = '\0';
+		TRACK_STATE->skipping = 0;
+		return 0;
+	}
+
+	return TRACK_STATE->skipping;
+}
+
+static switch_bool_t xml_track_changed(xml_track_t *track)
+{
+	time_t mtime;
+	int64_t size;
+
+	switch (track->type) {
+	case XML_TRACK_FILE:
+		xml_track_stat(track, &mtime, &size);
+		return mtime != track->mtime || size != track->size;
+	case XML_TRACK_GLOB:
+		return xml_track_glob_sig(track->path) != track->sig;
+	case XML_TRACK_EXEC:
+		return SWITCH_TRUE;
+	default:
+		return SWITCH_FALSE;
+	}
+}
+
 static int preprocess_exec(const char *cwd, const char *command, int write_fd, int rlevel)
 {
 #ifdef WIN32
@@ -1235,6 +1687,9 @@ static int preprocess_exec(const char *cwd, const char *command, int write_fd, i
 #else
 	int fds[2], pid = 0;
 
+	/* nothing tells whether its output changed */
+	xml_track_add(XML_TRACK_EXEC, command);
+
 	if (pipe(fds)) {
 		goto end;
 	} else {					/* good to go */
@@ -1288,6 +1743,15 @@ static int preprocess_glob(const char *cwd, const char *pattern, int write_fd, i
 		goto end;
 	}
 
+	if (TRACK_STATE) {
+		xml_track_t *track = xml_track_add(XML_TRACK_GLOB, pattern);
+
+		for (n = 0; n < glob_data.gl_pathc; n++) {
+			switch_ssize_t len = (switch_ssize_t) strlen(glob_data.gl_pathv[n]);
+			track->sig = track->sig * 31 + switch_hashfunc_default(glob_data.gl_pathv[n], &len);
+		}
+	}
+
 	for (n = 0; n < glob_data.gl_pathc; ++n) {
 		dir_path = strdup(glob_data.gl_pathv[n]);
 		switch_assert(dir_path);
@@ -1328,6 +1792,11 @@ static int preprocess(const char *cwd, const char *file, int write_fd, int rleve
 		return -1;
 	}
 
+	if (TRACK_STATE) {
+		xml_track_t *track = xml_track_add(XML_TRACK_FILE, file);
+		xml_track_stat(track, &track->mtime, &track->size);
+	}
+
 	while ((cur = switch_fd_read_line(read_fd, buf, sizeof(buf))) > 0) {
 		char *arg, *e;
 		const char *err = NULL;
@@ -1353,6 +1822,10 @@ static int preprocess(const char *cwd, const char *file, int write_fd, int rleve
 			}
 		}
 
+		if (TRACK_STATE && xml_track_line(bp, rlevel)) {
+			continue;
+		}
+
 		if ((tcmd = (char *) switch_stristr("X-pre-process", bp))) {
 			if (*(tcmd - 1) != '<') {
 				continue;
@@ -1419,6 +1892,7 @@ static int preprocess(const char *cwd, const char *file, int write_fd, int rleve
 
 				if (name && val) {
 					switch_core_set_variable(name, val);
+					xml_track_var(XML_TRACK_SET, name, val);
 				}
 
 			} else if (!strcasecmp(tcmd, "include")) {
@@ -1477,6 +1951,7 @@ static int preprocess(const char *cwd, const char *file, int write_fd, int rleve
 
 					if (name && val) {
 						switch_core_set_variable(name, val);
+						xml_track_var(XML_TRACK_SET, name, val);
 					}
 
 				} else if (!strcasecmp(cmd, "include")) {
@@ -1525,7 +2000,7 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file_simple(const char *file)
 	return NULL;
 }
 
-SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
+static switch_xml_t xml_parse_file_tracked(const char *file, xml_track_state_t *state)
 {
 	int fd = -1, write_fd = -1;
 	switch_xml_t xml = NULL;
@@ -1541,6 +2016,7 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 	}
 	
 	switch_mutex_lock(FILE_LOCK);
+	TRACK_STATE = state;
 
 	if (!(new_file = switch_mprintf("%s%s%s.fsxml", SWITCH_GLOBAL_dirs.log_dir, SWITCH_PATH_SEPARATOR, abs))) {
 		goto done;
@@ -1565,6 +2041,7 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 
   done:
 
+	TRACK_STATE = NULL;
 	switch_mutex_unlock(FILE_LOCK);
 
 	if (write_fd > -1) {
@@ -1580,68 +2057,441 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 	return xml;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
-												  const char *tag_name,
-												  const char *key_name,
-												  const char *key_value,
-												  switch_xml_t *root, switch_xml_t *node, switch_event_t *params, switch_bool_t clone)
+SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 {
-	switch_xml_t conf = NULL;
-	switch_xml_t tag = NULL;
-	switch_xml_t xml = NULL;
-	switch_xml_binding_t *binding;
-	uint8_t loops = 0;
-	switch_xml_section_t sections = BINDINGS ? switch_xml_parse_section_string(section) : 0;
+	return xml_parse_file_tracked(file, NULL);
+}
 
-	switch_thread_rwlock_rdlock(B_RWLOCK);
+static void xml_fetch_entry_free(xml_fetch_entry_t *entry)
+{
+	if (entry->xml) {
+		switch_xml_free(entry->xml);
+	}
+	switch_safe_free(entry->key);
+	switch_safe_free(entry->section);
+	switch_safe_free(entry->key_value);
+	free(entry);
+}
 
-	for (binding = BINDINGS; binding; binding = binding->next) {
-		if (binding->sections && !(sections & binding->sections)) {
+/* FETCH_CACHE_MUTEX must be held, the entry goes once the last fetch waiting on it is done */
+static void xml_fetch_entry_unhash(xml_fetch_entry_t *entry)
+{
+	if (entry->hashed) {
+		switch_core_hash_delete(FETCH_CACHE_HASH, entry->key);
+		entry->hashed = 0;
+		FETCH_CACHE_STATS.entries--;
+	}
+
+	if (!entry->refs) {
+		xml_fetch_entry_free(entry);
+	}
+}
+
+/* FETCH_CACHE_MUTEX must be held, NULL section and key_value match everything */
+static uint32_t xml_fetch_cache_clear(const char *section, const char *key_value, switch_bool_t expired_only)
+{
+	switch_hash_index_t *hi;
+	xml_fetch_entry_t *entry, *list = NULL;
+	switch_time_t now = switch_micro_time_now();
+	void *val;
+	uint32_t r = 0;
+
+	for (hi = switch_hash_first(NULL, FETCH_CACHE_HASH); hi; hi = switch_hash_next(hi)) {
+		switch_hash_this(hi, NULL, NULL, &val);
+		entry = (xml_fetch_entry_t *) val;
+
+		if (expired_only && (entry->fetching || entry->expires > now)) {
 			continue;
 		}
 
-		if ((xml = binding->function(section, tag_name, key_name, key_value, params, binding->user_data))) {
-			const char *err = NULL;
+		if ((section && strcasecmp(section, entry->section)) || (key_value && (!entry->key_value || strcasecmp(key_value, entry->key_value)))) {
+			continue;
+		}
 
-			err = switch_xml_error(xml);
-			if (zstr(err)) {
-				if ((conf = switch_xml_find_child(xml, "section", "name", "result"))) {
-					switch_xml_t p;
-					const char *aname;
+		entry->next = list;
+		list = entry;
+	}
 
-					if ((p = switch_xml_child(conf, "result"))) {
-						aname = switch_xml_attr(p, "status");
-						if (aname && !strcasecmp(aname, "not found")) {
-							switch_xml_free(xml);
-							xml = NULL;
-							continue;
-						}
-					}
-				}
-				break;
-			} else {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error[%s]\n", err);
-				switch_xml_free(xml);
-				xml = NULL;
-			}
-		}
+	while ((entry = list)) {
+		list = entry->next;
+		xml_fetch_entry_unhash(entry);
+		r++;
 	}
-	switch_thread_rwlock_unlock(B_RWLOCK);
 
-	for (;;) {
-		if (!xml) {
-			if (!(xml = switch_xml_root())) {
-				*node = NULL;
-				*root = NULL;
-				return SWITCH_STATUS_FALSE;
-			}
-		}
+	return r;
+}
 
-		if ((conf = switch_xml_find_child(xml, "section", "name", section)) && (tag = switch_xml_find_child(conf, tag_name, key_name, key_value))) {
-			if (clone) {
+SWITCH_DECLARE(uint32_t) switch_xml_clear_fetch_cache(const char *section, const char *key_value)
+{
+	uint32_t r;
+
+	switch_mutex_lock(FETCH_CACHE_MUTEX);
+	r = xml_fetch_cache_clear(section, key_value, SWITCH_FALSE);
+	switch_mutex_unlock(FETCH_CACHE_MUTEX);
+
+	return r;
+}
+
+SWITCH_DECLARE(void) switch_xml_fetch_cache_stats(switch_stream_handle_t *stream)
+{
+	switch_mutex_lock(FETCH_CACHE_MUTEX);
+	stream->write_function(stream, "entries: %u\nhits: %" SWITCH_UINT64_T_FMT "\nmisses: %" SWITCH_UINT64_T_FMT "\ncoalesced: %" SWITCH_UINT64_T_FMT "\n",
+						   FETCH_CACHE_STATS.entries, FETCH_CACHE_STATS.hits, FETCH_CACHE_STATS.misses, FETCH_CACHE_STATS.coalesced);
+	switch_mutex_unlock(FETCH_CACHE_MUTEX);
+}
+
+static switch_bool_t xml_fetch_cacheable(switch_xml_t xml)
+{
+	return xml && zstr(switch_xml_error(xml));
+}
+
+/*
+ * Runs a binding, answering from its cache while the last answer is younger than its ttl.
+ * Concurrent identical fetches wait for the one already on the wire and share its answer.
+ */
+static switch_xml_t xml_binding_fetch(switch_xml_binding_t *binding, const char *section, const char *tag_name, const char *key_name,
+									  const char *key_value, switch_event_t *params)
+{
+	switch_stream_handle_t stream = { 0 };
+	xml_fetch_entry_t *entry;
+	switch_xml_t xml = NULL;
+	switch_time_t now;
+	int i;
+
+	if (!binding->cache_ttl) {
+		return binding->function(section, tag_name, key_name, key_value, params, binding->user_data);
+	}
+
+	SWITCH_STANDARD_STREAM(stream);
+	stream.write_function(&stream, "%p|%s|%s|%s|%s", (void *) binding, switch_str_nil(section), switch_str_nil(tag_name),
+						  switch_str_nil(key_name), switch_str_nil(key_value));
+	for (i = 0; i < binding->cache_param_count; i++) {
+		const char *val = params ? switch_event_get_header(params, binding->cache_params[i]) : NULL;
+		stream.write_function(&stream, "|%s=%s", binding->cache_params[i], switch_str_nil(val));
+	}
+
+	switch_mutex_lock(FETCH_CACHE_MUTEX);
+	now = switch_micro_time_now();
+
+	if (now - FETCH_CACHE_SWEEP > 10000000) {
+		FETCH_CACHE_SWEEP = now;
+		xml_fetch_cache_clear(NULL, NULL, SWITCH_TRUE);
+	}
+
+	if ((entry = switch_core_hash_find(FETCH_CACHE_HASH, (char *) stream.data))) {
+		if (entry->fetching) {
+			FETCH_CACHE_STATS.coalesced++;
+			entry->refs++;
+			while (entry->fetching) {
+				switch_thread_cond_wait(FETCH_CACHE_COND, FETCH_CACHE_MUTEX);
+			}
+			entry->refs--;
+
+			if (entry->xml) {
+				xml = switch_xml_dup(entry->xml);
+			}
+
+			if (!entry->hashed && !entry->refs) {
+				xml_fetch_entry_free(entry);
+			}
+
+			switch_mutex_unlock(FETCH_CACHE_MUTEX);
+			goto end;
+		}
+
+		if (entry->expires > now) {
+			FETCH_CACHE_STATS.hits++;
+			xml = switch_xml_dup(entry->xml);
+			switch_mutex_unlock(FETCH_CACHE_MUTEX);
+			goto end;
+		}
+
+		xml_fetch_entry_unhash(entry);
+	}
+
+	FETCH_CACHE_STATS.misses++;
+	switch_zmalloc(entry, sizeof(*entry));
+	entry->key = strdup((char *) stream.data);
+	entry->section = strdup(switch_str_nil(section));
+	entry->key_value = key_value ? strdup(key_value) : NULL;
+	entry->fetching = 1;
+	entry->refs = 1;
+	entry->hashed = 1;
+	entry->binding_name = binding->name;
+	switch_core_hash_insert(FETCH_CACHE_HASH, entry->key, entry);
+	FETCH_CACHE_STATS.entries++;
+	switch_mutex_unlock(FETCH_CACHE_MUTEX);
+
+	xml = binding->function(section, tag_name, key_name, key_value, params, binding->user_data);
+
+	switch_mutex_lock(FETCH_CACHE_MUTEX);
+	entry->fetching = 0;
+	entry->refs--;
+
+	if (xml_fetch_cacheable(xml)) {
+		entry->xml = switch_xml_dup(xml);
+		entry->expires = switch_micro_time_now() + (switch_time_t) binding->cache_ttl * 1000000;
+	}
+
+	switch_thread_cond_broadcast(FETCH_CACHE_COND);
+
+	if (!entry->xml) {
+		/* nothing worth keeping, anyone waiting gets nothing as well and asks again next time */
+		xml_fetch_entry_unhash(entry);
+	} else if (!entry->hashed && !entry->refs) {
+		xml_fetch_entry_free(entry);
+	}
+	switch_mutex_unlock(FETCH_CACHE_MUTEX);
+
+  end:
+	switch_safe_free(stream.data);
+
+	return xml;
+}
+
+/* cached answers read from a state snapshot, waiting for the binding of the same name to come back */
+static xml_fetch_entry_t *FETCH_CACHE_RESTORED = NULL;
+
+#define XML_FETCH_CACHE_SNAPSHOT_VERSION 1
+
+/* a record is the ttl left, then binding name, key without the binding address, section and key value as strings, then the xml */
+static switch_status_t xml_fetch_cache_save(switch_snapshot_writer_t *writer, void *user_data)
+{
+	switch_hash_index_t *hi;
+	switch_time_t now = switch_micro_time_now();
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	void *val;
+
+	switch_mutex_lock(FETCH_CACHE_MUTEX);
+	for (hi = switch_hash_first(NULL, FETCH_CACHE_HASH); hi && status == SWITCH_STATUS_SUCCESS; hi = switch_hash_next(hi)) {
+		xml_fetch_entry_t *entry;
+		const char *rest;
+		char *text, *record;
+		int64_t ttl;
+		switch_size_t len, off = 0, n;
+
+		switch_hash_this(hi, NULL, NULL, &val);
+		entry = (xml_fetch_entry_t *) val;
+
+		if (!entry->binding_name || entry->fetching || !entry->xml || entry->expires <= now || !(rest = strchr(entry->key, '|'))) {
+			continue;
+		}
+
+		if (!(text = switch_xml_toxml(entry->xml, SWITCH_FALSE))) {
+			continue;
+		}
+
+		ttl = (int64_t) (entry->expires - now);
+		len = sizeof(ttl) + strlen(entry->binding_name) + strlen(rest) + strlen(entry->section) + strlen(switch_str_nil(entry->key_value)) + 6 + strlen(text);
+		switch_malloc(record, len);
+
+		memcpy(record, &ttl, sizeof(ttl));
+		off = sizeof(ttl);
+#define XML_RECORD_STR(_s) n = strlen(_s) + 1; memcpy(record + off, _s, n); off += n
+		XML_RECORD_STR(entry->binding_name);
+		XML_RECORD_STR(rest);
+		XML_RECORD_STR(entry->section);
+		record[off++] = entry->key_value ? '1' : '0';
+		XML_RECORD_STR(switch_str_nil(entry->key_value));
+#undef XML_RECORD_STR
+		memcpy(record + off, text, strlen(text));
+		off += strlen(text);
+
+		status = switch_snapshot_write(writer, record, off);
+		free(record);
+		free(text);
+	}
+	switch_mutex_unlock(FETCH_CACHE_MUTEX);
+
+	return status;
+}
+
+static switch_status_t xml_fetch_cache_load(const void *data, switch_size_t len, uint32_t age, void *user_data)
+{
+	const char *p = (const char *) data, *end = p + len, *fields[4];
+	char *text;
+	xml_fetch_entry_t *entry;
+	switch_xml_t xml;
+	int64_t ttl;
+	int i, has_value = 0;
+
+	if (len < sizeof(ttl) + 6) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	memcpy(&ttl, p, sizeof(ttl));
+	p += sizeof(ttl);
+	ttl -= (int64_t) age * 1000000;
+
+	if (ttl <= 0) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	for (i = 0; i < 4; i++) {
+		const char *e;
+
+		if (i == 3) {
+			if (p >= end) {
+				return SWITCH_STATUS_FALSE;
+			}
+			has_value = *p++ == '1';
+		}
+
+		if (!(e = memchr(p, '\0', end - p))) {
+			return SWITCH_STATUS_FALSE;
+		}
+		fields[i] = p;
+		p = e + 1;
+	}
+
+	switch_malloc(text, (end - p) + 1);
+	memcpy(text, p, end - p);
+	text[end - p] = '\0';
+
+	if (!(xml = switch_xml_parse_str_dynamic(text, SWITCH_FALSE)) || !xml_fetch_cacheable(xml)) {
+		if (xml) {
+			switch_xml_free(xml);
+		} else {
+			free(text);
+		}
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_zmalloc(entry, sizeof(*entry));
+	entry->binding_name = strdup(fields[0]);
+	entry->key = strdup(fields[1]);
+	entry->section = strdup(fields[2]);
+	entry->key_value = has_value ? strdup(fields[3]) : NULL;
+	entry->xml = xml;
+	entry->expires = switch_micro_time_now() + (switch_time_t) ttl;
+
+	switch_mutex_lock(FETCH_CACHE_MUTEX);
+	entry->next = FETCH_CACHE_RESTORED;
+	FETCH_CACHE_RESTORED = entry;
+	switch_mutex_unlock(FETCH_CACHE_MUTEX);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void xml_fetch_cache_restored_free(xml_fetch_entry_t *entry)
+{
+	free((char *) entry->binding_name);
+	entry->binding_name = NULL;
+	xml_fetch_entry_free(entry);
+}
+
+/* moves the restored answers of a binding into the cache under the key it has in this process */
+static void xml_fetch_cache_adopt(switch_xml_binding_t *binding)
+{
+	xml_fetch_entry_t *entry, *next, *keep = NULL;
+	switch_time_t now = switch_micro_time_now();
+	uint32_t adopted = 0;
+
+	switch_mutex_lock(FETCH_CACHE_MUTEX);
+	for (entry = FETCH_CACHE_RESTORED; entry; entry = next) {
+		char *key;
+
+		next = entry->next;
+
+		if (strcmp(entry->binding_name, binding->name)) {
+			entry->next = keep;
+			keep = entry;
+			continue;
+		}
+
+		key = switch_mprintf("%p%s", (void *) binding, entry->key);
+
+		if (entry->expires <= now || switch_core_hash_find(FETCH_CACHE_HASH, key)) {
+			free(key);
+			xml_fetch_cache_restored_free(entry);
+			continue;
+		}
+
+		free(entry->key);
+		entry->key = key;
+		free((char *) entry->binding_name);
+		entry->binding_name = binding->name;
+		entry->next = NULL;
+		entry->hashed = 1;
+		switch_core_hash_insert(FETCH_CACHE_HASH, entry->key, entry);
+		FETCH_CACHE_STATS.entries++;
+		adopted++;
+	}
+	FETCH_CACHE_RESTORED = keep;
+	switch_mutex_unlock(FETCH_CACHE_MUTEX);
+
+	if (adopted) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Binding %s starts with %u cached answers\n", binding->name, adopted);
+	}
+}
+
+SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
+												  const char *tag_name,
+												  const char *key_name,
+												  const char *key_value,
+												  switch_xml_t *root, switch_xml_t *node, switch_event_t *params, switch_bool_t clone)
+{
+	switch_xml_t conf = NULL;
+	switch_xml_t tag = NULL;
+	switch_xml_t xml = NULL;
+	switch_xml_binding_t *binding;
+	uint8_t loops = 0;
+	switch_xml_section_t sections = BINDINGS ? switch_xml_parse_section_string(section) : 0;
+	switch_time_t fetch_start;
+
+	switch_thread_rwlock_rdlock(B_RWLOCK);
+
+	for (binding = BINDINGS; binding; binding = binding->next) {
+		if (binding->sections && !(sections & binding->sections)) {
+			continue;
+		}
+
+		fetch_start = switch_micro_time_now();
+		xml = xml_binding_fetch(binding, section, tag_name, key_name, key_value, params);
+		switch_core_session_record_phase(NULL, SWITCH_PHASE_XML_FETCH, fetch_start, 0);
+
+		if (xml) {
+			const char *err = NULL;
+
+			err = switch_xml_error(xml);
+			if (zstr(err)) {
+				if ((conf = switch_xml_find_child(xml, "section", "name", "result"))) {
+					switch_xml_t p;
+					const char *aname;
+
+					if ((p = switch_xml_child(conf, "result"))) {
+						aname = switch_xml_attr(p, "status");
+						if (aname && !strcasecmp(aname, "not found")) {
+							switch_xml_free(xml);
+							xml = NULL;
+							continue;
+						}
+					}
+				}
+				break;
+			} else {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error[%s]\n", err);
+				switch_xml_free(xml);
+				xml = NULL;
+			}
+		}
+	}
+	switch_thread_rwlock_unlock(B_RWLOCK);
+
+	for (;;) {
+		if (!xml) {
+			if (!(xml = switch_xml_root())) {
+				*node = NULL;
+				*root = NULL;
+				return SWITCH_STATUS_FALSE;
+			}
+		}
+
+		if ((conf = switch_xml_find_child(xml, "section", "name", section)) && (tag = switch_xml_find_child(conf, tag_name, key_name, key_value))) {
+			if (clone) {
 				char *x = switch_xml_toxml(tag, SWITCH_FALSE);
 				switch_assert(x);
-				*node = *root = switch_xml_parse_str_dynamic(x, SWITCH_FALSE);	/* x will be free()'d in switch_xml_free() */
+				*node = *root = switch_xml_parse_str_arena(x, SWITCH_FALSE);	/* x will be free()'d in switch_xml_free() */
 				switch_xml_free(xml);
 			} else {
 				*node = tag;
@@ -1729,20 +2579,190 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_group(const char *group_name,
 	return status;
 }
 
-static switch_status_t find_user_in_tag(switch_xml_t tag, const char *ip, const char *user_name,
-										const char *key, switch_event_t *params, switch_xml_t *user)
+static void xml_user_index_add_name(xml_user_index_t *index, const char *name, int i)
+{
+	if (!zstr(name) && !switch_core_hash_find(index->names, name)) {
+		switch_core_hash_insert(index->names, name, (void *) (intptr_t) (i + 1));
+	}
+}
+
+static xml_user_index_t *xml_user_index_domain(switch_xml_t domain)
+{
+	xml_user_index_t *index;
+	switch_xml_t groups, group, users, user;
+	int n = 0, pass;
+
+	switch_zmalloc(index, sizeof(*index));
+	switch_core_hash_init_case(&index->names, NULL, SWITCH_FALSE);
+
+	/* count, then fill, groups first and the users right under the domain last */
+	for (pass = 0; pass < 2; pass++) {
+		n = 0;
+
+		if ((groups = switch_xml_child(domain, "groups"))) {
+			for (group = switch_xml_child(groups, "group"); group; group = group->next) {
+				if ((users = switch_xml_child(group, "users"))) {
+					for (user = switch_xml_child(users, "user"); user; user = user->next, n++) {
+						if (pass) {
+							index->entries[n].user = user;
+							index->entries[n].group = group;
+						}
+					}
+				}
+			}
+		}
+
+		for (user = switch_xml_child(domain, "user"); user; user = user->next, n++) {
+			if (pass) {
+				index->entries[n].user = user;
+			}
+		}
+
+		if (!pass) {
+			index->count = n;
+			index->entries = calloc(n + 1, sizeof(xml_user_entry_t));
+			index->typed = calloc(n + 1, sizeof(int));
+			switch_assert(index->entries && index->typed);
+		}
+	}
+
+	for (n = 0; n < index->count; n++) {
+		user = index->entries[n].user;
+		xml_user_index_add_name(index, switch_xml_attr(user, "id"), n);
+		xml_user_index_add_name(index, switch_xml_attr(user, "number-alias"), n);
+		if (switch_xml_attr(user, "type")) {
+			index->typed[index->typed_count++] = n;
+		}
+	}
+
+	return index;
+}
+
+static void xml_user_index_destroy(switch_hash_t **hash)
+{
+	switch_hash_index_t *hi;
+	void *val;
+
+	for (hi = switch_hash_first(NULL, *hash); hi; hi = switch_hash_next(hi)) {
+		xml_user_index_t *index;
+
+		switch_hash_this(hi, NULL, NULL, &val);
+		index = (xml_user_index_t *) val;
+		switch_core_hash_destroy(&index->names);
+		switch_safe_free(index->entries);
+		switch_safe_free(index->typed);
+		free(index);
+	}
+
+	switch_core_hash_destroy(hash);
+}
+
+/* indexes the directory parsed into this root, a directory kept from an earlier root keeps the index it has there */
+static void xml_user_index_build(switch_xml_t xml)
+{
+	switch_xml_root_t root = (switch_xml_root_t) xml;
+	switch_xml_t section, domain;
+	xml_graft_t *graft;
+	char key[64];
+	int domains = 0, users = 0;
+
+	if (root->user_index || !(section = switch_xml_find_child(xml, "section", "name", "directory"))) {
+		return;
+	}
+
+	for (graft = root->grafts; graft; graft = graft->next) {
+		if (graft->node == section) {
+			return;
+		}
+	}
+
+	switch_core_hash_init(&root->user_index, NULL);
+
+	for (domain = switch_xml_child(section, "domain"); domain; domain = domain->next) {
+		xml_user_index_t *index = xml_user_index_domain(domain);
+
+		switch_snprintf(key, sizeof(key), "%p", (void *) domain);
+		switch_core_hash_insert(root->user_index, key, index);
+		domains++;
+		users += index->count;
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Indexed %d user%s in %d domain%s\n", users, users == 1 ? "" : "s", domains,
+					  domains == 1 ? "" : "s");
+}
+
+static const char *find_user_type(switch_event_t *params)
 {
-	const char *type = "!pointer";
 	const char *val;
 
 	if (params && (val = switch_event_get_header(params, "user_type"))) {
-		if (!strcasecmp(val, "any")) {
-			type = NULL;
-		} else {
-			type = val;
+		return strcasecmp(val, "any") ? val : NULL;
+	}
+
+	return "!pointer";
+}
+
+/*
+ * Answers what walking the groups of the domain with find_user_in_tag() by id would, or SWITCH_STATUS_NOTIMPL for
+ * a domain that was not indexed, e.g. one a binding returned.  A user matches on id, on number-alias or, quirk
+ * kept as is, on a type attribute passing the type filter, and the first one in walking order wins.
+ */
+static switch_status_t xml_user_index_find(switch_xml_t domain, const char *user_name, const char *type, switch_bool_t groups_only,
+										   switch_xml_t *user, switch_xml_t *ingroup)
+{
+	switch_xml_t xml;
+	switch_xml_root_t root;
+	xml_user_index_t *index;
+	char key[64];
+	int best = -1, i;
+
+	if (zstr(user_name)) {
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	for (xml = domain; xml && xml->parent; xml = xml->parent);
+
+	root = (switch_xml_root_t) xml;
+
+	if (!xml || !switch_test_flag(xml, SWITCH_XML_ROOT) || !root->user_index) {
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	switch_snprintf(key, sizeof(key), "%p", (void *) domain);
+
+	if (!(index = switch_core_hash_find(root->user_index, key))) {
+		return SWITCH_STATUS_NOTIMPL;
+	}
+
+	best = (int) (intptr_t) switch_core_hash_find(index->names, user_name) - 1;
+
+	for (i = 0; type && i < index->typed_count && (best < 0 || index->typed[i] < best); i++) {
+		const char *val = switch_xml_attr(index->entries[index->typed[i]].user, "type");
+
+		if (*type == '!' ? strcasecmp(val, type + 1) != 0 : !strcasecmp(val, type)) {
+			best = index->typed[i];
+			break;
 		}
 	}
 
+	if (best < 0 || (groups_only && !index->entries[best].group)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	*user = index->entries[best].user;
+
+	if (ingroup) {
+		*ingroup = index->entries[best].group;
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t find_user_in_tag(switch_xml_t tag, const char *ip, const char *user_name,
+										const char *key, switch_event_t *params, switch_xml_t *user)
+{
+	const char *type = find_user_type(params);
+
 	if (ip) {
 		if ((*user = switch_xml_find_child_multi(tag, "user", "ip", ip, "type", type, NULL))) {
 			return SWITCH_STATUS_SUCCESS;
@@ -1770,6 +2790,12 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_in_domain(const char *use
 	switch_xml_t group = NULL, groups = NULL, users = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 
+	if ((status = xml_user_index_find(domain, user_name, find_user_type(NULL), SWITCH_TRUE, user, ingroup)) != SWITCH_STATUS_NOTIMPL) {
+		return status;
+	}
+
+	status = SWITCH_STATUS_FALSE;
+
 	if ((groups = switch_xml_child(domain, "groups"))) {
 		for (group = switch_xml_child(groups, "group"); group; group = group->next) {
 			if ((users = switch_xml_child(group, "users"))) {
@@ -1790,7 +2816,7 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_in_domain(const char *use
 SWITCH_DECLARE(switch_xml_t) switch_xml_dup(switch_xml_t xml)
 {
 	char *x = switch_xml_toxml(xml, SWITCH_FALSE);
-	return switch_xml_parse_str_dynamic(x, SWITCH_FALSE); 
+	return switch_xml_parse_str_arena(x, SWITCH_FALSE);
 }
 
 
@@ -1973,6 +2999,11 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user(const char *key,
 		goto end;
 	}
 
+	if (!ip && user_name && !strcasecmp(key, "id") &&
+		(status = xml_user_index_find(*domain, user_name, find_user_type(params), SWITCH_FALSE, user, ingroup)) != SWITCH_STATUS_NOTIMPL) {
+		goto end;
+	}
+
 	status = SWITCH_STATUS_FALSE;
 
 	if ((groups = switch_xml_child(*domain, "groups"))) {
@@ -2040,75 +3071,348 @@ SWITCH_DECLARE(void) switch_xml_free_in_thread(switch_xml_t xml, int stacksize)
 	switch_memory_pool_t *pool = NULL;
 	struct destroy_xml *dx;
 
-	switch_core_new_memory_pool(&pool);
+	switch_core_new_memory_pool(&pool);
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_detach_set(thd_attr, 1);
+	/* TBD figure out how much space we need by looking at the xml_t when stacksize == 0 */
+	switch_threadattr_stacksize_set(thd_attr, stacksize);
+
+	dx = switch_core_alloc(pool, sizeof(*dx));
+	dx->pool = pool;
+	dx->xml = xml;
+
+	switch_thread_create(&thread, thd_attr, destroy_thread, dx, pool);
+}
+
+static char not_so_threadsafe_error_buffer[256] = "";
+
+SWITCH_DECLARE(switch_status_t) switch_xml_set_root(switch_xml_t new_main)
+{
+	switch_xml_t old_root = NULL;
+
+	xml_user_index_build(new_main);
+
+	switch_mutex_lock(REFLOCK);
+
+	old_root = MAIN_XML_ROOT;
+	MAIN_XML_ROOT = new_main;
+	switch_set_flag(MAIN_XML_ROOT, SWITCH_XML_ROOT);
+	MAIN_XML_ROOT->refs++;
+			
+	if (old_root) {
+		if (old_root->refs) {
+			old_root->refs--;
+		}
+
+		if (!old_root->refs) {
+			switch_xml_free(old_root);
+		}
+	}
+
+	switch_mutex_unlock(REFLOCK);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_xml_set_open_root_function(switch_xml_open_root_function_t func, void *user_data)
+{
+	if (XML_LOCK) {
+		switch_mutex_lock(XML_LOCK);
+	}
+	
+	XML_OPEN_ROOT_FUNCTION = func;
+	XML_OPEN_ROOT_FUNCTION_USER_DATA = user_data;
+
+	if (XML_LOCK) {
+		switch_mutex_unlock(XML_LOCK);
+	}
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_xml_t) switch_xml_open_root(uint8_t reload, const char **err) 
+{
+	switch_xml_t root = NULL;
+
+	switch_mutex_lock(XML_LOCK);
+
+	if (XML_OPEN_ROOT_FUNCTION) {
+		root = XML_OPEN_ROOT_FUNCTION(reload, err, XML_OPEN_ROOT_FUNCTION_USER_DATA);
+	}
+	switch_mutex_unlock(XML_LOCK);
+
+	return root;
+}
+
+#define XML_SNAPSHOT_MAGIC "FSXMLSNAP 1"
+
+static char *xml_snapshot_path(void)
+{
+	return switch_mprintf("%s%sfreeswitch.xml.snapshot", SWITCH_GLOBAL_dirs.log_dir, SWITCH_PATH_SEPARATOR);
+}
+
+/*
+  A snapshot is the preprocessed text of a root with everything the preprocessor read to build it,
+  one track per line oldest first, so a later start can check nothing changed and skip the preprocessing.
+*/
+static void xml_snapshot_save(xml_track_state_t *state, const char *root_path, const char *fsxml)
+{
+	char *path = NULL, *tmp = NULL, buf[8192];
+	xml_track_t *track, **tracks = NULL;
+	int count = 0, i, fd = -1;
+	FILE *out = NULL;
+	struct stat st;
+	switch_ssize_t bytes;
+
+	for (track = state->head; track; track = track->next) {
+		if (track->type == XML_TRACK_EXEC) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Not writing an XML snapshot, the config runs %s\n", track->path);
+			return;
+		}
+		if (strchr(track->path, '\n') || strchr(track->path, '\t') || (track->value && strchr(track->value, '\n'))) {
+			return;
+		}
+		count++;
+	}
+
+	if (!count || (fd = open(fsxml, O_RDONLY, 0)) < 0 || fstat(fd, &st) != 0) {
+		goto end;
+	}
+
+	path = xml_snapshot_path();
+	tmp = switch_mprintf("%s.tmp", path);
+
+	if (!(out = fopen(tmp, "wb"))) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Cannot write XML snapshot %s\n", tmp);
+		goto end;
+	}
+
+	switch_zmalloc(tracks, count * sizeof(*tracks));
+	for (i = count, track = state->head; track; track = track->next) {
+		tracks[--i] = track;
+	}
+
+	fprintf(out, "%s %s\n", XML_SNAPSHOT_MAGIC, root_path);
+	for (i = 0; i < count; i++) {
+		track = tracks[i];
+		fprintf(out, "%d %" SWITCH_INT64_T_FMT " %" SWITCH_INT64_T_FMT " %u %s %s", track->type, (int64_t) track->mtime, track->size, track->sig,
+				track->section ? track->section : "-", track->path);
+		if (track->value) {
+			fprintf(out, "\t%s", track->value);
+		} else if (track->type == XML_TRACK_VAR) {
+			fprintf(out, "\t\t");
+		}
+		fprintf(out, "\n");
+	}
+	fprintf(out, "data %" SWITCH_INT64_T_FMT "\n", (int64_t) st.st_size);
+
+	while ((bytes = read(fd, buf, sizeof(buf))) > 0) {
+		if (fwrite(buf, 1, (size_t) bytes, out) != (size_t) bytes) {
+			break;
+		}
+	}
+
+	if (fclose(out) != 0 || bytes != 0) {
+		unlink(tmp);
+	} else if (rename(tmp, path) != 0) {
+		unlink(tmp);
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Wrote XML snapshot %s with %d tracks\n", path, count);
+	}
+	out = NULL;
+
+  end:
+
+	if (out) {
+		fclose(out);
+		unlink(tmp);
+	}
+	if (fd > -1) {
+		close(fd);
+	}
+	switch_safe_free(tracks);
+	switch_safe_free(tmp);
+	switch_safe_free(path);
+}
+
+/* the value a variable has at this point of the replay, sets are only applied once the whole snapshot checks out */
+static const char *xml_snapshot_var(switch_event_t *sets, const char *name, char **dup)
+{
+	const char *val;
+
+	switch_safe_free(*dup);
+
+	if ((val = switch_event_get_header(sets, name))) {
+		return val;
+	}
+
+	return (*dup = switch_core_get_variable_dup(name));
+}
+
+static switch_xml_t xml_snapshot_load(const char *root_path, xml_track_state_t **statep)
+{
+	char *path = NULL, *map = NULL, *p, *line, *end, *dup = NULL;
+	switch_xml_t xml = NULL;
+	switch_xml_root_t root;
+	xml_track_state_t *state = NULL;
+	xml_track_t *track;
+	switch_event_t *sets = NULL;
+	switch_event_header_t *hp;
+	switch_size_t map_len = 0, data_len = 0;
+	const char *why = NULL;
+	struct stat st;
+	int fd = -1;
+
+	*statep = NULL;
+	path = xml_snapshot_path();
 
-	switch_threadattr_create(&thd_attr, pool);
-	switch_threadattr_detach_set(thd_attr, 1);
-	/* TBD figure out how much space we need by looking at the xml_t when stacksize == 0 */
-	switch_threadattr_stacksize_set(thd_attr, stacksize);
+	if ((fd = open(path, O_RDONLY, 0)) < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) {
+		goto end;
+	}
 
-	dx = switch_core_alloc(pool, sizeof(*dx));
-	dx->pool = pool;
-	dx->xml = xml;
+	map_len = (switch_size_t) st.st_size;
+#ifndef WIN32
+	/* private so the parser can decode in place without touching the file */
+	if ((map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		map = NULL;
+		goto end;
+	}
+#else
+	if (!(map = malloc(map_len)) || read(fd, map, (unsigned) map_len) != (int) map_len) {
+		switch_safe_free(map);
+		goto end;
+	}
+#endif
 
-	switch_thread_create(&thread, thd_attr, destroy_thread, dx, pool);
-}
+	end = map + map_len;
+	switch_zmalloc(state, sizeof(*state));
+	switch_event_create_plain(&sets, SWITCH_EVENT_CHANNEL_DATA);
 
-static char not_so_threadsafe_error_buffer[256] = "";
+	for (line = map; line < end; line = p + 1) {
+		char *argv[6] = { 0 }, *value;
+		int argc;
 
-SWITCH_DECLARE(switch_status_t) switch_xml_set_root(switch_xml_t new_main)
-{
-	switch_xml_t old_root = NULL;
-	
-	switch_mutex_lock(REFLOCK);
+		if (!(p = memchr(line, '\n', end - line))) {
+			why = "truncated";
+			goto end;
+		}
+		*p = '\0';
 
-	old_root = MAIN_XML_ROOT;
-	MAIN_XML_ROOT = new_main;
-	switch_set_flag(MAIN_XML_ROOT, SWITCH_XML_ROOT);
-	MAIN_XML_ROOT->refs++;
-			
-	if (old_root) {
-		if (old_root->refs) {
-			old_root->refs--;
+		if (line == map) {
+			if (strncmp(line, XML_SNAPSHOT_MAGIC " ", strlen(XML_SNAPSHOT_MAGIC) + 1) || strcmp(line + strlen(XML_SNAPSHOT_MAGIC) + 1, root_path)) {
+				why = "written for another root";
+				goto end;
+			}
+			continue;
 		}
 
-		if (!old_root->refs) {
-			switch_xml_free(old_root);
+		if (!strncmp(line, "data ", 5)) {
+			data_len = (switch_size_t) strtoll(line + 5, NULL, 10);
+			if (!data_len || data_len != (switch_size_t) (end - (p + 1))) {
+				why = "truncated";
+				goto end;
+			}
+			p++;
+			break;
 		}
-	}
 
-	switch_mutex_unlock(REFLOCK);
+		if ((value = strchr(line, '\t'))) {
+			*value++ = '\0';
+		}
 
-	return SWITCH_STATUS_SUCCESS;
-}
+		if ((argc = switch_separate_string(line, ' ', argv, 6)) < 6) {
+			why = "corrupt";
+			goto end;
+		}
 
-SWITCH_DECLARE(switch_status_t) switch_xml_set_open_root_function(switch_xml_open_root_function_t func, void *user_data)
-{
-	if (XML_LOCK) {
-		switch_mutex_lock(XML_LOCK);
+		switch_zmalloc(track, sizeof(*track));
+		track->type = (xml_track_type_t) atoi(argv[0]);
+		track->mtime = (time_t) strtoll(argv[1], NULL, 10);
+		track->size = strtoll(argv[2], NULL, 10);
+		track->sig = (unsigned int) strtoul(argv[3], NULL, 10);
+		track->section = strcmp(argv[4], "-") ? strdup(argv[4]) : NULL;
+		track->path = strdup(argv[5]);
+		/* an unset variable is written with an empty value followed by a second tab */
+		track->value = value && *value != '\t' ? strdup(value) : NULL;
+		track->next = state->head;
+		state->head = track;
+
+		switch (track->type) {
+		case XML_TRACK_SET:
+			switch_event_del_header(sets, track->path);
+			switch_event_add_header_string(sets, SWITCH_STACK_BOTTOM, track->path, switch_str_nil(track->value));
+			break;
+		case XML_TRACK_VAR:
+			{
+				const char *now = xml_snapshot_var(sets, track->path, &dup);
+				if (!now != !track->value || (now && strcmp(now, track->value))) {
+					why = "a variable changed";
+					goto end;
+				}
+			}
+			break;
+		case XML_TRACK_SECTION:
+			break;
+		default:
+			if (xml_track_changed(track)) {
+				why = "a file changed";
+				goto end;
+			}
+			break;
+		}
 	}
-	
-	XML_OPEN_ROOT_FUNCTION = func;
-	XML_OPEN_ROOT_FUNCTION_USER_DATA = user_data;
 
-	if (XML_LOCK) {
-		switch_mutex_unlock(XML_LOCK);
+	if (!data_len) {
+		why = "truncated";
+		goto end;
 	}
-	return SWITCH_STATUS_SUCCESS;
-}
 
-SWITCH_DECLARE(switch_xml_t) switch_xml_open_root(uint8_t reload, const char **err) 
-{
-	switch_xml_t root = NULL;
+	if (!(root = (switch_xml_root_t) switch_xml_parse_str(p, data_len)) || !zstr(switch_xml_error(&root->xml))) {
+		if (root) {
+			switch_xml_free(&root->xml);
+		}
+		why = "unparsable";
+		goto end;
+	}
 
-	switch_mutex_lock(XML_LOCK);
+	root->map = map;
+	root->map_len = map_len;
+	map = NULL;
+	xml = &root->xml;
 
-	if (XML_OPEN_ROOT_FUNCTION) {
-		root = XML_OPEN_ROOT_FUNCTION(reload, err, XML_OPEN_ROOT_FUNCTION_USER_DATA);
+	for (hp = sets->headers; hp; hp = hp->next) {
+		switch_core_set_variable(hp->name, hp->value);
 	}
-	switch_mutex_unlock(XML_LOCK);
 
-	return root;
+	*statep = state;
+	state = NULL;
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Loaded XML root from snapshot %s\n", path);
+
+  end:
+
+	if (why) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Not using XML snapshot %s, %s\n", path, why);
+	}
+
+	if (map) {
+#ifndef WIN32
+		munmap(map, map_len);
+#else
+		free(map);
+#endif
+	}
+	if (fd > -1) {
+		close(fd);
+	}
+	if (sets) {
+		switch_event_destroy(&sets);
+	}
+	xml_track_free(&state);
+	switch_safe_free(dup);
+	switch_safe_free(path);
+
+	return xml;
 }
 
 SWITCH_DECLARE_NONSTD(switch_xml_t) __switch_xml_open_root(uint8_t reload, const char **err, void *user_data)
@@ -2116,6 +3420,7 @@ SWITCH_DECLARE_NONSTD(switch_xml_t) __switch_xml_open_root(uint8_t reload, const
 	char path_buf[1024];
 	uint8_t errcnt = 0;
 	switch_xml_t new_main, r = NULL;
+	xml_track_state_t *state = NULL;
 
 	if (MAIN_XML_ROOT) {
 		if (!reload) {
@@ -2125,7 +3430,20 @@ SWITCH_DECLARE_NONSTD(switch_xml_t) __switch_xml_open_root(uint8_t reload, const
 	}
 
 	switch_snprintf(path_buf, sizeof(path_buf), "%s%s%s", SWITCH_GLOBAL_dirs.conf_dir, SWITCH_PATH_SEPARATOR, "freeswitch.xml");
-	if ((new_main = switch_xml_parse_file(path_buf))) {
+
+	/* only the first load at startup may come from the snapshot, a reload always reads the files */
+	if (!MAIN_XML_ROOT && (switch_core_flags() & SCF_XML_SNAPSHOT) && (new_main = xml_snapshot_load(path_buf, &state))) {
+		*err = "Success";
+		switch_xml_set_root(new_main);
+		xml_track_free(&LAST_TRACK);
+		LAST_TRACK = state;
+		state = NULL;
+		goto loaded;
+	}
+
+	switch_zmalloc(state, sizeof(*state));
+
+	if ((new_main = xml_parse_file_tracked(path_buf, state))) {
 		*err = switch_xml_error(new_main);
 		switch_copy_string(not_so_threadsafe_error_buffer, *err, sizeof(not_so_threadsafe_error_buffer));
 		*err = not_so_threadsafe_error_buffer;
@@ -2135,14 +3453,21 @@ SWITCH_DECLARE_NONSTD(switch_xml_t) __switch_xml_open_root(uint8_t reload, const
 			errcnt++;
 		} else {
 			*err = "Success";
+			if ((switch_core_flags() & SCF_XML_SNAPSHOT) && new_main->free_path) {
+				xml_snapshot_save(state, path_buf, new_main->free_path);
+			}
 			switch_xml_set_root(new_main);
-
+			xml_track_free(&LAST_TRACK);
+			LAST_TRACK = state;
+			state = NULL;
 		}
 	} else {
 		*err = "Cannot Open log directory or XML Root!";
 		errcnt++;
 	}
 
+  loaded:
+
 	if (errcnt == 0) {
 		switch_event_t *event;
 		if (switch_event_create(&event, SWITCH_EVENT_RELOADXML) == SWITCH_STATUS_SUCCESS) {
@@ -2155,15 +3480,250 @@ SWITCH_DECLARE_NONSTD(switch_xml_t) __switch_xml_open_root(uint8_t reload, const
 
  done:
 
+	xml_track_free(&state);
+
 	return r;
 }
 
+static switch_bool_t xml_section_listed(char **list, int count, const char *section)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (!strcasecmp(list[i], section)) {
+			return SWITCH_TRUE;
+		}
+	}
+
+	return SWITCH_FALSE;
+}
+
+/* hands the children of the old section to the new empty one, the root that parsed them stays around while they are used */
+static switch_bool_t xml_graft_section(switch_xml_t old_main, switch_xml_t new_main, const char *section)
+{
+	switch_xml_root_t old_root = (switch_xml_root_t) old_main, new_root = (switch_xml_root_t) new_main;
+	switch_xml_t old_section, new_section, owner = old_main;
+	xml_graft_t *graft;
+
+	if (!(old_section = switch_xml_find_child(old_main, "section", "name", section)) ||
+		!(new_section = switch_xml_find_child(new_main, "section", "name", section)) || new_section->child) {
+		return SWITCH_FALSE;
+	}
+
+	for (graft = old_root->grafts; graft; graft = graft->next) {
+		if (graft->node == old_section) {
+			owner = graft->owner;
+			break;
+		}
+	}
+
+	switch_zmalloc(graft, sizeof(*graft));
+	graft->node = new_section;
+	graft->owner = owner;
+	graft->next = new_root->grafts;
+	new_root->grafts = graft;
+	new_section->child = old_section->child;
+
+	switch_mutex_lock(REFLOCK);
+	owner->refs++;
+	switch_mutex_unlock(REFLOCK);
+
+	return SWITCH_TRUE;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_xml_reload_sections(const char *what, const char **err)
+{
+	char path_buf[1024];
+	char *wanted[64] = { 0 }, *argv[64] = { 0 }, *dup = NULL;
+	int wanted_count = 0, argc = 0, i, full = 0;
+	xml_track_state_t *state = NULL;
+	xml_track_t *track;
+	switch_xml_t old_main = NULL, new_main = NULL;
+	switch_status_t status = SWITCH_STATUS_GENERR;
+	switch_stream_handle_t stream = { 0 };
+	switch_event_t *event;
+
+	switch_mutex_lock(XML_LOCK);
+
+	if (!MAIN_XML_ROOT || !LAST_TRACK || XML_OPEN_ROOT_FUNCTION != (switch_xml_open_root_function_t) __switch_xml_open_root) {
+		full = 1;
+		goto end;
+	}
+
+	if (!zstr(what)) {
+		dup = strdup(what);
+		switch_assert(dup);
+		argc = switch_separate_string(dup, ',', argv, (sizeof(argv) / sizeof(argv[0])));
+	}
+
+	/* a file name stands for the section it was included in, anything else is a section name */
+	for (i = 0; i < argc; i++) {
+		const char *section = argv[i];
+
+		for (track = LAST_TRACK->head; track; track = track->next) {
+			if (track->type == XML_TRACK_FILE && (!strcmp(track->path, argv[i]) || switch_stristr(argv[i], track->path))) {
+				if (!(section = track->section)) {
+					full = 1;
+					goto end;
+				}
+				break;
+			}
+		}
+
+		if (!xml_section_listed(wanted, wanted_count, section) && wanted_count < (int) (sizeof(wanted) / sizeof(wanted[0]))) {
+			wanted[wanted_count++] = (char *) section;
+		}
+	}
+
+	if (!argc) {
+		for (track = LAST_TRACK->head; track; track = track->next) {
+			if (!xml_track_changed(track)) {
+				continue;
+			}
+
+			if (!track->section) {
+				full = 1;
+				goto end;
+			}
+
+			if (!xml_section_listed(wanted, wanted_count, track->section) && wanted_count < (int) (sizeof(wanted) / sizeof(wanted[0]))) {
+				wanted[wanted_count++] = track->section;
+			}
+		}
+
+		if (!wanted_count) {
+			*err = "Unchanged";
+			status = SWITCH_STATUS_SUCCESS;
+			goto end;
+		}
+	}
+
+	for (i = 0; i < wanted_count; i++) {
+		for (track = LAST_TRACK->head; track; track = track->next) {
+			if (track->type == XML_TRACK_SECTION && !strcasecmp(track->path, wanted[i])) {
+				break;
+			}
+		}
+
+		if (!track) {
+			*err = "Unknown section";
+			goto end;
+		}
+	}
+
+	switch_zmalloc(state, sizeof(*state));
+	state->skip = calloc(64, sizeof(char *));
+	switch_assert(state->skip);
+
+	for (track = LAST_TRACK->head; track; track = track->next) {
+		if (track->type == XML_TRACK_SECTION && !xml_section_listed(wanted, wanted_count, track->path) &&
+			!xml_track_skipped(state, track->path) && state->skip_count < 64) {
+			state->skip[state->skip_count++] = strdup(track->path);
+		}
+	}
+
+	if (!state->skip_count) {
+		full = 1;
+		goto end;
+	}
+
+	switch_snprintf(path_buf, sizeof(path_buf), "%s%s%s", SWITCH_GLOBAL_dirs.conf_dir, SWITCH_PATH_SEPARATOR, "freeswitch.xml");
+
+	if (!(new_main = xml_parse_file_tracked(path_buf, state))) {
+		*err = "Cannot Open log directory or XML Root!";
+		goto end;
+	}
+
+	*err = switch_xml_error(new_main);
+	switch_copy_string(not_so_threadsafe_error_buffer, *err, sizeof(not_so_threadsafe_error_buffer));
+	*err = not_so_threadsafe_error_buffer;
+
+	if (!zstr(*err)) {
+		goto end;
+	}
+
+	old_main = switch_xml_root();
+
+	for (i = 0; i < state->skip_count; i++) {
+		if (!xml_graft_section(old_main, new_main, state->skip[i])) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Cannot keep section [%s] across a partial reload, reloading everything\n",
+							  state->skip[i]);
+			full = 1;
+			goto end;
+		}
+	}
+
+	/* the files of the sections that were kept still describe them */
+	for (track = LAST_TRACK->head; track; track = track->next) {
+		if (track->type != XML_TRACK_SECTION && xml_track_skipped(state, track->section)) {
+			xml_track_t *copy;
+
+			switch_zmalloc(copy, sizeof(*copy));
+			*copy = *track;
+			copy->path = strdup(track->path);
+			copy->section = strdup(track->section);
+			copy->next = state->head;
+			state->head = copy;
+		}
+	}
+
+	SWITCH_STANDARD_STREAM(stream);
+	for (i = 0; i < wanted_count; i++) {
+		stream.write_function(&stream, "%s%s", i ? "," : "", wanted[i]);
+	}
+
+	switch_xml_set_root(new_main);
+	new_main = NULL;
+	xml_track_free(&LAST_TRACK);
+	LAST_TRACK = state;
+	state = NULL;
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_NOTICE, "Reloaded XML sections [%s]\n", (char *) stream.data);
+
+	if (switch_event_create(&event, SWITCH_EVENT_RELOADXML) == SWITCH_STATUS_SUCCESS) {
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Reloaded-Sections", (char *) stream.data);
+		if (switch_event_fire(&event) != SWITCH_STATUS_SUCCESS) {
+			switch_event_destroy(&event);
+		}
+	}
+
+	switch_safe_free(stream.data);
+
+	*err = "Success";
+	status = SWITCH_STATUS_SUCCESS;
+
+  end:
+
+	if (new_main) {
+		switch_xml_free(new_main);
+	}
+
+	if (old_main) {
+		switch_xml_free(old_main);
+	}
+
+	xml_track_free(&state);
+	switch_safe_free(dup);
+	switch_mutex_unlock(XML_LOCK);
+
+	if (full) {
+		return switch_xml_reload(err);
+	}
+
+	if (status == SWITCH_STATUS_SUCCESS && strcmp(*err, "Unchanged")) {
+		switch_xml_clear_fetch_cache(NULL, NULL);
+	}
+
+	return status;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_xml_reload(const char **err)
 {
 	switch_xml_t xml_root;
 	
 	if ((xml_root = switch_xml_open_root(1, err))) {
 		switch_xml_free(xml_root);
+		switch_xml_clear_fetch_cache(NULL, NULL);
 		return SWITCH_STATUS_SUCCESS;
 	}
 
@@ -2182,11 +3742,16 @@ SWITCH_DECLARE(switch_status_t) switch_xml_init(switch_memory_pool_t *pool, cons
 	switch_mutex_init(&FILE_LOCK, SWITCH_MUTEX_NESTED, XML_MEMORY_POOL);
 	switch_mutex_init(&XML_GEN_LOCK, SWITCH_MUTEX_NESTED, XML_MEMORY_POOL);
 	switch_core_hash_init(&CACHE_HASH, XML_MEMORY_POOL);
+	switch_mutex_init(&FETCH_CACHE_MUTEX, SWITCH_MUTEX_DEFAULT, XML_MEMORY_POOL);
+	switch_thread_cond_create(&FETCH_CACHE_COND, XML_MEMORY_POOL);
+	switch_core_hash_init(&FETCH_CACHE_HASH, XML_MEMORY_POOL);
 
 	switch_thread_rwlock_create(&B_RWLOCK, XML_MEMORY_POOL);
 
 	assert(pool != NULL);
 
+	switch_snapshot_register("xml_fetch_cache", XML_FETCH_CACHE_SNAPSHOT_VERSION, xml_fetch_cache_save, xml_fetch_cache_load, NULL);
+
 	if ((xml = switch_xml_open_root(FALSE, err))) {
 		switch_xml_free(xml);
 		return SWITCH_STATUS_SUCCESS;
@@ -2198,6 +3763,7 @@ SWITCH_DECLARE(switch_status_t) switch_xml_init(switch_memory_pool_t *pool, cons
 SWITCH_DECLARE(switch_status_t) switch_xml_destroy(void)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
+	xml_fetch_entry_t *entry;
 
 
 	switch_mutex_lock(XML_LOCK);
@@ -2217,6 +3783,18 @@ SWITCH_DECLARE(switch_status_t) switch_xml_destroy(void)
 
 	switch_core_hash_destroy(&CACHE_HASH);
 
+	switch_snapshot_unregister("xml_fetch_cache");
+
+	switch_xml_clear_fetch_cache(NULL, NULL);
+	switch_core_hash_destroy(&FETCH_CACHE_HASH);
+
+	while ((entry = FETCH_CACHE_RESTORED)) {
+		FETCH_CACHE_RESTORED = entry->next;
+		xml_fetch_cache_restored_free(entry);
+	}
+
+	xml_track_free(&LAST_TRACK);
+
 	return status;
 }
 
@@ -2451,6 +4029,40 @@ static char *switch_xml_toxml_r(switch_xml_t xml, char **s, switch_size_t *len,
 	}
 }
 
+SWITCH_DECLARE(switch_status_t) switch_xml_stream_encode(switch_stream_handle_t *stream, const char *s, switch_bool_t attr)
+{
+	const char *p;
+	char *dst = NULL;
+	switch_size_t dlen = 0, max = 0;
+	switch_status_t status;
+
+	if (zstr(s)) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	/* most values need no encoding at all, write those straight through */
+	for (p = s; *p; p++) {
+		if (*p == '&' || *p == '<' || *p == '>' || *p == '"' || *p == '\n' || *p == '\t' || *p == '\r' || (*p & 0x80)) {
+			break;
+		}
+	}
+
+	if (!*p) {
+		return stream->raw_write_function(stream, (uint8_t *) s, p - s);
+	}
+
+	switch_xml_ampencode(s, 0, &dst, &dlen, &max, attr ? 1 : 0);
+
+	if (!dst) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	status = stream->raw_write_function(stream, (uint8_t *) dst, dlen);
+	free(dst);
+
+	return status;
+}
+
 SWITCH_DECLARE(char *) switch_xml_toxml_nolock(switch_xml_t xml, switch_bool_t prn_header)
 {
 	char *s = (char *) malloc(SWITCH_XML_BUFSIZE);
@@ -2554,6 +4166,7 @@ SWITCH_DECLARE(void) switch_xml_free(switch_xml_t xml)
 	char **a, *s;
 	switch_xml_t orig_xml;
 	int refs = 0;
+	xml_arena_t *arena = NULL;
 
   tailrecurse:
 	root = (switch_xml_root_t) xml;
@@ -2575,6 +4188,21 @@ SWITCH_DECLARE(void) switch_xml_free(switch_xml_t xml)
 		return;
 	}
 
+	if (!xml->parent && switch_test_flag(xml, SWITCH_XML_ROOT) && root->grafts) {
+		xml_graft_t *graft;
+
+		while ((graft = root->grafts)) {
+			root->grafts = graft->next;
+			graft->node->child = NULL;
+			switch_xml_free(graft->owner);
+			free(graft);
+		}
+	}
+
+	if (!xml->parent && switch_test_flag(xml, SWITCH_XML_ROOT) && root->user_index) {
+		xml_user_index_destroy(&root->user_index);
+	}
+
 	if (xml->free_path) {
 		if (!switch_stristr("freeswitch.xml.fsxml", xml->free_path)) {
 			if (unlink(xml->free_path) != 0) {
@@ -2615,11 +4243,23 @@ SWITCH_DECLARE(void) switch_xml_free(switch_xml_t xml)
 
 		if (root->dynamic == 1)
 			free(root->m);		/* malloced xml data */
+		if (root->map) {		/* snapshot the data was parsed from */
+#ifndef WIN32
+			munmap(root->map, root->map_len);
+#else
+			free(root->map);
+#endif
+		}
+		arena = root->arena;
+		root->arena = NULL;
 		if (root->u)
 			free(root->u);		/* utf8 conversion */
 	}
 
-	switch_xml_free_attr(xml->attr);	/* tag attributes */
+	if ((xml->flags & SWITCH_XML_ARENA_ATTR))
+		xml_free_arena_attr(xml->attr);	/* the list itself goes with the arena */
+	else
+		switch_xml_free_attr(xml->attr);	/* tag attributes */
 	if ((xml->flags & SWITCH_XML_TXTM))
 		free(xml->txt);			/* character content */
 	if ((xml->flags & SWITCH_XML_NAMEM))
@@ -2627,10 +4267,14 @@ SWITCH_DECLARE(void) switch_xml_free(switch_xml_t xml)
 	if (xml->ordered) {
 		orig_xml = xml;
 		xml = xml->ordered;
-		free(orig_xml);
+		if (!(orig_xml->flags & SWITCH_XML_ARENA))
+			free(orig_xml);
 		goto tailrecurse;
 	}
-	free(xml);
+	if (arena)
+		xml_arena_free(arena);	/* only ever set for the root tag, last to go */
+	if (!(xml->flags & SWITCH_XML_ARENA))
+		free(xml);
 }
 
 /* return parser error message or empty string if none */
@@ -2740,6 +4384,8 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_set_attr(switch_xml_t xml, const char *n
 
 	if (!xml)
 		return NULL;
+	if ((xml->flags & SWITCH_XML_ARENA_ATTR))
+		xml_attr_unarena(xml);
 	while (xml->attr[l] && strcmp(xml->attr[l], name))
 		l += 2;
 	if (!xml->attr[l]) {		/* not found, add as new attribute */